@@ -22,6 +22,7 @@
 #include "qpid/dispatch/ctools.h"
 #include "qpid/dispatch/threading.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -39,11 +40,19 @@ typedef struct qd_alloc_pool_t qd_alloc_pool_t;
 
 DEQ_DECLARE(qd_alloc_pool_t, qd_alloc_pool_list_t);
 
+/** Upper limit on the NUMA nodes that get their own global pools, higher nodes share node 0's */
+#define QD_ALLOC_MAX_NODES 8
+
+/** Size of the pages backing slabs configured with huge_pages */
+#define QD_ALLOC_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 /** Allocation configuration. */
 typedef struct {
-    int  transfer_batch_size;
-    int  local_free_list_max;
-    int  global_free_list_max;  ///< -1 means unlimited
+    int    transfer_batch_size;
+    int    local_free_list_max;
+    int    global_free_list_max;  ///< -1 means unlimited
+    size_t slab_size;             ///< 0: one heap allocation per item, else refill from slabs of this many bytes
+    bool   huge_pages;            ///< back slabs with (transparent) huge pages, slab_size is rounded up to a page
 } qd_alloc_config_t;
 
 /** Allocation statistics. */
@@ -53,13 +62,18 @@ typedef struct {
     uint64_t held_by_threads;
     uint64_t batches_rebalanced_to_threads;
     uint64_t batches_rebalanced_to_global;
+    uint64_t remote_frees_reclaimed;  ///< items freed by another thread and handed back to the allocating thread
+    uint64_t batches_rebalanced_from_remote_node;  ///< rebalances served by another NUMA node's global pool
 } qd_alloc_stats_t;
 
+/** Number of trim samples making up the idle-memory window (see qd_alloc_trim) */
+#define QD_ALLOC_TRIM_WINDOW 6
+
 /** Allocation type descriptor. */
 typedef struct qd_alloc_type_desc_t {
     // note: keep most frequently accessed fields at the top
     sys_mutex_t              lock;
-    qd_alloc_pool_t         *global_pool;
+    qd_alloc_pool_t         *global_pools;  // one per NUMA node
     const qd_alloc_config_t *config;
     size_t                   total_size;
     qd_alloc_stats_t         stats;
@@ -68,6 +82,12 @@ typedef struct qd_alloc_type_desc_t {
     const char              *type_name;
     const size_t            *additional_size;
     void                    *debug;
+    void                    *slabs;
+    void                    *samples;
+    uint64_t                 global_low_water;  // smallest global free list size since the last trim sample
+    uint64_t                 trim_window[QD_ALLOC_TRIM_WINDOW];
+    int                      trim_slot;
+    const struct qd_alloc_type_desc_t *embedded_in;  // see qd_alloc_desc_embedded_in()
     DEQ_LINKS(struct qd_alloc_type_desc_t);
 } qd_alloc_type_desc_t;
 
@@ -81,6 +101,8 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool);
 /** De-allocate from a thread pool. Use via ALLOC_DECLARE */
 void qd_dealloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool, char *p);
 uint32_t qd_alloc_sequence(void *p);
+/** Invalidate the safe pointers to an item that stays allocated, e.g. one embedded in a larger item */
+void qd_alloc_sequence_bump(void *p);
 
 // generic safe pointer api for any alloc pool item
 
@@ -123,6 +145,12 @@ static inline void *qd_alloc_deref_safe_ptr(const qd_alloc_safe_ptr_t *sp)
 void qd_alloc_desc_init(const char *name, qd_alloc_type_desc_t *desc, size_t size, const size_t *additional_size,
                         const qd_alloc_config_t *config);
 qd_alloc_stats_t qd_alloc_desc_stats(const qd_alloc_type_desc_t *desc);  // thread safe
+/**
+ * Each item of container holds one item of desc that is not allocated from the pool of desc: the stats of desc count
+ * them too.
+ */
+void qd_alloc_desc_embedded_in(qd_alloc_type_desc_t *desc, const qd_alloc_type_desc_t *container);
+size_t qd_alloc_desc_sampled(const qd_alloc_type_desc_t *desc);          // thread safe, live profiler samples
 // clang-format off
 #define ALLOC_DEFINE_CONFIG(T,S,A,C)                                    \
     qd_alloc_type_desc_t __desc_##T  __attribute__((aligned(64)));      \
@@ -154,8 +182,71 @@ void qd_alloc_debug_dump(const char *file);
 void qd_alloc_finalize(void);
 size_t qd_alloc_type_size(const qd_alloc_type_desc_t *desc);  // thread safe
 
+/**
+ * First of the allocation types, follow the list with DEQ_NEXT(desc). The list does not change between
+ * qd_alloc_initialize() and qd_alloc_finalize(), so it may be walked from any thread in between.
+ */
+qd_alloc_type_desc_t *qd_alloc_desc_first(void);
+
 // control the periodic logging of alloc pool utilization
 typedef struct qd_dispatch_t qd_dispatch_t;
 void qd_alloc_start_monitor(qd_dispatch_t *qd);
 void qd_alloc_stop_monitor(void);
+
+/**
+ * Router memory pressure: the memory held by the allocation pools as a percentage of the router memory ceiling (the
+ * maxMemory budget if configured, otherwise the platform memory size or the SKUPPER_ROUTER_MEMORY_CEILING override).
+ * Sampled once a second by the alloc pool monitor; zero until the monitor has started.  Thread safe.
+ */
+int qd_alloc_memory_pressure(void);
+
+/**
+ * Set the router memory budget in bytes, 0 (the default) falls back to the platform memory size.  Must be called
+ * before qd_alloc_start_monitor().
+ */
+void qd_alloc_set_memory_budget(uint64_t bytes);
+
+/**
+ * Graduated router-wide responses to memory pressure.  Each state includes the responses of the states before it:
+ * adaptive Q2 limits shrink, then new incoming links are attached without initial credit, then new connections are
+ * refused.
+ */
+typedef enum {
+    QD_MEMORY_NORMAL = 0,
+    QD_MEMORY_SHRINK_Q2,
+    QD_MEMORY_HOLD_CREDIT,
+    QD_MEMORY_REFUSE_CONNECTIONS,
+} qd_memory_state_t;
+
+/**
+ * The current memory state, QD_MEMORY_NORMAL until the monitor has started.  Thread safe.
+ */
+qd_memory_state_t qd_alloc_memory_state(void);
+
+/**
+ * Move the memory state for a new pressure sample and return it.  A state is entered when the pressure reaches its
+ * threshold and left only once the pressure falls a few points below it, transitions are logged.  Run by the alloc
+ * pool monitor on every pressure sample.
+ */
+qd_memory_state_t qd_alloc_update_memory_state(int pressure);
+
+/**
+ * Take one trim sample for every allocation type and release the part of the global free list that stayed unused
+ * for the whole QD_ALLOC_TRIM_WINDOW samples.  At most a bounded number of batches is released per type per call so
+ * the descriptor lock is held briefly.  Run periodically by the alloc pool monitor; thread safe.
+ */
+void qd_alloc_trim(void);
+
+/**
+ * Sample the call stack of every rate-th allocation made by each thread, 0 (the default) disables sampling.  The
+ * stacks of live sampled allocations are reported by qd_alloc_profile_report() and the allocator entity.
+ */
+void qd_alloc_set_profile_rate(uint32_t rate);
+
+/**
+ * Symbolized report of the live sampled allocations of the type, grouped by call stack, largest groups first.  At
+ * most max_stacks stacks are reported.  Returns a malloc'ed string the caller must free, or 0 if there are no live
+ * samples.  Thread safe.
+ */
+char *qd_alloc_profile_report(qd_alloc_type_desc_t *desc, int max_stacks);
 #endif
@@ -113,7 +113,8 @@ typedef enum {
 
 // Router annotations: maximum supported version
 //
-#define QD_ROUTER_ANNOTATIONS_VERSION 2
+#define QD_ROUTER_ANNOTATIONS_VERSION 3
+#define QD_TRACE_FINGERPRINT_SIZE     8  // octets of a router fingerprint in a compact trace (version 3)
 
 /** @name Standard codepoints */
 /// @{
@@ -140,6 +141,7 @@ extern const char * const QD_CAPABILITY_ROUTER_DATA;
 extern const char * const QD_CAPABILITY_EDGE_DOWNLINK;
 extern const char * const QD_CAPABILITY_STREAMING_DELIVERIES;
 extern const char * const QD_CAPABILITY_RESEND_RELEASED;
+extern const char * const QD_CAPABILITY_EDGE_TRACKING_BATCH;
 /// @}
 
 /** @name Dynamic Node Properties */
@@ -166,6 +168,8 @@ extern const char * const QD_CONNECTION_PROPERTY_ADAPTOR_KEY;
 extern const char * const QD_CONNECTION_PROPERTY_TCP_ADAPTOR_VALUE;
 extern const char * const QD_CONNECTION_PROPERTY_ANNOTATIONS_VERSION_KEY;
 extern const char * const QD_CONNECTION_PROPERTY_ACCESS_ID;
+extern const char * const QD_CONNECTION_PROPERTY_COMPRESSION_KEY;
+extern const char * const QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE;
 /// @}
 
 /** @name Terminus Addresses */
@@ -43,6 +43,10 @@ qd_connection_t *qd_link_connection(const qd_link_t *qd_link);
 void qd_link_set_incoming_msg(qd_link_t *link, qd_message_t *msg);
 void qd_link_q2_restart_receive(qd_alloc_safe_ptr_t context);
 bool qd_link_is_q2_limit_unbounded(const qd_link_t *link);
+uint32_t qd_link_q2_limit(const qd_link_t *link);
+void qd_link_q2_blocked(qd_link_t *link);
+void qd_link_q2_starved(qd_link_t *link);
+bool qd_link_q2_stats(qd_link_t *link, uint32_t *limit, uint32_t *blocked_count);
 pn_link_t *qd_link_pn(const qd_link_t *link);
 bool qd_connection_strip_annotations_in(const qd_connection_t *c);
 uint64_t qd_connection_max_message_size(const qd_connection_t *c);
@@ -50,6 +54,21 @@ void qd_connection_log_policy_denial(const qd_link_t *link, const char *text);
 qd_session_t *qd_link_get_session(const qd_link_t *link);
 size_t qd_session_get_outgoing_capacity(const qd_session_t *qd_ssn);
 
+// Per outgoing link cache of the last router annotations section sent, owned by message.c
+typedef struct qd_message_ra_cache_t qd_message_ra_cache_t;
+qd_message_ra_cache_t **qd_link_ra_cache(qd_link_t *link);
+void qd_message_ra_cache_free(qd_message_ra_cache_t *cache);
+
+// Per link compression context of connections that compress transfers, see compression.h
+typedef struct qd_compression_t        qd_compression_t;
+typedef struct qdr_compression_stats_t qdr_compression_stats_t;
+qd_compression_t **qd_link_compression(qd_link_t *link);
+bool qd_connection_compression(const qd_connection_t *c);
+qdr_compression_stats_t *qd_connection_compression_stats(qd_connection_t *c);
+
+// True if the peer router of the connection accepts the compact trace annotation (router annotations version 3)
+bool qd_connection_compact_trace(const qd_connection_t *c);
+
 // Used by the log module
 void qd_amqp_connection_set_tracing(bool enabled);
 
@@ -20,9 +20,10 @@
  */
 
 /**@file
- * Portable atomic operations on uint32_t.
+ * Portable atomic operations on uint32_t and pointers.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -32,6 +33,8 @@ extern "C++" {
 #include <atomic>
 }
 using std::atomic_uint;
+using std::atomic_uint_least64_t;
+using std::atomic_uintptr_t;
 #else
 #include <stdatomic.h>
 #endif
@@ -71,6 +74,43 @@ static inline uint32_t sys_atomic_set(sys_atomic_t *ref, uint32_t value)
 
 static inline void sys_atomic_destroy(sys_atomic_t *ref) {}
 
+//
+// Atomic pointers
+//
+// The pointer is stored as a uintptr_t so the same declaration works for C and the C++ unit tests.
+//
+
+typedef atomic_uintptr_t sys_atomic_ptr_t;
+
+static inline void sys_atomic_ptr_init(sys_atomic_ptr_t *ref, void *value)
+{
+#ifdef __cplusplus
+    atomic_store_explicit(ref, (uintptr_t) value, std::memory_order_relaxed);
+#else
+    atomic_init(ref, (uintptr_t) value);
+#endif
+}
+
+static inline void *sys_atomic_ptr_get(sys_atomic_ptr_t *ref)
+{
+    return (void *) atomic_load(ref);
+}
+
+/** Atomic exchange: NOTE returns the value *before* the exchange */
+static inline void *sys_atomic_ptr_set(sys_atomic_ptr_t *ref, void *value)
+{
+    return (void *) atomic_exchange(ref, (uintptr_t) value);
+}
+
+/**
+ * Compare and swap.  If the value of ref equals *expected replace it with desired and return true.  Otherwise load the
+ * current value into *expected and return false.  May fail spuriously, use in a loop.
+ */
+static inline bool sys_atomic_ptr_cas(sys_atomic_ptr_t *ref, void **expected, void *desired)
+{
+    return atomic_compare_exchange_weak(ref, (uintptr_t *) expected, (uintptr_t) desired);
+}
+
 #define    SET_ATOMIC_FLAG(flag)        sys_atomic_set((flag), 1)
 #define  CLEAR_ATOMIC_FLAG(flag)        sys_atomic_set((flag), 0)
 #define    SET_ATOMIC_BOOL(flag, value) sys_atomic_set((flag), ((value) ? 1 : 0))
@@ -32,7 +32,8 @@
 /** A bit mask */
 typedef struct qd_bitmask_t qd_bitmask_t;
 
-/** Number of bits in a bitmask. */
+/** Number of bits in a bitmask, and so the maximum number of routers in a network.  Set at build
+ * time by the QD_MAX_ROUTERS CMake option. */
 int qd_bitmask_width(void);
 
 /** Create a bitmask.
@@ -48,6 +49,11 @@ int qd_bitmask_value(qd_bitmask_t *b, int bitnum);
 int qd_bitmask_first_set(qd_bitmask_t *b, int *bitnum);
 int qd_bitmask_cardinality(const qd_bitmask_t *b);
 
+/** Bulk operations over the whole mask: dest = src, dest |= src, dest &= src */
+void qd_bitmask_copy(qd_bitmask_t *dest, const qd_bitmask_t *src);
+void qd_bitmask_or(qd_bitmask_t *dest, const qd_bitmask_t *src);
+void qd_bitmask_and(qd_bitmask_t *dest, const qd_bitmask_t *src);
+
 bool qd_bitmask_valid_bit_value(int bitnum);
 
 int _qdbm_start(qd_bitmask_t *b);
@@ -35,22 +35,86 @@ typedef struct qd_buffer_t qd_buffer_t;
 ALLOC_DECLARE(qd_buffer_t);
 DEQ_DECLARE(qd_buffer_t, qd_buffer_list_t);
 
-#define QD_BUFFER_DEFAULT_SIZE (4096 - sizeof(qd_buffer_t))
+/**
+ * Buffers come in three size classes, each with its own allocation pool.  The default class
+ * (QD_BUFFER_SIZE) is used unless the caller knows better: small buffers for short control
+ * content and large buffers for bulk streaming data.  A buffer list may mix classes, so code
+ * walking a list must use qd_buffer_size() and qd_buffer_capacity() of each buffer.
+ */
+typedef enum {
+    QD_BUFFER_CLASS_SMALL,
+    QD_BUFFER_CLASS_DEFAULT,
+    QD_BUFFER_CLASS_LARGE,
+    QD_BUFFER_CLASS_SHARED,  ///< No data area of its own, see qd_buffer_share()
+    QD_BUFFER_CLASS_EXTERNAL ///< Data area outside the pools, see qd_buffer_external()
+} qd_buffer_class_t;
+
+#define QD_BUFFER_SMALL_DEFAULT_SIZE (512 - sizeof(qd_buffer_t))
+#define QD_BUFFER_DEFAULT_SIZE       (4096 - sizeof(qd_buffer_t))
+#define QD_BUFFER_LARGE_DEFAULT_SIZE (65536 - sizeof(qd_buffer_t))
+extern size_t QD_BUFFER_SMALL_SIZE;
 extern size_t QD_BUFFER_SIZE;
+extern size_t QD_BUFFER_LARGE_SIZE;
 
 /** A raw byte buffer .*/
 struct qd_buffer_t {
     DEQ_LINKS(qd_buffer_t);
-    unsigned int size;     ///< Size of data content
-    sys_atomic_t bfanout;  ///< The number of receivers for this buffer
+    unsigned int      size;        ///< Size of data content
+    unsigned int      capacity;    ///< Size of the data area
+    sys_atomic_t      bfanout;     ///< The number of receivers for this buffer
+    sys_atomic_t      refs;        ///< References to the data area: the buffer itself plus its shares
+    qd_buffer_class_t size_class;  ///< The pool the buffer was allocated from
 };
 
+/**
+ * A QD_BUFFER_CLASS_SHARED buffer carries this in place of a data area: the buffer that owns
+ * the data and where in it the shared view starts.  A QD_BUFFER_CLASS_EXTERNAL buffer has no
+ * owner, release(context) is called when it is freed.
+ */
+typedef struct qd_buffer_share_t {
+    qd_buffer_t   *owner;
+    unsigned char *data;
+    void         (*release)(void *context);
+    void          *context;
+} qd_buffer_share_t;
+
 /**
  * Create a buffer with capacity set to the value of BUFFER_SIZE, and data
  * content size of 0 bytes.
  */
 qd_buffer_t *qd_buffer(void);
 
+/**
+ * Create an empty buffer of the given size class.
+ */
+qd_buffer_t *qd_buffer_sized(qd_buffer_class_t size_class);
+
+/**
+ * Create a buffer that shares the data of buf from offset up to its current size, without
+ * copying.  The new buffer is read-only: it and buf report zero capacity while the data is
+ * shared, so appends to either go to a new buffer (copy on write).  Content already in buf must
+ * not be modified in place while shares exist.  The data is released when buf and all its shares
+ * have been freed with qd_buffer_free().
+ *
+ * @param buf The buffer whose data is to be shared (may itself be a share)
+ * @param offset Offset into buf's content where the shared view starts
+ */
+qd_buffer_t *qd_buffer_share(qd_buffer_t *buf, size_t offset);
+
+/**
+ * Create a read-only buffer holding size octets of data that lives outside the buffer pools (a
+ * memory mapped spool file, see spool.h).  Like a share it reports zero capacity.  When the
+ * buffer and all its shares have been freed release(context) is called.
+ */
+qd_buffer_t *qd_buffer_external(unsigned char *data, size_t size, void (*release)(void *context), void *context);
+
+/**
+ * The number of default-class buffers that would hold the same memory as all buffers held
+ * by threads (in use or in per-thread free pools).  Used to compare buffer usage across size
+ * classes with limits expressed in default buffers.
+ */
+uint64_t qd_buffer_held_units(void);
+
 /**
  * Free a buffer
  * @param buf A pointer to an allocated buffer
@@ -64,6 +128,8 @@ void qd_buffer_free(qd_buffer_t *buf);
  */
 static inline unsigned char *qd_buffer_base(const qd_buffer_t *buf)
 {
+    if (buf->size_class >= QD_BUFFER_CLASS_SHARED)
+        return ((const qd_buffer_share_t*) &buf[1])->data;
     return (unsigned char*) &buf[1];
 }
 
@@ -74,7 +140,7 @@ static inline unsigned char *qd_buffer_base(const qd_buffer_t *buf)
  */
 static inline unsigned char *qd_buffer_cursor(const qd_buffer_t *buf)
 {
-    return ((unsigned char*) &buf[1]) + buf->size;
+    return qd_buffer_base(buf) + buf->size;
 }
 
 /**
@@ -84,7 +150,9 @@ static inline unsigned char *qd_buffer_cursor(const qd_buffer_t *buf)
  */
 static inline size_t qd_buffer_capacity(const qd_buffer_t *buf)
 {
-    return QD_BUFFER_SIZE - buf->size;
+    if (buf->size_class >= QD_BUFFER_CLASS_SHARED || sys_atomic_get((sys_atomic_t*) &buf->refs) > 1)
+        return 0;
+    return buf->capacity - buf->size;
 }
 
 /**
@@ -107,7 +175,7 @@ static inline size_t qd_buffer_size(const qd_buffer_t *buf)
 static inline void qd_buffer_insert(qd_buffer_t *buf, size_t len)
 {
     buf->size += len;
-    assert(buf->size <= QD_BUFFER_SIZE);
+    assert(buf->size <= buf->capacity);
 }
 
 /**
@@ -119,6 +187,16 @@ static inline void qd_buffer_insert(qd_buffer_t *buf, size_t len)
  */
 unsigned int qd_buffer_list_clone(qd_buffer_list_t *dst, const qd_buffer_list_t *src);
 
+/**
+ * Create a new buffer list sharing the data of an existing one (see qd_buffer_share).  The cost
+ * is per buffer rather than per byte.
+ *
+ * @param dst A pointer to a list to contain the new buffers
+ * @param src A pointer to an existing buffer list
+ * @return the number of bytes of data in the new chain
+ */
+unsigned int qd_buffer_list_clone_shared(qd_buffer_list_t *dst, const qd_buffer_list_t *src);
+
 /**
  * Free all the buffers contained in a buffer list
  *
@@ -178,8 +256,8 @@ static inline uint32_t qd_buffer_dec_fanout(qd_buffer_t *buf)
  */
 static inline unsigned char *qd_buffer_at(const qd_buffer_t *buf, size_t len)
 {
-    assert(len <= QD_BUFFER_SIZE);
-    return ((unsigned char*) &buf[1]) + len;
+    assert(len <= buf->capacity);
+    return qd_buffer_base(buf) + len;
 }
 
 
@@ -25,6 +25,9 @@
 /** A linked list of buffers composing a sequence of AMQP data objects. */
 typedef struct qd_composed_field_t qd_composed_field_t;
 
+/** The frozen encoding of a composed field, see ::qd_compose_template(). */
+typedef struct qd_compose_template_t qd_compose_template_t;
+
 
 /**@file
  * Composing AMQP data trees.
@@ -202,6 +205,17 @@ void qd_compose_insert_string_iterator(qd_composed_field_t *field, qd_iterator_t
  */
 void qd_compose_insert_symbol(qd_composed_field_t *field, const char *value);
 
+/**
+ * Insert null-terminated utf8-encoded strings, or symbols, into the field as consecutive elements of the enclosing
+ * list or map.  Same as inserting them one at a time, but the enclosing composite is updated once.
+ *
+ * @param field A field created by qd_compose.
+ * @param values An array of count pointers to null-terminated strings.
+ * @param count The number of strings.
+ */
+void qd_compose_insert_strings(qd_composed_field_t *field, const char *const *values, size_t count);
+void qd_compose_insert_symbols(qd_composed_field_t *field, const char *const *values, size_t count);
+
 /**
  * Insert a type-tagged value into the field from an iterator
  *
@@ -259,6 +273,28 @@ void qd_compose_insert_buffer_field(qd_composed_field_t *field,
  */
 void qd_compose_insert_double(qd_composed_field_t *field, double value);
 
+/**
+ * Freeze the encoding of a completely composed field into a template, for sections that are sent unchanged in many
+ * messages (the headers of recurring control messages).  The octets are copied into one contiguous block, the field
+ * is not modified and must still be freed by the caller.
+ *
+ * @param field A field with no open list or map.
+ * @return The template, to be freed with ::qd_compose_template_free().
+ */
+qd_compose_template_t *qd_compose_template(qd_composed_field_t *field);
+
+/**
+ * Begin a composed field with the encoding of a template, as if the template's field had been composed again.
+ *
+ * @param tmpl A template returned by ::qd_compose_template().
+ * @param extend An existing field with no open list or map onto which to append the template or NULL to create a
+ *        standalone field.
+ * @return A pointer to the field, which may be extended further.
+ */
+qd_composed_field_t *qd_compose_from_template(const qd_compose_template_t *tmpl, qd_composed_field_t *extend);
+
+void qd_compose_template_free(qd_compose_template_t *tmpl);
+
 
 ///@}
 
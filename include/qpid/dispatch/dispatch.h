@@ -90,6 +90,12 @@ qd_policy_t *qd_dispatch_get_policy(const qd_dispatch_t *dispatch);
  */
 uint32_t qd_dispatch_get_data_connection_count(const qd_dispatch_t *dispatch);
 
+/**
+ * Return the number of inter-router data connections a connector may grow to under load. Equal to the configured
+ * count unless dataConnectionCount is 'auto'.
+ */
+uint32_t qd_dispatch_get_data_connection_max(const qd_dispatch_t *dispatch);
+
 /**
  * Return the routers server
  */
@@ -0,0 +1,83 @@
+#ifndef __flight_recorder_h__
+#define __flight_recorder_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Flight recorder: the most recent events of every thread, kept for postmortem analysis.
+ *
+ * Each thread records into its own ring of QD_FLIGHT_RECORDER_EVENTS fixed size events, claimed from a static table
+ * of QD_FLIGHT_RECORDER_THREADS rings the first time the thread records. Recording takes no lock and makes no
+ * allocation: it writes one slot and advances the ring head. The ring of a thread that exits is taken over by the next
+ * thread claiming one. Threads beyond the size of the table are not recorded.
+ *
+ * The rings are written out by qd_flight_recorder_dump(), which is async-signal-safe so that it can be called from the
+ * panic handler and on SIGUSR2, and read by the GET-FLIGHT-RECORDER management operation. Neither stops the recording
+ * threads: an event overwritten or being written while it is read is skipped.
+ */
+
+#include <stdint.h>
+
+#define QD_FLIGHT_RECORDER_EVENTS  1024  // per thread, must be a power of two
+#define QD_FLIGHT_RECORDER_THREADS 64
+
+// A handler that runs longer than this is recorded as a QD_FLIGHT_LONG_HANDLER event
+#define QD_FLIGHT_LONG_HANDLER_NS  (10 * 1000 * 1000)
+
+//                                  arg0                  arg1                  arg2
+typedef enum {
+    QD_FLIGHT_NONE = 0,
+    QD_FLIGHT_ACTION,            // label (const char *)  run time (ns)         queue delay (us)
+    QD_FLIGHT_CONN_OPENED,       // connection id         role                  incoming
+    QD_FLIGHT_CONN_CLOSED,       // connection id         role
+    QD_FLIGHT_Q2_BLOCKED,        // link id               Q2 limit (buffers)
+    QD_FLIGHT_Q3_BLOCKED,        // link id
+    QD_FLIGHT_WINDOW_CLOSED,     // connection id         inbound octets
+    QD_FLIGHT_LONG_HANDLER,      // proactor mode         run time (ns)         events handled
+    QD_FLIGHT_EVENT_TYPE_COUNT
+} qd_flight_event_type_t;
+
+typedef struct qd_flight_event_t {
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC
+    uint64_t arg0;
+    uint64_t arg1;
+    uint32_t arg2;
+    uint32_t type;          // qd_flight_event_type_t
+} qd_flight_event_t;
+
+// Monotonic clock used for the event timestamps
+//
+uint64_t qd_flight_recorder_now_ns(void);
+
+// Record an event stamped with a time the caller has already read from qd_flight_recorder_now_ns()
+//
+void qd_flight_record_at(uint64_t timestamp_ns, qd_flight_event_type_t type, uint64_t arg0, uint64_t arg1, uint32_t arg2);
+
+static inline void qd_flight_record(qd_flight_event_type_t type, uint64_t arg0, uint64_t arg1, uint32_t arg2)
+{
+    qd_flight_record_at(qd_flight_recorder_now_ns(), type, arg0, arg1, arg2);
+}
+
+const char *qd_flight_event_type_name(qd_flight_event_type_t type);
+
+// Write the recorded events of every thread, oldest first, as text to file descriptor fd. Async-signal-safe.
+//
+void qd_flight_recorder_dump(int fd);
+
+#endif
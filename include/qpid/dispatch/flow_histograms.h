@@ -0,0 +1,53 @@
+#ifndef __flow_histograms_h__
+#define __flow_histograms_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * System-wide histograms of per-flow measurements, by protocol.
+ *
+ * The histograms are registered in the metrics registry (see metrics.h) as qdr_<protocol>_<histogram>.
+ */
+
+#include "qpid/dispatch/protocols.h"
+
+#include <stdint.h>
+
+typedef enum {
+    QD_FLOW_HIST_CONNECT,     // usec from initiating the egress connection to the server until it is connected
+    QD_FLOW_HIST_FIRST_BYTE,  // usec from the client's first octet until the first octet of the reply is written
+    QD_FLOW_HIST_DURATION,    // usec from the start of the flow until it is closed
+    QD_FLOW_HIST_THROUGHPUT,  // octets per second in both directions, averaged over the duration of the flow
+    QD_FLOW_HIST_TOTAL  // must be last
+} qd_flow_histogram_t;
+
+// Register the histograms of every protocol, called once at startup after qd_metrics_initialize()
+//
+void qd_flow_histograms_initialize(void);
+void qd_flow_histograms_finalize(void);
+
+// Add a measurement of a flow of protocol 'proto' to histogram 'hist'
+//
+void qd_flow_histogram_record(qd_protocol_t proto, qd_flow_histogram_t hist, uint64_t value);
+
+// Return the name of histogram 'hist' as used for metrics, e.g. "flow_connect_microseconds"
+//
+const char *qd_flow_histogram_name(qd_flow_histogram_t hist);
+
+#endif
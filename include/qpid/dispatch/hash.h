@@ -26,14 +26,122 @@
 #include "qpid/dispatch/error.h"
 #include "qpid/dispatch/iterator.h"
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define HASH_INIT ((uint32_t) 5381)
-#define HASH_COMPUTE(HASH, OCTET) ((((HASH)<<5) + (HASH)) + (uint32_t)(OCTET))  // hash * 33 + octet
+//
+// Streaming key hash shared by qd_hash_t and the iterator hash functions.
+//
+// Input is folded into the state eight octets at a time with a 64x64->128 bit multiply (in the
+// style of wyhash); only a trailing partial word is assembled octet by octet.  The result depends
+// solely on the octet sequence and not on how it was split across qd_hash_update() calls, so a key
+// hashed from a string, from a chain of buffers or a prefix at a time all produce the same value.
+// Hash values are never exchanged between routers.
+//
+typedef struct qd_hash_state_t {
+    uint64_t acc;
+    uint64_t tail;    // octets of the incomplete trailing word, first octet in the low byte
+    uint32_t length;  // total octets consumed
+} qd_hash_state_t;
+
+#define QD_HASH_SEED_0 0xa0761d6478bd642fULL
+#define QD_HASH_SEED_1 0xe7037ed1a0b428dbULL
+#define QD_HASH_SEED_2 0x8ebc6af09c88c6e3ULL
+
+static inline uint64_t qd_hash_mix(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) a * b;
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+    const uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+    const uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+    const uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t) hi_lo + lo_hi;
+    const uint64_t lo    = (cross << 32) | (uint32_t) lo_lo;
+    const uint64_t hi    = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return lo ^ hi;
+#endif
+}
+
+static inline uint64_t qd_hash_load64(const uint8_t *data)
+{
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+static inline void qd_hash_fold(qd_hash_state_t *state, uint64_t word)
+{
+    state->acc = qd_hash_mix(word ^ QD_HASH_SEED_0, state->acc ^ QD_HASH_SEED_1);
+}
+
+static inline void qd_hash_init(qd_hash_state_t *state)
+{
+    state->acc    = QD_HASH_SEED_2;
+    state->tail   = 0;
+    state->length = 0;
+}
+
+static inline void qd_hash_update(qd_hash_state_t *state, const uint8_t *data, size_t len)
+{
+    unsigned int used = state->length & 7;
+    state->length += (uint32_t) len;
+
+    if (used) {
+        // complete the partial word left by the previous update
+        while (len && used < 8) {
+            state->tail |= (uint64_t) *data++ << (8 * used++);
+            len--;
+        }
+        if (used < 8)
+            return;
+        qd_hash_fold(state, state->tail);
+        state->tail = 0;
+    }
+
+    while (len >= 8) {
+        qd_hash_fold(state, qd_hash_load64(data));
+        data += 8;
+        len  -= 8;
+    }
+
+    for (used = 0; len; --len) {
+        state->tail |= (uint64_t) *data++ << (8 * used++);
+    }
+}
+
+static inline uint32_t qd_hash_final(const qd_hash_state_t *state)
+{
+    uint64_t h = qd_hash_mix(state->tail ^ QD_HASH_SEED_0, state->acc ^ state->length);
+    h = qd_hash_mix(h ^ QD_HASH_SEED_1, QD_HASH_SEED_2);
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+static inline uint32_t qd_hash_bytes(const uint8_t *data, size_t len)
+{
+    qd_hash_state_t state;
+    qd_hash_init(&state);
+    qd_hash_update(&state, data, len);
+    return qd_hash_final(&state);
+}
 
 typedef struct qd_hash_t        qd_hash_t;
 typedef struct qd_hash_handle_t qd_hash_handle_t;
 
+/**
+ * Create a hash table.
+ *
+ * @param bucket_exponent The table starts with 2^bucket_exponent buckets and doubles as it fills.
+ * @param batch_size Number of buckets moved into the enlarged table per insert/remove while a
+ *        resize is in progress.
+ * @param value_is_const Non-zero if values are stored via the *_const functions.
+ */
 qd_hash_t *qd_hash(int bucket_exponent, int batch_size, int value_is_const);
 void qd_hash_free(qd_hash_t *h);
 
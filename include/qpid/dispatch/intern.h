@@ -0,0 +1,60 @@
+#ifndef __dispatch_intern_h__
+#define __dispatch_intern_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Router-wide table of interned strings.
+ *
+ * Identifiers such as router IDs, addresses and vanflow identities and attribute values are repeated in many objects.
+ * Interning keeps a single counted copy of each distinct string: two interned strings are equal exactly when their
+ * pointers are equal, and qd_intern_ref() adds a reference without hashing or locking. Only qd_intern() and the release
+ * of the last reference lock the table, which is split into shards so that unrelated strings do not contend.
+ *
+ * An interned string must not be modified or passed to free(). The /metrics HTTP endpoint reports the table as
+ * qdr_intern_strings and qdr_intern_octets.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+void qd_intern_initialize(void);
+void qd_intern_finalize(void);
+
+// Return the interned copy of 'str' with a new reference, or NULL if str is NULL
+//
+const char *qd_intern(const char *str);
+
+// As qd_intern() for the 'len' octets at 'str', which need not be null terminated
+//
+const char *qd_intern_n(const char *str, size_t len);
+
+// Add a reference to an interned string and return it. Lock free.
+//
+const char *qd_intern_ref(const char *interned);
+
+// Drop a reference, the string is freed with its last reference. interned may be NULL.
+//
+void qd_intern_release(const char *interned);
+
+// The qd_hash_bytes() value of an interned string, computed once when it was interned
+//
+uint32_t qd_intern_hash(const char *interned);
+
+#endif
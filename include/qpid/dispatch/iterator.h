@@ -44,6 +44,15 @@
  */
 typedef struct qd_iterator_t qd_iterator_t;
 
+/**
+ * Caller provided storage for an iterator that does not outlive the scope that creates it,
+ * typically a local variable.  See qd_iterator_init_string().
+ */
+#define QD_ITERATOR_STORAGE_SIZE 192
+typedef struct qd_iterator_storage_t {
+    uint64_t opaque[QD_ITERATOR_STORAGE_SIZE / sizeof(uint64_t)];
+} qd_iterator_storage_t;
+
 /**
  * Address Hash Prefix Values
  */
@@ -198,6 +207,30 @@ qd_iterator_t *qd_iterator_buffer(qd_buffer_t        *buffer,
                                   int                 length,
                                   qd_iterator_view_t  view);
 
+/**
+ * Initialize iterators in caller provided storage instead of allocating them.
+ *
+ * These are the equivalents of qd_iterator_string(), qd_iterator_buffer() and
+ * qd_iterator_dup() for iterators used within one function: hashing and comparing an
+ * address of up to eight segments with such an iterator allocates nothing.  The iterator
+ * must not be used after the storage goes out of scope and must still be released with
+ * qd_iterator_free(), which frees what the iterator allocated for itself but not the
+ * storage.
+ *
+ * @param storage Storage for the iterator
+ * @return The iterator, located in storage (NULL from qd_iterator_init_dup() if iter is NULL)
+ */
+qd_iterator_t *qd_iterator_init_string(qd_iterator_storage_t *storage,
+                                       const char            *text,
+                                       qd_iterator_view_t     view);
+qd_iterator_t *qd_iterator_init_buffer(qd_iterator_storage_t *storage,
+                                       qd_buffer_t           *buffer,
+                                       int                    offset,
+                                       int                    length,
+                                       qd_iterator_view_t     view);
+qd_iterator_t *qd_iterator_init_dup(qd_iterator_storage_t *storage,
+                                    const qd_iterator_t   *iter);
+
 /**
  * Free an allocated iterator
  *
@@ -381,7 +414,8 @@ void qd_iterator_annotate_prefix(qd_iterator_t *iter, char prefix);
 /** \name hash
  * Methods to calculate hash values for iterator views
  *
- * All hashing functions use the djb2 algorithm (http://www.cse.yorku.ca/~oz/hash.html).
+ * All hashing functions use the streaming qd_hash_state_t hash from hash.h and produce the same
+ * value as qd_hash_bytes() over the octets of the view.
  * @{
  */
 
@@ -51,6 +51,14 @@ typedef struct qd_link_t      qd_link_t;
 #define QD_QLIMIT_Q2_LOWER 32                        // Re-enable link receive
 #define QD_QLIMIT_Q2_UPPER (QD_QLIMIT_Q2_LOWER * 2)  // Disable link receive
 
+// Messages arriving on an AMQP link use that link's adaptive Q2 limit (see qd_link_q2_limit()) in place of the
+// defaults above: the upper limit doubles toward QD_QLIMIT_Q2_UPPER_MAX when the outgoing side drains the whole
+// message while input is held off, and halves toward QD_QLIMIT_Q2_UPPER_MIN when a link blocks while the router
+// memory state is QD_MEMORY_SHRINK_Q2 or worse.  The lower limit is always half the upper.
+
+#define QD_QLIMIT_Q2_UPPER_MIN 8
+#define QD_QLIMIT_Q2_UPPER_MAX 1024
+
 // Callback for status change (confirmed persistent, loaded-in-memory, etc.)
 
 typedef struct qd_message_t             qd_message_t;
@@ -244,6 +252,15 @@ bool qd_message_is_Q2_disabled_annotation(const qd_message_t *msg);
  */
 void qd_message_disable_router_annotations(qd_message_t *in_msg);
 
+/**
+ * Mark a received message for pass-through forwarding: the router only validates the sections it needs to route the
+ * message (up to the properties) and message logging does not parse the application-properties or the body.
+ *
+ * Set by the receiving link before the message is delivered to the core.
+ */
+void qd_message_set_pass_through(qd_message_t *msg);
+bool qd_message_is_pass_through(const qd_message_t *msg);
+
 /**
  * Receive message data frame by frame via a delivery.  This function may be called more than once on the same
  * delivery if the message spans multiple frames. Always returns a message. The message buffers are filled up to the point with the data that was been received so far.
@@ -277,13 +294,24 @@ bool qd_message_has_data_in_content_or_pending_buffers(qd_message_t   *msg);
  * @param msg A pointer to a message to be sent.
  * @param link The outgoing link on which to send the message.
  * @param ra_flags [in] outbound router annotations control flag
+ * @param quantum [in] stop after sending about this many octets, zero for no limit
  * @param q3_stalled [out] indicates that the link is stalled due to proton-buffer-full
+ * @return the number of octets sent
  */
 #define QD_MESSAGE_RA_STRIP_NONE    0x00  // send all router annotations
 #define QD_MESSAGE_RA_STRIP_INGRESS 0x01
 #define QD_MESSAGE_RA_STRIP_TRACE   0x02
+#define QD_MESSAGE_RA_COMPACT_TRACE 0x04  // set by qd_message_send() if the connection uses compact traces
 #define QD_MESSAGE_RA_STRIP_ALL     0xFF  // no router annotations section sent
-ssize_t qd_message_send(qd_message_t *msg, qd_link_t *link, unsigned int ra_flags, bool *q3_stalled);
+ssize_t qd_message_send(qd_message_t *msg, qd_link_t *link, unsigned int ra_flags, size_t quantum, bool *q3_stalled);
+
+/**
+ * Approximate number of octets of the message held in content buffers: the buffer count times the
+ * default buffer size.  Lock free.
+ *
+ * @param msg A pointer to the message
+ */
+size_t qd_message_buffered_octets(const qd_message_t *msg);
 
 /**
  * Check that the message is well-formed up to a certain depth.  Any part of the message that is
@@ -311,32 +339,34 @@ qd_message_depth_status_t qd_message_check_depth(const qd_message_t *msg, qd_mes
 qd_iterator_t *qd_message_field_iterator_typed(qd_message_t *msg, qd_message_field_t field);
 qd_iterator_t *qd_message_field_iterator(qd_message_t *msg, qd_message_field_t field);
 
+/**
+ * As qd_message_field_iterator() but the iterator is initialized in storage, see qd_iterator_init_string().
+ */
+qd_iterator_t *qd_message_field_iterator_init(qd_iterator_storage_t *storage, qd_message_t *msg, qd_message_field_t field);
+
 ssize_t qd_message_field_length(qd_message_t *msg, qd_message_field_t field);
 ssize_t qd_message_field_copy(qd_message_t *msg, qd_message_field_t field, char *buffer, size_t *hdr_length);
 
 /**
- * Return a pointer to the first octet of non-cutthrough body data in the message.
+ * Take the non-cutthrough body data of a stream for writing it out.
  *
- * This is intended to be used by the message-consuming end of a cut through message. The returned pointer is to the
- * data that arrived in the message prior to cut through activation. Prior to cut through activation buffers are
- * appended to the traditional content buffer queue. Once cut through has been activated new buffers are no longer
- * appended to the content buffer queue but are instead added to the cut through buffer slots. This function allows the
- * message consumer to access these initial buffers before consuming from the cut through buffer slots.  Return NULL if
- * there is no raw body buffers available.
+ * This is intended to be used by the message-consuming end of a cut through message. The raw body is the data that
+ * arrived in the message prior to cut through activation: buffers are appended to the traditional content buffer queue
+ * until cut through is activated, the consumer takes these before consuming from the cut through buffer slots with
+ * qd_message_consume_buffers().
  *
- * @param msg A pointer to a stream
- * @param buf [out] pointer to the buffer containing the first octet of the raw body (or 0)
- * @param offset [out] The offset in the buffer to the first octet of the raw body
- */
-void qd_message_get_raw_body_data(qd_message_t *msg, qd_buffer_t **buf, size_t *offset);
-
-/**
- * This is called when the raw body has been completely consumed by a cut-through consumer.
- * In this function, the function _should_ free any buffers that purely contain body content.
+ * No data is copied.  The buffers after the one the raw body starts in hold nothing else: while the stream has a
+ * single consumer they are moved out of the message and freed as they are written.  The first buffer, and all of them
+ * if the content has other consumers, are passed as shares (see qd_buffer_share()).  Once taken, the raw body can no
+ * longer be accessed through the message.
  *
  * @param msg A pointer to a stream
+ * @param buffers [out] Up to limit buffers are appended, the caller owns and frees them
+ * @param limit The maximum number of buffers to take
+ * @param complete [out] Set when the whole raw body has been taken
+ * @return The number of buffers appended to buffers
  */
-void qd_message_release_raw_body(qd_message_t *msg);
+size_t qd_message_take_raw_body(qd_message_t *msg, qd_buffer_list_t *buffers, size_t limit, bool *complete);
 
 // Create a message using composed fields to supply content.
 //
@@ -417,6 +447,33 @@ qd_parsed_field_t *qd_message_get_to_override(qd_message_t *msg);
  */
 qd_parsed_field_t *qd_message_get_trace(qd_message_t *msg);
 
+/**
+ * True if the trace annotation of the message is a compact trace (router annotations version 3), a binary of router
+ * fingerprints qd_message_get_trace() returns as a binary field.
+ */
+bool qd_message_trace_is_compact(qd_message_t *msg);
+
+/**
+ * Get the router fingerprints of the trace annotation, see qd_tracemask_fingerprint().  Trace lists are fingerprinted
+ * entry by entry.
+ *
+ * @param msg A pointer to the received message
+ * @param fingerprints (out) the first max fingerprints, ingress router first
+ * @param max Size of fingerprints
+ * @return the number of routers in the trace, which may be larger than max
+ */
+uint32_t qd_message_get_trace_fingerprints(qd_message_t *msg, uint64_t *fingerprints, uint32_t max);
+
+/**
+ * Find the router id of a compact trace entry, for display.
+ *
+ * @param fingerprint A fingerprint from qd_message_get_trace_fingerprints()
+ * @param buffer (out) the router id as it appears in a trace list, not null terminated
+ * @param size Size of buffer
+ * @return the length of the router id, 0 if the router is not known
+ */
+size_t qd_message_trace_id(uint64_t fingerprint, char *buffer, size_t size);
+
 /**
  * Accessor for ingress edge-mesh annotation
  *
@@ -541,6 +598,23 @@ void qd_message_set_aborted(qd_message_t *msg);
  */
 uint8_t qd_message_get_priority(qd_message_t *msg);
 
+/**
+ * Fix the absolute expiry of the message from the ttl field of its header, counting from the time the message
+ * entered the router.  Only the first call has an effect.
+ *
+ * @param msg A pointer to the message
+ * @param ingress_ns Monotonic time in nanoseconds at which the message was received
+ */
+void qd_message_set_expiry(qd_message_t *msg, uint64_t ingress_ns);
+
+/**
+ * True if the message has an expiry set by qd_message_set_expiry that has passed.
+ *
+ * @param msg A pointer to the message
+ * @param now_ns Current monotonic time in nanoseconds
+ */
+bool qd_message_expired(const qd_message_t *msg, uint64_t now_ns);
+
 /**
  * True if message is larger that maxMessageSize
  * @param msg A pointer to the message
@@ -555,10 +629,31 @@ bool qd_message_oversize(const qd_message_t *msg);
 // exactly one destination.
 //=====================================================================================================
 
-#define UCT_SLOT_COUNT       8
-#define UCT_RESUME_THRESHOLD 4
+#define UCT_SLOT_COUNT       8   // initial ring depth of a cut-through stream
+#define UCT_SLOT_COUNT_MAX   64  // default limit the ring depth may grow to
 #define UCT_SLOT_BUF_LIMIT   16  // per slot maximum qd_buffer_t list length
 
+/**
+ * Set the largest ring depth (in slots) that a cut-through stream may grow to.  The value is rounded up to a power of
+ * two and is never less than UCT_SLOT_COUNT.  Only affects streams started after the call.
+ *
+ * @param max_slots The maximum number of slots in a stream's ring
+ */
+void qd_message_set_cutthrough_max_slots(uint32_t max_slots);
+
+/**
+ * Router-wide cut-through ring statistics
+ */
+typedef struct {
+    uint64_t streams;          // streams that have entered cut-through mode
+    uint64_t producer_stalls;  // times a producer filled its ring
+    uint64_t ring_growths;     // times a ring depth was doubled
+    uint64_t slots_in_use;     // filled slots across all live streams
+    uint32_t max_slots;        // the configured ring depth limit
+} qd_message_cutthrough_stats_t;
+
+void qd_message_get_cutthrough_stats(qd_message_cutthrough_stats_t *stats);
+
 /**
  * Transition this message to unicast/cut-through operation.  This action cannot be reversed for a message.
  *
@@ -669,6 +764,15 @@ void qd_message_set_producer_activation(qd_message_t *stream, qd_message_activat
  */
 void qd_message_cancel_producer_activation(qd_message_t *stream);
 
+/**
+ * Check whether both ends of a cut-through stream are adaptor connections of this router: its buffers pass directly
+ * from the producing to the consuming connection and are never sent on a router link.
+ *
+ * @param stream Pointer to the message
+ * @return true if both the producer and the consumer activation are set and neither is an AMQP link
+ */
+bool qd_message_is_local_stream(qd_message_t *stream);
+
 ///@}
 
 #endif
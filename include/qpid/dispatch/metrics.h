@@ -0,0 +1,105 @@
+#ifndef __metrics_h__
+#define __metrics_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Registry of counters, gauges and histograms reported by the /metrics HTTP endpoint.
+ *
+ * A metric is registered once with a family name and an optional label, then updated from any thread using relaxed
+ * atomics: updates never take a lock. Metrics registered with the same name form a family that shares a single TYPE
+ * line and must have the same type.
+ *
+ * Histograms are log-linear: values below 4 have a bucket each, above that every power of two is split into
+ * QD_METRIC_HISTOGRAM_SUB_BUCKETS equal buckets, so the relative error of a bucket is at most 25% over the whole range.
+ * Values of 2^QD_METRIC_HISTOGRAM_MAX_EXP or more are only counted in the +Inf bucket.
+ *
+ * The registry is rendered in the Prometheus text format by qd_metrics_render(), one buffer at a time, on the thread
+ * serving the request. The registry lock is held while a buffer is rendered, so a metric must not be freed while it is
+ * being updated but may be freed at any time otherwise.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define QD_METRIC_HISTOGRAM_SUB_BUCKETS 4
+#define QD_METRIC_HISTOGRAM_MAX_EXP     40
+#define QD_METRIC_HISTOGRAM_BUCKETS     (QD_METRIC_HISTOGRAM_SUB_BUCKETS * (QD_METRIC_HISTOGRAM_MAX_EXP - 1) + 1)
+
+// Large enough for the longest histogram with a label value of up to 256 characters
+#define QD_METRICS_RENDER_MIN 65536
+
+typedef enum {
+    QD_METRIC_COUNTER,
+    QD_METRIC_GAUGE,
+    QD_METRIC_HISTOGRAM
+} qd_metric_type_t;
+
+typedef struct qd_metric_t qd_metric_t;
+
+// Position of an incremental rendering of the registry, zero it before the first call to qd_metrics_render()
+//
+typedef struct qd_metrics_cursor_t {
+    uint64_t family_id;
+    uint64_t metric_id;
+    bool     done;
+} qd_metrics_cursor_t;
+
+void qd_metrics_initialize(void);
+void qd_metrics_finalize(void);
+
+// Register a metric in family 'name'. label_name and label_value may both be NULL for a metric without a label.
+// Returns NULL if the family already exists with a different type. All the update functions ignore a NULL metric.
+//
+qd_metric_t *qd_metric(qd_metric_type_t type, const char *name, const char *label_name, const char *label_value);
+
+// Register a metric with label_count labels, label_names[i] having the value label_values[i]. The metrics of a family
+// should all have the same label names.
+//
+qd_metric_t *qd_metric_labels(qd_metric_type_t type, const char *name, int label_count,
+                              const char *const *label_names, const char *const *label_values);
+void qd_metric_free(qd_metric_t *metric);
+
+// Counters and gauges
+//
+void qd_metric_inc(qd_metric_t *metric, uint64_t amount);
+void qd_metric_dec(qd_metric_t *metric, uint64_t amount);  // gauges only
+void qd_metric_set(qd_metric_t *metric, uint64_t value);   // gauges only
+
+// Histograms
+//
+void qd_metric_observe(qd_metric_t *metric, uint64_t value);
+uint64_t qd_metric_histogram_bound(int bucket);  // largest value counted in 'bucket'
+
+// Fetch the current value of a counter or gauge, or the number of values observed by a histogram
+//
+uint64_t qd_metric_value(const qd_metric_t *metric);
+
+// Fetch the sum of the values observed by a histogram
+//
+uint64_t qd_metric_sum(const qd_metric_t *metric);
+
+// Write as many whole metrics as fit in 'buffer' starting from 'cursor' and advance the cursor past them. Returns the
+// number of octets written, which is not null terminated. cursor->done is set once the whole registry is written.
+// 'size' should be at least QD_METRICS_RENDER_MIN, a metric that does not fit an empty buffer is skipped.
+//
+size_t qd_metrics_render(qd_metrics_cursor_t *cursor, char *buffer, size_t size);
+
+#endif
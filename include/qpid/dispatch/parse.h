@@ -42,6 +42,24 @@ typedef struct qd_parsed_field_t qd_parsed_field_t;
  */
 qd_parsed_field_t *qd_parse(const qd_iterator_t *iter);
 
+/**
+ * Parse a field held in a buffer field.
+ *
+ * @param bfield holds the data to be parsed, starting at the type tag. It is not modified.
+ * @return A pointer to the newly created field.
+ */
+qd_parsed_field_t *qd_parse_buffer_field(const qd_buffer_field_t *bfield);
+
+/**
+ * Parse a field delimited by an iterator on demand.  The whole field is validated, so qd_parse_ok() gives the same
+ * result as for qd_parse(), but the children of maps and lists are only decoded when they are first visited.  Use it
+ * for large values of which the caller visits only a part, such as control-plane message bodies.
+ *
+ * @param iter holds the data to be parsed
+ * @return A pointer to the newly created field.
+ */
+qd_parsed_field_t *qd_parse_lazy(const qd_iterator_t *iter);
+
 /**
  * Free the resources associated with a parsed field.
  *
@@ -265,25 +283,34 @@ int qd_parse_is_scalar(qd_parsed_field_t *field);
  */
 qd_parsed_field_t *qd_parse_value_by_key(qd_parsed_field_t *field, const char *key);
 
+/**
+ * The entries of a router annotations section, located but not parsed.
+ *
+ * Each buffer field refers to the complete encoded entry (type header and value) within the message buffers. An
+ * optional entry that is absent (encoded as null) has no remaining octets. The entries can be copied into an outgoing
+ * section as they are, or parsed on demand with qd_parse_buffer_field().
+ */
+typedef struct qd_router_annotations_t {
+    uint32_t          flags;         // message flags
+    qd_buffer_field_t to_override;   // destination address override
+    qd_buffer_field_t ingress;       // ingress router id
+    qd_buffer_field_t trace;         // router trace list
+    qd_buffer_field_t trace_items;   // the encoded items of the trace list, without the list header
+    uint32_t          trace_count;   // number of items in the trace list
+    bool              trace_compact; // trace_items are QD_TRACE_FINGERPRINT_SIZE octet router fingerprints
+    qd_buffer_field_t ingress_mesh;  // mesh_id of the ingress edge router
+} qd_router_annotations_t;
+
 /**
  * Parse the router annotations list field.
  *
- * Return parsed fields for the four router entries or null if any are absent
+ * Validates the section and locates its entries without building parsed field trees for them.
  *
  * @param ra_field points to the encoded List data
- * @param ra_ingress returned parsed field: ingress router id
- * @param ra_to_override returned parsed field: destination address override
- * @param ra_trace returned parsed field: router trace list
- * @param ra_flags returned parsed field: message flags
+ * @param ra returned locations of the router annotation entries
  * @return 0 on success else a parse error message
  */
-const char *qd_parse_router_annotations(
-    qd_buffer_field_t  *ra_field,
-    qd_parsed_field_t **ra_ingress,
-    qd_parsed_field_t **ra_ingress_mesh,
-    qd_parsed_field_t **ra_to_override,
-    qd_parsed_field_t **ra_trace,
-    qd_parsed_field_t **ra_flags);
+const char *qd_parse_router_annotations(qd_buffer_field_t *ra_field, qd_router_annotations_t *ra);
 
 /**
  * Parse a 32 bit unsigned integer in network order to a native uint32 value.
@@ -62,4 +62,16 @@ uint64_t qd_router_virtual_memory_usage(void);
  */
 uint64_t qd_router_rss_memory_usage(void);
 
+/**
+ * Return the number of NUMA nodes on the platform (the highest possible node id plus one).  Returns 1 if the
+ * platform does not expose its NUMA topology.  Thread safe.
+ */
+int qd_platform_numa_node_count(void);
+
+/**
+ * Return the NUMA node of the CPU the calling thread is currently running on, 0 if it cannot be determined.  Unless
+ * the thread is bound to the CPUs of a single node the result may change at any time.  Thread safe.
+ */
+int qd_platform_numa_node(void);
+
 #endif
@@ -29,6 +29,12 @@ typedef struct {
     int       maxSenders;
     int       maxReceivers;
     uint64_t  maxMessageSize;
+    uint64_t  maxBytesPerSecond;               // all the connections of the user group
+    uint64_t  maxMessagesPerSecond;
+    uint64_t  maxConnectionBytesPerSecond;     // each connection of the user group
+    uint64_t  maxConnectionMessagesPerSecond;
+    uint64_t  vhostMaxBytesPerSecond;          // all the connections of the vhost
+    uint64_t  vhostMaxMessagesPerSecond;
     bool      allowDynamicSource;
     bool      allowAnonymousSender;
     bool      allowUserIdProxy;
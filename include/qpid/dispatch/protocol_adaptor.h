@@ -314,6 +314,22 @@ qdr_protocol_adaptor_t *qdr_protocol_adaptor(qdr_core_t                *core,
 void qdr_protocol_adaptor_free(qdr_core_t *core, qdr_protocol_adaptor_t *adaptor);
 
 
+/**
+ * qdr_protocol_adaptor_coalesce_activations
+ *
+ * Have the core coalesce activations of this adaptor's connections.  Once a connection has
+ * been activated the core will not invoke the activate callback for it again until the
+ * adaptor calls qdr_connection_process() for that connection.
+ *
+ * An adaptor that enables this MUST guarantee that every activation it receives is followed
+ * by a call to qdr_connection_process() for the connection (unless the connection is being
+ * closed), otherwise the connection will not be activated again.
+ *
+ * @param adaptor Pointer to a protocol adaptor object returned by qdr_protocol_adaptor
+ */
+void qdr_protocol_adaptor_coalesce_activations(qdr_protocol_adaptor_t *adaptor);
+
+
 /**
  ******************************************************************************
  * Connection functions
@@ -468,6 +484,71 @@ const char *qdr_connection_get_tenant_space(const qdr_connection_t *conn, int *l
  */
 int qdr_connection_process(qdr_connection_t *conn);
 
+/**
+ * qdr_connection_activation_pending
+ *
+ * Return true if the core has activated this connection since the last call to
+ * qdr_connection_process().  Only meaningful for adaptors that coalesce activations - see
+ * qdr_protocol_adaptor_coalesce_activations().  May be called from any thread.
+ *
+ * @param conn The pointer returned by qdr_connection_opened
+ */
+bool qdr_connection_activation_pending(qdr_connection_t *conn);
+
+/**
+ * qdr_connection_add_cpu_time
+ *
+ * Attribute time spent handling the connection's I/O events to the connection.  It is reported in the cpuMicroseconds
+ * attribute of the connection together with the core thread time spent on the connection's deliveries.  May be called
+ * from any thread.
+ *
+ * @param conn The pointer returned by qdr_connection_opened
+ * @param nsec Handler run time in nanoseconds
+ */
+void qdr_connection_add_cpu_time(qdr_connection_t *conn, uint64_t nsec);
+
+/**
+ * qdr_connection_cpu_time
+ *
+ * Return the total handler time in nanoseconds attributed to the connection so far.  May be called from any thread.
+ *
+ * @param conn The pointer returned by qdr_connection_opened
+ */
+uint64_t qdr_connection_cpu_time(const qdr_connection_t *conn);
+
+/**
+ * Octet counts and run time of the compressed deliveries of a connection, see the compression attribute of listeners
+ * and connectors.
+ */
+typedef struct qdr_compression_stats_t {
+    uint64_t plain_sent;      // octets of the compressed deliveries sent, before compression
+    uint64_t wire_sent;       //   and after
+    uint64_t wire_received;   // octets of the compressed deliveries received, before decompression
+    uint64_t plain_received;  //   and after
+    uint64_t nsec;            // compression and decompression time
+} qdr_compression_stats_t;
+
+/**
+ * qdr_connection_add_compression_stats
+ *
+ * Add compression counts accumulated by the I/O thread to the totals reported by the connection's management
+ * attributes.  May be called from any thread.
+ *
+ * @param conn The pointer returned by qdr_connection_opened
+ * @param stats Counts to add
+ */
+void qdr_connection_add_compression_stats(qdr_connection_t *conn, const qdr_compression_stats_t *stats);
+
+/**
+ * qdr_connection_compression_stats
+ *
+ * Get the compression totals of the connection.  May be called from any thread.
+ *
+ * @param conn The pointer returned by qdr_connection_opened
+ * @param stats Filled with the totals
+ */
+void qdr_connection_compression_stats(const qdr_connection_t *conn, qdr_compression_stats_t *stats);
+
 /**
  ******************************************************************************
  * Terminus functions
@@ -737,6 +818,15 @@ bool qdr_link_strip_annotations_out(const qdr_link_t *link);
  */
 void qdr_link_stalled_outbound(qdr_link_t *link);
 
+/**
+ * qdr_link_yield_outbound
+ *
+ * Tell the link, from its deliver handler, that it stopped sending a delivery after using up its
+ * transfer quantum.  The link is scheduled again after the other links of the connection that have
+ * work, so that deliveries in progress on different links are interleaved.
+ */
+void qdr_link_yield_outbound(qdr_link_t *link);
+
 /**
  * qdr_link_set_user_streaming
  *
@@ -858,6 +948,31 @@ qdr_delivery_t *qdr_link_deliver_to_core(qdr_link_t *link, qd_message_t *msg, bo
                                          uint64_t remote_disposition,
                                          qd_delivery_state_t *remote_state);
 
+/**
+ * qdr_link_deliver_batch_begin
+ *
+ * Start collecting the deliveries created on this link.  Until qdr_link_deliver_batch_flush() is
+ * called, receive-complete deliveries returned by the qdr_link_deliver functions are held on the link
+ * and then handed to the core together in a single action.  A delivery that is still arriving is
+ * passed to the core immediately, after the deliveries held before it, and collecting continues with
+ * the deliveries that follow.
+ *
+ * Both calls must be made from the I/O thread that owns the link.
+ *
+ * @param link Pointer to the incoming link.
+ */
+void qdr_link_deliver_batch_begin(qdr_link_t *link);
+
+/**
+ * qdr_link_deliver_batch_flush
+ *
+ * Hand the deliveries held since qdr_link_deliver_batch_begin() to the core, in arrival order, and
+ * stop collecting.
+ *
+ * @param link Pointer to the incoming link.
+ */
+void qdr_link_deliver_batch_flush(qdr_link_t *link);
+
 /**
  * qdr_link_process_deliveries
  *
@@ -898,6 +1013,13 @@ void qdr_link_complete_sent_message(qdr_core_t *core, qdr_link_t *link);
 
 void qdr_link_flow(qdr_core_t *core, qdr_link_t *link, int credit, bool drain_mode);
 
+/**
+ * qdr_link_flow for count links at once, posted to the core as a single action.
+ *
+ * @param links The links, credits[i] and drain_modes[i] are the flow of links[i]
+ */
+void qdr_link_flow_batch(qdr_core_t *core, qdr_link_t **links, const int *credits, const bool *drain_modes, int count);
+
 /**
  * Sets the link's drain flag to false and sets credit to core to zero.
  * The passed in link has been drained and hence no longer in drain mode.
@@ -912,8 +1034,13 @@ void qdr_link_set_drained(qdr_core_t *core, qdr_link_t *link);
  * Extract the disposition and delivery state data that is to be sent to the
  * remote endpoint via the delivery. Caller takes ownership of the returned
  * delivery_state and must free it when done.
+ *
+ * The state of the non-terminal PN_RECEIVED disposition is not returned as an
+ * object: its section number and offset are copied into *received, which is
+ * zeroed for other dispositions.  received may be NULL.
  */
-qd_delivery_state_t *qdr_delivery_take_local_delivery_state(qdr_delivery_t *dlv, uint64_t *dispo);
+qd_delivery_state_t *qdr_delivery_take_local_delivery_state(qdr_delivery_t *dlv, uint64_t *dispo,
+                                                            qd_delivery_state_t *received);
 
 
 qdr_connection_info_t *qdr_connection_info(bool             is_encrypted,
@@ -74,6 +74,32 @@ void qdpo_config_add_exception_protocol(qdpo_config_t *config, const char *proto
  */
 void qdpo_config_add_address(qdpo_config_t *config, const char *field, const char *value, const char *address);
 
+/**
+ * Observe only one connection in every interval in full. The other connections are not observed: only their octets
+ * are counted by the transport.
+ *
+ * @param config Configuration returned by qdpo_config
+ * @param interval The sampling interval, 0 or 1 observes every connection
+ */
+void qdpo_config_set_sample_interval(qdpo_config_t *config, int interval);
+
+/**
+ * Name the observer after the listener it observes. The name labels the metrics of the observer, such as the gRPC
+ * method latency histograms of the HTTP/2 observer.
+ *
+ * @param config Configuration returned by qdpo_config
+ * @param name The name of the listener, copied
+ */
+void qdpo_config_set_name(qdpo_config_t *config, const char *name);
+
+/**
+ * Limit the time spent observing across all the observers to percent of one CPU. While the limit is exceeded the
+ * sampling intervals of all the observers are scaled up for new connections, see qdpo_config_set_sample_interval().
+ *
+ * @param percent The budget in percent of one CPU, 0 for no limit
+ */
+void qdpo_set_cpu_budget(int percent);
+
 
 typedef struct qdpo_t qdpo_t;
 typedef struct qdpo_transport_handle_t qdpo_transport_handle_t;
@@ -106,6 +132,16 @@ void qdpo_free(qdpo_t *observer);
  */
 qdpo_transport_handle_t *qdpo_begin(qdpo_t *observer, vflow_record_t *vflow, void *transport_context, uint64_t conn_id);
 
+/**
+ * Indicate the application protocol negotiated by TLS for the connection (ALPN). Must be called before the first call
+ * to qdpo_data(). If the observer detects the protocol and alpn identifies a protocol that is observed ("h2",
+ * "http/1.1", "http/1.0") the observer of that protocol starts directly, without classifying the payload first.
+ *
+ * @param transport_handle The handle returned by qdpo_begin
+ * @param alpn The protocol identifier negotiated by ALPN
+ */
+void qdpo_set_alpn(qdpo_transport_handle_t *transport_handle, const char *alpn);
+
 /**
  * Provide subsequent payload data to an already established connection.
  *
@@ -117,7 +153,8 @@ qdpo_transport_handle_t *qdpo_begin(qdpo_t *observer, vflow_record_t *vflow, voi
 void qdpo_data(qdpo_transport_handle_t *transport_handle, bool from_client, const unsigned char *data, size_t length);
 
 /**
- * Indicate the end of a connection.
+ * Indicate the end of a connection. The vflow record passed to qdpo_begin is ended once the observer no longer uses
+ * it, so the caller must not end it.
  *
  * @param connection_handle The handle returned by qdpo_first.  This handle
  *                          should not be used after making this call.
@@ -126,4 +163,22 @@ void qdpo_end(qdpo_transport_handle_t *transport_handle);
 
 void qdpo_set_observer(qdpo_t *protocol_observer, qd_observer_t observer);
 
+/**
+ * Run the observers of subsequently begun connections on a pool of worker threads instead of the caller's thread.
+ *
+ * qdpo_data() then copies the payload to a queue served by the worker that owns the connection, so a connection's data
+ * is observed in order. If more than queue_octets octets are already queued the connection is no longer observed and
+ * its payload is only counted, so the caller never waits for the workers.
+ *
+ * @param threads The number of worker threads, zero keeps observing on the caller's thread
+ * @param queue_octets The limit of payload octets queued to all the workers
+ */
+void qdpo_async_start(int threads, size_t queue_octets);
+
+/**
+ * Observe the queued payload, run the final qdpo_end() calls and stop the worker threads. Must not be called while
+ * qdpo_data() or qdpo_end() may still be called for a connection begun in asynchronous mode.
+ */
+void qdpo_async_stop(void);
+
 #endif
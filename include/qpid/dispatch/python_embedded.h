@@ -96,6 +96,12 @@ qd_python_lock_state_t qd_python_lock(void);
 void qd_python_unlock(qd_python_lock_state_t state);
 void qd_python_check_lock(void);
 
+/**
+ * Release the qdr_python_gil_wait_microseconds and qdr_python_gil_hold_microseconds metrics, which stop being observed.
+ * Must be called before qd_metrics_finalize().
+ */
+void qd_python_free_metrics(void);
+
 /** Convert a Python string type to a C string.  The resulting string may be
  * UTF-8 encoded.  Caller must free returned string buffer.  Returns NULL on
  * failure
@@ -43,7 +43,8 @@ typedef enum {
     QD_TREATMENT_MULTICAST_ONCE   = 1,
     QD_TREATMENT_ANYCAST_CLOSEST  = 2,
     QD_TREATMENT_ANYCAST_BALANCED = 3,
-    QD_TREATMENT_UNAVAILABLE      = 4
+    QD_TREATMENT_UNAVAILABLE      = 4,
+    QD_TREATMENT_ANYCAST_AFFINITY = 5   ///< after UNAVAILABLE, treatment values are exchanged by mobile-address sync
 } qd_address_treatment_t;
 
 #include "qpid/dispatch/router_core.h"
@@ -56,6 +56,22 @@ qdr_core_t *qdr_core(qd_dispatch_t *qd, qd_router_mode_t mode, const char *area,
  */
 void qdr_core_free(qdr_core_t *core);
 
+/**
+ * Start batching core actions on the calling thread.
+ *
+ * Until qdr_action_batch_flush() is called, actions enqueued by this thread are
+ * staged in a thread-local list rather than posted to the core one at a time.
+ * The I/O threads use this to publish all actions generated while processing
+ * one proactor event batch with a single enqueue.
+ */
+void qdr_action_batch_begin(void);
+
+/**
+ * Stop batching on the calling thread and post all staged actions to the core,
+ * preserving the order in which they were enqueued.
+ */
+void qdr_action_batch_flush(void);
+
 /**
  ******************************************************************************
  * Miscellaneous functions
@@ -82,6 +98,35 @@ void qdr_process_tick(qdr_core_t *core);
  */
 const char *qdr_core_van_id(const qdr_core_t *core);
 
+/**
+ * Work refused because the router is overloaded, see qdr_core_overload_refused().
+ */
+typedef enum {
+    QDR_OVERLOAD_REFUSED_CONNECTION,
+    QDR_OVERLOAD_REFUSED_LINK,
+    QDR_OVERLOAD_REFUSED_COUNT
+} qdr_overload_refused_t;
+
+/**
+ * @brief True while the router core or the I/O threads are overloaded.
+ *
+ * The router is overloaded while the core takes longer than overloadQueueDelayMilliseconds to run an action after it
+ * was enqueued, or the I/O threads run timers later than overloadEventLoopLagMilliseconds.  Adaptors refuse new
+ * client connections and links while it is, established connections and links are not affected.  Always false when
+ * neither limit is configured.  Thread safe.
+ *
+ * @param core Pointer to the core object returned by qdr_core()
+ */
+bool qdr_core_overloaded(qdr_core_t *core);
+
+/**
+ * @brief Count a connection or link refused by an adaptor because the router is overloaded.
+ *
+ * @param core Pointer to the core object returned by qdr_core()
+ * @param refused What was refused
+ */
+void qdr_core_overload_refused(qdr_core_t *core, qdr_overload_refused_t refused);
+
 
 /**
  ******************************************************************************
@@ -274,6 +319,7 @@ typedef enum {
     QD_ROUTER_ROUTER_METRICS,
     QD_ROUTER_LINK,
     QD_ROUTER_ADDRESS,
+    QD_ROUTER_ALLOCATOR,
     QD_ROUTER_FORBIDDEN
 } qd_router_entity_type_t;
 
@@ -357,17 +403,19 @@ void qdr_manage_update(qdr_core_t *core, void *context, qd_router_entity_type_t
  * 4) Start the body map, add the "attributeNames" key
  * 5) Call qdr_query_add_attribute_names.  This will add the attribute names list
  * 6) Add the "results" key, start the outer list
- * 7) Call qdr_query_get_first.  This will asynchronously add the first inner list.
+ * 7) Call qdr_query_get_first with the requested count.  This will asynchronously add the first inner lists,
+ *    as many as the core writes in one pass.
  * 8) When the qdr_manage_response_t callback is invoked:
- *    a) if more is true and count is not exceeded, call qdr_query_get_next
- *    b) if more is false or count is exceeded, call qdr_query_free, close the outer list, close the map
+ *    a) if more is true, call qdr_query_get_next
+ *    b) if more is false (no more entities or count reached), close the outer list, close the map.  The core
+ *       frees the query.
  */
 
 qdr_query_t *qdr_manage_query(qdr_core_t *core, void *context, qd_router_entity_type_t type,
                               qd_parsed_field_t *attribute_names, qd_composed_field_t *body,
                               uint64_t in_conn);
 void qdr_query_add_attribute_names(qdr_query_t *query);
-void qdr_query_get_first(qdr_query_t *query, int offset);
+void qdr_query_get_first(qdr_query_t *query, int offset, int count);  // count <= 0 for all entities
 void qdr_query_get_next(qdr_query_t *query);
 void qdr_query_free(qdr_query_t *query);
 
@@ -398,6 +446,63 @@ typedef struct {
     (!QDR_ROUTER_VERSION_AT_LEAST(V, MAJOR, MINOR, PATCH))
 
 
+/**
+ * Core action statistics
+ *
+ * The core thread keeps per-action-type accounting of how long each action handler runs, how long actions waited
+ * between being enqueued and being run, and a log2 histogram of handler run times.  Action types are identified by the
+ * label passed to qdr_action().
+ *
+ * Histogram bucket N counts handler runs that took less than 2^N microseconds.  The last bucket counts everything
+ * slower than that.
+ */
+#define QDR_ACTION_STATS_MAX         96
+#define QDR_ACTION_HISTOGRAM_BUCKETS 16
+
+typedef struct {
+    const char *label;
+    uint64_t    count;
+    uint64_t    total_ns;              /// sum of handler run times
+    uint64_t    max_ns;                /// longest handler run time
+    uint64_t    queue_delay_total_ns;  /// sum of enqueue-to-execute delays
+    uint64_t    queue_delay_max_ns;    /// longest enqueue-to-execute delay
+    uint64_t    histogram[QDR_ACTION_HISTOGRAM_BUCKETS];
+} qdr_action_stats_t;
+
+
+/**
+ * Core action classes
+ *
+ * Foreground actions are run as soon as the core thread takes them.  Background actions are housekeeping work run by
+ * the core's background scheduler in the time left over from, or set aside alongside, foreground work.  Control
+ * actions carry routing-protocol and management traffic and are run ahead of all other actions, between any two of
+ * them.
+ */
+typedef enum {
+    QDR_ACTION_CLASS_FOREGROUND,
+    QDR_ACTION_CLASS_BACKGROUND,
+    QDR_ACTION_CLASS_CONTROL,
+    QDR_ACTION_CLASS_COUNT
+} qdr_action_class_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t wait_total_ns;  /// sum of enqueue-to-execute delays
+    uint64_t wait_max_ns;    /// longest enqueue-to-execute delay
+} qdr_action_class_stats_t;
+
+/**
+ * Delivery statistics for one message priority lane of the outgoing links on a connection.
+ * The queue delay runs from when a delivery is forwarded onto a link until it has all been
+ * written to the link.
+ */
+typedef struct {
+    uint64_t deliveries;
+    uint64_t queue_delay_total_ns;
+    uint64_t queue_delay_max_ns;
+} qdr_priority_lane_stats_t;
+
+
 typedef struct {
     size_t connections;
     size_t links;
@@ -420,6 +525,12 @@ typedef struct {
     size_t deliveries_stuck;
     size_t links_blocked;
     size_t deliveries_redirected_to_fallback;
+    size_t action_batches;         /// number of action lists taken by the core thread
+    size_t action_depth_max;       /// longest action list taken by the core thread
+    qdr_action_class_stats_t action_class_stats[QDR_ACTION_CLASS_COUNT];
+    size_t action_stats_count;
+    qdr_action_stats_t action_stats[QDR_ACTION_STATS_MAX];
+    qdr_priority_lane_stats_t priority_lane_stats[QDR_N_PRIORITIES];  /// inter-router links only
 }  qdr_global_stats_t;
 ALLOC_DECLARE(qdr_global_stats_t);
 
@@ -431,4 +542,25 @@ typedef void (*qdr_global_stats_handler_t) (void *context, bool discard);
 void qdr_request_global_stats(qdr_core_t *core, qdr_global_stats_t *stats, qdr_global_stats_handler_t callback, void *context);
 
 
+/**
+ * Statistics snapshot: the numeric counters of every open connection or link, copied by the core thread in a single
+ * action so that all rows describe the same instant. The core thread only copies the counters, the handler encodes
+ * them with qdr_stats_snapshot_encode() on a worker thread. See docs/notes/stats-snapshot.md for the encoding.
+ */
+typedef struct qdr_stats_snapshot_t qdr_stats_snapshot_t;
+
+// The handler owns the snapshot and must release it with qdr_stats_snapshot_free(). snapshot is null if entity_type is
+// not QD_ROUTER_CONNECTION or QD_ROUTER_LINK, or if discard is true (see qdr_global_stats_handler_t).
+typedef void (*qdr_stats_snapshot_handler_t) (void *context, qdr_stats_snapshot_t *snapshot, bool discard);
+void qdr_request_stats_snapshot(qdr_core_t *core, qd_router_entity_type_t entity_type,
+                                qdr_stats_snapshot_handler_t handler, void *context);
+
+size_t qdr_stats_snapshot_rows(const qdr_stats_snapshot_t *snapshot);
+
+// Return the binary encoding of the snapshot in a new buffer that the caller must free(). Its size is set in *length.
+uint8_t *qdr_stats_snapshot_encode(const qdr_stats_snapshot_t *snapshot, size_t *length);
+
+void qdr_stats_snapshot_free(qdr_stats_snapshot_t *snapshot);
+
+
 #endif
@@ -111,6 +111,14 @@ pn_proactor_t *qd_server_proactor(const qd_server_t *qd_server);
 qd_http_server_t *qd_server_http(const qd_server_t *qd_server);
 uint64_t qd_server_allocate_connection_id(qd_server_t *server);
 
+/**
+ * The number of worker threads processing events, between workerThreads and workerThreadsMax, and the share of
+ * their time the workers spent handling events over the last sample (percent, only sampled while the pool adapts).
+ * May be called from any thread.
+ */
+int qd_server_worker_threads(const qd_server_t *qd_server);
+int qd_server_worker_utilization(const qd_server_t *qd_server);
+
 /**
  * Callback handler and context for proactor events
  */
@@ -123,7 +131,12 @@ typedef struct qd_handler_context_t {
 
 
 const char *qd_server_get_container_name(const qd_server_t *server);
-sys_mutex_t *qd_server_get_activation_lock(qd_server_t *server);
+
+/**
+ * The lock that serializes the activation of a connection from other threads with the clearing of its context when it
+ * closes.  The locks are sharded by connection id so activations of unrelated connections rarely contend.
+ */
+sys_mutex_t *qd_server_get_activation_lock(qd_server_t *server, uint64_t connection_id);
 
 /**
  * @}
@@ -0,0 +1,78 @@
+#ifndef __sharded_counter_h__
+#define __sharded_counter_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Statistics counters for the hot path.
+ *
+ * A sharded counter keeps a cache line sized slot per shard and each thread adds to its own shard with a relaxed atomic, so
+ * counting from many I/O threads does not bounce a shared cache line between cores.  Reading sums the shards: it is
+ * exact once the updates have stopped and otherwise off by no more than the updates in flight.  A counter may go
+ * down as well as up, the shards are summed modulo 2^64.
+ *
+ * A counter costs QD_SHARDED_COUNTER_SHARDS * 64 octets, use it for router-wide and per-listener statistics, not for
+ * per-connection or per-link ones.  A zero-filled counter is a valid zero counter.
+ */
+
+#include "qpid/dispatch/atomic.h"
+
+#include <stdint.h>
+
+#define QD_SHARDED_COUNTER_SHARDS 16
+
+// Padded rather than aligned to a cache line so that counters can be embedded in objects from the allocation pools
+typedef struct qd_sharded_counter_shard_t {
+    atomic_uint_least64_t value;
+    char                  pad[64 - sizeof(atomic_uint_least64_t)];
+} qd_sharded_counter_shard_t;
+
+typedef struct qd_sharded_counter_t {
+    qd_sharded_counter_shard_t shards[QD_SHARDED_COUNTER_SHARDS];
+} qd_sharded_counter_t;
+
+extern __thread int qd_sharded_counter_thread_shard;
+
+/**
+ * Pick the calling thread's shard, done once per thread.
+ */
+int qd_sharded_counter_assign_shard(void);
+
+static inline int qd_sharded_counter_shard(void)
+{
+    int shard = qd_sharded_counter_thread_shard;
+    return shard >= 0 ? shard : qd_sharded_counter_assign_shard();
+}
+
+static inline void qd_sharded_counter_add(qd_sharded_counter_t *counter, uint64_t amount)
+{
+    atomic_fetch_add_explicit(&counter->shards[qd_sharded_counter_shard()].value, amount, memory_order_relaxed);
+}
+
+static inline void qd_sharded_counter_sub(qd_sharded_counter_t *counter, uint64_t amount)
+{
+    atomic_fetch_sub_explicit(&counter->shards[qd_sharded_counter_shard()].value, amount, memory_order_relaxed);
+}
+
+/**
+ * The sum of all the shards
+ */
+uint64_t qd_sharded_counter_value(const qd_sharded_counter_t *counter);
+
+#endif
@@ -25,19 +25,58 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "qpid/dispatch/internal/thread_annotations.h"
 
+typedef struct sys_lock_class_t sys_lock_class_t;
+
 typedef struct sys_mutex_t TA_CAP("mutex") sys_mutex_t;
 struct sys_mutex_t {
-    pthread_mutex_t mutex;
+    pthread_mutex_t   mutex;
+    sys_lock_class_t *lock_class;  // for contention profiling, NULL unless initialized by sys_mutex_init_named()
 };
 
 void sys_mutex_init(sys_mutex_t *mutex);
+void sys_mutex_init_class(sys_mutex_t *mutex, sys_lock_class_t **class_ref, const char *class_name);
 void sys_mutex_free(sys_mutex_t *mutex);
 void sys_mutex_lock(sys_mutex_t *mutex) TA_ACQ(*mutex);
 void sys_mutex_unlock(sys_mutex_t *mutex) TA_REL(*mutex);
 
+// Lock contention profiling. Once enabled, sys_mutex_lock() on a named mutex first tries the lock and, if that fails,
+// accounts for the time spent waiting against the mutex's lock class. All the mutexes initialized with the same class
+// name share one class. Unnamed mutexes are never profiled.
+//
+// sys_mutex_init_named() looks the class up once per call site and caches it, so a mutex initialized for every message
+// or connection costs no more than sys_mutex_init(). class_name must be a string constant.
+//
+#define sys_mutex_init_named(mutex, class_name)                             \
+    do {                                                                    \
+        static sys_lock_class_t *sys_lock_class_ref_;                       \
+        sys_mutex_init_class((mutex), &sys_lock_class_ref_, (class_name));  \
+    } while (0)
+
+#define SYS_LOCK_CLASS_MAX         32
+#define SYS_LOCK_HISTOGRAM_BUCKETS 24
+
+typedef struct sys_lock_stats_t {
+    const char *name;
+    uint64_t    acquisitions;   // profiled acquisitions
+    uint64_t    contended;      // profiled acquisitions that had to wait
+    uint64_t    wait_total_ns;
+    uint64_t    wait_max_ns;
+    uint64_t    histogram[SYS_LOCK_HISTOGRAM_BUCKETS];  // bucket N counts waits of less than 2^N usec, the last the rest
+} sys_lock_stats_t;
+
+void sys_lock_profiling_enable(void);   // call at startup
+void sys_lock_profiling_disable(void);  // for the unit tests, the statistics gathered so far are kept
+bool sys_lock_profiling_enabled(void);
+
+// Fetch the statistics of up to 'max' lock classes into 'stats', returns the number of classes fetched
+//
+int sys_lock_stats(sys_lock_stats_t *stats, int max);
+
 typedef struct sys_cond_t TA_CAP("cond") sys_cond_t;
 struct sys_cond_t {
     pthread_cond_t cond;
@@ -67,6 +106,9 @@ typedef enum {
     SYS_THREAD_PROACTOR,
     SYS_THREAD_VFLOW,
     SYS_THREAD_LWS_HTTP,
+    SYS_THREAD_LOG,
+    SYS_THREAD_OBSERVER,
+    SYS_THREAD_RESOLVER,
     // add new thread roles here and update _thread_names in threading.c
     SYS_THREAD_ROLE_COUNT
 } sys_thread_role_t;
@@ -129,6 +171,21 @@ void          sys_thread_free(sys_thread_t *thread);
 void          sys_thread_join(sys_thread_t *thread);
 sys_thread_t *sys_thread_self(void);
 
+// Thread placement: threads of the given role created after the call are bound to a set of CPUs. Must be configured
+// before the threads are started, it is not thread safe.
+//
+// sys_thread_set_role_cpus takes a Linux cpulist string ("0-3,8"), 0 or "" removes the binding.
+// sys_thread_set_role_node binds to the CPUs of a NUMA node.
+// Both return 0 on success, -1 if the cpulist or node is not valid on this platform. CPUs outside of the process's
+// allowed set are ignored.
+int sys_thread_set_role_cpus(sys_thread_role_t role, const char *cpu_list);
+int sys_thread_set_role_node(sys_thread_role_t role, int node);
+
+// Reserve the CPUs of a bound role: remove them from the CPU sets of all other roles, unbound roles (and the calling
+// thread) are bound to the remaining allowed CPUs. Returns -1 if the role is not bound or no CPU would remain for the
+// other roles.
+int sys_thread_isolate_role(sys_thread_role_t role);
+
 // these functions will use the current thread if passed 0:
 const char       *sys_thread_name(const sys_thread_t *);
 sys_thread_role_t sys_thread_role(const sys_thread_t *);
@@ -174,5 +231,6 @@ void _sys_thread_proactor_check_listener(const struct pn_listener_t *, const cha
 // for unit testing only:
 //
 char *test_threading_roles_names(void *context);
+char *test_threading_role_cpus(void *context);
 
 #endif  // __sys_threading_h__
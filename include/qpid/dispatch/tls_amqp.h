@@ -51,5 +51,16 @@ qd_tls_session_t *qd_tls_session_amqp(qd_tls_config_t *config, pn_transport_t *t
  */
 char *qd_tls_session_get_user_id(qd_tls_session_t *session);
 
+
+/**
+ * Count the outcome of the TLS handshake of a client session in the session resumption statistics of its sslProfile.
+ *
+ * Call once the handshake has completed, e.g. when the connection has opened. Has no effect if the handshake is not
+ * complete, the session is not a resumable client session or its handshake has already been counted.
+ *
+ * @param session the TLS session
+ */
+void qd_tls_session_record_handshake(qd_tls_session_t *session);
+
 #endif
 
@@ -95,4 +95,58 @@ void qd_tracemask_remove_link(qd_tracemask_t *tm, int router_maskbit);
  */
 qd_bitmask_t *qd_tracemask_create(qd_tracemask_t *tm, qd_parsed_field_t *tracelist, int *ingress_index);
 
+/**
+ * qd_tracemask_fingerprint
+ *
+ * The fingerprint of a router in a compact trace (router annotations version 3): the 64-bit
+ * FNV-1a hash of the router's trace list entry, "<area>/<router-id>".  The entry of an unknown router made by
+ * qd_tracemask_unknown_trace_id() is mapped back to its fingerprint.
+ *
+ * @param trace_id The trace list entry of the router, not null terminated
+ * @param len Length of trace_id
+ */
+uint64_t qd_tracemask_fingerprint(const char *trace_id, size_t len);
+
+/**
+ * qd_tracemask_create_compact
+ *
+ * Like qd_tracemask_create() for a compact trace.
+ *
+ * @param tm Tracemask created by qd_tracemask()
+ * @param fingerprints The router fingerprints of the trace, ingress router first
+ * @param count Number of fingerprints
+ * @param ingress_index (out) The mask-bit for the first router in the trace (the ingress router)
+ * @return A new bit mask with a set-bit for each neighbor router in the trace, to be freed by the caller.
+ */
+qd_bitmask_t *qd_tracemask_create_compact(qd_tracemask_t *tm, const uint64_t *fingerprints, uint32_t count,
+                                          int *ingress_index);
+
+/**
+ * qd_tracemask_trace_id
+ *
+ * Find the trace list entry of a known router from its fingerprint.
+ *
+ * @param tm Tracemask created by qd_tracemask()
+ * @param fingerprint The router fingerprint from a compact trace
+ * @param buffer (out) The trace list entry, not null terminated
+ * @param size Size of buffer
+ * @return Length of the entry, 0 if the router is unknown or the entry does not fit
+ */
+size_t qd_tracemask_trace_id(qd_tracemask_t *tm, uint64_t fingerprint, char *buffer, size_t size);
+
+/**
+ * qd_tracemask_unknown_trace_id
+ *
+ * The trace list entry standing for a router that is not known, so a compact trace keeps all of its hops when it is
+ * passed through a trace list: "#" followed by the fingerprint in QD_TRACE_UNKNOWN_ID_LEN - 1 hex digits.  Trace list
+ * entries of routers start with the area and never take this form.
+ *
+ * @param fingerprint The router fingerprint from a compact trace
+ * @param buffer (out) The trace list entry, not null terminated
+ * @param size Size of buffer
+ * @return Length of the entry, 0 if it does not fit
+ */
+#define QD_TRACE_UNKNOWN_ID_LEN 17
+size_t qd_tracemask_unknown_trace_id(uint64_t fingerprint, char *buffer, size_t size);
+
 #endif
@@ -23,6 +23,7 @@
 #include "proton/codec.h"
 #include "qpid/dispatch/message.h"
 #include "qpid/dispatch/iterator.h"
+#include "qpid/dispatch/atomic.h"
 
 typedef struct vflow_record_t vflow_record_t;
 
@@ -143,6 +144,13 @@ typedef enum vflow_attribute {
 
     VFLOW_ATTRIBUTE_ERROR_LISTENER_SIDE  = 64,  // String
     VFLOW_ATTRIBUTE_ERROR_CONNECTOR_SIDE = 65,  // String
+    VFLOW_ATTRIBUTE_WINDOW_RTT           = 66,  // uint          Smoothed round-trip of TCP window updates in usec
+    VFLOW_ATTRIBUTE_CONNECT_LATENCY      = 67,  // uint          Time in usec to connect to the server
+    VFLOW_ATTRIBUTE_FLOWS_UNRECORDED     = 68,  // uint/counter  Child flows not recorded by sampling or shedding
+    VFLOW_ATTRIBUTE_CPU_TIME             = 69,  // uint          Router CPU time in usec spent handling the connection
+    VFLOW_ATTRIBUTE_OBSERVER_SAMPLING    = 70,  // uint          Protocol observation sampling interval in effect for the flow
+    VFLOW_ATTRIBUTE_GRPC_METHOD          = 71,  // String        gRPC method of the request (the :path of the call)
+    VFLOW_ATTRIBUTE_GRPC_STATUS          = 72,  // uint          grpc-status of the call
 } vflow_attribute_t;
 // clang-format on
 
@@ -156,6 +164,23 @@ typedef enum vflow_log_severity {
     VFLOW_LOG_SEVERITY_CRITICAL = 4   // catastrophic loss of routing service
 } vflow_log_severity_t;
 
+/**
+ * vflow_batch_begin
+ *
+ * Start batching protocol-log work on the calling thread. Until vflow_batch_flush is called,
+ * updates made by this thread are staged locally rather than posted to the vflow thread one at
+ * a time, and repeated counter updates to the same record attribute are merged.
+ */
+void vflow_batch_begin(void);
+
+/**
+ * vflow_batch_flush
+ *
+ * Stop batching on the calling thread and post the staged work to the vflow thread, preserving
+ * the order in which it was made.
+ */
+void vflow_batch_flush(void);
+
 /**
  * vflow_start_record
  * 
@@ -168,6 +193,57 @@ typedef enum vflow_log_severity {
  */
 vflow_record_t *vflow_start_record(vflow_record_type_t record_type, vflow_record_t *parent);
 
+/**
+ * Sampling policy for detailed flow records.
+ *
+ * A flow that is sampled out gets no record: vflow_start_sampled_record returns NULL, which
+ * every vflow function ignores. Aggregate counters kept on the parent records (such as the
+ * flow count of a listener) remain exact, and the parent's VFLOW_ATTRIBUTE_FLOWS_UNRECORDED
+ * counter lets a collector scale the recorded flows up to the total.
+ */
+typedef struct vflow_sampler_t {
+    uint32_t     interval;      ///< Record one flow in every interval, 0 or 1 records every flow
+    uint32_t     rate_max;      ///< Maximum flows recorded per second, 0 for no limit
+    sys_atomic_t seen;          ///< Flows offered to the sampler
+    sys_atomic_t window_sec;    ///< Second of the current rate window
+    sys_atomic_t window_count;  ///< Flows recorded in the current rate window
+    sys_atomic_t unrecorded;    ///< Flows not recorded
+} vflow_sampler_t;
+
+/**
+ * vflow_sampler_init
+ *
+ * Initialize a sampler.  A negative interval or rate_max takes the router-wide value for the
+ * record type (see vflow_set_sampling).
+ *
+ * @param sampler The sampler to initialize
+ * @param record_type The type of record the sampler is used for
+ * @param interval Record one flow in every interval, 0 or 1 records every flow
+ * @param rate_max Maximum flows recorded per second, 0 for no limit
+ */
+void vflow_sampler_init(vflow_sampler_t *sampler, vflow_record_type_t record_type, int interval, int rate_max);
+
+/**
+ * vflow_set_sampling
+ *
+ * Set the router-wide sampling policy for a flow record type (VFLOW_RECORD_BIFLOW_TPORT or
+ * VFLOW_RECORD_BIFLOW_APP).
+ */
+void vflow_set_sampling(vflow_record_type_t record_type, uint32_t interval, uint32_t rate_max);
+
+/**
+ * vflow_start_sampled_record
+ *
+ * Open a new flow record subject to sampling.  New records are also shed while the vflow thread
+ * is far behind on its work.  A flow that is not recorded is counted on the parent record.
+ *
+ * @param record_type VFLOW_RECORD_BIFLOW_TPORT or VFLOW_RECORD_BIFLOW_APP
+ * @param parent Pointer to the parent record.  If NULL (the parent was not recorded), no record is opened.
+ * @param sampler The sampler to use, or NULL for the router-wide policy of the record type
+ * @return Pointer to the new record, or NULL if the flow is not recorded
+ */
+vflow_record_t *vflow_start_sampled_record(vflow_record_type_t record_type, vflow_record_t *parent, vflow_sampler_t *sampler);
+
 /**
  * vflow_start_co_record
  *
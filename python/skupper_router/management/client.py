@@ -392,5 +392,15 @@ class Node:
     def get_log(self, limit=None, type=None):
         return self.call(self.node_request(operation="GET-LOG", entityType=type, limit=limit)).body
 
+    def get_flight_recorder(self, limit=None):
+        return self.call(self.node_request(operation="GET-FLIGHT-RECORDER", limit=limit)).body
+
+    def apply_config(self, entities, entity_types=None):
+        """Make the entities of entity_types (default: the types in entities) match entities"""
+        body = {'entities': entities}
+        if entity_types:
+            body['entityTypes'] = entity_types
+        return self.call(self.node_request(operation="APPLY-CONFIG", body=body)).body
+
     def get_schema(self, type=None):
         return self.call(self.node_request(operation="GET-SCHEMA")).body
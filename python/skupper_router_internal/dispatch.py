@@ -138,6 +138,7 @@ class QdDll(PyDLL):
         self._prototype(self.qd_dispatch_policy_host_pattern_add, c_bool, [self.qd_dispatch_p, py_object])
         self._prototype(self.qd_dispatch_policy_host_pattern_remove, None, [self.qd_dispatch_p, py_object])
         self._prototype(self.qd_dispatch_policy_host_pattern_lookup, c_char_p, [self.qd_dispatch_p, py_object])
+        self._prototype(self.qd_dispatch_policy_settings_cache_flush, None, [self.qd_dispatch_p])
 
         # General router.
         self._prototype(self.qd_dispatch_set_agent, None, [self.qd_dispatch_p, py_object])
@@ -148,6 +149,7 @@ class QdDll(PyDLL):
         self._prototype(self.qd_entity_refresh_begin, c_long, [py_object])
         self._prototype(self.qd_entity_refresh_end, None, [])
         self._prototype(self.qd_log_recent_py, py_object, [c_long])
+        self._prototype(self.qd_flight_recorder_py, py_object, [c_long])
 
     def _prototype(self, f, restype, argtypes, check=True):
         """Set up the return and argument types and the error checker for a
@@ -64,12 +64,10 @@ data that may be updated in other threads.
 
 import traceback
 import json
-import pstats
 import socket
 import unicodedata
 from traceback import format_exc
 from threading import Lock
-from cProfile import Profile
 from io import StringIO
 
 from ctypes import c_void_p, py_object, c_long
@@ -79,7 +77,7 @@ from skupper_router.management.entity import camelcase
 from skupper_router.management.error import ManagementError, OK, CREATED, NO_CONTENT, STATUS_TEXT, \
     BadRequestStatus, InternalServerErrorStatus, NotImplementedStatus, NotFoundStatus
 from ..dispatch import IoAdapter, LogAdapter, LOG_INFO, LOG_DEBUG, LOG_ERROR, TREATMENT_ANYCAST_CLOSEST
-from .schema import ValidationError, SchemaEntity, EntityType
+from .schema import ValidationError, SchemaEntity, EntityType, EntityIndex
 from .qdrouter import QdSchema
 from ..router.message import Message
 from ..router.address import Address
@@ -587,6 +585,7 @@ class EntityCache:
         self.agent = agent
         self.qd = self.agent.qd
         self.schema = agent.schema
+        self.index = EntityIndex(self.schema)
         self.log = self.agent.log
 
     def map_filter(self, function, test):
@@ -608,8 +607,17 @@ class EntityCache:
             return list(map(function, filter(lambda e: e.entity_type.is_a(type),
                                              self.entities)))
 
+    def find(self, name, value):
+        """Entities with attribute name equal to value"""
+        def test(e): return e.attributes.get(name) == value
+        if name in self.index.unique_attributes:
+            found = [e for e in self.index.find(name, value) if test(e)]
+            if found:
+                return found
+        return self.map_filter(None, test)
+
     def validate_add(self, entity):
-        self.schema.validate_add(entity, self.entities)
+        self.schema.validate_add(entity, self.index)
 
     def add(self, entity):
         """Add an entity to the agent"""
@@ -618,6 +626,7 @@ class EntityCache:
         # Validate in the context of the existing entities for uniqueness
         self.validate_add(entity)
         self.entities.append(entity)
+        self.index.add(entity)
 
     def _add_implementation(self, implementation, adapter=None):
         """Create an adapter to wrap the implementation object and add it"""
@@ -635,6 +644,7 @@ class EntityCache:
     def _remove(self, entity):
         try:
             self.entities.remove(entity)
+            self.index.remove(entity)
             self.log(LOG_DEBUG, "Remove %s entity: %s" %
                      (entity.entity_type.short_name, entity.attributes['identity']))
         except ValueError:
@@ -780,6 +790,66 @@ class ManagementEntity(EntityAdapter):
             value = int(value)
         return value
 
+    def apply_config(self, request):
+        """Make the entities of the managed types match the desired set in the request body"""
+        body = request.body
+        if not isinstance(body, dict) or not isinstance(body.get('entities', []), list):
+            raise BadRequestStatus("APPLY-CONFIG body must be a map with a list of 'entities'")
+
+        types = set(self._schema.entity_type(t).name for t in body.get('entityTypes') or [])
+        desired = {}        # name: attributes as they would be passed to CREATE
+        validated = {}      # name: attributes with defaults filled in, to compare with existing entities
+        for attributes in body.get('entities', []):
+            attributes = dict(attributes)
+            name = attributes.get('name')
+            if not attributes.get('type') or not name:
+                raise BadRequestStatus("APPLY-CONFIG entity must have a type and a name: %s" % attributes)
+            if name in desired:
+                raise BadRequestStatus("APPLY-CONFIG duplicate entity name '%s'" % name)
+            entity_type = self._schema.entity_type(attributes['type'])
+            attributes['type'] = entity_type.name
+            entity_type.create_check(attributes)
+            desired[name] = attributes
+            validated[name] = entity_type.validate(dict(attributes))
+            types.add(entity_type.name)
+
+        for t in types:
+            entity_type = self._schema.entity_type(t)
+            if entity_type.singleton or not {'CREATE', 'DELETE'} <= set(entity_type.operations):
+                raise BadRequestStatus("APPLY-CONFIG cannot manage entity type '%s'" % entity_type.short_name)
+
+        current = {}
+        for t in types:
+            for entity in self._agent.entities.map_type(None, t):
+                current[entity.name] = entity
+        for name in desired:
+            if name not in current and self._agent.entities.find('name', name):
+                raise BadRequestStatus("APPLY-CONFIG entity '%s' clashes with an entity of an unmanaged type" % name)
+
+        def changed(entity, attributes):
+            if entity.type != attributes['type']:
+                return True
+            return any(entity.attributes.get(a.name) != attributes.get(a.name)
+                       for a in entity.entity_type.attributes.values()
+                       if a.create and a.name not in ('name', 'identity'))
+
+        # Delete first, so that a changed listener can bind its port again
+        deleted = [name for name, entity in current.items()
+                   if name not in desired or changed(entity, validated[name])]
+        for name in deleted:
+            entity = current[name]
+            entity._delete()
+            self._agent.remove(entity)
+        replaced = set(deleted)
+        created = [name for name in desired if name not in current or name in replaced]
+        for name in created:
+            self._agent._create(desired[name])
+
+        unchanged = len(current) - len(deleted)
+        self._log(LOG_INFO, "Applied configuration: %d deleted, %d created, %d unchanged" %
+                  (len(deleted), len(created), unchanged))
+        return (OK, {'deleted': deleted, 'created': created, 'unchanged': unchanged})
+
     def get_json_schema(self, request):
         return (OK, json.dumps(self._schema.dump(), indent=self._intprop(request, "indent")))
 
@@ -787,11 +857,16 @@ class ManagementEntity(EntityAdapter):
         logs = self._qd.qd_log_recent_py(self._intprop(request, "limit") or -1)
         return (OK, logs)
 
+    def get_flight_recorder(self, request):
+        limit = self._intprop(request, "limit")
+        return (OK, self._qd.qd_flight_recorder_py(-1 if limit is None else limit))
+
     def profile(self, request):
         """Start/stop the python profiler, returns profile results"""
         profile = self.__dict__.get("_profile")
         if "start" in request.properties:
             if not profile:
+                from cProfile import Profile  # only needed when profiling, keep it off the startup path
                 profile = self.__dict__["_profile"] = Profile()
             profile.enable()
             self._log(LOG_INFO, "Started python profiler")
@@ -802,6 +877,7 @@ class ManagementEntity(EntityAdapter):
             profile.create_stats()
             self._log(LOG_INFO, "Stopped python profiler")
             out = StringIO()
+            import pstats
             stats = pstats.Stats(profile, stream=out)
             try:
                 stop = request.properties["stop"]
@@ -822,10 +898,10 @@ class ManagementEntity(EntityAdapter):
 class Agent:
     """AMQP management agent. Manages entities, directs requests to the correct entity."""
 
-    def __init__(self, dispatch, qd):
+    def __init__(self, dispatch, qd, schema=None):
         self.qd = qd
         self.dispatch = dispatch
-        self.schema = QdSchema()
+        self.schema = schema or QdSchema()
         self.entities = EntityCache(self)
         self.request_lock = Lock()
         self.log_adapter = LogAdapter("AGENT")
@@ -1016,7 +1092,7 @@ class Agent:
             return " ".join(["%s=%s" % (k, v) for k, v in ids.items()])
 
         k, v = next(iter(ids.items()))  # Get the first id attribute
-        found = self.entities.map_filter(None, lambda e: e.attributes.get(k) == v)
+        found = self.entities.find(k, v)
         if len(found) == 1:
             entity = found[0]
         elif len(found) > 1:
@@ -285,7 +285,7 @@ def configure_dispatch(dispatch_int: int, filename: str) -> None:
 
     # NOTE: Can't import agent until dispatch C extension module is initialized.
     from .agent import Agent
-    agent = Agent(dispatch, qd)
+    agent = Agent(dispatch, qd, schema=config.schema)  # parsing skrouter.json is a large part of startup
     qd.qd_dispatch_set_agent(dispatch, agent)
 
     def configure(attributes):
@@ -58,8 +58,15 @@ class QdSchema(schema.Schema):
         Check that listeners and connectors can only have role=inter-router if the router has
         mode=interior.
         """
-        entities = list(entities)  # Iterate twice
-        super(QdSchema, self).validate_add(attributes, entities)
+        if isinstance(entities, schema.EntityIndex):
+            super(QdSchema, self).validate_add(attributes, entities)
+            # Only the router and the last listener or connector matter below
+            listener, connector = self.long_name("listener"), self.long_name("connector")
+            entities = entities.by_type(self.long_name("router")) + \
+                [e for e in [entities.last(listener), entities.last(listener, connector)] if e is not None]
+        else:
+            entities = list(entities)  # Iterate twice
+            super(QdSchema, self).validate_add(attributes, entities)
         entities.append(attributes)
         router_mode = router_id = listener_connector_role = listener_role = None
         list_conn_entity = None
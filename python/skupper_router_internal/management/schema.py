@@ -578,10 +578,12 @@ class Schema:
         self.entity_types = parsedefs(EntityType, entityTypes)
 
         self.all_attributes = set()
+        self.unique_attributes = set()
 
         for e in self.entity_types.values():
             e.init()
             self.all_attributes.update(e.attributes.keys())
+            self.unique_attributes.update(a.name for a in e.attributes.values() if a.unique)
 
     def log(self, level, text):
         if not self.log_adapter:
@@ -636,15 +638,16 @@ class Schema:
         """
         Validate all the entities from entity_iter, return a list of valid entities.
         """
-        entities = []
+        entities = EntityIndex(self)
         for a in attribute_maps:
             self.validate_add(a, entities)
-            entities.append(a)
+            entities.add(a)
 
     def validate_add(self, attributes, entities):
         """
         Validate that attributes would be valid when added to entities.
         Assumes entities are already valid
+        @param entities: A list of entities or an L{EntityIndex}.
         @raise ValidationError if adding e violates a global constraint like uniqueness.
         """
         self.validate_entity(attributes)
@@ -653,6 +656,8 @@ class Schema:
         unique = [a for a in entity_type.attributes.values() if a.unique and a.name in attributes]
         if not unique and not entity_type.singleton:
             return              # Nothing to do
+        if isinstance(entities, EntityIndex):
+            entities = entities.candidates(attributes, [a.name for a in unique], entity_type.singleton)
         for e in entities:
             if entity_type.singleton and attributes['type'] == e['type']:
                 raise ValidationError("Adding %s singleton %s when %s already exists" %
@@ -690,6 +695,79 @@ class Schema:
             return self.filter(lambda t: t.is_a(type))
 
 
+class EntityIndex:
+    """
+    Entities in the order they were added, indexed by type and by the values of their unique attributes.
+
+    Schema.validate_add() checks a new entity against an index by looking only at the entities it could clash with,
+    so loading a configuration of n entities takes O(n) rather than O(n^2) comparisons.
+    """
+
+    def __init__(self, schema, entities=None):
+        self.unique_attributes = schema.unique_attributes
+        self._seq = 0
+        self._keys = {}       # id(entity): (sequence number, type, [(attribute name, value)]) when added
+        self._by_type = {}    # type: {id(entity): entity} in the order added
+        self._by_value = {}   # (attribute name, value): {id(entity): entity}
+        for e in entities or []:
+            self.add(e)
+
+    def __len__(self):
+        return len(self._keys)
+
+    def add(self, entity):
+        values = []
+        for name in self.unique_attributes:
+            try:
+                values.append((name, entity[name]))
+            except KeyError:
+                continue
+        key = id(entity)
+        self._seq += 1
+        self._keys[key] = (self._seq, entity['type'], values)
+        self._by_type.setdefault(entity['type'], {})[key] = entity
+        for v in values:
+            self._by_value.setdefault(v, {})[key] = entity
+
+    def remove(self, entity):
+        key = id(entity)
+        if key not in self._keys:
+            return
+        _, type, values = self._keys.pop(key)
+        self._by_type[type].pop(key, None)
+        for v in values:
+            self._by_value[v].pop(key, None)
+            if not self._by_value[v]:
+                del self._by_value[v]
+
+    def _ordered(self, entities):
+        """Entities without duplicates, in the order they were added"""
+        unique = dict((id(e), e) for e in entities if e is not None)
+        return sorted(unique.values(), key=lambda e: self._keys[id(e)][0])
+
+    def find(self, name, value):
+        """Entities whose unique attribute name had value when they were added"""
+        return self._ordered(self._by_value.get((name, value), {}).values())
+
+    def by_type(self, type):
+        """Entities with exactly this (long) type name, in the order added"""
+        return list(self._by_type.get(type, {}).values())
+
+    def last(self, *types):
+        """The entity of one of the given types that was added last, or None"""
+        last = [next(reversed(self._by_type[t].values())) for t in types if self._by_type.get(t)]
+        return self._ordered(last)[-1] if last else None
+
+    def candidates(self, attributes, unique, singleton):
+        """Entities that may clash with attributes: those sharing a unique value, or its type if singleton"""
+        found = []
+        for name in unique:
+            found.extend(self._by_value.get((name, attributes[name]), {}).values())
+        if singleton:
+            found.extend(self.by_type(attributes['type']))
+        return self._ordered(found)
+
+
 class SchemaEntity(EntityBase):
     """A map of attributes associated with an L{EntityType}"""
 
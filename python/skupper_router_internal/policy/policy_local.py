@@ -63,6 +63,16 @@ class PolicyKeys:
     KW_SOURCE_PATTERN            = "sourcePattern"
     KW_TARGET_PATTERN            = "targetPattern"
     KW_VHOST_ALIASES             = "aliases"
+    KW_MAX_BYTES_PER_SEC         = "maxBytesPerSecond"
+    KW_MAX_MESSAGES_PER_SEC      = "maxMessagesPerSecond"
+    KW_MAX_CONN_BYTES_PER_SEC    = "maxConnectionBytesPerSecond"
+    KW_MAX_CONN_MESSAGES_PER_SEC = "maxConnectionMessagesPerSecond"
+
+    # Vhost rate limits handed to C with the user group settings, and the
+    # name of the vhost policy whose connections share them
+    KW_VHOST_MAX_BYTES_PER_SEC    = "vhostMaxBytesPerSecond"
+    KW_VHOST_MAX_MESSAGES_PER_SEC = "vhostMaxMessagesPerSecond"
+    KW_VHOST_POLICY               = "vhostPolicy"
 
     # Policy stats key words
     KW_CONNECTIONS_APPROVED     = "connectionsApproved"
@@ -123,7 +133,9 @@ class PolicyCompiler:
         PolicyKeys.KW_MAXCONNPERUSER,
         PolicyKeys.KW_CONNECTION_ALLOW_DEFAULT,
         PolicyKeys.KW_GROUPS,
-        PolicyKeys.KW_VHOST_ALIASES
+        PolicyKeys.KW_VHOST_ALIASES,
+        PolicyKeys.KW_MAX_BYTES_PER_SEC,
+        PolicyKeys.KW_MAX_MESSAGES_PER_SEC
     ]
 
     allowed_settings_options = [
@@ -144,7 +156,11 @@ class PolicyCompiler:
         PolicyKeys.KW_SOURCES,
         PolicyKeys.KW_TARGETS,
         PolicyKeys.KW_SOURCE_PATTERN,
-        PolicyKeys.KW_TARGET_PATTERN
+        PolicyKeys.KW_TARGET_PATTERN,
+        PolicyKeys.KW_MAX_BYTES_PER_SEC,
+        PolicyKeys.KW_MAX_MESSAGES_PER_SEC,
+        PolicyKeys.KW_MAX_CONN_BYTES_PER_SEC,
+        PolicyKeys.KW_MAX_CONN_MESSAGES_PER_SEC
     ]
 
     def __init__(self) -> None:
@@ -273,6 +289,10 @@ class PolicyCompiler:
         policy_out[PolicyKeys.KW_TARGET_PATTERN] = ''
         policy_out[PolicyKeys.KW_MAXCONNPERHOST] = None  # optional group limit
         policy_out[PolicyKeys.KW_MAXCONNPERUSER] = None
+        policy_out[PolicyKeys.KW_MAX_BYTES_PER_SEC] = 0  # zero: no rate limit
+        policy_out[PolicyKeys.KW_MAX_MESSAGES_PER_SEC] = 0
+        policy_out[PolicyKeys.KW_MAX_CONN_BYTES_PER_SEC] = 0
+        policy_out[PolicyKeys.KW_MAX_CONN_MESSAGES_PER_SEC] = 0
 
         cerror: List[str] = []
         user_sources = False
@@ -297,7 +317,11 @@ class PolicyCompiler:
                          PolicyKeys.KW_MAX_RECEIVERS,
                          PolicyKeys.KW_MAX_SENDERS,
                          PolicyKeys.KW_MAX_SESSION_WINDOW,
-                         PolicyKeys.KW_MAX_SESSIONS
+                         PolicyKeys.KW_MAX_SESSIONS,
+                         PolicyKeys.KW_MAX_BYTES_PER_SEC,
+                         PolicyKeys.KW_MAX_MESSAGES_PER_SEC,
+                         PolicyKeys.KW_MAX_CONN_BYTES_PER_SEC,
+                         PolicyKeys.KW_MAX_CONN_MESSAGES_PER_SEC
                          ]:
                 if not self.validateNumber(val, 0, 0, cerror):
                     errors.append("Policy vhost '%s' user group '%s' option '%s' has error '%s'." %
@@ -442,6 +466,8 @@ class PolicyCompiler:
         policy_out[PolicyKeys.KW_GROUPS] = {}
         policy_out[PolicyKeys.KW_MAX_MESSAGE_SIZE] = None
         policy_out[PolicyKeys.KW_VHOST_ALIASES] = []
+        policy_out[PolicyKeys.KW_MAX_BYTES_PER_SEC] = 0
+        policy_out[PolicyKeys.KW_MAX_MESSAGES_PER_SEC] = 0
 
         # validate the options
         for key, val in policy_in.items():
@@ -458,7 +484,9 @@ class PolicyCompiler:
                     errors.append(msg)
                     return False
                 policy_out[key] = val
-            elif key in [PolicyKeys.KW_MAX_MESSAGE_SIZE
+            elif key in [PolicyKeys.KW_MAX_MESSAGE_SIZE,
+                         PolicyKeys.KW_MAX_BYTES_PER_SEC,
+                         PolicyKeys.KW_MAX_MESSAGES_PER_SEC
                          ]:
                 if not self.validateNumber(val, 0, 0, cerror):
                     msg = ("Policy vhost '%s' option '%s' has error '%s'." %
@@ -980,6 +1008,9 @@ class PolicyLocal:
                     maxsize = self._max_message_size
                 upolicy[PolicyKeys.KW_MAX_MESSAGE_SIZE] = maxsize
 
+            upolicy[PolicyKeys.KW_VHOST_MAX_BYTES_PER_SEC] = int(ruleset.get(PolicyKeys.KW_MAX_BYTES_PER_SEC, 0))
+            upolicy[PolicyKeys.KW_VHOST_MAX_MESSAGES_PER_SEC] = int(ruleset.get(PolicyKeys.KW_MAX_MESSAGES_PER_SEC, 0))
+            upolicy[PolicyKeys.KW_VHOST_POLICY] = vhost
             upolicy[PolicyKeys.KW_CSTATS] = self.statsdb[vhost].get_cstats()
             return True
         except Exception as e:
@@ -68,6 +68,13 @@ class PolicyManager:
     def get_use_hostname_patterns(self):
         return self._use_hostname_patterns
 
+    def flush_settings_cache(self) -> None:
+        """
+        The vhost database changed. Discard the settings that C code
+        has cached from earlier lookup_settings calls.
+        """
+        self._agent.qd.qd_dispatch_policy_settings_cache_flush(self._agent.dispatch)
+
     def set_use_hostname_patterns(self, v: bool) -> None:
         self._use_hostname_patterns = v
         self._policy_local.use_hostname_patterns = v
@@ -81,6 +88,7 @@ class PolicyManager:
         @param[in] attributes: from config
         """
         self._policy_local.create_ruleset(attributes)
+        self.flush_settings_cache()
 
     #
     # Management interface to delete a ruleset
@@ -91,6 +99,7 @@ class PolicyManager:
         @param[in] id: ruleset name
         """
         self._policy_local.policy_delete(id)
+        self.flush_settings_cache()
 
     #
     # Management interface to update a ruleset
@@ -101,6 +110,7 @@ class PolicyManager:
         @param[in] id: ruleset name
         """
         self._policy_local.create_ruleset(attributes)
+        self.flush_settings_cache()
 
     #
     # Management interface to set the default vhost
@@ -112,6 +122,7 @@ class PolicyManager:
         @return:
         """
         self._policy_local.set_default_vhost(name)
+        self.flush_settings_cache()
 
     #
     # Runtime query interface
@@ -168,6 +179,7 @@ class PolicyManager:
         :return: none
         """
         self._policy_local.set_max_message_size(size)
+        self.flush_settings_cache()
 
 #
 #
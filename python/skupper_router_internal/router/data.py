@@ -24,6 +24,14 @@
 
 ProtocolVersion = 1
 
+##
+# The number of local link-state changes for which deltas are retained.  A link-state
+# request from a router that is further behind than this is answered with the full
+# link state.
+##
+
+LinkStateDeltaHistory = 16
+
 
 def getMandatory(data, key, cls=None):
     """
@@ -78,10 +86,16 @@ class LinkState:
     """
     The link-state of a single router.  The link state consists of a list of neighbor routers reachable from
     the reporting router.  The link-state-sequence number is incremented each time the link state changes.
+
+    The peers added and removed between sequence bumps are recorded so that the changes leading up to the
+    current sequence can be sent as a delta rather than the full link state.
     """
 
     def __init__(self, body, _id=None, _ls_seq=None, _peers=None):
         self.last_seen = 0
+        self.history   = []  # [(ls_seq, changed-peers, removed-peers)]
+        self.changed   = {}
+        self.removed   = set()
         if body:
             self.id = getMandatory(body, 'id', str)
             self.area = '0'
@@ -105,18 +119,32 @@ class LinkState:
     def add_peer(self, _id, _cost):
         if _id not in self.peers:
             self.peers[_id] = _cost
+            self.changed[_id] = _cost
+            self.removed.discard(_id)
+            return True
+        return False
+
+    def set_peer_cost(self, _id, _cost):
+        if _id in self.peers and self.peers[_id] != _cost:
+            self.peers[_id] = _cost
+            self.changed[_id] = _cost
             return True
         return False
 
     def del_peer(self, _id):
         if _id in self.peers:
             self.peers.pop(_id)
+            self.changed.pop(_id, None)
+            self.removed.add(_id)
             return True
         return False
 
     def del_all_peers(self):
         self.peers = {}
         self.ls_seq = 0
+        self.history = []
+        self.changed = {}
+        self.removed = set()
 
     def has_peers(self):
         return len(self.peers) > 0
@@ -126,6 +154,42 @@ class LinkState:
 
     def bump_sequence(self):
         self.ls_seq += 1
+        self.history.append((self.ls_seq, self.changed, sorted(self.removed)))
+        del self.history[:-LinkStateDeltaHistory]
+        self.changed = {}
+        self.removed = set()
+
+    def delta_since(self, ls_seq):
+        """
+        Return a tuple of (changed-peers, removed-peers) that brings a copy of this link state at
+        sequence ls_seq up to the current sequence, or None if the history doesn't reach back that far.
+        """
+        if ls_seq > self.ls_seq or ls_seq <= 0:
+            return None
+        entries = [entry for entry in self.history if entry[0] > ls_seq]
+        if len(entries) != self.ls_seq - ls_seq:
+            return None
+        changed = {}
+        removed = set()
+        for _, _changed, _removed in entries:
+            for _id in _removed:
+                changed.pop(_id, None)
+                removed.add(_id)
+            for _id, _cost in _changed.items():
+                changed[_id] = _cost
+                removed.discard(_id)
+        return changed, sorted(removed)
+
+    def apply_delta(self, ls_seq, changed, removed):
+        """
+        Apply a delta received from the owning router, advancing this copy to ls_seq.
+        """
+        peers = dict(self.peers)
+        for _id in removed:
+            peers.pop(_id, None)
+        peers.update(changed)
+        self.peers  = peers
+        self.ls_seq = ls_seq
 
 
 class MessageHELLO:
@@ -134,21 +198,30 @@ class MessageHELLO:
     scope: neighbors only - HELLO messages travel at most one hop
     This message is used by directly connected routers to determine with whom they have
     bidirectional connectivity.
+
+    It also measures the round-trip time to the neighbors: 'ts' is the sender's clock in microseconds
+    when it sent the message and 'echo' returns the last 'ts' received from each neighbor with the
+    microseconds it was held before this message was sent, {neighbor-id: [ts, held]}.  Both are
+    optional, routers that don't send them are not measured.
     """
 
-    def __init__(self, body, _id=None, _seen_peers=None, _instance=0):
+    def __init__(self, body, _id=None, _seen_peers=None, _instance=0, _timestamp=None, _echo=None):
         if body:
             self.id = getMandatory(body, 'id', str)
             self.area = '0'
             self.seen_peers = getMandatory(body, 'seen', list)
             self.instance = getOptional(body, 'instance', 0, int)
             self.version  = getOptional(body, 'pv', 0, int)
+            self.timestamp = getOptional(body, 'ts', None, int)
+            self.echo      = getOptional(body, 'echo', {}, dict)
         else:
             self.id   = _id
             self.area = '0'
             self.seen_peers = _seen_peers
             self.instance = _instance
             self.version  = ProtocolVersion
+            self.timestamp = _timestamp
+            self.echo      = _echo or {}
 
     def __repr__(self):
         return "HELLO(id=%s pv=%d area=%s inst=%d seen=%r)" % (self.id, self.version, self.area, self.instance, self.seen_peers)
@@ -157,11 +230,15 @@ class MessageHELLO:
         return 'HELLO'
 
     def to_dict(self):
-        return {'id'       : self.id,
-                'pv'       : self.version,
-                'area'     : self.area,
-                'instance' : self.instance,
-                'seen'     : self.seen_peers}
+        result = {'id'       : self.id,
+                  'pv'       : self.version,
+                  'area'     : self.area,
+                  'instance' : self.instance,
+                  'seen'     : self.seen_peers}
+        if self.timestamp is not None:
+            result['ts']   = self.timestamp
+            result['echo'] = self.echo
+        return result
 
     def is_seen(self, _id):
         return self.seen_peers.count(_id) > 0
@@ -209,16 +286,28 @@ class MessageRA:
 
 class MessageLSU:
     """
+    An LSU carries either the full link state of the sending router ('ls') or, in reply to an LSR
+    that names the sequence the requester already has, only the peers changed and removed since
+    that sequence ('base_seq', 'changed', 'removed').
     """
 
-    def __init__(self, body, _id=None, _ls_seq=None, _ls=None, _instance=0):
+    def __init__(self, body, _id=None, _ls_seq=None, _ls=None, _instance=0,
+                 _base_seq=None, _changed=None, _removed=None):
         if body:
             self.id = getMandatory(body, 'id', str)
             self.area = '0'
             self.ls_seq = getMandatory(body, 'ls_seq', int)
-            self.ls = LinkState(getMandatory(body, 'ls', dict))
             self.instance = getOptional(body, 'instance', 0, int)
             self.version  = getOptional(body, 'pv', 0, int)
+            self.base_seq = getOptional(body, 'base_seq', None, int)
+            if self.base_seq is None:
+                self.ls = LinkState(getMandatory(body, 'ls', dict))
+                self.changed = None
+                self.removed = None
+            else:
+                self.ls = None
+                self.changed = getMandatory(body, 'changed', dict)
+                self.removed = getMandatory(body, 'removed', list)
         else:
             self.id = _id
             self.area = '0'
@@ -226,47 +315,70 @@ class MessageLSU:
             self.ls = _ls
             self.instance = _instance
             self.version  = ProtocolVersion
+            self.base_seq = _base_seq
+            self.changed  = _changed
+            self.removed  = _removed
 
     def get_opcode(self):
         return 'LSU'
 
+    def is_delta(self):
+        return self.base_seq is not None
+
     def __repr__(self):
+        if self.is_delta():
+            return "LSU(id=%s pv=%d area=%s inst=%d ls_seq=%d base_seq=%d changed=%r removed=%r)" % \
+                (self.id, self.version, self.area, self.instance, self.ls_seq, self.base_seq,
+                 self.changed, self.removed)
         return "LSU(id=%s pv=%d area=%s inst=%d ls_seq=%d ls=%r)" % \
             (self.id, self.version, self.area, self.instance, self.ls_seq, self.ls)
 
     def to_dict(self):
-        return {'id'       : self.id,
-                'pv'       : self.version,
-                'area'     : self.area,
-                'instance' : self.instance,
-                'ls_seq'   : self.ls_seq,
-                'ls'       : self.ls.to_dict()}
+        result = {'id'       : self.id,
+                  'pv'       : self.version,
+                  'area'     : self.area,
+                  'instance' : self.instance,
+                  'ls_seq'   : self.ls_seq}
+        if self.is_delta():
+            result['base_seq'] = self.base_seq
+            result['changed']  = self.changed
+            result['removed']  = self.removed
+        else:
+            result['ls'] = self.ls.to_dict()
+        return result
 
 
 class MessageLSR:
     """
+    An LSR optionally carries the sequence of the requester's copy of the target's link state
+    ('have_seq') so the target can reply with a delta.  Without it the full link state is sent.
     """
 
-    def __init__(self, body, _id=None):
+    def __init__(self, body, _id=None, _have_seq=0):
         if body:
             self.id = getMandatory(body, 'id', str)
             self.version = getOptional(body, 'pv', 0, int)
             self.area = '0'
+            self.have_seq = getOptional(body, 'have_seq', 0, int)
         else:
             self.id = _id
             self.version = ProtocolVersion
             self.area = '0'
+            self.have_seq = _have_seq
 
     def get_opcode(self):
         return 'LSR'
 
     def __repr__(self):
-        return "LSR(id=%s pv=%d area=%s)" % (self.id, self.version, self.area)
+        return "LSR(id=%s pv=%d area=%s have_seq=%d)" % (self.id, self.version, self.area, self.have_seq)
 
     def to_dict(self):
-        return {'id'      : self.id,
-                'pv'      : self.version,
-                'area'    : self.area}
+        result = {'id'      : self.id,
+                  'pv'      : self.version,
+                  'area'    : self.area}
+        if self.have_seq:
+            result['have_seq'] = self.have_seq
+        return result
 
 
 class MessageMAU:
@@ -355,3 +467,41 @@ class MessageMAR:
                 'pv'       : self.version,
                 'area'     : self.area,
                 'have_seq' : self.have_seq}
+
+
+class TopologySnapshot:
+    """
+    A copy of the link states of the known remote routers, saved so that a restarting router can
+    preload them as provisional state.  Each entry also carries the router's instance so a router
+    that restarted since the snapshot was taken is detected from its first RA.
+    """
+
+    def __init__(self, body, _id=None, _taken=None, _nodes=None):
+        if body:
+            self.id = getMandatory(body, 'id', str)
+            self.version = getMandatory(body, 'pv', int)
+            self.taken = getMandatory(body, 'taken', int)
+            self.nodes = []
+            for entry in getMandatory(body, 'nodes', list):
+                self.nodes.append((LinkState(getMandatory(entry, 'ls', dict)),
+                                   getOptional(entry, 'instance', None, int)))
+        else:
+            self.id = _id
+            self.version = ProtocolVersion
+            self.taken = int(_taken)
+            self.nodes = _nodes  # [(LinkState, instance)]
+
+    def __repr__(self):
+        return "SNAPSHOT(id=%s pv=%d taken=%d nodes=%r)" % (self.id, self.version, self.taken, self.nodes)
+
+    def to_dict(self):
+        nodes = []
+        for ls, instance in self.nodes:
+            entry = {'ls': ls.to_dict()}
+            if instance is not None:
+                entry['instance'] = instance
+            nodes.append(entry)
+        return {'id'    : self.id,
+                'pv'    : self.version,
+                'taken' : self.taken,
+                'nodes' : nodes}
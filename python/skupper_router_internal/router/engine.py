@@ -111,9 +111,11 @@ class RouterEngine:
     def linkLost(self, link_id):
         """
         The control-link to a neighbor has been dropped.  We can cancel the neighbor from the
-        link-state immediately instead of waiting for the hello-timeout to expire.
+        link-state immediately instead of waiting for the hello-timeout to expire.  The routes are
+        recomputed right away rather than on the next timer tick.
         """
         self.node_tracker.link_lost(link_id)
+        self.node_tracker.process_changes(time.time())
 
     def handleTimerTick(self):
         """
@@ -21,9 +21,14 @@ from .data import MessageHELLO
 from ..dispatch import LOG_DEBUG, LOG_CRITICAL
 
 
+def _usec(seconds):
+    return int(round(seconds * 1000000))
+
+
 class HelloProtocol:
     """
-    This module is responsible for running the HELLO protocol.
+    This module is responsible for running the HELLO protocol and measuring the round-trip
+    time to the neighbors with it.
     """
 
     def __init__(self, container, node_tracker):
@@ -35,6 +40,7 @@ class HelloProtocol:
         self.hello_interval   = container.config.helloIntervalSeconds
         self.hello_max_age    = container.config.helloMaxAgeSeconds
         self.hellos           = {}
+        self.echoes           = {}  # neighbor id => (its last HELLO timestamp, time received) to echo back
         self.dup_reported     = False
 
     def tick(self, now):
@@ -42,7 +48,9 @@ class HelloProtocol:
         self.ticks += 1.0
         if self.ticks - self.last_hello_ticks >= self.hello_interval:
             self.last_hello_ticks = self.ticks
-            msg = MessageHELLO(None, self.id, list(self.hellos.keys()), self.container.instance)
+            echo = {_id: [ts, _usec(now - received)] for _id, (ts, received) in self.echoes.items()}
+            self.echoes = {}
+            msg = MessageHELLO(None, self.id, list(self.hellos.keys()), self.container.instance, _usec(now), echo)
             self.container.send('amqp:/_local/qdhello', msg)
             self.container.log_hello(LOG_DEBUG, "SENT: %r" % msg)
 
@@ -53,8 +61,16 @@ class HelloProtocol:
                 self.container.log_hello(LOG_CRITICAL, "Detected Neighbor Router with a Duplicate ID - %s" % msg.id)
             return
         self.hellos[msg.id] = now
+        if msg.timestamp is not None:
+            self.echoes[msg.id] = (msg.timestamp, now)
         if msg.is_seen(self.id):
             self.node_tracker.neighbor_refresh(msg.id, msg.version, msg.instance, link_id, cost, now)
+            echoed = msg.echo.get(self.id)
+            if echoed and len(echoed) == 2:
+                # our own timestamp came back, less the time the neighbor held it
+                rtt = now - (echoed[0] + echoed[1]) / 1000000.0
+                if rtt >= 0:
+                    self.node_tracker.neighbor_rtt(msg.id, rtt)
 
     def _expire_hellos(self, now):
         """
@@ -53,19 +53,29 @@ class LinkStateEngine:
     def handle_lsu(self, msg, now):
         if msg.id == self.id:
             return
-        self.node_tracker.link_state_received(msg.id, msg.version, msg.ls, msg.instance, now)
+        if msg.is_delta():
+            self.node_tracker.link_state_delta_received(msg.id, msg.version, msg.base_seq, msg.ls_seq,
+                                                        msg.changed, msg.removed, msg.instance, now)
+        else:
+            self.node_tracker.link_state_received(msg.id, msg.version, msg.ls, msg.instance, now)
 
     def handle_lsr(self, msg, now):
         if msg.id == self.id:
             return
         self.node_tracker.router_learned(msg.id, msg.version)
         my_ls = self.node_tracker.link_state
-        smsg = MessageLSU(None, self.id, my_ls.ls_seq, my_ls, self.container.instance)
+        delta = my_ls.delta_since(msg.have_seq)
+        if delta is not None:
+            changed, removed = delta
+            smsg = MessageLSU(None, self.id, my_ls.ls_seq, None, self.container.instance,
+                              msg.have_seq, changed, removed)
+        else:
+            smsg = MessageLSU(None, self.id, my_ls.ls_seq, my_ls, self.container.instance)
         self.container.send('amqp:/_topo/%s/%s/qdrouter' % (msg.area, msg.id), smsg)
         self.container.log_ls(LOG_DEBUG, "SENT: %r" % smsg)
 
-    def send_lsr(self, _id):
-        msg = MessageLSR(None, self.id)
+    def send_lsr(self, _id, have_seq=0):
+        msg = MessageLSR(None, self.id, have_seq)
         self.container.send('amqp:/_topo/0/%s/qdrouter' % _id, msg)
         self.container.log_ls(LOG_DEBUG, "SENT: %r to: %s" % (msg, _id))
 
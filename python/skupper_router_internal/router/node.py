@@ -17,10 +17,17 @@
 # under the License.
 #
 
-from ..dispatch import LOG_INFO, LOG_DEBUG
-from .data import LinkState, ProtocolVersion
+import json
+import os
+import time
+
+from ..dispatch import LOG_INFO, LOG_DEBUG, LOG_WARNING
+from .data import LinkState, ProtocolVersion, TopologySnapshot
 from .address import Address
 
+RTT_GAIN       = 0.125  # weight of a new sample in the smoothed round-trip time
+RTT_HYSTERESIS = 0.25   # quanta the smoothed round-trip time must leave its band by to change the link cost
+
 
 class NodeTracker:
     """
@@ -50,7 +57,14 @@ class NodeTracker:
         self.neighbor_max_age = self.container.config.helloMaxAgeSeconds
         self.ls_max_age       = self.container.config.remoteLsMaxAgeSeconds
         self.flux_interval    = self.container.config.raIntervalFluxSeconds * 2
+        self.snapshot_file     = getattr(self.container.config, 'topologySnapshotFile', None)
+        self.snapshot_interval = getattr(self.container.config, 'topologySnapshotIntervalSeconds', 30)
+        self.snapshot_dirty    = False
+        self.last_snapshot     = 0
+        self.rtt_cost_quantum  = getattr(self.container.config, 'rttCostQuantumMilliseconds', 0) / 1000.0
         self.container.router_adapter.get_agent().add_implementation(self, "router.node")
+        if self.snapshot_file:
+            self._load_snapshot(time.time())
 
     def refresh_entity(self, attributes):
         """Refresh management attributes"""
@@ -114,12 +128,18 @@ class NodeTracker:
                         self.nodes.pop(node_id)
 
     def tick(self, now):
-        send_ra = False
-
         ##
         # Expire neighbors and link state
         ##
         self._do_expirations(now)
+        self.process_changes(now)
+
+    def process_changes(self, now):
+        """
+        Act on the changes to the link state and topology recorded since the last call: recompute the
+        routes, request missing state and advertise our own link state if it changed.
+        """
+        send_ra = False
 
         ##
         # Enter flux mode if things are changing
@@ -153,6 +173,7 @@ class NodeTracker:
             self.container.log_ls(LOG_INFO, "Computed costs: %r" % costs)
             self.container.log_ls(LOG_INFO, "Computed valid origins: %r" % valid_origins)
             self.container.log_ls(LOG_INFO, "Computed radius: %d" % radius)
+            self.snapshot_dirty = True
 
             ##
             # Update the topology radius
@@ -177,7 +198,7 @@ class NodeTracker:
         ##
         for node_id, node in self.nodes.items():
             if node.link_state_requested():
-                self.container.link_state_engine.send_lsr(node_id)
+                self.container.link_state_engine.send_lsr(node_id, node.link_state_have_seq())
             if node.mobile_address_requested():
                 self.container.router_adapter.mobile_seq_advanced(node.maskbit)
 
@@ -187,6 +208,67 @@ class NodeTracker:
         if send_ra:
             self.container.link_state_engine.send_ra(now)
 
+        ##
+        # Save the topology for a warm restart if it changed since the last snapshot
+        ##
+        if self.snapshot_file and self.snapshot_dirty and now - self.last_snapshot >= self.snapshot_interval:
+            self._write_snapshot(now)
+
+    def _write_snapshot(self, now):
+        """
+        Write the link states of the known routers to the snapshot file.  The file is replaced
+        atomically so a crash mid-write leaves the previous snapshot intact.
+        """
+        self.snapshot_dirty = False
+        self.last_snapshot  = now
+        nodes = [(node.link_state, node.instance) for node in self.nodes.values() if node.link_state.has_peers()]
+        snapshot = TopologySnapshot(None, self.my_id, now, nodes)
+        tmp = self.snapshot_file + ".tmp"
+        try:
+            with open(tmp, "w") as f:
+                json.dump(snapshot.to_dict(), f)
+            os.replace(tmp, self.snapshot_file)
+            self.container.log_ls(LOG_DEBUG, "Topology snapshot written: %d routers" % len(nodes))
+        except (OSError, TypeError, ValueError) as e:
+            self.container.log(LOG_WARNING, "Unable to write topology snapshot %s: %s" % (self.snapshot_file, e))
+
+    def _load_snapshot(self, now):
+        """
+        Preload the link states saved by a previous run as provisional state.  They are used for
+        route computation as soon as neighbors come up, and are validated by the sequences in the
+        routers' RAs: an equal ls_seq needs no request, a newer one is fetched (as a delta where
+        possible), and a changed instance discards the entry.  Entries not confirmed by an RA expire
+        after remoteLsMaxAgeSeconds like any other link state.
+        """
+        try:
+            with open(self.snapshot_file) as f:
+                snapshot = TopologySnapshot(json.load(f))
+        except FileNotFoundError:
+            return
+        except Exception as e:
+            self.container.log(LOG_WARNING, "Ignoring topology snapshot %s: %s" % (self.snapshot_file, e))
+            return
+
+        if snapshot.id != self.my_id or snapshot.version != ProtocolVersion or now - snapshot.taken > self.ls_max_age:
+            self.container.log(LOG_INFO, "Ignoring stale topology snapshot %s" % self.snapshot_file)
+            return
+
+        for link_state, instance in snapshot.nodes:
+            if link_state.id == self.my_id or link_state.id in self.nodes:
+                continue
+            node = RouterNode(self, link_state.id, None, instance)
+            node.link_state           = link_state
+            node.link_state.last_seen = now
+            node.need_ls_request      = False
+            self.nodes[link_state.id] = node
+
+        for link_state, instance in snapshot.nodes:
+            for peer in link_state.peers:
+                self.router_learned(peer, None)
+
+        self.recompute_topology = True
+        self.container.log(LOG_INFO, "Preloaded topology snapshot: %d routers" % len(snapshot.nodes))
+
     def neighbor_refresh(self, node_id, version, instance, link_id, cost, now):
         """
         Invoked when the hello protocol has received positive confirmation
@@ -210,10 +292,11 @@ class NodeTracker:
         # Set the link_id to indicate this is a neighbor router.  If the link_id
         # changed, update the index and add the neighbor to the local link state.
         ##
+        node.configured_cost = cost
         if node.set_link_id(link_id):
             self.nodes_by_link_id[link_id] = node
             node.request_link_state()
-            if self.link_state.add_peer(node_id, cost):
+            if self.link_state.add_peer(node_id, node.link_cost(self.rtt_cost_quantum)):
                 self.link_state_changed = True
 
         ##
@@ -229,6 +312,23 @@ class NodeTracker:
             self.recompute_topology = True
             node.request_link_state()
 
+    def neighbor_rtt(self, node_id, rtt):
+        """
+        Invoked when the hello protocol has measured the round-trip time in seconds to a neighbor.
+        With rttCostQuantumMilliseconds set, the cost of the link to the neighbor follows the
+        smoothed round-trip time.
+        """
+        node = self.nodes.get(node_id)
+        if node is None or not node.is_neighbor():
+            return
+        node.update_rtt(rtt)
+        if self.rtt_cost_quantum > 0:
+            cost = node.link_cost(self.rtt_cost_quantum)
+            if self.link_state.set_peer_cost(node_id, cost):
+                self.link_state_changed = True
+                self.container.log_ls(LOG_INFO, "Link cost to %s is now %d (RTT %.1fms)" %
+                                      (node_id, cost, node.srtt * 1000))
+
     def link_lost(self, link_id):
         """
         Invoked when an inter-router link is dropped.
@@ -292,7 +392,7 @@ class NodeTracker:
         # not up to date.
         ##
         if node.link_state.ls_seq < ls_seq:
-            self.container.link_state_engine.send_lsr(node_id)
+            self.container.link_state_engine.send_lsr(node_id, node.link_state_have_seq())
 
         ##
         # Check the mobile sequence.  Send a mobile-address-request if we are
@@ -343,6 +443,36 @@ class NodeTracker:
                 if peer not in self.nodes:
                     self.router_learned(peer, None)
 
+    def link_state_delta_received(self, node_id, version, base_seq, ls_seq, changed, removed, instance, now):
+        """
+        Invoked when a delta link state update is received from another router.  The delta
+        applies only to the copy of the link state at base_seq; if our copy is at a different
+        sequence (or the router has restarted) the full link state is requested instead.
+        """
+        if node_id not in self.nodes:
+            self.nodes[node_id] = RouterNode(self, node_id, version, instance)
+        node = self.nodes[node_id]
+
+        if node.version is None:
+            node.version = version
+
+        if ls_seq <= node.link_state.ls_seq:
+            return
+
+        if base_seq != node.link_state.ls_seq or (node.instance is not None and instance != node.instance):
+            self.container.log_ls(LOG_DEBUG, "Link state delta gap from %s: have=%d base=%d - requesting full link state" %
+                                  (node_id, node.link_state.ls_seq, base_seq))
+            node.request_full_link_state()
+            return
+
+        node.link_state.apply_delta(ls_seq, changed, removed)
+        node.link_state.last_seen = now
+        self.recompute_topology = True
+
+        for peer in changed:
+            if peer not in self.nodes:
+                self.router_learned(peer, None)
+
     def router_node(self, node_id):
         return self.nodes[node_id]
 
@@ -390,8 +520,12 @@ class RouterNode:
         self.valid_origins           = None
         self.mobile_address_sequence = 0
         self.need_ls_request         = True
+        self.need_full_ls            = False
         self.need_mobile_request     = False
         self.keep_alive_count        = 0
+        self.configured_cost         = None  # of the link to a neighbor
+        self.srtt                    = None  # smoothed round-trip time in seconds of the link to a neighbor
+        self.rtt_steps               = 0     # quanta of srtt added to the configured cost
         self.adapter.add_router("amqp:/_topo/0/%s/qdrouter" % self.id, self.maskbit)
         self.log(LOG_DEBUG, "Node %s created: maskbit=%d" % (self.id, self.maskbit))
         self.adapter.get_agent().add_implementation(self, "router.node")
@@ -408,7 +542,9 @@ class RouterNode:
             "validOrigins": self.valid_origins,
             "address": Address.topological(self.id, area=self.parent.container.area),
             "routerLink": self.peer_link_id,
-            "cost": self.cost
+            "cost": self.cost,
+            "rtt": int(round(self.srtt * 1000000)) if self.srtt is not None and self.is_neighbor() else None,
+            "linkCost": self.parent.link_state.peers.get(self.id) if self.is_neighbor() else None
         })
 
     def _logify(self, addr):
@@ -420,6 +556,8 @@ class RouterNode:
             return False
         self.peer_link_id = link_id
         self.next_hop_router = None
+        self.srtt = None
+        self.rtt_steps = 0
         self.adapter.set_link(self.maskbit, link_id)
         self.adapter.remove_next_hop(self.maskbit)
         self.log(LOG_DEBUG, "Node %s link set: link_id=%r (removed next hop)" % (self.id, link_id))
@@ -476,6 +614,24 @@ class RouterNode:
     def is_neighbor(self):
         return self.peer_link_id is not None
 
+    def update_rtt(self, rtt):
+        self.srtt = rtt if self.srtt is None else self.srtt + RTT_GAIN * (rtt - self.srtt)
+
+    def link_cost(self, quantum):
+        """
+        The cost of the link to this neighbor: the configured cost plus the smoothed round-trip time
+        in quanta of the given seconds, or just the configured cost if the quantum is zero.  The
+        number of quanta only changes once the round-trip time has left the band of the current
+        number by RTT_HYSTERESIS quanta, so a round-trip time near a boundary does not make the
+        cost flap.
+        """
+        if quantum > 0 and self.srtt is not None:
+            low  = (self.rtt_steps - RTT_HYSTERESIS) * quantum
+            high = (self.rtt_steps + 1 + RTT_HYSTERESIS) * quantum
+            if not low <= self.srtt < high:
+                self.rtt_steps = int(self.srtt // quantum)
+        return self.configured_cost + self.rtt_steps
+
     def request_link_state(self):
         """
         Set the link-state-requested flag so we can send this node a link-state
@@ -483,6 +639,24 @@ class RouterNode:
         """
         self.need_ls_request = True
 
+    def request_full_link_state(self):
+        """
+        Request the full link state rather than a delta, used when a delta could not be
+        applied to our copy.
+        """
+        self.need_ls_request = True
+        self.need_full_ls    = True
+
+    def link_state_have_seq(self):
+        """
+        Return the sequence of our copy of this node's link state to be sent in a link-state
+        request, or zero if the full link state is needed.
+        """
+        if self.need_full_ls:
+            self.need_full_ls = False
+            return 0
+        return self.link_state.ls_seq
+
     def link_state_requested(self):
         """
         Return True iff we need to request this node's link state AND the node is
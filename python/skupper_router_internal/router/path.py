@@ -17,18 +17,27 @@
 # under the License.
 #
 
+import heapq
+
 
 class PathEngine:
     """
     This module is responsible for computing the next-hop for every router in the domain
     based on the collection of link states that have been gathered.
+
+    The shortest-path tree from the local node and the trees from every remote node (used for
+    valid origins) are kept between calls.  When the set of nodes is unchanged, only the trees
+    affected by the links that changed are repaired, and only the affected part of each of those
+    trees is recomputed.
     """
 
     def __init__(self, container):
         self.container = container
         self.id = self.container.id
+        self.graph = None    # link-state graph used for the trees below
+        self.trees = {}      # root node ID => SpfTree
 
-    def _calculate_tree_from_root(self, root, collection):
+    def _link_state_graph(self, collection):
         ##
         # Make a copy of the current collection of link-states that contains
         # a fake link-state for nodes that are known-peers but are not in the
@@ -37,185 +46,253 @@ class PathEngine:
         ##
         link_states = {}
         for _id, ls in collection.items():
-            link_states[_id] = ls.peers
+            link_states[_id] = dict(ls.peers)
             for p in ls.peers:
                 if p not in link_states:
                     link_states[p] = {_id: 1}
+        return link_states
 
+    def _graph_changes(self, graph):
         ##
-        # Setup Dijkstra's Algorithm
+        # Return the list of (from, to, old-cost, new-cost) links that differ from the graph
+        # the cached trees were computed with, or None if the trees must be rebuilt entirely.
+        # A cost of None means the link does not exist.
         ##
-        hops = {}
-        cost = {}
-        prev = {}
-        for _id in link_states:
-            hops[_id] = None  # infinite
-            cost[_id] = None  # infinite
-            prev[_id] = None  # undefined
-        hops[root] = 0   # no hops to the root node
-        cost[root] = 0   # no cost to the root node
-        unresolved = NodeSet(cost)
+        if self.graph is None or self.graph.keys() != graph.keys():
+            return None
+        changes = []
+        for u, peers in graph.items():
+            old_peers = self.graph[u]
+            if peers == old_peers:
+                continue
+            for v in peers.keys() | old_peers.keys():
+                if peers.get(v) != old_peers.get(v):
+                    changes.append((u, v, old_peers.get(v), peers.get(v)))
+        return changes
 
-        ##
-        # Process unresolved nodes until lowest cost paths to all reachable nodes have been found.
-        ##
-        while not unresolved.empty():
-            u = unresolved.lowest_cost()
-            if cost[u] is None:
-                # There are no more reachable nodes in unresolved
-                break
-            for v, v_cost in link_states[u].items():
-                if unresolved.contains(v):
-                    alt = cost[u] + v_cost
-                    if cost[v] is None or alt < cost[v]:
-                        hops[v] = hops[u] + 1
-                        cost[v] = alt
-                        prev[v] = u
-                        unresolved.set_cost(v, alt)
+    def _tree(self, root, graph, rgraph, changes):
+        tree = self.trees.get(root)
+        if tree is None or changes is None:
+            tree = SpfTree(root, graph, rgraph)
+            self.trees[root] = tree
+        elif changes:
+            tree.update(graph, rgraph, changes)
+        return tree
 
-        ##
-        # Remove unreachable nodes from the maps.  Note that this will also remove the
-        # root node (has no previous node) from the map.
-        ##
-        for u, val in list(prev.items()):
-            if not val:
-                prev.pop(u)
-                hops.pop(u)
-                cost.pop(u)
-
-        ##
-        # Return previous-node and cost maps.  Prev is a map of all reachable, remote nodes to
-        # their predecessor node.  Cost is a map of all reachable nodes and their costs.
-        ##
-        return prev, cost, hops
-
-    def _calculate_valid_origins(self, nodeset, collection):
+    def _calculate_valid_origins(self, nodes, graph, rgraph, changes):
         ##
         # Calculate the tree from each origin, determine the set of origins-per-dest
         # for which the path from origin to dest passes through us.  This is the set
         # of valid origins for forwarding to the destination.
         ##
         valid_origin = {}         # Map of destination => List of Valid Origins
-        for node in nodeset:
-            if node != self.id:
-                valid_origin[node] = []
-
-        for root in valid_origin.keys():
-            prev, cost, hops = self._calculate_tree_from_root(root, collection)
-            nodes = list(prev.keys())
-            while len(nodes) > 0:
-                u = nodes[0]
-                path = [u]
-                nodes.remove(u)
-                v = prev[u]
-                while v != root:
-                    if v in nodes:
-                        if v != self.id:
-                            path.append(v)
-                        nodes.remove(v)
-                    if v == self.id:
-                        for dest in path:
-                            valid_origin[dest].append(root)
-                    u = v
-                    v = prev[u]
+        for node in nodes:
+            valid_origin[node] = []
+
+        for root in nodes:
+            tree = self._tree(root, graph, rgraph, changes)
+            for dest in tree.descendants(self.id):
+                if dest in valid_origin:
+                    valid_origin[dest].append(root)
         return valid_origin
 
     def calculate_routes(self, collection):
+        graph   = self._link_state_graph(collection)
+        changes = self._graph_changes(graph)
+        if changes is None:
+            self.trees = {}
+        self.graph = graph
+
+        rgraph = {_id: {} for _id in graph}
+        for u, peers in graph.items():
+            for v, v_cost in peers.items():
+                rgraph[v][u] = v_cost
+
         ##
         # Generate the shortest-path tree with the local node as root
         ##
-        prev, cost, hops = self._calculate_tree_from_root(self.id, collection)
-        nodes = list(prev.keys())
+        local = self._tree(self.id, graph, rgraph, changes)
+        nodes = [_id for _id in graph if _id != self.id and _id in local.cost]
+        cost  = {_id: local.cost[_id] for _id in nodes}
 
         ##
         # We will also compute the radius of the topology.  This is the number of
         # hops (not cost) to the most distant router from the local node
         ##
-        radius = max(hops.values()) if len(hops) > 0 else 0
+        radius = max(local.hops[_id] for _id in nodes) if len(nodes) > 0 else 0
 
         ##
-        # Distill the path tree into a map of next hops for each node
+        # Distill the path tree into a map of next hops for each node: every node in the
+        # sub-tree below a neighbor of the root is reached through that neighbor.
         ##
         next_hops = {}
-        while len(nodes) > 0:
-            u = nodes[0]          # pick any destination
-            path = [u]
-            nodes.remove(u)
-            v = prev[u]
-            while v != self.id:   # build a list of nodes in the path back to the root
-                if v in nodes:
-                    path.append(v)
-                    nodes.remove(v)
-                u = v
-                v = prev[u]
-            for w in path:        # mark each node in the path as reachable via the next hop
-                next_hops[w] = u
+        for hop in local.children.get(self.id, ()):
+            next_hops[hop] = hop
+            for w in local.descendants(hop):
+                next_hops[w] = hop
 
         ##
-        # Calculate the valid origins for remote routers
+        # Calculate the valid origins for remote routers.  Trees for nodes that are no
+        # longer reachable are discarded.
         ##
-        valid_origins = self._calculate_valid_origins(list(prev.keys()), collection)
+        valid_origins = self._calculate_valid_origins(nodes, graph, rgraph, changes)
+        self.trees = {_id: tree for _id, tree in self.trees.items() if _id == self.id or _id in cost}
 
         return next_hops, cost, valid_origins, radius
 
 
-class NodeSet:
+class SpfTree:
     """
-    This data structure is an ordered list of node IDs, sorted in increasing order by their cost.
-    Equal cost nodes are secondarily sorted by their ID in order to provide deterministic and
-    repeatable ordering.
+    The shortest-path tree rooted at one node.  Equal cost paths are resolved deterministically:
+    the predecessor of a node is the candidate with the lowest (cost, ID).
+
+    cost, prev and hops only contain reachable nodes.  The root has no entry in prev.
     """
 
-    def __init__(self, cost_map):
-        self.nodes = []
-        for _id, cost in cost_map.items():
-            ##
-            # Assume that nodes are either unreachable (cost = None) or local (cost = 0)
-            # during this initialization.
-            ##
-            if cost == 0:
-                self.nodes.insert(0, (_id, cost))
-            else:
-                ##
-                # There is no need to sort unreachable nodes by ID
-                ##
-                self.nodes.append((_id, cost))
-
-    def __repr__(self):
-        return self.nodes.__repr__()
-
-    def empty(self):
-        return len(self.nodes) == 0
-
-    def contains(self, _id):
-        for a, b in self.nodes:
-            if a == _id:
-                return True
-        return False
+    def __init__(self, root, graph, rgraph):
+        self.root     = root
+        self.cost     = {root: 0}
+        self.prev     = {}
+        self.hops     = {root: 0}
+        self.children = {}
+        self._below   = {}   # cache of descendants(), cleared whenever the tree changes
+
+        self._relax(graph, [(0, root)], {})
+        for v in self.cost:
+            if v != root:
+                self._set_prev(v, self._best_prev(v, rgraph))
+        self._update_hops([root])
+
+    def _relax(self, graph, heap, before):
+        ##
+        # Dijkstra's algorithm from the nodes on the heap.  Costs of nodes not on the heap are
+        # final.  Records the original cost of each node whose cost is lowered in 'before'.
+        ##
+        done = set()
+        while heap:
+            u_cost, u = heapq.heappop(heap)
+            if u in done or u_cost != self.cost.get(u):
+                continue
+            done.add(u)
+            for v, v_cost in graph[u].items():
+                alt = u_cost + v_cost
+                if v != self.root and (v not in self.cost or alt < self.cost[v]):
+                    before.setdefault(v, self.cost.get(v))
+                    self.cost[v] = alt
+                    heapq.heappush(heap, (alt, v))
+
+    def _best_prev(self, v, rgraph):
+        if v not in self.cost:
+            return None
+        best = None
+        for u, v_cost in rgraph[v].items():
+            u_cost = self.cost.get(u)
+            if u_cost is not None and u_cost + v_cost == self.cost[v]:
+                if best is None or (u_cost, u) < (self.cost[best], best):
+                    best = u
+        return best
+
+    def _set_prev(self, v, u):
+        old = self.prev.get(v)
+        if old == u:
+            return False
+        if old is not None:
+            self.children[old].remove(v)
+        if u is None:
+            self.prev.pop(v)
+        else:
+            self.prev[v] = u
+            self.children.setdefault(u, []).append(v)
+        return True
+
+    def _update_hops(self, starts):
+        for start in sorted(starts, key=lambda _id: (self.cost.get(_id, -1), _id)):
+            stack = [start]
+            while stack:
+                x = stack.pop()
+                if x in self.prev:
+                    self.hops[x] = self.hops[self.prev[x]] + 1
+                elif x != self.root:
+                    self.hops.pop(x, None)
+                stack.extend(self.children.get(x, ()))
 
-    def lowest_cost(self):
+    def descendants(self, node):
         """
-        Remove and return the lowest cost node ID.
+        Return the list of nodes whose path from the root passes through node (excluding node).
         """
-        _id, cost = self.nodes.pop(0)
-        return _id
+        below = self._below.get(node)
+        if below is None:
+            below = []
+            stack = list(self.children.get(node, ()))
+            while stack:
+                x = stack.pop()
+                below.append(x)
+                stack.extend(self.children.get(x, ()))
+            self._below[node] = below
+        return below
 
-    def set_cost(self, _id, new_cost):
+    def update(self, graph, rgraph, changes):
         """
-        Set the cost for an ID in the NodeSet and re-insert the ID so that the list
-        remains sorted in increasing cost order.
+        Repair the tree after the links in changes (from, to, old-cost, new-cost) were modified.
+        Returns True if any cost or path in the tree changed.
         """
-        index = 0
-        for i, c in self.nodes:
-            if i == _id:
-                break
-            index += 1
-        self.nodes.pop(index)
-
-        index = 0
-        for i, c in self.nodes:
-            if c is None or new_cost < c or (new_cost == c and _id < i):
-                break
-            index += 1
-
-        self.nodes.insert(index, (_id, new_cost))
+        before  = {}      # node => cost before this update (None if unreachable)
+        touched = set()   # nodes whose predecessor may need to be re-evaluated
+        broken  = []      # nodes whose path used a link that got worse or was removed
+        for u, v, old_cost, new_cost in changes:
+            touched.add(v)
+            if self.prev.get(v) == u and (new_cost is None or new_cost > old_cost):
+                broken.append(v)
+
+        ##
+        # Detach the sub-trees below the broken links, then seed each detached node with the
+        # cheapest path through a node that is still attached.
+        ##
+        detached = set(broken)
+        for v in broken:
+            detached.update(self.descendants(v))
+        for x in detached:
+            before.setdefault(x, self.cost.pop(x, None))
+
+        heap = []
+        seeds = []
+        for x in detached:
+            best = None
+            for u, x_cost in rgraph[x].items():
+                if u in self.cost and (best is None or self.cost[u] + x_cost < best):
+                    best = self.cost[u] + x_cost
+            if best is not None:
+                seeds.append((best, x))
+        for best, x in seeds:
+            self.cost[x] = best
+            heapq.heappush(heap, (best, x))
+
+        ##
+        # Links that got cheaper or were added may shorten paths through them
+        ##
+        for u, v, old_cost, new_cost in changes:
+            if new_cost is not None and (old_cost is None or new_cost < old_cost) and u in self.cost:
+                alt = self.cost[u] + new_cost
+                if v != self.root and (v not in self.cost or alt < self.cost[v]):
+                    before.setdefault(v, self.cost.get(v))
+                    self.cost[v] = alt
+                    heapq.heappush(heap, (alt, v))
+        self._relax(graph, heap, before)
+
+        ##
+        # Re-select the predecessor of every node whose own cost, a candidate predecessor's
+        # cost or an incoming link changed.
+        ##
+        changed_cost = [x for x, c in before.items() if c != self.cost.get(x)]
+        candidates = touched | set(changed_cost)
+        for x in changed_cost:
+            candidates.update(graph[x].keys())
+        candidates.discard(self.root)
+
+        moved = [v for v in candidates if self._set_prev(v, self._best_prev(v, rgraph))]
+        if moved:
+            self._update_hops(moved)
+        if moved or changed_cost:
+            self._below = {}
+            return True
+        return False
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "qpid/dispatch.h"
+#include "qpid/dispatch/flight_recorder.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -73,6 +74,15 @@ static void signal_handler(int signum)
     }
 }
 
+/**
+ * SIGUSR2 writes the flight recorder to stderr without disturbing the router
+ */
+static void flight_recorder_signal_handler(int signum)
+{
+    (void) signum;
+    qd_flight_recorder_dump(STDERR_FILENO);  // async signal safe
+}
+
 static void check(int fd) {
     if (qd_error_code()) {
         qd_log(LOG_ROUTER, QD_LOG_CRITICAL, "Router start-up failed: %s", qd_error_message());
@@ -102,6 +112,7 @@ static void main_process(const char *config_path, const char *python_pkgdir, boo
     check(fd);
 
     install_signal_handler(signal_handler);
+    signal(SIGUSR2, flight_recorder_signal_handler);
 
     if (fd > 2) {               /* Daemon mode, fd is one end of a pipe not stdout or stderr */
         dprintf(fd, "ok"); // Success signal
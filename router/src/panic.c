@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include "qpid/dispatch/atomic.h"
+#include "qpid/dispatch/flight_recorder.h"
 #include "qpid/dispatch/threading.h"
 
 #include <assert.h>
@@ -481,6 +482,10 @@ static void panic_signal_handler(int signum, siginfo_t *siginfo, void *ucontext)
         print_backtrace(&context);
     }
 #endif
+
+    // The events leading up to the crash, see flight_recorder.h
+
+    qd_flight_recorder_dump(STDERR_FILENO);
     print("*** END ***\n");
 
     // Restore the default handler. This will cause the kernel to kill the process and produce a core dump when this
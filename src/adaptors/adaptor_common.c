@@ -85,6 +85,7 @@ qd_error_t qd_load_adaptor_config(qdr_core_t *core, qd_adaptor_config_t *config,
     char *observer =            qd_entity_opt_string(entity, "observer", "auto");      CHECK();
     config->observer =          get_listener_observer(observer);
     free(observer);
+    config->observer_sample_interval = qd_entity_opt_long(entity, "observerSampleInterval", 1); CHECK();
     config->backlog =           qd_entity_opt_long(entity, "backlog", 0);
     CHECK();
     if (config->backlog <= 0 || config->backlog > SOMAXCONN)
@@ -53,6 +53,7 @@ struct qd_adaptor_config_t
     char                       *host_port;
     int                         backlog;
     qd_observer_t  observer;
+    int            observer_sample_interval;  // observe one connection in every interval
     //TLS related info
     char                       *ssl_profile_name;
     bool                        authenticate_peer;
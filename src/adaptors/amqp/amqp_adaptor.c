@@ -22,12 +22,14 @@
 #include "qd_connection.h"
 #include "qd_listener.h"
 #include "container.h"
+#include "compression.h"
 #include "node_type.h"
 
 #include "delivery.h"
 #include "dispatch_private.h"
 #include "policy.h"
 #include "router_private.h"
+#include "trace_probes.h"
 
 #include <qpid/dispatch.h>
 #include <qpid/dispatch/protocol_adaptor.h>
@@ -36,6 +38,7 @@
 #include <qpid/dispatch/connection_counters.h>
 #include <qpid/dispatch/amqp_adaptor.h>
 #include <qpid/dispatch/tls_amqp.h>
+#include <qpid/dispatch/timer.h>
 
 #include <proton/sasl.h>
 
@@ -62,6 +65,10 @@ static void deferred_AMQP_rx_handler(void *context, bool discard);
 static bool parse_failover_property_list(qd_router_t *router, qd_connection_t *conn, pn_data_t *props);
 static void clear_producer_activation(qdr_core_t *core, qdr_delivery_t *delivery);
 static void clear_consumer_activation(qdr_core_t *core, qdr_delivery_t *delivery);
+static void AMQP_q3_resume(qd_router_t *router, qd_session_t *qd_ssn, qd_link_t *flowed);
+
+// Q3 blocked links of a session resumed at once at most, see AMQP_q3_resume()
+#define Q3_RESUME_BATCH_MAX 64
 
 const char *QD_AMQP_COND_OVERSIZE_DESCRIPTION = "Message size exceeded";
 
@@ -379,7 +386,7 @@ static int AMQP_conn_wake_handler(qd_router_t *router, qd_connection_t *conn, vo
                 //
                 assert(stream);
                 assert(qlink);
-                qd_message_send(stream, qlink, 0, &q3_stalled);
+                qd_message_send(stream, qlink, 0, 0, &q3_stalled);
                 if (q3_stalled) {
                     qd_link_q3_block(qlink);
                 }
@@ -458,6 +465,15 @@ static int AMQP_conn_wake_handler(qd_router_t *router, qd_connection_t *conn, vo
         }
     }
 
+    if (conn->q3_resume_pending && conn->pn_conn) {
+        conn->q3_resume_pending = false;
+        for (pn_session_t *pn_ssn = pn_session_head(conn->pn_conn, 0); pn_ssn; pn_ssn = pn_session_next(pn_ssn, 0)) {
+            qd_session_t *qd_ssn = qd_session_from_pn(pn_ssn);
+            if (qd_ssn && qd_session_is_q3_blocked(qd_ssn))
+                AMQP_q3_resume(router, qd_ssn, 0);
+        }
+    }
+
     return result;
 }
 
@@ -489,6 +505,18 @@ static qd_iterator_t *process_router_annotations(qd_router_t   *router,
             // the message has already passed through.
             //
             *link_exclusions = qd_tracemask_create(router->tracemask, trace, ingress_index);
+        } else if (qd_message_trace_is_compact(msg)) {
+            uint64_t  stack[32];
+            uint64_t *fingerprints = stack;
+            uint32_t  count        = qd_message_get_trace_fingerprints(msg, stack, 32);
+            if (count > 32) {
+                fingerprints = (uint64_t*) qd_malloc(count * sizeof(uint64_t));
+                qd_message_get_trace_fingerprints(msg, fingerprints, count);
+            }
+            *distance        = count;
+            *link_exclusions = qd_tracemask_create_compact(router->tracemask, fingerprints, count, ingress_index);
+            if (fingerprints != stack)
+                free(fingerprints);
         }
 
         qd_parsed_field_t *ingress = qd_message_get_ingress_router(msg);
@@ -517,6 +545,7 @@ static void log_link_message(qd_connection_t *conn, pn_link_t *pn_link, qd_messa
         char buf[QD_LOG_TEXT_MAX];
         const char *msg_str = qd_message_oversize(msg) ? "oversize message" :
             qd_message_aborted(msg) ? "aborted message" :
+            qd_message_is_pass_through(msg) ? "pass-through message" :
             qd_message_repr(msg, buf, sizeof(buf), cf->message_log_flags);
         if (msg_str) {
             const char *src = pn_terminus_get_address(pn_link_source(pn_link));
@@ -530,13 +559,12 @@ static void log_link_message(qd_connection_t *conn, pn_link_t *pn_link, qd_messa
 
 
 /**
- * Inbound Delivery Handler
+ * Process the current inbound delivery on a link
  *
  * @return true if we've advanced to the next delivery on this link and it is
- * ready for rx processing.  This will cause the container to immediately
- * re-call this function with the next delivery.
+ * ready for rx processing.
  */
-static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
+static bool AMQP_rx_delivery(qd_router_t *router, qd_link_t *link)
 {
     pn_link_t      *pn_link = qd_link_pn(link);
 
@@ -566,6 +594,21 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
     ssize_t octets_received;
     qd_message_t   *msg   = qd_message_receive(pnd, &octets_received);
     bool receive_complete = qd_message_receive_complete(msg);
+    QD_PROBE_MESSAGE_RECEIVE(conn->connection_id, qd_link_link_id(link), delivery ? delivery->delivery_id : 0,
+                             octets_received, receive_complete);
+
+    //
+    // Publish changes to the link's adaptive Q2 state for management
+    //
+    uint32_t q2_limit;
+    uint32_t q2_blocked_count;
+    if (qd_link_q2_stats(link, &q2_limit, &q2_blocked_count)) {
+        qdr_link_t *q2_rlink = (qdr_link_t*) qd_link_get_context(link);
+        if (q2_rlink) {
+            sys_atomic_set(&q2_rlink->q2_limit, q2_limit);
+            sys_atomic_set(&q2_rlink->q2_blocked_count, q2_blocked_count);
+        }
+    }
 
     //
     // Bump LINK metrics if appropriate
@@ -574,6 +617,22 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
         vflow_inc_counter(conn->connector->vflow_record, VFLOW_ATTRIBUTE_OCTETS_REVERSE, (uint64_t) octets_received);
     }
 
+    //
+    // Feed the session incoming window autotuning
+    //
+    if (octets_received > 0) {
+        qd_session_incoming_octets(qd_link_get_session(link), (size_t) octets_received);
+    }
+
+    //
+    // Charge the content against the policy rate limits, CORE_link_flow() holds back the credit of the connection's
+    // links while it is over them
+    //
+    if (conn->rate_limits && (octets_received > 0 || receive_complete)) {
+        (void) qd_policy_rate_charge(conn->rate_limits, octets_received > 0 ? (uint64_t) octets_received : 0,
+                                     receive_complete ? 1 : 0);
+    }
+
     // check if cut-through can be enabled or disabled
     //
     if (!!delivery) {
@@ -713,8 +772,9 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
     // partially, only to validate that we can find the fields we need to route
     // the message.
     //
-    // If per-message tracing is configured then validate the sections
-    // necessary for logging (currently application properties).
+    // If per-message tracing is configured and enabled then validate the
+    // sections necessary for logging (currently application properties),
+    // unless the connection is configured for pass-through forwarding.
     //
     // If the link is anonymous, we must validate through the message
     // properties to find the 'to' field.  If the link is not anonymous, we
@@ -730,10 +790,16 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
     const bool anonymous_link = qdr_link_is_anonymous(rlink);
     const bool check_user     = (conn->policy_settings && !conn->policy_settings->spec.allowUserIdProxy);
     const qd_server_config_t *cf = qd_connection_config(conn);
-    const qd_message_depth_t depth = (cf && cf->message_log_flags != 0) ? QD_DEPTH_APPLICATION_PROPERTIES
+    const bool pass_through   = cf && cf->pass_through;
+    const bool log_message    = cf && cf->message_log_flags != 0 && !pass_through
+                             && qd_log_enabled(LOG_MESSAGE, QD_LOG_DEBUG);
+    const qd_message_depth_t depth = log_message ? QD_DEPTH_APPLICATION_PROPERTIES
         : (anonymous_link || check_user) ? QD_DEPTH_PROPERTIES
         : QD_DEPTH_ROUTER_ANNOTATIONS;
 
+    if (pass_through)
+        qd_message_set_pass_through(msg);
+
     const qd_message_depth_status_t depth_valid = qd_message_check_depth(msg, depth);
     switch (depth_valid) {
     case QD_MESSAGE_DEPTH_INVALID:
@@ -778,7 +844,8 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
     //
     if (check_user) {
         // This connection must not allow proxied user_id
-        qd_iterator_t *userid_iter  = qd_message_field_iterator(msg, QD_FIELD_USER_ID);
+        qd_iterator_storage_t userid_storage;
+        qd_iterator_t *userid_iter  = qd_message_field_iterator_init(&userid_storage, msg, QD_FIELD_USER_ID);
         if (userid_iter) {
             // The user_id property has been specified
             if (qd_iterator_remaining(userid_iter) > 0) {
@@ -956,7 +1023,16 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
 
     if (delivery) {
         qd_link_set_incoming_msg(link, (qd_message_t*) 0);  // msg no longer exclusive to qd_link
-        qdr_node_connect_deliveries(link, delivery, pnd);
+        if (receive_complete && pn_delivery_settled(pnd)) {
+            //
+            // Pre-settled fast path: the core already knows this delivery is settled and no disposition can follow a
+            // pre-settled message that has been completely received.  Settle the proton delivery now rather than
+            // linking it to the qdr_delivery and passing the settlement to the core as a separate update.
+            //
+            pn_delivery_settle(pnd);
+        } else {
+            qdr_node_connect_deliveries(link, delivery, pnd);
+        }
         qdr_delivery_decref(router->router_core, delivery, "release protection of return from deliver");
     } else {
         //
@@ -978,6 +1054,28 @@ static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
 }
 
 
+/**
+ * Inbound Delivery Handler
+ *
+ * Drain every delivery on the link that is ready for rx processing in one pass.  The new receive-complete deliveries
+ * are handed to the core together as a single action when the pass is done rather than one action per delivery.
+ *
+ * @return false since no delivery ready for rx processing is left on the link.
+ */
+static bool AMQP_rx_handler(qd_router_t *router, qd_link_t *link)
+{
+    qdr_link_t *rlink = (qdr_link_t*) qd_link_get_context(link);
+
+    if (rlink)
+        qdr_link_deliver_batch_begin(rlink);
+    while (AMQP_rx_delivery(router, link))
+        ;
+    if (rlink)
+        qdr_link_deliver_batch_flush(rlink);
+    return false;
+}
+
+
 /**
  * Deferred callback for inbound delivery handler
  */
@@ -989,10 +1087,7 @@ static void deferred_AMQP_rx_handler(void *context, bool discard)
         qd_link_t *qdl = safe_deref_qd_link_t(*safe_qdl);
         if (!!qdl && !!qd_link_pn(qdl)) {
             assert(qd_link_direction(qdl) == QD_INCOMING);
-            while (true) {
-                if (!AMQP_rx_handler(amqp_adaptor.router, qdl))
-                    break;
-            }
+            (void) AMQP_rx_handler(amqp_adaptor.router, qdl);
         }
     }
 
@@ -1023,7 +1118,16 @@ static void AMQP_disposition_handler(qd_router_t *router, qd_link_t *link, pn_de
     if (settled && !qdr_delivery_receive_complete(delivery))
         settled = false;
 
-    if (dstate || settled) {
+    if (dstate == PN_RECEIVED && !settled) {
+        //
+        // Fast path for the constant acknowledgements of streaming deliveries: the section counters are passed by
+        // value, no delivery state is allocated
+        //
+        pn_disposition_t *disp = pn_delivery_remote(pnd);
+        qdr_delivery_remote_received_updated(router->router_core, delivery,
+                                             pn_disposition_get_section_number(disp),
+                                             pn_disposition_get_section_offset(disp));
+    } else if (dstate || settled) {
         //
         // Update the disposition of the delivery
         //
@@ -1122,6 +1226,91 @@ static int AMQP_link_attach_handler(qd_router_t *router, qd_link_t *link)
 }
 
 
+/**
+ * Resume the next batch of the Q3 blocked links of a session, if the session has the outgoing capacity for them (see
+ * qd_session_q3_resume_links()).  Releasing every blocked link at once lets them all race to refill the session, which
+ * blocks again at once.  The core is told of the batch with one flow action, which re-activates the links that have
+ * deliveries to send.  If links are left blocked, the next batch is tried at the next activation of the connection,
+ * once the output of this batch has been written.
+ *
+ * @param flowed A link whose flow has already been passed to the core, or 0
+ */
+static void AMQP_q3_resume(qd_router_t *router, qd_session_t *qd_ssn, qd_link_t *flowed)
+{
+    qd_link_t *blinks[Q3_RESUME_BATCH_MAX];
+    int        count = qd_session_q3_resume_links(qd_ssn, blinks, Q3_RESUME_BATCH_MAX);
+    if (count == 0)
+        return;
+
+    qd_metric_inc(amqp_adaptor.q3_resumes, 1);
+
+    qdr_link_t      *rlinks[Q3_RESUME_BATCH_MAX];
+    int              credits[Q3_RESUME_BATCH_MAX];
+    bool             drains[Q3_RESUME_BATCH_MAX];
+    int              flows = 0;
+    qd_connection_t *conn  = qd_link_connection(blinks[0]);
+
+    for (int i = 0; i < count; i++) {
+        qd_link_t *blink  = blinks[i];
+        pn_link_t *pnlink = qd_link_pn(blink);
+        if (blink != flowed) {
+            qdr_link_t *rlink = (qdr_link_t *) qd_link_get_context(blink);
+            if (rlink) {
+                // signalling flow to the core causes the link to be re-activated
+                rlinks[flows]  = rlink;
+                credits[flows] = pn_link_remote_credit(pnlink);
+                drains[flows]  = pn_link_get_drain(pnlink);
+                flows++;
+            }
+        }
+
+        pn_delivery_t *pdlv = pn_link_current(pnlink);
+        if (!!pdlv) {
+            qdr_delivery_t     *qdlv = qdr_node_delivery_qdr_from_pn(pdlv);
+            //
+            //https://github.com/skupperproject/skupper-router/issues/1221
+            // Add the delivery/delivery_ref to the outbound_cutthrough_worklist
+            // only if the delivery is a cut-through delivery.
+            // Pure all-AMQP deliveries/delivery_refs will never be cut-through and hence will never be placed
+            // on the conn->outbound_cutthrough_worklist.
+            //
+            if (qdr_delivery_is_unicast_cutthrough(qdlv)) {
+                qdr_delivery_ref_t *dref = new_qdr_delivery_ref_t();
+                bool used = false;
+
+                sys_spinlock_lock(&conn->outbound_cutthrough_spinlock);
+                if (!qdlv->cutthrough_list_ref) {
+                    DEQ_ITEM_INIT(dref);
+                    dref->dlv = qdlv;
+                    qdlv->cutthrough_list_ref = dref;
+                    DEQ_INSERT_TAIL(conn->outbound_cutthrough_worklist, dref);
+                    qdr_delivery_incref(qdlv, "Recover from Q3 stall");
+                    used = true;
+                }
+                sys_spinlock_unlock(&conn->outbound_cutthrough_spinlock);
+
+                if (!used) {
+                    free_qdr_delivery_ref_t(dref);
+                }
+            }
+        }
+    }
+
+    qdr_link_flow_batch(router->router_core, rlinks, credits, drains, flows);
+
+    //
+    // Wake the connection for outgoing cut-through
+    //
+    SET_ATOMIC_FLAG(&conn->wake_cutthrough_outbound);
+    AMQP_conn_wake_handler(router, conn, 0);
+
+    if (qd_session_is_q3_blocked(qd_ssn) && !conn->q3_resume_pending) {
+        conn->q3_resume_pending = true;
+        qd_connection_activate(conn);
+    }
+}
+
+
 /**
  * Handler for flow events on links.  Flow updates include session window
  * state, which needs to be checked for unblocking Q3.
@@ -1137,67 +1326,8 @@ static int AMQP_link_flow_handler(qd_router_t *router, qd_link_t *link)
 
     // check if Q3 can be unblocked
     qd_session_t *qd_ssn = qd_link_get_session(link);
-    if (qd_session_is_q3_blocked(qd_ssn)) {
-        // Q3 blocked - have we drained enough outgoing bytes?
-        if (qd_session_get_outgoing_capacity(qd_ssn) >= qd_session_get_outgoing_capacity_low_threshold(qd_ssn)) {
-            // yes.  We must now unblock all links that have been blocked by Q3
-
-            qd_link_list_t  *blinks = qd_session_q3_blocked_links(qd_ssn);
-            qd_link_t       *blink  = DEQ_HEAD(*blinks);
-            qd_connection_t *conn   = qd_link_connection(blink);
-
-            while (blink) {
-                qd_link_q3_unblock(blink);  // removes from blinks list!
-                pnlink = qd_link_pn(blink);
-                if (blink != link) {        // already flowed this link
-                    rlink = (qdr_link_t *) qd_link_get_context(blink);
-                    if (rlink) {
-                        // signalling flow to the core causes the link to be re-activated
-                        qdr_link_flow(router->router_core, rlink, pn_link_remote_credit(pnlink), pn_link_get_drain(pnlink));
-                    }
-                }
-
-                pn_delivery_t *pdlv = pn_link_current(pnlink);
-                if (!!pdlv) {
-                    qdr_delivery_t     *qdlv = qdr_node_delivery_qdr_from_pn(pdlv);
-                    //
-                    //https://github.com/skupperproject/skupper-router/issues/1221
-                    // Add the delivery/delivery_ref to the outbound_cutthrough_worklist
-                    // only if the delivery is a cut-through delivery.
-                    // Pure all-AMQP deliveries/delivery_refs will never be cut-through and hence will never be placed
-                    // on the conn->outbound_cutthrough_worklist.
-                    //
-                    if (qdr_delivery_is_unicast_cutthrough(qdlv)) {
-                        qdr_delivery_ref_t *dref = new_qdr_delivery_ref_t();
-                        bool used = false;
-
-                        sys_spinlock_lock(&conn->outbound_cutthrough_spinlock);
-                        if (!qdlv->cutthrough_list_ref) {
-                            DEQ_ITEM_INIT(dref);
-                            dref->dlv = qdlv;
-                            qdlv->cutthrough_list_ref = dref;
-                            DEQ_INSERT_TAIL(conn->outbound_cutthrough_worklist, dref);
-                            qdr_delivery_incref(qdlv, "Recover from Q3 stall");
-                            used = true;
-                        }
-                        sys_spinlock_unlock(&conn->outbound_cutthrough_spinlock);
-
-                        if (!used) {
-                            free_qdr_delivery_ref_t(dref);
-                        }
-                    }
-                }
-
-                blink = DEQ_HEAD(*blinks);
-            }
-
-            //
-            // Wake the connection for outgoing cut-through
-            //
-            SET_ATOMIC_FLAG(&conn->wake_cutthrough_outbound);
-            AMQP_conn_wake_handler(router, conn, 0);
-        }
-    }
+    if (qd_session_is_q3_blocked(qd_ssn))
+        AMQP_q3_resume(router, qd_ssn, link);
     return 0;
 }
 
@@ -1445,7 +1575,7 @@ static void AMQP_opened_handler(qd_router_t *router, qd_connection_t *conn, bool
         if (pn_data_next(props) && pn_data_type(props) == PN_MAP) {
 
             const size_t num_items   = pn_data_get_map(props);
-            const int    max_props   = 8;  // total possible props
+            const int    max_props   = 9;  // total possible props
             int          props_found = 0;  // once all props found exit loop
 
             pn_data_enter(props);
@@ -1530,6 +1660,23 @@ static void AMQP_opened_handler(qd_router_t *router, qd_connection_t *conn, bool
                         const int annos_version = (int) pn_data_get_int(props);
                         qd_log(LOG_ROUTER, QD_LOG_DEBUG, "Remote router annotations version: %d",
                                annos_version);
+                        // version 3 routers carry the trace as compact fingerprints, see router-annotations.adoc
+                        conn->compact_trace = annos_version >= 3;
+                    }
+
+                } else if ((key.size == strlen(QD_CONNECTION_PROPERTY_COMPRESSION_KEY)
+                           && strncmp(key.start, QD_CONNECTION_PROPERTY_COMPRESSION_KEY, key.size) == 0)) {
+                    props_found += 1;
+                    if (!pn_data_next(props)) break;
+                    // used if this end offered it too, see qd_connection.c
+                    const qd_server_config_t *config = qd_connection_config(conn);
+                    if ((is_router || role == QDR_ROLE_INTER_ROUTER_DATA) && pn_data_type(props) == PN_STRING
+                        && config && config->compression && qd_compression_available()) {
+                        pn_bytes_t value = pn_data_get_string(props);
+                        conn->compression = value.size == strlen(QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE)
+                            && strncmp(value.start, QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE, value.size) == 0;
+                        qd_log(LOG_ROUTER, QD_LOG_DEBUG, "[C%" PRIu64 "] Transfer compression %s", connection_id,
+                               conn->compression ? "enabled" : "not supported by the remote router");
                     }
 
                 } else if ((key.size == strlen(QD_CONNECTION_PROPERTY_ACCESS_ID)
@@ -1575,6 +1722,7 @@ static void AMQP_opened_handler(qd_router_t *router, qd_connection_t *conn, bool
         mech = pn_sasl_get_mech(sasl);
 
     if (conn->ssl) {
+        qd_tls_session_record_handshake(conn->ssl);
         proto = qd_tls_session_get_protocol_version(conn->ssl);
         cipher = qd_tls_session_get_protocol_ciphers(conn->ssl);
         ssl_ssf = qd_tls_session_get_ssf(conn->ssl);
@@ -1805,9 +1953,10 @@ static int AMQP_closed_handler(qd_router_t *router, qd_connection_t *conn, void
     qdr_connection_t *qdrc   = (qdr_connection_t*) qd_connection_get_context(conn);
 
     if (qdrc) {
-        sys_mutex_lock(qd_server_get_activation_lock(router->qd->server));
+        sys_mutex_t *activation_lock = qd_server_get_activation_lock(router->qd->server, qdrc->identity);
+        sys_mutex_lock(activation_lock);
         qdr_connection_set_context(qdrc, 0);
-        sys_mutex_unlock(qd_server_get_activation_lock(router->qd->server));
+        sys_mutex_unlock(activation_lock);
 
         if (qdrc->role == QDR_ROLE_NORMAL) {
             qd_connection_counter_dec(QD_PROTOCOL_AMQP);
@@ -1847,14 +1996,19 @@ static void CORE_connection_activate(void *context, qdr_connection_t *conn)
     //
     // IMPORTANT:  This is the only core callback that is invoked on the core
     //             thread itself. It must not take locks that could deadlock the core.
+    //             It is also invoked on the connection's own IO thread when
+    //             qdr_connection_process holds work back for a later pass.
     //
 
-    sys_mutex_lock(qd_server_get_activation_lock(router->qd->server));
+    // The identity of the qdr_connection_t is the connection_id of its qd_connection_t, so this is the lock
+    // AMQP_closed_handler takes before it clears the context.
+    sys_mutex_t *activation_lock = qd_server_get_activation_lock(router->qd->server, conn->identity);
+    sys_mutex_lock(activation_lock);
     qd_connection_t *ctx = (qd_connection_t*) qdr_connection_get_context(conn);
     if (!!ctx && !SET_ATOMIC_FLAG(&ctx->wake_core)) {
         qd_connection_activate(ctx);
     }
-    sys_mutex_unlock(qd_server_get_activation_lock(router->qd->server));
+    sys_mutex_unlock(activation_lock);
 }
 
 
@@ -2003,6 +2157,49 @@ static void CORE_link_detach(void *context, qdr_link_t *link, qdr_error_t *error
 }
 
 
+static void deferred_release_held_credit(void *context, bool discard);
+
+static void on_throttle_timer(void *context)
+{
+    qd_connection_t *conn = (qd_connection_t*) context;
+    qd_connection_invoke_deferred(conn, deferred_release_held_credit, conn);
+}
+
+
+static void throttle_connection(qd_connection_t *conn, uint64_t delay_ns)
+{
+    if (!conn->throttle_timer)
+        conn->throttle_timer = qd_timer(amqp_adaptor.dispatch, on_throttle_timer, conn);
+    qd_timer_schedule(conn->throttle_timer, MAX(delay_ns / 1000000, 1));
+}
+
+
+/**
+ * Issue the credit held back from the links of a connection once it is no longer over its policy rate limits
+ */
+static void deferred_release_held_credit(void *context, bool discard)
+{
+    qd_connection_t *conn = (qd_connection_t*) context;
+    if (discard || !conn->pn_conn)
+        return;
+
+    const uint64_t delay_ns = qd_policy_rate_charge(conn->rate_limits, 0, 0);
+    if (delay_ns) {
+        throttle_connection(conn, delay_ns);
+        return;
+    }
+
+    for (pn_link_t *plink = pn_link_head(conn->pn_conn, 0); plink; plink = pn_link_next(plink, 0)) {
+        qd_link_t *qlink = (qd_link_t*) pn_link_get_context(plink);
+        if (qlink && qd_link_direction(qlink) == QD_INCOMING) {
+            const int credit = qd_link_take_held_credit(qlink);
+            if (credit > 0)
+                pn_link_flow(plink, credit);
+        }
+    }
+}
+
+
 static void CORE_link_flow(void *context, qdr_link_t *link, int credit)
 {
     qd_link_t *qlink = (qd_link_t*) qdr_link_get_context(link);
@@ -2010,9 +2207,24 @@ static void CORE_link_flow(void *context, qdr_link_t *link, int credit)
         return;
 
     pn_link_t *plink = qd_link_pn(qlink);
+    if (!plink)
+        return;
 
-    if (plink)
-        pn_link_flow(plink, credit);
+    //
+    // A connection over its policy rate limits gets no credit until it is back within them
+    //
+    qd_connection_t *conn = qd_link_connection(qlink);
+    if (conn && conn->rate_limits && credit > 0) {
+        const uint64_t delay_ns = qd_policy_rate_charge(conn->rate_limits, 0, 0);
+        if (delay_ns) {
+            qd_link_hold_credit(qlink, credit);
+            throttle_connection(conn, delay_ns);
+            return;
+        }
+        credit += qd_link_take_held_credit(qlink);
+    }
+
+    pn_link_flow(plink, credit);
 }
 
 
@@ -2116,10 +2328,11 @@ static uint64_t CORE_link_deliver(void *context, qdr_link_t *link, qdr_delivery_
         pdlv = pn_link_current(plink);
 
         // handle any delivery-state on the transfer e.g. transactional-state
-        qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(dlv, &disposition);
+        qd_delivery_state_t  received;
+        qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(dlv, &disposition, &received);
         if (disposition) {
-            if (dstate)
-                qd_delivery_write_local_state(pdlv, disposition, dstate);
+            if (dstate || disposition == PN_RECEIVED)
+                qd_delivery_write_local_state(pdlv, disposition, disposition == PN_RECEIVED ? &received : dstate);
             pn_delivery_update(pdlv, disposition);
         }
         qd_delivery_state_free(dstate);
@@ -2155,8 +2368,10 @@ static uint64_t CORE_link_deliver(void *context, qdr_link_t *link, qdr_delivery_
         : router->router_mode == QD_ROUTER_MODE_EDGE ? (QD_MESSAGE_RA_STRIP_INGRESS | QD_MESSAGE_RA_STRIP_TRACE)
         : QD_MESSAGE_RA_STRIP_NONE;
 
-    octets_sent = qd_message_send(msg_out, qlink, ra_flags, &q3_stalled);
+    const size_t quantum = router->qd->transfer_quantum_octets;
+    octets_sent = qd_message_send(msg_out, qlink, ra_flags, quantum, &q3_stalled);
     bool send_complete = qdr_delivery_send_complete(dlv);
+    QD_PROBE_MESSAGE_SEND(qconn->connection_id, qd_link_link_id(qlink), dlv->delivery_id, octets_sent, send_complete);
 
     //
     // Bump LINK metrics if appropriate
@@ -2181,6 +2396,12 @@ static uint64_t CORE_link_deliver(void *context, qdr_link_t *link, qdr_delivery_
     if (q3_stalled) {
         qd_link_q3_block(qlink);
         qdr_link_stalled_outbound(link);
+    } else if (!send_complete && quantum && octets_sent >= quantum) {
+        //
+        // Used up the transfer quantum with more of the message ready to go: let the other links
+        // of the connection send before this one continues.
+        //
+        qdr_link_yield_outbound(link);
     }
 
     if (send_complete) {
@@ -2258,13 +2479,15 @@ static void CORE_delivery_update(void *context, qdr_delivery_t *dlv, uint64_t di
         return;
 
     if (disp && !pn_delivery_settled(pnd)) {
-        uint64_t ignore = 0;
-        qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(dlv, &ignore);
+        uint64_t             taken = 0;
+        qd_delivery_state_t  received;
+        qd_delivery_state_t *dstate       = qdr_delivery_take_local_delivery_state(dlv, &taken, &received);
+        const bool           new_received = disp == PN_RECEIVED && taken == PN_RECEIVED;
 
         // update if the disposition has changed or there is new state associated with it
-        if (disp != pn_delivery_local_state(pnd) || dstate) {
+        if (disp != pn_delivery_local_state(pnd) || dstate || new_received) {
             // handle propagation of delivery state from qdr_delivery_t to proton:
-            qd_delivery_write_local_state(pnd, disp, dstate);
+            qd_delivery_write_local_state(pnd, disp, new_received ? &received : dstate);
             pn_delivery_update(pnd, disp);
             qd_delivery_state_free(dstate);
             if (disp == PN_MODIFIED)  // @TODO(kgiusti) why do we need this???
@@ -2362,6 +2585,9 @@ static void qd_amqp_adaptor_init(qdr_core_t *core, void **adaptor_context)
     assert(qd->router);  // ensure router has been initialized first
     amqp_adaptor.router  = qd->router;
     amqp_adaptor.container = qd_container(qd->router, &router_node);
+    amqp_adaptor.q3_blocks       = qd_metric(QD_METRIC_COUNTER, "qdr_amqp_session_q3_blocked_total", 0, 0);
+    amqp_adaptor.q3_oscillations = qd_metric(QD_METRIC_COUNTER, "qdr_amqp_session_q3_oscillations_total", 0, 0);
+    amqp_adaptor.q3_resumes      = qd_metric(QD_METRIC_COUNTER, "qdr_amqp_session_q3_resume_batches_total", 0, 0);
     amqp_adaptor.adaptor = qdr_protocol_adaptor(core,
                                                         "amqp",
                                                         (void*) amqp_adaptor.router,
@@ -2402,6 +2628,7 @@ static void qd_amqp_adaptor_final(void *adaptor_context)
                 pn_transport_set_context(tport, 0); /* for transport_tracer */
             pn_connection_set_context(ctx->pn_conn, 0);
         }
+        qd_timer_free(ctx->throttle_timer);
         qd_connection_invoke_deferred_calls(ctx, true);  // Discard any pending deferred calls
         free(ctx->user_id);
         sys_mutex_free(&ctx->deferred_call_lock);
@@ -2409,6 +2636,7 @@ static void qd_amqp_adaptor_final(void *adaptor_context)
         free(ctx->role);
         if (ctx->policy_settings)
             qd_policy_settings_free(ctx->policy_settings);
+        qd_policy_rate_limits_free(ctx->rate_limits);
         if (ctx->connector) {
             qd_connector_remove_connection(ctx->connector, true, 0, 0);
             ctx->connector = 0;
@@ -2436,6 +2664,9 @@ static void qd_amqp_adaptor_final(void *adaptor_context)
 
     qdr_protocol_adaptor_free(amqp_adaptor.core, amqp_adaptor.adaptor);
     qd_container_free(amqp_adaptor.container);
+    qd_metric_free(amqp_adaptor.q3_blocks);
+    qd_metric_free(amqp_adaptor.q3_oscillations);
+    qd_metric_free(amqp_adaptor.q3_resumes);
 
     memset(&amqp_adaptor, 0, sizeof(amqp_adaptor));
 }
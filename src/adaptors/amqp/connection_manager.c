@@ -265,7 +265,8 @@ QD_EXPORT qd_error_t qd_entity_refresh_connector(qd_entity_t* entity, void *impl
         // stop updating entity on first failure to capture the error code
         if (qd_entity_set_string(entity, "failoverUrls", failover_info) == 0
             && qd_entity_set_string(entity, "connectionStatus", state_info) == 0
-            && qd_entity_set_string(entity, "connectionMsg", connector->conn_msg) == 0) {
+            && qd_entity_set_string(entity, "connectionMsg", connector->conn_msg) == 0
+            && qd_entity_set_long(entity, "lastConnectMilliseconds", connector->last_connect_msec) == 0) {
             // error code not set - nothing to do
         }
 
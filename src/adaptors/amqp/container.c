@@ -18,26 +18,32 @@
  */
 
 #include "container.h"
+#include "compression.h"
 
 #include "policy.h"
 #include "qd_connection.h"
+#include "qd_connector.h"
 #include "node_type.h"
 #include "private.h"
 
 #include "qpid/dispatch/amqp.h"
 #include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/flight_recorder.h"
 #include "qpid/dispatch/hash.h"
 #include "qpid/dispatch/iterator.h"
 #include "qpid/dispatch/log.h"
 #include "qpid/dispatch/message.h"
+#include "qpid/dispatch/router_core.h"
 #include "qpid/dispatch/server.h"
 #include "qpid/dispatch/threading.h"
+#include "qpid/dispatch/timer.h"
 #include "qpid/dispatch/amqp_adaptor.h"
 
 #include <proton/connection.h>
 #include <proton/engine.h>
 #include <proton/event.h>
 #include <proton/message.h>
+#include <proton/object.h>
 
 #include <inttypes.h>
 #include <stdio.h>
@@ -57,14 +63,22 @@ struct qd_link_t {
     DEQ_LINKS_N(Q3, qd_link_t); ///< Q3 blocked links
     uint64_t                    link_id;
     bool                        q2_limit_unbounded;
+    bool                        q2_stats_changed;  // since the last qd_link_q2_stats()
+    uint32_t                    q2_upper;          // adaptive Q2 upper limit, 0: QD_QLIMIT_Q2_UPPER
+    uint32_t                    q2_blocked_count;  // times an incoming message was held off by Q2
     bool                        q3_blocked;
     bool                        policy_counted;  // has this been counted by policy?
+    int                         held_credit;     // credit held back by the connection's policy rate limits
+    qd_message_ra_cache_t      *ra_cache;        // last router annotations sent, see qd_message_send()
+    qd_compression_t           *compression;     // compression context if the connection compresses transfers
+    bool                        stream_counted;  // counted by the data connector of the connection
 };
 
 ALLOC_DEFINE_SAFE(qd_link_t);
 ALLOC_DEFINE(qd_link_ref_t);
 
 static void qd_link_free(qd_link_t *);
+static void count_stream_link(qd_link_t *link, qd_connection_t *conn);
 
 
 /** Encapsulates a proton session */
@@ -72,7 +86,9 @@ struct qd_session_t {
     DEQ_LINKS(qd_session_t);
     sys_atomic_t    ref_count;
     pn_session_t   *pn_session;
-    qd_link_list_t  q3_blocked_links;  ///< Q3 blocked if !empty
+    qd_link_list_t  q3_blocked_links;  ///< Q3 blocked if !empty, in the order the links are to resume
+    qd_timestamp_t  q3_left;           ///< when the last Q3 blocked link resumed, 0: never
+    bool            q3_resuming;       ///< blocked links are resuming in batches, see qd_session_q3_resume_links()
 
     // remotes maximum incoming frame size in bytes (see AMQP 1.0 Open Performative)
     uint32_t remote_max_frame;
@@ -83,10 +99,22 @@ struct qd_session_t {
     // Session outgoing flow control: Stop writing outgoing data (calling pn_link_send()) to the session when the total
     // number of buffered bytes has exceeded the high threshold (see Proton pn_session_outgoing_bytes()). Resume writing
     // data when the session has sent enough data to reduce the number of buffered output bytes to below the low
-    // threshold. This prevents the router from buffering too much output data before allowing Proton to write it out.
-    // See qd_session_get_outgoing_capacity() for details.
+    // threshold (half the high threshold). This prevents the router from buffering too much output data before allowing
+    // Proton to write it out. The high threshold adapts between outgoing_bytes_min_threshold and the remote window, see
+    // qd_session_q3_unblocked(). See qd_session_get_outgoing_capacity() for details.
     size_t outgoing_bytes_high_threshold;
-    size_t outgoing_bytes_low_threshold;
+    size_t outgoing_bytes_min_threshold;
+
+    // Local incoming window in frames. When autotuned it moves between in_window_min and in_window_max following the
+    // bytes received in each sample period, see qd_session_incoming_octets(). Only touched by the I/O thread.
+    uint32_t        local_max_frame;
+    uint32_t        in_window;
+    uint32_t        in_window_min;
+    uint32_t        in_window_max;
+    uint32_t        in_window_idle_samples;
+    size_t          in_window_octets;
+    qd_timestamp_t  in_window_sample_start;
+    bool            in_window_auto;
 
     // Has this session been counted by policy? Only remotely initiated sessions can be counted by policy
     bool policy_counted;
@@ -107,6 +135,24 @@ struct qd_session_t {
 const size_t qd_session_incoming_window_normal  = (size_t) 8388608;    // window for role=normal connections (8MB)
 const size_t qd_session_incoming_window_router  = (size_t) 134217728;  // window for inter-router connections (128MB)
 
+// When maxSessionFrames is not configured the default window above is only the upper limit. A session starts at
+// 1/QD_SESSION_WINDOW_AUTO_DIVISOR of it, doubles whenever it receives a full window within one sample period and halves
+// after QD_SESSION_WINDOW_IDLE_SAMPLES periods using less than 1/8 of the window or while memory is under pressure, so
+// only busy sessions hold large windows.
+#define QD_SESSION_WINDOW_AUTO_DIVISOR  8
+#define QD_SESSION_WINDOW_SAMPLE_MSEC   1000
+#define QD_SESSION_WINDOW_IDLE_SAMPLES  4
+
+// Limits of the adaptive outgoing buffering threshold. The minimum comes from the old Q3 session byte limit.
+#define QD_SESSION_OUTGOING_MIN_BYTES  ((size_t) 1048576)
+#define QD_SESSION_OUTGOING_MAX_BYTES  ((size_t) 16777216)
+
+// Outgoing capacity a resumed Q3 blocked link is expected to fill before it blocks again, sizes the resume batches
+#define QD_SESSION_Q3_LINK_OCTETS  ((size_t) 65536)
+
+// A session that enters Q3 again within this time of leaving it is counted as oscillating
+#define QD_SESSION_Q3_OSCILLATION_MSEC 100
+
 
 // Can we leverage the new Proton Session Window API?
 //
@@ -143,16 +189,20 @@ struct qd_container_t {
 };
 
 qd_session_t *qd_session(pn_session_t *pn_ssn);
-static void qd_session_configure_incoming_window(qd_session_t *qd_ssn, uint32_t in_window);
+static void qd_session_configure_incoming_window(qd_session_t *qd_ssn, uint32_t in_window, bool autotune);
 
 #if USE_PN_SESSION_WINDOWS
 // Access to the remote incoming window was added in Proton 0.40.0
 static void qd_session_set_remote_incoming_window(qd_session_t *qd_ssn, uint32_t in_window);
 #endif
 
-static inline qd_session_t *qd_session_from_pn(pn_session_t *pn_ssn)
+// Condition description of the client connections and links refused while the router is overloaded
+#define OVERLOAD_DESCRIPTION "Router overloaded, retry later"
+
+// Client connections are refused under memory pressure or overload, inter-router and edge connections are not
+static inline bool is_client_connection(const qd_connection_t *qd_conn)
 {
-    return (qd_session_t *)pn_session_get_context(pn_ssn);
+    return !qd_conn->role || !strcmp(qd_conn->role, "normal");
 }
 
 static qd_link_t *setup_outgoing_link(qd_container_t *container, pn_link_t *pn_link)
@@ -180,6 +230,7 @@ static qd_link_t *setup_outgoing_link(qd_container_t *container, pn_link_t *pn_l
     qd_session_incref(link->qd_session);
 
     pn_link_set_context(pn_link, link);
+    count_stream_link(link, qd_link_connection(link));
     container->ntype->outgoing_link_handler(container->qd_router, link);
     return link;
 }
@@ -212,6 +263,7 @@ static qd_link_t *setup_incoming_link(qd_container_t *container, pn_link_t *pn_l
         pn_link_set_max_message_size(pn_link, max_size);
     }
     pn_link_set_context(pn_link, link);
+    count_stream_link(link, qd_link_connection(link));
     container->ntype->incoming_link_handler(container->qd_router, link);
     return link;
 }
@@ -325,6 +377,11 @@ static void cleanup_link(qd_link_t *link)
             qd_nullify_safe_ptr(&link->incoming_msg);
             qd_message_free(msg);
         }
+
+        qd_message_ra_cache_free(link->ra_cache);
+        link->ra_cache = 0;
+        qd_compression_free(link->compression);
+        link->compression = 0;
     }
 }
 
@@ -349,29 +406,27 @@ static void writable_handler(qd_container_t *container, pn_connection_t *conn, q
 }
 
 
+// Marks a pn_link_t that is already on its connection's free_link_list. The link is freed (or released along with its
+// connection) when the list is drained so the mark never needs to be cleared.
+PN_HANDLE(QD_FREE_LINK_LISTED)
+
 /**
- * Returns true if the free_link already exists in free_link_list, false otherwise
+ * Queue the link to be freed at the end of the event batch. A link may be queued more than once (e.g. on both the
+ * remote and the local close) but appears on the list only once. The membership check is constant time so that
+ * closing a connection with many links does not become quadratic.
  */
-static bool link_exists(qd_pn_free_link_list_t *free_list, pn_link_t *free_link)
-{
-    qd_pn_free_link_t *free_item = DEQ_HEAD(*free_list);
-    while(free_item) {
-        if (free_item->pn_link == free_link)
-            return true;
-        free_item = DEQ_NEXT(free_item);
-    }
-    return false;
-}
-
 static void add_link_to_free_list(qd_pn_free_link_list_t *free_link_list, pn_link_t *pn_link)
 {
-    if (!link_exists(free_link_list, pn_link)) {
+    pn_record_t *record = pn_link_attachments(pn_link);
+    if (!pn_record_has(record, QD_FREE_LINK_LISTED)) {
+        pn_record_def(record, QD_FREE_LINK_LISTED, PN_VOID);
+        pn_record_set(record, QD_FREE_LINK_LISTED, (void *) 1);
+
         qd_pn_free_link_t *to_free = new_qd_pn_free_link_t();
         DEQ_ITEM_INIT(to_free);
         to_free->pn_link = pn_link;
         DEQ_INSERT_TAIL(*free_link_list, to_free);
     }
-
 }
 
 
@@ -433,6 +488,27 @@ void qd_container_handle_event(qd_container_t *container, pn_event_t *event,
              * connection since by stalling the current connection it will never be
              * run, so we need some other thread context to run it in.
              */
+            if (qd_alloc_memory_state() >= QD_MEMORY_REFUSE_CONNECTIONS && is_client_connection(qd_conn)) {
+                // Out of memory budget: refuse clients, inter-router and edge connections are still accepted so
+                // the network stays connected while it drains
+                qd_log(LOG_SERVER, QD_LOG_WARNING,
+                       "[C%" PRIu64 "] Connection refused: router memory budget exceeded", qd_conn->connection_id);
+                pn_condition_t *cond = pn_connection_condition(conn);
+                (void) pn_condition_set_name(cond, QD_AMQP_COND_RESOURCE_LIMIT_EXCEEDED);
+                (void) pn_condition_set_description(cond, "Router memory budget exceeded");
+                pn_connection_close(conn);
+                break;
+            }
+            if (is_client_connection(qd_conn) && qdr_core_overloaded(amqp_adaptor.core)) {
+                qd_log(LOG_SERVER, QD_LOG_WARNING, "[C%" PRIu64 "] Connection refused: router overloaded",
+                       qd_conn->connection_id);
+                qdr_core_overload_refused(amqp_adaptor.core, QDR_OVERLOAD_REFUSED_CONNECTION);
+                pn_condition_t *cond = pn_connection_condition(conn);
+                (void) pn_condition_set_name(cond, QD_AMQP_COND_RESOURCE_LIMIT_EXCEEDED);
+                (void) pn_condition_set_description(cond, OVERLOAD_DESCRIPTION);
+                pn_connection_close(conn);
+                break;
+            }
             qd_policy_amqp_open(qd_conn);
         } else {
             // This Open is in response to an internally initiated connection
@@ -487,7 +563,10 @@ void qd_container_handle_event(qd_container_t *container, pn_event_t *event,
                 DEQ_INSERT_TAIL(qd_conn->child_sessions, qd_ssn);
                 uint32_t in_window;
                 qd_policy_get_session_settings(qd_conn, &in_window);
-                qd_session_configure_incoming_window(qd_ssn, in_window);
+                // a window set by policy is used as is
+                const qd_server_config_t *cf = qd_connection_config(qd_conn);
+                qd_session_configure_incoming_window(qd_ssn, in_window,
+                                                     cf->session_in_window_auto && in_window == cf->session_max_in_window);
                 pn_session_open(qd_ssn->pn_session);
             }
 #if USE_PN_SESSION_WINDOWS
@@ -560,6 +639,16 @@ void qd_container_handle_event(qd_container_t *container, pn_event_t *event,
         if (!(pn_connection_state(conn) & PN_LOCAL_CLOSED)) {
             pn_link = pn_event_link(event);
             if (pn_link_state(pn_link) & PN_LOCAL_UNINIT) {
+                if (is_client_connection(qd_conn) && qdr_core_overloaded(amqp_adaptor.core)) {
+                    qd_log(LOG_SERVER, QD_LOG_WARNING, "[C%" PRIu64 "] Link '%s' refused: router overloaded",
+                           qd_conn->connection_id, pn_link_name(pn_link));
+                    qdr_core_overload_refused(amqp_adaptor.core, QDR_OVERLOAD_REFUSED_LINK);
+                    pn_condition_t *cond = pn_link_condition(pn_link);
+                    (void) pn_condition_set_name(cond, QD_AMQP_COND_RESOURCE_LIMIT_EXCEEDED);
+                    (void) pn_condition_set_description(cond, OVERLOAD_DESCRIPTION);
+                    pn_link_close(pn_link);
+                    break;
+                }
                 bool policy_counted = false;
                 if (pn_link_is_sender(pn_link)) {
                     if (qd_conn->policy_settings) {
@@ -754,7 +843,7 @@ qd_link_t *qd_link(qd_connection_t *conn, qd_direction_t dir, const char* name,
         DEQ_INSERT_TAIL(conn->child_sessions, qd_ssn);
         conn->qd_sessions[ssn_class] = qd_ssn;
         qd_session_incref(qd_ssn);
-        qd_session_configure_incoming_window(qd_ssn, cf->session_max_in_window);
+        qd_session_configure_incoming_window(qd_ssn, cf->session_max_in_window, cf->session_in_window_auto);
         pn_session_open(qd_ssn->pn_session);
     }
 
@@ -780,15 +869,30 @@ qd_link_t *qd_link(qd_connection_t *conn, qd_direction_t dir, const char* name,
     link->remote_snd_settle_mode = pn_link_remote_snd_settle_mode(link->pn_link);
 
     pn_link_set_context(link->pn_link, link);
+    count_stream_link(link, conn);
 
     return link;
 }
 
 
+// Data connections carry only streaming links: count them so a connection carrying a quiet stream is not retired
+static void count_stream_link(qd_link_t *link, qd_connection_t *conn)
+{
+    if (conn && conn->connector)
+        link->stream_counted = qd_connector_stream_link_attached(conn->connector);
+}
+
+
 static void qd_link_free(qd_link_t *link)
 {
     if (!link) return;
 
+    if (link->stream_counted) {
+        qd_connection_t *conn = qd_link_connection(link);
+        if (conn && conn->connector)
+            qd_connector_stream_link_detached(conn->connector);
+    }
+
     sys_mutex_lock(&amqp_adaptor.container->lock);
     DEQ_REMOVE(amqp_adaptor.container->links, link);
     sys_mutex_unlock(&amqp_adaptor.container->lock);
@@ -827,6 +931,18 @@ qd_session_t *qd_link_get_session(const qd_link_t *link)
 }
 
 
+qd_message_ra_cache_t **qd_link_ra_cache(qd_link_t *link)
+{
+    return &link->ra_cache;
+}
+
+
+qd_compression_t **qd_link_compression(qd_link_t *link)
+{
+    return &link->compression;
+}
+
+
 bool qd_link_is_q2_limit_unbounded(const qd_link_t *link)
 {
     return link->q2_limit_unbounded;
@@ -839,6 +955,57 @@ void qd_link_set_q2_limit_unbounded(qd_link_t *link, bool q2_limit_unbounded)
 }
 
 
+// The Q2 state below is only touched by the I/O thread that owns the link.
+
+uint32_t qd_link_q2_limit(const qd_link_t *link)
+{
+    return link->q2_upper ? link->q2_upper : QD_QLIMIT_Q2_UPPER;
+}
+
+
+// An incoming message on this link has hit its Q2 upper limit.  Under memory
+// pressure (see qd_alloc_memory_state()) halve the limit so that many concurrent slow streams hold less.
+void qd_link_q2_blocked(qd_link_t *link)
+{
+    uint32_t limit = qd_link_q2_limit(link);
+
+    link->q2_blocked_count++;
+    if (qd_alloc_memory_state() >= QD_MEMORY_SHRINK_Q2 && limit > QD_QLIMIT_Q2_UPPER_MIN) {
+        link->q2_upper = MAX(limit / 2, QD_QLIMIT_Q2_UPPER_MIN);
+    }
+    link->q2_stats_changed = true;
+    qd_flight_record(QD_FLIGHT_Q2_BLOCKED, link->link_id, limit, 0);
+}
+
+
+// Receive resumed after Q2 holdoff and found the message fully drained: the
+// consumer keeps up and the limit, not the consumer, throttled the stream.
+// Grow toward the bandwidth-delay product unless memory is tight.
+void qd_link_q2_starved(qd_link_t *link)
+{
+    uint32_t limit = qd_link_q2_limit(link);
+
+    if (qd_alloc_memory_state() < QD_MEMORY_SHRINK_Q2 && limit < QD_QLIMIT_Q2_UPPER_MAX) {
+        link->q2_upper         = MIN(limit * 2, QD_QLIMIT_Q2_UPPER_MAX);
+        link->q2_stats_changed = true;
+    }
+}
+
+
+// Returns true and the current Q2 limit and block count if either changed
+// since the last call.
+bool qd_link_q2_stats(qd_link_t *link, uint32_t *limit, uint32_t *blocked_count)
+{
+    if (!link->q2_stats_changed)
+        return false;
+
+    link->q2_stats_changed = false;
+    *limit                 = qd_link_q2_limit(link);
+    *blocked_count         = link->q2_blocked_count;
+    return true;
+}
+
+
 qd_direction_t qd_link_direction(const qd_link_t *link)
 {
     return link->direction;
@@ -907,9 +1074,18 @@ void qd_link_q3_block(qd_link_t *link)
 {
     assert(link);
     if (!link->q3_blocked) {
-        assert(link->qd_session);
+        qd_session_t *qd_ssn = link->qd_session;
+        assert(qd_ssn);
+        if (DEQ_IS_EMPTY(qd_ssn->q3_blocked_links)) {
+            // the session enters Q3 (resuming was over even if its last blocked links detached instead)
+            qd_ssn->q3_resuming = false;
+            qd_metric_inc(amqp_adaptor.q3_blocks, 1);
+            if (qd_ssn->q3_left && qd_timer_now() - qd_ssn->q3_left < QD_SESSION_Q3_OSCILLATION_MSEC)
+                qd_metric_inc(amqp_adaptor.q3_oscillations, 1);
+        }
         link->q3_blocked = true;
-        DEQ_INSERT_TAIL_N(Q3, link->qd_session->q3_blocked_links, link);
+        DEQ_INSERT_TAIL_N(Q3, qd_ssn->q3_blocked_links, link);
+        qd_flight_record(QD_FLIGHT_Q3_BLOCKED, link->link_id, 0, 0);
     }
 }
 
@@ -931,6 +1107,20 @@ uint64_t qd_link_link_id(const qd_link_t *link)
 }
 
 
+void qd_link_hold_credit(qd_link_t *link, int credit)
+{
+    link->held_credit += credit;
+}
+
+
+int qd_link_take_held_credit(qd_link_t *link)
+{
+    int credit = link->held_credit;
+    link->held_credit = 0;
+    return credit;
+}
+
+
 void qd_link_set_link_id(qd_link_t *link, uint64_t link_id)
 {
     link->link_id = link_id;
@@ -953,10 +1143,10 @@ qd_session_t *qd_session(pn_session_t *pn_ssn)
         pn_session_set_context(pn_ssn, qd_ssn);
         qd_ssn->remote_max_frame = pn_transport_get_remote_max_frame(pn_tport);
         assert(qd_ssn->remote_max_frame != 0);
+        qd_ssn->local_max_frame = MAX(pn_transport_get_max_frame(pn_tport), 1);
 
-        // These thresholds come from the old Q3 session byte limits
-        qd_ssn->outgoing_bytes_high_threshold = 1048576;
-        qd_ssn->outgoing_bytes_low_threshold  =  524288;
+        qd_ssn->outgoing_bytes_high_threshold = QD_SESSION_OUTGOING_MIN_BYTES;
+        qd_ssn->outgoing_bytes_min_threshold  = QD_SESSION_OUTGOING_MIN_BYTES;
     }
     return qd_ssn;
 }
@@ -995,13 +1185,6 @@ void qd_session_decref(qd_session_t *qd_ssn)
 }
 
 
-qd_link_list_t *qd_session_q3_blocked_links(qd_session_t *qd_ssn)
-{
-    assert(qd_ssn);
-    return &qd_ssn->q3_blocked_links;
-}
-
-
 bool qd_session_is_q3_blocked(const qd_session_t *qd_ssn)
 {
     assert(qd_ssn);
@@ -1051,20 +1234,65 @@ size_t qd_session_get_outgoing_capacity(const qd_session_t *qd_ssn)
  */
 size_t qd_session_get_outgoing_capacity_low_threshold(const qd_session_t *qd_ssn)
 {
-    return qd_ssn->outgoing_bytes_low_threshold;
+    return qd_ssn->outgoing_bytes_high_threshold / 2;
 }
 
 
-/** Configure the sessions local incoming window limit.
- *
- * This sets the value of the incoming window for the session. This value is sent to the remote peer in the Begin
- * Performative.
- *
- * @param qd_ssn Session to configure
- * @param in_window maximum incoming window in frames
- */
-static void qd_session_configure_incoming_window(qd_session_t *qd_ssn, uint32_t in_window)
+// Q3 blocked links on the session are about to resume.  If Proton wrote out everything buffered while the links were
+// blocked the output went idle waiting for the router, so the threshold rather than the network limited the session:
+// double it up to the remote window unless memory is tight.  Under memory pressure halve it instead.
+static void qd_session_q3_unblocked(qd_session_t *qd_ssn)
+{
+    assert(qd_ssn && qd_ssn->pn_session);
+
+    size_t high = qd_ssn->outgoing_bytes_high_threshold;
+    if (qd_alloc_memory_state() >= QD_MEMORY_SHRINK_Q2) {
+        qd_ssn->outgoing_bytes_high_threshold = MAX(high / 2, qd_ssn->outgoing_bytes_min_threshold);
+    } else if (pn_session_outgoing_bytes(qd_ssn->pn_session) == 0) {
+        size_t limit = QD_SESSION_OUTGOING_MAX_BYTES;
+#if USE_PN_SESSION_WINDOWS
+        limit = MIN(limit, (size_t) qd_ssn->remote_max_incoming_window * qd_ssn->remote_max_frame);
+#endif
+        if (high < limit)
+            qd_ssn->outgoing_bytes_high_threshold = MIN(high * 2, limit);
+    }
+}
+
+
+int qd_session_q3_resume_links(qd_session_t *qd_ssn, qd_link_t **links, int max)
+{
+    assert(qd_ssn && max > 0);
+    if (DEQ_IS_EMPTY(qd_ssn->q3_blocked_links))
+        return 0;
+
+    size_t capacity = qd_session_get_outgoing_capacity(qd_ssn);
+    if (capacity < qd_session_get_outgoing_capacity_low_threshold(qd_ssn))
+        return 0;
+
+    if (!qd_ssn->q3_resuming) {
+        qd_ssn->q3_resuming = true;
+        qd_session_q3_unblocked(qd_ssn);
+    }
+
+    int batch = (int) MIN(capacity / QD_SESSION_Q3_LINK_OCTETS, (size_t) max);
+    batch     = MAX(batch, 1);
+    int count = 0;
+    while (count < batch && !DEQ_IS_EMPTY(qd_ssn->q3_blocked_links)) {
+        links[count] = DEQ_HEAD(qd_ssn->q3_blocked_links);
+        qd_link_q3_unblock(links[count++]);  // removes it from the list
+    }
+
+    if (DEQ_IS_EMPTY(qd_ssn->q3_blocked_links)) {
+        qd_ssn->q3_resuming = false;
+        qd_ssn->q3_left     = qd_timer_now();
+    }
+    return count;
+}
+
+
+static void qd_session_apply_incoming_window(qd_session_t *qd_ssn, uint32_t in_window)
 {
+    qd_ssn->in_window = in_window;
     // older proton session windowing would stall so do not enable it
 #if USE_PN_SESSION_WINDOWS
     // Use new window configuration API to set the maximum in window and low water mark
@@ -1076,6 +1304,68 @@ static void qd_session_configure_incoming_window(qd_session_t *qd_ssn, uint32_t
 }
 
 
+// Account for incoming data on the session and, once per sample period, adjust an autotuned incoming window to the
+// bytes received during the period.  Called by the I/O thread that owns the session.
+void qd_session_incoming_octets(qd_session_t *qd_ssn, size_t octets)
+{
+    if (!qd_ssn || !qd_ssn->in_window_auto || !qd_ssn->pn_session)
+        return;
+
+    qd_ssn->in_window_octets += octets;
+
+    qd_timestamp_t now = qd_timer_now();
+    if (now - qd_ssn->in_window_sample_start < QD_SESSION_WINDOW_SAMPLE_MSEC)
+        return;
+
+    const size_t window_bytes = (size_t) qd_ssn->in_window * qd_ssn->local_max_frame;
+    uint32_t     in_window    = qd_ssn->in_window;
+
+    if (qd_alloc_memory_state() >= QD_MEMORY_SHRINK_Q2) {
+        in_window = MAX(in_window / 2, qd_ssn->in_window_min);
+        qd_ssn->in_window_idle_samples = 0;
+    } else if (qd_ssn->in_window_octets >= window_bytes) {
+        in_window = (uint32_t) MIN((uint64_t) in_window * 2, (uint64_t) qd_ssn->in_window_max);
+        qd_ssn->in_window_idle_samples = 0;
+    } else if (qd_ssn->in_window_octets < window_bytes / 8) {
+        if (++qd_ssn->in_window_idle_samples >= QD_SESSION_WINDOW_IDLE_SAMPLES) {
+            in_window = MAX(in_window / 2, qd_ssn->in_window_min);
+            qd_ssn->in_window_idle_samples = 0;
+        }
+    } else {
+        qd_ssn->in_window_idle_samples = 0;
+    }
+
+    if (in_window != qd_ssn->in_window) {
+        qd_log(LOG_ROUTER, QD_LOG_DEBUG, "Session incoming window %" PRIu32 " -> %" PRIu32 " frames (%zu bytes in %" PRId64 " msec)",
+               qd_ssn->in_window, in_window, qd_ssn->in_window_octets, (int64_t) (now - qd_ssn->in_window_sample_start));
+        qd_session_apply_incoming_window(qd_ssn, in_window);
+    }
+
+    qd_ssn->in_window_octets       = 0;
+    qd_ssn->in_window_sample_start = now;
+}
+
+
+/** Configure the sessions local incoming window limit.
+ *
+ * This sets the value of the incoming window for the session. This value is sent to the remote peer in the Begin
+ * Performative.
+ *
+ * @param qd_ssn Session to configure
+ * @param in_window maximum incoming window in frames
+ * @param autotune start below in_window and adapt the window to the session throughput, see
+ *                 qd_session_incoming_octets()
+ */
+static void qd_session_configure_incoming_window(qd_session_t *qd_ssn, uint32_t in_window, bool autotune)
+{
+    qd_ssn->in_window_max          = in_window;
+    qd_ssn->in_window_min          = autotune ? MAX(in_window / QD_SESSION_WINDOW_AUTO_DIVISOR, 2) : in_window;
+    qd_ssn->in_window_auto         = USE_PN_SESSION_WINDOWS && autotune && qd_ssn->in_window_min < in_window;
+    qd_ssn->in_window_sample_start = qd_timer_now();
+    qd_session_apply_incoming_window(qd_ssn, qd_ssn->in_window_min);
+}
+
+
 /** Set the session incoming window that was advertised by the remote
  *
  * This is the value for the remotes incoming session window. It arrives in the Begin Performative.
@@ -1098,7 +1388,7 @@ static void qd_session_set_remote_incoming_window(qd_session_t *qd_ssn, uint32_t
     size_t window_bytes = (size_t) in_window * qd_ssn->remote_max_frame;
     if (window_bytes < qd_ssn->outgoing_bytes_high_threshold) {
         qd_ssn->outgoing_bytes_high_threshold = window_bytes;
-        qd_ssn->outgoing_bytes_low_threshold = window_bytes / 2;
+        qd_ssn->outgoing_bytes_min_threshold  = window_bytes;
     }
 }
 #endif
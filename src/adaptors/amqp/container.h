@@ -102,15 +102,32 @@ void qd_link_q3_block(qd_link_t *link);
 void qd_link_q3_unblock(qd_link_t *link);
 uint64_t qd_link_link_id(const qd_link_t *link);
 void qd_link_set_link_id(qd_link_t *link, uint64_t link_id);
+void qd_link_hold_credit(qd_link_t *link, int credit);  // credit withheld while the connection is rate limited
+int qd_link_take_held_credit(qd_link_t *link);
 struct qd_message_t;
 void qd_link_set_incoming_msg(qd_link_t *link, struct qd_message_t *msg);
 
+static inline qd_session_t *qd_session_from_pn(pn_session_t *pn_ssn)
+{
+    return (qd_session_t *)pn_session_get_context(pn_ssn);
+}
+
 void qd_session_incref(qd_session_t *qd_ssn);
 void qd_session_decref(qd_session_t *qd_ssn);
 bool qd_session_is_q3_blocked(const qd_session_t *qd_ssn);
-qd_link_list_t *qd_session_q3_blocked_links(qd_session_t *qd_ssn);
 size_t qd_session_get_outgoing_capacity_low_threshold(const qd_session_t *qd_ssn);
 
+/**
+ * Unblock the next Q3 blocked links of a session if its outgoing capacity has risen above the low threshold: as many
+ * as the capacity is expected to keep busy, at least one and at most max, in the order they blocked.  Links that block
+ * again queue behind the links still waiting so every link gets its turn.
+ *
+ * @param links Set to the unblocked links
+ * @return The number of links unblocked, 0 if the session has no capacity or no blocked links
+ */
+int qd_session_q3_resume_links(qd_session_t *qd_ssn, qd_link_t **links, int max);
+void qd_session_incoming_octets(qd_session_t *qd_ssn, size_t octets);
+
 void qd_connection_release_sessions(qd_connection_t *qd_conn);
 
 // Defaults for session incoming window size
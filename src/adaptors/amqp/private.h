@@ -27,6 +27,7 @@
  */
 
 #include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/threading.h"
 
 typedef struct qdr_core_t             qdr_core_t;
@@ -51,6 +52,9 @@ struct amqp_adaptor_t {
     qd_container_t         *container;
     sys_mutex_t             lock;
     qd_connection_list_t    conn_list;
+    qd_metric_t            *q3_blocks;        ///< sessions entering Q3
+    qd_metric_t            *q3_oscillations;  ///< sessions entering Q3 again right after leaving it
+    qd_metric_t            *q3_resumes;       ///< batches of Q3 blocked links resumed
 };
 
 extern amqp_adaptor_t amqp_adaptor;
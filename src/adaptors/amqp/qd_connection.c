@@ -23,6 +23,7 @@
 #include "qd_listener.h"
 #include "policy.h"
 #include "container.h"
+#include "compression.h"
 
 #include "qpid/dispatch/dispatch.h"
 #include "qpid/dispatch/proton_utils.h"
@@ -36,6 +37,7 @@
 #include <proton/netaddr.h>
 
 #include <inttypes.h>
+#include <time.h>
 
 
 ALLOC_DEFINE(qd_deferred_call_t);
@@ -177,6 +179,15 @@ static void decorate_connection(qd_connection_t *ctx)
                                pn_bytes(strlen(QD_CONNECTION_PROPERTY_ANNOTATIONS_VERSION_KEY),
                                         QD_CONNECTION_PROPERTY_ANNOTATIONS_VERSION_KEY));
             pn_data_put_int(pn_connection_properties(conn), QD_ROUTER_ANNOTATIONS_VERSION);
+
+            if (config->compression && qd_compression_available()) {
+                pn_data_put_symbol(pn_connection_properties(conn),
+                                   pn_bytes(strlen(QD_CONNECTION_PROPERTY_COMPRESSION_KEY),
+                                            QD_CONNECTION_PROPERTY_COMPRESSION_KEY));
+                pn_data_put_string(pn_connection_properties(conn),
+                                   pn_bytes(strlen(QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE),
+                                            QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE));
+            }
         }
 
         qd_failover_list_t *fol = config->failover_list;
@@ -381,9 +392,11 @@ static void qd_connection_free(qd_connection_t *qd_conn, const char *condition_n
         qd_policy_socket_close(qd_dispatch_get_policy(amqp_adaptor.dispatch), qd_conn);
     }
 
+    qd_timer_free(qd_conn->throttle_timer);  // before the deferred calls it schedules are discarded
     qd_connection_invoke_deferred_calls(qd_conn, true);  // Discard any pending deferred calls
     sys_mutex_free(&qd_conn->deferred_call_lock);
     qd_policy_settings_free(qd_conn->policy_settings);
+    qd_policy_rate_limits_free(qd_conn->rate_limits);
     free(qd_conn->user_id);
     if (qd_conn->timer) qd_timer_free(qd_conn->timer);
     free(qd_conn->name);
@@ -497,9 +510,10 @@ void qd_connection_invoke_deferred_impl(qd_connection_t *conn, qd_deferred_t cal
     DEQ_INSERT_TAIL(conn->deferred_calls, dc);
     sys_mutex_unlock(&conn->deferred_call_lock);
 
-    sys_mutex_lock(qd_server_get_activation_lock(conn->server));
+    sys_mutex_t *activation_lock = qd_server_get_activation_lock(conn->server, conn->connection_id);
+    sys_mutex_lock(activation_lock);
     qd_connection_activate(conn);
-    sys_mutex_unlock(qd_server_get_activation_lock(conn->server));
+    sys_mutex_unlock(activation_lock);
 }
 
 void *qd_connection_new_qd_deferred_call_t(void)
@@ -554,6 +568,21 @@ uint64_t qd_connection_max_message_size(const qd_connection_t *c)
     return (c && c->policy_settings) ? c->policy_settings->spec.maxMessageSize : 0;
 }
 
+bool qd_connection_compression(const qd_connection_t *c)
+{
+    return c && c->compression;
+}
+
+bool qd_connection_compact_trace(const qd_connection_t *c)
+{
+    return c && c->compact_trace;
+}
+
+qdr_compression_stats_t *qd_connection_compression_stats(qd_connection_t *c)
+{
+    return &c->compression_stats;
+}
+
 
 /* Log the description, set the transport condition (name, description) close the transport tail. */
 void connect_fail(qd_connection_t *ctx, const char *name, const char *description, ...)
@@ -728,6 +757,8 @@ static void timeout_on_handshake(void *context, bool discard)
 
     qd_connection_t *ctx   = (qd_connection_t*) context;
     pn_transport_t  *tport = pn_connection_transport(ctx->pn_conn);
+    if (ctx->connector)
+        qd_connector_handshake_timeout(ctx->connector);
     pn_transport_close_head(tport);
     connect_fail(ctx, QD_AMQP_COND_NOT_ALLOWED, "Timeout waiting for initial handshake");
 }
@@ -750,6 +781,14 @@ static void startup_timer_handler(void *context)
 /* Events involving a connection or listener are serialized by the proactor so
  * only one event per connection / listener will be processed at a time.
  */
+static inline uint64_t batch_clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
 bool qd_connection_handle_event(qd_server_t *qd_server, pn_event_t *e, void *context)
 {
     pn_connection_t *pn_conn = (pn_connection_t *) context;
@@ -760,15 +799,40 @@ bool qd_connection_handle_event(qd_server_t *qd_server, pn_event_t *e, void *con
         // Notify the container that the batch is complete so it can do after-batch
         // processing.
         //
-        if (ctx)
+        if (ctx) {
             qd_conn_event_batch_complete(amqp_adaptor.container, ctx, false);
+            if (ctx->batch_start_ns) {
+                uint64_t          busy_ns = batch_clock_ns() - ctx->batch_start_ns;
+                qdr_connection_t *qdr_conn = (qdr_connection_t *) qd_connection_get_context(ctx);
+                if (qdr_conn) {
+                    qdr_connection_add_cpu_time(qdr_conn, busy_ns);
+                    if (ctx->compression) {
+                        qdr_connection_add_compression_stats(qdr_conn, &ctx->compression_stats);
+                        ZERO(&ctx->compression_stats);
+                    }
+                }
+                if (ctx->connector && ctx->connector->is_data_connector)
+                    qd_connector_add_io_busy(ctx->connector, busy_ns / 1000);
+                ctx->batch_start_ns = 0;
+            }
+        }
         return true;
     }
 
+    // Time the event batches: charged to the connection's CPU time and, for inter-router data connections, the load
+    // signal for adding data connections
+    if (ctx && !ctx->batch_start_ns) {
+        ctx->batch_start_ns = batch_clock_ns();
+    }
+
     switch (pn_event_type(e)) {
 
     case PN_CONNECTION_INIT: {
-        const qd_server_config_t *config = ctx && ctx->listener ? &ctx->listener->config : 0;
+        const qd_server_config_t *config = 0;
+        if (ctx && ctx->listener)
+            config = &ctx->listener->config;
+        else if (ctx && ctx->connector)
+            config = qd_connector_get_server_config(ctx->connector);
         if (config && config->initial_handshake_timeout_seconds > 0) {
             ctx->timer = qd_timer(amqp_adaptor.dispatch, startup_timer_handler, ctx);
             qd_timer_schedule(ctx->timer, config->initial_handshake_timeout_seconds * 1000);
@@ -42,6 +42,7 @@
 typedef struct qd_listener_t        qd_listener_t;
 typedef struct qd_connector_t       qd_connector_t;
 typedef struct qd_policy_settings_t qd_policy_settings_t;
+typedef struct qd_policy_rate_limits_t qd_policy_rate_limits_t;
 typedef struct pn_connection_t      pn_connection_t;
 typedef struct qd_session_t         qd_session_t;
 typedef struct qd_timer_t           qd_timer_t;
@@ -91,6 +92,8 @@ struct qd_connection_t {
     uint64_t                        connection_id; // A unique identifier for the qd_connection_t. The underlying pn_connection already has one but it is long and clunky.
     char                            *user_id; // A unique identifier for the user on the connection. This is currently populated from the client ssl cert. See sslProfile.uidFormat for more info
     qd_policy_settings_t            *policy_settings;
+    qd_policy_rate_limits_t         *rate_limits;     // 0 if the connection is not rate limited by policy
+    qd_timer_t                      *throttle_timer;  // releases the link credit held back by the rate limits
     int                             n_sessions;
     int                             n_senders;
     int                             n_receivers;
@@ -102,6 +105,9 @@ struct qd_connection_t {
     qd_pn_free_link_list_t          free_link_list;
     bool                            strip_annotations_in;
     bool                            strip_annotations_out;
+    bool                            compression;      // both ends offered compression, see compression.h
+    bool                            compact_trace;    // the peer router accepts compact traces (annotations version 3)
+    qdr_compression_stats_t         compression_stats;  // since the end of the last event batch
     void (*wake)(qd_connection_t*); /* Wake method, different for libwebsockets vs. proactor */
     sys_atomic_t                    wake_core;                      // Atomic flag to indicate that core actions are due at next activation
     sys_atomic_t                    wake_cutthrough_outbound;       // Outbound cut-through actions are due at next activation
@@ -110,6 +116,8 @@ struct qd_connection_t {
     qdr_delivery_ref_list_t         outbound_cutthrough_worklist;   // List of inbound deliveries using cut-through
     sys_spinlock_t                  inbound_cutthrough_spinlock;    // Spinlock to protect the inbound worklist
     sys_spinlock_t                  outbound_cutthrough_spinlock;   // Spinlock to protect the outbound worklist
+    uint64_t                        batch_start_ns;                 // Start of the current event batch
+    bool                            q3_resume_pending;              // Sessions have Q3 blocked links to resume at next activation
     char rhost[NI_MAXHOST];     /* Remote host numeric IP for incoming connections */
     char rhost_port[NI_MAXHOST+NI_MAXSERV]; /* Remote host:port for incoming connections */
 };
@@ -137,6 +145,9 @@ void qd_connection_wake(qd_connection_t *ctx);
 
 uint64_t qd_connection_max_message_size(const qd_connection_t *c);
 
+bool qd_connection_compression(const qd_connection_t *c);
+qdr_compression_stats_t *qd_connection_compression_stats(qd_connection_t *c);
+
 /**
  * Get the name of the connection, based on its IP address.
  */
@@ -46,6 +46,14 @@ ALLOC_DEFINE(qd_connector_config_t);
  */
 #define ASSERT_MGMT_THREAD assert(sys_thread_role(0) == SYS_THREAD_MAIN || sys_thread_proactor_mode() == SYS_THREAD_PROACTOR_MODE_TIMER)
 
+// Load-adaptive inter-router data connections. The load of a data connection is the share of a sample interval its I/O
+// thread spent handling the connection's events.
+#define QD_DATA_CONN_SAMPLE_MSEC    2000
+#define QD_DATA_CONN_BUSY_PERCENT   70  // average load at which the data connections are considered saturated
+#define QD_DATA_CONN_IDLE_PERCENT   1   // load below which a data connection is considered idle
+#define QD_DATA_CONN_GROW_SAMPLES   3   // consecutive saturated samples before adding a data connection
+#define QD_DATA_CONN_RETIRE_SAMPLES 30  // consecutive idle samples before retiring an added data connection
+
 
 /** Disable reconnect
  *
@@ -100,6 +108,117 @@ static void qd_connector_config_cleanup_conns(void *context)
 }
 
 
+/**
+ * Data connectors sharing the config's current TLS ordinal, i.e. those that new streams may be routed over
+ */
+static bool qd_connector_is_current_data_connector(const qd_connector_config_t *ctor_config, qd_connector_t *ctor)
+{
+    if (!ctor->is_data_connector || ctor->tls_ordinal != ctor_config->tls_ordinal)
+        return false;
+    sys_mutex_lock(&ctor->lock);
+    bool current = ctor->state != CTOR_STATE_DELETED && !!ctor->reconnect_timer;
+    sys_mutex_unlock(&ctor->lock);
+    return current;
+}
+
+
+/**
+ * Periodic load sample for the data connectors of an inter-router connector_config_t.
+ *
+ * A data connection is added when the data connections have kept their I/O threads saturated for several consecutive
+ * samples, and a connection above the configured count is retired once it has been idle for a long period. The wide
+ * gap between the thresholds and the differing sample counts keep the count from oscillating. Streams are assigned to
+ * the connections of the group round-robin by the core so a new connection takes its share of new streams, while
+ * existing streams are never moved.
+ */
+static void qd_connector_config_scale_data_conns(void *context)
+{
+    ASSERT_MGMT_THREAD;  // only the mgmt thread can modify the connector list!
+
+    qd_connector_config_t *ctor_config = (qd_connector_config_t *) context;
+    const uint64_t sample_usec = QD_DATA_CONN_SAMPLE_MSEC * 1000;
+    uint64_t        total_usec = 0;
+    uint32_t        count      = 0;
+    bool            all_open   = true;
+    qd_connector_t *idle_ctor  = 0;
+
+    for (qd_connector_t *ctor = DEQ_HEAD(ctor_config->connectors); ctor; ctor = DEQ_NEXT(ctor)) {
+        if (!qd_connector_is_current_data_connector(ctor_config, ctor))
+            continue;
+
+        uint64_t busy_usec = sys_atomic_set(&ctor->io_busy_usec, 0);
+        total_usec += busy_usec;
+        count += 1;
+
+        sys_mutex_lock(&ctor->lock);
+        all_open = all_open && !!ctor->qd_conn && ctor->qd_conn->opened;
+        sys_mutex_unlock(&ctor->lock);
+
+        // a connection carrying a long lived stream with little traffic is in use, not idle
+        if (busy_usec * 100 < sample_usec * QD_DATA_CONN_IDLE_PERCENT && sys_atomic_get(&ctor->stream_links) == 0) {
+            if (++ctor->idle_samples >= QD_DATA_CONN_RETIRE_SAMPLES && !idle_ctor)
+                idle_ctor = ctor;
+        } else {
+            ctor->idle_samples = 0;
+        }
+    }
+
+    const uint32_t busy_percent = count ? (uint32_t) ((total_usec * 100) / (sample_usec * count)) : 0;
+
+    if (busy_percent >= QD_DATA_CONN_BUSY_PERCENT && all_open) {
+        ctor_config->data_busy_samples += 1;
+    } else {
+        ctor_config->data_busy_samples = 0;
+    }
+
+    if (ctor_config->data_busy_samples >= QD_DATA_CONN_GROW_SAMPLES && count < ctor_config->data_connection_max) {
+        ctor_config->data_busy_samples = 0;
+        qd_connector_t *d_ctor = qd_connector_create(ctor_config, true);  // true == create a data connector
+        if (d_ctor) {
+            qd_log(LOG_SERVER, QD_LOG_INFO,
+                   "Connector %s: data connections %" PRIu32 "%% busy, adding data connection %" PRIu32 " of %" PRIu32,
+                   ctor_config->config.name, busy_percent, count + 1, ctor_config->data_connection_max);
+            qd_connector_activate(d_ctor);
+            DEQ_INSERT_TAIL(ctor_config->connectors, d_ctor);
+        }
+    } else if (idle_ctor && count > ctor_config->data_connection_count
+               && busy_percent * 2 < QD_DATA_CONN_BUSY_PERCENT) {
+        qd_log(LOG_SERVER, QD_LOG_INFO, "Connector %s: retiring idle data connection, %" PRIu32 " remain",
+               ctor_config->config.name, count - 1);
+        DEQ_REMOVE(ctor_config->connectors, idle_ctor);
+        qd_connector_close(idle_ctor);
+        qd_connector_decref(idle_ctor);
+    }
+
+    qd_timer_schedule(ctor_config->data_scale_timer, QD_DATA_CONN_SAMPLE_MSEC);
+}
+
+
+void qd_connector_add_io_busy(qd_connector_t *ctor, uint64_t busy_usec)
+{
+    sys_atomic_add(&ctor->io_busy_usec, (uint32_t) MIN(busy_usec, (uint64_t) UINT32_MAX));
+}
+
+
+bool qd_connector_stream_link_attached(qd_connector_t *ctor)
+{
+    if (!ctor->is_data_connector)
+        return false;
+    sys_atomic_inc(&ctor->stream_links);
+    return true;
+}
+
+
+void qd_connector_stream_link_detached(qd_connector_t *ctor)
+{
+    // The connection's links are freed on its I/O thread, the same thread that clears the count and the connection's
+    // connector, so no link of an earlier connection is counted down here
+    uint32_t count = sys_atomic_dec(&ctor->stream_links);
+    assert(count > 0);
+    (void) count;
+}
+
+
 /**
  * Create all connectors for a given connector_config_t
  *
@@ -170,6 +289,8 @@ static void try_open_lh(qd_connector_t *connector, qd_connection_t *qd_conn) TA_
 
     connector->state   = CTOR_STATE_OPEN;
     connector->delay   = 5000;
+    if (!connector->connect_start)
+        connector->connect_start = qd_timer_now();
 
     //
     // Set the hostname on the pn_connection. This hostname will be used by proton as the
@@ -254,6 +375,8 @@ qd_connector_t *qd_connector_create(qd_connector_config_t *ctor_config, bool is_
 
     ZERO(connector);
     sys_atomic_init(&connector->ref_count, 1);  // for caller
+    sys_atomic_init(&connector->io_busy_usec, 0);
+    sys_atomic_init(&connector->stream_links, 0);
     DEQ_INIT(connector->conn_info_list);
     DEQ_ITEM_INIT(connector);
 
@@ -363,6 +486,8 @@ void qd_connector_decref(qd_connector_t* connector)
         qd_timer_free(connector->reconnect_timer);
         sys_mutex_free(&connector->lock);
         sys_atomic_destroy(&connector->ref_count);
+        sys_atomic_destroy(&connector->io_busy_usec);
+        sys_atomic_destroy(&connector->stream_links);
 
         qd_failover_item_t *item = DEQ_HEAD(connector->conn_info_list);
         while (item) {
@@ -465,6 +590,26 @@ void qd_connector_remote_opened(qd_connector_t *connector)
     qd_failover_item_t *item = qd_connector_get_conn_info_lh(connector);
     if (item)
         item->retries = 0;
+    if (connector->connect_start) {
+        connector->last_connect_msec = qd_timer_now() - connector->connect_start;
+        connector->connect_start     = 0;
+    }
+    sys_mutex_unlock(&connector->lock);
+}
+
+
+/**
+ * The connection attempt did not get the peer's OPEN within initialHandshakeTimeoutSeconds.
+ *
+ * A black-holed address would otherwise be retried once more before moving on, at the cost of a TCP connect timeout
+ * per try: mark the current failover item as retried so the next failure moves on to the next item.
+ */
+void qd_connector_handshake_timeout(qd_connector_t *connector)
+{
+    sys_mutex_lock(&connector->lock);
+    qd_failover_item_t *item = qd_connector_get_conn_info_lh(connector);
+    if (item)
+        item->retries = 1;
     sys_mutex_unlock(&connector->lock);
 }
 
@@ -510,6 +655,7 @@ void qd_connector_remove_connection(qd_connector_t *connector, bool final, const
     }
     connector->qd_conn = 0;
     ctx->connector = 0;
+    sys_atomic_set(&connector->stream_links, 0);  // links freed after this are no longer counted down
 
     // Should we reconnect?
     if (!!connector->reconnect_timer) {
@@ -683,6 +829,12 @@ qd_connector_config_t *qd_connector_config_create(qd_dispatch_t *qd, qd_entity_t
     if (is_inter_router) {
         qd_generate_discriminator(ctor_config->group_correlator);
         ctor_config->data_connection_count = qd_dispatch_get_data_connection_count(qd);
+        ctor_config->data_connection_max   = qd_dispatch_get_data_connection_max(qd);
+        if (ctor_config->data_connection_count > 0
+            && ctor_config->data_connection_max > ctor_config->data_connection_count) {
+            ctor_config->data_scale_timer =
+                qd_timer(amqp_adaptor.dispatch, qd_connector_config_scale_data_conns, ctor_config);
+        }
     }
 
     // Create all configured connectors. Sets qd_error on failure
@@ -710,6 +862,10 @@ void qd_connector_config_delete(qd_connector_config_t *ctor_config)
 {
     ASSERT_MGMT_THREAD;  // only the mgmt thread can modify the connector list!
 
+    // stop load sampling before the connectors are released
+    qd_timer_free(ctor_config->data_scale_timer);
+    ctor_config->data_scale_timer = 0;
+
     qd_connector_t *ct = DEQ_HEAD(ctor_config->connectors);
     while (ct) {
         DEQ_REMOVE_HEAD(ctor_config->connectors);
@@ -741,6 +897,7 @@ void qd_connector_config_decref(qd_connector_config_t *ctor_config)
         // free the timer first otherwise the callback can run and attempt to access ctor_config while it is being torn
         // down:
         qd_timer_free(ctor_config->cleanup_timer);
+        qd_timer_free(ctor_config->data_scale_timer);
         sys_atomic_destroy(&ctor_config->ref_count);
         free(ctor_config->policy_vhost);
         qd_tls_config_decref(ctor_config->tls_config);
@@ -760,6 +917,8 @@ void qd_connector_config_activate(qd_connector_config_t *ctor_config)
         for (qd_connector_t *ct = DEQ_HEAD(ctor_config->connectors); !!ct; ct = DEQ_NEXT(ct)) {
             qd_connector_activate(ct);
         }
+        if (ctor_config->data_scale_timer)
+            qd_timer_schedule(ctor_config->data_scale_timer, QD_DATA_CONN_SAMPLE_MSEC);
     }
 }
 
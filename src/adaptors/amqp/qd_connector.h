@@ -68,10 +68,19 @@ typedef struct qd_connector_t {
     bool                      oper_status_down;  // set when oper-status transitions to 'down' to avoid repeated error indications.
     bool                      is_data_connector; // inter-router conn for streaming messages
 
+    /* Data connectors: I/O thread time spent handling the connection's events, reset by each load sample */
+    sys_atomic_t              io_busy_usec;
+    sys_atomic_t              stream_links;      // streaming links attached over the current connection
+    int                       idle_samples;      // consecutive load samples the connection has been idle (mgmt thread)
+
     /* This conn_list contains all the connection information needed to make a connection. It also includes failover connection information */
     qd_failover_item_list_t   conn_info_list;
     int                       conn_index; // Which connection in the connection list to connect to next.
 
+    /* Time to connect: from the first attempt after the connector went down until the peer's OPEN arrived */
+    int64_t                   connect_start;      // qd_timer_now() msec, zero when connected
+    int64_t                   last_connect_msec;
+
     /* holds proton transport error condition text on connection failure */
 #define QD_CTOR_CONN_MSG_BUF_SIZE 300
     char conn_msg[QD_CTOR_CONN_MSG_BUF_SIZE];
@@ -102,6 +111,9 @@ struct qd_connector_config_t {
     uint64_t                  tls_ordinal;
     uint64_t                  tls_oldest_valid_ordinal;
     uint32_t                  data_connection_count;  // # of child inter-router data connections
+    uint32_t                  data_connection_max;    // data connections may be added under load up to this count
+    qd_timer_t               *data_scale_timer;       // samples data connection load when count < max
+    int                       data_busy_samples;      // consecutive samples with saturated data connections
 
     // The group correlation id for all child connectors/connections
     char                      group_correlator[QD_DISCRIMINATOR_SIZE];
@@ -128,6 +140,22 @@ void qd_connector_config_delete(qd_connector_config_t *ctor_config);
  */
 void qd_connector_config_activate(qd_connector_config_t *ctor_config);
 
+/** Account I/O thread time spent handling the events of a data connector's connection.
+ *
+ * Called on the connection's I/O thread at the end of each event batch. This is the load signal used to add and
+ * retire inter-router data connections.
+ */
+void qd_connector_add_io_busy(qd_connector_t *ctor, uint64_t busy_usec);
+
+/** Account the streaming links attached over a data connector's connection.
+ *
+ * Called on the connection's I/O thread as links are set up and freed. A data connection is only retired as idle
+ * while it carries no link, the count is cleared when the connection goes away. Returns false if the connector is not
+ * a data connector and the link was not counted.
+ */
+bool qd_connector_stream_link_attached(qd_connector_t *ctor);
+void qd_connector_stream_link_detached(qd_connector_t *ctor);
+
 /** Drop a reference to the configuration instance.
  * This may free the given instance.
  */
@@ -161,6 +189,7 @@ bool qd_connector_has_failover_info(const qd_connector_t* ctor);
 const char *qd_connector_policy_vhost(const qd_connector_t* ctor);
 void qd_connector_handle_transport_error(qd_connector_t *ctor, uint64_t connection_id, pn_condition_t *condition);
 void qd_connector_remote_opened(qd_connector_t *ctor);
+void qd_connector_handshake_timeout(qd_connector_t *ctor);
 
 // add a new connection to the parent connector
 void qd_connector_add_connection(qd_connector_t *ctor, qd_connection_t *qd_conn);
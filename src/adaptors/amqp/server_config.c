@@ -107,6 +107,7 @@ qd_error_t qd_server_config_load(qd_server_config_t *config, qd_entity_t *entity
     ZERO(config);
     config->log_message          = qd_entity_opt_string(entity, "messageLoggingComponents", 0);     CHECK();
     config->message_log_flags    = qd_message_repr_flags(config->log_message);
+    config->pass_through         = qd_entity_opt_bool(entity, "passThrough", false);  CHECK();
     config->port                 = qd_entity_get_string(entity, "port");              CHECK();
     config->name                 = qd_entity_opt_string(entity, "name", 0);           CHECK();
     config->role                 = qd_entity_get_string(entity, "role");              CHECK();
@@ -131,9 +132,7 @@ qd_error_t qd_server_config_load(qd_server_config_t *config, qd_entity_t *entity
     config->http_root_dir        = qd_entity_opt_string(entity, "httpRootDir", 0);    CHECK();
     config->http = config->http || config->http_root_dir; /* httpRootDir implies http */
     config->idle_timeout_seconds = qd_entity_get_long(entity, "idleTimeoutSeconds");  CHECK();
-    if (is_listener) {
-        config->initial_handshake_timeout_seconds = qd_entity_get_long(entity, "initialHandshakeTimeoutSeconds");  CHECK();
-    }
+    config->initial_handshake_timeout_seconds = qd_entity_get_long(entity, "initialHandshakeTimeoutSeconds");  CHECK();
     config->sasl_username        = qd_entity_opt_string(entity, "saslUsername", 0);   CHECK();
     config->sasl_password        = qd_entity_opt_string(entity, "saslPassword", 0);   CHECK();
     config->sasl_mechanisms      = qd_entity_opt_string(entity, "saslMechanisms", 0); CHECK();
@@ -206,6 +205,7 @@ qd_error_t qd_server_config_load(qd_server_config_t *config, qd_entity_t *entity
         }
         // Ensure the window is at least 2 frames to allow a non-zero low water mark
         value = MAX(value, 2);
+        config->session_in_window_auto = true;
     } else if (value < 2 || value > INT32_MAX) {
         (void) qd_error(QD_ERROR_CONFIG,
                         "Invalid maxSessionFrames specified (%"PRId64"). Minimum value is 2 and maximum value is %"PRIi32,
@@ -227,6 +227,10 @@ qd_error_t qd_server_config_load(qd_server_config_t *config, qd_entity_t *entity
     stripAnnotations = 0;
     CHECK();
 
+    char *compression   = qd_entity_opt_string(entity, "compression", 0); CHECK();
+    config->compression = compression && strcmp(compression, "deflate") == 0;
+    free(compression);
+
     config->requireAuthentication = authenticatePeer;
     config->requireEncryption     = requireEncryption || requireSsl;
 
@@ -151,6 +151,12 @@ typedef struct qd_server_config_t {
      */
     bool strip_outbound_annotations;
 
+    /**
+     * If true, offer to compress the transfers of inter-router and edge connections.  Compression is only used when
+     * both ends of the connection offer it, see compression.h.
+     */
+    bool compression;
+
     /**
      * The number of deliveries that can be in-flight concurrently for each link within the connection.
      */
@@ -218,6 +224,12 @@ typedef struct qd_server_config_t {
      */
     uint32_t session_max_in_window;
 
+    /**
+     * True if maxSessionFrames is not configured. The session incoming window then starts below session_max_in_window
+     * and adapts to the throughput of each session, with session_max_in_window as the upper limit.
+     */
+    bool session_in_window_auto;
+
     /**
      * The idle timeout, in seconds.  If the peer sends no data frames in this many seconds, the
      * connection will be automatically closed.
@@ -225,9 +237,9 @@ typedef struct qd_server_config_t {
     int idle_timeout_seconds;
 
     /**
-     * The timeout, in seconds, for the initial connection handshake.  If a connection is established
-     * inbound (via a listener) and the timeout expires before the OPEN frame arrives, the connection
-     * shall be closed.
+     * The timeout, in seconds, for the initial connection handshake.  If the timeout expires before the
+     * peer's OPEN frame arrives, the connection shall be closed.  For a connector this bounds each
+     * connection attempt, including the TCP connect, and the next failover URL is tried at once.
      */
     int initial_handshake_timeout_seconds;
 
@@ -258,6 +270,12 @@ typedef struct qd_server_config_t {
      */
     uint32_t message_log_flags;
 
+    /**
+     * Messages received on the connection are forwarded without parsing their sections beyond the properties, see
+     * qd_message_set_pass_through().
+     */
+    bool pass_through;
+
     /**
      * Configured failover list
      */
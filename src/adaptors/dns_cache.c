@@ -0,0 +1,288 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "dns_cache.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+#include "qpid/dispatch/metrics.h"
+#include "qpid/dispatch/threading.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define DNS_CACHE_MAX_ADDRESSES 8
+
+struct qd_dns_entry_t {
+    DEQ_LINKS(qd_dns_entry_t);
+    DEQ_LINKS_N(PENDING, qd_dns_entry_t);
+    char     *host;
+    char     *port;
+    char     *host_port;     // returned until the host is resolved
+    int       ref_count;
+    bool      numeric;       // host is an address already, nothing to resolve
+    bool      pending;       // on the pending list
+    bool      resolving;     // being resolved by the resolver thread
+    int       address_count;
+    int       next_address;  // rotated past addresses that fail to connect
+    char      addresses[DNS_CACHE_MAX_ADDRESSES][QD_DNS_CACHE_ADDRESS_MAX];
+    int64_t   expire_at;     // msec, the addresses are not used after this time
+    int64_t   refresh_at;    // msec, a lookup after this time queues the entry for resolution
+};
+
+DEQ_DECLARE(qd_dns_entry_t, qd_dns_entry_list_t);
+
+static struct {
+    sys_mutex_t          lock;
+    sys_cond_t           cond;
+    sys_thread_t        *thread;
+    bool                 shutdown;
+    qd_dns_entry_list_t  entries;
+    qd_dns_entry_list_t  pending;
+    qd_metric_t         *hits;
+    qd_metric_t         *misses;
+    qd_metric_t         *failures;
+    qd_metric_t         *latency;
+} dns_cache;
+
+
+static int64_t now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static bool is_numeric_host(const char *host)
+{
+    unsigned char addr[sizeof(struct in6_addr)];
+    return !*host || inet_pton(AF_INET, host, addr) == 1 || inet_pton(AF_INET6, host, addr) == 1;
+}
+
+
+static void schedule_LH(qd_dns_entry_t *entry)
+{
+    if (!entry->pending && !entry->resolving) {
+        entry->pending = true;
+        DEQ_INSERT_TAIL_N(PENDING, dns_cache.pending, entry);
+        sys_cond_signal(&dns_cache.cond);
+    }
+}
+
+
+static void free_entry_LH(qd_dns_entry_t *entry)
+{
+    if (entry->pending)
+        DEQ_REMOVE_N(PENDING, dns_cache.pending, entry);
+    DEQ_REMOVE(dns_cache.entries, entry);
+    free(entry->host);
+    free(entry->port);
+    free(entry->host_port);
+    free(entry);
+}
+
+
+static int format_addresses(const struct addrinfo *info, const char *port,
+                            char addresses[DNS_CACHE_MAX_ADDRESSES][QD_DNS_CACHE_ADDRESS_MAX])
+{
+    int count = 0;
+    for (const struct addrinfo *ai = info; ai && count < DNS_CACHE_MAX_ADDRESSES; ai = ai->ai_next) {
+        char        text[INET6_ADDRSTRLEN];
+        const void *addr = ai->ai_family == AF_INET    ? (const void *) &((struct sockaddr_in *) ai->ai_addr)->sin_addr
+                           : ai->ai_family == AF_INET6 ? (const void *) &((struct sockaddr_in6 *) ai->ai_addr)->sin6_addr
+                                                       : 0;
+        // Same host:port form as the configured address (see qd_load_adaptor_config)
+        if (addr && inet_ntop(ai->ai_family, addr, text, sizeof(text)))
+            snprintf(addresses[count++], QD_DNS_CACHE_ADDRESS_MAX, "%s:%s", text, port);
+    }
+    return count;
+}
+
+
+static void *resolver_run(void *unused)
+{
+    char addresses[DNS_CACHE_MAX_ADDRESSES][QD_DNS_CACHE_ADDRESS_MAX];
+
+    sys_mutex_lock(&dns_cache.lock);
+    while (!dns_cache.shutdown) {
+        qd_dns_entry_t *entry = DEQ_HEAD(dns_cache.pending);
+        if (!entry) {
+            sys_cond_wait(&dns_cache.cond, &dns_cache.lock);
+            continue;
+        }
+        DEQ_REMOVE_HEAD_N(PENDING, dns_cache.pending);
+        entry->pending   = false;
+        entry->resolving = true;
+        entry->ref_count++;  // host and port are not modified after the entry is created
+        sys_mutex_unlock(&dns_cache.lock);
+
+        struct addrinfo  hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_ADDRCONFIG};
+        struct addrinfo *info  = 0;
+        int64_t          start  = now_usec();
+        int              result = getaddrinfo(entry->host, entry->port, &hints, &info);
+        qd_metric_observe(dns_cache.latency, (uint64_t) (now_usec() - start));
+
+        int count = result == 0 ? format_addresses(info, entry->port, addresses) : 0;
+        if (info)
+            freeaddrinfo(info);
+        start /= 1000;  // the expiry times are in msec
+
+        sys_mutex_lock(&dns_cache.lock);
+        entry->resolving = false;
+        if (count > 0) {
+            memcpy(entry->addresses, addresses, sizeof(addresses));
+            entry->address_count = count;
+            entry->next_address  = 0;
+            entry->expire_at     = start + QD_DNS_CACHE_TTL_MSEC;
+            entry->refresh_at    = start + QD_DNS_CACHE_TTL_MSEC * 3 / 4;
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "Resolved %s: %d address(es), first %s", entry->host, count,
+                   entry->addresses[0]);
+        } else {
+            // Keep the addresses of the previous resolution until they expire, retry after the negative TTL
+            qd_metric_inc(dns_cache.failures, 1);
+            entry->refresh_at = start + QD_DNS_CACHE_NEGATIVE_TTL_MSEC;
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING, "Unable to resolve %s: %s", entry->host,
+                   result ? gai_strerror(result) : "no usable address");
+        }
+        if (--entry->ref_count == 0)
+            free_entry_LH(entry);
+    }
+    sys_mutex_unlock(&dns_cache.lock);
+    return 0;
+}
+
+
+void qd_dns_cache_initialize(void)
+{
+    ZERO(&dns_cache);
+    sys_mutex_init(&dns_cache.lock);
+    sys_cond_init(&dns_cache.cond);
+    DEQ_INIT(dns_cache.entries);
+    DEQ_INIT(dns_cache.pending);
+    dns_cache.hits     = qd_metric(QD_METRIC_COUNTER, "qdr_dns_cache_hits_total", 0, 0);
+    dns_cache.misses   = qd_metric(QD_METRIC_COUNTER, "qdr_dns_cache_misses_total", 0, 0);
+    dns_cache.failures = qd_metric(QD_METRIC_COUNTER, "qdr_dns_resolve_failures_total", 0, 0);
+    dns_cache.latency  = qd_metric(QD_METRIC_HISTOGRAM, "qdr_dns_resolve_latency_microseconds", 0, 0);
+    dns_cache.thread   = sys_thread(SYS_THREAD_RESOLVER, resolver_run, 0);
+}
+
+
+void qd_dns_cache_finalize(void)
+{
+    sys_mutex_lock(&dns_cache.lock);
+    dns_cache.shutdown = true;
+    sys_cond_signal(&dns_cache.cond);
+    sys_mutex_unlock(&dns_cache.lock);
+
+    // Waits for a resolution in progress to complete
+    sys_thread_join(dns_cache.thread);
+    sys_thread_free(dns_cache.thread);
+
+    sys_mutex_lock(&dns_cache.lock);
+    while (DEQ_HEAD(dns_cache.entries))
+        free_entry_LH(DEQ_HEAD(dns_cache.entries));
+    sys_mutex_unlock(&dns_cache.lock);
+
+    qd_metric_free(dns_cache.hits);
+    qd_metric_free(dns_cache.misses);
+    qd_metric_free(dns_cache.failures);
+    qd_metric_free(dns_cache.latency);
+    sys_cond_free(&dns_cache.cond);
+    sys_mutex_free(&dns_cache.lock);
+}
+
+
+qd_dns_entry_t *qd_dns_entry(const char *host, const char *port)
+{
+    sys_mutex_lock(&dns_cache.lock);
+    qd_dns_entry_t *entry = DEQ_HEAD(dns_cache.entries);
+    while (entry && (strcmp(entry->host, host) != 0 || strcmp(entry->port, port) != 0))
+        entry = DEQ_NEXT(entry);
+
+    if (!entry) {
+        entry = NEW(qd_dns_entry_t);
+        ZERO(entry);
+        DEQ_ITEM_INIT(entry);
+        DEQ_ITEM_INIT_N(PENDING, entry);
+        entry->host    = strdup(host);
+        entry->port    = strdup(port);
+        entry->numeric = is_numeric_host(host);
+        size_t size    = strlen(host) + strlen(port) + 2;
+        entry->host_port = (char *) malloc(size);
+        snprintf(entry->host_port, size, "%s:%s", host, port);
+        DEQ_INSERT_TAIL(dns_cache.entries, entry);
+        if (!entry->numeric)
+            schedule_LH(entry);
+    }
+    entry->ref_count++;
+    sys_mutex_unlock(&dns_cache.lock);
+    return entry;
+}
+
+
+void qd_dns_entry_decref(qd_dns_entry_t *entry)
+{
+    if (!entry)
+        return;
+    sys_mutex_lock(&dns_cache.lock);
+    if (--entry->ref_count == 0)
+        free_entry_LH(entry);
+    sys_mutex_unlock(&dns_cache.lock);
+}
+
+
+const char *qd_dns_entry_lookup(qd_dns_entry_t *entry, char buffer[QD_DNS_CACHE_ADDRESS_MAX])
+{
+    if (entry->numeric)
+        return entry->host_port;
+
+    const char *address = entry->host_port;
+    int64_t     now     = now_usec() / 1000;
+
+    sys_mutex_lock(&dns_cache.lock);
+    if (entry->address_count > 0 && now < entry->expire_at) {
+        strcpy(buffer, entry->addresses[entry->next_address % entry->address_count]);
+        address = buffer;
+    }
+    if (now >= entry->refresh_at)
+        schedule_LH(entry);
+    sys_mutex_unlock(&dns_cache.lock);
+
+    qd_metric_inc(address == buffer ? dns_cache.hits : dns_cache.misses, 1);
+    return address;
+}
+
+
+void qd_dns_entry_connect_failed(qd_dns_entry_t *entry)
+{
+    if (entry->numeric)
+        return;
+    sys_mutex_lock(&dns_cache.lock);
+    if (entry->address_count > 1)
+        entry->next_address = (entry->next_address + 1) % entry->address_count;
+    sys_mutex_unlock(&dns_cache.lock);
+}
@@ -0,0 +1,64 @@
+#ifndef __dns_cache_h__
+#define __dns_cache_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Router-wide cache of the addresses of the hosts that connectors open connections to.
+ *
+ * Names are resolved by a single background thread, never by the thread opening a connection. A lookup returns a
+ * numeric address that proton can connect to without resolving it again, or the configured host:port when the name
+ * has not been resolved yet so that proton resolves it as before. Entries in use are resolved again before they
+ * expire. Failures are cached for a shorter time to bound the load a broken name puts on the resolver.
+ *
+ * getaddrinfo() does not return the TTL of the records it resolves, so resolved addresses are kept for
+ * QD_DNS_CACHE_TTL_MSEC.
+ *
+ * The /metrics HTTP endpoint reports the lookups as qdr_dns_cache_hits_total and qdr_dns_cache_misses_total, and the
+ * resolutions as qdr_dns_resolve_latency_microseconds and qdr_dns_resolve_failures_total.
+ */
+
+#include <stddef.h>
+
+#define QD_DNS_CACHE_TTL_MSEC          30000
+#define QD_DNS_CACHE_NEGATIVE_TTL_MSEC  5000
+#define QD_DNS_CACHE_ADDRESS_MAX        64     // "ipv6-address:port" plus the terminating null
+
+typedef struct qd_dns_entry_t qd_dns_entry_t;
+
+void qd_dns_cache_initialize(void);
+void qd_dns_cache_finalize(void);
+
+// Return the entry for host:port, created and queued for resolution on first use. Entries are shared by all the
+// connectors of a host:port and counted: release the entry with qd_dns_entry_decref().
+//
+qd_dns_entry_t *qd_dns_entry(const char *host, const char *port);
+void qd_dns_entry_decref(qd_dns_entry_t *entry);
+
+// Write the address to connect to into 'buffer' and return it, or return the configured host:port if no address has
+// been resolved. Never blocks on the resolver. Thread safe.
+//
+const char *qd_dns_entry_lookup(qd_dns_entry_t *entry, char buffer[QD_DNS_CACHE_ADDRESS_MAX]);
+
+// Report that a connection to the address last returned by qd_dns_entry_lookup() failed: later lookups return the
+// next resolved address of the host, if it has more than one. Thread safe.
+//
+void qd_dns_entry_connect_failed(qd_dns_entry_t *entry);
+
+#endif
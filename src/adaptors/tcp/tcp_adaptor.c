@@ -27,6 +27,8 @@
 #include <qpid/dispatch/log.h>
 #include <qpid/dispatch/platform.h>
 #include <qpid/dispatch/connection_counters.h>
+#include <qpid/dispatch/flight_recorder.h>
+#include <qpid/dispatch/flow_histograms.h>
 #include <qpid/dispatch/vanflow.h>
 #include <qpid/dispatch/tls_raw.h>
 #include <qpid/dispatch/threading.h>
@@ -35,8 +37,12 @@
 #include <proton/listener.h>
 
 #include "tcp_adaptor.h"
+#include "trace_probes.h"
+#include "decoders/http1/http1_decoder.h"
 
 #include <stdatomic.h>
+#include <strings.h>
+#include <time.h>
 
 //
 // Function suffixes in this module:
@@ -52,6 +58,7 @@
 ALLOC_DEFINE(qd_tcp_listener_t);
 ALLOC_DEFINE(qd_tcp_connector_t);
 ALLOC_DEFINE_SAFE(qd_tcp_connection_t);
+ALLOC_DEFINE(qd_tcp_lane_t);
 
 static const char *const state_names[] =
 {
@@ -63,6 +70,7 @@ static const char *const state_names[] =
     [LSIDE_TLS_FLOW]      = "LSIDE_TLS_FLOW",
 
     [CSIDE_INITIAL]       = "CSIDE_INITIAL",
+    [CSIDE_POOLED]        = "CSIDE_POOLED",
     [CSIDE_LINK_SETUP]    = "CSIDE_LINK_SETUP",
     [CSIDE_FLOW]          = "CSIDE_FLOW",
     [CSIDE_TLS_FLOW]      = "CSIDE_TLS_FLOW",
@@ -87,6 +95,13 @@ ENUM_DEFINE(qd_tcp_connection_state, state_names);
 #define ALPN_KEY      "alpn"
 #define ALPN_KEY_LEN  4
 
+// Striped flows, see "Striped Flows"
+#define STRIPES_KEY   "stripes"  // client stream: the stripes offered, server stream: the stripes of the flow
+#define STRIPE_KEY    "stripe"   // stripe stream: its stripe number
+
+// Shared core connections, see "Shared Core Connections"
+#define SHARED_KEY    "shared"   // client stream: the listener has shared connections, server stream: they are served
+
 #define TCP_NUM_ALPN_PROTOCOLS 2
 static const char *tcp_alpn_protocols[TCP_NUM_ALPN_PROTOCOLS] = {"http/1.1", "h2"};
 
@@ -104,6 +119,7 @@ typedef struct {
     qd_tcp_connection_list_t  connections;
     sys_mutex_t                lock;
     pn_proactor_t             *proactor;
+    uint64_t                   idle_usec;  // quiet period after which a connection sheds its read buffers, 0: never
 } qd_tcp_context_t;
 
 static qd_tcp_context_t *tcp_context;
@@ -127,15 +143,185 @@ static uint64_t buffer_threshold_85;
 // TCP_MAX_CAPACITY_BYTES: this is set to 2x the maximum number of bytes a cut through message can buffer. This makes
 // the window large enough to max out a message at each end of the TCP flow.
 //
+// The window starts at TCP_MAX_CAPACITY_BYTES and adapts to the path: the ingress times the round-trip from reading a
+// byte to the PN_RECEIVED update that covers it and measures the rate at which updates acknowledge bytes.  While the
+// window keeps closing the flow is window-limited and the window grows toward twice the bandwidth-delay product
+// (acknowledge rate x minimum round-trip), bounded by 1/TCP_WINDOW_CEILING_SHARE of the router buffer ceiling.  It
+// falls back to TCP_MAX_CAPACITY_BYTES when router buffer usage reaches 50% of the ceiling.
+//
+// When the tcpListener and the tcpConnector of a flow are on the same router the stream buffers pass directly between
+// the two raw connections through the cut-through ring of each stream, which bounds the data buffered and stalls the
+// producer when it is full.  The window adds nothing on such a local path, so once a connection finds that both ends
+// of a stream are local (see window_local_path()) the ingress disables its window and the egress stops sending
+// PN_RECEIVED updates, taking the core out of the flow's data path.  The egress sends one update after detecting
+// it, which reopens an ingress window closed before the ingress found the path to be local.
+//
 #define TCP_FULL_MSG_BYTES      (QD_BUFFER_DEFAULT_SIZE * UCT_SLOT_COUNT * UCT_SLOT_BUF_LIMIT)
 #define TCP_MAX_CAPACITY_BYTES  (TCP_FULL_MSG_BYTES * UINT64_C(2))
 #define TCP_ACK_THRESHOLD_BYTES TCP_FULL_MSG_BYTES
+#define TCP_WINDOW_CEILING_SHARE 32
 
 // is the incoming byte window full?
 //
 inline static bool window_full(const qd_tcp_connection_t *conn)
 {
-    return !conn->window.disabled && (conn->inbound_octets - conn->window.last_update) >= TCP_MAX_CAPACITY_BYTES;
+    return !conn->window.disabled && (conn->inbound_octets - conn->window.last_update) >= conn->window.max_size;
+}
+
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static uint64_t now_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+//
+// CPU time accounting of the raw connection event handlers. The connection being handled by this thread is charged
+// when its handler returns, or when it is closed since the connection may be freed by the core at any time after that.
+//
+static __thread qd_tcp_connection_t *timed_conn;
+static __thread uint64_t             timed_start_ns;
+
+static void start_cpu_time_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    timed_conn     = conn;
+    timed_start_ns = now_nsec();
+}
+
+static void charge_cpu_time_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    if (timed_conn == conn) {
+        if (!!conn->core_conn)
+            qdr_connection_add_cpu_time(conn->core_conn, now_nsec() - timed_start_ns);
+        timed_conn = 0;
+    }
+}
+
+static void window_init(qd_tcp_connection_t *conn)
+{
+    conn->window.max_size = TCP_MAX_CAPACITY_BYTES;
+    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_SIZE, conn->window.max_size);
+}
+
+// Bytes were read into the inbound stream: start timing the round-trip to the PN_RECEIVED update covering them
+// unless a measurement is already in flight.
+//
+static void window_bytes_read(qd_tcp_connection_t *conn)
+{
+    if (conn->window.probe_offset == 0 && !conn->window.disabled) {
+        conn->window.probe_offset = conn->inbound_octets;
+        conn->window.probe_time   = now_usec();
+    }
+}
+
+// The window was closed by the bytes just read
+//
+static void window_closed(qd_tcp_connection_t *conn)
+{
+    conn->window.closed_count += 1;
+    conn->window.limited       = true;
+    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_CLOSURES, conn->window.closed_count);
+    qd_flight_record(QD_FLIGHT_WINDOW_CLOSED, conn->conn_id, conn->inbound_octets, 0);
+}
+
+// A PN_RECEIVED update acknowledged the inbound bytes up to acked_offset (called before window.last_update moves)
+//
+static void window_update_acked(qd_tcp_connection_t *conn, uint64_t acked_offset)
+{
+    const uint64_t now   = now_usec();
+    const uint64_t acked = acked_offset - conn->window.last_update;
+
+    if (conn->window.probe_offset && acked_offset >= conn->window.probe_offset) {
+        const uint64_t rtt = MAX(now - conn->window.probe_time, 1);
+        conn->window.min_rtt = conn->window.min_rtt ? MIN(conn->window.min_rtt, rtt) : rtt;
+        conn->window.srtt    = conn->window.srtt ? (7 * conn->window.srtt + rtt) / 8 : rtt;
+        conn->window.probe_offset = 0;
+        vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_RTT, conn->window.srtt);
+    }
+
+    uint64_t max_size = conn->window.max_size;
+    if (qd_buffer_held_units() >= buffer_threshold_50) {
+        max_size = TCP_MAX_CAPACITY_BYTES;
+    } else if (conn->window.limited && conn->window.ack_time && conn->window.min_rtt && now > conn->window.ack_time) {
+        const uint64_t bdp     = acked * conn->window.min_rtt / (now - conn->window.ack_time);
+        const uint64_t ceiling = MAX(buffer_ceiling * QD_BUFFER_SIZE / TCP_WINDOW_CEILING_SHARE, TCP_MAX_CAPACITY_BYTES);
+        max_size               = MIN(MAX(max_size, 2 * bdp), ceiling);
+    }
+    conn->window.ack_time = now;
+    conn->window.limited  = false;
+
+    if (max_size != conn->window.max_size) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
+               "[C%" PRIu64 "] TCP RX window resized %" PRIu64 " -> %" PRIu64 " bytes (srtt=%" PRIu64 "us min_rtt=%" PRIu64 "us)",
+               conn->conn_id, conn->window.max_size, max_size, conn->window.srtt, conn->window.min_rtt);
+        conn->window.max_size = max_size;
+        vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_SIZE, max_size);
+    }
+}
+
+// Check whether the peer connection of the flow is on this router, given one of the connection's streams.  Once it is
+// found local the inbound window is disabled.
+//
+static bool window_local_path(qd_tcp_connection_t *conn, qd_message_t *stream)
+{
+    if (!conn->window.local_path && !!stream && qd_message_is_local_stream(stream)) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] TCP flow peer is local: window flow control disabled",
+               conn->conn_id);
+        conn->window.local_path = true;
+        conn->window.disabled   = true;
+    }
+    return conn->window.local_path;
+}
+
+// Account buffers given to the raw connection for writing, and the octets they carry, to the listener or connector of
+// the connection
+//
+static void count_raw_writes_XSIDE_IO(qd_tcp_connection_t *conn, uint64_t writes, uint64_t octets)
+{
+    if (!conn->common.parent || writes == 0) {
+        return;
+    }
+    qd_tcp_write_counters_t *counters = conn->common.parent->context_type == TL_LISTENER
+                                            ? &((qd_tcp_listener_t *) conn->common.parent)->raw_writes
+                                            : &((qd_tcp_connector_t *) conn->common.parent)->raw_writes;
+    qd_sharded_counter_add(&counters->writes, writes);
+    qd_sharded_counter_add(&counters->octets, octets);
+}
+
+// The first octet of the flow was read from the raw connection
+//
+static void first_inbound_octet_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    conn->inbound_first_octet = true;
+    if (conn->listener_side) {
+        conn->first_octet_time = now_usec();
+        vflow_latency_start(conn->common.vflow);
+    } else {
+        vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_PROCESS_LATENCY);
+    }
+}
+
+// The first octet of the flow was written to the raw connection: on the listener side this ends the time-to-first-byte
+// of the client (if the client spoke first)
+//
+static void first_outbound_octet_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    conn->outbound_first_octet = true;
+    if (conn->listener_side) {
+        if (conn->first_octet_time) {
+            qd_flow_histogram_record(QD_PROTOCOL_TCP, QD_FLOW_HIST_FIRST_BYTE, now_usec() - conn->first_octet_time);
+        }
+        vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_LATENCY);
+    } else {
+        vflow_latency_start(conn->common.vflow);
+    }
 }
 
 //
@@ -145,6 +331,7 @@ static void on_connection_event_CSIDE_IO(pn_event_t *e, qd_server_t *qd_server,
 static void connection_run_LSIDE_IO(qd_tcp_connection_t *conn);
 static void connection_run_CSIDE_IO(qd_tcp_connection_t *conn);
 static void connection_run_XSIDE_IO(qd_tcp_connection_t *conn);
+static void fast_open_read_LSIDE_IO(qd_tcp_connection_t *conn);
 static uint64_t validate_outbound_message(const qdr_delivery_t *out_dlv);
 static void on_accept(qd_adaptor_listener_t *listener, pn_listener_t *pn_listener, void *context);
 static void on_tls_connection_secured(qd_tls_session_t *tls, void *user_context);
@@ -152,6 +339,19 @@ static char *get_tls_negotiated_alpn(qd_message_t *msg);  // caller must free()
 static int setup_tls_session(qd_tcp_connection_t *conn, qd_tls_config_t *parent_config, const char *peer_hostname,
                              const char **alpn_protocols, size_t alpn_protocol_count);
 static void free_tcp_resource(qd_tcp_common_t *resource);
+static qd_tcp_lane_t *lane_open(qd_tcp_listener_t *li);
+static void lane_close(qd_tcp_lane_t *lane);
+static void lane_detach_flow_XSIDE_IO(qd_tcp_connection_t *conn);
+static void http1_free_XSIDE_IO(qd_tcp_connection_t *conn);
+static void http1_next_request_LSIDE_IO(qd_tcp_connection_t *conn);
+static uint64_t http1_read_requests_LSIDE_IO(qd_tcp_connection_t *conn, bool *read_closed);
+static uint64_t http1_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery);
+static void stripes_free_XSIDE_IO(qd_tcp_connection_t *conn);
+static uint32_t stripes_count_CSIDE_IO(qd_tcp_connection_t *conn);
+static void stripes_start_CSIDE_IO(qd_tcp_connection_t *conn, uint32_t count);
+static uint64_t stripes_read_CSIDE_IO(qd_tcp_connection_t *conn, bool *read_closed);
+static uint64_t stripes_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery);
+static uint32_t get_stream_uint_property(qd_message_t *msg, const char *name);
 
 //=================================================================================
 // Thread assertions
@@ -200,7 +400,10 @@ static void _setup_protocol_observer_LH(qd_tcp_listener_t *listener)
         qdpo_free(listener->protocol_observer);
         listener->protocol_observer = 0;
     } else if (!listener->protocol_observer) {
-        listener->protocol_observer = protocol_observer(QD_PROTOCOL_TCP, qdpo_config(0, listener->adaptor_config->observer));
+        qdpo_config_t *config = qdpo_config(0, listener->adaptor_config->observer);
+        qdpo_config_set_sample_interval(config, listener->adaptor_config->observer_sample_interval);
+        qdpo_config_set_name(config, listener->adaptor_config->name);
+        listener->protocol_observer = protocol_observer(QD_PROTOCOL_TCP, config);
     }
 }
 
@@ -227,6 +430,12 @@ static void qd_tcp_listener_free(qd_tcp_listener_t *listener)
     if (listener->protocol_observer)
         qdpo_free(listener->protocol_observer);
 
+    // The flows hold listener references: all lanes are idle
+    for (uint32_t i = 0; i < listener->lane_count; i++) {
+        lane_close(listener->lanes[i]);
+    }
+    free(listener->lanes);
+
     qd_tls_config_decref(listener->tls_config);
     qd_free_adaptor_config(listener->adaptor_config);
     sys_mutex_free(&listener->lock);
@@ -246,6 +455,10 @@ static void qd_tcp_listener_decref(qd_tcp_listener_t *listener)
  */
 static void qd_tcp_connector_free(qd_tcp_connector_t *connector)
 {
+    // The pool timer handler takes connector->lock, free it before locking
+    qd_timer_free(connector->pool_timer);
+    connector->pool_timer = 0;
+
     // Disable activation by the Core thread.
     sys_mutex_lock(&connector->lock);
     qd_timer_free(connector->activate_timer);
@@ -264,6 +477,7 @@ static void qd_tcp_connector_free(qd_tcp_connector_t *connector)
             connector->adaptor_config->address, connector->adaptor_config->host, connector->adaptor_config->port);
 
     qd_tls_config_decref(connector->tls_config);
+    qd_dns_entry_decref(connector->dns_entry);
     qd_free_adaptor_config(connector->adaptor_config);
 
     // Pass connector to Core for final deallocation. The Core will free the cr->lock.
@@ -390,6 +604,13 @@ static void TL_setup_listener(qd_tcp_listener_t *li)
     // will automatically close the listening socket. When a client connects to the listening socket the "on_accept"
     // callback will be invoked on the proactor listener thread.
     //
+    if (li->lane_count > 0) {
+        li->lanes = NEW_PTR_ARRAY(qd_tcp_lane_t, li->lane_count);
+        for (uint32_t i = 0; i < li->lane_count; i++) {
+            li->lanes[i] = lane_open(li);
+        }
+    }
+
     li->adaptor_listener = qd_adaptor_listener(tcp_context->qd, li->adaptor_config, LOG_TCP_ADAPTOR);
     qd_adaptor_listener_listen(li->adaptor_listener, on_accept, li);
 }
@@ -492,10 +713,14 @@ static void qdr_core_free_tcp_resource_CT(qdr_core_t *core, qdr_action_t *action
     qd_tcp_common_t *common = (qd_tcp_common_t*) action->args.general.context_1;
     if (common->context_type == TL_CONNECTION) {
         qd_tcp_connection_t *conn = (qd_tcp_connection_t*) common;
-        sys_atomic_destroy(&conn->core_activation);
         sys_atomic_destroy(&conn->raw_opened);
         sys_mutex_free(&conn->activation_lock);
         free_qd_tcp_connection_t(conn);
+    } else if (common->context_type == TL_LANE) {
+        qd_tcp_lane_t *lane = (qd_tcp_lane_t*) common;
+        sys_mutex_free(&lane->lock);
+        sys_mutex_free(&lane->activation_lock);
+        free_qd_tcp_lane_t(lane);
     } else {
         // Core does not hold a reference to a listener so they are not freed here
         assert(common->context_type == TL_CONNECTOR);
@@ -551,6 +776,11 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
     if (conn->state != XSIDE_CLOSING)
         set_state_XSIDE_IO(conn, XSIDE_CLOSING);
 
+    if (!!conn->lane) {
+        // before the listener reference is dropped: the lanes are closed with the listener
+        lane_detach_flow_XSIDE_IO(conn);
+    }
+
     if (conn->common.parent) {
         if (conn->common.parent->context_type == TL_LISTENER) {
             qd_tcp_listener_t *listener = (qd_tcp_listener_t*) conn->common.parent;
@@ -573,15 +803,21 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
         } else {
             qd_tcp_connector_t *connector = (qd_tcp_connector_t*) conn->common.parent;
             sys_mutex_lock(&connector->lock);
-            connector->connections_closed++;
-            if (IS_ATOMIC_FLAG_SET(&connector->closing)) {
-                // Wake up the next conn on the list to get it closed
-                // See qd_dispatch_delete_tcp_connector() where the head connection is woken up.
-                qd_tcp_connection_t *next_conn = DEQ_NEXT(conn);
-                if (!!next_conn)
-                    pn_raw_connection_wake(next_conn->raw_conn);
+            if (conn->pooled) {
+                // Never claimed by a flow, so it was never counted as opened
+                DEQ_REMOVE(connector->pool, conn);
+                conn->pooled = false;
+            } else {
+                connector->connections_closed++;
+                if (IS_ATOMIC_FLAG_SET(&connector->closing)) {
+                    // Wake up the next conn on the list to get it closed
+                    // See qd_dispatch_delete_tcp_connector() where the head connection is woken up.
+                    qd_tcp_connection_t *next_conn = DEQ_NEXT(conn);
+                    if (!!next_conn)
+                        pn_raw_connection_wake(next_conn->raw_conn);
+                }
+                DEQ_REMOVE(connector->connections, conn);
             }
-            DEQ_REMOVE(connector->connections, conn);
             sys_mutex_unlock(&connector->lock);
             //
             // Call connector decref when a connection associated with the connector is removed (DEQ_REMOVE(connector->connections, conn))
@@ -627,13 +863,24 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
         qdr_delivery_decref(tcp_context->core, conn->inbound_delivery, "close_connection_XSIDE_IO - inbound_delivery released");
     }
 
+    if (!!conn->http1) {
+        http1_free_XSIDE_IO(conn);
+    }
+
+    if (!!conn->stripes) {
+        stripes_free_XSIDE_IO(conn);
+    }
+
     if (!!conn->inbound_link) {
         qdr_link_notify_closed(conn->inbound_link, true);
     }
 
     if (!!conn->outbound_delivery) {
         qdr_delivery_remote_state_updated(tcp_context->core, conn->outbound_delivery, PN_MODIFIED, true, 0, false);
-        qdr_delivery_set_context(conn->outbound_delivery, 0);
+        if (qdr_delivery_get_context(conn->outbound_delivery) == (void*) conn) {
+            // the server stream of a flow of a shared connection stays orphaned, see lane_detach_flow_XSIDE_IO()
+            qdr_delivery_set_context(conn->outbound_delivery, 0);
+        }
         qdr_delivery_decref(tcp_context->core, conn->outbound_delivery, "close_connection_XSIDE_IO - outbound_delivery released");
     }
 
@@ -641,15 +888,31 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
         qdr_link_notify_closed(conn->outbound_link, true);
     }
 
-    if (conn->observer_handle) {
-        qdpo_end(conn->observer_handle);
+    if (conn->flow_start) {
+        const uint64_t duration = MAX(now_usec() - conn->flow_start, 1);
+        qd_flow_histogram_record(QD_PROTOCOL_TCP, QD_FLOW_HIST_DURATION, duration);
+        qd_flow_histogram_record(QD_PROTOCOL_TCP, QD_FLOW_HIST_THROUGHPUT,
+                                 (conn->inbound_octets + conn->outbound_octets) * 1000000 / duration);
+        vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_DURATION, duration);
+        conn->flow_start = 0;
     }
 
+    charge_cpu_time_XSIDE_IO(conn);
+
     if (!!conn->common.vflow) {
         if (conn->listener_side) {
             vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS, conn->inbound_octets);
         }
-        vflow_end_record(conn->common.vflow);
+        if (!!conn->core_conn) {
+            vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_CPU_TIME, qdr_connection_cpu_time(conn->core_conn) / 1000);
+        }
+        if (!conn->observer_handle) {
+            vflow_end_record(conn->common.vflow);
+        }
+    }
+
+    if (conn->observer_handle) {
+        qdpo_end(conn->observer_handle);  // also ends the vflow record once the observer is done with it
     }
 
     if (!!conn->core_conn) {
@@ -661,8 +924,12 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
     qd_tls_session_free(conn->tls_session);
     free(conn->alpn_protocol);
     free(conn->reply_to);
+    free(conn->flow_tag);
+    qd_timer_free(conn->throttle_timer);
+    qd_policy_rate_limits_free(conn->rate_limits);
 
     conn->reply_to          = 0;
+    conn->flow_tag          = 0;
     conn->inbound_link      = 0;
     conn->inbound_stream    = 0;
     conn->inbound_delivery  = 0;
@@ -672,6 +939,8 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
     conn->observer_handle   = 0;
     conn->common.vflow      = 0;
     conn->tls_session       = 0;
+    conn->throttle_timer    = 0;
+    conn->rate_limits       = 0;
 
     // No thread assertion here - can be RAW_IO or TIMER_IO
     qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] Cleaning up resources", conn->conn_id);
@@ -690,525 +959,2322 @@ static void close_connection_XSIDE_IO(qd_tcp_connection_t *conn)
 }
 
 
-static void grant_read_buffers_XSIDE_IO(qd_tcp_connection_t *conn, const size_t capacity)
+// Apply a disposition update of the inbound delivery of a connection
+//
+// @return true if the connection is to be run
+//
+static bool inbound_delivery_update_XSIDE_IO(qd_tcp_connection_t *conn, uint64_t disp, bool settled, uint64_t received_offset)
 {
     ASSERT_RAW_IO;
+    qdr_delivery_t *dlv = conn->inbound_delivery;
+
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Inbound delivery update - disposition: %s", DLV_ARGS(dlv), pn_disposition_type_name(disp));
+    conn->inbound_disposition = disp;
+    const bool final_outcome = qd_delivery_state_is_terminal(disp);
+    if (final_outcome && disp != PN_ACCEPTED) {
+        // The delivery failed - this is unrecoverable.
+        if (!!conn->raw_conn) {
+            close_raw_connection(conn, "delivery-failed", "destination unreachable");
+            // clean stuff up when DISCONNECT event arrives
+        }
+    } else {
+        //
+        // handle flow control window updates
+        //
+        const bool window_was_full = window_full(conn);
 
-    //
-    // Cannot grant read buffers if the connection is currently blocked due to window flow control
-    //
-    if (window_full(conn)) {
-        return;
-    }
-
-    //
-    // Define the allocation tiers.  The tier values are the number of read buffers to be granted
-    // to raw connections based on the percentage of usage of the router-wide buffer ceiling.
-    //
-#define TIER_1 8  // [0% .. 50%)
-#define TIER_2 4  // [50% .. 75%)
-#define TIER_3 2  // [75% .. 85%)
-#define TIER_4 1  // [85% .. 100%]
+        // Resend released will generate a PN_RECEIVED with section_offset == 0, ignore it.  Ensure updates
+        // arrive in order, which may not happen if cut-through for disposition updates is implemented.
+        if (received_offset > 0
+            && (int64_t)(received_offset - conn->window.last_update) > 0) {
 
-    //
-    // Since we can't query Proton for the maximum read-buffer capacity, we will infer it from
-    // calls to pn_raw_connection_read_buffers_capacity.
-    //
-    static atomic_size_t max_capacity;
-    size_t current_mc = atomic_load(&max_capacity);
-    while (capacity > current_mc) {
-        if (atomic_compare_exchange_weak(&max_capacity, &current_mc, capacity))
-            break;
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
+                   DLV_FMT " PN_RECEIVED inbound_bytes=%" PRIu64 ", was_unacked=%" PRIu64 ", rcv_offset=%" PRIu64 " now_unacked=%" PRIu64,
+                   DLV_ARGS(dlv), conn->inbound_octets,
+                   (conn->inbound_octets - conn->window.last_update),
+                   received_offset,
+                   (conn->inbound_octets - received_offset));
+            window_update_acked(conn, received_offset);
+            conn->window.last_update = received_offset;
+            //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_UNACKED, conn->inbound_octets - received_offset);
+        }
+        // the window needs to be disabled when the remote settles or sets the final outcome because once that
+        // occurs the remote will no longer send PN_RECEIVED updates necessary to open the window.  The same holds
+        // once the remote found the path to be local.
+        conn->window.disabled = conn->window.disabled || settled || final_outcome;
+        if (received_offset > 0) {
+            window_local_path(conn, conn->inbound_stream);
+        }
+        if (window_was_full && !window_full(conn)) {
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
+                   DLV_FMT " TCP RX window %s: inbound_bytes=%" PRIu64 " unacked=%" PRIu64,
+                   DLV_ARGS(dlv),
+                   conn->window.disabled ? "DISABLED" : "OPENED",
+                   conn->inbound_octets, (conn->inbound_octets - conn->window.last_update));
+        }
     }
+    return !window_full(conn);
+}
 
-    //
-    // Get the "held_by_threads" stats for router buffers as an approximation of how many
-    // buffers are in-use.  This is an approximation since it also counts free buffers held
-    // in the per-thread free-pools.  Since we will be dealing with large numbers here, the
-    // number of buffers in free-pools will not be significant.
-    //
-    qd_alloc_stats_t  stats          = alloc_stats_qd_buffer_t();
-    uint64_t          buffers_in_use = stats.held_by_threads;
 
-    //
-    // Choose the grant-allocation tier based on the number of buffers in use.
-    //
-    size_t desired = TIER_4;
-    if (buffers_in_use < buffer_threshold_50) {
-        desired = TIER_1;
-    } else if (buffers_in_use < buffer_threshold_75) {
-        desired = TIER_2;
-    } else if (buffers_in_use < buffer_threshold_85) {
-        desired = TIER_3;
-    }
+// Take up the server stream of a listener side connection: its message sections up to the body have been validated.
+// The caller has set the delivery context and holds a delivery reference for the connection.
+//
+static void start_outbound_stream_LSIDE_IO(qd_tcp_connection_t *conn, qdr_delivery_t *delivery)
+{
+    ASSERT_RAW_IO;
+    conn->outbound_delivery = delivery;
+    conn->outbound_stream   = qdr_delivery_message(delivery);
 
     //
-    // Determine how many buffers are already granted.  This will always be a non-negative value.
+    // Message validation ensures the start of the message body is present. Activate cutthrough on the body data.
     //
-    current_mc = atomic_load(&max_capacity);
-    assert(current_mc >= capacity);
-    size_t already_granted = current_mc - capacity;
+    qd_message_activation_t activation;
+    activation.type     = QD_ACTIVATION_TCP;
+    activation.delivery = 0;
+    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP enabling consumer activation", DLV_ARGS(delivery));
+    qd_message_set_consumer_activation(conn->outbound_stream, &activation);
+    qd_message_start_unicast_cutthrough(conn->outbound_stream);
+}
 
-    //
-    // If we desire to grant additional buffers, calculate the number to grant now.
-    //
-    const size_t granted = desired > already_granted ? desired - already_granted : 0;
 
-    if (granted > 0) {
-        //
-        // Grant the buffers.
-        //
-        pn_raw_buffer_t raw_buffers[granted];
+//=================================================================================
+// Shared Core Connections
+//=================================================================================
+//
+// A tcpListener configured with sharedConnections N opens N core connections (lanes) with it and assigns each new flow
+// to one of them round robin, instead of opening a core connection with an inbound and an outbound link for every
+// flow.  The core then sees a flow as no more than its two streaming deliveries.
+//
+// The client streams of a lane's flows are all sent on the lane's inbound link and carry the reply-to of the lane's
+// outbound link, with a flow tag as message-id.  The connector side echoes the flow tag as the correlation-id of the
+// server stream.  The core forwards each server stream onto a streaming link of the lane's connection, so a long lived
+// flow does not hold up the others, and the lane hands the stream to the flow waiting for its tag.  A server stream
+// without the tag of a waiting flow is rejected: connector side routers that do not echo the tag cannot serve the
+// flows of shared connections.
+//
+// The flows of such a listener therefore start out with core connections of their own, as if sharedConnections were
+// not set, and their client streams carry SHARED_KEY.  A connector side router that serves shared connections answers
+// with SHARED_KEY in the server stream, and only then are the following flows of the listener put on its lanes.  A
+// lane that has to reject a server stream puts the listener back to per-flow connections until a connector side
+// router answers the offer again.
+//
+// The core connection of a lane is processed on a timer thread with lane->lock held.  A flow runs on the I/O thread of
+// its raw connection as usual: the lane does not call into it but passes on the core events of its deliveries in
+// conn->lane_update and wakes the raw connection.  A closing flow clears the context of its deliveries under
+// lane->lock, after which the lane cannot reach it.  Its server stream is marked orphaned rather than cleared: it stays
+// at the head of its streaming link until the settlement of the closing flow reaches the core, and the lane must not
+// take it for a new server stream meanwhile.
+//
+// The lanes are closed with the listener, after its last flow.  A lane whose core connection is closed by the core
+// (management delete, policy) or whose links are detached fails the flows that have started on them and opens new ones
+// in their place.  The flows still waiting for a reply-to start on the new links.
+//
+static qd_tcp_common_t lane_orphan = {.context_type = TL_ORPHAN};
 
-        for (size_t i = 0; i < granted; i++) {
-            qd_buffer_t *buf = qd_buffer();
-            raw_buffers[i].context  = (uintptr_t) buf;
-            raw_buffers[i].bytes    = (char*) qd_buffer_base(buf);
-            raw_buffers[i].capacity = qd_buffer_capacity(buf);
-            raw_buffers[i].offset   = 0;
-            raw_buffers[i].size     = 0;
-        }
+static void on_lane_activate_TIMER_IO(void *context)
+{
+    SET_THREAD_TIMER_IO;
+    qd_tcp_lane_t *lane = (qd_tcp_lane_t*) context;
+    sys_mutex_lock(&lane->lock);
+    qdr_connection_process(lane->core_conn);
+    sys_mutex_unlock(&lane->lock);
+}
 
-        size_t actual = pn_raw_connection_give_read_buffers(conn->raw_conn, raw_buffers, granted);
-        (void) actual;
-        assert(actual == granted);
 
-        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] grant_read_buffers_XSIDE_IO - %ld", conn->conn_id, granted);
-    }
+static void lane_attach_inbound_LH(qd_tcp_lane_t *lane)
+{
+    qd_tcp_listener_t *li     = (qd_tcp_listener_t*) lane->common.parent;
+    qdr_terminus_t    *target = qdr_terminus(0);
+
+    qdr_terminus_set_address(target, li->adaptor_config->address);
+    lane->inbound_link = qdr_link_first_attach(lane->core_conn, QD_INCOMING, qdr_terminus(0), target, "tcp.lane.in", 0, false, 0, &lane->inbound_link_id);
+    qdr_link_set_context(lane->inbound_link, lane);
 }
 
 
-static uint64_t produce_read_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream, bool *read_closed)
+static void lane_attach_outbound_LH(qd_tcp_lane_t *lane)
 {
-    ASSERT_RAW_IO;
-    uint64_t octet_count = 0;
-    *read_closed = false;
+    qdr_terminus_t *source = qdr_terminus(0);
 
-    if (qd_message_can_produce_buffers(stream)) {
-        qd_buffer_list_t qd_buffers = DEQ_EMPTY;
-        pn_raw_buffer_t  raw_buffers[RAW_BUFFER_BATCH_SIZE];
-        size_t           count;
+    qdr_terminus_set_dynamic(source);
+    lane->outbound_link = qdr_link_first_attach(lane->core_conn, QD_OUTGOING, source, qdr_terminus(0), "tcp.lane.out", 0, false, 0, &lane->outbound_link_id);
+    qdr_link_set_context(lane->outbound_link, lane);
+    qdr_link_flow(tcp_context->core, lane->outbound_link, 1, false);
+}
 
-        count = pn_raw_connection_take_read_buffers(conn->raw_conn, raw_buffers, RAW_BUFFER_BATCH_SIZE);
-        while (count > 0) {
-            for (size_t i = 0; i < count; i++) {
-                qd_buffer_t *buf = (qd_buffer_t*) raw_buffers[i].context;
-                qd_buffer_insert(buf, raw_buffers[i].size);
-                octet_count += raw_buffers[i].size;
-                if (qd_buffer_size(buf) > 0) {
-                    DEQ_INSERT_TAIL(qd_buffers, buf);
-                    if (conn->listener_side && !!conn->observer_handle) {
-                        qdpo_data(conn->observer_handle, true, qd_buffer_base(buf), qd_buffer_size(buf));
-                    }
-                } else {
-                    qd_buffer_free(buf);
-                }
-            }
-            count = pn_raw_connection_take_read_buffers(conn->raw_conn, raw_buffers, RAW_BUFFER_BATCH_SIZE);
-        }
 
-        // ISSUE-1446: it is only safe to check pn_raw_connection_is_read_closed() after all read buffers are drained since
-        // the connection can be marked closed while read buffers are still pending in the raw connection.
-        //
-        *read_closed = pn_raw_connection_is_read_closed(conn->raw_conn);
+static void lane_open_core_conn_LH(qd_tcp_lane_t *lane)
+{
+    qd_tcp_listener_t *li = (qd_tcp_listener_t*) lane->common.parent;
 
-        if (!DEQ_IS_EMPTY(qd_buffers)) {
-            //qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] produce_read_buffers_XSIDE_IO - Producing %ld buffers", conn->conn_id, DEQ_SIZE(qd_buffers));
-            qd_message_produce_buffers(stream, &qd_buffers);
-        }
-    }
+    lane->conn_id   = qd_server_allocate_connection_id(tcp_context->server);
+    lane->core_conn = TL_open_core_connection(lane->conn_id, true, "ingress-dispatch");
+    qdr_connection_set_context(lane->core_conn, lane);
+    lane_attach_inbound_LH(lane);
+    lane_attach_outbound_LH(lane);
 
-    return octet_count;
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] Shared core connection opened for tcpListener %s", lane->conn_id,
+           li->adaptor_config->name);
 }
 
 
-static uint64_t consume_write_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream)
+static qd_tcp_lane_t *lane_open(qd_tcp_listener_t *li)
 {
-    ASSERT_RAW_IO;
-    size_t   limit       = pn_raw_connection_write_buffers_capacity(conn->raw_conn);
-    uint64_t octet_count = 0;
+    qd_tcp_lane_t *lane = new_qd_tcp_lane_t();
+    ZERO(lane);
+
+    lane->common.context_type = TL_LANE;
+    lane->common.parent       = &li->common;
+    sys_mutex_init(&lane->lock);
+    sys_mutex_init(&lane->activation_lock);
+    DEQ_INIT(lane->flows);
+    lane->awaiting       = qd_hash(10, 32, 0);
+    lane->activate_timer = qd_timer(tcp_context->qd, on_lane_activate_TIMER_IO, lane);
+
+    sys_mutex_lock(&lane->lock);
+    lane_open_core_conn_LH(lane);
+    sys_mutex_unlock(&lane->lock);
+    return lane;
+}
 
-    if (limit > 0) {
-        qd_buffer_list_t buffers = DEQ_EMPTY;
-        size_t actual = qd_message_consume_buffers(stream, &buffers, limit);
-        assert(actual == DEQ_SIZE(buffers));
-        if (actual > 0) {
-            pn_raw_buffer_t raw_buffers[actual];
-            qd_buffer_t *buf = DEQ_HEAD(buffers);
-            for (size_t i = 0; i < actual; i++) {
-                if (conn->listener_side && !!conn->observer_handle) {
-                    qdpo_data(conn->observer_handle, false, qd_buffer_base(buf), qd_buffer_size(buf));
-                }
-                raw_buffers[i].context  = (uintptr_t) buf;
-                raw_buffers[i].bytes    = (char*) qd_buffer_base(buf);
-                raw_buffers[i].capacity = qd_buffer_capacity(buf);
-                raw_buffers[i].size     = qd_buffer_size(buf);
-                raw_buffers[i].offset   = 0;
-                octet_count += raw_buffers[i].size;
-                buf = DEQ_NEXT(buf);
-            }
-            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] consume_write_buffers_XSIDE_IO - Consuming %ld buffers", conn->conn_id, actual);
-            pn_raw_connection_write_buffers(conn->raw_conn, raw_buffers, actual);
-        }
-    }
 
-    return octet_count;
+static void lane_close(qd_tcp_lane_t *lane)
+{
+    // Disable activation by the Core thread.
+    sys_mutex_lock(&lane->activation_lock);
+    qd_timer_free(lane->activate_timer);
+    lane->activate_timer = 0;
+    sys_mutex_unlock(&lane->activation_lock);
+
+    sys_mutex_lock(&lane->lock);
+    assert(DEQ_IS_EMPTY(lane->flows) && qd_hash_size(lane->awaiting) == 0);  // the flows hold the listener
+    qdr_link_notify_closed(lane->inbound_link, true);
+    qdr_link_notify_closed(lane->outbound_link, true);
+    qdr_connection_notify_closed(lane->core_conn);
+    lane->inbound_link  = 0;
+    lane->outbound_link = 0;
+    lane->core_conn     = 0;
+    sys_mutex_unlock(&lane->lock);
+    qd_connection_counter_dec(QD_PROTOCOL_TCP);
+
+    qd_hash_free(lane->awaiting);
+    free(lane->reply_to);
+
+    // Pass the lane to Core for final deallocation, see qdr_core_free_tcp_resource_CT()
+    free_tcp_resource(&lane->common);
 }
 
-// Alternative to consume_message_body_XSIDE_IO() for use with TLS connections. The TLS layer takes ownership of all
-// output message buffers and will free them as they are processed. Due to that we need to make a copy of these buffers
-// in order to avoid freeing buffers that are part of the message (double-free).
+
+// Wake a flow of the lane to take up its lane_update.  Called on the lane's I/O thread.
 //
-static void copy_message_body_TLS_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream, qd_buffer_list_t *buffers, size_t limit)
+static void lane_wake_flow_LH(qd_tcp_connection_t *conn)
 {
-    size_t   offset = 0;
-
-    assert(conn->tls_session);
-
-    if (!conn->outbound_body) {
-        assert(!conn->outbound_body_complete);
-        qd_message_get_raw_body_data(stream, &conn->outbound_body, &offset);
+    conn->lane_update.pending = true;
+    sys_mutex_lock(&conn->activation_lock);
+    if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
+        pn_raw_connection_wake(conn->raw_conn);
     }
+    sys_mutex_unlock(&conn->activation_lock);
+}
 
-    while (limit-- && conn->outbound_body) {
-        size_t size = qd_buffer_size(conn->outbound_body) - offset;
-        if (size > 0) {
-            qd_buffer_t *clone = qd_buffer();
-            clone->size = size;
-            memcpy(qd_buffer_base(clone), qd_buffer_base(conn->outbound_body) + offset, size);
-            DEQ_INSERT_TAIL(*buffers, clone);
-        }
-        offset = 0;
-        conn->outbound_body = DEQ_NEXT(conn->outbound_body);
-    }
 
-    if (!conn->outbound_body) {
-        conn->outbound_body_complete = true;
-        qd_message_release_raw_body(stream);
+static void lane_attach_flow_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_listener_t *li   = (qd_tcp_listener_t*) conn->common.parent;
+    qd_tcp_lane_t     *lane = li->lanes[atomic_fetch_add_explicit(&li->next_lane, 1, memory_order_relaxed) % li->lane_count];
+    char               tag[24];
+
+    snprintf(tag, sizeof(tag), "%" PRIu64, conn->conn_id);
+    conn->lane     = lane;
+    conn->flow_tag = qd_strdup(tag);
+
+    sys_mutex_lock(&lane->lock);
+    DEQ_INSERT_TAIL_N(LANE, lane->flows, conn);
+    conn->inbound_link_id  = lane->inbound_link_id;
+    conn->outbound_link_id = lane->outbound_link_id;
+    if (!!lane->reply_to) {
+        conn->reply_to = qd_strdup(lane->reply_to);
+    } else {
+        conn->lane_waiting = true;
     }
+    sys_mutex_unlock(&lane->lock);
 }
 
-static uint64_t consume_message_body_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream)
+
+static void lane_deliver_client_stream_LSIDE_IO(qd_tcp_connection_t *conn)
 {
     ASSERT_RAW_IO;
-    assert(!conn->outbound_body_complete);
+    qd_tcp_lane_t *lane = conn->lane;
 
-    uint64_t octets = 0;
-    size_t   offset = 0;
+    sys_mutex_lock(&lane->lock);
+    qd_hash_insert_str(lane->awaiting, (const unsigned char*) conn->flow_tag, conn, &conn->awaiting_handle);
+    conn->inbound_delivery = qdr_link_deliver(lane->inbound_link, conn->inbound_stream, 0, false, 0, 0, 0, 0);
+    qdr_delivery_set_context(conn->inbound_delivery, conn);
+    sys_mutex_unlock(&lane->lock);
+}
 
-    if (!conn->outbound_body) {
-        // Get the pointer to the buffer containing the first octet of the body and the offset to that octet.  If there
-        // are no body octets, we will be given a NULL pointer.
-        //
-        qd_message_get_raw_body_data(stream, &conn->outbound_body, &offset);
-    }
 
-    //
-    // Process classic (non cut-though) body buffers until they are all sent onto the raw connection.
-    // Note that this may take multiple runs through this function if there is any back-pressure
-    // outbound on the raw connection.
-    //
-    // Note: There may be a non-zero offset only on the first body buffer.  It is assumed that 
-    //       every subsequent buffer will have an offset of 0.
-    //
-    const bool observe = conn->listener_side && !!conn->observer_handle;
-    while (!!conn->outbound_body && pn_raw_connection_write_buffers_capacity(conn->raw_conn) > 0) {
-        unsigned char *bytes = qd_buffer_base(conn->outbound_body) + offset;
-        size_t         size  = qd_buffer_size(conn->outbound_body) - offset;
+static void lane_take_update_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_lane_t        *lane = conn->lane;
+    qd_tcp_lane_update_t  update;
+
+    sys_mutex_lock(&lane->lock);
+    update = conn->lane_update;
+    ZERO(&conn->lane_update);
+    if (!conn->reply_to && !!lane->reply_to) {
+        conn->reply_to         = qd_strdup(lane->reply_to);
+        conn->inbound_link_id  = lane->inbound_link_id;
+        conn->outbound_link_id = lane->outbound_link_id;
+    }
+    sys_mutex_unlock(&lane->lock);
 
-        if (observe) {
-            qdpo_data(conn->observer_handle, false, bytes, size);
+    if (!update.pending) {
+        return;
+    }
+    if (update.closed) {
+        // the server stream handed over with the update is released with the connection's outbound delivery
+        if (!!update.outbound_delivery) {
+            assert(!conn->outbound_delivery);
+            conn->outbound_delivery = update.outbound_delivery;
         }
-        pn_raw_buffer_t raw_buffer;
-        raw_buffer.context  = 0;
-        raw_buffer.bytes    = (char*) bytes;
-        raw_buffer.capacity = 0;
-        raw_buffer.size     = size;
-        raw_buffer.offset   = 0;
-        octets += raw_buffer.size;
-        pn_raw_connection_write_buffers(conn->raw_conn, &raw_buffer, 1);
-        conn->outbound_body = DEQ_NEXT(conn->outbound_body);
-        offset = 0;
+        if (conn->state != XSIDE_CLOSING) {
+            close_raw_connection(conn, "delivery-failed", "shared connection closed");
+        }
+        return;
     }
-
-    if (!conn->outbound_body) {
-        conn->outbound_body_complete = true;
-        qd_message_release_raw_body(stream);
+    if (!!update.outbound_delivery) {
+        start_outbound_stream_LSIDE_IO(conn, update.outbound_delivery);
+    }
+    if (update.outbound_disposition) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Outbound delivery update - disposition: %s",
+               DLV_ARGS(conn->outbound_delivery), pn_disposition_type_name(update.outbound_disposition));
+        conn->outbound_disposition = update.outbound_disposition;
+    }
+    if (update.inbound_disposition) {
+        inbound_delivery_update_XSIDE_IO(conn, update.inbound_disposition, update.inbound_settled, update.received_offset);
     }
-
-    return octets;
 }
 
 
-static void link_setup_LSIDE_IO(qd_tcp_connection_t *conn)
+static void lane_detach_flow_XSIDE_IO(qd_tcp_connection_t *conn)
 {
-    ASSERT_RAW_IO;
-    qd_tcp_listener_t *li = (qd_tcp_listener_t*) conn->common.parent;
-    qdr_terminus_t *target = qdr_terminus(0);
-    qdr_terminus_t *source = qdr_terminus(0);
-    char               host[64];  // for numeric remote client IP:port address
+    // No thread assertion here - can be RAW_IO or TIMER_IO
+    qd_tcp_lane_t *lane = conn->lane;
+
+    sys_mutex_lock(&lane->lock);
+    DEQ_REMOVE_N(LANE, lane->flows, conn);
+    conn->lane_waiting = false;
+    if (!!conn->awaiting_handle) {
+        qd_hash_remove_by_handle(lane->awaiting, conn->awaiting_handle);
+        qd_hash_handle_free(conn->awaiting_handle);
+        conn->awaiting_handle = 0;
+    }
+    if (!!conn->lane_update.outbound_delivery) {
+        // handed over but not taken up: released with the connection's outbound delivery
+        assert(!conn->outbound_delivery);
+        conn->outbound_delivery = conn->lane_update.outbound_delivery;
+    }
+    ZERO(&conn->lane_update);
+    if (!!conn->inbound_delivery) {
+        qdr_delivery_set_context(conn->inbound_delivery, 0);
+    }
+    if (!!conn->outbound_delivery) {
+        qdr_delivery_set_context(conn->outbound_delivery, &lane_orphan);
+    }
+    sys_mutex_unlock(&lane->lock);
+    conn->lane = 0;
+}
 
-    qdr_terminus_set_address(target, li->adaptor_config->address);
-    qdr_terminus_set_dynamic(source);
 
-    qd_raw_conn_get_address_buf(conn->raw_conn, host, sizeof(host));
-    conn->core_conn = TL_open_core_connection(conn->conn_id, true, host);
-    qdr_connection_set_context(conn->core_conn, conn);
-    conn->inbound_link = qdr_link_first_attach(conn->core_conn, QD_INCOMING, qdr_terminus(0), target, "tcp.lside.in", 0, false, 0, &conn->inbound_link_id);
-    qdr_link_set_context(conn->inbound_link, conn);
-    conn->outbound_link = qdr_link_first_attach(conn->core_conn, QD_OUTGOING, source, qdr_terminus(0), "tcp.lside.out", 0, false, 0, &conn->outbound_link_id);
-    qdr_link_set_context(conn->outbound_link, conn);
-    qdr_link_set_user_streaming(conn->outbound_link);
-    qdr_link_flow(tcp_context->core, conn->outbound_link, 1, false);
+// The outbound link of the lane is attached: its address is the reply-to of the lane's flows.  Called on the lane's
+// I/O thread.
+//
+static void lane_outbound_attached_LH(qd_tcp_lane_t *lane, qdr_terminus_t *source)
+{
+    free(lane->reply_to);
+    lane->reply_to = (char*) qd_iterator_copy(qdr_terminus_get_address(source));
+    for (qd_tcp_connection_t *conn = DEQ_HEAD(lane->flows); !!conn; conn = DEQ_NEXT_N(LANE, conn)) {
+        if (conn->lane_waiting) {
+            conn->lane_waiting = false;
+            lane_wake_flow_LH(conn);
+        }
+    }
 }
 
 
-static void link_setup_CSIDE_IO(qd_tcp_connection_t *conn, qdr_delivery_t *delivery)
+// Fail the flows that have started on the links of the lane: their client streams or the reply-to they carry are
+// gone.  The flows still waiting for reply_to start on the links that replace them.  Called on the lane's I/O thread.
+//
+static void lane_fail_flows_LH(qd_tcp_lane_t *lane)
 {
-    ASSERT_RAW_IO;
-
-    assert(conn->common.parent->context_type == TL_CONNECTOR);
-    const char *host = ((qd_tcp_connector_t *) conn->common.parent)->adaptor_config->host_port;
-    conn->core_conn  = TL_open_core_connection(conn->conn_id, false, host);
-    qdr_connection_set_context(conn->core_conn, conn);
+    for (qd_tcp_connection_t *conn = DEQ_HEAD(lane->flows); !!conn; conn = DEQ_NEXT_N(LANE, conn)) {
+        if (!conn->lane_waiting) {
+            conn->lane_update.closed = true;
+            lane_wake_flow_LH(conn);
+        }
+    }
+}
 
-    // use an anonymous inbound link in order to ensure credit arrives otherwise if the client has dropped the state machine will stall waiting for credit
-    conn->inbound_link = qdr_link_first_attach(conn->core_conn, QD_INCOMING, qdr_terminus(0), qdr_terminus(0), "tcp.cside.in", 0, false, 0, &conn->inbound_link_id);
-    qdr_link_set_context(conn->inbound_link, conn);
-    conn->outbound_link = qdr_link_first_attach(conn->core_conn, QD_OUTGOING, qdr_terminus(0), qdr_terminus(0), "tcp.cside.out", 0, false, delivery, &conn->outbound_link_id);
-    qdr_link_set_context(conn->outbound_link, conn);
 
-    // now that the raw connection is up and able to be activated enable cutthrough activation
+// The core detached a link of the lane.  Called on the lane's I/O thread.
+//
+static void lane_link_detached_LH(qd_tcp_lane_t *lane, qdr_link_t *link)
+{
+    if (link != lane->inbound_link && link != lane->outbound_link) {
+        return;  // a streaming link
+    }
 
-    assert(conn->outbound_stream);
-    qd_message_activation_t activation;
-    activation.type     = QD_ACTIVATION_TCP;
-    activation.delivery = 0;
-    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP enabling consumer activation", DLV_ARGS(delivery));
-    qd_message_set_consumer_activation(conn->outbound_stream, &activation);
-    qd_message_start_unicast_cutthrough(conn->outbound_stream);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] Link of shared core connection detached, reattaching",
+           lane->conn_id, link == lane->inbound_link ? lane->inbound_link_id : lane->outbound_link_id);
+    lane_fail_flows_LH(lane);
+    qdr_link_notify_closed(link, false);
+    if (link == lane->inbound_link) {
+        lane_attach_inbound_LH(lane);
+    } else {
+        free(lane->reply_to);
+        lane->reply_to = 0;
+        lane_attach_outbound_LH(lane);
+    }
 }
 
 
-static bool try_compose_and_send_client_stream_LSIDE_IO(qd_tcp_connection_t *conn)
+// The core closed the connection of the lane.  Called on the lane's I/O thread.
+//
+static void lane_core_conn_closed_LH(qd_tcp_lane_t *lane)
 {
-    ASSERT_RAW_IO;
-    qd_tcp_listener_t  *li = (qd_tcp_listener_t*) conn->common.parent;
-    qd_composed_field_t *message = 0;
-
-    //
-    // The content-type value of "application/octet-stream" is used to signal to the network that
-    // the body of this stream will be a completely unstructured octet stream, without even an
-    // application-data performative.  The octets directly following the application-properties
-    // (or properties if there are no application-properties) section will constitute the stream
-    // and will consist solely of AMQP transport frames.
-    //
-    if (!!conn->reply_to) {
-        message = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
-        qd_compose_start_list(message);
-        qd_compose_insert_null(message);                                // message-id
-        qd_compose_insert_null(message);                                // user-id
-        qd_compose_insert_string(message, li->adaptor_config->address); // to
-        qd_compose_insert_null(message);                                // subject
-        qd_compose_insert_string(message, conn->reply_to);              // reply-to
-        vflow_serialize_identity(conn->common.vflow, message);          // correlation-id
-        qd_compose_insert_string(message, QD_CONTENT_TYPE_APP_OCTETS);  // content-type
-        //qd_compose_insert_null(message);                              // content-encoding
-        //qd_compose_insert_timestamp(message, 0);                      // absolute-expiry-time
-        //qd_compose_insert_timestamp(message, 0);                      // creation-time
-        //qd_compose_insert_null(message);                              // group-id
-        //qd_compose_insert_uint(message, 0);                           // group-sequence
-        //qd_compose_insert_null(message);                              // reply-to-group-id
-        qd_compose_end_list(message);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "[C%" PRIu64 "] Shared core connection closed, reopening", lane->conn_id);
+    lane_fail_flows_LH(lane);
+    qdr_link_notify_closed(lane->inbound_link, true);
+    qdr_link_notify_closed(lane->outbound_link, true);
+    qdr_connection_notify_closed(lane->core_conn);
+    qd_connection_counter_dec(QD_PROTOCOL_TCP);
+    free(lane->reply_to);
+    lane->reply_to = 0;
+    lane_open_core_conn_LH(lane);
+}
 
-        message = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, message);
-        qd_compose_start_map(message);
-        qd_compose_insert_string(message, MAPPING_VERSION_KEY);
-        qd_compose_insert_uint(message, MAPPING_VERSION);
-        if (conn->alpn_protocol) {
-            // add the ALPN protocol as negotiated with the remote via TLS.
-            qd_compose_insert_string_n(message, (const char *) ALPN_KEY, ALPN_KEY_LEN);
-            qd_compose_insert_string_n(message, (const char *) conn->alpn_protocol,
-                                       strlen(conn->alpn_protocol));
-        }
-        qd_compose_end_map(message);
 
-        message = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, message);
-        qd_compose_insert_null(message);
+// A server stream arrived on the outbound link or a streaming link of the lane.  Called on the lane's I/O thread.
+//
+// @return 0 if the stream was handed to its flow or needs more data, otherwise a terminal outcome
+//
+static uint64_t lane_outbound_delivery_LH(qd_tcp_lane_t *lane, qdr_link_t *link, qdr_delivery_t *delivery)
+{
+    ASSERT_TIMER_IO;
+    uint64_t dispo = validate_outbound_message(delivery);
+    if (dispo != PN_RECEIVED) {
+        // see handle_outbound_delivery_LSIDE_IO(): a server stream cannot be redelivered to another consumer
+        return dispo == PN_RELEASED ? PN_REJECTED : dispo;
     }
 
-    if (message == 0) {
-        return false;
+    qd_tcp_connection_t   *conn = 0;
+    qd_iterator_storage_t  storage;
+    qd_iterator_t         *tag  = qd_message_field_iterator_init(&storage, qdr_delivery_message(delivery), QD_FIELD_CORRELATION_ID);
+    if (!!tag) {
+        qd_hash_retrieve(lane->awaiting, tag, (void**) &conn);
+        qd_iterator_free(tag);
     }
 
-    conn->inbound_stream = qd_message();
-    qd_message_set_streaming_annotation(conn->inbound_stream);
-    qd_message_set_Q2_disabled_annotation(conn->inbound_stream);
-
-    qd_message_compose_2(conn->inbound_stream, message, false);
-    qd_compose_free(message);
+    // Replace the credit of the delivery as it leaves the link
+    qdr_link_flow(tcp_context->core, link, 1, false);
 
-    //
-    // Start cut-through mode for this stream.
-    //
-    qd_message_activation_t activation;
-    activation.type     = QD_ACTIVATION_TCP;
-    activation.delivery = 0;
-    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] TCP enabling producer activation", conn->conn_id, conn->inbound_link_id);
-    qd_message_set_producer_activation(conn->inbound_stream, &activation);
-    qd_message_start_unicast_cutthrough(conn->inbound_stream);
+    if (!conn) {
+        qd_tcp_listener_t *li = (qd_tcp_listener_t*) lane->common.parent;
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING,
+               DLV_FMT " Server stream for no flow of shared connection [C%" PRIu64 "] rejected, the connector side router may not support sharedConnections",
+               DLV_ARGS(delivery), lane->conn_id);
+        atomic_store_explicit(&li->lanes_usable, false, memory_order_relaxed);
+        qd_message_set_send_complete(qdr_delivery_message(delivery));
+        return PN_REJECTED;
+    }
 
-    //
-    // The delivery comes with a ref-count to protect the returned value.  Inherit that ref-count as the
-    // protection of our held pointer.
-    //
-    conn->inbound_delivery = qdr_link_deliver(conn->inbound_link, conn->inbound_stream, 0, false, 0, 0, 0, 0);
-    qdr_delivery_set_context(conn->inbound_delivery, conn);
+    qd_hash_remove_by_handle(lane->awaiting, conn->awaiting_handle);
+    qd_hash_handle_free(conn->awaiting_handle);
+    conn->awaiting_handle = 0;
 
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
-           DLV_FMT " Initiating listener side empty client inbound stream message", DLV_ARGS(conn->inbound_delivery));
-    return true;
+    qdr_delivery_incref(delivery, "lane_outbound_delivery_LH");
+    qdr_delivery_set_context(delivery, conn);
+    conn->lane_update.outbound_delivery = delivery;
+    lane_wake_flow_LH(conn);
+    return 0;
 }
 
 
-static void compose_and_send_server_stream_CSIDE_IO(qd_tcp_connection_t *conn)
+//
+// Per-connection read depth.  A connection is granted enough read buffers to hold READ_HORIZON_USEC of its recent
+// read throughput, and twice its previous depth whenever it filled every buffer it had been granted (the read queue
+// ran dry, so the connection was stalled on buffers).  Otherwise the depth decays by one buffer per grant toward the
+// throughput estimate, so idle connections give up their deep queues.  The result is capped by tier_limit, the
+// router-wide buffer usage tier.
+//
+// A connection that reads again after the idleConnectionSeconds quiet period starts over with a single buffer: its
+// throughput estimate is stale and the depth of its last burst is not topped up again.  Proton gives no way to take
+// back empty read buffers, so the buffers still granted are shed as they are filled.
+//
+#define READ_DEPTH_INITIAL     2
+#define READ_HORIZON_USEC      1000
+#define READ_RATE_SAMPLE_USEC  10000
+
+static void read_rate_update_XSIDE_IO(qd_tcp_connection_t *conn, uint64_t octets)
 {
-    ASSERT_RAW_IO;
-    qd_composed_field_t *message = 0;
+    const uint64_t now = now_usec();
+
+    if (octets > 0) {
+        if (tcp_context->idle_usec && conn->reads.last_read && now - conn->reads.last_read >= tcp_context->idle_usec) {
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] Idle for %" PRIu64 " ms, shedding read depth %zu",
+                   conn->conn_id, (now - conn->reads.last_read) / 1000, conn->reads.depth);
+            conn->reads.rate          = 0;
+            conn->reads.depth         = 1;
+            conn->reads.sample_start  = 0;
+            conn->reads.sample_octets = 0;
+            conn->bulk_reads          = false;
+        }
+        conn->reads.last_read = now;
+    }
 
-    //
-    // The lock is used here to protect access to the reply_to field.  This field is written
-    // by an IO thread associated with the core connection, not this raw connection.
-    //
-    // The content-type value of "application/octet-stream" is used to signal to the network that
-    // the body of this stream will be a completely unstructured octet stream, without even an
-    // application-data performative.  The octets directly following the application-properties
-    // (or properties if there are no application-properties) section will constitute the stream
-    // and will consist solely of AMQP transport frames.
-    //
-    assert(conn->reply_to);
-    assert(conn->common.parent && conn->common.parent->context_type == TL_CONNECTOR);
+    if (conn->reads.sample_start == 0)
+        conn->reads.sample_start = now;
+    conn->reads.sample_octets += octets;
 
-    message = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
-    qd_compose_start_list(message);
-    qd_compose_insert_null(message);                                // message-id
-    qd_compose_insert_null(message);                                // user-id
-    qd_compose_insert_string(message, conn->reply_to);              // to
-    qd_compose_insert_null(message);                                // subject
-    qd_compose_insert_null(message);                                // reply-to
-    qd_compose_insert_null(message);                                // correlation-id
-    qd_compose_insert_string(message, QD_CONTENT_TYPE_APP_OCTETS);  // content-type
-    //qd_compose_insert_null(message);                              // content-encoding
-    //qd_compose_insert_timestamp(message, 0);                      // absolute-expiry-time
-    //qd_compose_insert_timestamp(message, 0);                      // creation-time
-    //qd_compose_insert_null(message);                              // group-id
-    //qd_compose_insert_uint(message, 0);                           // group-sequence
-    //qd_compose_insert_null(message);                              // reply-to-group-id
-    qd_compose_end_list(message);
+    const uint64_t elapsed = now - conn->reads.sample_start;
+    if (elapsed >= READ_RATE_SAMPLE_USEC) {
+        const uint64_t rate = conn->reads.sample_octets * 1000000 / elapsed;
+        conn->reads.rate          = (3 * conn->reads.rate + rate) / 4;
+        conn->reads.sample_start  = now;
+        conn->reads.sample_octets = 0;
+    }
+}
 
-    message = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, message);
-    qd_compose_start_map(message);
-    qd_compose_insert_string(message, MAPPING_VERSION_KEY);
-    qd_compose_insert_uint(message, MAPPING_VERSION);
-    qd_compose_end_map(message);
+static size_t read_depth_XSIDE_IO(qd_tcp_connection_t *conn, size_t already_granted, qd_buffer_class_t size_class,
+                                  size_t tier_limit)
+{
+    const uint64_t buffer_size = size_class == QD_BUFFER_CLASS_LARGE ? QD_BUFFER_LARGE_SIZE : QD_BUFFER_SIZE;
+    const size_t   want        = (size_t) (conn->reads.rate * READ_HORIZON_USEC / 1000000 / buffer_size) + 1;
+
+    size_t depth = conn->reads.depth;
+    if (depth == 0) {
+        depth = READ_DEPTH_INITIAL;
+    } else if (already_granted == 0) {
+        depth *= 2;
+    } else if (depth > 1) {
+        depth -= 1;
+    }
+    depth = MIN(MAX(depth, want), tier_limit);
 
-    message = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, message);
-    qd_compose_insert_null(message);
+    conn->reads.depth = depth;
+    return depth;
+}
 
-    conn->inbound_stream = qd_message();
-    qd_message_set_streaming_annotation(conn->inbound_stream);
-    qd_message_set_Q2_disabled_annotation(conn->inbound_stream);
 
-    qd_message_compose_2(conn->inbound_stream, message, false);
-    qd_compose_free(message);
+static void on_throttle_TIMER_IO(void *context)
+{
+    SET_THREAD_TIMER_IO;
+    qd_tcp_connection_t *conn = (qd_tcp_connection_t*) context;
+    sys_mutex_lock(&conn->activation_lock);
+    if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
+        pn_raw_connection_wake(conn->raw_conn);
+    }
+    sys_mutex_unlock(&conn->activation_lock);
+}
+
+
+static void grant_read_buffers_XSIDE_IO(qd_tcp_connection_t *conn, const size_t capacity)
+{
+    ASSERT_RAW_IO;
 
     //
-    // Start cut-through mode for this stream.
+    // Cannot grant read buffers if the connection is currently blocked due to window flow control
     //
-    qd_message_activation_t activation;
-    activation.type     = QD_ACTIVATION_TCP;
-    activation.delivery = 0;
-    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] TCP enabling producer activation", conn->conn_id, conn->inbound_link_id);
-    qd_message_set_producer_activation(conn->inbound_stream, &activation);
-    qd_message_start_unicast_cutthrough(conn->inbound_stream);
+    if (window_full(conn)) {
+        return;
+    }
 
     //
-    // The delivery comes with a ref-count to protect the returned value.  Inherit that ref-count as the
-    // protection of our held pointer.
+    // Nor while the router is over its policy rate limits.  The throttle timer wakes the connection once it is
+    // within them again.
     //
-    qd_iterator_t *iter = qd_message_field_iterator(conn->inbound_stream, QD_FIELD_TO);
-    qd_iterator_reset_view(iter, ITER_VIEW_ADDRESS_HASH);
-    conn->inbound_delivery = qdr_link_deliver_to(conn->inbound_link, conn->inbound_stream, 0, iter, false, 0, 0, 0, 0);
-    qdr_delivery_set_context(conn->inbound_delivery, conn);
+    if (!!conn->rate_limits) {
+        const uint64_t delay_ns = qd_policy_rate_charge(conn->rate_limits, 0, 0);
+        if (delay_ns) {
+            if (!conn->throttle_timer) {
+                conn->throttle_timer = qd_timer(tcp_context->qd, on_throttle_TIMER_IO, conn);
+            }
+            qd_timer_schedule(conn->throttle_timer, MAX(delay_ns / 1000000, 1));
+            return;
+        }
+    }
 
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
-           DLV_FMT " Initiating connector side empty server inbound stream message", DLV_ARGS(conn->inbound_delivery));
-}
+    //
+    // Define the allocation tiers.  The tier values are the most read buffers granted to a raw
+    // connection based on the percentage of usage of the router-wide buffer ceiling.  Within the
+    // limit each connection keeps its own read depth (see read_depth_XSIDE_IO()).
+    //
+#define TIER_1 16  // [0% .. 50%)
+#define TIER_2 4   // [50% .. 75%)
+#define TIER_3 2   // [75% .. 85%)
+#define TIER_4 1   // [85% .. 100%]
 
+    //
+    // A connection streaming bulk data (its reads fill their buffers) is granted at most this many
+    // large buffers instead when buffer usage is in the first tier.
+    //
+#define TIER_1_LARGE 8
 
-static void extract_metadata_from_stream_CSIDE(qd_tcp_connection_t *conn)
-{
-    ASSERT_TIMER_IO;
-    qd_iterator_t *rt_iter = qd_message_field_iterator(conn->outbound_stream, QD_FIELD_REPLY_TO);
-    qd_iterator_t *ci_iter = qd_message_field_iterator(conn->outbound_stream, QD_FIELD_CORRELATION_ID);
+    //
+    // Since we can't query Proton for the maximum read-buffer capacity, we will infer it from
+    // calls to pn_raw_connection_read_buffers_capacity.
+    //
+    static atomic_size_t max_capacity;
+    size_t current_mc = atomic_load(&max_capacity);
+    while (capacity > current_mc) {
+        if (atomic_compare_exchange_weak(&max_capacity, &current_mc, capacity))
+            break;
+    }
 
-    if (!!rt_iter) {
-        conn->reply_to = (char*) qd_iterator_copy(rt_iter);
-        qd_iterator_free(rt_iter);
+    //
+    // Get the "held_by_threads" stats for router buffers as an approximation of how many
+    // buffers are in-use.  This is an approximation since it also counts free buffers held
+    // in the per-thread free-pools.  Since we will be dealing with large numbers here, the
+    // number of buffers in free-pools will not be significant.
+    //
+    uint64_t buffers_in_use = qd_buffer_held_units();
+
+    //
+    // Choose the grant-allocation tier based on the number of buffers in use.
+    //
+    size_t desired = TIER_4;
+    if (buffers_in_use < buffer_threshold_50) {
+        desired = TIER_1;
+    } else if (buffers_in_use < buffer_threshold_75) {
+        desired = TIER_2;
+    } else if (buffers_in_use < buffer_threshold_85) {
+        desired = TIER_3;
     }
 
-    if (!!ci_iter) {
+    qd_buffer_class_t size_class = QD_BUFFER_CLASS_DEFAULT;
+    if (desired == TIER_1 && conn->bulk_reads) {
+        size_class = QD_BUFFER_CLASS_LARGE;
+        desired    = TIER_1_LARGE;
+    }
+
+    //
+    // Determine how many buffers are already granted.  This will always be a non-negative value.
+    //
+    current_mc = atomic_load(&max_capacity);
+    assert(current_mc >= capacity);
+    size_t already_granted = current_mc - capacity;
+
+    desired = read_depth_XSIDE_IO(conn, already_granted, size_class, desired);
+
+    //
+    // If we desire to grant additional buffers, calculate the number to grant now.
+    //
+    const size_t granted = desired > already_granted ? desired - already_granted : 0;
+
+    if (granted > 0) {
         //
-        // If we have an iterator for the base-record identity, use it to create a co-record
+        // Grant the buffers.
         //
-        conn->common.vflow = vflow_start_co_record_iter(VFLOW_RECORD_BIFLOW_TPORT, ci_iter);
-        qd_iterator_free(ci_iter);
-        vflow_set_trace(conn->common.vflow, conn->outbound_stream);
+        pn_raw_buffer_t raw_buffers[granted];
+
+        for (size_t i = 0; i < granted; i++) {
+            qd_buffer_t *buf = qd_buffer_sized(size_class);
+            raw_buffers[i].context  = (uintptr_t) buf;
+            raw_buffers[i].bytes    = (char*) qd_buffer_base(buf);
+            raw_buffers[i].capacity = qd_buffer_capacity(buf);
+            raw_buffers[i].offset   = 0;
+            raw_buffers[i].size     = 0;
+        }
+
+        size_t actual = pn_raw_connection_give_read_buffers(conn->raw_conn, raw_buffers, granted);
+        (void) actual;
+        assert(actual == granted);
+
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] grant_read_buffers_XSIDE_IO - %ld", conn->conn_id, granted);
     }
 }
 
-// Handle delivery of outbound message to the client.
+
+// Take the filled read buffers of the raw connection and append them to buffers
 //
-// @return 0 on success, otherwise a terminal outcome indicating that the message cannot be delivered.
+// @return the number of octets read
 //
-static uint64_t handle_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery)
+static uint64_t take_read_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_buffer_list_t *buffers)
 {
     ASSERT_RAW_IO;
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " handle_outbound_delivery_LSIDE_IO - receive_complete=%s",
-           DLV_ARGS(delivery), qd_message_receive_complete(conn->outbound_stream) ? "true" : "false");
+    uint64_t        octet_count = 0;
+    pn_raw_buffer_t raw_buffers[RAW_BUFFER_BATCH_SIZE];
+    size_t          count;
+
+    count = pn_raw_connection_take_read_buffers(conn->raw_conn, raw_buffers, RAW_BUFFER_BATCH_SIZE);
+    while (count > 0) {
+        for (size_t i = 0; i < count; i++) {
+            qd_buffer_t *buf = (qd_buffer_t*) raw_buffers[i].context;
+            qd_buffer_insert(buf, raw_buffers[i].size);
+            octet_count += raw_buffers[i].size;
+            if (qd_buffer_size(buf) > 0) {
+                conn->bulk_reads = qd_buffer_capacity(buf) == 0;
+                DEQ_INSERT_TAIL(*buffers, buf);
+                if (conn->listener_side && !!conn->observer_handle) {
+                    qdpo_data(conn->observer_handle, true, qd_buffer_base(buf), qd_buffer_size(buf));
+                }
+            } else {
+                qd_buffer_free(buf);
+            }
+        }
+        count = pn_raw_connection_take_read_buffers(conn->raw_conn, raw_buffers, RAW_BUFFER_BATCH_SIZE);
+    }
+    return octet_count;
+}
+
+
+static uint64_t produce_read_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream, bool *read_closed)
+{
+    ASSERT_RAW_IO;
+    uint64_t octet_count = 0;
+    *read_closed = false;
+
+    if (!!conn->http1) {
+        return http1_read_requests_LSIDE_IO(conn, read_closed);
+    }
+    if (!!conn->stripes && !conn->listener_side) {
+        return stripes_read_CSIDE_IO(conn, read_closed);
+    }
+
+    if (qd_message_can_produce_buffers(stream)) {
+        qd_buffer_list_t qd_buffers = DEQ_EMPTY;
+
+        octet_count = take_read_buffers_XSIDE_IO(conn, &qd_buffers);
+
+        // ISSUE-1446: it is only safe to check pn_raw_connection_is_read_closed() after all read buffers are drained since
+        // the connection can be marked closed while read buffers are still pending in the raw connection.
+        //
+        *read_closed = pn_raw_connection_is_read_closed(conn->raw_conn);
+
+        if (!DEQ_IS_EMPTY(qd_buffers)) {
+            //qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] produce_read_buffers_XSIDE_IO - Producing %ld buffers", conn->conn_id, DEQ_SIZE(qd_buffers));
+            qd_message_produce_buffers(stream, &qd_buffers);
+        }
+    }
+
+    return octet_count;
+}
+
+
+//
+// Plaintext write buffers holding less than this are small: the raw connection issues a socket write per buffer and
+// accepts a limited number of buffers at once, so many small buffers cost many small writes.  Buffers filled by a read
+// or by a message body are usually far larger, and are handed on without a copy.
+//
+#define RAW_WRITE_SMALL_SIZE 1024
+
+//
+// Copy runs of two or more small queued buffers together into large buffers.  Every other buffer is passed on as is.
+// Data is never held back waiting for more, so interactive flows see no added latency.
+//
+static void coalesce_buffers(qd_buffer_list_t *buffers)
+{
+    if (DEQ_SIZE(*buffers) < 2)
+        return;
+
+    qd_buffer_list_t out = DEQ_EMPTY;
+    qd_buffer_t     *agg = 0;
+    qd_buffer_t     *buf = DEQ_HEAD(*buffers);
+
+    while (buf) {
+        DEQ_REMOVE_HEAD(*buffers);
+        qd_buffer_t *next  = DEQ_HEAD(*buffers);
+        size_t       size  = qd_buffer_size(buf);
+        const bool   small = size < RAW_WRITE_SMALL_SIZE;
+
+        if (!!agg && (!small || qd_buffer_capacity(agg) < size)) {
+            DEQ_INSERT_TAIL(out, agg);
+            agg = 0;
+        }
+
+        if (!small || (!agg && (!next || qd_buffer_size(next) >= RAW_WRITE_SMALL_SIZE))) {
+            DEQ_INSERT_TAIL(out, buf);  // nothing to gain by copying
+        } else {
+            if (!agg)
+                agg = qd_buffer_sized(QD_BUFFER_CLASS_LARGE);
+            memcpy(qd_buffer_cursor(agg), qd_buffer_base(buf), size);
+            qd_buffer_insert(agg, size);
+            qd_buffer_free(buf);
+        }
+        buf = next;
+    }
+
+    if (!!agg)
+        DEQ_INSERT_TAIL(out, agg);
+    DEQ_MOVE(out, *buffers);
+}
+
+
+// Hand buffers to the raw connection for writing, it frees them once written (see drain_write_buffers_XSIDE_IO).  The
+// raw connection must have a free write slot for each of them.
+//
+// @return the number of octets in the buffers
+//
+static uint64_t write_raw_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_buffer_list_t *buffers)
+{
+    ASSERT_RAW_IO;
+    const size_t    actual      = DEQ_SIZE(*buffers);
+    uint64_t        octet_count = 0;
+    pn_raw_buffer_t raw_buffers[actual];
+
+    qd_buffer_t *buf = DEQ_HEAD(*buffers);
+    for (size_t i = 0; i < actual; i++) {
+        if (conn->listener_side && !!conn->observer_handle) {
+            qdpo_data(conn->observer_handle, false, qd_buffer_base(buf), qd_buffer_size(buf));
+        }
+        raw_buffers[i].context  = (uintptr_t) buf;
+        raw_buffers[i].bytes    = (char*) qd_buffer_base(buf);
+        raw_buffers[i].capacity = qd_buffer_capacity(buf);
+        raw_buffers[i].size     = qd_buffer_size(buf);
+        raw_buffers[i].offset   = 0;
+        octet_count += raw_buffers[i].size;
+        buf = DEQ_NEXT(buf);
+    }
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] consume_write_buffers_XSIDE_IO - Consuming %ld buffers", conn->conn_id, actual);
+    pn_raw_connection_write_buffers(conn->raw_conn, raw_buffers, actual);
+    DEQ_INIT(*buffers);
+    return octet_count;
+}
+
+static uint64_t consume_write_buffers_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream)
+{
+    ASSERT_RAW_IO;
+    size_t   limit       = pn_raw_connection_write_buffers_capacity(conn->raw_conn);
+    uint64_t octet_count = 0;
+    uint64_t writes      = 0;
+
+    //
+    // Each pass consumes no more buffers than there are free write slots, so the coalesced result always fits.  When
+    // coalescing frees slots another pass fills them.
+    //
+    while (limit > 0) {
+        qd_buffer_list_t buffers = DEQ_EMPTY;
+        size_t actual = qd_message_consume_buffers(stream, &buffers, limit);
+        assert(actual == DEQ_SIZE(buffers));
+        if (actual == 0) {
+            break;
+        }
+        coalesce_buffers(&buffers);
+        actual = DEQ_SIZE(buffers);
+
+        octet_count += write_raw_buffers_XSIDE_IO(conn, &buffers);
+        writes += actual;
+        limit  -= actual;
+    }
+
+    count_raw_writes_XSIDE_IO(conn, writes, octet_count);
+    return octet_count;
+}
+
+// Take the body payload that is in the normal non-cut-through buffers of the outbound stream.  The buffers are owned
+// by the caller (see qd_message_take_raw_body), no data is copied.
+//
+static void take_message_body_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream, qd_buffer_list_t *buffers, size_t limit)
+{
+    assert(!conn->outbound_body_complete);
+
+    bool complete = false;
+    qd_message_take_raw_body(stream, buffers, limit, &complete);
+    conn->outbound_body_complete = complete;
+}
+
+static uint64_t consume_message_body_XSIDE_IO(qd_tcp_connection_t *conn, qd_message_t *stream)
+{
+    ASSERT_RAW_IO;
+    assert(!conn->outbound_body_complete);
+
+    uint64_t octets = 0;
+    uint64_t writes = 0;
+
+    //
+    // Process classic (non cut-though) body buffers until they are all sent onto the raw connection.
+    // Note that this may take multiple runs through this function if there is any back-pressure
+    // outbound on the raw connection.  The raw connection frees the buffers once written (see
+    // drain_write_buffers_XSIDE_IO).
+    //
+    const bool observe = conn->listener_side && !!conn->observer_handle;
+    size_t     limit   = pn_raw_connection_write_buffers_capacity(conn->raw_conn);
+    while (limit > 0 && !conn->outbound_body_complete) {
+        qd_buffer_list_t buffers = DEQ_EMPTY;
+        take_message_body_XSIDE_IO(conn, stream, &buffers, limit);
+        size_t actual = DEQ_SIZE(buffers);
+        if (actual == 0)
+            break;
+
+        pn_raw_buffer_t raw_buffers[actual];
+        qd_buffer_t *buf = DEQ_HEAD(buffers);
+        for (size_t i = 0; i < actual; i++) {
+            if (observe) {
+                qdpo_data(conn->observer_handle, false, qd_buffer_base(buf), qd_buffer_size(buf));
+            }
+            raw_buffers[i].context  = (uintptr_t) buf;
+            raw_buffers[i].bytes    = (char*) qd_buffer_base(buf);
+            raw_buffers[i].capacity = qd_buffer_capacity(buf);
+            raw_buffers[i].size     = qd_buffer_size(buf);
+            raw_buffers[i].offset   = 0;
+            octets += raw_buffers[i].size;
+            buf = DEQ_NEXT(buf);
+        }
+        pn_raw_connection_write_buffers(conn->raw_conn, raw_buffers, actual);
+        writes += actual;
+        limit  -= actual;
+    }
+
+    count_raw_writes_XSIDE_IO(conn, writes, octets);
+    return octets;
+}
+
+
+static void link_setup_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_listener_t *li = (qd_tcp_listener_t*) conn->common.parent;
+    if (li->lane_count > 0 && atomic_load_explicit(&li->lanes_usable, memory_order_relaxed)) {
+        lane_attach_flow_LSIDE_IO(conn);
+        return;
+    }
+
+    qdr_terminus_t *target = qdr_terminus(0);
+    qdr_terminus_t *source = qdr_terminus(0);
+    char               host[64];  // for numeric remote client IP:port address
+
+    qdr_terminus_set_address(target, li->adaptor_config->address);
+    qdr_terminus_set_dynamic(source);
+
+    qd_raw_conn_get_address_buf(conn->raw_conn, host, sizeof(host));
+    conn->core_conn = TL_open_core_connection(conn->conn_id, true, host);
+    qdr_connection_set_context(conn->core_conn, conn);
+    conn->inbound_link = qdr_link_first_attach(conn->core_conn, QD_INCOMING, qdr_terminus(0), target, "tcp.lside.in", 0, false, 0, &conn->inbound_link_id);
+    qdr_link_set_context(conn->inbound_link, conn);
+    conn->outbound_link = qdr_link_first_attach(conn->core_conn, QD_OUTGOING, source, qdr_terminus(0), "tcp.lside.out", 0, false, 0, &conn->outbound_link_id);
+    qdr_link_set_context(conn->outbound_link, conn);
+    if (!conn->http1 && !conn->stripes) {
+        // the server streams of a requestBalancing http1 or a striped flow arrive on streaming links of their own instead
+        qdr_link_set_user_streaming(conn->outbound_link);
+    }
+    qdr_link_flow(tcp_context->core, conn->outbound_link, 1, false);
+}
+
+
+static void link_setup_CSIDE_IO(qd_tcp_connection_t *conn, qdr_delivery_t *delivery)
+{
+    ASSERT_RAW_IO;
+
+    assert(conn->common.parent->context_type == TL_CONNECTOR);
+    const char *host = ((qd_tcp_connector_t *) conn->common.parent)->adaptor_config->host_port;
+    conn->core_conn  = TL_open_core_connection(conn->conn_id, false, host);
+    qdr_connection_set_context(conn->core_conn, conn);
+
+    // use an anonymous inbound link in order to ensure credit arrives otherwise if the client has dropped the state machine will stall waiting for credit
+    conn->inbound_link = qdr_link_first_attach(conn->core_conn, QD_INCOMING, qdr_terminus(0), qdr_terminus(0), "tcp.cside.in", 0, false, 0, &conn->inbound_link_id);
+    qdr_link_set_context(conn->inbound_link, conn);
+    conn->outbound_link = qdr_link_first_attach(conn->core_conn, QD_OUTGOING, qdr_terminus(0), qdr_terminus(0), "tcp.cside.out", 0, false, delivery, &conn->outbound_link_id);
+    qdr_link_set_context(conn->outbound_link, conn);
+
+    // now that the raw connection is up and able to be activated enable cutthrough activation
+
+    assert(conn->outbound_stream);
+    qd_message_activation_t activation;
+    activation.type     = QD_ACTIVATION_TCP;
+    activation.delivery = 0;
+    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP enabling consumer activation", DLV_ARGS(delivery));
+    qd_message_set_consumer_activation(conn->outbound_stream, &activation);
+    qd_message_start_unicast_cutthrough(conn->outbound_stream);
+}
+
+
+static bool try_compose_and_send_client_stream_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_listener_t  *li = (qd_tcp_listener_t*) conn->common.parent;
+    qd_composed_field_t *message = 0;
+
+    //
+    // The content-type value of "application/octet-stream" is used to signal to the network that
+    // the body of this stream will be a completely unstructured octet stream, without even an
+    // application-data performative.  The octets directly following the application-properties
+    // (or properties if there are no application-properties) section will constitute the stream
+    // and will consist solely of AMQP transport frames.
+    //
+    if (!!conn->reply_to) {
+        if (!!conn->http1) {
+            http1_next_request_LSIDE_IO(conn);
+        }
+        message = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+        qd_compose_start_list(message);
+        if (!!conn->flow_tag) {
+            qd_compose_insert_string(message, conn->flow_tag);          // message-id
+        } else {
+            qd_compose_insert_null(message);                            // message-id
+        }
+        qd_compose_insert_null(message);                                // user-id
+        qd_compose_insert_string(message, li->adaptor_config->address); // to
+        qd_compose_insert_null(message);                                // subject
+        qd_compose_insert_string(message, conn->reply_to);              // reply-to
+        vflow_serialize_identity(conn->common.vflow, message);          // correlation-id
+        qd_compose_insert_string(message, QD_CONTENT_TYPE_APP_OCTETS);  // content-type
+        //qd_compose_insert_null(message);                              // content-encoding
+        //qd_compose_insert_timestamp(message, 0);                      // absolute-expiry-time
+        //qd_compose_insert_timestamp(message, 0);                      // creation-time
+        //qd_compose_insert_null(message);                              // group-id
+        //qd_compose_insert_uint(message, 0);                           // group-sequence
+        //qd_compose_insert_null(message);                              // reply-to-group-id
+        qd_compose_end_list(message);
+
+        message = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, message);
+        qd_compose_start_map(message);
+        qd_compose_insert_string(message, MAPPING_VERSION_KEY);
+        qd_compose_insert_uint(message, MAPPING_VERSION);
+        if (conn->alpn_protocol) {
+            // add the ALPN protocol as negotiated with the remote via TLS.
+            qd_compose_insert_string_n(message, (const char *) ALPN_KEY, ALPN_KEY_LEN);
+            qd_compose_insert_string_n(message, (const char *) conn->alpn_protocol,
+                                       strlen(conn->alpn_protocol));
+        }
+        if (!!conn->stripes) {
+            qd_compose_insert_string(message, STRIPES_KEY);
+            qd_compose_insert_uint(message, li->stripes);
+        }
+        if (li->lane_count > 0 && !conn->lane) {
+            qd_compose_insert_string(message, SHARED_KEY);
+            qd_compose_insert_uint(message, 1);
+        }
+        qd_compose_end_map(message);
+
+        message = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, message);
+        qd_compose_insert_null(message);
+    }
+
+    if (message == 0) {
+        return false;
+    }
+
+    conn->inbound_stream = qd_message();
+    qd_message_set_streaming_annotation(conn->inbound_stream);
+    qd_message_set_Q2_disabled_annotation(conn->inbound_stream);
+
+    qd_message_compose_2(conn->inbound_stream, message, false);
+    qd_compose_free(message);
+
+    //
+    // Start cut-through mode for this stream.
+    //
+    qd_message_activation_t activation;
+    activation.type     = QD_ACTIVATION_TCP;
+    activation.delivery = 0;
+    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] TCP enabling producer activation", conn->conn_id, conn->inbound_link_id);
+    qd_message_set_producer_activation(conn->inbound_stream, &activation);
+    qd_message_start_unicast_cutthrough(conn->inbound_stream);
+
+    //
+    // The delivery comes with a ref-count to protect the returned value.  Inherit that ref-count as the
+    // protection of our held pointer.
+    //
+    if (!!conn->lane) {
+        lane_deliver_client_stream_LSIDE_IO(conn);
+    } else {
+        conn->inbound_delivery = qdr_link_deliver(conn->inbound_link, conn->inbound_stream, 0, false, 0, 0, 0, 0);
+        qdr_delivery_set_context(conn->inbound_delivery, conn);
+    }
+
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
+           DLV_FMT " Initiating listener side empty client inbound stream message", DLV_ARGS(conn->inbound_delivery));
+
+    //
+    // Fast-open: the octets read during link setup follow the headers before the core has forwarded the delivery.
+    //
+    fast_open_read_LSIDE_IO(conn);
+    return true;
+}
+
+
+// Compose a server stream and send it to the reply-to of the flow
+//
+// @param stripe 0 for the main server stream, else the stripe number of a stripe stream
+// @param stripes The stripes of the flow, carried by the main server stream of a striped flow
+// @param delivery [out] The delivery of the stream, with a reference
+// @return the stream
+//
+static qd_message_t *send_server_stream_CSIDE_IO(qd_tcp_connection_t *conn, uint32_t stripe, uint32_t stripes,
+                                                 qdr_delivery_t **delivery)
+{
+    ASSERT_RAW_IO;
+    qd_composed_field_t *message = 0;
+
+    //
+    // The lock is used here to protect access to the reply_to field.  This field is written
+    // by an IO thread associated with the core connection, not this raw connection.
+    //
+    // The content-type value of "application/octet-stream" is used to signal to the network that
+    // the body of this stream will be a completely unstructured octet stream, without even an
+    // application-data performative.  The octets directly following the application-properties
+    // (or properties if there are no application-properties) section will constitute the stream
+    // and will consist solely of AMQP transport frames.
+    //
+    assert(conn->reply_to);
+    assert(conn->common.parent && conn->common.parent->context_type == TL_CONNECTOR);
+
+    message = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+    qd_compose_start_list(message);
+    qd_compose_insert_null(message);                                // message-id
+    qd_compose_insert_null(message);                                // user-id
+    qd_compose_insert_string(message, conn->reply_to);              // to
+    qd_compose_insert_null(message);                                // subject
+    qd_compose_insert_null(message);                                // reply-to
+    if (!!conn->flow_tag) {
+        qd_compose_insert_string(message, conn->flow_tag);          // correlation-id
+    } else {
+        qd_compose_insert_null(message);                            // correlation-id
+    }
+    qd_compose_insert_string(message, QD_CONTENT_TYPE_APP_OCTETS);  // content-type
+    //qd_compose_insert_null(message);                              // content-encoding
+    //qd_compose_insert_timestamp(message, 0);                      // absolute-expiry-time
+    //qd_compose_insert_timestamp(message, 0);                      // creation-time
+    //qd_compose_insert_null(message);                              // group-id
+    //qd_compose_insert_uint(message, 0);                           // group-sequence
+    //qd_compose_insert_null(message);                              // reply-to-group-id
+    qd_compose_end_list(message);
+
+    message = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, message);
+    qd_compose_start_map(message);
+    qd_compose_insert_string(message, MAPPING_VERSION_KEY);
+    qd_compose_insert_uint(message, MAPPING_VERSION);
+    if (stripe > 0) {
+        qd_compose_insert_string(message, STRIPE_KEY);
+        qd_compose_insert_uint(message, stripe);
+    } else if (stripes > 1) {
+        qd_compose_insert_string(message, STRIPES_KEY);
+        qd_compose_insert_uint(message, stripes);
+    }
+    if (stripe == 0 && get_stream_uint_property(conn->outbound_stream, SHARED_KEY) != 0) {
+        qd_compose_insert_string(message, SHARED_KEY);
+        qd_compose_insert_uint(message, 1);
+    }
+    qd_compose_end_map(message);
+
+    message = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, message);
+    qd_compose_insert_null(message);
+
+    qd_message_t *stream = qd_message();
+    qd_message_set_streaming_annotation(stream);
+    qd_message_set_Q2_disabled_annotation(stream);
+
+    qd_message_compose_2(stream, message, false);
+    qd_compose_free(message);
+
+    //
+    // Start cut-through mode for this stream.
+    //
+    qd_message_activation_t activation;
+    activation.type     = QD_ACTIVATION_TCP;
+    activation.delivery = 0;
+    qd_alloc_set_safe_ptr(&activation.safeptr, conn);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] TCP enabling producer activation", conn->conn_id, conn->inbound_link_id);
+    qd_message_set_producer_activation(stream, &activation);
+    qd_message_start_unicast_cutthrough(stream);
+
+    //
+    // The delivery comes with a ref-count to protect the returned value.  Inherit that ref-count as the
+    // protection of our held pointer.
+    //
+    qd_iterator_t *iter = qd_message_field_iterator(stream, QD_FIELD_TO);
+    qd_iterator_reset_view(iter, ITER_VIEW_ADDRESS_HASH);
+    *delivery = qdr_link_deliver_to(conn->inbound_link, stream, 0, iter, false, 0, 0, 0, 0);
+    qdr_delivery_set_context(*delivery, conn);
+    return stream;
+}
+
+
+static void compose_and_send_server_stream_CSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    const uint32_t stripes = stripes_count_CSIDE_IO(conn);
+
+    conn->inbound_stream = send_server_stream_CSIDE_IO(conn, 0, stripes, &conn->inbound_delivery);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
+           DLV_FMT " Initiating connector side empty server inbound stream message", DLV_ARGS(conn->inbound_delivery));
+
+    if (stripes > 1) {
+        stripes_start_CSIDE_IO(conn, stripes);
+    }
+}
+
+
+static void extract_metadata_from_stream_CSIDE(qd_tcp_connection_t *conn)
+{
+    ASSERT_TIMER_IO;
+    qd_iterator_t *rt_iter = qd_message_field_iterator(conn->outbound_stream, QD_FIELD_REPLY_TO);
+    qd_iterator_t *ci_iter = qd_message_field_iterator(conn->outbound_stream, QD_FIELD_CORRELATION_ID);
+    qd_iterator_t *mi_iter = qd_message_field_iterator(conn->outbound_stream, QD_FIELD_MESSAGE_ID);
+
+    if (!!rt_iter) {
+        conn->reply_to = (char*) qd_iterator_copy(rt_iter);
+        qd_iterator_free(rt_iter);
+    }
+
+    if (!!mi_iter) {
+        // The flow tag of a listener side shared connection, echoed in the server stream
+        conn->flow_tag = (char*) qd_iterator_copy(mi_iter);
+        qd_iterator_free(mi_iter);
+    }
+
+    if (!!ci_iter) {
+        //
+        // If we have an iterator for the base-record identity, use it to create a co-record
+        //
+        conn->common.vflow = vflow_start_co_record_iter(VFLOW_RECORD_BIFLOW_TPORT, ci_iter);
+        qd_iterator_free(ci_iter);
+        vflow_set_trace(conn->common.vflow, conn->outbound_stream);
+    }
+}
+
+// Handle delivery of outbound message to the client.
+//
+// @return 0 on success, otherwise a terminal outcome indicating that the message cannot be delivered.
+//
+static uint64_t handle_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery)
+{
+    ASSERT_RAW_IO;
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " handle_outbound_delivery_LSIDE_IO - receive_complete=%s",
+           DLV_ARGS(delivery), qd_message_receive_complete(conn->outbound_stream) ? "true" : "false");
+
+    if (!!conn->http1) {
+        return http1_outbound_delivery_LSIDE_IO(conn, link, delivery);
+    }
+    if (!!conn->stripes) {
+        return stripes_outbound_delivery_LSIDE_IO(conn, link, delivery);
+    }
+
+    if (!conn->outbound_delivery) {
+        // newly arrived delivery: Verify the message sections up to and including the dummy BODY_AMQP_VALUE have
+        // arrived and are valid.
+        //
+        uint64_t dispo = validate_outbound_message(delivery);
+        if (dispo != PN_RECEIVED) {
+            // PN_RELEASED: since this message was delivered to this listener's unique reply-to, it cannot be
+            // redelivered to another consumer. PN_RELEASED means incompatible encapsulation so this is a
+            // misconfiguration. Reject the delivery.
+            if (dispo == PN_RELEASED)
+                dispo = PN_REJECTED;
+            return dispo;
+        }
+
+        qd_tcp_listener_t *li = (qd_tcp_listener_t*) conn->common.parent;
+        if (!!li && li->lane_count > 0 && get_stream_uint_property(qdr_delivery_message(delivery), SHARED_KEY) != 0
+            && !atomic_exchange_explicit(&li->lanes_usable, true, memory_order_relaxed)) {
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "tcpListener %s: connector side serves shared connections, using them",
+                   li->adaptor_config->name);
+        }
+
+        qdr_delivery_incref(delivery, "handle_outbound_delivery_LSIDE_IO");
+        qdr_delivery_set_context(delivery, conn);
+        start_outbound_stream_LSIDE_IO(conn, delivery);
+    }
+
+    connection_run_LSIDE_IO(conn);
+    return 0;
+}
+
+
+/**
+ * Handle the first indication of a new outbound delivery on CSIDE.  This is where the raw connection to the
+ * external service is established.  This function executes in an IO thread not associated with a raw connection.
+ *
+ * @return disposition. MOVED_TO_NEW_LINK on success, 0 if more message needed, else error outcome
+ */
+//=================================================================================
+// Connector Connection Pool
+//=================================================================================
+//
+// A tcpConnector configured with a non-zero poolMinIdle keeps pre-established backend connections so that a new flow
+// binds to an open socket instead of waiting for a connect.  Pooled connections are in the CSIDE_POOLED state and on
+// connector->pool rather than connector->connections.  No read buffers are granted to them: anything the backend sends
+// stays in the socket until a flow claims the connection.  The pool keeps pool_target idle connections, starting at
+// poolMinIdle.  Each miss grows the target by one up to poolMaxIdle and each connection that ages out unused after
+// poolMaxAge shrinks it by one.
+//
+// connector->pool and the pooled and pool_expired flags of its connections are protected by connector->lock.
+//
+#define POOL_TIMER_MSEC 1000
+
+static qd_tcp_connection_t *new_connection_CSIDE(qd_tcp_connector_t *connector)
+{
+    qd_tcp_connection_t *conn = new_qd_tcp_connection_t();
+    ZERO(conn);
+
+    conn->conn_id  = qd_server_allocate_connection_id(tcp_context->server);
+    conn->common.context_type = TL_CONNECTION;
+    conn->common.parent       = (qd_tcp_common_t*) connector;
+    //
+    // Call connector incref when a connection references a connector via conn->common.parent
+    //
+    qd_tcp_connector_incref(connector);
+
+    sys_mutex_init(&conn->activation_lock);
+    sys_atomic_init(&conn->raw_opened, 0);
+
+    conn->listener_side   = false;
+    conn->context.context = conn;
+    conn->context.handler = on_connection_event_CSIDE_IO;
+    conn->rate_limits     = qd_policy_rate_limits(qd_dispatch_get_policy(tcp_context->qd), 0, 0, true, false);
+
+    conn->raw_conn = pn_raw_connection();
+    pn_raw_connection_set_context(conn->raw_conn, &conn->context);
+
+    return conn;
+}
+
+//
+// Bind the first outbound delivery of a flow to its connector-side connection.  Caller must hold connector->lock.
+//
+static void bind_outbound_delivery_CSIDE_LH(qd_tcp_connector_t *connector, qd_tcp_connection_t *conn, qdr_delivery_t *delivery)
+{
+    qdr_delivery_incref(delivery, "CORE_deliver_outbound CSIDE");
+    qdr_delivery_set_context(delivery, conn);
+
+    conn->outbound_delivery = delivery;
+    conn->outbound_stream   = qdr_delivery_message(delivery);
+    conn->flow_start        = now_usec();
+
+    //
+    // Get relevant data from the connection stream.  If there is base-record data in the stream,
+    // this will create a VanFlow co-record that we can use to report metrics and state.
+    //
+    extract_metadata_from_stream_CSIDE(conn);
+    window_init(conn);
+
+    DEQ_INSERT_TAIL(connector->connections, conn);
+    connector->connections_opened++;
+    vflow_set_uint64(connector->common.vflow, VFLOW_ATTRIBUTE_FLOW_COUNT_L4, connector->connections_opened);
+    vflow_set_ref_from_record(conn->common.vflow, VFLOW_ATTRIBUTE_CONNECTOR, connector->common.vflow);
+    if (conn->connect_usec) {
+        // a pooled connection connected before the flow record was created
+        vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_CONNECT_LATENCY, conn->connect_usec);
+    }
+}
+
+static void pool_wake_LH(qd_tcp_connection_t *conn)
+{
+    sys_mutex_lock(&conn->activation_lock);
+    if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
+        pn_raw_connection_wake(conn->raw_conn);
+    }
+    sys_mutex_unlock(&conn->activation_lock);
+}
+
+//
+// Mark a pooled connection for closing.  A connection that has not connected yet is closed by its CONNECTED event.
+//
+static void pool_expire_LH(qd_tcp_connection_t *conn)
+{
+    conn->pool_expired = true;
+    pool_wake_LH(conn);
+}
+
+//
+// Claim an established pooled connection for the flow of delivery.
+//
+// @return the connection now bound to delivery, or 0 if the pool has no connection ready
+//
+static qd_tcp_connection_t *pool_claim_TIMER_IO(qd_tcp_connector_t *connector, qdr_delivery_t *delivery)
+{
+    ASSERT_TIMER_IO;
+    qd_tcp_connection_t *conn = 0;
+
+    sys_mutex_lock(&connector->lock);
+    if (!!connector->pool_timer) {
+        conn = DEQ_HEAD(connector->pool);
+        while (!!conn && (conn->pool_expired || !IS_ATOMIC_FLAG_SET(&conn->raw_opened))) {
+            conn = DEQ_NEXT(conn);
+        }
+
+        if (!!conn) {
+            DEQ_REMOVE(connector->pool, conn);
+            conn->pooled = false;
+            connector->pool_hits++;
+            bind_outbound_delivery_CSIDE_LH(connector, conn, delivery);
+            pool_wake_LH(conn);
+            qd_timer_schedule(connector->pool_timer, 0);  // replace the claimed connection
+        } else {
+            connector->pool_misses++;
+            if (connector->pool_target < connector->pool_max_idle) {
+                connector->pool_target++;
+                qd_timer_schedule(connector->pool_timer, 0);
+            }
+        }
+    }
+    sys_mutex_unlock(&connector->lock);
+
+    if (!!conn) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " CSIDE outbound delivery bound to pooled connection [C%"PRIu64"]",
+               DLV_ARGS(delivery), conn->conn_id);
+    }
+    return conn;
+}
+
+static void on_pool_timer_TIMER_IO(void *context)
+{
+    SET_THREAD_TIMER_IO;
+    qd_tcp_connector_t *connector = (qd_tcp_connector_t*) context;
+    const uint64_t      now       = now_usec();
+    uint64_t            idle      = 0;
+
+    sys_mutex_lock(&connector->lock);
+    if (!connector->pool_timer) {
+        // The pool is shutting down, see pool_shutdown()
+        sys_mutex_unlock(&connector->lock);
+        return;
+    }
+
+    qd_tcp_connection_t *conn = DEQ_HEAD(connector->pool);
+    while (!!conn) {
+        if (!conn->pool_expired && now - conn->connect_start >= connector->pool_max_age) {
+            pool_expire_LH(conn);
+            if (connector->pool_target > connector->pool_min_idle) {
+                connector->pool_target--;
+            }
+        }
+        if (!conn->pool_expired) {
+            idle++;
+        }
+        conn = DEQ_NEXT(conn);
+    }
+
+    while (idle++ < connector->pool_target) {
+        char        buffer[QD_DNS_CACHE_ADDRESS_MAX];
+        const char *address = qd_dns_entry_lookup(connector->dns_entry, buffer);
+
+        conn = new_connection_CSIDE(connector);
+        conn->state  = CSIDE_POOLED;
+        conn->pooled = true;
+        DEQ_INSERT_TAIL(connector->pool, conn);
+
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] CSIDE opening pooled connection to %s (%s)", conn->conn_id,
+               connector->adaptor_config->host_port, address);
+        conn->connect_start = now_usec();
+        pn_proactor_raw_connect(tcp_context->proactor, conn->raw_conn, address);
+    }
+
+    qd_timer_schedule(connector->pool_timer, POOL_TIMER_MSEC);
+    sys_mutex_unlock(&connector->lock);
+}
+
+//
+// Stop refilling the pool and close its idle connections.
+//
+static void pool_shutdown(qd_tcp_connector_t *connector)
+{
+    sys_mutex_lock(&connector->lock);
+    qd_timer_t *timer     = connector->pool_timer;
+    connector->pool_timer = 0;
+    sys_mutex_unlock(&connector->lock);
+
+    // The timer handler takes connector->lock, free it unlocked
+    qd_timer_free(timer);
+
+    sys_mutex_lock(&connector->lock);
+    qd_tcp_connection_t *conn = DEQ_HEAD(connector->pool);
+    while (!!conn) {
+        if (!conn->pool_expired) {
+            pool_expire_LH(conn);
+        }
+        conn = DEQ_NEXT(conn);
+    }
+    sys_mutex_unlock(&connector->lock);
+}
+
+
+static uint64_t handle_first_outbound_delivery_CSIDE(qd_tcp_connector_t *connector, qdr_link_t *link, qdr_delivery_t *delivery)
+{
+    ASSERT_TIMER_IO;
+    assert(!qdr_delivery_get_context(delivery));
+
+    // Verify the message sections up to and including the dummy BODY_AMQP_VALUE have arrived and are valid.
+    //
+    uint64_t dispo = validate_outbound_message(delivery);
+    if (dispo != PN_RECEIVED) {
+        return dispo;
+    }
+
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " CSIDE new outbound delivery", DLV_ARGS(delivery));
+
+    if (!!pool_claim_TIMER_IO(connector, delivery)) {
+        return QD_DELIVERY_MOVED_TO_NEW_LINK;
+    }
+
+    qd_tcp_connection_t *conn = new_connection_CSIDE(connector);
+    conn->state = CSIDE_INITIAL;
+
+    sys_mutex_lock(&connector->lock);
+    bind_outbound_delivery_CSIDE_LH(connector, conn, delivery);
+    sys_mutex_unlock(&connector->lock);
+
+    //
+    // The raw connection establishment must be the last thing done in this function.
+    // After this call, a separate IO thread may immediately be invoked in the context
+    // of the new connection to handle raw connection events.
+    //
+    char        buffer[QD_DNS_CACHE_ADDRESS_MAX];
+    const char *address = qd_dns_entry_lookup(connector->dns_entry, buffer);
+    conn->connect_start = now_usec();
+    pn_proactor_raw_connect(tcp_context->proactor, conn->raw_conn, address);
+
+    return QD_DELIVERY_MOVED_TO_NEW_LINK;
+}
+
+
+/**
+ * Handle subsequent pushes of the outbound delivery on CSIDE.  This is where delivery completion will be 
+ * detected and raw connection write-close will occur.
+ */
+static void handle_outbound_delivery_CSIDE(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery, bool settled)
+{
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] handle_outbound_delivery_CSIDE - receive_complete=%s",
+           conn->conn_id, qd_message_receive_complete(conn->outbound_stream) ? "true" : "false");
+
+    //
+    // It is not guaranteed that this function will be called on the proper IO thread.  Wake the raw connection for
+    // continued processing in the correct context.
+    //
+    sys_mutex_lock(&conn->activation_lock);
+    if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
+        pn_raw_connection_wake(conn->raw_conn);
+    }
+    sys_mutex_unlock(&conn->activation_lock);
+}
+
+
+/**
+ * Produce the available read buffers into the inbound stream and account for them.
+ *
+ * @param conn Pointer to the TCP connection record
+ * @param read_closed Set true if the raw connection is read-closed (see produce_read_buffers_XSIDE_IO)
+ */
+static void produce_inbound_stream_XSIDE_IO(qd_tcp_connection_t *conn, bool *read_closed)
+{
+    ASSERT_RAW_IO;
+    bool was_blocked = window_full(conn);
+    uint64_t octet_count = produce_read_buffers_XSIDE_IO(conn, conn->inbound_stream, read_closed);
+    conn->inbound_octets += octet_count;
+    if (!!conn->rate_limits && octet_count > 0) {
+        (void) qd_policy_rate_charge(conn->rate_limits, octet_count, 0);
+    }
+
+    read_rate_update_XSIDE_IO(conn, octet_count);
+    if (octet_count > 0) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] %cSIDE Raw read: Produced %"PRIu64" octets into stream", conn->conn_id, conn->listener_side ? 'L' : 'C', octet_count);
+        QD_PROBE_TCP_READ(conn->conn_id, conn->inbound_link_id,
+                          conn->inbound_delivery ? conn->inbound_delivery->delivery_id : 0, octet_count);
+        window_bytes_read(conn);
+        if (!was_blocked && window_full(conn) && !*read_closed && !window_local_path(conn, conn->inbound_stream)) {
+            uint64_t unacked = conn->inbound_octets - conn->window.last_update;
+            window_closed(conn);
+            //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_UNACKED, unacked);
+            // there is no inbound delivery between the requests of a requestBalancing http1 flow
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] TCP RX window CLOSED: inbound_bytes=%" PRIu64 " unacked=%" PRIu64,
+                   conn->conn_id, conn->inbound_link_id, conn->inbound_octets, unacked);
+        }
+        if (conn->listener_side) {
+            vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS, conn->inbound_octets);
+        }
+    }
+
+    //
+    // Manage latency measurements
+    //
+    if (!conn->inbound_first_octet && octet_count > 0) {
+        first_inbound_octet_XSIDE_IO(conn);
+    }
+}
+
+
+/**
+ * Fast-open (see the tcpListener fastOpen attribute): read the client's octets before the connector side has
+ * answered the client stream, from the listener-side states that precede LSIDE_FLOW.  Read buffers are granted from
+ * link setup on and the octets read are produced into the client stream as soon as it exists.  A read-closed raw
+ * connection is left for manage_flow_XSIDE_IO() to detect once the stream is answered.
+ */
+static void fast_open_read_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_listener_t *li = (qd_tcp_listener_t *) conn->common.parent;
+    if (!li || !li->fast_open || !!conn->tls_session || !conn->raw_conn) {
+        return;
+    }
+
+    if (!!conn->inbound_stream) {
+        bool read_closed;
+        produce_inbound_stream_XSIDE_IO(conn, &read_closed);
+        if (!qd_message_can_produce_buffers(conn->inbound_stream)) {
+            return;
+        }
+    }
+
+    size_t capacity = pn_raw_connection_read_buffers_capacity(conn->raw_conn);
+    if (capacity > 0) {
+        grant_read_buffers_XSIDE_IO(conn, capacity);
+    }
+}
+
+
+//=================================================================================
+// HTTP/1 Request Balancing
+//=================================================================================
+//
+// A tcpListener with requestBalancing http1 routes each HTTP/1 request of a client connection on its own, so the
+// requests of a long lived keep-alive connection are balanced across the tcpConnectors of the address instead of all
+// going to the server the connection happened to reach first.
+//
+// The client octets are read into conn->http1->held and run through the HTTP/1 decoder as they are produced into the
+// client stream.  The stream of a request ends where the decoder finds the end of the request, the octets that follow
+// start the stream of the next one.  The connector side serves each client stream as a flow of its own: it
+// write-closes its backend connection after the request and the server stream ends when the backend closes the
+// connection after its response.
+//
+// Up to HTTP1_PIPELINE_DEPTH requests of a pipelining client are in flight at once and their responses are written to
+// the client in the order of the requests.  The client streams carry their sequence number as flow tag, echoed as the
+// correlation-id of the server stream (see "Shared Core Connections").  The server streams arrive on streaming links
+// of their own, so one arriving ahead of its turn is held without blocking the response before it.  The client
+// stream of a request is kept until it is settled or its response is written so that a request the network cannot
+// deliver fails the connection as it does for a plain flow.
+//
+// A CONNECT request, a request to upgrade the protocol or octets the decoder cannot parse end the balancing: the
+// stream of the current request carries the rest of the client octets and its response ends the flow.
+//
+#define HTTP1_PIPELINE_DEPTH 8
+
+typedef struct qd_tcp_http1_slot_t {
+    qdr_delivery_t *request;   // the completed client stream, with a reference, until settled or answered
+    qdr_delivery_t *response;  // the server stream if it arrived before its turn, with a reference
+} qd_tcp_http1_slot_t;
+
+struct qd_tcp_http1_t {
+    qd_http1_decoder_connection_t *decoder;        // of the request being produced
+    qd_buffer_list_t               held;           // client octets read but not yet produced into a client stream
+    uint64_t                       requests;       // client streams started
+    uint64_t                       responses;      // server streams written to the client
+    uint64_t                       produced;       // client octets produced into the client streams
+    uint64_t                       stream_base;    // client octets produced before the current client stream
+    uint64_t                       response_base;  // octets written to the client before the current server stream
+    qd_tcp_http1_slot_t            slots[HTTP1_PIPELINE_DEPTH];  // by request sequence number
+    bool                           request_ended;  // the decoder found the end of the current request
+    bool                           tunnel;         // the current streams carry the rest of the flow
+    bool                           read_closed;    // the client closed its side of the connection
+    bool                           write_closed;
+};
+
+
+static int http1_rx_request(qd_http1_decoder_connection_t *hconn, const char *method, const char *target,
+                            uint32_t version_major, uint32_t version_minor, uintptr_t *request_context)
+{
+    qd_tcp_connection_t *conn = (qd_tcp_connection_t*) qd_http1_decoder_connection_get_context(hconn);
+    if (strcasecmp(method, "CONNECT") == 0) {
+        conn->http1->tunnel = true;
+    }
+    return 0;
+}
+
+static int http1_rx_response(qd_http1_decoder_connection_t *hconn, uintptr_t request_context, int status_code,
+                             const char *reason_phrase, uint32_t version_major, uint32_t version_minor)
+{
+    return 0;  // only the client octets are decoded
+}
+
+static int http1_rx_header(qd_http1_decoder_connection_t *hconn, uintptr_t request_context, bool from_client,
+                           const char *key, const char *value)
+{
+    qd_tcp_connection_t *conn = (qd_tcp_connection_t*) qd_http1_decoder_connection_get_context(hconn);
+    if (from_client && strcasecmp(key, "Upgrade") == 0) {
+        conn->http1->tunnel = true;
+    }
+    return 0;
+}
+
+static int http1_message_done(qd_http1_decoder_connection_t *hconn, uintptr_t request_context, bool from_client)
+{
+    qd_tcp_connection_t *conn = (qd_tcp_connection_t*) qd_http1_decoder_connection_get_context(hconn);
+    if (from_client) {
+        conn->http1->request_ended = true;
+    }
+    return 0;
+}
+
+static int http1_transaction_complete(qd_http1_decoder_connection_t *hconn, uintptr_t request_context)
+{
+    return 0;
+}
+
+static void http1_protocol_error(qd_http1_decoder_connection_t *hconn, const char *reason)
+{
+    qd_tcp_connection_t *conn = (qd_tcp_connection_t*) qd_http1_decoder_connection_get_context(hconn);
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] HTTP/1 request balancing ended: %s", conn->conn_id, reason);
+    conn->http1->tunnel = true;
+}
+
+static const qd_http1_decoder_config_t http1_decoder_config = {
+    .rx_request           = http1_rx_request,
+    .rx_response          = http1_rx_response,
+    .rx_header            = http1_rx_header,
+    .message_done         = http1_message_done,
+    .transaction_complete = http1_transaction_complete,
+    .protocol_error       = http1_protocol_error
+};
+
+
+static qd_tcp_http1_t *http1_state(qd_tcp_connection_t *conn)
+{
+    qd_tcp_http1_t *h1 = NEW(qd_tcp_http1_t);
+    ZERO(h1);
+    DEQ_INIT(h1->held);
+    h1->decoder = qd_http1_decoder_connection(&http1_decoder_config, (uintptr_t) conn);
+    return h1;
+}
+
+
+static void http1_free_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    // No thread assertion here - can be RAW_IO or TIMER_IO
+    qd_tcp_http1_t *h1 = conn->http1;
+
+    for (int i = 0; i < HTTP1_PIPELINE_DEPTH; i++) {
+        qd_tcp_http1_slot_t *slot = &h1->slots[i];
+        if (!!slot->request) {
+            qdr_delivery_set_context(slot->request, 0);
+            qdr_delivery_decref(tcp_context->core, slot->request, "http1_free_XSIDE_IO - request released");
+        }
+        if (!!slot->response) {
+            qdr_delivery_remote_state_updated(tcp_context->core, slot->response, PN_MODIFIED, true, 0, false);
+            qdr_delivery_set_context(slot->response, 0);
+            qdr_delivery_decref(tcp_context->core, slot->response, "http1_free_XSIDE_IO - response released");
+        }
+    }
+    qd_buffer_list_free_buffers(&h1->held);
+    qd_http1_decoder_connection_free(h1->decoder);
+    free(h1);
+    conn->http1 = 0;
+}
+
+
+// The octets of the current server stream written to the client, the section offset of its PN_RECEIVED updates
+//
+static inline uint64_t outbound_stream_octets(const qd_tcp_connection_t *conn)
+{
+    return conn->outbound_octets - (!!conn->http1 ? conn->http1->response_base : 0);
+}
+
+
+// A client stream is about to be composed: give it the sequence number of its request as flow tag.  Every request
+// after the first gets a new decoder, and the window of its stream starts out open.
+//
+static void http1_next_request_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1 = conn->http1;
+    char            tag[24];
+
+    snprintf(tag, sizeof(tag), "%" PRIu64, h1->requests);
+    free(conn->flow_tag);
+    conn->flow_tag = qd_strdup(tag);
+
+    if (h1->requests > 0) {
+        qd_http1_decoder_connection_free(h1->decoder);
+        h1->decoder = qd_http1_decoder_connection(&http1_decoder_config, (uintptr_t) conn);
+
+        h1->stream_base           = h1->produced;
+        conn->window.last_update  = h1->produced;
+        conn->window.probe_offset = 0;
+        conn->window.limited      = false;
+        conn->window.local_path   = false;
+        conn->window.disabled     = false;
+    }
+    h1->request_ended = false;
+    h1->requests++;
+}
+
+
+// Move the held client octets of the current request to buffers, up to the end of the request
+//
+// @return the number of octets moved
+//
+static uint64_t http1_take_request_LSIDE_IO(qd_tcp_connection_t *conn, qd_buffer_list_t *buffers)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1     = conn->http1;
+    uint64_t        octets = 0;
+
+    while (!h1->request_ended && !DEQ_IS_EMPTY(h1->held)) {
+        qd_buffer_t  *buf  = DEQ_HEAD(h1->held);
+        const size_t  size = qd_buffer_size(buf);
+        size_t        used = size;
+
+        if (!h1->tunnel) {
+            if (qd_http1_decoder_connection_rx_message(h1->decoder, true, qd_buffer_base(buf), size, &used) != 0) {
+                h1->tunnel = true;  // see http1_protocol_error()
+            }
+            if (h1->tunnel) {
+                used              = size;
+                h1->request_ended = false;
+            }
+        }
+
+        DEQ_REMOVE_HEAD(h1->held);
+        if (used < size) {
+            // The request ended within the buffer: the octets past its end start the next request
+            qd_buffer_list_t rest = DEQ_EMPTY;
+            qd_buffer_list_append(&rest, qd_buffer_base(buf) + used, size - used);
+            DEQ_APPEND(rest, h1->held);
+            DEQ_MOVE(rest, h1->held);
+            buf->size = used;
+        }
+        if (used > 0) {
+            DEQ_INSERT_TAIL(*buffers, buf);
+            octets += used;
+        } else {
+            qd_buffer_free(buf);
+        }
+    }
+    return octets;
+}
+
+
+// Read the client octets into conn->http1->held and produce those of the current request into its client stream.
+// See produce_read_buffers_XSIDE_IO.
+//
+static uint64_t http1_read_requests_LSIDE_IO(qd_tcp_connection_t *conn, bool *read_closed)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1          = conn->http1;
+    uint64_t        octet_count = take_read_buffers_XSIDE_IO(conn, &h1->held);
+
+    // ISSUE-1446: see produce_read_buffers_XSIDE_IO
+    *read_closed = pn_raw_connection_is_read_closed(conn->raw_conn);
+
+    if (!!conn->inbound_stream && qd_message_can_produce_buffers(conn->inbound_stream)) {
+        qd_buffer_list_t buffers = DEQ_EMPTY;
+        h1->produced += http1_take_request_LSIDE_IO(conn, &buffers);
+        if (!DEQ_IS_EMPTY(buffers)) {
+            qd_message_produce_buffers(conn->inbound_stream, &buffers);
+        }
+    }
+    return octet_count;
+}
+
+
+// The current request has been produced: complete its client stream
+//
+static void http1_end_request_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t      *h1   = conn->http1;
+    const uint64_t       seq  = h1->requests - 1;
+    qd_tcp_http1_slot_t *slot = &h1->slots[seq % HTTP1_PIPELINE_DEPTH];
+
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " HTTP/1 request %" PRIu64 " complete - close inbound delivery",
+           DLV_ARGS(conn->inbound_delivery), seq);
+    qd_message_set_receive_complete(conn->inbound_stream);
+    qd_message_cancel_producer_activation(conn->inbound_stream);
+    qdr_delivery_continue(tcp_context->core, conn->inbound_delivery, false);
+
+    if (seq >= h1->responses) {
+        assert(!slot->request);
+        slot->request = conn->inbound_delivery;  // the reference and the context are kept, see http1_request_update_XSIDE_IO
+    } else {
+        // the response was written before the end of the request
+        qdr_delivery_set_context(conn->inbound_delivery, 0);
+        qdr_delivery_decref(tcp_context->core, conn->inbound_delivery, "http1_end_request_LSIDE_IO - request answered");
+    }
+    conn->inbound_delivery = 0;
+    conn->inbound_stream   = 0;
+}
+
+
+// Write-close the client connection once the client closed its side and all of its requests are answered
+//
+static void http1_check_done_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1 = conn->http1;
+
+    if (h1->read_closed && !h1->write_closed && !conn->inbound_stream && !conn->outbound_stream
+        && DEQ_IS_EMPTY(h1->held) && h1->responses == h1->requests) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] HTTP/1 requests answered: Write-closing the raw connection",
+               conn->conn_id);
+        h1->write_closed = true;
+        pn_raw_connection_write_close(conn->raw_conn);
+    }
+}
+
+
+// The client side of manage_flow_XSIDE_IO for a requestBalancing http1 flow
+//
+// @return true if the state machine is to run again
+//
+static bool http1_manage_requests_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1          = conn->http1;
+    bool            read_closed = false;
+
+    produce_inbound_stream_XSIDE_IO(conn, &read_closed);
+    h1->read_closed = h1->read_closed || read_closed;
+
+    const bool room = h1->requests - h1->responses < HTTP1_PIPELINE_DEPTH;
+    if (!!conn->inbound_stream) {
+        if (h1->request_ended || (h1->read_closed && DEQ_IS_EMPTY(h1->held))) {
+            http1_end_request_LSIDE_IO(conn);
+            return true;
+        }
+    } else if (!DEQ_IS_EMPTY(h1->held) && room) {
+        // the client sent the start of its next request
+        return try_compose_and_send_client_stream_LSIDE_IO(conn);
+    }
+
+    //
+    // Read on while the current client stream takes the octets or, between requests, while another one may be sent
+    //
+    size_t capacity = pn_raw_connection_read_buffers_capacity(conn->raw_conn);
+    if (!h1->read_closed && DEQ_IS_EMPTY(h1->held) && capacity > 0
+        && (!!conn->inbound_stream ? qd_message_can_produce_buffers(conn->inbound_stream) : room)) {
+        grant_read_buffers_XSIDE_IO(conn, capacity);
+    }
+
+    http1_check_done_LSIDE_IO(conn);
+    return false;
+}
+
+
+// The server stream at the head of the responses has been written to the client: take up the next one
+//
+static void http1_response_done_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t      *h1   = conn->http1;
+    qd_tcp_http1_slot_t *slot = &h1->slots[h1->responses % HTTP1_PIPELINE_DEPTH];
+
+    if (!!slot->request) {
+        qdr_delivery_set_context(slot->request, 0);
+        qdr_delivery_decref(tcp_context->core, slot->request, "http1_response_done_LSIDE_IO - request answered");
+        slot->request = 0;
+    }
+    h1->responses++;
+    h1->response_base        = conn->outbound_octets;
+    conn->window.pending_ack = 0;
+
+    slot = &h1->slots[h1->responses % HTTP1_PIPELINE_DEPTH];
+    if (!!slot->response) {
+        start_outbound_stream_LSIDE_IO(conn, slot->response);
+        slot->response = 0;
+    } else if (h1->tunnel) {
+        if (!h1->write_closed && h1->responses == h1->requests) {
+            // as for a plain flow: the end of the server stream write-closes the client connection
+            h1->write_closed = true;
+            pn_raw_connection_write_close(conn->raw_conn);
+        }
+    } else {
+        http1_check_done_LSIDE_IO(conn);
+    }
+}
+
+
+// A server stream arrived on a streaming link of a requestBalancing http1 flow: match it up with its request
+//
+// @return 0 on success, otherwise a terminal outcome indicating that the message cannot be delivered.
+//
+static uint64_t http1_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1 = conn->http1;
+
+    if (qdr_delivery_get_context(delivery) == (void*) conn) {
+        // more of a server stream taken up before
+        connection_run_LSIDE_IO(conn);
+        return 0;
+    }
+
+    uint64_t dispo = validate_outbound_message(delivery);
+    if (dispo != PN_RECEIVED) {
+        // see handle_outbound_delivery_LSIDE_IO(): a server stream cannot be redelivered to another consumer
+        return dispo == PN_RELEASED ? PN_REJECTED : dispo;
+    }
+
+    uint64_t              seq   = UINT64_MAX;
+    qd_iterator_storage_t storage;
+    qd_iterator_t        *tag   = qd_message_field_iterator_init(&storage, qdr_delivery_message(delivery), QD_FIELD_CORRELATION_ID);
+    if (!!tag) {
+        char  text[24];
+        char *end = 0;
+        qd_iterator_strncpy(tag, text, sizeof(text));
+        seq = strtoull(text, &end, 10);
+        if (end == text || *end != '\0') {
+            seq = UINT64_MAX;
+        }
+        qd_iterator_free(tag);
+    }
+
+    // Replace the credit of the delivery as it leaves the link
+    qdr_link_flow(tcp_context->core, link, 1, false);
+
+    qd_tcp_http1_slot_t *slot = &h1->slots[seq % HTTP1_PIPELINE_DEPTH];
+    if (seq < h1->responses || seq >= h1->requests || !!slot->response
+        || (seq == h1->responses && !!conn->outbound_delivery)) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING,
+               DLV_FMT " Server stream for no request of [C%" PRIu64 "] rejected, the connector side router may not support requestBalancing",
+               DLV_ARGS(delivery), conn->conn_id);
+        qd_message_set_send_complete(qdr_delivery_message(delivery));
+        return PN_REJECTED;
+    }
+
+    qdr_delivery_incref(delivery, "http1_outbound_delivery_LSIDE_IO");
+    qdr_delivery_set_context(delivery, conn);
+    if (seq == h1->responses) {
+        start_outbound_stream_LSIDE_IO(conn, delivery);
+    } else {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Server stream of HTTP/1 request %" PRIu64 " held for its turn",
+               DLV_ARGS(delivery), seq);
+        slot->response = delivery;
+    }
+
+    connection_run_LSIDE_IO(conn);
+    return 0;
+}
+
+
+// A disposition update for the client stream of a request that is complete
+//
+// @return true if the connection is to be run
+//
+static bool http1_request_update_XSIDE_IO(qd_tcp_connection_t *conn, qdr_delivery_t *dlv, uint64_t disp, bool settled)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_http1_t *h1 = conn->http1;
+
+    for (uint64_t seq = h1->responses; seq < h1->requests; seq++) {
+        qd_tcp_http1_slot_t *slot = &h1->slots[seq % HTTP1_PIPELINE_DEPTH];
+        if (slot->request != dlv) {
+            continue;
+        }
+        if (qd_delivery_state_is_terminal(disp) && disp != PN_ACCEPTED) {
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " HTTP/1 request %" PRIu64 " failed - disposition: %s",
+                   DLV_ARGS(dlv), seq, pn_disposition_type_name(disp));
+            if (!!conn->raw_conn) {
+                close_raw_connection(conn, "delivery-failed", "destination unreachable");
+            }
+        } else if (settled) {
+            qdr_delivery_set_context(dlv, 0);
+            qdr_delivery_decref(tcp_context->core, dlv, "http1_request_update_XSIDE_IO - request settled");
+            slot->request = 0;
+        }
+        break;
+    }
+    return false;
+}
+
+
+//=================================================================================
+// Striped Flows
+//=================================================================================
+//
+// The server data of a flow is a single streaming delivery, so it crosses each inter-router hop on one data
+// connection and is limited by the I/O thread and the TCP window of that connection.  A tcpListener with stripes N
+// offers to take the server data of its flows striped across up to N streams, a tcpConnector with stripes M stripes
+// it across min(N, M): the main server stream plus a stripe stream for each further stripe, all sent to the reply-to
+// of the flow.  The core puts each streaming delivery on the next connection of the group of inter-router data
+// connections to the next hop (see get_outgoing_streaming_link()), so the stripes of a flow spread over them.
+//
+// The octets read from the server are cut into chunks of TCP_STRIPE_CHUNK octets, chunk i going to stripe i % count.
+// The listener side writes the chunks to the client in order, each taken from its stripe, so no framing is needed:
+// the flow ends where the stripe of the current chunk ends.  The main server stream carries the count of stripes and
+// the window updates for all of the flow's server data, the stripe streams carry their stripe number.  Routers of an
+// older version neither offer nor stripe.  The client data of a flow is not striped.
+//
+#define TCP_STRIPES_MAX  8
+#define TCP_STRIPE_CHUNK 65536
+
+struct qd_tcp_stripes_t {
+    uint32_t          count;                           // stripes including the main stream, 0 until known (LSIDE)
+    qdr_delivery_t   *delivery[TCP_STRIPES_MAX];       // of the stripe streams, from 1, with a reference
+    qd_message_t     *stream[TCP_STRIPES_MAX];         // by stripe, stream[0] is the main server stream
+    qd_buffer_list_t  held[TCP_STRIPES_MAX];           // LSIDE: octets taken from a stripe but not yet written
+    bool              body_complete[TCP_STRIPES_MAX];  // LSIDE: the non-cut-through body of the stripe is taken
+    uint64_t          chunk;                           // the chunk being read (CSIDE) or written (LSIDE)
+    uint64_t          chunk_octets;                    // of it so far
+    bool              ended;                           // LSIDE: the last chunk is written
+};
+
+
+static qd_tcp_stripes_t *stripes_state(void)
+{
+    qd_tcp_stripes_t *st = NEW(qd_tcp_stripes_t);
+    ZERO(st);
+    for (int i = 0; i < TCP_STRIPES_MAX; i++) {
+        DEQ_INIT(st->held[i]);
+    }
+    return st;
+}
+
+
+static void stripes_free_XSIDE_IO(qd_tcp_connection_t *conn)
+{
+    // No thread assertion here - can be RAW_IO or TIMER_IO
+    qd_tcp_stripes_t *st = conn->stripes;
+
+    for (int i = 1; i < TCP_STRIPES_MAX; i++) {
+        qdr_delivery_t *dlv = st->delivery[i];
+        if (!dlv) {
+            continue;
+        }
+        if (conn->listener_side) {
+            qd_message_cancel_consumer_activation(st->stream[i]);
+            qdr_delivery_remote_state_updated(tcp_context->core, dlv, PN_MODIFIED, true, 0, false);
+        } else {
+            qd_message_set_receive_complete(st->stream[i]);
+            qd_message_cancel_producer_activation(st->stream[i]);
+            qdr_delivery_continue(tcp_context->core, dlv, false);
+            qdr_delivery_remote_state_updated(tcp_context->core, dlv, 0, true, 0, false);
+        }
+        qdr_delivery_set_context(dlv, 0);
+        qdr_delivery_decref(tcp_context->core, dlv, "stripes_free_XSIDE_IO - stripe released");
+    }
+    for (int i = 0; i < TCP_STRIPES_MAX; i++) {
+        qd_buffer_list_free_buffers(&st->held[i]);
+    }
+    free(st);
+    conn->stripes = 0;
+}
+
+
+// The value of an unsigned integer application property of a stream, 0 if it has none
+//
+static uint32_t get_stream_uint_property(qd_message_t *msg, const char *name)
+{
+    qd_iterator_t *ap_iter = qd_message_field_iterator(msg, QD_FIELD_APPLICATION_PROPERTIES);
+    if (!ap_iter) {
+        return 0;
+    }
+
+    uint32_t           value = 0;
+    qd_parsed_field_t *ap    = qd_parse(ap_iter);
+    if (ap && qd_parse_ok(ap) && qd_parse_is_map(ap)) {
+        uint32_t count = qd_parse_sub_count(ap);
+        for (uint32_t i = 0; i < count; i++) {
+            qd_parsed_field_t *key = qd_parse_sub_key(ap, i);
+            if (key == 0) {
+                break;
+            }
+            qd_iterator_t *key_iter = qd_parse_raw(key);
+            if (!!key_iter && qd_iterator_equal(key_iter, (const unsigned char *) name)) {
+                qd_parsed_field_t *field = qd_parse_sub_value(ap, i);
+                value = qd_parse_as_uint(field);
+                if (!qd_parse_ok(field)) {
+                    value = 0;
+                }
+                break;
+            }
+        }
+    }
+
+    qd_parse_free(ap);
+    qd_iterator_free(ap_iter);
+    return value;
+}
+
+
+// The stripes of the server data of a new flow: those the client stream offers, within the limit of the connector
+//
+static uint32_t stripes_count_CSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_connector_t *connector = (qd_tcp_connector_t*) conn->common.parent;
+    if (connector->stripes <= 1 || !!conn->tls_session) {
+        return 1;
+    }
+    uint32_t offered = get_stream_uint_property(conn->outbound_stream, STRIPES_KEY);
+    return MAX(MIN(MIN(offered, connector->stripes), TCP_STRIPES_MAX), 1);
+}
+
+
+// The main server stream of a striped flow has been sent: send the stripe streams after it
+//
+static void stripes_start_CSIDE_IO(qd_tcp_connection_t *conn, uint32_t count)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = stripes_state();
+
+    st->count     = count;
+    st->stream[0] = conn->inbound_stream;
+    for (uint32_t i = 1; i < count; i++) {
+        st->stream[i] = send_server_stream_CSIDE_IO(conn, i, 0, &st->delivery[i]);
+    }
+    conn->stripes = st;
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Server data striped across %" PRIu32 " streams",
+           DLV_ARGS(conn->inbound_delivery), count);
+}
+
+
+// True if the octets read from the server can be produced into the streams of all of the stripes
+//
+static bool stripes_can_produce_CSIDE_IO(const qd_tcp_connection_t *conn)
+{
+    const qd_tcp_stripes_t *st = conn->stripes;
+    for (uint32_t i = 0; i < st->count; i++) {
+        if (!qd_message_can_produce_buffers(st->stream[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Read the octets of the server and produce each chunk into the stream of its stripe.  See
+// produce_read_buffers_XSIDE_IO.
+//
+static uint64_t stripes_read_CSIDE_IO(qd_tcp_connection_t *conn, bool *read_closed)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
+
+    if (!stripes_can_produce_CSIDE_IO(conn)) {
+        return 0;
+    }
+
+    qd_buffer_list_t buffers     = DEQ_EMPTY;
+    uint64_t         octet_count = take_read_buffers_XSIDE_IO(conn, &buffers);
+
+    // ISSUE-1446: see produce_read_buffers_XSIDE_IO
+    *read_closed = pn_raw_connection_is_read_closed(conn->raw_conn);
+
+    qd_buffer_list_t chunks[TCP_STRIPES_MAX];
+    for (uint32_t i = 0; i < st->count; i++) {
+        DEQ_INIT(chunks[i]);
+    }
+
+    qd_buffer_t *buf = DEQ_HEAD(buffers);
+    while (!!buf) {
+        DEQ_REMOVE_HEAD(buffers);
+        const size_t size = qd_buffer_size(buf);
+        const size_t room = TCP_STRIPE_CHUNK - st->chunk_octets;
+        if (size > room) {
+            // The chunk ends within the buffer: the octets past its end start the next chunk
+            qd_buffer_list_t rest = DEQ_EMPTY;
+            qd_buffer_list_append(&rest, qd_buffer_base(buf) + room, size - room);
+            DEQ_APPEND(rest, buffers);
+            DEQ_MOVE(rest, buffers);
+            buf->size = room;
+        }
+        DEQ_INSERT_TAIL(chunks[st->chunk % st->count], buf);
+        st->chunk_octets += qd_buffer_size(buf);
+        if (st->chunk_octets == TCP_STRIPE_CHUNK) {
+            st->chunk++;
+            st->chunk_octets = 0;
+        }
+        buf = DEQ_HEAD(buffers);
+    }
+
+    for (uint32_t i = 0; i < st->count; i++) {
+        if (!DEQ_IS_EMPTY(chunks[i])) {
+            qd_message_produce_buffers(st->stream[i], &chunks[i]);
+        }
+    }
+    return octet_count;
+}
+
+
+// The server closed its side of the connection: complete the stripe streams along with the main server stream
+//
+static void stripes_end_CSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
+
+    for (uint32_t i = 1; i < st->count; i++) {
+        qdr_delivery_t *dlv = st->delivery[i];
+        if (!dlv) {
+            continue;
+        }
+        qd_message_set_receive_complete(st->stream[i]);
+        qd_message_cancel_producer_activation(st->stream[i]);
+        qdr_delivery_continue(tcp_context->core, dlv, false);
+        qdr_delivery_set_context(dlv, 0);
+        qdr_delivery_decref(tcp_context->core, dlv, "stripes_end_CSIDE_IO - stripe released");
+        st->delivery[i] = 0;
+        st->stream[i]   = 0;
+    }
+    st->stream[0] = 0;
+}
+
+
+// A server stream arrived for a flow whose listener offers striping
+//
+// @return 0 on success, otherwise a terminal outcome indicating that the message cannot be delivered.
+//
+static uint64_t stripes_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
+
+    if (qdr_delivery_get_context(delivery) == (void*) conn) {
+        // more of a stream taken up before
+        connection_run_LSIDE_IO(conn);
+        return 0;
+    }
+
+    uint64_t dispo = validate_outbound_message(delivery);
+    if (dispo != PN_RECEIVED) {
+        // see handle_outbound_delivery_LSIDE_IO(): a server stream cannot be redelivered to another consumer
+        return dispo == PN_RELEASED ? PN_REJECTED : dispo;
+    }
+
+    qd_message_t  *msg    = qdr_delivery_message(delivery);
+    const uint32_t stripe = get_stream_uint_property(msg, STRIPE_KEY);
+
+    // Replace the credit of the delivery as it leaves the link
+    qdr_link_flow(tcp_context->core, link, 1, false);
+
+    if (st->ended || stripe >= TCP_STRIPES_MAX || (st->count > 0 && stripe >= st->count)
+        || (stripe == 0 ? !!conn->outbound_delivery : !!st->delivery[stripe])) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING, DLV_FMT " Unexpected stripe %" PRIu32 " of [C%" PRIu64 "] rejected",
+               DLV_ARGS(delivery), stripe, conn->conn_id);
+        qd_message_set_send_complete(msg);
+        return PN_REJECTED;
+    }
+
+    qdr_delivery_incref(delivery, "stripes_outbound_delivery_LSIDE_IO");
+    qdr_delivery_set_context(delivery, conn);
 
-    if (!conn->outbound_delivery) {
-        // newly arrived delivery: Verify the message sections up to and including the dummy BODY_AMQP_VALUE have
-        // arrived and are valid.
-        //
-        uint64_t dispo = validate_outbound_message(delivery);
-        if (dispo != PN_RECEIVED) {
-            // PN_RELEASED: since this message was delivered to this listener's unique reply-to, it cannot be
-            // redelivered to another consumer. PN_RELEASED means incompatible encapsulation so this is a
-            // misconfiguration. Reject the delivery.
-            if (dispo == PN_RELEASED)
-                dispo = PN_REJECTED;
-            return dispo;
+    if (stripe == 0) {
+        st->count = MAX(MIN(get_stream_uint_property(msg, STRIPES_KEY), TCP_STRIPES_MAX), 1);
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Server data striped across %" PRIu32 " streams",
+               DLV_ARGS(delivery), st->count);
+        start_outbound_stream_LSIDE_IO(conn, delivery);
+        if (st->count == 1) {
+            // the connector side does not stripe the flow
+            stripes_free_XSIDE_IO(conn);
+        } else {
+            st->stream[0] = conn->outbound_stream;
+            conn->outbound_body_complete = true;  // the stripes take their own, see stripes_take_LSIDE_IO()
         }
+    } else {
+        st->delivery[stripe] = delivery;
+        st->stream[stripe]   = msg;
 
-        qdr_delivery_incref(delivery, "handle_outbound_delivery_LSIDE_IO");
-        conn->outbound_delivery = delivery;
-        conn->outbound_stream   = qdr_delivery_message(delivery);
-        qdr_delivery_set_context(delivery, conn);
-
-        //
-        // Message validation ensures the start of the message body is present. Activate cutthrough on the body data.
-        //
         qd_message_activation_t activation;
         activation.type     = QD_ACTIVATION_TCP;
         activation.delivery = 0;
         qd_alloc_set_safe_ptr(&activation.safeptr, conn);
-        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP enabling consumer activation", DLV_ARGS(delivery));
-        qd_message_set_consumer_activation(conn->outbound_stream, &activation);
-        qd_message_start_unicast_cutthrough(conn->outbound_stream);
+        qd_message_set_consumer_activation(msg, &activation);
+        qd_message_start_unicast_cutthrough(msg);
     }
 
     connection_run_LSIDE_IO(conn);
@@ -1216,98 +3282,144 @@ static uint64_t handle_outbound_delivery_LSIDE_IO(qd_tcp_connection_t *conn, qdr
 }
 
 
-/**
- * Handle the first indication of a new outbound delivery on CSIDE.  This is where the raw connection to the
- * external service is established.  This function executes in an IO thread not associated with a raw connection.
- *
- * @return disposition. MOVED_TO_NEW_LINK on success, 0 if more message needed, else error outcome
- */
-static uint64_t handle_first_outbound_delivery_CSIDE(qd_tcp_connector_t *connector, qdr_link_t *link, qdr_delivery_t *delivery)
+// Move the octets of the chunks to write from their stripes to buffers, up to limit buffers
+//
+static void stripes_take_LSIDE_IO(qd_tcp_connection_t *conn, qd_buffer_list_t *buffers, size_t limit)
 {
-    ASSERT_TIMER_IO;
-    assert(!qdr_delivery_get_context(delivery));
-
-    // Verify the message sections up to and including the dummy BODY_AMQP_VALUE have arrived and are valid.
-    //
-    uint64_t dispo = validate_outbound_message(delivery);
-    if (dispo != PN_RECEIVED) {
-        return dispo;
-    }
-
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " CSIDE new outbound delivery", DLV_ARGS(delivery));
-
-    qd_message_t         *msg = qdr_delivery_message(delivery);
-    qd_tcp_connection_t *conn = new_qd_tcp_connection_t();
-    ZERO(conn);
-
-    qdr_delivery_incref(delivery, "CORE_deliver_outbound CSIDE");
-    qdr_delivery_set_context(delivery, conn);
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
+
+    while (DEQ_SIZE(*buffers) < limit && !st->ended && st->count > 1) {
+        const uint32_t    stripe = st->chunk % st->count;
+        qd_message_t     *stream = st->stream[stripe];
+        qd_buffer_list_t *held   = &st->held[stripe];
+        if (!stream) {
+            break;  // the stripe stream has not arrived yet
+        }
 
-    conn->conn_id  = qd_server_allocate_connection_id(tcp_context->server);
-    conn->common.context_type = TL_CONNECTION;
-    conn->common.parent       = (qd_tcp_common_t*) connector;
-    //
-    // Call connector incref when a connection references a connector via conn->common.parent
-    //
-    qd_tcp_connector_incref(connector);
+        if (DEQ_IS_EMPTY(*held)) {
+            const size_t want = limit - DEQ_SIZE(*buffers);
+            if (!st->body_complete[stripe]) {
+                qd_message_take_raw_body(stream, held, want, &st->body_complete[stripe]);
+            }
+            if (DEQ_IS_EMPTY(*held) && st->body_complete[stripe]) {
+                qd_buffer_list_t more = DEQ_EMPTY;
+                qd_message_consume_buffers(stream, &more, want);
+                DEQ_APPEND(*held, more);
+            }
+            if (DEQ_IS_EMPTY(*held)) {
+                if (st->body_complete[stripe] && qd_message_receive_complete(stream)
+                    && !qd_message_can_consume_buffers(stream)) {
+                    st->ended = true;  // the flow ends within this chunk
+                }
+                break;
+            }
+        }
 
-    sys_atomic_init(&conn->core_activation, 0);
-    sys_atomic_init(&conn->raw_opened, 0);
+        qd_buffer_t  *buf  = DEQ_HEAD(*held);
+        const size_t  size = qd_buffer_size(buf);
+        const size_t  room = TCP_STRIPE_CHUNK - st->chunk_octets;
+        DEQ_REMOVE_HEAD(*held);
+        if (size > room) {
+            // The chunk ends within the buffer: the octets past its end belong to the next chunk of the stripe
+            qd_buffer_list_t rest = DEQ_EMPTY;
+            qd_buffer_list_append(&rest, qd_buffer_base(buf) + room, size - room);
+            DEQ_APPEND(rest, *held);
+            DEQ_MOVE(rest, *held);
+            buf->size = room;
+        }
+        if (qd_buffer_size(buf) == 0) {
+            qd_buffer_free(buf);
+            continue;
+        }
+        DEQ_INSERT_TAIL(*buffers, buf);
+        st->chunk_octets += qd_buffer_size(buf);
+        if (st->chunk_octets == TCP_STRIPE_CHUNK) {
+            st->chunk++;
+            st->chunk_octets = 0;
+        }
+    }
+}
 
-    conn->listener_side     = false;
-    conn->state             = CSIDE_INITIAL;
-    conn->outbound_delivery = delivery;
-    conn->outbound_stream   = msg;
 
-    //
-    // Get relevant data from the connection stream.  If there is base-record data in the stream,
-    // this will create a VanFlow co-record that we can use to report metrics and state.
-    //
-    extract_metadata_from_stream_CSIDE(conn);
-    //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_SIZE, TCP_MAX_CAPACITY_BYTES);
+// Write the server data of a striped flow to the client.  See consume_write_buffers_XSIDE_IO.
+//
+// @return the number of octets written
+//
+static uint64_t stripes_consume_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    size_t   limit       = pn_raw_connection_write_buffers_capacity(conn->raw_conn);
+    uint64_t octet_count = 0;
+    uint64_t writes      = 0;
 
-    conn->context.context = conn;
-    conn->context.handler = on_connection_event_CSIDE_IO;
+    while (limit > 0) {
+        qd_buffer_list_t buffers = DEQ_EMPTY;
+        stripes_take_LSIDE_IO(conn, &buffers, limit);
+        if (DEQ_IS_EMPTY(buffers)) {
+            break;
+        }
+        coalesce_buffers(&buffers);
+        const size_t actual = DEQ_SIZE(buffers);
+        octet_count += write_raw_buffers_XSIDE_IO(conn, &buffers);
+        writes      += actual;
+        limit       -= actual;
+    }
 
-    conn->raw_conn = pn_raw_connection();
-    pn_raw_connection_set_context(conn->raw_conn, &conn->context);
+    count_raw_writes_XSIDE_IO(conn, writes, octet_count);
+    return octet_count;
+}
 
-    sys_mutex_lock(&connector->lock);
-    DEQ_INSERT_TAIL(connector->connections, conn);
-    connector->connections_opened++;
-    vflow_set_uint64(connector->common.vflow, VFLOW_ATTRIBUTE_FLOW_COUNT_L4, connector->connections_opened);
-    vflow_set_ref_from_record(conn->common.vflow, VFLOW_ATTRIBUTE_CONNECTOR, connector->common.vflow);
-    sys_mutex_unlock(&connector->lock);
 
-    //
-    // The raw connection establishment must be the last thing done in this function.
-    // After this call, a separate IO thread may immediately be invoked in the context
-    // of the new connection to handle raw connection events.
-    //
-    pn_proactor_raw_connect(tcp_context->proactor, conn->raw_conn, connector->adaptor_config->host_port);
+// The last chunk of a striped flow is written: settle the stripe streams along with the main server stream
+//
+static void stripes_end_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
 
-    return QD_DELIVERY_MOVED_TO_NEW_LINK;
+    for (uint32_t i = 1; i < st->count; i++) {
+        qdr_delivery_t *dlv = st->delivery[i];
+        if (!dlv) {
+            continue;
+        }
+        qd_message_set_send_complete(st->stream[i]);
+        qd_message_cancel_consumer_activation(st->stream[i]);
+        qdr_delivery_set_context(dlv, 0);
+        qdr_delivery_remote_state_updated(tcp_context->core, dlv, PN_ACCEPTED, true, 0, true); // accepted, settled, ref_given
+        st->delivery[i] = 0;
+        st->stream[i]   = 0;
+        qd_buffer_list_free_buffers(&st->held[i]);
+    }
+    st->stream[0] = 0;
+    qd_buffer_list_free_buffers(&st->held[0]);
 }
 
 
-/**
- * Handle subsequent pushes of the outbound delivery on CSIDE.  This is where delivery completion will be 
- * detected and raw connection write-close will occur.
- */
-static void handle_outbound_delivery_CSIDE(qd_tcp_connection_t *conn, qdr_link_t *link, qdr_delivery_t *delivery, bool settled)
+// A disposition update for a stripe stream
+//
+// @return true if the connection is to be run
+//
+static bool stripes_update_XSIDE_IO(qd_tcp_connection_t *conn, qdr_delivery_t *dlv, uint64_t disp, bool settled)
 {
-    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] handle_outbound_delivery_CSIDE - receive_complete=%s",
-           conn->conn_id, qd_message_receive_complete(conn->outbound_stream) ? "true" : "false");
+    ASSERT_RAW_IO;
+    qd_tcp_stripes_t *st = conn->stripes;
 
-    //
-    // It is not guaranteed that this function will be called on the proper IO thread.  Wake the raw connection for
-    // continued processing in the correct context.
-    //
-    sys_mutex_lock(&conn->activation_lock);
-    if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
-        pn_raw_connection_wake(conn->raw_conn);
+    for (int i = 1; i < TCP_STRIPES_MAX; i++) {
+        if (st->delivery[i] != dlv) {
+            continue;
+        }
+        if (settled || (qd_delivery_state_is_terminal(disp) && disp != PN_ACCEPTED)) {
+            // The peer gave up on the stripe before the end of the flow - this is unrecoverable.
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Stripe %d failed - disposition: %s",
+                   DLV_ARGS(dlv), i, pn_disposition_type_name(disp));
+            if (!!conn->raw_conn) {
+                close_raw_connection(conn, "delivery-failed", "destination unreachable");
+            }
+        }
+        break;
     }
-    sys_mutex_unlock(&conn->activation_lock);
+    return false;
 }
 
 
@@ -1324,41 +3436,16 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
     //
     // Inbound stream (producer-side) processing
     //
-    if (!!conn->inbound_stream && !!conn->raw_conn) {
+    if (!!conn->http1) {
+        if (!!conn->raw_conn && http1_manage_requests_LSIDE_IO(conn)) {
+            return true;
+        }
+    } else if (!!conn->inbound_stream && !!conn->raw_conn) {
         //
         // Produce available read buffers into the inbound stream
         //
         bool read_closed = false;
-        bool was_blocked = window_full(conn);
-        uint64_t octet_count = produce_read_buffers_XSIDE_IO(conn, conn->inbound_stream, &read_closed);
-        conn->inbound_octets += octet_count;
-
-        if (octet_count > 0) {
-            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] %cSIDE Raw read: Produced %"PRIu64" octets into stream", conn->conn_id, conn->listener_side ? 'L' : 'C', octet_count);
-            if (!was_blocked && window_full(conn) && !read_closed) {
-                uint64_t unacked = conn->inbound_octets - conn->window.last_update;
-                conn->window.closed_count += 1;
-                //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_UNACKED, unacked);
-                //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_CLOSURES, conn->window.closed_count);
-                qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP RX window CLOSED: inbound_bytes=%" PRIu64 " unacked=%" PRIu64,
-                       DLV_ARGS(conn->inbound_delivery), conn->inbound_octets, unacked);
-            }
-            if (conn->listener_side) {
-                vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS, conn->inbound_octets);
-            }
-        }
-
-        //
-        // Manage latency measurements
-        //
-        if (!conn->inbound_first_octet && octet_count > 0) {
-            conn->inbound_first_octet = true;
-            if (conn->listener_side) {
-                vflow_latency_start(conn->common.vflow);
-            } else {
-                vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_PROCESS_LATENCY);
-            }
-        }
+        produce_inbound_stream_XSIDE_IO(conn, &read_closed);
 
         //
         // If the raw connection is read-closed and the last produce did not block, settle and complete
@@ -1369,6 +3456,9 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
             qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
                    DLV_FMT " Raw conn read-closed - close inbound delivery, cancel producer activation",
                    DLV_ARGS(conn->inbound_delivery));
+            if (!!conn->stripes && !conn->listener_side) {
+                stripes_end_CSIDE_IO(conn);
+            }
             qd_message_set_receive_complete(conn->inbound_stream);
             qd_message_cancel_producer_activation(conn->inbound_stream);
             qdr_delivery_continue(tcp_context->core, conn->inbound_delivery, false);
@@ -1383,7 +3473,9 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         // Issue read buffers when the client stream is producible and the raw connection has capacity for read buffers
         //
         size_t capacity = pn_raw_connection_read_buffers_capacity(conn->raw_conn);
-        if (qd_message_can_produce_buffers(conn->inbound_stream) && capacity > 0) {
+        const bool can_produce = !!conn->stripes && !conn->listener_side ? stripes_can_produce_CSIDE_IO(conn)
+                                                                         : qd_message_can_produce_buffers(conn->inbound_stream);
+        if (can_produce && capacity > 0) {
             grant_read_buffers_XSIDE_IO(conn, capacity);
         }
     }
@@ -1407,6 +3499,8 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
             conn->window.pending_ack += body_octets;
             if (body_octets > 0) {
                 qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] %cSIDE Raw write: Consumed %"PRIu64" octets from stream (body-field)", conn->conn_id, conn->listener_side ? 'L' : 'C', body_octets);
+                QD_PROBE_TCP_WRITE(conn->conn_id, conn->outbound_link_id,
+                                   conn->outbound_delivery ? conn->outbound_delivery->delivery_id : 0, body_octets);
             }
         }
 
@@ -1414,11 +3508,14 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         // Consume available write buffers from the outbound stream
         //
         if (conn->outbound_body_complete) {
-            uint64_t octets = consume_write_buffers_XSIDE_IO(conn, conn->outbound_stream);
+            uint64_t octets = !!conn->stripes ? stripes_consume_LSIDE_IO(conn)
+                                              : consume_write_buffers_XSIDE_IO(conn, conn->outbound_stream);
             conn->outbound_octets += octets;
             conn->window.pending_ack += octets;
             if (octets > 0) {
                 qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] %cSIDE Raw write: Consumed %"PRIu64" octets from stream", conn->conn_id, conn->listener_side ? 'L' : 'C', octets);
+                QD_PROBE_TCP_WRITE(conn->conn_id, conn->outbound_link_id,
+                                   conn->outbound_delivery ? conn->outbound_delivery->delivery_id : 0, octets);
                 if (conn->listener_side) {
                     vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_REVERSE, conn->outbound_octets);
                 }
@@ -1429,12 +3526,7 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         // Manage latency measurements
         //
         if (!conn->outbound_first_octet && conn->outbound_octets > 0) {
-            conn->outbound_first_octet = true;
-            if (conn->listener_side) {
-                vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_LATENCY);
-            } else {
-                vflow_latency_start(conn->common.vflow);
-            }
+            first_outbound_octet_XSIDE_IO(conn);
         }
 
         //
@@ -1442,10 +3534,18 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         // Note that this is not done if there are stream buffers yet to consume.  Wait until all of the
         // payload has been consumed and written before write-closing the connection.
         //
-        if (qd_message_receive_complete(conn->outbound_stream) && !qd_message_can_consume_buffers(conn->outbound_stream)) {
-            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Rx-complete, rings empty: Write-closing the raw connection, consumer activation cancelled",
-                   DLV_ARGS(conn->outbound_delivery));
-            pn_raw_connection_write_close(conn->raw_conn);
+        const bool complete = !!conn->stripes ? conn->stripes->ended
+                                              : qd_message_receive_complete(conn->outbound_stream)
+                                                && !qd_message_can_consume_buffers(conn->outbound_stream);
+        if (complete) {
+            if (!!conn->stripes) {
+                stripes_end_LSIDE_IO(conn);
+            }
+            if (!conn->http1) {
+                qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Rx-complete, rings empty: Write-closing the raw connection, consumer activation cancelled",
+                       DLV_ARGS(conn->outbound_delivery));
+                pn_raw_connection_write_close(conn->raw_conn);
+            }
             qd_message_set_send_complete(conn->outbound_stream);
             qd_message_cancel_consumer_activation(conn->outbound_stream);
             qdr_delivery_set_context(conn->outbound_delivery, 0);
@@ -1453,20 +3553,22 @@ static bool manage_flow_XSIDE_IO(qd_tcp_connection_t *conn)
             // do NOT decref outbound_delivery - ref count passed to qdr_delivery_remote_state_updated()!
             conn->outbound_delivery = 0;
             conn->outbound_stream   = 0;
+            if (!!conn->http1) {
+                http1_response_done_LSIDE_IO(conn);
+                return true;
+            }
         } else {
             //
             // More to send. Check if enough octets have been written to open up the window
             //
-            if (conn->window.pending_ack >= TCP_ACK_THRESHOLD_BYTES) {
-                qd_delivery_state_t *dstate = qd_delivery_state();
-                dstate->section_number = 0;
-                dstate->section_offset = conn->outbound_octets;
-                qdr_delivery_remote_state_updated(tcp_context->core, conn->outbound_delivery, PN_RECEIVED,
-                                                  false, dstate, false);  // received, !settled, !ref_given
+            if (conn->window.pending_ack >= TCP_ACK_THRESHOLD_BYTES && !conn->window.local_path) {
+                const uint64_t offset = outbound_stream_octets(conn);
+                qdr_delivery_remote_received_updated(tcp_context->core, conn->outbound_delivery, 0, offset);
                 qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
                        DLV_FMT " PN_RECEIVED sent with section_offset=%" PRIu64 " pending=%" PRIu64,
-                       DLV_ARGS(conn->outbound_delivery), conn->outbound_octets, conn->window.pending_ack);
+                       DLV_ARGS(conn->outbound_delivery), offset, conn->window.pending_ack);
                 conn->window.pending_ack = 0;
+                window_local_path(conn, conn->outbound_stream);
             }
         }
     }
@@ -1489,7 +3591,7 @@ static int64_t tls_consume_data_buffers(void *context, qd_buffer_list_t *buffers
         return octets;
 
     if (!conn->outbound_body_complete) {
-        copy_message_body_TLS_XSIDE_IO(conn, conn->outbound_stream, buffers, limit);
+        take_message_body_XSIDE_IO(conn, conn->outbound_stream, buffers, limit);
         assert(limit >= DEQ_SIZE(*buffers));
         limit -= DEQ_SIZE(*buffers);
     }
@@ -1523,27 +3625,19 @@ static int64_t tls_consume_data_buffers(void *context, qd_buffer_list_t *buffers
         // Manage latency measurements
         //
         if (!conn->outbound_first_octet) {
-            conn->outbound_first_octet = true;
-            if (conn->listener_side) {
-                vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_LATENCY);
-            } else {
-                vflow_latency_start(conn->common.vflow);
-            }
+            first_outbound_octet_XSIDE_IO(conn);
         }
 
         //
         // Check if enough octets have been written to open up the window
         //
-        if (conn->window.pending_ack >= TCP_ACK_THRESHOLD_BYTES) {
-            qd_delivery_state_t *dstate = qd_delivery_state();
-            dstate->section_number = 0;
-            dstate->section_offset = conn->outbound_octets;
-            qdr_delivery_remote_state_updated(tcp_context->core, conn->outbound_delivery, PN_RECEIVED,
-                                              false, dstate, false);  // received, !settled, !ref_given
+        if (conn->window.pending_ack >= TCP_ACK_THRESHOLD_BYTES && !conn->window.local_path) {
+            qdr_delivery_remote_received_updated(tcp_context->core, conn->outbound_delivery, 0, conn->outbound_octets);
             qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
                    DLV_FMT " sending PN_RECEIVED with section_offset=%" PRIu64 " pending=%" PRIu64,
                    DLV_ARGS(conn->outbound_delivery), conn->outbound_octets, conn->window.pending_ack);
             conn->window.pending_ack = 0;
+            window_local_path(conn, conn->outbound_stream);
         }
     } else if (qd_message_receive_complete(conn->outbound_stream) && !qd_message_can_consume_buffers(conn->outbound_stream)) {
         //
@@ -1589,9 +3683,11 @@ static bool manage_tls_flow_XSIDE_IO(qd_tcp_connection_t *conn)
                                                  &decrypted_octets, LOG_TCP_ADAPTOR, conn->conn_id);
 
     //
-    // Process inbound cleartext data.
+    // Process inbound cleartext data.  The read depth follows the cleartext rate: the TLS record overhead is small
+    // next to the data.
     //
 
+    read_rate_update_XSIDE_IO(conn, decrypted_octets);
     if (decrypted_octets) {
         more_work = true;
         conn->inbound_octets += decrypted_octets;
@@ -1608,11 +3704,11 @@ static bool manage_tls_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         qd_message_produce_buffers(conn->inbound_stream, &decrypted_buffers);
 
         qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] %cSIDE TLS read: Produced %"PRIu64" octets into stream", conn->conn_id, conn->listener_side ? 'L' : 'C', decrypted_octets);
-        if (!window_blocked && window_full(conn)) {
+        window_bytes_read(conn);
+        if (!window_blocked && window_full(conn) && !window_local_path(conn, conn->inbound_stream)) {
             //uint64_t unacked = conn->inbound_octets - conn->window.last_update;
-            conn->window.closed_count += 1;
+            window_closed(conn);
             //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_UNACKED, unacked);
-            //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_CLOSURES, conn->window.closed_count);
             qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " TCP RX window CLOSED: inbound_bytes=%" PRIu64 " unacked=%" PRIu64,
                    DLV_ARGS(conn->inbound_delivery), conn->inbound_octets,
                    (conn->inbound_octets - conn->window.last_update));
@@ -1622,12 +3718,7 @@ static bool manage_tls_flow_XSIDE_IO(qd_tcp_connection_t *conn)
         // Manage latency measurements
         //
         if (!conn->inbound_first_octet) {
-            conn->inbound_first_octet = true;
-            if (conn->listener_side) {
-                vflow_latency_start(conn->common.vflow);
-            } else {
-                vflow_latency_end(conn->common.vflow, VFLOW_ATTRIBUTE_PROCESS_LATENCY);
-            }
+            first_inbound_octet_XSIDE_IO(conn);
         }
     }
 
@@ -1696,6 +3787,7 @@ static void connection_run_LSIDE_IO(qd_tcp_connection_t *conn)
                 } else {
                     link_setup_LSIDE_IO(conn);
                     set_state_XSIDE_IO(conn, LSIDE_LINK_SETUP);
+                    fast_open_read_LSIDE_IO(conn);
                 }
             }
             break;
@@ -1747,6 +3839,8 @@ static void connection_run_LSIDE_IO(qd_tcp_connection_t *conn)
             if (!!conn->outbound_stream) {
                 set_state_XSIDE_IO(conn, (conn->tls_session) ? LSIDE_TLS_FLOW: LSIDE_FLOW);
                 repeat = true;
+            } else {
+                fast_open_read_LSIDE_IO(conn);
             }
             break;
 
@@ -1823,6 +3917,25 @@ static void connection_run_CSIDE_IO(qd_tcp_connection_t *conn)
             }
             break;
 
+        case CSIDE_POOLED: {
+            qd_tcp_connector_t *connector = (qd_tcp_connector_t *) conn->common.parent;
+            sys_mutex_lock(&connector->lock);
+            const bool claimed = !conn->pooled;
+            const bool expired = conn->pool_expired;
+            sys_mutex_unlock(&connector->lock);
+
+            if (claimed) {
+                // The vflow record was created when the connection was bound to its flow
+                qd_set_vflow_netaddr_string(conn->common.vflow, conn->raw_conn, conn->listener_side);
+                set_state_XSIDE_IO(conn, CSIDE_INITIAL);
+                repeat = true;
+            } else if (expired) {
+                close_raw_connection(conn, "Pool-expired", "Idle pooled connection closed");
+                set_state_XSIDE_IO(conn, XSIDE_CLOSING);  // prevent further connection I/O
+            }
+            break;
+        }
+
         case CSIDE_LINK_SETUP:
             credit = conn->inbound_credit;
 
@@ -1944,6 +4057,9 @@ static void on_tls_connection_secured(qd_tls_session_t *tls_session, void *user_
     if (conn->listener_side) {
         assert(!conn->alpn_protocol);
         conn->alpn_protocol = qd_tls_session_get_alpn_protocol(conn->tls_session);
+        if (conn->alpn_protocol && conn->observer_handle) {
+            qdpo_set_alpn(conn->observer_handle, conn->alpn_protocol);
+        }
     }
 }
 
@@ -2008,12 +4124,53 @@ static int setup_tls_session(qd_tcp_connection_t *conn, qd_tls_config_t *parent_
 //=================================================================================
 // Handlers for events from the Raw Connections
 //=================================================================================
+//
+// Connection setup deferred from on_accept().  All accepts of a listener are serialized in the listener's context, so
+// on_accept() only does what the listener must: this part runs on the first event of the new connection, in parallel
+// with the setup of other connections.
+//
+static void connection_setup_LSIDE_IO(qd_tcp_connection_t *conn)
+{
+    ASSERT_RAW_IO;
+    qd_tcp_listener_t *listener = (qd_tcp_listener_t *) conn->common.parent;
+    bool has_protocol_observer  = false;
+
+    conn->setup_done   = true;
+    conn->common.vflow = vflow_start_sampled_record(VFLOW_RECORD_BIFLOW_TPORT, listener->common.vflow, &listener->flow_sampler);
+    if (listener->http1_requests) {
+        conn->http1 = http1_state(conn);
+    } else if (listener->stripes > 1 && listener->lane_count == 0 && !listener->tls_config) {
+        conn->stripes = stripes_state();
+    }
+    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS, 0);
+    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_REVERSE, 0);
+    window_init(conn);
+
+    sys_mutex_lock(&listener->lock);
+    _setup_protocol_observer_LH(listener);
+    if (listener->protocol_observer) {
+        has_protocol_observer = true;
+        conn->observer_handle = qdpo_begin(listener->protocol_observer, conn->common.vflow, conn, conn->conn_id);
+    }
+    sys_mutex_unlock(&listener->lock);
+
+    if (!has_protocol_observer) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] connection setup, no protocol observer for this connection", conn->conn_id);
+    }
+}
+
+
 static void on_connection_event_LSIDE_IO(pn_event_t *e, qd_server_t *qd_server, void *context)
 {
     SET_THREAD_RAW_IO;
     pn_event_type_t       etype = pn_event_type(e);
     qd_tcp_connection_t *conn  = (qd_tcp_connection_t*) context;
     qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] on_connection_event_LSIDE_IO: %s", conn->conn_id, pn_event_type_name(etype));
+    start_cpu_time_XSIDE_IO(conn);
+
+    if (!conn->setup_done && conn->common.parent) {
+        connection_setup_LSIDE_IO(conn);
+    }
 
     if (etype == PN_RAW_CONNECTION_CONNECTED) {
         // it is safe to call pn_raw_connection_wake() now
@@ -2027,11 +4184,14 @@ static void on_connection_event_LSIDE_IO(pn_event_t *e, qd_server_t *qd_server,
         return;
     }
 
-    if (CLEAR_ATOMIC_FLAG(&conn->core_activation) && !!conn->core_conn) {
+    if (!!conn->lane) {
+        lane_take_update_LSIDE_IO(conn);
+    } else if (!!conn->core_conn && qdr_connection_activation_pending(conn->core_conn)) {
         qdr_connection_process(conn->core_conn);
     }
 
     connection_run_LSIDE_IO(conn);
+    charge_cpu_time_XSIDE_IO(conn);
 }
 
 
@@ -2041,8 +4201,20 @@ static void on_connection_event_CSIDE_IO(pn_event_t *e, qd_server_t *qd_server,
     pn_event_type_t       etype = pn_event_type(e);
     qd_tcp_connection_t *conn  = (qd_tcp_connection_t*) context;
     qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] on_connection_event_CSIDE_IO: %s", conn->conn_id, pn_event_type_name(etype));
+    start_cpu_time_XSIDE_IO(conn);
 
     if (etype == PN_RAW_CONNECTION_CONNECTED) {
+        qd_tcp_connector_t *connector = (qd_tcp_connector_t *) conn->common.parent;
+        sys_mutex_lock(&connector->lock);
+        const uint64_t connect_usec = MAX(now_usec() - conn->connect_start, 1);
+        connector->connects++;
+        connector->connect_usec += connect_usec;
+        conn->connect_usec       = connect_usec;
+        // A pooled connection has no flow record yet, bind_outbound_delivery_CSIDE_LH sets it
+        vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_CONNECT_LATENCY, connect_usec);
+        sys_mutex_unlock(&connector->lock);
+        qd_flow_histogram_record(QD_PROTOCOL_TCP, QD_FLOW_HIST_CONNECT, connect_usec);
+
         // it is safe to call pn_raw_connection_wake() now
         qd_set_vflow_netaddr_string(conn->common.vflow, conn->raw_conn, conn->listener_side);
         assert(!IS_ATOMIC_FLAG_SET(&conn->raw_opened));
@@ -2050,21 +4222,35 @@ static void on_connection_event_CSIDE_IO(pn_event_t *e, qd_server_t *qd_server,
     } else if (etype == PN_RAW_CONNECTION_DISCONNECTED) {
         conn->error = !!conn->raw_conn ? pn_raw_connection_condition(conn->raw_conn) : 0;
         vflow_set_pn_condition_string(conn->common.vflow, VFLOW_ATTRIBUTE_ERROR_CONNECTOR_SIDE, conn->error);
+        if (!!conn->common.parent && !IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
+            // The connect failed, try another address of the host next time
+            qd_dns_entry_connect_failed(((qd_tcp_connector_t *) conn->common.parent)->dns_entry);
+        }
         close_connection_XSIDE_IO(conn);
         return;
     }
 
-    if (CLEAR_ATOMIC_FLAG(&conn->core_activation) && !!conn->core_conn) {
+    if (!!conn->core_conn && qdr_connection_activation_pending(conn->core_conn)) {
         qdr_connection_process(conn->core_conn);
     }
 
     connection_run_CSIDE_IO(conn);
+    charge_cpu_time_XSIDE_IO(conn);
 }
 
 
 static void on_accept(qd_adaptor_listener_t *adaptor_listener, pn_listener_t *pn_listener, void *context)
 {
     qd_tcp_listener_t *listener      = (qd_tcp_listener_t*) context;
+
+    if (qdr_core_overloaded(tcp_context->core)) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING, "Connection refused on listener %s: router overloaded",
+               listener->adaptor_config->name);
+        qdr_core_overload_refused(tcp_context->core, QDR_OVERLOAD_REFUSED_CONNECTION);
+        qd_adaptor_listener_deny_conn(adaptor_listener, pn_listener);
+        return;
+    }
+
     qd_tcp_connection_t *conn  = new_qd_tcp_connection_t();
 
     ZERO(conn);
@@ -2077,39 +4263,26 @@ static void on_accept(qd_adaptor_listener_t *adaptor_listener, pn_listener_t *pn
     qd_tcp_listener_incref(listener);
 
     sys_mutex_init(&conn->activation_lock);
-    sys_atomic_init(&conn->core_activation, 0);
     sys_atomic_init(&conn->raw_opened, 0);
 
     conn->listener_side = true;
     conn->state         = LSIDE_INITIAL;
-
-    conn->common.vflow = vflow_start_record(VFLOW_RECORD_BIFLOW_TPORT, listener->common.vflow);
-    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS, 0);
-    vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_REVERSE, 0);
-    //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_WINDOW_SIZE, TCP_MAX_CAPACITY_BYTES);
+    conn->flow_start    = now_usec();
 
     conn->context.context = conn;
     conn->context.handler = on_connection_event_LSIDE_IO;
+    conn->rate_limits     = qd_policy_rate_limits(qd_dispatch_get_policy(tcp_context->qd), 0, 0, true, false);
 
     conn->raw_conn = pn_raw_connection();
     pn_raw_connection_set_context(conn->raw_conn, &conn->context);
-    bool has_protocol_observer = false;
 
     sys_mutex_lock(&listener->lock);
-    _setup_protocol_observer_LH(listener);
-    if (listener->protocol_observer) {
-        has_protocol_observer = true;
-        conn->observer_handle = qdpo_begin(listener->protocol_observer, conn->common.vflow, conn, conn->conn_id);
-    }
     DEQ_INSERT_TAIL(listener->connections, conn);
     listener->connections_opened++;
     vflow_set_uint64(listener->common.vflow, VFLOW_ATTRIBUTE_FLOW_COUNT_L4, listener->connections_opened);
     sys_mutex_unlock(&listener->lock);
 
-    if (!has_protocol_observer) {
-        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%"PRIu64"] on_accept, no protocol observer setup for this connection", conn->conn_id);
-    }
-
+    // The rest of the connection setup is done by connection_setup_LSIDE_IO() in the context of the new connection.
     // Note: this will trigger the connection's event handler on another thread:
     pn_listener_raw_accept(pn_listener, conn->raw_conn);
 }
@@ -2128,6 +4301,10 @@ static void CORE_activate(void *context, qdr_connection_t *core_conn)
         assert(false);  // listeners are never activated, relies on adaptor_listener callback
         break;
 
+    case TL_ORPHAN:
+        assert(false);  // only ever the context of a delivery
+        break;
+
     case TL_CONNECTOR: {
         qd_tcp_connector_t *connector = (qd_tcp_connector_t *) common;
         sys_mutex_lock(&connector->lock);
@@ -2137,11 +4314,24 @@ static void CORE_activate(void *context, qdr_connection_t *core_conn)
         break;
     }
 
+    case TL_LANE: {
+        qd_tcp_lane_t *lane = (qd_tcp_lane_t *) common;
+        sys_mutex_lock(&lane->activation_lock);
+        if (lane->activate_timer)
+            qd_timer_schedule(lane->activate_timer, 0);
+        sys_mutex_unlock(&lane->activation_lock);
+        break;
+    }
+
     case TL_CONNECTION:
         conn = (qd_tcp_connection_t*) common;
+        //
+        // The core coalesces activations (see qdr_protocol_adaptor_coalesce_activations), so this is only reached
+        // once per qdr_connection_process() call. If the raw connection is not yet open the pending activation is
+        // picked up by the CONNECTED event.
+        //
         sys_mutex_lock(&conn->activation_lock);
         if (IS_ATOMIC_FLAG_SET(&conn->raw_opened)) {
-            SET_ATOMIC_FLAG(&conn->core_activation);
             pn_raw_connection_wake(conn->raw_conn);
         }
         sys_mutex_unlock(&conn->activation_lock);
@@ -2186,12 +4376,22 @@ static void CORE_second_attach(void           *context,
             conn->reply_to = (char*) qd_iterator_copy(qdr_terminus_get_address(source));
             connection_run_XSIDE_IO(conn);
         }
+    } else if (common->context_type == TL_LANE) {
+        qd_tcp_lane_t *lane = (qd_tcp_lane_t*) common;
+        if (link == lane->outbound_link) {
+            lane_outbound_attached_LH(lane, source);
+        }
     }
 }
 
 
 static void CORE_detach(void *context, qdr_link_t *link, qdr_error_t *error, bool first)
 {
+    qd_tcp_common_t *common = (qd_tcp_common_t*) qdr_link_get_context(link);
+
+    if (!!common && common->context_type == TL_LANE && first) {
+        lane_link_detached_LH((qd_tcp_lane_t*) common, link);
+    }
 }
 
 
@@ -2239,9 +4439,17 @@ static uint64_t CORE_deliver_outbound(void *context, qdr_link_t *link, qdr_deliv
 
     if (common->context_type == TL_CONNECTOR) {
         return handle_first_outbound_delivery_CSIDE((qd_tcp_connector_t*) common, link, delivery);
+    } else if (common->context_type == TL_ORPHAN) {
+        // more of the server stream of a closed flow of a shared connection: dropped until its settlement lands
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Server stream of a closed flow ignored", DLV_ARGS(delivery));
+    } else if (common->context_type == TL_LANE) {
+        return lane_outbound_delivery_LH((qd_tcp_lane_t*) common, link, delivery);
     } else if (common->context_type == TL_CONNECTION) {
         qd_tcp_connection_t *conn = (qd_tcp_connection_t*) common;
-        if (conn->listener_side) {
+        if (!!conn->lane) {
+            // more of the server stream of a flow of a shared connection, on the lane's I/O thread
+            lane_wake_flow_LH(conn);
+        } else if (conn->listener_side) {
             return handle_outbound_delivery_LSIDE_IO(conn, link, delivery);
         } else {
             handle_outbound_delivery_CSIDE(conn, link, delivery, settled);
@@ -2262,66 +4470,54 @@ static int CORE_get_credit(void *context, qdr_link_t *link)
 
 static void CORE_delivery_update(void *context, qdr_delivery_t *dlv, uint64_t disp, bool settled)
 {
-    bool              need_wake = false;
     qd_tcp_common_t *common = (qd_tcp_common_t*) qdr_delivery_get_context(dlv);
     if (!!common && common->context_type == TL_CONNECTION && disp != 0) {
-        qd_tcp_connection_t *conn = (qd_tcp_connection_t*) common;
+        qd_tcp_connection_t *conn            = (qd_tcp_connection_t*) common;
+        const bool           inbound         = dlv == conn->inbound_delivery;
+        uint64_t             received_offset = 0;
+
+        if (inbound && disp == PN_RECEIVED) {
+            //
+            // The egress adaptor for TCP flow has sent us its count of sent bytes
+            //
+            uint64_t ignore;
+            qd_delivery_state_t  received;
+            qd_delivery_state_free(qdr_delivery_take_local_delivery_state(dlv, &ignore, &received));
+            received_offset = received.section_offset;
+            if (received_offset > 0 && !!conn->http1) {
+                // the offset counts the octets of the current request's stream
+                received_offset += conn->http1->stream_base;
+            }
+        }
+
+        if (!!conn->lane) {
+            //
+            // On the lane's I/O thread: hand the update over to the flow's, see "Shared Core Connections"
+            //
+            qd_tcp_lane_update_t *update = &conn->lane_update;
+            if (inbound) {
+                if (!qd_delivery_state_is_terminal(update->inbound_disposition))
+                    update->inbound_disposition = disp;
+                update->received_offset = MAX(update->received_offset, received_offset);
+                update->inbound_settled = update->inbound_settled || settled;
+            } else {
+                update->outbound_disposition = disp;
+            }
+            lane_wake_flow_LH(conn);
+            return;
+        }
 
+        bool need_wake = false;
         if (dlv == conn->outbound_delivery) {
             qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Outbound delivery update - disposition: %s", DLV_ARGS(dlv), pn_disposition_type_name(disp));
             conn->outbound_disposition = disp;
             need_wake = true;
-        } else if (dlv == conn->inbound_delivery) {
-            qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, DLV_FMT " Inbound delivery update - disposition: %s", DLV_ARGS(dlv), pn_disposition_type_name(disp));
-            conn->inbound_disposition = disp;
-            const bool final_outcome = qd_delivery_state_is_terminal(disp);
-            if (final_outcome && disp != PN_ACCEPTED) {
-                // The delivery failed - this is unrecoverable.
-                if (!!conn->raw_conn) {
-                    close_raw_connection(conn, "delivery-failed", "destination unreachable");
-                    // clean stuff up when DISCONNECT event arrives
-                }
-            } else {
-                //
-                // handle flow control window updates
-                //
-                const bool window_was_full = window_full(conn);
-                if (disp == PN_RECEIVED) {
-                    //
-                    // The egress adaptor for TCP flow has sent us its count of sent bytes
-                    //
-                    uint64_t ignore;
-                    qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(dlv, &ignore);
-
-                    // Resend released will generate a PN_RECEIVED with section_offset == 0, ignore it.  Ensure updates
-                    // arrive in order, which may not happen if cut-through for disposition updates is implemented.
-                    if (dstate && dstate->section_offset > 0
-                        && (int64_t)(dstate->section_offset - conn->window.last_update) > 0) {
-
-                        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
-                               DLV_FMT " PN_RECEIVED inbound_bytes=%" PRIu64 ", was_unacked=%" PRIu64 ", rcv_offset=%" PRIu64 " now_unacked=%" PRIu64,
-                               DLV_ARGS(dlv), conn->inbound_octets,
-                               (conn->inbound_octets - conn->window.last_update),
-                               dstate->section_offset,
-                               (conn->inbound_octets - dstate->section_offset));
-                        conn->window.last_update = dstate->section_offset;
-                        //vflow_set_uint64(conn->common.vflow, VFLOW_ATTRIBUTE_OCTETS_UNACKED, conn->inbound_octets - dstate->section_offset);
-
-                        qd_delivery_state_free(dstate);
-                    }
-                }
-                // the window needs to be disabled when the remote settles or sets the final outcome because once that
-                // occurs the remote will no longer send PN_RECEIVED updates necessary to open the window.
-                conn->window.disabled = conn->window.disabled || settled || final_outcome;
-                if (window_was_full && !window_full(conn)) {
-                    qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
-                           DLV_FMT " TCP RX window %s: inbound_bytes=%" PRIu64 " unacked=%" PRIu64,
-                           DLV_ARGS(dlv),
-                           conn->window.disabled ? "DISABLED" : "OPENED",
-                           conn->inbound_octets, (conn->inbound_octets - conn->window.last_update));
-                }
-            }
-            need_wake = !window_full(conn);
+        } else if (inbound) {
+            need_wake = inbound_delivery_update_XSIDE_IO(conn, disp, settled, received_offset);
+        } else if (!!conn->http1) {
+            need_wake = http1_request_update_XSIDE_IO(conn, dlv, disp, settled);
+        } else if (!!conn->stripes) {
+            need_wake = stripes_update_XSIDE_IO(conn, dlv, disp, settled);
         }
 
         if (need_wake) {
@@ -2334,6 +4530,11 @@ static void CORE_delivery_update(void *context, qdr_delivery_t *dlv, uint64_t di
 static void CORE_connection_close(void *context, qdr_connection_t *conn, qdr_error_t *error)
 {
     qd_tcp_common_t *common = (qd_tcp_common_t*) qdr_connection_get_context(conn);
+    if (!!common && common->context_type == TL_LANE) {
+        // Called from qdr_connection_process() on the lane's I/O thread
+        lane_core_conn_closed_LH((qd_tcp_lane_t*) common);
+        return;
+    }
     qd_tcp_connection_t *tcp_conn = (qd_tcp_connection_t*) common;
     if (tcp_conn) {
         qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG,
@@ -2378,6 +4579,27 @@ QD_EXPORT void *qd_dispatch_configure_tcp_listener(qd_dispatch_t *qd, qd_entity_
         return 0;
     }
 
+    listener->fast_open  = qd_entity_opt_bool(entity, "fastOpen", false);
+    long shared_conns    = qd_entity_opt_long(entity, "sharedConnections", 0);
+    listener->lane_count = (uint32_t) MAX(shared_conns, 0);
+    long stripes         = qd_entity_opt_long(entity, "stripes", 1);
+    listener->stripes    = (uint32_t) MIN(MAX(stripes, 1), TCP_STRIPES_MAX);
+
+    char *balancing = qd_entity_opt_string(entity, "requestBalancing", "none");
+    listener->http1_requests = !!balancing && strcmp(balancing, "http1") == 0;
+    free(balancing);
+    if (listener->http1_requests && (listener->lane_count > 0 || !!listener->adaptor_config->ssl_profile_name)) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_ERROR,
+               "tcpListener %s: requestBalancing http1 cannot be combined with sharedConnections or an sslProfile",
+               listener->adaptor_config->name);
+        qd_free_adaptor_config(listener->adaptor_config);
+        free_qd_tcp_listener_t(listener);
+        return 0;
+    }
+    vflow_sampler_init(&listener->flow_sampler, VFLOW_RECORD_BIFLOW_TPORT,
+                       qd_entity_opt_long(entity, "flowSampleInterval", -1),
+                       qd_entity_opt_long(entity, "flowRecordRateMax", -1));
+
     if (listener->adaptor_config->ssl_profile_name) {
         // On the TCP TLS listener side, send "http/1.1", "http/1.0" and "h2" as ALPN protocols
         listener->tls_config = qd_tls_config(listener->adaptor_config->ssl_profile_name,
@@ -2508,6 +4730,10 @@ QD_EXPORT void qd_dispatch_delete_tcp_connector(qd_dispatch_t *qd, void *impl)
         qdr_connection_notify_closed(connector->core_conn);
         connector->core_conn = 0;
         qd_connection_counter_dec(QD_PROTOCOL_TCP);
+
+        // The idle pooled connections hold connector references, close them regardless of terminate_tcp_conns
+        pool_shutdown(connector);
+
         //
         // Initiate termination of existing connections
         //
@@ -2556,8 +4782,11 @@ QD_EXPORT qd_error_t qd_entity_refresh_tcpListener(qd_entity_t* entity, void *im
 
     if (   qd_entity_set_long(entity, "bytesIn",           0) == 0
         && qd_entity_set_long(entity, "bytesOut",          0) == 0
+        && qd_entity_set_long(entity, "rawWrites",         qd_sharded_counter_value(&li->raw_writes.writes)) == 0
+        && qd_entity_set_long(entity, "rawWriteOctets",    qd_sharded_counter_value(&li->raw_writes.octets)) == 0
         && qd_entity_set_long(entity, "connectionsOpened", co) == 0
         && qd_entity_set_long(entity, "connectionsClosed", cc) == 0
+        && qd_entity_set_long(entity, "flowsUnrecorded",   sys_atomic_get(&li->flow_sampler.unrecorded)) == 0
         && qd_entity_set_string(entity, "operStatus", os == QD_LISTENER_OPER_UP ? "up" : "down") == 0)
     {
         return QD_ERROR_NONE;
@@ -2600,11 +4829,38 @@ qd_tcp_connector_t *qd_dispatch_configure_tcp_connector(qd_dispatch_t *qd, qd_en
         }
     }
 
+    long pool_min_idle = qd_entity_opt_long(entity, "poolMinIdle", 0);
+    long pool_max_idle = qd_entity_opt_long(entity, "poolMaxIdle", 0);
+    long pool_max_age  = qd_entity_opt_long(entity, "poolMaxAge", 60);
+    if (qd_error_code() || pool_min_idle < 0 || pool_max_idle < 0 || pool_max_age <= 0) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_ERROR, "tcpConnector %s invalid connection pool configuration",
+               connector->adaptor_config->name);
+        qd_tls_config_decref(connector->tls_config);
+        qd_free_adaptor_config(connector->adaptor_config);
+        free(connector->process_ref);
+        free_qd_tcp_connector_t(connector);
+        return 0;
+    }
+
+    long stripes              = qd_entity_opt_long(entity, "stripes", 1);
+    connector->stripes        = (uint32_t) MIN(MAX(stripes, 1), TCP_STRIPES_MAX);
+    connector->dns_entry      = qd_dns_entry(connector->adaptor_config->host, connector->adaptor_config->port);
     connector->activate_timer = qd_timer(tcp_context->qd, on_core_activate_TIMER_IO, connector);
     connector->common.context_type = TL_CONNECTOR;
     sys_mutex_init(&connector->lock);
     sys_atomic_init(&connector->closing, 0);
 
+    if (pool_min_idle > 0) {
+        connector->pool_min_idle = pool_min_idle;
+        connector->pool_max_idle = MAX(pool_min_idle, pool_max_idle);
+        connector->pool_max_age  = (uint64_t) pool_max_age * 1000000;
+        connector->pool_target   = connector->pool_min_idle;
+        connector->pool_timer    = qd_timer(tcp_context->qd, on_pool_timer_TIMER_IO, connector);
+        qd_timer_schedule(connector->pool_timer, 0);
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "TcpConnector %s connection pool: minIdle=%ld maxIdle=%"PRIu64" maxAge=%lds",
+               connector->adaptor_config->name, pool_min_idle, connector->pool_max_idle, pool_max_age);
+    }
+
 
     qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO,
             "Configured TcpConnector for %s, %s:%s",
@@ -2623,14 +4879,24 @@ QD_EXPORT qd_error_t qd_entity_refresh_tcpConnector(qd_entity_t* entity, void *i
     SET_THREAD_UNKNOWN;
     qd_tcp_connector_t *cr = (qd_tcp_connector_t*) impl;
     sys_mutex_lock(&cr->lock);
-    uint64_t co = cr->connections_opened;
-    uint64_t cc = cr->connections_closed;
+    uint64_t co     = cr->connections_opened;
+    uint64_t cc     = cr->connections_closed;
+    uint64_t idle   = DEQ_SIZE(cr->pool);
+    uint64_t hits   = cr->pool_hits;
+    uint64_t misses = cr->pool_misses;
+    uint64_t cl     = cr->connects ? cr->connect_usec / cr->connects : 0;
     sys_mutex_unlock(&cr->lock);
 
     if (   qd_entity_set_long(entity, "bytesIn",           0) == 0
         && qd_entity_set_long(entity, "bytesOut",          0) == 0
+        && qd_entity_set_long(entity, "rawWrites",         qd_sharded_counter_value(&cr->raw_writes.writes)) == 0
+        && qd_entity_set_long(entity, "rawWriteOctets",    qd_sharded_counter_value(&cr->raw_writes.octets)) == 0
         && qd_entity_set_long(entity, "connectionsOpened", co) == 0
-        && qd_entity_set_long(entity, "connectionsClosed", cc) == 0)
+        && qd_entity_set_long(entity, "connectionsClosed", cc) == 0
+        && qd_entity_set_long(entity, "poolIdle",          idle) == 0
+        && qd_entity_set_long(entity, "poolHits",          hits) == 0
+        && qd_entity_set_long(entity, "poolMisses",        misses) == 0
+        && qd_entity_set_long(entity, "connectLatency",    cl) == 0)
     {
         return QD_ERROR_NONE;
     }
@@ -2651,6 +4917,7 @@ static void ADAPTOR_init(qdr_core_t *core, void **adaptor_context)
     tcp_context->core   = core;
     tcp_context->qd     = qdr_core_dispatch(core);
     tcp_context->server = tcp_context->qd->server;
+    tcp_context->idle_usec = (uint64_t) tcp_context->qd->idle_connection_seconds * 1000000;
     tcp_context->pa     = qdr_protocol_adaptor(core, "tcp", (void*) tcp_context,
                                                    CORE_activate,
                                                    CORE_first_attach,
@@ -2666,8 +4933,12 @@ static void ADAPTOR_init(qdr_core_t *core, void **adaptor_context)
                                                    CORE_delivery_update,
                                                    CORE_connection_close,
                                                    CORE_connection_trace);
+    qdr_protocol_adaptor_coalesce_activations(tcp_context->pa);
     sys_mutex_init(&tcp_context->lock);
     tcp_context->proactor = qd_server_proactor(tcp_context->server);
+    qdpo_async_start(tcp_context->qd->observer_threads, (size_t) tcp_context->qd->observer_queue_octets);
+    qdpo_set_cpu_budget(tcp_context->qd->observer_cpu_budget);
+    qd_dns_cache_initialize();
 
     //
     // Determine the configured buffer memory ceiling.
@@ -2734,9 +5005,16 @@ static void ADAPTOR_final(void *adaptor_context)
             close_connection_XSIDE_IO(conn);
             conn = next_conn;
         }
+        while (DEQ_HEAD(connector->pool)) {
+            close_connection_XSIDE_IO(DEQ_HEAD(connector->pool));  // removes it from the pool
+        }
         qd_tcp_connector_free(connector);
     }
 
+    // Finish observing the closed connections
+    qdpo_async_stop();
+    qd_dns_cache_finalize();
+
     qdr_protocol_adaptor_free(tcp_context->core, tcp_context->pa);
     sys_mutex_free(&tcp_context->lock);
     free(tcp_context);
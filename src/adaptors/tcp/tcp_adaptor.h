@@ -23,19 +23,29 @@
 #include "delivery.h"
 #include "adaptors/adaptor_common.h"
 #include "adaptors/adaptor_listener.h"
+#include "adaptors/dns_cache.h"
+#include <qpid/dispatch/hash.h>
 #include <qpid/dispatch/protocol_observer.h>
+#include <qpid/dispatch/sharded_counter.h>
+#include <qpid/dispatch/vanflow.h>
+
+#include <stdatomic.h>
 
 
 typedef struct qd_tcp_common_t     qd_tcp_common_t;
 typedef struct qd_tcp_listener_t   qd_tcp_listener_t;
 typedef struct qd_tcp_connector_t  qd_tcp_connector_t;
 typedef struct qd_tcp_connection_t qd_tcp_connection_t;
+typedef struct qd_tcp_lane_t       qd_tcp_lane_t;
+typedef struct qd_tcp_http1_t      qd_tcp_http1_t;
+typedef struct qd_tcp_stripes_t    qd_tcp_stripes_t;
 typedef struct qd_tls_config_t     qd_tls_config_t;
 typedef struct qd_tls_session_t    qd_tls_session_t;
 
 ALLOC_DECLARE(qd_tcp_listener_t);
 ALLOC_DECLARE(qd_tcp_connector_t);
 ALLOC_DECLARE_SAFE(qd_tcp_connection_t);
+ALLOC_DECLARE(qd_tcp_lane_t);
 
 DEQ_DECLARE(qd_tcp_listener_t,   qd_tcp_listener_list_t);
 DEQ_DECLARE(qd_tcp_connector_t,  qd_tcp_connector_list_t);
@@ -47,7 +57,9 @@ extern const char *qdr_tcp_connection_columns[QDR_TCP_CONNECTION_COLUMN_COUNT +
 typedef enum {
     TL_LISTENER,
     TL_CONNECTOR,
-    TL_CONNECTION
+    TL_CONNECTION,
+    TL_LANE,
+    TL_ORPHAN       // the server stream of a flow that left its lane, see lane_detach_flow_XSIDE_IO()
 } qd_tcp_context_type_t;
 
 struct qd_tcp_common_t {
@@ -56,6 +68,13 @@ struct qd_tcp_common_t {
     vflow_record_t        *vflow;
 };
 
+// Plaintext writes of all the connections of a listener or connector, updated from the connections' I/O threads
+//
+typedef struct qd_tcp_write_counters_t {
+    qd_sharded_counter_t  writes;  // buffers given to the raw connections for writing
+    qd_sharded_counter_t  octets;  // octets in those buffers
+} qd_tcp_write_counters_t;
+
 struct qd_tcp_listener_t {
     qd_tcp_common_t           common;
     DEQ_LINKS(qd_tcp_listener_t);
@@ -69,6 +88,35 @@ struct qd_tcp_listener_t {
     uint64_t                   connections_closed;
     sys_atomic_t               ref_count;
     sys_atomic_t               closing;
+    qd_tcp_write_counters_t    raw_writes;
+    bool                       fast_open;  // carry the client's first octets in the initial stream delivery
+    vflow_sampler_t            flow_sampler;  // which connections get a BIFLOW_TPORT record
+    qd_tcp_lane_t            **lanes;         // sharedConnections core connections, 0 if every flow has its own
+    uint32_t                   lane_count;
+    atomic_uint                next_lane;
+    atomic_bool                lanes_usable;  // a connector side router answered the SHARED_KEY offer of a flow
+    bool                       http1_requests;  // requestBalancing http1: route each HTTP/1 request on its own
+    uint32_t                   stripes;         // accept the server data of a flow striped across this many streams
+};
+
+
+// A core connection of a tcpListener with sharedConnections, carrying the streams of many flows.  See "Shared Core
+// Connections" in tcp_adaptor.c.
+//
+struct qd_tcp_lane_t {
+    qd_tcp_common_t            common;           // parent is the listener
+    sys_mutex_t                lock;             // held while the core connection is processed
+    sys_mutex_t                activation_lock;
+    qd_timer_t                *activate_timer;
+    qdr_connection_t          *core_conn;
+    uint64_t                   conn_id;
+    qdr_link_t                *inbound_link;     // carries the client streams of the lane's flows
+    uint64_t                   inbound_link_id;
+    qdr_link_t                *outbound_link;    // its dynamic source is the reply-to of the lane's flows
+    uint64_t                   outbound_link_id;
+    char                      *reply_to;         // 0 until the outbound link is attached
+    qd_tcp_connection_list_t   flows;            // the flows on the lane, those waiting for reply_to are lane_waiting
+    qd_hash_t                 *awaiting;         // flows waiting for their server stream, by flow tag
 };
 
 
@@ -79,6 +127,7 @@ typedef struct qd_tcp_connector_t {
     qd_timer_t                *activate_timer;
     qd_adaptor_config_t       *adaptor_config;
     qd_tls_config_t           *tls_config;
+    qd_dns_entry_t            *dns_entry;  // resolved addresses of adaptor_config->host
     qdr_connection_t          *core_conn;  // dispatcher conn and link
     char                      *process_ref;  // VanFlow Process ID
     uint64_t                   conn_id;
@@ -87,6 +136,18 @@ typedef struct qd_tcp_connector_t {
     qd_tcp_connection_list_t  connections;
     uint64_t                   connections_opened;
     uint64_t                   connections_closed;
+    qd_timer_t                *pool_timer;     // 0 if the connection pool is disabled
+    qd_tcp_connection_list_t   pool;           // idle pre-established backend connections, oldest first
+    uint64_t                   pool_min_idle;
+    uint64_t                   pool_max_idle;
+    uint64_t                   pool_max_age;   // usec
+    uint64_t                   pool_target;    // idle connections to keep, between pool_min_idle and pool_max_idle
+    uint64_t                   pool_hits;
+    uint64_t                   pool_misses;
+    uint64_t                   connects;       // backend connections established
+    uint64_t                   connect_usec;   // total connect latency of the established backend connections
+    uint32_t                   stripes;        // stripe the server data of a flow across up to this many streams
+    qd_tcp_write_counters_t    raw_writes;
     sys_atomic_t               ref_count;
     sys_atomic_t               closing;
 } qd_tcp_connector_t;
@@ -103,6 +164,7 @@ typedef enum {
     LSIDE_TLS_FLOW,      // in/out deliveries and msg active; doing TLS I/O
 
     CSIDE_INITIAL,       // raw connection initiated, out delivery/msg available
+    CSIDE_POOLED,        // raw connection initiated or idle in the connector pool, no out delivery/msg yet
     CSIDE_LINK_SETUP,    // raw conn/TLS opened, QDR conn and links attaching, waiting for inbound credit from core
     CSIDE_FLOW,          // in/out deliveries and msg active; doing I/O
     CSIDE_TLS_FLOW,      // in/out deliveries and msg active; doing TLS I/O
@@ -111,6 +173,19 @@ typedef enum {
 ENUM_DECLARE(qd_tcp_connection_state);
 
 
+// Core connection events of a flow on a lane, for the flow's I/O thread
+//
+typedef struct qd_tcp_lane_update_t {
+    qdr_delivery_t *outbound_delivery;     // the server stream, with a reference for the flow
+    uint64_t        outbound_disposition;
+    uint64_t        inbound_disposition;
+    uint64_t        received_offset;       // largest PN_RECEIVED section offset
+    bool            inbound_settled;
+    bool            closed;                // the core connection or the reply-to the flow started on is gone
+    bool            pending;
+} qd_tcp_lane_update_t;
+
+
 //
 // Important note about the polarity of the link/stream/delivery/disposition tuples:
 //
@@ -124,9 +199,9 @@ ENUM_DECLARE(qd_tcp_connection_state);
 typedef struct qd_tcp_connection_t {
     qd_tcp_common_t            common;
     DEQ_LINKS(qd_tcp_connection_t);
+    DEQ_LINKS_N(LANE, qd_tcp_connection_t);  // LSIDE: on lane->flows
     pn_raw_connection_t        *raw_conn;
     sys_mutex_t                 activation_lock;
-    sys_atomic_t                core_activation;
     sys_atomic_t                raw_opened;
     qdr_connection_t           *core_conn;
     uint64_t                    conn_id;
@@ -142,25 +217,56 @@ typedef struct qd_tcp_connection_t {
     uint64_t                    outbound_link_id;
     uint64_t                    inbound_octets;
     uint64_t                    outbound_octets;
-    qd_buffer_t                *outbound_body;
     pn_condition_t             *error;
     char                       *reply_to;
+    char                       *flow_tag;      // LSIDE: the flow's key in lane->awaiting.  CSIDE: the peer's, echoed
+    qd_tcp_lane_t              *lane;          // LSIDE: the shared core connection of the flow, 0 if it has its own
+    qd_tcp_http1_t             *http1;         // LSIDE: the requests of a requestBalancing http1 flow, else 0
+    qd_tcp_stripes_t           *stripes;       // the server data streams of a striped flow, else 0
+    qd_hash_handle_t           *awaiting_handle;
     qd_tls_session_t           *tls_session;   // tls session if configured for TLS
     char                       *alpn_protocol; // negotiated by TLS else 0
     qd_handler_context_t        context;
     qd_tcp_connection_state_t  state;
     qdpo_transport_handle_t    *observer_handle;
+    uint64_t                    connect_start;  // CSIDE: time in usec the raw connection was initiated
+    uint64_t                    connect_usec;   // CSIDE: time in usec the raw connection took to connect, 0 until connected
+    uint64_t                    flow_start;     // time in usec the flow started, 0 while CSIDE is pooled
+    uint64_t                    first_octet_time;  // LSIDE: time in usec the client's first octet was read
+    qd_policy_rate_limits_t    *rate_limits;     // router-wide policy rate limits, 0 if there are none
+    qd_timer_t                 *throttle_timer;  // wakes the connection to grant read buffers once within the limits
     struct {
         uint64_t                last_update;  // ingress: last byte count value received in PN_RECEIVED
         uint64_t                pending_ack;  // egress: bytes sent since last PN_RECEIVED generated
         uint64_t                closed_count; // ingress: total count of window closures
+        uint64_t                max_size;     // ingress: current window limit, adapted to the bandwidth-delay product
+        uint64_t                srtt;         // ingress: smoothed PN_RECEIVED round-trip in usec, 0 until measured
+        uint64_t                min_rtt;      // ingress: smallest PN_RECEIVED round-trip in usec, 0 until measured
+        uint64_t                probe_offset; // ingress: inbound byte count being timed, 0 if no probe is in flight
+        uint64_t                probe_time;   // ingress: time in usec the inbound byte count reached probe_offset
+        uint64_t                ack_time;     // ingress: time in usec of the last PN_RECEIVED update
+        bool                    limited;      // ingress: the window closed since the last PN_RECEIVED update
         bool                    disabled;     // window flow control disabled, no backpressure allowed
+        bool                    local_path;   // the peer of the flow is a connection of this router
     } window;
+    struct {
+        uint64_t                rate;          // smoothed read throughput in octets/sec
+        uint64_t                sample_start;  // time in usec the current throughput sample started, 0 if none
+        uint64_t                sample_octets; // octets read in the current throughput sample
+        size_t                  depth;         // read buffers to keep granted to the raw connection, 0 until first grant
+        uint64_t                last_read;     // time in usec octets were last read, 0 before the first read
+    } reads;
     bool                        listener_side;
     bool                        inbound_credit;
     bool                        inbound_first_octet;
     bool                        outbound_first_octet;
     bool                        outbound_body_complete;
+    bool                        bulk_reads;  // The last read filled its buffer; read into large buffers
+    bool                        pooled;        // CSIDE: on connector->pool, not yet claimed by a flow
+    bool                        pool_expired;  // CSIDE: pooled connection aged out and is to be closed
+    bool                        setup_done;    // LSIDE: connection_setup_LSIDE_IO has run
+    bool                        lane_waiting;  // LSIDE: waiting for the lane's reply_to
+    qd_tcp_lane_update_t        lane_update;   // LSIDE: handed over by the lane's I/O thread under lane->lock
 } qd_tcp_connection_t;
 
 
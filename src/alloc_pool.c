@@ -29,24 +29,29 @@
 #include "qd_asan_interface.h"
 
 #include "qpid/dispatch/alloc.h"
+#include "qpid/dispatch/atomic.h"
 #include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/internal/symbolization.h"
 #include "qpid/dispatch/log.h"
 #include "qpid/dispatch/platform.h"
 #include "qpid/dispatch/timer.h"
 
 #include "proton/version.h"
 
+#include <execinfo.h>
 #include <inttypes.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include <memory.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 
 #ifdef QD_MEMORY_DEBUG
 #include "log_private.h"
-
-#include "qpid/dispatch/internal/symbolization.h"
-
-#include <execinfo.h>
 #endif
 
 const char *QD_ALLOCATOR_TYPE = "allocator";
@@ -54,13 +59,21 @@ const char *QD_ALLOCATOR_TYPE = "allocator";
 typedef struct qd_alloc_item_t          qd_alloc_item_t;
 typedef struct qd_alloc_chunk_t         qd_alloc_chunk_t;
 typedef struct qd_alloc_linked_stack_t  qd_alloc_linked_stack_t;
+typedef struct qd_alloc_slab_t          qd_alloc_slab_t;
+typedef struct qd_alloc_sample_t        qd_alloc_sample_t;
 
 #define PATTERN_FRONT 0xdeadbeef
 #define PATTERN_BACK  0xbabecafe
 #define STACK_DEPTH   10
 
 struct qd_alloc_item_t {
-    uintmax_t             sequence;  // uintmax_t ensures proper alignment of following data
+    uintmax_t             sequence;    // uintmax_t ensures proper alignment of following data
+    qd_alloc_pool_t      *owner;       // thread pool the item was last allocated from
+    union {
+        qd_alloc_item_t   *inbox_next;  // free: link while queued on the owner's remote-free inbox
+        qd_alloc_sample_t *sample;      // allocated: profiler record, 0 if the allocation was not sampled
+    };
+    qd_alloc_slab_t      *slab;        // slab the item was carved from, 0 if allocated individually
 #ifdef QD_MEMORY_DEBUG
     qd_alloc_type_desc_t *desc;
     DEQ_LINKS(qd_alloc_item_t);
@@ -75,6 +88,38 @@ struct qd_alloc_item_t {
 DEQ_DECLARE(qd_alloc_item_t, qd_alloc_item_list_t);
 #endif
 
+// A slab is a single allocation carved into item_count items.  Its memory goes back to the OS once every item has
+// been released from the pools (see release_item_LH).
+struct qd_alloc_slab_t {
+    DEQ_LINKS(qd_alloc_slab_t);
+    size_t   size;
+    uint32_t item_count;
+    uint32_t released;
+    bool     mmapped;
+};
+
+DEQ_DECLARE(qd_alloc_slab_t, qd_alloc_slab_list_t);
+
+// Allocation profiler sample: the call stack of a live sampled allocation
+struct qd_alloc_sample_t {
+    DEQ_LINKS(qd_alloc_sample_t);
+    void *stack[STACK_DEPTH];
+    int   depth;
+};
+
+DEQ_DECLARE(qd_alloc_sample_t, qd_alloc_sample_list_t);
+
+// record_sample() itself is at the top of each sampled stack
+#define SAMPLE_SKIP_FRAMES 1
+
+// Every profile_rate-th allocation made by a thread is sampled, 0 disables the profiler.  The countdown is per thread
+// so the unsampled path only touches thread-local state.
+static atomic_uint_fast32_t profile_rate;
+static __thread uint32_t    profile_countdown;
+
+// slab header size, keeps the first item cache aligned
+#define SLAB_HEADER_SIZE ((sizeof(qd_alloc_slab_t) + 63) & ~((size_t) 63))
+
 // Leak Suppressions
 // A list of items that are known to leak.
 //
@@ -91,7 +136,7 @@ static const char *leaking_types[] = {
     // system_tests_edge_router (centos7)
     // DISPATCH-1699
 
-    "qd_message_t", "qd_message_content_t", "qdr_delivery_t",
+    "qd_message_t", "qd_message_arena_t", "qdr_delivery_t",
     "qd_delivery_state_t",  // DISPATCH-2082: See comments in JIRA
     "qd_link_ref_t",
 
@@ -246,8 +291,286 @@ static inline int unordered_move_stack(qd_alloc_linked_stack_t *from, qd_alloc_l
 struct qd_alloc_pool_t {
     DEQ_LINKS(qd_alloc_pool_t);
     qd_alloc_linked_stack_t free_list;
+    int                     node;  // NUMA node of the owning thread (global pools: the node they serve)
+    qd_alloc_type_desc_t   *desc;
+    qd_alloc_pool_t        *thread_next;  // next pool created by the same thread, see retire_thread_pools()
+
+    // Remote-free inbox: items allocated from this pool but freed by another thread are pushed here (lock-free,
+    // multiple producers) instead of accumulating on the freeing thread's list. The owning thread takes the whole
+    // inbox in one exchange when its local free list runs dry.
+    _Atomic(qd_alloc_item_t *) inbox;
+    atomic_uint_fast32_t       inbox_size;
+    atomic_uint_fast64_t       remote_frees_reclaimed;  // written by the owning thread only
+    atomic_bool                dead;                    // the owning thread has exited, the inbox takes no items
 };
 
+// NUMA nodes served by the global pools, at most QD_ALLOC_MAX_NODES
+static int numa_nodes = 1;
+
+static inline int current_node(void)
+{
+    const int node = qd_platform_numa_node();
+    return node < numa_nodes ? node : 0;
+}
+
+static void init_pool(qd_alloc_pool_t *pool, qd_alloc_type_desc_t *desc, int node)
+{
+    DEQ_ITEM_INIT(pool);
+    pool->node        = node;
+    pool->desc        = desc;
+    pool->thread_next = 0;
+    init_stack(&pool->free_list);
+    atomic_init(&pool->inbox, (qd_alloc_item_t *) 0);
+    atomic_init(&pool->inbox_size, 0);
+    atomic_init(&pool->remote_frees_reclaimed, 0);
+    atomic_init(&pool->dead, false);
+}
+
+//
+// Move every item on a dead pool's inbox to the global pool of its node.  Safe against concurrent pushes: a pusher that
+// loses the race with the exchange finds the pool dead and calls this again.
+//
+static void retire_inbox_LH(qd_alloc_type_desc_t *desc, qd_alloc_pool_t *pool)
+{
+    qd_alloc_item_t *item  = atomic_exchange(&pool->inbox, (qd_alloc_item_t *) 0);
+    uint32_t         count = 0;
+    while (item) {
+        qd_alloc_item_t *next = item->inbox_next;
+        push_stack(&desc->global_pools[pool->node].free_list, item);
+        item = next;
+        count++;
+    }
+    atomic_fetch_sub_explicit(&pool->inbox_size, count, memory_order_relaxed);
+    desc->stats.held_by_threads -= count;
+}
+
+//
+// Queue an item freed by a foreign thread on its owner's inbox.  Returns false if the owner's thread has exited or the
+// inbox is already holding a full local free list worth of items (e.g. the owner has stopped allocating), in which case
+// the caller keeps the item.
+//
+static inline bool push_inbox(qd_alloc_pool_t *owner, qd_alloc_item_t *item, int limit)
+{
+    if (atomic_load(&owner->dead))
+        return false;
+    if (atomic_fetch_add_explicit(&owner->inbox_size, 1, memory_order_relaxed) >= (uint_fast32_t) limit) {
+        atomic_fetch_sub_explicit(&owner->inbox_size, 1, memory_order_relaxed);
+        return false;
+    }
+    item->inbox_next = atomic_load_explicit(&owner->inbox, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&owner->inbox, &item->inbox_next, item, memory_order_seq_cst,
+                                                  memory_order_relaxed))
+        ;
+    //
+    // The owner may have retired its pool between the check above and the push, after taking the inbox for the last
+    // time.  Nobody would ever drain the item, so move it to the global pool.
+    //
+    if (atomic_load(&owner->dead)) {
+        sys_mutex_lock(&owner->desc->lock);
+        retire_inbox_LH(owner->desc, owner);
+        sys_mutex_unlock(&owner->desc->lock);
+    }
+    return true;
+}
+
+//
+// Move every item on the pool's inbox to its local free list.  Must only be called by the thread owning the pool (or
+// at finalize time).  Returns the number of items reclaimed.
+//
+static inline uint32_t drain_inbox(qd_alloc_pool_t *pool)
+{
+    if (atomic_load_explicit(&pool->inbox, memory_order_relaxed) == 0)
+        return 0;
+
+    qd_alloc_item_t *item  = atomic_exchange_explicit(&pool->inbox, (qd_alloc_item_t *) 0, memory_order_acquire);
+    uint32_t         count = 0;
+    while (item) {
+        qd_alloc_item_t *next = item->inbox_next;
+        push_stack(&pool->free_list, item);
+        item = next;
+        count++;
+    }
+    atomic_fetch_sub_explicit(&pool->inbox_size, count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->remote_frees_reclaimed, count, memory_order_relaxed);
+    return count;
+}
+
+static size_t item_stride(const qd_alloc_type_desc_t *desc)
+{
+    size_t size = sizeof(qd_alloc_item_t) + desc->total_size
+#ifdef QD_MEMORY_DEBUG
+                  + sizeof(uint32_t)
+#endif
+        ;
+    return (size + 63) & ~((size_t) 63);
+}
+
+static void *map_slab(size_t size, bool huge_pages, bool *mmapped)
+{
+    void *mem = 0;
+
+    *mmapped = false;
+    if (huge_pages) {
+#ifdef MAP_HUGETLB
+        // explicit huge pages only succeed if the administrator has reserved some
+        mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED)
+#endif
+        {
+            mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (mem != MAP_FAILED)
+                (void) madvise(mem, size, MADV_HUGEPAGE);
+#endif
+        }
+        if (mem == MAP_FAILED)
+            return 0;
+        *mmapped = true;
+        return mem;
+    }
+
+    ALLOC_CACHE_ALIGNED(size, mem);
+    return mem;
+}
+
+static void free_slab(qd_alloc_slab_t *slab)
+{
+    if (slab->mmapped)
+        munmap(slab, slab->size);
+    else
+        FREE_CACHE_ALIGNED(slab);
+}
+
+//
+// Refill the thread pool from a new slab.  The first transfer batch goes to the thread pool, the remaining items go
+// to the global pool.
+//
+static void refill_from_slab_LH(qd_alloc_type_desc_t *desc, qd_alloc_pool_t *pool)
+{
+    const size_t stride = item_stride(desc);
+    const int    batch  = desc->config->transfer_batch_size;
+    size_t       size   = MAX(desc->config->slab_size, SLAB_HEADER_SIZE + batch * stride);
+    if (desc->config->huge_pages)
+        size = (size + QD_ALLOC_HUGE_PAGE_SIZE - 1) & ~((size_t) QD_ALLOC_HUGE_PAGE_SIZE - 1);
+
+    bool             mmapped;
+    qd_alloc_slab_t *slab = (qd_alloc_slab_t *) map_slab(size, desc->config->huge_pages, &mmapped);
+    if (slab == 0)
+        abort();
+    DEQ_ITEM_INIT(slab);
+    slab->size       = size;
+    slab->item_count = (size - SLAB_HEADER_SIZE) / stride;
+    slab->released   = 0;
+    slab->mmapped    = mmapped;
+    DEQ_INSERT_TAIL(*(qd_alloc_slab_list_t *) desc->slabs, slab);
+
+    for (uint32_t idx = 0; idx < slab->item_count; idx++) {
+        qd_alloc_item_t *item = (qd_alloc_item_t *) ((char *) slab + SLAB_HEADER_SIZE + idx * stride);
+#ifdef QD_MEMORY_DEBUG
+        DEQ_ITEM_INIT(item);
+#endif
+        item->sequence = 0;
+        item->owner    = 0;
+        item->slab     = slab;
+        push_stack(idx < batch ? &pool->free_list : &desc->global_pools[pool->node].free_list, item);
+        ASAN_POISON_MEMORY_REGION(&item[1], desc->total_size);
+    }
+    desc->stats.held_by_threads += batch;
+    desc->stats.total_alloc_from_heap += slab->item_count;
+}
+
+//
+// Return an item that has been removed from all pools to the heap.  Slab items are only accounted for, the slab
+// itself is released with its last item.
+//
+static void release_item_LH(qd_alloc_type_desc_t *desc, qd_alloc_item_t *item)
+{
+    qd_alloc_slab_t *slab = item->slab;
+    if (!slab) {
+        FREE_CACHE_ALIGNED(item);
+        return;
+    }
+    if (++slab->released == slab->item_count) {
+        DEQ_REMOVE(*(qd_alloc_slab_list_t *) desc->slabs, slab);
+        free_slab(slab);
+    }
+}
+
+__attribute__((noinline)) static void record_sample(qd_alloc_type_desc_t *desc, qd_alloc_item_t *item)
+{
+    qd_alloc_sample_t *sample = NEW(qd_alloc_sample_t);
+    DEQ_ITEM_INIT(sample);
+    sample->depth = backtrace(sample->stack, STACK_DEPTH);
+    item->sample  = sample;
+
+    sys_mutex_lock(&desc->lock);
+    DEQ_INSERT_TAIL(*(qd_alloc_sample_list_t *) desc->samples, sample);
+    sys_mutex_unlock(&desc->lock);
+}
+
+static inline void profile_alloc(qd_alloc_type_desc_t *desc, qd_alloc_item_t *item)
+{
+    item->sample = 0;
+    const uint32_t rate = atomic_load_explicit(&profile_rate, memory_order_relaxed);
+    if (rate && ++profile_countdown >= rate) {
+        profile_countdown = 0;
+        record_sample(desc, item);
+    }
+}
+
+static inline void profile_free(qd_alloc_type_desc_t *desc, qd_alloc_item_t *item)
+{
+    qd_alloc_sample_t *sample = item->sample;
+    if (sample) {
+        item->sample = 0;
+        sys_mutex_lock(&desc->lock);
+        DEQ_REMOVE(*(qd_alloc_sample_list_t *) desc->samples, sample);
+        sys_mutex_unlock(&desc->lock);
+        free(sample);
+    }
+}
+
+// Items on the global free lists of all NUMA nodes
+static inline uint64_t global_size_LH(const qd_alloc_type_desc_t *desc)
+{
+    uint64_t size = 0;
+    for (int node = 0; node < numa_nodes; ++node)
+        size += DEQ_SIZE(desc->global_pools[node].free_list);
+    return size;
+}
+
+//
+// Global pool to rebalance a batch from: the caller's node if it holds a full batch, otherwise the first node that
+// does.  Zero if no node holds a full batch.
+//
+static inline qd_alloc_pool_t *find_global_batch_LH(qd_alloc_type_desc_t *desc, int node)
+{
+    const uint64_t batch = desc->config->transfer_batch_size;
+    if (DEQ_SIZE(desc->global_pools[node].free_list) >= batch)
+        return &desc->global_pools[node];
+    for (int other = 0; other < numa_nodes; ++other) {
+        if (DEQ_SIZE(desc->global_pools[other].free_list) >= batch)
+            return &desc->global_pools[other];
+    }
+    return 0;
+}
+
+//
+// Take an item from the global free lists, preferring the given node (-1: the largest list).  The caller ensures
+// the lists are not all empty.
+//
+static inline qd_alloc_item_t *pop_global_LH(qd_alloc_type_desc_t *desc, int node)
+{
+    if (node < 0 || DEQ_SIZE(desc->global_pools[node].free_list) == 0) {
+        node = 0;
+        for (int other = 1; other < numa_nodes; ++other) {
+            if (DEQ_SIZE(desc->global_pools[other].free_list) > DEQ_SIZE(desc->global_pools[node].free_list))
+                node = other;
+        }
+    }
+    return pop_stack(&desc->global_pools[node].free_list);
+}
+
 const qd_alloc_config_t qd_alloc_default_config_big   = {16, 32, -1};
 const qd_alloc_config_t qd_alloc_default_config_small = {64, 128, -1};
 const qd_alloc_config_t qd_alloc_default_config_asan  = {1, 0, 0};
@@ -263,6 +586,63 @@ static char *debug_dump = 0;
 static atomic_bool alloc_pool_ready;
 #endif
 
+//
+// If there's a global_free_list size limit, release items from the global pools until the limit is not exceeded.  The
+// limit applies to the sum of all NUMA nodes.
+//
+static void limit_global_LH(qd_alloc_type_desc_t *desc, int node)
+{
+    if (desc->config->global_free_list_max == -1)
+        return;
+    uint64_t global_size = global_size_LH(desc);
+    while (global_size > desc->config->global_free_list_max) {
+        qd_alloc_item_t *item = pop_global_LH(desc, node);
+        release_item_LH(desc, item);
+        desc->stats.total_free_to_heap++;
+        global_size--;
+    }
+}
+
+//
+// Thread pools are retired when their thread exits.  The key holds the head of the exiting thread's pool list (linked
+// through thread_next), its destructor runs on thread exit.  The main thread never runs it, its pools are reclaimed by
+// qd_alloc_finalize().
+//
+static pthread_key_t thread_pools_key;
+
+static void retire_thread_pools(void *head)
+{
+    for (qd_alloc_pool_t *pool = (qd_alloc_pool_t *) head; pool; pool = pool->thread_next) {
+        qd_alloc_type_desc_t *desc = pool->desc;
+
+        // from here on foreign frees take the global path, see push_inbox()
+        atomic_store(&pool->dead, true);
+
+        sys_mutex_lock(&desc->lock);
+        retire_inbox_LH(desc, pool);
+        const int moved = unordered_move_stack(&pool->free_list, &desc->global_pools[pool->node].free_list,
+                                               DEQ_SIZE(pool->free_list));
+        desc->stats.held_by_threads -= moved;
+        limit_global_LH(desc, pool->node);
+        sys_mutex_unlock(&desc->lock);
+
+        // the pool itself stays on tpool_list until qd_alloc_finalize(): items it allocated still point at it
+    }
+}
+
+static qd_alloc_pool_t *new_thread_pool(qd_alloc_type_desc_t *desc)
+{
+    qd_alloc_pool_t *pool;
+    NEW_CACHE_ALIGNED(qd_alloc_pool_t, pool);
+    init_pool(pool, desc, current_node());
+    pool->thread_next = (qd_alloc_pool_t *) pthread_getspecific(thread_pools_key);
+    pthread_setspecific(thread_pools_key, pool);
+    sys_mutex_lock(&desc->lock);
+    DEQ_INSERT_TAIL(desc->tpool_list, pool);
+    sys_mutex_unlock(&desc->lock);
+    return pool;
+}
+
 /* coverity[+alloc] */
 void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
 {
@@ -277,14 +657,8 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
     // If this is the thread's first pass through here, allocate the
     // thread-local pool for this type.
     //
-    if (*tpool == 0) {
-        NEW_CACHE_ALIGNED(qd_alloc_pool_t, *tpool);
-        DEQ_ITEM_INIT(*tpool);
-        init_stack(&(*tpool)->free_list);
-        sys_mutex_lock(&desc->lock);
-        DEQ_INSERT_TAIL(desc->tpool_list, *tpool);
-        sys_mutex_unlock(&desc->lock);
-    }
+    if (*tpool == 0)
+        *tpool = new_thread_pool(desc);
 
     qd_alloc_pool_t *pool = *tpool;
 
@@ -294,7 +668,10 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
     // there is no need to acquire a lock.
     //
     qd_alloc_item_t *item = pop_stack(&pool->free_list);
+    if (!item && drain_inbox(pool))
+        item = pop_stack(&pool->free_list);
     if (item) {
+        item->owner = pool;
         ASAN_UNPOISON_MEMORY_REGION(&item[1], desc->total_size);
 #ifdef QD_MEMORY_DEBUG
         item->desc   = desc;
@@ -309,23 +686,33 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
         memcpy((char*) &item[1] + desc->total_size, &pb, sizeof(pb));
         QD_MEMORY_FILL(&item[1], QD_MEMORY_INIT, desc->total_size);
 #endif
+        profile_alloc(desc, item);
         return &item[1];
     }
 
     //
-    // The local free list is empty, we need to either rebalance a batch
-    // of items from the global list or go to the heap to get new memory.
+    // The local free list and the remote-free inbox are empty, we need to
+    // either rebalance a batch of items from the global list or go to the
+    // heap to get new memory.
     //
     sys_mutex_lock(&desc->lock);
-    if (DEQ_SIZE(desc->global_pool->free_list) >= desc->config->transfer_batch_size) {
+    qd_alloc_pool_t *global = find_global_batch_LH(desc, pool->node);
+    if (global) {
         //
         // Rebalance a full batch from the global free list to the thread list.
         //
-        const int moved = unordered_move_stack(&desc->global_pool->free_list, &pool->free_list,
+        const int moved = unordered_move_stack(&global->free_list, &pool->free_list,
                                                desc->config->transfer_batch_size);
         assert(moved == desc->config->transfer_batch_size);
         desc->stats.batches_rebalanced_to_threads++;
         desc->stats.held_by_threads += moved;
+        if (global->node != pool->node)
+            desc->stats.batches_rebalanced_from_remote_node++;
+        const uint64_t global_size = global_size_LH(desc);
+        if (global_size < desc->global_low_water)
+            desc->global_low_water = global_size;
+    } else if (desc->config->slab_size) {
+        refill_from_slab_LH(desc, pool);
     } else {
         //
         // Allocate a full batch from the heap and put it on the thread list.
@@ -348,6 +735,8 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
 #endif
             push_stack(&pool->free_list, item);
             item->sequence = 0;
+            item->owner    = 0;
+            item->slab     = 0;
             ASAN_POISON_MEMORY_REGION(&item[1], desc->total_size);
         }
         desc->stats.held_by_threads += desc->config->transfer_batch_size;
@@ -357,6 +746,7 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
 
     item = pop_stack(&pool->free_list);
     if (item) {
+        item->owner = pool;
         ASAN_UNPOISON_MEMORY_REGION(&item[1], desc->total_size);
 #ifdef QD_MEMORY_DEBUG
         item->desc = desc;
@@ -371,6 +761,7 @@ void *qd_alloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool)
         memcpy((char*) &item[1] + desc->total_size, &pb, sizeof(pb));
         QD_MEMORY_FILL(&item[1], QD_MEMORY_INIT, desc->total_size);
 #endif
+        profile_alloc(desc, item);
         return &item[1];
     }
 
@@ -404,18 +795,25 @@ void qd_dealloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool, char *p)
     // If this is the thread's first pass through here, allocate the
     // thread-local pool for this type.
     //
-    if (*tpool == 0) {
-        NEW_CACHE_ALIGNED(qd_alloc_pool_t, *tpool);
-        DEQ_ITEM_INIT(*tpool);
-        init_stack(&(*tpool)->free_list);
-        sys_mutex_lock(&desc->lock);
-        DEQ_INSERT_TAIL(desc->tpool_list, *tpool);
-        sys_mutex_unlock(&desc->lock);
-    }
+    if (*tpool == 0)
+        *tpool = new_thread_pool(desc);
 
     qd_alloc_pool_t *pool = *tpool;
 
     item->sequence++;
+    profile_free(desc, item);
+
+    //
+    // If the item came from another thread's pool hand it back to its owner
+    // rather than keeping it here. Otherwise a thread that only frees (the
+    // consumer side of a producer/consumer pair) would keep rebalancing
+    // batches to the global list under the lock while the producer keeps
+    // fetching them back.
+    //
+    if (item->owner && item->owner != pool && desc->config->local_free_list_max > 0
+        && push_inbox(item->owner, item, desc->config->local_free_list_max))
+        return;
+
     push_stack(&pool->free_list, item);
 
     if (DEQ_SIZE(pool->free_list) < desc->config->local_free_list_max)
@@ -426,22 +824,12 @@ void qd_dealloc(qd_alloc_type_desc_t *desc, qd_alloc_pool_t **tpool, char *p)
     // rebalanced back to the global list.
     //
     sys_mutex_lock(&desc->lock);
-    const int moved = unordered_move_stack(&pool->free_list, &desc->global_pool->free_list,
+    const int moved = unordered_move_stack(&pool->free_list, &desc->global_pools[pool->node].free_list,
                                            desc->config->transfer_batch_size);
     assert(moved == desc->config->transfer_batch_size);
     desc->stats.batches_rebalanced_to_global++;
     desc->stats.held_by_threads -= moved;
-    //
-    // If there's a global_free_list size limit, remove items until the limit is
-    // not exceeded.
-    //
-    if (desc->config->global_free_list_max != -1) {
-        while (DEQ_SIZE(desc->global_pool->free_list) > desc->config->global_free_list_max) {
-            item = pop_stack(&desc->global_pool->free_list);
-            FREE_CACHE_ALIGNED(item);
-            desc->stats.total_free_to_heap++;
-        }
-    }
+    limit_global_LH(desc, pool->node);
 
     sys_mutex_unlock(&desc->lock);
 }
@@ -464,8 +852,28 @@ uint32_t qd_alloc_sequence(void *p)
     return item->sequence;
 }
 
+#if defined(QD_DISABLE_MEMORY_POOL)
+ATTRIBUTE_NO_SANITIZE_ADDRESS
+#endif
+void qd_alloc_sequence_bump(void *p)
+{
+    if (!p)
+        return;
+
+    qd_alloc_item_t *item = ((qd_alloc_item_t*) p) - 1;
+#ifdef QD_MEMORY_DEBUG
+    assert(item->header == PATTERN_FRONT);
+#endif
+    item->sequence++;
+}
+
 void qd_alloc_initialize(void)
 {
+    numa_nodes = MIN(MAX(qd_platform_numa_node_count(), 1), QD_ALLOC_MAX_NODES);
+    int rc = pthread_key_create(&thread_pools_key, retire_thread_pools);
+    (void) rc;
+    assert(rc == 0);
+
     for (qd_alloc_type_desc_t *desc = DEQ_HEAD(desc_list); desc; desc = DEQ_NEXT(desc)) {
         // Compute the size of the type. This is done after all the desc have been created since the value of the
         // additional_size attribute may be initialized prior to calling qd_alloc_initialize()
@@ -484,12 +892,21 @@ void qd_alloc_initialize(void)
         assert(desc->config->local_free_list_max >= desc->config->transfer_batch_size);
 #endif
 
-        desc->global_pool = NEW(qd_alloc_pool_t);
-        DEQ_ITEM_INIT(desc->global_pool);
-        init_stack(&desc->global_pool->free_list);
-        sys_mutex_init(&desc->lock);
+        desc->global_pools = NEW_ARRAY(qd_alloc_pool_t, numa_nodes);
+        for (int node = 0; node < numa_nodes; ++node)
+            init_pool(&desc->global_pools[node], desc, node);
+        sys_mutex_init_named(&desc->lock, "alloc_pool");
         DEQ_INIT(desc->tpool_list);
         memset(&desc->stats, 0, sizeof(desc->stats));
+        desc->global_low_water = UINT64_MAX;  // no trim sample taken yet
+
+        qd_alloc_slab_list_t *slabs = NEW(qd_alloc_slab_list_t);
+        DEQ_INIT(*slabs);
+        desc->slabs = (void *) slabs;
+
+        qd_alloc_sample_list_t *samples = NEW(qd_alloc_sample_list_t);
+        DEQ_INIT(*samples);
+        desc->samples = (void *) samples;
 
 #ifdef QD_MEMORY_DEBUG
         // maintain a list of allocated items for leak checking during
@@ -535,6 +952,9 @@ void qd_alloc_finalize(void)
     //       concerned about locking.
     //
 
+    // the pools are freed below, threads exiting later must not retire them
+    pthread_key_delete(thread_pools_key);
+
 #ifdef QD_MEMORY_DEBUG
     alloc_pool_ready      = false;
     const char *last_leak = 0;
@@ -558,24 +978,27 @@ void qd_alloc_finalize(void)
         //
         // Reclaim the items on the global free pool
         //
-        qd_alloc_item_t *item = pop_stack(&desc->global_pool->free_list);
-        while (item) {
-            FREE_CACHE_ALIGNED(item);
-            desc->stats.total_free_to_heap++;
-            item = pop_stack(&desc->global_pool->free_list);
+        qd_alloc_item_t *item;
+        for (int node = 0; node < numa_nodes; ++node) {
+            qd_alloc_pool_t *global = &desc->global_pools[node];
+            while ((item = pop_stack(&global->free_list))) {
+                release_item_LH(desc, item);
+                desc->stats.total_free_to_heap++;
+            }
+            free_stack_chunks(&global->free_list);
         }
-        free_stack_chunks(&desc->global_pool->free_list);
-        free(desc->global_pool);
-        desc->global_pool = 0;
+        free(desc->global_pools);
+        desc->global_pools = 0;
 
         //
         // Reclaim the items on thread pools
         //
         qd_alloc_pool_t *tpool = DEQ_HEAD(desc->tpool_list);
         while (tpool) {
+            drain_inbox(tpool);
             item = pop_stack(&tpool->free_list);
             while (item) {
-                FREE_CACHE_ALIGNED(item);
+                release_item_LH(desc, item);
                 desc->stats.total_free_to_heap++;
                 item = pop_stack(&tpool->free_list);
             }
@@ -628,18 +1051,44 @@ void qd_alloc_finalize(void)
                 // Since this is a custom heap ASAN will dump the first
                 // malloc() of the object - not the last time it was allocated
                 // from the pool.
-                FREE_CACHE_ALIGNED(item);
+                release_item_LH(desc, item);
                 item = DEQ_HEAD(*items);
             }
 #endif
         }
 
+        //
+        // Slabs still holding leaked items
+        //
+        qd_alloc_slab_list_t *slabs = (qd_alloc_slab_list_t *) desc->slabs;
+        qd_alloc_slab_t      *slab  = DEQ_HEAD(*slabs);
+        while (slab) {
+            DEQ_REMOVE_HEAD(*slabs);
+            free_slab(slab);
+            slab = DEQ_HEAD(*slabs);
+        }
+
+        //
+        // Profiler samples of items that were never freed
+        //
+        qd_alloc_sample_list_t *samples = (qd_alloc_sample_list_t *) desc->samples;
+        qd_alloc_sample_t      *sample  = DEQ_HEAD(*samples);
+        while (sample) {
+            DEQ_REMOVE_HEAD(*samples);
+            free(sample);
+            sample = DEQ_HEAD(*samples);
+        }
+
         //
         // Reclaim the descriptor components
         //
         sys_mutex_free(&desc->lock);
         free(desc->debug);
         desc->debug = 0;
+        free(desc->slabs);
+        desc->slabs = 0;
+        free(desc->samples);
+        desc->samples = 0;
     }
 
     if (debug_dump) {
@@ -658,10 +1107,114 @@ void qd_alloc_finalize(void)
 }
 
 
+// Sum of the items returned to their owning thread via the remote-free inboxes
+static uint64_t remote_frees_reclaimed_LH(const qd_alloc_type_desc_t *desc)
+{
+    uint64_t total = 0;
+    for (qd_alloc_pool_t *tpool = DEQ_HEAD(desc->tpool_list); tpool; tpool = DEQ_NEXT(tpool))
+        total += atomic_load_explicit(&tpool->remote_frees_reclaimed, memory_order_relaxed);
+    return total;
+}
+
+void qd_alloc_set_profile_rate(uint32_t rate)
+{
+    atomic_store_explicit(&profile_rate, rate, memory_order_relaxed);
+}
+
+typedef struct {
+    const qd_alloc_sample_t *sample;
+    uint64_t                 count;
+} sample_group_t;
+
+static int compare_stacks(const void *a, const void *b)
+{
+    const qd_alloc_sample_t *sa = *(const qd_alloc_sample_t **) a;
+    const qd_alloc_sample_t *sb = *(const qd_alloc_sample_t **) b;
+    if (sa->depth != sb->depth)
+        return sa->depth - sb->depth;
+    return memcmp(sa->stack, sb->stack, sa->depth * sizeof(void *));
+}
+
+static int compare_groups(const void *a, const void *b)
+{
+    const sample_group_t *ga = (const sample_group_t *) a;
+    const sample_group_t *gb = (const sample_group_t *) b;
+    return ga->count < gb->count ? 1 : ga->count > gb->count ? -1 : 0;
+}
+
+char *qd_alloc_profile_report(qd_alloc_type_desc_t *desc, int max_stacks)
+{
+    //
+    // Take a snapshot of the live samples under the lock, then group identical
+    // stacks and symbolize the largest groups without holding it.
+    //
+    sys_mutex_lock(&desc->lock);
+    qd_alloc_sample_list_t *list  = (qd_alloc_sample_list_t *) desc->samples;
+    size_t                  count = list ? DEQ_SIZE(*list) : 0;
+    qd_alloc_sample_t      *copy  = count ? NEW_ARRAY(qd_alloc_sample_t, count) : 0;
+    size_t                  i     = 0;
+    for (qd_alloc_sample_t *sample = list ? DEQ_HEAD(*list) : 0; sample; sample = DEQ_NEXT(sample))
+        copy[i++] = *sample;
+    sys_mutex_unlock(&desc->lock);
+
+    if (count == 0)
+        return 0;
+
+    qd_alloc_sample_t **sorted = NEW_ARRAY(qd_alloc_sample_t *, count);
+    for (i = 0; i < count; ++i)
+        sorted[i] = &copy[i];
+    qsort(sorted, count, sizeof(qd_alloc_sample_t *), compare_stacks);
+
+    sample_group_t *groups      = NEW_ARRAY(sample_group_t, count);
+    size_t          group_count = 0;
+    for (i = 0; i < count; ++i) {
+        if (group_count && compare_stacks(&groups[group_count - 1].sample, &sorted[i]) == 0) {
+            groups[group_count - 1].count++;
+        } else {
+            groups[group_count].sample  = sorted[i];
+            groups[group_count++].count = 1;
+        }
+    }
+    qsort(groups, group_count, sizeof(sample_group_t), compare_groups);
+
+    char  *report = 0;
+    size_t size   = 0;
+    FILE  *out    = open_memstream(&report, &size);
+    if (out) {
+        const uint32_t rate = atomic_load_explicit(&profile_rate, memory_order_relaxed);
+        for (size_t g = 0; g < group_count && g < (size_t) max_stacks; ++g) {
+            const qd_alloc_sample_t *sample = groups[g].sample;
+            fprintf(out, "%" PRIu64 " samples (~%" PRIu64 " live):\n", groups[g].count, groups[g].count * MAX(rate, 1));
+            char **strings = backtrace_symbols((void *const *) sample->stack, sample->depth);
+            for (int f = SAMPLE_SKIP_FRAMES; f < sample->depth; ++f)
+                qd_print_symbolized_backtrace_line(out, strings ? strings[f] : "?", f - SAMPLE_SKIP_FRAMES,
+                                                   sample->stack[f]);
+            free(strings);
+        }
+        fclose(out);
+        qd_symbolize_finalize();
+    }
+
+    free(groups);
+    free(sorted);
+    free(copy);
+    return report;
+}
+
+// number of call stacks shown in the allocator entity's sampledStacks attribute
+#define ENTITY_PROFILE_STACKS 10
+
 QD_EXPORT qd_error_t qd_entity_refresh_allocator(qd_entity_t* entity, void *impl)
 {
     qd_alloc_type_desc_t *desc = (qd_alloc_type_desc_t *) impl;
 
+    // symbolizing the samples is slow, do not hold the lock
+    char *profile = qd_alloc_profile_report(desc, ENTITY_PROFILE_STACKS);
+    qd_error_t err = qd_entity_set_string(entity, "sampledStacks", profile);
+    free(profile);
+    if (err != QD_ERROR_NONE)
+        return err;
+
     sys_mutex_lock(&desc->lock);
 
     if (qd_entity_set_string(entity, "typeName", desc->type_name) == 0
@@ -673,7 +1226,10 @@ QD_EXPORT qd_error_t qd_entity_refresh_allocator(qd_entity_t* entity, void *impl
         && qd_entity_set_long(entity, "totalFreeToHeap", desc->stats.total_free_to_heap) == 0
         && qd_entity_set_long(entity, "heldByThreads", desc->stats.held_by_threads) == 0
         && qd_entity_set_long(entity, "batchesRebalancedToThreads", desc->stats.batches_rebalanced_to_threads) == 0
-        && qd_entity_set_long(entity, "batchesRebalancedToGlobal", desc->stats.batches_rebalanced_to_global) == 0) {
+        && qd_entity_set_long(entity, "batchesRebalancedToGlobal", desc->stats.batches_rebalanced_to_global) == 0
+        && qd_entity_set_long(entity, "batchesRebalancedFromRemoteNode", desc->stats.batches_rebalanced_from_remote_node) == 0
+        && qd_entity_set_long(entity, "remoteFreesReclaimed", remote_frees_reclaimed_LH(desc)) == 0
+        && qd_entity_set_long(entity, "sampledInUse", DEQ_SIZE(*(qd_alloc_sample_list_t *) desc->samples)) == 0) {
         sys_mutex_unlock(&desc->lock);
         return QD_ERROR_NONE;
     }
@@ -681,16 +1237,42 @@ QD_EXPORT qd_error_t qd_entity_refresh_allocator(qd_entity_t* entity, void *impl
     return qd_error_code();
 }
 
+size_t qd_alloc_desc_sampled(const qd_alloc_type_desc_t *desc)
+{
+    sys_mutex_t *lock = (sys_mutex_t *) &desc->lock;  // cast away const
+    sys_mutex_lock(lock);
+    size_t count = desc->samples ? DEQ_SIZE(*(qd_alloc_sample_list_t *) desc->samples) : 0;
+    sys_mutex_unlock(lock);
+    return count;
+}
+
+qd_alloc_type_desc_t *qd_alloc_desc_first(void)
+{
+    return DEQ_HEAD(desc_list);
+}
+
 qd_alloc_stats_t qd_alloc_desc_stats(const qd_alloc_type_desc_t *desc)
 {
     sys_mutex_t *lock = (sys_mutex_t *) &desc->lock;  // cast away const
     sys_mutex_lock(lock);
     qd_alloc_stats_t stats = desc->stats;
+    stats.remote_frees_reclaimed = remote_frees_reclaimed_LH(desc);
     sys_mutex_unlock(lock);
 
+    if (desc->embedded_in) {
+        qd_alloc_stats_t embedded = qd_alloc_desc_stats(desc->embedded_in);
+        stats.total_alloc_from_heap += embedded.total_alloc_from_heap;
+        stats.total_free_to_heap    += embedded.total_free_to_heap;
+        stats.held_by_threads       += embedded.held_by_threads;
+    }
     return stats;
 }
 
+void qd_alloc_desc_embedded_in(qd_alloc_type_desc_t *desc, const qd_alloc_type_desc_t *container)
+{
+    desc->embedded_in = container;
+}
+
 size_t qd_alloc_type_size(const qd_alloc_type_desc_t *desc)
 {
     return desc->total_size;
@@ -738,6 +1320,29 @@ void qd_alloc_desc_init(const char *name, qd_alloc_type_desc_t *desc, size_t siz
 static qd_duration_t monitor_interval = 15 * 60 * 1000;
 static qd_timer_t *monitor_timer;
 
+// memory pressure is sampled far more often than the usage is logged
+static const qd_duration_t pressure_interval = 1000;
+static qd_timer_t *pressure_timer;
+static uint64_t memory_ceiling;
+static uint64_t memory_budget;
+static sys_atomic_t memory_pressure;
+static sys_atomic_t memory_state;
+
+// pressure (percent of the ceiling) at which each memory state is entered, a state is left once the pressure drops
+// MEMORY_STATE_HYSTERESIS points below its threshold so a router hovering at a threshold does not flap
+static const int memory_state_threshold[] = {0, 50, 85, 95};
+static const char *const memory_state_name[] = {"normal", "shrinking Q2 limits", "holding credit on new links",
+                                                "refusing new connections"};
+#define MEMORY_STATE_HYSTERESIS 5
+
+// Idle pool memory is trimmed at a low rate: an item is only released after the global free list has not dipped
+// below it for QD_ALLOC_TRIM_WINDOW consecutive samples (one minute by default).
+static qd_duration_t trim_interval = 10 * 1000;
+static qd_timer_t *trim_timer;
+
+// limit on the batches released per type per sample, bounds the desc->lock hold time
+#define TRIM_MAX_BATCHES 16
+
 // timer callback to dump memory metrics to the log
 //
 static void on_monitor_timer(void *context)
@@ -806,12 +1411,130 @@ static void on_monitor_timer(void *context)
     qd_timer_schedule(monitor_timer, monitor_interval);
 }
 
+static void on_pressure_timer(void *context)
+{
+    ASSERT_PROACTOR_MODE(SYS_THREAD_PROACTOR_MODE_TIMER);
+
+    uint64_t usage = qd_alloc_memory_usage();
+    int pressure   = (int) MIN(usage * 100 / memory_ceiling, 100);
+    sys_atomic_set(&memory_pressure, (uint32_t) pressure);
+    qd_alloc_update_memory_state(pressure);
+    qd_timer_schedule(pressure_timer, pressure_interval);
+}
+
+int qd_alloc_memory_pressure(void)
+{
+    return (int) sys_atomic_get(&memory_pressure);
+}
+
+void qd_alloc_set_memory_budget(uint64_t bytes)
+{
+    memory_budget = bytes;
+}
+
+qd_memory_state_t qd_alloc_memory_state(void)
+{
+    return (qd_memory_state_t) sys_atomic_get(&memory_state);
+}
+
+qd_memory_state_t qd_alloc_update_memory_state(int pressure)
+{
+    qd_memory_state_t old_state = qd_alloc_memory_state();
+    qd_memory_state_t state     = old_state;
+
+    while (state < QD_MEMORY_REFUSE_CONNECTIONS && pressure >= memory_state_threshold[state + 1])
+        state++;
+    while (state > QD_MEMORY_NORMAL && pressure < memory_state_threshold[state] - MEMORY_STATE_HYSTERESIS)
+        state--;
+
+    if (state != old_state) {
+        sys_atomic_set(&memory_state, (uint32_t) state);
+        qd_log(LOG_ROUTER, state > old_state ? QD_LOG_WARNING : QD_LOG_INFO,
+               "Memory pressure %d%% of %" PRIu64 " bytes: %s (was %s)", pressure, memory_ceiling,
+               memory_state_name[state], memory_state_name[old_state]);
+    }
+    return state;
+}
+
+void qd_alloc_trim(void)
+{
+    uint64_t released = 0;
+
+    for (qd_alloc_type_desc_t *desc = DEQ_HEAD(desc_list); desc; desc = DEQ_NEXT(desc)) {
+        sys_mutex_lock(&desc->lock);
+        if (!desc->global_pools) {
+            sys_mutex_unlock(&desc->lock);
+            continue;
+        }
+
+        const uint64_t size = global_size_LH(desc);
+        desc->trim_window[desc->trim_slot] = MIN(desc->global_low_water, size);
+        desc->trim_slot                    = (desc->trim_slot + 1) % QD_ALLOC_TRIM_WINDOW;
+        desc->global_low_water             = size;
+
+        // The idle count is the number of items that sat on the global free list throughout the window.  Keep one
+        // batch in reserve so the next rebalance does not have to go to the heap.
+        uint64_t idle = desc->trim_window[0];
+        for (int i = 1; i < QD_ALLOC_TRIM_WINDOW; ++i)
+            idle = MIN(idle, desc->trim_window[i]);
+
+        const uint64_t reserve = desc->config->transfer_batch_size;
+        if (idle > reserve) {
+            const uint64_t count = MIN(idle - reserve, (uint64_t) TRIM_MAX_BATCHES * desc->config->transfer_batch_size);
+            for (uint64_t i = 0; i < count; ++i) {
+                qd_alloc_item_t *item = pop_global_LH(desc, -1);
+                release_item_LH(desc, item);
+            }
+            desc->stats.total_free_to_heap += count;
+            released += count * desc->total_size;
+
+            // the released items are no longer part of the window
+            for (int i = 0; i < QD_ALLOC_TRIM_WINDOW; ++i)
+                desc->trim_window[i] -= MIN(desc->trim_window[i], count);
+            desc->global_low_water -= count;
+        }
+        sys_mutex_unlock(&desc->lock);
+    }
+
+    if (released) {
+#ifdef __GLIBC__
+        // let the C library give the freed pages back to the OS
+        malloc_trim(0);
+#endif
+        qd_log(LOG_ROUTER, QD_LOG_DEBUG, "alloc_pool trimmed %" PRIu64 " bytes of idle pool memory", released);
+    }
+}
+
+static void on_trim_timer(void *context)
+{
+    ASSERT_PROACTOR_MODE(SYS_THREAD_PROACTOR_MODE_TIMER);
+
+    qd_alloc_trim();
+    qd_timer_schedule(trim_timer, trim_interval);
+}
+
 void qd_alloc_start_monitor(struct qd_dispatch_t *qd)
 {
 #ifdef QD_MEMORY_DEBUG
     assert(alloc_pool_ready);  // need to call qd_alloc_initialize first!
 #endif
 
+    memory_ceiling = (uint64_t) qd_platform_memory_size();
+    const char *ceiling_str = getenv("SKUPPER_ROUTER_MEMORY_CEILING");
+    if (ceiling_str) {
+        long long convert = atoll(ceiling_str);
+        if (convert > 0)
+            memory_ceiling = (uint64_t) convert;
+    }
+    if (memory_budget) {
+        memory_ceiling = memory_budget;
+        qd_log(LOG_ROUTER, QD_LOG_INFO, "Router memory budget %" PRIu64 " bytes", memory_budget);
+    }
+    if (memory_ceiling) {
+        pressure_timer = qd_timer(qd, on_pressure_timer, 0);
+        qd_timer_schedule(pressure_timer, pressure_interval);
+    }
+
     // Check for override
     const char *interval_str = getenv("SKUPPER_ROUTER_ALLOC_MONITOR_SECS");
     if (interval_str) {
@@ -828,11 +1551,31 @@ void qd_alloc_start_monitor(struct qd_dispatch_t *qd)
         monitor_timer = qd_timer(qd, on_monitor_timer, 0);
         qd_timer_schedule(monitor_timer, monitor_interval);
     }
+
+    const char *trim_str = getenv("SKUPPER_ROUTER_ALLOC_TRIM_SECS");
+    if (trim_str) {
+        unsigned int interval = 0;
+        int rc = sscanf(trim_str, "%u", &interval);
+        if (rc == 1) {
+            trim_interval = 1000 * (qd_duration_t) interval;
+            qd_log(LOG_ROUTER, QD_LOG_DEBUG, "alloc_pool trim interval overridden to %lu msecs",
+                   (unsigned long) trim_interval);
+        }
+    }
+
+    if (trim_interval) {
+        trim_timer = qd_timer(qd, on_trim_timer, 0);
+        qd_timer_schedule(trim_timer, trim_interval);
+    }
 }
 
 void qd_alloc_stop_monitor(void)
 {
     if (monitor_timer)
         qd_timer_free(monitor_timer);
+    if (pressure_timer)
+        qd_timer_free(pressure_timer);
+    if (trim_timer)
+        qd_timer_free(trim_timer);
 }
 
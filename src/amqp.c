@@ -34,6 +34,7 @@ const char * const QD_CAPABILITY_ROUTER_DATA          = "qd.router-data";
 const char * const QD_CAPABILITY_EDGE_DOWNLINK        = "qd.router-edge-downlink";
 const char * const QD_CAPABILITY_STREAMING_DELIVERIES = "qd.streaming-deliveries";
 const char * const QD_CAPABILITY_RESEND_RELEASED      = "qd.resend-released";
+const char * const QD_CAPABILITY_EDGE_TRACKING_BATCH  = "qd.edge-tracking-batch";
 const char * const QD_CAPABILITY_ANONYMOUS_RELAY      = "ANONYMOUS-RELAY";
 const char * const QD_CAPABILITY_STREAMING_LINKS      = "qd.streaming-links";
 const char * const QD_CAPABILITY_INTER_EDGE           = "qd.router-inter-edge";
@@ -58,6 +59,8 @@ const char * const QD_CONNECTION_PROPERTY_ADAPTOR_KEY           = "qd.adaptor";
 const char * const QD_CONNECTION_PROPERTY_TCP_ADAPTOR_VALUE     = "tcp";
 const char * const QD_CONNECTION_PROPERTY_ANNOTATIONS_VERSION_KEY = "qd.annotations-version";
 const char * const QD_CONNECTION_PROPERTY_ACCESS_ID             = "qd.access-id";
+const char * const QD_CONNECTION_PROPERTY_COMPRESSION_KEY       = "qd.compression";
+const char * const QD_CONNECTION_PROPERTY_COMPRESSION_DEFLATE   = "deflate";
 
 const char * const QD_TERMINUS_EDGE_ADDRESS_TRACKING = "_$qd.edge_addr_tracking";
 const char * const QD_TERMINUS_HEARTBEAT             = "_$qd.edge_heartbeat";
@@ -19,13 +19,19 @@
 
 #include "qpid/dispatch/bitmask.h"
 
+#include "config.h"
+
 #include "qpid/dispatch/alloc.h"
 
 #include <assert.h>
 #include <stdint.h>
 
-#define QD_BITMASK_LONGS 2
-#define QD_BITMASK_BITS  (QD_BITMASK_LONGS * 64)
+// The width is selected at build time with the QD_MAX_ROUTERS CMake option
+#define QD_BITMASK_BITS  QD_MAX_ROUTERS
+#define QD_BITMASK_LONGS (QD_BITMASK_BITS / 64)
+
+_Static_assert(QD_BITMASK_BITS % 64 == 0 && QD_BITMASK_BITS >= 128 && QD_BITMASK_BITS <= 1024,
+               "QD_MAX_ROUTERS must be 128, 256, 512 or 1024");
 
 struct qd_bitmask_t {
     uint64_t array[QD_BITMASK_LONGS];
@@ -123,6 +129,24 @@ int qd_bitmask_value(qd_bitmask_t *b, int bitnum)
 }
 
 
+// return the lowest set bit at or above bitnum, or FIRST_NONE
+static inline int qdbm_scan(const qd_bitmask_t *b, int bitnum)
+{
+    if (bitnum >= QD_BITMASK_BITS)
+        return FIRST_NONE;
+
+    int      idx  = MASK_INDEX(bitnum);
+    uint64_t word = b->array[idx] & (~((uint64_t) 0) << (bitnum % 64));
+
+    while (!word) {
+        if (++idx == QD_BITMASK_LONGS)
+            return FIRST_NONE;
+        word = b->array[idx];
+    }
+    return idx * 64 + __builtin_ctzll(word);
+}
+
+
 int qd_bitmask_first_set(qd_bitmask_t *b, int *bitnum)
 {
     //
@@ -131,18 +155,8 @@ int qd_bitmask_first_set(qd_bitmask_t *b, int *bitnum)
     if (!b)
         return 0;
 
-    if (b->first_set == FIRST_UNKNOWN) {
-        b->first_set = FIRST_NONE;
-        for (int i = 0; i < QD_BITMASK_LONGS; i++)
-            if (b->array[i]) {
-                for (int j = 0; j < 64; j++)
-                    if ((((uint64_t) 1) << j) & b->array[i]) {
-                        b->first_set = i * 64 + j;
-                        break;
-                    }
-                break;
-            }
-    }
+    if (b->first_set == FIRST_UNKNOWN)
+        b->first_set = b->cardinality ? qdbm_scan(b, 0) : FIRST_NONE;
 
     if (b->first_set == FIRST_NONE)
         return 0;
@@ -157,6 +171,39 @@ int qd_bitmask_cardinality(const qd_bitmask_t *b)
 }
 
 
+// recompute the cached cardinality after a bulk operation
+static void qdbm_recount(qd_bitmask_t *b)
+{
+    int cardinality = 0;
+    for (int i = 0; i < QD_BITMASK_LONGS; i++)
+        cardinality += __builtin_popcountll(b->array[i]);
+    b->cardinality = cardinality;
+    b->first_set   = cardinality ? FIRST_UNKNOWN : FIRST_NONE;
+}
+
+
+void qd_bitmask_copy(qd_bitmask_t *dest, const qd_bitmask_t *src)
+{
+    *dest = *src;
+}
+
+
+void qd_bitmask_or(qd_bitmask_t *dest, const qd_bitmask_t *src)
+{
+    for (int i = 0; i < QD_BITMASK_LONGS; i++)
+        dest->array[i] |= src->array[i];
+    qdbm_recount(dest);
+}
+
+
+void qd_bitmask_and(qd_bitmask_t *dest, const qd_bitmask_t *src)
+{
+    for (int i = 0; i < QD_BITMASK_LONGS; i++)
+        dest->array[i] &= src->array[i];
+    qdbm_recount(dest);
+}
+
+
 bool qd_bitmask_valid_bit_value(int bitnum)
 {
     return (bitnum >= 0 && bitnum < QD_BITMASK_BITS);
@@ -174,30 +221,5 @@ int _qdbm_start(qd_bitmask_t *b)
 
 void _qdbm_next(qd_bitmask_t *b, int *v)
 {
-    if (*v == QD_BITMASK_BITS - 1) {
-        *v = -1;
-        return;
-    }
-
-    int      idx  = MASK_INDEX(*v);
-    uint64_t bits = MASK_ONEHOT(*v);
-    int      next = *v;
-
-    while (1) {
-        next++;
-        if (bits & 0x8000000000000000LL) {
-            if (++idx == QD_BITMASK_LONGS) {
-                *v = -1;
-                return;
-            }
-            bits = 1;
-        } else
-            bits = bits << 1;
-
-        if (b->array[idx] & bits) {
-            *v = next;
-            return;
-        }
-    }
+    *v = qdbm_scan(b, *v + 1);
 }
-
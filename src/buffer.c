@@ -24,9 +24,34 @@
 #include <stdint.h>
 #include <string.h>
 
-size_t QD_BUFFER_SIZE = QD_BUFFER_DEFAULT_SIZE;
+size_t QD_BUFFER_SMALL_SIZE = QD_BUFFER_SMALL_DEFAULT_SIZE;
+size_t QD_BUFFER_SIZE       = QD_BUFFER_DEFAULT_SIZE;
+size_t QD_BUFFER_LARGE_SIZE = QD_BUFFER_LARGE_DEFAULT_SIZE;
 
-ALLOC_DEFINE_CONFIG(qd_buffer_t, sizeof(qd_buffer_t), &QD_BUFFER_SIZE, 0);
+//
+// One pool per size class.  The small and large pools are distinct alloc types that share the
+// qd_buffer_t layout.
+//
+typedef qd_buffer_t qd_buffer_small_t;
+typedef qd_buffer_t qd_buffer_large_t;
+typedef qd_buffer_t qd_buffer_shared_t;
+ALLOC_DECLARE(qd_buffer_small_t);
+ALLOC_DECLARE(qd_buffer_large_t);
+ALLOC_DECLARE(qd_buffer_shared_t);
+
+// Buffers are the hottest pool type on the forwarding path.  Refill them from huge-page backed slabs so they sit on
+// a few TLB entries rather than being scattered across the heap.  The batch sizes are those of
+// qd_alloc_default_config_big, which buffers used before.
+static const qd_alloc_config_t qd_buffer_alloc_config = {.transfer_batch_size  = 16,
+                                                         .local_free_list_max  = 32,
+                                                         .global_free_list_max = -1,
+                                                         .slab_size            = QD_ALLOC_HUGE_PAGE_SIZE,
+                                                         .huge_pages           = true};
+
+ALLOC_DEFINE_CONFIG(qd_buffer_t, sizeof(qd_buffer_t), &QD_BUFFER_SIZE, &qd_buffer_alloc_config);
+ALLOC_DEFINE_CONFIG(qd_buffer_small_t, sizeof(qd_buffer_t), &QD_BUFFER_SMALL_SIZE, 0);
+ALLOC_DEFINE_CONFIG(qd_buffer_large_t, sizeof(qd_buffer_t), &QD_BUFFER_LARGE_SIZE, 0);
+ALLOC_DEFINE_CONFIG(qd_buffer_shared_t, sizeof(qd_buffer_t) + sizeof(qd_buffer_share_t), 0, 0);
 
 /**
  * Set the initial buffer capacity to be allocated by future calls to qp_buffer.
@@ -34,29 +59,140 @@ ALLOC_DEFINE_CONFIG(qd_buffer_t, sizeof(qd_buffer_t), &QD_BUFFER_SIZE, 0);
  * NOTICE: This function is provided for testing purposes only.  It should not be invoked in the production code. This
  * function can only be called once. It must be called before calling qd_alloc_initialize() otherwise the software WILL
  * BE unstable and WILL crash.
+ *
+ * All size classes are set to the same size so that tests exercising buffer boundaries see them
+ * regardless of which class the code under test picks.
  */
 void qd_buffer_set_size_test_only(size_t size)
 {
-    QD_BUFFER_SIZE = size;
+    QD_BUFFER_SMALL_SIZE = size;
+    QD_BUFFER_SIZE       = size;
+    QD_BUFFER_LARGE_SIZE = size;
 }
 
 
-qd_buffer_t *qd_buffer(void)
+qd_buffer_t *qd_buffer_sized(qd_buffer_class_t size_class)
 {
-    qd_buffer_t *buf = new_qd_buffer_t();
+    qd_buffer_t *buf;
+
+    switch (size_class) {
+    case QD_BUFFER_CLASS_SMALL:
+        buf = new_qd_buffer_small_t();
+        buf->capacity = QD_BUFFER_SMALL_SIZE;
+        break;
+    case QD_BUFFER_CLASS_LARGE:
+        buf = new_qd_buffer_large_t();
+        buf->capacity = QD_BUFFER_LARGE_SIZE;
+        break;
+    default:
+        buf = new_qd_buffer_t();
+        buf->capacity = QD_BUFFER_SIZE;
+        size_class    = QD_BUFFER_CLASS_DEFAULT;
+        break;
+    }
 
     DEQ_ITEM_INIT(buf);
-    buf->size   = 0;
+    buf->size       = 0;
+    buf->size_class = size_class;
     sys_atomic_init(&buf->bfanout, 0);
+    sys_atomic_init(&buf->refs, 1);
     return buf;
 }
 
 
+qd_buffer_t *qd_buffer_share(qd_buffer_t *buf, size_t offset)
+{
+    assert(offset <= buf->size);
+    qd_buffer_t *owner = buf->size_class == QD_BUFFER_CLASS_SHARED
+        ? ((qd_buffer_share_t*) &buf[1])->owner : buf;
+
+    qd_buffer_t *share = new_qd_buffer_shared_t();
+    DEQ_ITEM_INIT(share);
+    share->size       = buf->size - offset;
+    share->capacity   = share->size;
+    share->size_class = QD_BUFFER_CLASS_SHARED;
+    sys_atomic_init(&share->bfanout, 0);
+    sys_atomic_init(&share->refs, 1);
+
+    qd_buffer_share_t *ext = (qd_buffer_share_t*) &share[1];
+    ext->owner   = owner;
+    ext->data    = qd_buffer_base(buf) + offset;
+    ext->release = 0;
+    ext->context = 0;
+    sys_atomic_inc(&owner->refs);
+    return share;
+}
+
+
+qd_buffer_t *qd_buffer_external(unsigned char *data, size_t size, void (*release)(void *context), void *context)
+{
+    qd_buffer_t *buf = new_qd_buffer_shared_t();
+    DEQ_ITEM_INIT(buf);
+    buf->size       = size;
+    buf->capacity   = size;
+    buf->size_class = QD_BUFFER_CLASS_EXTERNAL;
+    sys_atomic_init(&buf->bfanout, 0);
+    sys_atomic_init(&buf->refs, 1);
+
+    qd_buffer_share_t *ext = (qd_buffer_share_t*) &buf[1];
+    ext->owner   = 0;
+    ext->data    = data;
+    ext->release = release;
+    ext->context = context;
+    return buf;
+}
+
+
+qd_buffer_t *qd_buffer(void)
+{
+    return qd_buffer_sized(QD_BUFFER_CLASS_DEFAULT);
+}
+
+
 void qd_buffer_free(qd_buffer_t *buf)
 {
     if (!buf) return;
+
+    //
+    // The data area stays allocated until the last share of it is freed.
+    //
+    if (sys_atomic_dec(&buf->refs) > 1)
+        return;
+
     sys_atomic_destroy(&buf->bfanout);
-    free_qd_buffer_t(buf);
+    sys_atomic_destroy(&buf->refs);
+    switch (buf->size_class) {
+    case QD_BUFFER_CLASS_SMALL:
+        free_qd_buffer_small_t(buf);
+        break;
+    case QD_BUFFER_CLASS_LARGE:
+        free_qd_buffer_large_t(buf);
+        break;
+    case QD_BUFFER_CLASS_SHARED: {
+        qd_buffer_t *owner = ((qd_buffer_share_t*) &buf[1])->owner;
+        free_qd_buffer_shared_t(buf);
+        qd_buffer_free(owner);
+        break;
+    }
+    case QD_BUFFER_CLASS_EXTERNAL: {
+        qd_buffer_share_t ext = *(qd_buffer_share_t*) &buf[1];
+        free_qd_buffer_shared_t(buf);
+        ext.release(ext.context);
+        break;
+    }
+    default:
+        free_qd_buffer_t(buf);
+        break;
+    }
+}
+
+
+uint64_t qd_buffer_held_units(void)
+{
+    uint64_t bytes = alloc_stats_qd_buffer_t().held_by_threads * QD_BUFFER_SIZE
+                     + alloc_stats_qd_buffer_small_t().held_by_threads * QD_BUFFER_SMALL_SIZE
+                     + alloc_stats_qd_buffer_large_t().held_by_threads * QD_BUFFER_LARGE_SIZE;
+    return bytes / QD_BUFFER_SIZE;
 }
 
 
@@ -70,7 +206,8 @@ unsigned int qd_buffer_list_clone(qd_buffer_list_t *dst, const qd_buffer_list_t
         unsigned char *src = qd_buffer_base(buf);
         len += to_copy;
         while (to_copy) {
-            qd_buffer_t *newbuf = qd_buffer();
+            qd_buffer_t *newbuf = qd_buffer_sized(buf->size_class >= QD_BUFFER_CLASS_SHARED
+                                                  ? QD_BUFFER_CLASS_DEFAULT : buf->size_class);
             size_t count = qd_buffer_capacity(newbuf);
             // default buffer capacity may have changed,
             // so don't assume it will fit:
@@ -87,6 +224,23 @@ unsigned int qd_buffer_list_clone(qd_buffer_list_t *dst, const qd_buffer_list_t
 }
 
 
+unsigned int qd_buffer_list_clone_shared(qd_buffer_list_t *dst, const qd_buffer_list_t *src)
+{
+    uint32_t len = 0;
+    DEQ_INIT(*dst);
+    qd_buffer_t *buf = DEQ_HEAD(*src);
+    while (buf) {
+        if (qd_buffer_size(buf) > 0) {
+            qd_buffer_t *share = qd_buffer_share(buf, 0);
+            len += qd_buffer_size(share);
+            DEQ_INSERT_TAIL(*dst, share);
+        }
+        buf = DEQ_NEXT(buf);
+    }
+    return len;
+}
+
+
 void qd_buffer_list_free_buffers(qd_buffer_list_t *list)
 {
     qd_buffer_t *buf = DEQ_HEAD(*list);
@@ -65,7 +65,11 @@ static inline void qd_insert(qd_composed_field_t *field, const uint8_t *seq, siz
 
     while (len > 0) {
         if (buf == 0 || qd_buffer_capacity(buf) == 0) {
-            buf = qd_buffer();
+            //
+            // Most composed fields are short (headers, properties, control bodies), so start
+            // with a small buffer and continue in default buffers if the field grows.
+            //
+            buf = !buf && len <= QD_BUFFER_SMALL_SIZE ? qd_buffer_sized(QD_BUFFER_CLASS_SMALL) : qd_buffer();
             if (buf == 0)
                 return;
             DEQ_INSERT_TAIL(field->buffers, buf);
@@ -84,35 +88,115 @@ static inline void qd_insert(qd_composed_field_t *field, const uint8_t *seq, siz
 }
 
 
+//
+// Fast path for short encodings: qd_insert_reserve() returns where len octets can be written contiguously, directly in
+// the tail buffer if they fit or else in the caller's scratch space, and qd_insert_commit() appends them.  Only the
+// scratch case goes through qd_insert().
+//
+static inline uint8_t *qd_insert_reserve(qd_composed_field_t *field, size_t len, uint8_t *scratch)
+{
+    qd_buffer_t *buf = DEQ_TAIL(field->buffers);
+    return buf && qd_buffer_capacity(buf) >= len ? qd_buffer_cursor(buf) : scratch;
+}
+
+
+static inline void qd_insert_commit(qd_composed_field_t *field, const uint8_t *out, const uint8_t *scratch, size_t len)
+{
+    if (out == scratch) {
+        qd_insert(field, scratch, len);
+    } else {
+        qd_buffer_insert(DEQ_TAIL(field->buffers), len);
+        bump_length(field, len);
+    }
+}
+
+
+static inline uint8_t *encode_32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t) ((value & 0xFF000000) >> 24);
+    out[1] = (uint8_t) ((value & 0x00FF0000) >> 16);
+    out[2] = (uint8_t) ((value & 0x0000FF00) >> 8);
+    out[3] = (uint8_t)  (value & 0x000000FF);
+    return out + 4;
+}
+
+
+static inline uint8_t *encode_64(uint8_t *out, uint64_t value)
+{
+    out = encode_32(out, (uint32_t) (value >> 32));
+    return encode_32(out, (uint32_t) value);
+}
+
+
 static inline void qd_insert_8(qd_composed_field_t *field, uint8_t value)
 {
-    qd_insert(field, &value, 1);
+    uint8_t  scratch[1];
+    uint8_t *out = qd_insert_reserve(field, 1, scratch);
+    out[0] = value;
+    qd_insert_commit(field, out, scratch, 1);
+}
+
+
+// A type tag followed by a one octet value
+static inline void qd_insert_tag_8(qd_composed_field_t *field, uint8_t tag, uint8_t value)
+{
+    uint8_t  scratch[2];
+    uint8_t *out = qd_insert_reserve(field, 2, scratch);
+    out[0] = tag;
+    out[1] = value;
+    qd_insert_commit(field, out, scratch, 2);
+}
+
+
+static inline void qd_insert_tag_32(qd_composed_field_t *field, uint8_t tag, uint32_t value)
+{
+    uint8_t  scratch[5];
+    uint8_t *out = qd_insert_reserve(field, 5, scratch);
+    out[0] = tag;
+    encode_32(out + 1, value);
+    qd_insert_commit(field, out, scratch, 5);
 }
 
 
-static inline void qd_insert_32(qd_composed_field_t *field, uint32_t value)
+static inline void qd_insert_tag_64(qd_composed_field_t *field, uint8_t tag, uint64_t value)
 {
-    uint8_t buf[4];
-    buf[0] = (uint8_t) ((value & 0xFF000000) >> 24);
-    buf[1] = (uint8_t) ((value & 0x00FF0000) >> 16);
-    buf[2] = (uint8_t) ((value & 0x0000FF00) >> 8);
-    buf[3] = (uint8_t)  (value & 0x000000FF);
-    qd_insert(field, buf, 4);
+    uint8_t  scratch[9];
+    uint8_t *out = qd_insert_reserve(field, 9, scratch);
+    out[0] = tag;
+    encode_64(out + 1, value);
+    qd_insert_commit(field, out, scratch, 9);
 }
 
 
-static inline void qd_insert_64(qd_composed_field_t *field, uint64_t value)
+// A variable width value: the type tag for its length class, the length and the octets, in one copy if they fit in
+// the tail buffer
+static inline void qd_insert_variable(qd_composed_field_t *field, uint8_t tag8, uint8_t tag32, const uint8_t *value,
+                                      size_t len)
 {
-    uint8_t buf[8];
-    buf[0] = (uint8_t) ((value & 0xFF00000000000000L) >> 56);
-    buf[1] = (uint8_t) ((value & 0x00FF000000000000L) >> 48);
-    buf[2] = (uint8_t) ((value & 0x0000FF0000000000L) >> 40);
-    buf[3] = (uint8_t) ((value & 0x000000FF00000000L) >> 32);
-    buf[4] = (uint8_t) ((value & 0x00000000FF000000L) >> 24);
-    buf[5] = (uint8_t) ((value & 0x0000000000FF0000L) >> 16);
-    buf[6] = (uint8_t) ((value & 0x000000000000FF00L) >> 8);
-    buf[7] = (uint8_t)  (value & 0x00000000000000FFL);
-    qd_insert(field, buf, 8);
+    uint8_t header[5];
+    size_t  header_len;
+    if (len < 256) {
+        header[0]  = tag8;
+        header[1]  = (uint8_t) len;
+        header_len = 2;
+    } else {
+        header[0] = tag32;
+        encode_32(header + 1, (uint32_t) len);
+        header_len = 5;
+    }
+
+    qd_buffer_t *buf = DEQ_TAIL(field->buffers);
+    if (buf && qd_buffer_capacity(buf) >= header_len + len) {
+        uint8_t *out = qd_buffer_cursor(buf);
+        memcpy(out, header, header_len);
+        if (len)
+            memcpy(out + header_len, value, len);
+        qd_buffer_insert(buf, header_len + len);
+        bump_length(field, header_len + len);
+    } else {
+        qd_insert(field, header, header_len);
+        qd_insert(field, value, len);
+    }
 }
 
 
@@ -310,11 +394,9 @@ void qd_compose_insert_uint(qd_composed_field_t *field, uint32_t value)
     if (value == 0) {
         qd_insert_8(field, QD_AMQP_UINT0);
     } else if (value < 256) {
-        qd_insert_8(field, QD_AMQP_SMALLUINT);
-        qd_insert_8(field, (uint8_t) value);
+        qd_insert_tag_8(field, QD_AMQP_SMALLUINT, (uint8_t) value);
     } else {
-        qd_insert_8(field, QD_AMQP_UINT);
-        qd_insert_32(field, value);
+        qd_insert_tag_32(field, QD_AMQP_UINT, value);
     }
     bump_count(field);
 }
@@ -325,11 +407,9 @@ void qd_compose_insert_ulong(qd_composed_field_t *field, uint64_t value)
     if (value == 0) {
         qd_insert_8(field, QD_AMQP_ULONG0);
     } else if (value < 256) {
-        qd_insert_8(field, QD_AMQP_SMALLULONG);
-        qd_insert_8(field, (uint8_t) value);
+        qd_insert_tag_8(field, QD_AMQP_SMALLULONG, (uint8_t) value);
     } else {
-        qd_insert_8(field, QD_AMQP_ULONG);
-        qd_insert_64(field, value);
+        qd_insert_tag_64(field, QD_AMQP_ULONG, value);
     }
     bump_count(field);
 }
@@ -338,11 +418,9 @@ void qd_compose_insert_ulong(qd_composed_field_t *field, uint64_t value)
 void qd_compose_insert_int(qd_composed_field_t *field, int32_t value)
 {
     if (value >= -128 && value <= 127) {
-        qd_insert_8(field, QD_AMQP_SMALLINT);
-        qd_insert_8(field, (uint8_t) value);
+        qd_insert_tag_8(field, QD_AMQP_SMALLINT, (uint8_t) value);
     } else {
-        qd_insert_8(field, QD_AMQP_INT);
-        qd_insert_32(field, (uint32_t) value);
+        qd_insert_tag_32(field, QD_AMQP_INT, (uint32_t) value);
     }
     bump_count(field);
 }
@@ -351,11 +429,9 @@ void qd_compose_insert_int(qd_composed_field_t *field, int32_t value)
 void qd_compose_insert_long(qd_composed_field_t *field, int64_t value)
 {
     if (value >= -128 && value <= 127) {
-        qd_insert_8(field, QD_AMQP_SMALLLONG);
-        qd_insert_8(field, (uint8_t) value);
+        qd_insert_tag_8(field, QD_AMQP_SMALLLONG, (uint8_t) value);
     } else {
-        qd_insert_8(field, QD_AMQP_LONG);
-        qd_insert_64(field, (uint64_t) value);
+        qd_insert_tag_64(field, QD_AMQP_LONG, (uint64_t) value);
     }
     bump_count(field);
 }
@@ -363,8 +439,7 @@ void qd_compose_insert_long(qd_composed_field_t *field, int64_t value)
 
 void qd_compose_insert_timestamp(qd_composed_field_t *field, uint64_t value)
 {
-    qd_insert_8(field, QD_AMQP_TIMESTAMP);
-    qd_insert_64(field, value);
+    qd_insert_tag_64(field, QD_AMQP_TIMESTAMP, value);
     bump_count(field);
 }
 
@@ -379,14 +454,7 @@ void qd_compose_insert_uuid(qd_composed_field_t *field, const uint8_t *value)
 
 void qd_compose_insert_binary(qd_composed_field_t *field, const uint8_t *value, uint32_t len)
 {
-    if (len < 256) {
-        qd_insert_8(field, QD_AMQP_VBIN8);
-        qd_insert_8(field, (uint8_t) len);
-    } else {
-        qd_insert_8(field, QD_AMQP_VBIN32);
-        qd_insert_32(field, len);
-    }
-    qd_insert(field, value, len);
+    qd_insert_variable(field, QD_AMQP_VBIN8, QD_AMQP_VBIN32, value, len);
     bump_count(field);
 }
 
@@ -408,11 +476,9 @@ void qd_compose_insert_binary_buffers(qd_composed_field_t *field, qd_buffer_list
     // Supply the appropriate binary tag for the length.
     //
     if (len < 256) {
-        qd_insert_8(field, QD_AMQP_VBIN8);
-        qd_insert_8(field, (uint8_t) len);
+        qd_insert_tag_8(field, QD_AMQP_VBIN8, (uint8_t) len);
     } else {
-        qd_insert_8(field, QD_AMQP_VBIN32);
-        qd_insert_32(field, len);
+        qd_insert_tag_32(field, QD_AMQP_VBIN32, len);
     }
 
     //
@@ -431,14 +497,7 @@ void qd_compose_insert_binary_buffers(qd_composed_field_t *field, qd_buffer_list
 
 void qd_compose_insert_string_n(qd_composed_field_t *field, const char *value, size_t len)
 {
-    if (len < 256) {
-        qd_insert_8(field, QD_AMQP_STR8_UTF8);
-        qd_insert_8(field, (uint8_t) len);
-    } else {
-        qd_insert_8(field, QD_AMQP_STR32_UTF8);
-        qd_insert_32(field, len);
-    }
-    qd_insert(field, (const uint8_t*) value, len);
+    qd_insert_variable(field, QD_AMQP_STR8_UTF8, QD_AMQP_STR32_UTF8, (const uint8_t*) value, len);
     bump_count(field);
 }
 
@@ -459,11 +518,9 @@ void qd_compose_insert_string2(qd_composed_field_t *field, const char *value1, c
     uint32_t len  = len1 + len2;
 
     if (len < 256) {
-        qd_insert_8(field, QD_AMQP_STR8_UTF8);
-        qd_insert_8(field, (uint8_t) len);
+        qd_insert_tag_8(field, QD_AMQP_STR8_UTF8, (uint8_t) len);
     } else {
-        qd_insert_8(field, QD_AMQP_STR32_UTF8);
-        qd_insert_32(field, len);
+        qd_insert_tag_32(field, QD_AMQP_STR32_UTF8, len);
     }
     qd_insert(field, (const uint8_t*) value1, len1);
     qd_insert(field, (const uint8_t*) value2, len2);
@@ -488,24 +545,38 @@ void qd_compose_insert_symbol(qd_composed_field_t *field, const char *value)
     if (value)
         len = strlen(value);
 
-    if (len < 256) {
-        qd_insert_8(field, QD_AMQP_SYM8);
-        qd_insert_8(field, (uint8_t) len);
-    } else {
-        qd_insert_8(field, QD_AMQP_SYM32);
-        qd_insert_32(field, len);
-    }
-    qd_insert(field, (const uint8_t*) value, len);
+    qd_insert_variable(field, QD_AMQP_SYM8, QD_AMQP_SYM32, (const uint8_t*) value, len);
     bump_count(field);
 }
 
 
-void qd_compose_insert_typed_iterator(qd_composed_field_t *field, qd_iterator_t *iter)
+void qd_compose_insert_strings(qd_composed_field_t *field, const char *const *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const char *value = values[i];
+        qd_insert_variable(field, QD_AMQP_STR8_UTF8, QD_AMQP_STR32_UTF8, (const uint8_t*) value,
+                           value ? strlen(value) : 0);
+    }
+    bump_count_by_n(field, count);
+}
+
+
+void qd_compose_insert_symbols(qd_composed_field_t *field, const char *const *values, size_t count)
 {
-    while (!qd_iterator_end(iter)) {
-        uint8_t octet = qd_iterator_octet(iter);
-        qd_insert_8(field, octet);
+    for (size_t i = 0; i < count; i++) {
+        const char *value = values[i];
+        qd_insert_variable(field, QD_AMQP_SYM8, QD_AMQP_SYM32, (const uint8_t*) value, value ? strlen(value) : 0);
     }
+    bump_count_by_n(field, count);
+}
+
+
+void qd_compose_insert_typed_iterator(qd_composed_field_t *field, qd_iterator_t *iter)
+{
+    uint8_t chunk[64];
+    size_t  len;
+    while ((len = qd_iterator_ncopy_octets(iter, chunk, sizeof(chunk))) > 0)
+        qd_insert(field, chunk, len);
 
     bump_count(field);
 }
@@ -549,6 +620,48 @@ void qd_compose_insert_buffer_field(qd_composed_field_t *field,
 }
 
 
+struct qd_compose_template_t {
+    size_t  size;
+    uint8_t octets[];
+};
+
+
+qd_compose_template_t *qd_compose_template(qd_composed_field_t *field)
+{
+    assert(DEQ_SIZE(field->fieldStack) == 0);
+    size_t                 size = qd_buffer_list_length(&field->buffers);
+    qd_compose_template_t *tmpl = (qd_compose_template_t*) qd_malloc(sizeof(qd_compose_template_t) + size);
+    tmpl->size = size;
+
+    uint8_t     *cursor = tmpl->octets;
+    qd_buffer_t *buf    = DEQ_HEAD(field->buffers);
+    while (buf) {
+        memcpy(cursor, qd_buffer_base(buf), qd_buffer_size(buf));
+        cursor += qd_buffer_size(buf);
+        buf = DEQ_NEXT(buf);
+    }
+
+    return tmpl;
+}
+
+
+qd_composed_field_t *qd_compose_from_template(const qd_compose_template_t *tmpl, qd_composed_field_t *extend)
+{
+    qd_composed_field_t *field = qd_compose_subfield(extend);
+
+    if (field)
+        qd_insert(field, tmpl->octets, tmpl->size);
+
+    return field;
+}
+
+
+void qd_compose_template_free(qd_compose_template_t *tmpl)
+{
+    free(tmpl);
+}
+
+
 void qd_compose_insert_double(qd_composed_field_t *field, double value)
 {
     union {
@@ -557,7 +670,6 @@ void qd_compose_insert_double(qd_composed_field_t *field, double value)
     } converter;
     converter.d = value;
 
-    qd_insert_8(field, QD_AMQP_DOUBLE);
-    qd_insert_64(field, converter.l);
+    qd_insert_tag_64(field, QD_AMQP_DOUBLE, converter.l);
     bump_count(field);
 }
@@ -0,0 +1,384 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "compression.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+
+#include <proton/condition.h>
+#include <proton/connection.h>
+#include <proton/delivery.h>
+#include <proton/error.h>
+#include <proton/link.h>
+#include <proton/session.h>
+
+#ifdef HAVE_ZLIB
+
+#include <zlib.h>
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFLATE_LEVEL       1
+#define DEFLATE_WINDOW_BITS -13  // raw deflate with an 8KB history keeps the per link memory at ~80KB
+#define DEFLATE_MEM_LEVEL   6
+#define CHUNK_SIZE          16384
+
+// Adaptation: the ratio of a delivery is checked every ADAPT_WINDOW octets, a delivery is incompressible if it shrinks
+// by less than 1/16
+#define ADAPT_WINDOW      (64 * 1024)
+#define REPROBE_WINDOWS   16   // windows sent stored before compression is tried again
+#define MIN_ADAPT_OCTETS  512  // shorter deliveries do not change the back-off
+#define MAX_SKIP          256  // maximum number of deliveries sent uncompressed after an incompressible one
+
+// The history both ends start every delivery with: the encodings that begin most messages exchanged by routers, most
+// frequent last
+static const char preset_dictionary[] =
+    "amqp:not-found" "amqp:resource-limit-exceeded" "amqp:internal-error"
+    "application/octet-stream" "application/json" "text/plain"
+    "_topo/0/" "_edge/" "_$qd.edge_heartbeat" "_$qd.edge_addr_tracking" "$management"
+    "\x00\x53\x78\xc1" "\x00\x53\x77\xa1" "\x00\x53\x76\xd0"
+    "\x00\x53\x71\xc1" "\x00\x53\x72\xc1" "\x00\x53\x74\xc1\x00\x00\x00\x00\xa1"
+    "\x00\x53\x73\xc0\x00\x00\x00\x00\xa1" "\x00\x53\x70\xc0\x05\x05\x41\x40\x40\x40\x40"
+    "\x00\x80\x53\x4b\x50\x52\x2d\x2d\x52\x41\xd0\x00\x00\x00\x00\x00\x00\x00\x00\xa1"
+    "\x00\x53\x75\xb0\x00\x00\x00\x00";
+
+struct qd_compression_t {
+    z_stream      strm;
+    bool          outgoing;
+    bool          sending;         // the current outgoing delivery is compressed
+    bool          output_full;     // inflate stopped with the output full, it may hold more output
+    int           level;
+    uint32_t      stored_windows;  // windows sent at level 0 since the last probe
+    uint32_t      skip;            // deliveries still to be sent uncompressed
+    uint32_t      backoff;         // deliveries to skip after the next incompressible one
+    uint64_t      delivery_in;     // octets of the current delivery, before compression
+    uint64_t      delivery_out;    //   and after
+    uint64_t      window_in;
+    uint64_t      window_out;
+    unsigned char chunk[CHUNK_SIZE];  // outgoing: compressed output, incoming: compressed input
+};
+
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+static inline bool incompressible(uint64_t in, uint64_t out)
+{
+    return out * 16 > in * 15;
+}
+
+
+static qd_compression_t *codec_new(bool outgoing)
+{
+    qd_compression_t *codec = NEW(qd_compression_t);
+    ZERO(codec);
+    codec->outgoing = outgoing;
+    codec->backoff  = 1;
+
+    // zlib can only fail here if out of memory
+    int rc = outgoing
+        ? deflateInit2(&codec->strm, DEFLATE_LEVEL, Z_DEFLATED, DEFLATE_WINDOW_BITS, DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY)
+        : inflateInit2(&codec->strm, DEFLATE_WINDOW_BITS);
+    if (rc != Z_OK) {
+        qd_log(LOG_ROUTER, QD_LOG_CRITICAL, "Failed to initialize zlib (%d)", rc);
+        abort();
+    }
+    codec->level = DEFLATE_LEVEL;
+    return codec;
+}
+
+
+bool qd_compression_available(void)
+{
+    return true;
+}
+
+
+void qd_compression_free(qd_compression_t *codec)
+{
+    if (!codec)
+        return;
+    if (codec->outgoing)
+        deflateEnd(&codec->strm);
+    else
+        inflateEnd(&codec->strm);
+    free(codec);
+}
+
+
+// Send the output of deflate() until it has flushed all of its input
+//
+static ssize_t deflate_and_send(qd_compression_t *codec, pn_link_t *link, int flush)
+{
+    ssize_t sent = 0;
+    do {
+        codec->strm.next_out  = codec->chunk;
+        codec->strm.avail_out = CHUNK_SIZE;
+        int rc = deflate(&codec->strm, flush);
+        (void) rc;
+        assert(rc == Z_OK || rc == Z_BUF_ERROR);
+        size_t have = CHUNK_SIZE - codec->strm.avail_out;
+        if (have) {
+            ssize_t n = pn_link_send(link, (const char*) codec->chunk, have);
+            if (n < 0)
+                return n;
+            sent += have;
+        }
+    } while (codec->strm.avail_out == 0);
+    return sent;
+}
+
+
+static ssize_t set_level(qd_compression_t *codec, pn_link_t *link, int level)
+{
+    codec->strm.next_out  = codec->chunk;
+    codec->strm.avail_out = CHUNK_SIZE;
+    int rc = deflateParams(&codec->strm, level, Z_DEFAULT_STRATEGY);
+    (void) rc;
+    assert(rc == Z_OK);
+    codec->level = level;
+
+    // input is always flushed so there is seldom any output, but zlib may emit an empty block
+    size_t have = CHUNK_SIZE - codec->strm.avail_out;
+    if (have) {
+        ssize_t n = pn_link_send(link, (const char*) codec->chunk, have);
+        if (n < 0)
+            return n;
+    }
+    return have;
+}
+
+
+bool qd_compression_send_start(qd_compression_t **codecp, pn_delivery_t *delivery)
+{
+    qd_compression_t *codec = *codecp;
+    if (!codec) {
+        codec = codec_new(true);
+        *codecp = codec;
+    }
+
+    // back off from links that carry incompressible data
+    if (codec->sending && codec->delivery_in >= MIN_ADAPT_OCTETS) {
+        if (incompressible(codec->delivery_in, codec->delivery_out)) {
+            codec->skip    = codec->backoff;
+            codec->backoff = MIN(codec->backoff * 2, MAX_SKIP);
+        } else {
+            codec->backoff = 1;
+        }
+    }
+    codec->sending = false;
+    if (codec->skip) {
+        codec->skip--;
+        return false;
+    }
+
+    deflateReset(&codec->strm);
+    if (codec->level != DEFLATE_LEVEL) {
+        // nothing has been compressed since the reset: there is no output
+        codec->strm.next_out  = codec->chunk;
+        codec->strm.avail_out = CHUNK_SIZE;
+        deflateParams(&codec->strm, DEFLATE_LEVEL, Z_DEFAULT_STRATEGY);
+        codec->level = DEFLATE_LEVEL;
+    }
+    deflateSetDictionary(&codec->strm, (const Bytef*) preset_dictionary, sizeof(preset_dictionary) - 1);
+
+    codec->sending        = true;
+    codec->stored_windows = 0;
+    codec->delivery_in    = 0;
+    codec->delivery_out   = 0;
+    codec->window_in      = 0;
+    codec->window_out     = 0;
+    pn_delivery_set_message_format(delivery, QD_MESSAGE_FORMAT_DEFLATE);
+    return true;
+}
+
+
+ssize_t qd_compression_send(qd_compression_t *codec, pn_link_t *link, const char *bytes, size_t len,
+                            qdr_compression_stats_t *stats)
+{
+    assert(codec && codec->sending);
+    uint64_t start = now_ns();
+
+    codec->strm.next_in  = (Bytef*) bytes;
+    codec->strm.avail_in = len;
+    ssize_t out = deflate_and_send(codec, link, Z_SYNC_FLUSH);
+    if (out < 0)
+        return out;
+    assert(codec->strm.avail_in == 0);
+
+    codec->delivery_in  += len;
+    codec->delivery_out += out;
+    codec->window_in    += len;
+    codec->window_out   += out;
+
+    if (codec->window_in >= ADAPT_WINDOW) {
+        int level = codec->level;
+        if (level == 0) {
+            if (++codec->stored_windows >= REPROBE_WINDOWS)
+                level = DEFLATE_LEVEL;
+        } else if (incompressible(codec->window_in, codec->window_out)) {
+            level                 = 0;
+            codec->stored_windows = 0;
+        }
+        if (level != codec->level) {
+            ssize_t n = set_level(codec, link, level);
+            if (n < 0)
+                return n;
+            out                 += n;
+            codec->delivery_out += n;
+        }
+        codec->window_in  = 0;
+        codec->window_out = 0;
+    }
+
+    stats->plain_sent += len;
+    stats->wire_sent  += out;
+    stats->nsec       += now_ns() - start;
+    return len;
+}
+
+
+bool qd_compression_recv_start(qd_compression_t **codecp, pn_delivery_t *delivery)
+{
+    if (pn_delivery_message_format(delivery) != QD_MESSAGE_FORMAT_DEFLATE)
+        return false;
+
+    qd_compression_t *codec = *codecp;
+    if (!codec) {
+        codec = codec_new(false);
+        *codecp = codec;
+    }
+    inflateReset(&codec->strm);
+    inflateSetDictionary(&codec->strm, (const Bytef*) preset_dictionary, sizeof(preset_dictionary) - 1);
+    codec->strm.avail_in = 0;
+    codec->output_full   = false;
+    return true;
+}
+
+
+ssize_t qd_compression_recv(qd_compression_t *codec, pn_link_t *link, char *bytes, size_t size,
+                            qdr_compression_stats_t *stats)
+{
+    assert(codec && !codec->outgoing);
+    if (size == 0)
+        return pn_link_recv(link, bytes, 0);  // probe of the delivery state
+
+    uint64_t start = now_ns();
+    ssize_t  result;
+
+    codec->strm.next_out  = (Bytef*) bytes;
+    codec->strm.avail_out = size;
+    while (true) {
+        if (codec->strm.avail_in || codec->output_full) {
+            int rc = inflate(&codec->strm, Z_SYNC_FLUSH);
+            if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                pn_connection_t *conn = pn_session_connection(pn_link_session(link));
+                qd_log(LOG_ROUTER, QD_LOG_ERROR, "Closing connection: corrupt compressed delivery on link %s (%d: %s)",
+                       pn_link_name(link), rc, codec->strm.msg ? codec->strm.msg : "");
+                pn_condition_set_name(pn_connection_condition(conn), "amqp:decode-error");
+                pn_condition_set_description(pn_connection_condition(conn), "corrupt compressed delivery");
+                pn_connection_close(conn);
+                result = PN_ERR;
+                break;
+            }
+            size_t produced    = size - codec->strm.avail_out;
+            codec->output_full = codec->strm.avail_out == 0;
+            if (produced) {
+                result = produced;
+                stats->plain_received += produced;
+                break;
+            }
+        }
+
+        // all input has been decompressed
+        result = pn_link_recv(link, (char*) codec->chunk, CHUNK_SIZE);
+        if (result <= 0)
+            break;
+        stats->wire_received += result;
+        codec->strm.next_in  = codec->chunk;
+        codec->strm.avail_in = result;
+    }
+
+    stats->nsec += now_ns() - start;
+    return result;
+}
+
+
+size_t qd_compression_pending(const qd_compression_t *codec)
+{
+    return codec->strm.avail_in + (codec->output_full ? 1 : 0);
+}
+
+#else  // !HAVE_ZLIB
+
+bool qd_compression_available(void)
+{
+    return false;
+}
+
+
+void qd_compression_free(qd_compression_t *codec)
+{
+    assert(!codec);
+}
+
+
+bool qd_compression_send_start(qd_compression_t **codec, pn_delivery_t *delivery)
+{
+    return false;
+}
+
+
+ssize_t qd_compression_send(qd_compression_t *codec, pn_link_t *link, const char *bytes, size_t len,
+                            qdr_compression_stats_t *stats)
+{
+    assert(false);
+    return PN_ERR;
+}
+
+
+bool qd_compression_recv_start(qd_compression_t **codec, pn_delivery_t *delivery)
+{
+    // never negotiated, the peer cannot send compressed deliveries
+    return false;
+}
+
+
+ssize_t qd_compression_recv(qd_compression_t *codec, pn_link_t *link, char *bytes, size_t size,
+                            qdr_compression_stats_t *stats)
+{
+    assert(false);
+    return PN_ERR;
+}
+
+
+size_t qd_compression_pending(const qd_compression_t *codec)
+{
+    return 0;
+}
+
+#endif
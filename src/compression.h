@@ -0,0 +1,99 @@
+#ifndef __compression_h__
+#define __compression_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/** @file
+ * Compression of the message transfers of router to router connections.
+ *
+ * Compression is offered by the "qd.compression" connection property of inter-router and edge connections whose
+ * listener or connector is configured with compression "deflate", and is used when both ends offer it.  The sender
+ * then chooses per delivery: the payload of a compressed delivery is a raw deflate stream and the delivery carries the
+ * QD_MESSAGE_FORMAT_DEFLATE message format.
+ *
+ * Each link has its own compression context.  It is reset to a built-in preset dictionary at the start of every
+ * delivery so that a delivery can be decompressed on its own, whatever happened to the deliveries before it (aborted,
+ * discarded, sent uncompressed).  Every write is sync flushed so the receiver can forward streaming deliveries without
+ * waiting for more data.
+ *
+ * Compression is adaptive: a delivery that does not compress, such as TLS protected TCP stream data, switches to
+ * stored deflate blocks for the rest of its data, re-probing now and then, and the deliveries after it on the link are
+ * sent uncompressed for an exponentially growing number of deliveries.
+ *
+ * All functions must be called on the I/O thread of the link's connection.
+ */
+
+#include "qpid/dispatch/protocol_adaptor.h"
+
+#include <proton/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct qd_compression_t qd_compression_t;
+
+// Message format of a delivery with a compressed payload: vendor code "SKR", version 0
+#define QD_MESSAGE_FORMAT_DEFLATE 0x534b5200
+
+/**
+ * True if the router was built with compression support
+ */
+bool qd_compression_available(void);
+
+void qd_compression_free(qd_compression_t *codec);
+
+/**
+ * Start sending a delivery on a link of a connection with compression in use.  If compression is worth trying the
+ * delivery is marked with the compressed message format and its payload must be sent with qd_compression_send().
+ *
+ * @param codec the link's compression context, allocated on first use
+ * @param delivery the new outgoing delivery, nothing has been sent on it yet
+ * @return true if the payload of the delivery is compressed
+ */
+bool qd_compression_send_start(qd_compression_t **codec, pn_delivery_t *delivery);
+
+/**
+ * Compress and send payload octets of the current delivery.
+ *
+ * @return len, or the < 0 error code of pn_link_send()
+ */
+ssize_t qd_compression_send(qd_compression_t *codec, pn_link_t *link, const char *bytes, size_t len,
+                            qdr_compression_stats_t *stats);
+
+/**
+ * Start receiving a delivery on a link of a connection with compression in use.
+ *
+ * @return true if the payload of the delivery is compressed and must be received with qd_compression_recv()
+ */
+bool qd_compression_recv_start(qd_compression_t **codec, pn_delivery_t *delivery);
+
+/**
+ * Receive and decompress payload octets of the current delivery, a pn_link_recv() replacement.  On corrupt data the
+ * connection is closed with a decode error and PN_ERR is returned.
+ */
+ssize_t qd_compression_recv(qd_compression_t *codec, pn_link_t *link, char *bytes, size_t size,
+                            qdr_compression_stats_t *stats);
+
+/**
+ * Non-zero if received data is held by the decompressor, to be added to pn_delivery_pending().
+ */
+size_t qd_compression_pending(const qd_compression_t *codec);
+
+#endif
@@ -18,28 +18,28 @@
  */
 
 #include "qpid/dispatch/connection_counters.h"
-#include "qpid/dispatch/atomic.h"
+#include "qpid/dispatch/sharded_counter.h"
 
-atomic_uint_fast64_t qd_connection_counters[QD_PROTOCOL_TOTAL];
+static qd_sharded_counter_t qd_connection_counters[QD_PROTOCOL_TOTAL];
 
 void qd_connection_counter_inc(qd_protocol_t proto)
 {
     assert(proto < QD_PROTOCOL_TOTAL);
-    atomic_fetch_add_explicit(&qd_connection_counters[proto], 1, memory_order_relaxed);
+    qd_sharded_counter_add(&qd_connection_counters[proto], 1);
 }
 
 void qd_connection_counter_dec(qd_protocol_t proto)
 {
     assert(proto < QD_PROTOCOL_TOTAL);
-    uint64_t old = atomic_fetch_sub_explicit(&qd_connection_counters[proto], 1, memory_order_relaxed);
-    (void) old;
-    assert(old != 0);  // underflow!
+    // A connection may close on another thread than it opened on, so a shard may go below zero: only the sum of the
+    // shards is meaningful, and it cannot be checked for underflow while other threads are counting.
+    qd_sharded_counter_sub(&qd_connection_counters[proto], 1);
 }
 
 uint64_t qd_connection_count(qd_protocol_t proto)
 {
     assert(proto < QD_PROTOCOL_TOTAL);
-    return (uint64_t) atomic_load_explicit(&qd_connection_counters[proto], memory_order_relaxed);
+    return qd_sharded_counter_value(&qd_connection_counters[proto]);
 }
 
 
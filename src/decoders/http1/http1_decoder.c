@@ -94,6 +94,18 @@ const char * const decoder_state[] = {
 // Currently this is used for start lines, headers, and chunk headers.
 // Null terminated.
 //
+// The memory is only held while a line is being parsed: it is released at the end of each rx_data call that leaves no
+// partial line buffered, so an idle connection holds no parse buffer. Buffers of PARSE_BUFFER_POOLED_SIZE come from an
+// allocation pool shared by all the connections, only longer lines are held in memory from the heap.
+//
+#define PARSE_BUFFER_POOLED_SIZE 1024
+
+typedef struct parse_buffer_block_t {
+    unsigned char data[PARSE_BUFFER_POOLED_SIZE];
+} parse_buffer_block_t;
+ALLOC_DECLARE(parse_buffer_block_t);
+ALLOC_DEFINE(parse_buffer_block_t);
+
 typedef struct parse_buffer_t {
     unsigned char *data;
     uint32_t       mem_size;  // size of allocated memory for data, not content length!
@@ -141,6 +153,7 @@ struct decoder_t {
     bool is_client:1;
     bool is_chunked:1;
     bool is_http10:1;
+    bool message_ended:1;  // a message ended in the data being decoded, see qd_http1_decoder_connection_rx_message()
 
     // decoded headers
     bool hdr_transfer_encoding:1;
@@ -172,11 +185,36 @@ ALLOC_DEFINE(qd_http1_decoder_connection_t);
 static void ensure_buffer_size(parse_buffer_t *b, size_t required)
 {
     if (b->mem_size < required) {
-        b->mem_size = required;
-        if (!b->data)
-            b->data = qd_malloc(b->mem_size);
+        if (!b->data && required <= PARSE_BUFFER_POOLED_SIZE) {
+            b->data     = new_parse_buffer_block_t()->data;
+            b->mem_size = PARSE_BUFFER_POOLED_SIZE;
+        } else if (b->mem_size == PARSE_BUFFER_POOLED_SIZE) {
+            unsigned char *data = qd_malloc(required);
+            memcpy(data, b->data, b->length);
+            free_parse_buffer_block_t((parse_buffer_block_t *) b->data);
+            b->data     = data;
+            b->mem_size = required;
+        } else {
+            // heap buffers are always larger than PARSE_BUFFER_POOLED_SIZE
+            b->data     = b->data ? qd_realloc(b->data, required) : qd_malloc(required);
+            b->mem_size = required;
+        }
+    }
+}
+
+
+// Release the memory of the parse buffer, which must not hold a partial line
+//
+static void release_buffer(parse_buffer_t *b)
+{
+    if (b->data) {
+        if (b->mem_size == PARSE_BUFFER_POOLED_SIZE)
+            free_parse_buffer_block_t((parse_buffer_block_t *) b->data);
         else
-            b->data = qd_realloc(b->data, b->mem_size);
+            free(b->data);
+        b->data     = 0;
+        b->mem_size = 0;
+        b->length   = 0;
     }
 }
 
@@ -302,10 +340,10 @@ void qd_http1_decoder_connection_free(qd_http1_decoder_connection_t *conn)
         }
 
         decoder_reset(&conn->client);
-        free(conn->client.buffer.data);
+        release_buffer(&conn->client.buffer);
 
         decoder_reset(&conn->server);
-        free(conn->server.buffer.data);
+        release_buffer(&conn->server.buffer);
 
         free_qd_http1_decoder_connection_t(conn);
     }
@@ -321,6 +359,44 @@ static void debug_print_line(const char *prefix, const char *line)
 }
 
 
+// The line scanner examines 8 octets at a time (SWAR). These return a word with the high bit set in each octet of x
+// that is a LF, a NUL or greater than 0x7E (non USASCII) respectively. They are exact: no carry crosses octets.
+//
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_LOW7  0x7F7F7F7F7F7F7F7FULL
+#define SWAR_HIGH  0x8080808080808080ULL
+
+static inline uint64_t swar_zero_octets(uint64_t x)
+{
+    return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x | SWAR_LOW7);
+}
+
+static inline uint64_t swar_stop_octets(uint64_t x)
+{
+    const uint64_t lf     = swar_zero_octets(x ^ (SWAR_ONES * LF_TOKEN));
+    const uint64_t nul    = swar_zero_octets(x);
+    const uint64_t non_us = (x | ((x & SWAR_LOW7) + SWAR_ONES)) & SWAR_HIGH;  // octet >= 0x7F
+    return lf | nul | non_us;
+}
+
+// Return a pointer to the first LF or invalid USASCII octet in [ptr, end), or end if there is none
+//
+static const unsigned char *scan_line(const unsigned char *ptr, const unsigned char *end)
+{
+    while (end - ptr >= 8) {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+        if (swar_stop_octets(word))
+            break;  // the octet-wise loop below locates it, avoiding any dependency on byte order
+        ptr += 8;
+    }
+
+    while (ptr != end && *ptr != LF_TOKEN && *ptr != 0 && *ptr <= 0x7E)
+        ptr += 1;
+    return ptr;
+}
+
+
 // Read incoming http line starting at 'data' into the decoders parse buffer. Stop when a CRLF is parsed.
 //
 // Returns a pointer to the null-terminated line and advances *data/*length past the line. The returned line has the
@@ -333,20 +409,12 @@ static void debug_print_line(const char *prefix, const char *line)
 //
 static char *read_line(decoder_t *decoder, const unsigned char **data, size_t *length)
 {
-    const unsigned char *ptr = *data;
     const unsigned char *end = *data + *length;
+    const unsigned char *ptr = scan_line(*data, end);
 
-    while (ptr != end) {
-        if (*ptr == 0 || *ptr > 0x7E) { // invalid USASCII
-            parser_error(decoder->hconn, "protocol error: non USASCII data");
-            return 0;
-        }
-
-        if (*ptr == LF_TOKEN) {
-            break;
-        }
-
-        ptr += 1;
+    if (ptr != end && *ptr != LF_TOKEN) {  // invalid USASCII
+        parser_error(decoder->hconn, "protocol error: non USASCII data");
+        return 0;
     }
 
     // at this point if ptr == end no LF found and we need to store all the data
@@ -442,6 +510,7 @@ static bool message_done(qd_http1_decoder_connection_t *hconn, decoder_t *decode
     }
 
     decoder_reset(decoder);  // resets decode state to parse_request or parse_response
+    decoder->message_ended = true;
 
     if (hrs->response_complete && hrs->request_complete) {
         int rc = hconn->config->transaction_complete(hconn, hrs->user_context);
@@ -919,18 +988,16 @@ static bool parse_body(qd_http1_decoder_connection_t *hconn, struct decoder_t *d
 
 // Push inbound network data into the http1 protocol engine.
 //
-// This is the main decode loop.  All callbacks take place in the context of this call.
-//
+// This is the main decode loop.  All callbacks take place in the context of this call.  If consumed is set the loop
+// stops at the end of the first message that ends in data and *consumed is set to the octets decoded.
 //
-int qd_http1_decoder_connection_rx_data(qd_http1_decoder_connection_t *hconn, bool from_client, const unsigned char *data, size_t length)
+static int decode_data(qd_http1_decoder_connection_t *hconn, bool from_client, const unsigned char *data, size_t length, size_t *consumed)
 {
-    bool more = true;
-
-    if (hconn->parse_error) {
-        return -1;
-    }
-
+    bool              more    = true;
+    const size_t      total   = length;
     struct decoder_t *decoder = from_client ? &hconn->client : &hconn->server;
+
+    decoder->message_ended = false;
     while (more) {
 #if DEBUG_DECODER
         fprintf(stdout, "hconn: %p State: %s data length=%zu\n", (void *) hconn, decoder_state[decoder->state], length);
@@ -969,6 +1036,75 @@ int qd_http1_decoder_connection_rx_data(qd_http1_decoder_connection_t *hconn, bo
                 more = false;
                 break;
         }
+
+        if (consumed && decoder->message_ended)
+            more = false;
+    }
+
+    // Lines returned by read_line() are no longer referenced: keep the buffer only while it holds a partial line
+    if (decoder->buffer.length == 0)
+        release_buffer(&decoder->buffer);
+
+    if (consumed)
+        *consumed = total - length;
+    return !!hconn->parse_error ? -1 : 0;
+}
+
+
+int qd_http1_decoder_connection_rx_data(qd_http1_decoder_connection_t *hconn, bool from_client, const unsigned char *data, size_t length)
+{
+    if (hconn->parse_error) {
+        return -1;
+    }
+    return decode_data(hconn, from_client, data, length, 0);
+}
+
+
+int qd_http1_decoder_connection_rx_message(qd_http1_decoder_connection_t *hconn, bool from_client,
+                                           const unsigned char *data, size_t length, size_t *consumed)
+{
+    *consumed = 0;
+    if (hconn->parse_error) {
+        return -1;
+    }
+    return decode_data(hconn, from_client, data, length, consumed);
+}
+
+
+uint64_t qd_http1_decoder_connection_skippable(const qd_http1_decoder_connection_t *hconn, bool from_client)
+{
+    const decoder_t *decoder = from_client ? &hconn->client : &hconn->server;
+
+    if (decoder->state == HTTP1_DECODE_BODY || decoder->state == HTTP1_DECODE_CHUNK_DATA)
+        return (uint64_t) decoder->body_length;
+    return 0;
+}
+
+
+int qd_http1_decoder_connection_rx_skip(qd_http1_decoder_connection_t *hconn, bool from_client, size_t length)
+{
+    if (hconn->parse_error) {
+        return -1;
+    }
+
+    decoder_t *decoder = from_client ? &hconn->client : &hconn->server;
+    if (length > qd_http1_decoder_connection_skippable(hconn, from_client)) {
+        parser_error(hconn, "skipped octets are not message body");
+        return -1;
+    }
+
+    if (length && hconn->config->rx_body) {
+        int rc = hconn->config->rx_body(hconn, decoder->hrs->user_context, decoder->is_client, 0, length);
+        if (rc) {
+            parser_error(hconn, "rx_body callback failed");
+            return -1;
+        }
+    }
+    decoder->body_length -= length;
+
+    // The end of a chunk's data is parsed with the CRLF that follows it, see parse_chunk_data()
+    if (decoder->body_length == 0 && decoder->state == HTTP1_DECODE_BODY) {
+        message_done(hconn, decoder);
     }
 
     return !!hconn->parse_error ? -1 : 0;
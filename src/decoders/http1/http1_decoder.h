@@ -91,7 +91,7 @@ struct qd_http1_decoder_config_t {
 
     // (Optional) invoked as the HTTP1 message body is parsed. length is set to the number of data octets in the
     // body buffer. The body buffer lifecycle ends on return from this call - if the caller needs to preserve the body
-    // data it must copy it.
+    // data it must copy it. body is NULL for octets passed to qd_http1_decoder_connection_rx_skip().
     //
     int (*rx_body)(qd_http1_decoder_connection_t *hconn, uintptr_t request_context, bool from_client, const unsigned char *body, size_t length);
 
@@ -134,4 +134,25 @@ void qd_http1_decoder_connection_free(qd_http1_decoder_connection_t *conn);
 //
 int qd_http1_decoder_connection_rx_data(qd_http1_decoder_connection_t *conn, bool from_client, const unsigned char *data, size_t len);
 
+// As qd_http1_decoder_connection_rx_data() but decoding stops at the end of the first message that ends within data.
+// *consumed is set to the number of octets of data that were decoded: if it is less than len the message ended at that
+// offset (the message_done callback has been invoked) and the remaining octets, which belong to the messages that
+// follow, have not been decoded.
+//
+int qd_http1_decoder_connection_rx_message(qd_http1_decoder_connection_t *conn, bool from_client,
+                                           const unsigned char *data, size_t len, size_t *consumed);
+
+// Return the number of octets that immediately follow in the stream from the client (or server) that are message body
+// data. The decoder only needs to know their number: the caller may pass them by length to
+// qd_http1_decoder_connection_rx_skip() instead of passing them to qd_http1_decoder_connection_rx_data(). The body of a
+// response that ends when the connection closes is INT64_MAX octets long.
+//
+uint64_t qd_http1_decoder_connection_skippable(const qd_http1_decoder_connection_t *conn, bool from_client);
+
+// Account for 'len' octets of message body that are not passed to the decoder. len must not be larger than the value
+// returned by qd_http1_decoder_connection_skippable(). The return value is the same as for
+// qd_http1_decoder_connection_rx_data().
+//
+int qd_http1_decoder_connection_rx_skip(qd_http1_decoder_connection_t *conn, bool from_client, size_t len);
+
 #endif // __http1_decoder_h__
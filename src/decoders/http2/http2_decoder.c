@@ -38,6 +38,8 @@ const uint8_t http2_client_prefix[HTTP2_CLIENT_PREFIX_LEN] = {
 #define HTTP2_FRAME_HEADER_LENGTH          9  // This is the frame header length. Every frame in http2 has a 9 byte header
 #define HTTP2_FRAME_STREAM_ID_LENGTH       4  // Stream id is 31 bytes
 #define HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH 5  // Stream id and flags field together is 40 bytes
+#define HTTP2_HEADER_PRIORITY_LENGTH       5  // HEADERS frame stream dependency (4 bytes) and weight (1 byte)
+#define HTTP2_HEADER_PREFIX_MAX_LENGTH     (HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH + 1 + HTTP2_HEADER_PRIORITY_LENGTH)
 
 typedef enum qd_http2_frame_type {
     FRAME_TYPE_DATA     = 0x00,  // HTTP2 DATA frames
@@ -55,6 +57,14 @@ typedef enum {
     HTTP2_DECODE_ERROR                      // Decoding error has occurred.
 } qd_http2_decoder_state_t;
 
+// The parts of a HEADERS frame following the frame length and type, parsed in turn by
+// parse_request_response_header_frame()
+typedef enum {
+    HTTP2_HEADER_PREFIX,   // flags, stream id and the optional pad length and priority fields
+    HTTP2_HEADER_BLOCK,    // the header block fragment, inflated as it arrives
+    HTTP2_HEADER_PADDING   // padding following the header block fragment
+} qd_http2_header_part_t;
+
 
 struct qd_http2_decoder_t {
     qd_http2_decoder_connection_t *conn_state;             // Reference to the decoder's connection state information.
@@ -67,6 +77,14 @@ struct qd_http2_decoder_t {
     uint32_t                       frame_length_processed; // How much of the (9 byte frame header + Frame payload length) have we already processed
     uint32_t                       frame_payload_length;   // What is the payload length for the frame ? This does not include the 9 byte frame header.
     bool                           end_stream;
+    // HEADERS frame processing. Only the prefix is reassembled across input buffers, the header block fragment is
+    // passed to the inflater straight from the input.
+    qd_http2_header_part_t         header_part;
+    uint8_t                        header_prefix[HTTP2_HEADER_PREFIX_MAX_LENGTH];
+    uint32_t                       header_prefix_size;
+    uint32_t                       header_block_remaining; // octets of the header block fragment not yet inflated
+    uint32_t                       header_padding_remaining;
+    uint32_t                       stream_id;
 };
 
 struct qd_http2_decoder_connection_t {
@@ -96,6 +114,11 @@ static void reset_decoder_frame_info(qd_http2_decoder_t *decoder)
     decoder->frame_payload_length   = 0;
     decoder->frame_type             = FRAME_TYPE_NONE;
     decoder->end_stream             = false;
+    decoder->header_part              = HTTP2_HEADER_PREFIX;
+    decoder->header_prefix_size       = 0;
+    decoder->header_block_remaining   = 0;
+    decoder->header_padding_remaining = 0;
+    decoder->stream_id                = 0;
 }
 
 /**
@@ -253,30 +276,21 @@ void qd_http2_decoder_connection_free(qd_http2_decoder_connection_t *conn_state)
 }
 
 /**
- * Decompresses headers that were compressed using HPACK header compression.
- * Uses nghttp2 provided API to uncompress the compressed header fields.
- * The passed in pointer to data must point to the beginning of the complete header block fragment that contains the compressed header fields.
+ * Inflates part of a header block fragment that was compressed using HPACK header compression.
+ * Uses the nghttp2 inflater, which keeps the state of a header field that is split across calls, so the fragment can be
+ * passed in as it arrives. in_final must be set on the call that passes the end of the fragment.
+ * Returns 0 on success or the negative nghttp2 error code.
  */
-static int decompress_headers(qd_http2_decoder_t *decoder, uint32_t stream_id, const uint8_t *data, size_t length)
+static int inflate_header_block(qd_http2_decoder_t *decoder, const uint8_t *data, size_t length, bool in_final)
 {
-    if (length == 0) {
-        qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] decompress_headers - passed in length = 0", decoder->conn_state->conn_id);
-        return -1;
-    }
     qd_http2_decoder_connection_t *conn_state = decoder->conn_state;
-    if (conn_state->callbacks && conn_state->callbacks->on_begin_header) {
-        conn_state->callbacks->on_begin_header(conn_state,
-                                               conn_state->user_context,
-                                               decoder->is_client,
-                                               stream_id);
-    }
     for (;;) {
         nghttp2_nv nv;
         int inflate_flags = 0;
         size_t proclen;
-        int rv = nghttp2_hd_inflate_hd2(decoder->inflater, &nv, &inflate_flags, data, length, 1);
+        int rv = nghttp2_hd_inflate_hd2(decoder->inflater, &nv, &inflate_flags, data, length, in_final ? 1 : 0);
         if (rv < 0) {
-            qd_log(LOG_HTTP2_DECODER, QD_LOG_ERROR, "[C%"PRIu64"] decompress_headers - decompression error rv=%i", decoder->conn_state->conn_id, rv);
+            qd_log(LOG_HTTP2_DECODER, QD_LOG_ERROR, "[C%"PRIu64"] inflate_header_block - decompression error rv=%i", decoder->conn_state->conn_id, rv);
             return rv;
         }
         proclen = (size_t)rv;
@@ -289,7 +303,7 @@ static int decompress_headers(qd_http2_decoder_t *decoder, uint32_t stream_id, c
                 conn_state->callbacks->on_header(conn_state,
                                                  conn_state->user_context,
                                                  decoder->is_client,
-                                                 stream_id,
+                                                 decoder->stream_id,
                                                  nv.name,
                                                  nv.namelen,
                                                  nv.value,
@@ -305,14 +319,6 @@ static int decompress_headers(qd_http2_decoder_t *decoder, uint32_t stream_id, c
             break;
         }
     }
-
-    if (conn_state->callbacks && conn_state->callbacks->on_end_headers) {
-        conn_state->callbacks->on_end_headers(conn_state,
-                                             conn_state->user_context,
-                                             decoder->is_client,
-                                             stream_id,
-                                             decoder->end_stream);
-    }
     return 0;
 }
 
@@ -420,121 +426,127 @@ static bool parse_data_frame(qd_http2_decoder_t *decoder, const uint8_t **data,
     }
 }
 
-bool get_request_headers(qd_http2_decoder_t *decoder)
+static void header_frame_error(qd_http2_decoder_t *decoder, const char *reason)
 {
-    qd_decoder_buffer_t *scratch_buffer = &decoder->scratch_buffer;
-    if (scratch_buffer->size == 0) {
-        qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] get_request_headers - failure due to zero scratch buffer size, moving decoder state to HTTP2_DECODE_ERROR", decoder->conn_state->conn_id);
-        static char error[106];
-        snprintf(error, sizeof(error), "get_request_headers - failure due to zero scratch buffer size, moving decoder state to HTTP2_DECODE_ERROR");
-        reset_decoder_frame_info(decoder);
-        reset_scratch_buffer(&decoder->scratch_buffer);
-        parser_error(decoder, error);
-        return false;
-    }
-    bool end_headers, is_padded, has_priority;
-    get_header_flags(scratch_buffer->bytes[0], &decoder->end_stream, &end_headers, &is_padded, &has_priority);
-    decoder->frame_length_processed += 1;
-    scratch_buffer->offset += 1;
-    uint32_t stream_id = get_stream_identifier(scratch_buffer->bytes + scratch_buffer->offset);
-    qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] get_request_headers - is_client=%i, decoder->end_stream=%i, end_headers=%i, is_padded=%i, has_priority=%i, stream_id=%" PRIu32, decoder->conn_state->conn_id, decoder->is_client, decoder->end_stream, end_headers, is_padded, has_priority, stream_id);
-    scratch_buffer->offset += HTTP2_FRAME_STREAM_ID_LENGTH;
-    decoder->frame_length_processed += HTTP2_FRAME_STREAM_ID_LENGTH;
-    uint8_t pad_length = 0;
-    if (is_padded) {
-        pad_length = get_pad_length(scratch_buffer->bytes + scratch_buffer->offset);
-        // Move one byte to account for pad length
-        scratch_buffer->offset += 1;
-        decoder->frame_length_processed += 1;
-    }
+    qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] parse_request_response_header_frame - failure, moving decoder state to HTTP2_DECODE_ERROR", decoder->conn_state->conn_id);
+    reset_decoder_frame_info(decoder);
+    parser_error(decoder, reason);
+}
 
-    if (has_priority) {
-        // Skip the Stream Dependency field if the priority flag is set
-        // Stream Dependency field is 4 octets.
-        scratch_buffer->offset += 4;
-        decoder->frame_length_processed += 4;
+/**
+ * Reassemble the HEADERS frame fields that precede the header block fragment. Their length depends on the flags, the
+ * first of them. Returns true once they are all present and valid.
+ */
+static bool parse_header_prefix(qd_http2_decoder_t *decoder, const uint8_t **data, size_t *length)
+{
+    bool end_headers, is_padded = false, has_priority = false;
+    uint32_t prefix_length = HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH;
 
-        // Skip the weight field if the priority field is true.
-        scratch_buffer->offset += 1;
-        decoder->frame_length_processed += 1;
+    while (*length > 0) {
+        if (decoder->header_prefix_size > 0) {
+            get_header_flags(decoder->header_prefix[0], &decoder->end_stream, &end_headers, &is_padded, &has_priority);
+            prefix_length = HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH + (is_padded ? 1 : 0) + (has_priority ? HTTP2_HEADER_PRIORITY_LENGTH : 0);
+        }
+        if (decoder->header_prefix_size == prefix_length)
+            break;
+        size_t to_copy = MIN(*length, (size_t) (decoder->header_prefix_size > 0 ? prefix_length - decoder->header_prefix_size : 1));
+        memcpy(decoder->header_prefix + decoder->header_prefix_size, *data, to_copy);
+        decoder->header_prefix_size     += to_copy;
+        decoder->frame_length_processed += to_copy;
+        *data   += to_copy;
+        *length -= to_copy;
     }
 
-    //
-    // Before the call to decompress_headers(), we need to make sure that there is some data left in the scratch buffer before we decompress it.
-    //
-    int buffer_data_size         = scratch_buffer->size - scratch_buffer->offset;
-    int contains_pad_length      = scratch_buffer->size - pad_length;
-    int pad_length_offset        = scratch_buffer->size - pad_length - scratch_buffer->offset;
-    bool valid_pad_length        = contains_pad_length > 0;
-    bool valid_buffer_data       = buffer_data_size > 0;
-    bool valid_pad_length_offset = pad_length_offset > 0;
-    if (decoder->frame_payload_length == 0 || !valid_buffer_data || !valid_pad_length || !valid_pad_length_offset) {
-        qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] get_request_headers - failure, moving decoder state to HTTP2_DECODE_ERROR", decoder->conn_state->conn_id);
-        static char error[130];
-        snprintf(error, sizeof(error), "get_request_headers - either request or response header was received with zero payload or contains bogus data, stopping decoder");
-        reset_decoder_frame_info(decoder);
-        reset_scratch_buffer(&decoder->scratch_buffer);
-        parser_error(decoder, error);
+    if (decoder->header_prefix_size == 0)
         return false;
-    }
-
-    // Take out the padding bytes from the end of the scratch buffer
-    scratch_buffer->size = scratch_buffer->size - pad_length;
-
-    // We are now finally at a place which matters to us - The Header block fragment. We will look thru and decompress it so we can get the request/response headers.
-    int rv = decompress_headers(decoder, stream_id, scratch_buffer->bytes + scratch_buffer->offset, scratch_buffer->size - scratch_buffer->offset);
-    if (rv < 0) {
-        qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] get_request_headers - failure, moving decoder state to HTTP2_DECODE_ERROR", decoder->conn_state->conn_id);
-        static char error[105];
-        snprintf(error, sizeof(error), "get_request_headers - failure, moving decoder state to HTTP2_DECODE_ERROR nghttp2 error code=%i", rv);
-        reset_decoder_frame_info(decoder);
-        reset_scratch_buffer(&decoder->scratch_buffer);
-        parser_error(decoder, error);
+    get_header_flags(decoder->header_prefix[0], &decoder->end_stream, &end_headers, &is_padded, &has_priority);
+    prefix_length = HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH + (is_padded ? 1 : 0) + (has_priority ? HTTP2_HEADER_PRIORITY_LENGTH : 0);
+    if (decoder->header_prefix_size < prefix_length)
+        return false;  // need more data
+
+    decoder->stream_id = get_stream_identifier(decoder->header_prefix + 1);
+    qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] parse_header_prefix - is_client=%i, decoder->end_stream=%i, end_headers=%i, is_padded=%i, has_priority=%i, stream_id=%" PRIu32, decoder->conn_state->conn_id, decoder->is_client, decoder->end_stream, end_headers, is_padded, has_priority, decoder->stream_id);
+
+    // The pad length and priority fields are part of the frame payload, the header block fragment must not be empty
+    uint32_t fields_length = prefix_length - HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH;
+    uint32_t pad_length    = is_padded ? get_pad_length(decoder->header_prefix + HTTP2_FRAME_FLAGS_STREAM_ID_LENGTH) : 0;
+    if ((uint64_t) fields_length + pad_length >= decoder->frame_payload_length) {
+        static char error[130];
+        snprintf(error, sizeof(error), "parse_header_prefix - either request or response header was received with zero payload or contains bogus data, stopping decoder");
+        header_frame_error(decoder, error);
         return false;
     }
-    else {
-        qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] get_request_headers - success, moving decoder state to HTTP2_DECODE_FRAME_HEADER", decoder->conn_state->conn_id);
-        decoder_new_state(decoder, HTTP2_DECODE_FRAME_HEADER);
-        reset_decoder_frame_info(decoder);
-        reset_scratch_buffer(&decoder->scratch_buffer);
-        return true;
-    }
+    decoder->header_block_remaining   = decoder->frame_payload_length - fields_length - pad_length;
+    decoder->header_padding_remaining = pad_length;
+    return true;
 }
 
+/**
+ * Parse a request or response HEADERS frame. The header block fragment is decompressed as it arrives, without being
+ * copied. decode() may be called with the frame split at any point.
+ */
 static bool parse_request_response_header_frame(qd_http2_decoder_t *decoder, const uint8_t **data, size_t *length)
 {
     if (*length == 0)
         return false;
-    size_t bytes_to_copy = decoder->frame_length - decoder->frame_length_processed;
-    if (*length < bytes_to_copy) {
-        int allocated = move_to_scratch_buffer(&decoder->scratch_buffer, *data, *length);
-        if (allocated == -1) {
-            parser_error(decoder, "scratch buffer size exceeded 65535 bytes, stopping decoder");
-            return false;
-        }
-        decoder->frame_length_processed += *length;
-        *data += *length;
-        *length = 0;
-        return false;
-    } else {
-        int allocated = move_to_scratch_buffer(&decoder->scratch_buffer, *data, bytes_to_copy);
-        if (allocated == -1) {
-            parser_error(decoder, "scratch buffer size exceeded 65535 bytes, stopping decoder");
+
+    qd_http2_decoder_connection_t *conn_state = decoder->conn_state;
+
+    if (decoder->header_part == HTTP2_HEADER_PREFIX) {
+        if (!parse_header_prefix(decoder, data, length))
             return false;
+        decoder->header_part = HTTP2_HEADER_BLOCK;
+        if (conn_state->callbacks && conn_state->callbacks->on_begin_header) {
+            conn_state->callbacks->on_begin_header(conn_state,
+                                                   conn_state->user_context,
+                                                   decoder->is_client,
+                                                   decoder->stream_id);
         }
-        *data += bytes_to_copy;
-        *length -= bytes_to_copy;
-        if ((decoder->frame_length_processed + bytes_to_copy) == decoder->frame_length) {
-            bool header_success = get_request_headers(decoder);
-            if (!header_success)
+    }
+
+    if (decoder->header_part == HTTP2_HEADER_BLOCK) {
+        size_t block_length = MIN(*length, (size_t) decoder->header_block_remaining);
+        bool   in_final     = block_length == decoder->header_block_remaining;
+        if (block_length > 0) {
+            // We are now finally at a place which matters to us - The Header block fragment. We will look thru and
+            // decompress it so we can get the request/response headers.
+            int rv = inflate_header_block(decoder, *data, block_length, in_final);
+            if (rv < 0) {
+                static char error[130];
+                snprintf(error, sizeof(error), "parse_request_response_header_frame - failure, moving decoder state to HTTP2_DECODE_ERROR nghttp2 error code=%i", rv);
+                header_frame_error(decoder, error);
                 return false;
+            }
+            decoder->header_block_remaining -= block_length;
+            decoder->frame_length_processed += block_length;
+            *data   += block_length;
+            *length -= block_length;
         }
-        if (*length > 0) {
-            return true; // More bytes remain to be processed, continue processing.
-        } else {
-            return false;
+        if (!in_final)
+            return false;  // need more data
+
+        if (conn_state->callbacks && conn_state->callbacks->on_end_headers) {
+            conn_state->callbacks->on_end_headers(conn_state,
+                                                 conn_state->user_context,
+                                                 decoder->is_client,
+                                                 decoder->stream_id,
+                                                 decoder->end_stream);
         }
+        decoder->header_part = HTTP2_HEADER_PADDING;
     }
+
+    size_t padding = MIN(*length, (size_t) decoder->header_padding_remaining);
+    decoder->header_padding_remaining -= padding;
+    decoder->frame_length_processed   += padding;
+    *data   += padding;
+    *length -= padding;
+    if (decoder->header_padding_remaining > 0)
+        return false;  // need more data
+
+    qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] parse_request_response_header_frame - success, moving decoder state to HTTP2_DECODE_FRAME_HEADER", decoder->conn_state->conn_id);
+    decoder_new_state(decoder, HTTP2_DECODE_FRAME_HEADER);
+    reset_decoder_frame_info(decoder);
+    return *length > 0;
 }
 
 /**
@@ -573,7 +585,13 @@ static bool parse_frame_header_from_scratch_buffer(qd_http2_decoder_t *decoder)
         qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] parse_frame_header - moving decoder state to HTTP2_DECODE_REQUEST_RESPONSE_HEADER", decoder->conn_state->conn_id);
         decoder_new_state(decoder, HTTP2_DECODE_REQUEST_RESPONSE_HEADER);
     } else if (decoder->frame_type == FRAME_TYPE_DATA) { // HTTP2 DATA frames.
-        decoder_new_state(decoder, HTTP2_DECODE_FRAME_DATA);
+        qd_http2_decoder_connection_t *conn_state = decoder->conn_state;
+        if (conn_state->callbacks && conn_state->callbacks->on_data) {
+            decoder_new_state(decoder, HTTP2_DECODE_FRAME_DATA);
+        } else {
+            // Nobody is interested in the stream id and flags, jump straight over the rest of the frame
+            decoder_new_state(decoder, HTTP2_DECODE_SKIP_FRAME_PAYLOAD);
+        }
     } else if (decoder->frame_type == FRAME_TYPE_OTHER) {
         qd_log(LOG_HTTP2_DECODER, QD_LOG_DEBUG, "[C%"PRIu64"] parse_frame_header - moving decoder state to HTTP2_DECODE_SKIP_FRAME_PAYLOAD", decoder->conn_state->conn_id);
         decoder_new_state(decoder, HTTP2_DECODE_SKIP_FRAME_PAYLOAD);
@@ -751,6 +769,36 @@ int decode(qd_http2_decoder_connection_t *conn_state, bool from_client, const ui
 }
 
 
+uint32_t qd_http2_decoder_connection_skippable(const qd_http2_decoder_connection_t *conn_state, bool from_client)
+{
+    const qd_http2_decoder_t *decoder = from_client ? &conn_state->client_decoder : &conn_state->server_decoder;
+
+    if (decoder->state == HTTP2_DECODE_SKIP_FRAME_PAYLOAD)
+        return decoder->frame_length - decoder->frame_length_processed;
+    return 0;
+}
+
+
+int qd_http2_decoder_connection_rx_skip(qd_http2_decoder_connection_t *conn_state, bool from_client, size_t length)
+{
+    if (length == 0 || conn_state->parse_error)
+        return conn_state->parse_error ? -1 : 0;
+
+    qd_http2_decoder_t *decoder = from_client ? &conn_state->client_decoder : &conn_state->server_decoder;
+    if (length > qd_http2_decoder_connection_skippable(conn_state, from_client)) {
+        parser_error(decoder, "skipped octets are not frame payload");
+        return -1;
+    }
+
+    decoder->frame_length_processed += length;
+    if (decoder->frame_length_processed == decoder->frame_length) {
+        reset_decoder_frame_info(decoder);
+        decoder_new_state(decoder, HTTP2_DECODE_FRAME_HEADER);
+    }
+    return 0;
+}
+
+
 //----------------------------------
 // Helper functions for testing only
 //----------------------------------
@@ -116,6 +116,21 @@ struct qd_http2_decoder_callbacks_t {
  */
 int decode(qd_http2_decoder_connection_t *state, bool from_client, const uint8_t *data, size_t length);
 
+/**
+ * Returns the number of octets that immediately follow in the stream from the client (or server) that the decoder jumps
+ * over without looking at them: the rest of a DATA frame or of any other frame that is not a HEADERS frame. The caller
+ * may pass these octets by length to qd_http2_decoder_connection_rx_skip() instead of passing them to decode().
+ * @param - qd_http2_decoder_connection_t - connection state
+ * @param - from_client - indicates if the stream is the one from the client or from the server
+ */
+uint32_t qd_http2_decoder_connection_skippable(const qd_http2_decoder_connection_t *conn_state, bool from_client);
+
+/**
+ * Account for length octets that are not passed to decode(). length must not be larger than the value returned by
+ * qd_http2_decoder_connection_skippable(). The return value is the same as for decode().
+ */
+int qd_http2_decoder_connection_rx_skip(qd_http2_decoder_connection_t *conn_state, bool from_client, size_t length);
+
 
 /**
  * Creates a new connection state object and assign it a user context.
@@ -31,13 +31,18 @@
 #include "message_private.h"
 #include "policy.h"
 #include "router_private.h"
+#include "spool.h"
 
 #include "qpid/dispatch/alloc.h"
 #include "qpid/dispatch/ctools.h"
 #include "qpid/dispatch/discriminator.h"
+#include "qpid/dispatch/flow_histograms.h"
+#include "qpid/dispatch/intern.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/server.h"
 #include "qpid/dispatch/static_assert.h"
 #include "qpid/dispatch/tls_common.h"
+#include "qpid/dispatch/vanflow.h"
 
 #include <dlfcn.h>
 #include <inttypes.h>
@@ -117,6 +122,9 @@ qd_dispatch_t *qd_dispatch(const char *python_pkgdir, bool test_hooks)
     qd_entity_cache_initialize();   /* Must be first */
     qd_alloc_initialize();
     qd_log_initialize();
+    qd_metrics_initialize();
+    qd_intern_initialize();
+    qd_flow_histograms_initialize();
     qd_tls_initialize();
     qd_error_initialize();
     if (qd_error_code()) { qd_dispatch_free(qd); return 0; }
@@ -219,6 +227,56 @@ static void qd_dispatch_set_router_default_distribution(qd_dispatch_t *qd, char
     free(distribution);
 }
 
+// Takes ownership of weights string: a comma-separated list of positive weights for priorities 0, 1, ...
+static void qd_dispatch_set_priority_lane_weights(qd_dispatch_t *qd, char *weights)
+{
+    char *cursor = weights;
+    for (int priority = 0; cursor && *cursor && priority < QDR_N_PRIORITIES; priority++) {
+        char *end;
+        long  weight = strtol(cursor, &end, 10);
+        if (end == cursor || weight < 1 || (*end != ',' && *end != '\0')) {
+            qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value \"%s\" for priorityLaneWeights, using defaults from priority %d",
+                   weights, priority);
+            break;
+        }
+        qd->priority_lane_weights[priority] = (int) weight;
+        cursor = *end ? end + 1 : end;
+    }
+    free(weights);
+}
+
+// Bind the threads of a role to the CPUs listed in a router attribute.  Returns false if the attribute is not set or
+// not valid.
+static bool qd_dispatch_set_thread_cpus(qd_entity_t *entity, const char *attribute, sys_thread_role_t role)
+{
+    char *cpus  = qd_entity_opt_string(entity, attribute, 0);
+    bool  bound = false;
+    if (cpus && *cpus) {
+        bound = sys_thread_set_role_cpus(role, cpus) == 0;
+        if (!bound)
+            qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value \"%s\" for %s, threads will not be bound", cpus, attribute);
+    }
+    free(cpus);
+    return bound;
+}
+
+// Set the router-wide sampling policy for a vanflow flow record type from a pair of router attributes
+static void qd_dispatch_set_flow_sampling(qd_entity_t *entity, vflow_record_type_t record_type,
+                                          const char *interval_attribute, const char *rate_attribute)
+{
+    long interval = qd_entity_opt_long(entity, interval_attribute, 1);
+    long rate_max = qd_entity_opt_long(entity, rate_attribute, 0);
+    if (interval < 1 || interval > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for %s, recording every flow", interval, interval_attribute);
+        interval = 1;
+    }
+    if (rate_max < 0 || rate_max > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for %s, using no limit", rate_max, rate_attribute);
+        rate_max = 0;
+    }
+    vflow_set_sampling(record_type, (uint32_t) interval, (uint32_t) rate_max);
+}
+
 qd_error_t qd_dispatch_configure_router(qd_dispatch_t *qd, qd_entity_t *entity)
 {
     qd_dispatch_set_router_default_distribution(qd, qd_entity_opt_string(entity, "defaultDistribution", 0)); QD_ERROR_RET();
@@ -239,14 +297,23 @@ qd_error_t qd_dispatch_configure_router(qd_dispatch_t *qd, qd_entity_t *entity)
         qd_generate_discriminator(qd->router_id + strlen(qd->router_id));
     }
     qd->thread_count = qd_entity_opt_long(entity, "workerThreads", 4); QD_ERROR_RET();
+    qd->thread_max = qd_entity_opt_long(entity, "workerThreadsMax", 0); QD_ERROR_RET();
+    if (qd->thread_max && qd->thread_max < qd->thread_count) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for workerThreadsMax, below workerThreads, using %d",
+               qd->thread_max, qd->thread_count);
+        qd->thread_max = qd->thread_count;
+    }
+    qd->thread_max = MAX(qd->thread_max, qd->thread_count);
     char *data_conn_count_str = qd_entity_opt_string(entity, "dataConnectionCount", "auto"); QD_ERROR_RET();
 
+    bool data_conn_count_auto = true;
     if (!strcmp("auto", data_conn_count_str)) {
         // The user has explicitly requested 'auto'.
         qd->data_connection_count = (qd->thread_count + 1) / 2;
         qd_log(LOG_ROUTER, QD_LOG_INFO, "Inter-router data connections calculated at %d ", qd->data_connection_count);
     } else if (1 == sscanf(data_conn_count_str, "%u", &qd->data_connection_count)) {
         // The user has requested a specific number of connections.
+        data_conn_count_auto = false;
         qd_log(LOG_ROUTER, QD_LOG_INFO, "Inter-router data connections set to %d ", qd->data_connection_count);
     } else {
         // The user has entered a non-numeric value that is not 'auto'.
@@ -257,11 +324,159 @@ qd_error_t qd_dispatch_configure_router(qd_dispatch_t *qd, qd_entity_t *entity)
     }
     free(data_conn_count_str);
 
+    // With 'auto' the calculated count is only the floor: connectors add data connections, up to one per worker
+    // thread the pool may grow to, while the existing ones keep their I/O threads saturated.
+    qd->data_connection_max = qd->data_connection_count;
+    if (data_conn_count_auto)
+        qd->data_connection_max = MAX(qd->data_connection_count, (uint32_t) qd->thread_max);
+
     qd->timestamps_in_utc = qd_entity_opt_bool(entity, "timestampsInUTC", false); QD_ERROR_RET();
     qd->timestamp_format = qd_entity_opt_string(entity, "timestampFormat", 0); QD_ERROR_RET();
+    qd->async_logging = qd_entity_opt_bool(entity, "asyncLogging", false); QD_ERROR_RET();
+    qd->observer_threads = qd_entity_opt_long(entity, "observerThreads", 0); QD_ERROR_RET();
+    qd->observer_queue_octets = qd_entity_opt_long(entity, "observerQueueOctets", 16 * 1024 * 1024); QD_ERROR_RET();
+    qd->observer_cpu_budget = qd_entity_opt_long(entity, "observerCpuBudget", 0); QD_ERROR_RET();
+    if (qd_entity_opt_bool(entity, "lockProfiling", false))
+        sys_lock_profiling_enable();
+    QD_ERROR_RET();
     qd->metadata = qd_entity_opt_string(entity, "metadata", 0); QD_ERROR_RET();
     qd->terminate_tcp_conns   = qd_entity_opt_bool(entity, "dropTcpConnections", true);
     QD_ERROR_RET();
+    qd->latency_aware_balancing = qd_entity_opt_bool(entity, "latencyAwareBalancing", false);
+    QD_ERROR_RET();
+    qd->enforce_message_ttl = qd_entity_opt_bool(entity, "enforceMessageTtl", false);
+    QD_ERROR_RET();
+    long transfer_quantum = qd_entity_opt_long(entity, "transferQuantumOctets", 0); QD_ERROR_RET();
+    if (transfer_quantum < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for transferQuantumOctets, using 0", transfer_quantum);
+        transfer_quantum = 0;
+    }
+    qd->transfer_quantum_octets = (size_t) transfer_quantum;
+    long overload_queue_delay = qd_entity_opt_long(entity, "overloadQueueDelayMilliseconds", 0); QD_ERROR_RET();
+    if (overload_queue_delay < 0 || overload_queue_delay > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for overloadQueueDelayMilliseconds, using 0", overload_queue_delay);
+        overload_queue_delay = 0;
+    }
+    qd->overload_queue_delay_ms = (uint32_t) overload_queue_delay;
+    long overload_lag = qd_entity_opt_long(entity, "overloadEventLoopLagMilliseconds", 0); QD_ERROR_RET();
+    if (overload_lag < 0 || overload_lag > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for overloadEventLoopLagMilliseconds, using 0", overload_lag);
+        overload_lag = 0;
+    }
+    qd->overload_event_loop_lag_ms = (uint32_t) overload_lag;
+    long liveness = qd_entity_opt_long(entity, "neighborLivenessMilliseconds", 0); QD_ERROR_RET();
+    if (liveness < 0 || liveness > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for neighborLivenessMilliseconds, using 0", liveness);
+        liveness = 0;
+    }
+    qd->neighbor_liveness_ms = (uint32_t) liveness;
+    long publish = qd_entity_opt_long(entity, "statsPublishSeconds", 0); QD_ERROR_RET();
+    if (publish < 0 || publish > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for statsPublishSeconds, using 0", publish);
+        publish = 0;
+    }
+    qd->stats_publish_seconds = (uint32_t) publish;
+    long busy_poll = qd_entity_opt_long(entity, "busyPollMicroseconds", 0); QD_ERROR_RET();
+    if (busy_poll < 0 || busy_poll > 1000000) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for busyPollMicroseconds, using 0", busy_poll);
+        busy_poll = 0;
+    }
+    qd->busy_poll_usec = (uint32_t) busy_poll;
+    qd->busy_poll_threads = qd_entity_opt_long(entity, "busyPollThreads", 0); QD_ERROR_RET();
+    if (qd->busy_poll_threads < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for busyPollThreads, using 0", qd->busy_poll_threads);
+        qd->busy_poll_threads = 0;
+    }
+    qd->busy_poll_core = qd_entity_opt_bool(entity, "busyPollCoreThread", true); QD_ERROR_RET();
+    long idle_conn = qd_entity_opt_long(entity, "idleConnectionSeconds", 0); QD_ERROR_RET();
+    if (idle_conn < 0 || idle_conn > 86400) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for idleConnectionSeconds, using 0", idle_conn);
+        idle_conn = 0;
+    }
+    qd->idle_connection_seconds = (uint32_t) idle_conn;
+    qd->edge_uplinks = qd_entity_opt_long(entity, "edgeUplinks", 1); QD_ERROR_RET();
+    if (qd->edge_uplinks < 1 || qd->edge_uplinks > QD_EDGE_MAX_UPLINKS) {
+        int edge_uplinks = MIN(MAX(qd->edge_uplinks, 1), QD_EDGE_MAX_UPLINKS);
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for edgeUplinks, using %d", qd->edge_uplinks, edge_uplinks);
+        qd->edge_uplinks = edge_uplinks;
+    }
+    qd->vflow_compact_records = qd_entity_opt_bool(entity, "vflowCompactRecords", false);
+    QD_ERROR_RET();
+    qd->vflow_export_file = qd_entity_opt_string(entity, "vflowExportFile", 0); QD_ERROR_RET();
+    long vflow_export_octets = qd_entity_opt_long(entity, "vflowExportOctets", 16 * 1024 * 1024); QD_ERROR_RET();
+    if (vflow_export_octets <= 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for vflowExportOctets, using %d", vflow_export_octets,
+               16 * 1024 * 1024);
+        vflow_export_octets = 16 * 1024 * 1024;
+    }
+    qd->vflow_export_octets = (size_t) vflow_export_octets;
+    qd_dispatch_set_flow_sampling(entity, VFLOW_RECORD_BIFLOW_TPORT, "flowSampleInterval", "flowRecordRateMax"); QD_ERROR_RET();
+    qd_dispatch_set_flow_sampling(entity, VFLOW_RECORD_BIFLOW_APP, "appFlowSampleInterval", "appFlowRecordRateMax"); QD_ERROR_RET();
+    qd_dispatch_set_priority_lane_weights(qd, qd_entity_opt_string(entity, "priorityLaneWeights", 0)); QD_ERROR_RET();
+    qd->streaming_link_pool_min = qd_entity_opt_long(entity, "streamingLinkPoolMin", 0); QD_ERROR_RET();
+    if (qd->streaming_link_pool_min < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for streamingLinkPoolMin, using 0", qd->streaming_link_pool_min);
+        qd->streaming_link_pool_min = 0;
+    }
+    qd->dynamic_addr_pool_size = qd_entity_opt_long(entity, "dynamicAddressPoolSize", 0); QD_ERROR_RET();
+    if (qd->dynamic_addr_pool_size < 0 || qd->dynamic_addr_pool_size > QD_DYNAMIC_ADDR_POOL_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for dynamicAddressPoolSize, using 0", qd->dynamic_addr_pool_size);
+        qd->dynamic_addr_pool_size = 0;
+    }
+    qd->mobile_addr_hold_down = qd_entity_opt_long(entity, "mobileAddressHoldDownSeconds", 1); QD_ERROR_RET();
+    if (qd->mobile_addr_hold_down < 1) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for mobileAddressHoldDownSeconds, using 1", qd->mobile_addr_hold_down);
+        qd->mobile_addr_hold_down = 1;
+    }
+    qd->mobile_addr_max_update = qd_entity_opt_long(entity, "mobileAddressMaxUpdate", 0); QD_ERROR_RET();
+    if (qd->mobile_addr_max_update < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for mobileAddressMaxUpdate, using no limit", qd->mobile_addr_max_update);
+        qd->mobile_addr_max_update = 0;
+    }
+    qd->addr_watch_interval = qd_entity_opt_long(entity, "addressWatchIntervalSeconds", 0); QD_ERROR_RET();
+    if (qd->addr_watch_interval < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %d for addressWatchIntervalSeconds, using 0", qd->addr_watch_interval);
+        qd->addr_watch_interval = 0;
+    }
+    long uct_max_slots = qd_entity_opt_long(entity, "cutThroughMaxSlots", UCT_SLOT_COUNT_MAX); QD_ERROR_RET();
+    if (uct_max_slots < UCT_SLOT_COUNT || uct_max_slots > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for cutThroughMaxSlots, using %d", uct_max_slots, UCT_SLOT_COUNT_MAX);
+        uct_max_slots = UCT_SLOT_COUNT_MAX;
+    }
+    qd_message_set_cutthrough_max_slots((uint32_t) uct_max_slots);
+
+    long alloc_profile_rate = qd_entity_opt_long(entity, "allocProfileRate", 0); QD_ERROR_RET();
+    if (alloc_profile_rate < 0 || alloc_profile_rate > UINT32_MAX) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for allocProfileRate, using 0", alloc_profile_rate);
+        alloc_profile_rate = 0;
+    }
+    qd_alloc_set_profile_rate((uint32_t) alloc_profile_rate);
+
+    long max_memory = qd_entity_opt_long(entity, "maxMemory", 0); QD_ERROR_RET();
+    if (max_memory < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for maxMemory, using the platform memory size", max_memory);
+        max_memory = 0;
+    }
+    qd_alloc_set_memory_budget((uint64_t) max_memory);
+
+    char *spool_dir = qd_entity_opt_string(entity, "spoolDirectory", 0); QD_ERROR_RET();
+    long spool_threshold = qd_entity_opt_long(entity, "spoolThresholdOctets", 4 * 1024 * 1024); QD_ERROR_RET();
+    if (spool_threshold < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "Bad value %ld for spoolThresholdOctets, using %d", spool_threshold,
+               4 * 1024 * 1024);
+        spool_threshold = 4 * 1024 * 1024;
+    }
+    qd_spool_configure(spool_dir, (size_t) spool_threshold);
+    free(spool_dir);
+
+    // Thread placement must be configured before any of the router threads is started
+    const bool core_bound = qd_dispatch_set_thread_cpus(entity, "coreThreadCpus", SYS_THREAD_CORE); QD_ERROR_RET();
+    qd_dispatch_set_thread_cpus(entity, "workerThreadCpus", SYS_THREAD_PROACTOR); QD_ERROR_RET();
+    qd_dispatch_set_thread_cpus(entity, "vflowThreadCpus", SYS_THREAD_VFLOW); QD_ERROR_RET();
+    qd_dispatch_set_thread_cpus(entity, "httpThreadCpus", SYS_THREAD_LWS_HTTP); QD_ERROR_RET();
+    const bool isolate_core = qd_entity_opt_bool(entity, "isolateCoreThread", false); QD_ERROR_RET();
+    if (isolate_core && (!core_bound || sys_thread_isolate_role(SYS_THREAD_CORE) != 0))
+        qd_log(LOG_ROUTER, QD_LOG_ERROR, "isolateCoreThread requires coreThreadCpus to leave CPUs for the other threads, ignored");
 
     if (! qd->sasl_config_path) {
         qd->sasl_config_path = qd_entity_opt_string(entity, "saslConfigDir", 0); QD_ERROR_RET();
@@ -344,6 +559,11 @@ QD_EXPORT void qd_dispatch_policy_host_pattern_remove(qd_dispatch_t *qd, void *p
     free(hostPattern);
 }
 
+QD_EXPORT void qd_dispatch_policy_settings_cache_flush(qd_dispatch_t *qd)
+{
+    qd_policy_settings_cache_flush(qd->policy);
+}
+
 QD_EXPORT char * qd_dispatch_policy_host_pattern_lookup(qd_dispatch_t *qd, void *py_obj)
 {
     char *hostPattern = py_string_2_c(py_obj);
@@ -355,6 +575,8 @@ QD_EXPORT char * qd_dispatch_policy_host_pattern_lookup(qd_dispatch_t *qd, void
 qd_error_t qd_dispatch_prepare(qd_dispatch_t *qd)
 {
     qd_log_global_options(qd->timestamp_format, qd->timestamps_in_utc);
+    if (qd->async_logging)
+        qd_log_enable_async();
     qd->server             = qd_server(qd, qd->thread_count, qd->router_id, qd->sasl_config_path, qd->sasl_config_name);
     qd->router             = qd_router(qd, qd->router_mode, qd->router_area, qd->router_id);
     qd->connection_manager = qd_connection_manager(qd);
@@ -407,6 +629,11 @@ void qd_dispatch_free(qd_dispatch_t *qd)
     Py_XDECREF((PyObject*) qd->agent);
     qd_router_free(qd->router);
     qd_server_free(qd->server);
+    qd_spool_finalize();
+    qd_flow_histograms_finalize();
+    qd_python_free_metrics();
+    qd_intern_finalize();
+    qd_metrics_finalize();
     qd_tls_finalize();
     qd_log_finalize();
     qd_alloc_finalize();
@@ -416,6 +643,7 @@ void qd_dispatch_free(qd_dispatch_t *qd)
     qd_dispatch_set_router_van_id(qd, NULL);
     qd_iterator_finalize();
     free(qd->timestamp_format);
+    free(qd->vflow_export_file);
     free(qd->metadata);
     sys_atomic_destroy(&global_delivery_id);
 
@@ -442,6 +670,7 @@ qd_connection_manager_t *qd_dispatch_connection_manager(const qd_dispatch_t *qd)
 QD_EXPORT void qd_router_setup_late(qd_dispatch_t *qd)
 {
     qd->router->tracemask   = qd_tracemask();
+    qd_message_set_trace_resolver(qd->router->tracemask);
     qd->router->router_core = qdr_core(qd, qd->router->router_mode, qd->router->router_area, qd->router->router_id, qd->router->van_id);
     qd_router_python_setup(qd->router);
     qd_timer_schedule(qd->router->timer, 1000);
@@ -464,6 +693,11 @@ uint32_t qd_dispatch_get_data_connection_count(const qd_dispatch_t *dispatch)
     return qd->data_connection_count;
 }
 
+uint32_t qd_dispatch_get_data_connection_max(const qd_dispatch_t *dispatch)
+{
+    return qd->data_connection_max;
+}
+
 qd_server_t *qd_dispatch_get_server(const qd_dispatch_t *dispatch)
 {
     return qd->server;
@@ -36,9 +36,20 @@ typedef struct qd_config_address_t   qd_config_address_t;
 #include "router_private.h"
 #include "server_private.h"
 
+#include "qpid/dispatch/amqp.h"
 #include "qpid/dispatch/connection_manager.h"
 #include "qpid/dispatch/router.h"
 
+/**
+ * Upper bound of the edgeUplinks attribute, the number of interior connections an edge router uses at the same time
+ */
+#define QD_EDGE_MAX_UPLINKS 4
+
+/**
+ * Upper bound of the dynamicAddressPoolSize attribute
+ */
+#define QD_DYNAMIC_ADDR_POOL_MAX 64
+
 struct qd_dispatch_t {
     qd_server_t             *server;
     qd_router_t             *router;
@@ -48,7 +59,9 @@ struct qd_dispatch_t {
     qd_address_treatment_t   default_treatment;
     qd_router_mode_t         router_mode;
     int       thread_count;
+    int       thread_max;             ///< Worker threads the pool may grow to under load, thread_count: fixed pool
     uint32_t  data_connection_count;
+    uint32_t  data_connection_max;    // upper bound when the count adapts to load, else data_connection_count
     char     *sasl_config_path;
     char     *sasl_config_name;
     char     *router_area;
@@ -58,6 +71,31 @@ struct qd_dispatch_t {
     char     *metadata;
     bool      timestamps_in_utc;
     bool      terminate_tcp_conns;
+    bool      latency_aware_balancing;
+    bool      enforce_message_ttl;      ///< Drop messages whose header ttl ran out before they were sent on
+    size_t    transfer_quantum_octets;  ///< Octets an outgoing link sends of a delivery before yielding, 0: no limit
+    uint32_t  overload_queue_delay_ms;     ///< Core action queue delay at which the router is overloaded, 0: not monitored
+    uint32_t  overload_event_loop_lag_ms;  ///< I/O event-loop lag at which the router is overloaded, 0: not monitored
+    uint32_t  neighbor_liveness_ms;     ///< Silence after which a neighbor router is declared lost, 0: HELLO only
+    uint32_t  stats_publish_seconds;    ///< Interval of the statistics the core publishes for readers, 0: on request
+    uint32_t  busy_poll_usec;           ///< Time idle threads poll for work before blocking, 0: block at once
+    int       busy_poll_threads;        ///< Worker threads that busy-poll, zero for all of them
+    bool      busy_poll_core;           ///< The core thread busy-polls too
+    uint32_t  idle_connection_seconds;  ///< Quiet period after which a TCP connection sheds its read buffers, 0: never
+    int       edge_uplinks;             ///< Active edge connections to interior routers, one means active/standby
+    bool      async_logging;            ///< Write log output from a dedicated thread
+    int       observer_threads;         ///< Protocol observer worker threads, zero observes on the I/O threads
+    long      observer_queue_octets;    ///< Payload octets that may be queued to the observer threads
+    int       observer_cpu_budget;      ///< Percent of one CPU the protocol observers may use, zero for no limit
+    bool      vflow_compact_records;    ///< Emit vanflow records with the compact encoding
+    char     *vflow_export_file;        ///< Export vanflow records to this memory mapped ring file, NULL: none
+    size_t    vflow_export_octets;      ///< Size of the export ring
+    int       streaming_link_pool_min;  ///< Idle streaming links kept attached per streaming connection
+    int       dynamic_addr_pool_size;   ///< Detached dynamic addresses kept for reuse per connection and direction
+    int       priority_lane_weights[QDR_N_PRIORITIES];  ///< Configured weights, zero where not set
+    int       mobile_addr_hold_down;                    ///< Seconds between differential mobile address updates
+    int       mobile_addr_max_update;                   ///< Maximum addresses per differential update, zero for no limit
+    int       addr_watch_interval;                      ///< Minimum seconds between address watch deliveries
 };
 
 qd_dispatch_t *qd_dispatch_get_dispatch(void);
@@ -0,0 +1,309 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "python_private.h"  // must be first!
+
+#include "qpid/dispatch/flight_recorder.h"
+
+#include "qpid/dispatch/internal/export.h"
+#include "qpid/dispatch/threading.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EVENT_MASK       (QD_FLIGHT_RECORDER_EVENTS - 1)
+#define THREAD_NAME_MAX  16
+
+_Static_assert((QD_FLIGHT_RECORDER_EVENTS & EVENT_MASK) == 0, "QD_FLIGHT_RECORDER_EVENTS must be a power of two");
+
+//
+// A slot is a seqlock: stamp is odd while the owning thread writes the event and is (seq + 1) * 2 once event number seq
+// of the ring is complete.  Readers copy the event and keep the copy only if the stamp was that value before and after.
+//
+typedef struct flight_slot_t {
+    _Atomic uint64_t  stamp;
+    qd_flight_event_t event;
+} flight_slot_t;
+
+typedef struct flight_ring_t {
+    flight_slot_t    slots[QD_FLIGHT_RECORDER_EVENTS];
+    _Atomic uint64_t head;    // count of events ever recorded, written only by the owning thread
+    _Atomic uint64_t base;    // head when the current owner claimed the ring, older events are not shown
+    atomic_bool      in_use;  // claimed by a running thread, released when it exits
+    char             thread_name[THREAD_NAME_MAX];
+} flight_ring_t;
+
+static flight_ring_t        rings[QD_FLIGHT_RECORDER_THREADS];
+static atomic_int           ring_count;
+static flight_ring_t        no_ring;  // marks a thread that found the table full
+
+static __thread flight_ring_t *thread_ring;
+
+// releases the ring of an exiting thread, see claim_ring()
+static pthread_key_t  ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static const char *event_type_names[QD_FLIGHT_EVENT_TYPE_COUNT] = {
+    [QD_FLIGHT_NONE]          = "none",
+    [QD_FLIGHT_ACTION]        = "action",
+    [QD_FLIGHT_CONN_OPENED]   = "connection-opened",
+    [QD_FLIGHT_CONN_CLOSED]   = "connection-closed",
+    [QD_FLIGHT_Q2_BLOCKED]    = "q2-blocked",
+    [QD_FLIGHT_Q3_BLOCKED]    = "q3-blocked",
+    [QD_FLIGHT_WINDOW_CLOSED] = "window-closed",
+    [QD_FLIGHT_LONG_HANDLER]  = "long-handler",
+};
+
+
+const char *qd_flight_event_type_name(qd_flight_event_type_t type)
+{
+    return type < QD_FLIGHT_EVENT_TYPE_COUNT ? event_type_names[type] : "unknown";
+}
+
+
+uint64_t qd_flight_recorder_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void release_ring(void *ring)
+{
+    // the events stay readable until another thread claims the ring
+    atomic_store_explicit(&((flight_ring_t *) ring)->in_use, false, memory_order_release);
+}
+
+static void create_ring_key(void)
+{
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// Number of rings that have been claimed and are safe to read
+//
+static int rings_in_use(void)
+{
+    int count = atomic_load_explicit(&ring_count, memory_order_acquire);
+    return count < QD_FLIGHT_RECORDER_THREADS ? count : QD_FLIGHT_RECORDER_THREADS;
+}
+
+//
+// Take over the ring of a thread that has exited or, if there is none, a ring never used before.  A ring keeps its
+// head across owners so that the stamps of its slots stay unique.
+//
+static flight_ring_t *claim_ring(void)
+{
+    flight_ring_t *ring  = 0;
+    int            count = rings_in_use();
+
+    for (int i = 0; i < count && !ring; ++i) {
+        bool idle = false;
+        if (atomic_compare_exchange_strong(&rings[i].in_use, &idle, true))
+            ring = &rings[i];
+    }
+
+    if (!ring) {
+        int index = atomic_fetch_add_explicit(&ring_count, 1, memory_order_acq_rel);
+        if (index >= QD_FLIGHT_RECORDER_THREADS)
+            return &no_ring;
+        ring = &rings[index];
+        atomic_store_explicit(&ring->in_use, true, memory_order_relaxed);
+    }
+
+    const char *name = sys_thread_name(0);
+    strncpy(ring->thread_name, name ? name : "unknown", THREAD_NAME_MAX - 1);
+    atomic_store_explicit(&ring->base, atomic_load_explicit(&ring->head, memory_order_relaxed), memory_order_release);
+
+    pthread_once(&ring_key_once, create_ring_key);
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+
+void qd_flight_record_at(uint64_t timestamp_ns, qd_flight_event_type_t type, uint64_t arg0, uint64_t arg1, uint32_t arg2)
+{
+    flight_ring_t *ring = thread_ring;
+    if (!ring)
+        ring = thread_ring = claim_ring();
+    if (ring == &no_ring)
+        return;
+
+    uint64_t           head  = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    flight_slot_t     *slot  = &ring->slots[head & EVENT_MASK];
+    qd_flight_event_t *event = &slot->event;
+
+    atomic_store_explicit(&slot->stamp, (head + 1) * 2 - 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event->timestamp_ns = timestamp_ns;
+    event->arg0         = arg0;
+    event->arg1         = arg1;
+    event->arg2         = arg2;
+    event->type         = type;
+    atomic_store_explicit(&slot->stamp, (head + 1) * 2, memory_order_release);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+// Copy event number seq of the ring.  Returns false if the slot has been overwritten or is being written, the copy
+// would then mix two events (e.g. a newer integer arg0 with an action label type).
+//
+static bool read_event(flight_ring_t *ring, uint64_t seq, qd_flight_event_t *copy)
+{
+    flight_slot_t *slot  = &ring->slots[seq & EVENT_MASK];
+    const uint64_t stamp = (seq + 1) * 2;
+
+    if (atomic_load_explicit(&slot->stamp, memory_order_acquire) != stamp)
+        return false;
+    *copy = slot->event;
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->stamp, memory_order_relaxed) == stamp;
+}
+
+
+// The oldest event of the current owner of the ring still held by the ring
+//
+static uint64_t ring_first(flight_ring_t *ring, uint64_t head)
+{
+    uint64_t base = atomic_load_explicit(&ring->base, memory_order_acquire);
+    uint64_t kept = head > QD_FLIGHT_RECORDER_EVENTS ? head - QD_FLIGHT_RECORDER_EVENTS : 0;
+    return base > kept ? base : kept;
+}
+
+
+//
+// The dump routines may run in a signal handler: see man signal-safety(7). They must not call stdio or allocate.
+//
+
+static void write_str(int fd, const char *str)
+{
+    ssize_t ignore = write(fd, str, strlen(str));
+    (void) ignore;
+}
+
+static void write_uint(int fd, uint64_t value)
+{
+    char  buffer[24];
+    char *ptr = &buffer[sizeof(buffer) - 1];
+
+    *ptr = 0;
+    do {
+        *--ptr = (value % 10) + '0';
+        value /= 10;
+    } while (value > 0);
+    write_str(fd, ptr);
+}
+
+static void write_event(int fd, const qd_flight_event_t *event)
+{
+    write_uint(fd, event->timestamp_ns);
+    write_str(fd, " ");
+    write_str(fd, qd_flight_event_type_name(event->type));
+    write_str(fd, " ");
+    if (event->type == QD_FLIGHT_ACTION && event->arg0)
+        write_str(fd, (const char *) (uintptr_t) event->arg0);
+    else
+        write_uint(fd, event->arg0);
+    write_str(fd, " ");
+    write_uint(fd, event->arg1);
+    write_str(fd, " ");
+    write_uint(fd, event->arg2);
+    write_str(fd, "\n");
+}
+
+
+void qd_flight_recorder_dump(int fd)
+{
+    int count = rings_in_use();
+
+    write_str(fd, "*** FLIGHT RECORDER (time-ns event arg0 arg1 arg2) now=");
+    write_uint(fd, qd_flight_recorder_now_ns());
+    write_str(fd, " ***\n");
+
+    for (int i = 0; i < count; ++i) {
+        flight_ring_t *ring  = &rings[i];
+        uint64_t       head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t       first = ring_first(ring, head);
+
+        write_str(fd, "Thread ");
+        write_str(fd, ring->thread_name);
+        write_str(fd, " (");
+        write_uint(fd, head - atomic_load_explicit(&ring->base, memory_order_acquire));
+        write_str(fd, " events recorded)\n");
+        for (uint64_t seq = first; seq < head; ++seq) {
+            qd_flight_event_t event;
+            if (read_event(ring, seq, &event))
+                write_event(fd, &event);
+        }
+    }
+    write_str(fd, "*** END FLIGHT RECORDER ***\n");
+}
+
+
+/// Return the recorded events of all threads, oldest first, as a list of [timestamp_ns, thread name, event name, arg0,
+/// arg1, arg2]. Only the newest 'limit' events are returned if limit is not negative. Called by management agent.
+QD_EXPORT PyObject *qd_flight_recorder_py(long limit)
+{
+    if (PyErr_Occurred()) return NULL;
+    int       count = rings_in_use();
+    PyObject *list  = PyList_New(0);
+    if (!list) return NULL;
+
+    for (int i = 0; i < count; ++i) {
+        flight_ring_t *ring  = &rings[i];
+        uint64_t       head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t       first = ring_first(ring, head);
+
+        for (uint64_t seq = first; seq < head; ++seq) {
+            qd_flight_event_t event;
+            if (!read_event(ring, seq, &event))
+                continue;
+            PyObject *arg0 = event.type == QD_FLIGHT_ACTION
+                ? PyUnicode_FromString(event.arg0 ? (const char *) (uintptr_t) event.arg0 : "")
+                : PyLong_FromUnsignedLongLong(event.arg0);
+            PyObject *py_event = Py_BuildValue("[KssNKI]", (unsigned long long) event.timestamp_ns, ring->thread_name,
+                                               qd_flight_event_type_name(event.type), arg0,
+                                               (unsigned long long) event.arg1, (unsigned int) event.arg2);
+            if (!py_event || PyList_Append(list, py_event) != 0) {
+                Py_XDECREF(py_event);
+                Py_DECREF(list);
+                return NULL;
+            }
+            Py_DECREF(py_event);
+        }
+    }
+
+    // Timestamps come first, so this orders the events of all threads by time
+    if (PyList_Sort(list) != 0) {
+        Py_DECREF(list);
+        return NULL;
+    }
+
+    Py_ssize_t size = PyList_Size(list);
+    if (limit >= 0 && size > limit) {
+        PyObject *newest = PyList_GetSlice(list, size - limit, size);
+        Py_DECREF(list);
+        list = newest;
+    }
+    return list;
+}
@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "qpid/dispatch/flow_histograms.h"
+#include "qpid/dispatch/metrics.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+static qd_metric_t *flow_histograms[QD_PROTOCOL_TOTAL][QD_FLOW_HIST_TOTAL];
+
+void qd_flow_histograms_initialize(void)
+{
+    char name[64];
+    for (int proto = 0; proto < QD_PROTOCOL_TOTAL; ++proto) {
+        for (int hist = 0; hist < QD_FLOW_HIST_TOTAL; ++hist) {
+            snprintf(name, sizeof(name), "qdr_%s_%s", qd_protocol_name(proto), qd_flow_histogram_name(hist));
+            flow_histograms[proto][hist] = qd_metric(QD_METRIC_HISTOGRAM, name, 0, 0);
+        }
+    }
+}
+
+void qd_flow_histograms_finalize(void)
+{
+    for (int proto = 0; proto < QD_PROTOCOL_TOTAL; ++proto) {
+        for (int hist = 0; hist < QD_FLOW_HIST_TOTAL; ++hist) {
+            qd_metric_free(flow_histograms[proto][hist]);
+            flow_histograms[proto][hist] = 0;
+        }
+    }
+}
+
+void qd_flow_histogram_record(qd_protocol_t proto, qd_flow_histogram_t hist, uint64_t value)
+{
+    assert(proto < QD_PROTOCOL_TOTAL && hist < QD_FLOW_HIST_TOTAL);
+    qd_metric_observe(flow_histograms[proto][hist], value);
+}
+
+const char *qd_flow_histogram_name(qd_flow_histogram_t hist)
+{
+    switch (hist) {
+        case QD_FLOW_HIST_CONNECT:
+            return "flow_connect_microseconds";
+        case QD_FLOW_HIST_FIRST_BYTE:
+            return "flow_first_byte_microseconds";
+        case QD_FLOW_HIST_DURATION:
+            return "flow_duration_microseconds";
+        case QD_FLOW_HIST_THROUGHPUT:
+            return "flow_octets_per_second";
+        case QD_FLOW_HIST_TOTAL:
+            break;
+    }
+    assert(false);
+    return "unknown";
+}
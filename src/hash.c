@@ -32,6 +32,7 @@ typedef struct qd_hash_item_t {
         const void *val_const;
     } v;
     qd_hash_handle_t *handle;
+    uint32_t          hash;  // full hash of key, compared before the key itself
 } qd_hash_item_t;
 
 ALLOC_DECLARE(qd_hash_item_t);
@@ -44,10 +45,23 @@ typedef struct bucket_t {
 } bucket_t;
 
 
+//
+// The table grows by doubling once the average chain length exceeds QD_HASH_MAX_LOAD.  Growth is
+// incremental: the previous bucket array is kept in old_buckets and its chains are moved into the
+// new array a few buckets at a time on each insert/remove.  Old buckets below migrate_next have
+// already been moved.  The batch_size passed to qd_hash() sets the number of old buckets migrated
+// per operation.
+//
+#define QD_HASH_MAX_LOAD 2
+
 struct qd_hash_t {
     bucket_t     *buckets;
     unsigned int  bucket_count;
     unsigned int  bucket_mask;
+    bucket_t     *old_buckets;
+    unsigned int  old_bucket_count;
+    unsigned int  old_bucket_mask;
+    unsigned int  migrate_next;
     int           batch_size;
     size_t        size;
     int           is_const;
@@ -55,7 +69,6 @@ struct qd_hash_t {
 
 
 struct qd_hash_handle_t {
-    bucket_t    *bucket;
     qd_hash_item_t *item;
 };
 
@@ -63,21 +76,76 @@ ALLOC_DECLARE(qd_hash_handle_t);
 ALLOC_DEFINE(qd_hash_handle_t);
 
 
-static bucket_t *qd_hash_get_bucket_iter(qd_hash_t *h, qd_iterator_t *key)
+static uint32_t qd_hash_compute_str(const unsigned char *key)
+{
+    return qd_hash_bytes(key, strlen((const char *) key));
+}
+
+
+// find the bucket that currently holds (or would hold) items with the given hash
+static bucket_t *qd_hash_get_bucket(qd_hash_t *h, uint32_t hash)
+{
+    if (h->old_buckets) {
+        uint32_t old_idx = hash & h->old_bucket_mask;
+        if (old_idx >= h->migrate_next)
+            return &h->old_buckets[old_idx];
+    }
+    return &h->buckets[hash & h->bucket_mask];
+}
+
+
+// move up to 'count' old buckets into the current bucket array, releasing the old array when done
+static void qd_hash_migrate(qd_hash_t *h, unsigned int count)
 {
-    uint32_t idx = qd_iterator_hash_view(key) & h->bucket_mask;
-    return &h->buckets[idx];
+    if (!h->old_buckets)
+        return;
+
+    while (count-- && h->migrate_next < h->old_bucket_count) {
+        bucket_t       *old  = &h->old_buckets[h->migrate_next++];
+        qd_hash_item_t *item = DEQ_HEAD(old->items);
+        while (item) {
+            DEQ_REMOVE_HEAD(old->items);
+            DEQ_INSERT_TAIL(h->buckets[item->hash & h->bucket_mask].items, item);
+            item = DEQ_HEAD(old->items);
+        }
+    }
+
+    if (h->migrate_next == h->old_bucket_count) {
+        free(h->old_buckets);
+        h->old_buckets      = 0;
+        h->old_bucket_count = 0;
+        h->old_bucket_mask  = 0;
+        h->migrate_next     = 0;
+    }
 }
 
 
-static bucket_t *qd_hash_get_bucket_str(qd_hash_t *h, const unsigned char *key)
+// start doubling the bucket array if the table is overloaded
+static void qd_hash_maybe_grow(qd_hash_t *h)
 {
-    uint32_t hash = HASH_INIT;
-    while (*key) {
-        hash = HASH_COMPUTE(hash, *key++);
+    if (h->size <= (size_t) h->bucket_count * QD_HASH_MAX_LOAD || h->bucket_count >= (1u << 31))
+        return;
+
+    //
+    // A previous resize is still in progress: finish it before starting the next one.  With the
+    // default batch sizes this only happens when inserts arrive much faster than the migration rate.
+    //
+    qd_hash_migrate(h, h->old_bucket_count);
+
+    bucket_t *buckets = NEW_ARRAY(bucket_t, h->bucket_count * 2);
+    if (!buckets)
+        return;  // keep running with longer chains
+    for (unsigned int i = 0; i < h->bucket_count * 2; i++) {
+        DEQ_INIT(buckets[i].items);
     }
 
-    return &h->buckets[(hash & h->bucket_mask)];
+    h->old_buckets      = h->buckets;
+    h->old_bucket_count = h->bucket_count;
+    h->old_bucket_mask  = h->bucket_mask;
+    h->migrate_next     = 0;
+    h->buckets          = buckets;
+    h->bucket_count     = h->bucket_count * 2;
+    h->bucket_mask      = h->bucket_count - 1;
 }
 
 
@@ -89,9 +157,10 @@ qd_hash_t *qd_hash(int bucket_exponent, int batch_size, int value_is_const)
     if (!h)
         return 0;
 
+    ZERO(h);
     h->bucket_count = 1 << bucket_exponent;
     h->bucket_mask  = h->bucket_count - 1;
-    h->batch_size   = batch_size;
+    h->batch_size   = batch_size > 0 ? batch_size : 1;
     h->size         = 0;
     h->is_const     = value_is_const;
     h->buckets = NEW_ARRAY(bucket_t, h->bucket_count);
@@ -125,22 +194,35 @@ static void qd_hash_internal_remove_item(qd_hash_t *h, bucket_t *bucket, qd_hash
     }
     free_qd_hash_item_t(item);
     h->size--;
+    qd_hash_migrate(h, h->batch_size);
 }
 
-void qd_hash_free(qd_hash_t *h)
+static void qd_hash_free_buckets(qd_hash_t *h, bucket_t *buckets, unsigned int count)
 {
-    if (!h) return;
     qd_hash_item_t *item;
-    int             idx;
+    unsigned int    idx;
 
-    for (idx = 0; idx < h->bucket_count; idx++) {
-        item = DEQ_HEAD(h->buckets[idx].items);
+    for (idx = 0; idx < count; idx++) {
+        item = DEQ_HEAD(buckets[idx].items);
         while (item) {
-            qd_hash_internal_remove_item(h, &h->buckets[idx], item, 0);
-            item = DEQ_HEAD(h->buckets[idx].items);
+            DEQ_REMOVE_HEAD(buckets[idx].items);
+            free(item->key);
+            if (item->handle)
+                item->handle->item = 0;
+            free_qd_hash_item_t(item);
+            h->size--;
+            item = DEQ_HEAD(buckets[idx].items);
         }
     }
-    free(h->buckets);
+    free(buckets);
+}
+
+void qd_hash_free(qd_hash_t *h)
+{
+    if (!h) return;
+    if (h->old_buckets)
+        qd_hash_free_buckets(h, h->old_buckets, h->old_bucket_count);
+    qd_hash_free_buckets(h, h->buckets, h->bucket_count);
     free(h);
 }
 
@@ -152,12 +234,13 @@ size_t qd_hash_size(qd_hash_t *h)
 
 
 // ownership of key is transferred to the qd_hash_item_t
-static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, bucket_t *bucket, unsigned char *key, int *exists, qd_hash_handle_t **handle)
+static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, uint32_t hash, unsigned char *key, int *exists, qd_hash_handle_t **handle)
 {
-    qd_hash_item_t *item = DEQ_HEAD(bucket->items);
+    bucket_t       *bucket = qd_hash_get_bucket(h, hash);
+    qd_hash_item_t *item   = DEQ_HEAD(bucket->items);
 
     while (item) {
-        if (strcmp((const char *) key, (const char *) item->key) == 0)
+        if (item->hash == hash && strcmp((const char *) key, (const char *) item->key) == 0)
             break;
         item = DEQ_NEXT(item);
     }
@@ -180,7 +263,8 @@ static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, bucket_t *bucket, u
     item->handle = 0;
 
     DEQ_ITEM_INIT(item);
-    item->key = key;
+    item->key  = key;
+    item->hash = hash;
 
     DEQ_INSERT_TAIL(bucket->items, item);
     h->size++;
@@ -191,7 +275,6 @@ static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, bucket_t *bucket, u
     //
     if (handle) {
         *handle = new_qd_hash_handle_t();
-        (*handle)->bucket = bucket;
         (*handle)->item   = item;
 
         //
@@ -204,6 +287,9 @@ static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, bucket_t *bucket, u
         item->handle = *handle;
     }
 
+    qd_hash_migrate(h, h->batch_size);
+    qd_hash_maybe_grow(h);
+
     return item;
 }
 
@@ -211,13 +297,13 @@ static qd_hash_item_t *qd_hash_internal_insert(qd_hash_t *h, bucket_t *bucket, u
 qd_error_t qd_hash_insert(qd_hash_t *h, qd_iterator_t *key, void *val, qd_hash_handle_t **handle)
 {
     int       exists = 0;
-    bucket_t *bucket = qd_hash_get_bucket_iter(h, key);
+    uint32_t  hash   = qd_iterator_hash_view(key);
     unsigned char *k = qd_iterator_copy(key);
 
     if (!k)
         return QD_ERROR_ALLOC;
 
-    qd_hash_item_t *item   = qd_hash_internal_insert(h, bucket, k, &exists, handle);
+    qd_hash_item_t *item   = qd_hash_internal_insert(h, hash, k, &exists, handle);
 
     if (!item) {
         free(k);
@@ -240,13 +326,13 @@ qd_error_t qd_hash_insert_const(qd_hash_t *h, qd_iterator_t *key, const void *va
     assert(h->is_const);
 
     int       exists = 0;
-    bucket_t *bucket = qd_hash_get_bucket_iter(h, key);
+    uint32_t  hash   = qd_iterator_hash_view(key);
     unsigned char *k = qd_iterator_copy(key);
 
     if (!k)
         return QD_ERROR_ALLOC;
 
-    qd_hash_item_t *item  = qd_hash_internal_insert(h, bucket, k, &exists, handle);
+    qd_hash_item_t *item  = qd_hash_internal_insert(h, hash, k, &exists, handle);
 
     if (!item) {
         free(k);
@@ -267,13 +353,13 @@ qd_error_t qd_hash_insert_const(qd_hash_t *h, qd_iterator_t *key, const void *va
 qd_error_t qd_hash_insert_str(qd_hash_t *h, const unsigned char *key, void *val, qd_hash_handle_t **handle)
 {
     int       exists = 0;
-    bucket_t *bucket = qd_hash_get_bucket_str(h, key);
+    uint32_t  hash   = qd_hash_compute_str(key);
     unsigned char *k = (unsigned char *) strdup((const char *) key);
 
     if (!k)
         return QD_ERROR_ALLOC;
 
-    qd_hash_item_t *item   = qd_hash_internal_insert(h, bucket, k, &exists, handle);
+    qd_hash_item_t *item   = qd_hash_internal_insert(h, hash, k, &exists, handle);
 
     if (!item) {
         free(k);
@@ -293,11 +379,10 @@ qd_error_t qd_hash_insert_str(qd_hash_t *h, const unsigned char *key, void *val,
 
 static qd_hash_item_t *qd_hash_internal_retrieve_with_hash(qd_hash_t *h, uint32_t hash, qd_iterator_t *key)
 {
-    uint32_t        idx  = hash & h->bucket_mask;
-	qd_hash_item_t *item = DEQ_HEAD(h->buckets[idx].items);
+	qd_hash_item_t *item = DEQ_HEAD(qd_hash_get_bucket(h, hash)->items);
 
 	while (item) {
-		if (qd_iterator_equal(key, item->key))
+		if (item->hash == hash && qd_iterator_equal(key, item->key))
 			break;
 		item = DEQ_NEXT(item);
 	}
@@ -388,12 +473,12 @@ qd_error_t qd_hash_retrieve_const(qd_hash_t *h, qd_iterator_t *key, const void *
 }
 
 
-static qd_hash_item_t *qd_hash_internal_get_item_str(qd_hash_t *h, bucket_t *bucket, const unsigned char *key)
+static qd_hash_item_t *qd_hash_internal_get_item_str(qd_hash_t *h, uint32_t hash, const unsigned char *key)
 {
-	qd_hash_item_t *item = DEQ_HEAD(bucket->items);
+	qd_hash_item_t *item = DEQ_HEAD(qd_hash_get_bucket(h, hash)->items);
 
 	while (item) {
-		if (strcmp((const char *) key, (const char *) item->key) == 0) {
+		if (item->hash == hash && strcmp((const char *) key, (const char *) item->key) == 0) {
             return item;
         }
 		item = DEQ_NEXT(item);
@@ -405,9 +490,7 @@ static qd_hash_item_t *qd_hash_internal_get_item_str(qd_hash_t *h, bucket_t *buc
 
 qd_error_t qd_hash_retrieve_str(qd_hash_t *h, const unsigned char *key, void **val)
 {
-	qd_hash_item_t *item = qd_hash_internal_get_item_str(h,
-                                                         qd_hash_get_bucket_str(h, key),
-                                                         key);
+	qd_hash_item_t *item = qd_hash_internal_get_item_str(h, qd_hash_compute_str(key), key);
     if (item) {
         *val = item->v.val;
         return QD_ERROR_NONE;
@@ -420,26 +503,24 @@ qd_error_t qd_hash_retrieve_str(qd_hash_t *h, const unsigned char *key, void **v
 
 qd_error_t qd_hash_remove(qd_hash_t *h, qd_iterator_t *key)
 {
-    //the retrieve function will re-apply the bucket_mask, but that is ok
-    //we apply it here because we need the bucket index to do the remove
-    uint32_t        idx  = qd_iterator_hash_view(key) & h->bucket_mask;
-    qd_hash_item_t *item = qd_hash_internal_retrieve_with_hash(h, idx, key);
+    uint32_t        hash = qd_iterator_hash_view(key);
+    qd_hash_item_t *item = qd_hash_internal_retrieve_with_hash(h, hash, key);
     if (!item)
         return QD_ERROR_NOT_FOUND;
 
-    qd_hash_internal_remove_item(h, &h->buckets[idx], item, 0);
+    qd_hash_internal_remove_item(h, qd_hash_get_bucket(h, hash), item, 0);
     return QD_ERROR_NONE;
 }
 
 
 qd_error_t qd_hash_remove_str(qd_hash_t *h, const unsigned char *key)
 {
-    bucket_t     *bucket = qd_hash_get_bucket_str(h, key);
-    qd_hash_item_t *item = qd_hash_internal_get_item_str(h, bucket, key);
+    uint32_t        hash = qd_hash_compute_str(key);
+    qd_hash_item_t *item = qd_hash_internal_get_item_str(h, hash, key);
     if (!item)
         return QD_ERROR_NOT_FOUND;
 
-    qd_hash_internal_remove_item(h, bucket, item, 0);
+    qd_hash_internal_remove_item(h, qd_hash_get_bucket(h, hash), item, 0);
     return QD_ERROR_NONE;
 }
 
@@ -489,6 +570,6 @@ qd_error_t qd_hash_remove_by_handle2(qd_hash_t *h, qd_hash_handle_t *handle, uns
     //
     if (!handle || !handle->item)
         return QD_ERROR_NOT_FOUND;
-    qd_hash_internal_remove_item(h, handle->bucket, handle->item, key);
+    qd_hash_internal_remove_item(h, qd_hash_get_bucket(h, handle->item->hash), handle->item, key);
     return QD_ERROR_NONE;
 }
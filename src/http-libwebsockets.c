@@ -33,6 +33,7 @@
 #include "qpid/dispatch/threading.h"
 #include "qpid/dispatch/timer.h"
 #include "qpid/dispatch/connection_counters.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/tls_common.h"
 
 #include <proton/connection_driver.h>
@@ -112,6 +113,11 @@ typedef struct stats_request_state_t {
     qd_http_server_t *server;
     struct lws *wsi;
     size_t buffer_size;       // extra octets past lws_prefix[LWS_PRE] for HTTP output
+    bool core_metrics_sent;   // T: headers and the core metrics written, the metrics registry follows
+    qd_metrics_cursor_t registry_cursor;
+    uint8_t *snapshot;        // encoded statistics snapshot, see callback_stats_snapshot()
+    size_t snapshot_length;
+    size_t snapshot_sent;     // octets of the snapshot already written
     uint8_t lws_prefix[LWS_PRE];
     // buffer_size extra octets are appended to this structure when it is allocated. This space is used for the HTTP
     // response. See new_stats_request_state(), Use &lws_prefix[LWS_PRE] as the start of output buffer.
@@ -142,6 +148,8 @@ static int callback_metrics(struct lws *wsi, enum lws_callback_reasons reason,
                                void *user, void *in, size_t len);
 static int callback_healthz(struct lws *wsi, enum lws_callback_reasons reason,
                                void *user, void *in, size_t len);
+static int callback_stats_snapshot(struct lws *wsi, enum lws_callback_reasons reason,
+                                   void *user, void *in, size_t len);
 
 static struct lws_protocols protocols[] = {
     /* HTTP only protocol comes first */
@@ -174,6 +182,11 @@ static struct lws_protocols protocols[] = {
         callback_healthz,
         sizeof(stats_t),
     },
+    {
+        "stats",
+        callback_stats_snapshot,
+        sizeof(stats_t),
+    },
     { NULL, NULL, 0, 0 } /* terminator */
 };
 
@@ -287,6 +300,7 @@ struct qd_lws_listener_t {
     struct lws_http_mount mount;
     struct lws_http_mount metrics;
     struct lws_http_mount healthz;
+    struct lws_http_mount stats;
 };
 
 void qd_lws_listener_free(qd_lws_listener_t *hl) {
@@ -374,6 +388,15 @@ static void listener_start(qd_lws_listener_t *hl, qd_http_server_t *hs) {
         metrics->origin_protocol = LWSMPRO_CALLBACK;
         metrics->protocol = "http";
         metrics->origin = IGNORED;
+
+        struct lws_http_mount *stats = &hl->stats;
+        tail->mount_next = stats;
+        tail = stats;
+        stats->mountpoint = "/stats";
+        stats->mountpoint_len = strlen(stats->mountpoint);
+        stats->origin_protocol = LWSMPRO_CALLBACK;
+        stats->protocol = "stats";
+        stats->origin = IGNORED;
     }
     if (config->healthz) {
         struct lws_http_mount *healthz = &hl->healthz;
@@ -503,13 +526,25 @@ static void connection_wake(qd_connection_t *qd_conn)
 // should metric be added/removed. I've added many debug asserts to prevent accidental buffer overflow should the
 // metrics not be updated properly.
 //
-// TODO(kgiusti): refactor this to use a smaller buffer with a chunked-output approach if possible with LWS.
+// Metrics in the registry (see metrics.h) are written after that, one buffer at a time with each buffer rendered when
+// LWS is ready for it. They are updated lock-free by whichever thread owns them and are rendered without involving the
+// router core. The output buffer is therefore also made at least QD_METRICS_RENDER_MIN in size.
 #define MAX_METRIC_NAME_LEN  48
 #define MAX_METRIC_VALUE_LEN 20  // uint64_t in decimal
 #define MAX_METRIC_TYPE_LEN  7   // strlen("counter")
 #define PER_METRIC_BUF_SIZE ((2 * MAX_METRIC_NAME_LEN) + MAX_METRIC_VALUE_LEN + MAX_METRIC_TYPE_LEN + 11)
 #define PER_ALLOC_METRIC_COUNT 4  // 4 metrics per alloc type
 
+// Core action metrics carry an action="<label>" label and, for histogram buckets, an le="<bound>" label. One TYPE
+// line is written per metric family, then one line per action (per bucket for the histogram).
+#define MAX_ACTION_LABEL_LEN 64
+#define PER_ACTION_LINE_BUF_SIZE (MAX_METRIC_NAME_LEN + MAX_ACTION_LABEL_LEN + (2 * MAX_METRIC_VALUE_LEN) + 24)
+#define ACTION_METRIC_FAMILIES 4
+#define PER_ACTION_LINE_COUNT (QDR_ACTION_HISTOGRAM_BUCKETS + 5)  // buckets, sum, count, max, delay total, delay max
+
+// Priority lane metrics carry a priority="<n>" label: one TYPE line per family then one line per priority.
+#define LANE_METRIC_FAMILIES 3
+
 #define HTTP_HEADER_LEN 128  // reserve space for headers added by LWS (128 is a guess, asserted in callback).
 #define HEALTHZ_BUF_SIZE 2048 // for /healthz url response data
 
@@ -568,6 +603,16 @@ static uint64_t stats_get_deliveries_delayed_1sec(const qdr_global_stats_t *stat
 static uint64_t stats_get_deliveries_delayed_10sec(const qdr_global_stats_t *stats) { return stats->deliveries_delayed_10sec; }
 static uint64_t stats_get_deliveries_stuck(const qdr_global_stats_t *stats) { return stats->deliveries_stuck; }
 static uint64_t stats_get_links_blocked(const qdr_global_stats_t *stats) { return stats->links_blocked; }
+static uint64_t stats_get_action_batches(const qdr_global_stats_t *stats) { return stats->action_batches; }
+static uint64_t stats_get_action_depth_max(const qdr_global_stats_t *stats) { return stats->action_depth_max; }
+static uint64_t stats_get_foreground_wait(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_FOREGROUND].wait_total_ns / 1000; }
+static uint64_t stats_get_foreground_wait_max(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_FOREGROUND].wait_max_ns / 1000; }
+static uint64_t stats_get_background_actions(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_BACKGROUND].count; }
+static uint64_t stats_get_background_wait(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_BACKGROUND].wait_total_ns / 1000; }
+static uint64_t stats_get_background_wait_max(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_BACKGROUND].wait_max_ns / 1000; }
+static uint64_t stats_get_control_actions(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_CONTROL].count; }
+static uint64_t stats_get_control_wait(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_CONTROL].wait_total_ns / 1000; }
+static uint64_t stats_get_control_wait_max(const qdr_global_stats_t *stats) { return stats->action_class_stats[QDR_ACTION_CLASS_CONTROL].wait_max_ns / 1000; }
 
 static const struct metric_definition metrics[] = {
     {"qdr_connections_total", "gauge", stats_get_connections},
@@ -587,6 +632,16 @@ static const struct metric_definition metrics[] = {
     {"qdr_deliveries_delayed_10sec_total", "counter", stats_get_deliveries_delayed_10sec},
     {"qdr_deliveries_stuck_total", "gauge", stats_get_deliveries_stuck},
     {"qdr_links_blocked_total", "gauge", stats_get_links_blocked},
+    {"qdr_core_action_batches_total", "counter", stats_get_action_batches},
+    {"qdr_core_action_depth_max", "gauge", stats_get_action_depth_max},
+    {"qdr_core_foreground_wait_microseconds_total", "counter", stats_get_foreground_wait},
+    {"qdr_core_foreground_wait_max_microseconds", "gauge", stats_get_foreground_wait_max},
+    {"qdr_core_background_actions_total", "counter", stats_get_background_actions},
+    {"qdr_core_background_wait_microseconds_total", "counter", stats_get_background_wait},
+    {"qdr_core_background_wait_max_microseconds", "gauge", stats_get_background_wait_max},
+    {"qdr_core_control_actions_total", "counter", stats_get_control_actions},
+    {"qdr_core_control_wait_microseconds_total", "counter", stats_get_control_wait},
+    {"qdr_core_control_wait_max_microseconds", "gauge", stats_get_control_wait_max},
 };
 static const size_t metrics_length = sizeof(metrics)/sizeof(metrics[0]);
 
@@ -692,6 +747,161 @@ static size_t _write_global_metrics(const stats_request_state_t *state, uint8_t
 }
 
 
+// Write one labelled sample of a core action metric. le may be null for metrics that are not histogram buckets. Return
+// the total octets written (not including null terminator) or zero on error.
+//
+static size_t _write_action_sample(uint8_t **start, size_t available, const char *name, const char *action,
+                                   const char *le, uint64_t value)
+{
+    int rc;
+    if (le)
+        rc = snprintf((char *) *start, available, "%s{action=\"%s\",le=\"%s\"} %" PRIu64 "\n", name, action, le, value);
+    else
+        rc = snprintf((char *) *start, available, "%s{action=\"%s\"} %" PRIu64 "\n", name, action, value);
+    if (rc < 0 || rc >= available) { // overrun!
+        assert(false);  // you need to increase the output_buffer size!
+        return 0;
+    }
+    *start += rc;
+    return rc;
+}
+
+// Write the TYPE line of a core action metric family.
+//
+static size_t _write_action_family(uint8_t **start, size_t available, const char *name, const char *type)
+{
+    int rc = snprintf((char *) *start, available, "# TYPE %s %s\n", name, type);
+    if (rc < 0 || rc >= available) { // overrun!
+        assert(false);  // you need to increase the output_buffer size!
+        return 0;
+    }
+    *start += rc;
+    return rc;
+}
+
+// Copy an action label into buf for use as a metric label value. Labels are short literals set by the router core,
+// but truncate and replace characters that are special in the exposition format regardless.
+//
+static const char *_action_label(char *buf, size_t size, const char *label)
+{
+    snprintf(buf, size, "%s", label);
+    for (char *ptr = buf; *ptr; ++ptr) {
+        if (*ptr == '"' || *ptr == '\\' || *ptr == '\n')
+            *ptr = '_';
+    }
+    return buf;
+}
+
+// Write the per-action-type core thread metrics: a histogram of handler run times plus the longest run time and the
+// enqueue-to-execute delay. Times are in microseconds. Return the total octets written (not including null terminator)
+// or zero on error.
+//
+// On successful return (*start) will be advanced to the terminating null byte.
+//
+static size_t _write_action_metrics(const stats_request_state_t *state, uint8_t **start, size_t available)
+{
+    const qdr_global_stats_t *stats = &state->stats;
+    const size_t save = available;
+    char label[MAX_ACTION_LABEL_LEN + 1];
+    char le[MAX_METRIC_VALUE_LEN + 1];
+    size_t rc;
+
+#define _ACTION_WRITE(X) do { rc = (X); if (rc == 0) return 0; available -= rc; } while (0)
+
+    _ACTION_WRITE(_write_action_family(start, available, "qdr_core_action_duration_microseconds", "histogram"));
+    for (size_t i = 0; i < stats->action_stats_count; ++i) {
+        const qdr_action_stats_t *action = &stats->action_stats[i];
+        _action_label(label, sizeof(label), action->label);
+
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < QDR_ACTION_HISTOGRAM_BUCKETS; ++bucket) {
+            cumulative += action->histogram[bucket];
+            if (bucket == QDR_ACTION_HISTOGRAM_BUCKETS - 1)
+                snprintf(le, sizeof(le), "+Inf");
+            else
+                snprintf(le, sizeof(le), "%" PRIu64, (uint64_t) 1 << bucket);
+            _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_duration_microseconds_bucket",
+                                               label, le, cumulative));
+        }
+        _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_duration_microseconds_sum",
+                                           label, 0, action->total_ns / 1000));
+        _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_duration_microseconds_count",
+                                           label, 0, action->count));
+    }
+
+    _ACTION_WRITE(_write_action_family(start, available, "qdr_core_action_duration_max_microseconds", "gauge"));
+    for (size_t i = 0; i < stats->action_stats_count; ++i) {
+        const qdr_action_stats_t *action = &stats->action_stats[i];
+        _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_duration_max_microseconds",
+                                           _action_label(label, sizeof(label), action->label), 0,
+                                           action->max_ns / 1000));
+    }
+
+    _ACTION_WRITE(_write_action_family(start, available, "qdr_core_action_queue_delay_microseconds_total", "counter"));
+    for (size_t i = 0; i < stats->action_stats_count; ++i) {
+        const qdr_action_stats_t *action = &stats->action_stats[i];
+        _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_queue_delay_microseconds_total",
+                                           _action_label(label, sizeof(label), action->label), 0,
+                                           action->queue_delay_total_ns / 1000));
+    }
+
+    _ACTION_WRITE(_write_action_family(start, available, "qdr_core_action_queue_delay_max_microseconds", "gauge"));
+    for (size_t i = 0; i < stats->action_stats_count; ++i) {
+        const qdr_action_stats_t *action = &stats->action_stats[i];
+        _ACTION_WRITE(_write_action_sample(start, available, "qdr_core_action_queue_delay_max_microseconds",
+                                           _action_label(label, sizeof(label), action->label), 0,
+                                           action->queue_delay_max_ns / 1000));
+    }
+
+#undef _ACTION_WRITE
+
+    return save - available;
+}
+
+
+// Write the per-priority delivery count and queueing delay of the inter-router links. Times are in microseconds.
+// Return the total octets written (not including null terminator) or zero on error.
+//
+// On successful return (*start) will be advanced to the terminating null byte.
+//
+static size_t _write_lane_metrics(const stats_request_state_t *state, uint8_t **start, size_t available)
+{
+    static const struct {
+        const char *name;
+        const char *type;
+    } families[LANE_METRIC_FAMILIES] = {
+        {"qdr_priority_lane_deliveries_total", "counter"},
+        {"qdr_priority_lane_delay_microseconds_total", "counter"},
+        {"qdr_priority_lane_delay_max_microseconds", "gauge"},
+    };
+    const size_t save = available;
+
+    for (int family = 0; family < LANE_METRIC_FAMILIES; ++family) {
+        size_t rc = _write_action_family(start, available, families[family].name, families[family].type);
+        if (rc == 0)
+            return 0;
+        available -= rc;
+
+        for (int priority = 0; priority < QDR_N_PRIORITIES; ++priority) {
+            const qdr_priority_lane_stats_t *lane = &state->stats.priority_lane_stats[priority];
+            uint64_t value = family == 0 ? lane->deliveries
+                           : family == 1 ? lane->queue_delay_total_ns / 1000
+                           : lane->queue_delay_max_ns / 1000;
+            int n = snprintf((char *) *start, available, "%s{priority=\"%d\"} %" PRIu64 "\n",
+                             families[family].name, priority, value);
+            if (n < 0 || n >= available) { // overrun!
+                assert(false);  // you need to increase the output_buffer size!
+                return 0;
+            }
+            *start += n;
+            available -= n;
+        }
+    }
+
+    return save - available;
+}
+
+
 // Write a single allocator metric to the output buffer. Generate the metric name using the name and subname. Return the
 // total octets written (not including null terminator) or zero on error.
 //
@@ -728,6 +938,13 @@ static size_t _write_allocator_metrics(uint8_t **start, size_t available)
         uint64_t total_in_use = stats.held_by_threads;
         uint64_t total_in_cache = total_allocated - total_in_use;
         uint64_t total_bytes = total_allocated * qd_alloc_type_size(metric->desc);
+        if (metric->desc->embedded_in) {
+            // the embedded items are in the bytes of their container
+            qd_alloc_stats_t embedded = qd_alloc_desc_stats(metric->desc->embedded_in);
+            uint64_t         bytes    = (embedded.total_alloc_from_heap - embedded.total_free_to_heap)
+                              * qd_alloc_type_size(metric->desc);
+            total_bytes = total_bytes > bytes ? total_bytes - bytes : 0;
+        }
 
         pool_total_bytes += total_bytes;
 
@@ -798,7 +1015,9 @@ static size_t _generate_metrics_response(stats_request_state_t *state, uint8_t *
     if (_write_global_metrics(state, start, end - *start) == 0
         || _write_allocator_metrics(start, end - *start) == 0
         || _write_memory_metrics(start, end - *start) == 0
-        || _write_conn_counter_metrics(start, end - *start) == 0) {
+        || _write_conn_counter_metrics(start, end - *start) == 0
+        || _write_action_metrics(state, start, end - *start) == 0
+        || _write_lane_metrics(state, start, end - *start) == 0) {
         // error, close the connection
         return 0;
     }
@@ -836,9 +1055,14 @@ static int callback_metrics(struct lws *wsi, enum lws_callback_reasons reason,
             + (2 * PER_METRIC_BUF_SIZE)
             // connection counters by protocol:
             + (QD_PROTOCOL_TOTAL * PER_METRIC_BUF_SIZE)
+            // core action metrics in the worst case of every action type tracked:
+            + (ACTION_METRIC_FAMILIES * PER_METRIC_BUF_SIZE)
+            + (QDR_ACTION_STATS_MAX * PER_ACTION_LINE_COUNT * PER_ACTION_LINE_BUF_SIZE)
+            // priority lane metrics:
+            + (LANE_METRIC_FAMILIES * (QDR_N_PRIORITIES + 1) * PER_METRIC_BUF_SIZE)
             // 1 terminating null
             + 1;
-        stats->state = new_stats_request_state(buf_size);
+        stats->state = new_stats_request_state(MAX(buf_size, QD_METRICS_RENDER_MIN));
         stats->state->wsi = wsi;
         stats->state->server = hs;
         //request stats from core thread
@@ -862,33 +1086,40 @@ static int callback_metrics(struct lws *wsi, enum lws_callback_reasons reason,
 
         uint8_t *start = &stats->state->lws_prefix[LWS_PRE];
         uint8_t *end = start + stats->state->buffer_size;  // first byte past buffer
+        bool final = false;
 
-        // encode stats into buffer
+        if (!stats->state->core_metrics_sent) {
+            // encode the headers and the core stats into buffer
 
-        if (lws_add_http_header_status(wsi, HTTP_STATUS_OK, &start, end)
-            || add_header_by_name(wsi, "content-type:", "text/plain", &start, end)
-            || add_header_by_name(wsi, "connection:", "close", &start, end)
-            || lws_finalize_http_header(wsi, &start, end)) {
+            if (lws_add_http_header_status(wsi, HTTP_STATUS_OK, &start, end)
+                || add_header_by_name(wsi, "content-type:", "text/plain", &start, end)
+                || add_header_by_name(wsi, "connection:", "close", &start, end)
+                || lws_finalize_http_header(wsi, &start, end)) {
 
-            qd_log(LOG_HTTP, QD_LOG_WARNING, "Metrics request failed: cannot send headers");
-            return 1;
-        }
+                qd_log(LOG_HTTP, QD_LOG_WARNING, "Metrics request failed: cannot send headers");
+                return 1;
+            }
 
-        // if this fails make HTTP_HEADER_LEN larger (LWS does not document the required size)
-        assert(HTTP_HEADER_LEN >= (start - &stats->state->lws_prefix[LWS_PRE]));
+            // if this fails make HTTP_HEADER_LEN larger (LWS does not document the required size)
+            assert(HTTP_HEADER_LEN >= (start - &stats->state->lws_prefix[LWS_PRE]));
 
-        if (_generate_metrics_response(stats->state, &start, end) == 0) {
-            // Failed to generate output. This is not expected. Terminate the connection
-            qd_log(LOG_HTTP, QD_LOG_WARNING, "Metrics request failed: cannot access metrics");
-            return 1;
+            if (_generate_metrics_response(stats->state, &start, end) == 0) {
+                // Failed to generate output. This is not expected. Terminate the connection
+                qd_log(LOG_HTTP, QD_LOG_WARNING, "Metrics request failed: cannot access metrics");
+                return 1;
+            }
+            stats->state->core_metrics_sent = true;
+        } else {
+            // the next buffer of the metrics registry
+            start += qd_metrics_render(&stats->state->registry_cursor, (char *) start, end - start);
+            final = stats->state->registry_cursor.done;
         }
 
-        // Write the entire output buffer to LWS in one call. Best I can tell from the docs this should not fail
-        // unless the connection has closed.
+        // Best I can tell from the docs this should not fail unless the connection has closed.
 
         size_t available = (size_t) (start - &stats->state->lws_prefix[LWS_PRE]);
         size_t amount = lws_write(wsi, (unsigned char *) &stats->state->lws_prefix[LWS_PRE],
-                                  available, LWS_WRITE_HTTP_FINAL);
+                                  available, final ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP);
 
         if (amount < available) {
             // according to the lws_write header, this is an error. It may return more than available, which is ok
@@ -896,6 +1127,11 @@ static int callback_metrics(struct lws *wsi, enum lws_callback_reasons reason,
             return 1;
         }
 
+        if (!final) {
+            lws_callback_on_writable(wsi);
+            return 0;
+        }
+
         stats->response_complete = true;
 
         if (lws_http_transaction_completed(wsi)) {
@@ -1016,6 +1252,138 @@ static int callback_healthz(struct lws *wsi, enum lws_callback_reasons reason,
     }
 }
 
+
+// A statistics snapshot is fetched with an HTTP get request on "http://<router>/stats/connections" or
+// "http://<router>/stats/links". The response is the binary encoding of the counters of every open connection or link,
+// see docs/notes/stats-snapshot.md. The core thread copies the counters and a worker thread encodes them (see
+// handle_snapshot_results()), the http thread only writes the encoded octets, STATS_SNAPSHOT_BUF_SIZE at a time.
+//
+#define STATS_SNAPSHOT_BUF_SIZE (HTTP_HEADER_LEN + 16384)
+
+/**
+ * Called on router worker thread: encodes the snapshot then passes it to the http thread like the router stats
+ */
+static void handle_snapshot_results(void *context, qdr_stats_snapshot_t *snapshot, bool discard)
+{
+    stats_request_state_t *state = (stats_request_state_t *) context;
+    if (snapshot) {
+        state->snapshot = qdr_stats_snapshot_encode(snapshot, &state->snapshot_length);
+        qdr_stats_snapshot_free(snapshot);
+    }
+    handle_stats_results(state, discard);
+}
+
+static int callback_stats_snapshot(struct lws *wsi, enum lws_callback_reasons reason,
+                                   void *user, void *in, size_t len)
+{
+    qd_http_server_t *hs = wsi_server(wsi);
+    stats_t *stats = (stats_t*) user;
+
+    if (!stats)   // ignore any non-http request events
+        return 0;
+
+    switch (reason) {
+
+    case LWS_CALLBACK_HTTP: {
+        assert(!stats->state);
+        char uri[64];
+        qd_router_entity_type_t entity_type;
+        if (lws_hdr_copy(wsi, uri, sizeof(uri), WSI_TOKEN_GET_URI) < 0)
+            uri[0] = 0;
+        if (strcmp(uri, "/stats/connections") == 0) {
+            entity_type = QD_ROUTER_CONNECTION;
+        } else if (strcmp(uri, "/stats/links") == 0) {
+            entity_type = QD_ROUTER_LINK;
+        } else {
+            if (lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL))
+                return 1;
+            return lws_http_transaction_completed(wsi) ? 1 : 0;
+        }
+        stats->state = new_stats_request_state(STATS_SNAPSHOT_BUF_SIZE);
+        stats->state->wsi = wsi;
+        stats->state->server = hs;
+        qdr_request_stats_snapshot(hs->core, entity_type, handle_snapshot_results, (void*) stats->state);
+        return 0;
+    }
+
+    case LWS_CALLBACK_HTTP_WRITEABLE: {
+        assert(stats->state);  // expect LWS_CALLBACK_HTTP event occurs first!
+
+        if (stats->response_complete) {  // ignore spurious WRITABLE events once response complete
+            return 0;
+        }
+
+        if (!stats->state->callback_completed) {
+            // the snapshot has not been taken yet, another LWS_CALLBACK_HTTP_WRITABLE event follows when it has
+            return 0;
+        }
+
+        stats_request_state_t *state = stats->state;
+        uint8_t *start = &state->lws_prefix[LWS_PRE];
+        uint8_t *end = start + state->buffer_size;  // first byte past buffer
+
+        if (state->snapshot_sent == 0) {
+            if (lws_add_http_header_status(wsi, HTTP_STATUS_OK, &start, end)
+                || add_header_by_name(wsi, "content-type:", "application/octet-stream", &start, end)
+                || lws_add_http_header_content_length(wsi, state->snapshot_length, &start, end)
+                || lws_finalize_http_header(wsi, &start, end)) {
+
+                qd_log(LOG_HTTP, QD_LOG_WARNING, "Stats snapshot request failed: cannot send headers");
+                return 1;
+            }
+
+            // if this fails make HTTP_HEADER_LEN larger (LWS does not document the required size)
+            assert(HTTP_HEADER_LEN >= (start - &state->lws_prefix[LWS_PRE]));
+        }
+
+        size_t chunk = MIN((size_t) (end - start), state->snapshot_length - state->snapshot_sent);
+        if (chunk) {
+            memcpy(start, state->snapshot + state->snapshot_sent, chunk);
+            start += chunk;
+            state->snapshot_sent += chunk;
+        }
+        bool final = state->snapshot_sent == state->snapshot_length;
+
+        size_t available = (size_t) (start - &state->lws_prefix[LWS_PRE]);
+        size_t amount = lws_write(wsi, (unsigned char *) &state->lws_prefix[LWS_PRE],
+                                  available, final ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP);
+        if (amount < available) {
+            // according to the lws_write header, this is an error. It may return more than available, which is ok
+            qd_log(LOG_HTTP, QD_LOG_WARNING, "Stats snapshot request failed: connection closed while writing");
+            return 1;
+        }
+
+        if (!final) {
+            lws_callback_on_writable(wsi);
+            return 0;
+        }
+
+        stats->response_complete = true;
+
+        if (lws_http_transaction_completed(wsi)) {
+            // I do not think this is an error, but according to the examples we close the connection when this happens
+            return 1;
+        }
+        return 0;
+    }
+
+    case LWS_CALLBACK_HTTP_DROP_PROTOCOL:
+    case LWS_CALLBACK_CLOSED_HTTP: {
+        if (stats->state) {
+            stats->state->wsi_deleted = true;
+            if (stats->state->callback_completed) {
+                free_stats_request_state(stats->state);
+                stats->state = 0;
+            }
+        }
+        return 0;
+    }
+
+    default:
+        return 0;
+    }
+}
+
 /* Callbacks for promoted AMQP over WS connections. */
 static int callback_amqpws(struct lws *wsi, enum lws_callback_reasons reason,
                            void *user, void *in, size_t len)
@@ -1317,5 +1685,6 @@ static stats_request_state_t *new_stats_request_state(size_t buffer_size)
 
 static void free_stats_request_state(stats_request_state_t *state)
 {
+    free(state->snapshot);
     free(state);
 }
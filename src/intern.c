@@ -0,0 +1,225 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "qpid/dispatch/intern.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/hash.h"
+#include "qpid/dispatch/metrics.h"
+#include "qpid/dispatch/threading.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_SHARDS          64     // must be a power of two
+#define INTERN_INITIAL_BUCKETS 64     // per shard, must be a power of two
+
+typedef struct intern_entry_t intern_entry_t;
+
+struct intern_entry_t {
+    intern_entry_t        *next;       // in the bucket
+    atomic_uint_least32_t  ref_count;  // zero once the last reference is being released
+    uint32_t               hash;
+    size_t                 length;
+    char                   text[];
+};
+
+typedef struct intern_shard_t {
+    sys_mutex_t      lock;
+    intern_entry_t **buckets;
+    uint32_t         bucket_count;
+    uint32_t         count;
+} intern_shard_t;
+
+static intern_shard_t  shards[INTERN_SHARDS];
+static qd_metric_t    *strings_metric;
+static qd_metric_t    *octets_metric;
+
+
+static inline intern_entry_t *entry_of(const char *interned)
+{
+    return (intern_entry_t *) (interned - offsetof(intern_entry_t, text));
+}
+
+
+// The low bits of the hash select the shard, the next ones the bucket
+//
+static inline intern_shard_t *shard_of(uint32_t hash)
+{
+    return &shards[hash & (INTERN_SHARDS - 1)];
+}
+
+static inline uint32_t bucket_of(const intern_shard_t *shard, uint32_t hash)
+{
+    return (hash / INTERN_SHARDS) & (shard->bucket_count - 1);
+}
+
+
+static void grow_LH(intern_shard_t *shard)
+{
+    uint32_t         old_count   = shard->bucket_count;
+    intern_entry_t **old_buckets = shard->buckets;
+
+    shard->bucket_count = old_count * 2;
+    shard->buckets      = NEW_PTR_ARRAY(intern_entry_t, shard->bucket_count);
+    memset(shard->buckets, 0, shard->bucket_count * sizeof(intern_entry_t *));
+
+    for (uint32_t i = 0; i < old_count; ++i) {
+        intern_entry_t *entry = old_buckets[i];
+        while (entry) {
+            intern_entry_t *next   = entry->next;
+            uint32_t        bucket = bucket_of(shard, entry->hash);
+            entry->next            = shard->buckets[bucket];
+            shard->buckets[bucket] = entry;
+            entry                  = next;
+        }
+    }
+    free(old_buckets);
+}
+
+
+void qd_intern_initialize(void)
+{
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        intern_shard_t *shard = &shards[i];
+        sys_mutex_init(&shard->lock);
+        shard->bucket_count = INTERN_INITIAL_BUCKETS;
+        shard->count        = 0;
+        shard->buckets      = NEW_PTR_ARRAY(intern_entry_t, INTERN_INITIAL_BUCKETS);
+        memset(shard->buckets, 0, INTERN_INITIAL_BUCKETS * sizeof(intern_entry_t *));
+    }
+    strings_metric = qd_metric(QD_METRIC_GAUGE, "qdr_intern_strings", 0, 0);
+    octets_metric  = qd_metric(QD_METRIC_GAUGE, "qdr_intern_octets", 0, 0);
+}
+
+
+void qd_intern_finalize(void)
+{
+    // Strings still referenced at shutdown are freed with the table
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        intern_shard_t *shard = &shards[i];
+        for (uint32_t b = 0; b < shard->bucket_count; ++b) {
+            intern_entry_t *entry = shard->buckets[b];
+            while (entry) {
+                intern_entry_t *next = entry->next;
+                free(entry);
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        shard->buckets = 0;
+        sys_mutex_free(&shard->lock);
+    }
+    qd_metric_free(strings_metric);
+    qd_metric_free(octets_metric);
+    strings_metric = 0;
+    octets_metric  = 0;
+}
+
+
+const char *qd_intern_n(const char *str, size_t len)
+{
+    if (!str)
+        return 0;
+
+    uint32_t        hash  = qd_hash_bytes((const uint8_t *) str, len);
+    intern_shard_t *shard = shard_of(hash);
+
+    sys_mutex_lock(&shard->lock);
+    for (intern_entry_t *entry = shard->buckets[bucket_of(shard, hash)]; entry; entry = entry->next) {
+        if (entry->hash != hash || entry->length != len || memcmp(entry->text, str, len) != 0)
+            continue;
+        // An entry whose count has dropped to zero is being freed and must not be revived
+        uint32_t count = atomic_load_explicit(&entry->ref_count, memory_order_relaxed);
+        while (count > 0) {
+            if (atomic_compare_exchange_weak_explicit(&entry->ref_count, &count, count + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                sys_mutex_unlock(&shard->lock);
+                return entry->text;
+            }
+        }
+    }
+
+    intern_entry_t *entry = (intern_entry_t *) qd_malloc(sizeof(intern_entry_t) + len + 1);
+    atomic_init(&entry->ref_count, 1);
+    entry->hash   = hash;
+    entry->length = len;
+    memcpy(entry->text, str, len);
+    entry->text[len] = '\0';
+
+    if (++shard->count > shard->bucket_count * 2)
+        grow_LH(shard);
+    uint32_t bucket        = bucket_of(shard, hash);
+    entry->next            = shard->buckets[bucket];
+    shard->buckets[bucket] = entry;
+    sys_mutex_unlock(&shard->lock);
+
+    qd_metric_inc(strings_metric, 1);
+    qd_metric_inc(octets_metric, len + 1);
+    return entry->text;
+}
+
+
+const char *qd_intern(const char *str)
+{
+    return str ? qd_intern_n(str, strlen(str)) : 0;
+}
+
+
+const char *qd_intern_ref(const char *interned)
+{
+    if (interned) {
+        uint32_t old = atomic_fetch_add_explicit(&entry_of(interned)->ref_count, 1, memory_order_relaxed);
+        (void) old;
+        assert(old > 0);
+    }
+    return interned;
+}
+
+
+void qd_intern_release(const char *interned)
+{
+    if (!interned)
+        return;
+
+    intern_entry_t *entry = entry_of(interned);
+    if (atomic_fetch_sub_explicit(&entry->ref_count, 1, memory_order_acq_rel) != 1)
+        return;
+
+    intern_shard_t *shard = shard_of(entry->hash);
+    sys_mutex_lock(&shard->lock);
+    intern_entry_t **link = &shard->buckets[bucket_of(shard, entry->hash)];
+    while (*link != entry)
+        link = &(*link)->next;
+    *link = entry->next;
+    shard->count--;
+    sys_mutex_unlock(&shard->lock);
+
+    qd_metric_dec(strings_metric, 1);
+    qd_metric_dec(octets_metric, entry->length + 1);
+    free(entry);
+}
+
+
+uint32_t qd_intern_hash(const char *interned)
+{
+    return entry_of(interned)->hash;
+}
@@ -40,14 +40,12 @@ typedef enum {
 } view_state_t;
 
 typedef struct qd_hash_segment_t {
-    DEQ_LINKS(struct qd_hash_segment_t);
     uint32_t hash;           //The hash of the segment
     uint32_t segment_length; //The length of the segment
 } qd_hash_segment_t;
 
-DEQ_DECLARE(qd_hash_segment_t, qd_hash_segment_list_t);
-ALLOC_DECLARE(qd_hash_segment_t);
-ALLOC_DEFINE(qd_hash_segment_t);
+// Hash segments held in the iterator itself, enough for all but unusually deep addresses
+#define ITER_INLINE_SEGMENTS 8
 
 struct qd_iterator_t {
     qd_buffer_field_t       start_pointer;      // Pointer to the raw data
@@ -56,16 +54,22 @@ struct qd_iterator_t {
     qd_iterator_view_t      view;
     int                     annotation_length;
     int                     annotation_remaining;
-    qd_hash_segment_list_t  hash_segments;
+    qd_hash_segment_t      *segments_heap;      // 0 while the segments fit in segments_inline
+    uint32_t                segment_count;
+    uint32_t                segment_capacity;   // of segments_heap
     parse_mode_t            mode;
     view_state_t            state;
     unsigned char           prefix;
     unsigned char           prefix_override;
+    bool                    in_storage;         // initialized in caller provided qd_iterator_storage_t
+    qd_hash_segment_t       segments_inline[ITER_INLINE_SEGMENTS];
 };
 
 ALLOC_DECLARE(qd_iterator_t);
 ALLOC_DEFINE(qd_iterator_t);
 
+_Static_assert(sizeof(qd_iterator_t) <= sizeof(qd_iterator_storage_t), "QD_ITERATOR_STORAGE_SIZE is too small");
+
 typedef struct qd_iterator_peer_edge_t {
     DEQ_LINKS(struct qd_iterator_peer_edge_t);
     char *router_id;
@@ -478,12 +482,29 @@ static inline size_t iterator_view_copy(qd_iterator_t *iter, uint8_t *buffer, si
 
 static void qd_iterator_free_hash_segments(qd_iterator_t *iter)
 {
-    qd_hash_segment_t *seg = DEQ_HEAD(iter->hash_segments);
-    while (seg) {
-        DEQ_REMOVE_HEAD(iter->hash_segments);
-        free_qd_hash_segment_t(seg);
-        seg = DEQ_HEAD(iter->hash_segments);
-    }
+    free(iter->segments_heap);
+    iter->segments_heap    = 0;
+    iter->segment_count    = 0;
+    iter->segment_capacity = 0;
+}
+
+
+// A copy of an iterator does not take the hash segments of the original
+//
+static inline void iterator_drop_segments(qd_iterator_t *iter)
+{
+    iter->segments_heap    = 0;
+    iter->segment_count    = 0;
+    iter->segment_capacity = 0;
+}
+
+
+static inline qd_iterator_t *iterator_in_storage(qd_iterator_storage_t *storage)
+{
+    qd_iterator_t *iter = (qd_iterator_t*) storage;
+    ZERO(iter);
+    iter->in_storage = true;
+    return iter;
 }
 
 
@@ -529,6 +550,28 @@ void qd_iterator_del_peer_edge(const char *router)
 
 
 
+static qd_iterator_t *iterator_string(qd_iterator_t *iter, const char *text, qd_iterator_view_t view)
+{
+    iter->start_pointer.cursor    = (unsigned char*) text;
+    iter->start_pointer.remaining = strlen(text);
+
+    qd_iterator_reset_view(iter, view);
+
+    return iter;
+}
+
+
+static qd_iterator_t *iterator_buffer(qd_iterator_t *iter, qd_buffer_t *buffer, int offset, int length,
+                                      qd_iterator_view_t view)
+{
+    iter->start_pointer = qd_buffer_field(buffer, qd_buffer_base(buffer) + offset, length);
+
+    qd_iterator_reset_view(iter, view);
+
+    return iter;
+}
+
+
 qd_iterator_t* qd_iterator_string(const char *text, qd_iterator_view_t view)
 {
     qd_iterator_t *iter = new_qd_iterator_t();
@@ -536,12 +579,13 @@ qd_iterator_t* qd_iterator_string(const char *text, qd_iterator_view_t view)
         return 0;
 
     ZERO(iter);
-    iter->start_pointer.cursor    = (unsigned char*) text;
-    iter->start_pointer.remaining = strlen(text);
+    return iterator_string(iter, text, view);
+}
 
-    qd_iterator_reset_view(iter, view);
 
-    return iter;
+qd_iterator_t *qd_iterator_init_string(qd_iterator_storage_t *storage, const char *text, qd_iterator_view_t view)
+{
+    return iterator_string(iterator_in_storage(storage), text, view);
 }
 
 
@@ -568,11 +612,14 @@ qd_iterator_t *qd_iterator_buffer(qd_buffer_t *buffer, int offset, int length, q
         return 0;
 
     ZERO(iter);
-    iter->start_pointer = qd_buffer_field(buffer, qd_buffer_base(buffer) + offset, length);
+    return iterator_buffer(iter, buffer, offset, length, view);
+}
 
-    qd_iterator_reset_view(iter, view);
 
-    return iter;
+qd_iterator_t *qd_iterator_init_buffer(qd_iterator_storage_t *storage, qd_buffer_t *buffer, int offset, int length,
+                                       qd_iterator_view_t view)
+{
+    return iterator_buffer(iterator_in_storage(storage), buffer, offset, length, view);
 }
 
 
@@ -582,7 +629,8 @@ void qd_iterator_free(qd_iterator_t *iter)
         return;
 
     qd_iterator_free_hash_segments(iter);
-    free_qd_iterator_t(iter);
+    if (!iter->in_storage)
+        free_qd_iterator_t(iter);
 }
 
 
@@ -881,7 +929,7 @@ unsigned char *qd_iterator_copy_const(const qd_iterator_t *iter)
         return 0;
 
     qd_iterator_t temp = *iter;
-    DEQ_INIT(temp.hash_segments);
+    iterator_drop_segments(&temp);
     return qd_iterator_copy(&temp);
 }
 
@@ -896,84 +944,160 @@ qd_iterator_t *qd_iterator_dup(const qd_iterator_t *iter)
         *dup = *iter;
         // drop any references to the hash segments to avoid potential double
         // free
-        DEQ_INIT(dup->hash_segments);
+        iterator_drop_segments(dup);
+        dup->in_storage = false;
     }
     return dup;
 }
 
 
-/**
- * Creates and returns a new qd_hash_segment_t and initializes it.
- */
-static qd_hash_segment_t *qd_iterator_hash_segment(void)
+qd_iterator_t *qd_iterator_init_dup(qd_iterator_storage_t *storage, const qd_iterator_t *iter)
 {
-    qd_hash_segment_t *hash_segment = new_qd_hash_segment_t();
-    DEQ_ITEM_INIT(hash_segment);
-    hash_segment->hash           = 0;
-    hash_segment->segment_length = 0;
-    return hash_segment;
+    if (!iter)
+        return 0;
+
+    qd_iterator_t *dup = (qd_iterator_t*) storage;
+    *dup = *iter;
+    iterator_drop_segments(dup);
+    dup->in_storage = true;
+    return dup;
 }
 
 
 /**
- * Create a new hash segment and insert it at the end of the linked list
+ * Append a hash segment to the segments of the iterator, moving them to the heap once they outgrow the inline array
  */
 static void qd_insert_hash_segment(qd_iterator_t *iter, uint32_t *hash, int segment_length)
 {
-    qd_hash_segment_t *hash_segment = qd_iterator_hash_segment();
+    qd_hash_segment_t *segments = iter->segments_heap ? iter->segments_heap : iter->segments_inline;
+    uint32_t           capacity = iter->segments_heap ? iter->segment_capacity : ITER_INLINE_SEGMENTS;
+
+    if (iter->segment_count == capacity) {
+        capacity *= 2;
+        qd_hash_segment_t *grown = (qd_hash_segment_t*) qd_malloc(capacity * sizeof(qd_hash_segment_t));
+        memcpy(grown, segments, iter->segment_count * sizeof(qd_hash_segment_t));
+        free(iter->segments_heap);
+        iter->segments_heap    = grown;
+        iter->segment_capacity = capacity;
+        segments               = grown;
+    }
 
     // While storing the segment, don't include the hash of the separator in the segment but do include it in the overall hash.
-    hash_segment->hash = *hash;
+    qd_hash_segment_t *hash_segment = &segments[iter->segment_count++];
+    hash_segment->hash              = *hash;
+    hash_segment->segment_length    = segment_length;
+}
+
+
+// Number of octets before the first separator in data, or len if there is none.  The word loop
+// tests eight octets at a time for either member of SEPARATORS ("./").
+//
+static inline size_t iterator_separator_span(const uint8_t *data, size_t len)
+{
+#define ITER_HAS_ZERO_OCTET(W) (((W) - 0x0101010101010101ULL) & ~(W) & 0x8080808080808080ULL)
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &data[i], sizeof(word));
+        const uint64_t dot   = word ^ 0x2e2e2e2e2e2e2e2eULL;
+        const uint64_t slash = word ^ 0x2f2f2f2f2f2f2f2fULL;
+        if (ITER_HAS_ZERO_OCTET(dot) | ITER_HAS_ZERO_OCTET(slash))
+            break;
+    }
+#undef ITER_HAS_ZERO_OCTET
 
-    hash_segment->segment_length = segment_length;
-    DEQ_INSERT_TAIL(iter->hash_segments, hash_segment);
+    for (; i < len; ++i) {
+        if (data[i] == '.' || data[i] == '/')
+            break;
+    }
+    return i;
 }
 
 
-uint32_t qd_iterator_hash_view(qd_iterator_t *iter)
+// Add an extent of the view to the hash.  If segment_length is supplied, a hash segment is recorded
+// at each separator (see qd_iterator_hash_view_segments).
+//
+static void iterator_hash_extent(qd_iterator_t *iter, qd_hash_state_t *state, const uint8_t *data, size_t len, int *segment_length)
 {
-    uint32_t hash = HASH_INIT;
-    uint8_t buffer[64];
+    if (!segment_length) {
+        qd_hash_update(state, data, len);
+        return;
+    }
+
+    while (len) {
+        size_t run = iterator_separator_span(data, len);
+        qd_hash_update(state, data, run);
+        *segment_length += run;
+        if (run == len)
+            return;
+
+        // don't include the separator in the segment but do include it in the overall hash
+        uint32_t hash = qd_hash_final(state);
+        qd_insert_hash_segment(iter, &hash, *segment_length);
+        qd_hash_update(state, &data[run], 1);
+        *segment_length += 1;
+        data += run + 1;
+        len  -= run + 1;
+    }
+}
+
 
+// Hash the view, feeding field data to the hash directly from each contiguous buffer extent.  Only
+// the synthesized prefix of an address view is produced octet by octet.
+//
+static void iterator_hash(qd_iterator_t *iter, qd_hash_state_t *state, int *segment_length)
+{
     qd_iterator_reset(iter);
-    while (!iterator_at_end(iter)) {
-        size_t count = iterator_view_copy(iter, buffer, sizeof(buffer));
-        for (int i = 0; i < count; ++i)
-            hash = HASH_COMPUTE(hash, buffer[i]);
+
+    while (!iterator_at_end(iter) && !in_field_data(iter)) {
+        uint8_t octet = qd_iterator_octet(iter);
+        iterator_hash_extent(iter, state, &octet, 1, segment_length);
     }
 
-    return hash;
+    qd_buffer_field_t *field = &iter->view_pointer;
+    if (field->buffer) {
+        while (field->remaining) {
+            size_t avail = MIN(field->remaining, (size_t) (qd_buffer_cursor(field->buffer) - field->cursor));
+            iterator_hash_extent(iter, state, field->cursor, avail, segment_length);
+            field->cursor    += avail;
+            field->remaining -= avail;
+            qd_buffer_field_normalize(field);
+        }
+    } else if (field->remaining) {  // string or binary array
+        iterator_hash_extent(iter, state, field->cursor, field->remaining, segment_length);
+        field->cursor   += field->remaining;
+        field->remaining = 0;
+    }
 }
 
 
-void qd_iterator_hash_view_segments(qd_iterator_t *iter)
+uint32_t qd_iterator_hash_view(qd_iterator_t *iter)
 {
-    if (!iter)
-        return;
+    qd_hash_state_t state;
 
-    // Reset the pointers in the iterator
-    qd_iterator_reset(iter);
-    uint32_t hash = HASH_INIT;
-    char octet;
-    int segment_length=0;
+    qd_hash_init(&state);
+    iterator_hash(iter, &state, 0);
+    return qd_hash_final(&state);
+}
 
-    qd_iterator_free_hash_segments(iter);
 
-    while (!iterator_at_end(iter)) {
-        // Get the octet at which the iterator is currently pointing to.
-        octet = qd_iterator_octet(iter);
-        segment_length += 1;
+void qd_iterator_hash_view_segments(qd_iterator_t *iter)
+{
+    if (!iter)
+        return;
 
-        if (strrchr(SEPARATORS, (int) octet)) {
-            qd_insert_hash_segment(iter, &hash, segment_length-1);
-        }
+    qd_hash_state_t state;
+    int segment_length = 0;
 
-        hash = HASH_COMPUTE(hash, octet);
-    }
+    iter->segment_count = 0;  // an overflow array from a previous call is reused
+    qd_hash_init(&state);
+    iterator_hash(iter, &state, &segment_length);
 
     // Segments should never end with a separator. see view_initialize which in turn calls
     // qd_iterator_remove_trailing_separator
-    // Insert the last segment which was not inserted in the previous while loop
+    // Insert the last segment which was not inserted by iterator_hash_extent
+    uint32_t hash = qd_hash_final(&state);
     qd_insert_hash_segment(iter, &hash, segment_length);
 
     // Return the pointers in the iterator back to the original state before returning from this function.
@@ -983,17 +1107,15 @@ void qd_iterator_hash_view_segments(qd_iterator_t *iter)
 
 bool qd_iterator_next_segment(qd_iterator_t *iter, uint32_t *hash)
 {
-    qd_hash_segment_t *hash_segment = DEQ_TAIL(iter->hash_segments);
-    if (!hash_segment)
+    if (iter->segment_count == 0)
         return false;
 
+    const qd_hash_segment_t *segments     = iter->segments_heap ? iter->segments_heap : iter->segments_inline;
+    const qd_hash_segment_t *hash_segment = &segments[--iter->segment_count];
+
     *hash = hash_segment->hash;
     qd_iterator_trim_view(iter, hash_segment->segment_length);
 
-    DEQ_REMOVE_TAIL(iter->hash_segments);
-
-    free_qd_hash_segment_t(hash_segment);
-
     return true;
 }
 
@@ -35,6 +35,7 @@
 #include "qpid/dispatch/vanflow.h"
 #include "qpid/dispatch/amqp_adaptor.h"
 
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -120,6 +121,20 @@ struct qd_log_source_t {
 
 static sys_mutex_t log_source_lock;
 
+// Effective enable mask of each module: its own, or that of the DEFAULT source if it has none.  Read without the
+// log_source_lock by qd_log_enabled(), rewritten under it whenever a mask changes.
+static atomic_int enabled_masks[NUM_LOG_SOURCES];
+
+static void update_enabled_masks_lh(void) TA_REQ(log_source_lock)
+{
+    const int default_mask = default_log_source ? default_log_source->mask : 0;
+    for (int i = 0; i < NUM_LOG_SOURCES; i++) {
+        const qd_log_source_t *src = log_sources[i];
+        const int mask = (src && src->mask != -1) ? src->mask : default_mask;
+        atomic_store_explicit(&enabled_masks[i], mask, memory_order_relaxed);
+    }
+}
+
 typedef struct level_t {
     const char *name;
     int         bit;   // QD_LOG bit
@@ -144,6 +159,33 @@ static level_t levels[] = {{"default", -1, -1, 0},
 
 static bool log_events_enabled;  // Ok to issue vanflow events (must hold log_source_lock)
 
+//
+// Asynchronous output (router attribute asyncLogging). The line is still formatted under the log_source_lock but
+// instead of being written there it is handed to a dedicated writer thread through a bounded ring. The lock
+// serializes the producers so the ring has a single producer and a single consumer and needs no lock of its own.
+// The writer does the file and syslog I/O and flushes once per batch, so a slow log file no longer stalls every
+// thread that logs. A producer never waits for the writer: a line that finds the ring full is dropped and counted,
+// and the writer reports the count ahead of the next line it writes.
+//
+#define ASYNC_RING_SIZE 1024  // must be a power of two
+#define ASYNC_BATCH_MAX 64
+
+typedef struct async_line_t {
+    log_sink_t *sink;          // holds a sink reference, released by the writer
+    int         syslog_level;  // -1 if not for syslog
+    char        text[LOG_MAX];
+} async_line_t;
+
+static async_line_t *async_ring;     // non-zero while asynchronous output is enabled (must hold log_source_lock)
+static sys_atomic_t  async_head;     // next slot the writer consumes
+static sys_atomic_t  async_tail;     // next slot the producer fills
+static sys_atomic_t  async_dropped;  // lines dropped since the last report
+static sys_atomic_t  async_waiting;  // the writer is waiting on async_cond
+static bool          async_stop;     // protected by async_lock
+static sys_mutex_t   async_lock;
+static sys_cond_t    async_cond;
+static sys_thread_t *async_thread;
+
 static const level_t invalid_level = {"invalid", -2, -2, 0};
 
 static char level_names[TEXT_MAX] = {0}; /* Set up in qd_log_initialize */
@@ -315,6 +357,102 @@ static bool default_bool(int value, int default_value) {
     return value == -1 ? default_value : value;
 }
 
+// Write a formatted line to the sink without flushing it. Does not require the log_source_lock, the caller holds a
+// reference to the sink.
+static void write_sink(log_sink_t *sink, int syslog_level, const char *log_str)
+{
+    if (sink->file) {
+        if (fputs(log_str, sink->file) == EOF) {
+            char msg[TEXT_MAX];
+            snprintf(msg, sizeof(msg), "Cannot write log output to '%s'", sink->name);
+            perror(msg);
+            exit(1);
+        };
+    }
+    if (sink->syslog && syslog_level != -1)
+        syslog(syslog_level, "%s", log_str);
+}
+
+// Queue a formatted line for the writer thread, or drop it if the ring is full. The log_source_lock makes this the
+// only producer.
+static void async_put_lh(log_sink_t *sink, int syslog_level, const char *log_str) TA_REQ(log_source_lock)
+{
+    const uint32_t tail = sys_atomic_get(&async_tail);
+    if (tail - sys_atomic_get(&async_head) >= ASYNC_RING_SIZE) {
+        sys_atomic_inc(&async_dropped);
+        return;
+    }
+
+    async_line_t *slot = &async_ring[tail & (ASYNC_RING_SIZE - 1)];
+    sys_atomic_inc(&sink->ref_count);
+    slot->sink         = sink;
+    slot->syslog_level = syslog_level;
+    strncpy(slot->text, log_str, LOG_MAX - 1);
+    slot->text[LOG_MAX - 1] = '\0';
+    sys_atomic_set(&async_tail, tail + 1);  // publishes the slot to the writer
+
+    // The writer sets async_waiting before it re-checks the tail, so either it sees this line or we see the flag
+    if (sys_atomic_get(&async_waiting)) {
+        sys_mutex_lock(&async_lock);
+        sys_cond_signal(&async_cond);
+        sys_mutex_unlock(&async_lock);
+    }
+}
+
+static void *async_writer_run(void *arg)
+{
+    async_line_t *ring = (async_line_t *) arg;
+    log_sink_t   *held[ASYNC_BATCH_MAX];
+
+    while (true) {
+        const uint32_t head = sys_atomic_get(&async_head);
+        const uint32_t tail = sys_atomic_get(&async_tail);
+
+        if (head == tail) {
+            sys_mutex_lock(&async_lock);
+            sys_atomic_set(&async_waiting, 1);
+            while (!async_stop && sys_atomic_get(&async_tail) == head)
+                sys_cond_wait(&async_cond, &async_lock);
+            sys_atomic_set(&async_waiting, 0);
+            const bool done = async_stop && sys_atomic_get(&async_tail) == head;
+            sys_mutex_unlock(&async_lock);
+            if (done)
+                break;
+            continue;
+        }
+
+        const uint32_t count   = MIN(tail - head, (uint32_t) ASYNC_BATCH_MAX);
+        uint32_t       dropped = sys_atomic_set(&async_dropped, 0);
+        for (uint32_t i = 0; i < count; ++i) {
+            async_line_t *slot = &ring[(head + i) & (ASYNC_RING_SIZE - 1)];
+            if (dropped) {
+                char notice[128];
+                snprintf(notice, sizeof(notice),
+                         "LOG (warning) %" PRIu32 " log lines dropped: asynchronous log queue full\n", dropped);
+                write_sink(slot->sink, LOG_WARNING, notice);
+                dropped = 0;
+            }
+            write_sink(slot->sink, slot->syslog_level, slot->text);
+            held[i]    = slot->sink;
+            slot->sink = 0;
+        }
+
+        // One flush per file per batch rather than one per line
+        for (uint32_t i = 0; i < count; ++i) {
+            if (held[i]->file && (i == 0 || held[i] != held[i - 1]))
+                fflush(held[i]->file);
+        }
+
+        sys_atomic_set(&async_head, head + count);  // the slots may be reused from here on
+
+        sys_mutex_lock(&log_source_lock);
+        for (uint32_t i = 0; i < count; ++i)
+            log_sink_free_lh(held[i]);
+        sys_mutex_unlock(&log_source_lock);
+    }
+    return 0;
+}
+
 // Format and output the log message to the log_source. Expects the log_source_lock is held.
 //
 static void write_log_lh(qd_log_source_t *log_source, qd_log_entry_t *entry) TA_REQ(log_source_lock)
@@ -348,19 +486,13 @@ static void write_log_lh(qd_log_source_t *log_source, qd_log_entry_t *entry) TA_
     aprintf(&begin, end, "\n");
 
     if (sink) {
-        if (sink->file) {
-            if (fputs(log_str, sink->file) == EOF) {
-                char msg[TEXT_MAX];
-                snprintf(msg, sizeof(msg), "Cannot write log output to '%s'", sink->name);
-                perror(msg);
-                exit(1);
-            };
-            fflush(sink->file);
-        }
-        if (sink->syslog) {
-            int syslog_level = level->syslog;
-            if (syslog_level != -1)
-                syslog(syslog_level, "%s", log_str);
+        const int syslog_level = sink->syslog ? level->syslog : -1;
+        if (async_ring) {
+            async_put_lh(sink, syslog_level, log_str);
+        } else {
+            write_sink(sink, syslog_level, log_str);
+            if (sink->file)
+                fflush(sink->file);
         }
     }
 
@@ -440,6 +572,7 @@ qd_log_source_t *qd_log_source_reset(qd_log_module_t module)
     sys_mutex_lock(&log_source_lock);
     qd_log_source_t* src = qd_log_source_lh(module);
     qd_log_source_defaults(src);
+    update_enabled_masks_lh();
     sys_mutex_unlock(&log_source_lock);
     return src;
 }
@@ -457,10 +590,8 @@ static void qd_log_source_free_lh(qd_log_module_t module) TA_REQ(log_source_lock
 
 bool qd_log_enabled(qd_log_module_t module, qd_log_level_t level)
 {
-    qd_log_source_t *source = qd_log_source(module);
-    if (!source) return false;
-    int mask = source->mask == -1 ? default_log_source->mask : source->mask;
-    return level & mask;
+    // Called by every qd_log(): no lock, a mask change is seen by later calls
+    return level & atomic_load_explicit(&enabled_masks[module], memory_order_relaxed);
 }
 
 bool log_enabled_lh(qd_log_source_t *source, qd_log_level_t level) TA_REQ(log_source_lock)
@@ -587,17 +718,60 @@ void qd_log_initialize(void) TA_NO_THREAD_SAFETY_ANALYSIS
     for (level_index_t i = NONE + 1; i < N_LEVELS; ++i)
         aprintf(&begin, end, ", %s", levels[i].name);
 
-    sys_mutex_init(&log_source_lock);
+    sys_mutex_init_named(&log_source_lock, "log_source");
 
     default_log_source                   = qd_log_source(LOG_DEFAULT);
     default_log_source->mask = levels[INFO].mask;
     default_log_source->includeTimestamp = true;
     default_log_source->includeSource = 0;
     default_log_source->sink = log_sink_lh(SINK_STDERR);
+    update_enabled_masks_lh();
+}
+
+void qd_log_enable_async(void)
+{
+    sys_mutex_lock(&log_source_lock);
+    if (!async_ring) {
+        sys_atomic_init(&async_head, 0);
+        sys_atomic_init(&async_tail, 0);
+        sys_atomic_init(&async_dropped, 0);
+        sys_atomic_init(&async_waiting, 0);
+        async_stop = false;
+        sys_mutex_init(&async_lock);
+        sys_cond_init(&async_cond);
+        async_ring   = (async_line_t *) qd_calloc(ASYNC_RING_SIZE, sizeof(async_line_t));
+        async_thread = sys_thread(SYS_THREAD_LOG, async_writer_run, async_ring);
+    }
+    sys_mutex_unlock(&log_source_lock);
+}
+
+// Switch back to synchronous output and let the writer drain the lines already queued
+static void qd_log_disable_async(void)
+{
+    sys_mutex_lock(&log_source_lock);
+    async_line_t *ring = async_ring;
+    async_ring         = 0;
+    sys_mutex_unlock(&log_source_lock);
+
+    if (!ring)
+        return;
+
+    sys_mutex_lock(&async_lock);
+    async_stop = true;
+    sys_cond_signal(&async_cond);
+    sys_mutex_unlock(&async_lock);
+
+    sys_thread_join(async_thread);
+    sys_thread_free(async_thread);
+    async_thread = 0;
+    sys_cond_free(&async_cond);
+    sys_mutex_free(&async_lock);
+    free(ring);
 }
 
 void qd_log_finalize(void) TA_NO_THREAD_SAFETY_ANALYSIS
 {
+    qd_log_disable_async();
     for (int i = 0; i < NUM_LOG_SOURCES; i++)
         qd_log_source_free_lh(i);
     while (DEQ_HEAD(entries))
@@ -605,6 +779,7 @@ void qd_log_finalize(void) TA_NO_THREAD_SAFETY_ANALYSIS
     while (DEQ_HEAD(sink_list))
         log_sink_free_lh(DEQ_HEAD(sink_list));
     default_log_source = NULL;  // stale value would misconfigure new router started again in the same process
+    update_enabled_masks_lh();
 }
 
 QD_EXPORT qd_error_t qd_log_entity(qd_entity_t *entity)
@@ -714,6 +889,7 @@ QD_EXPORT qd_error_t qd_log_entity(qd_entity_t *entity)
             }
             else {
                 src->mask = mask;
+                update_enabled_masks_lh();
             }
         }
 
@@ -26,5 +26,6 @@
 void qd_log_initialize(void);
 void qd_log_global_options(const char* format, bool utc);
 void qd_log_finalize(void);
+void qd_log_enable_async(void);
 void qd_log_formatted_time(const struct timeval *time, char *buf, size_t buflen);
 #endif
@@ -22,9 +22,12 @@
 #include "aprintf.h"
 #include "buffer_field_api.h"
 #include "compose_private.h"
+#include "compression.h"
 #include "message_private.h"
 #include "policy.h"
+#include "spool.h"
 
+#include "qpid/dispatch/alloc_pool.h"
 #include "qpid/dispatch/amqp.h"
 #include "qpid/dispatch/ctools.h"
 #include "qpid/dispatch/discriminator.h"
@@ -32,7 +35,9 @@
 #include "qpid/dispatch/internal/thread_annotations.h"
 #include "qpid/dispatch/iterator.h"
 #include "qpid/dispatch/log.h"
+#include "qpid/dispatch/sharded_counter.h"
 #include "qpid/dispatch/threading.h"
+#include "qpid/dispatch/trace_mask.h"
 #include <qpid/dispatch/cutthrough_utils.h>
 #include <qpid/dispatch/amqp_adaptor.h>
 
@@ -95,11 +100,81 @@ static const char * const section_names[QD_DEPTH_ALL + 1] = {
 PN_HANDLE(PN_DELIVERY_CTX)
 
 ALLOC_DEFINE_CONFIG_SAFE(qd_message_t, sizeof(qd_message_pvt_t), 0, 0);
-ALLOC_DEFINE(qd_message_content_t);
+ALLOC_DEFINE(qd_message_arena_t);
+ALLOC_DEFINE(qd_message_ra_local_t);
 
 typedef void (*buffer_process_t) (void *context, const unsigned char *base, int length);
 
-void qd_message_initialize(void) {}
+// Unicast cut-through ring configuration and router-wide statistics
+static uint32_t uct_max_slots = UCT_SLOT_COUNT_MAX;
+static qd_sharded_counter_t uct_stat_streams;
+static qd_sharded_counter_t uct_stat_producer_stalls;
+static qd_sharded_counter_t uct_stat_ring_growths;
+static qd_sharded_counter_t uct_stat_slots_in_use;
+
+
+// Number of ring slots holding produced buffers.  The slot capacity is a power of two so the unsigned difference of
+// the two indexes stays correct when it wraps.
+static inline uint32_t uct_full_slots(const qd_message_content_t *content)
+{
+    return (sys_atomic_get((sys_atomic_t *) &content->uct_produce_slot)
+            - sys_atomic_get((sys_atomic_t *) &content->uct_consume_slot)) & (content->uct_slot_capacity - 1);
+}
+
+
+static inline bool uct_ring_full(const qd_message_content_t *content)
+{
+    return uct_full_slots(content) >= sys_atomic_get((sys_atomic_t *) &content->uct_slot_limit);
+}
+
+
+static inline bool uct_ring_empty(const qd_message_content_t *content)
+{
+    return sys_atomic_get((sys_atomic_t *) &content->uct_produce_slot)
+        == sys_atomic_get((sys_atomic_t *) &content->uct_consume_slot);
+}
+
+
+static inline uint32_t uct_next_slot(const qd_message_content_t *content, uint32_t slot)
+{
+    return (slot + 1) & (content->uct_slot_capacity - 1);
+}
+
+
+// Producer side: publish the slot just filled.
+static inline void uct_produced_slot(qd_message_content_t *content, uint32_t slot)
+{
+    sys_atomic_set(&content->uct_produce_slot, uct_next_slot(content, slot));
+    qd_sharded_counter_add(&uct_stat_slots_in_use, 1);
+    if (uct_ring_full(content) && !IS_ATOMIC_FLAG_SET(&content->uct_producer_stalled)) {
+        SET_ATOMIC_FLAG(&content->uct_producer_stalled);
+        qd_sharded_counter_add(&uct_stat_producer_stalls, 1);
+    }
+}
+
+
+// Consumer side: release the slot just drained.  If the producer filled the ring and the consumer has since drained
+// all of it, the consumer outran the producer's resume latency: the window rather than either endpoint is limiting
+// throughput, so double the ring depth (up to the capacity).  Only the consumer writes uct_slot_limit.
+static inline void uct_consumed_slot(qd_message_content_t *content, uint32_t slot)
+{
+    sys_atomic_set(&content->uct_consume_slot, uct_next_slot(content, slot));
+    qd_sharded_counter_sub(&uct_stat_slots_in_use, 1);
+    if (uct_ring_empty(content) && IS_ATOMIC_FLAG_SET(&content->uct_producer_stalled)) {
+        CLEAR_ATOMIC_FLAG(&content->uct_producer_stalled);
+        uint32_t limit = sys_atomic_get(&content->uct_slot_limit);
+        if (limit < content->uct_slot_capacity - 1) {
+            sys_atomic_set(&content->uct_slot_limit, MIN((limit + 1) * 2, content->uct_slot_capacity) - 1);
+            qd_sharded_counter_add(&uct_stat_ring_growths, 1);
+        }
+    }
+}
+
+void qd_message_initialize(void)
+{
+    // the originating message of each arena is a qd_message_t too
+    qd_alloc_desc_embedded_in(&__desc_qd_message_t, &__desc_qd_message_arena_t);
+}
 
 /**
  * Quote non-printable characters suitable for log messages. Output in buffer.
@@ -404,6 +479,7 @@ static const char REPR_END[] = "}\0";
 
 char* qd_message_repr(qd_message_t *msg, char* buffer, size_t len, uint32_t flags) {
     if (flags == 0
+        || MSG_CONTENT(msg)->pass_through
         || qd_message_check_depth(msg, QD_DEPTH_APPLICATION_PROPERTIES) != QD_MESSAGE_DEPTH_OK
         || !((qd_message_pvt_t *)msg)->content->section_application_properties.parsed) {
         return NULL;
@@ -740,6 +816,15 @@ static qd_section_status_t message_section_check_LH(qd_message_content_t *conten
     unsigned char *end_of_buffer = qd_buffer_cursor(test_buffer);
     int            idx           = 0;
 
+    if (end_of_buffer - test_cursor > pattern_length) {
+        // Fast path: the whole descriptor and its tag octet are contiguous in
+        // this buffer so a single memcmp replaces the per-octet walk.
+        if (memcmp(test_cursor, pattern, pattern_length) != 0)
+            return QD_SECTION_NO_MATCH;
+        test_cursor += pattern_length;
+        idx = pattern_length;
+    }
+
     while (idx < pattern_length && *test_cursor == pattern[idx]) {
         idx++;
         test_cursor++;
@@ -1095,31 +1180,36 @@ static qd_field_location_t *qd_message_field_location(qd_message_t *msg, qd_mess
     return 0;
 }
 
-qd_message_t *qd_message(void)
-{
-    qd_message_pvt_t *msg = (qd_message_pvt_t*) new_qd_message_t();
-    if (!msg)
-        return 0;
 
-    ZERO (msg);
+// Publish the size of the buffer chain for lock-free readers.  Must be called
+// after every change to content->buffers.
+static inline void content_buffers_changed_LH(qd_message_content_t *content) TA_REQ(content->lock)
+{
+    sys_atomic_set(&content->buffer_count, DEQ_SIZE(content->buffers));
+}
 
-    msg->content = new_qd_message_content_t();
 
-    if (msg->content == 0) {
-        free_qd_message_t((qd_message_t*) msg);
+qd_message_t *qd_message(void)
+{
+    qd_message_arena_t *arena = new_qd_message_arena_t();
+    if (!arena)
         return 0;
-    }
 
+    qd_message_pvt_t *msg = &arena->msg;
+    ZERO (msg);
+    msg->content = &arena->content;
     ZERO(msg->content);
-    sys_mutex_init(&msg->content->lock);
+    sys_mutex_init_named(&msg->content->lock, "message_content");
     sys_mutex_init(&msg->content->producer_activation_lock);
     sys_mutex_init(&msg->content->consumer_activation_lock);
     sys_atomic_init(&msg->content->aborted, 0);
+    sys_atomic_init(&msg->content->buffer_count, 0);
     sys_atomic_init(&msg->content->discard, 0);
     sys_atomic_init(&msg->content->no_body, 0);
     sys_atomic_init(&msg->content->oversize, 0);
     sys_atomic_init(&msg->content->priority, QDR_DEFAULT_PRIORITY);
     sys_atomic_init(&msg->content->priority_parsed, 0);
+    sys_atomic_init(&msg->content->q2_input_holdoff, 0);
     sys_atomic_init(&msg->content->receive_complete, 0);
     sys_atomic_init(&msg->content->ref_count, 1);
     sys_atomic_init(&msg->content->uct_enabled, 0);
@@ -1128,6 +1218,55 @@ qd_message_t *qd_message(void)
 }
 
 
+static inline const char *ra_to_override(const qd_message_pvt_t *msg)
+{
+    return msg->ra_local ? msg->ra_local->to_override : 0;
+}
+
+
+static inline const char *ra_ingress_mesh(const qd_message_pvt_t *msg)
+{
+    return msg->ra_local ? msg->ra_local->ingress_mesh : 0;
+}
+
+
+static void ra_local_release(qd_message_ra_local_t *local)
+{
+    if (local && sys_atomic_dec(&local->refs) == 1) {
+        free(local->to_override);
+        free(local->ingress_mesh);
+        sys_atomic_destroy(&local->refs);
+        free_qd_message_ra_local_t(local);
+    }
+}
+
+
+// The annotation overrides of msg for modification, unshared from the other copies of the message first.  Only the
+// thread owning msg copies or modifies it, so a reference count of one means no other copy can pick up the block.
+//
+static qd_message_ra_local_t *ra_local_writable(qd_message_pvt_t *msg)
+{
+    qd_message_ra_local_t *shared = msg->ra_local;
+    if (shared && sys_atomic_get(&shared->refs) == 1)
+        return shared;
+
+    qd_message_ra_local_t *local = new_qd_message_ra_local_t();
+    ZERO(local);
+    sys_atomic_init(&local->refs, 1);
+    if (shared) {
+        if (shared->to_override)
+            local->to_override = qd_strdup(shared->to_override);
+        if (shared->ingress_mesh) {
+            local->ingress_mesh = (char*) qd_malloc(QD_DISCRIMINATOR_BYTES);
+            memcpy(local->ingress_mesh, shared->ingress_mesh, QD_DISCRIMINATOR_BYTES);
+        }
+        ra_local_release(shared);
+    }
+    msg->ra_local = local;
+    return local;
+}
+
+
 void qd_message_free(qd_message_t *in_msg)
 {
     if (!in_msg) return;
@@ -1135,12 +1274,12 @@ void qd_message_free(qd_message_t *in_msg)
     qd_message_pvt_t          *msg        = (qd_message_pvt_t*) in_msg;
     qd_message_q2_unblocker_t  q2_unblock = {0};
 
-    free(msg->ra_to_override);
-    free(msg->ra_ingress_mesh);
+    ra_local_release(msg->ra_local);
 
     sys_atomic_destroy(&msg->send_complete);
 
-    qd_message_content_t *content = msg->content;
+    qd_message_content_t *content  = msg->content;
+    const bool            in_arena = msg == &MSG_ARENA(content)->msg;
 
     if (msg->is_fanout) {
         //
@@ -1160,15 +1299,16 @@ void qd_message_free(qd_message_t *in_msg)
             }
             buf = next_buf;
         }
+        content_buffers_changed_LH(content);
         --content->fanout;
 
         //
         // it is possible that we've freed enough buffers to clear Q2 holdoff
         //
-        if (content->q2_input_holdoff
+        if (IS_ATOMIC_FLAG_SET(&content->q2_input_holdoff)
             && was_blocked
             && _Q2_holdoff_should_unblock_LH(content)) {
-            content->q2_input_holdoff = false;
+            CLEAR_ATOMIC_FLAG(&content->q2_input_holdoff);
             q2_unblock = content->q2_unblocker;
         }
 
@@ -1179,6 +1319,11 @@ void qd_message_free(qd_message_t *in_msg)
     if (q2_unblock.handler)
         q2_unblock.handler(q2_unblock.context);
 
+    // The originating message stays allocated with the arena while copies remain: its safe pointers must stop
+    // resolving now.  Bumped before the content reference is dropped, after that the arena may be gone.
+    if (in_arena)
+        qd_alloc_sequence_bump(msg);
+
     rc = sys_atomic_dec(&content->ref_count) - 1;
     if (rc == 0) {
         if (content->ra_pf_ingress)
@@ -1189,8 +1334,6 @@ void qd_message_free(qd_message_t *in_msg)
             qd_parse_free(content->ra_pf_ingress_mesh);
         if (content->ra_pf_trace)
             qd_parse_free(content->ra_pf_trace);
-        if (content->ra_pf_flags)
-            qd_parse_free(content->ra_pf_flags);
 
         qd_buffer_list_free_buffers(&content->buffers);
 
@@ -1201,11 +1344,13 @@ void qd_message_free(qd_message_t *in_msg)
         sys_mutex_free(&content->consumer_activation_lock);
         sys_mutex_free(&content->producer_activation_lock);
         sys_atomic_destroy(&content->aborted);
+        sys_atomic_destroy(&content->buffer_count);
         sys_atomic_destroy(&content->discard);
         sys_atomic_destroy(&content->no_body);
         sys_atomic_destroy(&content->oversize);
         sys_atomic_destroy(&content->priority);
         sys_atomic_destroy(&content->priority_parsed);
+        sys_atomic_destroy(&content->q2_input_holdoff);
         sys_atomic_destroy(&content->receive_complete);
         sys_atomic_destroy(&content->ref_count);
 
@@ -1213,18 +1358,24 @@ void qd_message_free(qd_message_t *in_msg)
         // If unicast/cut-through was enabled, clean up the related state and buffers
         //
         if (IS_ATOMIC_FLAG_SET(&content->uct_enabled)) {
+            qd_sharded_counter_sub(&uct_stat_slots_in_use, uct_full_slots(content));
+            sys_atomic_destroy(&content->uct_slot_limit);
+            sys_atomic_destroy(&content->uct_producer_stalled);
             sys_atomic_destroy(&content->uct_produce_slot);
             sys_atomic_destroy(&content->uct_consume_slot);
-            for (int i = 0; i < UCT_SLOT_COUNT; i++) {
+            for (uint32_t i = 0; i < content->uct_slot_capacity; i++) {
                 qd_buffer_list_free_buffers(&content->uct_slots[i]);
             }
+            free(content->uct_slots);
         }
 
         sys_atomic_destroy(&content->uct_enabled);
-        free_qd_message_content_t(content);
+        free_qd_message_arena_t(MSG_ARENA(content));
     }
 
-    free_qd_message_t((qd_message_t*) msg);
+    // the originating message is released with its content, above
+    if (!in_arena)
+        free_qd_message_t((qd_message_t*) msg);
 }
 
 
@@ -1250,8 +1401,9 @@ qd_message_t *qd_message_copy(qd_message_t *in_msg)
     copy->is_fanout     = false;
 
     if (!content->ra_disabled) {
-        if (msg->ra_to_override)
-            copy->ra_to_override = qd_strdup(msg->ra_to_override);
+        copy->ra_local = msg->ra_local;
+        if (copy->ra_local)
+            sys_atomic_inc(&copy->ra_local->refs);
         copy->ra_flags = msg->ra_flags;
     }
 
@@ -1289,19 +1441,13 @@ const char *qd_message_parse_router_annotations(qd_message_t *in_msg)
         return "Invalid router annotations: bad hdr_length";
     }
 
-    const char *err = qd_parse_router_annotations(&ra_list,
-                                                  &content->ra_pf_ingress,
-                                                  &content->ra_pf_ingress_mesh,
-                                                  &content->ra_pf_to_override,
-                                                  &content->ra_pf_trace,
-                                                  &content->ra_pf_flags);
+    // only locate the entries here, they are parsed when first asked for (see ra_parsed_entry)
+    const char *err = qd_parse_router_annotations(&ra_list, &content->ra);
     if (err)
         return(err);
 
     // copy flags into message so they can be modified
-    msg->ra_flags = qd_parse_as_uint(content->ra_pf_flags);
-    if (!qd_parse_ok(content->ra_pf_flags))
-        return qd_parse_error(content->ra_pf_flags);
+    msg->ra_flags = content->ra.flags;
 
     return 0;
 }
@@ -1309,19 +1455,31 @@ const char *qd_message_parse_router_annotations(qd_message_t *in_msg)
 
 void qd_message_set_to_override_annotation(qd_message_t *in_msg, const char *to_field)
 {
-    qd_message_pvt_t *msg = (qd_message_pvt_t*) in_msg;
-    free(msg->ra_to_override);
-    msg->ra_to_override = to_field ? qd_strdup(to_field) : 0;
+    qd_message_pvt_t *msg     = (qd_message_pvt_t*) in_msg;
+    const char       *current = ra_to_override(msg);
+    if (current == to_field || (current && to_field && strcmp(current, to_field) == 0))
+        return;
+
+    qd_message_ra_local_t *local = ra_local_writable(msg);
+    free(local->to_override);
+    local->to_override = to_field ? qd_strdup(to_field) : 0;
 }
 
 
 void qd_message_set_ingress_mesh(qd_message_t *in_msg, const char *mesh_identifier)
 {
-    qd_message_pvt_t *msg = (qd_message_pvt_t*) in_msg;
-    free(msg->ra_ingress_mesh);
+    qd_message_pvt_t *msg     = (qd_message_pvt_t*) in_msg;
+    const char       *current = ra_ingress_mesh(msg);
+    if (current == mesh_identifier
+        || (current && mesh_identifier && memcmp(current, mesh_identifier, QD_DISCRIMINATOR_BYTES) == 0))
+        return;
+
+    qd_message_ra_local_t *local = ra_local_writable(msg);
+    free(local->ingress_mesh);
+    local->ingress_mesh = 0;
     if (!!mesh_identifier) {
-        msg->ra_ingress_mesh = (char*) malloc(QD_DISCRIMINATOR_BYTES);
-        memcpy(msg->ra_ingress_mesh, mesh_identifier, QD_DISCRIMINATOR_BYTES);
+        local->ingress_mesh = (char*) qd_malloc(QD_DISCRIMINATOR_BYTES);
+        memcpy(local->ingress_mesh, mesh_identifier, QD_DISCRIMINATOR_BYTES);
     }
 }
 
@@ -1375,6 +1533,18 @@ void qd_message_disable_router_annotations(qd_message_t *msg)
 }
 
 
+void qd_message_set_pass_through(qd_message_t *msg)
+{
+    MSG_CONTENT(msg)->pass_through = true;
+}
+
+
+bool qd_message_is_pass_through(const qd_message_t *msg)
+{
+    return MSG_CONTENT(msg)->pass_through;
+}
+
+
 bool qd_message_is_discard(qd_message_t *msg)
 {
     if (!msg)
@@ -1412,6 +1582,7 @@ void qd_message_add_fanout(qd_message_t *out_msg)
     if (!buf) {
         assert(content->pending && qd_buffer_size(content->pending) > 0);
         DEQ_INSERT_TAIL(content->buffers, content->pending);
+        content_buffers_changed_LH(content);
         content->pending = 0;
         buf = DEQ_HEAD(content->buffers);
     }
@@ -1429,6 +1600,40 @@ void qd_message_add_fanout(qd_message_t *out_msg)
 }
 
 
+void qd_message_set_expiry(qd_message_t *msg, uint64_t ingress_ns)
+{
+    qd_message_content_t *content = MSG_CONTENT(msg);
+
+    if (content->expiry_set)
+        return;
+    content->expiry_set = true;
+
+    qd_iterator_t *iter = qd_message_field_iterator(msg, QD_FIELD_HEADER);
+    if (!!iter) {
+        qd_parsed_field_t *field = qd_parse(iter);
+        if (qd_parse_ok(field)) {
+            if (qd_parse_is_list(field) && qd_parse_sub_count(field) >= 3) {
+                qd_parsed_field_t *ttl_field = qd_parse_sub_value(field, 2);
+                if (qd_parse_tag(ttl_field) != QD_AMQP_NULL) {
+                    uint32_t ttl = qd_parse_as_uint(ttl_field);  // milliseconds
+                    if (qd_parse_ok(ttl_field) && ttl > 0)
+                        content->expiry_ns = ingress_ns + (uint64_t) ttl * 1000000;
+                }
+            }
+        }
+        qd_parse_free(field);
+        qd_iterator_free(iter);
+    }
+}
+
+
+bool qd_message_expired(const qd_message_t *msg, uint64_t now_ns)
+{
+    const uint64_t expiry_ns = MSG_CONTENT(msg)->expiry_ns;
+    return expiry_ns && now_ns >= expiry_ns;
+}
+
+
 /**
 * There are two sources of priority information --
 * message and address. Address takes precedence, falling
@@ -1483,8 +1688,8 @@ void qd_message_set_receive_complete(qd_message_t *in_msg)
         LOCK(&content->lock);
 
         SET_ATOMIC_FLAG(&content->receive_complete);
-        if (content->q2_input_holdoff) {
-            content->q2_input_holdoff = false;
+        if (IS_ATOMIC_FLAG_SET(&content->q2_input_holdoff)) {
+            CLEAR_ATOMIC_FLAG(&content->q2_input_holdoff);
             q2_unblock = content->q2_unblocker;
         }
         content->q2_unblocker.handler = 0;
@@ -1540,6 +1745,7 @@ void qd_message_set_tag_sent(qd_message_t *in_msg, bool tag_sent)
  * Receive and discard large messages for which there is no destination.
  * Don't waste resources by putting the message into internal buffers.
  * Message locking is not required since the message content buffers are untouched.
+ * Compressed deliveries are discarded without decompressing them.
  */
 qd_message_t *discard_receive(pn_delivery_t *delivery,
                               pn_link_t     *link,
@@ -1591,7 +1797,7 @@ bool qd_message_has_data_in_content_or_pending_buffers(qd_message_t   *msg)
         return false;
 
     if (MSG_CONTENT(msg)) {
-        if (DEQ_SIZE(MSG_CONTENT(msg)->buffers) > 0) {
+        if (sys_atomic_get(&MSG_CONTENT(msg)->buffer_count) > 0) {
             qd_buffer_t *buf = DEQ_HEAD(MSG_CONTENT(msg)->buffers);
             if (buf && qd_buffer_size(buf) > 0)
                 return true;
@@ -1618,8 +1824,8 @@ static inline void activate_message_producer(qd_message_t *stream)
 {
     qd_message_content_t *content = MSG_CONTENT(stream);
 
-    uint32_t full_slots = (sys_atomic_get(&content->uct_produce_slot) - sys_atomic_get(&content->uct_consume_slot)) % UCT_SLOT_COUNT;
-    if (full_slots < UCT_RESUME_THRESHOLD) {
+    // resume the producer once the ring is half empty
+    if (uct_full_slots(content) <= sys_atomic_get(&content->uct_slot_limit) / 2) {
         LOCK(&content->producer_activation_lock);
         if (content->uct_producer_activation.type != QD_ACTIVATION_NONE) {
             cutthrough_notify_buffers_consumed_outbound(&content->uct_producer_activation);
@@ -1632,14 +1838,51 @@ static inline void activate_message_producer(qd_message_t *stream)
 // Read incoming data from a pn_link_t and store it into a buffer list. Limit buffer list length to a maximum of
 // limit. Helper routine for qd_message_receive_cutthrough()
 //
+// Receive the payload octets of the delivery, a pn_link_recv() replacement that decompresses compressed deliveries.  A
+// corrupt compressed delivery is aborted.
+//
+static inline ssize_t link_recv(qd_message_pvt_t *msg, pn_link_t *link, char *bytes, size_t size)
+{
+    if (!msg->compressed)
+        return pn_link_recv(link, bytes, size);
+
+    qd_link_t *qdl = (qd_link_t*) pn_link_get_context(link);
+    ssize_t    rc  = qd_compression_recv(*qd_link_compression(qdl), link, bytes, size,
+                                         qd_connection_compression_stats(qd_link_connection(qdl)));
+    if (rc == PN_ERR)
+        SET_ATOMIC_FLAG(&msg->content->aborted);
+    return rc;
+}
+
+// pn_delivery_pending() including the received octets held by the decompressor
+//
+static inline size_t link_pending(qd_message_pvt_t *msg, pn_delivery_t *delivery)
+{
+    size_t pending = pn_delivery_pending(delivery);
+    if (msg->compressed)
+        pending += qd_compression_pending(*qd_link_compression((qd_link_t*) pn_link_get_context(pn_delivery_link(delivery))));
+    return pending;
+}
+
+//
+// A buffer is only allocated while proton holds pending octets for the delivery. Once the pending data has been
+// drained the delivery state is probed with an empty read rather than by pulling into a buffer that would be
+// discarded on every pass.
+//
 // Returns 0 on success else the < 0 status code from pn_link_recv() (PN_EOS, PN_ABORTED, etc).  If 0 returned the
 // caller must check the length of the blist - if it is zero then no data is available to receive at this time.
 //
-static inline ssize_t link_receive_bufs(pn_link_t *link, qd_buffer_list_t *blist, int limit)
+static inline ssize_t link_receive_bufs(qd_message_pvt_t *msg, pn_delivery_t *delivery, pn_link_t *link,
+                                        qd_buffer_list_t *blist, int limit)
 {
     while (limit-- > 0) {
+        if (link_pending(msg, delivery) == 0) {
+            char probe;
+            return pn_link_recv(link, &probe, 0);
+        }
+
         qd_buffer_t *buf = qd_buffer();
-        ssize_t rc = pn_link_recv(link, (char *) qd_buffer_cursor(buf), qd_buffer_capacity(buf));
+        ssize_t rc = link_recv(msg, link, (char *) qd_buffer_cursor(buf), qd_buffer_capacity(buf));
         if (rc <= 0) {
             qd_buffer_free(buf);
             return rc;
@@ -1653,7 +1896,7 @@ static inline ssize_t link_receive_bufs(pn_link_t *link, qd_buffer_list_t *blist
 
 static void qd_message_receive_cutthrough(qd_message_t *in_msg, pn_delivery_t *delivery, pn_link_t *link, qd_message_content_t *content)
 {
-    bool stalled = (sys_atomic_get(&content->uct_consume_slot) - sys_atomic_get(&content->uct_produce_slot)) % UCT_SLOT_COUNT == 1;
+    bool stalled = uct_ring_full(content);
     bool notify_produced = false;
 
     while (!stalled && !qd_message_receive_complete(in_msg)) {
@@ -1663,7 +1906,8 @@ static void qd_message_receive_cutthrough(qd_message_t *in_msg, pn_delivery_t *d
         uint32_t     use_slot = sys_atomic_get(&content->uct_produce_slot);
         assert(DEQ_SIZE(content->uct_slots[use_slot]) == 0);
 
-        ssize_t rc   = link_receive_bufs(link, &content->uct_slots[use_slot], UCT_SLOT_BUF_LIMIT);
+        ssize_t rc   = link_receive_bufs((qd_message_pvt_t*) in_msg, delivery, link, &content->uct_slots[use_slot],
+                                         UCT_SLOT_BUF_LIMIT);
         bool data_rx = DEQ_SIZE(content->uct_slots[use_slot]) > 0;
         if (data_rx) {
             //
@@ -1672,11 +1916,8 @@ static void qd_message_receive_cutthrough(qd_message_t *in_msg, pn_delivery_t *d
             notify_produced = true;
             qd_log(LOG_MESSAGE, QD_LOG_DEBUG, "qd_message_receive_cutthrough - %u octets written to use_slot=%u",
                    qd_buffer_list_length(&content->uct_slots[use_slot]), use_slot);
-            sys_atomic_set(&content->uct_produce_slot, (use_slot + 1) % UCT_SLOT_COUNT);
-
-            if ((sys_atomic_get(&content->uct_consume_slot) - sys_atomic_get(&content->uct_produce_slot)) % UCT_SLOT_COUNT == 1) {
-                stalled = true;
-            }
+            uct_produced_slot(content, use_slot);
+            stalled = uct_ring_full(content);
         }
 
         // Check for rx complete, error, or no data available:
@@ -1729,6 +1970,9 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
         pn_record_def(record, PN_DELIVERY_CTX, PN_VOID);
         pn_record_set(record, PN_DELIVERY_CTX, (void*) msg);
         msg->content->max_message_size = qd_connection_max_message_size(qdc);
+        msg->content->q2_upper         = qd_link_q2_limit(qdl);
+        msg->compressed = qd_connection_compression(qdc)
+                          && qd_compression_recv_start(qd_link_compression(qdl), delivery);
         qd_link_set_incoming_msg(qdl, (qd_message_t*) msg);
     }
 
@@ -1759,17 +2003,31 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
     //      have been processed and freed by outbound processing then
     //      message holdoff is cleared and receiving may continue.
     //
-    LOCK(&msg->content->lock);
-    if (!qd_link_is_q2_limit_unbounded(qdl) && !msg->content->disable_q2_holdoff) {
-        if (msg->content->q2_input_holdoff) {
-            UNLOCK(&msg->content->lock);
-            return (qd_message_t*)msg;
-        }
+    // No lock needed: holdoff is never set while disable_q2_holdoff is true
+    // (disabling clears it), and a stale read only means the receiver is
+    // re-activated by the Q2 unblock handler.
+    //
+    if (!qd_link_is_q2_limit_unbounded(qdl) && IS_ATOMIC_FLAG_SET(&msg->content->q2_input_holdoff)) {
+        return (qd_message_t*)msg;
     }
-    UNLOCK(&msg->content->lock);
 
     // Loop until msg is complete, error seen, or incoming bytes are consumed
     qd_message_content_t *content = msg->content;
+
+    if (content->q2_receive_held) {
+        //
+        // Receive is resuming after Q2 holdoff.  If the outgoing side has
+        // already sent every unprotected buffer the input side was the
+        // bottleneck: let the link buffer more before holding off again.
+        //
+        content->q2_receive_held = false;
+        LOCK(&content->lock);
+        if (DEQ_SIZE(content->buffers) == content->protected_buffers) {
+            qd_link_q2_starved(qdl);
+            content->q2_upper = qd_link_q2_limit(qdl);
+        }
+        UNLOCK(&content->lock);
+    }
     bool recv_error = false;
     while (1) {
         //
@@ -1777,7 +2035,7 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
         //
         bool at_eos = (pn_delivery_partial(delivery) == false) &&
                       (pn_delivery_aborted(delivery) == false) &&
-                      (pn_delivery_pending(delivery) == 0);
+                      (link_pending(msg, delivery) == 0);
 
         if (at_eos || recv_error) {
             // Message is complete
@@ -1791,6 +2049,7 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
                         qd_buffer_set_fanout(content->pending, content->fanout);
                         DEQ_INSERT_TAIL(content->buffers,
                                         content->pending);
+                        content_buffers_changed_LH(content);
                     } else {
                         // pending buffer is empty
                         pending_free = content->pending;
@@ -1825,14 +2084,22 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
         } else {
             // Pending buffer exists
             if (qd_buffer_capacity(content->pending) == 0) {
-                // Pending buffer is full
+                // Pending buffer is full.  Spool it first if the message holds too much content, nothing else
+                // refers to it yet.
+                if (qd_spool_wanted(sys_atomic_get(&content->buffer_count),
+                                    qd_alloc_memory_state() >= QD_MEMORY_SHRINK_Q2))
+                    content->pending = qd_spool_buffer(content->pending);
                 LOCK(&content->lock);
                 qd_buffer_set_fanout(content->pending, content->fanout);
                 DEQ_INSERT_TAIL(content->buffers, content->pending);
+                content_buffers_changed_LH(content);
                 content->pending = 0;
                 if (_Q2_holdoff_should_block_LH(content)) {
                     if (!qd_link_is_q2_limit_unbounded(qdl)) {
-                        content->q2_input_holdoff = true;
+                        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
+                        content->q2_receive_held = true;
+                        qd_link_q2_blocked(qdl);
+                        content->q2_upper = qd_link_q2_limit(qdl);
                         UNLOCK(&content->lock);
                         break;
                     }
@@ -1847,9 +2114,9 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
         //
         // Try to fill the remaining space in the pending buffer.
         //
-        rc = pn_link_recv(link,
-                          (char*) qd_buffer_cursor(content->pending),
-                          qd_buffer_capacity(content->pending));
+        rc = link_recv(msg, link,
+                       (char*) qd_buffer_cursor(content->pending),
+                       qd_buffer_capacity(content->pending));
 
         if (rc < 0) {
             // error or eos seen. next pass breaks out of loop
@@ -1887,6 +2154,7 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
                 LOCK(&content->lock);
                 qd_buffer_set_fanout(content->pending, content->fanout);
                 DEQ_INSERT_TAIL(content->buffers, content->pending);
+                content_buffers_changed_LH(content);
                 content->pending = 0;
                 UNLOCK(&content->lock);
                 content->pending = qd_buffer();
@@ -1899,10 +2167,137 @@ qd_message_t *qd_message_receive(pn_delivery_t *delivery, ssize_t *octets_receiv
 }
 
 
+//
+// Send payload octets of the current delivery, a pn_link_send() replacement that compresses compressed deliveries.
+//
+static inline ssize_t link_send(qd_message_pvt_t *msg, qd_link_t *link, const char *bytes, size_t len)
+{
+    if (!msg->compressed)
+        return pn_link_send(qd_link_pn(link), bytes, len);
+    return qd_compression_send(*qd_link_compression(link), qd_link_pn(link), bytes, len,
+                               qd_connection_compression_stats(qd_link_connection(link)));
+}
+
+
+typedef struct send_context_t {
+    qd_message_pvt_t *msg;
+    qd_link_t        *link;
+} send_context_t;
+
 static void send_handler(void *context, const unsigned char *start, int length)
 {
-    pn_link_t *pnl = (pn_link_t*) context;
-    pn_link_send(pnl, (const char*) start, length);
+    send_context_t *send = (send_context_t*) context;
+    link_send(send->msg, send->link, (const char*) start, length);
+}
+
+
+// Resolves the fingerprints of a compact trace to router ids, see qd_message_set_trace_resolver()
+static qd_tracemask_t *trace_resolver;
+
+#define TRACE_STACK_ENTRIES 32  // trace entries handled without a heap allocation
+
+qd_tracemask_t *qd_message_set_trace_resolver(qd_tracemask_t *tm)
+{
+    qd_tracemask_t *old = trace_resolver;
+    trace_resolver      = tm;
+    return old;
+}
+
+
+// Read the next entry of a compact trace, bf is advanced past it
+//
+static uint64_t trace_entry_read(qd_buffer_field_t *bf)
+{
+    uint8_t octets[QD_TRACE_FINGERPRINT_SIZE];
+    qd_buffer_field_ncopy(bf, octets, QD_TRACE_FINGERPRINT_SIZE);
+    uint64_t fingerprint = 0;
+    for (int i = 0; i < QD_TRACE_FINGERPRINT_SIZE; i++)
+        fingerprint = (fingerprint << 8) | octets[i];
+    return fingerprint;
+}
+
+
+static void trace_entry_write(uint8_t *octets, uint64_t fingerprint)
+{
+    for (int i = QD_TRACE_FINGERPRINT_SIZE - 1; i >= 0; i--) {
+        octets[i]     = (uint8_t) fingerprint;
+        fingerprint >>= 8;
+    }
+}
+
+
+// Fingerprint the next string entry of a trace list, bf is advanced past it.  The entries have been validated when
+// the message was received.
+//
+static uint64_t trace_entry_fingerprint(qd_buffer_field_t *bf)
+{
+    uint8_t  tag = 0;
+    uint32_t len = 0;
+    qd_buffer_field_octet(bf, &tag);
+    if (tag == QD_AMQP_STR8_UTF8) {
+        uint8_t len8 = 0;
+        qd_buffer_field_octet(bf, &len8);
+        len = len8;
+    } else {
+        qd_buffer_field_uint32(bf, &len);
+    }
+
+    char  stack[256];
+    char *trace_id = len <= sizeof(stack) ? stack : (char*) qd_malloc(len);
+    qd_buffer_field_ncopy(bf, (uint8_t*) trace_id, len);
+    uint64_t fingerprint = qd_tracemask_fingerprint(trace_id, len);
+    if (trace_id != stack)
+        free(trace_id);
+    return fingerprint;
+}
+
+
+// index 3 of the router annotations as a compact trace: the received trace followed by this router
+//
+static void compose_compact_trace(qd_message_content_t *content, qd_composed_field_t *ra)
+{
+    const uint32_t count = content->ra.trace.remaining ? content->ra.trace_count : 0;
+    const size_t   len   = (size_t) (count + 1) * QD_TRACE_FINGERPRINT_SIZE;
+    uint8_t        stack[TRACE_STACK_ENTRIES * QD_TRACE_FINGERPRINT_SIZE];
+    uint8_t       *trace = len <= sizeof(stack) ? stack : (uint8_t*) qd_malloc(len);
+
+    qd_buffer_field_t bf = content->ra.trace_items;
+    if (content->ra.trace_compact) {
+        qd_buffer_field_ncopy(&bf, trace, len - QD_TRACE_FINGERPRINT_SIZE);
+    } else {
+        // received from a router that does not use compact traces
+        for (uint32_t i = 0; i < count; i++)
+            trace_entry_write(trace + i * QD_TRACE_FINGERPRINT_SIZE, trace_entry_fingerprint(&bf));
+    }
+    const char *router_id = qd_router_id();
+    trace_entry_write(trace + count * QD_TRACE_FINGERPRINT_SIZE, qd_tracemask_fingerprint(router_id, strlen(router_id)));
+
+    qd_compose_insert_binary(ra, trace, len);
+    if (trace != stack)
+        free(trace);
+}
+
+
+// index 3 of the router annotations as a trace list for a router that does not use compact traces, from a received
+// compact trace.  Routers this router does not know of cannot be named, they are kept as the entry of
+// qd_tracemask_unknown_trace_id() so the trace keeps its length and their fingerprints are restored by the next router
+// that uses compact traces.
+//
+static void compose_trace_from_compact(qd_message_content_t *content, qd_composed_field_t *ra)
+{
+    qd_buffer_field_t bf = content->ra.trace_items;
+    char              trace_id[256];
+
+    qd_compose_start_list(ra);
+    for (uint32_t i = 0; i < content->ra.trace_count; i++) {
+        uint64_t fingerprint = trace_entry_read(&bf);
+        size_t   len         = trace_resolver ? qd_tracemask_trace_id(trace_resolver, fingerprint, trace_id, sizeof(trace_id)) : 0;
+        if (!len)
+            len = qd_tracemask_unknown_trace_id(fingerprint, trace_id, sizeof(trace_id));
+        qd_compose_insert_string_n(ra, trace_id, len);
+    }
+    qd_compose_insert_string(ra, qd_router_id());
+    qd_compose_end_list(ra);
 }
 
 
@@ -1927,10 +2322,10 @@ uint32_t _compose_router_annotations(qd_message_pvt_t *msg, unsigned int ra_flag
     qd_compose_insert_uint(ra, msg->ra_flags);
 
     // index 1: to-override. Value local to the message takes precedence.
-    if (msg->ra_to_override) {
-        qd_compose_insert_string(ra, msg->ra_to_override);
-    } else if (content->ra_pf_to_override) {
-        qd_buffer_field_t bf = qd_parse_typed_field(content->ra_pf_to_override);
+    if (ra_to_override(msg)) {
+        qd_compose_insert_string(ra, ra_to_override(msg));
+    } else if (content->ra.to_override.remaining) {
+        qd_buffer_field_t bf = content->ra.to_override;
         qd_compose_insert_buffer_field(ra, &bf, 1);
     } else {
         qd_compose_insert_null(ra);
@@ -1939,8 +2334,8 @@ uint32_t _compose_router_annotations(qd_message_pvt_t *msg, unsigned int ra_flag
     // index 2: ingress router
     if (!!(ra_flags & QD_MESSAGE_RA_STRIP_INGRESS)) {
         qd_compose_insert_null(ra);
-    } else if (content->ra_pf_ingress) {
-        qd_buffer_field_t bf = qd_parse_typed_field(content->ra_pf_ingress);
+    } else if (content->ra.ingress.remaining) {
+        qd_buffer_field_t bf = content->ra.ingress;
         qd_compose_insert_buffer_field(ra, &bf, 1);
     } else {
         // use local node
@@ -1950,23 +2345,27 @@ uint32_t _compose_router_annotations(qd_message_pvt_t *msg, unsigned int ra_flag
     // index 3: trace list
     if (!!(ra_flags & QD_MESSAGE_RA_STRIP_TRACE)) {
         qd_compose_empty_list(ra);
+    } else if (!!(ra_flags & QD_MESSAGE_RA_COMPACT_TRACE)) {
+        compose_compact_trace(content, ra);
+    } else if (content->ra.trace.remaining && content->ra.trace_compact) {
+        compose_trace_from_compact(content, ra);
     } else {
         qd_compose_start_list(ra);
         // start with received trace list first.
-        if (content->ra_pf_trace) {
+        if (content->ra.trace.remaining) {
             // insert just the encoded content, not the list type headers (raw)
-            qd_buffer_field_t bf = qd_parse_raw_field(content->ra_pf_trace);
-            qd_compose_insert_buffer_field(ra, &bf, qd_parse_sub_count(content->ra_pf_trace));
+            qd_buffer_field_t bf = content->ra.trace_items;
+            qd_compose_insert_buffer_field(ra, &bf, content->ra.trace_count);
         }
         qd_compose_insert_string(ra, qd_router_id());
         qd_compose_end_list(ra);
     }
 
     // index 4: edge-mesh identifier
-    if (!!msg->ra_ingress_mesh) {
-        qd_compose_insert_string_n(ra, msg->ra_ingress_mesh, QD_DISCRIMINATOR_BYTES);
-    } else if (!!content->ra_pf_ingress_mesh) {
-        qd_buffer_field_t bf = qd_parse_typed_field(content->ra_pf_ingress_mesh);
+    if (!!ra_ingress_mesh(msg)) {
+        qd_compose_insert_string_n(ra, ra_ingress_mesh(msg), QD_DISCRIMINATOR_BYTES);
+    } else if (content->ra.ingress_mesh.remaining) {
+        qd_buffer_field_t bf = content->ra.ingress_mesh;
         qd_compose_insert_buffer_field(ra, &bf, 1);
     } else {
         // qd_compose_insert_null(ra);   // Un-comment this line if more fields are added after this one.
@@ -1980,21 +2379,174 @@ uint32_t _compose_router_annotations(qd_message_pvt_t *msg, unsigned int ra_flag
 }
 
 
+//
+// Cache of the router annotations section last sent on an outgoing link.  Between a pair of
+// routers most messages carry the same annotations, so the inputs to
+// _compose_router_annotations() are flattened into a key and the encoded section is reused
+// while the key matches.  Inputs larger than the key buffer (long trace lists) are not cached.
+//
+#define RA_CACHE_KEY_MAX 512
+
+struct qd_message_ra_cache_t {
+    size_t   key_len;
+    uint8_t  key[RA_CACHE_KEY_MAX];
+    size_t   encoded_len;
+    uint8_t *encoded;
+};
+
+typedef struct {
+    size_t  len;
+    bool    overflow;
+    uint8_t bytes[RA_CACHE_KEY_MAX];
+} ra_cache_key_t;
+
+
+void qd_message_ra_cache_free(qd_message_ra_cache_t *cache)
+{
+    if (cache) {
+        free(cache->encoded);
+        free(cache);
+    }
+}
+
+
+// Append a tagged, length-prefixed segment to the key.  If bf is set its content is used,
+// otherwise len octets at data.
+//
+static void ra_cache_key_add(ra_cache_key_t *key, uint8_t tag, const uint8_t *data, size_t len, qd_buffer_field_t *bf)
+{
+    if (bf)
+        len = bf->remaining;
+    if (key->overflow || key->len + 3 + len > RA_CACHE_KEY_MAX) {
+        key->overflow = true;
+        return;
+    }
+    key->bytes[key->len++] = tag;
+    key->bytes[key->len++] = (uint8_t) (len >> 8);
+    key->bytes[key->len++] = (uint8_t) len;
+    if (bf)
+        qd_buffer_field_ncopy(bf, &key->bytes[key->len], len);
+    else if (len)
+        memcpy(&key->bytes[key->len], data, len);
+    key->len += len;
+}
+
+
+// Build the key from every input _compose_router_annotations() uses.  The local router id is
+// constant and therefore left out.
+//
+static void ra_cache_make_key(qd_message_pvt_t *msg, unsigned int ra_flags, ra_cache_key_t *key)
+{
+    qd_message_content_t *content = msg->content;
+    uint8_t               flags[8];
+    qd_buffer_field_t     bf;
+
+    key->len      = 0;
+    key->overflow = false;
+
+    memcpy(flags, &ra_flags, 4);
+    memcpy(flags + 4, &msg->ra_flags, 4);
+    ra_cache_key_add(key, 'F', flags, 8, 0);
+
+    const char *to_override = ra_to_override(msg);
+    if (to_override) {
+        ra_cache_key_add(key, 'L', (const uint8_t*) to_override, strlen(to_override), 0);
+    } else if (content->ra.to_override.remaining) {
+        bf = content->ra.to_override;
+        ra_cache_key_add(key, 'P', 0, 0, &bf);
+    } else {
+        ra_cache_key_add(key, 'N', 0, 0, 0);
+    }
+
+    if (!(ra_flags & QD_MESSAGE_RA_STRIP_INGRESS) && content->ra.ingress.remaining) {
+        bf = content->ra.ingress;
+        ra_cache_key_add(key, 'P', 0, 0, &bf);
+    } else {
+        ra_cache_key_add(key, 'N', 0, 0, 0);
+    }
+
+    if (!(ra_flags & QD_MESSAGE_RA_STRIP_TRACE) && content->ra.trace.remaining) {
+        uint32_t count = content->ra.trace_count;
+        ra_cache_key_add(key, content->ra.trace_compact ? 'B' : 'C', (const uint8_t*) &count, sizeof(count), 0);
+        bf = content->ra.trace_items;
+        ra_cache_key_add(key, 'P', 0, 0, &bf);
+    } else {
+        ra_cache_key_add(key, 'N', 0, 0, 0);
+    }
+
+    if (!!ra_ingress_mesh(msg)) {
+        ra_cache_key_add(key, 'L', (const uint8_t*) ra_ingress_mesh(msg), QD_DISCRIMINATOR_BYTES, 0);
+    } else if (content->ra.ingress_mesh.remaining) {
+        bf = content->ra.ingress_mesh;
+        ra_cache_key_add(key, 'P', 0, 0, &bf);
+    } else {
+        ra_cache_key_add(key, 'N', 0, 0, 0);
+    }
+}
+
+
+// Send the router annotations section for msg on link, from the link's cache when possible.
+//
+static void send_router_annotations(qd_message_pvt_t *msg, unsigned int ra_flags, qd_link_t *link)
+{
+    qd_message_ra_cache_t **cachep = qd_link_ra_cache(link);
+    ra_cache_key_t          key;
+
+    ra_cache_make_key(msg, ra_flags, &key);
+
+    qd_message_ra_cache_t *cache = *cachep;
+    if (!key.overflow && cache && cache->key_len == key.len && memcmp(cache->key, key.bytes, key.len) == 0) {
+        link_send(msg, link, (const char*) cache->encoded, cache->encoded_len);
+        return;
+    }
+
+    qd_buffer_list_t ra_buffers;
+    uint32_t len = _compose_router_annotations(msg, ra_flags, &ra_buffers);
+    if (len) {
+        if (!key.overflow) {
+            if (!cache) {
+                cache = NEW(qd_message_ra_cache_t);
+                ZERO(cache);
+                *cachep = cache;
+            }
+            if (cache->encoded_len < len) {
+                free(cache->encoded);
+                cache->encoded = (uint8_t*) qd_malloc(len);
+            }
+            size_t offset = 0;
+            for (qd_buffer_t *buf = DEQ_HEAD(ra_buffers); buf; buf = DEQ_NEXT(buf)) {
+                memcpy(cache->encoded + offset, qd_buffer_base(buf), qd_buffer_size(buf));
+                offset += qd_buffer_size(buf);
+            }
+            cache->encoded_len = len;
+            cache->key_len     = key.len;
+            memcpy(cache->key, key.bytes, key.len);
+        }
+
+        qd_buffer_t *buffer = DEQ_HEAD(ra_buffers);
+        assert(buffer);
+        const uint8_t *cursor = qd_buffer_base(buffer);
+        send_context_t send = {.msg = msg, .link = link};
+        advance_guarded(&cursor, &buffer, len, send_handler, (void*) &send);
+        qd_buffer_list_free_buffers(&ra_buffers);
+    }
+}
+
+
 static void qd_message_send_cut_through(qd_message_pvt_t *msg, qd_message_content_t *content, qd_link_t *link, bool *session_stalled)
 {
-    pn_link_t *pnl             = qd_link_pn(link);
     size_t     session_limit   = qd_session_get_outgoing_capacity(qd_link_get_session(link));
     bool       notify_consumed = false;
 
     *session_stalled = !IS_ATOMIC_FLAG_SET(&content->aborted) && session_limit == 0;
-    while (!*session_stalled && (sys_atomic_get(&content->uct_consume_slot) - sys_atomic_get(&content->uct_produce_slot)) % UCT_SLOT_COUNT != 0) {
+    while (!*session_stalled && !uct_ring_empty(content)) {
         uint32_t use_slot = sys_atomic_get(&content->uct_consume_slot);
 
         qd_buffer_t *buf = DEQ_HEAD(content->uct_slots[use_slot]);
         while (!!buf && session_limit > 0) {
             DEQ_REMOVE_HEAD(content->uct_slots[use_slot]);
             if (!IS_ATOMIC_FLAG_SET(&content->aborted)) {
-                ssize_t sent = pn_link_send(pnl, (char*) qd_buffer_base(buf), qd_buffer_size(buf));
+                ssize_t sent = link_send(msg, link, (char*) qd_buffer_base(buf), qd_buffer_size(buf));
                 (void) sent;
                 assert(sent == qd_buffer_size(buf));
                 // (probably) ok to overflow the session limit a bit
@@ -2005,14 +2557,14 @@ static void qd_message_send_cut_through(qd_message_pvt_t *msg, qd_message_conten
         }
 
         if (DEQ_IS_EMPTY(content->uct_slots[use_slot])) {
-            sys_atomic_set(&content->uct_consume_slot, (use_slot + 1) % UCT_SLOT_COUNT);
+            uct_consumed_slot(content, use_slot);
             notify_consumed = true;
         }
         *session_stalled = !IS_ATOMIC_FLAG_SET(&content->aborted) && session_limit == 0;
     }
 
     if ((IS_ATOMIC_FLAG_SET(&content->aborted) || IS_ATOMIC_FLAG_SET(&content->receive_complete))
-        && sys_atomic_get(&content->uct_consume_slot) == sys_atomic_get(&content->uct_produce_slot)) {
+        && uct_ring_empty(content)) {
         //
         // The stream is aborted or receive complete (no new content expected) AND we have consumed
         // all of the buffered content.  Mark the message as send-complete.
@@ -2030,12 +2582,14 @@ static void qd_message_send_cut_through(qd_message_pvt_t *msg, qd_message_conten
 ssize_t qd_message_send(qd_message_t *in_msg,
                         qd_link_t    *link,
                         unsigned int  ra_flags,
+                        size_t        quantum,
                         bool         *session_stalled)
 {
     qd_message_pvt_t     *msg     = (qd_message_pvt_t*) in_msg;
     qd_message_content_t *content = msg->content;
     pn_link_t            *pnl     = qd_link_pn(link);
     ssize_t bytes_sent = 0;
+    ssize_t total_sent = 0;
 
     CHECK_PROACTOR_CONNECTION(pn_session_connection(pn_link_session(pnl)));
 
@@ -2068,6 +2622,9 @@ ssize_t qd_message_send(qd_message_t *in_msg,
         msg->cursor.buffer = DEQ_HEAD(content->buffers);
         msg->cursor.cursor = qd_buffer_base(msg->cursor.buffer);
 
+        msg->compressed = qd_connection_compression(qd_link_connection(link))
+                          && qd_compression_send_start(qd_link_compression(link), pn_link_current(pnl));
+
         if (!content->ra_disabled) {
 
             // skip over the old incoming router annotations if present
@@ -2084,15 +2641,9 @@ ssize_t qd_message_send(qd_message_t *in_msg,
 
             if (ra_flags != QD_MESSAGE_RA_STRIP_ALL) {
                 // prefix the message with new outgoing router annotations section
-                qd_buffer_list_t ra_buffers;
-                uint32_t len = _compose_router_annotations(msg, ra_flags, &ra_buffers);
-                if (len) {
-                    qd_buffer_t *buffer = DEQ_HEAD(ra_buffers);
-                    assert(buffer);
-                    const uint8_t *cursor = qd_buffer_base(buffer);
-                    advance_guarded(&cursor, &buffer, len, send_handler, (void*) pnl);
-                    qd_buffer_list_free_buffers(&ra_buffers);
-                }
+                if (qd_connection_compact_trace(qd_link_connection(link)))
+                    ra_flags |= QD_MESSAGE_RA_COMPACT_TRACE;
+                send_router_annotations(msg, ra_flags, link);
             }
         }
 
@@ -2103,10 +2654,11 @@ ssize_t qd_message_send(qd_message_t *in_msg,
 
     qd_message_q2_unblocker_t q2_unblock = {0};
     size_t session_limit = qd_session_get_outgoing_capacity(qd_link_get_session(link));
+    size_t send_limit    = quantum ? MIN(session_limit, quantum) : session_limit;
 
     while (!IS_ATOMIC_FLAG_SET(&content->aborted)
            && buf
-           && session_limit > 0) {
+           && send_limit > 0) {
 
         // This will send the remaining data in the buffer if any. There may be
         // zero bytes left to send if we stopped here last time and there was
@@ -2114,9 +2666,9 @@ ssize_t qd_message_send(qd_message_t *in_msg,
         //
         size_t buf_size = qd_buffer_size(buf);
         int num_bytes_to_send = buf_size - (msg->cursor.cursor - qd_buffer_base(buf));
-        num_bytes_to_send = MIN(num_bytes_to_send, session_limit);
+        num_bytes_to_send = MIN(num_bytes_to_send, send_limit);
         if (num_bytes_to_send > 0) {
-            bytes_sent = pn_link_send(pnl, (const char*)msg->cursor.cursor, num_bytes_to_send);
+            bytes_sent = link_send(msg, link, (const char*)msg->cursor.cursor, num_bytes_to_send);
         }
 
         LOCK(&content->lock);
@@ -2139,6 +2691,8 @@ ssize_t qd_message_send(qd_message_t *in_msg,
 
             msg->cursor.cursor += bytes_sent;
             session_limit -= bytes_sent;
+            send_limit    -= bytes_sent;
+            total_sent    += bytes_sent;
 
             if (msg->cursor.cursor == qd_buffer_cursor(buf)) {
                 //
@@ -2159,12 +2713,13 @@ ssize_t qd_message_send(qd_message_t *in_msg,
                     if (ref_count == 1 && !qd_message_is_resend_released(in_msg)) {
 
                         DEQ_REMOVE(content->buffers, buf);
+                        content_buffers_changed_LH(content);
                         qd_buffer_free(buf);
                         ++content->buffers_freed;
 
                         // by freeing a buffer there now may be room to restart a
                         // stalled message receiver
-                        if (content->q2_input_holdoff) {
+                        if (IS_ATOMIC_FLAG_SET(&content->q2_input_holdoff)) {
                             if (_Q2_holdoff_should_unblock_LH(content)) {
                                 // wake up receive side
                                 // Note: clearing holdoff here is easy compared to
@@ -2172,7 +2727,7 @@ ssize_t qd_message_send(qd_message_t *in_msg,
                                 // shows that rx_handler may run and subsequently
                                 // set input holdoff before the deferred handler
                                 // runs.
-                                content->q2_input_holdoff = false;
+                                CLEAR_ATOMIC_FLAG(&content->q2_input_holdoff);
                                 q2_unblock = content->q2_unblocker;
                             }
                         }
@@ -2180,6 +2735,8 @@ ssize_t qd_message_send(qd_message_t *in_msg,
 
                     msg->cursor.buffer = next_buf;
                     msg->cursor.cursor = (next_buf) ? qd_buffer_base(next_buf) : 0;
+                    if (next_buf)
+                        qd_spool_prefetch(next_buf);
 
                     SET_ATOMIC_BOOL(&msg->send_complete, (complete && !next_buf && !IS_ATOMIC_FLAG_SET(&content->uct_enabled)));
                 }
@@ -2225,7 +2782,34 @@ ssize_t qd_message_send(qd_message_t *in_msg,
         *session_stalled = session_limit == 0;
     }
 
-    return bytes_sent;
+    return total_sent;
+}
+
+
+size_t qd_message_buffered_octets(const qd_message_t *msg)
+{
+    return (size_t) sys_atomic_get(&MSG_CONTENT(msg)->buffer_count) * QD_BUFFER_SIZE;
+}
+
+
+// Peek at the descriptor at the start of the next section without moving the
+// parse cursor.  Every section begins with the 0x00 descriptor constructor
+// followed by either 0x53 (smallulong, the short pattern) or 0x80 (ulong, the
+// long pattern).  Returns that format code, 0 if the next octets cannot start
+// a section descriptor, or -1 if there is not enough data yet.
+static int peek_descriptor_format(qd_buffer_t *buffer, unsigned char *cursor)
+{
+    if (!cursor || !can_advance(&cursor, &buffer))
+        return -1;
+
+    if (*cursor != 0x00)
+        return 0;
+
+    cursor++;
+    if (!can_advance(&cursor, &buffer))
+        return -1;
+
+    return (*cursor == 0x53 || *cursor == 0x80) ? *cursor : 0;
 }
 
 
@@ -2243,12 +2827,19 @@ static qd_message_depth_status_t message_check_depth_LH(qd_message_content_t *co
     if (depth <= content->parse_depth)
         return QD_MESSAGE_DEPTH_OK;
 
+    // The descriptor format tells us up front which of the two patterns can
+    // possibly match, so at most one pattern is compared against the buffer
+    // chain per section instead of trying the short form and then the long.
     qd_section_status_t rc = QD_SECTION_NO_MATCH;
-    if (short_pattern) {
-        rc = message_section_check_LH(content, &content->parse_buffer, &content->parse_cursor, short_pattern, SHORT, expected_tags, location, false, protect_buffer);
-    }
-    if (rc == QD_SECTION_NO_MATCH)  // try the alternative
+    int format = peek_descriptor_format(content->parse_buffer, content->parse_cursor);
+    if (format == -1) {
+        rc = QD_SECTION_NEED_MORE;
+    } else if (format == 0x53) {
+        if (short_pattern)
+            rc = message_section_check_LH(content, &content->parse_buffer, &content->parse_cursor, short_pattern, SHORT, expected_tags, location, false, protect_buffer);
+    } else if (format == 0x80) {
         rc = message_section_check_LH(content, &content->parse_buffer, &content->parse_cursor, long_pattern,  LONG,  expected_tags, location, false, protect_buffer);
+    }
 
     if (rc == QD_SECTION_MATCH || (optional && rc == QD_SECTION_NO_MATCH)) {
         content->parse_depth = depth;
@@ -2479,7 +3070,7 @@ qd_iterator_t *qd_message_field_iterator_typed(qd_message_t *msg, qd_message_fie
 }
 
 
-qd_iterator_t *qd_message_field_iterator(qd_message_t *msg, qd_message_field_t field)
+static qd_iterator_t *message_field_iterator(qd_message_t *msg, qd_message_field_t field, qd_iterator_storage_t *storage)
 {
     qd_field_location_t *loc = qd_message_field_location(msg, field);
 
@@ -2494,10 +3085,24 @@ qd_iterator_t *qd_message_field_iterator(qd_message_t *msg, qd_message_field_t f
     if (!advance(&cursor, &buffer, loc->hdr_length))
         return 0;
 
+    if (storage)
+        return qd_iterator_init_buffer(storage, buffer, cursor - qd_buffer_base(buffer), loc->length, ITER_VIEW_ALL);
     return qd_iterator_buffer(buffer, cursor - qd_buffer_base(buffer), loc->length, ITER_VIEW_ALL);
 }
 
 
+qd_iterator_t *qd_message_field_iterator(qd_message_t *msg, qd_message_field_t field)
+{
+    return message_field_iterator(msg, field, 0);
+}
+
+
+qd_iterator_t *qd_message_field_iterator_init(qd_iterator_storage_t *storage, qd_message_t *msg, qd_message_field_t field)
+{
+    return message_field_iterator(msg, field, storage);
+}
+
+
 ssize_t qd_message_field_length(qd_message_t *msg, qd_message_field_t field)
 {
     qd_field_location_t *loc = qd_message_field_location(msg, field);
@@ -2537,10 +3142,11 @@ ssize_t qd_message_field_copy(qd_message_t *msg, qd_message_field_t field, char
 }
 
 
-void qd_message_get_raw_body_data(qd_message_t *in_msg, qd_buffer_t **buf, size_t *offset)
+size_t qd_message_take_raw_body(qd_message_t *in_msg, qd_buffer_list_t *buffers, size_t limit, bool *complete)
 {
     qd_message_pvt_t     *msg     = (qd_message_pvt_t*) in_msg;
     qd_message_content_t *content = msg->content;
+    size_t                count   = 0;
 
     LOCK(&content->lock);
 
@@ -2552,29 +3158,37 @@ void qd_message_get_raw_body_data(qd_message_t *in_msg, qd_buffer_t **buf, size_
     assert(content->parse_depth >= QD_DEPTH_RAW_BODY);
     assert(IS_ATOMIC_FLAG_SET(&content->uct_enabled));
 
+    if (!msg->raw_body_started) {
+        msg->raw_body_started = true;
+        msg->raw_body.buffer  = content->section_raw_body.buffer;
+        msg->raw_body.offset  = content->section_raw_body.offset;
+    }
+
     //
-    // If there are no body octets in the buffer list, return a NULL buffer pointer.  We will do pure cut-through in this case.
+    // The buffer holding the start of the raw body also holds the message headers.  The buffers after it hold nothing
+    // but body data: with no other consumer of the content they are handed over, otherwise they are shared.
     //
-    if (content->section_raw_body.buffer == 0 || (qd_buffer_size(content->section_raw_body.buffer) == content->section_raw_body.offset && !DEQ_NEXT(content->section_raw_body.buffer))) {
-        *buf    = 0;
-        *offset = 0;
-    } else {
-        *buf    = content->section_raw_body.buffer;
-        *offset = content->section_raw_body.offset;
+    const bool single_consumer = content->fanout <= 1 && !qd_message_is_resend_released(in_msg);
+    while (count < limit && msg->raw_body.buffer) {
+        qd_buffer_t *buf = msg->raw_body.buffer;
+        msg->raw_body.buffer = DEQ_NEXT(buf);
+
+        if (single_consumer && buf != content->section_raw_body.buffer && buf != msg->cursor.buffer) {
+            DEQ_REMOVE(content->buffers, buf);
+            content_buffers_changed_LH(content);
+            DEQ_INSERT_TAIL(*buffers, buf);
+            count++;
+        } else if (qd_buffer_size(buf) > msg->raw_body.offset) {
+            qd_buffer_t *share = qd_buffer_share(buf, msg->raw_body.offset);
+            DEQ_INSERT_TAIL(*buffers, share);
+            count++;
+        }
+        msg->raw_body.offset = 0;
     }
+    *complete = !msg->raw_body.buffer;
 
     UNLOCK(&content->lock);
-}
-
-
-void qd_message_release_raw_body(qd_message_t *in_msg)
-{
-    //
-    // This function intentionally left blank.
-    //
-    // This is an optimization that will be implemented if we discover that large numbers of buffers
-    // are held by open cut-through streams.
-    //
+    return count;
 }
 
 
@@ -2618,9 +3232,10 @@ void qd_message_compose_1(qd_message_t *msg, const char *to, qd_buffer_list_t *b
 
     SET_ATOMIC_FLAG(&content->receive_complete);
     qd_compose_take_buffers(field, &content->buffers);
+    content_buffers_changed_LH(content);
     if (_Q2_holdoff_should_block_LH(content))
         // initialize the Q2 flag:
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
 
     UNLOCK(&content->lock);
     qd_compose_free(field);
@@ -2636,10 +3251,11 @@ void qd_message_compose_2(qd_message_t *msg, qd_composed_field_t *field, bool co
     LOCK(&content->lock);
 
     content->buffers          = *field_buffers;
+    content_buffers_changed_LH(content);
     SET_ATOMIC_BOOL(&content->receive_complete, complete);
     if (_Q2_holdoff_should_block_LH(content))
         // initialize the Q2 flag:
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
 
     UNLOCK(&content->lock);
 
@@ -2660,10 +3276,11 @@ void qd_message_compose_3(qd_message_t *msg, qd_composed_field_t *field1, qd_com
     content->buffers = *field1_buffers;
     DEQ_INIT(*field1_buffers);
     DEQ_APPEND(content->buffers, (*field2_buffers));
+    content_buffers_changed_LH(content);
 
     // initialize the Q2 flag:
     if (_Q2_holdoff_should_block_LH(content))
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
 
     UNLOCK(&content->lock);
 }
@@ -2685,10 +3302,11 @@ void qd_message_compose_4(qd_message_t *msg, qd_composed_field_t *field1, qd_com
     DEQ_INIT(*field1_buffers);
     DEQ_APPEND(content->buffers, (*field2_buffers));
     DEQ_APPEND(content->buffers, (*field3_buffers));
+    content_buffers_changed_LH(content);
 
     // initialize the Q2 flag:
     if (_Q2_holdoff_should_block_LH(content))
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
 
     UNLOCK(&content->lock);
 }
@@ -2712,6 +3330,7 @@ void qd_message_compose_5(qd_message_t *msg, qd_composed_field_t *field1, qd_com
     DEQ_APPEND(content->buffers, (*field2_buffers));
     DEQ_APPEND(content->buffers, (*field3_buffers));
     DEQ_APPEND(content->buffers, (*field4_buffers));
+    content_buffers_changed_LH(content);
 
     UNLOCK(&content->lock);
 }
@@ -2747,8 +3366,9 @@ qd_message_t *qd_message_compose(qd_composed_field_t *f1,
     // the new message until this function returns.
 #pragma GCC diagnostic push
     TA_SUPPRESS;
+    content_buffers_changed_LH(content);
     if (_Q2_holdoff_should_block_LH(content))
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
 #pragma GCC diagnostic pop
 
     return msg;
@@ -2772,11 +3392,12 @@ int qd_message_extend(qd_message_t *msg, qd_composed_field_t *field, bool *q2_bl
     }
 
     DEQ_APPEND(content->buffers, (*buffers));
+    content_buffers_changed_LH(content);
     count = DEQ_SIZE(content->buffers);
 
     // buffers added - must check for Q2:
     if (_Q2_holdoff_should_block_LH(content)) {
-        content->q2_input_holdoff = true;
+        SET_ATOMIC_FLAG(&content->q2_input_holdoff);
         if (q2_blocked)
             *q2_blocked = true;
     }
@@ -2786,27 +3407,75 @@ int qd_message_extend(qd_message_t *msg, qd_composed_field_t *field, bool *q2_bl
 }
 
 
+// Parse a received router annotation entry on first use. The content is shared by every copy of the message and the
+// copies may be examined on different threads, hence the lock.
+//
+static qd_parsed_field_t *ra_parsed_entry(qd_message_content_t *content, qd_parsed_field_t **pf,
+                                          const qd_buffer_field_t *entry)
+{
+    if (!entry->remaining)
+        return 0;
+
+    LOCK(&content->lock);
+    if (!*pf)
+        *pf = qd_parse_buffer_field(entry);
+    qd_parsed_field_t *result = *pf;
+    UNLOCK(&content->lock);
+    return result;
+}
+
+
 qd_parsed_field_t *qd_message_get_ingress_router(qd_message_t *msg)
 {
-    return ((qd_message_pvt_t*) msg)->content->ra_pf_ingress;
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    return ra_parsed_entry(content, &content->ra_pf_ingress, &content->ra.ingress);
 }
 
 
 qd_parsed_field_t *qd_message_get_to_override(qd_message_t *msg)
 {
-    return ((qd_message_pvt_t*)msg)->content->ra_pf_to_override;
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    return ra_parsed_entry(content, &content->ra_pf_to_override, &content->ra.to_override);
 }
 
 
 qd_parsed_field_t *qd_message_get_trace(qd_message_t *msg)
 {
-    return ((qd_message_pvt_t*) msg)->content->ra_pf_trace;
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    return ra_parsed_entry(content, &content->ra_pf_trace, &content->ra.trace);
+}
+
+
+bool qd_message_trace_is_compact(qd_message_t *msg)
+{
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    return content->ra.trace.remaining && content->ra.trace_compact;
+}
+
+
+uint32_t qd_message_get_trace_fingerprints(qd_message_t *msg, uint64_t *fingerprints, uint32_t max)
+{
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    if (!content->ra.trace.remaining)
+        return 0;
+
+    qd_buffer_field_t bf = content->ra.trace_items;
+    for (uint32_t i = 0; i < content->ra.trace_count && i < max; i++)
+        fingerprints[i] = content->ra.trace_compact ? trace_entry_read(&bf) : trace_entry_fingerprint(&bf);
+    return content->ra.trace_count;
+}
+
+
+size_t qd_message_trace_id(uint64_t fingerprint, char *buffer, size_t size)
+{
+    return trace_resolver ? qd_tracemask_trace_id(trace_resolver, fingerprint, buffer, size) : 0;
 }
 
 
 qd_parsed_field_t *qd_message_get_ingress_mesh(qd_message_t *msg)
 {
-    return ((qd_message_pvt_t*) msg)->content->ra_pf_ingress_mesh;
+    qd_message_content_t *content = ((qd_message_pvt_t*) msg)->content;
+    return ra_parsed_entry(content, &content->ra_pf_ingress_mesh, &content->ra.ingress_mesh);
 }
 
 
@@ -2828,8 +3497,8 @@ void qd_message_Q2_holdoff_disable(qd_message_t *msg)
     LOCK(&content->lock);
     if (!msg_pvt->content->disable_q2_holdoff) {
         msg_pvt->content->disable_q2_holdoff = true;
-        if (content->q2_input_holdoff) {
-            content->q2_input_holdoff = false;
+        if (IS_ATOMIC_FLAG_SET(&content->q2_input_holdoff)) {
+            CLEAR_ATOMIC_FLAG(&content->q2_input_holdoff);
             q2_unblock = content->q2_unblocker;
         }
     }
@@ -2840,11 +3509,17 @@ void qd_message_Q2_holdoff_disable(qd_message_t *msg)
 }
 
 
+static inline size_t q2_upper_LH(const qd_message_content_t *content) TA_REQ(content->lock)
+{
+    return content->q2_upper ? content->q2_upper : QD_QLIMIT_Q2_UPPER;
+}
+
+
 bool _Q2_holdoff_should_block_LH(const qd_message_content_t *content) TA_REQ(content->lock)
 {
     const size_t buff_ct = DEQ_SIZE(content->buffers);
     assert(buff_ct >= content->protected_buffers);
-    return !content->disable_q2_holdoff && (buff_ct - content->protected_buffers) >= QD_QLIMIT_Q2_UPPER;
+    return !content->disable_q2_holdoff && (buff_ct - content->protected_buffers) >= q2_upper_LH(content);
 }
 
 
@@ -2852,7 +3527,7 @@ bool _Q2_holdoff_should_unblock_LH(const qd_message_content_t *content) TA_REQ(c
 {
     const size_t buff_ct = DEQ_SIZE(content->buffers);
     assert(buff_ct >= content->protected_buffers);
-    return content->disable_q2_holdoff || (buff_ct - content->protected_buffers) < QD_QLIMIT_Q2_LOWER;
+    return content->disable_q2_holdoff || (buff_ct - content->protected_buffers) < q2_upper_LH(content) / 2;
 }
 
 
@@ -2861,11 +3536,9 @@ bool qd_message_is_Q2_blocked(const qd_message_t *msg)
     qd_message_pvt_t     *msg_pvt = (qd_message_pvt_t*) msg;
     qd_message_content_t *content = msg_pvt->content;
 
-    bool blocked;
-    LOCK(&content->lock);
-    blocked = content->q2_input_holdoff;
-    UNLOCK(&content->lock);
-    return blocked;
+    // lock-free: the flag is only changed under the content lock, together
+    // with the buffer chain it describes
+    return IS_ATOMIC_FLAG_SET(&content->q2_input_holdoff);
 }
 
 
@@ -2927,9 +3600,18 @@ void qd_message_start_unicast_cutthrough(qd_message_t *stream)
     qd_message_content_t *content = MSG_CONTENT(stream);
     sys_mutex_lock(&content->lock);
     if (!IS_ATOMIC_FLAG_SET(&content->uct_enabled)) {
+        content->uct_slot_capacity = uct_max_slots;
+        content->uct_slots         = NEW_ARRAY(qd_buffer_list_t, content->uct_slot_capacity);
+        for (uint32_t i = 0; i < content->uct_slot_capacity; i++) {
+            DEQ_INIT(content->uct_slots[i]);
+        }
+        // one slot always stays empty so a full ring can be told from an empty one
+        sys_atomic_init(&content->uct_slot_limit, UCT_SLOT_COUNT - 1);
+        sys_atomic_init(&content->uct_producer_stalled, 0);
         sys_atomic_init(&content->uct_produce_slot, 0);
         sys_atomic_init(&content->uct_consume_slot, 0);
         SET_ATOMIC_FLAG(&content->uct_enabled);
+        qd_sharded_counter_add(&uct_stat_streams, 1);
 
         //
         // TODO - If there are body octets in buffers, move those bytes/buffers into the cut-through ring.
@@ -2949,21 +3631,21 @@ bool qd_message_is_unicast_cutthrough(const qd_message_t *stream)
 bool qd_message_can_produce_buffers(const qd_message_t *stream)
 {
     qd_message_content_t *content = MSG_CONTENT(stream);
-    return (sys_atomic_get(&content->uct_consume_slot) - sys_atomic_get(&content->uct_produce_slot)) % UCT_SLOT_COUNT != 1;
+    return !uct_ring_full(content);
 }
 
 
 bool qd_message_can_consume_buffers(const qd_message_t *stream)
 {
     qd_message_content_t *content = MSG_CONTENT(stream);
-    return (sys_atomic_get(&content->uct_consume_slot) - sys_atomic_get(&content->uct_produce_slot)) % UCT_SLOT_COUNT != 0;
+    return !uct_ring_empty(content);
 }
 
 
 int qd_message_full_slot_count(const qd_message_t *stream)
 {
     qd_message_content_t *content = MSG_CONTENT(stream);
-    return (sys_atomic_get(&content->uct_produce_slot) - sys_atomic_get(&content->uct_consume_slot)) % UCT_SLOT_COUNT;
+    return uct_full_slots(content);
 }
 
 
@@ -2975,7 +3657,7 @@ void qd_message_produce_buffers(qd_message_t *stream, qd_buffer_list_t *buffers)
 
     uint32_t useSlot = sys_atomic_get(&content->uct_produce_slot);
     DEQ_MOVE(*buffers, content->uct_slots[useSlot]);
-    sys_atomic_set(&content->uct_produce_slot, (useSlot + 1) % UCT_SLOT_COUNT);
+    uct_produced_slot(content, useSlot);
     activate_message_consumer(stream);
 }
 
@@ -2985,7 +3667,7 @@ int qd_message_consume_buffers(qd_message_t *stream, qd_buffer_list_t *buffers,
     qd_message_content_t *content = MSG_CONTENT(stream);
     int  count = 0;
     bool notify_consumed = false;
-    bool empty = sys_atomic_get(&content->uct_consume_slot) == sys_atomic_get(&content->uct_produce_slot);
+    bool empty = uct_ring_empty(content);
 
     while (count < limit && !empty) {
         uint32_t useSlot = sys_atomic_get(&content->uct_consume_slot);
@@ -2997,9 +3679,9 @@ int qd_message_consume_buffers(qd_message_t *stream, qd_buffer_list_t *buffers,
         }
         if (DEQ_IS_EMPTY(content->uct_slots[useSlot])) {
             notify_consumed = true;
-            sys_atomic_set(&content->uct_consume_slot, (useSlot + 1) % UCT_SLOT_COUNT);
+            uct_consumed_slot(content, useSlot);
         }
-        empty = sys_atomic_get(&content->uct_consume_slot) == sys_atomic_get(&content->uct_produce_slot);
+        empty = uct_ring_empty(content);
     }
 
     if (notify_consumed) {
@@ -3009,6 +3691,25 @@ int qd_message_consume_buffers(qd_message_t *stream, qd_buffer_list_t *buffers,
     return count;
 }
 
+void qd_message_set_cutthrough_max_slots(uint32_t max_slots)
+{
+    uint32_t slots = UCT_SLOT_COUNT;
+    while (slots < max_slots && slots < (UINT32_C(1) << 31))
+        slots <<= 1;
+    uct_max_slots = slots;
+}
+
+
+void qd_message_get_cutthrough_stats(qd_message_cutthrough_stats_t *stats)
+{
+    stats->streams         = qd_sharded_counter_value(&uct_stat_streams);
+    stats->producer_stalls = qd_sharded_counter_value(&uct_stat_producer_stalls);
+    stats->ring_growths    = qd_sharded_counter_value(&uct_stat_ring_growths);
+    stats->slots_in_use    = qd_sharded_counter_value(&uct_stat_slots_in_use);
+    stats->max_slots       = uct_max_slots;
+}
+
+
 void qd_message_set_consumer_activation(qd_message_t *stream, qd_message_activation_t *activation)
 {
     qd_message_content_t *content = MSG_CONTENT(stream);
@@ -3041,3 +3742,21 @@ void qd_message_cancel_producer_activation(qd_message_t *stream)
     content->uct_producer_activation.type = QD_ACTIVATION_NONE;
     UNLOCK(&content->producer_activation_lock);
 }
+
+
+bool qd_message_is_local_stream(qd_message_t *stream)
+{
+    qd_message_content_t         *content = MSG_CONTENT(stream);
+    qd_message_activation_type_t  producer;
+    qd_message_activation_type_t  consumer;
+
+    LOCK(&content->producer_activation_lock);
+    producer = content->uct_producer_activation.type;
+    UNLOCK(&content->producer_activation_lock);
+    LOCK(&content->consumer_activation_lock);
+    consumer = content->uct_consumer_activation.type;
+    UNLOCK(&content->consumer_activation_lock);
+
+    return producer != QD_ACTIVATION_NONE && producer != QD_ACTIVATION_AMQP
+        && consumer != QD_ACTIVATION_NONE && consumer != QD_ACTIVATION_AMQP;
+}
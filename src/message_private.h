@@ -24,6 +24,9 @@
 #include "qpid/dispatch/internal/thread_annotations.h"
 #include "qpid/dispatch/message.h"
 #include "qpid/dispatch/threading.h"
+#include "qpid/dispatch/trace_mask.h"
+
+#include <stddef.h>
 
 typedef struct qd_message_pvt_t qd_message_pvt_t;
 
@@ -73,6 +76,15 @@ typedef struct {
 //        It's likely that link-routing will cause no contention for the message content.
 //
 
+// The content lock protects the buffer chain and the section/field parse
+// state.  The frequently polled state flags (discard, receive_complete,
+// aborted, q2_input_holdoff) and buffer_count are atomics so that accessors
+// may read them without taking the lock.  Writers that change them together
+// with the buffer chain still hold the lock, and all atomic accesses are
+// sequentially consistent: a lock-free reader observes a value no older than
+// the last unlock that published it, but must take the lock before touching
+// the buffers themselves.
+//
 typedef struct {
     sys_mutex_t          lock;
     sys_mutex_t          producer_activation_lock;        // These locks prevent either side from activating
@@ -82,6 +94,7 @@ typedef struct {
                                                           // that was observed on the content lock.
     sys_atomic_t         ref_count;                       // The number of messages referencing this
     qd_buffer_list_t     buffers;                         // The buffer chain containing the message
+    sys_atomic_t         buffer_count;                    // DEQ_SIZE(buffers), readable without the lock
     qd_buffer_t         *pending;                         // Buffer owned by and filled by qd_message_receive
     uint64_t             buffers_freed;                   // count of large msg buffers freed on send
 
@@ -113,17 +126,21 @@ typedef struct {
     unsigned char       *parse_cursor;                    // Octet in parse_buffer where parsing should resume
     qd_message_depth_t   parse_depth;                     // Depth to which message content has been parsed
 
-    // Per-message Router annotations.  These values are extracted from the
+    // Per-message Router annotations.  These values are located in the
     // incoming messages router annotations section.  Refer to
     // docs/notes/router-annotations.adoc for more information.
     //
-    qd_parsed_field_t   *ra_pf_ingress;                  // ingress router id
-    qd_parsed_field_t   *ra_pf_to_override;              // optional dest address override
-    qd_parsed_field_t   *ra_pf_trace;                    // the fields from the trace list
-    qd_parsed_field_t   *ra_pf_flags;                    // misc control flags
-    qd_parsed_field_t   *ra_pf_ingress_mesh;             // mesh_id of ingress edge router
+    qd_router_annotations_t ra;                          // entries of the received section (unparsed)
+    qd_parsed_field_t   *ra_pf_ingress;                  // ingress router id, parsed on first use
+    qd_parsed_field_t   *ra_pf_to_override;              // optional dest address override, parsed on first use
+    qd_parsed_field_t   *ra_pf_trace;                    // the fields from the trace list, parsed on first use
+    qd_parsed_field_t   *ra_pf_ingress_mesh;             // mesh_id of ingress edge router, parsed on first use
     bool                 ra_disabled;                    // true: link routing - no router annotations involved.
     bool                 ra_parsed;
+    bool                 pass_through;                   // only the routing sections are parsed, see qd_message_set_pass_through
+
+    uint64_t             expiry_ns;                      // qdr_core_now_ns() deadline from the header ttl, 0: none
+    bool                 expiry_set;                     // expiry_ns has been computed (core thread, at ingress)
 
     uint64_t             max_message_size;               // Configured max; 0 if no max to enforce
     uint64_t             bytes_received;                 // Bytes returned by pn_link_recv()
@@ -133,7 +150,9 @@ typedef struct {
                                                          //  including in-process subscribers.
     qd_message_q2_unblocker_t q2_unblocker;              // Callback and context to signal Q2 unblocked to receiver
 
-    bool                 q2_input_holdoff;               // Q2 state: hold off calling pn_link_recv
+    sys_atomic_t         q2_input_holdoff;               // Q2 state: hold off calling pn_link_recv (set under lock)
+    uint32_t             q2_upper;                       // Q2 upper limit from the incoming link, 0: default
+    bool                 q2_receive_held;                // rx thread only: Q2 held off this message since last receive
     bool                 disable_q2_holdoff;             // Disable Q2 flow control
 
     sys_atomic_t         discard;                        // Message is being discarded
@@ -144,14 +163,29 @@ typedef struct {
     sys_atomic_t         priority;                       // Message AMQP priority
     sys_atomic_t         aborted;                        // Message has been aborted
 
+    // Unicast cut-through single-producer/single-consumer ring.  The slot array is allocated when cut-through
+    // starts.  uct_slot_capacity is its (power of two) length and never changes; uct_slot_limit is the number
+    // of slots the producer may currently fill.  The consumer raises the limit when the stream is window bound
+    // (see uct_consumed_slot).
     sys_atomic_t             uct_enabled;
-    qd_buffer_list_t         uct_slots[UCT_SLOT_COUNT];
+    qd_buffer_list_t        *uct_slots;
+    uint32_t                 uct_slot_capacity;
+    sys_atomic_t             uct_slot_limit;
+    sys_atomic_t             uct_producer_stalled;  // set by the producer when it fills the ring
     sys_atomic_t             uct_produce_slot;
     sys_atomic_t             uct_consume_slot;
     qd_message_activation_t  uct_producer_activation;
     qd_message_activation_t  uct_consumer_activation;
 } qd_message_content_t;
 
+// The router annotation overrides of an outgoing message.  Shared copy-on-write by the copies of a message (they
+// mostly carry the same values) and freed by the last copy referring to it.
+typedef struct qd_message_ra_local_t {
+    sys_atomic_t refs;
+    char        *to_override;   // new outgoing value for to-override annotation
+    char        *ingress_mesh;  // new outgoing value for ingress_mesh annotation, QD_DISCRIMINATOR_BYTES long
+} qd_message_ra_local_t;
+
 struct qd_message_pvt_t {
     struct {
         qd_buffer_t *buffer;
@@ -159,21 +193,36 @@ struct qd_message_pvt_t {
     }                              cursor;          // Pointer to current location of outgoing byte stream.
     qd_message_content_t          *content;         // Singleton content shared by reference between
                                                     //  incoming and all outgoing copies
-    char                          *ra_to_override;  // new outgoing value for to-override annotation
-    char                          *ra_ingress_mesh; // new outgoing value for ingress_mesh annotation
+    qd_message_ra_local_t         *ra_local;        // annotation overrides, 0 if none
     uint32_t                       ra_flags;        // new outgoing value for flag annotation
     bool                           strip_annotations_in;
     bool                           ra_sent;         // false == router annotation section not yet sent
     bool                           tag_sent;        // Tags are sent
     bool                           is_fanout;       // Message is an outgoing fanout
     bool                           uct_started;     // Cut-through has been started for this message
+    bool                           compressed;      // The delivery payload is compressed, see compression.h
+    bool                           raw_body_started; // qd_message_take_raw_body() has been called
+    struct {
+        qd_buffer_t *buffer;
+        size_t       offset;
+    }                              raw_body;        // Next raw body data to be taken
     sys_atomic_t                   send_complete;   // Message has been been completely sent
 };
 
+// A new message and its content are co-allocated from a single pool item. Copies of the message come from the
+// qd_message_t pool and share the content. The arena goes back to the pool when the content is released, so the
+// originating qd_message_pvt_t is never freed on its own.
+typedef struct qd_message_arena_t {
+    qd_message_pvt_t     msg;  // first, so the alloc pool item header precedes the message
+    qd_message_content_t content;
+} qd_message_arena_t;
+
 ALLOC_DECLARE_SAFE(qd_message_t);
-ALLOC_DECLARE(qd_message_content_t);
+ALLOC_DECLARE(qd_message_arena_t);
+ALLOC_DECLARE(qd_message_ra_local_t);
 
 #define MSG_CONTENT(m)     (((qd_message_pvt_t*) m)->content)
+#define MSG_ARENA(c)       ((qd_message_arena_t*) ((char*) (c) - offsetof(qd_message_arena_t, content)))
 #define MSG_FLAG_STREAMING       0x01u
 #define MSG_FLAG_RESEND_RELEASED 0x02u
 #define MSG_FLAG_DISABLE_Q2      0x04u
@@ -181,6 +230,12 @@ ALLOC_DECLARE(qd_message_content_t);
 /** Initialize logging */
 void qd_message_initialize(void);
 
+/**
+ * Set the router's tracemask, used to turn compact traces back into trace lists for routers that do not use them.
+ * Called before the I/O threads start.  Returns the previous tracemask.
+ */
+qd_tracemask_t *qd_message_set_trace_resolver(qd_tracemask_t *tm);
+
 //
 // Internal API - exported for unit testing ONLY:
 //
@@ -0,0 +1,414 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "qpid/dispatch/metrics.h"
+
+#include "qpid/dispatch/atomic.h"
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/threading.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SUB_BUCKET_BITS 2  // log2(QD_METRIC_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct qd_metric_family_t qd_metric_family_t;
+
+struct qd_metric_t {
+    DEQ_LINKS(qd_metric_t);
+    qd_metric_family_t   *family;
+    uint64_t              id;
+    char                 *labels;   // 'name="value",...' or NULL
+    atomic_uint_fast64_t  value;    // counters and gauges, the sum of the values observed by histograms
+    atomic_uint_fast64_t *buckets;  // histograms only, QD_METRIC_HISTOGRAM_BUCKETS
+};
+
+DEQ_DECLARE(qd_metric_t, qd_metric_list_t);
+
+struct qd_metric_family_t {
+    DEQ_LINKS(qd_metric_family_t);
+    char             *name;
+    qd_metric_type_t  type;
+    uint64_t          id;
+    qd_metric_list_t  metrics;
+};
+
+DEQ_DECLARE(qd_metric_family_t, qd_metric_family_list_t);
+
+// Families and the metrics in each family are kept in registration order, which is also id order. Ids are never
+// reused so that a cursor stays valid while metrics come and go between the buffers of a rendering.
+//
+static sys_mutex_t             registry_lock;
+static qd_metric_family_list_t families;
+static uint64_t                next_id;
+
+
+static inline int histogram_bucket(uint64_t value)
+{
+    if (value < (1 << SUB_BUCKET_BITS))
+        return (int) value;
+    int exp    = 63 - __builtin_clzll(value);  // value is in [2^exp, 2^(exp+1))
+    int sub    = (int) (value >> (exp - SUB_BUCKET_BITS)) & (QD_METRIC_HISTOGRAM_SUB_BUCKETS - 1);
+    int bucket = QD_METRIC_HISTOGRAM_SUB_BUCKETS * (exp - 1) + sub;
+    return bucket < QD_METRIC_HISTOGRAM_BUCKETS ? bucket : QD_METRIC_HISTOGRAM_BUCKETS - 1;
+}
+
+
+uint64_t qd_metric_histogram_bound(int bucket)
+{
+    assert(bucket >= 0 && bucket < QD_METRIC_HISTOGRAM_BUCKETS);
+    if (bucket == QD_METRIC_HISTOGRAM_BUCKETS - 1)
+        return UINT64_MAX;
+    if (bucket < QD_METRIC_HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+    int exp = bucket / QD_METRIC_HISTOGRAM_SUB_BUCKETS + 1;
+    int sub = bucket % QD_METRIC_HISTOGRAM_SUB_BUCKETS;
+    return ((uint64_t) (QD_METRIC_HISTOGRAM_SUB_BUCKETS + sub + 1) << (exp - SUB_BUCKET_BITS)) - 1;
+}
+
+
+void qd_metrics_initialize(void)
+{
+    sys_mutex_init(&registry_lock);
+    DEQ_INIT(families);
+    next_id = 1;  // a zeroed cursor starts before everything
+}
+
+
+void qd_metrics_finalize(void)
+{
+    qd_metric_family_t *family = DEQ_HEAD(families);
+    while (family) {
+        DEQ_REMOVE_HEAD(families);
+        qd_metric_t *metric = DEQ_HEAD(family->metrics);
+        while (metric) {
+            DEQ_REMOVE_HEAD(family->metrics);
+            free(metric->labels);
+            free(metric->buckets);
+            free(metric);
+            metric = DEQ_HEAD(family->metrics);
+        }
+        free(family->name);
+        free(family);
+        family = DEQ_HEAD(families);
+    }
+    sys_mutex_free(&registry_lock);
+}
+
+
+// Format 'name="value",...', escaping the values as the exposition format requires
+//
+static char *format_labels(int label_count, const char *const *label_names, const char *const *label_values)
+{
+    size_t len = 1;
+    for (int i = 0; i < label_count; ++i)
+        len += strlen(label_names[i]) + 2 * strlen(label_values[i]) + 4;
+
+    char *labels = qd_malloc(len);
+    char *ptr    = labels;
+    for (int i = 0; i < label_count; ++i) {
+        ptr += sprintf(ptr, "%s%s=\"", i ? "," : "", label_names[i]);
+        for (const char *c = label_values[i]; *c; ++c) {
+            if (*c == '\\' || *c == '"') {
+                *ptr++ = '\\';
+                *ptr++ = *c;
+            } else if (*c == '\n') {
+                *ptr++ = '\\';
+                *ptr++ = 'n';
+            } else {
+                *ptr++ = *c;
+            }
+        }
+        *ptr++ = '"';
+    }
+    *ptr = '\0';
+    return labels;
+}
+
+
+qd_metric_t *qd_metric(qd_metric_type_t type, const char *name, const char *label_name, const char *label_value)
+{
+    assert(!!label_name == !!label_value);
+    const int label_count = label_name && label_value ? 1 : 0;
+    return qd_metric_labels(type, name, label_count, &label_name, &label_value);
+}
+
+
+qd_metric_t *qd_metric_labels(qd_metric_type_t type, const char *name, int label_count,
+                              const char *const *label_names, const char *const *label_values)
+{
+    qd_metric_t *metric = NEW(qd_metric_t);
+    ZERO(metric);
+    atomic_init(&metric->value, 0);
+    if (label_count > 0)
+        metric->labels = format_labels(label_count, label_names, label_values);
+    if (type == QD_METRIC_HISTOGRAM) {
+        metric->buckets = NEW_ARRAY(atomic_uint_fast64_t, QD_METRIC_HISTOGRAM_BUCKETS);
+        for (int i = 0; i < QD_METRIC_HISTOGRAM_BUCKETS; ++i)
+            atomic_init(&metric->buckets[i], 0);
+    }
+
+    char *family_name = qd_strdup(name);
+    for (char *ptr = family_name; *ptr; ++ptr) {
+        if (!isalnum(*ptr) && *ptr != '_' && *ptr != ':')
+            *ptr = '_';
+    }
+
+    sys_mutex_lock(&registry_lock);
+    qd_metric_family_t *family = DEQ_HEAD(families);
+    while (family && strcmp(family->name, family_name) != 0)
+        family = DEQ_NEXT(family);
+
+    if (!family) {
+        family = NEW(qd_metric_family_t);
+        ZERO(family);
+        family->name = family_name;
+        family->type = type;
+        family->id   = next_id++;
+        DEQ_INIT(family->metrics);
+        DEQ_INSERT_TAIL(families, family);
+        family_name = 0;
+    } else if (family->type != type) {
+        sys_mutex_unlock(&registry_lock);
+        free(family_name);
+        assert(false);  // the same metric name registered with two types
+        free(metric->labels);
+        free(metric->buckets);
+        free(metric);
+        return 0;
+    }
+
+    metric->family = family;
+    metric->id     = next_id++;
+    DEQ_INSERT_TAIL(family->metrics, metric);
+    sys_mutex_unlock(&registry_lock);
+    free(family_name);  // NULL unless the family already existed
+    return metric;
+}
+
+
+void qd_metric_free(qd_metric_t *metric)
+{
+    if (!metric)
+        return;
+
+    sys_mutex_lock(&registry_lock);
+    qd_metric_family_t *family = metric->family;
+    DEQ_REMOVE(family->metrics, metric);
+    if (DEQ_IS_EMPTY(family->metrics)) {
+        DEQ_REMOVE(families, family);
+        free(family->name);
+        free(family);
+    }
+    sys_mutex_unlock(&registry_lock);
+
+    free(metric->labels);
+    free(metric->buckets);
+    free(metric);
+}
+
+
+void qd_metric_inc(qd_metric_t *metric, uint64_t amount)
+{
+    if (metric) {
+        assert(!metric->buckets);
+        atomic_fetch_add_explicit(&metric->value, amount, memory_order_relaxed);
+    }
+}
+
+
+void qd_metric_dec(qd_metric_t *metric, uint64_t amount)
+{
+    if (metric) {
+        assert(metric->family->type == QD_METRIC_GAUGE);
+        atomic_fetch_sub_explicit(&metric->value, amount, memory_order_relaxed);
+    }
+}
+
+
+void qd_metric_set(qd_metric_t *metric, uint64_t value)
+{
+    if (metric) {
+        assert(metric->family->type == QD_METRIC_GAUGE);
+        atomic_store_explicit(&metric->value, value, memory_order_relaxed);
+    }
+}
+
+
+void qd_metric_observe(qd_metric_t *metric, uint64_t value)
+{
+    if (metric) {
+        assert(metric->buckets);
+        atomic_fetch_add_explicit(&metric->buckets[histogram_bucket(value)], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&metric->value, value, memory_order_relaxed);
+    }
+}
+
+
+uint64_t qd_metric_value(const qd_metric_t *metric)
+{
+    if (!metric)
+        return 0;
+    if (!metric->buckets)
+        return atomic_load_explicit(&metric->value, memory_order_relaxed);
+
+    uint64_t count = 0;
+    for (int i = 0; i < QD_METRIC_HISTOGRAM_BUCKETS; ++i)
+        count += atomic_load_explicit(&metric->buckets[i], memory_order_relaxed);
+    return count;
+}
+
+
+uint64_t qd_metric_sum(const qd_metric_t *metric)
+{
+    if (!metric)
+        return 0;
+    assert(metric->buckets);
+    return atomic_load_explicit(&metric->value, memory_order_relaxed);
+}
+
+
+static const char *type_name(qd_metric_type_t type)
+{
+    switch (type) {
+        case QD_METRIC_COUNTER:
+            return "counter";
+        case QD_METRIC_GAUGE:
+            return "gauge";
+        case QD_METRIC_HISTOGRAM:
+            return "histogram";
+    }
+    return "untyped";
+}
+
+
+// Append to the buffer at *offset. Returns false without advancing *offset if it does not fit.
+//
+static bool put(char *buffer, size_t size, size_t *offset, const char *format, ...) __attribute__((format(printf, 4, 5)));
+static bool put(char *buffer, size_t size, size_t *offset, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(buffer + *offset, size - *offset, format, ap);
+    va_end(ap);
+    if (n < 0 || n >= size - *offset)
+        return false;
+    *offset += n;
+    return true;
+}
+
+
+// Write the samples of one metric. Histogram buckets with no values above the highest used bucket are left out, so
+// each series appears once its first value is observed and is never withdrawn since the counts only grow.
+//
+static bool render_metric(const qd_metric_t *metric, char *buffer, size_t size, size_t *offset)
+{
+    const char *name   = metric->family->name;
+    const char *labels = metric->labels ? metric->labels : "";
+    const char *open   = metric->labels ? "{" : "";
+    const char *close  = metric->labels ? "}" : "";
+    const char *sep    = metric->labels ? "," : "";
+
+    if (!metric->buckets) {
+        return put(buffer, size, offset, "%s%s%s%s %" PRIu64 "\n", name, open, labels, close,
+                   (uint64_t) atomic_load_explicit(&metric->value, memory_order_relaxed));
+    }
+
+    // Copy the histogram first so that the buckets, count and sum are written from a single snapshot
+    uint64_t snapshot[QD_METRIC_HISTOGRAM_BUCKETS];
+    int      top = -1;
+    for (int i = 0; i < QD_METRIC_HISTOGRAM_BUCKETS; ++i) {
+        snapshot[i] = atomic_load_explicit(&metric->buckets[i], memory_order_relaxed);
+        if (snapshot[i] && i < QD_METRIC_HISTOGRAM_BUCKETS - 1)
+            top = i;
+    }
+    uint64_t sum = atomic_load_explicit(&metric->value, memory_order_relaxed);
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= top; ++i) {
+        cumulative += snapshot[i];
+        if (!put(buffer, size, offset, "%s_bucket{%s%sle=\"%" PRIu64 "\"} %" PRIu64 "\n", name, labels, sep,
+                 qd_metric_histogram_bound(i), cumulative))
+            return false;
+    }
+    for (int i = top + 1; i < QD_METRIC_HISTOGRAM_BUCKETS; ++i)
+        cumulative += snapshot[i];
+
+    return put(buffer, size, offset,
+               "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n"
+               "%s_sum%s%s%s %" PRIu64 "\n"
+               "%s_count%s%s%s %" PRIu64 "\n",
+               name, labels, sep, cumulative,
+               name, open, labels, close, sum,
+               name, open, labels, close, cumulative);
+}
+
+
+size_t qd_metrics_render(qd_metrics_cursor_t *cursor, char *buffer, size_t size)
+{
+    size_t offset = 0;
+
+    sys_mutex_lock(&registry_lock);
+
+    qd_metric_family_t *family = DEQ_HEAD(families);
+    while (family && family->id < cursor->family_id)
+        family = DEQ_NEXT(family);
+
+    while (family) {
+        if (family->id != cursor->family_id) {
+            cursor->family_id = family->id;
+            cursor->metric_id = 0;
+        }
+
+        qd_metric_t *metric = DEQ_HEAD(family->metrics);
+        while (metric && metric->id < cursor->metric_id)
+            metric = DEQ_NEXT(metric);
+
+        while (metric) {
+            size_t start = offset;
+            bool   ok    = (cursor->metric_id != 0
+                            || put(buffer, size, &offset, "# TYPE %s %s\n", family->name, type_name(family->type)))
+                      && render_metric(metric, buffer, size, &offset);
+            if (!ok) {
+                offset = start;
+                if (start > 0) {
+                    // next buffer
+                    sys_mutex_unlock(&registry_lock);
+                    return offset;
+                }
+                assert(false);  // metric larger than the buffer, skip it
+            }
+            cursor->metric_id = metric->id + 1;
+            metric = DEQ_NEXT(metric);
+        }
+
+        cursor->family_id = family->id + 1;
+        cursor->metric_id = 0;
+        family = DEQ_NEXT(family);
+    }
+
+    cursor->done = true;
+    sys_mutex_unlock(&registry_lock);
+    return offset;
+}
@@ -55,7 +55,7 @@ static int rx_request(qd_http1_decoder_connection_t *hconn, const char *method,
     http1_request_state_t *hreq = new_http1_request_state_t();
     ZERO(hreq);
     DEQ_ITEM_INIT(hreq);
-    hreq->vflow = vflow_start_record(VFLOW_RECORD_BIFLOW_APP, th->vflow);
+    hreq->vflow = vflow_start_sampled_record(VFLOW_RECORD_BIFLOW_APP, th->vflow, 0);
     vflow_set_string(hreq->vflow, VFLOW_ATTRIBUTE_PROTOCOL, version_minor == 1 ? "HTTP/1.1" : "HTTP/1.0");
     vflow_set_string(hreq->vflow, VFLOW_ATTRIBUTE_METHOD, method);
     vflow_set_uint64(hreq->vflow, VFLOW_ATTRIBUTE_OCTETS, 0);
@@ -206,6 +206,21 @@ static void http1_observe(qdpo_transport_handle_t *th, bool from_client, const u
     assert(th->http1.decoder);
 
     int rc = qd_http1_decoder_connection_rx_data(th->http1.decoder, from_client, data, length);
+    if (rc) {
+        qdpo_http1_final(th);
+        return;
+    }
+
+    // Only the length of the body is of interest, see rx_body()
+    th->skip_octets[from_client] = qd_http1_decoder_connection_skippable(th->http1.decoder, from_client);
+}
+
+
+static void http1_skip(qdpo_transport_handle_t *th, bool from_client, uint64_t length)
+{
+    assert(th->http1.decoder);
+
+    int rc = qd_http1_decoder_connection_rx_skip(th->http1.decoder, from_client, length);
     if (rc) {
         qdpo_http1_final(th);
     }
@@ -218,6 +233,7 @@ void qdpo_http1_init(qdpo_transport_handle_t *th)
 
     th->protocol  = QD_PROTOCOL_HTTP1;
     th->observe   = http1_observe;
+    th->skip      = http1_skip;
 
     memset(&th->http1, 0, sizeof(th->http1));
     DEQ_INIT(th->http1.requests);
@@ -16,8 +16,10 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <assert.h>
 #include <inttypes.h>
-#include "qpid/dispatch/hash.h"
+#include <string.h>
+#include <time.h>
 #include "qpid/dispatch/connection_counters.h"
 #include "qpid/dispatch/ctools.h"
 #include "observers/private.h"
@@ -26,43 +28,298 @@
 const char *HTTP_METHOD = ":method";
 const char *HTTP_STATUS = ":status";
 const char *X_FORWARDED_FOR = "x-forwarded-for";
+const char *HTTP_PATH = ":path";
+const char *CONTENT_TYPE = "content-type";
+const char *GRPC_CONTENT_TYPE = "application/grpc";  // followed by nothing, "+proto", ";charset=..." etc
+const char *GRPC_STATUS = "grpc-status";
 
 ALLOC_DEFINE(qd_http2_stream_info_t);
 
+#define STREAM_TABLE_MIN_SLOTS 16
+
+static inline uint32_t stream_table_home(const http2_stream_table_t *table, uint32_t stream_id)
+{
+    return (stream_id >> 1) & table->mask;
+}
+
+static void stream_table_init(http2_stream_table_t *table, uint32_t slot_count)
+{
+    table->slots = NEW_PTR_ARRAY(qd_http2_stream_info_t, slot_count);
+    memset(table->slots, 0, sizeof(qd_http2_stream_info_t *) * slot_count);
+    table->mask  = slot_count - 1;
+    table->count = 0;
+}
+
+static void stream_table_final(http2_stream_table_t *table)
+{
+    free(table->slots);
+    table->slots = 0;
+    table->mask  = 0;
+    table->count = 0;
+}
+
+static void stream_table_place(http2_stream_table_t *table, qd_http2_stream_info_t *stream_info)
+{
+    uint32_t slot = stream_table_home(table, stream_info->stream_id);
+    while (table->slots[slot])
+        slot = (slot + 1) & table->mask;
+    table->slots[slot] = stream_info;
+    table->count++;
+}
+
+// Double the number of slots, keeping the table at most half full so that probe sequences stay short
+//
+static void stream_table_grow(http2_stream_table_t *table)
+{
+    qd_http2_stream_info_t **old_slots = table->slots;
+    uint32_t                 old_count = table->mask + 1;
+
+    stream_table_init(table, old_count * 2);
+    for (uint32_t i = 0; i < old_count; ++i) {
+        if (old_slots[i])
+            stream_table_place(table, old_slots[i]);
+    }
+    free(old_slots);
+}
+
+// Return the slot holding stream_id, or -1 if the stream is not in the table
+//
+static int64_t stream_table_find(const http2_stream_table_t *table, uint32_t stream_id)
+{
+    if (!table->slots)
+        return -1;
+    uint32_t slot = stream_table_home(table, stream_id);
+    while (table->slots[slot]) {
+        if (table->slots[slot]->stream_id == stream_id)
+            return slot;
+        slot = (slot + 1) & table->mask;
+    }
+    return -1;
+}
+
 /**
- * Inserts the passed in stream_info object into the stream_id hash table.
+ * Inserts the passed in stream_info object into the stream table. stream_info->stream_id must be set to stream_id.
  */
 static qd_error_t insert_stream_info_into_hashtable(qdpo_transport_handle_t *transport_handle, qd_http2_stream_info_t *stream_info, uint32_t stream_id)
 {
-    qd_hash_t  *stream_id_hash = transport_handle->http2.stream_id_hash;
-    // Convert stream_id to string
-    char stream_id_str[11];
-    snprintf(stream_id_str, sizeof stream_id_str, "%" PRIu32, stream_id);
-    return qd_hash_insert_str(stream_id_hash, (const unsigned char *)stream_id_str, stream_info, 0);
+    http2_stream_table_t *table = &transport_handle->http2.stream_table;
+    assert(stream_info->stream_id == stream_id);
+    if (stream_table_find(table, stream_id) >= 0)
+        return QD_ERROR_ALREADY_EXISTS;
+    if (!table->slots)
+        stream_table_init(table, STREAM_TABLE_MIN_SLOTS);
+    else if ((table->count + 1) * 2 > table->mask + 1)
+        stream_table_grow(table);
+    stream_table_place(table, stream_info);
+    return QD_ERROR_NONE;
 }
 
 /**
- * Gets the stream_info object from the hashtable using the passed in stream_id as the key.
+ * Gets the stream_info object from the stream table using the passed in stream_id as the key.
  */
 static qd_error_t get_stream_info_from_hashtable(qdpo_transport_handle_t *transport_handle, qd_http2_stream_info_t **stream_info, uint32_t stream_id)
 {
-    qd_hash_t  *stream_id_hash = transport_handle->http2.stream_id_hash;
-    // Convert stream_id to string
-    char stream_id_str[11];
-    snprintf(stream_id_str, sizeof stream_id_str, "%" PRIu32, stream_id);
-    return qd_hash_retrieve_str(stream_id_hash, (const unsigned char *)stream_id_str, (void **)stream_info);
+    http2_stream_table_t *table = &transport_handle->http2.stream_table;
+    int64_t               slot  = stream_table_find(table, stream_id);
+    if (slot < 0) {
+        *stream_info = 0;
+        return QD_ERROR_NOT_FOUND;
+    }
+    *stream_info = table->slots[slot];
+    return QD_ERROR_NONE;
 }
 
 /**
- * Delete the stream_info object from the hashtable whose key is the passed in stream_id
+ * Delete the stream_info object from the stream table whose key is the passed in stream_id
  */
 static qd_error_t delete_stream_info_from_hashtable(qdpo_transport_handle_t *transport_handle, uint32_t stream_id)
 {
-    qd_hash_t  *stream_id_hash = transport_handle->http2.stream_id_hash;
-    // Convert stream_id to string
-    char stream_id_str[11];
-    snprintf(stream_id_str, sizeof stream_id_str, "%" PRIu32, stream_id);
-    return qd_hash_remove_str(stream_id_hash, (const unsigned char *)stream_id_str);
+    http2_stream_table_t *table = &transport_handle->http2.stream_table;
+    int64_t               found = stream_table_find(table, stream_id);
+    if (found < 0)
+        return QD_ERROR_NOT_FOUND;
+
+    // Backward shift deletion: move each following entry of the probe sequence into the hole unless its home slot lies
+    // cyclically within (hole, next], in which case it is already reachable from its home.
+    uint32_t hole = (uint32_t) found;
+    uint32_t next = hole;
+    while (true) {
+        next = (next + 1) & table->mask;
+        if (!table->slots[next])
+            break;
+        uint32_t home = stream_table_home(table, table->slots[next]->stream_id);
+        if (((next - home) & table->mask) >= ((next - hole) & table->mask)) {
+            table->slots[hole] = table->slots[next];
+            hole = next;
+        }
+    }
+    table->slots[hole] = 0;
+    table->count--;
+
+    // An idle connection holds no table, it is allocated again for the next stream
+    if (table->count == 0)
+        stream_table_final(table);
+    return QD_ERROR_NONE;
+}
+
+/*
+ * gRPC method metrics
+ */
+
+static uint32_t grpc_path_hash(const char *path)
+{
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *) path; *c; ++c) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Return the method registered for path, or 0 with *empty set to the slot where it would be inserted
+//
+static qdpo_grpc_method_t *grpc_method_probe(qdpo_grpc_methods_t *methods, const char *path, uint32_t *empty)
+{
+    uint32_t slot = grpc_path_hash(path) & (QDPO_GRPC_METHOD_SLOTS - 1);
+    while (true) {
+        qdpo_grpc_method_t *method = atomic_load_explicit(&methods->slots[slot], memory_order_acquire);
+        if (!method) {
+            *empty = slot;
+            return 0;
+        }
+        if (strcmp(method->path, path) == 0)
+            return method;
+        slot = (slot + 1) & (QDPO_GRPC_METHOD_SLOTS - 1);
+    }
+}
+
+static qdpo_grpc_method_t *grpc_method_new(const qdpo_t *observer, const char *path)
+{
+    const char *const   names[]  = {"listener", "method"};
+    const char *const   values[] = {observer->config->name ? observer->config->name : "", path};
+    qdpo_grpc_method_t *method   = NEW(qdpo_grpc_method_t);
+    ZERO(method);
+    method->path    = qd_strdup(path);
+    method->latency = qd_metric_labels(QD_METRIC_HISTOGRAM, "qdr_grpc_call_latency_microseconds", 2, names, values);
+    for (int i = 0; i < QDPO_GRPC_STATUS_MAX + 2; ++i)
+        atomic_init(&method->calls[i], 0);
+    return method;
+}
+
+static void grpc_method_free(qdpo_grpc_method_t *method)
+{
+    if (method) {
+        qd_metric_free(method->latency);
+        for (int i = 0; i < QDPO_GRPC_STATUS_MAX + 2; ++i)
+            qd_metric_free(atomic_load(&method->calls[i]));
+        free(method->path);
+        free(method);
+    }
+}
+
+/**
+ * Return the method of a gRPC call to path, registering it if it is new. Once QDPO_GRPC_METHODS_MAX methods are
+ * registered the calls to other methods are all counted under the method "other", to bound the number of metrics a
+ * client can create.
+ */
+static qdpo_grpc_method_t *grpc_method(qdpo_t *observer, const char *path)
+{
+    qdpo_grpc_methods_t *methods = &observer->grpc;
+    uint32_t             slot;
+
+    qdpo_grpc_method_t *method = grpc_method_probe(methods, path, &slot);
+    if (method)
+        return method;
+    method = atomic_load_explicit(&methods->other, memory_order_acquire);  // only registered once the table is full
+    if (method)
+        return method;
+
+    sys_mutex_lock(&methods->lock);
+    method = grpc_method_probe(methods, path, &slot);
+    if (!method) {
+        if (methods->count < QDPO_GRPC_METHODS_MAX) {
+            method = grpc_method_new(observer, path);
+            methods->count++;
+            atomic_store_explicit(&methods->slots[slot], method, memory_order_release);
+        } else {
+            method = atomic_load_explicit(&methods->other, memory_order_relaxed);
+            if (!method) {
+                method = grpc_method_new(observer, "other");
+                atomic_store_explicit(&methods->other, method, memory_order_release);
+            }
+        }
+    }
+    sys_mutex_unlock(&methods->lock);
+    return method;
+}
+
+static void grpc_call_count(qdpo_t *observer, qdpo_grpc_method_t *method, int status)
+{
+    const int    index = status >= 0 && status <= QDPO_GRPC_STATUS_MAX ? status : QDPO_GRPC_STATUS_MAX + 1;
+    qd_metric_t *calls = atomic_load_explicit(&method->calls[index], memory_order_acquire);
+
+    if (!calls) {
+        char              code[16];
+        const char *const names[]  = {"listener", "method", "code"};
+        const char *const values[] = {observer->config->name ? observer->config->name : "", method->path, code};
+        if (index <= QDPO_GRPC_STATUS_MAX)
+            snprintf(code, sizeof(code), "%d", index);
+        else
+            snprintf(code, sizeof(code), "unknown");
+
+        sys_mutex_lock(&observer->grpc.lock);
+        calls = atomic_load_explicit(&method->calls[index], memory_order_relaxed);
+        if (!calls) {
+            calls = qd_metric_labels(QD_METRIC_COUNTER, "qdr_grpc_calls_total", 3, names, values);
+            atomic_store_explicit(&method->calls[index], calls, memory_order_release);
+        }
+        sys_mutex_unlock(&observer->grpc.lock);
+    }
+    qd_metric_inc(calls, 1);
+}
+
+static uint64_t grpc_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void qdpo_grpc_methods_init(qdpo_grpc_methods_t *methods)
+{
+    sys_mutex_init(&methods->lock);
+    for (int i = 0; i < QDPO_GRPC_METHOD_SLOTS; ++i)
+        atomic_init(&methods->slots[i], 0);
+    atomic_init(&methods->other, 0);
+    methods->count = 0;
+}
+
+void qdpo_grpc_methods_final(qdpo_grpc_methods_t *methods)
+{
+    for (int i = 0; i < QDPO_GRPC_METHOD_SLOTS; ++i)
+        grpc_method_free(atomic_load(&methods->slots[i]));
+    grpc_method_free(atomic_load(&methods->other));
+    sys_mutex_free(&methods->lock);
+}
+
+/**
+ * The response of a stream has ended: record the call metrics of gRPC methods and free the stream.
+ */
+static void stream_end(qdpo_transport_handle_t *transport_handle, qd_http2_stream_info_t *stream_info)
+{
+    if (stream_info->grpc_method) {
+        qd_metric_observe(stream_info->grpc_method->latency, (grpc_now_ns() - stream_info->grpc_start_ns) / 1000);
+        grpc_call_count(transport_handle->parent, stream_info->grpc_method, stream_info->grpc_status);
+        if (stream_info->grpc_status >= 0 && stream_info->grpc_status <= QDPO_GRPC_STATUS_MAX)
+            vflow_set_uint64(stream_info->vflow, VFLOW_ATTRIBUTE_GRPC_STATUS, stream_info->grpc_status);
+    }
+    vflow_end_record(stream_info->vflow);
+    qd_error_t error = delete_stream_info_from_hashtable(transport_handle, stream_info->stream_id);
+    if (error == QD_ERROR_NOT_FOUND) {
+        qd_log(LOG_HTTP2_DECODER, QD_LOG_ERROR, "[C%"PRIu64"] stream_end - could not find in the hashtable, stream_id=%" PRIu32, transport_handle->conn_id, stream_info->stream_id);
+    }
+    DEQ_REMOVE(transport_handle->http2.streams, stream_info);
+    free_qd_http2_stream_info_t(stream_info);
 }
 
 /*
@@ -91,14 +348,13 @@ int on_end_headers_callback(qd_http2_decoder_connection_t *conn_state,
     } else {
         if (!from_client) {
             if (end_stream) {
-                vflow_end_record(stream_info->vflow);
-                qd_error_t error = delete_stream_info_from_hashtable(transport_handle, stream_id);
-                if (error == QD_ERROR_NOT_FOUND) {
-                    qd_log(LOG_HTTP2_DECODER, QD_LOG_ERROR, "[C%"PRIu64"] on_header_recv_callback - could not find in the hashtable, stream_id=%" PRIu32, transport_handle->conn_id, stream_id);
-                }
-                DEQ_REMOVE(transport_handle->http2.streams, stream_info);
-                free_qd_http2_stream_info_t(stream_info);
+                stream_end(transport_handle, stream_info);
             }
+        } else if (stream_info->grpc && !stream_info->grpc_method) {
+            // The request headers of a gRPC call, the :path names its method
+            stream_info->grpc_method   = grpc_method(transport_handle->parent, stream_info->path);
+            stream_info->grpc_start_ns = grpc_now_ns();
+            vflow_set_string(stream_info->vflow, VFLOW_ATTRIBUTE_GRPC_METHOD, stream_info->path);
         }
     }
 
@@ -125,9 +381,10 @@ int on_begin_header_callback(qd_http2_decoder_connection_t *conn_state,
         if (error == QD_ERROR_NOT_FOUND) {
             qd_http2_stream_info_t *stream_info = new_qd_http2_stream_info_t();
             ZERO(stream_info);
+            stream_info->grpc_status = -1;
             DEQ_INSERT_TAIL(transport_handle->http2.streams, stream_info);
             // This is the first header frame in a particular stream.
-            stream_info->vflow = vflow_start_record(VFLOW_RECORD_BIFLOW_APP, transport_handle->vflow);
+            stream_info->vflow = vflow_start_sampled_record(VFLOW_RECORD_BIFLOW_APP, transport_handle->vflow, 0);
             vflow_set_string(stream_info->vflow, VFLOW_ATTRIBUTE_PROTOCOL, "HTTP/2");
             vflow_set_uint64(stream_info->vflow, VFLOW_ATTRIBUTE_OCTETS, 0);
             stream_info->stream_id = stream_id;
@@ -178,13 +435,7 @@ static int on_data_recv_callback(qd_http2_decoder_connection_t *conn_state,
             stream_info->bytes_out += num_bytes;
             vflow_set_uint64(stream_info->vflow, VFLOW_ATTRIBUTE_OCTETS_REVERSE, stream_info->bytes_out);
             if (end_stream) {
-                vflow_end_record(stream_info->vflow);
-                qd_error_t error = delete_stream_info_from_hashtable(transport_handle, stream_id);
-                if (error == QD_ERROR_NOT_FOUND) {
-                    qd_log(LOG_HTTP2_DECODER, QD_LOG_ERROR, "[C%"PRIu64"] on_header_recv_callback - could not find in the hashtable, stream_id=%" PRIu32, transport_handle->conn_id, stream_id);
-                }
-                DEQ_REMOVE(transport_handle->http2.streams, stream_info);
-                free_qd_http2_stream_info_t(stream_info);
+                stream_end(transport_handle, stream_info);
             }
         }
     }
@@ -193,7 +444,7 @@ static int on_data_recv_callback(qd_http2_decoder_connection_t *conn_state,
 
 /**
  * This callback is called for every single header.
- * We only care about the http method and the response status code.
+ * We only care about the http method, the response status code and the headers of gRPC calls.
  */
 static int on_header_recv_callback(qd_http2_decoder_connection_t *conn_state,
                                    uintptr_t request_context,
@@ -239,6 +490,25 @@ static int on_header_recv_callback(qd_http2_decoder_connection_t *conn_state,
                 vflow_set_string(stream_info->vflow, VFLOW_ATTRIBUTE_RESULT, status_code_str);
             }
         }
+    } else if (from_client && strcmp(HTTP_PATH, (const char *)name) == 0) {
+        // Only kept in case the request turns out to be a gRPC call, see CONTENT_TYPE below
+        if (get_stream_info_from_hashtable(transport_handle, &stream_info, stream_id) == QD_ERROR_NONE) {
+            const size_t length = MIN(valuelen, QDPO_GRPC_PATH_MAX - 1);
+            memcpy(stream_info->path, value, length);
+            stream_info->path[length] = '\0';
+        }
+    } else if (from_client && strcmp(CONTENT_TYPE, (const char *)name) == 0) {
+        if (strncasecmp(GRPC_CONTENT_TYPE, (const char *)value, strlen(GRPC_CONTENT_TYPE)) == 0
+            && get_stream_info_from_hashtable(transport_handle, &stream_info, stream_id) == QD_ERROR_NONE) {
+            stream_info->grpc = true;
+        }
+    } else if (!from_client && strcmp(GRPC_STATUS, (const char *)name) == 0) {
+        // Usually in the trailers, or in the headers of a response without a body (Trailers-Only)
+        if (get_stream_info_from_hashtable(transport_handle, &stream_info, stream_id) == QD_ERROR_NONE && stream_info->grpc_method) {
+            char *end = 0;
+            long status = strtol((const char *)value, &end, 10);
+            stream_info->grpc_status = (end != (const char *) value && *end == '\0' && status >= 0 && status <= QDPO_GRPC_STATUS_MAX) ? (int) status : QDPO_GRPC_STATUS_MAX + 1;
+        }
     } else if (strcasecmp(X_FORWARDED_FOR, (const char *)name) == 0 && value != 0) {
         qd_error_t error = get_stream_info_from_hashtable(transport_handle, &stream_info, stream_id);
         if (error == QD_ERROR_NOT_FOUND) {
@@ -296,6 +566,19 @@ void http2_observe(qdpo_transport_handle_t *transport_handle, bool from_client,
 
     int rc = decode(transport_handle->http2.conn_state, from_client, data, length);
 
+    if (rc) {
+        qdpo_http2_final(transport_handle);
+        return;
+    }
+
+    // The decoder jumps over the rest of DATA frames and of the frames it does not parse
+    transport_handle->skip_octets[from_client] = qd_http2_decoder_connection_skippable(transport_handle->http2.conn_state, from_client);
+}
+
+static void http2_skip(qdpo_transport_handle_t *transport_handle, bool from_client, uint64_t length)
+{
+    int rc = qd_http2_decoder_connection_rx_skip(transport_handle->http2.conn_state, from_client, length);
+
     if (rc) {
         qdpo_http2_final(transport_handle);
     }
@@ -307,9 +590,9 @@ void qdpo_http2_init(qdpo_transport_handle_t *transport_handle)
 
     transport_handle->protocol = QD_PROTOCOL_HTTP2;
     transport_handle->observe = http2_observe;
+    transport_handle->skip = http2_skip;
 
     memset(&transport_handle->http2, 0, sizeof(transport_handle->http2));
-    transport_handle->http2.stream_id_hash = qd_hash(12, 32, 0);
     DEQ_INIT(transport_handle->http2.streams);
     transport_handle->http2.conn_state = qd_http2_decoder_connection(&callbacks, (uintptr_t) transport_handle, transport_handle->conn_id);
 }
@@ -322,10 +605,7 @@ void qdpo_http2_final(qdpo_transport_handle_t *transport_handle)
         transport_handle->observe = 0;
         qd_http2_decoder_connection_free(transport_handle->http2.conn_state);
     }
-    if (transport_handle->http2.stream_id_hash) {
-        qd_hash_free(transport_handle->http2.stream_id_hash);
-        transport_handle->http2.stream_id_hash = 0;
-    }
+    stream_table_final(&transport_handle->http2.stream_table);
     qd_http2_stream_info_t *stream_info = DEQ_HEAD(transport_handle->http2.streams);
     while (stream_info) {
         DEQ_REMOVE_HEAD(transport_handle->http2.streams);
@@ -20,17 +20,51 @@
  */
 
 #include <qpid/dispatch/protocol_observer.h>
+#include <qpid/dispatch/atomic.h>
 #include <qpid/dispatch/hash.h>
+#include <qpid/dispatch/metrics.h>
+#include <qpid/dispatch/threading.h>
 #include "adaptors/adaptor_common.h"
+
+#include <stdatomic.h>
 struct qdpo_config_t {
     qdpo_use_address_t           use_address;
     qd_observer_t                observer;
+    uint32_t                     sample_interval;  // observe one connection in every sample_interval
+    char                        *name;             // of the listener, labels the observer's metrics
 };
 
 
+/**
+ * gRPC call metrics of a listener, by method
+ */
+#define QDPO_GRPC_METHODS_MAX  64   // calls to more methods are counted under the "other" method
+#define QDPO_GRPC_METHOD_SLOTS 128  // a power of two, at least twice QDPO_GRPC_METHODS_MAX
+#define QDPO_GRPC_PATH_MAX     128  // longer method paths are truncated
+#define QDPO_GRPC_STATUS_MAX   16   // largest grpc-status code, calls without a valid status count as "unknown"
+
+typedef struct qdpo_grpc_method_t {
+    char                  *path;
+    qd_metric_t           *latency;                         // call duration, first request header to end of response
+    _Atomic(qd_metric_t *) calls[QDPO_GRPC_STATUS_MAX + 2];  // by grpc-status and unknown, registered on first use
+} qdpo_grpc_method_t;
+
+// Open addressing table keyed by path. Methods are only removed when the observer is freed, so lookups take no lock:
+// the lock only serializes the registration of methods and metrics.
+//
+typedef struct qdpo_grpc_methods_t {
+    sys_mutex_t                   lock;
+    _Atomic(qdpo_grpc_method_t *) slots[QDPO_GRPC_METHOD_SLOTS];
+    _Atomic(qdpo_grpc_method_t *) other;
+    int                           count;
+} qdpo_grpc_methods_t;
+
+
 struct qdpo_t {
-    qd_protocol_t  base;    // initial observed protocol
-    qdpo_config_t *config;
+    qd_protocol_t        base;    // initial observed protocol
+    qdpo_config_t       *config;
+    sys_atomic_t         seen;    // connections begun, for sampling
+    qdpo_grpc_methods_t  grpc;
 };
 
 /**
@@ -79,15 +113,28 @@ struct qd_http2_stream_info_t {
     uint64_t                       bytes_in;        // bytes received from client on this stream
     uint64_t                       bytes_out;       // bytes sent to the client on this stream
     bool                           x_forwarded_for; // True if the x-forwarded-for header has already been received
-
+    bool                           grpc;            // the request has a gRPC content-type
+    int                            grpc_status;     // -1 until the grpc-status of the response is received
+    qdpo_grpc_method_t            *grpc_method;     // set at the end of the request headers of a gRPC call
+    uint64_t                       grpc_start_ns;
+    char                           path[QDPO_GRPC_PATH_MAX];  // of the request, kept until it is known to be gRPC
 };
 
 ALLOC_DECLARE(qd_http2_stream_info_t);
 DEQ_DECLARE(qd_http2_stream_info_t, qd_http2_stream_info_list_t);
 
+// Open addressing table of the streams of a connection keyed by stream_id, with linear probing. A stream's home slot
+// is (stream_id >> 1) so the consecutive stream ids of a busy connection fill consecutive slots without colliding.
+//
+typedef struct http2_stream_table_t {
+    qd_http2_stream_info_t **slots;  // 0 == empty slot, no table at all while the connection has no stream
+    uint32_t                 mask;   // number of slots - 1, the number of slots is a power of two
+    uint32_t                 count;
+} http2_stream_table_t;
+
 struct http2_observer_state_t {
     qd_http2_decoder_connection_t *conn_state;
-    qd_hash_t                     *stream_id_hash;
+    http2_stream_table_t           stream_table;
     qd_http2_stream_info_list_t    streams;    // A connection can have many streams.
 };
 
@@ -104,6 +151,22 @@ struct qdpo_transport_handle_t {
 
     void (*observe)(qdpo_transport_handle_t *, bool from_client, const unsigned char *buf, size_t length);
 
+    // Octets the observer does not need to see, indexed by from_client. An observer sets the count for a direction on
+    // return from observe() if its decoder only needs to know the length of the data that follows, such as a message
+    // body. Skipped octets are not passed to observe(), their number is passed to skip() at the end of the skipped
+    // run, or every QDPO_SKIP_REPORT_OCTETS if the run is longer.
+    void    (*skip)(qdpo_transport_handle_t *, bool from_client, uint64_t length);
+    uint64_t skip_octets[2];
+    uint64_t skipped_octets[2];  // skipped, but not yet passed to skip()
+
+    // Asynchronous mode, see qdpo_async_start(). Once a worker is assigned the transport thread must not touch the
+    // observer state above: it is only accessed by the worker.
+    struct qdpo_worker_t *worker;
+    bool                  degraded;           // transport: queue was full, payload is no longer passed to the worker
+    bool                  finalized;          // worker: the observer was finalized when the handle degraded
+    atomic_bool           bypass;             // worker: the observer has stopped, the payload is no longer needed
+    uint64_t              unobserved_octets;  // transport: payload counted but not observed since degraded
+
     union {
         tcp_observer_state_t   tcp;
         http1_observer_state_t http1;
@@ -111,8 +174,11 @@ struct qdpo_transport_handle_t {
     };
 };
 
+#define QDPO_SKIP_REPORT_OCTETS (1024 * 1024)
+
 void qdpo_tcp_init(qdpo_transport_handle_t *handle);
 void qdpo_tcp_final(qdpo_transport_handle_t *handle);
+void qdpo_tcp_alpn(qdpo_transport_handle_t *handle, const char *alpn);
 
 void qdpo_http1_init(qdpo_transport_handle_t *handle);
 void qdpo_http1_final(qdpo_transport_handle_t *handle);
@@ -120,4 +186,7 @@ void qdpo_http1_final(qdpo_transport_handle_t *handle);
 void qdpo_http2_init(qdpo_transport_handle_t *handle);
 void qdpo_http2_final(qdpo_transport_handle_t *handle);
 
+void qdpo_grpc_methods_init(qdpo_grpc_methods_t *methods);
+void qdpo_grpc_methods_final(qdpo_grpc_methods_t *methods);
+
 #endif
@@ -19,6 +19,23 @@
 
 #include "private.h"
 #include <qpid/dispatch/alloc_pool.h>
+#include <qpid/dispatch/atomic.h>
+#include <qpid/dispatch/log.h>
+#include <qpid/dispatch/threading.h>
+
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Number of times an idle worker yields the CPU before it parks
+#define QDPO_WORKER_SPIN_COUNT 64
+
+// The CPU budget is checked once per window, the sampling intervals are scaled by at most QDPO_SAMPLING_SCALE_MAX
+#define QDPO_BUDGET_WINDOW_NS    1000000000
+#define QDPO_SAMPLING_SCALE_MAX  1024
 
 ALLOC_DECLARE(qdpo_config_t);
 ALLOC_DEFINE(qdpo_config_t);
@@ -27,17 +44,124 @@ ALLOC_DEFINE(qdpo_t);
 ALLOC_DECLARE(qdpo_transport_handle_t);
 ALLOC_DEFINE(qdpo_transport_handle_t);
 
+//
+// Asynchronous mode: each worker serves a lock-free stack of work items pushed by the transport threads, newest first.
+// The worker takes the whole stack at once and reverses it. A connection is always served by the same worker and its
+// items are pushed by one transport thread at a time, so they are observed in the order they were pushed.
+//
+typedef enum {
+    QDPO_WORK_DATA,
+    QDPO_WORK_ALPN,     // data holds the null terminated ALPN protocol identifier
+    QDPO_WORK_DEGRADE,  // the queue was full: finalize the observer, the rest of the payload is only counted
+    QDPO_WORK_END
+} qdpo_work_type_t;
+
+typedef struct qdpo_work_t qdpo_work_t;
+struct qdpo_work_t {
+    qdpo_work_t             *next;  // older item
+    qdpo_transport_handle_t *th;
+    qdpo_work_type_t         type;
+    bool                     from_client;
+    size_t                   length;
+    unsigned char            data[];
+};
+
+typedef struct qdpo_worker_t {
+    sys_thread_t     *thread;
+    sys_atomic_ptr_t  work_stack;
+    sys_mutex_t       lock;
+    sys_cond_t        cond;
+    sys_atomic_t      sleeping;
+} qdpo_worker_t;
+
+static struct {
+    qdpo_worker_t *workers;
+    int            count;
+    size_t         queue_limit;
+    atomic_size_t  queued_octets;
+    atomic_bool    running;
+} async;
+
+static struct {
+    uint64_t             budget_ns;        // observing time allowed per window, 0 for no limit
+    atomic_uint_fast64_t used_ns;          // observing time in the current window
+    atomic_uint_fast64_t window_start_ns;
+    atomic_uint          scale;            // multiplies the configured sampling intervals, a power of two
+} cpu = { .scale = 1 };
+
+
+static uint64_t qdpo_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 
 qdpo_config_t *qdpo_config(qdpo_use_address_t use_address, qd_observer_t observer)
 {
     qdpo_config_t *config = new_qdpo_config_t();
     ZERO(config);
 
-    config->use_address = use_address;
-    config->observer    = observer;
+    config->use_address     = use_address;
+    config->observer        = observer;
+    config->sample_interval = 1;
     return config;
 }
 
+
+void qdpo_config_set_sample_interval(qdpo_config_t *config, int interval)
+{
+    config->sample_interval = MAX(interval, 1);
+}
+
+
+void qdpo_config_set_name(qdpo_config_t *config, const char *name)
+{
+    free(config->name);
+    config->name = name ? qd_strdup(name) : 0;
+}
+
+
+void qdpo_set_cpu_budget(int percent)
+{
+    cpu.budget_ns = percent > 0 ? (uint64_t) percent * (QDPO_BUDGET_WINDOW_NS / 100) : 0;
+    atomic_store(&cpu.used_ns, 0);
+    atomic_store(&cpu.window_start_ns, qdpo_now_ns());
+    atomic_store(&cpu.scale, 1);
+    if (percent > 0)
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "Protocol observer CPU budget: %d%% of one CPU", percent);
+}
+
+
+// Return the factor applied to the sampling intervals. At the end of each budget window the factor is doubled if the
+// observers used more than their budget, and halved if they used less than half of it.
+//
+static uint32_t qdpo_sampling_scale(void)
+{
+    if (cpu.budget_ns == 0)
+        return 1;
+
+    uint64_t now   = qdpo_now_ns();
+    uint64_t start = atomic_load(&cpu.window_start_ns);
+    uint32_t scale = atomic_load(&cpu.scale);
+    if (now - start < QDPO_BUDGET_WINDOW_NS || !atomic_compare_exchange_strong(&cpu.window_start_ns, &start, now))
+        return scale;
+
+    // Scale the budget to the length of the window that just ended, connections may have been quiet for a while
+    double used    = (double) atomic_exchange(&cpu.used_ns, 0);
+    double allowed = (double) cpu.budget_ns * (double) (now - start) / QDPO_BUDGET_WINDOW_NS;
+    if (used > allowed && scale < QDPO_SAMPLING_SCALE_MAX) {
+        scale *= 2;
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "Protocol observers over their CPU budget, sampling intervals scaled by %" PRIu32, scale);
+    } else if (used < allowed / 2 && scale > 1) {
+        scale /= 2;
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "Protocol observers under their CPU budget, sampling intervals scaled by %" PRIu32, scale);
+    }
+    atomic_store(&cpu.scale, scale);
+    return scale;
+}
+
 void qdpo_set_observer(qdpo_t *protocol_observer, qd_observer_t observer)
 {
     protocol_observer->config->observer = observer;
@@ -46,6 +170,7 @@ void qdpo_set_observer(qdpo_t *protocol_observer, qd_observer_t observer)
 
 void qdpo_config_free(qdpo_config_t *config)
 {
+    free(config->name);
     free_qdpo_config_t(config);
 }
 
@@ -69,6 +194,8 @@ qdpo_t *protocol_observer(qd_protocol_t base, qdpo_config_t *config)
 
     protocol_observer->base   = base;
     protocol_observer->config = config;
+    sys_atomic_init(&protocol_observer->seen, 0);
+    qdpo_grpc_methods_init(&protocol_observer->grpc);
 
     return protocol_observer;
 }
@@ -76,6 +203,7 @@ qdpo_t *protocol_observer(qd_protocol_t base, qdpo_config_t *config)
 
 void qdpo_free(qdpo_t *observer)
 {
+    qdpo_grpc_methods_final(&observer->grpc);
     if(observer->config)
         qdpo_config_free(observer->config);
     free_qdpo_t(observer);
@@ -95,6 +223,12 @@ qdpo_transport_handle_t *qdpo_begin(qdpo_t *observer, vflow_record_t *vflow, voi
     th->protocol          = observer->base;
     th->conn_id           = conn_id;
 
+    // Connections that are not sampled get no observer, only their octets are counted
+    const uint32_t interval = observer->config->sample_interval * qdpo_sampling_scale();
+    if (sys_atomic_inc(&observer->seen) % interval != 0)
+        return th;
+    vflow_set_uint64(vflow, VFLOW_ATTRIBUTE_OBSERVER_SAMPLING, interval);
+
     //
     // Directly call the corresponding init functions based on the observer
     // specified in the tcp listener.
@@ -112,37 +246,311 @@ qdpo_transport_handle_t *qdpo_begin(qdpo_t *observer, vflow_record_t *vflow, voi
         default:
             break;
     }
+
+    if (async.count > 0 && th->observe)
+        th->worker = &async.workers[conn_id % async.count];
     return th;
 }
 
 
+// Pass the octets skipped from the stream in one direction to the observer
+//
+static void qdpo_report_skipped(qdpo_transport_handle_t *th, bool from_client)
+{
+    uint64_t skipped = th->skipped_octets[from_client];
+    th->skipped_octets[from_client] = 0;
+    if (skipped && th->observe && th->skip)
+        th->skip(th, from_client, skipped);
+}
+
+
+static void qdpo_observe_run(qdpo_transport_handle_t *th, bool from_client, const unsigned char *data, size_t length)
+{
+    while (length > 0 && th->observe) {
+        uint64_t to_skip = th->skip_octets[from_client];
+        if (to_skip == 0) {
+            th->observe(th, from_client, data, length);  // may set skip_octets for the data that follows
+            return;
+        }
+
+        size_t skipped = MIN(to_skip, length);
+        th->skip_octets[from_client]    -= skipped;
+        th->skipped_octets[from_client] += skipped;
+        data   += skipped;
+        length -= skipped;
+        if (th->skip_octets[from_client] == 0 || th->skipped_octets[from_client] >= QDPO_SKIP_REPORT_OCTETS)
+            qdpo_report_skipped(th, from_client);
+    }
+}
+
+
+static void qdpo_observe(qdpo_transport_handle_t *th, bool from_client, const unsigned char *data, size_t length)
+{
+    if (cpu.budget_ns == 0 || !th->observe) {
+        qdpo_observe_run(th, from_client, data, length);
+        return;
+    }
+
+    uint64_t start = qdpo_now_ns();
+    qdpo_observe_run(th, from_client, data, length);
+    atomic_fetch_add_explicit(&cpu.used_ns, qdpo_now_ns() - start, memory_order_relaxed);
+}
+
+
+static void qdpo_final(qdpo_transport_handle_t *th)
+{
+    qdpo_report_skipped(th, true);
+    qdpo_report_skipped(th, false);
+    switch (th->protocol) {
+        case QD_PROTOCOL_TCP:
+            qdpo_tcp_final(th);
+            break;
+        case QD_PROTOCOL_HTTP1:
+            qdpo_http1_final(th);
+            break;
+        case QD_PROTOCOL_HTTP2:
+            qdpo_http2_final(th);
+            break;
+        default:
+            assert(false);  // unsupported protocol
+            break;
+    }
+}
+
+
+static void qdpo_work_push(qdpo_worker_t *worker, qdpo_work_t *work)
+{
+    void *head = sys_atomic_ptr_get(&worker->work_stack);
+    do {
+        work->next = (qdpo_work_t *) head;
+    } while (!sys_atomic_ptr_cas(&worker->work_stack, &head, work));
+
+    //
+    // The worker sets the sleeping flag under its lock before it re-checks the stack and parks, see
+    // qdr_action_push_chain().
+    //
+    if (IS_ATOMIC_FLAG_SET(&worker->sleeping)) {
+        sys_mutex_lock(&worker->lock);
+        sys_mutex_unlock(&worker->lock);
+        sys_cond_signal(&worker->cond);
+    }
+}
+
+
+// The payload of data items may be large: their allocation may fail and the caller stops observing the connection, see
+// qdpo_async_data().  The other items are small and needed to finalize the observer.
+//
+static qdpo_work_t *qdpo_work(qdpo_transport_handle_t *th, qdpo_work_type_t type, size_t length)
+{
+    qdpo_work_t *work = (qdpo_work_t *) (type == QDPO_WORK_DATA ? malloc(sizeof(qdpo_work_t) + length)
+                                                                : qd_malloc(sizeof(qdpo_work_t) + length));
+    if (!work)
+        return 0;
+    ZERO(work);
+    work->th     = th;
+    work->type   = type;
+    work->length = length;
+    return work;
+}
+
+
+static void qdpo_async_data(qdpo_transport_handle_t *th, bool from_client, const unsigned char *data, size_t length)
+{
+    if (th->degraded) {
+        th->unobserved_octets += length;
+        return;
+    }
+
+    size_t       queued = atomic_fetch_add_explicit(&async.queued_octets, length, memory_order_relaxed) + length;
+    qdpo_work_t *work   = queued <= async.queue_limit ? qdpo_work(th, QDPO_WORK_DATA, length) : 0;
+    if (!work) {
+        if (queued > async.queue_limit)
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING,
+                   "[C%" PRIu64 "] Protocol observer queue full, no longer observing the connection", th->conn_id);
+        else
+            qd_log(LOG_TCP_ADAPTOR, QD_LOG_WARNING,
+                   "[C%" PRIu64 "] Protocol observer cannot allocate %zu octets, no longer observing the connection",
+                   th->conn_id, length);
+        atomic_fetch_sub_explicit(&async.queued_octets, length, memory_order_relaxed);
+        th->degraded           = true;
+        th->unobserved_octets += length;
+        qdpo_work_push(th->worker, qdpo_work(th, QDPO_WORK_DEGRADE, 0));
+        return;
+    }
+
+    work->from_client = from_client;
+    memcpy(work->data, data, length);
+    qdpo_work_push(th->worker, work);
+}
+
+
+void qdpo_set_alpn(qdpo_transport_handle_t *th, const char *alpn)
+{
+    assert(th && alpn);
+    if (th->worker) {
+        size_t       length = strlen(alpn) + 1;
+        qdpo_work_t *work   = qdpo_work(th, QDPO_WORK_ALPN, length);
+        memcpy(work->data, alpn, length);
+        qdpo_work_push(th->worker, work);
+    } else if (th->observe) {
+        qdpo_tcp_alpn(th, alpn);
+    }
+}
+
+
 void qdpo_data(qdpo_transport_handle_t *th, bool from_client, const unsigned char *data, size_t length)
 {
     assert(th);
-    if (th->observe)
-        th->observe(th, from_client, data, length);
+    if (th->worker) {
+        if (length > 0 && !atomic_load_explicit(&th->bypass, memory_order_relaxed))
+            qdpo_async_data(th, from_client, data, length);
+    } else {
+        qdpo_observe(th, from_client, data, length);
+    }
 }
 
 
 void qdpo_end(qdpo_transport_handle_t *th)
 {
     if (th) {
-        switch (th->protocol) {
-            case QD_PROTOCOL_TCP:
-                qdpo_tcp_final(th);
-                break;
-            case QD_PROTOCOL_HTTP1:
-                qdpo_http1_final(th);
-                break;
-            case QD_PROTOCOL_HTTP2:
-                qdpo_http2_final(th);
-                break;
-            default:
-                assert(false);  // unsupported protocol
-                break;
+        if (th->worker) {
+            qdpo_work_push(th->worker, qdpo_work(th, QDPO_WORK_END, 0));
+            return;
         }
-
+        qdpo_final(th);
+        vflow_end_record(th->vflow);
         free_qdpo_transport_handle_t(th);
     }
 }
 
+
+static void qdpo_work_run(qdpo_work_t *work)
+{
+    qdpo_transport_handle_t *th = work->th;
+
+    switch (work->type) {
+        case QDPO_WORK_DATA:
+            qdpo_observe(th, work->from_client, work->data, work->length);
+            if (!th->observe)
+                atomic_store_explicit(&th->bypass, true, memory_order_relaxed);
+            atomic_fetch_sub_explicit(&async.queued_octets, work->length, memory_order_relaxed);
+            break;
+
+        case QDPO_WORK_ALPN:
+            if (th->observe)
+                qdpo_tcp_alpn(th, (const char *) work->data);
+            break;
+
+        case QDPO_WORK_DEGRADE:
+            qdpo_final(th);
+            th->finalized = true;
+            break;
+
+        case QDPO_WORK_END:
+            if (!th->finalized)
+                qdpo_final(th);
+            if (th->degraded)
+                qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] %" PRIu64 " octets were not observed",
+                       th->conn_id, th->unobserved_octets);
+            vflow_end_record(th->vflow);
+            free_qdpo_transport_handle_t(th);
+            break;
+    }
+    free(work);
+}
+
+
+static bool qdpo_worker_wait(qdpo_worker_t *worker)
+{
+    for (int spin = 0; spin < QDPO_WORKER_SPIN_COUNT; spin++) {
+        if (sys_atomic_ptr_get(&worker->work_stack) != 0)
+            return true;
+        if (!atomic_load(&async.running))
+            return false;
+        sched_yield();
+    }
+
+    sys_mutex_lock(&worker->lock);
+    SET_ATOMIC_FLAG(&worker->sleeping);
+    while (sys_atomic_ptr_get(&worker->work_stack) == 0 && atomic_load(&async.running)) {
+        sys_cond_wait(&worker->cond, &worker->lock);
+    }
+    CLEAR_ATOMIC_FLAG(&worker->sleeping);
+    sys_mutex_unlock(&worker->lock);
+    return sys_atomic_ptr_get(&worker->work_stack) != 0;
+}
+
+
+static void *qdpo_worker_run(void *arg)
+{
+    qdpo_worker_t *worker = (qdpo_worker_t *) arg;
+
+    // Once stopped, the work queued before the stop is drained before the thread exits
+    while (qdpo_worker_wait(worker)) {
+        qdpo_work_t *work = (qdpo_work_t *) sys_atomic_ptr_set(&worker->work_stack, 0);
+        qdpo_work_t *fifo = 0;
+        while (work) {
+            qdpo_work_t *older = work->next;
+            work->next = fifo;
+            fifo       = work;
+            work       = older;
+        }
+        while (fifo) {
+            qdpo_work_t *next = fifo->next;
+            qdpo_work_run(fifo);
+            fifo = next;
+        }
+    }
+    return 0;
+}
+
+
+void qdpo_async_start(int threads, size_t queue_octets)
+{
+    assert(async.count == 0);
+    if (threads <= 0)
+        return;
+
+    async.workers     = (qdpo_worker_t *) calloc(threads, sizeof(qdpo_worker_t));
+    async.queue_limit = queue_octets;
+    atomic_store(&async.queued_octets, 0);
+    atomic_store(&async.running, true);
+    for (int i = 0; i < threads; i++) {
+        qdpo_worker_t *worker = &async.workers[i];
+        sys_mutex_init(&worker->lock);
+        sys_cond_init(&worker->cond);
+        sys_atomic_init(&worker->sleeping, 0);
+        sys_atomic_ptr_init(&worker->work_stack, 0);
+        worker->thread = sys_thread(SYS_THREAD_OBSERVER, qdpo_worker_run, worker);
+    }
+    async.count = threads;
+    qd_log(LOG_TCP_ADAPTOR, QD_LOG_INFO, "Protocol observers running on %d threads, queue limit %zu octets",
+           threads, queue_octets);
+}
+
+
+void qdpo_async_stop(void)
+{
+    if (async.count == 0)
+        return;
+
+    atomic_store(&async.running, false);
+    for (int i = 0; i < async.count; i++) {
+        qdpo_worker_t *worker = &async.workers[i];
+        sys_mutex_lock(&worker->lock);
+        sys_mutex_unlock(&worker->lock);
+        sys_cond_signal(&worker->cond);
+    }
+    for (int i = 0; i < async.count; i++) {
+        qdpo_worker_t *worker = &async.workers[i];
+        sys_thread_join(worker->thread);
+        sys_thread_free(worker->thread);
+        sys_cond_free(&worker->cond);
+        sys_mutex_free(&worker->lock);
+        sys_atomic_destroy(&worker->sleeping);
+    }
+    free(async.workers);
+    async.workers = 0;
+    async.count   = 0;
+}
+
@@ -135,10 +135,30 @@ static void tcp_observe(qdpo_transport_handle_t *th, bool from_client, const uns
 }
 
 
+// Classify the protocol by the ALPN protocol identifier negotiated by TLS (RFC 7301), before any payload is observed
+//
+void qdpo_tcp_alpn(qdpo_transport_handle_t *th, const char *alpn)
+{
+    if (th->observe != tcp_observe || th->tcp.prefix_len > 0 || th->tcp.server_bytes > 0)
+        return;
+
+    if (strcmp(alpn, "h2") == 0) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] TCP observer classified protocol by ALPN: %s", th->conn_id, alpn);
+        qdpo_tcp_final(th);
+        qdpo_http2_init(th);
+    } else if (strcmp(alpn, "http/1.1") == 0 || strcmp(alpn, "http/1.0") == 0) {
+        qd_log(LOG_TCP_ADAPTOR, QD_LOG_DEBUG, "[C%" PRIu64 "] TCP observer classified protocol by ALPN: %s", th->conn_id, alpn);
+        qdpo_tcp_final(th);
+        qdpo_http1_init(th);
+    }
+}
+
+
 void qdpo_tcp_init(qdpo_transport_handle_t *th)
 {
     th->protocol       = QD_PROTOCOL_TCP;
     th->observe        = tcp_observe;
+    th->skip           = 0;
 
     th->tcp.prefix_len   = 0;
     th->tcp.server_bytes = 0;
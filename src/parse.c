@@ -49,20 +49,34 @@ struct qd_parsed_field_t {
     const char              *parse_error;
     qd_buffer_field_t        full_field;  // contains encoded AMQP type header and value
     qd_amqp_field_t          amqp;        // decoded header and raw value
+    qd_buffer_field_t        pending;     // lazy parse: encoded children not yet decoded, following children
+    uint32_t                 pending_count;
+    qd_parsed_field_t      **index;       // children by position, built on the first indexed access, see child_at()
+    uint32_t                *key_slots;   // maps: entry + 1 by hash of the key octets, 0 if empty, see find_key()
+    uint32_t                 key_mask;    // number of key_slots - 1
 };
 
+// Composites with fewer children are not indexed, walking their children is as fast
+#define PARSE_INDEX_MIN_CHILDREN 8
+
 ALLOC_DECLARE(qd_parsed_field_t);
 ALLOC_DEFINE(qd_parsed_field_t);
 
 
+static qd_parsed_field_t *decode_next_child(qd_parsed_field_t *field);
+
 qd_parsed_field_t* qd_field_first_child(qd_parsed_field_t *field)
 {
-    return DEQ_HEAD(field->children);
+    qd_parsed_field_t *child = DEQ_HEAD(field->children);
+    return child ? child : decode_next_child(field);
 }
 
 qd_parsed_field_t* qd_field_next_child(qd_parsed_field_t *field)
 {
-    return DEQ_NEXT(field);
+    qd_parsed_field_t *next = DEQ_NEXT(field);
+    if (!next && field->parent)
+        next = decode_next_child((qd_parsed_field_t *) field->parent);
+    return next;
 }
 
 
@@ -179,11 +193,10 @@ static inline char *parse_amqp_field(qd_buffer_field_t *bfield, qd_amqp_field_t
 
 
 
-// bfield contains the encoded AMQP data to be parsed.  bfield starts at the
-// type tag octet and should be long enough to hold the entire AMQP data type.
-// On return bfield has been advanced past the encoded AMQP data.
+// Allocate a field for the encoded AMQP data at bfield and decode its type header, but not its children.  bfield
+// starts at the type tag octet and is advanced past the encoded AMQP data.
 //
-static qd_parsed_field_t *qd_parse_internal(qd_buffer_field_t *bfield, qd_parsed_field_t *p)
+static qd_parsed_field_t *parse_field_header(qd_buffer_field_t *bfield, const qd_parsed_field_t *p)
 {
     qd_parsed_field_t *field = new_qd_parsed_field_t();
     if (!field)
@@ -199,7 +212,20 @@ static qd_parsed_field_t *qd_parse_internal(qd_buffer_field_t *bfield, qd_parsed
         // truncate full_field in case bfield holds multiple values.
         // since bfield has advanced past the parsed field we just subtract it.
         field->full_field.remaining -= bfield->remaining;
+    }
+
+    return field;
+}
+
 
+// bfield contains the encoded AMQP data to be parsed.  bfield starts at the
+// type tag octet and should be long enough to hold the entire AMQP data type.
+// On return bfield has been advanced past the encoded AMQP data.
+//
+static qd_parsed_field_t *qd_parse_internal(qd_buffer_field_t *bfield, qd_parsed_field_t *p)
+{
+    qd_parsed_field_t *field = parse_field_header(bfield, p);
+    if (field && !field->parse_error) {
         // now parse out the content of any contained types:
         qd_buffer_field_t children = field->amqp.value;
         for (uint32_t idx = 0; idx < field->amqp.count; idx++) {
@@ -216,6 +242,106 @@ static qd_parsed_field_t *qd_parse_internal(qd_buffer_field_t *bfield, qd_parsed
 }
 
 
+// Check that the count elements encoded in bfield are well-formed without allocating fields for them.  Returns the
+// error of the first malformed element, as qd_parse_internal() would set it on their parent.
+//
+static const char *validate_elements(qd_buffer_field_t *bfield, uint32_t count)
+{
+    for (uint32_t idx = 0; idx < count; idx++) {
+        qd_amqp_field_t amqp;
+        const char     *error = parse_amqp_field(bfield, &amqp);
+        if (!error)
+            error = validate_elements(&amqp.value, amqp.count);
+        if (error)
+            return error;
+    }
+    return 0;
+}
+
+
+// Decode a field without its children.  The children of composites are validated, so the field is ok if and only if
+// qd_parse_internal() would parse it, and they are decoded when they are first visited.
+//
+static qd_parsed_field_t *qd_parse_lazy_internal(qd_buffer_field_t *bfield)
+{
+    qd_parsed_field_t *field = parse_field_header(bfield, 0);
+    if (field && !field->parse_error) {
+        qd_buffer_field_t children = field->amqp.value;
+        field->parse_error = validate_elements(&children, field->amqp.count);
+        if (!field->parse_error) {
+            field->pending       = field->amqp.value;
+            field->pending_count = field->amqp.count;
+        }
+    }
+    return field;
+}
+
+
+// Decode the next child of a lazily parsed field, 0 if all its children have been decoded.  The child's own children
+// are decoded when they are visited.
+//
+static qd_parsed_field_t *decode_next_child(qd_parsed_field_t *field)
+{
+    if (field->pending_count == 0)
+        return 0;
+
+    qd_parsed_field_t *child = parse_field_header(&field->pending, field);
+    if (!child)
+        return 0;
+    assert(!child->parse_error);  // validated by qd_parse_lazy_internal()
+    child->pending       = child->amqp.value;
+    child->pending_count = child->amqp.count;
+    field->pending_count--;
+    DEQ_INSERT_TAIL(field->children, child);
+    return child;
+}
+
+
+// Index the children of a well-formed composite by position, decoding the children that were not decoded yet
+//
+static void build_index(qd_parsed_field_t *field)
+{
+    while (decode_next_child(field))
+        ;
+
+    size_t count = DEQ_SIZE(field->children);
+    field->index = NEW_PTR_ARRAY(qd_parsed_field_t, count);
+    size_t idx   = 0;
+    for (qd_parsed_field_t *child = DEQ_HEAD(field->children); child; child = DEQ_NEXT(child))
+        field->index[idx++] = child;
+}
+
+
+// True if the children of the field are indexed, indexing them first if the field is large enough
+//
+static bool index_children(qd_parsed_field_t *field)
+{
+    if (!field->index && !field->parse_error
+        && DEQ_SIZE(field->children) + field->pending_count >= PARSE_INDEX_MIN_CHILDREN)
+        build_index(field);
+    return !!field->index;
+}
+
+
+// The idx'th child of a field, decoded if it was parsed lazily
+//
+static qd_parsed_field_t *child_at(qd_parsed_field_t *field, uint32_t idx)
+{
+    if (index_children(field))
+        return idx < DEQ_SIZE(field->children) ? field->index[idx] : 0;
+
+    while (DEQ_SIZE(field->children) <= idx && decode_next_child(field))
+        ;
+
+    qd_parsed_field_t *child = DEQ_HEAD(field->children);
+    while (idx && child) {
+        idx--;
+        child = DEQ_NEXT(child);
+    }
+    return child;
+}
+
+
 qd_parsed_field_t *qd_parse(const qd_iterator_t *iter)
 {
     if (!iter)
@@ -226,6 +352,26 @@ qd_parsed_field_t *qd_parse(const qd_iterator_t *iter)
 }
 
 
+qd_parsed_field_t *qd_parse_buffer_field(const qd_buffer_field_t *bfield)
+{
+    if (!bfield)
+        return 0;
+
+    qd_buffer_field_t copy = *bfield;
+    return qd_parse_internal(&copy, 0);
+}
+
+
+qd_parsed_field_t *qd_parse_lazy(const qd_iterator_t *iter)
+{
+    if (!iter)
+        return 0;
+
+    qd_buffer_field_t bfield = qd_iterator_get_view_cursor(iter);
+    return qd_parse_lazy_internal(&bfield);
+}
+
+
 void qd_parse_free(qd_parsed_field_t *field)
 {
     if (!field)
@@ -238,6 +384,9 @@ void qd_parse_free(qd_parsed_field_t *field)
     if (field->typed_iter)
         qd_iterator_free(field->typed_iter);
 
+    free(field->index);
+    free(field->key_slots);
+
     qd_parsed_field_t *sub_field = DEQ_HEAD(field->children);
     while (sub_field) {
         qd_parsed_field_t *next = DEQ_NEXT(sub_field);
@@ -264,10 +413,12 @@ static qd_parsed_field_t *qd_parse_dup_internal(const qd_parsed_field_t *field,
     dup->typed_iter = qd_iterator_dup(field->typed_iter);
     dup->amqp       = field->amqp;
     dup->full_field = field->full_field;
+    dup->pending       = field->pending;
+    dup->pending_count = field->pending_count;
 
     qd_parsed_field_t *child = DEQ_HEAD(field->children);
     while (child) {
-        qd_parsed_field_t *dup_child = qd_parse_dup_internal(child, field);
+        qd_parsed_field_t *dup_child = qd_parse_dup_internal(child, dup);
         DEQ_INSERT_TAIL(dup->children, dup_child);
         child = DEQ_NEXT(child);
     }
@@ -598,7 +749,7 @@ bool qd_parse_as_bool(qd_parsed_field_t *parsed_field)
 
 uint32_t qd_parse_sub_count(qd_parsed_field_t *field)
 {
-    uint32_t count = DEQ_SIZE(field->children);
+    uint32_t count = DEQ_SIZE(field->children) + field->pending_count;
 
     if (field->amqp.tag == QD_AMQP_MAP8 || field->amqp.tag == QD_AMQP_MAP32)
         count = count >> 1;
@@ -612,14 +763,7 @@ qd_parsed_field_t *qd_parse_sub_key(qd_parsed_field_t *field, uint32_t idx)
     if (field->amqp.tag != QD_AMQP_MAP8 && field->amqp.tag != QD_AMQP_MAP32)
         return 0;
 
-    idx = idx << 1;
-    qd_parsed_field_t *key = DEQ_HEAD(field->children);
-    while (idx && key) {
-        idx--;
-        key = DEQ_NEXT(key);
-    }
-
-    return key;
+    return child_at(field, idx << 1);
 }
 
 
@@ -628,13 +772,7 @@ qd_parsed_field_t *qd_parse_sub_value(qd_parsed_field_t *field, uint32_t idx)
     if (field->amqp.tag == QD_AMQP_MAP8 || field->amqp.tag == QD_AMQP_MAP32)
         idx = (idx << 1) + 1;
 
-    qd_parsed_field_t *key = DEQ_HEAD(field->children);
-    while (idx && key) {
-        idx--;
-        key = DEQ_NEXT(key);
-    }
-
-    return key;
+    return child_at(field, idx);
 }
 
 
@@ -666,7 +804,7 @@ int qd_parse_is_list(qd_parsed_field_t *field)
 
 int qd_parse_is_scalar(qd_parsed_field_t *field)
 {
-    return DEQ_SIZE(field->children) == 0;
+    return DEQ_SIZE(field->children) == 0 && field->pending_count == 0;
 }
 
 
@@ -677,22 +815,95 @@ static inline bool qd_parse_is_string(const qd_parsed_field_t *field)
 }
 
 
+static inline bool key_equal(const qd_parsed_field_t *key_field, const char *key, size_t len)
+{
+    qd_buffer_field_t value = key_field->amqp.value;
+    return value.remaining == len && qd_buffer_field_equal(&value, (const uint8_t *) key, len);
+}
+
+
+static inline uint32_t key_hash_init(void)
+{
+    return 2166136261u;  // FNV-1a
+}
+
+
+static inline uint32_t key_hash_octet(uint32_t hash, uint8_t octet)
+{
+    return (hash ^ octet) * 16777619u;
+}
+
+
+static uint32_t key_field_hash(const qd_parsed_field_t *key_field)
+{
+    qd_buffer_field_t value = key_field->amqp.value;
+    uint32_t          hash  = key_hash_init();
+    uint8_t           octet;
+    while (qd_buffer_field_octet(&value, &octet))
+        hash = key_hash_octet(hash, octet);
+    return hash;
+}
+
+
+// Hash the keys of an indexed map.  The entries are inserted in order so that, with duplicate keys, the probe sequence
+// reaches the first entry of a key first, as a linear search would.
+//
+static void build_key_index(qd_parsed_field_t *field)
+{
+    uint32_t entries = DEQ_SIZE(field->children) / 2;
+    uint32_t slots   = 4;
+    while (slots < entries * 2)
+        slots <<= 1;
+
+    field->key_mask  = slots - 1;
+    field->key_slots = NEW_ARRAY(uint32_t, slots);
+    memset(field->key_slots, 0, sizeof(uint32_t) * slots);
+    for (uint32_t entry = 0; entry < entries; entry++) {
+        uint32_t slot = key_field_hash(field->index[entry * 2]) & field->key_mask;
+        while (field->key_slots[slot])
+            slot = (slot + 1) & field->key_mask;
+        field->key_slots[slot] = entry + 1;
+    }
+}
+
+
+// Find the value of a key with the key index of an indexed map
+//
+static qd_parsed_field_t *find_key(qd_parsed_field_t *field, const char *key, size_t len)
+{
+    if (!field->key_slots)
+        build_key_index(field);
+
+    uint32_t hash = key_hash_init();
+    for (size_t i = 0; i < len; i++)
+        hash = key_hash_octet(hash, (uint8_t) key[i]);
+
+    for (uint32_t slot = hash & field->key_mask; field->key_slots[slot]; slot = (slot + 1) & field->key_mask) {
+        uint32_t entry = field->key_slots[slot] - 1;
+        if (key_equal(field->index[entry * 2], key, len))
+            return field->index[entry * 2 + 1];
+    }
+    return 0;
+}
+
+
 qd_parsed_field_t *qd_parse_value_by_key(qd_parsed_field_t *field, const char *key)
 {
-    if (!key)
+    if (!key || !qd_parse_is_map(field))
         return 0;
 
     uint32_t count = qd_parse_sub_count(field);
+    size_t   len   = strlen(key);
+
+    if (index_children(field))
+        return find_key(field, key, len);
 
     for (uint32_t idx = 0; idx < count; idx++) {
         qd_parsed_field_t *sub  = qd_parse_sub_key(field, idx);
         if (!sub)
             return 0;
 
-        qd_buffer_field_t value = sub->amqp.value;
-        size_t len = strlen(key);
-
-        if (qd_buffer_field_equal(&value, (const uint8_t*) key, len)) {
+        if (key_equal(sub, key, len)) {
             return qd_parse_sub_value(field, idx);
         }
     }
@@ -701,22 +912,35 @@ qd_parsed_field_t *qd_parse_value_by_key(qd_parsed_field_t *field, const char *k
 }
 
 
+// Decode the next entry of the router annotations list. *full is set to the entry's complete encoding (type header
+// and value).
+//
+static const char *ra_next_entry(qd_buffer_field_t *entries, qd_amqp_field_t *amqp, qd_buffer_field_t *full)
+{
+    *full = *entries;
+    const char *error = parse_amqp_field(entries, amqp);
+    if (!error)
+        full->remaining -= entries->remaining;
+    return error;
+}
+
+
+static inline bool ra_is_string(const qd_amqp_field_t *amqp)
+{
+    return amqp->tag == QD_AMQP_STR8_UTF8 || amqp->tag == QD_AMQP_STR32_UTF8;
+}
+
+
 /* Incoming message router annotations processing.
  * See docs/notes/router-annotations.adoc
+ *
+ * This runs for every message arriving over an inter-router or edge link, so the entries are only validated and
+ * located here. No parsed field trees are built: most transit messages need nothing but the flags, and the router
+ * re-sends the other entries unchanged.
  */
-const char *qd_parse_router_annotations(
-    qd_buffer_field_t  *ra_field,
-    qd_parsed_field_t **ra_ingress,
-    qd_parsed_field_t **ra_ingress_mesh,
-    qd_parsed_field_t **ra_to_override,
-    qd_parsed_field_t **ra_trace,
-    qd_parsed_field_t **ra_flags)
-{
-    *ra_ingress      = 0;
-    *ra_ingress_mesh = 0;
-    *ra_to_override  = 0;
-    *ra_trace        = 0;
-    *ra_flags        = 0;
+const char *qd_parse_router_annotations(qd_buffer_field_t *ra_field, qd_router_annotations_t *ra)
+{
+    ZERO(ra);
 
     // ra_field should be pointing to the encoded RA list
     qd_amqp_field_t ra_list;
@@ -733,62 +957,81 @@ const char *qd_parse_router_annotations(
         return "Invalid router annotations section: wrong list count";
 
     // The order of the annotations within the list is fixed and described in
-    // router-annotations.adoc.  ra_fields is set to the content of the list,
-    // and each time an entry is parsed ra_fields is advanced to the next list
+    // router-annotations.adoc.  ra_entries is set to the content of the list,
+    // and each time an entry is decoded ra_entries is advanced to the next list
     // entry.
 
-    qd_buffer_field_t ra_fields = ra_list.value;
+    qd_buffer_field_t ra_entries = ra_list.value;
+    qd_buffer_field_t full;
+    qd_amqp_field_t   amqp;
 
     // index 0: flags
-    (*ra_flags) = qd_parse_internal(&ra_fields, 0);
-    if (!qd_parse_ok((*ra_flags)))
-        return (*ra_flags)->parse_error;
+    qd_parsed_field_t flags;
+    ZERO(&flags);
+    error = ra_next_entry(&ra_entries, &flags.amqp, &full);
+    if (error)
+        return error;
+    ra->flags = qd_parse_as_uint(&flags);
+    if (!qd_parse_ok(&flags))
+        return flags.parse_error;
 
     // index 1: to-override (optional)
-    (*ra_to_override) = qd_parse_internal(&ra_fields, 0);
-    if (!qd_parse_ok((*ra_to_override)))
-        return (*ra_to_override)->parse_error;
-    if ((*ra_to_override)->amqp.tag == QD_AMQP_NULL) {
-        // optional - no to-override present
-        qd_parse_free(*ra_to_override);
-        *ra_to_override = 0;
-    } else if (!qd_parse_is_string(*ra_to_override))
-        return "Invalid router to-override annotation: wrong type";
-
-    // index 2: ingress router id
-    (*ra_ingress) = qd_parse_internal(&ra_fields, 0);
-    if (!qd_parse_ok((*ra_ingress)))
-        return (*ra_ingress)->parse_error;
-    if ((*ra_ingress)->amqp.tag == QD_AMQP_NULL) {
-        // no router ingress for edge connections
-        qd_parse_free(*ra_ingress);
-        *ra_ingress = 0;
-    } else if (!qd_parse_is_string(*ra_ingress))
-        return "Invalid router ingress annotation: wrong type";
-
-    // index 3: trace list
-    (*ra_trace) = qd_parse_internal(&ra_fields, 0);
-    if (!qd_parse_ok((*ra_trace)))
-        return (*ra_trace)->parse_error;
-    if (!qd_parse_is_list((*ra_trace)))
-        return "Invalid router trace annotation: not a list";
-    bool all_str = true;
-    for (qd_parsed_field_t *node = DEQ_HEAD((*ra_trace)->children);
-         node && all_str;
-         node = DEQ_NEXT(node)) {
-        all_str = qd_parse_is_string(node);
+    error = ra_next_entry(&ra_entries, &amqp, &full);
+    if (error)
+        return error;
+    if (amqp.tag != QD_AMQP_NULL) {
+        if (!ra_is_string(&amqp))
+            return "Invalid router to-override annotation: wrong type";
+        ra->to_override = full;
+    }
+
+    // index 2: ingress router id (no router ingress for edge connections)
+    error = ra_next_entry(&ra_entries, &amqp, &full);
+    if (error)
+        return error;
+    if (amqp.tag != QD_AMQP_NULL) {
+        if (!ra_is_string(&amqp))
+            return "Invalid router ingress annotation: wrong type";
+        ra->ingress = full;
+    }
+
+    // index 3: trace list, or the compact trace of router annotations version 3: a binary of 8 octet router
+    // fingerprints
+    error = ra_next_entry(&ra_entries, &amqp, &full);
+    if (error)
+        return error;
+    if (amqp.tag == QD_AMQP_VBIN8 || amqp.tag == QD_AMQP_VBIN32) {
+        if (amqp.size % QD_TRACE_FINGERPRINT_SIZE != 0)
+            return "Invalid router trace annotation: truncated fingerprint";
+        ra->trace         = full;
+        ra->trace_items   = amqp.value;
+        ra->trace_count   = amqp.size / QD_TRACE_FINGERPRINT_SIZE;
+        ra->trace_compact = true;
+    } else {
+        if (amqp.tag != QD_AMQP_LIST8 && amqp.tag != QD_AMQP_LIST32 && amqp.tag != QD_AMQP_LIST0)
+            return "Invalid router trace annotation: not a list";
+        qd_buffer_field_t items = amqp.value;
+        for (uint32_t idx = 0; idx < amqp.count; idx++) {
+            qd_amqp_field_t item;
+            error = parse_amqp_field(&items, &item);
+            if (error)
+                return error;
+            if (!ra_is_string(&item))
+                return "Invalid router trace annotation: list contains non-string entries";
+        }
+        ra->trace       = full;
+        ra->trace_items = amqp.value;
+        ra->trace_count = amqp.count;
     }
-    if (!all_str)
-        return "Invalid router trace annotation: list contains non-string entries";
 
     // index 4: ingress mesh id
     if (ra_list.count >= 5) {
-        (*ra_ingress_mesh) = qd_parse_internal(&ra_fields, 0);
-        if (!qd_parse_ok(*ra_ingress_mesh)) {
-            return (*ra_ingress_mesh)->parse_error;
-        } else if (!qd_parse_is_string(*ra_ingress_mesh)) {
+        error = ra_next_entry(&ra_entries, &amqp, &full);
+        if (error)
+            return error;
+        if (!ra_is_string(&amqp))
             return "Invalid ingress-mesh annotation: wrong type";
-        }
+        ra->ingress_mesh = full;
     }
 
     return 0;
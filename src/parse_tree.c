@@ -217,6 +217,14 @@ struct qd_parse_tree {
     qd_hash_t            *hash;
     qd_parse_tree_type_t  type;
     uint32_t              next_hkey_prefix;  // next # for hash key prefix
+    uint32_t              generation;        // bumped whenever a pattern is added or removed
+    uint32_t              wildcard_nodes;    // count of match-one/match-glob nodes in the tree
+
+    // optional memo of qd_parse_tree_retrieve_match results, keyed by the literal value.
+    // Only valid while match_cache_generation == generation.
+    qd_hash_t            *match_cache;
+    size_t                match_cache_max;
+    uint32_t              match_cache_generation;
 };
 ALLOC_DECLARE(qd_parse_tree_t);
 ALLOC_DEFINE(qd_parse_tree_t);
@@ -256,6 +264,7 @@ ALLOC_DEFINE(qd_parse_node_t);
 //  "<parent node hkey-prefix in hex>/<token>
 //
 #define HKEY_PREFIX_LEN (8 + 1)  // 8 hex chars (32 bit integer) + '/'
+#define HKEY_STACK_LEN  256      // hkeys up to this size are generated on the stack during lookup
 static inline void generate_hkey(char *hkey, size_t buf_len, uint32_t pprefix, const token_t *t)
 {
     int rc = snprintf(hkey, buf_len, "%"PRIX32"/%.*s", pprefix, (int)TOKEN_LEN(*t), t->begin);
@@ -280,6 +289,10 @@ static void free_parse_node(qd_parse_tree_t *tree, qd_parse_node_t *n)
         assert(parse_node_child_count(n) == 0);
         free(n->token);
         free(n->pattern);
+        if (n->match_type == QD_PARSE_NODE_MATCH_ONE || n->match_type == QD_PARSE_NODE_MATCH_GLOB) {
+            assert(tree->wildcard_nodes > 0);
+            tree->wildcard_nodes--;
+        }
         if (n->handle) {
             qd_hash_remove_by_handle(tree->hash, n->handle);
             qd_hash_handle_free(n->handle);
@@ -307,6 +320,8 @@ static qd_parse_node_t *new_parse_node(qd_parse_tree_t *tree,
         n->match_type = match_type;
         // generate a new hash key prefix for this node's children
         n->hkey_prefix = tree->next_hkey_prefix++;
+        if (match_type == QD_PARSE_NODE_MATCH_ONE || match_type == QD_PARSE_NODE_MATCH_GLOB)
+            tree->wildcard_nodes++;
 
         if (match_type == QD_PARSE_NODE_TOKEN) {
             assert(t);
@@ -343,15 +358,17 @@ static qd_parse_node_t *new_parse_node(qd_parse_tree_t *tree,
 static qd_parse_node_t *parse_node_find_child(qd_parse_tree_t *tree, const qd_parse_node_t *node, const token_t *token)
 {
     qd_parse_node_t *child = 0;
+    char buffer[HKEY_STACK_LEN];
     const size_t tlen = TOKEN_LEN(*token);
     const size_t hkey_size = HKEY_PREFIX_LEN + tlen + 1;
-    char *hkey = qd_malloc(hkey_size);
+    char *hkey = hkey_size <= sizeof(buffer) ? buffer : qd_malloc(hkey_size);
     generate_hkey(hkey, hkey_size, node->hkey_prefix, token);
     qd_hash_retrieve_str(tree->hash, (const unsigned char *)hkey, (void **)&child);
     if (child) {
         assert(child->parent == node);
     }
-    free(hkey);
+    if (hkey != buffer)
+        free(hkey);
     return child;
 }
 
@@ -443,6 +460,7 @@ static qd_error_t parse_node_add_pattern(qd_parse_tree_t *tree, char *pattern, v
             node->pattern = pattern;
             pattern = 0;
             node->payload = payload;
+            tree->generation++;
             qd_log(LOG_DEFAULT, QD_LOG_DEBUG, "Parse tree add pattern '%s'", node->pattern);
         }
     }
@@ -680,18 +698,95 @@ static bool get_first(void *handle, const char *pattern, void *payload)
     return false;
 }
 
-bool qd_parse_tree_retrieve_match(qd_parse_tree_t *tree,
-                                  const qd_iterator_t *value,
-                                  void **payload)
+
+// Match value against a tree that holds no wildcard patterns.  The only possible match is the
+// pattern with exactly the same tokens, so a single descent replaces the backtracking search.
+//
+static void *parse_node_find_exact(qd_parse_tree_t *tree, const char *value)
+{
+    qd_parse_node_t *node = tree->root;
+    token_iterator_t t_iter;
+
+    token_iterator_init(&t_iter, tree->type, value);
+    while (node && !token_iterator_done(&t_iter)) {
+        token_t token;
+        token_iterator_pop(&t_iter, &token);
+        node = parse_node_find_child(tree, node, &token);
+    }
+
+    return (node && node->pattern) ? node->payload : 0;
+}
+
+
+static void parse_tree_flush_match_cache(qd_parse_tree_t *tree)
+{
+    qd_hash_free(tree->match_cache);
+    tree->match_cache            = qd_hash(10, 32, false);
+    tree->match_cache_generation = tree->generation;
+}
+
+
+static bool parse_tree_retrieve_match(qd_parse_tree_t *tree, const char *value, void **payload)
 {
     *payload = NULL;
-    qd_parse_tree_search(tree, value, get_first, payload);
+
+    if (tree->match_cache) {
+        if (tree->match_cache_generation != tree->generation) {
+            parse_tree_flush_match_cache(tree);
+        } else if (qd_hash_retrieve_str(tree->match_cache, (const unsigned char *) value, payload) == QD_ERROR_NONE) {
+            // cached result, possibly a cached miss
+            return *payload != NULL;
+        }
+    }
+
+    qd_log(LOG_DEFAULT, QD_LOG_DEBUG, "Parse tree search for '%s'", value);
+
+    if (tree->wildcard_nodes == 0) {
+        *payload = parse_node_find_exact(tree, value);
+    } else {
+        token_iterator_t t_iter;
+        token_iterator_init(&t_iter, tree->type, value);
+        parse_node_find(tree, tree->root, &t_iter, get_first, payload);
+    }
+
+    if (tree->match_cache) {
+        if (qd_hash_size(tree->match_cache) >= tree->match_cache_max)
+            parse_tree_flush_match_cache(tree);
+        qd_hash_insert_str(tree->match_cache, (const unsigned char *) value, *payload, 0);
+    }
+
     if (*payload == NULL)
         qd_log(LOG_DEFAULT, QD_LOG_DEBUG, "Parse tree match not found");
     return *payload != NULL;
 }
 
 
+bool qd_parse_tree_retrieve_match(qd_parse_tree_t *tree,
+                                  const qd_iterator_t *value,
+                                  void **payload)
+{
+    char *str = (char *)qd_iterator_copy_const(value);
+    if (!str) {
+        *payload = NULL;
+        return false;
+    }
+
+    bool found = parse_tree_retrieve_match(tree, str, payload);
+    free(str);
+    return found;
+}
+
+
+void qd_parse_tree_enable_match_cache(qd_parse_tree_t *tree, size_t max_entries)
+{
+    qd_hash_free(tree->match_cache);
+    tree->match_cache     = 0;
+    tree->match_cache_max = max_entries;
+    if (max_entries)
+        parse_tree_flush_match_cache(tree);
+}
+
+
 // Invoke callback for each pattern that matches 'value'
 void qd_parse_tree_search(qd_parse_tree_t *tree,
                           const qd_iterator_t *value,
@@ -764,6 +859,7 @@ void *qd_parse_tree_remove_pattern(qd_parse_tree_t *tree,
     free(node->pattern);
     node->pattern = 0;
     node->payload = 0;
+    tree->generation++;
     qd_parse_node_t *parent = node->parent;
 
     while (node && node->pattern == 0 && parse_node_child_count(node) == 0 && parent) {
@@ -874,6 +970,7 @@ static void _parse_tree_free(qd_parse_tree_t *tree)
     if (tree) {
         parse_node_free(tree, tree->root);
         qd_hash_free(tree->hash);
+        qd_hash_free(tree->match_cache);
         free_qd_parse_tree_t(tree);
     }
 }
@@ -972,11 +1069,7 @@ bool qd_parse_tree_retrieve_match_str(qd_parse_tree_t *tree,
                                       const char *value,
                                       void **payload)
 {
-    *payload = NULL;
-    qd_parse_tree_search_str(tree, value, get_first, payload);
-    if (*payload == NULL)
-        qd_log(LOG_DEFAULT, QD_LOG_DEBUG, "Parse tree(str) match not found");
-    return *payload != NULL;
+    return parse_tree_retrieve_match(tree, value, payload);
 }
 
 // returns old payload or NULL if not present
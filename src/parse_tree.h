@@ -104,6 +104,13 @@ bool qd_parse_tree_retrieve_match(qd_parse_tree_t *tree,
                                   const qd_iterator_t *value,
                                   void **payload);
 
+// Memoize qd_parse_tree_retrieve_match results (including misses) keyed by the literal value,
+// holding at most max_entries results.  The memo is discarded whenever a pattern is added or
+// removed.  Lookups update the memo, so only enable this on a tree used by a single thread.
+// A max_entries of zero disables the memo.
+//
+void qd_parse_tree_enable_match_cache(qd_parse_tree_t *tree, size_t max_entries);
+
 // parse tree traversal
 
 // return false to stop tree transversal
@@ -26,6 +26,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #if QD_HAVE_GETRLIMIT
 #include <sys/resource.h>
 #endif
@@ -197,3 +199,36 @@ uint64_t qd_router_rss_memory_usage(void)
     // VmRSS is in kB
     return _parse_proc_memory_metric("VmRSS: %" SCNu64) * 1024;
 }
+
+// Linux-specific: the possible node ids are listed in cpulist format, e.g. "0-1"
+//
+int qd_platform_numa_node_count(void)
+{
+    int   count = 1;
+    FILE *fp    = fopen("/sys/devices/system/node/possible", "r");
+    if (fp) {
+        char buffer[64];
+        if (fgets(buffer, sizeof(buffer), fp)) {
+            // the last id is the highest one
+            char *last = strrchr(buffer, ',');
+            last       = last ? last + 1 : buffer;
+            char *dash = strchr(last, '-');
+            int   node = atoi(dash ? dash + 1 : last);
+            if (node >= 0)
+                count = node + 1;
+        }
+        fclose(fp);
+    }
+    return count;
+}
+
+int qd_platform_numa_node(void)
+{
+#ifdef SYS_getcpu
+    unsigned int cpu  = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, 0) == 0)
+        return (int) node;
+#endif
+    return 0;
+}
@@ -32,6 +32,7 @@
 #include "adaptors/amqp/qd_connector.h"
 #include "adaptors/amqp/container.h"
 
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/server.h"
 
 #include <proton/condition.h>
@@ -42,6 +43,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 //
 // The current statistics maintained globally through multiple
@@ -91,6 +93,74 @@ static PyObject * module = 0;
 
 ALLOC_DEFINE(qd_policy_settings_t);
 
+//
+// Cache of the settings fetched from the python vhost database, keyed by vhost and user group.
+// An entry holds everything qd_policy_open_fetch_settings() copies out of python so that a hit
+// needs neither the GIL nor the python call. The cache is flushed by the policy manager whenever
+// the vhost database changes.
+//
+#define SETTINGS_CACHE_BUCKETS 256
+#define SETTINGS_CACHE_MAX     4096
+
+typedef struct settings_cache_entry_t settings_cache_entry_t;
+struct settings_cache_entry_t {
+    settings_cache_entry_t    *next;
+    uint32_t                   hash;
+    char                      *vhost;
+    char                      *group_name;
+    qd_policy_spec_t           spec;
+    char                      *sources;
+    char                      *targets;
+    char                      *sourcePattern;
+    char                      *targetPattern;
+    char                      *vhost_policy;
+    qd_policy_denial_counts_t *denialCounts;
+};
+
+typedef struct settings_cache_t {
+    sys_mutex_t             lock;
+    settings_cache_entry_t *buckets[SETTINGS_CACHE_BUCKETS];
+    int                     count;
+    uint64_t                generation;  // advanced by every flush
+    qd_metric_t            *hits;
+    qd_metric_t            *misses;
+    qd_metric_t            *open_latency;
+} settings_cache_t;
+
+//
+// Rate limits
+//
+// Token buckets limit the rate at which message content and messages are accepted from connections. The limits of
+// the router, of each vhost and of each vhost user group are shared by all the connections they apply to and are
+// kept in a registry of the policy; the limits of a single connection are its own. A connection over any of its
+// limits is throttled: its adaptor holds back the credit or read buffers it would give the peer until
+// qd_policy_rate_charge() finds all its buckets out of deficit again.
+//
+typedef struct qd_policy_rate_t qd_policy_rate_t;
+struct qd_policy_rate_t {
+    DEQ_LINKS(qd_policy_rate_t);
+    qd_policy_t              *policy;     // registry holding the rate, 0 once the policy is freed
+    char                     *vhost;      // 0 for the router-wide rates
+    char                     *group;      // 0 for the rates of the whole vhost
+    int                       ref_count;  // under policy->rate_lock
+    qd_policy_token_bucket_t  octets;
+    qd_policy_token_bucket_t  messages;
+    qd_metric_t              *throttled_total;        // times connections were throttled by these rates
+    qd_metric_t              *throttled_connections;  // connections currently throttled by these rates
+};
+
+DEQ_DECLARE(qd_policy_rate_t, qd_policy_rate_list_t);
+
+struct qd_policy_rate_limits_t {
+    qd_policy_rate_t         *router;
+    qd_policy_rate_t         *vhost;
+    qd_policy_rate_t         *group;         // also reports the throttling by the connection's own buckets
+    qd_policy_token_bucket_t  octets;        // the connection's own buckets
+    qd_policy_token_bucket_t  messages;
+    qd_policy_rate_t         *throttled_by;  // rates the connection is held back by, 0 if it is not throttled
+    bool                      count_messages;
+};
+
 //
 // Policy configuration/statistics management interface
 //
@@ -99,6 +169,10 @@ struct qd_policy_t {
     void                 *py_policy_manager;
     sys_mutex_t           tree_lock;
     qd_parse_tree_t      *hostname_tree;
+    settings_cache_t      settings_cache;
+    sys_mutex_t           rate_lock;
+    qd_policy_rate_list_t rates;
+    qd_policy_rate_t     *router_rate;  // 0 if there are no router-wide rate limits
                           // configured settings
     int                   max_connection_limit;
     char                 *policyDir;
@@ -110,6 +184,136 @@ struct qd_policy_t {
     int                   connections_current;
 };
 
+static uint64_t now_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+void _qd_policy_token_bucket_init(qd_policy_token_bucket_t *bucket, uint64_t rate, uint64_t now_ns)
+{
+    sys_spinlock_init(&bucket->lock);
+    bucket->rate    = rate;
+    bucket->tokens  = (double) rate;
+    bucket->last_ns = now_ns;
+}
+
+
+void _qd_policy_token_bucket_final(qd_policy_token_bucket_t *bucket)
+{
+    sys_spinlock_free(&bucket->lock);
+}
+
+
+static void token_bucket_refill_LH(qd_policy_token_bucket_t *bucket, uint64_t now_ns)
+{
+    if (now_ns > bucket->last_ns) {
+        bucket->tokens += (double) bucket->rate * (double) (now_ns - bucket->last_ns) / 1e9;
+        if (bucket->tokens > (double) bucket->rate)
+            bucket->tokens = (double) bucket->rate;
+        bucket->last_ns = now_ns;
+    }
+}
+
+
+void _qd_policy_token_bucket_set_rate(qd_policy_token_bucket_t *bucket, uint64_t rate, uint64_t now_ns)
+{
+    sys_spinlock_lock(&bucket->lock);
+    if (rate != bucket->rate) {
+        token_bucket_refill_LH(bucket, now_ns);
+        bucket->rate = rate;
+        if (bucket->tokens > (double) rate)
+            bucket->tokens = (double) rate;
+    }
+    sys_spinlock_unlock(&bucket->lock);
+}
+
+
+uint64_t _qd_policy_token_bucket_take(qd_policy_token_bucket_t *bucket, uint64_t tokens, uint64_t now_ns)
+{
+    uint64_t delay_ns = 0;
+    sys_spinlock_lock(&bucket->lock);
+    if (bucket->rate) {
+        token_bucket_refill_LH(bucket, now_ns);
+        bucket->tokens -= (double) tokens;
+        if (bucket->tokens < 0)
+            delay_ns = (uint64_t) (-bucket->tokens * 1e9 / (double) bucket->rate) + 1;
+    }
+    sys_spinlock_unlock(&bucket->lock);
+    return delay_ns;
+}
+
+
+/** Find or create the shared rates of vhost/group and take a reference to them. The rates are updated to the
+ * current settings.
+ **/
+static qd_policy_rate_t *rate_acquire(qd_policy_t *policy, const char *vhost, const char *group,
+                                      uint64_t octets_rate, uint64_t messages_rate, uint64_t now_ns)
+{
+    sys_mutex_lock(&policy->rate_lock);
+    qd_policy_rate_t *rate = DEQ_HEAD(policy->rates);
+    while (rate) {
+        if (!!rate->vhost == !!vhost && (!vhost || strcmp(rate->vhost, vhost) == 0)
+            && !!rate->group == !!group && (!group || strcmp(rate->group, group) == 0))
+            break;
+        rate = DEQ_NEXT(rate);
+    }
+
+    if (rate) {
+        _qd_policy_token_bucket_set_rate(&rate->octets, octets_rate, now_ns);
+        _qd_policy_token_bucket_set_rate(&rate->messages, messages_rate, now_ns);
+    } else {
+        rate = NEW(qd_policy_rate_t);
+        ZERO(rate);
+        DEQ_ITEM_INIT(rate);
+        rate->policy = policy;
+        rate->vhost  = vhost ? qd_strdup(vhost) : 0;
+        rate->group  = group ? qd_strdup(group) : 0;
+        _qd_policy_token_bucket_init(&rate->octets, octets_rate, now_ns);
+        _qd_policy_token_bucket_init(&rate->messages, messages_rate, now_ns);
+
+        const char *label_names[]  = {"vhost", "group"};
+        const char *label_values[] = {vhost ? vhost : "", group ? group : ""};
+        rate->throttled_total = qd_metric_labels(QD_METRIC_COUNTER, "qdr_policy_throttled_total", 2, label_names,
+                                                 label_values);
+        rate->throttled_connections = qd_metric_labels(QD_METRIC_GAUGE, "qdr_policy_throttled_connections", 2,
+                                                       label_names, label_values);
+        DEQ_INSERT_TAIL(policy->rates, rate);
+    }
+    rate->ref_count++;
+    sys_mutex_unlock(&policy->rate_lock);
+    return rate;
+}
+
+
+static void rate_release(qd_policy_rate_t *rate)
+{
+    if (!rate)
+        return;
+
+    qd_policy_t *policy = rate->policy;
+    if (policy)
+        sys_mutex_lock(&policy->rate_lock);
+    bool unused = --rate->ref_count == 0;
+    if (unused && policy)
+        DEQ_REMOVE(policy->rates, rate);
+    if (policy)
+        sys_mutex_unlock(&policy->rate_lock);
+
+    if (unused) {
+        _qd_policy_token_bucket_final(&rate->octets);
+        _qd_policy_token_bucket_final(&rate->messages);
+        qd_metric_free(rate->throttled_total);
+        qd_metric_free(rate->throttled_connections);
+        free(rate->vhost);
+        free(rate->group);
+        free(rate);
+    }
+}
+
+
 /** Create the policy structure
  * @param[in] qd pointer the the qd
  **/
@@ -122,6 +326,12 @@ qd_policy_t *qd_policy(qd_dispatch_t *qd)
     policy->hostname_tree        = qd_parse_tree_new(QD_PARSE_TREE_ADDRESS);
     sys_mutex_init(&stats_lock);
     sys_mutex_init(&policy->tree_lock);
+    sys_mutex_init(&policy->settings_cache.lock);
+    sys_mutex_init(&policy->rate_lock);
+    DEQ_INIT(policy->rates);
+    policy->settings_cache.hits         = qd_metric(QD_METRIC_COUNTER, "qdr_policy_settings_cache_hits_total", 0, 0);
+    policy->settings_cache.misses       = qd_metric(QD_METRIC_COUNTER, "qdr_policy_settings_cache_misses_total", 0, 0);
+    policy->settings_cache.open_latency = qd_metric(QD_METRIC_HISTOGRAM, "qdr_policy_open_latency_microseconds", 0, 0);
 
     qd_log(LOG_POLICY, QD_LOG_DEBUG, "Policy Initialized");
     return policy;
@@ -137,6 +347,23 @@ void qd_policy_free(qd_policy_t *policy)
         free(policy->policyDir);
     sys_mutex_free(&policy->tree_lock);
     hostname_tree_free(policy->hostname_tree);
+    qd_policy_settings_cache_flush(policy);
+    sys_mutex_free(&policy->settings_cache.lock);
+    qd_metric_free(policy->settings_cache.hits);
+    qd_metric_free(policy->settings_cache.misses);
+    qd_metric_free(policy->settings_cache.open_latency);
+
+    // Connections freed after the policy release their rates without the registry
+    sys_mutex_lock(&policy->rate_lock);
+    qd_policy_rate_t *rate = DEQ_HEAD(policy->rates);
+    while (rate) {
+        DEQ_REMOVE_HEAD(policy->rates);
+        rate->policy = 0;
+        rate = DEQ_HEAD(policy->rates);
+    }
+    sys_mutex_unlock(&policy->rate_lock);
+    rate_release(policy->router_rate);
+    sys_mutex_free(&policy->rate_lock);
     Py_XDECREF(module);
     free(policy);
     sys_mutex_free(&stats_lock);
@@ -161,6 +388,12 @@ qd_error_t qd_entity_configure_policy(qd_policy_t *policy, qd_entity_t *entity)
         qd_entity_opt_string(entity, "policyDir", 0); CHECK();
     policy->enableVhostPolicy = qd_entity_opt_bool(entity, "enableVhostPolicy", false); CHECK();
     policy->enableVhostNamePatterns = qd_entity_opt_bool(entity, "enableVhostNamePatterns", false); CHECK();
+    long max_bytes_per_sec    = qd_entity_opt_long(entity, "maxBytesPerSecond", 0); CHECK();
+    long max_messages_per_sec = qd_entity_opt_long(entity, "maxMessagesPerSecond", 0); CHECK();
+    if (max_bytes_per_sec < 0 || max_messages_per_sec < 0)
+        return qd_error(QD_ERROR_CONFIG, "maxBytesPerSecond and maxMessagesPerSecond must be >= 0");
+    if (max_bytes_per_sec || max_messages_per_sec)
+        policy->router_rate = rate_acquire(policy, 0, 0, max_bytes_per_sec, max_messages_per_sec, now_nsec());
     qd_log(LOG_POLICY, QD_LOG_INFO,
            "Policy configured maxConnections: %d, "
            "policyDir: '%s',"
@@ -325,16 +558,14 @@ void qd_policy_socket_close(qd_policy_t *policy, const qd_connection_t *conn)
 static const char* QPALN_COMMA_SEP =",";
 
 //
-// Given a CSV string defining parser tree specs for allowed sender or
-// receiver links, return a parse_tree
-//
-//  @param config_spec CSV string with link name match patterns
-//     The patterns consist of ('key', 'prefix', 'suffix') triplets describing
-//     the match pattern.
-//  @return pointer to parse tree
+// Build the parse tree of the link name match patterns in config_spec with
+// username in place of the ${user} substitution key, or with the key itself
+// if username is null.
 //
-qd_parse_tree_t * qd_policy_parse_tree(const char *config_spec)
+static qd_parse_tree_t *parse_tree_build(const char *config_spec, const char *username)
 {
+    const char *user = username ? username : user_subst_key;
+
     if (!config_spec || strlen(config_spec) == 0)
         // empty config specs never match so don't even create parse tree
         return NULL;
@@ -378,17 +609,17 @@ qd_parse_tree_t * qd_policy_parse_tree(const char *config_spec)
         pch += sS2 + 1;
         pS2[sS2] = '\0';
 
-        size_t sName = sS1 + strlen(user_subst_key) + sS2 + 1; // large enough to handle any case
+        size_t sName = sS1 + strlen(user) + sS2 + 1; // large enough to handle any case
         char *pName = (char *)malloc(sName);
 
         if (!strcmp(pChar, user_subst_i_absent))
             snprintf(pName, sName, "%s", pS1);
         else if (!strcmp(pChar, user_subst_i_prefix))
-            snprintf(pName, sName, "%s%s", user_subst_key, pS2);
+            snprintf(pName, sName, "%s%s", user, pS2);
         else if (!strcmp(pChar, user_subst_i_embed))
-            snprintf(pName, sName, "%s%s%s", pS1, user_subst_key, pS2);
+            snprintf(pName, sName, "%s%s%s", pS1, user, pS2);
         else
-            snprintf(pName, sName, "%s%s", pS1, user_subst_key);
+            snprintf(pName, sName, "%s%s", pS1, user);
         qd_parse_tree_add_pattern_str(tree, pName, (void *)1);
 
         free(pName);
@@ -398,6 +629,55 @@ qd_parse_tree_t * qd_policy_parse_tree(const char *config_spec)
 }
 
 
+//
+// Given a CSV string defining parser tree specs for allowed sender or
+// receiver links, return a parse_tree
+//
+//  @param config_spec CSV string with link name match patterns
+//     The patterns consist of ('key', 'prefix', 'suffix') triplets describing
+//     the match pattern.
+//  @return pointer to parse tree
+//
+qd_parse_tree_t * qd_policy_parse_tree(const char *config_spec)
+{
+    return parse_tree_build(config_spec, 0);
+}
+
+
+qd_parse_tree_t *_qd_policy_user_parse_tree(const char *config_spec, const char *username)
+{
+    return parse_tree_build(config_spec, username);
+}
+
+
+/**
+ * Given a char return true if it is a parse_tree token separater
+ */
+bool is_token_sep(char testc)
+{
+    for (const char *ptr = qd_parse_address_token_sep(); *ptr != '\0'; ptr++) {
+        if (*ptr == testc)
+            return true;
+    }
+    return false;
+}
+
+
+//
+// A user name can be substituted into the link name patterns of a parse tree
+// only if it forms whole tokens of the address and holds no wildcard: a user
+// named '#' must not be allowed every address.
+//
+static bool user_name_substitutable(const char *username)
+{
+    if (!username || !*username)
+        return false;
+    if (strpbrk(username, "*#"))
+        return false;
+    return !is_token_sep(username[0]) && !is_token_sep(username[strlen(username) - 1]);
+}
+
+
 //
 // Functions related to authenticated connection denial.
 // An AMQP Open has been received over some connection.
@@ -518,21 +798,180 @@ bool qd_policy_open_lookup_user(
 }
 
 
+static uint32_t settings_cache_hash(const char *vhost, const char *group_name)
+{
+    uint32_t hash = 2166136261u;  // FNV-1a over vhost, a separator and group_name
+    for (const char *c = vhost; *c; ++c)
+        hash = (hash ^ (uint8_t) *c) * 16777619u;
+    hash = (hash ^ 0xff) * 16777619u;
+    for (const char *c = group_name; *c; ++c)
+        hash = (hash ^ (uint8_t) *c) * 16777619u;
+    return hash;
+}
+
+
+static char *strdup_opt(const char *str)
+{
+    return str ? qd_strdup(str) : 0;
+}
+
+
+static void settings_cache_entry_free(settings_cache_entry_t *entry)
+{
+    free(entry->vhost);
+    free(entry->group_name);
+    free(entry->sources);
+    free(entry->targets);
+    free(entry->sourcePattern);
+    free(entry->targetPattern);
+    free(entry->vhost_policy);
+    free(entry);
+}
+
+
+void qd_policy_settings_cache_flush(qd_policy_t *policy)
+{
+    settings_cache_t *cache = &policy->settings_cache;
+    sys_mutex_lock(&cache->lock);
+    for (int i = 0; i < SETTINGS_CACHE_BUCKETS; ++i) {
+        settings_cache_entry_t *entry = cache->buckets[i];
+        while (entry) {
+            settings_cache_entry_t *next = entry->next;
+            settings_cache_entry_free(entry);
+            entry = next;
+        }
+        cache->buckets[i] = 0;
+    }
+    cache->count = 0;
+    cache->generation++;
+    sys_mutex_unlock(&cache->lock);
+}
+
+
+/** Copy the cached settings for vhost/group_name into settings.
+ * Return false on a cache miss, in which case *generation is set to the generation to be passed to
+ * settings_cache_insert() once the settings have been fetched from python.
+ **/
+static bool settings_cache_lookup(qd_policy_t *policy, const char *vhost, const char *group_name,
+                                  qd_policy_settings_t *settings, uint64_t *generation)
+{
+    settings_cache_t *cache = &policy->settings_cache;
+    uint32_t          hash  = settings_cache_hash(vhost, group_name);
+    bool              found = false;
+
+    sys_mutex_lock(&cache->lock);
+    for (settings_cache_entry_t *entry = cache->buckets[hash % SETTINGS_CACHE_BUCKETS]; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->vhost, vhost) == 0 && strcmp(entry->group_name, group_name) == 0) {
+            settings->spec          = entry->spec;
+            settings->sources       = strdup_opt(entry->sources);
+            settings->targets       = strdup_opt(entry->targets);
+            settings->sourcePattern = strdup_opt(entry->sourcePattern);
+            settings->targetPattern = strdup_opt(entry->targetPattern);
+            settings->vhost_policy  = strdup_opt(entry->vhost_policy);
+            settings->denialCounts  = entry->denialCounts;
+            found = true;
+            break;
+        }
+    }
+    *generation = cache->generation;
+    sys_mutex_unlock(&cache->lock);
+
+    qd_metric_inc(found ? cache->hits : cache->misses, 1);
+    return found;
+}
+
+
+/** Remember the settings fetched from python for vhost/group_name.
+ * Nothing is cached if the cache was flushed since the lookup that returned generation: the
+ * settings may predate the change to the vhost database.
+ **/
+static void settings_cache_insert(qd_policy_t *policy, const char *vhost, const char *group_name,
+                                  const qd_policy_settings_t *settings, uint64_t generation)
+{
+    settings_cache_t       *cache = &policy->settings_cache;
+    settings_cache_entry_t *entry = NEW(settings_cache_entry_t);
+    ZERO(entry);
+    entry->hash          = settings_cache_hash(vhost, group_name);
+    entry->vhost         = qd_strdup(vhost);
+    entry->group_name    = qd_strdup(group_name);
+    entry->spec          = settings->spec;
+    entry->sources       = strdup_opt(settings->sources);
+    entry->targets       = strdup_opt(settings->targets);
+    entry->sourcePattern = strdup_opt(settings->sourcePattern);
+    entry->targetPattern = strdup_opt(settings->targetPattern);
+    entry->vhost_policy  = strdup_opt(settings->vhost_policy);
+    entry->denialCounts  = settings->denialCounts;
+
+    sys_mutex_lock(&cache->lock);
+    settings_cache_entry_t **bucket = &cache->buckets[entry->hash % SETTINGS_CACHE_BUCKETS];
+    bool cached = cache->generation == generation && cache->count < SETTINGS_CACHE_MAX;
+    for (settings_cache_entry_t *other = *bucket; cached && other; other = other->next) {
+        // another connection fetched the same settings concurrently
+        if (other->hash == entry->hash && strcmp(other->vhost, vhost) == 0 && strcmp(other->group_name, group_name) == 0)
+            cached = false;
+    }
+    if (cached) {
+        entry->next = *bucket;
+        *bucket     = entry;
+        cache->count++;
+    }
+    sys_mutex_unlock(&cache->lock);
+
+    if (!cached)
+        settings_cache_entry_free(entry);
+}
+
+
+/** Compile the link name rules of settings for the user of the connection.
+ * The user name is substituted once here so that approving a link or an anonymous
+ * message target is a single match against the compiled rules.
+ **/
+static void compile_link_rules(qd_policy_settings_t *settings, const char *username)
+{
+    bool user_bound = user_name_substitutable(username);
+    settings->sourceParseTree     = parse_tree_build(settings->sourcePattern, user_bound ? username : 0);
+    settings->targetParseTree     = parse_tree_build(settings->targetPattern, user_bound ? username : 0);
+    settings->parseTreesUserBound = user_bound;
+    if (!settings->sourceParseTree)
+        settings->sourceNames = _qd_policy_compile_link_names(username, settings->sources);
+    if (!settings->targetParseTree)
+        settings->targetNames = _qd_policy_compile_link_names(username, settings->targets);
+}
+
+
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
 /** Fetch policy settings for a vhost/group
  * A vhost database user group name has been returned by qd_policy_open_lookup_user
  * or by some configuration value. Access the vhost database for that group and
  * extract the run-time settings.
+ * Settings found in the settings cache are returned without calling python.
+ * The link name rules are compiled for username.
  * @param[in] policy pointer to policy
  * @param[in] vhost vhost name
  * @param[in] group_name usergroup that holds the settings
+ * @param[in] username authenticated user name of the connection
  * @param[out] settings pointer to settings object to be filled with policy values
  **/
 bool qd_policy_open_fetch_settings(
     qd_policy_t *policy,
     const char *vhost,
     const char *group_name,
+    const char *username,
     qd_policy_settings_t *settings)
 {
+    uint64_t generation;
+    if (settings_cache_lookup(policy, vhost, group_name, settings, &generation)) {
+        compile_link_rules(settings, username);
+        return true;
+    }
+
     bool res = false;
     qd_python_lock_state_t lock_state = qd_python_lock();
     {
@@ -553,6 +992,12 @@ bool qd_policy_open_fetch_settings(
                         settings->spec.maxSenders           = qd_entity_opt_long((qd_entity_t*)upolicy, "maxSenders", 0);
                         settings->spec.maxReceivers         = qd_entity_opt_long((qd_entity_t*)upolicy, "maxReceivers", 0);
                         settings->spec.maxMessageSize       = qd_entity_opt_long((qd_entity_t*)upolicy, "maxMessageSize", 0);
+                        settings->spec.maxBytesPerSecond    = qd_entity_opt_long((qd_entity_t*)upolicy, "maxBytesPerSecond", 0);
+                        settings->spec.maxMessagesPerSecond = qd_entity_opt_long((qd_entity_t*)upolicy, "maxMessagesPerSecond", 0);
+                        settings->spec.maxConnectionBytesPerSecond    = qd_entity_opt_long((qd_entity_t*)upolicy, "maxConnectionBytesPerSecond", 0);
+                        settings->spec.maxConnectionMessagesPerSecond = qd_entity_opt_long((qd_entity_t*)upolicy, "maxConnectionMessagesPerSecond", 0);
+                        settings->spec.vhostMaxBytesPerSecond         = qd_entity_opt_long((qd_entity_t*)upolicy, "vhostMaxBytesPerSecond", 0);
+                        settings->spec.vhostMaxMessagesPerSecond      = qd_entity_opt_long((qd_entity_t*)upolicy, "vhostMaxMessagesPerSecond", 0);
                         settings->spec.allowAnonymousSender = qd_entity_opt_bool((qd_entity_t*)upolicy, "allowAnonymousSender", false);
                         settings->spec.allowDynamicSource   = qd_entity_opt_bool((qd_entity_t*)upolicy, "allowDynamicSource", false);
                         settings->spec.allowUserIdProxy       = qd_entity_opt_bool((qd_entity_t*)upolicy, "allowUserIdProxy", false);
@@ -565,8 +1010,7 @@ bool qd_policy_open_fetch_settings(
                         settings->targets              = qd_entity_get_string((qd_entity_t*)upolicy, "targets");
                         settings->sourcePattern        = qd_entity_get_string((qd_entity_t*)upolicy, "sourcePattern");
                         settings->targetPattern        = qd_entity_get_string((qd_entity_t*)upolicy, "targetPattern");
-                        settings->sourceParseTree      = qd_policy_parse_tree(settings->sourcePattern);
-                        settings->targetParseTree      = qd_policy_parse_tree(settings->targetPattern);
+                        settings->vhost_policy         = qd_entity_opt_string((qd_entity_t*)upolicy, "vhostPolicy", 0);
                         settings->denialCounts         = (qd_policy_denial_counts_t*)
                                                         qd_entity_get_pointer_from_capsule((qd_entity_t*)upolicy, "denialCounts");
                         res = true; // named settings content returned
@@ -588,6 +1032,10 @@ bool qd_policy_open_fetch_settings(
     }
     qd_python_unlock(lock_state);
 
+    if (res) {
+        settings_cache_insert(policy, vhost, group_name, settings, generation);
+        compile_link_rules(settings, username);
+    }
     return res;
 }
 
@@ -722,18 +1170,6 @@ void qd_policy_count_max_size_event(pn_link_t *link, qd_connection_t *qd_conn)
     }
 }
 
-/**
- * Given a char return true if it is a parse_tree token separater
- */
-bool is_token_sep(char testc)
-{
-    for (const char *ptr = qd_parse_address_token_sep(); *ptr != '\0'; ptr++) {
-        if (*ptr == testc)
-            return true;
-    }
-    return false;
-}
-
 
 //
 //
@@ -877,6 +1313,148 @@ bool _qd_policy_approve_link_name(const char *username, const char *allowed, con
 }
 
 
+//
+// The link names allowed to one user, compiled from the CSV tuples of
+// _qd_policy_approve_link_name() with the user name substituted.
+//
+struct qd_policy_link_names_t {
+    bool    allow_all;     // a wildcard tuple was found
+    int     name_count;
+    int     prefix_count;
+    char  **names;         // names matched exactly, sorted for bsearch
+    char  **prefixes;      // names that ended in the wildcard, without it
+    size_t *prefix_lens;
+};
+
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+
+qd_policy_link_names_t *_qd_policy_compile_link_names(const char *username, const char *allowed)
+{
+    if (!allowed || !*allowed)
+        return 0;
+    if (!username)
+        username = "";
+
+    size_t username_len = strlen(username);
+    int    tuple_max    = 1;
+    for (const char *c = allowed; *c; ++c) {
+        if (*c == *QPALN_COMMA_SEP)
+            tuple_max++;
+    }
+    tuple_max = tuple_max / 3 + 1;
+
+    qd_policy_link_names_t *names = NEW(qd_policy_link_names_t);
+    ZERO(names);
+    names->names       = NEW_PTR_ARRAY(char, tuple_max);
+    names->prefixes    = NEW_PTR_ARRAY(char, tuple_max);
+    names->prefix_lens = NEW_ARRAY(size_t, tuple_max);
+
+    // make a writable, disposable copy of the csv string
+    char * dup = qd_strdup(allowed);
+    char * dupend = dup + strlen(dup);
+    char * pch = dup;
+
+    while (pch < dupend && names->name_count + names->prefix_count < tuple_max) {
+        // the tuple strings
+        char  *pChar, *pS1, *pS2;
+        size_t sChar,  sS1,  sS2;
+
+        // extract control field
+        sChar = strcspn(pch, QPALN_COMMA_SEP);
+        if (sChar != 1) { assert(false); break;}
+        pChar = pch;
+        pChar[sChar] = '\0';
+        pch += sChar + 1;
+        if (pch >= dupend) { assert(false); break; }
+
+        // extract prefix field S1
+        sS1 = strcspn(pch, QPALN_COMMA_SEP);
+        pS1 = pch;
+        pS1[sS1] = '\0';
+        pch += sS1 + 1;
+        if (pch > dupend) { assert(false); break; }
+
+        // extract suffix field S2
+        sS2 = strcspn(pch, QPALN_COMMA_SEP);
+        pS2 = pch;
+        pch += sS2 + 1;
+        pS2[sS2] = '\0';
+
+        if (*pChar == *user_subst_i_wildcard) {
+            names->allow_all = true;
+            break;
+        }
+
+        size_t sName = sS1 + username_len + sS2 + 1;
+        char  *pName = (char *) malloc(sName);
+        if (*pChar == *user_subst_i_absent)
+            snprintf(pName, sName, "%s", pS1);
+        else if (*pChar == *user_subst_i_prefix)
+            snprintf(pName, sName, "%s%s", username, pS2);
+        else if (*pChar == *user_subst_i_embed)
+            snprintf(pName, sName, "%s%s%s", pS1, username, pS2);
+        else if (*pChar == *user_subst_i_suffix)
+            snprintf(pName, sName, "%s%s", pS1, username);
+        else {
+            assert(false);
+            free(pName);
+            break;
+        }
+
+        size_t rule_len = strlen(pName);
+        if (rule_len > 0 && pName[rule_len - 1] == QPALN_WILDCARD) {
+            pName[rule_len - 1] = '\0';
+            names->prefix_lens[names->prefix_count] = rule_len - 1;
+            names->prefixes[names->prefix_count++]  = pName;
+        } else {
+            names->names[names->name_count++] = pName;
+        }
+    }
+    free(dup);
+
+    qsort(names->names, names->name_count, sizeof(char *), compare_names);
+    return names;
+}
+
+
+bool _qd_policy_approve_compiled_link_name(const qd_policy_link_names_t *names, const char *proposed)
+{
+    if (!*proposed) {
+        // degenerate case of blank proposed name being opened. will never match anything.
+        return false;
+    }
+    if (names->allow_all)
+        return true;
+    if (names->name_count && bsearch(&proposed, names->names, names->name_count, sizeof(char *), compare_names))
+        return true;
+    for (int i = 0; i < names->prefix_count; ++i) {
+        if (strncmp(proposed, names->prefixes[i], names->prefix_lens[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+
+void _qd_policy_link_names_free(qd_policy_link_names_t *names)
+{
+    if (!names)
+        return;
+    for (int i = 0; i < names->name_count; ++i)
+        free(names->names[i]);
+    for (int i = 0; i < names->prefix_count; ++i)
+        free(names->prefixes[i]);
+    free(names->names);
+    free(names->prefixes);
+    free(names->prefix_lens);
+    free(names);
+}
+
+
 bool _qd_policy_approve_link_name_tree(const char *username, const char *allowed, const char *proposed,
                                        qd_parse_tree_t *tree)
 {
@@ -1033,12 +1611,7 @@ bool qd_policy_approve_message_target(qd_iterator_t *address, qd_connection_t *q
 
     const char* target = qd_iterator_strncpy(address, buffer, length + 1);
 
-    bool lookup = false;
-    if (qd_conn->policy_settings->targetParseTree) {
-        lookup = _qd_policy_approve_link_name_tree(qd_conn->user_id, qd_conn->policy_settings->targetPattern, target, qd_conn->policy_settings->targetParseTree);
-    } else if (qd_conn->policy_settings->targets) {
-        lookup = _qd_policy_approve_link_name(qd_conn->user_id, qd_conn->policy_settings->targets, target);
-    }
+    bool lookup = qd_policy_approve_link_name(qd_conn->user_id, qd_conn->policy_settings, target, false);
 
     const char *hostip = qd_connection_remote_ip(qd_conn);
     const char *vhost = pn_connection_remote_hostname(qd_connection_pn(qd_conn));
@@ -1174,6 +1747,7 @@ void qd_policy_amqp_open(qd_connection_t *qd_conn) {
     qd_dispatch_t *qd = qd_server_dispatch(qd_conn->server);
     qd_policy_t *policy = qd->policy;
     bool connection_allowed = true;
+    const bool router_wide_rates = !qd_conn->role || !strcmp(qd_conn->role, "normal");
 
     const char *policy_vhost = 0;
     if (!!qd_conn->listener)
@@ -1189,6 +1763,7 @@ void qd_policy_amqp_open(qd_connection_t *qd_conn) {
 #define SETTINGS_NAME_SIZE 256
         char settings_name[SETTINGS_NAME_SIZE];
         uint32_t conn_id = qd_conn->connection_id;
+        uint64_t start_usec = now_usec();
         if (!qd_conn->policy_settings) {
             qd_conn->policy_settings = new_qd_policy_settings_t();
             ZERO(qd_conn->policy_settings);
@@ -1199,7 +1774,7 @@ void qd_policy_amqp_open(qd_connection_t *qd_conn) {
             settings_name[0]) {
             // This connection is allowed by policy.
             // Apply transport policy settings
-            if (qd_policy_open_fetch_settings(policy, vhost, settings_name, qd_conn->policy_settings)) {
+            if (qd_policy_open_fetch_settings(policy, vhost, settings_name, qd_conn->user_id, qd_conn->policy_settings)) {
                 if (qd_conn->policy_settings->spec.maxFrameSize > 0)
                     pn_transport_set_max_frame(pn_trans, qd_conn->policy_settings->spec.maxFrameSize);
                 if (qd_conn->policy_settings->spec.maxSessions > 0)
@@ -1220,6 +1795,8 @@ void qd_policy_amqp_open(qd_connection_t *qd_conn) {
                 } else {
                     // not multi-tenant: don't look for vhost
                 }
+                qd_conn->rate_limits =
+                    qd_policy_rate_limits(policy, qd_conn->policy_settings, settings_name, router_wide_rates, true);
             } else {
                 // failed to fetch settings
                 connection_allowed = false;
@@ -1228,9 +1805,11 @@ void qd_policy_amqp_open(qd_connection_t *qd_conn) {
             // This connection is denied by policy.
             connection_allowed = false;
         }
+        qd_metric_observe(policy->settings_cache.open_latency, now_usec() - start_usec);
     } else {
         // No policy implies automatic policy allow
         // Note that connections not governed by policy have no policy_settings.
+        qd_conn->rate_limits = qd_policy_rate_limits(policy, 0, 0, router_wide_rates, true);
     }
     if (connection_allowed) {
         if (pn_connection_state(conn) & PN_LOCAL_UNINIT)
@@ -1261,9 +1840,12 @@ void qd_policy_amqp_open_connector(qd_connection_t *qd_conn) {
             if (qd_conn->policy_settings) {
                 ZERO(qd_conn->policy_settings);
 
-                if (qd_policy_open_fetch_settings(policy, policy_vhost, POLICY_VHOST_GROUP, qd_conn->policy_settings)) {
+                if (qd_policy_open_fetch_settings(policy, policy_vhost, POLICY_VHOST_GROUP, qd_conn->user_id,
+                                                  qd_conn->policy_settings)) {
                     qd_conn->policy_settings->spec.outgoingConnection = true;
                     qd_conn->policy_counted = true; // Count senders and receivers for this connection
+                    qd_conn->rate_limits =
+                        qd_policy_rate_limits(policy, qd_conn->policy_settings, POLICY_VHOST_GROUP, false, true);
                 } else {
                     qd_log(LOG_POLICY, QD_LOG_ERROR,
                            "[C%" PRIu64 "] Failed to find policyVhost settings for connection '%d', policyVhost: '%s'",
@@ -1297,28 +1879,139 @@ void qd_policy_settings_free(qd_policy_settings_t *settings)
     if (settings->targetPattern)   free(settings->targetPattern);
     if (settings->sourceParseTree) qd_parse_tree_free(settings->sourceParseTree);
     if (settings->targetParseTree) qd_parse_tree_free(settings->targetParseTree);
+    _qd_policy_link_names_free(settings->sourceNames);
+    _qd_policy_link_names_free(settings->targetNames);
     if (settings->vhost_name)      free(settings->vhost_name);
+    free(settings->vhost_policy);
     free_qd_policy_settings_t(settings);
 }
 
 
+qd_policy_rate_limits_t *qd_policy_rate_limits(qd_policy_t *policy, const qd_policy_settings_t *settings,
+                                               const char *group_name, bool router_wide, bool count_messages)
+{
+    const qd_policy_spec_t *spec = settings ? &settings->spec : 0;
+    const bool vhost_limited = spec && settings->vhost_policy
+        && (spec->maxBytesPerSecond || spec->maxMessagesPerSecond
+            || spec->maxConnectionBytesPerSecond || spec->maxConnectionMessagesPerSecond
+            || spec->vhostMaxBytesPerSecond || spec->vhostMaxMessagesPerSecond);
+    router_wide = router_wide && !!policy->router_rate;
+    if (!vhost_limited && !router_wide)
+        return 0;
+
+    const uint64_t now_ns = now_nsec();
+    qd_policy_rate_limits_t *limits = NEW(qd_policy_rate_limits_t);
+    ZERO(limits);
+    limits->count_messages = count_messages;
+    if (router_wide) {
+        sys_mutex_lock(&policy->rate_lock);
+        limits->router = policy->router_rate;
+        limits->router->ref_count++;
+        sys_mutex_unlock(&policy->rate_lock);
+    }
+    if (vhost_limited) {
+        if (spec->vhostMaxBytesPerSecond || spec->vhostMaxMessagesPerSecond)
+            limits->vhost = rate_acquire(policy, settings->vhost_policy, 0, spec->vhostMaxBytesPerSecond,
+                                         spec->vhostMaxMessagesPerSecond, now_ns);
+        limits->group = rate_acquire(policy, settings->vhost_policy, group_name, spec->maxBytesPerSecond,
+                                     spec->maxMessagesPerSecond, now_ns);
+    }
+    _qd_policy_token_bucket_init(&limits->octets, spec ? spec->maxConnectionBytesPerSecond : 0, now_ns);
+    _qd_policy_token_bucket_init(&limits->messages, spec ? spec->maxConnectionMessagesPerSecond : 0, now_ns);
+    return limits;
+}
+
+
+static void rate_limits_throttled_by(qd_policy_rate_limits_t *limits, qd_policy_rate_t *rate)
+{
+    if (rate == limits->throttled_by)
+        return;
+    if (limits->throttled_by)
+        qd_metric_dec(limits->throttled_by->throttled_connections, 1);
+    if (rate) {
+        qd_metric_inc(rate->throttled_connections, 1);
+        qd_metric_inc(rate->throttled_total, 1);
+    }
+    limits->throttled_by = rate;
+}
+
+
+void qd_policy_rate_limits_free(qd_policy_rate_limits_t *limits)
+{
+    if (!limits)
+        return;
+    rate_limits_throttled_by(limits, 0);
+    rate_release(limits->router);
+    rate_release(limits->vhost);
+    rate_release(limits->group);
+    _qd_policy_token_bucket_final(&limits->octets);
+    _qd_policy_token_bucket_final(&limits->messages);
+    free(limits);
+}
+
+
+/** Charge a connection's octets and messages to one set of rates, return the delay they impose
+ **/
+static uint64_t rate_charge(qd_policy_rate_limits_t *limits, qd_policy_token_bucket_t *octets,
+                            qd_policy_token_bucket_t *messages, uint64_t octet_count, uint64_t message_count,
+                            uint64_t now_ns)
+{
+    uint64_t delay_ns = _qd_policy_token_bucket_take(octets, octet_count, now_ns);
+    if (limits->count_messages)
+        delay_ns = MAX(delay_ns, _qd_policy_token_bucket_take(messages, message_count, now_ns));
+    return delay_ns;
+}
+
+
+uint64_t qd_policy_rate_charge(qd_policy_rate_limits_t *limits, uint64_t octets, uint64_t messages)
+{
+    const uint64_t now_ns = now_nsec();
+    qd_policy_rate_t *shared[] = {limits->router, limits->vhost, limits->group};
+    qd_policy_rate_t *throttled_by = 0;
+    uint64_t          delay_ns     = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        if (shared[i]) {
+            uint64_t rate_delay_ns = rate_charge(limits, &shared[i]->octets, &shared[i]->messages, octets, messages, now_ns);
+            if (rate_delay_ns > delay_ns) {
+                delay_ns     = rate_delay_ns;
+                throttled_by = shared[i];
+            }
+        }
+    }
+
+    // The connection's own limits are set by its user group, which reports them
+    uint64_t own_delay_ns = rate_charge(limits, &limits->octets, &limits->messages, octets, messages, now_ns);
+    if (own_delay_ns > delay_ns) {
+        delay_ns     = own_delay_ns;
+        throttled_by = limits->group;
+    }
+
+    rate_limits_throttled_by(limits, throttled_by);
+    return delay_ns;
+}
+
+
 bool qd_policy_approve_link_name(const char *username,
                                  const qd_policy_settings_t *settings,
                                  const char *proposed,
                                  bool isReceiver)
 {
-    if (isReceiver) {
-        if (settings->sourceParseTree) {
-            return _qd_policy_approve_link_name_tree(username, settings->sourcePattern, proposed, settings->sourceParseTree);
-        } else if (settings->sources) {
-            return _qd_policy_approve_link_name(username, settings->sources, proposed);
-        }
-    } else {
-        if (settings->targetParseTree) {
-            return _qd_policy_approve_link_name_tree(username, settings->targetPattern, proposed, settings->targetParseTree);
-        } else if (settings->targets) {
-            return _qd_policy_approve_link_name(username, settings->targets, proposed);
+    qd_parse_tree_t              *tree    = isReceiver ? settings->sourceParseTree : settings->targetParseTree;
+    const qd_policy_link_names_t *names   = isReceiver ? settings->sourceNames : settings->targetNames;
+    const char                   *allowed = isReceiver ? settings->sources : settings->targets;
+
+    if (tree) {
+        if (settings->parseTreesUserBound) {
+            void *unused_payload = 0;
+            return *proposed && qd_parse_tree_retrieve_match_str(tree, proposed, &unused_payload);
         }
+        return _qd_policy_approve_link_name_tree(username, isReceiver ? settings->sourcePattern : settings->targetPattern,
+                                                 proposed, tree);
+    } else if (names) {
+        return _qd_policy_approve_compiled_link_name(names, proposed);
+    } else if (allowed) {
+        return _qd_policy_approve_link_name(username, allowed, proposed);
     }
     return false;
 }
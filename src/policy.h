@@ -45,6 +45,8 @@ struct qd_policy_denial_counts_s {
 };
 
 typedef struct qd_policy_t qd_policy_t;
+typedef struct qd_policy_link_names_t qd_policy_link_names_t;
+typedef struct qd_policy_rate_limits_t qd_policy_rate_limits_t;
 
 //
 // Policy settings are defined in include/qpid/dispatch/policy_settings.h
@@ -58,8 +60,12 @@ struct qd_policy_settings_t {
     char *targetPattern;
     qd_parse_tree_t *sourceParseTree;
     qd_parse_tree_t *targetParseTree;
+    bool parseTreesUserBound;  // the parse trees hold the user name of the connection in place of ${user}
+    qd_policy_link_names_t *sourceNames;  // sources compiled for the user of the connection
+    qd_policy_link_names_t *targetNames;
     qd_policy_denial_counts_t *denialCounts;
     char *vhost_name;
+    char *vhost_policy;  // name of the vhost policy the settings come from
 };
 
 typedef struct qd_policy_settings_t qd_policy_settings_t;
@@ -188,6 +194,13 @@ void qd_policy_amqp_open(qd_connection_t *conn);
 void qd_policy_amqp_open_connector(qd_connection_t *conn);
 
 
+/** Discard the settings cached by qd_policy_open_fetch_settings.
+ * Called whenever the python vhost database changes.
+ * @param[in] policy pointer to the policy
+ **/
+void qd_policy_settings_cache_flush(qd_policy_t *policy);
+
+
 /** Dispose of policy settings
  * 
  * @param settings the settings to be destroyed
@@ -195,6 +208,8 @@ void qd_policy_amqp_open_connector(qd_connection_t *conn);
 void qd_policy_settings_free(qd_policy_settings_t *settings);
 
 /** Approve link by source/target name.
+ * The link name rules of settings are compiled for the user of the connection
+ * when the settings are fetched, so username must be that user.
  * @param[in] username authenticated user name
  * @param[in] settings policy settings
  * @param[in] proposed the link target name to be approved
@@ -258,6 +273,34 @@ bool qd_policy_approve_message_target(qd_iterator_t *address, qd_connection_t *q
  **/
 void qd_policy_count_max_size_event(pn_link_t *link, qd_connection_t *qd_conn);
 
+/**
+ * Set up the rate limits of a connection: those of its vhost and user group settings and, if router_wide, the
+ * policy maxBytesPerSecond and maxMessagesPerSecond. The vhost and user group limits are shared with the other
+ * connections using them.
+ *
+ * @param[in] policy the policy
+ * @param[in] settings policy settings of the connection, or 0 if it is not governed by a vhost policy
+ * @param[in] group_name the user group of settings
+ * @param[in] router_wide apply the router-wide limits
+ * @param[in] count_messages charge messages as well as octets, false for connections that carry byte streams
+ * @return the limits to be freed by qd_policy_rate_limits_free(), or 0 if the connection has none
+ **/
+qd_policy_rate_limits_t *qd_policy_rate_limits(qd_policy_t *policy, const qd_policy_settings_t *settings,
+                                               const char *group_name, bool router_wide, bool count_messages);
+
+void qd_policy_rate_limits_free(qd_policy_rate_limits_t *limits);
+
+/**
+ * Charge the octets and messages received from a connection against its rate limits. Passing zero for both returns
+ * the current state of the limits. Must be called by the thread owning the connection.
+ *
+ * @param[in] limits rate limits of the connection
+ * @param[in] octets octets received
+ * @param[in] messages messages received
+ * @return zero if the connection may be given more credit, else the nanoseconds until it may be
+ **/
+uint64_t qd_policy_rate_charge(qd_policy_rate_limits_t *limits, uint64_t octets, uint64_t messages);
+
 /**
  * Return POLICY log_source to log policy 
  */
@@ -21,6 +21,20 @@
 
 #include "policy.h"
 
+#include "qpid/dispatch/threading.h"
+
+/**
+ * Token bucket of a rate limit. The bucket holds at most one second worth of tokens and is refilled continuously
+ * at 'rate' tokens per second. Taking tokens may drive it into deficit: the taker learns how long the bucket needs
+ * to refill to zero and is expected to hold its peer back for that long.
+ */
+typedef struct qd_policy_token_bucket_t {
+    sys_spinlock_t lock;
+    uint64_t       rate;     // tokens per second, 0 if unlimited
+    double         tokens;   // negative while in deficit
+    uint64_t       last_ns;  // time of the last refill
+} qd_policy_token_bucket_t;
+
 /**
  * Private Function Prototypes
  */
@@ -94,4 +108,52 @@ bool _qd_policy_approve_link_name(const char *username, const char *allowed, con
  * @param[in] tree the parse tree for this source/target names
  */
 bool _qd_policy_approve_link_name_tree(const char *username, const char *allowed, const char *proposed, qd_parse_tree_t *tree);
+
+
+/** Compile policy settings source/target names for one user.
+ * The username is substituted into every rule once so that each approval is a
+ * lookup instead of a parse of the allowed string.
+ * @param[in] username authenticated user name
+ * @param[in] allowed policy settings source/target string in packed CSV form.
+ * @return the compiled names, or null if allowed is blank
+ */
+qd_policy_link_names_t *_qd_policy_compile_link_names(const char *username, const char *allowed);
+
+
+/** Approve link by source/target name against compiled names.
+ * Same result as _qd_policy_approve_link_name() with the username and allowed
+ * string the names were compiled from.
+ * @param[in] names compiled by _qd_policy_compile_link_names()
+ * @param[in] proposed the link source/target name to be approved
+ */
+bool _qd_policy_approve_compiled_link_name(const qd_policy_link_names_t *names, const char *proposed);
+
+void _qd_policy_link_names_free(qd_policy_link_names_t *names);
+
+
+/** Build the parse tree of a source/target pattern spec with username in place of ${user}.
+ * A proposed name is approved if it matches the tree, with no further substitution.
+ * @param[in] config_spec policy settings sourcePattern/targetPattern in packed CSV form.
+ * @param[in] username authenticated user name, with no wildcard characters
+ */
+qd_parse_tree_t *_qd_policy_user_parse_tree(const char *config_spec, const char *username);
+
+
+/** Initialize a full token bucket.
+ * @param[in] rate tokens per second, 0 for a bucket that never limits
+ * @param[in] now_ns current time in nanoseconds
+ */
+void _qd_policy_token_bucket_init(qd_policy_token_bucket_t *bucket, uint64_t rate, uint64_t now_ns);
+void _qd_policy_token_bucket_final(qd_policy_token_bucket_t *bucket);
+
+/** Change the rate of a bucket, keeping the tokens it holds up to the new burst size.
+ */
+void _qd_policy_token_bucket_set_rate(qd_policy_token_bucket_t *bucket, uint64_t rate, uint64_t now_ns);
+
+/** Take tokens from a bucket.
+ * @param[in] tokens tokens to take, may be zero to check the bucket
+ * @param[in] now_ns current time in nanoseconds
+ * @return zero if the bucket is not in deficit, else the nanoseconds until it is refilled to zero
+ */
+uint64_t _qd_policy_token_bucket_take(qd_policy_token_bucket_t *bucket, uint64_t tokens, uint64_t now_ns);
 #endif
@@ -33,12 +33,136 @@
 #include "qpid/dispatch/internal/thread_annotations.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct sys_lock_class_t {
+    const char           *name;
+    atomic_uint_fast64_t  acquisitions;
+    atomic_uint_fast64_t  contended;
+    atomic_uint_fast64_t  wait_total_ns;
+    atomic_uint_fast64_t  wait_max_ns;
+    atomic_uint_fast64_t  histogram[SYS_LOCK_HISTOGRAM_BUCKETS];
+};
+
+// Classes are only added, never removed, so a class pointer held by a mutex stays valid for the life of the process.
+// The registry lock is a plain pthread mutex since it is taken while initializing a sys_mutex_t.
+//
+static sys_lock_class_t lock_classes[SYS_LOCK_CLASS_MAX];
+static atomic_int       lock_class_count;
+static pthread_mutex_t  lock_class_registry = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool      lock_profiling;
+
+
+static sys_lock_class_t *lock_class(const char *name)
+{
+    sys_lock_class_t *cls = 0;
+
+    pthread_mutex_lock(&lock_class_registry);
+    int count = atomic_load(&lock_class_count);
+    for (int i = 0; i < count && !cls; ++i) {
+        if (strcmp(lock_classes[i].name, name) == 0)
+            cls = &lock_classes[i];
+    }
+    if (!cls && count < SYS_LOCK_CLASS_MAX) {
+        cls       = &lock_classes[count];
+        cls->name = name;
+        atomic_store(&lock_class_count, count + 1);
+    }
+    pthread_mutex_unlock(&lock_class_registry);
+    return cls;  // NULL once the table is full: the mutex is not profiled
+}
+
 
 void sys_mutex_init(sys_mutex_t *mutex)
 {
     int result = pthread_mutex_init(&(mutex->mutex), 0);
     (void) result; assert(result == 0);
+    mutex->lock_class = 0;
+}
+
+
+void sys_mutex_init_class(sys_mutex_t *mutex, sys_lock_class_t **class_ref, const char *class_name)
+{
+    sys_mutex_init(mutex);
+    sys_lock_class_t *cls = __atomic_load_n(class_ref, __ATOMIC_ACQUIRE);
+    if (!cls) {
+        cls = lock_class(class_name);
+        __atomic_store_n(class_ref, cls, __ATOMIC_RELEASE);
+    }
+    mutex->lock_class = cls;
+}
+
+
+void sys_lock_profiling_enable(void)
+{
+    atomic_store(&lock_profiling, true);
+}
+
+
+void sys_lock_profiling_disable(void)
+{
+    atomic_store(&lock_profiling, false);
+}
+
+
+bool sys_lock_profiling_enabled(void)
+{
+    return atomic_load_explicit(&lock_profiling, memory_order_relaxed);
+}
+
+
+int sys_lock_stats(sys_lock_stats_t *stats, int max)
+{
+    int count = MIN(atomic_load(&lock_class_count), max);
+    for (int i = 0; i < count; ++i) {
+        sys_lock_class_t *cls = &lock_classes[i];
+        stats[i].name          = cls->name;
+        stats[i].acquisitions  = atomic_load_explicit(&cls->acquisitions, memory_order_relaxed);
+        stats[i].contended     = atomic_load_explicit(&cls->contended, memory_order_relaxed);
+        stats[i].wait_total_ns = atomic_load_explicit(&cls->wait_total_ns, memory_order_relaxed);
+        stats[i].wait_max_ns   = atomic_load_explicit(&cls->wait_max_ns, memory_order_relaxed);
+        for (int b = 0; b < SYS_LOCK_HISTOGRAM_BUCKETS; ++b)
+            stats[i].histogram[b] = atomic_load_explicit(&cls->histogram[b], memory_order_relaxed);
+    }
+    return count;
+}
+
+
+static inline uint64_t lock_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void sys_mutex_lock_profiled(sys_mutex_t *mutex, sys_lock_class_t *cls) TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    atomic_fetch_add_explicit(&cls->acquisitions, 1, memory_order_relaxed);
+    if (pthread_mutex_trylock(&(mutex->mutex)) == 0)
+        return;
+
+    uint64_t start  = lock_now_ns();
+    int      result = pthread_mutex_lock(&(mutex->mutex));
+    (void) result; assert(result == 0);
+    uint64_t wait = lock_now_ns() - start;
+
+    uint64_t usec   = wait / 1000;
+    int      bucket = usec ? 64 - __builtin_clzll(usec) : 0;  // smallest N with usec < 2^N
+    atomic_fetch_add_explicit(&cls->histogram[MIN(bucket, SYS_LOCK_HISTOGRAM_BUCKETS - 1)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cls->contended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cls->wait_total_ns, wait, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&cls->wait_max_ns, memory_order_relaxed);
+    while (wait > max
+           && !atomic_compare_exchange_weak_explicit(&cls->wait_max_ns, &max, wait, memory_order_relaxed,
+                                                     memory_order_relaxed))
+        ;
 }
 
 
@@ -51,6 +175,11 @@ void sys_mutex_free(sys_mutex_t *mutex)
 
 void sys_mutex_lock(sys_mutex_t *mutex) TA_ACQ(*mutex) TA_NO_THREAD_SAFETY_ANALYSIS
 {
+    if (mutex->lock_class && atomic_load_explicit(&lock_profiling, memory_order_relaxed)) {
+        sys_mutex_lock_profiled(mutex, mutex->lock_class);
+        return;
+    }
+
     int result = pthread_mutex_lock(&(mutex->mutex));
     (void) result; assert(result == 0);
 }
@@ -140,11 +269,123 @@ static const char thread_names[SYS_THREAD_ROLE_COUNT][SYS_THREAD_NAME_MAX + 1] =
     "core_thread",   // SYS_THREAD_CORE
     "wrkr_",         // SYS_THREAD_PROACTOR (multiple)
     "vflow_thread",  // SYS_THREAD_VFLOW
-    "lws_thread"     // SYS_THREAD_LWS_HTTP
+    "lws_thread",    // SYS_THREAD_LWS_HTTP
+    "log_thread",    // SYS_THREAD_LOG
+    "observer_thrd", // SYS_THREAD_OBSERVER (multiple)
+    "dns_thread"     // SYS_THREAD_RESOLVER
 };
 
 static sys_atomic_t proactor_thread_count = 0;
 
+// CPUs the threads of each role are bound to at creation, see sys_thread_set_role_cpus()
+static cpu_set_t role_cpus[SYS_THREAD_ROLE_COUNT];
+static bool      role_bound[SYS_THREAD_ROLE_COUNT];
+
+// parse a Linux cpulist ("0-3,8,10-11") into cpus, returns false if malformed or empty
+static bool parse_cpu_list(const char *cpu_list, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    const char *ptr = cpu_list;
+    while (*ptr) {
+        char *end;
+        long  first = strtol(ptr, &end, 10);
+        long  last  = first;
+        if (end == ptr || first < 0)
+            return false;
+        if (*end == '-') {
+            ptr  = end + 1;
+            last = strtol(ptr, &end, 10);
+            if (end == ptr || last < first)
+                return false;
+        }
+        if (last >= CPU_SETSIZE)
+            return false;
+        for (long cpu = first; cpu <= last; ++cpu)
+            CPU_SET(cpu, cpus);
+        while (isspace((unsigned char) *end))
+            end++;
+        if (*end == ',')
+            end++;
+        else if (*end)
+            return false;
+        ptr = end;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+int sys_thread_set_role_cpus(sys_thread_role_t role, const char *cpu_list)
+{
+    assert(role < SYS_THREAD_ROLE_COUNT);
+
+    if (!cpu_list || !*cpu_list) {
+        role_bound[role] = false;
+        return 0;
+    }
+    cpu_set_t cpus;
+    cpu_set_t allowed;
+    if (!parse_cpu_list(cpu_list, &cpus))
+        return -1;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        CPU_AND(&cpus, &cpus, &allowed);
+    if (CPU_COUNT(&cpus) == 0)
+        return -1;
+    role_cpus[role]  = cpus;
+    role_bound[role] = true;
+    return 0;
+}
+
+int sys_thread_isolate_role(sys_thread_role_t role)
+{
+    assert(role < SYS_THREAD_ROLE_COUNT);
+
+    // others = the allowed CPUs minus the role's CPUs (which are a subset of the allowed set)
+    cpu_set_t others;
+    if (!role_bound[role] || sched_getaffinity(0, sizeof(others), &others) != 0)
+        return -1;
+    CPU_XOR(&others, &others, &role_cpus[role]);
+    if (CPU_COUNT(&others) == 0)
+        return -1;
+
+    cpu_set_t cpus[SYS_THREAD_ROLE_COUNT];
+    for (int other = 0; other < SYS_THREAD_ROLE_COUNT; ++other) {
+        if (other == role)
+            continue;
+        if (role_bound[other]) {
+            CPU_AND(&cpus[other], &role_cpus[other], &others);
+            if (CPU_COUNT(&cpus[other]) == 0)
+                return -1;
+        } else {
+            cpus[other] = others;
+        }
+    }
+
+    for (int other = 0; other < SYS_THREAD_ROLE_COUNT; ++other) {
+        if (other != role) {
+            role_cpus[other]  = cpus[other];
+            role_bound[other] = true;
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &role_cpus[sys_thread_role(0)]);
+    return 0;
+}
+
+int sys_thread_set_role_node(sys_thread_role_t role, int node)
+{
+    char path[64];
+    char cpu_list[256] = {0};
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    char *ok = fgets(cpu_list, sizeof(cpu_list), fp);
+    fclose(fp);
+    if (!ok)
+        return -1;
+    cpu_list[strcspn(cpu_list, "\n")] = 0;
+    return sys_thread_set_role_cpus(role, cpu_list);
+}
+
 void sys_spinlock_init(sys_spinlock_t *lock)
 {
     int result;
@@ -226,9 +467,14 @@ sys_thread_t *sys_thread(sys_thread_role_t role, void *(*run_function)(void *),
     } else {
         strcpy(thread->name, thread_names[role]);
     }
-    int rc = pthread_create(&(thread->thread), 0, _thread_init, (void *) thread);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (role_bound[role])
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &role_cpus[role]);
+    int rc = pthread_create(&(thread->thread), &attr, _thread_init, (void *) thread);
     (void) rc;
     assert(rc == 0);
+    pthread_attr_destroy(&attr);
     pthread_setname_np(thread->thread, thread->name);
 
     return thread;
@@ -381,13 +627,16 @@ char *test_threading_roles_names(void *context)
 
     // check non-proactor thread roles and names
 
-    sys_thread_role_t roles[3] = {
+    sys_thread_role_t roles[6] = {
         SYS_THREAD_CORE,
         SYS_THREAD_VFLOW,
         SYS_THREAD_LWS_HTTP,
+        SYS_THREAD_LOG,
+        SYS_THREAD_OBSERVER,
+        SYS_THREAD_RESOLVER,
     };
 
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < 6; i++) {
         sys_mutex_lock(&lock);
 
         sys_thread_t *t = sys_thread(roles[i], test_thread, &lock);
@@ -411,3 +660,66 @@ char *test_threading_roles_names(void *context)
 
     return 0;
 }
+
+static void *test_affinity_thread(void *arg)
+{
+    cpu_set_t *cpus = (cpu_set_t *) arg;
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), cpus);
+    return 0;
+}
+
+// DEBUG/TEST only (see test/thread_test.c)
+char *test_threading_role_cpus(void *context)
+{
+    if (sys_thread_set_role_cpus(SYS_THREAD_VFLOW, "1-") == 0 || sys_thread_set_role_cpus(SYS_THREAD_VFLOW, "3-1") == 0
+        || sys_thread_set_role_cpus(SYS_THREAD_VFLOW, "x") == 0)
+        return "FAILED: malformed cpulist accepted";
+
+    // bind to the first CPU this process may run on
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu = 0;
+    while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed))
+        cpu++;
+    char cpu_list[16];
+    snprintf(cpu_list, sizeof(cpu_list), "%d", cpu);
+
+    if (sys_thread_set_role_cpus(SYS_THREAD_VFLOW, cpu_list) != 0)
+        return "FAILED: valid cpulist rejected";
+
+    cpu_set_t     cpus;
+    sys_thread_t *t = sys_thread(SYS_THREAD_VFLOW, test_affinity_thread, &cpus);
+    sys_thread_join(t);
+    sys_thread_free(t);
+    sys_thread_set_role_cpus(SYS_THREAD_VFLOW, 0);
+
+    if (CPU_COUNT(&cpus) != 1 || !CPU_ISSET(cpu, &cpus))
+        return "FAILED: thread not bound to the role CPUs";
+
+    // isolation needs a CPU left over for the other roles
+    if (CPU_COUNT(&allowed) > 1) {
+        sys_thread_set_role_cpus(SYS_THREAD_CORE, cpu_list);
+        const int rc = sys_thread_isolate_role(SYS_THREAD_CORE);
+
+        t = sys_thread(SYS_THREAD_VFLOW, test_affinity_thread, &cpus);
+        sys_thread_join(t);
+        sys_thread_free(t);
+
+        for (int role = 0; role < SYS_THREAD_ROLE_COUNT; ++role)
+            sys_thread_set_role_cpus(role, 0);
+        pthread_setaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+
+        if (rc != 0)
+            return "FAILED: role isolation rejected";
+        if (CPU_ISSET(cpu, &cpus) || CPU_COUNT(&cpus) != CPU_COUNT(&allowed) - 1)
+            return "FAILED: isolated CPU not removed from the other roles";
+    } else {
+        sys_thread_set_role_cpus(SYS_THREAD_CORE, cpu_list);
+        const int rc = sys_thread_isolate_role(SYS_THREAD_CORE);
+        sys_thread_set_role_cpus(SYS_THREAD_CORE, 0);
+        if (rc == 0)
+            return "FAILED: isolating the only CPU must be rejected";
+    }
+
+    return 0;
+}
@@ -26,11 +26,13 @@
 #include "qpid/dispatch/amqp.h"
 #include "qpid/dispatch/error.h"
 #include "qpid/dispatch/log.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/router.h"
 
 #include <proton/disposition.h>
 
 #include <ctype.h>
+#include <time.h>
 
 
 #define DISPATCH_MODULE "skupper_router_internal.dispatch"
@@ -44,6 +46,13 @@ static PyObject        *dispatch_module = 0;
 static PyObject        *message_type = 0;
 static PyObject        *dispatch_python_pkgdir = 0;
 
+// Time taken to acquire the GIL and time it is held, per outermost qd_python_lock()/qd_python_unlock() pair. The hold
+// time includes any interval in which the interpreter itself switches to another thread.
+static qd_metric_t     *gil_wait_metric = 0;
+static qd_metric_t     *gil_hold_metric = 0;
+static __thread int      gil_depth;        // nesting of qd_python_lock() in this thread
+static __thread uint64_t gil_acquired_ns;  // when this thread took the GIL
+
 static void qd_python_setup(void);
 
 
@@ -59,6 +68,17 @@ void qd_python_initialize(qd_dispatch_t *qd, const char *python_pkgdir)
         dispatch_python_pkgdir = PyUnicode_FromString(python_pkgdir);
     qd_python_setup();
     PyEval_SaveThread(); // drop the Python GIL; we will reacquire it in other threads as needed
+
+    gil_wait_metric = qd_metric(QD_METRIC_HISTOGRAM, "qdr_python_gil_wait_microseconds", 0, 0);
+    gil_hold_metric = qd_metric(QD_METRIC_HISTOGRAM, "qdr_python_gil_hold_microseconds", 0, 0);
+}
+
+void qd_python_free_metrics(void)
+{
+    qd_metric_free(gil_wait_metric);
+    qd_metric_free(gil_hold_metric);
+    gil_wait_metric = 0;
+    gil_hold_metric = 0;
 }
 
 void qd_python_finalize(void)
@@ -685,8 +705,8 @@ static int IoAdapter_init(IoAdapter *self, PyObject *args, PyObject *kwds)
         PyErr_SetString(PyExc_TypeError, "IoAdapter.__init__ handler is not callable");
         return -1;
     }
-    if (treatment == QD_TREATMENT_ANYCAST_BALANCED) {
-        PyErr_SetString(PyExc_TypeError, "IoAdapter: ANYCAST_BALANCED is not supported for in-process subscriptions");
+    if (treatment == QD_TREATMENT_ANYCAST_BALANCED || treatment == QD_TREATMENT_ANYCAST_AFFINITY) {
+        PyErr_SetString(PyExc_TypeError, "IoAdapter: ANYCAST_BALANCED and ANYCAST_AFFINITY are not supported for in-process subscriptions");
         return -1;
     }
     Py_INCREF(self->handler);
@@ -884,13 +904,32 @@ static void qd_python_setup(void)
     }
 }
 
+static inline uint64_t gil_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 qd_python_lock_state_t qd_python_lock(void)
 {
-    return PyGILState_Ensure();
+    if (gil_depth++ > 0 || !gil_hold_metric)
+        return PyGILState_Ensure();
+
+    uint64_t               start_ns = gil_now_ns();
+    qd_python_lock_state_t state    = PyGILState_Ensure();
+    gil_acquired_ns = gil_now_ns();
+    qd_metric_observe(gil_wait_metric, (gil_acquired_ns - start_ns) / 1000);
+    return state;
 }
 
 void qd_python_unlock(qd_python_lock_state_t lock_state)
 {
+    if (--gil_depth == 0 && gil_acquired_ns) {
+        if (gil_hold_metric)
+            qd_metric_observe(gil_hold_metric, (gil_now_ns() - gil_acquired_ns) / 1000);
+        gil_acquired_ns = 0;
+    }
     PyGILState_Release(lock_state);
 }
 
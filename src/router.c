@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "message_private.h"
 #include "router_private.h"
 
 const char *QD_ROUTER_NODE_TYPE = "router.node";
@@ -125,6 +126,7 @@ void qd_router_free(qd_router_t *router)
 
     qd_router_python_free(router);
     qdr_core_free(router->router_core);
+    qd_message_set_trace_resolver(0);
     qd_tracemask_free(router->tracemask);
     qd_timer_free(router->timer);
     sys_mutex_free(&router->lock);
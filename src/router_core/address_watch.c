@@ -23,11 +23,14 @@
 struct qdr_address_watch_t {
     DEQ_LINKS(struct qdr_address_watch_t);
     DEQ_LINKS_N(PER_ADDRESS, struct qdr_address_watch_t);
+    DEQ_LINKS_N(DIRTY, struct qdr_address_watch_t);
     qdr_watch_handle_t          watch_handle;
     qdr_address_t              *addr;
     qdr_address_watch_update_t  on_update;
     qdr_address_watch_cancel_t  on_cancel;
     void                       *context;
+    bool                        dirty;  // On core->addr_watches_dirty awaiting delivery
+    qdr_watch_update_t          update; // Latest snapshot of the address
 };
 
 ALLOC_DECLARE(qdr_address_watch_t);
@@ -38,6 +41,9 @@ static void qdr_watch_cancel_invoker(qdr_core_t *core, qdr_general_work_t *work,
 static void qdr_core_watch_address_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
 static void qdr_core_unwatch_address_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
 static void qdr_address_watch_free_CT(qdr_core_t *core, qdr_address_watch_t *watch);
+static void qdr_address_watch_flush_CT(qdr_core_t *core);
+static void qdr_address_watch_flush_action_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
+static void qdr_address_watch_timer_CT(qdr_core_t *core, void *context);
 
 //==================================================================================
 // Core Interface Functions
@@ -82,23 +88,53 @@ void qdr_core_unwatch_address(qdr_core_t *core, qdr_watch_handle_t handle)
 //==================================================================================
 void qdr_trigger_address_watch_CT(qdr_core_t *core, qdr_address_t *addr)
 {
-    qdr_address_watch_t *watch = DEQ_HEAD(addr->watches);
+    //
+    // The watches are triggered on every change to the destinations of an address.  Let the
+    // producers back off at the source if the last destination has gone.
+    //
+    qdr_addr_stop_inlinks_CT(core, addr);
+
+    qdr_address_watch_t *watch = addr->ext ? DEQ_HEAD(addr->ext->watches) : 0;
+
+    if (!watch)
+        return;
 
     while (!!watch) {
-        qdr_general_work_t *work = qdr_general_work(qdr_watch_invoker);
-        work->watch_update_handler = watch->on_update;
-        work->context              = watch->context;
-        work->local_consumers      = DEQ_SIZE(addr->rlinks);
-        work->in_proc_consumers    = DEQ_SIZE(addr->subscriptions);
-        work->remote_consumers     = qd_bitmask_cardinality(addr->rnodes);
-        work->local_producers      = DEQ_SIZE(addr->inlinks);
-        qdr_post_general_work_CT(core, work);
+        watch->update.local_consumers   = DEQ_SIZE(addr->rlinks);
+        watch->update.in_proc_consumers = DEQ_SIZE(addr->subscriptions);
+        watch->update.remote_consumers  = qd_bitmask_cardinality(addr->rnodes);
+        watch->update.local_producers   = DEQ_SIZE(addr->inlinks);
+        if (!watch->dirty) {
+            watch->dirty = true;
+            DEQ_INSERT_TAIL_N(DIRTY, core->addr_watches_dirty, watch);
+        }
         watch = DEQ_NEXT_N(PER_ADDRESS, watch);
     }
+
+    if (core->addr_watch_flush_scheduled)
+        return;
+    core->addr_watch_flush_scheduled = true;
+
+    //
+    // Deliver after the actions already queued have run so that a burst of changes is
+    // coalesced, and no sooner than the configured interval after the last delivery.
+    //
+    uint32_t interval = core->qd ? core->qd->addr_watch_interval : 0;
+    uint32_t elapsed  = qdr_core_uptime_ticks(core) - core->addr_watch_last_flush;
+    if (interval > 0 && elapsed < interval) {
+        if (!core->addr_watch_timer)
+            core->addr_watch_timer = qdr_core_timer_CT(core, qdr_address_watch_timer_CT, 0);
+        qdr_core_timer_schedule_CT(core, core->addr_watch_timer, interval - elapsed);
+    } else {
+        qdr_action_enqueue(core, qdr_action(qdr_address_watch_flush_action_CT, "address_watch_flush"));
+    }
 }
 
 void qdr_address_watch_shutdown(qdr_core_t *core)
 {
+    qdr_core_timer_free_CT(core, core->addr_watch_timer);
+    core->addr_watch_timer = 0;
+
     qdr_address_watch_t *watch = DEQ_HEAD(core->addr_watches);
     while (!!watch) {
         DEQ_REMOVE(core->addr_watches, watch);
@@ -113,8 +149,11 @@ void qdr_address_watch_shutdown(qdr_core_t *core)
 //==================================================================================
 static void qdr_address_watch_free_CT(qdr_core_t *core, qdr_address_watch_t *watch)
 {
-    DEQ_REMOVE_N(PER_ADDRESS, watch->addr->watches, watch);
-    if (DEQ_SIZE(watch->addr->watches) == 0) {
+    if (watch->dirty) {
+        DEQ_REMOVE_N(DIRTY, core->addr_watches_dirty, watch);
+    }
+    DEQ_REMOVE_N(PER_ADDRESS, watch->addr->ext->watches, watch);
+    if (DEQ_SIZE(watch->addr->ext->watches) == 0) {
         qdrc_event_addr_raise(core, QDRC_EVENT_ADDR_WATCH_OFF, watch->addr);
     }
 
@@ -124,11 +163,61 @@ static void qdr_address_watch_free_CT(qdr_core_t *core, qdr_address_watch_t *wat
 }
 
 
-static void qdr_watch_invoker(qdr_core_t *core, qdr_general_work_t *work, bool discard)
+/**
+ * Hand the latest snapshot of every dirty watch to the I/O threads in a single work item.
+ */
+static void qdr_address_watch_flush_CT(qdr_core_t *core)
+{
+    core->addr_watch_flush_scheduled = false;
+    core->addr_watch_last_flush      = qdr_core_uptime_ticks(core);
+
+    size_t count = DEQ_SIZE(core->addr_watches_dirty);
+    if (count == 0)
+        return;
+
+    qdr_watch_update_t *updates = NEW_ARRAY(qdr_watch_update_t, count);
+    size_t              i       = 0;
+
+    qdr_address_watch_t *watch = DEQ_HEAD(core->addr_watches_dirty);
+    while (!!watch) {
+        DEQ_REMOVE_HEAD_N(DIRTY, core->addr_watches_dirty);
+        watch->dirty = false;
+        updates[i] = watch->update;
+        updates[i].handler = watch->on_update;
+        updates[i].context = watch->context;
+        i++;
+        watch = DEQ_HEAD(core->addr_watches_dirty);
+    }
+
+    qdr_general_work_t *work = qdr_general_work(qdr_watch_invoker);
+    work->affinity           = (uintptr_t) &core->addr_watches;  // cancels must follow the updates before them
+    work->watch_updates      = updates;
+    work->watch_update_count = count;
+    qdr_post_general_work_CT(core, work);
+}
+
+
+static void qdr_address_watch_flush_action_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     if (!discard)
-        work->watch_update_handler(work->context,
-                                   work->local_consumers, work->in_proc_consumers, work->remote_consumers, work->local_producers);
+        qdr_address_watch_flush_CT(core);
+}
+
+
+static void qdr_address_watch_timer_CT(qdr_core_t *core, void *context)
+{
+    qdr_address_watch_flush_CT(core);
+}
+
+
+static void qdr_watch_invoker(qdr_core_t *core, qdr_general_work_t *work, bool discard)
+{
+    for (size_t i = 0; !discard && i < work->watch_update_count; i++) {
+        qdr_watch_update_t *update = &work->watch_updates[i];
+        update->handler(update->context,
+                        update->local_consumers, update->in_proc_consumers, update->remote_consumers, update->local_producers);
+    }
+    free(work->watch_updates);
 }
 
 
@@ -174,13 +263,14 @@ static void qdr_core_watch_address_CT(qdr_core_t *core, qdr_action_t *action, bo
             watch->context      = action->args.io.context;
             DEQ_INSERT_TAIL(core->addr_watches, watch);
 
-            DEQ_INSERT_TAIL_N(PER_ADDRESS, addr->watches, watch);
+            qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+            DEQ_INSERT_TAIL_N(PER_ADDRESS, ext->watches, watch);
             addr->ref_count++;
 
             //
             // Raise a core event to notify interested parties that this address is being watched.
             //
-            if (DEQ_SIZE(addr->watches) == 1) {
+            if (DEQ_SIZE(ext->watches) == 1) {
                 qdrc_event_addr_raise(core, QDRC_EVENT_ADDR_WATCH_ON, addr);
             }
 
@@ -205,6 +295,7 @@ static void qdr_core_unwatch_address_CT(qdr_core_t *core, qdr_action_t *action,
                 DEQ_REMOVE(core->addr_watches, watch);
                 if (!!watch->on_cancel) {
                     qdr_general_work_t *work = qdr_general_work(qdr_watch_cancel_invoker);
+                    work->affinity             = (uintptr_t) &core->addr_watches;
                     work->watch_cancel_handler = watch->on_cancel;
                     work->context              = watch->context;
                     qdr_post_general_work_CT(core, work);
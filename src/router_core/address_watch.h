@@ -25,11 +25,28 @@
 typedef struct qdr_address_watch_t qdr_address_watch_t;
 DEQ_DECLARE(qdr_address_watch_t, qdr_address_watch_list_t);
 
+/**
+ * The latest reachability snapshot for one watch, as delivered to its update handler.
+ */
+typedef struct qdr_watch_update_t {
+    qdr_address_watch_update_t  handler;
+    void                       *context;
+    uint32_t                    local_consumers;
+    uint32_t                    in_proc_consumers;
+    uint32_t                    remote_consumers;
+    uint32_t                    local_producers;
+} qdr_watch_update_t;
+
 /**
  * qdr_trigger_address_watch_CT
  * 
  * This function is invoked after changes have been made to the address that affect
  * reachability (i.e. local and remote senders and receivers).
+ *
+ * Updates are coalesced: each watch keeps only its latest snapshot, and all pending
+ * snapshots are delivered together in one general-work item, at most once per
+ * addressWatchIntervalSeconds (or once the pending core actions have run when the
+ * interval is zero).
  * 
  * @param core Pointer to the router core state
  * @param addr Pointer to the address record that was modified
@@ -19,6 +19,7 @@
 
 #include "adaptors/tcp/tcp_adaptor.h"
 #include "agent_address.h"
+#include "agent_allocator.h"
 #include "agent_config_address.h"
 #include "agent_config_auto_link.h"
 #include "agent_connection.h"
@@ -36,6 +37,10 @@ static void qdr_manage_update_CT(qdr_core_t *core, qdr_action_t *action, bool di
 ALLOC_DECLARE(qdr_query_t);
 ALLOC_DEFINE(qdr_query_t);
 
+// Core thread time that one action may spend writing the rows of a QUERY, the remaining rows are written by later
+// actions
+#define QDR_AGENT_QUERY_BUDGET_NS (1000 * 1000)
+
 
 struct qdr_agent_t {
     qdr_query_list_t       outgoing_query_list;
@@ -80,6 +85,9 @@ void qdr_agent_enqueue_response_CT(qdr_core_t *core, qdr_query_t *query)
 {
     qdr_agent_t *agent = core->mgmt_agent;
 
+    if (query->batching)
+        return;  // qdr_agent_query_rows_CT enqueues the response once the batch is written
+
     sys_mutex_lock(&agent->query_lock);
     DEQ_INSERT_TAIL(agent->outgoing_query_list, query);
     bool notify = DEQ_SIZE(agent->outgoing_query_list) == 1;
@@ -258,6 +266,7 @@ qdr_query_t *qdr_manage_query(qdr_core_t              *core,
     case QD_ROUTER_CONNECTION:        qdr_agent_set_columns(query, attribute_names, qdr_connection_columns, QDR_CONNECTION_COLUMN_COUNT);  break;
     case QD_ROUTER_LINK:              qdr_agent_set_columns(query, attribute_names, qdr_link_columns, QDR_LINK_COLUMN_COUNT);  break;
     case QD_ROUTER_ADDRESS:           qdr_agent_set_columns(query, attribute_names, qdr_address_columns, QDR_ADDRESS_COLUMN_COUNT); break;
+    case QD_ROUTER_ALLOCATOR:         qdr_agent_set_columns(query, attribute_names, qdr_allocator_columns, QDR_ALLOCATOR_COLUMN_COUNT); break;
     case QD_ROUTER_FORBIDDEN:         break;
     }
 
@@ -274,12 +283,14 @@ void qdr_query_add_attribute_names(qdr_query_t *query)
     case QD_ROUTER_CONNECTION:        qdr_agent_emit_columns(query, qdr_connection_columns, QDR_CONNECTION_COLUMN_COUNT); break;
     case QD_ROUTER_LINK:              qdr_agent_emit_columns(query, qdr_link_columns, QDR_LINK_COLUMN_COUNT); break;
     case QD_ROUTER_ADDRESS:           qdr_agent_emit_columns(query, qdr_address_columns, QDR_ADDRESS_COLUMN_COUNT); break;
+    case QD_ROUTER_ALLOCATOR:         qdr_agent_emit_columns(query, qdr_allocator_columns, QDR_ALLOCATOR_COLUMN_COUNT); break;
     case QD_ROUTER_FORBIDDEN:         qd_compose_empty_list(query->body); break;
     }
 }
 
-void qdr_query_get_first(qdr_query_t *query, int offset)
+void qdr_query_get_first(qdr_query_t *query, int offset, int count)
 {
+    query->limit = count;
     qdr_action_t *action = qdr_action(qdrh_query_get_first_CT, "query_get_first");
     action->args.agent.query  = query;
     action->args.agent.offset = offset;
@@ -405,6 +416,7 @@ static void qdr_manage_read_CT(qdr_core_t *core, qdr_action_t *action, bool disc
         case QD_ROUTER_ROUTER_METRICS:    qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_LINK:              break;
         case QD_ROUTER_ADDRESS:           qdra_address_get_CT(core, name, identity, query, qdr_address_columns); break;
+        case QD_ROUTER_ALLOCATOR:         qdra_allocator_get_CT(core, name, identity, query, qdr_allocator_columns); break;
         case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, false); break;
        }
     }
@@ -429,6 +441,7 @@ static void qdr_manage_create_CT(qdr_core_t *core, qdr_action_t *action, bool di
         case QD_ROUTER_ROUTER_METRICS:    qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_LINK:              qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_ADDRESS:           break;
+        case QD_ROUTER_ALLOCATOR:         qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, false); break;
        }
     }
@@ -453,6 +466,7 @@ static void qdr_manage_delete_CT(qdr_core_t *core, qdr_action_t *action, bool di
         case QD_ROUTER_ROUTER_METRICS:    qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_LINK:              qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_ADDRESS:           break;
+        case QD_ROUTER_ALLOCATOR:         qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, false); break;
        }
     }
@@ -475,6 +489,7 @@ static void qdr_manage_update_CT(qdr_core_t *core, qdr_action_t *action, bool di
         case QD_ROUTER_CONNECTION:        qdra_connection_update_CT(core, name, identity, query, in_body); break;
         case QD_ROUTER_LINK:              qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_ADDRESS:           break;
+        case QD_ROUTER_ALLOCATOR:         qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_ROUTER_METRICS:    qdr_agent_forbidden(core, query, false); break;
         case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, false); break;
         }
@@ -488,21 +503,72 @@ static void qdr_manage_update_CT(qdr_core_t *core, qdr_action_t *action, bool di
 
 
 
+static void qdr_agent_get_first_CT(qdr_core_t *core, qdr_query_t *query, int offset)
+{
+    switch (query->entity_type) {
+    case QD_ROUTER_CONFIG_ADDRESS:    qdra_config_address_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_CONFIG_AUTO_LINK:  qdra_config_auto_link_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_ROUTER_METRICS:    qdra_router_metrics_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_CONNECTION:        qdra_connection_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_LINK:              qdra_link_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_ADDRESS:           qdra_address_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_ALLOCATOR:         qdra_allocator_get_first_CT(core, query, offset); break;
+    case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, true); break;
+    }
+}
+
+
+static void qdr_agent_get_next_CT(qdr_core_t *core, qdr_query_t *query)
+{
+    switch (query->entity_type) {
+    case QD_ROUTER_CONFIG_ADDRESS:    qdra_config_address_get_next_CT(core, query); break;
+    case QD_ROUTER_CONFIG_AUTO_LINK:  qdra_config_auto_link_get_next_CT(core, query); break;
+    case QD_ROUTER_ROUTER_METRICS:    qdra_router_metrics_get_next_CT(core, query); break;
+    case QD_ROUTER_CONNECTION:        qdra_connection_get_next_CT(core, query); break;
+    case QD_ROUTER_LINK:              qdra_link_get_next_CT(core, query); break;
+    case QD_ROUTER_ADDRESS:           qdra_address_get_next_CT(core, query); break;
+    case QD_ROUTER_ALLOCATOR:         qdra_allocator_get_next_CT(core, query); break;
+    case QD_ROUTER_FORBIDDEN:         break;
+    }
+}
+
+
+/**
+ * Write as many rows of a query as fit in QDR_AGENT_QUERY_BUDGET_NS, then enqueue a single response for all of
+ * them. A large query is spread across core actions instead of holding the core thread, and each response carries
+ * a batch of rows instead of one.
+ */
+static void qdr_agent_query_rows_CT(qdr_core_t *core, qdr_query_t *query, bool first, int offset)
+{
+    uint64_t start_ns = qdr_core_now_ns();
+
+    query->batching = true;
+    if (first)
+        qdr_agent_get_first_CT(core, query, offset);
+    else
+        qdr_agent_get_next_CT(core, query);
+    query->rows++;
+
+    while (query->more && (query->limit <= 0 || query->rows < query->limit)
+           && qdr_core_now_ns() - start_ns < QDR_AGENT_QUERY_BUDGET_NS) {
+        qdr_agent_get_next_CT(core, query);
+        query->rows++;
+    }
+
+    if (query->limit > 0 && query->rows >= query->limit)
+        query->more = false;  // the requested count has been written
+    query->batching = false;
+    qdr_agent_enqueue_response_CT(core, query);
+}
+
+
 static void qdrh_query_get_first_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     qdr_query_t *query  = action->args.agent.query;
     int          offset = action->args.agent.offset;
 
     if (!discard) {
-        switch (query->entity_type) {
-        case QD_ROUTER_CONFIG_ADDRESS:    qdra_config_address_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_CONFIG_AUTO_LINK:  qdra_config_auto_link_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_ROUTER_METRICS:    qdra_router_metrics_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_CONNECTION:        qdra_connection_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_LINK:              qdra_link_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_ADDRESS:           qdra_address_get_first_CT(core, query, offset); break;
-        case QD_ROUTER_FORBIDDEN:         qdr_agent_forbidden(core, query, true); break;
-        }
+        qdr_agent_query_rows_CT(core, query, true, offset);
     }
 }
 
@@ -512,15 +578,7 @@ static void qdrh_query_get_next_CT(qdr_core_t *core, qdr_action_t *action, bool
     qdr_query_t *query  = action->args.agent.query;
 
     if (!discard) {
-        switch (query->entity_type) {
-        case QD_ROUTER_CONFIG_ADDRESS:    qdra_config_address_get_next_CT(core, query); break;
-        case QD_ROUTER_CONFIG_AUTO_LINK:  qdra_config_auto_link_get_next_CT(core, query); break;
-        case QD_ROUTER_ROUTER_METRICS:    qdra_router_metrics_get_next_CT(core, query); break;
-        case QD_ROUTER_CONNECTION:        qdra_connection_get_next_CT(core, query); break;
-        case QD_ROUTER_LINK:              qdra_link_get_next_CT(core, query); break;
-        case QD_ROUTER_ADDRESS:           qdra_address_get_next_CT(core, query); break;
-        case QD_ROUTER_FORBIDDEN:         break;
-        }
+        qdr_agent_query_rows_CT(core, query, false, 0);
     }
 }
 
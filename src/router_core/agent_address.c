@@ -42,6 +42,9 @@
 #define QDR_ADDRESS_PRIORITY                           18
 #define QDR_ADDRESS_DELIVERIES_REDIRECTED              19
 #define QDR_ADDRESS_WATCH                              20
+#define QDR_ADDRESS_EGRESS_LATENCY_AVG                 21
+#define QDR_ADDRESS_SETTLE_LATENCY_AVG                 22
+#define QDR_ADDRESS_DELIVERIES_EXPIRED                 23
 
 const char *qdr_address_columns[] =
     {"name",
@@ -65,6 +68,9 @@ const char *qdr_address_columns[] =
      "priority",
      "deliveriesRedirectedToFallback",
      "watch",
+     "egressLatencyAvg",
+     "settleLatencyAvg",
+     "deliveriesExpired",
      0};
 
 
@@ -93,6 +99,7 @@ static void qdr_insert_address_columns_CT(qdr_core_t          *core,
             case QD_TREATMENT_MULTICAST_ONCE:   qd_compose_insert_string(body, "multicast");    break;
             case QD_TREATMENT_ANYCAST_CLOSEST:  qd_compose_insert_string(body, "closest");      break;
             case QD_TREATMENT_ANYCAST_BALANCED: qd_compose_insert_string(body, "balanced");     break;
+            case QD_TREATMENT_ANYCAST_AFFINITY: qd_compose_insert_string(body, "affinity");     break;
             case QD_TREATMENT_UNAVAILABLE:      qd_compose_insert_string(body, "unavailable");  break;
         }
         break;
@@ -146,11 +153,11 @@ static void qdr_insert_address_columns_CT(qdr_core_t          *core,
         break;
 
     case QDR_ADDRESS_DELIVERIES_EGRESS_ROUTE_CONTAINER:
-        qd_compose_insert_ulong(body, addr->deliveries_egress_route_container);
+        qd_compose_insert_ulong(body, addr->ext ? addr->ext->deliveries_egress_route_container : 0);
         break;
 
     case QDR_ADDRESS_DELIVERIES_INGRESS_ROUTE_CONTAINER:
-        qd_compose_insert_ulong(body, addr->deliveries_ingress_route_container);
+        qd_compose_insert_ulong(body, addr->ext ? addr->ext->deliveries_ingress_route_container : 0);
         break;
 
     case QDR_ADDRESS_TRANSIT_OUTSTANDING:
@@ -172,13 +179,31 @@ static void qdr_insert_address_columns_CT(qdr_core_t          *core,
         break;
 
     case QDR_ADDRESS_DELIVERIES_REDIRECTED:
-        qd_compose_insert_ulong(body, addr->deliveries_redirected);
+        qd_compose_insert_ulong(body, addr->ext ? addr->ext->deliveries_redirected : 0);
         break;
 
     case QDR_ADDRESS_WATCH:
-        qd_compose_insert_bool(body, DEQ_SIZE(addr->watches) > 0);
+        qd_compose_insert_bool(body, qdr_address_watch_count(addr) > 0);
         break;
 
+    case QDR_ADDRESS_EGRESS_LATENCY_AVG:
+    case QDR_ADDRESS_SETTLE_LATENCY_AVG: {
+        const qdr_address_latency_t *latency = addr->ext ? addr->ext->latency : 0;
+        qd_metric_t *hist = !latency ? 0 : column_index == QDR_ADDRESS_EGRESS_LATENCY_AVG ? latency->egress : latency->settle;
+        uint64_t count = qd_metric_value(hist);
+        qd_compose_insert_ulong(body, count ? qd_metric_sum(hist) / count : 0);
+        break;
+    }
+
+    case QDR_ADDRESS_DELIVERIES_EXPIRED: {
+        // dropped by the forwarder, and from the queues of the local consumers' links
+        uint64_t expired = addr->ext ? addr->ext->deliveries_expired : 0;
+        for (qdr_link_ref_t *ref = DEQ_HEAD(addr->rlinks); ref; ref = DEQ_NEXT(ref))
+            expired += ref->link->expired_deliveries;
+        qd_compose_insert_ulong(body, expired);
+        break;
+    }
+
     default:
         qd_compose_insert_null(body);
         break;
@@ -0,0 +1,270 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "agent_allocator.h"
+
+#include "qpid/dispatch/alloc_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// The allocator entity used to be read through the Python agent and its entity cache. The allocation type list is
+// fixed while the router runs and the statistics of each type are read under the type's own lock, so the core agent
+// can serve it without the GIL.
+//
+
+#define QDR_ALLOCATOR_NAME                               0
+#define QDR_ALLOCATOR_IDENTITY                           1
+#define QDR_ALLOCATOR_TYPE                               2
+#define QDR_ALLOCATOR_TYPE_NAME                          3
+#define QDR_ALLOCATOR_TYPE_SIZE                          4
+#define QDR_ALLOCATOR_TRANSFER_BATCH_SIZE                5
+#define QDR_ALLOCATOR_LOCAL_FREE_LIST_MAX                6
+#define QDR_ALLOCATOR_GLOBAL_FREE_LIST_MAX               7
+#define QDR_ALLOCATOR_TOTAL_ALLOC_FROM_HEAP              8
+#define QDR_ALLOCATOR_TOTAL_FREE_TO_HEAP                 9
+#define QDR_ALLOCATOR_HELD_BY_THREADS                    10
+#define QDR_ALLOCATOR_BATCHES_REBALANCED_TO_THREADS      11
+#define QDR_ALLOCATOR_BATCHES_REBALANCED_TO_GLOBAL       12
+#define QDR_ALLOCATOR_BATCHES_REBALANCED_FROM_REMOTE     13
+#define QDR_ALLOCATOR_REMOTE_FREES_RECLAIMED             14
+#define QDR_ALLOCATOR_SAMPLED_IN_USE                     15
+#define QDR_ALLOCATOR_SAMPLED_STACKS                     16
+
+#define QDR_ALLOCATOR_PROFILE_STACKS 10  // as reported by the Python agent
+
+const char *qdr_allocator_columns[] =
+    {"name",
+     "identity",
+     "type",
+     "typeName",
+     "typeSize",
+     "transferBatchSize",
+     "localFreeListMax",
+     "globalFreeListMax",
+     "totalAllocFromHeap",
+     "totalFreeToHeap",
+     "heldByThreads",
+     "batchesRebalancedToThreads",
+     "batchesRebalancedToGlobal",
+     "batchesRebalancedFromRemoteNode",
+     "remoteFreesReclaimed",
+     "sampledInUse",
+     "sampledStacks",
+     0};
+
+static const char *ALLOCATOR_TYPE = "io.skupper.router.allocator";
+
+
+static void qdr_allocator_insert_column_CT(qd_alloc_type_desc_t *desc, const qd_alloc_stats_t *stats, int col,
+                                           qd_composed_field_t *body)
+{
+    switch (col) {
+    case QDR_ALLOCATOR_NAME:
+    case QDR_ALLOCATOR_IDENTITY: {
+        char id[200];
+        snprintf(id, sizeof(id), "allocator/%s", desc->type_name);
+        qd_compose_insert_string(body, id);
+        break;
+    }
+
+    case QDR_ALLOCATOR_TYPE:
+        qd_compose_insert_string(body, ALLOCATOR_TYPE);
+        break;
+
+    case QDR_ALLOCATOR_TYPE_NAME:
+        qd_compose_insert_string(body, desc->type_name);
+        break;
+
+    case QDR_ALLOCATOR_TYPE_SIZE:
+        qd_compose_insert_ulong(body, qd_alloc_type_size(desc));
+        break;
+
+    case QDR_ALLOCATOR_TRANSFER_BATCH_SIZE:
+        qd_compose_insert_long(body, desc->config->transfer_batch_size);
+        break;
+
+    case QDR_ALLOCATOR_LOCAL_FREE_LIST_MAX:
+        qd_compose_insert_long(body, desc->config->local_free_list_max);
+        break;
+
+    case QDR_ALLOCATOR_GLOBAL_FREE_LIST_MAX:
+        qd_compose_insert_long(body, desc->config->global_free_list_max);
+        break;
+
+    case QDR_ALLOCATOR_TOTAL_ALLOC_FROM_HEAP:
+        qd_compose_insert_ulong(body, stats->total_alloc_from_heap);
+        break;
+
+    case QDR_ALLOCATOR_TOTAL_FREE_TO_HEAP:
+        qd_compose_insert_ulong(body, stats->total_free_to_heap);
+        break;
+
+    case QDR_ALLOCATOR_HELD_BY_THREADS:
+        qd_compose_insert_ulong(body, stats->held_by_threads);
+        break;
+
+    case QDR_ALLOCATOR_BATCHES_REBALANCED_TO_THREADS:
+        qd_compose_insert_ulong(body, stats->batches_rebalanced_to_threads);
+        break;
+
+    case QDR_ALLOCATOR_BATCHES_REBALANCED_TO_GLOBAL:
+        qd_compose_insert_ulong(body, stats->batches_rebalanced_to_global);
+        break;
+
+    case QDR_ALLOCATOR_BATCHES_REBALANCED_FROM_REMOTE:
+        qd_compose_insert_ulong(body, stats->batches_rebalanced_from_remote_node);
+        break;
+
+    case QDR_ALLOCATOR_REMOTE_FREES_RECLAIMED:
+        qd_compose_insert_ulong(body, stats->remote_frees_reclaimed);
+        break;
+
+    case QDR_ALLOCATOR_SAMPLED_IN_USE:
+        qd_compose_insert_ulong(body, qd_alloc_desc_sampled(desc));
+        break;
+
+    case QDR_ALLOCATOR_SAMPLED_STACKS: {
+        // Only present while the allocation profiler is enabled (allocProfileRate), a debugging aid: the stacks are
+        // symbolized here on the core thread.
+        char *profile = qd_alloc_profile_report(desc, QDR_ALLOCATOR_PROFILE_STACKS);
+        if (profile)
+            qd_compose_insert_string(body, profile);
+        else
+            qd_compose_insert_null(body);
+        free(profile);
+        break;
+    }
+
+    default:
+        qd_compose_insert_null(body);
+        break;
+    }
+}
+
+
+static void qdr_agent_write_allocator_CT(qdr_query_t *query, qd_alloc_type_desc_t *desc)
+{
+    qd_composed_field_t *body  = query->body;
+    qd_alloc_stats_t     stats = qd_alloc_desc_stats(desc);
+
+    qd_compose_start_list(body);
+    int i = 0;
+    while (query->columns[i] >= 0) {
+        qdr_allocator_insert_column_CT(desc, &stats, query->columns[i], body);
+        i++;
+    }
+    qd_compose_end_list(body);
+}
+
+
+static qd_alloc_type_desc_t *qdr_allocator_at(int offset)
+{
+    qd_alloc_type_desc_t *desc = qd_alloc_desc_first();
+    for (int i = 0; i < offset && desc; i++)
+        desc = DEQ_NEXT(desc);
+    return desc;
+}
+
+
+static void qdr_manage_advance_allocator_CT(qdr_query_t *query, qd_alloc_type_desc_t *desc)
+{
+    query->next_offset++;
+    query->more = !!DEQ_NEXT(desc);
+}
+
+
+void qdra_allocator_get_first_CT(qdr_core_t *core, qdr_query_t *query, int offset)
+{
+    //
+    // Queries that get this far will always succeed.
+    //
+    query->status = QD_AMQP_OK;
+
+    qd_alloc_type_desc_t *desc = qdr_allocator_at(offset);
+    if (desc) {
+        qdr_agent_write_allocator_CT(query, desc);
+        query->next_offset = offset;
+        qdr_manage_advance_allocator_CT(query, desc);
+    } else {
+        query->more = false;
+    }
+
+    qdr_agent_enqueue_response_CT(core, query);
+}
+
+
+void qdra_allocator_get_next_CT(qdr_core_t *core, qdr_query_t *query)
+{
+    //
+    // The allocation types never change while the router runs, so the saved offset is always valid.
+    //
+    qd_alloc_type_desc_t *desc = qdr_allocator_at(query->next_offset);
+    if (desc) {
+        qdr_agent_write_allocator_CT(query, desc);
+        qdr_manage_advance_allocator_CT(query, desc);
+    } else {
+        query->more = false;
+    }
+
+    qdr_agent_enqueue_response_CT(core, query);
+}
+
+
+static qd_alloc_type_desc_t *qdr_allocator_find_CT(qd_iterator_t *name, qd_iterator_t *identity)
+{
+    qd_iterator_t *key = identity ? identity : name;
+    if (!key)
+        return 0;
+
+    for (qd_alloc_type_desc_t *desc = qd_alloc_desc_first(); desc; desc = DEQ_NEXT(desc)) {
+        char id[200];
+        snprintf(id, sizeof(id), "allocator/%s", desc->type_name);
+        if (qd_iterator_equal(key, (const unsigned char *) id))
+            return desc;
+    }
+    return 0;
+}
+
+
+void qdra_allocator_get_CT(qdr_core_t    *core,
+                           qd_iterator_t *name,
+                           qd_iterator_t *identity,
+                           qdr_query_t   *query,
+                           const char    *qdr_allocator_columns[])
+{
+    qd_alloc_type_desc_t *desc = qdr_allocator_find_CT(name, identity);
+
+    if (!desc) {
+        // Send back a 404
+        query->status = QD_AMQP_NOT_FOUND;
+    } else {
+        qd_alloc_stats_t stats = qd_alloc_desc_stats(desc);
+        qd_compose_start_map(query->body);
+        for (int i = 0; i < QDR_ALLOCATOR_COLUMN_COUNT; i++) {
+            qd_compose_insert_string(query->body, qdr_allocator_columns[i]);
+            qdr_allocator_insert_column_CT(desc, &stats, i, query->body);
+        }
+        qd_compose_end_map(query->body);
+        query->status = QD_AMQP_OK;
+    }
+
+    qdr_agent_enqueue_response_CT(core, query);
+}
@@ -31,6 +31,8 @@
 #define QDR_CONFIG_ADDRESS_DISTRIBUTION  4
 #define QDR_CONFIG_ADDRESS_PATTERN       5
 #define QDR_CONFIG_ADDRESS_PRIORITY      6
+#define QDR_CONFIG_ADDRESS_LATENCY       7
+#define QDR_CONFIG_ADDRESS_AFFINITY_KEY  8
 
 const char *qdr_config_address_columns[] =
     {"name",
@@ -40,6 +42,8 @@ const char *qdr_config_address_columns[] =
      "distribution",
      "pattern",
      "priority",
+     "latencyTracking",
+     "affinityKey",
      0};
 
 const char *CONFIG_ADDRESS_TYPE = "io.skupper.router.router.config.address";
@@ -102,6 +106,17 @@ static void qdr_config_address_insert_column_CT(qdr_address_config_t *addr, int
     case QDR_CONFIG_ADDRESS_PRIORITY:
         qd_compose_insert_int(body, addr->priority);
         break;
+
+    case QDR_CONFIG_ADDRESS_LATENCY:
+        qd_compose_insert_bool(body, addr->latency_tracking);
+        break;
+
+    case QDR_CONFIG_ADDRESS_AFFINITY_KEY:
+        if (addr->affinity_key)
+            qd_compose_insert_string(body, addr->affinity_key);
+        else
+            qd_compose_insert_null(body);
+        break;
     }
 }
 
@@ -227,6 +242,7 @@ static qd_address_treatment_t qdra_address_treatment_CT(qd_parsed_field_t *field
         if (qd_iterator_equal(iter, (unsigned char*) "multicast"))    return QD_TREATMENT_MULTICAST_ONCE;
         if (qd_iterator_equal(iter, (unsigned char*) "closest"))      return QD_TREATMENT_ANYCAST_CLOSEST;
         if (qd_iterator_equal(iter, (unsigned char*) "balanced"))     return QD_TREATMENT_ANYCAST_BALANCED;
+        if (qd_iterator_equal(iter, (unsigned char*) "affinity"))     return QD_TREATMENT_ANYCAST_AFFINITY;
         if (qd_iterator_equal(iter, (unsigned char*) "unavailable"))  return QD_TREATMENT_UNAVAILABLE;
     }
     return QD_TREATMENT_ANYCAST_BALANCED;
@@ -356,8 +372,11 @@ void qdra_config_address_create_CT(qdr_core_t         *core,
         qd_parsed_field_t *pattern_field   = qd_parse_value_by_key(in_body, qdr_config_address_columns[QDR_CONFIG_ADDRESS_PATTERN]);
         qd_parsed_field_t *distrib_field   = qd_parse_value_by_key(in_body, qdr_config_address_columns[QDR_CONFIG_ADDRESS_DISTRIBUTION]);
         qd_parsed_field_t *priority_field  = qd_parse_value_by_key(in_body, qdr_config_address_columns[QDR_CONFIG_ADDRESS_PRIORITY]);
+        qd_parsed_field_t *latency_field   = qd_parse_value_by_key(in_body, qdr_config_address_columns[QDR_CONFIG_ADDRESS_LATENCY]);
+        qd_parsed_field_t *affinity_field  = qd_parse_value_by_key(in_body, qdr_config_address_columns[QDR_CONFIG_ADDRESS_AFFINITY_KEY]);
 
         long priority = priority_field  ? qd_parse_as_long(priority_field)  : -1;
+        bool latency_tracking = latency_field ? qd_parse_as_bool(latency_field) : false;
 
         //
         // Either a prefix or a pattern field is mandatory.  Prefix and pattern
@@ -453,6 +472,9 @@ void qdra_config_address_create_CT(qdr_core_t         *core,
         addr->is_prefix = !!prefix_field;
         addr->pattern   = pattern;
         addr->priority  = priority;
+        addr->latency_tracking = latency_tracking;
+        if (affinity_field && qd_iterator_length(qd_parse_raw(affinity_field)) > 0)
+            addr->affinity_key = (char*) qd_iterator_copy(qd_parse_raw(affinity_field));
         pattern = 0;
 
         DEQ_INSERT_TAIL(core->addr_config, addr);
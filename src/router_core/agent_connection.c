@@ -52,6 +52,13 @@
 #define QDR_CONNECTION_TLS_ORDINAL           25
 #define QDR_CONNECTION_GROUP_CORRELATOR      26
 #define QDR_CONNECTION_GROUP_ORDINAL         27
+#define QDR_CONNECTION_CPU_MICROSECONDS      28
+#define QDR_CONNECTION_COMPRESSED_SENT       29
+#define QDR_CONNECTION_UNCOMPRESSED_SENT     30
+#define QDR_CONNECTION_COMPRESSED_RECEIVED   31
+#define QDR_CONNECTION_UNCOMPRESSED_RECEIVED 32
+#define QDR_CONNECTION_COMPRESSION_MICROSECONDS 33
+#define QDR_CONNECTION_WORK_BUDGET_EXHAUSTED 34
 
 
 const char * const QDR_CONNECTION_DIR_IN  = "in";
@@ -102,6 +109,13 @@ const char *qdr_connection_columns[] =
      "tlsOrdinal",
      "groupCorrelationId",
      "groupOrdinal",
+     "cpuMicroseconds",
+     "compressedOctetsSent",
+     "uncompressedOctetsSent",
+     "compressedOctetsReceived",
+     "uncompressedOctetsReceived",
+     "compressionMicroseconds",
+     "workBudgetExhausted",
      0};
 
 const char *CONNECTION_TYPE = "io.skupper.router.connection";
@@ -133,6 +147,7 @@ static void qdr_connection_insert_column_CT(qdr_core_t *core, qdr_connection_t *
 {
     char id_str[100];
     const char *text = 0;
+    qdr_compression_stats_t compression;
 
     if (!conn)
         return;
@@ -241,7 +256,7 @@ static void qdr_connection_insert_column_CT(qdr_core_t *core, qdr_connection_t *
                 qd_compose_insert_bool(body, true);
             }
             else if (core->router_mode  == QD_ROUTER_MODE_EDGE){
-                if (core->active_edge_connection == conn)
+                if (core->active_edge_connection == conn || conn->edge_uplink)
                     qd_compose_insert_bool(body, true);
                 else
                     qd_compose_insert_bool(body, false);
@@ -343,6 +358,39 @@ static void qdr_connection_insert_column_CT(qdr_core_t *core, qdr_connection_t *
             qd_compose_insert_null(body);
         }
         break;
+
+    case QDR_CONNECTION_CPU_MICROSECONDS:
+        qd_compose_insert_ulong(body, qdr_connection_cpu_time(conn) / 1000);
+        break;
+
+    case QDR_CONNECTION_COMPRESSED_SENT:
+        qdr_connection_compression_stats(conn, &compression);
+        qd_compose_insert_ulong(body, compression.wire_sent);
+        break;
+
+    case QDR_CONNECTION_UNCOMPRESSED_SENT:
+        qdr_connection_compression_stats(conn, &compression);
+        qd_compose_insert_ulong(body, compression.plain_sent);
+        break;
+
+    case QDR_CONNECTION_COMPRESSED_RECEIVED:
+        qdr_connection_compression_stats(conn, &compression);
+        qd_compose_insert_ulong(body, compression.wire_received);
+        break;
+
+    case QDR_CONNECTION_UNCOMPRESSED_RECEIVED:
+        qdr_connection_compression_stats(conn, &compression);
+        qd_compose_insert_ulong(body, compression.plain_received);
+        break;
+
+    case QDR_CONNECTION_COMPRESSION_MICROSECONDS:
+        qdr_connection_compression_stats(conn, &compression);
+        qd_compose_insert_ulong(body, compression.nsec / 1000);
+        break;
+
+    case QDR_CONNECTION_WORK_BUDGET_EXHAUSTED:
+        qd_compose_insert_ulong(body, atomic_load_explicit(&conn->budget_exhausted, memory_order_relaxed));
+        break;
     }
 
     sys_mutex_unlock(&conn->connection_info->connection_info_lock);
@@ -372,6 +420,8 @@ static void qdr_manage_advance_connection_CT(qdr_query_t *query, qdr_connection_
         query->next_offset++;
         conn = DEQ_NEXT(conn);
         query->more = !!conn;
+        if (conn)
+            set_safe_ptr_qdr_connection_t(conn, &query->next_ptr);
     }
     else {
         query->more = false;
@@ -427,12 +477,22 @@ void qdra_connection_get_first_CT(qdr_core_t *core, qdr_query_t *query, int offs
 
 void qdra_connection_get_next_CT(qdr_core_t *core, qdr_query_t *query)
 {
-    qdr_connection_t *conn = 0;
+    //
+    // Resume from the connection saved by the previous get.  A connection stays on the
+    // open_connections list until it is freed.
+    //
+    qdr_connection_t *conn = safe_deref_qdr_connection_t(query->next_ptr);
 
-    if (query->next_offset < DEQ_SIZE(core->open_connections)) {
-        conn = DEQ_HEAD(core->open_connections);
-        for (int i = 0; i < query->next_offset && conn; i++)
-            conn = DEQ_NEXT(conn);
+    if (!conn) {
+        //
+        // If the connection was closed in the time between this get and the previous one,
+        // we need to use the saved offset, which is less efficient.
+        //
+        if (query->next_offset < DEQ_SIZE(core->open_connections)) {
+            conn = DEQ_HEAD(core->open_connections);
+            for (int i = 0; i < query->next_offset && conn; i++)
+                conn = DEQ_NEXT(conn);
+        }
     }
 
     if (conn) {
@@ -50,6 +50,10 @@
 #define QDR_LINK_SETTLE_RATE              25
 #define QDR_LINK_CREDIT_AVAILABLE         26
 #define QDR_LINK_ZERO_CREDIT_SECONDS      27
+#define QDR_LINK_Q2_LIMIT                 28
+#define QDR_LINK_Q2_BLOCKED_COUNT         29
+#define QDR_LINK_EFFECTIVE_CAPACITY       30
+#define QDR_LINK_DELIVERIES_EXPIRED       31
 
 const char *qdr_link_columns[] =
     {"name",
@@ -80,6 +84,10 @@ const char *qdr_link_columns[] =
      "settleRate",
      "creditAvailable",
      "zeroCreditSeconds",
+     "q2Limit",
+     "q2BlockedCount",
+     "effectiveCapacity",
+     "deliveriesExpired",
      0};
 
 static const char *qd_link_type_name(qd_link_type_t lt)
@@ -150,11 +158,11 @@ static void qdr_agent_write_column_CT(qdr_core_t *core, qd_composed_field_t *bod
         break;
 
     case QDR_LINK_CAPACITY:
-        qd_compose_insert_uint(body, link->capacity);
+        qd_compose_insert_uint(body, link->conn ? link->conn->link_capacity : link->capacity);
         break;
 
     case QDR_LINK_UNDELIVERED_COUNT:
-        qd_compose_insert_ulong(body, DEQ_SIZE(link->undelivered));
+        qd_compose_insert_ulong(body, qdr_delivery_ring_size(&link->undelivered));
         break;
 
     case QDR_LINK_UNSETTLED_COUNT:
@@ -272,6 +280,26 @@ static void qdr_agent_write_column_CT(qdr_core_t *core, qd_composed_field_t *bod
             qd_compose_insert_uint(body, qdr_core_uptime_ticks(core) - link->zero_credit_time);
         break;
 
+    case QDR_LINK_Q2_LIMIT:
+        if (link->link_direction == QD_INCOMING) {
+            uint32_t q2_limit = sys_atomic_get(&link->q2_limit);
+            qd_compose_insert_uint(body, q2_limit ? q2_limit : QD_QLIMIT_Q2_UPPER);
+        } else
+            qd_compose_insert_null(body);
+        break;
+
+    case QDR_LINK_Q2_BLOCKED_COUNT:
+        qd_compose_insert_uint(body, sys_atomic_get(&link->q2_blocked_count));
+        break;
+
+    case QDR_LINK_EFFECTIVE_CAPACITY:
+        qd_compose_insert_uint(body, link->capacity);
+        break;
+
+    case QDR_LINK_DELIVERIES_EXPIRED:
+        qd_compose_insert_ulong(body, link->expired_deliveries);
+        break;
+
     default:
         qd_compose_insert_null(body);
         break;
@@ -299,6 +327,7 @@ static void qdr_manage_advance_link_CT(qdr_query_t *query, qdr_link_t *link)
     link = DEQ_NEXT(link);
     if (link) {
         query->more     = true;
+        set_safe_ptr_qdr_link_t(link, &query->next_ptr);
         //query->next_key = qdr_field((const char*) qd_hash_key_by_handle(link->owning_addr->hash_handle));
     } else
         query->more = false;
@@ -354,13 +383,23 @@ void qdra_link_get_first_CT(qdr_core_t *core, qdr_query_t *query, int offset)
 
 void qdra_link_get_next_CT(qdr_core_t *core, qdr_query_t *query)
 {
-    qdr_link_t *link = 0;
+    //
+    // Resume from the link saved by the previous get.  A link stays on the open_links list
+    // until it is freed.
+    //
+    qdr_link_t *link = safe_deref_qdr_link_t(query->next_ptr);
 
+    if (!link) {
+        //
+        // If the link was freed in the time between this get and the previous one,
+        // we need to use the saved offset, which is less efficient.
+        //
         if (query->next_offset < DEQ_SIZE(core->open_links)) {
             link = DEQ_HEAD(core->open_links);
             for (int i = 0; i < query->next_offset && link; i++)
                 link = DEQ_NEXT(link);
         }
+    }
 
     if (link) {
         //
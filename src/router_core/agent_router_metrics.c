@@ -55,6 +55,18 @@
 #define QDR_ROUTER_RSS_USAGE                           26
 #define QDR_ROUTER_CONNECTION_COUNTERS                 27
 #define QDR_ROUTER_VERSION                             28
+#define QDR_ROUTER_CORE_ACTION_BATCHES                 29
+#define QDR_ROUTER_CORE_ACTION_DEPTH_MAX               30
+#define QDR_ROUTER_CORE_ACTION_STATS                   31
+#define QDR_ROUTER_CORE_ACTION_CLASS_STATS             32
+#define QDR_ROUTER_CONNECTION_ACTIVATIONS              33
+#define QDR_ROUTER_PRIORITY_LANE_STATS                 34
+#define QDR_ROUTER_MOBILE_ADDRESS_SYNC_STATS           35
+#define QDR_ROUTER_CUT_THROUGH_STATS                   36
+#define QDR_ROUTER_LOCK_STATS                          37
+#define QDR_ROUTER_HEAVY_HITTERS                       38
+#define QDR_ROUTER_WORKER_THREADS                      39
+#define QDR_ROUTER_WORKER_UTILIZATION                  40
 
 const char *qdr_router_columns[] =
     {"identity",
@@ -86,6 +98,18 @@ const char *qdr_router_columns[] =
      "residentMemoryUsage",
      "connectionCounters",
      "version",
+     "coreActionBatches",
+     "coreActionDepthMax",
+     "coreActionStats",
+     "coreActionClassStats",
+     "connectionActivations",
+     "priorityLaneStats",
+     "mobileAddressSyncStats",
+     "cutThroughStats",
+     "lockStats",
+     "heavyHitters",
+     "workerThreads",
+     "workerUtilization",
      0};
 
 static void qdr_agent_write_column_CT(qd_composed_field_t *body, int col, qdr_core_t *core)
@@ -225,6 +249,182 @@ static void qdr_agent_write_column_CT(qd_composed_field_t *body, int col, qdr_co
         break;
     }
 
+    case QDR_ROUTER_CORE_ACTION_BATCHES:
+        qd_compose_insert_ulong(body, core->action_stats.batches);
+        break;
+
+    case QDR_ROUTER_CORE_ACTION_DEPTH_MAX:
+        qd_compose_insert_ulong(body, core->action_stats.depth_max);
+        break;
+
+    case QDR_ROUTER_CORE_ACTION_STATS: {
+        qdr_action_stats_t *stats = NEW_ARRAY(qdr_action_stats_t, QDR_ACTION_STATS_MAX);
+        size_t count = qdr_action_stats_collect_CT(core, stats, QDR_ACTION_STATS_MAX);
+        qd_compose_start_map(body);
+        for (size_t i = 0; i < count; i++) {
+            qd_compose_insert_string(body, stats[i].label);
+            qd_compose_start_map(body);
+            qd_compose_insert_string(body, "count");
+            qd_compose_insert_ulong(body, stats[i].count);
+            qd_compose_insert_string(body, "totalNs");
+            qd_compose_insert_ulong(body, stats[i].total_ns);
+            qd_compose_insert_string(body, "maxNs");
+            qd_compose_insert_ulong(body, stats[i].max_ns);
+            qd_compose_insert_string(body, "queueDelayTotalNs");
+            qd_compose_insert_ulong(body, stats[i].queue_delay_total_ns);
+            qd_compose_insert_string(body, "queueDelayMaxNs");
+            qd_compose_insert_ulong(body, stats[i].queue_delay_max_ns);
+            qd_compose_insert_string(body, "histogram");
+            qd_compose_start_list(body);
+            for (int b = 0; b < QDR_ACTION_HISTOGRAM_BUCKETS; b++)
+                qd_compose_insert_ulong(body, stats[i].histogram[b]);
+            qd_compose_end_list(body);
+            qd_compose_end_map(body);
+        }
+        qd_compose_end_map(body);
+        free(stats);
+        break;
+    }
+
+    case QDR_ROUTER_CORE_ACTION_CLASS_STATS: {
+        static const char *class_names[QDR_ACTION_CLASS_COUNT] = {"foreground", "background", "control"};
+        qd_compose_start_map(body);
+        for (int cls = 0; cls < QDR_ACTION_CLASS_COUNT; cls++) {
+            const qdr_action_class_stats_t *class_stats = &core->action_stats.classes[cls];
+            qd_compose_insert_string(body, class_names[cls]);
+            qd_compose_start_map(body);
+            qd_compose_insert_string(body, "count");
+            qd_compose_insert_ulong(body, class_stats->count);
+            qd_compose_insert_string(body, "waitTotalNs");
+            qd_compose_insert_ulong(body, class_stats->wait_total_ns);
+            qd_compose_insert_string(body, "waitMaxNs");
+            qd_compose_insert_ulong(body, class_stats->wait_max_ns);
+            qd_compose_end_map(body);
+        }
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_CONNECTION_ACTIVATIONS: {
+        qd_compose_start_map(body);
+        for (qdr_protocol_adaptor_t *adaptor = DEQ_HEAD(core->protocol_adaptors); adaptor; adaptor = DEQ_NEXT(adaptor)) {
+            qd_compose_insert_string(body, adaptor->name);
+            qd_compose_start_map(body);
+            qd_compose_insert_string(body, "requested");
+            qd_compose_insert_ulong(body, adaptor->activations_requested);
+            qd_compose_insert_string(body, "suppressed");
+            qd_compose_insert_ulong(body, adaptor->activations_suppressed);
+            qd_compose_insert_string(body, "delivered");
+            qd_compose_insert_ulong(body, adaptor->activations_delivered);
+            qd_compose_end_map(body);
+        }
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_PRIORITY_LANE_STATS: {
+        qdr_priority_lane_stats_t lanes[QDR_N_PRIORITIES];
+        memcpy(lanes, core->closed_lane_stats, sizeof(lanes));
+        for (qdr_connection_t *conn = DEQ_HEAD(core->open_connections); conn; conn = DEQ_NEXT(conn)) {
+            sys_mutex_lock(&conn->work_lock);
+            qdr_priority_lane_stats_merge(lanes, conn->lane_stats);
+            sys_mutex_unlock(&conn->work_lock);
+        }
+
+        char key[8];
+        qd_compose_start_map(body);
+        for (int priority = 0; priority < QDR_N_PRIORITIES; priority++) {
+            snprintf(key, sizeof(key), "%d", priority);
+            qd_compose_insert_string(body, key);
+            qd_compose_start_map(body);
+            qd_compose_insert_string(body, "deliveries");
+            qd_compose_insert_ulong(body, lanes[priority].deliveries);
+            qd_compose_insert_string(body, "delayTotalNs");
+            qd_compose_insert_ulong(body, lanes[priority].queue_delay_total_ns);
+            qd_compose_insert_string(body, "delayMaxNs");
+            qd_compose_insert_ulong(body, lanes[priority].queue_delay_max_ns);
+            qd_compose_end_map(body);
+        }
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_MOBILE_ADDRESS_SYNC_STATS: {
+        const qdr_mobile_sync_stats_t *stats = &core->mobile_sync_stats;
+        qd_compose_start_map(body);
+        qd_compose_insert_string(body, "flips");
+        qd_compose_insert_ulong(body, stats->flips);
+        qd_compose_insert_string(body, "coalesced");
+        qd_compose_insert_ulong(body, stats->coalesced);
+        qd_compose_insert_string(body, "updates");
+        qd_compose_insert_ulong(body, stats->updates);
+        qd_compose_insert_string(body, "addresses");
+        qd_compose_insert_ulong(body, stats->addresses);
+        qd_compose_insert_string(body, "pending");
+        qd_compose_insert_ulong(body, stats->pending);
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_CUT_THROUGH_STATS: {
+        qd_message_cutthrough_stats_t stats;
+        qd_message_get_cutthrough_stats(&stats);
+        qd_compose_start_map(body);
+        qd_compose_insert_string(body, "streams");
+        qd_compose_insert_ulong(body, stats.streams);
+        qd_compose_insert_string(body, "producerStalls");
+        qd_compose_insert_ulong(body, stats.producer_stalls);
+        qd_compose_insert_string(body, "ringGrowths");
+        qd_compose_insert_ulong(body, stats.ring_growths);
+        qd_compose_insert_string(body, "slotsInUse");
+        qd_compose_insert_ulong(body, stats.slots_in_use);
+        qd_compose_insert_string(body, "maxSlots");
+        qd_compose_insert_uint(body, stats.max_slots);
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_LOCK_STATS: {
+        qd_compose_start_map(body);
+        if (sys_lock_profiling_enabled()) {
+            sys_lock_stats_t *stats = NEW_ARRAY(sys_lock_stats_t, SYS_LOCK_CLASS_MAX);
+            int count = sys_lock_stats(stats, SYS_LOCK_CLASS_MAX);
+            for (int i = 0; i < count; i++) {
+                qd_compose_insert_string(body, stats[i].name);
+                qd_compose_start_map(body);
+                qd_compose_insert_string(body, "acquisitions");
+                qd_compose_insert_ulong(body, stats[i].acquisitions);
+                qd_compose_insert_string(body, "contended");
+                qd_compose_insert_ulong(body, stats[i].contended);
+                qd_compose_insert_string(body, "waitTotalNs");
+                qd_compose_insert_ulong(body, stats[i].wait_total_ns);
+                qd_compose_insert_string(body, "waitMaxNs");
+                qd_compose_insert_ulong(body, stats[i].wait_max_ns);
+                qd_compose_insert_string(body, "histogram");
+                qd_compose_start_list(body);
+                for (int b = 0; b < SYS_LOCK_HISTOGRAM_BUCKETS; b++)
+                    qd_compose_insert_ulong(body, stats[i].histogram[b]);
+                qd_compose_end_list(body);
+                qd_compose_end_map(body);
+            }
+            free(stats);
+        }
+        qd_compose_end_map(body);
+        break;
+    }
+
+    case QDR_ROUTER_HEAVY_HITTERS:
+        qdr_heavy_hitters_write_CT(core->heavy_hitters, body);
+        break;
+
+    case QDR_ROUTER_WORKER_THREADS:
+        qd_compose_insert_uint(body, qd_server_worker_threads(qd_dispatch_get_server(core->qd)));
+        break;
+
+    case QDR_ROUTER_WORKER_UTILIZATION:
+        qd_compose_insert_uint(body, qd_server_worker_utilization(qd_dispatch_get_server(core->qd)));
+        break;
+
     default:
         qd_compose_insert_null(body);
         break;
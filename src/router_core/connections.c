@@ -24,6 +24,7 @@
 
 #include "qpid/dispatch/amqp.h"
 #include "qpid/dispatch/discriminator.h"
+#include "qpid/dispatch/flight_recorder.h"
 #include "qpid/dispatch/router_core.h"
 #include "qpid/dispatch/static_assert.h"
 
@@ -115,11 +116,13 @@ qdr_connection_t *qdr_connection_opened(qdr_core_t                   *core,
     conn->admin_status          = QD_CONN_ADMIN_ENABLED;
     conn->oper_status           = QD_CONN_OPER_UP;
     DEQ_INIT(conn->links);
-    DEQ_INIT(conn->work_list);
+    sys_atomic_ptr_init(&conn->work_stack, 0);
     DEQ_INIT(conn->streaming_link_pool);
     conn->connection_info->role = conn->role;
-    sys_mutex_init(&conn->work_lock);
+    sys_mutex_init_named(&conn->work_lock, "connection_work");
+    sys_atomic_init(&conn->activation_pending, 0);
     conn->conn_uptime = qdr_core_uptime_ticks(core);
+    qd_flight_record(QD_FLIGHT_CONN_OPENED, management_id, role, incoming);
 
     if (context_binder) {
         context_binder(conn, bind_token);
@@ -292,6 +295,39 @@ void *qdr_connection_get_context(const qdr_connection_t *conn)
     return conn ? conn->user_context : NULL;
 }
 
+bool qdr_connection_activation_pending(qdr_connection_t *conn)
+{
+    return IS_ATOMIC_FLAG_SET(&conn->activation_pending);
+}
+
+void qdr_connection_add_cpu_time(qdr_connection_t *conn, uint64_t nsec)
+{
+    atomic_fetch_add_explicit(&conn->cpu_ns, nsec, memory_order_relaxed);
+}
+
+uint64_t qdr_connection_cpu_time(const qdr_connection_t *conn)
+{
+    return atomic_load_explicit(&conn->cpu_ns, memory_order_relaxed);
+}
+
+void qdr_connection_add_compression_stats(qdr_connection_t *conn, const qdr_compression_stats_t *stats)
+{
+    atomic_fetch_add_explicit(&conn->compression.plain_sent, stats->plain_sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&conn->compression.wire_sent, stats->wire_sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&conn->compression.wire_received, stats->wire_received, memory_order_relaxed);
+    atomic_fetch_add_explicit(&conn->compression.plain_received, stats->plain_received, memory_order_relaxed);
+    atomic_fetch_add_explicit(&conn->compression.nsec, stats->nsec, memory_order_relaxed);
+}
+
+void qdr_connection_compression_stats(const qdr_connection_t *conn, qdr_compression_stats_t *stats)
+{
+    stats->plain_sent     = atomic_load_explicit(&conn->compression.plain_sent, memory_order_relaxed);
+    stats->wire_sent      = atomic_load_explicit(&conn->compression.wire_sent, memory_order_relaxed);
+    stats->wire_received  = atomic_load_explicit(&conn->compression.wire_received, memory_order_relaxed);
+    stats->plain_received = atomic_load_explicit(&conn->compression.plain_received, memory_order_relaxed);
+    stats->nsec           = atomic_load_explicit(&conn->compression.nsec, memory_order_relaxed);
+}
+
 void qdr_record_link_credit(qdr_core_t *core, qdr_link_t *link)
 {
     //
@@ -322,6 +358,37 @@ void qdr_record_link_credit(qdr_core_t *core, qdr_link_t *link)
 }
 
 
+void qdr_link_delivery_queued_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (!link->in_delivery_age_list) {
+        link->delivery_age_ticks = qdr_core_uptime_ticks(core);
+        DEQ_INSERT_TAIL_N(DELIVERY_AGE, core->links_by_delivery_age, link);
+        link->in_delivery_age_list = true;
+    }
+}
+
+
+void qdr_link_delivery_progress_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (link->in_delivery_age_list) {
+        link->delivery_age_ticks = qdr_core_uptime_ticks(core);
+        if (DEQ_NEXT_N(DELIVERY_AGE, link)) {
+            DEQ_REMOVE_N(DELIVERY_AGE, core->links_by_delivery_age, link);
+            DEQ_INSERT_TAIL_N(DELIVERY_AGE, core->links_by_delivery_age, link);
+        }
+    }
+}
+
+
+void qdr_link_delivery_age_remove_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (link->in_delivery_age_list) {
+        DEQ_REMOVE_N(DELIVERY_AGE, core->links_by_delivery_age, link);
+        link->in_delivery_age_list = false;
+    }
+}
+
+
 void qdr_close_connection_CT(qdr_core_t *core, qdr_connection_t  *conn)
 {
     bool conn_already_closed = false;
@@ -370,11 +437,48 @@ void qdr_core_close_connection(qdr_connection_t *conn)
 }
 
 
+static int qdr_delivery_ref_compare(const void *a, const void *b)
+{
+    uint32_t id_a = (*(qdr_delivery_ref_t* const*) a)->dlv->delivery_id;
+    uint32_t id_b = (*(qdr_delivery_ref_t* const*) b)->dlv->delivery_id;
+    int32_t  diff = (int32_t) (id_a - id_b);  // delivery ids wrap
+    return (diff > 0) - (diff < 0);
+}
+
+
+//
+// Put a link's batch of updated deliveries back into delivery order.  The core settles deliveries in whatever order
+// their peers complete, but Proton only folds dispositions with the same outcome into one ranged disposition frame
+// when they are applied to consecutive deliveries in order.
+//
+static void qdr_sort_updated_deliveries(qdr_delivery_ref_list_t *list)
+{
+    qdr_delivery_ref_t *dref = DEQ_HEAD(*list);
+    while (dref && DEQ_NEXT(dref) && qdr_delivery_ref_compare(&dref, &DEQ_NEXT(dref)) <= 0)
+        dref = DEQ_NEXT(dref);
+    if (!dref || !DEQ_NEXT(dref))
+        return;  // already in order
+
+    size_t               count = DEQ_SIZE(*list);
+    qdr_delivery_ref_t **refs  = NEW_PTR_ARRAY(qdr_delivery_ref_t, count);
+    size_t               i     = 0;
+    while ((dref = DEQ_HEAD(*list))) {
+        DEQ_REMOVE_HEAD(*list);
+        refs[i++] = dref;
+    }
+
+    qsort(refs, count, sizeof(qdr_delivery_ref_t*), qdr_delivery_ref_compare);
+    for (i = 0; i < count; i++)
+        DEQ_INSERT_TAIL(*list, refs[i]);
+    free(refs);
+}
+
+
 int qdr_connection_process(qdr_connection_t *conn)
 {
     if (!conn)
         return 0;
-    qdr_connection_work_list_t  work_list;
+    qdr_connection_work_list_t  work_list = DEQ_EMPTY;
     qdr_link_ref_list_t         links_with_work[QDR_N_PRIORITIES];
     qdr_core_t                 *core = conn->core;
     int                         event_count = 0;
@@ -382,6 +486,15 @@ int qdr_connection_process(qdr_connection_t *conn)
     qdr_link_ref_t *ref;
     qdr_link_t     *link;
     bool            detach_sent;
+    int             lanes_with_work  = 0;
+    int             links_count      = 0;
+    bool            yielded          = false;
+    bool            budget_exhausted = false;
+    int             spent            = 0;  // of QDR_CONNECTION_PROCESS_BUDGET
+    qdr_link_ref_t *resume_ref[QDR_N_PRIORITIES] = {0};  // first link not reached when the budget ran out
+
+    // Clear before taking the work: an activation arriving after this point is delivered again
+    CLEAR_ATOMIC_FLAG(&conn->activation_pending);
 
     sys_mutex_lock(&conn->work_lock);
 
@@ -393,7 +506,6 @@ int qdr_connection_process(qdr_connection_t *conn)
         return 0;
     }
 
-    DEQ_MOVE(conn->work_list, work_list);
     for (int priority = 0; priority <= QDR_MAX_PRIORITY; ++ priority) {
         DEQ_MOVE(conn->links_with_work[priority], links_with_work[priority]);
 
@@ -407,10 +519,37 @@ int qdr_connection_process(qdr_connection_t *conn)
             ref->link->processing = true;
             ref = DEQ_NEXT(ref);
         }
+
+        if (DEQ_SIZE(links_with_work[priority]) > 0)
+            lanes_with_work++;
+        links_count += DEQ_SIZE(links_with_work[priority]);
     }
     sys_mutex_unlock(&conn->work_lock);
 
+    // Taken after the links: the connection work that created a link taken above (its first attach) was posted before
+    // that link's work, so it is taken here too and processed ahead of it.
+    qdr_connection_work_take(conn, &work_list);
+
+    //
+    // If links of more than one priority have work, share this pass between the priority lanes
+    // by deficit round-robin: each lane may push up to its quantum of deliveries (plus any
+    // deficit left from the previous pass).  Links of a lane that used up its share stay queued
+    // and the connection is activated again, so that work arriving for a higher priority does not
+    // wait behind the whole backlog of a lower one.
+    //
+    const bool share_lanes = lanes_with_work > 1;
+
+    //
+    // The pass handles at most QDR_CONNECTION_PROCESS_BUDGET work items, disposition updates and deliveries, so that a
+    // connection with many busy links does not hold its I/O thread for long.  The budget is shared among the links with
+    // work: a link that used its share, and the links not reached when the budget ran out, stay queued - the latter
+    // ahead of the others - and the connection is activated again.
+    //
+    const int link_quantum = links_count > 1 ? MAX(QDR_CONNECTION_PROCESS_BUDGET / links_count, QDR_LINK_PROCESS_MIN_QUANTUM)
+                                             : QDR_CONNECTION_PROCESS_BUDGET;
+
     event_count += DEQ_SIZE(work_list);
+    spent       += DEQ_SIZE(work_list);
     qdr_connection_work_t *work = DEQ_HEAD(work_list);
     while (work) {
         DEQ_REMOVE_HEAD(work_list);
@@ -440,12 +579,26 @@ int qdr_connection_process(qdr_connection_t *conn)
 
     // Process the links_with_work array from highest to lowest priority.
     for (int priority = QDR_MAX_PRIORITY; priority >= 0; -- priority) {
+        bool lane_yielded = false;
+
         ref = DEQ_HEAD(links_with_work[priority]);
+        if (ref && share_lanes && spent < QDR_CONNECTION_PROCESS_BUDGET)
+            conn->lane_deficit[priority] += core->priority_lane_quantum[priority];
+
         while (ref) {
             qdr_link_work_t *link_work;
             detach_sent = false;
             link = ref->link;
 
+            if (spent >= QDR_CONNECTION_PROCESS_BUDGET) {
+                budget_exhausted     = true;
+                lane_yielded         = true;
+                resume_ref[priority] = ref;
+                for (; ref; ref = DEQ_NEXT(ref))
+                    ref->link->lane_yielded = true;
+                break;
+            }
+
             //
             // The work lock must be used to protect accesses to the link's work_list and
             // link_work->processing.
@@ -466,6 +619,7 @@ int qdr_connection_process(qdr_connection_t *conn)
             sys_mutex_lock(&conn->work_lock);
             DEQ_MOVE(link->updated_deliveries, updated_deliveries);
             sys_mutex_unlock(&conn->work_lock);
+            qdr_sort_updated_deliveries(&updated_deliveries);
 
             qdr_delivery_ref_t *dref = DEQ_HEAD(updated_deliveries);
             while (dref) {
@@ -474,15 +628,32 @@ int qdr_connection_process(qdr_connection_t *conn)
                 qdr_del_delivery_ref(&updated_deliveries, dref);
                 dref = DEQ_HEAD(updated_deliveries);
                 event_count++;
+                spent++;
             }
 
             while (link_work) {
                 switch (link_work->work_type) {
                 case QDR_LINK_WORK_DELIVERY :
                     {
-                        int count = conn->protocol_adaptor->push_handler(conn->protocol_adaptor->user_context, link, link_work->value);
-                        assert(count <= link_work->value);
+                        int limit = link_work->value;
+                        if (share_lanes)
+                            limit = MIN(limit, MAX(conn->lane_deficit[priority], 0));
+                        limit = MIN(limit, MIN(link_quantum, MAX(QDR_CONNECTION_PROCESS_BUDGET - spent, 0)));
+
+                        int count = limit > 0 ? conn->protocol_adaptor->push_handler(conn->protocol_adaptor->user_context, link, limit) : 0;
+                        assert(count <= limit);
                         link_work->value -= count;
+                        spent            += count;
+
+                        if (share_lanes)
+                            conn->lane_deficit[priority] -= count;
+                        if (count == limit && link_work->value > 0) {
+                            // Stopped by the lane's share or the budget rather than by credit or lack of deliveries
+                            link->lane_yielded = true;
+                            lane_yielded       = true;
+                            if (spent >= QDR_CONNECTION_PROCESS_BUDGET)
+                                budget_exhausted = true;
+                        }
                         break;
                     }
 
@@ -522,6 +693,7 @@ int qdr_connection_process(qdr_connection_t *conn)
                 }
                 sys_mutex_unlock(&conn->work_lock);
                 event_count++;
+                spent++;
             }
 
             if (!detach_sent) {
@@ -530,24 +702,49 @@ int qdr_connection_process(qdr_connection_t *conn)
 
             ref = DEQ_NEXT(ref);
         }
+
+        //
+        // A lane that was not cut short has no backlog to carry a deficit for.
+        //
+        if (lane_yielded)
+            yielded = true;
+        else
+            conn->lane_deficit[priority] = 0;
     }
 
     sys_mutex_lock(&conn->work_lock);
     for (int priority = QDR_MAX_PRIORITY; priority >= 0; -- priority) {
-        ref = DEQ_HEAD(links_with_work[priority]);
+        // Requeue the links not reached first, then the links processed in this pass
+        ref = resume_ref[priority] ? resume_ref[priority] : DEQ_HEAD(links_with_work[priority]);
         while (ref) {
-            qdr_link_t *link = ref->link;
+            qdr_link_ref_t *next = DEQ_NEXT(ref);
+            qdr_link_t     *link = ref->link;
 
             link->processing = false;
             if (link->ready_to_free)
                 qdr_link_processing_complete(core, link);
+            else if (link->lane_yielded) {
+                qdr_add_link_ref(&conn->links_with_work[priority], link, QDR_LINK_LIST_CLASS_WORK);
+                yielded = true;
+            }
+            link->lane_yielded = false;
 
-            qdr_del_link_ref(links_with_work + priority, ref->link, QDR_LINK_LIST_CLASS_LOCAL);
-            ref = DEQ_HEAD(links_with_work[priority]);
+            qdr_del_link_ref(links_with_work + priority, link, QDR_LINK_LIST_CLASS_LOCAL);
+            ref = next ? next : DEQ_HEAD(links_with_work[priority]);
         }
     }
     sys_mutex_unlock(&conn->work_lock);
 
+    if (budget_exhausted)
+        atomic_fetch_add_explicit(&conn->budget_exhausted, 1, memory_order_relaxed);
+
+    //
+    // Come back for the work that was held back to share the pass between priority lanes, or
+    // between links that used up their transfer quantum.
+    //
+    if (yielded && (!conn->protocol_adaptor->coalesce_activations || !SET_ATOMIC_FLAG(&conn->activation_pending)))
+        conn->protocol_adaptor->activate_handler(conn->protocol_adaptor->user_context, conn);
+
     return event_count;
 }
 
@@ -638,6 +835,12 @@ void qdr_link_stalled_outbound(qdr_link_t *link)
 }
 
 
+void qdr_link_yield_outbound(qdr_link_t *link)
+{
+    link->lane_yielded = true;
+}
+
+
 void qdr_link_set_user_streaming(qdr_link_t *link)
 {
     link->user_streaming = true;
@@ -815,16 +1018,32 @@ void qdr_connection_enqueue_work_CT(qdr_core_t            *core,
                                     qdr_connection_t      *conn,
                                     qdr_connection_work_t *work)
 {
-    sys_mutex_lock(&conn->work_lock);
-    DEQ_INSERT_TAIL(conn->work_list, work);
-    bool notify = DEQ_SIZE(conn->work_list) == 1;
-    sys_mutex_unlock(&conn->work_lock);
+    void *head = sys_atomic_ptr_get(&conn->work_stack);
+    do {
+        DEQ_NEXT(work) = (qdr_connection_work_t*) head;
+    } while (!sys_atomic_ptr_cas(&conn->work_stack, &head, work));
 
-    if (notify)
+    // Only the push onto an empty stack needs to activate, the I/O thread takes everything behind it in one go
+    if (!head)
         qdr_connection_activate_CT(core, conn);
 }
 
 
+void qdr_connection_work_take(qdr_connection_t *conn, qdr_connection_work_list_t *list)
+{
+    qdr_connection_work_t      *work = (qdr_connection_work_t*) sys_atomic_ptr_set(&conn->work_stack, 0);
+    qdr_connection_work_list_t  fifo = DEQ_EMPTY;
+
+    while (work) {
+        qdr_connection_work_t *older = DEQ_NEXT(work);
+        DEQ_ITEM_INIT(work);
+        DEQ_INSERT_HEAD(fifo, work);
+        work = older;
+    }
+    DEQ_APPEND(*list, fifo);
+}
+
+
 void qdr_link_enqueue_work_CT(qdr_core_t      *core,
                               qdr_link_t      *link,
                               qdr_link_work_t *work)
@@ -859,16 +1078,20 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
     // Clean up the lists of deliveries on this link
     //
     qdr_delivery_ref_list_t updated_deliveries;
-    qdr_delivery_list_t     undelivered;
+    qdr_delivery_ring_t     undelivered;
     qdr_delivery_list_t     unsettled;
     qdr_delivery_list_t     settled;
 
     sys_mutex_lock(&conn->work_lock);
     DEQ_MOVE(link->updated_deliveries, updated_deliveries);
 
-    DEQ_MOVE(link->undelivered, undelivered);
-    qdr_delivery_t *d = DEQ_HEAD(undelivered);
-    while (d) {
+    undelivered = link->undelivered;
+    ZERO(&link->undelivered);
+    qdr_delivery_t *d;
+    for (uint32_t pos = undelivered.head; undelivered.count && qdr_delivery_ring_before(&undelivered, pos); pos++) {
+        d = qdr_delivery_ring_at(&undelivered, pos);
+        if (!d)
+            continue;
         assert(d->where == QDR_DELIVERY_IN_UNDELIVERED);
         if (d->presettled)
             core->dropped_presettled_deliveries++;
@@ -877,7 +1100,6 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
             d->tracking_addr = 0;
         qdr_link_work_release(d->link_work);
         d->link_work = 0;
-        d = DEQ_NEXT(d);
     }
 
     DEQ_MOVE(link->unsettled, unsettled);
@@ -928,10 +1150,9 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
     // undelivereds can simply be destroyed.  If it's an outgoing link, the
     // undelivereds' peer deliveries need to be released.
     //
-    qdr_delivery_t *dlv = DEQ_HEAD(undelivered);
+    qdr_delivery_t *dlv = qdr_delivery_ring_pop(&undelivered);
     qdr_delivery_t *peer;
     while (dlv) {
-        DEQ_REMOVE_HEAD(undelivered);
 
         // expect: an inbound undelivered multicast should
         // have no peers (has not been forwarded yet)
@@ -949,7 +1170,9 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
                 qdr_delivery_mcast_outbound_update_CT(core, peer, dlv, PN_RELEASED, true);
             }
             else {
-                qdr_delivery_release_CT(core, peer);
+                // On shutdown the I/O threads are gone and every link is being freed: nobody is told of the release
+                if (!on_shutdown)
+                    qdr_delivery_release_CT(core, peer);
                 qdr_delivery_unlink_peers_CT(core, dlv, peer);
             }
             peer = qdr_delivery_next_peer_CT(dlv);
@@ -966,8 +1189,9 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
         //
         qdr_delivery_decref_CT(core, dlv, "qdr_link_cleanup_deliveries_CT - remove from undelivered list");
 
-        dlv = DEQ_HEAD(undelivered);
+        dlv = qdr_delivery_ring_pop(&undelivered);
     }
+    qdr_delivery_ring_free(&undelivered);
 
     //
     // Free the unsettled deliveries.
@@ -988,7 +1212,8 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
 
         if (!qdr_delivery_receive_complete(dlv)) {
             qdr_delivery_set_aborted(dlv);
-            qdr_delivery_continue_peers_CT(core, dlv, false);
+            if (!on_shutdown)
+                qdr_delivery_continue_peers_CT(core, dlv, false);
         }
 
         if (dlv->multicast) {
@@ -1008,7 +1233,7 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
                     //
                     qdr_delivery_mcast_outbound_update_CT(core, peer, dlv, PN_MODIFIED, true);
                 } else {
-                    if (link->link_direction == QD_OUTGOING)
+                    if (link->link_direction == QD_OUTGOING && !on_shutdown)
                         qdr_delivery_failed_CT(core, peer);
                     qdr_delivery_unlink_peers_CT(core, dlv, peer);
                 }
@@ -1037,7 +1262,8 @@ void qdr_link_cleanup_deliveries_CT(qdr_core_t *core, qdr_connection_t *conn, qd
 
         if (!qdr_delivery_receive_complete(dlv)) {
             qdr_delivery_set_aborted(dlv);
-            qdr_delivery_continue_peers_CT(core, dlv, false);
+            if (!on_shutdown)
+                qdr_delivery_continue_peers_CT(core, dlv, false);
         }
 
         peer = qdr_delivery_first_peer_CT(dlv);
@@ -1071,6 +1297,8 @@ static void qdr_link_cleanup_CT(qdr_core_t *core, qdr_connection_t *conn, qdr_li
     // link pool
     //
     DEQ_REMOVE(core->open_links, link);
+    qdr_link_delivery_age_remove_CT(core, link);
+    qdr_link_release_held_credit_CT(core, link);
 
     //
     // If the link has a core_endpoint, allow the core_endpoint module to
@@ -1133,10 +1361,7 @@ static void qdr_link_cleanup_CT(qdr_core_t *core, qdr_connection_t *conn, qdr_li
                          link,  QDR_LINK_LIST_CLASS_ADDRESS);
     }
 
-    if (link->in_streaming_pool) {
-        DEQ_REMOVE_N(STREAMING_POOL, conn->streaming_link_pool, link);
-        link->in_streaming_pool = false;
-    }
+    qdr_link_streaming_pool_remove_CT(core, link);
 
     //
     // Free the link's name and terminus_addr
@@ -1167,6 +1392,7 @@ static void qdr_link_cleanup_CT(qdr_core_t *core, qdr_connection_t *conn, qdr_li
     if (link->user_context) {
         qdr_link_set_context(link, 0);
     }
+    qdr_delivery_ring_free(&link->undelivered);
     free_qdr_link_t(link);
 }
 
@@ -1275,12 +1501,8 @@ void qdr_link_outbound_detach_CT(qdr_core_t *core, qdr_link_t *link, qdr_error_t
     //
     // Ensure a pooled link is no longer available for streaming messages
     //
-    if (link->streaming) {
-        if (link->in_streaming_pool) {
-            DEQ_REMOVE_N(STREAMING_POOL, link->conn->streaming_link_pool, link);
-            link->in_streaming_pool = false;
-        }
-    }
+    if (link->streaming)
+        qdr_link_streaming_pool_remove_CT(core, link);
 
     //
     // tell the I/O thread to do the detach
@@ -1381,7 +1603,8 @@ qd_address_treatment_t qdr_treatment_for_address_hash_with_default_CT(qdr_core_t
         //
         // Handle the mobile address case
         //
-        qd_iterator_t *config_iter = qd_iterator_string(&copy[1], ITER_VIEW_ADDRESS_NO_HOST);
+        qd_iterator_storage_t storage;
+        qd_iterator_t        *config_iter = qd_iterator_init_string(&storage, &copy[1], ITER_VIEW_ADDRESS_NO_HOST);
         qd_parse_tree_retrieve_match(core->addr_parse_tree, config_iter, (void **) &addr);
         if (addr)
             trt = addr->treatment;
@@ -1401,6 +1624,18 @@ qd_address_treatment_t qdr_treatment_for_address_hash_with_default_CT(qdr_core_t
  * Depending on its policy, the address may be eligible for being closed out
  * (i.e. Logging its terminal statistics and freeing its resources).
  */
+static inline bool qdr_address_unused_CT(qdr_address_t *addr)
+{
+    return DEQ_SIZE(addr->subscriptions) == 0
+        && DEQ_SIZE(addr->rlinks) == 0
+        && DEQ_SIZE(addr->inlinks) == 0
+        && qd_bitmask_cardinality(addr->rnodes) == 0
+        && addr->ref_count == 0
+        && addr->tracked_deliveries == 0
+        && qdr_address_core_endpoint(addr) == 0;
+}
+
+
 void qdr_check_addr_CT(qdr_core_t *core, qdr_address_t *addr)
 {
     if (addr == 0)
@@ -1410,18 +1645,119 @@ void qdr_check_addr_CT(qdr_core_t *core, qdr_address_t *addr)
     // If the address has no in-process consumer or destinations, it should be
     // deleted.
     //
-    if (DEQ_SIZE(addr->subscriptions) == 0
-        && DEQ_SIZE(addr->rlinks) == 0
-        && DEQ_SIZE(addr->inlinks) == 0
-        && qd_bitmask_cardinality(addr->rnodes) == 0
-        && addr->ref_count == 0
-        && addr->tracked_deliveries == 0
-        && addr->core_endpoint == 0) {
+    if (qdr_address_unused_CT(addr)) {
         qdr_core_remove_address(core, addr);
     }
 }
 
 
+bool qdr_address_reusable_CT(const qdr_address_t *addr)
+{
+    return addr->ext && addr->ext->pool_conn;
+}
+
+
+void qdr_dynamic_addr_adopt_CT(qdr_core_t *core, qdr_connection_t *conn, qd_direction_t dir, qdr_address_t *addr,
+                               const char *address)
+{
+    if (core->dynamic_addr_pool_size == 0 || !conn)
+        return;
+
+    qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+    ext->pool_conn    = conn;
+    ext->pool_dir     = dir;
+    ext->pool_address = qd_strdup(address);
+    ext->pool_prev    = 0;
+    ext->pool_next    = conn->dynamic_addr_adopted;
+    if (ext->pool_next)
+        ext->pool_next->ext->pool_prev = addr;
+    conn->dynamic_addr_adopted = addr;
+}
+
+
+void qdr_dynamic_addr_forget_CT(qdr_address_t *addr)
+{
+    qdr_address_ext_t *ext = addr->ext;
+    if (!ext || !ext->pool_conn)
+        return;
+
+    if (ext->pool_prev)
+        ext->pool_prev->ext->pool_next = ext->pool_next;
+    else
+        ext->pool_conn->dynamic_addr_adopted = ext->pool_next;
+    if (ext->pool_next)
+        ext->pool_next->ext->pool_prev = ext->pool_prev;
+    ext->pool_prev = 0;
+    ext->pool_next = 0;
+    ext->pool_conn = 0;
+}
+
+
+qdr_address_t *qdr_dynamic_addr_take_CT(qdr_core_t *core, qdr_connection_t *conn, qd_direction_t dir,
+                                        qdr_terminus_t *terminus)
+{
+    if (!conn || conn->dynamic_addr_pool_count[dir] == 0)
+        return 0;
+
+    qdr_address_t **pool = conn->dynamic_addr_pool + dir * core->dynamic_addr_pool_size;
+    qdr_address_t  *addr = pool[--conn->dynamic_addr_pool_count[dir]];
+    addr->ref_count--;  // the pool's reference, the caller binds a link before anything checks the address
+    qdr_terminus_set_address(terminus, addr->ext->pool_address);
+    return addr;
+}
+
+
+/**
+ * The address stops being reusable: its deferred proxy withdrawal happens now.
+ */
+static void qdr_dynamic_addr_release_CT(qdr_core_t *core, qdr_address_t *addr)
+{
+    qdr_dynamic_addr_forget_CT(addr);
+    qdrc_event_addr_raise(core, QDRC_EVENT_ADDR_POOL_RELEASED, addr);
+}
+
+
+void qdr_dynamic_addr_detached_CT(qdr_core_t *core, qdr_address_t *addr)
+{
+    if (!qdr_address_reusable_CT(addr) || !qdr_address_unused_CT(addr))
+        return;
+
+    qdr_connection_t *conn = addr->ext->pool_conn;
+    qd_direction_t    dir  = addr->ext->pool_dir;
+    if (conn->closed || conn->dynamic_addr_pool_count[dir] == core->dynamic_addr_pool_size) {
+        qdr_dynamic_addr_release_CT(core, addr);
+        return;
+    }
+
+    if (!conn->dynamic_addr_pool)
+        conn->dynamic_addr_pool = NEW_PTR_ARRAY(qdr_address_t, 2 * core->dynamic_addr_pool_size);
+    conn->dynamic_addr_pool[dir * core->dynamic_addr_pool_size + conn->dynamic_addr_pool_count[dir]++] = addr;
+    addr->ref_count++;
+}
+
+
+void qdr_dynamic_addr_pool_free_CT(qdr_core_t *core, qdr_connection_t *conn)
+{
+    for (int dir = 0; dir < 2; dir++) {
+        while (conn->dynamic_addr_pool_count[dir] > 0) {
+            qdr_address_t *addr =
+                conn->dynamic_addr_pool[dir * core->dynamic_addr_pool_size + --conn->dynamic_addr_pool_count[dir]];
+            addr->ref_count--;
+            qdr_dynamic_addr_release_CT(core, addr);
+            qdr_check_addr_CT(core, addr);
+        }
+    }
+    free(conn->dynamic_addr_pool);
+    conn->dynamic_addr_pool = 0;
+
+    //
+    // The addresses still in use, by the links of this or of other connections, are not reusable past its close
+    //
+    while (conn->dynamic_addr_adopted)
+        qdr_dynamic_addr_release_CT(core, conn->dynamic_addr_adopted);
+}
+
+
 /**
  * Process local and remote attributes for this address to see if action is needed.
  * 
@@ -1751,6 +2087,19 @@ static void qdr_connection_opened_CT(qdr_core_t *core, qdr_action_t *action, boo
         }
     } while (false);
 
+    //
+    // Pre-attach streaming links on the connections that carry streaming messages: inter-router data connections,
+    // edge connections and inter-router connections that do not trunk streams over data connections.
+    //
+    if (core->streaming_link_pool_min > 0) {
+        const bool streaming = conn->connection_info->streaming_links;
+        if (conn->role == QDR_ROLE_INTER_ROUTER_DATA
+            || (conn->role == QDR_ROLE_EDGE_CONNECTION && streaming)
+            || (conn->role == QDR_ROLE_INTER_ROUTER && streaming && !conn->connection_info->connection_trunking)) {
+            qdr_connection_warm_streaming_pool_CT(core, conn);
+        }
+    }
+
     qdrc_event_conn_raise(core, QDRC_EVENT_CONN_OPENED, conn);
 
     qdr_field_free(action->args.connection.connection_label);
@@ -1760,9 +2109,12 @@ static void qdr_connection_opened_CT(qdr_core_t *core, qdr_action_t *action, boo
 
 void qdr_connection_free(qdr_connection_t *conn)
 {
+    qdr_action_uncharge_CT(conn);
     sys_mutex_free(&conn->work_lock);
+    sys_atomic_destroy(&conn->activation_pending);
     qdr_error_free(conn->error);
     qdr_connection_info_free(conn->connection_info);
+    free(conn->dynamic_addr_pool);
     free_qdr_connection_t(conn);
 }
 
@@ -1804,6 +2156,55 @@ qdr_link_t *qdr_connection_new_streaming_link_CT(qdr_core_t *core, qdr_connectio
     return out_link;
 }
 
+
+//
+// Keep at least streamingLinkPoolMin idle streaming links in the connection's pool so that a new streaming message
+// never waits for a link attach. The links are created here and their attach completes in the background: a link
+// taken from the pool before its attach has been answered queues the message just as a link created on demand would.
+//
+void qdr_connection_warm_streaming_pool_CT(qdr_core_t *core, qdr_connection_t *conn)
+{
+    if (conn->closed)
+        return;
+
+    while (DEQ_SIZE(conn->streaming_link_pool) < core->streaming_link_pool_min) {
+        qdr_link_t *link = qdr_connection_new_streaming_link_CT(core, conn);
+        if (!link)
+            break;
+        qdr_link_streaming_pool_insert_CT(core, link);
+    }
+}
+
+
+void qdr_link_streaming_pool_insert_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    assert(!link->in_streaming_pool);
+    DEQ_INSERT_TAIL_N(STREAMING_POOL, link->conn->streaming_link_pool, link);
+    link->in_streaming_pool    = true;
+    link->streaming_idle_ticks = qdr_core_uptime_ticks(core);
+    link->in_idle_streaming    = true;
+    DEQ_INSERT_TAIL_N(STREAMING_IDLE, core->idle_streaming_links, link);
+
+    // The timer is left unscheduled while no link is pooled
+    qdr_core_timer_t *timer = core->streaming_link_idle_timer;
+    if (timer && !timer->scheduled)
+        qdr_core_timer_schedule_CT(core, timer, core->streaming_link_idle_timeout);
+}
+
+
+void qdr_link_streaming_pool_remove_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (link->in_streaming_pool) {
+        DEQ_REMOVE_N(STREAMING_POOL, link->conn->streaming_link_pool, link);
+        if (link->in_idle_streaming) {
+            DEQ_REMOVE_N(STREAMING_IDLE, core->idle_streaming_links, link);
+            link->in_idle_streaming = false;
+        }
+        link->in_streaming_pool = false;
+    }
+}
+
+
 static void qdr_connection_set_tracing_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     qdr_connection_t *conn = safe_deref_qdr_connection_t(action->args.connection.conn);
@@ -1875,6 +2276,11 @@ static void qdr_connection_notify_closed_CT(qdr_core_t *core, qdr_action_t *acti
     //        This involves the links and the dispositions of deliveries stored
     //        with the links.
     //
+    // The disposition updates for the peers of all the connection's deliveries are batched: each peer connection is
+    // locked and activated once rather than once per delivery.
+    //
+    qdr_dynamic_addr_pool_free_CT(core, conn);
+    qdr_delivery_push_batch_begin_CT(core);
     link_ref = DEQ_HEAD(conn->links);
     while (link_ref) {
         qdr_link_t *link = link_ref->link;
@@ -1887,6 +2293,7 @@ static void qdr_connection_notify_closed_CT(qdr_core_t *core, qdr_action_t *acti
         qdr_link_cleanup_CT(core, conn, link, "Link closed due to connection loss"); // link_cleanup disconnects and frees the ref.
         link_ref = DEQ_HEAD(conn->links);
     }
+    qdr_delivery_push_batch_flush_CT(core);
 
     if (conn->has_streaming_links) {
         assert(DEQ_IS_EMPTY(conn->streaming_link_pool));  // all links have been released
@@ -1896,11 +2303,13 @@ static void qdr_connection_notify_closed_CT(qdr_core_t *core, qdr_action_t *acti
     //
     // Discard items on the work list
     //
-    qdr_connection_work_t *work = DEQ_HEAD(conn->work_list);
+    qdr_connection_work_list_t work_list = DEQ_EMPTY;
+    qdr_connection_work_take(conn, &work_list);
+    qdr_connection_work_t *work = DEQ_HEAD(work_list);
     while (work) {
-        DEQ_REMOVE_HEAD(conn->work_list);
+        DEQ_REMOVE_HEAD(work_list);
         qdr_connection_work_free_CT(work);
-        work = DEQ_HEAD(conn->work_list);
+        work = DEQ_HEAD(work_list);
     }
 
     //
@@ -1917,7 +2326,9 @@ static void qdr_connection_notify_closed_CT(qdr_core_t *core, qdr_action_t *acti
     // inter-router connections and inter-edge connections etc.
     // Normal client connections will log at DEBUG level since these are high frequency log messages.
     qd_log(LOG_ROUTER_CORE, conn->role == QDR_ROLE_NORMAL ? QD_LOG_DEBUG : QD_LOG_INFO, "[C%" PRIu64 "] Connection Closed", conn->identity);
+    qd_flight_record(QD_FLIGHT_CONN_CLOSED, conn->identity, conn->role, 0);
 
+    qdr_priority_lane_stats_merge(core->closed_lane_stats, conn->lane_stats);
     DEQ_REMOVE(core->open_connections, conn);
     qdr_connection_free(conn);
 }
@@ -2023,16 +2434,19 @@ static void qdr_detach_link_control_CT(qdr_core_t *core, qdr_connection_t *conn,
         //
         // Optimization: immediately notify the routing agent that this path is no longer present (rather than wait for
         // heartbeat timeout). This should only be done if the connection is the active control connection and there's
-        // no pending connection to take over:
+        // no pending connection to take over, and only once: the neighbor_liveness module posts it too when it closes
+        // the connection of a silent neighbor.
         //
         if (qd_bitmask_valid_bit_value(conn->mask_bit) &&
             core->rnode_conns_by_mask_bit[conn->mask_bit] == conn &&
-            core->pending_rnode_conns_by_mask_bit[conn->mask_bit] == 0) {
+            core->pending_rnode_conns_by_mask_bit[conn->mask_bit] == 0 &&
+            !conn->link_lost_posted) {
 
             qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
                    "[C%"PRIu64"] Notify routing agent of loss of control link [L%"PRIu64"]",
                    conn->identity, link->identity);
             qdr_post_link_lost_CT(core, conn->mask_bit);
+            conn->link_lost_posted = true;
         }
     }
 }
@@ -2079,8 +2493,9 @@ static void qdr_detach_link_data_CT(qdr_core_t *core, qdr_connection_t *conn, qd
 
 static void qdr_attach_link_downlink_CT(qdr_core_t *core, qdr_connection_t *conn, qdr_link_t *link, qdr_terminus_t *source)
 {
-    qdr_address_t *addr;
-    qd_iterator_t *iter = qd_iterator_dup(qdr_terminus_get_address(source));
+    qdr_address_t        *addr;
+    qd_iterator_storage_t storage;
+    qd_iterator_t        *iter = qd_iterator_init_dup(&storage, qdr_terminus_get_address(source));
     qd_iterator_reset_view(iter, ITER_VIEW_ADDRESS_HASH);
     qd_iterator_annotate_prefix(iter, QD_ITER_HASH_PREFIX_EDGE_SUMMARY);
 
@@ -2111,7 +2526,7 @@ static void qdr_link_process_initial_delivery_CT(qdr_core_t *core, qdr_link_t *l
             break;
 
         case QDR_DELIVERY_IN_UNDELIVERED:
-            DEQ_REMOVE(old_link->undelivered, dlv);
+            qdr_delivery_ring_remove(&old_link->undelivered, dlv);
             dlv->where = QDR_DELIVERY_NOWHERE;
             qdr_link_work_release(dlv->link_work);
             dlv->link_work = 0;
@@ -2263,7 +2678,7 @@ static void qdr_link_inbound_first_attach_CT(qdr_core_t *core, qdr_action_t *act
             if (qdr_terminus_is_anonymous(target)) {
                 link->owning_addr = 0;
                 qdr_link_outbound_second_attach_CT(core, link, source, target);
-                qdr_link_issue_credit_CT(core, link, link->capacity, false);
+                qdr_link_issue_initial_credit_CT(core, link);
 
             } else {
                 //
@@ -2403,7 +2818,7 @@ static void qdr_link_inbound_second_attach_CT(qdr_core_t *core, qdr_action_t *ac
             //
             qdr_address_t *addr = link->owning_addr;
             if (!addr || (DEQ_SIZE(addr->subscriptions) || DEQ_SIZE(addr->rlinks) || qd_bitmask_cardinality(addr->rnodes)))
-                qdr_link_issue_credit_CT(core, link, link->capacity, false);
+                qdr_link_issue_initial_credit_CT(core, link);
             break;
 
         case QD_LINK_ROUTER:
@@ -2467,12 +2882,8 @@ static void qdr_link_process_detach(qdr_core_t *core, qdr_link_t *link, qdr_erro
     //
     // ensure a pooled link is no longer available for use
     //
-    if (link->streaming) {
-        if (link->in_streaming_pool) {
-            DEQ_REMOVE_N(STREAMING_POOL, conn->streaming_link_pool, link);
-            link->in_streaming_pool = false;
-        }
-    }
+    if (link->streaming)
+        qdr_link_streaming_pool_remove_CT(core, link);
 
     //
     // Notify the auto-link that the link is coming down so a new link will be initiated.
@@ -2566,6 +2977,7 @@ static void qdr_link_process_detach(qdr_core_t *core, qdr_link_t *link, qdr_erro
     //
     if (addr) {
         addr->ref_count--;
+        qdr_dynamic_addr_detached_CT(core, addr);
         qdr_check_addr_CT(core, addr);
     }
 }
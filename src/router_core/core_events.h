@@ -40,6 +40,8 @@ typedef uint32_t qdrc_event_t;
  * QDRC_EVENT_CONN_EDGE_LOST             An edge connection has been lost
  * QDRC_EVENT_CONN_MESH_PEER_ESTABLISHED An active connection to an edge peer has been established
  * QDRC_EVENT_CONN_MESH_PEER_LOST        The active connection to an adge peer has been lost
+ * QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED An edge connection has become an additional active uplink (edgeUplinks > 1)
+ * QDRC_EVENT_CONN_EDGE_UPLINK_LOST      An additional active uplink has been lost
  *
  * QDRC_EVENT_LINK_IN_ATTACHED           (not implemented)
  * QDRC_EVENT_LINK_IN_DETACHED           An inlink has been detached
@@ -56,6 +58,7 @@ typedef uint32_t qdrc_event_t;
  * QDRC_EVENT_ADDR_REMOVED_REMOTE_DEST   A remote destination was removed for this address
  * QDRC_EVENT_ADDR_BECAME_SOURCE         An address transitioned from zero to one local source (inlink)
  * QDRC_EVENT_ADDR_NO_LONGER_SOURCE      An address transitioned from one to zero local sources (inlink)
+ * QDRC_EVENT_ADDR_POOL_RELEASED         A reusable dynamic address was released by its connection's pool
  * QDRC_EVENT_ADDR_WATCH_ON              A watch was started for an address
  * QDRC_EVENT_ADDR_WATCH_OFF             A watch was ended for an address
  * QDRC_EVENT_ADDR_LOCAL_CHANGED         An attribute (MAU address descriptor data) was updated for an address
@@ -73,7 +76,9 @@ typedef uint32_t qdrc_event_t;
 #define QDRC_EVENT_CONN_EDGE_LOST             0x00000008
 #define QDRC_EVENT_CONN_MESH_PEER_ESTABLISHED 0x00000010
 #define QDRC_EVENT_CONN_MESH_PEER_LOST        0x00000020
-#define _QDRC_EVENT_CONN_RANGE                0x0000003F
+#define QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED 0x00400000
+#define QDRC_EVENT_CONN_EDGE_UPLINK_LOST      0x00800000
+#define _QDRC_EVENT_CONN_RANGE                0x00C0003F
 
 #define QDRC_EVENT_LINK_IN_ATTACHED           0x00000040
 #define QDRC_EVENT_LINK_IN_DETACHED           0x00000080
@@ -89,13 +94,14 @@ typedef uint32_t qdrc_event_t;
 #define QDRC_EVENT_ADDR_REMOVED_LOCAL_DEST    0x00008000
 #define QDRC_EVENT_ADDR_ADDED_REMOTE_DEST     0x00010000
 #define QDRC_EVENT_ADDR_REMOVED_REMOTE_DEST   0x00020000
+#define QDRC_EVENT_ADDR_POOL_RELEASED         0x00040000
 #define QDRC_EVENT_ADDR_BECAME_SOURCE         0x00100000
 #define QDRC_EVENT_ADDR_NO_LONGER_SOURCE      0x00200000
 #define QDRC_EVENT_ADDR_WATCH_ON              0x01000000
 #define QDRC_EVENT_ADDR_WATCH_OFF             0x02000000
 #define QDRC_EVENT_ADDR_LOCAL_CHANGED         0x04000000
 #define QDRC_EVENT_ADDR_REMOTE_CHANGED        0x08000000
-#define _QDRC_EVENT_ADDR_RANGE                0x0FFFF000
+#define _QDRC_EVENT_ADDR_RANGE                0x0F3FF000
 
 #define QDRC_EVENT_ROUTER_ADDED               0x10000000
 #define QDRC_EVENT_ROUTER_REMOVED             0x20000000
@@ -39,8 +39,9 @@ void qdrc_endpoint_bind_mobile_address_CT(qdr_core_t           *core,
                                           qdrc_endpoint_desc_t *desc,
                                           void                 *bind_context)
 {
-    qdr_address_t *addr = 0;
-    qd_iterator_t *iter = qd_iterator_string(address, ITER_VIEW_ADDRESS_HASH);
+    qdr_address_t        *addr = 0;
+    qd_iterator_storage_t storage;
+    qd_iterator_t        *iter = qd_iterator_init_string(&storage, address, ITER_VIEW_ADDRESS_HASH);
 
     qd_hash_retrieve(core->addr_hash, iter, (void*) &addr);
     if (!addr) {
@@ -53,9 +54,10 @@ void qdrc_endpoint_bind_mobile_address_CT(qdr_core_t           *core,
         qd_hash_insert(core->addr_hash, iter, addr, &addr->hash_handle);
     }
 
-    assert(addr->core_endpoint == 0);
-    addr->core_endpoint         = desc;
-    addr->core_endpoint_context = bind_context;
+    qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+    assert(ext->core_endpoint == 0);
+    ext->core_endpoint         = desc;
+    ext->core_endpoint_context = bind_context;
 
     qd_iterator_free(iter);
 }
@@ -175,13 +177,13 @@ void qdrc_endpoint_do_bound_attach_CT(qdr_core_t *core, qdr_address_t *addr, qdr
 {
     qdrc_endpoint_t *ep = new_qdrc_endpoint_t();
     ZERO(ep);
-    ep->desc = addr->core_endpoint;
+    ep->desc = addr->ext->core_endpoint;
     ep->link = link;
 
     link->core_endpoint = ep;
     link->owning_addr   = addr;
 
-    ep->desc->on_first_attach(addr->core_endpoint_context, ep, &ep->link_context, source, target);
+    ep->desc->on_first_attach(addr->ext->core_endpoint_context, ep, &ep->link_context, source, target);
 }
 
 
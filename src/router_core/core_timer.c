@@ -49,35 +49,35 @@ qdr_core_timer_t *qdr_core_timer_CT(qdr_core_t *core, qdr_timer_cb_t callback, v
 }
 
 
+/**
+ * Place a scheduled timer into the wheel slot for its expiry relative to the current tick.
+ */
+static void qdr_core_timer_insert_CT(qdr_core_timer_wheel_t *wheel, qdr_core_timer_t *timer)
+{
+    uint64_t delta = timer->expiry - wheel->tick;
+    int      level = 0;
+
+    while (level < QDR_CORE_TIMER_WHEEL_LEVELS - 1
+           && delta >= ((uint64_t) 1 << (QDR_CORE_TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+
+    int slot = (int) (timer->expiry >> (QDR_CORE_TIMER_WHEEL_BITS * level)) & (QDR_CORE_TIMER_WHEEL_SLOTS - 1);
+    timer->slot = &wheel->slots[level][slot];
+    DEQ_INSERT_TAIL(*timer->slot, timer);
+}
+
+
 void qdr_core_timer_schedule_CT(qdr_core_t *core, qdr_core_timer_t *timer, uint32_t delay)
 {
     if (timer->scheduled)
         qdr_core_timer_cancel_CT(core, timer);
 
-    qdr_core_timer_t *ptr         = DEQ_HEAD(core->scheduled_timers);
-    uint32_t          time_before = 0;
-
-    while (ptr && time_before + ptr->delta_time_seconds <= delay) {
-        time_before += ptr->delta_time_seconds;
-        ptr = DEQ_NEXT(ptr);
-    }
-
     //
-    // ptr is the first timer to exceed duration or NULL if we ran out
+    // A delay of zero fires on the next tick
     //
-    timer->delta_time_seconds = delay - time_before;
-    timer->scheduled          = true;
-
-    if (!ptr)
-        DEQ_INSERT_TAIL(core->scheduled_timers, timer);
-    else {
-        ptr->delta_time_seconds -= timer->delta_time_seconds;
-        ptr = DEQ_PREV(ptr);
-        if (ptr)
-            DEQ_INSERT_AFTER(core->scheduled_timers, timer, ptr);
-        else
-            DEQ_INSERT_HEAD(core->scheduled_timers, timer);
-    }
+    timer->expiry    = core->timer_wheel.tick + delay + 1;
+    timer->scheduled = true;
+    qdr_core_timer_insert_CT(&core->timer_wheel, timer);
 }
 
 
@@ -85,10 +85,8 @@ void qdr_core_timer_cancel_CT(qdr_core_t *core, qdr_core_timer_t *timer)
 {
     if (timer->scheduled) {
         timer->scheduled = false;
-        if (DEQ_NEXT(timer)) {
-            DEQ_NEXT(timer)->delta_time_seconds += timer->delta_time_seconds;
-        }
-        DEQ_REMOVE(core->scheduled_timers, timer);
+        DEQ_REMOVE(*timer->slot, timer);
+        timer->slot = 0;
     }
 }
 
@@ -110,22 +108,45 @@ void qdr_process_tick_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 
     sys_atomic_inc(&core->uptime_ticks);
 
-    qdr_core_timer_t *timer = DEQ_HEAD(core->scheduled_timers);
-    qdr_core_timer_t *timer_next = 0;
+    qdr_core_timer_wheel_t *wheel = &core->timer_wheel;
+    uint64_t                tick  = ++wheel->tick;
+
+    //
+    // Each time a level wraps, move the timers in the next slot of the level above down the wheel.  Go top-down so
+    // timers cascade through all levels that wrap on this tick.
+    //
+    for (int level = QDR_CORE_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        uint64_t span = (uint64_t) 1 << (QDR_CORE_TIMER_WHEEL_BITS * level);
+        if ((tick & (span - 1)) == 0) {
+            int                   slot  = (int) (tick >> (QDR_CORE_TIMER_WHEEL_BITS * level)) & (QDR_CORE_TIMER_WHEEL_SLOTS - 1);
+            qdr_core_timer_list_t timers = DEQ_EMPTY;
+            DEQ_MOVE(wheel->slots[level][slot], timers);
+
+            qdr_core_timer_t *timer = DEQ_HEAD(timers);
+            while (timer) {
+                DEQ_REMOVE_HEAD(timers);
+                qdr_core_timer_insert_CT(wheel, timer);
+                timer = DEQ_HEAD(timers);
+            }
+        }
+    }
 
-    while (timer && timer->delta_time_seconds == 0) {
-        assert(timer->scheduled);
+    //
+    // Everything in the current level-0 slot expires on this tick.  Handlers may schedule or cancel other timers,
+    // so always take the head of the slot.
+    //
+    qdr_core_timer_list_t *expired = &wheel->slots[0][tick & (QDR_CORE_TIMER_WHEEL_SLOTS - 1)];
+    qdr_core_timer_t      *timer   = DEQ_HEAD(*expired);
+
+    while (timer) {
+        assert(timer->scheduled && timer->expiry == tick);
+        DEQ_REMOVE_HEAD(*expired);
         timer->scheduled = false;
-        timer_next = DEQ_NEXT(timer);
-        DEQ_REMOVE(core->scheduled_timers, timer);
+        timer->slot      = 0;
 
         if (timer->handler)
             timer->handler(core, timer->context);
 
-        timer = timer_next;
+        timer = DEQ_HEAD(*expired);
     }
-
-    if (timer)
-        timer->delta_time_seconds--;
 }
-
@@ -18,10 +18,16 @@
  */
 
 #include "delivery.h"
+#include "trace_probes.h"
+
+#include "qpid/dispatch/static_assert.h"
 
 #include <inttypes.h>
+#include <stddef.h>
 
 ALLOC_DEFINE(qdr_delivery_t);
+STATIC_ASSERT(offsetof(qdr_delivery_t, context) + sizeof(void *) <= QDR_HOT_FIELDS_SIZE,
+              qdr_delivery_t_hot_fields_exceed_a_cache_line);
 
 
 static void qdr_update_delivery_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
@@ -214,6 +220,20 @@ void qdr_delivery_remote_state_updated(qdr_core_t *core, qdr_delivery_t *deliver
 }
 
 
+void qdr_delivery_remote_received_updated(qdr_core_t *core, qdr_delivery_t *delivery, uint32_t section_number,
+                                          uint64_t section_offset)
+{
+    qdr_action_t *action = qdr_action(qdr_update_delivery_CT, "update_delivery");
+    action->args.delivery.delivery       = delivery;
+    action->args.delivery.disposition    = PN_RECEIVED;
+    action->args.delivery.section_number = section_number;
+    action->args.delivery.section_offset = section_offset;
+
+    qdr_delivery_incref(delivery, "qdr_delivery_remote_received_updated - add to action list");
+    qdr_action_enqueue(core, action);
+}
+
+
 qdr_delivery_t *qdr_delivery_continue(qdr_core_t *core,qdr_delivery_t *in_dlv, bool settled)
 {
 
@@ -330,11 +350,34 @@ bool qdr_delivery_settled_CT(qdr_core_t *core, qdr_delivery_t *dlv) TA_NO_THREAD
         DEQ_REMOVE(link->unsettled, dlv);
         dlv->where = QDR_DELIVERY_NOWHERE;
         moved = true;
+
+        if (qdr_link_capacity_adapts(link) && qdr_delivery_ring_size(&link->undelivered) == 0
+            && DEQ_SIZE(link->unsettled) + 1 >= link->capacity)
+            qdr_link_capacity_grow_CT(link);
     }
 
     if (link->link_direction == QD_OUTGOING)
         sys_mutex_unlock(&conn->work_lock);
 
+    //
+    // Feed the outgoing link's settlement-time average used by latency-aware balancing.
+    // The average moves 1/8 of the way toward each new sample.
+    //
+    if (moved && dlv->forwarded_ns) {
+        uint64_t elapsed = qdr_core_now_ns() - dlv->forwarded_ns;
+        if (link->settle_ewma_ns == 0)
+            link->settle_ewma_ns = elapsed;
+        else
+            link->settle_ewma_ns = link->settle_ewma_ns - (link->settle_ewma_ns >> 3) + (elapsed >> 3);
+        dlv->forwarded_ns = 0;
+    }
+
+    if (moved)
+        QD_PROBE_DELIVERY_SETTLE(dlv->conn_id, dlv->link_id, dlv->delivery_id, dlv->disposition);
+
+    if (moved && dlv->latency && link->link_direction == QD_OUTGOING)
+        qd_metric_observe(dlv->latency->settle, (qdr_core_now_ns() - dlv->ingress_ns) / 1000);
+
     if (dlv->tracking_addr) {
         dlv->tracking_addr->outstanding_deliveries[dlv->tracking_addr_bit]--;
         dlv->tracking_addr->tracked_deliveries--;
@@ -440,6 +483,7 @@ void qdr_delivery_increment_counters_CT(qdr_core_t *core, qdr_delivery_t *delive
                     link->settled_deliveries[link->rate_cursor] = 0;
                 }
                 link->core_ticks = qdr_core_uptime_ticks(core);
+                qdr_link_delivery_progress_CT(core, link);
             }
             link->settled_deliveries[link->rate_cursor]++;
         }
@@ -471,6 +515,9 @@ static void qdr_delete_delivery_internal_CT(qdr_core_t *core, qdr_delivery_t *de
         delivery->tracking_addr = 0;
     }
 
+    qdr_address_latency_decref_CT(delivery->latency);
+    delivery->latency = 0;
+
     qdr_delivery_increment_counters_CT(core, delivery);
 
     //
@@ -704,6 +751,10 @@ static void qdr_update_delivery_CT(qdr_core_t *core, qdr_action_t *action, bool
         return;
     }
 
+    qdr_link_t *dlv_link = qdr_delivery_link(dlv);
+    if (dlv_link && dlv_link->conn)
+        qdr_action_charge_CT(dlv_link->conn);
+
     if (dlv->multicast) {
         //
         // remote state change for *inbound* multicast delivery,
@@ -747,6 +798,10 @@ static void qdr_update_delivery_CT(qdr_core_t *core, qdr_action_t *action, bool
             qd_message_set_resend_released_annotation(msg, false);
         }
 
+        if (new_disp == PN_RECEIVED && !dstate) {
+            dlv->remote_section_number = action->args.delivery.section_number;
+            dlv->remote_section_offset = action->args.delivery.section_offset;
+        }
         qdr_delivery_set_remote_delivery_state_CT(dlv, new_disp, dstate);
         if (new_disp == PN_RELEASED && peer_incoming && !!msg && qd_message_is_resend_released(msg)) {
             qdr_delivery_anycast_reforward_CT(core, dlv, peer);
@@ -1189,9 +1244,8 @@ void qdr_delivery_continue_peers_CT(qdr_core_t *core, qdr_delivery_t *in_dlv, bo
                     // re-use this streaming link for the next streaming
                     // message since that new message will not be blocked
                     // indefinitely by the current message.
-                    DEQ_INSERT_TAIL_N(STREAMING_POOL, peer_link->conn->streaming_link_pool, peer_link);
-                    peer_link->in_streaming_pool = true;
-                    reuse_link                   = true;
+                    qdr_link_streaming_pool_insert_CT(core, peer_link);
+                    reuse_link = true;
                 }
             }
 
@@ -1247,6 +1301,8 @@ static void qdr_delivery_continue_CT(qdr_core_t *core, qdr_action_t *action, boo
     }
 
     qdr_link_t *link = qdr_delivery_link(in_dlv);
+    if (link && link->conn)
+        qdr_action_charge_CT(link->conn);
 
     //
     // If it is already in the undelivered list, don't try to deliver this again.
@@ -1324,6 +1380,17 @@ void qdr_delivery_push_CT(qdr_core_t *core, qdr_delivery_t *dlv)
     if (!link)
         return;
 
+    if (core->push_batching) {
+        if (core->push_batch_count == core->push_batch_capacity) {
+            core->push_batch_capacity = MAX(core->push_batch_capacity * 2, 64);
+            size_t size      = core->push_batch_capacity * sizeof(qdr_delivery_t*);
+            core->push_batch = (qdr_delivery_t**) (core->push_batch ? qd_realloc(core->push_batch, size) : qd_malloc(size));
+        }
+        qdr_delivery_incref(dlv, "qdr_delivery_push_CT - add to push batch");
+        core->push_batch[core->push_batch_count++] = dlv;
+        return;
+    }
+
     bool activate = false;
 
     sys_mutex_lock(&link->conn->work_lock);
@@ -1343,6 +1410,70 @@ void qdr_delivery_push_CT(qdr_core_t *core, qdr_delivery_t *dlv)
 }
 
 
+void qdr_delivery_push_batch_begin_CT(qdr_core_t *core)
+{
+    assert(!core->push_batching);
+    core->push_batching = true;
+}
+
+
+// order the staged deliveries by connection, then link
+static int push_batch_compare(const void *a, const void *b)
+{
+    qdr_link_t *la = qdr_delivery_link(*(qdr_delivery_t* const*) a);
+    qdr_link_t *lb = qdr_delivery_link(*(qdr_delivery_t* const*) b);
+    uintptr_t   ca = la ? (uintptr_t) la->conn : 0;
+    uintptr_t   cb = lb ? (uintptr_t) lb->conn : 0;
+    if (ca != cb)
+        return ca < cb ? -1 : 1;
+    return (uintptr_t) la < (uintptr_t) lb ? -1 : (uintptr_t) la > (uintptr_t) lb;
+}
+
+
+void qdr_delivery_push_batch_flush_CT(qdr_core_t *core)
+{
+    core->push_batching = false;
+    if (core->push_batch_count == 0)
+        return;
+
+    const size_t count = core->push_batch_count;
+    qsort(core->push_batch, count, sizeof(qdr_delivery_t*), push_batch_compare);
+
+    size_t i = 0;
+    while (i < count) {
+        qdr_link_t *link = qdr_delivery_link(core->push_batch[i]);
+        if (!link) {  // the link went away since the push, nothing left to update
+            i++;
+            continue;
+        }
+
+        qdr_connection_t *conn     = link->conn;
+        bool              activate = false;
+        sys_mutex_lock(&conn->work_lock);
+        for (; i < count; i++) {
+            qdr_delivery_t *dlv = core->push_batch[i];
+            link = qdr_delivery_link(dlv);
+            if (!link || link->conn != conn)
+                break;
+            if (dlv->where != QDR_DELIVERY_IN_UNDELIVERED) {
+                qdr_delivery_incref(dlv, "qdr_delivery_push_batch_flush_CT - add to updated list");
+                qdr_add_delivery_ref_CT(&link->updated_deliveries, dlv);
+                qdr_add_link_ref(&conn->links_with_work[link->priority], link, QDR_LINK_LIST_CLASS_WORK);
+                activate = true;
+            }
+        }
+        sys_mutex_unlock(&conn->work_lock);
+
+        if (activate)
+            qdr_connection_activate_CT(core, conn);
+    }
+
+    for (i = 0; i < count; i++)
+        qdr_delivery_decref_CT(core, core->push_batch[i], "qdr_delivery_push_batch_flush_CT - remove from push batch");
+    core->push_batch_count = 0;
+}
+
+
 // Set remote delivery state when proton indicates that the remote has updated
 // delivery. Ownership of *remote_state is passed to the delivery.
 //
@@ -1359,15 +1490,23 @@ static bool qdr_delivery_set_remote_delivery_state_CT(qdr_delivery_t *dlv, uint6
 
 
 // Called on the I/O thread: take local delivery state from the delivery for writing to proton.
-// Caller assumes ownership of state object.
+// Caller assumes ownership of state object.  PN_RECEIVED state is held inline and copied into
+// *received instead.
 //
-qd_delivery_state_t *qdr_delivery_take_local_delivery_state(qdr_delivery_t *dlv, uint64_t *dispo)
+qd_delivery_state_t *qdr_delivery_take_local_delivery_state(qdr_delivery_t *dlv, uint64_t *dispo, qd_delivery_state_t *received)
 {
     sys_mutex_lock(&dlv->dispo_lock);
 
     qd_delivery_state_t *dstate = dlv->local_state;
     dlv->local_state = 0;
     *dispo = dlv->disposition;
+    if (received) {
+        ZERO(received);
+        if (*dispo == PN_RECEIVED) {
+            received->section_number = dlv->local_section_number;
+            received->section_offset = dlv->local_section_offset;
+        }
+    }
     // if the disposition is not terminal, clear the state to allow another
     // disposition update.  Terminal dispositions are final and never update.
     if (!qd_delivery_state_is_terminal(dlv->disposition))
@@ -1399,7 +1538,15 @@ bool qdr_delivery_move_delivery_state_CT(qdr_delivery_t *dlv, qdr_delivery_t *pe
 
         peer->disposition = dispo;
         qd_delivery_state_t *old = peer->local_state;
-        peer->local_state = dstate;
+        if (dispo == PN_RECEIVED) {
+            // held inline: the I/O thread copies it out without taking ownership of a state object
+            peer->local_section_number = dstate ? dstate->section_number : dlv->remote_section_number;
+            peer->local_section_offset = dstate ? dstate->section_offset : dlv->remote_section_offset;
+            peer->local_state          = 0;
+        } else {
+            peer->local_state = dstate;
+            dstate            = 0;
+        }
 
         sys_mutex_unlock(&peer->dispo_lock);
 
@@ -1408,6 +1555,40 @@ bool qdr_delivery_move_delivery_state_CT(qdr_delivery_t *dlv, qdr_delivery_t *pe
             qd_delivery_state_free(old);
         }
     }
+    qd_delivery_state_free(dstate);  // PN_RECEIVED state copied inline, or no disposition
 
     return !!dispo;
 }
+
+
+void qdr_delivery_ring_make_room(qdr_delivery_ring_t *ring)
+{
+    uint32_t size     = ring->slots ? ring->mask + 1 : 0;
+    uint32_t new_size = size == 0 ? 16 : (ring->count <= size / 2 ? size : 2 * size);
+
+    qdr_delivery_t **slots = NEW_PTR_ARRAY(qdr_delivery_t, new_size);
+    uint32_t         count = 0;
+    for (uint32_t pos = ring->head; ring->count && pos != ring->tail; pos++) {
+        qdr_delivery_t *dlv = ring->slots[pos & ring->mask];
+        if (dlv) {
+            dlv->ring_pos  = count;
+            slots[count++] = dlv;
+        }
+    }
+    assert(count == ring->count);
+    for (uint32_t i = count; i < new_size; i++)
+        slots[i] = 0;
+
+    free(ring->slots);
+    ring->slots = slots;
+    ring->mask  = new_size - 1;
+    ring->head  = 0;
+    ring->tail  = count;
+}
+
+
+void qdr_delivery_ring_free(qdr_delivery_ring_t *ring)
+{
+    free(ring->slots);
+    ZERO(ring);
+}
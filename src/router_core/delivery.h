@@ -33,53 +33,148 @@ typedef enum {
 
 
 struct qdr_delivery_t {
+    //
+    // Hot: used for every delivery by the forwarder and the I/O threads.  Kept within the first
+    // QDR_HOT_FIELDS_SIZE octets, see the static asserts in delivery.c
+    //
     DEQ_LINKS(qdr_delivery_t);
-    void                   *context;
     sys_atomic_t            ref_count;
+    bool                    settled;
+    bool                    presettled; /// Proton does not have a notion of pre-settled. This flag is introduced in Dispatch and should exclusively be used only to update management counters like presettled delivery counts on links etc. This flag DOES NOT represent the remote settlement state of the delivery.
+    bool                    multicast;         /// True if this delivery is targeted for a multicast address.
+    bool                    via_edge;          /// True if this delivery arrived via an edge-connection.
+    qd_message_t           *msg;
     qdr_link_t_sp           link_sp;       /// Safe pointer to the link
-    qdr_link_t_sp           original_link_sp; /// Safe pointer to original link if this delivery was moved (via initial-delivery)
     qdr_delivery_t         *peer;          /// Use this peer if the delivery has one and only one peer.
+    void                   *context;
+
+    // Settlement, disposition and forwarding state
+    qdr_delivery_where_t    where;
+    uint32_t                ring_pos;          ///< Position in the link's undelivered ring while IN_UNDELIVERED
+    bool                    in_message_activation;
+    bool                    abort_outbound;    /// A re-forwarded streaming delivery needs to be aborted outbound
+    bool                    lane_counted;      /// Already recorded in its connection's priority lane stats
     qdr_delivery_ref_t     *next_peer_ref;
     qdr_delivery_ref_t     *cutthrough_list_ref;
-    qd_message_t           *msg;
-    qd_iterator_t          *to_addr;
-    qd_iterator_t          *origin;
+    qdr_link_work_t        *link_work;         ///< Delivery work item for this delivery
+    qdr_delivery_ref_list_t peers;                 /// Use this list if the delivery has more than one peer.
+    qdr_subscription_ref_list_t subscriptions;
     sys_mutex_t             dispo_lock;          ///< lock disposition and local_state fields
     uint64_t                disposition;         ///< local disposition, will be pushed to remote endpoint
     uint64_t                remote_disposition;  ///< disposition as set by remote endpoint
     uint64_t                mcast_disposition;   ///< temporary terminal disposition while multicast fwding
     qd_delivery_state_t    *remote_state;        ///< outcome-specific data read from remote endpoint
     qd_delivery_state_t    *local_state;         ///< outcome-specific data to send to remote endpoint
-    uint32_t                ingress_time;
-    qdr_delivery_where_t    where;
-    uint8_t                 tag[QDR_DELIVERY_TAG_MAX];
-    int                     tag_length;
+    uint64_t                remote_section_offset;  ///< PN_RECEIVED state read from remote endpoint, held inline
+    uint64_t                local_section_offset;   ///< PN_RECEIVED state to send to remote endpoint, held inline
+    uint32_t                remote_section_number;
+    uint32_t                local_section_number;
+    qd_iterator_t          *to_addr;
+    qd_iterator_t          *origin;
     qd_bitmask_t           *link_exclusion;
+    qdr_link_t             *chosen_link;           /// Pointer to link most recently chosen for forwarding.  This pointer shall never be dereferenced, only compared.
     qdr_address_t          *tracking_addr;
-    int                     tracking_addr_bit;
     int                     ingress_index;
-    qdr_link_work_t        *link_work;         ///< Delivery work item for this delivery
-    qdr_subscription_ref_list_t subscriptions;
-    qdr_delivery_ref_list_t peers;                 /// Use this list if the delivery has more than one peer.
-    qdr_link_t             *chosen_link;           /// Pointer to link most recently chosen for forwarding.  This pointer shall never be dereferenced, only compared.
     int                     chosen_neighbor;       /// Mask-bit of the most recently chosen neighbor router.
+    int                     tracking_addr_bit;
+    uint32_t                ingress_time;
+    uint64_t                forwarded_ns;        ///< When the out-delivery was queued (inter-router links, latency-aware balancing)
+    uint64_t                ingress_ns;          ///< When the delivery was handed to the core by its ingress link
+    qdr_address_latency_t  *latency;             ///< [ref] Histograms of a latency-tracked address, or NULL
+
+    // Cold: re-forwarding, stuck delivery detection and logging
+    qdr_link_t_sp           original_link_sp; /// Safe pointer to original link if this delivery was moved (via initial-delivery)
+    bool                    stuck;             /// True if this delivery was counted as stuck.
+    bool                    reforwarded;       /// True if this delivery was released and re-forwarded.
+    bool                    expired;           /// True if the forwarder dropped this delivery because its ttl ran out.
+    uint8_t                 tag[QDR_DELIVERY_TAG_MAX];
+    int                     tag_length;
+    uint32_t                delivery_id;           /// id for logging
     qd_bitmask_t           *invalidated_neighbors; /// Bitmask of all neighbor routers that have been invalidated in the lifetime of this delivery
     qdr_link_ref_list_t     invalidated_links;     /// List of links that have been invalidated.  These link pointer shall never be dereferenced, only compared.
-    uint32_t                delivery_id;           /// id for logging
     uint64_t                link_id;               /// id for logging
     uint64_t                conn_id;               /// id for logging
-    bool                    settled;
-    bool                    presettled; /// Proton does not have a notion of pre-settled. This flag is introduced in Dispatch and should exclusively be used only to update management counters like presettled delivery counts on links etc. This flag DOES NOT represent the remote settlement state of the delivery.
-    bool                    multicast;         /// True if this delivery is targeted for a multicast address.
-    bool                    via_edge;          /// True if this delivery arrived via an edge-connection.
-    bool                    stuck;             /// True if this delivery was counted as stuck.
-    bool                    reforwarded;       /// True if this delivery was released and re-forwarded.
-    bool                    abort_outbound;    /// A re-forwarded streaming delivery needs to be aborted outbound
-    bool                    in_message_activation;
 };
 
 ALLOC_DECLARE(qdr_delivery_t);
 
+//
+// Undelivered rings, see qdr_delivery_ring_t.  For an outgoing link the ring is protected by the connection's
+// work_lock.
+//
+
+// the slots of a ring that empties are freed if there are more than this
+#define QDR_DELIVERY_RING_KEEP 64
+
+/**
+ * Make room for one more delivery: allocate the slots of an empty ring, or move the deliveries into new slots, doubling
+ * their count unless the empty slots make up half of them.
+ */
+void qdr_delivery_ring_make_room(qdr_delivery_ring_t *ring);
+
+void qdr_delivery_ring_free(qdr_delivery_ring_t *ring);
+
+static inline qdr_delivery_t *qdr_delivery_ring_head(const qdr_delivery_ring_t *ring)
+{
+    return ring->count ? ring->slots[ring->head & ring->mask] : 0;
+}
+
+static inline void qdr_delivery_ring_push(qdr_delivery_ring_t *ring, qdr_delivery_t *dlv)
+{
+    if (!ring->slots || ring->tail - ring->head > ring->mask)
+        qdr_delivery_ring_make_room(ring);
+    dlv->ring_pos                          = ring->tail++;
+    ring->slots[dlv->ring_pos & ring->mask] = dlv;
+    ring->count++;
+}
+
+/**
+ * Take dlv, which must be held by the ring, out of it.
+ */
+static inline void qdr_delivery_ring_remove(qdr_delivery_ring_t *ring, qdr_delivery_t *dlv)
+{
+    assert(ring->count > 0 && ring->slots[dlv->ring_pos & ring->mask] == dlv);
+    ring->slots[dlv->ring_pos & ring->mask] = 0;
+    if (--ring->count == 0) {
+        ring->head = ring->tail = 0;
+        if (ring->mask >= QDR_DELIVERY_RING_KEEP)
+            qdr_delivery_ring_free(ring);
+    } else if (dlv->ring_pos == ring->head) {
+        do {
+            ring->head++;
+        } while (!ring->slots[ring->head & ring->mask]);
+    } else if (dlv->ring_pos == ring->tail - 1) {
+        do {
+            ring->tail--;
+        } while (!ring->slots[(ring->tail - 1) & ring->mask]);
+    }
+}
+
+static inline qdr_delivery_t *qdr_delivery_ring_pop(qdr_delivery_ring_t *ring)
+{
+    qdr_delivery_t *dlv = qdr_delivery_ring_head(ring);
+    if (dlv)
+        qdr_delivery_ring_remove(ring, dlv);
+    return dlv;
+}
+
+/**
+ * The delivery at a position between head and tail, 0 for an empty slot.  To walk a ring from the oldest delivery:
+ *
+ *     for (uint32_t pos = ring->head; ring->count && qdr_delivery_ring_before(ring, pos); pos++)
+ *
+ * which allows the delivery at pos to be removed.
+ */
+static inline qdr_delivery_t *qdr_delivery_ring_at(const qdr_delivery_ring_t *ring, uint32_t pos)
+{
+    return ring->slots[pos & ring->mask];
+}
+
+static inline bool qdr_delivery_ring_before(const qdr_delivery_ring_t *ring, uint32_t pos)
+{
+    return (int32_t) (ring->tail - pos) > 0;
+}
+
 /** Delivery Id for logging - thread safe
  */
 extern sys_atomic_t global_delivery_id;
@@ -145,6 +240,11 @@ void qdr_delivery_set_presettled(qdr_delivery_t *delivery);
 void qdr_delivery_remote_state_updated(qdr_core_t *core, qdr_delivery_t *delivery, uint64_t disp,
                                        bool settled, qd_delivery_state_t *dstate, bool ref_given);
 
+/* the remote end of the link has updated the non-terminal PN_RECEIVED state of the delivery, the frequent
+ * acknowledgement of streaming protocols: no delivery state object is allocated for it */
+void qdr_delivery_remote_received_updated(qdr_core_t *core, qdr_delivery_t *delivery, uint32_t section_number,
+                                          uint64_t section_offset);
+
 /* invoked when incoming message data arrives - schedule core thread */
 qdr_delivery_t *qdr_delivery_continue(qdr_core_t *core, qdr_delivery_t *delivery, bool settled);
 
@@ -163,6 +263,11 @@ bool qdr_delivery_settled_CT(qdr_core_t *core, qdr_delivery_t *delivery);
 /* add dlv to links list of updated deliveries and schedule I/O thread processing */
 void qdr_delivery_push_CT(qdr_core_t *core, qdr_delivery_t *dlv);
 
+/* Bulk teardown: between begin and flush pushes are staged and then posted with one work_lock and one activation per
+ * connection.  Not nested. */
+void qdr_delivery_push_batch_begin_CT(qdr_core_t *core);
+void qdr_delivery_push_batch_flush_CT(qdr_core_t *core);
+
 /* optimized decref for core thread */
 void qdr_delivery_decref_CT(qdr_core_t *core, qdr_delivery_t *delivery, const char *label);
 
@@ -21,22 +21,33 @@
 
 #include "delivery.h"
 #include "router_core_private.h"
+#include "trace_probes.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <strings.h>
 
 // #define LOG_FORWARD_BALANCED 1
 
 typedef struct qdr_forward_deliver_info_t {
-    DEQ_LINKS(struct qdr_forward_deliver_info_t);
     qdr_link_t     *out_link;
     qdr_delivery_t *out_dlv;
 } qdr_forward_deliver_info_t;
 
-ALLOC_DECLARE(qdr_forward_deliver_info_t);
-DEQ_DECLARE(qdr_forward_deliver_info_t, qdr_forward_deliver_info_list_t);
+//
+// The out-deliveries of one multicast fan-out.  They are collected while the destinations
+// are chosen and then pushed to their connections in per-connection groups, so that each
+// connection's work_lock is taken once per message rather than once per destination link.
+// Typical fan-outs fit in the inline entries; wider ones spill to the heap.
+//
+#define QDR_FORWARD_FANOUT_INLINE 32
 
-ALLOC_DEFINE(qdr_forward_deliver_info_t);
+typedef struct qdr_forward_fanout_t {
+    qdr_forward_deliver_info_t *entries;
+    int                         count;
+    int                         capacity;
+    qdr_forward_deliver_info_t  inline_entries[QDR_FORWARD_FANOUT_INLINE];
+} qdr_forward_fanout_t;
 
 
 // get the outgoing control link for a given inter-router connection
@@ -72,6 +83,19 @@ static inline qdr_link_t *peer_router_data_link(qdr_core_t *core,
 }
 
 
+//
+// True if the message is to be sent on a link of its own rather than on the shared link for its
+// destination: if it is still being received, or if it is larger than the transfer quantum.  A
+// delivery in progress on a link holds up the deliveries queued behind it, while deliveries on
+// different links are interleaved a quantum at a time.
+//
+static inline bool qdr_forward_streaming_CT(qdr_core_t *core, qd_message_t *msg, bool receive_complete)
+{
+    return !receive_complete
+        || (core->transfer_quantum_octets && qd_message_buffered_octets(msg) > core->transfer_quantum_octets);
+}
+
+
 // Get an idle anonymous link for a streaming message. This link will come from
 // either the connection's free link pool or it will be dynamically created on
 // the given connection.
@@ -103,11 +127,12 @@ static inline qdr_link_t *get_outgoing_streaming_link(qdr_core_t *core, qdr_conn
 
     qdr_link_t *out_link = DEQ_HEAD(conn->streaming_link_pool);
     if (out_link) {
-        DEQ_REMOVE_HEAD_N(STREAMING_POOL, conn->streaming_link_pool);
-        out_link->in_streaming_pool = false;
+        qdr_link_streaming_pool_remove_CT(core, out_link);
         qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
                "[C%" PRIu64 "][L%" PRIu64 "] Taking streaming link %s from free pool", conn->identity,
                out_link->identity, out_link->name);
+        // replace it so the next stream finds an attached link too
+        qdr_connection_warm_streaming_pool_CT(core, conn);
     } else {
         // no free links - create a new one
         out_link = qdr_connection_new_streaming_link_CT(core, conn);
@@ -116,6 +141,7 @@ static inline qdr_link_t *get_outgoing_streaming_link(qdr_core_t *core, qdr_conn
                    "[C%" PRIu64 "] Unable to setup new outgoing streaming message link", conn->identity);
             return 0;
         }
+        qdr_connection_warm_streaming_pool_CT(core, conn);
     }
     return out_link;
 }
@@ -137,32 +163,42 @@ static int qdr_forward_message_null_CT(qdr_core_t      *core,
 }
 
 
-static void qdr_forward_find_closest_remotes_CT(qdr_core_t *core, qdr_address_t *addr)
+//
+// Rebuild the address's cached list of remote forwarding candidates.  The list holds the
+// routers in addr->rnodes that currently have a path (direct link or next-hop), in order of
+// cost, least to most.  It is rebuilt only when core->cost_epoch has moved since the last
+// build.  Mobile-address sync moves an address's own epoch when its set of rnodes changes.
+//
+// Note that this algorithm assumes that the core's router list is sorted by cost, least to most.
+// Since the sorting work is done at router insert/delete, this algorithm is more efficient at forwarding
+// time.
+//
+static void qdr_forward_refresh_candidates_CT(qdr_core_t *core, qdr_address_t *addr)
 {
-    //
-    // Note that this algorithm assumes that the core's router list is sorted by cost, least to most.
-    // Since the sorting work is done at router insert/delete, this algorithm is more efficient at forwarding
-    // time.
-    //
-    qdr_node_t *rnode       = DEQ_HEAD(core->routers);
-    int         lowest_cost = 0;
+    int needed = qd_bitmask_cardinality(addr->rnodes);
+    if (needed > addr->remote_candidate_capacity) {
+        addr->remote_candidates = (qdr_forward_candidate_t*) realloc(addr->remote_candidates,
+                                                                     needed * sizeof(qdr_forward_candidate_t));
+        addr->remote_candidate_capacity = needed;
+    }
 
-    if (!addr->closest_remotes)
-        addr->closest_remotes = qd_bitmask(0);
-    addr->cost_epoch  = core->cost_epoch;
-    addr->next_remote = -1;
+    addr->cost_epoch             = core->cost_epoch;
+    addr->remote_candidate_count = 0;
+    addr->closest_count          = 0;
+    addr->next_remote            = 0;
 
-    qd_bitmask_clear_all(addr->closest_remotes);
-    while (rnode) {
+    qdr_node_t *rnode = DEQ_HEAD(core->routers);
+    while (rnode && addr->remote_candidate_count < needed) {
         if (qd_bitmask_value(addr->rnodes, rnode->mask_bit)) {
-            if (lowest_cost == 0) {
-                lowest_cost = rnode->cost;
-                addr->next_remote = rnode->mask_bit;
+            const int conn_bit = (rnode->next_hop) ? rnode->next_hop->conn_mask_bit : rnode->conn_mask_bit;
+            if (conn_bit >= 0) {
+                qdr_forward_candidate_t *cand = &addr->remote_candidates[addr->remote_candidate_count++];
+                cand->rnode    = rnode;
+                cand->conn_bit = conn_bit;
+                cand->cost     = rnode->cost;
+                if (cand->cost == addr->remote_candidates[0].cost)
+                    addr->closest_count++;
             }
-            if (lowest_cost == rnode->cost)
-                qd_bitmask_set_bit(addr->closest_remotes, rnode->mask_bit);
-            else
-                break;
         }
         rnode = DEQ_NEXT(rnode);
     }
@@ -189,6 +225,11 @@ qdr_delivery_t *qdr_forward_new_delivery_CT(qdr_core_t *core, qdr_delivery_t *in
         out_dlv->settled       = in_dlv->settled;
         out_dlv->ingress_time  = in_dlv->ingress_time;
         out_dlv->ingress_index = in_dlv->ingress_index;
+        if (in_dlv->latency) {
+            out_dlv->ingress_ns = in_dlv->ingress_ns;
+            out_dlv->latency    = in_dlv->latency;
+            out_dlv->latency->ref_count++;
+        }
         if (in_dlv->remote_disposition) {
             // propagate disposition state from remote to peer
             qdr_delivery_move_delivery_state_CT(in_dlv, out_dlv);
@@ -227,28 +268,24 @@ qdr_delivery_t *qdr_forward_new_delivery_CT(qdr_core_t *core, qdr_delivery_t *in
 //
 static void qdr_forward_drop_presettled_CT_LH(qdr_core_t *core, qdr_link_t *link) TA_REQ(link->conn->work_lock)
 {
-    qdr_delivery_t *dlv = DEQ_HEAD(link->undelivered);
+    qdr_delivery_ring_t *ring = &link->undelivered;
 
-    if (!dlv)
-        return;
     //
     // Remove leading delivery from consideration.
     // Parts of this message may have been transmitted already and dropping
     // it may corrupt outbound data.
     //
-    dlv = DEQ_NEXT(dlv);
-
-    qdr_delivery_t *next;
-
-    while (dlv) {
-        next = DEQ_NEXT(dlv);
+    for (uint32_t pos = ring->head + 1; ring->count && qdr_delivery_ring_before(ring, pos); pos++) {
+        qdr_delivery_t *dlv = qdr_delivery_ring_at(ring, pos);
+        if (!dlv)
+            continue;
         //
         // Remove pre-settled deliveries unless they are in a link_work
         // record that is being processed.  If it's being processed, it is
         // too late to drop the delivery.
         //
         if (dlv->settled && dlv->link_work && !dlv->link_work->processing) {
-            DEQ_REMOVE(link->undelivered, dlv);
+            qdr_delivery_ring_remove(ring, dlv);
             dlv->where = QDR_DELIVERY_NOWHERE;
 
             //
@@ -270,12 +307,11 @@ static void qdr_forward_drop_presettled_CT_LH(qdr_core_t *core, qdr_link_t *link
             link->dropped_presettled_deliveries++;
             core->dropped_presettled_deliveries++;
         }
-        dlv = next;
     }
 }
 
 
-void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery_t *out_dlv)
+static void qdr_forward_annotate_mesh_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery_t *out_dlv)
 {
     //
     // If we are an edge router and the outgoing link is an edge connection to the interior,
@@ -287,19 +323,33 @@ void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery
         && core->edge_mesh_identifier[0] != '\0') {
         qd_message_set_ingress_mesh(out_dlv->msg, core->edge_mesh_identifier);
     }
+}
 
-    sys_mutex_lock(&out_link->conn->work_lock);
+
+//
+// Place the delivery on the link's undelivered list and schedule link work for it.
+// The caller activates the connection after releasing the lock.
+//
+static void qdr_forward_deliver_CT_LH(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery_t *out_dlv) TA_REQ(out_link->conn->work_lock)
+{
+    if (qdr_link_capacity_adapts(out_link) && qdr_delivery_ring_size(&out_link->undelivered) >= out_link->capacity)
+        qdr_link_capacity_shrink_CT(out_link);
 
     //
-    // If the delivery is pre-settled and the outbound link is at or above capacity,
+    // If the delivery is pre-settled and the outbound link is at or above its drop threshold,
     // discard all pre-settled deliveries on the undelivered list prior to enqueuing
     // the new delivery.
     //
-    if (out_dlv->settled && out_link->capacity > 0 && DEQ_SIZE(out_link->undelivered) >= out_link->capacity)
+    const int drop_threshold = qdr_link_drop_threshold(out_link);
+    if (out_dlv->settled && drop_threshold > 0 && qdr_delivery_ring_size(&out_link->undelivered) >= drop_threshold)
         qdr_forward_drop_presettled_CT_LH(core, out_link);
 
-    DEQ_INSERT_TAIL(out_link->undelivered, out_dlv);
+    qdr_delivery_ring_push(&out_link->undelivered, out_dlv);
     out_dlv->where = QDR_DELIVERY_IN_UNDELIVERED;
+    qdr_link_delivery_queued_CT(core, out_link);
+
+    if (out_link->link_type == QD_LINK_ROUTER || (core->latency_aware_balancing && !out_dlv->settled))
+        out_dlv->forwarded_ns = qdr_core_now_ns();
 
     // This incref is for putting the delivery in the undelivered list
     qdr_delivery_incref(out_dlv, "qdr_forward_deliver_CT - add to undelivered list");
@@ -320,6 +370,17 @@ void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery
     qdr_add_link_ref(&out_link->conn->links_with_work[out_link->priority], out_link, QDR_LINK_LIST_CLASS_WORK);
 
     out_dlv->link_work = qdr_link_work_getref(work);
+}
+
+
+void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery_t *out_dlv)
+{
+    qdr_forward_annotate_mesh_CT(core, out_link, out_dlv);
+    QD_PROBE_FORWARD_DELIVER(out_dlv->conn_id, out_dlv->link_id, out_dlv->delivery_id,
+                             out_dlv->peer ? out_dlv->peer->delivery_id : 0);
+
+    sys_mutex_lock(&out_link->conn->work_lock);
+    qdr_forward_deliver_CT_LH(core, out_link, out_dlv);
     sys_mutex_unlock(&out_link->conn->work_lock);
 
     //
@@ -329,6 +390,76 @@ void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *out_link, qdr_delivery
 }
 
 
+static void qdr_forward_fanout_init(qdr_forward_fanout_t *fanout)
+{
+    fanout->entries  = fanout->inline_entries;
+    fanout->count    = 0;
+    fanout->capacity = QDR_FORWARD_FANOUT_INLINE;
+}
+
+
+static void qdr_forward_fanout_add(qdr_forward_fanout_t *fanout, qdr_link_t *out_link, qdr_delivery_t *out_dlv)
+{
+    if (fanout->count == fanout->capacity) {
+        int                         capacity = fanout->capacity * 2;
+        qdr_forward_deliver_info_t *entries  = NEW_ARRAY(qdr_forward_deliver_info_t, capacity);
+        memcpy(entries, fanout->entries, fanout->count * sizeof(qdr_forward_deliver_info_t));
+        if (fanout->entries != fanout->inline_entries)
+            free(fanout->entries);
+        fanout->entries  = entries;
+        fanout->capacity = capacity;
+    }
+
+    fanout->entries[fanout->count].out_link = out_link;
+    fanout->entries[fanout->count].out_dlv  = out_dlv;
+    fanout->count++;
+}
+
+
+static int qdr_forward_fanout_compare(const void *a, const void *b)
+{
+    uintptr_t conn_a = (uintptr_t) ((const qdr_forward_deliver_info_t*) a)->out_link->conn;
+    uintptr_t conn_b = (uintptr_t) ((const qdr_forward_deliver_info_t*) b)->out_link->conn;
+    return (conn_a > conn_b) - (conn_a < conn_b);
+}
+
+
+//
+// Deliver all of the collected out-deliveries, taking each destination connection's
+// work_lock and activating the connection once for all of its links.
+//
+// Thread-safety analysis cannot follow the lock through the grouping, hence the annotation.
+//
+static void qdr_forward_fanout_deliver_CT(qdr_core_t *core, qdr_forward_fanout_t *fanout) TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    qdr_forward_deliver_info_t *entries = fanout->entries;
+
+    for (int i = 0; i < fanout->count; i++)
+        qdr_forward_annotate_mesh_CT(core, entries[i].out_link, entries[i].out_dlv);
+
+    if (fanout->count > 1)
+        qsort(entries, fanout->count, sizeof(qdr_forward_deliver_info_t), qdr_forward_fanout_compare);
+
+    int i = 0;
+    while (i < fanout->count) {
+        qdr_connection_t *conn = entries[i].out_link->conn;
+
+        sys_mutex_lock(&conn->work_lock);
+        while (i < fanout->count && entries[i].out_link->conn == conn) {
+            qdr_forward_deliver_CT_LH(core, entries[i].out_link, entries[i].out_dlv);
+            i++;
+        }
+        sys_mutex_unlock(&conn->work_lock);
+
+        qdr_connection_activate_CT(core, conn);
+    }
+
+    if (fanout->entries != fanout->inline_entries)
+        free(fanout->entries);
+    qdr_forward_fanout_init(fanout);
+}
+
+
 static void qdr_settle_subscription_delivery_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     qdr_delivery_t *in_delivery = action->args.delivery.delivery;
@@ -425,7 +556,9 @@ void qdr_forward_on_message_CT(qdr_core_t *core, qdr_subscription_t *sub, qdr_li
         if (!!in_delivery)
             qdr_delivery_incref(in_delivery, "qdr_forward_on_message_CT - adding to general work item");
 
+        // Messages to the same subscriber are delivered in-order
         qdr_general_work_t *work = qdr_general_work(qdr_forward_on_message);
+        work->affinity           = (uintptr_t) sub->on_message_context;
         work->on_message         = sub->on_message;
         work->on_message_context = sub->on_message_context;
         work->msg                = qd_message_copy(msg);
@@ -510,6 +643,19 @@ static inline bool qdr_invalidated_link_CT(qdr_delivery_t *in_dlv, qdr_link_t *o
 }
 
 
+/**
+ * Determine if the out_link is an edge router's proxy link to its interior router.  Destinations reached over an
+ * uplink are one hop further away than the local ones and the ones on peer edges of the same mesh, which are reached
+ * over the inter-edge connections, so forwarding prefers the latter and keeps intra-mesh traffic off the interior.
+ */
+static inline bool qdr_forward_is_uplink_CT(qdr_core_t *core, const qdr_link_t *out_link)
+{
+    return core->router_mode == QD_ROUTER_MODE_EDGE
+        && out_link->proxy
+        && out_link->conn->role == QDR_ROLE_EDGE_CONNECTION;
+}
+
+
 /**
  * Handle forwarding to a subscription
  */
@@ -537,6 +683,72 @@ static void qdr_forward_to_subscriber_CT(qdr_core_t *core, qdr_subscription_t *s
 }
 
 
+//
+// Return the set of inter-router connections that multicast deliveries from the origin router
+// are sent on: the next-hops of the destination routers in addr->rnodes for which the origin
+// is valid, i.e. the branches of the origin's shortest-path tree that lead to subscribers.
+// Destinations reachable via the same next-hop share one branch, so a single copy is sent to
+// each next-hop and the downstream routers fan the message out.
+//
+// The sets are cached in the address, by origin, and dropped when core->cost_epoch moves (which
+// covers costs, next-hops, links and valid origins) or mobile-address sync moves the address's
+// own epoch on a change to its rnodes.  Multicast addresses have no forwarding candidates, so
+// they use the address's epoch for the branch sets instead.
+//
+static qd_bitmask_t *qdr_forward_multicast_branches_CT(qdr_core_t *core, qdr_address_t *addr, int origin,
+                                                      bool bypass_valid_origins)
+{
+    qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+
+    if (!ext->multicast_branches) {
+        ext->multicast_branches = (qd_bitmask_t**) calloc(qd_bitmask_width(), sizeof(qd_bitmask_t*));
+        ext->multicast_origins  = qd_bitmask(0);
+        addr->cost_epoch        = core->cost_epoch;
+    } else if (addr->cost_epoch != core->cost_epoch) {
+        qd_bitmask_clear_all(ext->multicast_origins);
+        addr->cost_epoch = core->cost_epoch;
+    }
+
+    qd_bitmask_t *branches = ext->multicast_branches[origin];
+    if (!branches)
+        branches = ext->multicast_branches[origin] = qd_bitmask(0);
+    else if (qd_bitmask_value(ext->multicast_origins, origin))
+        return branches;
+
+    qd_bitmask_clear_all(branches);
+    int dest_bit;
+    int c;
+    for (QD_BITMASK_EACH(addr->rnodes, dest_bit, c)) {
+        qdr_node_t *rnode = core->routers_by_mask_bit[dest_bit];
+        if (!rnode)
+            continue;
+
+        // get the inter-router connection associated with path to rnode:
+        int conn_bit = (rnode->next_hop) ? rnode->next_hop->conn_mask_bit : rnode->conn_mask_bit;
+
+        if (conn_bit >= 0 && (bypass_valid_origins || qd_bitmask_value(rnode->valid_origins, origin)))
+            qd_bitmask_set_bit(branches, conn_bit);
+    }
+    qd_bitmask_set_bit(ext->multicast_origins, origin);
+
+    return branches;
+}
+
+
+void qdr_forward_free_multicast_branches_CT(qdr_address_t *addr)
+{
+    qdr_address_ext_t *ext = addr->ext;
+    if (ext && ext->multicast_branches) {
+        for (int i = 0; i < qd_bitmask_width(); i++)
+            qd_bitmask_free(ext->multicast_branches[i]);
+        free(ext->multicast_branches);
+        qd_bitmask_free(ext->multicast_origins);
+        ext->multicast_branches = 0;
+        ext->multicast_origins  = 0;
+    }
+}
+
+
 int qdr_forward_multicast_CT(qdr_core_t      *core,
                              qdr_address_t   *addr,
                              qd_message_t    *msg,
@@ -548,9 +760,10 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
     int           fanout               = 0;
     qd_bitmask_t *link_exclusion       = !!in_delivery ? in_delivery->link_exclusion : 0;
     bool          receive_complete     = qd_message_receive_complete(msg);
+    bool          streaming            = qdr_forward_streaming_CT(core, msg, receive_complete);
 
-    qdr_forward_deliver_info_list_t deliver_info_list;
-    DEQ_INIT(deliver_info_list);
+    qdr_forward_fanout_t pending;
+    qdr_forward_fanout_init(&pending);
 
     //
     // Forward to local subscribers
@@ -565,7 +778,7 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
             //
             if (!qdr_forward_edge_echo_CT(in_delivery, out_link)) {
 
-                if (!receive_complete && out_link->conn->connection_info->streaming_links) {
+                if (streaming && out_link->conn->connection_info->streaming_links) {
                     out_link = get_outgoing_streaming_link(core, out_link->conn, out_link);
                 }
 
@@ -573,11 +786,7 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
                     qdr_delivery_t *out_delivery = qdr_forward_new_delivery_CT(core, in_delivery, out_link, msg);
 
                     // Store the out_link and out_delivery so we can forward the delivery later on
-                    qdr_forward_deliver_info_t *deliver_info = new_qdr_forward_deliver_info_t();
-                    ZERO(deliver_info);
-                    deliver_info->out_dlv = out_delivery;
-                    deliver_info->out_link = out_link;
-                    DEQ_INSERT_TAIL(deliver_info_list, deliver_info);
+                    qdr_forward_fanout_add(&pending, out_link, out_delivery);
 
                     fanout++;
                     if (out_link->link_type != QD_LINK_CONTROL && out_link->link_type != QD_LINK_ROUTER) {
@@ -617,43 +826,21 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
     // Forward to the next-hops for remote destinations.
     //
     if (origin >= 0) {
-        int           dest_bit;
-        qd_bitmask_t *conn_set = qd_bitmask(0);  // connections to the next-hops
+        qd_bitmask_t *branches = qdr_forward_multicast_branches_CT(core, addr, origin, bypass_valid_origins);
 
         //
-        // Loop over the target nodes for this address.  Build a set of outgoing connections
-        // for which there are valid targets.  We do this to avoid sending more than one
-        // message to a given next-hop.  It's possible that there are multiple destinations
-        // for this address that are all reachable via the same next-hop.  In this case, we
-        // will send only one copy of the message to the next-hop and allow the downstream
-        // routers to fan the message out.
+        // Send a copy of the message over the inter-router connection to each next hop
         //
+        int conn_bit;
         int c;
-        for (QD_BITMASK_EACH(addr->rnodes, dest_bit, c)) {
-            qdr_node_t *rnode = core->routers_by_mask_bit[dest_bit];
-            if (!rnode)
+        for (QD_BITMASK_EACH(branches, conn_bit, c)) {
+            if (link_exclusion && qd_bitmask_value(link_exclusion, conn_bit))
                 continue;
 
-            // get the inter-router connection associated with path to rnode:
-            int conn_bit = (rnode->next_hop) ? rnode->next_hop->conn_mask_bit : rnode->conn_mask_bit;
-
-            if (conn_bit >= 0 && (!link_exclusion || qd_bitmask_value(link_exclusion, conn_bit) == 0) &&
-		(bypass_valid_origins || qd_bitmask_value(rnode->valid_origins, origin))) {
-                qd_bitmask_set_bit(conn_set, conn_bit);
-            }
-        }
-
-        //
-        // Send a copy of the message over the inter-router connection to the next hop
-        //
-        int conn_bit;
-        while (qd_bitmask_first_set(conn_set, &conn_bit)) {
-            qd_bitmask_clear_bit(conn_set, conn_bit);
-
             qdr_link_t  *dest_link;
             if (control) {
                 dest_link = peer_router_control_link(core, conn_bit);
-            } else if (!receive_complete) {  // inter-router conns support dynamic streaming links
+            } else if (streaming) {  // inter-router conns support dynamic streaming links
                 dest_link = get_outgoing_streaming_link(core, core->rnode_conns_by_mask_bit[conn_bit], 0);
             } else {
                 dest_link = peer_router_data_link(core, conn_bit, qdr_forward_effective_priority(msg, addr));
@@ -663,11 +850,7 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
                 qdr_delivery_t *out_delivery = qdr_forward_new_delivery_CT(core, in_delivery, dest_link, msg);
 
                 // Store the out_link and out_delivery so we can forward the delivery later on
-                qdr_forward_deliver_info_t *deliver_info = new_qdr_forward_deliver_info_t();
-                ZERO(deliver_info);
-                deliver_info->out_dlv = out_delivery;
-                deliver_info->out_link = dest_link;
-                DEQ_INSERT_TAIL(deliver_info_list, deliver_info);
+                qdr_forward_fanout_add(&pending, dest_link, out_delivery);
 
                 fanout++;
                 addr->deliveries_transit++;
@@ -675,8 +858,6 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
                     core->deliveries_transit++;
             }
         }
-
-        qd_bitmask_free(conn_set);
     }
 
     if (!exclude_inprocess) {
@@ -692,13 +873,7 @@ int qdr_forward_multicast_CT(qdr_core_t      *core,
         }
     }
 
-    qdr_forward_deliver_info_t *deliver_info = DEQ_HEAD(deliver_info_list);
-    while (deliver_info) {
-        qdr_forward_deliver_CT(core, deliver_info->out_link, deliver_info->out_dlv);
-        DEQ_REMOVE_HEAD(deliver_info_list);
-        free_qdr_forward_deliver_info_t(deliver_info);
-        deliver_info = DEQ_HEAD(deliver_info_list);
-    }
+    qdr_forward_fanout_deliver_CT(core, &pending);
 
     return fanout;
 }
@@ -712,6 +887,7 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
                            bool             control)
 {
     const bool receive_complete = qd_message_receive_complete(msg);
+    const bool streaming        = qdr_forward_streaming_CT(core, msg, receive_complete);
     //
     // Forward to an in-process subscriber if there is one.
     //
@@ -750,11 +926,26 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
         link_ref = DEQ_NEXT(link_ref);
     }
 
+    //
+    // On an edge router, use the uplink to the interior only if there is no local or mesh-peer destination.
+    //
+    if (link_ref && qdr_forward_is_uplink_CT(core, link_ref->link)) {
+        qdr_link_ref_t *nearer = DEQ_NEXT(link_ref);
+        while (nearer && (qdr_forward_is_uplink_CT(core, nearer->link)
+                          || qdr_forward_edge_echo_CT(in_delivery, nearer->link)
+                          || qdr_invalidated_link_CT(in_delivery, nearer->link))) {
+            nearer = DEQ_NEXT(nearer);
+        }
+        if (nearer) {
+            link_ref = nearer;
+        }
+    }
+
     if (link_ref) {
         qdr_link_t *out_link = link_ref->link;
         qdr_link_t *original_link = out_link;
 
-        if (!receive_complete && out_link->conn->connection_info->streaming_links) {
+        if (streaming && out_link->conn->connection_info->streaming_links) {
             out_link = get_outgoing_streaming_link(core, out_link->conn, out_link);
         }
 
@@ -781,7 +972,7 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
 
             if (qdr_connection_route_container(out_link->conn)) {
                 core->deliveries_egress_route_container++;
-                addr->deliveries_egress_route_container++;
+                qdr_address_ext_CT(addr)->deliveries_egress_route_container++;
             }
 
             return 1;
@@ -789,11 +980,11 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
     }
 
     //
-    // If the cached list of closest remotes is stale (i.e. cost data has changed),
-    // recompute the closest remote routers.
+    // If the cached list of remote candidates is stale (i.e. cost or route data has changed),
+    // rebuild it.
     //
     if (addr->cost_epoch != core->cost_epoch)
-        qdr_forward_find_closest_remotes_CT(core, addr);
+        qdr_forward_refresh_candidates_CT(core, addr);
 
     //
     // Get the mask bit associated with the ingress router for the message.
@@ -814,46 +1005,32 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
     //
     // Find a non-invalidated neighbor to send this delivery to.
     //
-    int start_bit       = addr->next_remote;
     int chosen_conn_bit = -1;
 
     //
-    // Start by trying all of the least-cost routers
+    // Start by trying all of the least-cost routers, round-robin
     //
-    if (addr->next_remote >= 0) {
+    if (addr->closest_count > 0) {
+        const int start = addr->next_remote;
         do {
-            qdr_node_t *rnode = core->routers_by_mask_bit[addr->next_remote];
-            if (!!rnode) {
-                const int conn_bit = (rnode->next_hop) ? rnode->next_hop->conn_mask_bit : rnode->conn_mask_bit;
-                if ((!in_delivery || !in_delivery->invalidated_neighbors || qd_bitmask_value(in_delivery->invalidated_neighbors, conn_bit) == 0)
-                    && qd_bitmask_value(rnode->valid_origins, origin)) {
-                    chosen_conn_bit = conn_bit;
-                }
+            const qdr_forward_candidate_t *cand = &addr->remote_candidates[addr->next_remote];
+            if ((!in_delivery || !in_delivery->invalidated_neighbors || qd_bitmask_value(in_delivery->invalidated_neighbors, cand->conn_bit) == 0)
+                && qd_bitmask_value(cand->rnode->valid_origins, origin)) {
+                chosen_conn_bit = cand->conn_bit;
             }
 
-            //
-            // Advance to the next router in the closest_remotes set
-            //
-            _qdbm_next(addr->closest_remotes, &addr->next_remote);
-            if (addr->next_remote == -1) {
-                qd_bitmask_first_set(addr->closest_remotes, &addr->next_remote);
-            }
-        } while (chosen_conn_bit < 0 && addr->next_remote != start_bit);
+            addr->next_remote = (addr->next_remote + 1) % addr->closest_count;
+        } while (chosen_conn_bit < 0 && addr->next_remote != start);
     }
 
     //
-    // If all of the least-cost routers are invalidated, try the ordered list of routers that match this address
+    // If all of the least-cost routers are invalidated, try the rest of the candidates in order of cost
     //
-    if (chosen_conn_bit < 0) {
-        qdr_node_t *rnode = DEQ_HEAD(core->routers);
-        while (!!rnode) {
-            const int conn_bit = (rnode->next_hop) ? rnode->next_hop->conn_mask_bit : rnode->conn_mask_bit;
-            if (qd_bitmask_value(addr->rnodes, rnode->mask_bit) && (!in_delivery || !in_delivery->invalidated_neighbors || qd_bitmask_value(in_delivery->invalidated_neighbors, conn_bit) == 0)
-                && qd_bitmask_value(rnode->valid_origins, origin)) {
-                chosen_conn_bit = conn_bit;
-                break;
-            }
-            rnode = DEQ_NEXT(rnode);
+    for (int i = addr->closest_count; chosen_conn_bit < 0 && i < addr->remote_candidate_count; i++) {
+        const qdr_forward_candidate_t *cand = &addr->remote_candidates[i];
+        if ((!in_delivery || !in_delivery->invalidated_neighbors || qd_bitmask_value(in_delivery->invalidated_neighbors, cand->conn_bit) == 0)
+            && qd_bitmask_value(cand->rnode->valid_origins, origin)) {
+            chosen_conn_bit = cand->conn_bit;
         }
     }
 
@@ -865,7 +1042,7 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
         qdr_link_t *out_link;
         if (control) {
             out_link = peer_router_control_link(core, chosen_conn_bit);
-        } else if (!receive_complete) {
+        } else if (streaming) {
             out_link = get_outgoing_streaming_link(core, core->rnode_conns_by_mask_bit[chosen_conn_bit], 0);
         } else {
             out_link = peer_router_data_link(core, chosen_conn_bit, qdr_forward_effective_priority(msg, addr));
@@ -888,36 +1065,16 @@ int qdr_forward_closest_CT(qdr_core_t      *core,
 }
 
 
-int qdr_forward_balanced_CT(qdr_core_t      *core,
-                            qdr_address_t   *addr,
-                            qd_message_t    *msg,
-                            qdr_delivery_t  *in_delivery,
-                            bool             exclude_inprocess,
-                            bool             control)
+//
+// Choose the destination for a balanced delivery by outstanding deliveries, biased by route cost.
+//
+static void qdr_forward_balanced_by_outstanding_CT(qdr_core_t      *core,
+                                                   qdr_address_t   *addr,
+                                                   qd_message_t    *msg,
+                                                   qdr_delivery_t  *in_delivery,
+                                                   qdr_link_t     **chosen_link,
+                                                   int             *chosen_conn_bit)
 {
-    //
-    // Control messages should never use balanced treatment.
-    //
-    assert(!control);
-#ifdef LOG_FORWARD_BALANCED
-    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "ForwardBalanced: %s locals=%d remotes=%d",
-           qd_hash_key_by_handle(addr->hash_handle), DEQ_SIZE(addr->rlinks), qd_bitmask_cardinality(addr->rnodes));
-#endif
-
-    //
-    // If this is the first time through here, allocate the array for outstanding delivery counts.
-    //
-    if (addr->outstanding_deliveries == 0) {
-        addr->outstanding_deliveries = NEW_ARRAY(int, qd_bitmask_width());
-        for (int i = 0; i < qd_bitmask_width(); i++)
-            addr->outstanding_deliveries[i] = 0;
-    }
-
-    if (!!in_delivery) {
-        in_delivery->chosen_link     = 0;
-        in_delivery->chosen_neighbor = -1;
-    }
-
     qdr_link_t *best_eligible_link       = 0;
     int         best_eligible_conn_bit   = -1;
     uint32_t    eligible_link_value      = UINT32_MAX;
@@ -942,10 +1099,16 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
     while (link_ref && eligible_link_value != 0) {
         qdr_link_t *link     = link_ref->link;
         sys_mutex_lock(&link->conn->work_lock);
-        uint32_t    value    = DEQ_SIZE(link->undelivered) + DEQ_SIZE(link->unsettled) + (core->disable_867_fix ? 0 : link->open_moved_streams);
+        uint32_t    value    = qdr_delivery_ring_size(&link->undelivered) + DEQ_SIZE(link->unsettled) + (core->disable_867_fix ? 0 : link->open_moved_streams);
         sys_mutex_unlock(&link->conn->work_lock);
         bool        eligible = link->capacity > value;
 
+        //
+        // An edge router's uplink costs one more hop than its local and mesh-peer destinations.
+        //
+        if (qdr_forward_is_uplink_CT(core, link))
+            value++;
+
         //
         // Only consider links that do not result in edge-echo are are not invalidated.
         //
@@ -991,16 +1154,16 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
                 qd_bitmask_first_set(origin_addr->rnodes, &origin);
         }
 
-        int c;
-        int node_bit;
-        for (QD_BITMASK_EACH(addr->rnodes, node_bit, c)) {
-            qdr_node_t *rnode     = core->routers_by_mask_bit[node_bit];
+        if (addr->cost_epoch != core->cost_epoch)
+            qdr_forward_refresh_candidates_CT(core, addr);
 
-            if (qd_bitmask_value(rnode->valid_origins, origin)) {
+        const uint8_t priority = qdr_forward_effective_priority(msg, addr);
+        for (int i = 0; i < addr->remote_candidate_count; i++) {
+            const qdr_forward_candidate_t *cand = &addr->remote_candidates[i];
 
-                qdr_node_t *next_node = rnode->next_hop ? rnode->next_hop : rnode;
-                int         conn_bit  = next_node->conn_mask_bit;
-                uint8_t     priority  = qdr_forward_effective_priority(msg, addr);
+            if (qd_bitmask_value(cand->rnode->valid_origins, origin)) {
+
+                int         conn_bit  = cand->conn_bit;
                 qdr_link_t *link      = peer_router_data_link(core, conn_bit, priority);
                 if (!link) continue;
 
@@ -1011,7 +1174,7 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
                     //
                     // Link is a candidate, adjust the value by the bias (node cost).
                     //
-                    value += rnode->cost;
+                    value += cand->cost;
                     if (eligible && eligible_link_value > value) {
                         best_eligible_link     = link;
                         best_eligible_conn_bit = conn_bit;
@@ -1040,23 +1203,201 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
         }
     }
 
-    qdr_link_t *chosen_link     = 0;
-    int         chosen_conn_bit = -1;
-
     if (best_eligible_link) {
-        chosen_link     = best_eligible_link;
-        chosen_conn_bit = best_eligible_conn_bit;
+        *chosen_link     = best_eligible_link;
+        *chosen_conn_bit = best_eligible_conn_bit;
     } else if (best_ineligible_link) {
-        chosen_link     = best_ineligible_link;
-        chosen_conn_bit = best_ineligible_conn_bit;
+        *chosen_link     = best_ineligible_link;
+        *chosen_conn_bit = best_ineligible_conn_bit;
     }
+}
 
+
+//
+// Latency-aware balancing considers every destination while an address has at most this many;
+// beyond that it samples two local links and two remote routers per delivery.
+//
+#define QDR_BALANCED_SAMPLE_THRESHOLD 8
+
+typedef struct qdr_balanced_choice_t {
+    qdr_link_t *link;
+    int         conn_bit;
+    uint64_t    estimate;
+    bool        eligible;
+} qdr_balanced_choice_t;
+
+
+//
+// Return the settlement latency to expect from an outgoing link: its moving average, or the
+// age of its oldest unsettled delivery if that is larger.  The latter keeps a consumer that
+// has stopped settling (and so stopped producing samples) from looking fast.  If local_load
+// is supplied it receives the number of deliveries queued or in flight on the link.
+//
+static uint64_t qdr_forward_link_latency_CT(qdr_core_t *core, qdr_link_t *link, uint64_t now, uint32_t *local_load)
+{
+    sys_mutex_lock(&link->conn->work_lock);
+    uint64_t        latency = link->settle_ewma_ns;
+    qdr_delivery_t *oldest  = DEQ_HEAD(link->unsettled);
+    if (oldest && oldest->forwarded_ns && now > oldest->forwarded_ns)
+        latency = MAX(latency, now - oldest->forwarded_ns);
+    if (local_load)
+        *local_load = qdr_delivery_ring_size(&link->undelivered) + DEQ_SIZE(link->unsettled) + (core->disable_867_fix ? 0 : link->open_moved_streams);
+    sys_mutex_unlock(&link->conn->work_lock);
+    return latency;
+}
+
+
+//
+// Rank a candidate by estimated completion time, (outstanding + 1) x latency.  Eligible links
+// (below capacity) are always preferred to ineligible ones.
+//
+static void qdr_forward_balanced_consider(qdr_balanced_choice_t *best, qdr_link_t *link, int conn_bit,
+                                          uint32_t outstanding, uint64_t latency)
+{
+    bool     eligible = link->capacity > outstanding;
+    uint64_t estimate = (uint64_t) (outstanding + 1) * latency;
+
+#ifdef LOG_FORWARD_BALANCED
+    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "ForwardBalanced:   candidate conn_bit=%d outstanding=%" PRIu32 " estimate=%" PRIu64,
+           conn_bit, outstanding, estimate);
+#endif
+
+    if (!best->link || (eligible && !best->eligible) || (eligible == best->eligible && estimate < best->estimate)) {
+        best->link     = link;
+        best->conn_bit = conn_bit;
+        best->estimate = estimate;
+        best->eligible = eligible;
+    }
+}
+
+
+static void qdr_forward_balanced_consider_remote_CT(qdr_core_t                    *core,
+                                                    qdr_address_t                 *addr,
+                                                    qdr_delivery_t                *in_delivery,
+                                                    const qdr_forward_candidate_t *cand,
+                                                    int                            origin,
+                                                    uint8_t                        priority,
+                                                    uint64_t                       now,
+                                                    qdr_balanced_choice_t         *best)
+{
+    if (!qd_bitmask_value(cand->rnode->valid_origins, origin))
+        return;
+
+    if (in_delivery && in_delivery->invalidated_neighbors && qd_bitmask_value(in_delivery->invalidated_neighbors, cand->conn_bit))
+        return;
+
+    qdr_link_t *link = peer_router_data_link(core, cand->conn_bit, priority);
+    if (!link)
+        return;
+
+    qdr_forward_balanced_consider(best, link, cand->conn_bit, addr->outstanding_deliveries[cand->conn_bit],
+                                  qdr_forward_link_latency_CT(core, link, now, 0));
+}
+
+
+//
+// Choose the destination for a balanced delivery by estimated completion time.  Every outgoing
+// unsettled delivery is timestamped and the time to its settlement is averaged per link
+// (see qdr_delivery_settled_CT).  Remote routers are ranked by the data link toward their
+// next-hop, with the address's own outstanding count toward that next-hop.
+//
+// For addresses with many destinations, use power-of-two-choices: two local links taken from
+// the head of the (rotating) rlinks list and two remote candidates picked at random.
+//
+static void qdr_forward_balanced_by_latency_CT(qdr_core_t      *core,
+                                               qdr_address_t   *addr,
+                                               qd_message_t    *msg,
+                                               qdr_delivery_t  *in_delivery,
+                                               qdr_link_t     **chosen_link,
+                                               int             *chosen_conn_bit)
+{
+    qdr_balanced_choice_t best = {0, -1, 0, false};
+    uint64_t              now  = qdr_core_now_ns();
+
+    if (addr->cost_epoch != core->cost_epoch)
+        qdr_forward_refresh_candidates_CT(core, addr);
+
+    const bool sample = DEQ_SIZE(addr->rlinks) + addr->remote_candidate_count > QDR_BALANCED_SAMPLE_THRESHOLD;
+
+    //
+    // Local links.  Only consider links that do not result in edge-echo and are not invalidated.
+    //
+    int             considered = 0;
+    qdr_link_ref_t *link_ref   = DEQ_HEAD(addr->rlinks);
+    while (link_ref && (!sample || considered < 2)) {
+        qdr_link_t *link = link_ref->link;
+        if (!qdr_forward_edge_echo_CT(in_delivery, link) && !qdr_invalidated_link_CT(in_delivery, link)) {
+            uint32_t outstanding;
+            uint64_t latency = qdr_forward_link_latency_CT(core, link, now, &outstanding);
+            qdr_forward_balanced_consider(&best, link, -1, outstanding, latency);
+            considered++;
+        }
+        link_ref = DEQ_NEXT(link_ref);
+    }
+
+    if (sample && DEQ_SIZE(addr->rlinks) > 1) {
+        link_ref = DEQ_HEAD(addr->rlinks);
+        DEQ_REMOVE_HEAD(addr->rlinks);
+        DEQ_INSERT_TAIL(addr->rlinks, link_ref);
+    }
+
+    //
+    // Remote routers
+    //
+    if (addr->remote_candidate_count > 0) {
+        int origin = 0;  // default to this router
+        qd_iterator_t *ingress_iter = in_delivery ? in_delivery->origin : 0;
+
+        if (ingress_iter) {
+            qd_iterator_reset_view(ingress_iter, ITER_VIEW_NODE_HASH);
+            qdr_address_t *origin_addr;
+            qd_hash_retrieve(core->addr_hash, ingress_iter, (void*) &origin_addr);
+            if (origin_addr && qd_bitmask_cardinality(origin_addr->rnodes) == 1)
+                qd_bitmask_first_set(origin_addr->rnodes, &origin);
+        }
+
+        const uint8_t priority = qdr_forward_effective_priority(msg, addr);
+        const int     count    = addr->remote_candidate_count;
+        bool          scan     = true;
+
+        if (sample && count > 2) {
+            for (int n = 0; n < 2; n++)
+                qdr_forward_balanced_consider_remote_CT(core, addr, in_delivery, &addr->remote_candidates[random() % count],
+                                                        origin, priority, now, &best);
+            //
+            // Fall back to the full list only if neither the local nor the remote samples were usable.
+            //
+            scan = !best.link;
+        }
+
+        for (int i = 0; scan && i < count; i++)
+            qdr_forward_balanced_consider_remote_CT(core, addr, in_delivery, &addr->remote_candidates[i],
+                                                    origin, priority, now, &best);
+    }
+
+    *chosen_link     = best.link;
+    *chosen_conn_bit = best.conn_bit;
+}
+
+
+//
+// Send a balanced (or affinity) delivery on the chosen link: a local link or, with chosen_conn_bit >= 0, the data
+// link toward a remote router.
+//
+static int qdr_forward_balanced_deliver_CT(qdr_core_t     *core,
+                                           qdr_address_t  *addr,
+                                           qd_message_t   *msg,
+                                           qdr_delivery_t *in_delivery,
+                                           qdr_link_t     *chosen_link,
+                                           int             chosen_conn_bit)
+{
     qdr_link_t *original_link = chosen_link;
 
     if (chosen_link) {
         // DISPATCH-1545 (head of line blocking): if the message is streaming,
         // see if the allows us to open a dedicated link for streaming
-        if (!qd_message_receive_complete(msg) && chosen_link->conn->connection_info->streaming_links) {
+        if (qdr_forward_streaming_CT(core, msg, qd_message_receive_complete(msg))
+            && chosen_link->conn->connection_info->streaming_links) {
             chosen_link = get_outgoing_streaming_link(core, chosen_link->conn, chosen_link);
             if (!chosen_link) {
                 return 0;
@@ -1106,7 +1447,7 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
 
             if (qdr_connection_route_container(chosen_link->conn)) {
                 core->deliveries_egress_route_container++;
-                addr->deliveries_egress_route_container++;
+                qdr_address_ext_CT(addr)->deliveries_egress_route_container++;
             }
         }
         return 1;
@@ -1115,6 +1456,200 @@ int qdr_forward_balanced_CT(qdr_core_t      *core,
     return 0;
 }
 
+
+static void qdr_forward_balanced_prepare_CT(qdr_address_t *addr, qdr_delivery_t *in_delivery)
+{
+    //
+    // If this is the first time through here, allocate the array for outstanding delivery counts.
+    //
+    if (addr->outstanding_deliveries == 0) {
+        addr->outstanding_deliveries = NEW_ARRAY(int, qd_bitmask_width());
+        for (int i = 0; i < qd_bitmask_width(); i++)
+            addr->outstanding_deliveries[i] = 0;
+    }
+
+    if (!!in_delivery) {
+        in_delivery->chosen_link     = 0;
+        in_delivery->chosen_neighbor = -1;
+    }
+}
+
+
+int qdr_forward_balanced_CT(qdr_core_t      *core,
+                            qdr_address_t   *addr,
+                            qd_message_t    *msg,
+                            qdr_delivery_t  *in_delivery,
+                            bool             exclude_inprocess,
+                            bool             control)
+{
+    //
+    // Control messages should never use balanced treatment.
+    //
+    assert(!control);
+#ifdef LOG_FORWARD_BALANCED
+    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "ForwardBalanced: %s locals=%d remotes=%d",
+           qd_hash_key_by_handle(addr->hash_handle), DEQ_SIZE(addr->rlinks), qd_bitmask_cardinality(addr->rnodes));
+#endif
+
+    qdr_forward_balanced_prepare_CT(addr, in_delivery);
+
+    qdr_link_t *chosen_link     = 0;
+    int         chosen_conn_bit = -1;
+
+    if (core->latency_aware_balancing)
+        qdr_forward_balanced_by_latency_CT(core, addr, msg, in_delivery, &chosen_link, &chosen_conn_bit);
+    else
+        qdr_forward_balanced_by_outstanding_CT(core, addr, msg, in_delivery, &chosen_link, &chosen_conn_bit);
+
+    return qdr_forward_balanced_deliver_CT(core, addr, msg, in_delivery, chosen_link, chosen_conn_bit);
+}
+
+
+//
+// Affinity distribution sends the deliveries with the same key to the same destination for as long as the set of
+// destinations is stable.  The key is the value of the application property named by the address configuration's
+// affinityKey or, without one, the group-id of the message.  Deliveries without a key are balanced.
+//
+// The destination is chosen by rendezvous (highest random weight) hashing, in two levels so that every router picks
+// the same one for a key: first the router, among this one (if it has local destinations) and the remote routers
+// with destinations, weighted by router id; then, on the chosen router, the local link, weighted by link identity.
+// Removing a destination only moves the keys it held.  A failing consumer is bounded by its credit: a destination
+// at capacity is passed over for the remaining one with the highest weight, and used only if all are at capacity.
+//
+#define QDR_AFFINITY_KEY_MAX 256  // octets of the key that are hashed
+
+static bool qdr_forward_affinity_key_CT(qdr_address_t *addr, qd_message_t *msg, uint32_t *key_hash)
+{
+    const char        *property = addr->config ? addr->config->affinity_key : 0;
+    qd_iterator_t     *iter     = 0;
+    qd_iterator_t     *ap_iter  = 0;
+    qd_parsed_field_t *ap_field = 0;
+
+    if (property) {
+        if (qd_message_check_depth(msg, QD_DEPTH_APPLICATION_PROPERTIES) != QD_MESSAGE_DEPTH_OK)
+            return false;
+        ap_iter  = qd_message_field_iterator(msg, QD_FIELD_APPLICATION_PROPERTIES);
+        ap_field = ap_iter ? qd_parse(ap_iter) : 0;
+        if (ap_field && qd_parse_is_map(ap_field)) {
+            qd_parsed_field_t *value = qd_parse_value_by_key(ap_field, property);
+            iter = value ? qd_parse_raw(value) : 0;
+        }
+    } else {
+        if (qd_message_check_depth(msg, QD_DEPTH_PROPERTIES) != QD_MESSAGE_DEPTH_OK)
+            return false;
+        iter = ap_iter = qd_message_field_iterator(msg, QD_FIELD_GROUP_ID);
+    }
+
+    uint8_t key[QDR_AFFINITY_KEY_MAX];
+    size_t  len = iter ? qd_iterator_ncopy(iter, key, sizeof(key)) : 0;
+    if (len > 0)
+        *key_hash = qd_hash_bytes(key, len);
+
+    qd_parse_free(ap_field);
+    qd_iterator_free(ap_iter);
+    return len > 0;
+}
+
+
+static inline uint64_t qdr_forward_affinity_weight(uint32_t key_hash, uint64_t destination)
+{
+    return qd_hash_mix((((uint64_t) key_hash << 32) ^ destination) ^ QD_HASH_SEED_0, QD_HASH_SEED_1);
+}
+
+
+typedef struct qdr_affinity_choice_t {
+    qdr_link_t *link;
+    int         conn_bit;
+    uint64_t    weight;
+    bool        eligible;
+} qdr_affinity_choice_t;
+
+
+static void qdr_forward_affinity_consider(qdr_affinity_choice_t *best, qdr_link_t *link, int conn_bit,
+                                          uint64_t weight, bool eligible)
+{
+    if (!best->link || (eligible && !best->eligible) || (eligible == best->eligible && weight > best->weight)) {
+        best->link     = link;
+        best->conn_bit = conn_bit;
+        best->weight   = weight;
+        best->eligible = eligible;
+    }
+}
+
+
+int qdr_forward_affinity_CT(qdr_core_t      *core,
+                            qdr_address_t   *addr,
+                            qd_message_t    *msg,
+                            qdr_delivery_t  *in_delivery,
+                            bool             exclude_inprocess,
+                            bool             control)
+{
+    assert(!control);
+
+    uint32_t key_hash;
+    if (!qdr_forward_affinity_key_CT(addr, msg, &key_hash))
+        return qdr_forward_balanced_CT(core, addr, msg, in_delivery, exclude_inprocess, control);
+
+    qdr_forward_balanced_prepare_CT(addr, in_delivery);
+
+    //
+    // The local link for the key, and whether it has capacity
+    //
+    qdr_affinity_choice_t local = {0, -1, 0, false};
+    for (qdr_link_ref_t *link_ref = DEQ_HEAD(addr->rlinks); link_ref; link_ref = DEQ_NEXT(link_ref)) {
+        qdr_link_t *link = link_ref->link;
+        if (qdr_forward_edge_echo_CT(in_delivery, link) || qdr_invalidated_link_CT(in_delivery, link))
+            continue;
+        sys_mutex_lock(&link->conn->work_lock);
+        uint32_t outstanding = qdr_delivery_ring_size(&link->undelivered) + DEQ_SIZE(link->unsettled) + (core->disable_867_fix ? 0 : link->open_moved_streams);
+        sys_mutex_unlock(&link->conn->work_lock);
+        qdr_forward_affinity_consider(&local, link, -1, qdr_forward_affinity_weight(key_hash, link->identity),
+                                      link->capacity > outstanding);
+    }
+
+    qdr_affinity_choice_t best = {0, -1, 0, false};
+    if (local.link)
+        qdr_forward_affinity_consider(&best, local.link, -1, qdr_forward_affinity_weight(key_hash, core->router_id_hash),
+                                      local.eligible);
+
+    //
+    // The remote routers, ranked by the data link toward their next-hop
+    //
+    if (addr->cost_epoch != core->cost_epoch)
+        qdr_forward_refresh_candidates_CT(core, addr);
+
+    if (addr->remote_candidate_count > 0) {
+        int origin = 0;  // default to this router
+        qd_iterator_t *ingress_iter = in_delivery ? in_delivery->origin : 0;
+
+        if (ingress_iter) {
+            qd_iterator_reset_view(ingress_iter, ITER_VIEW_NODE_HASH);
+            qdr_address_t *origin_addr;
+            qd_hash_retrieve(core->addr_hash, ingress_iter, (void*) &origin_addr);
+            if (origin_addr && qd_bitmask_cardinality(origin_addr->rnodes) == 1)
+                qd_bitmask_first_set(origin_addr->rnodes, &origin);
+        }
+
+        const uint8_t priority = qdr_forward_effective_priority(msg, addr);
+        for (int i = 0; i < addr->remote_candidate_count; i++) {
+            const qdr_forward_candidate_t *cand = &addr->remote_candidates[i];
+            if (!qd_bitmask_value(cand->rnode->valid_origins, origin))
+                continue;
+            if (in_delivery && in_delivery->invalidated_neighbors && qd_bitmask_value(in_delivery->invalidated_neighbors, cand->conn_bit))
+                continue;
+            qdr_link_t *link = peer_router_data_link(core, cand->conn_bit, priority);
+            if (!link)
+                continue;
+            qdr_forward_affinity_consider(&best, link, cand->conn_bit,
+                                          qdr_forward_affinity_weight(key_hash, cand->rnode->id_hash),
+                                          link->capacity > addr->outstanding_deliveries[cand->conn_bit]);
+        }
+    }
+
+    return qdr_forward_balanced_deliver_CT(core, addr, msg, in_delivery, best.link, best.conn_bit);
+}
+
+
 //==================================================================================
 // In-Thread API Functions
 //==================================================================================
@@ -1139,12 +1674,16 @@ void qdr_forwarder_setup_CT(qdr_core_t *core)
     core->forwarders[QD_TREATMENT_MULTICAST_ONCE]   = qdr_new_forwarder(qdr_forward_multicast_CT, false);
     core->forwarders[QD_TREATMENT_ANYCAST_CLOSEST]  = qdr_new_forwarder(qdr_forward_closest_CT,   false);
     core->forwarders[QD_TREATMENT_ANYCAST_BALANCED] = qdr_new_forwarder(qdr_forward_balanced_CT,  false);
+    core->forwarders[QD_TREATMENT_ANYCAST_AFFINITY] = qdr_new_forwarder(qdr_forward_affinity_CT,  false);
+
+    if (core->router_id)
+        core->router_id_hash = qd_hash_bytes((const uint8_t*) core->router_id, strlen(core->router_id));
 }
 
 
 qdr_forwarder_t *qdr_forwarder_CT(qdr_core_t *core, qd_address_treatment_t treatment)
 {
-    if (treatment <= QD_TREATMENT_ANYCAST_BALANCED)
+    if (treatment <= QD_TREATMENT_ANYCAST_BALANCED || treatment == QD_TREATMENT_ANYCAST_AFFINITY)
         return core->forwarders[treatment];
     return 0;
 }
@@ -1154,8 +1693,22 @@ int qdr_forward_message_CT(qdr_core_t *core, qdr_address_t *addr, qd_message_t *
                            bool exclude_inprocess, bool control)
 {
     int fanout = 0;
+
+    //
+    // A message whose ttl has run out is not worth sending anywhere.  The caller disposes of the
+    // in-delivery as an expired one.
+    //
+    if (core->enforce_message_ttl && qd_message_expired(msg, qdr_core_now_ns())) {
+        qdr_address_ext_CT(addr)->deliveries_expired++;
+        if (in_delivery)
+            in_delivery->expired = true;
+        return 0;
+    }
+
     if (addr->forwarder)
         fanout = addr->forwarder->forward_message(core, addr, msg, in_delivery, exclude_inprocess, control);
+    QD_PROBE_FORWARD_MESSAGE(in_delivery ? in_delivery->conn_id : 0, in_delivery ? in_delivery->link_id : 0,
+                             in_delivery ? in_delivery->delivery_id : 0, fanout);
     return fanout;
 }
 
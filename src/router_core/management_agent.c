@@ -30,6 +30,7 @@
 #include "qpid/dispatch/router_core.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 const char *ENTITY = "entityType";
 const char *TYPE = "type";
@@ -49,6 +50,7 @@ const unsigned char *address_entity_type           = (unsigned char*) "io.skuppe
 const unsigned char *link_entity_type              = (unsigned char*) "io.skupper.router.router.link";
 const unsigned char *router_metrics_entity_type      = (unsigned char*) "io.skupper.router.routerMetrics";
 const unsigned char *connection_entity_type        = (unsigned char*) "io.skupper.router.connection";
+const unsigned char *allocator_entity_type         = (unsigned char*) "io.skupper.router.allocator";
 const unsigned char *http_request_info_entity_type = (unsigned char*) "io.skupper.router.httpRequestInfo";
 
 const char * const status_description = "statusDescription";
@@ -64,6 +66,7 @@ const unsigned char *MANAGEMENT_CREATE = (unsigned char*) "CREATE";
 const unsigned char *MANAGEMENT_READ   = (unsigned char*) "READ";
 const unsigned char *MANAGEMENT_UPDATE = (unsigned char*) "UPDATE";
 const unsigned char *MANAGEMENT_DELETE = (unsigned char*) "DELETE";
+const unsigned char *MANAGEMENT_STATS_SNAPSHOT = (unsigned char*) "GET-STATS-SNAPSHOT";
 
 
 typedef enum {
@@ -71,7 +74,8 @@ typedef enum {
     QD_ROUTER_OPERATION_CREATE,
     QD_ROUTER_OPERATION_READ,
     QD_ROUTER_OPERATION_UPDATE,
-    QD_ROUTER_OPERATION_DELETE
+    QD_ROUTER_OPERATION_DELETE,
+    QD_ROUTER_OPERATION_STATS_SNAPSHOT
 } qd_router_operation_type_t;
 
 
@@ -82,7 +86,6 @@ typedef struct qd_management_context_t {
     qdr_query_t                *query;
     qdr_core_t                 *core;
     int                         count;
-    int                         current_count;
     qd_router_operation_type_t  operation_type;
 } qd_management_context_t ;
 
@@ -106,7 +109,6 @@ static qd_management_context_t* qd_management_context(qd_message_t
     ctx->msg    = msg;
     ctx->source = qd_message_copy(source);
     ctx->query  = query;
-    ctx->current_count = 0;
     ctx->core   = core;
     ctx->operation_type = operation_type;
 
@@ -167,26 +169,18 @@ static void qd_set_properties(qd_message_t         *msg,
 }
 
 
+static void qd_manage_send_response(qd_management_context_t *ctx, const qd_amqp_error_t *status);
+
+
 static void qd_manage_response_handler(void *context, const qd_amqp_error_t *status, bool more)
 {
     qd_management_context_t *ctx = (qd_management_context_t*) context;
-    bool need_free = false;
     if (ctx->operation_type == QD_ROUTER_OPERATION_QUERY) {
-        if (status->status / 100 == 2) { // There is no error, proceed to conditionally call get_next
-            if (more) {
-                ctx->current_count++; // Increment how many you have at hand
-                if (ctx->count != ctx->current_count) {
-                    qdr_query_get_next(ctx->query);
-                    return;
-                } else {
-                    //
-                    // This is one case where the core agent won't free the query itself.
-                    // Don't free immediately as we need status below and it may belong
-                    // to the query.
-                    //
-                    need_free = true;
-                }
-            }
+        if (status->status / 100 == 2 && more) {
+            // There is no error and the requested count has not been reached: the core agent
+            // stops with more == false once it has written count rows
+            qdr_query_get_next(ctx->query);
+            return;
         }
         qd_compose_end_list(ctx->field);
         qd_compose_end_map(ctx->field);
@@ -203,6 +197,15 @@ static void qd_manage_response_handler(void *context, const qd_amqp_error_t *sta
         }
     }
 
+    qd_manage_send_response(ctx, status);
+}
+
+
+/**
+ * Send the response composed in ctx->field with the given status and release the context.
+ */
+static void qd_manage_send_response(qd_management_context_t *ctx, const qd_amqp_error_t *status)
+{
     qd_iterator_t       *reply_to = 0;
     qd_composed_field_t *fld = 0;
 
@@ -228,9 +231,6 @@ static void qd_manage_response_handler(void *context, const qd_amqp_error_t *sta
     qd_message_free(ctx->source);
     qd_compose_free(ctx->field);
 
-    if (need_free) {
-        qdr_query_free(ctx->query);
-    }
     free_qd_management_context_t(ctx);
 }
 
@@ -262,7 +262,7 @@ static void qd_core_agent_query_handler(qdr_core_t                 *core,
 
     qd_iterator_t *body_iter = qd_message_field_iterator(msg, QD_FIELD_BODY);
 
-    qd_parsed_field_t *body = qd_parse(body_iter);
+    qd_parsed_field_t *body = qd_parse_lazy(body_iter);
     if (body != 0 && qd_parse_is_map(body)) {
         attribute_names_parsed_field = qd_parse_value_by_key(body, ATTRIBUTE_NAMES);
     }
@@ -276,13 +276,57 @@ static void qd_core_agent_query_handler(qdr_core_t                 *core,
     qd_compose_insert_string(field, results); //add a "results" key
     qd_compose_start_list(field); //start the list for results
 
-    qdr_query_get_first(ctx->query, (*offset));
+    qdr_query_get_first(ctx->query, (*offset), (*count));
 
     qd_iterator_free(body_iter);
     qd_parse_free(body);
 }
 
 
+/**
+ * Called on a worker thread with the counters copied by the core thread. The body of the response is a single binary
+ * value holding the encoded snapshot, see docs/notes/stats-snapshot.md.
+ */
+static void qd_stats_snapshot_response_handler(void *context, qdr_stats_snapshot_t *snapshot, bool discard)
+{
+    qd_management_context_t *ctx = (qd_management_context_t*) context;
+
+    if (discard) {
+        qd_message_free(ctx->msg);
+        qd_message_free(ctx->source);
+        qd_compose_free(ctx->field);
+        free_qd_management_context_t(ctx);
+        return;
+    }
+
+    if (!snapshot) {
+        qd_compose_insert_null(ctx->field);
+        qd_manage_send_response(ctx, &QD_AMQP_BAD_REQUEST);
+        return;
+    }
+
+    size_t   length;
+    uint8_t *encoded = qdr_stats_snapshot_encode(snapshot, &length);
+    qd_compose_insert_binary(ctx->field, encoded, (uint32_t) length);
+    free(encoded);
+    qdr_stats_snapshot_free(snapshot);
+
+    qd_manage_send_response(ctx, &QD_AMQP_OK);
+}
+
+
+static void qd_core_agent_stats_snapshot_handler(qdr_core_t                 *core,
+                                                 qd_message_t               *msg,
+                                                 qd_router_entity_type_t     entity_type,
+                                                 qd_router_operation_type_t  operation_type)
+{
+    qd_composed_field_t     *body = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
+    qd_management_context_t *ctx  = qd_management_context(qd_message(), msg, body, 0, core, operation_type, 0);
+
+    qdr_request_stats_snapshot(core, entity_type, qd_stats_snapshot_response_handler, ctx);
+}
+
+
 static void qd_core_agent_read_handler(qdr_core_t                 *core,
                                        qd_message_t               *msg,
                                        qd_router_entity_type_t     entity_type,
@@ -327,7 +371,7 @@ static void qd_core_agent_create_handler(qdr_core_t                 *core,
 
     qd_iterator_t *body_iter = qd_message_field_iterator(msg, QD_FIELD_BODY);
 
-    qd_parsed_field_t *in_body = qd_parse(body_iter);
+    qd_parsed_field_t *in_body = qd_parse_lazy(body_iter);
 
     qd_buffer_list_t empty_list;
     DEQ_INIT(empty_list);
@@ -352,7 +396,7 @@ static void qd_core_agent_update_handler(qdr_core_t                 *core,
     qd_management_context_t *ctx = qd_management_context(qd_message(), msg, out_body, 0, core, operation_type, 0);
 
     qd_iterator_t *iter = qd_message_field_iterator(msg, QD_FIELD_BODY);
-    qd_parsed_field_t *in_body= qd_parse(iter);
+    qd_parsed_field_t *in_body= qd_parse_lazy(iter);
     qd_iterator_free(iter);
 
     qdr_manage_update(core, ctx, entity_type, name_iter, identity_iter, in_body, out_body, in_conn);
@@ -435,6 +479,8 @@ static bool qd_can_handle_request(qd_parsed_field_t           *properties_fld,
         *entity_type = QD_ROUTER_ROUTER_METRICS;
     else if (qd_iterator_equal(qd_parse_raw(parsed_field), connection_entity_type))
         *entity_type = QD_ROUTER_CONNECTION;
+    else if (qd_iterator_equal(qd_parse_raw(parsed_field), allocator_entity_type))
+        *entity_type = QD_ROUTER_ALLOCATOR;
     else
         return false;
 
@@ -454,6 +500,9 @@ static bool qd_can_handle_request(qd_parsed_field_t           *properties_fld,
         (*operation_type) = QD_ROUTER_OPERATION_UPDATE;
     else if (qd_iterator_equal(qd_parse_raw(parsed_field), MANAGEMENT_DELETE))
         (*operation_type) = QD_ROUTER_OPERATION_DELETE;
+    else if (qd_iterator_equal(qd_parse_raw(parsed_field), MANAGEMENT_STATS_SNAPSHOT)
+             && (*entity_type == QD_ROUTER_CONNECTION || *entity_type == QD_ROUTER_LINK))
+        (*operation_type) = QD_ROUTER_OPERATION_STATS_SNAPSHOT;
     else
         // This is an unknown operation type. cannot be handled, return false.
         return false;
@@ -516,6 +565,9 @@ uint64_t qdr_management_agent_on_message(void *context, qd_message_t *msg, int u
         case QD_ROUTER_OPERATION_DELETE:
             qd_core_agent_delete_handler(core, msg, entity_type, operation_type, identity_iter, name_iter, in_conn_id);
             break;
+        case QD_ROUTER_OPERATION_STATS_SNAPSHOT:
+            qd_core_agent_stats_snapshot_handler(core, msg, entity_type, operation_type);
+            break;
         }
     } else {
         //
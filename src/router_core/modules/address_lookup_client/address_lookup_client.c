@@ -128,6 +128,13 @@ static qdr_address_t *qdr_lookup_terminus_address_CT(qdr_core_t       *core,
         if (!accept_dynamic)
             return 0;
 
+        //
+        // Reuse an address the connection detached from earlier, if the router keeps them
+        //
+        addr = qdr_dynamic_addr_take_CT(core, conn, dir, terminus);
+        if (addr)
+            return addr;
+
         bool generating = true;
         while (generating) {
             //
@@ -141,13 +148,15 @@ static qdr_address_t *qdr_lookup_terminus_address_CT(qdr_core_t       *core,
             else
                 temp_addr = qdr_generate_mobile_addr(core);
 
-            qd_iterator_t *temp_iter = qd_iterator_string(temp_addr, ITER_VIEW_ADDRESS_HASH);
+            qd_iterator_storage_t storage;
+            qd_iterator_t        *temp_iter = qd_iterator_init_string(&storage, temp_addr, ITER_VIEW_ADDRESS_HASH);
             qd_hash_retrieve(core->addr_hash, temp_iter, (void**) &addr);
             if (!addr) {
                 addr = qdr_address_CT(core, QD_TREATMENT_ANYCAST_BALANCED, 0);
                 qd_hash_insert(core->addr_hash, temp_iter, addr, &addr->hash_handle);
                 DEQ_INSERT_TAIL(core->addrs, addr);
                 qdr_terminus_set_address(terminus, temp_addr);
+                qdr_dynamic_addr_adopt_CT(core, conn, dir, addr, temp_addr);
                 generating = false;
             }
             qd_iterator_free(temp_iter);
@@ -210,7 +219,7 @@ static qdr_address_t *qdr_lookup_terminus_address_CT(qdr_core_t       *core,
             *unavailable = true;
     }
 
-    if (!!addr && addr->core_endpoint != 0)
+    if (!!addr && qdr_address_core_endpoint(addr) != 0)
         *core_endpoint = true;
 
     if (addr)
@@ -267,7 +276,7 @@ static void qdr_link_react_to_first_attach_CT(qdr_core_t       *core,
             && (DEQ_SIZE(addr->subscriptions)
                 || DEQ_SIZE(addr->rlinks)
                 || qd_bitmask_cardinality(addr->rnodes))) {
-            qdr_link_issue_credit_CT(core, link, link->capacity, false);
+            qdr_link_issue_initial_credit_CT(core, link);
         }
 
         //
@@ -25,6 +25,14 @@
 
 #include <stdio.h>
 
+//
+// When the edge advertises QD_CAPABILITY_EDGE_TRACKING_BATCH on its tracking link, the
+// reachability updates raised while processing one core action are sent in a single message
+// whose body is a list of [address, reachable] pairs.  A batch is flushed when it reaches
+// TRACKING_BATCH_MAX updates or when the core gets to the flush action scheduled for it.
+//
+#define TRACKING_BATCH_MAX 1000
+
 typedef struct qdr_addr_tracking_module_context_t     qdr_addr_tracking_module_context_t;
 typedef struct qdr_addr_endpoint_state_t              qdr_addr_endpoint_state_t;
 
@@ -35,6 +43,10 @@ struct qdr_addr_endpoint_state_t {
     qdr_addr_tracking_module_context_t *mc;
     int                                ref_count;
     bool                               closed; // Is the endpoint that this state belong to closed?
+    bool                               batch;  // The peer accepts batched updates
+    bool                               flush_scheduled;
+    qd_composed_field_t               *pending;        // Body of the batch being built
+    int                                pending_count;
 };
 
 DEQ_DECLARE(qdr_addr_endpoint_state_t, qdr_addr_endpoint_state_list_t);
@@ -80,6 +92,26 @@ static qd_message_t *qdcm_edge_create_address_dlv(qdr_core_t *core, qdr_address_
     return msg;
 }
 
+/**
+ * Drop a reference to the endpoint state, freeing it if the endpoint has been closed and
+ * nothing else references it.
+ */
+static void qdrc_endpoint_state_release(qdr_addr_endpoint_state_t *endpoint_state)
+{
+    if (endpoint_state->ref_count == 0 && endpoint_state->closed) {
+        qdr_addr_tracking_module_context_t *mc = endpoint_state->mc;
+        if (mc) {
+            DEQ_REMOVE(mc->endpoint_state_list, endpoint_state);
+        }
+        qd_compose_free(endpoint_state->pending);
+        endpoint_state->pending  = 0;
+        endpoint_state->conn     = 0;
+        endpoint_state->endpoint = 0;
+        free_qdr_addr_endpoint_state_t(endpoint_state);
+    }
+}
+
+
 static qdr_addr_endpoint_state_t *qdrc_get_endpoint_state_for_connection(qdr_addr_endpoint_state_list_t  endpoint_state_list, qdr_connection_t *conn)
 {
     qdr_addr_endpoint_state_t *endpoint_state = DEQ_HEAD(endpoint_state_list);
@@ -113,6 +145,7 @@ static void qdrc_address_endpoint_first_attach(void              *bind_context,
         endpoint_state->endpoint  = endpoint;
         endpoint_state->mc        = bc;
         endpoint_state->conn      = qdrc_endpoint_get_connection_CT(endpoint);
+        endpoint_state->batch     = qdr_terminus_has_capability(remote_target, QD_CAPABILITY_EDGE_TRACKING_BATCH);
         DEQ_INSERT_TAIL(bc->endpoint_state_list, endpoint_state);
         *link_context = endpoint_state;
         qdrc_endpoint_second_attach_CT(bc->core, endpoint, remote_source, remote_target);
@@ -146,23 +179,9 @@ static void qdrc_address_endpoint_cleanup(void *link_context)
 {
     qdr_addr_endpoint_state_t *endpoint_state  = (qdr_addr_endpoint_state_t*) link_context;
     if (endpoint_state) {
-        qdr_addr_tracking_module_context_t *mc = endpoint_state->mc;
         assert (endpoint_state->conn);
         endpoint_state->closed = true;
-        if (endpoint_state->ref_count == 0) {
-
-            //
-            // The endpoint has been closed and no other links are referencing this endpoint. Time to free it.
-            // Clean out all the states held by the link_context (endpoint_state)
-            //
-            if (mc) {
-                DEQ_REMOVE(mc->endpoint_state_list, endpoint_state);
-            }
-
-            endpoint_state->conn = 0;
-            endpoint_state->endpoint = 0;
-            free_qdr_addr_endpoint_state_t(endpoint_state);
-        }
+        qdrc_endpoint_state_release(endpoint_state);
     }
 }
 
@@ -216,18 +235,91 @@ static bool qdrc_can_send_address(qdr_address_t *addr, qdr_connection_t *in_conn
 }
 
 
-static void qdrc_send_message(qdr_core_t *core, qdr_address_t *addr, qdrc_endpoint_t *endpoint, bool insert_addr)
+/**
+ * Send the pending batch of updates, if any, to the edge peer.
+ */
+static void qdrc_flush_batch(qdr_core_t *core, qdr_addr_endpoint_state_t *endpoint_state)
+{
+    qd_composed_field_t *body = endpoint_state->pending;
+    if (!body)
+        return;
+
+    endpoint_state->pending       = 0;
+    endpoint_state->pending_count = 0;
+
+    if (!endpoint_state->endpoint || endpoint_state->closed) {
+        qd_compose_free(body);
+        return;
+    }
+
+    qd_composed_field_t *fld = qd_compose(QD_PERFORMATIVE_HEADER, 0);
+    qd_compose_start_list(fld);
+    qd_compose_insert_bool(fld, 0);     // durable
+    qd_compose_end_list(fld);
+
+    qd_compose_end_list(body);
+
+    qd_message_t *msg = qd_message();
+    qd_message_compose_3(msg, fld, body, true);
+    qd_compose_free(body);
+    qd_compose_free(fld);
+
+    qdr_delivery_t *dlv = qdrc_endpoint_delivery_CT(core, endpoint_state->endpoint, msg);
+    qdrc_endpoint_send_CT(core, endpoint_state->endpoint, dlv, false);
+}
+
+
+static void qdrc_flush_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+
+    qdr_addr_endpoint_state_t *endpoint_state = (qdr_addr_endpoint_state_t*) action->args.general.context_1;
+    endpoint_state->flush_scheduled = false;
+    qdrc_flush_batch(core, endpoint_state);
+    endpoint_state->ref_count--;
+    qdrc_endpoint_state_release(endpoint_state);
+}
+
+
+static void qdrc_send_message(qdr_core_t *core, qdr_address_t *addr, qdr_addr_endpoint_state_t *endpoint_state, bool insert_addr)
 {
     if (!addr)
         return;
 
-    if (!endpoint)
+    if (!endpoint_state->endpoint)
         return;
 
-    qd_message_t *msg = qdcm_edge_create_address_dlv(core, addr, insert_addr);
-    qdr_delivery_t *dlv = qdrc_endpoint_delivery_CT(core, endpoint, msg);
+    if (!endpoint_state->batch) {
+        qd_message_t *msg = qdcm_edge_create_address_dlv(core, addr, insert_addr);
+        qdr_delivery_t *dlv = qdrc_endpoint_delivery_CT(core, endpoint_state->endpoint, msg);
+
+        qdrc_endpoint_send_CT(core, endpoint_state->endpoint, dlv, false);
+        return;
+    }
+
+    if (!endpoint_state->pending) {
+        endpoint_state->pending = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
+        qd_compose_start_list(endpoint_state->pending);
+    }
+
+    qd_compose_start_list(endpoint_state->pending);
+    qd_compose_insert_string(endpoint_state->pending, (const char*) qd_hash_key_by_handle(addr->hash_handle));
+    qd_compose_insert_bool(endpoint_state->pending, insert_addr);
+    qd_compose_end_list(endpoint_state->pending);
 
-    qdrc_endpoint_send_CT(core, endpoint, dlv, false);
+    if (++endpoint_state->pending_count >= TRACKING_BATCH_MAX) {
+        qdrc_flush_batch(core, endpoint_state);
+    } else if (!endpoint_state->flush_scheduled) {
+        //
+        // Hold a reference so the state survives until the flush action runs.
+        //
+        endpoint_state->flush_scheduled = true;
+        endpoint_state->ref_count++;
+        qdr_action_t *action = qdr_action(qdrc_flush_batch_CT, "edge_addr_tracking_flush");
+        action->args.general.context_1 = endpoint_state;
+        qdr_action_enqueue(core, action);
+    }
 }
 
 
@@ -243,12 +335,12 @@ static void qdrc_update_edge_peers(qdr_core_t *core, qdr_address_t *addr, bool r
             if (!!endpoint && !endpoint_state->closed) {
                 if (reachable) {
                     if (!link->edge_reachable && qdrc_can_send_address(addr, endpoint_state->conn)) {
-                        qdrc_send_message(core, addr, endpoint, true);
+                        qdrc_send_message(core, addr, endpoint_state, true);
                         link->edge_reachable = true;
                     }
                 } else {
                     if (link->edge_reachable && !qdrc_can_send_address(addr, endpoint_state->conn)) {
-                        qdrc_send_message(core, addr, endpoint, false);
+                        qdrc_send_message(core, addr, endpoint_state, false);
                         link->edge_reachable = false;
                     }
                 }
@@ -275,12 +367,12 @@ static void qdrc_check_edge_peers(qdr_core_t *core, qdr_address_t *addr)
             if (!!endpoint && !endpoint_state->closed) {
                 if (!link->edge_reachable) {
                     if (qdrc_can_send_address(addr, endpoint_state->conn)) {
-                        qdrc_send_message(core, addr, endpoint, true);
+                        qdrc_send_message(core, addr, endpoint_state, true);
                         link->edge_reachable = true;
                     }
                 } else {
                     if (!qdrc_can_send_address(addr, endpoint_state->conn)) {
-                        qdrc_send_message(core, addr, endpoint, false);
+                        qdrc_send_message(core, addr, endpoint_state, false);
                         link->edge_reachable = false;
                     }
                 }
@@ -357,7 +449,7 @@ static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
                     link->edge_context = endpoint_state;
                     endpoint_state->ref_count++;
                     if (qdrc_can_send_address(addr, link->conn)) {
-                        qdrc_send_message(mc->core, addr, endpoint_state->endpoint, true);
+                        qdrc_send_message(mc->core, addr, endpoint_state, true);
                         link->edge_reachable = true;
                     }
                 }
@@ -374,15 +466,7 @@ static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
                 //
                 // The endpoint has been closed and no other links are referencing this endpoint. Time to free it.
                 //
-                if (endpoint_state->ref_count == 0 && endpoint_state->closed) {
-                    qdr_addr_tracking_module_context_t *mc = endpoint_state->mc;
-                    if (mc) {
-                        DEQ_REMOVE(mc->endpoint_state_list, endpoint_state);
-                    }
-                    endpoint_state->conn = 0;
-                    endpoint_state->endpoint = 0;
-                    free_qdr_addr_endpoint_state_t(endpoint_state);
-                }
+                qdrc_endpoint_state_release(endpoint_state);
             }
             break;
         }
@@ -443,6 +527,7 @@ static void qdrc_edge_address_tracking_final_CT(void *module_context)
     qdr_addr_endpoint_state_t *endpoint_state = DEQ_HEAD(mc->endpoint_state_list);
     while (endpoint_state) {
         DEQ_REMOVE_HEAD(mc->endpoint_state_list);
+        qd_compose_free(endpoint_state->pending);
         free_qdr_addr_endpoint_state_t(endpoint_state);
         endpoint_state = DEQ_HEAD(mc->endpoint_state_list);
     }
@@ -62,8 +62,28 @@
 //    7) For addresses that have at least one local non-proxy destination, maintain inbound links
 //       on each open inter-edge connection.
 //
+//  When an edge connection is established, the existing local addresses are proxied in batches
+//  of RESYNC_BATCH addresses, one batch per background core action, so that a large address
+//  table doesn't hold the core thread for the whole resync.
+//
+//  With edgeUplinks greater than one the connection manager also announces additional active
+//  uplinks.  Each active uplink, the primary included, occupies a slot that indexes the proxy
+//  links of the addresses in qdr_address_ext_t and has its own anonymous sender (1) and address
+//  tracking link (5, 6).  Anycast addresses are proxied over every uplink (3, 4), so the
+//  forwarder shares their deliveries among the uplinks.  Multicast addresses and the edge
+//  downlink (2) stay on the primary: two interiors would each deliver a copy of a multicast
+//  delivery.  When the primary is lost, an additional uplink is promoted and keeps its links.
+//
 
 #define INITIAL_CREDIT 32
+#define RESYNC_BATCH   1000
+
+typedef struct qcm_edge_uplink_t {
+    qcm_edge_addr_proxy_t *ap;
+    qdr_connection_t      *conn;               // Null if the slot is free
+    qdrc_endpoint_t       *tracking_endpoint;
+    int                    index;              // Index of the uplink's proxy links in qdr_address_ext_t
+} qcm_edge_uplink_t;
 
 struct qcm_edge_addr_proxy_t {
     qdr_core_t                *core;
@@ -71,8 +91,11 @@ struct qcm_edge_addr_proxy_t {
     bool                       edge_conn_established;
     qdr_address_t             *edge_conn_addr;
     qdr_connection_t          *edge_conn;
-    qdrc_endpoint_t           *tracking_endpoint;
+    qcm_edge_uplink_t         *primary;                      // The uplink of edge_conn
+    qcm_edge_uplink_t          uplinks[QD_EDGE_MAX_UPLINKS];
     qdrc_endpoint_desc_t       endpoint_descriptor;
+    qdr_address_t             *resync_next;       // Where the next resync batch starts (ref_count held)
+    bool                       resync_scheduled;  // A resync action is pending
 };
 
 
@@ -95,36 +118,84 @@ static qdr_terminus_t *qdr_terminus_normal(const char *addr)
 }
 
 
-static void add_inlink(qcm_edge_addr_proxy_t *ap, const char *key, qdr_address_t *addr)
+// The proxy links of an address on an uplink, null if it has none
+static qdr_link_t *addr_edge_inlink(qdr_address_t *addr, int index)
+{
+    return addr->ext ? safe_deref_qdr_link_t(addr->ext->edge_inlink_sp[index]) : 0;
+}
+
+
+static qdr_link_t *addr_edge_outlink(qdr_address_t *addr, int index)
+{
+    return addr->ext ? safe_deref_qdr_link_t(addr->ext->edge_outlink_sp[index]) : 0;
+}
+
+
+// The active uplink over a connection, null if the connection is not one
+static qcm_edge_uplink_t *uplink_for_conn(qcm_edge_addr_proxy_t *ap, const qdr_connection_t *conn)
 {
-    qdr_link_t *edge_inlink = safe_deref_qdr_link_t(addr->edge_inlink_sp);
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+        if (conn && ap->uplinks[i].conn == conn)
+            return &ap->uplinks[i];
+    }
+    return 0;
+}
+
+
+// True if the list has links and all of them are on uplinks, i.e. they are the proxies of other routers
+static bool only_uplink_links(qcm_edge_addr_proxy_t *ap, const qdr_link_ref_list_t *links)
+{
+    const qdr_link_ref_t *ref = DEQ_HEAD(*links);
+    if (!ref)
+        return false;
+    for (; ref; ref = DEQ_NEXT(ref)) {
+        if (!uplink_for_conn(ap, ref->link->conn))
+            return false;
+    }
+    return true;
+}
+
+
+/**
+ * Multicast addresses are only proxied over the primary uplink, a copy of each delivery
+ * forwarded by two interiors would reach the consumers twice.
+ */
+static bool proxy_on_uplink(const qcm_edge_uplink_t *uplink, qdr_address_t *addr)
+{
+    return uplink->conn && (uplink == uplink->ap->primary || !qdr_is_addr_treatment_multicast(addr));
+}
+
+
+static void add_inlink(qcm_edge_uplink_t *uplink, const char *key, qdr_address_t *addr)
+{
+    qdr_link_t *edge_inlink = addr_edge_inlink(addr, uplink->index);
     if (edge_inlink == 0) {
         qdr_terminus_t *term = qdr_terminus_normal(key + 1);
 
-        qdr_link_t *link = qdr_create_link_CT(ap->core, ap->edge_conn, QD_LINK_ENDPOINT, QD_INCOMING,
+        qdr_link_t *link = qdr_create_link_CT(uplink->ap->core, uplink->conn, QD_LINK_ENDPOINT, QD_INCOMING,
                                               term, qdr_terminus_normal(0), QD_SSN_ENDPOINT,
                                               QDR_DEFAULT_PRIORITY);
         link->proxy = true;
-        qdr_core_bind_address_link_CT(ap->core, addr, link);
-        set_safe_ptr_qdr_link_t(link, &addr->edge_inlink_sp);
+        qdr_core_bind_address_link_CT(uplink->ap->core, addr, link);
+        set_safe_ptr_qdr_link_t(link, &qdr_address_ext_CT(addr)->edge_inlink_sp[uplink->index]);
     }
 }
 
 
-static void del_inlink(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+static void del_inlink(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr, int index)
 {
-    qdr_link_t *link = safe_deref_qdr_link_t(addr->edge_inlink_sp);
+    qdr_link_t *link = addr_edge_inlink(addr, index);
     if (link) {
-        qd_nullify_safe_ptr(&addr->edge_inlink_sp);
+        qd_nullify_safe_ptr(&addr->ext->edge_inlink_sp[index]);
         qdr_core_unbind_address_link_CT(ap->core, addr, link);
         qdr_link_outbound_detach_CT(ap->core, link, 0, QDR_CONDITION_NONE);
     }
 }
 
 
-static void add_outlink(qcm_edge_addr_proxy_t *ap, const char *key, qdr_address_t *addr)
+static void add_outlink(qcm_edge_uplink_t *uplink, const char *key, qdr_address_t *addr)
 {
-    qdr_link_t *edge_outlink = safe_deref_qdr_link_t(addr->edge_outlink_sp);
+    qdr_link_t *edge_outlink = addr_edge_outlink(addr, uplink->index);
     if (edge_outlink == 0 && DEQ_SIZE(addr->subscriptions) == 0) {
         //
         // Note that this link must not be bound to the address at this time.  That will
@@ -133,26 +204,58 @@ static void add_outlink(qcm_edge_addr_proxy_t *ap, const char *key, qdr_address_
         //
         qdr_terminus_t *term = qdr_terminus_normal(key + 1);
 
-        qdr_link_t *link = qdr_create_link_CT(ap->core, ap->edge_conn, QD_LINK_ENDPOINT, QD_OUTGOING,
+        qdr_link_t *link = qdr_create_link_CT(uplink->ap->core, uplink->conn, QD_LINK_ENDPOINT, QD_OUTGOING,
                                               qdr_terminus_normal(0), term, QD_SSN_ENDPOINT,
                                               QDR_DEFAULT_PRIORITY);
         link->proxy = true;
-        set_safe_ptr_qdr_link_t(link, &addr->edge_outlink_sp);
+        set_safe_ptr_qdr_link_t(link, &qdr_address_ext_CT(addr)->edge_outlink_sp[uplink->index]);
     }
 }
 
 
-static void del_outlink(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+static void del_outlink(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr, int index)
 {
-    qdr_link_t *link = safe_deref_qdr_link_t(addr->edge_outlink_sp);
+    qdr_link_t *link = addr_edge_outlink(addr, index);
     if (link) {
-        qd_nullify_safe_ptr(&addr->edge_outlink_sp);
+        qd_nullify_safe_ptr(&addr->ext->edge_outlink_sp[index]);
         qdr_core_unbind_address_link_CT(ap->core, addr, link);
         qdr_link_outbound_detach_CT(ap->core, link, 0, QDR_CONDITION_NONE);
     }
 }
 
 
+static void add_inlinks(qcm_edge_addr_proxy_t *ap, const char *key, qdr_address_t *addr)
+{
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+        if (proxy_on_uplink(&ap->uplinks[i], addr))
+            add_inlink(&ap->uplinks[i], key, addr);
+    }
+}
+
+
+static void del_inlinks(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+{
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++)
+        del_inlink(ap, addr, i);
+}
+
+
+static void add_outlinks(qcm_edge_addr_proxy_t *ap, const char *key, qdr_address_t *addr)
+{
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+        if (proxy_on_uplink(&ap->uplinks[i], addr))
+            add_outlink(&ap->uplinks[i], key, addr);
+    }
+}
+
+
+static void del_outlinks(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+{
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++)
+        del_outlink(ap, addr, i);
+}
+
+
 static void proxy_addr_on_inter_edge_connection(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr, qdr_connection_t *conn)
 {
     const char     *key  = (const char*) qd_hash_key_by_handle(addr->hash_handle);
@@ -203,6 +306,112 @@ static void on_inter_edge_connection_opened(qcm_edge_addr_proxy_t *ap, qdr_conne
 }
 
 
+/**
+ * Create the proxy links over the active uplinks for a local address that has
+ * destinations or sources.  Links that already exist are kept.
+ */
+static void proxy_local_addr(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+{
+    const char *key = (const char*) qd_hash_key_by_handle(addr->hash_handle);
+    if (*key != QD_ITER_HASH_PREFIX_MOBILE)
+        return;
+
+    //
+    // If the address has more than zero attached destinations, create an
+    // incoming link from the interior to signal the presence of local consumers.
+    //
+    if (DEQ_SIZE(addr->rlinks) > 0 || (DEQ_SIZE(addr->subscriptions) > 0 && addr->propagate_local)) {
+        //
+        // If all of the links are on uplinks, ignore the address.
+        //
+        if (!only_uplink_links(ap, &addr->rlinks))
+            add_inlinks(ap, key, addr);
+    }
+
+    //
+    // If the address has more than zero attached sources, create an outgoing link
+    // to the interior to signal the presence of local producers.
+    //
+    if (DEQ_SIZE(addr->inlinks) > 0 || qdr_address_watch_count(addr) > 0) {
+        //
+        // If all of the links are on uplinks, ignore the address.
+        //
+        if (qdr_address_watch_count(addr) > 0 || !only_uplink_links(ap, &addr->inlinks))
+            add_outlinks(ap, key, addr);
+    }
+}
+
+
+/**
+ * Move the resync cursor, holding a reference on the new position so the address can't be freed
+ * between batches, and releasing the old one.
+ */
+static void set_resync_next(qcm_edge_addr_proxy_t *ap, qdr_address_t *addr)
+{
+    qdr_address_t *old = ap->resync_next;
+    ap->resync_next = addr;
+    if (addr)
+        addr->ref_count++;
+    if (old && --old->ref_count == 0)
+        qdr_check_addr_CT(ap->core, old);
+}
+
+
+static void resync_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
+
+static void schedule_resync(qcm_edge_addr_proxy_t *ap)
+{
+    if (!ap->resync_scheduled) {
+        ap->resync_scheduled = true;
+        qdr_action_t *action = qdr_action(resync_batch_CT, "edge_addr_proxy_resync");
+        action->args.general.context_1 = ap;
+        qdr_action_background_enqueue(ap->core, action);
+    }
+}
+
+
+static void resync_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+
+    qcm_edge_addr_proxy_t *ap = (qcm_edge_addr_proxy_t*) action->args.general.context_1;
+    ap->resync_scheduled = false;
+
+    //
+    // The edge connections were lost since this batch was scheduled.
+    //
+    if (!ap->edge_conn_established || !ap->resync_next)
+        return;
+
+    qdr_address_t *addr  = ap->resync_next;
+    int            count = 0;
+    while (addr && count < RESYNC_BATCH) {
+        proxy_local_addr(ap, addr);
+        addr = DEQ_NEXT(addr);
+        count++;
+    }
+
+    set_resync_next(ap, addr);
+    if (addr)
+        schedule_resync(ap);
+    else
+        qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Edge Address Proxy: local addresses proxied on edge connection");
+}
+
+
+/**
+ * (Re)start the resync from the head of the address table.  A restart covers the uplinks that
+ * joined since the last one started, the addresses already proxied on the others are skipped.
+ */
+static void restart_resync(qcm_edge_addr_proxy_t *ap)
+{
+    set_resync_next(ap, DEQ_HEAD(ap->core->addrs));
+    if (ap->resync_next)
+        schedule_resync(ap);
+}
+
+
 static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
 {
     if (!link || !link->conn)
@@ -218,14 +427,16 @@ static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
         case QDRC_EVENT_LINK_OUT_DETACHED: {
             qdr_address_t *addr = link->owning_addr;
             if (addr) {
-                qdr_link_t *edge_outlink = safe_deref_qdr_link_t(addr->edge_outlink_sp);
-                if (link == edge_outlink) {
-                    //
-                    // The link is being detached. If the detaching link is the same as the link's owning_addr's edge_outlink,
-                    // set the edge_outlink on the address to be zero. We do this because this link is going to be freed
-                    // and we don't want anyone dereferencing the addr->edge_outlink
-                    //
-                    qd_nullify_safe_ptr(&addr->edge_outlink_sp);
+                for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+                    qdr_link_t *edge_outlink = addr_edge_outlink(addr, i);
+                    if (link == edge_outlink) {
+                        //
+                        // The link is being detached. If the detaching link is the same as the link's owning_addr's edge_outlink,
+                        // set the edge_outlink on the address to be zero. We do this because this link is going to be freed
+                        // and we don't want anyone dereferencing the addr->edge_outlink
+                        //
+                        qd_nullify_safe_ptr(&addr->ext->edge_outlink_sp[i]);
+                    }
                 }
             }
             break;
@@ -234,14 +445,16 @@ static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
         case QDRC_EVENT_LINK_IN_DETACHED: {
             qdr_address_t *addr = link->owning_addr;
             if (addr) {
-                qdr_link_t *edge_inlink = safe_deref_qdr_link_t(addr->edge_inlink_sp);
-                if (link == edge_inlink) {
-                    //
-                    // The link is being detached. If the detaching link is the same as the link's owning_addr's edge_inlink,
-                    // set the edge_inlink on the address to be zero. We do this because this link is going to be freed
-                    // and we don't want anyone dereferencing the addr->edge_inlink
-                    //
-                    qd_nullify_safe_ptr(&addr->edge_inlink_sp);
+                for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+                    qdr_link_t *edge_inlink = addr_edge_inlink(addr, i);
+                    if (link == edge_inlink) {
+                        //
+                        // The link is being detached. If the detaching link is the same as the link's owning_addr's edge_inlink,
+                        // set the edge_inlink on the address to be zero. We do this because this link is going to be freed
+                        // and we don't want anyone dereferencing the addr->edge_inlink
+                        //
+                        qd_nullify_safe_ptr(&addr->ext->edge_inlink_sp[i]);
+                    }
                 }
             }
             break;
@@ -254,6 +467,71 @@ static void on_link_event(void *context, qdrc_event_t event, qdr_link_t *link)
 }
 
 
+/**
+ * Start using an edge connection as an uplink: take a free slot and attach the links that every
+ * uplink has.
+ */
+static qcm_edge_uplink_t *open_uplink(qcm_edge_addr_proxy_t *ap, qdr_connection_t *conn)
+{
+    qcm_edge_uplink_t *uplink = 0;
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS && !uplink; i++) {
+        if (!ap->uplinks[i].conn)
+            uplink = &ap->uplinks[i];
+    }
+
+    //
+    // The connection manager keeps no more than edgeUplinks connections active.
+    //
+    assert(uplink);
+    if (!uplink)
+        return 0;
+    uplink->conn = conn;
+
+    //
+    // Attach an anonymous sending link to the interior router.
+    //
+    qdr_link_t *out_link = qdr_create_link_CT(ap->core, conn,
+                                              QD_LINK_ENDPOINT, QD_OUTGOING,
+                                              qdr_terminus(0), qdr_terminus(0),
+                                              QD_SSN_ENDPOINT,
+                                              QDR_DEFAULT_PRIORITY);
+    out_link->proxy = true;
+
+    //
+    // Associate the anonymous sender with the edge connection address.  This will cause
+    // all deliveries destined off-edge to be sent to the interior via the edge connections.
+    //
+    qdr_core_bind_address_link_CT(ap->core, ap->edge_conn_addr, out_link);
+
+    //
+    // Attach a receiving link for edge address tracking updates.  The capability tells
+    // the interior that we accept batched tracking updates.  Each interior reports the
+    // destinations it can reach, the updates apply to the proxy links of this uplink.
+    //
+    qdr_terminus_t *tracking_target = qdr_terminus(0);
+    qdr_terminus_add_capability(tracking_target, QD_CAPABILITY_EDGE_TRACKING_BATCH);
+    uplink->tracking_endpoint =
+        qdrc_endpoint_create_link_CT(ap->core, conn, QD_INCOMING,
+                                     qdr_terminus_normal(QD_TERMINUS_EDGE_ADDRESS_TRACKING),
+                                     tracking_target, &ap->endpoint_descriptor, uplink);
+    return uplink;
+}
+
+
+/**
+ * Release the slot of a lost uplink.  The links over the connection were freed with it.
+ */
+static void close_uplink(qcm_edge_uplink_t *uplink)
+{
+    if (uplink) {
+        uplink->conn              = 0;
+        uplink->tracking_endpoint = 0;
+        if (uplink->ap->primary == uplink)
+            uplink->ap->primary = 0;
+    }
+}
+
+
 static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *conn)
 {
     qcm_edge_addr_proxy_t *ap = (qcm_edge_addr_proxy_t*) context;
@@ -267,26 +545,20 @@ static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *c
 
     case QDRC_EVENT_CONN_EDGE_ESTABLISHED : {
         //
-        // Flag the edge connection as being established.
+        // An additional uplink that is promoted to primary keeps the links it has.
         //
-        ap->edge_conn_established = true;
-        ap->edge_conn             = conn;
-
-        //
-        // Attach an anonymous sending link to the interior router.
-        //
-        qdr_link_t *out_link = qdr_create_link_CT(ap->core, conn,
-                                                  QD_LINK_ENDPOINT, QD_OUTGOING,
-                                                  qdr_terminus(0), qdr_terminus(0),
-                                                  QD_SSN_ENDPOINT,
-                                                  QDR_DEFAULT_PRIORITY);
-        out_link->proxy = true;
+        qcm_edge_uplink_t *uplink = uplink_for_conn(ap, conn);
+        if (!uplink)
+            uplink = open_uplink(ap, conn);
+        if (!uplink)
+            break;
 
         //
-        // Associate the anonymous sender with the edge connection address.  This will cause
-        // all deliveries destined off-edge to be sent to the interior via the edge connection.
+        // Flag the edge connection as being established.
         //
-        qdr_core_bind_address_link_CT(ap->core, ap->edge_conn_addr, out_link);
+        ap->edge_conn_established = true;
+        ap->edge_conn             = conn;
+        ap->primary               = uplink;
 
         //
         // Attach a receiving link for edge summary.  This will cause all deliveries
@@ -300,65 +572,28 @@ static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *c
         elink->proxy = true;
 
         //
-        // Attach a receiving link for edge address tracking updates.
-        //
-        ap->tracking_endpoint =
-            qdrc_endpoint_create_link_CT(ap->core, conn, QD_INCOMING,
-                                         qdr_terminus_normal(QD_TERMINUS_EDGE_ADDRESS_TRACKING),
-                                         qdr_terminus(0), &ap->endpoint_descriptor, ap);
-
-        //
-        // Process eligible local destinations
+        // Process eligible local destinations, a batch at a time.  Addresses that change
+        // in the meantime are proxied by on_addr_event.  After a promotion this only adds
+        // the multicast addresses, the others are proxied already.
         //
-        qdr_address_t *addr = DEQ_HEAD(ap->core->addrs);
-        while (addr) {
-            const char *key = (const char*) qd_hash_key_by_handle(addr->hash_handle);
-            if (*key == QD_ITER_HASH_PREFIX_MOBILE) {
-                //
-                // If the address has more than zero attached destinations, create an
-                // incoming link from the interior to signal the presence of local consumers.
-                //
-                if (DEQ_SIZE(addr->rlinks) > 0 || (DEQ_SIZE(addr->subscriptions) > 0 && addr->propagate_local)) {
-                    if (DEQ_SIZE(addr->rlinks) == 1) { // TODO - fix this logic
-                        //
-                        // If there's only one link and it's on the edge connection, ignore the address.
-                        //
-                        qdr_link_ref_t *ref = DEQ_HEAD(addr->rlinks);
-                        if (ref->link->conn != ap->edge_conn)
-                            add_inlink(ap, key, addr);
-                    } else
-                        add_inlink(ap, key, addr);
-                }
-
-                //
-                // If the address has more than zero attached sources, create an outgoing link
-                // to the interior to signal the presence of local producers.
-                //
-                bool add = false;
-                if (DEQ_SIZE(addr->inlinks) > 0 || DEQ_SIZE(addr->watches) > 0) {
-                    if (DEQ_SIZE(addr->inlinks) == 1 && DEQ_SIZE(addr->watches) == 0) {
-                        //
-                        // If there's only one link and it's on the edge connection, ignore the address.
-                        //
-                        qdr_link_ref_t *ref = DEQ_HEAD(addr->inlinks);
-                        if (ref->link->conn != ap->edge_conn)
-                            add = true;
-                    } else
-                        add = true;
-
-                    if (add) {
-                        add_outlink(ap, key, addr);
-                    }
-                }
-            }
-            addr = DEQ_NEXT(addr);
-        }
+        restart_resync(ap);
         break;
     }
 
     case QDRC_EVENT_CONN_EDGE_LOST :
+        close_uplink(uplink_for_conn(ap, conn));
         ap->edge_conn_established = false;
         ap->edge_conn             = 0;
+        set_resync_next(ap, 0);
+        break;
+
+    case QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED :
+        if (ap->edge_conn_established && open_uplink(ap, conn))
+            restart_resync(ap);
+        break;
+
+    case QDRC_EVENT_CONN_EDGE_UPLINK_LOST :
+        close_uplink(uplink_for_conn(ap, conn));
         break;
 
     default:
@@ -409,32 +644,43 @@ static void on_addr_event(void *context, qdrc_event_t event, qdr_address_t *addr
     switch (event) {
     case QDRC_EVENT_ADDR_ADDED_LOCAL_DEST :
         if (DEQ_SIZE(addr->rlinks) - addr->proxy_rlink_count == 1) {
-            add_inlink(ap, key, addr);
+            add_inlinks(ap, key, addr);
         }
         break;
 
     case QDRC_EVENT_ADDR_REMOVED_LOCAL_DEST :
-        if (DEQ_SIZE(addr->rlinks) - addr->proxy_rlink_count == 0) {
-            del_inlink(ap, addr);
+        //
+        // The uplink proxies of a dynamic address kept for reuse by its connection are withdrawn once the
+        // address is released (QDRC_EVENT_ADDR_POOL_RELEASED), see qdr_dynamic_addr_detached_CT()
+        //
+        if (DEQ_SIZE(addr->rlinks) - addr->proxy_rlink_count == 0 && !qdr_address_reusable_CT(addr)) {
+            del_inlinks(ap, addr);
         }
         break;
 
     case QDRC_EVENT_ADDR_BECAME_SOURCE :
-        add_outlink(ap, key, addr);
+        add_outlinks(ap, key, addr);
         break;
 
     case QDRC_EVENT_ADDR_NO_LONGER_SOURCE :
-        if (DEQ_SIZE(addr->watches) == 0)
-            del_outlink(ap, addr);
+        if (qdr_address_watch_count(addr) == 0 && !qdr_address_reusable_CT(addr))
+            del_outlinks(ap, addr);
+        break;
+
+    case QDRC_EVENT_ADDR_POOL_RELEASED :
+        if (DEQ_SIZE(addr->rlinks) - addr->proxy_rlink_count == 0)
+            del_inlinks(ap, addr);
+        if (DEQ_SIZE(addr->inlinks) == addr->proxy_inlink_count && qdr_address_watch_count(addr) == 0)
+            del_outlinks(ap, addr);
         break;
 
     case QDRC_EVENT_ADDR_WATCH_ON :
-        add_outlink(ap, key, addr);
+        add_outlinks(ap, key, addr);
         break;
 
     case QDRC_EVENT_ADDR_WATCH_OFF :
         if (DEQ_SIZE(addr->inlinks) == addr->proxy_inlink_count) {
-            del_outlink(ap, addr);
+            del_outlinks(ap, addr);
         }
         break;
 
@@ -449,20 +695,60 @@ static void on_second_attach(void           *link_context,
                              qdr_terminus_t *remote_source,
                              qdr_terminus_t *remote_target)
 {
-    qcm_edge_addr_proxy_t *ap = (qcm_edge_addr_proxy_t*) link_context;
+    qcm_edge_uplink_t *uplink = (qcm_edge_uplink_t*) link_context;
 
-    qdrc_endpoint_flow_CT(ap->core, ap->tracking_endpoint, INITIAL_CREDIT, false);
+    qdrc_endpoint_flow_CT(uplink->ap->core, uplink->tracking_endpoint, INITIAL_CREDIT, false);
 
     qdr_terminus_free(remote_source);
     qdr_terminus_free(remote_target);
 }
 
 
+/**
+ * Apply one tracking update: a list with two elements.  The first is an address and the
+ * second is a boolean indicating whether that address has upstream destinations via the
+ * uplink's interior.
+ */
+static void apply_tracking_update(qcm_edge_uplink_t *uplink, qd_parsed_field_t *update)
+{
+    qcm_edge_addr_proxy_t *ap = uplink->ap;
+
+    if (!update || !qd_parse_is_list(update) || qd_parse_sub_count(update) != 2)
+        return;
+
+    qd_parsed_field_t *addr_field = qd_parse_sub_value(update, 0);
+    qd_parsed_field_t *dest_field = qd_parse_sub_value(update, 1);
+
+    if (qd_parse_is_scalar(addr_field) && qd_parse_is_scalar(dest_field)) {
+        qd_iterator_t *addr_iter = qd_parse_raw(addr_field);
+        bool           dest      = qd_parse_as_bool(dest_field);
+        qdr_address_t *addr;
+
+        qd_iterator_reset_view(addr_iter, ITER_VIEW_ALL);
+        qd_hash_retrieve(ap->core->addr_hash, addr_iter, (void**) &addr);
+        if (addr) {
+            qdr_link_t *link = addr_edge_outlink(addr, uplink->index);
+            if (link) {
+                if (dest) {
+                    if (link->owning_addr == 0) {
+                        qdr_core_bind_address_link_CT(ap->core, addr, link);
+                    }
+                } else {
+                    if (link->owning_addr == addr) {
+                        qdr_core_unbind_address_link_CT(ap->core, addr, link);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
 static void on_transfer(void           *link_context,
                         qdr_delivery_t *dlv,
                         qd_message_t   *msg)
 {
-    qcm_edge_addr_proxy_t *ap = (qcm_edge_addr_proxy_t*) link_context;
+    qcm_edge_uplink_t *uplink = (qcm_edge_uplink_t*) link_context;
     uint64_t dispo = PN_ACCEPTED;
 
     //
@@ -470,36 +756,18 @@ static void on_transfer(void           *link_context,
     //
     if (qd_message_check_depth(msg, QD_DEPTH_BODY) == QD_MESSAGE_DEPTH_OK) {
         //
-        // Get the message body.  It must be a list with two elements.  The first is an address
-        // and the second is a boolean indicating whether that address has upstream destinations.
+        // The message body is either a single update (see apply_tracking_update) or, since
+        // we advertise QD_CAPABILITY_EDGE_TRACKING_BATCH, a list of updates applied in order.
         //
         qd_iterator_t     *iter = qd_message_field_iterator(msg, QD_FIELD_BODY);
         qd_parsed_field_t *body = qd_parse(iter);
-        if (!!body && qd_parse_is_list(body) && qd_parse_sub_count(body) == 2) {
-            qd_parsed_field_t *addr_field = qd_parse_sub_value(body, 0);
-            qd_parsed_field_t *dest_field = qd_parse_sub_value(body, 1);
-
-            if (qd_parse_is_scalar(addr_field) && qd_parse_is_scalar(dest_field)) {
-                qd_iterator_t *addr_iter = qd_parse_raw(addr_field);
-                bool           dest      = qd_parse_as_bool(dest_field);
-                qdr_address_t *addr;
-
-                qd_iterator_reset_view(addr_iter, ITER_VIEW_ALL);
-                qd_hash_retrieve(ap->core->addr_hash, addr_iter, (void**) &addr);
-                if (addr) {
-                    qdr_link_t *link = safe_deref_qdr_link_t(addr->edge_outlink_sp);
-                    if (link) {
-                        if (dest) {
-                            if (link->owning_addr == 0) {
-                                qdr_core_bind_address_link_CT(ap->core, addr, link);
-                            }
-                        } else {
-                            if (link->owning_addr == addr) {
-                                qdr_core_unbind_address_link_CT(ap->core, addr, link);
-                            }
-                        }
-                    }
-                }
+        if (!!body && qd_parse_is_list(body)) {
+            qd_parsed_field_t *first = qd_field_first_child(body);
+            if (!!first && qd_parse_is_list(first)) {
+                for (qd_parsed_field_t *update = first; !!update; update = qd_field_next_child(update))
+                    apply_tracking_update(uplink, update);
+            } else {
+                apply_tracking_update(uplink, body);
             }
         }
 
@@ -511,12 +779,12 @@ static void on_transfer(void           *link_context,
         dispo = PN_REJECTED;
     }
 
-    qdrc_endpoint_settle_CT(ap->core, dlv, dispo);
+    qdrc_endpoint_settle_CT(uplink->ap->core, dlv, dispo);
 
     //
     // Replenish the credit for this delivery
     //
-    qdrc_endpoint_flow_CT(ap->core, ap->tracking_endpoint, 1, false);
+    qdrc_endpoint_flow_CT(uplink->ap->core, uplink->tracking_endpoint, 1, false);
 }
 
 qdr_address_t *qcm_edge_conn_addr(void *link_context)
@@ -530,9 +798,9 @@ qdr_address_t *qcm_edge_conn_addr(void *link_context)
 
 static void on_cleanup(void *link_context)
 {
-    qcm_edge_addr_proxy_t *ap = (qcm_edge_addr_proxy_t*) link_context;
+    qcm_edge_uplink_t *uplink = (qcm_edge_uplink_t*) link_context;
 
-    ap->tracking_endpoint = 0;
+    uplink->tracking_endpoint = 0;
 }
 
 
@@ -542,6 +810,10 @@ qcm_edge_addr_proxy_t *qcm_edge_addr_proxy(qdr_core_t *core)
 
     ZERO(ap);
     ap->core = core;
+    for (int i = 0; i < QD_EDGE_MAX_UPLINKS; i++) {
+        ap->uplinks[i].ap    = ap;
+        ap->uplinks[i].index = i;
+    }
 
     ap->endpoint_descriptor.label            = "Edge Address Proxy";
     ap->endpoint_descriptor.on_second_attach = on_second_attach;
@@ -559,11 +831,14 @@ qcm_edge_addr_proxy_t *qcm_edge_addr_proxy(qdr_core_t *core)
     ap->event_sub = qdrc_event_subscribe_CT(core,
                                             QDRC_EVENT_CONN_EDGE_ESTABLISHED
                                             | QDRC_EVENT_CONN_EDGE_LOST
+                                            | QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED
+                                            | QDRC_EVENT_CONN_EDGE_UPLINK_LOST
                                             | QDRC_EVENT_CONN_OPENED
                                             | QDRC_EVENT_ADDR_ADDED_LOCAL_DEST
                                             | QDRC_EVENT_ADDR_REMOVED_LOCAL_DEST
                                             | QDRC_EVENT_ADDR_BECAME_SOURCE
                                             | QDRC_EVENT_ADDR_NO_LONGER_SOURCE
+                                            | QDRC_EVENT_ADDR_POOL_RELEASED
                                             | QDRC_EVENT_ADDR_WATCH_ON
                                             | QDRC_EVENT_ADDR_WATCH_OFF
                                             | QDRC_EVENT_LINK_IN_DETACHED
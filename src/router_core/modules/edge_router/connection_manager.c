@@ -39,14 +39,74 @@
 //     QDRC_EVENT_CONN_EDGE_ESTABLISHED
 //     QDRC_EVENT_CONN_EDGE_LOST
 //
+// If the router is configured with more than one edgeUplinks, up to that many
+// edge connections are active at once.  The first is the primary and is
+// announced with the events above.  The others are additional uplinks that
+// carry a share of the edge traffic and are announced with:
+//
+//     QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED
+//     QDRC_EVENT_CONN_EDGE_UPLINK_LOST
+//
+// When the primary is lost an additional uplink is promoted in its place, so
+// the links already proxied over it stay in use.  Edge connections beyond
+// edgeUplinks stand by to fill the slots of lost uplinks.
+//
 
 struct qcm_edge_conn_mgr_t {
     qdr_core_t                *core;
     qdrc_event_subscription_t *event_sub;
     qdr_connection_t          *active_edge_connection;
+    qdr_connection_t          *uplinks[QD_EDGE_MAX_UPLINKS - 1];  // Additional active edge connections, null if free
 };
 
 
+static int uplink_index(qcm_edge_conn_mgr_t *cm, qdr_connection_t *conn)
+{
+    for (int i = 0; i < cm->core->edge_uplinks - 1; i++) {
+        if (cm->uplinks[i] == conn)
+            return i;
+    }
+    return -1;
+}
+
+
+static void add_uplink_CT(qcm_edge_conn_mgr_t *cm, int index, qdr_connection_t *conn)
+{
+    qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
+           "Edge connection (id=%" PRIu64 ") to interior established as additional uplink", conn->identity);
+    cm->uplinks[index] = conn;
+    conn->edge_uplink  = true;
+    qdrc_event_conn_raise(cm->core, QDRC_EVENT_CONN_EDGE_UPLINK_ESTABLISHED, conn);
+}
+
+
+static void remove_uplink_CT(qcm_edge_conn_mgr_t *cm, int index)
+{
+    qdr_connection_t *conn = cm->uplinks[index];
+    cm->uplinks[index] = 0;
+    conn->edge_uplink  = false;
+}
+
+
+/**
+ * Fill the free additional uplink slots with standby edge connections, other than the closing one.
+ */
+static void fill_uplinks_CT(qcm_edge_conn_mgr_t *cm, qdr_connection_t *closing)
+{
+    qdr_connection_t *standby = DEQ_HEAD(cm->core->open_connections);
+    for (int i = 0; i < cm->core->edge_uplinks - 1; i++) {
+        if (cm->uplinks[i])
+            continue;
+        while (standby && (standby == closing || standby->role != QDR_ROLE_EDGE_CONNECTION
+                           || standby == cm->active_edge_connection || standby->edge_uplink))
+            standby = DEQ_NEXT(standby);
+        if (!standby)
+            return;
+        add_uplink_CT(cm, i, standby);
+    }
+}
+
+
 static qdr_edge_peer_t *qdr_find_edge_peer_CT(qdr_core_t *core, const char *container_id)
 {
     qdr_edge_peer_t *edge_peer = DEQ_HEAD(core->edge_peers);
@@ -143,6 +203,10 @@ static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *c
                 cm->active_edge_connection       = conn;
                 cm->core->active_edge_connection = conn;
                 qdrc_event_conn_raise(cm->core, QDRC_EVENT_CONN_EDGE_ESTABLISHED, conn);
+        } else if (conn->role == QDR_ROLE_EDGE_CONNECTION) {
+            int free_slot = uplink_index(cm, 0);
+            if (free_slot >= 0)
+                add_uplink_CT(cm, free_slot, conn);
         }
 
         if (conn->role == QDR_ROLE_INTER_EDGE) {
@@ -157,9 +221,22 @@ static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *c
     case QDRC_EVENT_CONN_CLOSED :
         if (cm->active_edge_connection == conn) {
             qdrc_event_conn_raise(cm->core, QDRC_EVENT_CONN_EDGE_LOST, conn);
-            qdr_connection_t *alternate = DEQ_HEAD(cm->core->open_connections);
-            while (alternate && (alternate == conn || alternate->role != QDR_ROLE_EDGE_CONNECTION))
-                alternate = DEQ_NEXT(alternate);
+
+            //
+            // Prefer an additional uplink as the alternate, it already has the address proxies in place.
+            //
+            qdr_connection_t *alternate = 0;
+            for (int i = 0; i < cm->core->edge_uplinks - 1 && !alternate; i++) {
+                if (cm->uplinks[i]) {
+                    alternate = cm->uplinks[i];
+                    remove_uplink_CT(cm, i);
+                }
+            }
+            if (!alternate) {
+                alternate = DEQ_HEAD(cm->core->open_connections);
+                while (alternate && (alternate == conn || alternate->role != QDR_ROLE_EDGE_CONNECTION))
+                    alternate = DEQ_NEXT(alternate);
+            }
             if (alternate) {
                 qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
                        "Edge connection (id=%" PRIu64 ") to interior lost, activating alternate id=%" PRIu64 "",
@@ -173,6 +250,13 @@ static void on_conn_event(void *context, qdrc_event_t event, qdr_connection_t *c
                        conn->identity);
                 cm->active_edge_connection = 0;
             }
+            fill_uplinks_CT(cm, conn);
+        } else if (conn->role == QDR_ROLE_EDGE_CONNECTION && conn->edge_uplink) {
+            qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
+                   "Edge connection (id=%" PRIu64 ") to interior lost, was an additional uplink", conn->identity);
+            remove_uplink_CT(cm, uplink_index(cm, conn));
+            qdrc_event_conn_raise(cm->core, QDRC_EVENT_CONN_EDGE_UPLINK_LOST, conn);
+            fill_uplinks_CT(cm, conn);
         }
 
         //
@@ -195,6 +279,7 @@ qcm_edge_conn_mgr_t *qcm_edge_conn_mgr(qdr_core_t *core)
 {
     qcm_edge_conn_mgr_t *cm = NEW(qcm_edge_conn_mgr_t);
 
+    ZERO(cm);
     cm->core = core;
     cm->event_sub = qdrc_event_subscribe_CT(core,
                                             QDRC_EVENT_CONN_OPENED | QDRC_EVENT_CONN_CLOSED,
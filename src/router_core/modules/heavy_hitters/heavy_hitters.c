@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "module.h"
+#include "router_core_private.h"
+#include "sketch.h"
+
+#include "qpid/dispatch/compose.h"
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/hash.h"
+#include "qpid/dispatch/metrics.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+//
+// Heavy hitter tracking: the addresses and connections that carry the most deliveries and octets.
+//
+// Each measure is counted in a Space-Saving sketch of HH_CAPACITY counters.  A key with a counter adds to it, a new
+// key takes over the smallest counter and inherits its count as the error bound of its own.  Any key with more than
+// 1/HH_CAPACITY of the window total is guaranteed to hold a counter, and the count of a key over-estimates its true
+// count by at most its error.  The sketches are reset every HH_WINDOW_SECS seconds (tumbling windows) after the top
+// HH_TOP_K keys of each have been kept as the report of the completed window, read by management and exported as
+// gauges.
+//
+// All state is owned by the core thread.
+//
+
+#define HH_WINDOW_SECS 5
+
+typedef enum {
+    HH_ADDRESS_DELIVERIES,
+    HH_ADDRESS_OCTETS,
+    HH_CONNECTION_DELIVERIES,
+    HH_CONNECTION_OCTETS,
+    HH_SKETCH_COUNT
+} hh_measure_t;
+
+static const char *const report_names[HH_SKETCH_COUNT] = {"addressDeliveries", "addressOctets",
+                                                          "connectionDeliveries", "connectionOctets"};
+static const char *const metric_names[HH_SKETCH_COUNT] = {
+    "qdr_heavy_hitter_address_deliveries", "qdr_heavy_hitter_address_octets",
+    "qdr_heavy_hitter_connection_deliveries", "qdr_heavy_hitter_connection_octets"};
+
+struct qdr_heavy_hitters_t {
+    qdr_core_t       *core;
+    qdr_core_timer_t *timer;
+    hh_sketch_t       sketches[HH_SKETCH_COUNT];
+    hh_report_t       reports[HH_SKETCH_COUNT];  // of the last completed window
+    qd_metric_t      *gauges[HH_SKETCH_COUNT][HH_TOP_K];
+};
+
+
+static void update_gauges_CT(qdr_heavy_hitters_t *hh)
+{
+    for (int m = 0; m < HH_SKETCH_COUNT; m++) {
+        const bool   address = m == HH_ADDRESS_DELIVERIES || m == HH_ADDRESS_OCTETS;
+        hh_report_t *report  = &hh->reports[m];
+
+        for (int r = 0; r < HH_TOP_K; r++) {
+            qd_metric_free(hh->gauges[m][r]);
+            hh->gauges[m][r] = 0;
+            if (r >= report->count)
+                continue;
+
+            if (address) {
+                hh->gauges[m][r] = qd_metric(QD_METRIC_GAUGE, metric_names[m], "address", report->top[r].name);
+            } else {
+                char identity[24];
+                snprintf(identity, sizeof(identity), "%" PRIu64, report->top[r].key);
+                const char *const label_names[]  = {"connection", "host"};
+                const char *const label_values[] = {identity, report->top[r].name};
+                hh->gauges[m][r] = qd_metric_labels(QD_METRIC_GAUGE, metric_names[m], 2, label_names, label_values);
+            }
+            qd_metric_set(hh->gauges[m][r], report->top[r].count);
+        }
+    }
+}
+
+
+static void on_window_end_CT(qdr_core_t *core, void *context)
+{
+    qdr_heavy_hitters_t *hh = (qdr_heavy_hitters_t*) context;
+
+    for (int m = 0; m < HH_SKETCH_COUNT; m++) {
+        hh_sketch_top(&hh->sketches[m], &hh->reports[m]);
+        hh_sketch_reset(&hh->sketches[m]);
+    }
+    update_gauges_CT(hh);
+
+    qdr_core_timer_schedule_CT(core, hh->timer, HH_WINDOW_SECS);
+}
+
+
+void qdr_heavy_hitters_record_CT(qdr_heavy_hitters_t *hh, qdr_address_t *addr, qdr_connection_t *conn,
+                                 uint64_t octets)
+{
+    const char *address = addr->hash_handle ? (const char*) qd_hash_key_by_handle(addr->hash_handle) : 0;
+    hh_sketch_add(&hh->sketches[HH_ADDRESS_DELIVERIES], (uint64_t) (uintptr_t) addr, 1, address);
+    hh_sketch_add(&hh->sketches[HH_ADDRESS_OCTETS], (uint64_t) (uintptr_t) addr, octets, address);
+
+    if (conn) {
+        const char *host = conn->connection_info ? conn->connection_info->host : 0;
+        hh_sketch_add(&hh->sketches[HH_CONNECTION_DELIVERIES], conn->identity, 1, host);
+        hh_sketch_add(&hh->sketches[HH_CONNECTION_OCTETS], conn->identity, octets, host);
+    }
+}
+
+
+void qdr_heavy_hitters_forget_address_CT(qdr_heavy_hitters_t *hh, qdr_address_t *addr)
+{
+    // the reports keep copies of the names, only the keys of the current window may be reused
+    hh_sketch_remove(&hh->sketches[HH_ADDRESS_DELIVERIES], (uint64_t) (uintptr_t) addr);
+    hh_sketch_remove(&hh->sketches[HH_ADDRESS_OCTETS], (uint64_t) (uintptr_t) addr);
+}
+
+
+void qdr_heavy_hitters_write_CT(const qdr_heavy_hitters_t *hh, qd_composed_field_t *body)
+{
+    qd_compose_start_map(body);
+    if (hh) {
+        qd_compose_insert_string(body, "windowSeconds");
+        qd_compose_insert_uint(body, HH_WINDOW_SECS);
+        for (int m = 0; m < HH_SKETCH_COUNT; m++) {
+            const bool         address = m == HH_ADDRESS_DELIVERIES || m == HH_ADDRESS_OCTETS;
+            const hh_report_t *report  = &hh->reports[m];
+
+            qd_compose_insert_string(body, report_names[m]);
+            qd_compose_start_list(body);
+            for (int r = 0; r < report->count; r++) {
+                qd_compose_start_map(body);
+                if (address) {
+                    qd_compose_insert_string(body, "address");
+                    qd_compose_insert_string(body, report->top[r].name);
+                } else {
+                    qd_compose_insert_string(body, "connection");
+                    qd_compose_insert_ulong(body, report->top[r].key);
+                    qd_compose_insert_string(body, "host");
+                    qd_compose_insert_string(body, report->top[r].name);
+                }
+                qd_compose_insert_string(body, "count");
+                qd_compose_insert_ulong(body, report->top[r].count);
+                qd_compose_insert_string(body, "error");
+                qd_compose_insert_ulong(body, report->top[r].error);
+                qd_compose_end_map(body);
+            }
+            qd_compose_end_list(body);
+        }
+    }
+    qd_compose_end_map(body);
+}
+
+
+static bool qdrc_heavy_hitters_enable_CT(qdr_core_t *core)
+{
+    return true;
+}
+
+
+static void qdrc_heavy_hitters_init_CT(qdr_core_t *core, void **module_context)
+{
+    qdr_heavy_hitters_t *hh = NEW(qdr_heavy_hitters_t);
+    ZERO(hh);
+    hh->core = core;
+    for (int m = 0; m < HH_SKETCH_COUNT; m++)
+        hh_sketch_reset(&hh->sketches[m]);
+    hh->timer = qdr_core_timer_CT(core, on_window_end_CT, hh);
+    qdr_core_timer_schedule_CT(core, hh->timer, HH_WINDOW_SECS);
+
+    core->heavy_hitters = hh;
+    *module_context     = hh;
+}
+
+
+static void qdrc_heavy_hitters_final_CT(void *module_context)
+{
+    qdr_heavy_hitters_t *hh = (qdr_heavy_hitters_t*) module_context;
+
+    hh->core->heavy_hitters = 0;
+    qdr_core_timer_free_CT(hh->core, hh->timer);
+    for (int m = 0; m < HH_SKETCH_COUNT; m++) {
+        for (int r = 0; r < HH_TOP_K; r++)
+            qd_metric_free(hh->gauges[m][r]);
+    }
+    free(hh);
+}
+
+
+QDR_CORE_MODULE_DECLARE("heavy_hitters", qdrc_heavy_hitters_enable_CT, qdrc_heavy_hitters_init_CT, qdrc_heavy_hitters_final_CT)
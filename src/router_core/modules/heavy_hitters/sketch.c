@@ -0,0 +1,155 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "sketch.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static inline unsigned home_slot(uint64_t key)
+{
+    return (unsigned) qd_hash_mix(key ^ QD_HASH_SEED_0, QD_HASH_SEED_1) & (HH_INDEX_SLOTS - 1);
+}
+
+
+void hh_sketch_reset(hh_sketch_t *sketch)
+{
+    sketch->used = 0;
+    memset(sketch->index, -1, sizeof(sketch->index));
+}
+
+
+/**
+ * The counter index of key, -1 if it has none.  *slot is set to the slot holding it, or to the empty slot that ends
+ * its probe sequence.
+ */
+static int sketch_find(const hh_sketch_t *sketch, uint64_t key, unsigned *slot)
+{
+    unsigned s = home_slot(key);
+    while (sketch->index[s] >= 0) {
+        if (sketch->counters[sketch->index[s]].key == key) {
+            *slot = s;
+            return sketch->index[s];
+        }
+        s = (s + 1) & (HH_INDEX_SLOTS - 1);
+    }
+    *slot = s;
+    return -1;
+}
+
+
+/**
+ * Empty a slot of the index, shifting the entries probed past it back so no probe sequence is broken.
+ */
+static void sketch_unindex(hh_sketch_t *sketch, unsigned slot)
+{
+    unsigned hole = slot;
+    unsigned next = (slot + 1) & (HH_INDEX_SLOTS - 1);
+    while (sketch->index[next] >= 0) {
+        unsigned home = home_slot(sketch->counters[sketch->index[next]].key);
+        // the entry may fill the hole if the hole lies on its probe sequence, between its home slot and its slot
+        if (((next - home) & (HH_INDEX_SLOTS - 1)) >= ((next - hole) & (HH_INDEX_SLOTS - 1))) {
+            sketch->index[hole] = sketch->index[next];
+            hole = next;
+        }
+        next = (next + 1) & (HH_INDEX_SLOTS - 1);
+    }
+    sketch->index[hole] = -1;
+}
+
+
+void hh_sketch_add(hh_sketch_t *sketch, uint64_t key, uint64_t weight, const char *name)
+{
+    unsigned slot;
+    int      i = sketch_find(sketch, key, &slot);
+    if (i >= 0) {
+        sketch->counters[i].count += weight;
+        return;
+    }
+
+    uint64_t inherited = 0;
+    if (sketch->used < HH_CAPACITY) {
+        i = sketch->used++;
+    } else {
+        i = 0;
+        for (int c = 1; c < HH_CAPACITY; c++) {
+            if (sketch->counters[c].count < sketch->counters[i].count)
+                i = c;
+        }
+        inherited = sketch->counters[i].count;
+        unsigned evicted;
+        (void) sketch_find(sketch, sketch->counters[i].key, &evicted);
+        sketch_unindex(sketch, evicted);
+        (void) sketch_find(sketch, key, &slot);  // the shift may have moved the end of the probe sequence
+    }
+
+    hh_counter_t *counter = &sketch->counters[i];
+    counter->key   = key;
+    counter->count = inherited + weight;
+    counter->error = inherited;
+    snprintf(counter->name, sizeof(counter->name), "%s", name ? name : "");
+    sketch->index[slot] = (int8_t) i;
+}
+
+
+void hh_sketch_remove(hh_sketch_t *sketch, uint64_t key)
+{
+    unsigned slot;
+    int      i = sketch_find(sketch, key, &slot);
+    if (i < 0)
+        return;
+    sketch_unindex(sketch, slot);
+
+    // keep the counters dense: move the last one into the freed counter
+    int last = --sketch->used;
+    if (i != last) {
+        (void) sketch_find(sketch, sketch->counters[last].key, &slot);
+        sketch->counters[i] = sketch->counters[last];
+        sketch->index[slot] = (int8_t) i;
+    }
+}
+
+
+const hh_counter_t *hh_sketch_counter(const hh_sketch_t *sketch, uint64_t key)
+{
+    unsigned slot;
+    int      i = sketch_find(sketch, key, &slot);
+    return i >= 0 ? &sketch->counters[i] : 0;
+}
+
+
+void hh_sketch_top(const hh_sketch_t *sketch, hh_report_t *report)
+{
+    bool taken[HH_CAPACITY] = {false};
+
+    report->count = MIN(sketch->used, HH_TOP_K);
+    for (int r = 0; r < report->count; r++) {
+        int best = -1;
+        for (int c = 0; c < sketch->used; c++) {
+            if (!taken[c] && (best < 0 || sketch->counters[c].count > sketch->counters[best].count))
+                best = c;
+        }
+        taken[best]     = true;
+        report->top[r] = sketch->counters[best];
+    }
+}
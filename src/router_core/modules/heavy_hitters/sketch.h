@@ -0,0 +1,69 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef qcm_heavy_hitters_sketch
+#define qcm_heavy_hitters_sketch 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// The Space-Saving sketch of the heavy_hitters module, see heavy_hitters.c.  Keys are counted in HH_CAPACITY counters
+// found through an open addressing index, a key without a counter takes over the smallest one once all are in use.
+//
+
+#define HH_CAPACITY    64   // counters per sketch
+#define HH_INDEX_SLOTS 128  // power of two, keeps the index at most half full
+#define HH_TOP_K       10
+#define HH_NAME_MAX    64
+
+typedef struct hh_counter_t {
+    uint64_t key;    // address pointer or connection identity
+    uint64_t count;
+    uint64_t error;  // count inherited from the evicted counter, the most count may over-estimate
+    char     name[HH_NAME_MAX];  // address or connection host, copied when the key takes the counter
+} hh_counter_t;
+
+typedef struct hh_sketch_t {
+    hh_counter_t counters[HH_CAPACITY];
+    int          used;
+    int8_t       index[HH_INDEX_SLOTS];  // linear probing table of counters by key, -1: empty slot
+} hh_sketch_t;
+
+typedef struct hh_report_t {
+    hh_counter_t top[HH_TOP_K];  // largest count first
+    int          count;
+} hh_report_t;
+
+
+void hh_sketch_reset(hh_sketch_t *sketch);
+void hh_sketch_add(hh_sketch_t *sketch, uint64_t key, uint64_t weight, const char *name);
+void hh_sketch_remove(hh_sketch_t *sketch, uint64_t key);
+
+/**
+ * The counter of key, 0 if it has none.
+ */
+const hh_counter_t *hh_sketch_counter(const hh_sketch_t *sketch, uint64_t key);
+
+/**
+ * Fill report with the HH_TOP_K counters of the sketch that have the largest counts.
+ */
+void hh_sketch_top(const hh_sketch_t *sketch, hh_report_t *report);
+
+#endif
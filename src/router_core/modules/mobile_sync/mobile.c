@@ -43,6 +43,21 @@ static const char *ADD        = "add";
 static const char *DEL        = "del";
 static const char *EXIST      = "exist";
 static const char *HAVE_SEQ   = "have_seq";
+static const char *DIGEST     = "digest";
+static const char *RANGES     = "ranges";
+static const char *MORE       = "more";
+
+//
+// Address digest ranges.  Mobile addresses are partitioned into MOBILE_SYNC_RANGES ranges by
+// the top bits of a hash of their hash key.  A MAR carries a digest per range of the addresses
+// the requester has for the target router.  The target answers with absolute MAU chunks that
+// cover only the ranges whose digests differ, at most MOBILE_SYNC_CHUNK_ADDRS addresses per
+// chunk (a single range is never split across chunks).
+//
+#define MOBILE_SYNC_RANGE_BITS  6
+#define MOBILE_SYNC_RANGES      (1 << MOBILE_SYNC_RANGE_BITS)
+#define MOBILE_SYNC_ALL_RANGES  UINT64_MAX
+#define MOBILE_SYNC_CHUNK_ADDRS 10000
 
 //
 // qdr_address_t.sync_mask bit values
@@ -52,12 +67,14 @@ static const char *HAVE_SEQ   = "have_seq";
 #define ADDR_SYNC_ADDRESS_IN_UPDATE_LIST  0x00000004
 #define ADDR_SYNC_ADDRESS_TO_BE_DELETED   0x00000008
 #define ADDR_SYNC_ADDRESS_MOBILE_TRACKING 0x00000010
+#define ADDR_SYNC_ADDRESS_KEY_HASHED      0x00000020
 
 //
 // qdr_node_t.sync_mask bit values
 //
 #define ADDR_SYNC_ROUTER_MA_REQUESTED     0x00000001
 #define ADDR_SYNC_ROUTER_VERSION_LOGGED   0x00000002
+#define ADDR_SYNC_ROUTER_DIGEST_PENDING   0x00000004
 
 typedef struct {
     qdr_core_t                *core;
@@ -67,6 +84,7 @@ typedef struct {
     qdr_subscription_t        *message_sub2;
     uint64_t                   mobile_seq;
     qdr_address_list_t         sync_addrs;
+    qd_compose_template_t     *mau_headers;  ///< headers of the differential MAU, the same in every one
 } qdrm_mobile_sync_t;
 
 /**
@@ -106,6 +124,8 @@ static qd_address_treatment_t qcm_mobile_sync_default_treatment(qdr_core_t *core
         return QD_TREATMENT_ANYCAST_CLOSEST;
     case QD_TREATMENT_ANYCAST_BALANCED:
         return QD_TREATMENT_ANYCAST_BALANCED;
+    case QD_TREATMENT_ANYCAST_AFFINITY:
+        return QD_TREATMENT_ANYCAST_AFFINITY;
     case QD_TREATMENT_UNAVAILABLE:
         return QD_TREATMENT_UNAVAILABLE;
     default:
@@ -121,6 +141,55 @@ static bool qcm_mobile_sync_addr_is_mobile(qdr_address_t *addr)
 }
 
 
+/**
+ * The digest hashes are part of the protocol and must not change with the internal hash
+ * table implementation, hence the use of a fixed FNV-1a here.
+ */
+static uint64_t qcm_mobile_sync_fnv(uint64_t hash, const unsigned char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t qcm_mobile_sync_key_hash(qdr_address_t *addr)
+{
+    if (!BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_KEY_HASHED)) {
+        const char *hash_key = (const char*) qd_hash_key_by_handle(addr->hash_handle);
+        addr->sync_key_hash  = qcm_mobile_sync_fnv(0xcbf29ce484222325ULL, (const unsigned char*) hash_key, strlen(hash_key));
+        BIT_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_KEY_HASHED);
+    }
+    return addr->sync_key_hash;
+}
+
+
+static int qcm_mobile_sync_addr_range(qdr_address_t *addr)
+{
+    return (int) (qcm_mobile_sync_key_hash(addr) >> (64 - MOBILE_SYNC_RANGE_BITS));
+}
+
+
+/**
+ * The digest contribution of one address: its hash key and, if present, its sole-destination mesh.
+ * Contributions are XOR-ed together per range so they are run through a finalizer first.
+ */
+static uint64_t qcm_mobile_sync_digest_entry(qdr_address_t *addr, const char *mesh)
+{
+    uint64_t hash = qcm_mobile_sync_key_hash(addr);
+    if (!!mesh && mesh[0] != '\0')
+        hash = qcm_mobile_sync_fnv(hash, (const unsigned char*) mesh, QD_DISCRIMINATOR_BYTES);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
 static qdr_node_t *qcm_mobile_sync_router_by_id(qdrm_mobile_sync_t *msync, qd_parsed_field_t *id_field)
 {
     if (!id_field)
@@ -260,16 +329,21 @@ static qd_iterator_t *qcm_mobile_sync_parse_addr_descriptor(qd_parsed_field_t *f
 }
 
 
-static void qcm_mobile_sync_compose_diff_addr_list_add(qdrm_mobile_sync_t *msync, qd_composed_field_t *field)
+/**
+ * The differential list composers consume at most *budget entries from the sync list (in the order
+ * the changes occurred), leaving the rest for the next update.
+ */
+static void qcm_mobile_sync_compose_diff_addr_list_add(qdrm_mobile_sync_t *msync, qd_composed_field_t *field, size_t *budget)
 {
     qd_compose_start_list(field);
     qdr_address_t *addr = DEQ_HEAD(msync->sync_addrs);
-    while (addr) {
+    while (addr && *budget > 0) {
         qdr_address_t *next = DEQ_NEXT_N(SYNC, addr);
         if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST | ADDR_SYNC_ADDRESS_IN_UPDATE_LIST)) {
             qcm_mobile_sync_compose_addr_descriptor(addr, field, true);
             DEQ_REMOVE_N(SYNC, msync->sync_addrs, addr);
             BIT_CLEAR(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST | ADDR_SYNC_ADDRESS_IN_UPDATE_LIST);
+            (*budget)--;
         }
         addr = next;
     }
@@ -277,17 +351,18 @@ static void qcm_mobile_sync_compose_diff_addr_list_add(qdrm_mobile_sync_t *msync
 }
 
 
-static void qcm_mobile_sync_compose_diff_addr_list_del(qdrm_mobile_sync_t *msync, qd_composed_field_t *field)
+static void qcm_mobile_sync_compose_diff_addr_list_del(qdrm_mobile_sync_t *msync, qd_composed_field_t *field, size_t *budget)
 {
     qd_compose_start_list(field);
     qdr_address_t *addr = DEQ_HEAD(msync->sync_addrs);
-    while (addr) {
+    while (addr && *budget > 0) {
         qdr_address_t *next = DEQ_NEXT_N(SYNC, addr);
         if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST)) {
             qcm_mobile_sync_compose_addr_descriptor(addr, field, false);
             DEQ_REMOVE_N(SYNC, msync->sync_addrs, addr);
             BIT_CLEAR(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST);
             qcm_mobile_sync_stop_tracking(msync->core, addr);
+            (*budget)--;
         }
         addr = next;
     }
@@ -295,10 +370,20 @@ static void qcm_mobile_sync_compose_diff_addr_list_del(qdrm_mobile_sync_t *msync
 }
 
 
-static qd_message_t *qcm_mobile_sync_compose_differential_mau(qdrm_mobile_sync_t *msync, const char *address)
+/**
+ * Compose a differential MAU for all the other routers.  Its headers are composed once and copied from the template
+ * in every later update.
+ */
+static qd_message_t *qcm_mobile_sync_compose_differential_mau(qdrm_mobile_sync_t *msync, size_t *budget)
 {
+    if (!msync->mau_headers) {
+        qd_composed_field_t *field = qcm_mobile_sync_message_headers("_topo/0/all/qdrouter.ma", MAU);
+        msync->mau_headers = qd_compose_template(field);
+        qd_compose_free(field);
+    }
+
     qd_message_t        *msg     = qd_message();
-    qd_composed_field_t *headers = qcm_mobile_sync_message_headers(address, MAU);
+    qd_composed_field_t *headers = qd_compose_from_template(msync->mau_headers, 0);
     qd_composed_field_t *body    = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
 
     //
@@ -318,10 +403,10 @@ static qd_message_t *qcm_mobile_sync_compose_differential_mau(qdrm_mobile_sync_t
     qd_compose_insert_long(body, msync->mobile_seq);
 
     qd_compose_insert_symbol(body, ADD);
-    qcm_mobile_sync_compose_diff_addr_list_add(msync, body);
+    qcm_mobile_sync_compose_diff_addr_list_add(msync, body, budget);
 
     qd_compose_insert_symbol(body, DEL);
-    qcm_mobile_sync_compose_diff_addr_list_del(msync, body);
+    qcm_mobile_sync_compose_diff_addr_list_del(msync, body, budget);
 
     qd_compose_end_map(body);
 
@@ -332,6 +417,27 @@ static qd_message_t *qcm_mobile_sync_compose_differential_mau(qdrm_mobile_sync_t
 }
 
 
+/**
+ * For an address to be included in an absolute MAU, it must:
+ *   - be a mobile address
+ *   - have at least one local consumer or in-process subscription
+ *     _OR_ be in the delete list (because the peers haven't heard of its pending deletion)
+ *   - not be in the add list (because the peers haven't heard of its pending addition)
+ *
+ * Note that in the two add/del list cases, we are reporting information that is not currently
+ * accurate.  In these cases, a differential MAU will be sent very shortly that will put the
+ * peer router in the correct state.
+ */
+static bool qcm_mobile_sync_addr_is_exported(qdr_address_t *addr)
+{
+    return qcm_mobile_sync_addr_is_mobile(addr)
+        && (DEQ_SIZE(addr->rlinks) > 0
+            || (DEQ_SIZE(addr->subscriptions) > 0 && addr->propagate_local)
+            || BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST))
+        && !BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST);
+}
+
+
 static qd_message_t *qcm_mobile_sync_compose_absolute_mau(qdrm_mobile_sync_t *msync, const char *address)
 {
     qd_message_t        *msg     = qd_message();
@@ -355,22 +461,7 @@ static qd_message_t *qcm_mobile_sync_compose_absolute_mau(qdrm_mobile_sync_t *ms
     qd_compose_start_list(body);
     qdr_address_t *addr = DEQ_HEAD(msync->core->addrs);
     while (!!addr) {
-        //
-        // For an address to be included in the list, it must:
-        //   - be a mobile address
-        //   - have at least one local consumer or in-process subscription
-        //     _OR_ be in the delete list (because the peers haven't heard of its pending deletion)
-        //   - not be in the add list (because the peers haven't heard of its pending addition)
-        //
-        // Note that in the two add/del list cases, we are reporting information that is not currently
-        // accurate.  In these cases, a differential MAU will be sent very shortly that will put the
-        // peer router in the correct state.
-        //
-        if (qcm_mobile_sync_addr_is_mobile(addr)
-            && (DEQ_SIZE(addr->rlinks) > 0
-                || (DEQ_SIZE(addr->subscriptions) > 0 && addr->propagate_local)
-                || BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST))
-            && !BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST)) {
+        if (qcm_mobile_sync_addr_is_exported(addr)) {
             qcm_mobile_sync_compose_addr_descriptor(addr, body, true);
         }
         addr = DEQ_NEXT(addr);
@@ -384,6 +475,160 @@ static qd_message_t *qcm_mobile_sync_compose_absolute_mau(qdrm_mobile_sync_t *ms
 }
 
 
+/**
+ * Compose one chunk of a range-limited absolute MAU.  The receiver replaces its view of the
+ * addresses in the 'ranges' set with the 'exist' list.  All chunks but the last carry 'more'
+ * so the receiver only advances the mobile_seq when the whole update has arrived.
+ */
+static qd_message_t *qcm_mobile_sync_compose_absolute_mau_chunk(qdrm_mobile_sync_t *msync, const char *address,
+                                                                qdr_address_t **addrs, size_t count,
+                                                                uint64_t ranges, bool more)
+{
+    qd_message_t        *msg     = qd_message();
+    qd_composed_field_t *headers = qcm_mobile_sync_message_headers(address, MAU);
+    qd_composed_field_t *body    = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
+
+    qd_compose_start_map(body);
+    qd_compose_insert_symbol(body, ID);
+    qd_compose_insert_string(body, msync->core->router_id);
+
+    qd_compose_insert_symbol(body, PV);
+    qd_compose_insert_long(body, PROTOCOL_VERSION);
+
+    qd_compose_insert_symbol(body, AREA);
+    qd_compose_insert_string(body, msync->core->router_area);
+
+    qd_compose_insert_symbol(body, MOBILE_SEQ);
+    qd_compose_insert_long(body, msync->mobile_seq);
+
+    qd_compose_insert_symbol(body, RANGES);
+    qd_compose_insert_ulong(body, ranges);
+
+    qd_compose_insert_symbol(body, MORE);
+    qd_compose_insert_bool(body, more);
+
+    qd_compose_insert_symbol(body, EXIST);
+    qd_compose_start_list(body);
+    for (size_t i = 0; i < count; i++) {
+        qcm_mobile_sync_compose_addr_descriptor(addrs[i], body, true);
+    }
+    qd_compose_end_list(body);
+    qd_compose_end_map(body);
+    qd_message_compose_3(msg, headers, body, true);
+    qd_compose_free(headers);
+    qd_compose_free(body);
+    return msg;
+}
+
+
+/**
+ * Compute the per-range digests of the addresses we export to the other routers.
+ */
+static void qcm_mobile_sync_local_digest(qdrm_mobile_sync_t *msync, uint64_t *digest, size_t *counts)
+{
+    qdr_address_t *addr = DEQ_HEAD(msync->core->addrs);
+    while (!!addr) {
+        if (qcm_mobile_sync_addr_is_exported(addr)) {
+            int range = qcm_mobile_sync_addr_range(addr);
+            digest[range] ^= qcm_mobile_sync_digest_entry(addr, addr->local_sole_destination_mesh ? addr->destination_mesh_id : 0);
+            counts[range]++;
+        }
+        addr = DEQ_NEXT(addr);
+    }
+}
+
+
+/**
+ * Compute the per-range digests of the addresses we have mapped to a remote router.
+ */
+static void qcm_mobile_sync_router_digest(qdrm_mobile_sync_t *msync, qdr_node_t *router, uint64_t *digest)
+{
+    qdr_address_t *addr = DEQ_HEAD(msync->core->addrs);
+    while (!!addr) {
+        if (qcm_mobile_sync_addr_is_mobile(addr) && !!qd_bitmask_value(addr->rnodes, router->mask_bit)) {
+            const char *mesh = !!addr->remote_sole_destination_meshes
+                ? addr->remote_sole_destination_meshes + (QD_DISCRIMINATOR_BYTES * router->mask_bit) : 0;
+            digest[qcm_mobile_sync_addr_range(addr)] ^= qcm_mobile_sync_digest_entry(addr, mesh);
+        }
+        addr = DEQ_NEXT(addr);
+    }
+}
+
+
+/**
+ * Send a requestor the absolute MAU chunks for the ranges where its digest differs from ours.
+ * At least one (possibly empty) chunk is always sent so the requestor's mobile_seq advances.
+ */
+static void qcm_mobile_sync_send_absolute_mau_chunks_CT(qdrm_mobile_sync_t *msync, qdr_node_t *router,
+                                                        const uint64_t *peer_digest)
+{
+    uint64_t digest[MOBILE_SYNC_RANGES] = {0};
+    size_t   counts[MOBILE_SYNC_RANGES] = {0};
+    size_t   offset[MOBILE_SYNC_RANGES + 1];
+    uint64_t stale = 0;
+
+    qcm_mobile_sync_local_digest(msync, digest, counts);
+
+    offset[0] = 0;
+    for (int r = 0; r < MOBILE_SYNC_RANGES; r++) {
+        if (digest[r] != peer_digest[r]) {
+            stale |= (uint64_t) 1 << r;
+        } else {
+            counts[r] = 0;
+        }
+        offset[r + 1] = offset[r] + counts[r];
+    }
+
+    //
+    // Bucket the addresses in the stale ranges by range
+    //
+    size_t          total = offset[MOBILE_SYNC_RANGES];
+    qdr_address_t **addrs = total > 0 ? NEW_PTR_ARRAY(qdr_address_t, total) : 0;
+    size_t          fill[MOBILE_SYNC_RANGES];
+    memcpy(fill, offset, sizeof(fill));
+
+    qdr_address_t *addr = DEQ_HEAD(msync->core->addrs);
+    while (!!addr && total > 0) {
+        if (qcm_mobile_sync_addr_is_exported(addr)) {
+            int range = qcm_mobile_sync_addr_range(addr);
+            if (stale & ((uint64_t) 1 << range))
+                addrs[fill[range]++] = addr;
+        }
+        addr = DEQ_NEXT(addr);
+    }
+
+    int  start  = 0;
+    int  chunks = 0;
+    bool more;
+    do {
+        int    end   = start;
+        size_t count = 0;
+        while (end < MOBILE_SYNC_RANGES && (count == 0 || count + counts[end] <= MOBILE_SYNC_CHUNK_ADDRS)) {
+            count += counts[end];
+            end++;
+        }
+
+        uint64_t upto   = end == MOBILE_SYNC_RANGES ? MOBILE_SYNC_ALL_RANGES : ((uint64_t) 1 << end) - 1;
+        uint64_t ranges = stale & upto & ~(((uint64_t) 1 << start) - 1);
+        more = (stale & ~upto) != 0;
+
+        qd_message_t *mau = qcm_mobile_sync_compose_absolute_mau_chunk(msync, router->wire_address_ma,
+                                                                       addrs ? addrs + offset[start] : 0, count,
+                                                                       ranges, more);
+        (void) qdr_forward_message_CT(msync->core, router->owning_addr, mau, 0, true, true);
+        qd_message_free(mau);
+        chunks++;
+        start = end;
+    } while (more);
+
+    free(addrs);
+
+    qd_log(LOG_ROUTER_MA, QD_LOG_DEBUG,
+           "Sent MAU to requestor: mobile_seq=%" PRIu64 ", stale_ranges=%d, addrs=%zu, chunks=%d",
+           msync->mobile_seq, __builtin_popcountll(stale), total, chunks);
+}
+
+
 static qd_message_t *qcm_mobile_sync_compose_mar(qdrm_mobile_sync_t *msync, qdr_node_t *router)
 {
     qd_message_t        *msg     = qd_message();
@@ -403,6 +648,17 @@ static qd_message_t *qcm_mobile_sync_compose_mar(qdrm_mobile_sync_t *msync, qdr_
     qd_compose_insert_symbol(body, HAVE_SEQ);
     qd_compose_insert_long(body, router->mobile_seq);
 
+    uint64_t digest[MOBILE_SYNC_RANGES] = {0};
+    if (router->mobile_seq > 0)
+        qcm_mobile_sync_router_digest(msync, router, digest);
+
+    qd_compose_insert_symbol(body, DIGEST);
+    qd_compose_start_list(body);
+    for (int r = 0; r < MOBILE_SYNC_RANGES; r++) {
+        qd_compose_insert_ulong(body, digest[r]);
+    }
+    qd_compose_end_list(body);
+
     qd_compose_end_map(body);
 
     qd_message_compose_3(msg, headers, body, true);
@@ -453,17 +709,16 @@ static void qcm_mobile_sync_on_timer_CT(qdr_core_t *core, void *context)
     qdrm_mobile_sync_t *msync = (qdrm_mobile_sync_t*) context;
 
     //
-    // Re-schedule the timer for the next go-around
+    // Re-schedule the timer for the next go-around.  Changes accumulate (and opposite changes
+    // to the same address cancel out) for the whole hold-down interval.
     //
-    qdr_core_timer_schedule_CT(core, msync->timer, 0);
+    qdr_core_timer_schedule_CT(core, msync->timer, core->qd->mobile_addr_hold_down - 1);
 
     //
     // Check the add and delete lists.  If they are empty, nothing of note occured in the last
     // interval.  Exit the handler function.
     //
-    size_t sync_count = DEQ_SIZE(msync->sync_addrs);
-
-    if (sync_count == 0)
+    if (DEQ_SIZE(msync->sync_addrs) == 0)
         return;
 
     //
@@ -474,7 +729,14 @@ static void qcm_mobile_sync_on_timer_CT(qdr_core_t *core, void *context)
     //
     // Prepare a differential MAU for sending to all the other routers.
     //
-    qd_message_t *mau = qcm_mobile_sync_compose_differential_mau(msync, "_topo/0/all/qdrouter.ma");
+    size_t budget = core->qd->mobile_addr_max_update > 0 ? (size_t) core->qd->mobile_addr_max_update : SIZE_MAX;
+    size_t limit  = budget;
+    qd_message_t *mau = qcm_mobile_sync_compose_differential_mau(msync, &budget);
+    size_t sync_count = limit - budget;
+
+    core->mobile_sync_stats.updates++;
+    core->mobile_sync_stats.addresses += sync_count;
+    core->mobile_sync_stats.pending    = DEQ_SIZE(msync->sync_addrs);
 
     //
     // Multicast the control message.  Set the exclude_inprocess and control flags.
@@ -494,8 +756,8 @@ static void qcm_mobile_sync_on_timer_CT(qdr_core_t *core, void *context)
     // Debug log the activity of this sequence update.
     //
     qd_log(LOG_ROUTER_MA, QD_LOG_DEBUG,
-           "New mobile sequence: mobile_seq=%" PRIu64 ", addrs_synced=%zu, fanout=%i", msync->mobile_seq, sync_count,
-           fanout);
+           "New mobile sequence: mobile_seq=%" PRIu64 ", addrs_synced=%zu, addrs_pending=%zu, fanout=%i",
+           msync->mobile_seq, sync_count, DEQ_SIZE(msync->sync_addrs), fanout);
 }
 
 
@@ -531,6 +793,21 @@ static void qcm_mobile_sync_on_mar_CT(qdrm_mobile_sync_t *msync, qd_parsed_field
             qd_log(LOG_ROUTER_MA, QD_LOG_DEBUG, "Received MAR from %s, have_seq=%" PRIu64,
                    (const char *) qd_hash_key_by_handle(router->owning_addr->hash_handle) + 1, have_seq);
 
+            //
+            // A requestor that sends a digest understands range-limited absolute MAUs.  It is always
+            // answered, even if it claims to be up to date, since the digests may reveal a difference.
+            //
+            qd_parsed_field_t *digest_field = qd_parse_value_by_key(body, DIGEST);
+            if (!!digest_field && qd_parse_is_list(digest_field)
+                && qd_parse_sub_count(digest_field) == MOBILE_SYNC_RANGES) {
+                uint64_t peer_digest[MOBILE_SYNC_RANGES];
+                for (int r = 0; r < MOBILE_SYNC_RANGES; r++) {
+                    peer_digest[r] = qd_parse_as_ulong(qd_parse_sub_value(digest_field, r));
+                }
+                qcm_mobile_sync_send_absolute_mau_chunks_CT(msync, router, peer_digest);
+                return;
+            }
+
             if (have_seq < msync->mobile_seq) {
                 //
                 // The requestor's view of our mobile_seq is less than our actual mobile_sync.
@@ -582,6 +859,10 @@ static void qcm_mobile_sync_on_mau_CT(qdrm_mobile_sync_t *msync, qd_parsed_field
             qd_parsed_field_t *add_field   = qd_parse_value_by_key(body, ADD);
             qd_parsed_field_t *del_field   = qd_parse_value_by_key(body, DEL);
             qd_parsed_field_t *exist_field = qd_parse_value_by_key(body, EXIST);
+            qd_parsed_field_t *ranges_field = qd_parse_value_by_key(body, RANGES);
+            qd_parsed_field_t *more_field  = qd_parse_value_by_key(body, MORE);
+            uint64_t           ranges      = !!ranges_field ? qd_parse_as_ulong(ranges_field) : MOBILE_SYNC_ALL_RANGES;
+            bool               more        = !!more_field && qd_parse_as_bool(more_field);
             qdr_address_t     *addr;
 
             //
@@ -593,7 +874,8 @@ static void qcm_mobile_sync_on_mau_CT(qdrm_mobile_sync_t *msync, qd_parsed_field
                 || (!!add_field && !qd_parse_is_list(add_field))
                 || (!!del_field && !qd_parse_is_list(del_field))
                 || (!!exist_field && (!!add_field || !!del_field))
-                || (!exist_field && (!add_field || !del_field))) {
+                || (!exist_field && (!add_field || !del_field))
+                || (!exist_field && (!!ranges_field || !!more_field))) {
                 qd_log(LOG_ROUTER_MA, QD_LOG_ERROR, "Received malformed MAU from %s", router_id);
                 return;
             }
@@ -611,23 +893,36 @@ static void qcm_mobile_sync_on_mau_CT(qdrm_mobile_sync_t *msync, qd_parsed_field
             }
 
             //
-            // Record the new mobile sequence for the remote router.
+            // While a digest request is outstanding, the digests it carried describe our state
+            // before this differential.  Drop it; the absolute MAU in reply supersedes it.
             //
-            BIT_CLEAR(router->sync_mask, ADDR_SYNC_ROUTER_MA_REQUESTED);
-            router->mobile_seq = mobile_seq;
+            if (!exist_field && BIT_IS_SET(router->sync_mask, ADDR_SYNC_ROUTER_DIGEST_PENDING)) {
+                qd_log(LOG_ROUTER_MA, QD_LOG_DEBUG, "Dropped differential MAU from %s pending digest reply, mobile_seq=%" PRIu64,
+                       router_id, mobile_seq);
+                return;
+            }
+
+            //
+            // Record the new mobile sequence for the remote router once the whole update has arrived.
+            //
+            if (!more) {
+                BIT_CLEAR(router->sync_mask, ADDR_SYNC_ROUTER_MA_REQUESTED | ADDR_SYNC_ROUTER_DIGEST_PENDING);
+                router->mobile_seq = mobile_seq;
+            }
 
             qd_log(LOG_ROUTER_MA, QD_LOG_DEBUG, "Received MAU (%s) from %s, mobile_seq=%" PRIu64,
-                   !!exist_field ? "absolute" : "differential", router_id, mobile_seq);
+                   !!exist_field ? (!!ranges_field ? "absolute-ranges" : "absolute") : "differential", router_id, mobile_seq);
 
             //
-            // If this is an absolute MAU, the existing set of addresses for this router must
-            // be marked as needing deletion, in case they are not mentioned in the existing
+            // If this is an absolute MAU, the existing set of addresses for this router (in the covered
+            // ranges) must be marked as needing deletion, in case they are not mentioned in the existing
             // address list.
             //
             if (!!exist_field) {
                 addr = DEQ_HEAD(msync->core->addrs);
                 while (!!addr) {
-                    if (qcm_mobile_sync_addr_is_mobile(addr) && !!qd_bitmask_value(addr->rnodes, router->mask_bit))
+                    if (qcm_mobile_sync_addr_is_mobile(addr) && !!qd_bitmask_value(addr->rnodes, router->mask_bit)
+                        && (ranges == MOBILE_SYNC_ALL_RANGES || (ranges & ((uint64_t) 1 << qcm_mobile_sync_addr_range(addr)))))
                         BIT_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_TO_BE_DELETED);
                     addr = DEQ_NEXT(addr);
                 }
@@ -760,7 +1055,8 @@ static void qcm_mobile_sync_on_mau_CT(qdrm_mobile_sync_t *msync, qd_parsed_field
             //
             // Tell the python router about the new mobile sequence
             //
-            qdr_post_set_mobile_seq_CT(msync->core, router->mask_bit, mobile_seq);
+            if (!more)
+                qdr_post_set_mobile_seq_CT(msync->core, router->mask_bit, mobile_seq);
         } else {
             log_unknown_router(msync, id_field, "MAU");
         }
@@ -776,11 +1072,13 @@ static uint64_t qcm_mobile_sync_on_message_CT(void                    *context,
                                               const qd_policy_spec_t  *unused_policy_spec,
                                               qdr_error_t            **error)
 {
-    qdrm_mobile_sync_t *msync      = (qdrm_mobile_sync_t*) context;
-    qd_iterator_t      *ap_iter    = qd_message_field_iterator(msg, QD_FIELD_APPLICATION_PROPERTIES);
-    qd_iterator_t      *body_iter  = qd_message_field_iterator(msg, QD_FIELD_BODY);
-    qd_parsed_field_t  *ap_field   = qd_parse(ap_iter);
-    qd_parsed_field_t  *body_field = qd_parse(body_iter);
+    qdrm_mobile_sync_t   *msync      = (qdrm_mobile_sync_t*) context;
+    qd_iterator_storage_t ap_storage;
+    qd_iterator_storage_t body_storage;
+    qd_iterator_t        *ap_iter    = qd_message_field_iterator_init(&ap_storage, msg, QD_FIELD_APPLICATION_PROPERTIES);
+    qd_iterator_t        *body_iter  = qd_message_field_iterator_init(&body_storage, msg, QD_FIELD_BODY);
+    qd_parsed_field_t    *ap_field   = qd_parse(ap_iter);
+    qd_parsed_field_t    *body_field = qd_parse_lazy(body_iter);
 
     if (!!ap_field && qd_parse_is_map(ap_field)) {
         qd_parsed_field_t *opcode_field = qd_parse_value_by_key(ap_field, OPCODE);
@@ -816,12 +1114,15 @@ static void qcm_mobile_sync_on_became_local_dest_CT(qdrm_mobile_sync_t *msync, q
     if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST | ADDR_SYNC_ADDRESS_IN_UPDATE_LIST))
         return;
 
+    msync->core->mobile_sync_stats.flips++;
+
     if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST)) {
         //
         // If the address was deleted since the last update, simply forget that it was deleted.
         //
         DEQ_REMOVE_N(SYNC, msync->sync_addrs, addr);
         BIT_CLEAR(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST);
+        msync->core->mobile_sync_stats.coalesced += 2;
     } else {
         DEQ_INSERT_TAIL_N(SYNC, msync->sync_addrs, addr);
         BIT_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST);
@@ -841,6 +1142,8 @@ static void qcm_mobile_sync_on_no_longer_local_dest_CT(qdrm_mobile_sync_t *msync
     if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_DEL_LIST))
         return;
 
+    msync->core->mobile_sync_stats.flips++;
+
     if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST)) {
         //
         // If the address was added since the last update, simply forget that it was added.
@@ -848,6 +1151,7 @@ static void qcm_mobile_sync_on_no_longer_local_dest_CT(qdrm_mobile_sync_t *msync
         DEQ_REMOVE_N(SYNC, msync->sync_addrs, addr);
         BIT_CLEAR(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_ADD_LIST);
         qcm_mobile_sync_stop_tracking(msync->core, addr);
+        msync->core->mobile_sync_stats.coalesced += 2;
     } else if (BIT_IS_SET(addr->sync_mask, ADDR_SYNC_ADDRESS_IN_UPDATE_LIST)) {
         //
         // Move the address from the update list to the delete list
@@ -889,6 +1193,7 @@ static void qcm_mobile_sync_on_address_local_change_CT(qdrm_mobile_sync_t *msync
 static void qcm_mobile_sync_on_router_flush_CT(qdrm_mobile_sync_t *msync, qdr_node_t *router)
 {
     router->mobile_seq = 0;
+    BIT_CLEAR(router->sync_mask, ADDR_SYNC_ROUTER_DIGEST_PENDING);
     qdr_address_t *addr = DEQ_HEAD(msync->core->addrs);
     while (!!addr) {
         qdr_address_t *next_addr = DEQ_NEXT(addr);
@@ -922,6 +1227,7 @@ static void qcm_mobile_sync_on_router_advanced_CT(qdrm_mobile_sync_t *msync, qdr
     //
     int fanout = qdr_forward_message_CT(msync->core, router->owning_addr, mar, 0, true, true);
     qd_message_free(mar);
+    BIT_SET(router->sync_mask, ADDR_SYNC_ROUTER_DIGEST_PENDING);
 
     //
     // Debug log the activity of this sequence update.
@@ -1024,7 +1330,7 @@ static void qcm_mobile_sync_init_CT(qdr_core_t *core, void **module_context)
                                                msync);
 
     //
-    // Create and schedule a one-second recurring timer to drive the sync protocol
+    // Create and schedule a recurring timer (one hold-down interval) to drive the sync protocol
     //
     msync->timer = qdr_core_timer_CT(core, qcm_mobile_sync_on_timer_CT, msync);
     qdr_core_timer_schedule_CT(core, msync->timer, 0);
@@ -1051,6 +1357,7 @@ static void qcm_mobile_sync_final_CT(void *module_context)
     qdr_core_unsubscribe(msync->message_sub1);
     qdr_core_unsubscribe(msync->message_sub2);
 
+    qd_compose_template_free(msync->mau_headers);
     free(msync);
 }
 
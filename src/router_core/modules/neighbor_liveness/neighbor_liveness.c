@@ -0,0 +1,241 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "module.h"
+#include "router_core_private.h"
+
+#include "qpid/dispatch/compose.h"
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+#include "qpid/dispatch/message.h"
+#include "qpid/dispatch/metrics.h"
+#include "qpid/dispatch/timer.h"
+
+#include <inttypes.h>
+
+//
+// Neighbor liveness: sub-second detection of a lost neighbor router.
+//
+// The HELLO protocol of the Python router engine declares a neighbor lost after helloMaxAgeSeconds, on a timer that
+// runs under the GIL.  When neighborLivenessMilliseconds is set this module sends a keepalive on the outgoing control
+// link of every active inter-router connection four times per interval and declares the neighbor lost once nothing
+// has been heard from it for the interval: the routing agent is told that the link is lost (as it is when the control
+// link detaches) and the connection is closed so its connector starts over.
+//
+// A neighbor is only watched once a keepalive has been received from it on its current connection, neighbors that do
+// not run the module are left to the HELLO protocol.  The keepalives are driven by a proactor timer because the core
+// timers tick in seconds, the timer posts a control action so a backlog of general actions does not delay the check.
+// The keepalives arrive as control actions too.  Should the core itself fall behind by more than half an interval,
+// the silence it saw says nothing about the neighbors and the clocks are restarted instead.
+//
+
+#define NL_KEEPALIVES_PER_INTERVAL 4
+#define NL_MIN_PERIOD_MS           10
+#define NL_MAX_QUEUED              2   // keepalives waiting for credit on a control link before no more are added
+
+typedef struct {
+    uint64_t conn_id;        // connection the neighbor was last heard on, 0: not watched
+    uint64_t last_heard_ns;
+} qcm_neighbor_t;
+
+typedef struct {
+    qdr_core_t         *core;
+    uint32_t            interval_ms;
+    uint32_t            period_ms;
+    qd_timer_t         *timer;
+    sys_atomic_t        tick_pending;
+    uint64_t            last_tick_ns;
+    qd_message_t       *keepalive;
+    qdr_subscription_t *sub;
+    qcm_neighbor_t     *neighbors;   // by link maskbit
+    qd_metric_t        *lost_counter;
+} qcm_neighbor_liveness_t;
+
+
+static uint64_t qcm_neighbor_liveness_on_message_CT(void                    *context,
+                                                    qd_message_t            *msg,
+                                                    int                      link_maskbit,
+                                                    int                      unused_inter_router_cost,
+                                                    uint64_t                 conn_id,
+                                                    const qd_policy_spec_t  *unused_policy_spec,
+                                                    qdr_error_t            **error)
+{
+    qcm_neighbor_liveness_t *nl = (qcm_neighbor_liveness_t*) context;
+
+    if (qd_bitmask_valid_bit_value(link_maskbit) && conn_id) {
+        nl->neighbors[link_maskbit].conn_id       = conn_id;
+        nl->neighbors[link_maskbit].last_heard_ns = qdr_core_now_ns();
+    }
+    return PN_ACCEPTED;
+}
+
+
+static void qcm_neighbor_liveness_lost_CT(qcm_neighbor_liveness_t *nl, qdr_connection_t *conn, uint64_t silent_ms)
+{
+    qdr_core_t *core = nl->core;
+
+    qd_log(LOG_ROUTER_CORE, QD_LOG_WARNING,
+           "[C%" PRIu64 "] Neighbor router silent for %" PRIu64 " ms, declaring the link lost (neighborLivenessMilliseconds=%" PRIu32 ")",
+           conn->identity, silent_ms, nl->interval_ms);
+    qd_metric_inc(nl->lost_counter, 1);
+
+    // The detach of the control link when the connection closes does not post it again
+    qdr_post_link_lost_CT(core, conn->mask_bit);
+    conn->link_lost_posted = true;
+
+    sys_mutex_lock(&conn->work_lock);
+    if (!conn->error)
+        conn->error = qdr_error(QD_AMQP_COND_CONNECTION_FORCED, "Neighbor router liveness timeout");
+    sys_mutex_unlock(&conn->work_lock);
+    qdr_close_connection_CT(core, conn);
+}
+
+
+static void qcm_neighbor_liveness_tick_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+
+    qcm_neighbor_liveness_t *nl = (qcm_neighbor_liveness_t*) action->args.general.context_1;
+    sys_atomic_set(&nl->tick_pending, 0);
+
+    const uint64_t now      = qdr_core_now_ns();
+    const uint64_t limit_ns = (uint64_t) nl->interval_ms * 1000000;
+    const bool     stalled  = nl->last_tick_ns && now - nl->last_tick_ns > limit_ns / 2;
+    nl->last_tick_ns = now;
+
+    if (stalled)
+        qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Neighbor liveness check skipped, the core fell behind");
+
+    for (int bit = 0; bit < qd_bitmask_width(); bit++) {
+        qdr_connection_t *conn     = core->rnode_conns_by_mask_bit[bit];
+        qcm_neighbor_t   *neighbor = &nl->neighbors[bit];
+
+        if (!conn || conn->closed) {
+            neighbor->conn_id = 0;
+            continue;
+        }
+
+        if (neighbor->conn_id == conn->identity) {
+            if (stalled) {
+                neighbor->last_heard_ns = now;
+            } else if (now - neighbor->last_heard_ns > limit_ns) {
+                neighbor->conn_id = 0;
+                qcm_neighbor_liveness_lost_CT(nl, conn, (now - neighbor->last_heard_ns) / 1000000);
+                continue;
+            }
+        }
+
+        qdr_link_t *link = conn->control_links[QD_OUTGOING];
+        if (link && qdr_delivery_ring_size(&link->undelivered) < NL_MAX_QUEUED) {
+            qdr_delivery_t *dlv = qdr_forward_new_delivery_CT(core, 0, link, nl->keepalive);
+            qdr_forward_deliver_CT(core, link, dlv);
+        }
+    }
+}
+
+
+/**
+ * Runs on an I/O thread.
+ */
+static void qcm_neighbor_liveness_on_timer(void *context)
+{
+    qcm_neighbor_liveness_t *nl = (qcm_neighbor_liveness_t*) context;
+
+    if (!sys_atomic_set(&nl->tick_pending, 1)) {
+        qdr_action_t *action = qdr_action(qcm_neighbor_liveness_tick_CT, "neighbor_liveness_tick");
+        action->args.general.context_1 = nl;
+        qdr_action_control_enqueue(nl->core, action);
+    }
+    qd_timer_schedule(nl->timer, nl->period_ms);
+}
+
+
+static qd_message_t *qcm_neighbor_liveness_keepalive(void)
+{
+    qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_HEADER, 0);
+    qd_compose_start_list(field);
+    qd_compose_insert_bool(field, 0); // durable
+    qd_compose_end_list(field);
+
+    field = qd_compose(QD_PERFORMATIVE_PROPERTIES, field);
+    qd_compose_start_list(field);
+    qd_compose_insert_null(field);                           // message-id
+    qd_compose_insert_null(field);                           // user-id
+    qd_compose_insert_string(field, "_local/qdrouter.lv");   // to
+    qd_compose_end_list(field);
+
+    qd_message_t *msg = qd_message();
+    qd_message_compose_2(msg, field, true);
+    qd_compose_free(field);
+    return msg;
+}
+
+
+static bool qcm_neighbor_liveness_enable_CT(qdr_core_t *core)
+{
+    return core->router_mode == QD_ROUTER_MODE_INTERIOR && core->qd->neighbor_liveness_ms > 0;
+}
+
+
+static void qcm_neighbor_liveness_init_CT(qdr_core_t *core, void **module_context)
+{
+    qcm_neighbor_liveness_t *nl = NEW(qcm_neighbor_liveness_t);
+    ZERO(nl);
+    nl->core         = core;
+    nl->interval_ms  = core->qd->neighbor_liveness_ms;
+    nl->period_ms    = MAX(nl->interval_ms / NL_KEEPALIVES_PER_INTERVAL, NL_MIN_PERIOD_MS);
+    nl->keepalive    = qcm_neighbor_liveness_keepalive();
+    nl->neighbors    = NEW_ARRAY(qcm_neighbor_t, qd_bitmask_width());
+    nl->lost_counter = qd_metric(QD_METRIC_COUNTER, "qdr_neighbor_liveness_lost_total", 0, 0);
+    memset(nl->neighbors, 0, sizeof(qcm_neighbor_t) * qd_bitmask_width());
+    sys_atomic_init(&nl->tick_pending, 0);
+
+    //
+    // The address is created router-control-only with the route tables, only keepalives received on control links
+    // reach the subscription
+    //
+    nl->sub = qdr_core_subscribe(core, "qdrouter.lv", 'L', QD_TREATMENT_MULTICAST_ONCE, true, false,
+                                 qcm_neighbor_liveness_on_message_CT, nl);
+
+    qd_log(LOG_ROUTER_CORE, QD_LOG_INFO, "Neighbor liveness: lost after %" PRIu32 " ms, keepalive every %" PRIu32 " ms",
+           nl->interval_ms, nl->period_ms);
+
+    nl->timer = qd_timer(core->qd, qcm_neighbor_liveness_on_timer, nl);
+    qd_timer_schedule(nl->timer, nl->period_ms);
+
+    *module_context = nl;
+}
+
+
+static void qcm_neighbor_liveness_final_CT(void *module_context)
+{
+    qcm_neighbor_liveness_t *nl = (qcm_neighbor_liveness_t*) module_context;
+
+    qd_timer_free(nl->timer);
+    qdr_core_unsubscribe(nl->sub);
+    qd_message_free(nl->keepalive);
+    qd_metric_free(nl->lost_counter);
+    sys_atomic_destroy(&nl->tick_pending);
+    free(nl->neighbors);
+    free(nl);
+}
+
+
+QDR_CORE_MODULE_DECLARE("neighbor_liveness", qcm_neighbor_liveness_enable_CT, qcm_neighbor_liveness_init_CT, qcm_neighbor_liveness_final_CT)
@@ -27,126 +27,70 @@
 /*
  * Release unused streaming links
  *
- * Periodically scan through the list of open connections checking for idle
- * streaming links.  If the connections idle streaming link pool is oversized
- * then release some of the unused links in the background.
+ * Links returned to a connection's idle streaming link pool are also put on
+ * the tail of core->idle_streaming_links, so that list is ordered by the time
+ * the links became idle.  The scrubber's core timer is scheduled for the
+ * moment the head link has been idle for the idle timeout: only the expired
+ * links are visited.  An expired link is closed if its connection's pool is
+ * oversized.  Otherwise it is kept for the pool and leaves the list, so the
+ * links a pool needs are visited once rather than every idle timeout.  A pool
+ * never holds more of those untracked links than its limit, the links that
+ * make it oversized are always in the list.
  */
 
-#define PROD_TIMER_INTERVAL    30
-#define TEST_TIMER_INTERVAL    5
+#define PROD_IDLE_TIMEOUT      30
+#define TEST_IDLE_TIMEOUT      5
 #define TEST_MAX_FREE_POOL     2
 #define MAX_FREE_BATCH         10  // rate limit the link detach
 
-static int timer_interval     = PROD_TIMER_INTERVAL;
+static int idle_timeout       = PROD_IDLE_TIMEOUT;
 static int max_free_pool_size = 128;
 
-static void qdr_streaming_link_scrubber_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
-
 typedef struct tracker_t tracker_t;
 struct tracker_t {
-    qdr_core_t              *core;
-    qdr_core_timer_t        *timer;
-    qdr_connection_ref_t_sp  next_conn_ref;
+    qdr_core_t       *core;
+    qdr_core_timer_t *timer;
 };
 
 
-/* Idle streaming link cleanup
- *
- * Check the size of the connections idle link free pool.  If the connection
- * has accumulated too many unused links start closing them
- */
-static void idle_link_cleanup(qdr_core_t *core, qdr_connection_t *conn)
+static void timer_handler_CT(qdr_core_t *core, void *context)
 {
-    qdr_link_list_t to_free = DEQ_EMPTY;
-
-    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "[C%" PRIu64 "] Streaming link scrubber: scanning connection",
-           conn->identity);
-
-    const size_t pool_size = DEQ_SIZE(conn->streaming_link_pool);
-    if (pool_size > max_free_pool_size) {
-        size_t count = MIN(MAX_FREE_BATCH, pool_size - max_free_pool_size);
-
-        // links are returned to the pool by inserting at the tail.  Thus the
-        // links at head have been on the list the longest and are more likely
-        // be candidates for cleanup (e.g. idle)
-        while (count) {
-            qdr_link_t *link = DEQ_HEAD(conn->streaming_link_pool);
-            if (!qdr_link_is_idle_CT(link))
-                break;
-            DEQ_REMOVE_HEAD_N(STREAMING_POOL, conn->streaming_link_pool);
-            DEQ_INSERT_TAIL_N(STREAMING_POOL, to_free, link);
-            link->in_streaming_pool = false;
-            count -= 1;
-        }
-
-    }
-
-    if (DEQ_HEAD(to_free)) {
-        qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "[C%" PRIu64 "] Streaming link scrubber: found %d idle links",
-               conn->identity, (int) DEQ_SIZE(to_free));
-
-        while (DEQ_HEAD(to_free)) {
-            qdr_link_t *link = DEQ_HEAD(to_free);
-            DEQ_REMOVE_HEAD_N(STREAMING_POOL, to_free);
+    tracker_t      *tracker  = (tracker_t*) context;
+    const uint32_t  now      = qdr_core_uptime_ticks(core);
+    const size_t    pool_max = MAX(max_free_pool_size, core->streaming_link_pool_min);
+    int             freed    = 0;
+
+    qdr_link_t *link = DEQ_HEAD(core->idle_streaming_links);
+    while (link && now - link->streaming_idle_ticks >= idle_timeout && freed < MAX_FREE_BATCH) {
+        qdr_connection_t *conn = link->conn;
+        if (DEQ_SIZE(conn->streaming_link_pool) > pool_max && qdr_link_is_idle_CT(link)) {
+            qdr_link_streaming_pool_remove_CT(core, link);
             qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
-                   "[C%" PRIu64 "][L%" PRIu64 "] Streaming link scrubber: closing idle link %s", link->conn->identity,
+                   "[C%" PRIu64 "][L%" PRIu64 "] Streaming link scrubber: closing idle link %s", conn->identity,
                    link->identity, (link->name) ? link->name : "");
             qdr_link_outbound_detach_CT(core, link, 0, QDR_CONDITION_NONE);
+            freed++;
+        } else if (DEQ_SIZE(conn->streaming_link_pool) <= pool_max) {
+            // The pool needs it: stop tracking it until it is taken from the pool and returned
+            DEQ_REMOVE_HEAD_N(STREAMING_IDLE, core->idle_streaming_links);
+            link->in_idle_streaming = false;
+        } else {
+            // Oversized pool but the link is still busy: it is idle again from now on
+            DEQ_REMOVE_HEAD_N(STREAMING_IDLE, core->idle_streaming_links);
+            link->streaming_idle_ticks = now;
+            DEQ_INSERT_TAIL_N(STREAMING_IDLE, core->idle_streaming_links, link);
         }
+        link = DEQ_HEAD(core->idle_streaming_links);
     }
-}
 
-
-static void timer_handler_CT(qdr_core_t *core, void *context)
-{
-    tracker_t            *tracker    = (tracker_t*) context;
-    qdr_connection_ref_t *first_ref = DEQ_HEAD(core->streaming_connections);
-
-    if (!!first_ref) {
-        qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Starting streaming link scrubber scan");
-        set_safe_ptr_qdr_connection_ref_t(first_ref, &tracker->next_conn_ref);
-        qdr_action_t *action = qdr_action(qdr_streaming_link_scrubber_CT, "streaming_link_scrubber");
-        action->args.general.context_1 = tracker;
-        qdr_action_background_enqueue(core, action);
-    } else
-        qdr_core_timer_schedule_CT(core, tracker->timer, timer_interval);
-}
-
-
-static void qdr_streaming_link_scrubber_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
-{
-    if (discard)
-        return;
-
-    tracker_t            *tracker  = (tracker_t*) action->args.general.context_1;
-    qdr_connection_ref_t *conn_ref = safe_deref_qdr_connection_ref_t(tracker->next_conn_ref);
-
-    if (!!conn_ref) {
-        idle_link_cleanup(core, conn_ref->conn);
-
-        conn_ref = DEQ_NEXT(conn_ref);
-        if (!!conn_ref) {
-            //
-            // There is another connection on the list.  Schedule another
-            // background action to process the next connection.
-            //
-            set_safe_ptr_qdr_connection_ref_t(conn_ref, &tracker->next_conn_ref);
-            action = qdr_action(qdr_streaming_link_scrubber_CT, "streaming_link_scrubber");
-            action->args.general.context_1 = tracker;
-            qdr_action_background_enqueue(core, action);
-        } else
-            //
-            // We've come to the end of the list of open connections.  Set the
-            // timer to start a new sweep after the interval.
-            //
-            qdr_core_timer_schedule_CT(core, tracker->timer, timer_interval);
-    } else
-        //
-        // The connection we were provided is no longer valid.  It was probably
-        // closed since the last time we came through this path.  Abort the
-        // sweep and set the timer for a new one after the interval.
-        //
-        qdr_core_timer_schedule_CT(core, tracker->timer, timer_interval);
+    //
+    // Fire again when the new head expires, or in a second if the batch limit left expired links.  With the list
+    // empty the timer is scheduled by the next qdr_link_streaming_pool_insert_CT().
+    //
+    if (link) {
+        uint32_t idle = now - link->streaming_idle_ticks;
+        qdr_core_timer_schedule_CT(core, tracker->timer, idle < idle_timeout ? idle_timeout - idle : 1);
+    }
 }
 
 
@@ -156,7 +100,7 @@ static bool qcm_streaming_link_scrubber_enable_CT(qdr_core_t *core)
         //
         // Test mode is enabled, override the timing constants with the test values
         //
-        timer_interval = TEST_TIMER_INTERVAL;
+        idle_timeout       = TEST_IDLE_TIMEOUT;
         max_free_pool_size = TEST_MAX_FREE_POOL;
     }
 
@@ -170,12 +114,15 @@ static void qcm_streaming_link_scrubber_init_CT(qdr_core_t *core, void **module_
     ZERO(tracker);
     tracker->core  = core;
     tracker->timer = qdr_core_timer_CT(core, timer_handler_CT, tracker);
-    qdr_core_timer_schedule_CT(core, tracker->timer, timer_interval);
+    core->streaming_link_idle_timer   = tracker->timer;
+    core->streaming_link_idle_timeout = idle_timeout;
+    if (DEQ_HEAD(core->idle_streaming_links))
+        qdr_core_timer_schedule_CT(core, tracker->timer, idle_timeout);
     *module_context = tracker;
 
     // This is a one time init log message. This will be logged at the QD_LOG_INFO level.
     qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
-           "Streaming link scrubber: Scan interval: %d seconds, max free pool: %d links", timer_interval,
+           "Streaming link scrubber: Idle timeout: %d seconds, max free pool: %d links", idle_timeout,
            max_free_pool_size);
 }
 
@@ -183,6 +130,7 @@ static void qcm_streaming_link_scrubber_init_CT(qdr_core_t *core, void **module_
 static void qcm_streaming_link_scrubber_final_CT(void *module_context)
 {
     tracker_t *tracker = (tracker_t*) module_context;
+    tracker->core->streaming_link_idle_timer = 0;
     qdr_core_timer_free_CT(tracker->core, tracker->timer);
     free(tracker);
 }
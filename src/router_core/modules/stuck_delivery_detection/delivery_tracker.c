@@ -30,6 +30,9 @@
 #define TEST_TIMER_INTERVAL 5
 #define TEST_STUCK_AGE      3
 
+// links checked for zero credit per background action
+#define BLOCKED_SWEEP_BATCH 256
+
 static int timer_interval = PROD_TIMER_INTERVAL;
 static int stuck_age      = PROD_STUCK_AGE;
 
@@ -52,7 +55,7 @@ static void check_delivery_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery_t
         return;
     }
 
-    if (!dlv->stuck && ((qdr_core_uptime_ticks(core) - link->core_ticks) > stuck_age)) {
+    if (!dlv->stuck) {
         dlv->stuck = true;
         link->deliveries_stuck++;
         core->deliveries_stuck++;
@@ -69,20 +72,56 @@ static void check_delivery_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery_t
 }
 
 
-static void process_link_CT(qdr_core_t *core, qdr_link_t *link)
+/**
+ * Mark the deliveries of a link that has not settled anything for stuck_age seconds.  Return false if the link holds no
+ * deliveries any more.
+ */
+static bool process_link_deliveries_CT(qdr_core_t *core, qdr_link_t *link)
 {
-    qdr_delivery_t *dlv = DEQ_HEAD(link->undelivered);
-    while (dlv) {
-        check_delivery_CT(core, link, dlv);
-        dlv = DEQ_NEXT(dlv);
+    // The I/O thread moves deliveries from undelivered to unsettled under the work lock
+    sys_mutex_lock(&link->conn->work_lock);
+    size_t held = qdr_delivery_ring_size(&link->undelivered) + DEQ_SIZE(link->unsettled);
+
+    // Nothing to do if every delivery the link holds has been marked already
+    if (held > link->deliveries_stuck) {
+        const qdr_delivery_ring_t *ring = &link->undelivered;
+        qdr_delivery_t            *dlv;
+        for (uint32_t pos = ring->head; ring->count && qdr_delivery_ring_before(ring, pos); pos++) {
+            if ((dlv = qdr_delivery_ring_at(ring, pos)))
+                check_delivery_CT(core, link, dlv);
+        }
+
+        dlv = DEQ_HEAD(link->unsettled);
+        while (dlv) {
+            check_delivery_CT(core, link, dlv);
+            dlv = DEQ_NEXT(dlv);
+        }
     }
+    sys_mutex_unlock(&link->conn->work_lock);
+    return held > 0;
+}
+
 
-    dlv = DEQ_HEAD(link->unsettled);
-    while (dlv) {
-        check_delivery_CT(core, link, dlv);
-        dlv = DEQ_NEXT(dlv);
+/**
+ * Walk the links by delivery age up to the first one that made progress in the last stuck_age seconds.  The cost is
+ * that of the links with old deliveries, the links that settle and their deliveries are not visited.
+ */
+static void detect_stuck_deliveries_CT(qdr_core_t *core)
+{
+    uint32_t    now  = qdr_core_uptime_ticks(core);
+    qdr_link_t *link = DEQ_HEAD(core->links_by_delivery_age);
+
+    while (link && now - link->delivery_age_ticks > stuck_age) {
+        qdr_link_t *next = DEQ_NEXT_N(DELIVERY_AGE, link);
+        if (!link->conn || !process_link_deliveries_CT(core, link))
+            qdr_link_delivery_age_remove_CT(core, link);
+        link = next;
     }
+}
+
 
+static void process_link_CT(qdr_core_t *core, qdr_link_t *link)
+{
     if (!link->reported_as_blocked && link->zero_credit_time > 0 &&
         (qdr_core_uptime_ticks(core) - link->zero_credit_time > stuck_age)) {
         link->reported_as_blocked = true;
@@ -107,6 +146,12 @@ static void timer_handler_CT(qdr_core_t *core, void *context)
 
     qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Stuck Delivery Detection: Starting detection cycle");
 
+    detect_stuck_deliveries_CT(core);
+
+    //
+    // Links blocked with zero credit need not hold deliveries.  Checking for them is cheap but needs a sweep over all
+    // links, which is done in batches in the background.
+    //
     if (!!first_link) {
         set_safe_ptr_qdr_link_t(first_link, &tracker->next_link);
         qdr_action_t *action = qdr_action(action_handler_CT, "detect_stuck_deliveries");
@@ -126,12 +171,15 @@ static void action_handler_CT(qdr_core_t *core, qdr_action_t *action, bool disca
     qdr_link_t *link    = safe_deref_qdr_link_t(tracker->next_link);
 
     if (!!link) {
-        process_link_CT(core, link);
-        qdr_link_t *next = DEQ_NEXT(link);
+        qdr_link_t *next = link;
+        for (int i = 0; next && i < BLOCKED_SWEEP_BATCH; i++) {
+            process_link_CT(core, next);
+            next = DEQ_NEXT(next);
+        }
         if (!!next) {
             //
-            // There is another link on the list.  Schedule another background action to process
-            // the next link.
+            // There are more links on the list.  Schedule another background action to process
+            // the next batch.
             //
             set_safe_ptr_qdr_link_t(next, &tracker->next_link);
             action = qdr_action(action_handler_CT, "detect_stuck_deliveries");
@@ -0,0 +1,156 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "router_core_private.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/metrics.h"
+#include "qpid/dispatch/timer.h"
+
+#include <inttypes.h>
+
+//
+// Overload detection, see qdr_overload_t.
+//
+
+// how often the core and I/O threads are sampled
+#define QDR_OVERLOAD_SAMPLE_MS 100
+
+static const char *const refused_names[QDR_OVERLOAD_REFUSED_COUNT] = {"connection", "link"};
+
+
+/**
+ * Runs on the core thread in the order it was enqueued, its delay is the time every action enqueued before it waited.
+ */
+static void qdr_overload_probe_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+    uint64_t delay_ms = (qdr_core_now_ns() - action->enqueued_ns) / 1000000;
+    sys_atomic_set(&core->overload.queue_delay_ms, (uint32_t) MIN(delay_ms, UINT32_MAX));
+    sys_atomic_set(&core->overload.probe_pending, 0);
+}
+
+
+static bool over_limit(uint64_t value, uint32_t limit, bool overloaded)
+{
+    if (!limit)
+        return false;
+    return overloaded ? value >= limit / 2 : value >= limit;
+}
+
+
+static void qdr_overload_on_timer(void *context)
+{
+    qdr_core_t     *core     = (qdr_core_t*) context;
+    qdr_overload_t *overload = &core->overload;
+    uint64_t        now      = qdr_core_now_ns();
+
+    uint64_t event_loop_lag_ms = now > overload->due_ns ? (now - overload->due_ns) / 1000000 : 0;
+
+    // A probe still waiting to run has been delayed at least since it was enqueued
+    uint64_t queue_delay_ms = sys_atomic_get(&overload->queue_delay_ms);
+    if (sys_atomic_get(&overload->probe_pending)) {
+        queue_delay_ms = MAX(queue_delay_ms, (now - overload->probe_sent_ns) / 1000000);
+    } else {
+        overload->probe_sent_ns = now;
+        sys_atomic_set(&overload->probe_pending, 1);
+        qdr_action_enqueue(core, qdr_action(qdr_overload_probe_CT, "overload_probe"));
+    }
+
+    uint32_t queue_depth = sys_atomic_get(&core->batch_depth);
+
+    qd_metric_set(overload->queue_delay_gauge, queue_delay_ms);
+    qd_metric_set(overload->queue_depth_gauge, queue_depth);
+    qd_metric_set(overload->event_loop_lag_gauge, event_loop_lag_ms);
+
+    bool was_overloaded = !!sys_atomic_get(&overload->overloaded);
+    bool overloaded     = over_limit(queue_delay_ms, overload->queue_delay_limit_ms, was_overloaded)
+                       || over_limit(event_loop_lag_ms, overload->event_loop_lag_limit_ms, was_overloaded);
+    if (overloaded != was_overloaded) {
+        sys_atomic_set(&overload->overloaded, overloaded);
+        qd_metric_set(overload->overloaded_gauge, overloaded);
+        qd_log(LOG_ROUTER_CORE, overloaded ? QD_LOG_WARNING : QD_LOG_INFO,
+               "Router %s: core action queue delay %" PRIu64 " ms (depth %" PRIu32 "), I/O event loop lag %" PRIu64
+               " ms", overloaded ? "overloaded, refusing new client connections and links" : "no longer overloaded",
+               queue_delay_ms, queue_depth, event_loop_lag_ms);
+    }
+
+    overload->due_ns = now + (uint64_t) QDR_OVERLOAD_SAMPLE_MS * 1000000;
+    qd_timer_schedule(overload->timer, QDR_OVERLOAD_SAMPLE_MS);
+}
+
+
+void qdr_overload_setup(qdr_core_t *core)
+{
+    qdr_overload_t *overload = &core->overload;
+
+    sys_atomic_init(&overload->probe_pending, 0);
+    sys_atomic_init(&overload->queue_delay_ms, 0);
+    sys_atomic_init(&overload->overloaded, 0);
+    overload->queue_delay_limit_ms    = core->qd->overload_queue_delay_ms;
+    overload->event_loop_lag_limit_ms = core->qd->overload_event_loop_lag_ms;
+    if (!overload->queue_delay_limit_ms && !overload->event_loop_lag_limit_ms)
+        return;
+
+    overload->overloaded_gauge     = qd_metric(QD_METRIC_GAUGE, "qdr_overloaded", 0, 0);
+    overload->queue_delay_gauge    = qd_metric(QD_METRIC_GAUGE, "qdr_core_action_queue_delay_milliseconds", 0, 0);
+    overload->queue_depth_gauge    = qd_metric(QD_METRIC_GAUGE, "qdr_core_action_queue_depth", 0, 0);
+    overload->event_loop_lag_gauge = qd_metric(QD_METRIC_GAUGE, "qdr_io_event_loop_lag_milliseconds", 0, 0);
+    for (int i = 0; i < QDR_OVERLOAD_REFUSED_COUNT; i++)
+        overload->refused[i] = qd_metric(QD_METRIC_COUNTER, "qdr_overload_refused_total", "type", refused_names[i]);
+
+    qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
+           "Overload control enabled: core action queue delay limit %" PRIu32 " ms, I/O event loop lag limit %" PRIu32
+           " ms (0: not monitored)", overload->queue_delay_limit_ms, overload->event_loop_lag_limit_ms);
+
+    overload->timer  = qd_timer(core->qd, qdr_overload_on_timer, core);
+    overload->due_ns = qdr_core_now_ns() + (uint64_t) QDR_OVERLOAD_SAMPLE_MS * 1000000;
+    qd_timer_schedule(overload->timer, QDR_OVERLOAD_SAMPLE_MS);
+}
+
+
+/**
+ * Called before the core threads are stopped, a probe still enqueued is discarded with the other actions.
+ */
+void qdr_overload_final(qdr_core_t *core)
+{
+    qdr_overload_t *overload = &core->overload;
+
+    qd_timer_free(overload->timer);
+    overload->timer = 0;
+    qd_metric_free(overload->overloaded_gauge);
+    qd_metric_free(overload->queue_delay_gauge);
+    qd_metric_free(overload->queue_depth_gauge);
+    qd_metric_free(overload->event_loop_lag_gauge);
+    for (int i = 0; i < QDR_OVERLOAD_REFUSED_COUNT; i++)
+        qd_metric_free(overload->refused[i]);
+}
+
+
+bool qdr_core_overloaded(qdr_core_t *core)
+{
+    return !!sys_atomic_get(&core->overload.overloaded);
+}
+
+
+void qdr_core_overload_refused(qdr_core_t *core, qdr_overload_refused_t refused)
+{
+    qd_metric_inc(core->overload.refused[refused], 1);
+}
@@ -32,17 +32,22 @@ static void qdr_mobile_seq_advanced_CT (qdr_core_t *core, qdr_action_t *action,
 static void qdr_subscribe_CT           (qdr_core_t *core, qdr_action_t *action, bool discard);
 static void qdr_unsubscribe_CT         (qdr_core_t *core, qdr_action_t *action, bool discard);
 
+// Number of address-to-config lookups memoized by core->addr_parse_tree
+#define QDR_ADDR_CONFIG_CACHE_SIZE 16384
+
 
 //==================================================================================
 // Interface Functions
 //==================================================================================
 
+// Route table updates from the router engine are control actions, topology changes are not held up by data traffic
+
 void qdr_core_add_router(qdr_core_t *core, const char *address, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_add_router_CT, "add_router");
     action->args.route_table.router_maskbit = router_maskbit;
     action->args.route_table.address        = qdr_field(address);
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -50,7 +55,7 @@ void qdr_core_del_router(qdr_core_t *core, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_del_router_CT, "del_router");
     action->args.route_table.router_maskbit = router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -59,7 +64,7 @@ void qdr_core_set_link(qdr_core_t *core, int router_maskbit, int link_maskbit)
     qdr_action_t *action = qdr_action(qdr_set_link_CT, "set_link");
     action->args.route_table.router_maskbit = router_maskbit;
     action->args.route_table.link_maskbit   = link_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -67,7 +72,7 @@ void qdr_core_remove_link(qdr_core_t *core, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_remove_link_CT, "remove_link");
     action->args.route_table.router_maskbit = router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -76,7 +81,7 @@ void qdr_core_set_next_hop(qdr_core_t *core, int router_maskbit, int nh_router_m
     qdr_action_t *action = qdr_action(qdr_set_next_hop_CT, "set_next_hop");
     action->args.route_table.router_maskbit    = router_maskbit;
     action->args.route_table.nh_router_maskbit = nh_router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -84,7 +89,7 @@ void qdr_core_remove_next_hop(qdr_core_t *core, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_remove_next_hop_CT, "remove_next_hop");
     action->args.route_table.router_maskbit = router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -93,7 +98,7 @@ void qdr_core_set_cost(qdr_core_t *core, int router_maskbit, int cost)
     qdr_action_t *action = qdr_action(qdr_set_cost_CT, "set_cost");
     action->args.route_table.router_maskbit = router_maskbit;
     action->args.route_table.cost           = cost;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -102,7 +107,7 @@ void qdr_core_set_valid_origins(qdr_core_t *core, int router_maskbit, qd_bitmask
     qdr_action_t *action = qdr_action(qdr_set_valid_origins_CT, "set_valid_origins");
     action->args.route_table.router_maskbit = router_maskbit;
     action->args.route_table.router_set     = routers;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -110,7 +115,7 @@ void qdr_core_flush_destinations(qdr_core_t *core, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_flush_destinations_CT, "flush_destinations");
     action->args.route_table.router_maskbit = router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -118,7 +123,7 @@ void qdr_core_mobile_seq_advanced(qdr_core_t *core, int router_maskbit)
 {
     qdr_action_t *action = qdr_action(qdr_mobile_seq_advanced_CT, "mobile_seq_advanced");
     action->args.route_table.router_maskbit = router_maskbit;
-    qdr_action_enqueue(core, action);
+    qdr_action_control_enqueue(core, action);
 }
 
 
@@ -186,6 +191,12 @@ void qdr_route_table_update_cost_CT(qdr_core_t *core, qdr_node_t *rnode)
     qdr_node_t *ptr;
     bool needs_reinsertion = false;
 
+    //
+    // The cost is cached in the addresses' forwarding candidates, so any change
+    // invalidates them, whether or not the router moves in the list.
+    //
+    core->cost_epoch++;
+
     ptr = DEQ_PREV(rnode);
     if (ptr && ptr->cost > rnode->cost)
         needs_reinsertion = true;
@@ -196,7 +207,6 @@ void qdr_route_table_update_cost_CT(qdr_core_t *core, qdr_node_t *rnode)
     }
 
     if (needs_reinsertion) {
-        core->cost_epoch++;
         DEQ_REMOVE(core->routers, rnode);
         ptr = DEQ_TAIL(core->routers);
         while (ptr) {
@@ -224,6 +234,7 @@ void qdr_route_table_setup_CT(qdr_core_t *core)
     core->conn_id_hash = qd_hash(6, 4, 0);
     core->cost_epoch   = 1;
     core->addr_parse_tree = qd_parse_tree_new(QD_PARSE_TREE_ADDRESS);
+    qd_parse_tree_enable_match_cache(core->addr_parse_tree, QDR_ADDR_CONFIG_CACHE_SIZE);
 
     if (core->router_mode == QD_ROUTER_MODE_INTERIOR) {
         core->hello_addr      = qdr_add_local_address_CT(core, 'L', "qdhello",     QD_TREATMENT_MULTICAST_FLOOD);
@@ -231,12 +242,14 @@ void qdr_route_table_setup_CT(qdr_core_t *core)
         core->routerma_addr_L = qdr_add_local_address_CT(core, 'L', "qdrouter.ma", QD_TREATMENT_MULTICAST_ONCE);
         core->router_addr_T   = qdr_add_local_address_CT(core, 'T', "qdrouter",    QD_TREATMENT_MULTICAST_FLOOD);
         core->routerma_addr_T = qdr_add_local_address_CT(core, 'T', "qdrouter.ma", QD_TREATMENT_MULTICAST_ONCE);
+        core->routerlv_addr_L = qdr_add_local_address_CT(core, 'L', "qdrouter.lv", QD_TREATMENT_MULTICAST_ONCE);
 
         core->hello_addr->router_control_only      = true;
         core->router_addr_L->router_control_only   = true;
         core->routerma_addr_L->router_control_only = true;
         core->router_addr_T->router_control_only   = true;
         core->routerma_addr_T->router_control_only = true;
+        core->routerlv_addr_L->router_control_only = true;
 
         core->neighbor_free_mask = qd_bitmask(1);
 
@@ -322,6 +335,10 @@ static void qdr_add_router_CT(qdr_core_t *core, qdr_action_t *action, bool disca
         qd_iterator_ncopy(iter, (unsigned char*) rnode->wire_address_ma, addr_len);
         strcpy(rnode->wire_address_ma + addr_len, ".ma");
 
+        // the hash key is the router id behind the 'R' prefix, as core->router_id is for this router
+        const char *id = (const char*) qd_hash_key_by_handle(addr->hash_handle) + 1;
+        rnode->id_hash = qd_hash_bytes((const uint8_t*) id, strlen(id));
+
         //
         // Insert at the head of the list because we don't yet know the cost to this
         // router node and we've set the cost to zero.  This puts it in a properly-sorted
@@ -461,6 +478,7 @@ static void qdr_set_link_CT(qdr_core_t *core, qdr_action_t *action, bool discard
     // Add the peer_link reference to the router record.
     //
     rnode->conn_mask_bit = conn_maskbit;
+    core->cost_epoch++;
     qdr_addr_start_inlinks_CT(core, rnode->owning_addr);
 }
 
@@ -485,6 +503,7 @@ static void qdr_remove_link_CT(qdr_core_t *core, qdr_action_t *action, bool disc
 
     qdr_node_t *rnode = core->routers_by_mask_bit[router_maskbit];
     rnode->conn_mask_bit = -1;
+    core->cost_epoch++;
 }
 
 
@@ -521,6 +540,7 @@ static void qdr_set_next_hop_CT(qdr_core_t *core, qdr_action_t *action, bool dis
     if (router_maskbit != nh_router_maskbit) {
         qdr_node_t *rnode = core->routers_by_mask_bit[router_maskbit];
         rnode->next_hop   = core->routers_by_mask_bit[nh_router_maskbit];
+        core->cost_epoch++;
         qdr_addr_start_inlinks_CT(core, rnode->owning_addr);
     }
 }
@@ -541,6 +561,7 @@ static void qdr_remove_next_hop_CT(qdr_core_t *core, qdr_action_t *action, bool
 
     qdr_node_t *rnode = core->routers_by_mask_bit[router_maskbit];
     rnode->next_hop = 0;
+    core->cost_epoch++;
 }
 
 
@@ -596,6 +617,11 @@ static void qdr_set_valid_origins_CT(qdr_core_t *core, qdr_action_t *action, boo
             qd_bitmask_free(rnode->valid_origins);
         rnode->valid_origins = valid_origins;
         valid_origins = 0;
+
+        //
+        // The valid origins decide the branches of the multicast trees cached in the addresses.
+        //
+        core->cost_epoch++;
     } while (false);
 
     if (valid_origins)
@@ -22,16 +22,23 @@
 #include "route_control.h"
 #include "router_core_private.h"
 
+#include "qpid/dispatch/static_assert.h"
+
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <strings.h>
 
 ALLOC_DECLARE(qdr_link_work_t);
 
 ALLOC_DEFINE(qdr_address_t);
+ALLOC_DEFINE(qdr_address_ext_t);
 ALLOC_DEFINE(qdr_address_config_t);
 ALLOC_DEFINE(qdr_node_t);
 ALLOC_DEFINE(qdr_delivery_ref_t);
 ALLOC_DEFINE_SAFE(qdr_link_t);
+STATIC_ASSERT(offsetof(qdr_link_t, link_direction) + sizeof(qd_direction_t) <= QDR_HOT_FIELDS_SIZE,
+              qdr_link_t_hot_fields_exceed_a_cache_line);
 ALLOC_DEFINE(qdr_router_ref_t);
 ALLOC_DEFINE(qdr_link_ref_t);
 ALLOC_DEFINE(qdr_delivery_cleanup_t);
@@ -44,6 +51,7 @@ ALLOC_DEFINE(qdr_subscription_ref_t);
 const uint64_t QD_DELIVERY_MOVED_TO_NEW_LINK = 999999999;
 
 static void qdr_general_handler(void *context);
+static void take_posted_work(qdr_general_work_shard_t *shard);
 
 static void qdr_core_setup_init(qdr_core_t *core)
 {
@@ -52,6 +60,19 @@ static void qdr_core_setup_init(qdr_core_t *core)
     //
     core->disable_867_fix = getenv("SKUPPER_ROUTER_DISABLE_867_FIX") != 0;
 
+    core->latency_aware_balancing = core->qd->latency_aware_balancing;
+    core->streaming_link_pool_min = core->qd->streaming_link_pool_min;
+    core->dynamic_addr_pool_size  = core->qd->dynamic_addr_pool_size;
+    core->edge_uplinks            = MAX(core->qd->edge_uplinks, 1);
+    core->enforce_message_ttl     = core->qd->enforce_message_ttl;
+    core->transfer_quantum_octets = core->qd->transfer_quantum_octets;
+    core->busy_poll_ns            = core->qd->busy_poll_core ? (uint64_t) core->qd->busy_poll_usec * 1000 : 0;
+
+    for (int priority = 0; priority < QDR_N_PRIORITIES; priority++) {
+        int weight = core->qd->priority_lane_weights[priority] ? core->qd->priority_lane_weights[priority] : priority + 1;
+        core->priority_lane_quantum[priority] = weight * QDR_PRIORITY_LANE_QUANTUM;
+    }
+
     //
     // DISPATCH-1867: These functions used to be called inside the router_core_thread() function in router_core_thread.c
     // which meant they were executed asynchronously by the core thread which meant qd_router_setup_late() could
@@ -60,6 +81,7 @@ static void qdr_core_setup_init(qdr_core_t *core)
     //
     qdr_forwarder_setup_CT(core);
     qdr_route_table_setup_CT(core);
+    qdr_stats_publish_setup_CT(core);
 
     //
     // Initialize the core modules
@@ -97,21 +119,36 @@ qdr_core_t *qdr_core(qd_dispatch_t *qd, qd_router_mode_t mode, const char *area,
     //
     // Set up the threading support
     //
+    core->running = true;
     sys_cond_init(&core->action_cond);
-    sys_mutex_init(&core->action_lock);
-    core->running     = true;
-    DEQ_INIT(core->action_list);
+    sys_mutex_init_named(&core->action_lock, "core_action");
+    sys_atomic_init(&core->sleeping, 0);
+    sys_atomic_init(&core->batch_depth, 0);
+    sys_atomic_ptr_init(&core->action_stack, 0);
+    sys_atomic_ptr_init(&core->action_stack_background, 0);
+    sys_atomic_ptr_init(&core->action_stack_control, 0);
     DEQ_INIT(core->action_list_background);
 
-    sys_mutex_init(&core->work_lock);
-    DEQ_INIT(core->work_list);
-    core->work_timer = qd_timer(core->qd, qdr_general_handler, core);
+    static const char *class_names[QDR_ACTION_CLASS_COUNT] = {"foreground", "background", "control"};
+    for (int i = 0; i < QDR_ACTION_CLASS_COUNT; i++) {
+        core->action_latency[i] =
+            qd_metric(QD_METRIC_HISTOGRAM, "qdr_core_action_latency_microseconds", "class", class_names[i]);
+    }
+
+    atomic_init(&core->work_next_shard, 0);
+    for (int i = 0; i < QDR_GENERAL_WORK_SHARDS; i++) {
+        qdr_general_work_shard_t *shard = &core->work_shards[i];
+        shard->core = core;
+        sys_atomic_ptr_init(&shard->posted, 0);
+        DEQ_INIT(shard->pending);
+        shard->timer = qd_timer(core->qd, qdr_general_handler, shard);
+    }
+    qdr_overload_setup(core);
 
     //
     // Set up the unique identifier generator
     //
-    core->next_identifier = 1;
-    sys_mutex_init(&core->id_lock);
+    atomic_init(&core->next_identifier, 1);
 
     //
     // Initialize the management agent
@@ -139,16 +176,17 @@ qdr_core_t *qdr_core(qd_dispatch_t *qd, qd_router_mode_t mode, const char *area,
 
 
 void qdr_core_stop_thread_CT(qdr_core_t *core, qdr_action_t *action, bool discard) {
-    if (!discard) {
+    if (!discard)
         core->running = false;
-    }
 }
 
 
 void qdr_core_free(qdr_core_t *core)
 {
+    qdr_overload_final(core);
+
     //
-    // Stop and join the thread
+    // Stop and join the threads
     //
     qdr_action_enqueue(core, qdr_action(qdr_core_stop_thread_CT, "Stop Thread"));
     sys_thread_join(core->thread);
@@ -156,6 +194,10 @@ void qdr_core_free(qdr_core_t *core)
     // have adaptors clean up all core resources
     qdr_adaptors_finalize(core);
 
+    for (int i = 0; i < QDR_ACTION_CLASS_COUNT; i++) {
+        qd_metric_free(core->action_latency[i]);
+    }
+
     //
     // The char* core->router_id and core->router_area are owned by qd->router_id and qd->router_area respectively
     // We will set them to zero here just in case anybody tries to use these fields.
@@ -166,7 +208,7 @@ void qdr_core_free(qdr_core_t *core)
     //
     // Free the core resources
     //
-    for (int i = 0; i <= QD_TREATMENT_ANYCAST_BALANCED; ++i) {
+    for (int i = 0; i <= QD_TREATMENT_ANYCAST_AFFINITY; ++i) {
         if (core->forwarders[i]) {
             free(core->forwarders[i]);
         }
@@ -182,6 +224,9 @@ void qdr_core_free(qdr_core_t *core)
     // Remove all address watches
     //
     qdr_address_watch_shutdown(core);
+    qdr_core_timer_free_CT(core, core->memory_timer);
+    core->memory_timer = 0;
+    qdr_stats_publish_final_CT(core);
 
     qdr_address_t *addr = 0;
     while ( (addr = DEQ_HEAD(core->addrs)) ) {
@@ -205,10 +250,8 @@ void qdr_core_free(qdr_core_t *core)
     qdr_link_t *link = DEQ_HEAD(core->open_links);
     while (link) {
         DEQ_REMOVE_HEAD(core->open_links);
-        if (link->in_streaming_pool) {
-            DEQ_REMOVE_N(STREAMING_POOL, link->conn->streaming_link_pool, link);
-            link->in_streaming_pool = false;
-        }
+        qdr_link_delivery_age_remove_CT(core, link);
+        qdr_link_streaming_pool_remove_CT(core, link);
 
         qdr_link_cleanup_deliveries_CT(core, link->conn, link, true);
 
@@ -240,6 +283,7 @@ void qdr_core_free(qdr_core_t *core)
         if (link->user_context) {
             qdr_link_set_context(link, 0);
         }
+        qdr_delivery_ring_free(&link->undelivered);
         free_qdr_link_t(link);
         link = DEQ_HEAD(core->open_links);
     }
@@ -279,11 +323,13 @@ void qdr_core_free(qdr_core_t *core)
             qdr_route_check_id_for_deletion_CT(core, conn->alt_conn_id);
         }
 
-        qdr_connection_work_t *work = DEQ_HEAD(conn->work_list);
+        qdr_connection_work_list_t work_list = DEQ_EMPTY;
+        qdr_connection_work_take(conn, &work_list);
+        qdr_connection_work_t *work = DEQ_HEAD(work_list);
         while (work) {
-            DEQ_REMOVE_HEAD(conn->work_list);
+            DEQ_REMOVE_HEAD(work_list);
             qdr_connection_work_free_CT(work);
-            work = DEQ_HEAD(conn->work_list);
+            work = DEQ_HEAD(work_list);
         }
 
         if (conn->has_streaming_links) {
@@ -303,21 +349,28 @@ void qdr_core_free(qdr_core_t *core)
     // discard any left over general work items, allowing them to clean up any
     // resources held by the work item
 
-    while (!DEQ_IS_EMPTY(core->work_list)) {
-        qdr_general_work_t *work = DEQ_HEAD(core->work_list);
-        DEQ_REMOVE_HEAD(core->work_list);
-        work->handler(core, work, true);  // discard == true
-        free_qdr_general_work_t(work);
-        work = DEQ_HEAD(core->work_list);
+    for (int i = 0; i < QDR_GENERAL_WORK_SHARDS; i++) {
+        qdr_general_work_shard_t *shard = &core->work_shards[i];
+        take_posted_work(shard);
+        while (!DEQ_IS_EMPTY(shard->pending)) {
+            qdr_general_work_t *work = DEQ_HEAD(shard->pending);
+            DEQ_REMOVE_HEAD(shard->pending);
+            work->handler(core, work, true);  // discard == true
+            free_qdr_general_work_t(work);
+        }
     }
 
     // discard any left over actions, allowing them to clean up any resources
     // held by the action
 
-    qdr_action_list_t  action_list;
-    while (!DEQ_IS_EMPTY(core->action_list) || !DEQ_IS_EMPTY(core->action_list_background)) {
-        DEQ_MOVE(core->action_list, action_list);
+    qdr_action_list_t action_list = DEQ_EMPTY;
+    for (;;) {
+        qdr_action_stack_take(&core->action_stack_control, &action_list);
+        qdr_action_stack_take(&core->action_stack, &action_list);
         DEQ_APPEND(action_list, core->action_list_background);
+        qdr_action_stack_take(&core->action_stack_background, &action_list);
+        if (DEQ_IS_EMPTY(action_list))
+            break;
         qdr_action_t *action = DEQ_HEAD(action_list);
         while (action) {
             DEQ_REMOVE_HEAD(action_list);
@@ -346,12 +399,18 @@ void qdr_core_free(qdr_core_t *core)
     // action/work handler did not properly honor the discard flag and needs to
     // be fixed!
 
-    assert(DEQ_IS_EMPTY(core->work_list));
-    assert(DEQ_IS_EMPTY(core->action_list));
+    for (int i = 0; i < QDR_GENERAL_WORK_SHARDS; i++) {
+        assert(sys_atomic_ptr_get(&core->work_shards[i].posted) == 0);
+        assert(DEQ_IS_EMPTY(core->work_shards[i].pending));
+    }
+    assert(sys_atomic_ptr_get(&core->action_stack) == 0);
+    assert(sys_atomic_ptr_get(&core->action_stack_background) == 0);
+    assert(sys_atomic_ptr_get(&core->action_stack_control) == 0);
     assert(DEQ_IS_EMPTY(core->action_list_background));
     assert(DEQ_IS_EMPTY(core->streaming_connections));
 
     if (core->routers_by_mask_bit)             free(core->routers_by_mask_bit);
+    free(core->push_batch);
     if (core->neighbor_free_mask)              qd_bitmask_free(core->neighbor_free_mask);
     if (core->rnode_conns_by_mask_bit)         free(core->rnode_conns_by_mask_bit);
     if (core->pending_rnode_conns_by_mask_bit) free(core->pending_rnode_conns_by_mask_bit);
@@ -365,9 +424,8 @@ void qdr_core_free(qdr_core_t *core)
     sys_thread_free(core->thread);
     sys_cond_free(&core->action_cond);
     sys_mutex_free(&core->action_lock);
-    sys_mutex_free(&core->work_lock);
-    sys_mutex_free(&core->id_lock);
-    qd_timer_free(core->work_timer);
+    for (int i = 0; i < QDR_GENERAL_WORK_SHARDS; i++)
+        qd_timer_free(core->work_shards[i].timer);
 
     free(core);
 }
@@ -493,25 +551,120 @@ qdr_action_t *qdr_action(qdr_action_handler_t action_handler, const char *label)
 }
 
 
-void qdr_action_enqueue(qdr_core_t *core, qdr_action_t *action)
+//
+// Thread-local staging of actions between qdr_action_batch_begin() and qdr_action_batch_flush().  Staged actions are
+// kept newest first and linked through DEQ_NEXT, so a flush can push the chain onto the core's action stack with a
+// single compare-and-swap.
+//
+typedef struct qdr_action_batch_t {
+    qdr_core_t   *core;
+    qdr_action_t *newest;
+    qdr_action_t *oldest;
+    bool          active;
+} qdr_action_batch_t;
+
+static __thread qdr_action_batch_t action_batch;
+
+
+/**
+ * Push a chain of actions onto one of the core's stacks.  The chain runs from newest to oldest through DEQ_NEXT.
+ */
+static void qdr_action_push_chain(qdr_core_t *core, sys_atomic_ptr_t *stack, qdr_action_t *newest, qdr_action_t *oldest)
 {
-    sys_mutex_lock(&core->action_lock);
-    DEQ_INSERT_TAIL(core->action_list, action);
-    const bool need_wake = core->sleeping;
-    sys_mutex_unlock(&core->action_lock);
-    if (need_wake)
+    void *head = sys_atomic_ptr_get(stack);
+    do {
+        DEQ_NEXT(oldest) = (qdr_action_t*) head;
+    } while (!sys_atomic_ptr_cas(stack, &head, newest));
+
+    //
+    // The core thread sets the sleeping flag under the action_lock before it re-checks the stacks and parks.  Taking
+    // the lock here guarantees that the core thread is either not yet checking or already waiting on the condition.
+    //
+    if (IS_ATOMIC_FLAG_SET(&core->sleeping)) {
+        sys_mutex_lock(&core->action_lock);
+        sys_mutex_unlock(&core->action_lock);
         sys_cond_signal(&core->action_cond);
+    }
+}
+
+
+static void qdr_action_batch_publish(void)
+{
+    qdr_core_t *core = action_batch.core;
+    if (action_batch.newest) {
+        qdr_action_push_chain(core, &core->action_stack, action_batch.newest, action_batch.oldest);
+        action_batch.newest = 0;
+        action_batch.oldest = 0;
+    }
+    action_batch.core = 0;
+}
+
+
+void qdr_action_batch_begin(void)
+{
+    action_batch.active = true;
+}
+
+
+void qdr_action_batch_flush(void)
+{
+    if (action_batch.core)
+        qdr_action_batch_publish();
+    action_batch.active = false;
+}
+
+
+void qdr_action_stack_take(sys_atomic_ptr_t *stack, qdr_action_list_t *list)
+{
+    qdr_action_t      *action = (qdr_action_t*) sys_atomic_ptr_set(stack, 0);
+    qdr_action_list_t  fifo   = DEQ_EMPTY;
+
+    while (action) {
+        qdr_action_t *older = DEQ_NEXT(action);
+        DEQ_ITEM_INIT(action);
+        DEQ_INSERT_HEAD(fifo, action);
+        action = older;
+    }
+    DEQ_APPEND(*list, fifo);
+}
+
+
+void qdr_action_enqueue(qdr_core_t *core, qdr_action_t *action)
+{
+    action->enqueued_ns = qdr_core_now_ns();
+    if (action_batch.active) {
+        if (action_batch.core != core) {
+            if (action_batch.core)
+                qdr_action_batch_publish();
+            action_batch.core = core;
+        }
+        DEQ_NEXT(action) = action_batch.newest;
+        action_batch.newest = action;
+        if (!action_batch.oldest)
+            action_batch.oldest = action;
+        return;
+    }
+
+    qdr_action_push_chain(core, &core->action_stack, action, action);
 }
 
 
 void qdr_action_background_enqueue(qdr_core_t *core, qdr_action_t *action)
 {
-    sys_mutex_lock(&core->action_lock);
-    DEQ_INSERT_TAIL(core->action_list_background, action);
-    const bool need_wake = core->sleeping;
-    sys_mutex_unlock(&core->action_lock);
-    if (need_wake)
-        sys_cond_signal(&core->action_cond);
+    action->enqueued_ns = qdr_core_now_ns();
+    qdr_action_push_chain(core, &core->action_stack_background, action, action);
+}
+
+
+/**
+ * Enqueue a routing-protocol or management action.  It is not staged with the I/O thread's batch and the core thread
+ * runs it before any foreground or background action still waiting.  Control actions run in the order they were
+ * enqueued, but not in order with actions of the other classes.
+ */
+void qdr_action_control_enqueue(qdr_core_t *core, qdr_action_t *action)
+{
+    action->enqueued_ns = qdr_core_now_ns();
+    qdr_action_push_chain(core, &core->action_stack_control, action, action);
 }
 
 
@@ -526,8 +679,6 @@ qdr_address_t *qdr_address_CT(qdr_core_t *core, qd_address_treatment_t treatment
     addr->treatment  = treatment;
     addr->forwarder  = qdr_forwarder_CT(core, treatment);
     addr->rnodes     = qd_bitmask(0);
-    addr->add_prefix = 0;
-    addr->del_prefix = 0;
     addr->priority   = -1;
 
     if (config)
@@ -537,14 +688,56 @@ qdr_address_t *qdr_address_CT(qdr_core_t *core, qd_address_treatment_t treatment
 }
 
 
+qdr_address_ext_t *qdr_address_ext_CT(qdr_address_t *addr)
+{
+    if (!addr->ext) {
+        addr->ext = new_qdr_address_ext_t();
+        ZERO(addr->ext);
+    }
+    return addr->ext;
+}
+
+
+/**
+ * Return the latency histograms of a latency-tracked address with a reference added for the caller, registering the
+ * histograms the first time round.
+ */
+qdr_address_latency_t *qdr_address_latency_CT(qdr_address_t *addr)
+{
+    qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+    if (!ext->latency) {
+        const char *key = addr->hash_handle ? (const char *) qd_hash_key_by_handle(addr->hash_handle) : 0;
+        if (!key)
+            key = "";
+        ext->latency            = NEW(qdr_address_latency_t);
+        ext->latency->ref_count = 1;  // the address' reference
+        ext->latency->egress    = qd_metric(QD_METRIC_HISTOGRAM, "qdr_address_egress_latency_microseconds", "address", key);
+        ext->latency->settle    = qd_metric(QD_METRIC_HISTOGRAM, "qdr_address_settle_latency_microseconds", "address", key);
+    }
+    ext->latency->ref_count++;
+    return ext->latency;
+}
+
+
+void qdr_address_latency_decref_CT(qdr_address_latency_t *latency)
+{
+    if (latency && --latency->ref_count == 0) {
+        qd_metric_free(latency->egress);
+        qd_metric_free(latency->settle);
+        free(latency);
+    }
+}
+
+
 qdr_address_t *qdr_add_local_address_CT(qdr_core_t *core, char aclass, const char *address, qd_address_treatment_t treatment)
 {
     char           addr_string[1000];
     qdr_address_t *addr = 0;
     qd_iterator_t *iter = 0;
 
+    qd_iterator_storage_t storage;
     snprintf(addr_string, sizeof(addr_string), "%c%s", aclass, address);
-    iter = qd_iterator_string(addr_string, ITER_VIEW_ALL);
+    iter = qd_iterator_init_string(&storage, addr_string, ITER_VIEW_ALL);
 
     qd_hash_retrieve(core->addr_hash, iter, (void**) &addr);
     if (!addr) {
@@ -575,8 +768,9 @@ qdr_address_t *qdr_add_mobile_address_CT(qdr_core_t *core, const char *prefix, c
         addr_string = (char*) malloc(len);
     }
 
+    qd_iterator_storage_t storage;
     snprintf(addr_string, len, "%s%s%s", edge ? "H" : "M", prefix, address);
-    iter = qd_iterator_string(addr_string, ITER_VIEW_ALL);
+    iter = qd_iterator_init_string(&storage, addr_string, ITER_VIEW_ALL);
 
     qd_hash_retrieve(core->addr_hash, iter, (void**) &addr);
     if (!addr) {
@@ -625,6 +819,7 @@ const char *get_address_treatment_string(qd_address_treatment_t  treatment)
     case QD_TREATMENT_MULTICAST_ONCE:   text = "multicast"; break;
     case QD_TREATMENT_ANYCAST_CLOSEST:  text = "closest";   break;
     case QD_TREATMENT_ANYCAST_BALANCED: text = "balanced";  break;
+    case QD_TREATMENT_ANYCAST_AFFINITY: text = "affinity";  break;
     default:
         text = 0;
     }
@@ -658,6 +853,7 @@ static void free_address_config(qdr_address_config_t *addr)
 {
     free(addr->name);
     free(addr->pattern);
+    free(addr->affinity_key);
     qd_hash_handle_free(addr->hash_handle);
     free_qdr_address_config_t(addr);
 }
@@ -668,6 +864,9 @@ void qdr_core_remove_address(qdr_core_t *core, qdr_address_t *addr)
     if (config && --config->ref_count == 0)
         free_address_config(config);
 
+    if (core->heavy_hitters)
+        qdr_heavy_hitters_forget_address_CT(core->heavy_hitters, addr);
+
     // Free resources associated with this address
 
     DEQ_APPEND(addr->rlinks, addr->inlinks);
@@ -694,16 +893,17 @@ void qdr_core_remove_address(qdr_core_t *core, qdr_address_t *addr)
     }
 
     qd_bitmask_free(addr->rnodes);
-    if (addr->treatment == QD_TREATMENT_ANYCAST_CLOSEST) {
-        qd_bitmask_free(addr->closest_remotes);
-    }
-    else if (addr->treatment == QD_TREATMENT_ANYCAST_BALANCED) {
-        free(addr->outstanding_deliveries);
-    }
+    free(addr->remote_candidates);
+    free(addr->outstanding_deliveries);  // balanced and affinity distribution
 
-    free(addr->add_prefix);
-    free(addr->del_prefix);
     free(addr->remote_sole_destination_meshes);
+    if (addr->ext) {
+        qdr_address_latency_decref_CT(addr->ext->latency);
+        qdr_forward_free_multicast_branches_CT(addr);
+        qdr_dynamic_addr_forget_CT(addr);
+        free(addr->ext->pool_address);
+        free_qdr_address_ext_t(addr->ext);
+    }
     free_qdr_address_t(addr);
 }
 
@@ -1010,23 +1210,40 @@ void qdr_del_subscription_ref_CT(qdr_subscription_ref_list_t *list, qdr_subscrip
 }
 
 
+/**
+ * Append the work posted to the shard since the last call to its pending list, oldest first.
+ */
+static void take_posted_work(qdr_general_work_shard_t *shard)
+{
+    qdr_general_work_t *work = (qdr_general_work_t *) sys_atomic_ptr_set(&shard->posted, 0);
+    qdr_general_work_list_t taken;
+    DEQ_INIT(taken);
+    while (work) {
+        qdr_general_work_t *next = work->next;
+        DEQ_INSERT_HEAD(taken, work);
+        work = next;
+    }
+    DEQ_APPEND(shard->pending, taken);
+}
+
+
 static void qdr_general_handler(void *context)
 {
-    qdr_core_t              *core = (qdr_core_t*) context;
-    qdr_general_work_list_t  work_list;
-    qdr_general_work_t      *work;
+    qdr_general_work_shard_t *shard = (qdr_general_work_shard_t*) context;
+    qdr_core_t               *core  = shard->core;
 
-    sys_mutex_lock(&core->work_lock);
-    DEQ_MOVE(core->work_list, work_list);
-    sys_mutex_unlock(&core->work_lock);
+    take_posted_work(shard);
 
-    work = DEQ_HEAD(work_list);
-    while (work) {
-        DEQ_REMOVE_HEAD(work_list);
+    for (int i = 0; i < QDR_GENERAL_WORK_BATCH && !DEQ_IS_EMPTY(shard->pending); i++) {
+        qdr_general_work_t *work = DEQ_HEAD(shard->pending);
+        DEQ_REMOVE_HEAD(shard->pending);
         work->handler(core, work, false);
         free_qdr_general_work_t(work);
-        work = DEQ_HEAD(work_list);
     }
+
+    // Work posted from now on reschedules the timer itself, only the remainder of this batch needs another pass
+    if (!DEQ_IS_EMPTY(shard->pending))
+        qd_timer_schedule(shard->timer, 0);
 }
 
 
@@ -1039,27 +1256,36 @@ qdr_general_work_t *qdr_general_work(qdr_general_work_handler_t handler)
 }
 
 
+static qdr_general_work_shard_t *work_shard(qdr_core_t *core, uintptr_t affinity)
+{
+    if (affinity == 0)
+        return &core->work_shards[0];
+    if (affinity == QDR_GENERAL_WORK_UNORDERED)
+        return &core->work_shards[atomic_fetch_add_explicit(&core->work_next_shard, 1, memory_order_relaxed)
+                                  % QDR_GENERAL_WORK_SHARDS];
+    return &core->work_shards[(((uint64_t) affinity * 0x9E3779B97F4A7C15ULL) >> 32) % QDR_GENERAL_WORK_SHARDS];
+}
+
+
 void qdr_post_general_work_CT(qdr_core_t *core, qdr_general_work_t *work)
 {
-    bool notify;
+    qdr_general_work_shard_t *shard = work_shard(core, work->affinity);
 
-    sys_mutex_lock(&core->work_lock);
     DEQ_ITEM_INIT(work);
-    DEQ_INSERT_TAIL(core->work_list, work);
-    notify = DEQ_SIZE(core->work_list) == 1;
-    sys_mutex_unlock(&core->work_lock);
-
-    if (notify)
-        qd_timer_schedule(core->work_timer, 0);
+    void *head = sys_atomic_ptr_get(&shard->posted);
+    do {
+        work->next = (qdr_general_work_t *) head;
+    } while (!sys_atomic_ptr_cas(&shard->posted, &head, work));
+
+    // Only the first work posted since the timer last took the list needs to schedule it
+    if (!head)
+        qd_timer_schedule(shard->timer, 0);
 }
 
 
 uint64_t qdr_identifier(qdr_core_t* core)
 {
-    sys_mutex_lock(&core->id_lock);
-    uint64_t id = core->next_identifier++;
-    sys_mutex_unlock(&core->id_lock);
-    return id;
+    return atomic_fetch_add_explicit(&core->next_identifier, 1, memory_order_relaxed);
 }
 
 
@@ -1081,32 +1307,53 @@ static void qdr_post_global_stats_response(qdr_core_t *core, qdr_general_work_t
     work->stats_handler(work->context, discard);
 }
 
+void qdr_global_stats_copy_CT(qdr_core_t *core, qdr_global_stats_t *stats)
+{
+    stats->addrs = DEQ_SIZE(core->addrs);
+    stats->links = DEQ_SIZE(core->open_links);
+    stats->routers = DEQ_SIZE(core->routers);
+    stats->connections = DEQ_SIZE(core->open_connections);
+    stats->auto_links = DEQ_SIZE(core->auto_links);
+    stats->presettled_deliveries = core->presettled_deliveries;
+    stats->dropped_presettled_deliveries = core->dropped_presettled_deliveries;
+    stats->accepted_deliveries = core->accepted_deliveries;
+    stats->rejected_deliveries = core->rejected_deliveries;
+    stats->released_deliveries = core->released_deliveries;
+    stats->modified_deliveries = core->modified_deliveries;
+    stats->deliveries_ingress = core->deliveries_ingress;
+    stats->deliveries_egress = core->deliveries_egress;
+    stats->deliveries_transit = core->deliveries_transit;
+    stats->deliveries_ingress_route_container = core->deliveries_ingress_route_container;
+    stats->deliveries_egress_route_container = core->deliveries_egress_route_container;
+    stats->deliveries_delayed_1sec = core->deliveries_delayed_1sec;
+    stats->deliveries_delayed_10sec = core->deliveries_delayed_10sec;
+    stats->deliveries_stuck = core->deliveries_stuck;
+    stats->links_blocked = core->links_blocked;
+    const qdr_action_stats_table_t *table = &core->action_stats;
+    stats->action_batches   = table->batches;
+    stats->action_depth_max = table->depth_max;
+    for (int cls = 0; cls < QDR_ACTION_CLASS_COUNT; cls++) {
+        qdr_action_class_stats_t *class_stats = &stats->action_class_stats[cls];
+        class_stats->count         = table->classes[cls].count;
+        class_stats->wait_total_ns = table->classes[cls].wait_total_ns;
+        class_stats->wait_max_ns   = table->classes[cls].wait_max_ns;
+    }
+    stats->action_stats_count = qdr_action_stats_collect_CT(core, stats->action_stats, QDR_ACTION_STATS_MAX);
+
+    memcpy(stats->priority_lane_stats, core->closed_lane_stats, sizeof(stats->priority_lane_stats));
+    for (qdr_connection_t *conn = DEQ_HEAD(core->open_connections); conn; conn = DEQ_NEXT(conn)) {
+        sys_mutex_lock(&conn->work_lock);
+        qdr_priority_lane_stats_merge(stats->priority_lane_stats, conn->lane_stats);
+        sys_mutex_unlock(&conn->work_lock);
+    }
+}
+
 static void qdr_global_stats_request_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     if (!discard) {
         qdr_global_stats_t *stats = action->args.stats_request.stats;
-        if (stats) {
-            stats->addrs = DEQ_SIZE(core->addrs);
-            stats->links = DEQ_SIZE(core->open_links);
-            stats->routers = DEQ_SIZE(core->routers);
-            stats->connections = DEQ_SIZE(core->open_connections);
-            stats->auto_links = DEQ_SIZE(core->auto_links);
-            stats->presettled_deliveries = core->presettled_deliveries;
-            stats->dropped_presettled_deliveries = core->dropped_presettled_deliveries;
-            stats->accepted_deliveries = core->accepted_deliveries;
-            stats->rejected_deliveries = core->rejected_deliveries;
-            stats->released_deliveries = core->released_deliveries;
-            stats->modified_deliveries = core->modified_deliveries;
-            stats->deliveries_ingress = core->deliveries_ingress;
-            stats->deliveries_egress = core->deliveries_egress;
-            stats->deliveries_transit = core->deliveries_transit;
-            stats->deliveries_ingress_route_container = core->deliveries_ingress_route_container;
-            stats->deliveries_egress_route_container = core->deliveries_egress_route_container;
-            stats->deliveries_delayed_1sec = core->deliveries_delayed_1sec;
-            stats->deliveries_delayed_10sec = core->deliveries_delayed_10sec;
-            stats->deliveries_stuck = core->deliveries_stuck;
-            stats->links_blocked = core->links_blocked;
-        }
+        if (stats)
+            qdr_global_stats_copy_CT(core, stats);
         qdr_general_work_t *work = qdr_general_work(qdr_post_global_stats_response);
         work->stats_handler = action->args.stats_request.handler;
         work->context = action->args.stats_request.context;
@@ -1117,6 +1364,18 @@ static void qdr_global_stats_request_CT(qdr_core_t *core, qdr_action_t *action,
 
 void qdr_request_global_stats(qdr_core_t *core, qdr_global_stats_t *stats, qdr_global_stats_handler_t callback, void *context)
 {
+    //
+    // Answer from the statistics the core last published, if it publishes them. A request without stats is a
+    // liveness probe of the core thread and always takes the action.
+    //
+    if (stats && qdr_global_stats_read_published(core, stats)) {
+        qdr_general_work_t *work = qdr_general_work(qdr_post_global_stats_response);
+        work->stats_handler = callback;
+        work->context       = context;
+        qdr_post_general_work_CT(core, work);  // lock-free, safe off the core thread
+        return;
+    }
+
     qdr_action_t *action = qdr_action(qdr_global_stats_request_CT, "global_stats_request");
     action->args.stats_request.stats = stats;
     action->args.stats_request.handler = callback;
@@ -1170,8 +1429,17 @@ qdr_protocol_adaptor_t *qdr_protocol_adaptor(qdr_core_t                *core,
 }
 
 
+void qdr_protocol_adaptor_coalesce_activations(qdr_protocol_adaptor_t *adaptor)
+{
+    adaptor->coalesce_activations = true;
+}
+
+
 void qdr_protocol_adaptor_free(qdr_core_t *core, qdr_protocol_adaptor_t *adaptor)
 {
+    qd_log(LOG_ROUTER_CORE, QD_LOG_INFO,
+           "Protocol adaptor %s connection activations: requested=%" PRIu64 " suppressed=%" PRIu64 " delivered=%" PRIu64,
+           adaptor->name, adaptor->activations_requested, adaptor->activations_suppressed, adaptor->activations_delivered);
     DEQ_REMOVE(core->protocol_adaptors, adaptor);
     free(adaptor);
 }
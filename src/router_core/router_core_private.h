@@ -24,6 +24,7 @@
 
 #include "qpid/dispatch/atomic.h"
 #include "qpid/dispatch/log.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/protocol_adaptor.h"
 #include "qpid/dispatch/threading.h"
 #include "qpid/dispatch/discriminator.h"
@@ -31,6 +32,7 @@
 #include "qpid/dispatch/router_core.h"
 
 #include <memory.h>
+#include <time.h>
 
 typedef struct qdr_address_t         qdr_address_t;
 typedef struct qdr_address_config_t  qdr_address_config_t;
@@ -100,6 +102,7 @@ struct qdr_action_t {
     DEQ_LINKS(qdr_action_t);
     qdr_action_handler_t  action_handler;
     const char           *label;
+    uint64_t              enqueued_ns;  /// monotonic time the action was enqueued, for queue-delay stats
     union {
         //
         // Arguments for router control-plane actions
@@ -140,6 +143,8 @@ struct qdr_action_t {
             qdr_delivery_t      *delivery;
             qd_delivery_state_t *dstate;
             uint64_t             disposition;
+            uint64_t             section_offset;  // PN_RECEIVED without dstate
+            uint32_t             section_number;
             bool                 settled;
             bool                 presettled;  // true if remote settles while msg is in flight
             bool                 more;  // true if there are more frames arriving, false otherwise
@@ -183,6 +188,15 @@ struct qdr_action_t {
             void                           *context;
         } stats_request;
 
+        //
+        // Arguments for stats snapshot actions
+        //
+        struct {
+            qd_router_entity_type_t        entity_type;
+            qdr_stats_snapshot_handler_t   handler;
+            void                           *context;
+        } stats_snapshot;
+
         //
         // Arguments for general use
         //
@@ -217,9 +231,13 @@ DEQ_DECLARE(qdr_delivery_cleanup_t, qdr_delivery_cleanup_list_t);
 // General Work
 //
 // The following types are used to post work to the IO threads for
-// non-connection-specific action.  These actions are serialized through
-// a zero-delay timer and are processed by one thread at a time.  General
-// actions occur in-order and are not run concurrently.
+// non-connection-specific action.  Work is distributed over a number of
+// shards by its affinity key.  Each shard is a lock-free list drained by its
+// own zero-delay timer, a bounded batch per pass, so a backlog in one shard
+// does not hold up the others.  Work in the same shard occurs in-order and is
+// not run concurrently.  Work without an affinity key goes to the first shard
+// and stays in-order with all other such work; QDR_GENERAL_WORK_UNORDERED may
+// be given to work that can run in any order.
 //
 // If the discard parameter to the handler is true the router is in the process
 // of shutting down and cleaning up any outstanding general work items. At this
@@ -233,6 +251,7 @@ typedef void (*qdr_general_work_handler_t) (qdr_core_t *core, qdr_general_work_t
 struct qdr_general_work_t {
     DEQ_LINKS(qdr_general_work_t);
     qdr_general_work_handler_t   handler;
+    uintptr_t                    affinity;  /// Work with the same key runs in-order, 0: in-order with all unkeyed work
     int                          maskbit;
     int                          inter_router_cost;
     qd_message_t                *msg;
@@ -240,22 +259,32 @@ struct qdr_general_work_t {
     void                        *on_message_context;
     uint64_t                     in_conn_id;
     uint64_t                     mobile_seq;
-    uint32_t                     local_consumers;
-    uint32_t                     in_proc_consumers;
-    uint32_t                     remote_consumers;
-    uint32_t                     local_producers;
     const qd_policy_spec_t      *policy_spec;
     qdr_delivery_t              *delivery;
     qdr_delivery_cleanup_list_t  delivery_cleanup_list;
     qdr_global_stats_handler_t   stats_handler;
-    qdr_address_watch_update_t   watch_update_handler;
+    qdr_stats_snapshot_handler_t snapshot_handler;
+    qdr_stats_snapshot_t        *snapshot;
     qdr_address_watch_cancel_t   watch_cancel_handler;
+    qdr_watch_update_t          *watch_updates;
+    size_t                       watch_update_count;
     void                        *context;
 };
 
 ALLOC_DECLARE(qdr_general_work_t);
 DEQ_DECLARE(qdr_general_work_t, qdr_general_work_list_t);
 
+#define QDR_GENERAL_WORK_SHARDS    4
+#define QDR_GENERAL_WORK_BATCH     64             /// Work items run per timer pass of a shard
+#define QDR_GENERAL_WORK_UNORDERED ((uintptr_t) 1) /// Affinity of work that can run on any shard
+
+typedef struct qdr_general_work_shard_t {
+    qdr_core_t                   *core;
+    sys_atomic_ptr_t              posted;   /// Lock-free stack of posted work, newest first, linked by next
+    qdr_general_work_list_t       pending;  /// Timer only: taken from posted, in posting order
+    qd_timer_t                   *timer;
+} qdr_general_work_shard_t;
+
 qdr_general_work_t *qdr_general_work(qdr_general_work_handler_t handler);
 
 
@@ -288,6 +317,13 @@ ALLOC_DECLARE(qdr_connection_work_t);
 DEQ_DECLARE(qdr_connection_work_t, qdr_connection_work_list_t);
 void qdr_connection_work_free_CT(qdr_connection_work_t *work);
 
+/**
+ * Take all the work posted to a connection and append it to list in the order it was posted.  Connection work is
+ * handed to the I/O thread through a lock-free stack: the core pushes with a compare-and-swap and the taker empties the
+ * whole stack with one atomic exchange, so the work_lock is not needed for it.
+ */
+void qdr_connection_work_take(qdr_connection_t *conn, qdr_connection_work_list_t *list);
+
 //
 // Link Work
 //
@@ -349,6 +385,10 @@ struct qdr_query_t {
     qd_composed_field_t     *body;
     qdr_field_t             *next_key;
     int                      next_offset;
+    qd_alloc_safe_ptr_t      next_ptr;  // the next connection or link, next_offset is used if it has been freed
+    int                      limit;     // rows requested, all rows if not positive
+    int                      rows;      // rows written so far
+    bool                     batching;  // the response is deferred while a batch of rows is written
     bool                     more;
     qd_amqp_error_t          status;
     uint64_t                 in_conn;  // or perhaps a pointer???
@@ -367,6 +407,7 @@ struct qdr_node_t {
     int               cost;
     uint64_t          mobile_seq;
     char             *wire_address_ma;    ///< The address of this router's mobile-sync agent in non-hashed form
+    uint32_t          id_hash;            ///< Hash of the router id, its weight seed for affinity distribution
     uint32_t          sync_mask;          ///< Bitmask for mobile-address-sync
 };
 
@@ -412,6 +453,28 @@ void qdr_del_subscription_ref_CT(qdr_subscription_ref_list_t *list, qdr_subscrip
 
 DEQ_DECLARE(qdr_delivery_t, qdr_delivery_list_t);
 
+/**
+ * The undelivered deliveries of a link, oldest first, held in a growable ring of delivery pointers so that sending,
+ * draining and sweeping a link walk contiguous memory and queueing a delivery touches none of its neighbours.
+ *
+ * Ring positions increase monotonically (modulo 2^32) and index the slots through the mask; each queued delivery
+ * keeps its position in qdr_delivery_t.ring_pos.  A delivery taken out of the middle leaves an empty slot that is
+ * skipped once it reaches the head, so the head, if any, is always a delivery.  A zeroed ring is empty, the slots are
+ * allocated on the first push.  See delivery.h for the operations.
+ */
+typedef struct qdr_delivery_ring_t {
+    qdr_delivery_t **slots;
+    uint32_t         mask;   ///< slot count - 1, the slot count is a power of two
+    uint32_t         head;   ///< position of the oldest delivery
+    uint32_t         tail;   ///< position of the next delivery pushed
+    uint32_t         count;  ///< deliveries held, not counting the empty slots between head and tail
+} qdr_delivery_ring_t;
+
+static inline uint32_t qdr_delivery_ring_size(const qdr_delivery_ring_t *ring)
+{
+    return ring->count;
+}
+
 void qdr_add_delivery_ref_CT(qdr_delivery_ref_list_t *list, qdr_delivery_t *dlv);
 void qdr_del_delivery_ref(qdr_delivery_ref_list_t *list, qdr_delivery_ref_t *ref);
 
@@ -446,37 +509,47 @@ typedef enum {
 
 #define QDR_LINK_RATE_DEPTH 5
 
+//
+// The fields of qdr_link_t and qdr_delivery_t used for every delivery are grouped at the start of the structures, in
+// at most this many octets: one cache line.
+//
+#define QDR_HOT_FIELDS_SIZE 64
+
 struct qdr_link_t {
-    DEQ_LINKS(qdr_link_t);
+    //
+    // Hot: used for every delivery forwarded to or received from the link.  Kept within the first
+    // QDR_HOT_FIELDS_SIZE octets, see the static asserts in router_core.c
+    //
     qdr_core_t              *core;
-    uint64_t                 identity;
-    void                    *user_context;
-    void                    *edge_context;       ///< Opaque context to be used for edge-related purposes
     qdr_connection_t        *conn;               ///< [ref] Connection that owns this link
+    qdr_address_t           *owning_addr;        ///< [ref] Address record that owns this link
+    qdr_delivery_ring_t      undelivered;        ///< Deliveries to be forwarded or sent
+    int                      capacity;
+    int                      credit_to_core;    ///< Number of the available credits incrementally given to the core
     qd_link_type_t           link_type;
     qd_direction_t           link_direction;
+
+    DEQ_LINKS(qdr_link_t);
+    uint64_t                 identity;
+    void                    *user_context;
+    void                    *edge_context;       ///< Opaque context to be used for edge-related purposes
     qdr_link_state_t         state;
     qdr_link_work_list_t     work_list;
-    char                    *name;
-    char                    *disambiguated_name;
-    char                    *terminus_addr;
     uint32_t                 open_moved_streams; ///< Number of still-open streaming deliveries that were moved from this link
-    qdr_address_t           *owning_addr;        ///< [ref] Address record that owns this link
+    uint64_t                 settle_ewma_ns;     ///< Moving average of forward-to-settlement time (latency-aware balancing)
     qdrc_endpoint_t         *core_endpoint;      ///< [ref] Set if this link terminates on an in-core endpoint
     qdr_link_ref_t          *ref[QDR_LINK_LIST_CLASSES];  ///< Pointers to containing reference objects
     qdr_auto_link_t         *auto_link;          ///< [ref] Auto_link that owns this link
-    qdr_delivery_list_t      undelivered;        ///< Deliveries to be forwarded or sent
     qdr_delivery_list_t      unsettled;          ///< Unsettled deliveries
     qdr_delivery_list_t      settled;            ///< Settled deliveries
     qdr_delivery_ref_list_t  updated_deliveries; ///< References to deliveries (in the unsettled list) with updates.
     qdr_link_oper_status_t   oper_status;
-    int                      capacity;
-    int                      credit_to_core;    ///< Number of the available credits incrementally given to the core
     int                      credit_pending;    ///< Number of credits to be issued once consumers are available
     int                      credit_stored;     ///< Number of credits given to the link before it was ready to process them.
     int                      credit_reported;   ///< Number of credits to expose to management
     uint32_t                 zero_credit_time;  ///< Number of core ticks when credit last went to zero
     bool                     reported_as_blocked; ///< The fact that this link has been blocked with zero credit has been logged
+    bool                     credit_held;       ///< Initial credit withheld under router memory pressure
     bool                     strip_annotations_in;
     bool                     strip_annotations_out;
     bool                     drain_mode;
@@ -484,8 +557,10 @@ struct qdr_link_t {
     bool                     edge;              ///< True if this link is in an edge-connection
     bool                     processing;        ///< True if an IO thread is currently handling this link
     bool                     ready_to_free;     ///< True if the core thread wanted to clean up the link but it was processing
+    bool                     lane_yielded;      ///< True if processing stopped because the link's priority lane used its share or the link its transfer quantum
     bool                     streaming;         ///< True if this link can be reused for streaming msgs
     bool                     in_streaming_pool; ///< True if this link is in the connections standby pool STREAMING_POOL
+    bool                     in_idle_streaming; ///< True if this pooled link is in core->idle_streaming_links STREAMING_IDLE
     bool                     user_streaming;    ///< True if this link can be used to transfer a stream (requested by the in-process attacher)
     bool                     resend_released_deliveries;
     bool                     no_route;          ///< True if this link is to not receive routed deliveries
@@ -493,12 +568,20 @@ struct qdr_link_t {
     bool                     proxy;             ///< True if this link represents endpoints on a remote router (used on edge router only)
     bool                     edge_reachable;    ///< The last reachability state sent to the edge (only for edge inlinks on an interior router)
     sys_atomic_t             streaming_deliveries;  ///< If true, set the streaming bit in the router annotations for arriving deliveries
+    sys_atomic_t             q2_limit;          ///< Adaptive Q2 upper limit reported by the I/O thread (incoming AMQP links), 0: default
+    sys_atomic_t             q2_blocked_count;  ///< Number of times Q2 held off an incoming message, reported by the I/O thread
+    qdr_delivery_list_t      deliver_batch;     ///< I/O thread only: new deliveries held until qdr_link_deliver_batch_flush()
+    bool                     deliver_batching;  ///< I/O thread only: true between qdr_link_deliver_batch_begin() and _flush()
+    char                    *name;
+    char                    *disambiguated_name;
+    char                    *terminus_addr;
     char                    *strip_prefix;
     char                    *insert_prefix;
 
     uint64_t  total_deliveries;
     uint64_t  presettled_deliveries;
     uint64_t  dropped_presettled_deliveries;
+    uint64_t  expired_deliveries;   ///< Outgoing deliveries dropped from undelivered because their ttl ran out
     uint64_t  accepted_deliveries;
     uint64_t  rejected_deliveries;
     uint64_t  released_deliveries;
@@ -512,9 +595,14 @@ struct qdr_link_t {
     uint8_t   priority;
     uint8_t   rate_cursor;
     uint32_t  core_ticks;
+    uint32_t  delivery_age_ticks;       ///< Core ticks when the link last settled, or got deliveries while it had none
+    bool      in_delivery_age_list;     ///< The link is in core->links_by_delivery_age
+    uint32_t  streaming_idle_ticks;     ///< Core ticks when the link was last put in its connection's streaming pool
     uint64_t  conn_id;
 
     DEQ_LINKS_N(STREAMING_POOL, qdr_link_t);
+    DEQ_LINKS_N(STREAMING_IDLE, qdr_link_t);
+    DEQ_LINKS_N(DELIVERY_AGE, qdr_link_t);
 };
 DEQ_DECLARE(qdr_link_t, qdr_link_list_t);
 
@@ -540,6 +628,60 @@ DEQ_DECLARE(qdr_connection_ref_t, qdr_connection_ref_list_t);
 void qdr_add_connection_ref(qdr_connection_ref_list_t *ref_list, qdr_connection_t *conn);
 void qdr_del_connection_ref(qdr_connection_ref_list_t *ref_list, qdr_connection_t *conn);
 
+//
+// A remote destination for an anycast address, cached on the address so that forwarding
+// does not have to walk the router list for each delivery.
+//
+typedef struct qdr_forward_candidate_t {
+    qdr_node_t *rnode;      ///< The remote router with a destination for the address
+    int         conn_bit;   ///< Mask bit of the inter-router connection toward rnode
+    int         cost;       ///< Cost to reach rnode
+} qdr_forward_candidate_t;
+
+//
+// Address state that a typical mobile address never uses, split out of qdr_address_t so that routers with very many
+// addresses stay compact.  Allocated on first use by qdr_address_ext_CT(); readers must allow for addr->ext being null.
+//
+//
+// Forwarding latency histograms of an address configured with latencyTracking.  Deliveries to the address hold a
+// reference so that the histograms stay valid if the address is deleted while deliveries are in flight.  Core thread
+// only, except that the histograms are updated from any thread.
+//
+typedef struct qdr_address_latency_t {
+    qd_metric_t *egress;     ///< usec from ingress until an out-delivery is completely sent
+    qd_metric_t *settle;     ///< usec from ingress until an out-delivery is settled by its receiver
+    uint32_t     ref_count;
+} qdr_address_latency_t;
+
+qdr_address_latency_t *qdr_address_latency_CT(qdr_address_t *addr);
+void qdr_address_latency_decref_CT(qdr_address_latency_t *latency);
+
+typedef struct qdr_address_ext_t {
+    qdrc_endpoint_desc_t      *core_endpoint; ///< [ref] Set if this address is bound to an in-core endpoint
+    void                      *core_endpoint_context;
+    qdr_link_t_sp              edge_inlink_sp[QD_EDGE_MAX_UPLINKS];  ///< [ref] In-link safe ptrs from connected Interior routers, by uplink (on edge router)
+    qdr_link_t_sp              edge_outlink_sp[QD_EDGE_MAX_UPLINKS]; ///< [ref] Out-link safe ptrs to connected Interior routers, by uplink (on edge router)
+    qdr_address_watch_list_t   watches;
+    uint64_t                   deliveries_egress_route_container;
+    uint64_t                   deliveries_ingress_route_container;
+    uint64_t                   deliveries_redirected;
+    uint64_t                   deliveries_expired;
+    qdr_address_latency_t     *latency;        ///< [ref] Set once a delivery is forwarded if latency tracking is on
+    qd_bitmask_t             **multicast_branches; ///< [own] Next-hop conn mask bits of multicast copies, by origin mask bit
+    qd_bitmask_t              *multicast_origins;  ///< [own] Origin mask bits whose multicast_branches are current
+    qdr_connection_t          *pool_conn;      ///< Set if this dynamic address returns to the pool of this connection
+    qdr_address_t             *pool_prev;      ///< Addresses adopted by pool_conn, see qdr_connection_t.dynamic_addr_adopted
+    qdr_address_t             *pool_next;
+    char                      *pool_address;   ///< [own] The generated address, given to the terminus again on reuse
+    qd_direction_t             pool_dir;
+} qdr_address_ext_t;
+
+ALLOC_DECLARE(qdr_address_ext_t);
+
+//
+// Fields are grouped to avoid padding, keep it that way when adding one: qdr_address_t is allocated per address and
+// the per-address footprint is checked by the cpp_unit tests.
+//
 struct qdr_address_t {
     DEQ_LINKS(qdr_address_t);
     qdr_address_config_t      *config;
@@ -548,50 +690,46 @@ struct qdr_address_t {
     qdr_link_ref_list_t        inlinks;       ///< Locally-Connected Producers
     qd_bitmask_t              *rnodes;        ///< Bitmask of remote routers with connected consumers
     qd_hash_handle_t          *hash_handle;   ///< Linkage back to the hash table entry
-    qdrc_endpoint_desc_t      *core_endpoint; ///< [ref] Set if this address is bound to an in-core endpoint
-    void                      *core_endpoint_context;
-    qdr_link_t_sp              edge_inlink_sp;  ///< [ref] In-link safe ptr from connected Interior router (on edge router)
-    qdr_link_t_sp              edge_outlink_sp; ///< [ref] Out-link safe ptr to connected Interior router (on edge router)
-    qd_address_treatment_t     treatment;
     qdr_forwarder_t           *forwarder;
-    qdr_address_watch_list_t   watches;
+    qdr_address_ext_t         *ext;           ///< Rarely used state, see qdr_address_ext_CT()
+    qd_address_treatment_t     treatment;
     int                        ref_count;     ///< Number of entities referencing this address
     int                        proxy_rlink_count;
     int                        proxy_inlink_count;
+    uint32_t                   tracked_deliveries;
+    int                        priority;
+    uint64_t                   cost_epoch;
     bool                       local;
     bool                       router_control_only; ///< If set, address is only for deliveries arriving on a control link
     bool                       propagate_local;     ///< If set, propagate to the network even if there are only local subscriptions
-    uint32_t                   tracked_deliveries;
-    uint64_t                   cost_epoch;
 
     //
     // State for mobile-address synchronization
     //
-    DEQ_LINKS_N(SYNC, qdr_address_t);                          ///< Links for storage in lists for synchronization
-    uint32_t      sync_mask;                                   ///< Mask of bits used to store synchronization-related state
-    char          destination_mesh_id[QD_DISCRIMINATOR_BYTES]; ///< Mesh-id of edge destination if there is a sole-destination-mesh
     bool          local_sole_destination_mesh;                 ///< If set, the only local destinations for this address are on the same mesh
                                                                ///  This is used to drive the state sent via MAU to other routers
     bool          remote_sole_destination_mesh;                ///< If set, the only destinations for this address are on the same mesh
+    char          destination_mesh_id[QD_DISCRIMINATOR_BYTES]; ///< Mesh-id of edge destination if there is a sole-destination-mesh
+    uint32_t      sync_mask;                                   ///< Mask of bits used to store synchronization-related state
+    DEQ_LINKS_N(SYNC, qdr_address_t);                          ///< Links for storage in lists for synchronization
+    uint64_t      sync_key_hash;                               ///< Cached digest hash of the hash key (see mobile_sync)
     char         *remote_sole_destination_meshes;              ///< Per-remote sole-destination-mesh identities used to compute the global flag
 
     //
-    // State for "closest" treatment
+    // Forwarding candidates for "closest" and "balanced" treatment: the reachable routers
+    // in rnodes, ordered by cost.  Rebuilt when cost_epoch no longer matches the core's.
     //
-    qd_bitmask_t *closest_remotes;
-    int           next_remote;
+    qdr_forward_candidate_t *remote_candidates;
+    int                      remote_candidate_count;
+    int                      remote_candidate_capacity;
+    int                      closest_count;  ///< Number of leading candidates that share the lowest cost
+    int                      next_remote;    ///< Round-robin index into the closest candidates
 
     //
     // State for "balanced" treatment, indexed by inter-router connection mask bit
     //
     int *outstanding_deliveries;
 
-    //
-    // State for "link balanced" treatment
-    //
-    char *add_prefix;
-    char *del_prefix;
-
     /**@name Statistics */
     ///@{
     uint64_t deliveries_ingress;
@@ -599,18 +737,16 @@ struct qdr_address_t {
     uint64_t deliveries_transit;
     uint64_t deliveries_to_container;
     uint64_t deliveries_from_container;
-    uint64_t deliveries_egress_route_container;
-    uint64_t deliveries_ingress_route_container;
-    uint64_t deliveries_redirected;
 
     ///@}
-
-    int priority;
 };
 
 DEQ_DECLARE(qdr_address_t, qdr_address_list_t);
 
 qdr_address_t *qdr_address_CT(qdr_core_t *core, qd_address_treatment_t treatment, qdr_address_config_t *config);
+qdr_address_ext_t *qdr_address_ext_CT(qdr_address_t *addr);
+static inline size_t qdr_address_watch_count(const qdr_address_t *addr) { return addr->ext ? DEQ_SIZE(addr->ext->watches) : 0; }
+static inline qdrc_endpoint_desc_t *qdr_address_core_endpoint(const qdr_address_t *addr) { return addr->ext ? addr->ext->core_endpoint : 0; }
 qdr_address_t *qdr_add_local_address_CT(qdr_core_t *core, char aclass, const char *addr, qd_address_treatment_t treatment);
 qdr_address_t *qdr_add_mobile_address_CT(qdr_core_t *core, const char* prefix, const char *addr, qd_address_treatment_t treatment, bool edge);
 void qdr_core_remove_address(qdr_core_t *core, qdr_address_t *addr);
@@ -627,6 +763,8 @@ struct qdr_address_config_t {
     bool                    is_prefix;
     qd_address_treatment_t  treatment;
     int                     priority;
+    bool                    latency_tracking;  ///< Record forwarding latency histograms for matching addresses
+    char                   *affinity_key;      ///< Application property holding the key of affinity distribution
     qd_hash_handle_t       *hash_handle;
 };
 
@@ -687,6 +825,15 @@ struct qdr_connection_t {
     qdr_core_t                 *core;
     bool                        incoming;
     bool                        in_activate_list;
+    sys_atomic_t                activation_pending;  // activated, qdr_connection_process() not yet called
+    atomic_uint_least64_t       cpu_ns;  // I/O and core handler time attributed to the connection
+    struct {
+        atomic_uint_least64_t   plain_sent;
+        atomic_uint_least64_t   wire_sent;
+        atomic_uint_least64_t   wire_received;
+        atomic_uint_least64_t   plain_received;
+        atomic_uint_least64_t   nsec;
+    }                           compression;  // see qdr_compression_stats_t
     bool                        closed; // This bit is used in the case where a client is trying to force close this connection.
     uint8_t                     next_pri;  // for incoming inter-router data links
     qdr_connection_role_t       role;
@@ -696,17 +843,22 @@ struct qdr_connection_t {
     bool                        strip_annotations_out;
     bool                        enable_protocol_trace; // Has trace level logging been turned on for this connection.
     bool                        has_streaming_links;   ///< one or more of this connection's links are for streaming messages
+    bool                        edge_uplink;           ///< Edge routers only - an additional active edge connection (edgeUplinks > 1)
     int                         inter_router_cost;
     int                         link_capacity;
     int                         mask_bit;  ///< set only if inter-router control connection
     int                         group_parent_mask_bit;  ///< if inter-router data connection maskbit of group parent inter-router control conn
-    qdr_connection_work_list_t  work_list;
+    sys_atomic_ptr_t            work_stack;  ///< Pending qdr_connection_work_t, newest first, see qdr_connection_work_take()
     sys_mutex_t                 work_lock;
     qdr_link_ref_list_t         links;
     qdr_link_ref_list_t         links_with_work[QDR_N_PRIORITIES];
+    int                         lane_deficit[QDR_N_PRIORITIES];  ///< Deficit round-robin credit per priority lane (IO thread only)
+    atomic_uint_least64_t       budget_exhausted;  ///< qdr_connection_process() calls that left work for a later call
+    qdr_priority_lane_stats_t   lane_stats[QDR_N_PRIORITIES];    ///< Outgoing delivery stats per priority lane, use work_lock
     qdr_connection_info_t      *connection_info;
     void                       *user_context; /* Updated from IO thread, use work_lock */
     qdr_link_t                 *control_links[2];  // QD_LINK_CONTROL links [QD_INCOMING/QD_OUTGOING] (inter-router conn only)
+    bool                        link_lost_posted;   // the routing agent was told the control link is lost (inter-router conn only)
     qdr_priority_sheaf_t        data_links;  // links for non-streaming messages (by priority)  (inter-router conn only)
     qd_conn_oper_status_t       oper_status;
     qd_conn_admin_status_t      admin_status;
@@ -714,6 +866,9 @@ struct qdr_connection_t {
     uint32_t                    conn_uptime; // Timestamp which can be used to calculate the number of seconds this connection has been up and running.
     uint32_t                    last_delivery_time; // Timestamp which can be used to calculate the number of seconds since the last delivery arrived on this connection.
     qdr_link_list_t             streaming_link_pool;   ///< pool of links available for streaming messages
+    qdr_address_t             **dynamic_addr_pool;     ///< [ref] Reusable dynamic addresses, see qdr_dynamic_addr_take_CT()
+    int                         dynamic_addr_pool_count[2];  ///< by qd_direction_t
+    qdr_address_t              *dynamic_addr_adopted;  ///< Every address with pool_conn set to this connection, pooled or in use
     const qd_policy_spec_t     *policy_spec;
     qdr_connection_list_t       connection_group;      ///< List of associated connection group members
     qdr_connection_t           *group_cursor;          ///< Pointer to the next group member to use for traffic allocation
@@ -727,16 +882,37 @@ void qdr_core_delete_auto_link (qdr_core_t *core,  qdr_auto_link_t *al);
 typedef void (*qdr_timer_cb_t)(qdr_core_t *core, void* context);
 typedef qdr_address_t * (*qdr_edge_conn_addr_t) (void *context);
 
-typedef struct qdr_core_timer_t {
-    DEQ_LINKS(struct qdr_core_timer_t);
-    qdr_timer_cb_t  handler;
-    void           *context;
-    uint32_t        delta_time_seconds;
-    bool            scheduled;
-} qdr_core_timer_t;
+typedef struct qdr_core_timer_t qdr_core_timer_t;
+typedef struct qdr_stats_publisher_t qdr_stats_publisher_t;
+DEQ_DECLARE(qdr_core_timer_t, qdr_core_timer_list_t);
+
+struct qdr_core_timer_t {
+    DEQ_LINKS(qdr_core_timer_t);
+    qdr_timer_cb_t         handler;
+    void                  *context;
+    uint64_t               expiry;  // wheel tick at which the timer fires
+    qdr_core_timer_list_t *slot;    // wheel slot holding the timer while scheduled
+    bool                   scheduled;
+};
 
 ALLOC_DECLARE(qdr_core_timer_t);
-DEQ_DECLARE(qdr_core_timer_t, qdr_core_timer_list_t);
+
+//
+// Core timers are kept in a hierarchical timing wheel.  Level 0 has one slot
+// per tick (second); each slot of level N spans all of level N-1.  Timers are
+// placed by how far in the future they expire and move down a level when the
+// wheel reaches their slot, so schedule and cancel are O(1) and a tick only
+// visits the slots that come due.  Six levels of 64 slots cover any uint32_t
+// delay.  A zero-filled wheel is a valid empty wheel.
+//
+#define QDR_CORE_TIMER_WHEEL_BITS   6
+#define QDR_CORE_TIMER_WHEEL_SLOTS  (1 << QDR_CORE_TIMER_WHEEL_BITS)
+#define QDR_CORE_TIMER_WHEEL_LEVELS 6
+
+typedef struct qdr_core_timer_wheel_t {
+    uint64_t              tick;  // number of ticks processed
+    qdr_core_timer_list_t slots[QDR_CORE_TIMER_WHEEL_LEVELS][QDR_CORE_TIMER_WHEEL_SLOTS];
+} qdr_core_timer_wheel_t;
 
 
 typedef enum {
@@ -801,6 +977,14 @@ struct qdr_protocol_adaptor_t {
     qdr_delivery_update_t     delivery_update_handler;
     qdr_connection_close_t    conn_close_handler;
     qdr_connection_trace_t    conn_trace_handler;
+
+    //
+    // Connection activation (core thread only)
+    //
+    bool                      coalesce_activations;
+    uint64_t                  activations_requested;   /// connections flagged for activation
+    uint64_t                  activations_suppressed;  /// already pending, activate callback skipped
+    uint64_t                  activations_delivered;   /// activate callback invoked
 };
 
 DEQ_DECLARE(qdr_protocol_adaptor_t, qdr_protocol_adaptor_list_t);
@@ -817,23 +1001,116 @@ struct qdr_edge_peer_t {
 DEQ_DECLARE(qdr_edge_peer_t, qdr_edge_peer_list_t);
 
 
+//
+// Core Action Statistics
+//
+// The core thread accounts for the actions it runs in a small open-addressed
+// table keyed by action handler.  The table is written only by the core thread;
+// see qdr_action_stats_collect_CT() for reading it.  Once QDR_ACTION_STATS_MAX - 1
+// handlers are tracked, further handlers are accounted in the overflow entry.
+//
+#define QDR_ACTION_STATS_SLOTS 128
+
+typedef struct qdr_action_stats_table_t {
+    qdr_action_handler_t     handler[QDR_ACTION_STATS_SLOTS];
+    qdr_action_stats_t       entry[QDR_ACTION_STATS_SLOTS];
+    qdr_action_stats_t       overflow;
+    qdr_action_class_stats_t classes[QDR_ACTION_CLASS_COUNT];
+    int                      in_use;
+    uint64_t                 batches;
+    uint64_t                 depth_max;
+} qdr_action_stats_table_t;
+
+//
+// Overload detection.  A proactor timer samples the core and I/O threads
+// periodically: it enqueues a probe action and takes the time the core needed
+// to run the previous one as the action queue delay, and it takes its own
+// late firing as the I/O event-loop lag.  The router is overloaded once either
+// reaches its configured limit and stays so until both are back under half of
+// their limits.  See qdr_core_overloaded().
+//
+typedef struct qdr_overload_t {
+    qd_timer_t   *timer;
+    uint32_t      queue_delay_limit_ms;    /// 0: the action queue delay is not monitored
+    uint32_t      event_loop_lag_limit_ms; /// 0: the I/O event-loop lag is not monitored
+    uint64_t      due_ns;                  /// Timer only: when the timer should fire next
+    uint64_t      probe_sent_ns;           /// Timer only: when the outstanding probe was enqueued
+    sys_atomic_t  probe_pending;           /// Set by the timer when it enqueues a probe, cleared by the probe
+    sys_atomic_t  queue_delay_ms;          /// Enqueue-to-execute delay of the latest probe
+    sys_atomic_t  overloaded;
+
+    qd_metric_t  *overloaded_gauge;
+    qd_metric_t  *queue_delay_gauge;
+    qd_metric_t  *queue_depth_gauge;
+    qd_metric_t  *event_loop_lag_gauge;
+    qd_metric_t  *refused[QDR_OVERLOAD_REFUSED_COUNT];
+} qdr_overload_t;
+
+/**
+ * Mobile address churn as seen by the mobile_sync module.  A flip is a mobile address gaining its
+ * first or losing its last local destination; flips undone within the same hold-down window are
+ * coalesced and never reach the other routers.
+ */
+typedef struct qdr_heavy_hitters_t qdr_heavy_hitters_t;
+
+typedef struct {
+    uint64_t flips;      /// local-destination transitions of mobile addresses
+    uint64_t coalesced;  /// flips cancelled by an opposite flip before being advertised
+    uint64_t updates;    /// differential MAUs sent
+    uint64_t addresses;  /// address entries carried by those MAUs
+    uint64_t pending;    /// addresses waiting for a later MAU
+} qdr_mobile_sync_stats_t;
+
 struct qdr_core_t {
     qd_dispatch_t     *qd;
+
     sys_thread_t      *thread;
 
-    qdr_action_list_t  action_list_background;  /// Actions processed only when the action_list is empty
-    qdr_action_list_t  action_list;
+    //
+    // Producers push actions onto lock-free LIFO stacks.  The core thread takes a
+    // whole stack with one atomic exchange and reverses it, so actions are run in
+    // the order they were enqueued.  The lock and condition variable are only used
+    // to park the core thread when it is idle: producers look at the sleeping flag
+    // and only pay for a wakeup when the core thread is actually parked.
+    //
+    sys_atomic_ptr_t   action_stack;             /// Pending actions, newest first
+    sys_atomic_ptr_t   action_stack_background;  /// Pending background actions, newest first
+    sys_atomic_ptr_t   action_stack_control;     /// Pending control actions, newest first
+    qdr_action_list_t  action_list_background;   /// Core thread only: background actions taken from the stack
+    uint64_t           background_credit_ns;     /// Core thread only: background run time earned by foreground work
     sys_cond_t         action_cond;
     sys_mutex_t        action_lock;
+    sys_atomic_t       sleeping;
+    sys_atomic_t       batch_depth;              /// Foreground actions in the batch being run, zero when idle
+    qdr_action_stats_table_t action_stats;       /// Core thread only: action run-time accounting
+
     bool               running;
-    bool               sleeping;
+    qd_metric_t       *action_latency[QDR_ACTION_CLASS_COUNT];  /// usec from enqueue to completion of an action
 
     bool disable_867_fix; /// True if the fix for issue #867 is to be disabled
-
-    sys_mutex_t              work_lock;
-    qdr_core_timer_list_t    scheduled_timers;
-    qdr_general_work_list_t  work_list;
-    qd_timer_t              *work_timer;
+    bool latency_aware_balancing; /// True if balanced addresses pick destinations by estimated completion time
+    int  streaming_link_pool_min; /// Idle streaming links kept attached on each connection that carries streams
+    int  dynamic_addr_pool_size;  /// Detached dynamic addresses each connection keeps for reuse, per direction
+    qdr_link_list_t   idle_streaming_links;       /// The links of all streaming pools, longest idle first
+    qdr_core_timer_t *streaming_link_idle_timer;  /// Set by the streaming link scrubber, fires when the head link expires
+    uint32_t          streaming_link_idle_timeout; /// Seconds a pooled streaming link may stay idle
+    int  edge_uplinks;            /// Edge connections to interior routers an edge router keeps active at once
+    bool enforce_message_ttl;     /// True if messages are dropped once their header ttl has run out
+    size_t transfer_quantum_octets; /// Messages larger than this go on streaming links so they are interleaved, 0: off
+    uint64_t busy_poll_ns;          /// An idle core thread polls its action stacks this long before parking, 0: spin briefly
+    bool             push_batching;      /// Deliveries pushed are staged in push_batch, see qdr_delivery_push_batch_begin_CT()
+    qdr_delivery_t **push_batch;         /// Staged deliveries, each holding a reference
+    size_t           push_batch_count;
+    size_t           push_batch_capacity;
+    qdr_overload_t overload;        /// New client connections and links are refused while the core is overloaded
+    int  priority_lane_quantum[QDR_N_PRIORITIES]; /// Deliveries per pass granted to each priority lane of a connection
+    qdr_priority_lane_stats_t closed_lane_stats[QDR_N_PRIORITIES]; /// Lane statistics of connections already freed
+    qdr_mobile_sync_stats_t   mobile_sync_stats;                   /// Maintained by the mobile_sync module
+    qdr_heavy_hitters_t      *heavy_hitters;                       /// Owned by the heavy_hitters module, 0 if disabled
+
+    qdr_core_timer_wheel_t   timer_wheel;
+    qdr_general_work_shard_t work_shards[QDR_GENERAL_WORK_SHARDS];
+    atomic_uint              work_next_shard;  /// Round robin over the shards for unordered work
     sys_atomic_t             uptime_ticks;
 
     qdr_protocol_adaptor_list_t  protocol_adaptors;
@@ -841,6 +1118,7 @@ struct qdr_core_t {
     qdr_connection_t            *active_edge_connection;
     qdr_connection_list_t        connections_to_activate;
     qdr_link_list_t              open_links;
+    qdr_link_list_t              links_by_delivery_age;  ///< Links holding deliveries, oldest delivery_age_ticks first
     qdr_connection_ref_list_t    streaming_connections;
     qdr_edge_peer_list_t         edge_peers;
     char                         edge_mesh_identifier[QD_DISCRIMINATOR_BYTES + 1];
@@ -881,12 +1159,20 @@ struct qdr_core_t {
     qdr_address_list_t         addrs;
     qd_hash_t                 *addr_hash;
     qdr_address_watch_list_t   addr_watches;
+    qdr_address_watch_list_t   addr_watches_dirty;         // Watches with an update not yet delivered
+    qdr_core_timer_t          *addr_watch_timer;
+    bool                       addr_watch_flush_scheduled;
+    uint32_t                   addr_watch_last_flush;      // Uptime tick of the last delivery
+    qdr_core_timer_t          *memory_timer;               // Polls for the release of held link credit
+    int                        credit_held_links;          // Links whose initial credit is held for memory
+    qdr_stats_publisher_t     *stats_publisher;            // Set when the statistics are published, see stats_snapshot.c
     qd_parse_tree_t           *addr_parse_tree;
     qdr_address_t             *hello_addr;
     qdr_address_t             *router_addr_L;
     qdr_address_t             *routerma_addr_L;
     qdr_address_t             *router_addr_T;
     qdr_address_t             *routerma_addr_T;
+    qdr_address_t             *routerlv_addr_L;  ///< neighbor liveness keepalives, see modules/neighbor_liveness
 
     qdr_node_list_t         routers;                          ///< List of routers, in order of cost, from lowest to highest
     qd_bitmask_t           *neighbor_free_mask;               ///< bits available for new conns (qd_connection_t->mask_bit values)
@@ -895,14 +1181,14 @@ struct qdr_core_t {
     qdr_connection_t      **pending_rnode_conns_by_mask_bit;  ///< higher precedence inter-router conns pending upgrade [conn->mask_bit]
     qdr_connection_list_t   unallocated_group_members;        ///< List of unallocated group members (i.e. before the group is given a maskbit)
     char                  **group_correlator_by_maskbit;      ///< Group correlator number indexed by conn->maskbit
-    uint64_t                cost_epoch;
+    uint64_t                cost_epoch;                       ///< Bumped on any change to router costs, next-hops or links
 
     uint64_t              next_tag;
 
-    uint64_t              next_identifier;
-    sys_mutex_t           id_lock;
+    atomic_uint_least64_t next_identifier;
 
-    qdr_forwarder_t      *forwarders[QD_TREATMENT_UNAVAILABLE];
+    qdr_forwarder_t      *forwarders[QD_TREATMENT_ANYCAST_AFFINITY + 1];  ///< none for QD_TREATMENT_UNAVAILABLE
+    uint32_t              router_id_hash;  ///< weight seed of this router for affinity distribution
 
     qdr_delivery_cleanup_list_t  delivery_cleanup_list;  ///< List of delivery cleanup items to be processed in an IO thread
 
@@ -944,22 +1230,155 @@ struct qdr_terminus_t {
 ALLOC_DECLARE(qdr_terminus_t);
 
 void *router_core_thread(void *arg);
+
+/**
+ * Atomically take all actions from an action stack and append them to list in the order they were pushed.
+ */
+void qdr_action_stack_take(sys_atomic_ptr_t *stack, qdr_action_list_t *list);
+
+/**
+ * Monotonic clock in nanoseconds, used for action and delivery timing.
+ */
+static inline uint64_t qdr_core_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Deliveries per unit of priorityLaneWeights that a priority lane may push in one pass over a connection.
+ */
+#define QDR_PRIORITY_LANE_QUANTUM 4
+
+/**
+ * Work items, disposition updates and deliveries that one qdr_connection_process() call may handle before it yields the
+ * I/O thread, see qdr_connection_t.budget_exhausted.  Above the sum of the default priority lane quanta.
+ */
+#define QDR_CONNECTION_PROCESS_BUDGET 1024
+
+/**
+ * Smallest number of deliveries a link may push in one qdr_connection_process() call when the budget is shared among
+ * the links with work.
+ */
+#define QDR_LINK_PROCESS_MIN_QUANTUM 8
+
+/**
+ * Add the per-priority lane statistics in src into dst.
+ */
+static inline void qdr_priority_lane_stats_merge(qdr_priority_lane_stats_t *dst, const qdr_priority_lane_stats_t *src)
+{
+    for (int priority = 0; priority < QDR_N_PRIORITIES; priority++) {
+        dst[priority].deliveries           += src[priority].deliveries;
+        dst[priority].queue_delay_total_ns += src[priority].queue_delay_total_ns;
+        dst[priority].queue_delay_max_ns    = MAX(dst[priority].queue_delay_max_ns, src[priority].queue_delay_max_ns);
+    }
+}
+
+/**
+ * Merge the action statistics of all shards into the stats array, combining entries with the same label.  Returns the
+ * number of entries written (at most max).
+ *
+ * Runs on a core thread.  Counters of other shards are read without synchronization and may be slightly stale.
+ */
+size_t qdr_action_stats_collect_CT(qdr_core_t *core, qdr_action_stats_t *stats, size_t max);
+
+/**
+ * Copy the global statistics of the core into stats.
+ */
+void qdr_global_stats_copy_CT(qdr_core_t *core, qdr_global_stats_t *stats);
+
+/**
+ * Start publishing the statistics every statsPublishSeconds (nothing when it is zero), stop publishing them.
+ */
+void qdr_stats_publish_setup_CT(qdr_core_t *core);
+void qdr_stats_publish_final_CT(qdr_core_t *core);
+
+/**
+ * Copy the last published global statistics into stats. Returns false if none were published yet or the statistics
+ * are not published, the caller then requests them from the core thread. May be called from any thread.
+ */
+bool qdr_global_stats_read_published(qdr_core_t *core, qdr_global_stats_t *stats);
+
 uint64_t qdr_identifier(qdr_core_t* core);
 uint64_t qdr_management_agent_on_message(void *context, qd_message_t *msg, int link_id, int cost,
                                          uint64_t in_conn_id, const qd_policy_spec_t *policy_spec, qdr_error_t **error);
 void  qdr_route_table_setup_CT(qdr_core_t *core);
 qdr_agent_t *qdr_agent(qdr_core_t *core);
+void qdr_overload_setup(qdr_core_t *core);
+void qdr_overload_final(qdr_core_t *core);
+
+/**
+ * Count a delivery of a client link forwarded to addr in the heavy hitter sketches, see
+ * modules/heavy_hitters/heavy_hitters.c.  Called only while core->heavy_hitters is set.
+ *
+ * @param conn Connection the delivery arrived on
+ * @param octets Content of the message buffered when it was forwarded
+ */
+void qdr_heavy_hitters_record_CT(qdr_heavy_hitters_t *hh, qdr_address_t *addr, qdr_connection_t *conn,
+                                 uint64_t octets);
+void qdr_heavy_hitters_forget_address_CT(qdr_heavy_hitters_t *hh, qdr_address_t *addr);
+
+/**
+ * Compose the top heavy hitters of the last completed window as a map, an empty map if hh is 0.
+ */
+void qdr_heavy_hitters_write_CT(const qdr_heavy_hitters_t *hh, qd_composed_field_t *body);
 void qdr_agent_setup_subscriptions(qdr_agent_t *agent, qdr_core_t *core);
 void qdr_agent_free(qdr_agent_t *agent);
 void  qdr_forwarder_setup_CT(qdr_core_t *core);
 qdr_action_t *qdr_action(qdr_action_handler_t action_handler, const char *label);
 void qdr_action_enqueue(qdr_core_t *core, qdr_action_t *action);
 void qdr_action_background_enqueue(qdr_core_t *core, qdr_action_t *action);
+void qdr_action_control_enqueue(qdr_core_t *core, qdr_action_t *action);
+
+/**
+ * Attribute the run time of the action being executed to a connection (see qdr_connection_add_cpu_time).  The last
+ * connection charged by an action handler is the one charged.  A connection must be uncharged before it is freed.
+ */
+void qdr_action_charge_CT(qdr_connection_t *conn);
+void qdr_action_uncharge_CT(qdr_connection_t *conn);
 void qdr_link_issue_credit_CT(qdr_core_t *core, qdr_link_t *link, int credit, bool drain);
+void qdr_link_issue_initial_credit_CT(qdr_core_t *core, qdr_link_t *link);
+void qdr_link_release_held_credit_CT(qdr_core_t *core, qdr_link_t *link);
 void qdr_drain_inbound_undelivered_CT(qdr_core_t *core, qdr_link_t *link, qdr_address_t *addr);
 void qdr_addr_start_inlinks_CT(qdr_core_t *core, qdr_address_t *addr);
+void qdr_addr_stop_inlinks_CT(qdr_core_t *core, qdr_address_t *addr);
 static inline bool qdr_link_is_streaming_deliveries(qdr_link_t *link) { return IS_ATOMIC_FLAG_SET(&link->streaming_deliveries); }
 
+/**
+ * The capacity of an outgoing endpoint link adapts to its consumer, within a factor of QDR_LINK_CAPACITY_RANGE of the
+ * connection's link capacity: it grows by one when a delivery settles while the consumer has taken everything queued
+ * for it and the link was at capacity, and shrinks by one for each delivery queued while undeliveredCount is at
+ * capacity.  A fast consumer is given more outstanding deliveries and a slow one holds less router buffering.
+ */
+#define QDR_LINK_CAPACITY_RANGE 4
+
+static inline bool qdr_link_capacity_adapts(const qdr_link_t *link)
+{
+    return link->link_direction == QD_OUTGOING && link->link_type == QD_LINK_ENDPOINT && !!link->conn;
+}
+
+static inline void qdr_link_capacity_grow_CT(qdr_link_t *link)
+{
+    if (link->capacity < link->conn->link_capacity * QDR_LINK_CAPACITY_RANGE)
+        link->capacity++;
+}
+
+static inline void qdr_link_capacity_shrink_CT(qdr_link_t *link)
+{
+    if (link->capacity > MAX(link->conn->link_capacity / QDR_LINK_CAPACITY_RANGE, 1))
+        link->capacity--;
+}
+
+/**
+ * The undelivered count at which pre-settled deliveries queued on the link are dropped.  It does not follow the
+ * adaptive capacity, which would drop more for a consumer that falls behind.
+ */
+static inline int qdr_link_drop_threshold(const qdr_link_t *link)
+{
+    return qdr_link_capacity_adapts(link) ? link->conn->link_capacity : link->capacity;
+}
+
 /**
  * Returns true if the passed in address is a mobile address, false otherwise
  * If the first character of the address_key (obtained using its hash_handle) is M, the address is mobile.
@@ -976,14 +1395,47 @@ void qdr_post_link_lost_CT(qdr_core_t *core, int link_maskbit);
 
 void qdr_post_general_work_CT(qdr_core_t *core, qdr_general_work_t *work);
 void qdr_check_addr_CT(qdr_core_t *core, qdr_address_t *addr);
+
+/**
+ * Reusable dynamic addresses (dynamicAddressPoolSize).
+ *
+ * qdr_dynamic_addr_adopt_CT() marks a newly generated dynamic address as reusable by the connection it was generated
+ * for.  When the last link using it detaches, qdr_dynamic_addr_detached_CT() returns it to the pool of the connection,
+ * holding a reference, or releases it if the pool is full.  qdr_dynamic_addr_take_CT() hands a pooled address out
+ * again for a dynamic terminus in the same direction and sets the terminus address.  qdr_dynamic_addr_pool_free_CT()
+ * releases the pool when the connection closes, along with every other address the connection adopted: one still
+ * used by the links of other connections does not keep a pointer to the closed connection.
+ * qdr_dynamic_addr_forget_CT() unlinks an adopted address that is being freed.  QDRC_EVENT_ADDR_POOL_RELEASED is
+ * raised for an address that stops being reusable, so the withdrawal of its edge proxies can be deferred until then.
+ */
+bool qdr_address_reusable_CT(const qdr_address_t *addr);
+void qdr_dynamic_addr_adopt_CT(qdr_core_t *core, qdr_connection_t *conn, qd_direction_t dir, qdr_address_t *addr,
+                               const char *address);
+qdr_address_t *qdr_dynamic_addr_take_CT(qdr_core_t *core, qdr_connection_t *conn, qd_direction_t dir,
+                                        qdr_terminus_t *terminus);
+void qdr_dynamic_addr_detached_CT(qdr_core_t *core, qdr_address_t *addr);
+void qdr_dynamic_addr_pool_free_CT(qdr_core_t *core, qdr_connection_t *conn);
+void qdr_dynamic_addr_forget_CT(qdr_address_t *addr);
 void qdr_process_addr_attributes_CT(qdr_core_t *core, qdr_address_t *addr);
 bool qdr_is_addr_treatment_multicast(qdr_address_t *addr);
 qdr_delivery_t *qdr_forward_new_delivery_CT(qdr_core_t *core, qdr_delivery_t *peer, qdr_link_t *link, qd_message_t *msg);
 void qdr_forward_deliver_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery_t *dlv);
+void qdr_forward_free_multicast_branches_CT(qdr_address_t *addr);
 void qdr_connection_free(qdr_connection_t *conn);
 void qdr_connection_activate_CT(qdr_core_t *core, qdr_connection_t *conn);
 void qdr_close_connection_CT(qdr_core_t *core, qdr_connection_t *conn);
 qdr_link_t *qdr_connection_new_streaming_link_CT(qdr_core_t *core, qdr_connection_t *conn);
+void qdr_connection_warm_streaming_pool_CT(qdr_core_t *core, qdr_connection_t *conn);
+
+/**
+ * Put a streaming link in, or take it out of, its connection's pool of idle streaming links.  Pooled links are also
+ * kept in core->idle_streaming_links in the order they became idle, and the streaming link scrubber's timer is
+ * scheduled for the head of that list, so idle links are reclaimed when they expire without scanning the pools.  A
+ * link that expires while its pool needs it leaves that list for good: a pool only grows above its limit by links
+ * inserted later, which are in the list.
+ */
+void qdr_link_streaming_pool_insert_CT(qdr_core_t *core, qdr_link_t *link);
+void qdr_link_streaming_pool_remove_CT(qdr_core_t *core, qdr_link_t *link);
 qdr_address_config_t *qdr_config_for_address_CT(qdr_core_t *core, qdr_connection_t *conn, qd_iterator_t *iter);
 qd_address_treatment_t qdr_treatment_for_address_hash_CT(qdr_core_t *core, qd_iterator_t *iter, qdr_address_config_t **addr_config);
 qd_address_treatment_t qdr_treatment_for_address_hash_with_default_CT(qdr_core_t *core, qd_iterator_t *iter, qd_address_treatment_t default_treatment, qdr_address_config_t **addr_config);
@@ -1078,6 +1530,16 @@ void qdr_reset_sheaf(qdr_connection_t *conn);
  */
 void qdr_record_link_credit(qdr_core_t *core, qdr_link_t *link);
 
+/**
+ * Maintain core->links_by_delivery_age, the index the stuck delivery detection walks instead of every link.  A link
+ * joins the index at its delivery_age_ticks when the core queues a delivery on it and moves to the tail when it settles
+ * a delivery, so the index stays ordered by the time the link last made progress.  Links found without deliveries are
+ * dropped from the index by the detection.
+ */
+void qdr_link_delivery_queued_CT(qdr_core_t *core, qdr_link_t *link);
+void qdr_link_delivery_progress_CT(qdr_core_t *core, qdr_link_t *link);
+void qdr_link_delivery_age_remove_CT(qdr_core_t *core, qdr_link_t *link);
+
 /**
  * Access core uptime
  */
@@ -20,8 +20,11 @@
 #include "module.h"
 #include "router_core_private.h"
 
+#include "qpid/dispatch/flight_recorder.h"
 #include "qpid/dispatch/protocol_adaptor.h"
 
+#include <sched.h>
+
 /**
  * Creates a thread that is dedicated to managing and using the routing table.
  * The purpose of moving this function into one thread is to remove the widespread
@@ -32,6 +35,26 @@
 
 ALLOC_DEFINE(qdr_action_t);
 
+//
+// Number of times an idle core thread polls its action stacks before parking
+//
+#define QDR_CORE_SPIN_COUNT 64
+
+//
+// Background scheduling
+//
+// Background actions earn run time in proportion to the foreground work done
+// (QDR_BACKGROUND_SHARE percent of core time under load), so they are never
+// starved.  No single pass runs background actions for longer than
+// QDR_BACKGROUND_PASS_BUDGET_NS, so they cannot cause long foreground stalls
+// either, even when the core is otherwise idle.  A background action that has
+// waited longer than QDR_BACKGROUND_DEADLINE_NS runs in the next pass even if
+// no credit is available.
+//
+#define QDR_BACKGROUND_SHARE          10
+#define QDR_BACKGROUND_PASS_BUDGET_NS (2 * 1000 * 1000)
+#define QDR_BACKGROUND_DEADLINE_NS    (100 * 1000 * 1000)
+
 
 typedef struct qdrc_module_t {
     DEQ_LINKS(struct qdrc_module_t);
@@ -95,9 +118,17 @@ static void qdr_activate_connections_CT(qdr_core_t *core)
 {
     qdr_connection_t *conn = DEQ_HEAD(core->connections_to_activate);
     while (conn) {
+        qdr_protocol_adaptor_t *adaptor = conn->protocol_adaptor;
         DEQ_REMOVE_HEAD_N(ACTIVATE, core->connections_to_activate);
         conn->in_activate_list = false;
-        conn->protocol_adaptor->activate_handler(conn->protocol_adaptor->user_context, conn);
+        adaptor->activations_requested++;
+        if (adaptor->coalesce_activations && SET_ATOMIC_FLAG(&conn->activation_pending)) {
+            // the adaptor has not yet processed the previous activation, which will pick up the new work
+            adaptor->activations_suppressed++;
+        } else {
+            adaptor->activations_delivered++;
+            adaptor->activate_handler(adaptor->user_context, conn);
+        }
         conn = DEQ_HEAD(core->connections_to_activate);
     }
 }
@@ -187,72 +218,303 @@ void qdr_adaptors_finalize(qdr_core_t *core)
 }
 
 
+static inline int qdr_action_histogram_bucket(uint64_t elapsed_ns)
+{
+    uint64_t usec = elapsed_ns / 1000;
+    if (usec == 0)
+        return 0;
+    int bucket = 64 - __builtin_clzll(usec);  // smallest N with usec < 2^N
+    return bucket < QDR_ACTION_HISTOGRAM_BUCKETS ? bucket : QDR_ACTION_HISTOGRAM_BUCKETS - 1;
+}
+
+
+static qdr_action_stats_t *qdr_action_stats_entry(qdr_action_stats_table_t *table, const qdr_action_t *action)
+{
+    uintptr_t key  = (uintptr_t) action->action_handler;
+    int       slot = (int) ((key >> 4) ^ (key >> 12)) & (QDR_ACTION_STATS_SLOTS - 1);
+
+    while (table->handler[slot]) {
+        if (table->handler[slot] == action->action_handler)
+            return &table->entry[slot];
+        slot = (slot + 1) & (QDR_ACTION_STATS_SLOTS - 1);
+    }
+
+    if (table->in_use == QDR_ACTION_STATS_MAX - 1) {
+        table->overflow.label = "other";
+        return &table->overflow;
+    }
+
+    table->in_use++;
+    table->handler[slot]     = action->action_handler;
+    table->entry[slot].label = action->label ? action->label : "unlabeled";
+    return &table->entry[slot];
+}
+
+
+//
+// Connection charged for the action being executed by this thread
+//
+static __thread qdr_connection_t *charged_conn;
+
+void qdr_action_charge_CT(qdr_connection_t *conn)
+{
+    charged_conn = conn;
+}
+
+
+void qdr_action_uncharge_CT(qdr_connection_t *conn)
+{
+    if (charged_conn == conn)
+        charged_conn = 0;
+}
+
+
+/**
+ * Account for one action run by the core thread.  started_ns is when the handler was called.  Returns the current
+ * time so back-to-back actions need only one clock read each.
+ */
+static uint64_t qdr_action_stats_record(qdr_core_t *core, const qdr_action_t *action, qdr_action_class_t cls,
+                                        uint64_t started_ns)
+{
+    uint64_t                  now   = qdr_core_now_ns();
+    uint64_t                  run   = now - started_ns;
+    uint64_t                  delay = started_ns > action->enqueued_ns ? started_ns - action->enqueued_ns : 0;
+    qdr_action_stats_t       *entry = qdr_action_stats_entry(&core->action_stats, action);
+    qdr_action_class_stats_t *class = &core->action_stats.classes[cls];
+
+    class->count++;
+    class->wait_total_ns += delay;
+    if (delay > class->wait_max_ns)
+        class->wait_max_ns = delay;
+
+    entry->count++;
+    entry->total_ns             += run;
+    entry->queue_delay_total_ns += delay;
+    if (run > entry->max_ns)
+        entry->max_ns = run;
+    if (delay > entry->queue_delay_max_ns)
+        entry->queue_delay_max_ns = delay;
+    entry->histogram[qdr_action_histogram_bucket(run)]++;
+    qd_metric_observe(core->action_latency[cls], (delay + run) / 1000);
+    qd_flight_record_at(now, QD_FLIGHT_ACTION, (uintptr_t) action->label, run, (uint32_t) MIN(delay / 1000, UINT32_MAX));
+    if (charged_conn) {
+        qdr_connection_add_cpu_time(charged_conn, run);
+        charged_conn = 0;
+    }
+    return now;
+}
+
+
+static void qdr_action_stats_merge(qdr_action_stats_t *to, const qdr_action_stats_t *from)
+{
+    to->count                += from->count;
+    to->total_ns             += from->total_ns;
+    to->queue_delay_total_ns += from->queue_delay_total_ns;
+    if (from->max_ns > to->max_ns)
+        to->max_ns = from->max_ns;
+    if (from->queue_delay_max_ns > to->queue_delay_max_ns)
+        to->queue_delay_max_ns = from->queue_delay_max_ns;
+    for (int i = 0; i < QDR_ACTION_HISTOGRAM_BUCKETS; i++)
+        to->histogram[i] += from->histogram[i];
+}
+
+
+static size_t qdr_action_stats_add(qdr_action_stats_t *stats, size_t count, size_t max, const qdr_action_stats_t *from)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(stats[i].label, from->label) == 0) {
+            qdr_action_stats_merge(&stats[i], from);
+            return count;
+        }
+    }
+    if (count == max)
+        return count;
+    ZERO(&stats[count]);
+    stats[count].label = from->label;
+    qdr_action_stats_merge(&stats[count], from);
+    return count + 1;
+}
+
+
+size_t qdr_action_stats_collect_CT(qdr_core_t *core, qdr_action_stats_t *stats, size_t max)
+{
+    size_t count = 0;
+
+    qdr_action_stats_table_t *table = &core->action_stats;
+    for (int slot = 0; slot < QDR_ACTION_STATS_SLOTS; slot++) {
+        if (table->handler[slot])
+            count = qdr_action_stats_add(stats, count, max, &table->entry[slot]);
+    }
+    if (table->overflow.count)
+        count = qdr_action_stats_add(stats, count, max, &table->overflow);
+    return count;
+}
+
+
+static inline bool qdr_core_has_actions(qdr_core_t *core)
+{
+    return sys_atomic_ptr_get(&core->action_stack) != 0
+        || sys_atomic_ptr_get(&core->action_stack_control) != 0
+        || sys_atomic_ptr_get(&core->action_stack_background) != 0
+        || !DEQ_IS_EMPTY(core->action_list_background);
+}
+
+
+/**
+ * Wait for new actions to arrive on an idle core.
+ *
+ * The core thread first spins for a short time, yielding the CPU, in case more actions arrive immediately.  In
+ * busy-poll mode it polls without yielding for core->busy_poll_ns instead.  If no action arrives it sets the sleeping
+ * flag and parks on the condition variable until a producer wakes it.
+ */
+static void qdr_core_wait(qdr_core_t *core)
+{
+    if (core->busy_poll_ns) {
+        const uint64_t until = qdr_core_now_ns() + core->busy_poll_ns;
+        do {
+            if (qdr_core_has_actions(core) || !core->running)
+                return;
+        } while (qdr_core_now_ns() < until);
+    }
+
+    for (int spin = 0; spin < QDR_CORE_SPIN_COUNT; spin++) {
+        if (qdr_core_has_actions(core) || !core->running)
+            return;
+        sched_yield();
+    }
+
+    sys_mutex_lock(&core->action_lock);
+    SET_ATOMIC_FLAG(&core->sleeping);
+    while (!qdr_core_has_actions(core) && core->running) {
+        sys_cond_wait(&core->action_cond, &core->action_lock);
+    }
+    CLEAR_ATOMIC_FLAG(&core->sleeping);
+    sys_mutex_unlock(&core->action_lock);
+}
+
+
+/**
+ * Run the control actions enqueued so far, oldest first, starting at time now.  Called ahead of every foreground and
+ * background action so control actions never wait for more than the action being run.  Returns the current time.
+ */
+static uint64_t qdr_core_run_control(qdr_core_t *core, uint64_t now)
+{
+    qdr_action_list_t  control_list = DEQ_EMPTY;
+
+    qdr_action_stack_take(&core->action_stack_control, &control_list);
+    qdr_action_t *action = DEQ_HEAD(control_list);
+    while (action) {
+        DEQ_REMOVE_HEAD(control_list);
+        if (action->label)
+            qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Core control action '%s'%s", action->label,
+                   core->running ? "" : " (discard)");
+        action->action_handler(core, action, !core->running);
+        now = qdr_action_stats_record(core, action, QDR_ACTION_CLASS_CONTROL, now);
+        free_qdr_action_t(action);
+        action = DEQ_HEAD(control_list);
+    }
+    return now;
+}
+
+
+/**
+ * Run background actions, oldest first, starting at time now.  When idle is true there is no foreground work pending
+ * and background actions may use the whole pass budget, stopping early if foreground actions arrive.  Otherwise they
+ * may use only the credit earned by foreground work.  Overdue actions run regardless of credit.  Returns the current
+ * time.
+ */
+static uint64_t qdr_core_run_background(qdr_core_t *core, uint64_t now, bool idle)
+{
+    uint64_t      start  = now;
+    uint64_t      budget = idle ? QDR_BACKGROUND_PASS_BUDGET_NS : MIN(core->background_credit_ns, QDR_BACKGROUND_PASS_BUDGET_NS);
+    qdr_action_t *action = DEQ_HEAD(core->action_list_background);
+
+    while (action) {
+        uint64_t elapsed = now - start;
+        bool     overdue = now - action->enqueued_ns >= QDR_BACKGROUND_DEADLINE_NS;
+
+        if (elapsed >= QDR_BACKGROUND_PASS_BUDGET_NS)
+            break;
+        if (!overdue && (elapsed >= budget || (idle && sys_atomic_ptr_get(&core->action_stack) != 0)))
+            break;
+
+        if (sys_atomic_ptr_get(&core->action_stack_control) != 0)
+            now = qdr_core_run_control(core, now);
+
+        DEQ_REMOVE_HEAD(core->action_list_background);
+        if (action->label)
+            qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Core background action '%s'%s", action->label,
+                   core->running ? "" : " (discard)");
+        action->action_handler(core, action, !core->running);
+        now = qdr_action_stats_record(core, action, QDR_ACTION_CLASS_BACKGROUND, now);
+        free_qdr_action_t(action);
+        action = DEQ_HEAD(core->action_list_background);
+    }
+
+    if (!idle) {
+        uint64_t used = now - start;
+        core->background_credit_ns = used < core->background_credit_ns ? core->background_credit_ns - used : 0;
+    }
+    return now;
+}
+
+
 void *router_core_thread(void *arg)
 {
     qdr_core_t        *core = (qdr_core_t*) arg;
     qdr_action_list_t  action_list = DEQ_EMPTY;
-    qdr_action_t      *bg_action = 0;
 
     qd_log(LOG_ROUTER_CORE, QD_LOG_INFO, "Router Core thread running. %s/%s", core->router_area,
            core->router_id);
     while (core->running) {
-        //
-        // Use the lock only to protect the condition variable and the action lists
-        //
-        sys_mutex_lock(&core->action_lock);
+        qdr_action_stack_take(&core->action_stack, &action_list);
+        if (DEQ_IS_EMPTY(core->action_list_background))
+            qdr_action_stack_take(&core->action_stack_background, &core->action_list_background);
 
-        for (;;) {
-            if (!DEQ_IS_EMPTY(core->action_list)) {
-                DEQ_MOVE(core->action_list, action_list);
-                break;
-            }
+        if (DEQ_IS_EMPTY(action_list) && DEQ_IS_EMPTY(core->action_list_background)
+            && sys_atomic_ptr_get(&core->action_stack_control) == 0) {
+            qdr_core_wait(core);
+            continue;
+        }
 
-            // no pending actions so process one background action if present
-            //
-            bg_action = DEQ_HEAD(core->action_list_background);
-            if (bg_action) {
-                DEQ_REMOVE_HEAD(core->action_list_background);
-                break;
-            }
+        uint64_t now  = qdr_core_run_control(core, qdr_core_now_ns());
+        bool     idle = DEQ_IS_EMPTY(action_list);
 
-            if (!core->running)
-                break;
+        if (!idle) {
+            core->action_stats.batches++;
+            sys_atomic_set(&core->batch_depth, (uint32_t) DEQ_SIZE(action_list));
+            if (DEQ_SIZE(action_list) > core->action_stats.depth_max)
+                core->action_stats.depth_max = DEQ_SIZE(action_list);
 
             //
-            // Block on the condition variable when there is no action to do
+            // Process and free all of the action items in the list
             //
-            core->sleeping = true;
-            sys_cond_wait(&core->action_cond, &core->action_lock);
-            core->sleeping = false;
-        }
-
-        sys_mutex_unlock(&core->action_lock);
+            uint64_t      start  = now;
+            qdr_action_t *action = DEQ_HEAD(action_list);
+            while (action) {
+                if (sys_atomic_ptr_get(&core->action_stack_control) != 0)
+                    now = qdr_core_run_control(core, now);
+
+                DEQ_REMOVE_HEAD(action_list);
+                if (action->label)
+                    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Core action '%s'%s", action->label,
+                           core->running ? "" : " (discard)");
+                action->action_handler(core, action, !core->running);
+                now = qdr_action_stats_record(core, action, QDR_ACTION_CLASS_FOREGROUND, now);
+                free_qdr_action_t(action);
+                action = DEQ_HEAD(action_list);
+            }
 
-        // bg_action is set only when there are no other actions pending
-        //
-        if (bg_action) {
-            if (bg_action->label)
-                qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Core background action '%s'%s", bg_action->label,
-                       core->running ? "" : " (discard)");
-            bg_action->action_handler(core, bg_action, !core->running);
-            free_qdr_action_t(bg_action);
-            bg_action = 0;
-            continue;
+            //
+            // Foreground work earns background credit so background actions get their share under load
+            //
+            core->background_credit_ns += (now - start) * QDR_BACKGROUND_SHARE / (100 - QDR_BACKGROUND_SHARE);
+            core->background_credit_ns = MIN(core->background_credit_ns, QDR_BACKGROUND_PASS_BUDGET_NS);
+            sys_atomic_set(&core->batch_depth, 0);
         }
 
-        //
-        // Process and free all of the action items in the list
-        //
-        qdr_action_t *action = DEQ_HEAD(action_list);
-        while (action) {
-            DEQ_REMOVE_HEAD(action_list);
-            if (action->label)
-                qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "Core action '%s'%s", action->label,
-                       core->running ? "" : " (discard)");
-            action->action_handler(core, action, !core->running);
-            free_qdr_action_t(action);
-            action = DEQ_HEAD(action_list);
-        }
+        if (!DEQ_IS_EMPTY(core->action_list_background))
+            qdr_core_run_background(core, now, idle);
 
         //
         // Activate all connections that were flagged for activation during the above processing
@@ -264,6 +526,7 @@ void *router_core_thread(void *arg)
         //
         if (DEQ_SIZE(core->delivery_cleanup_list) > 0) {
             qdr_general_work_t *work = qdr_general_work(qdr_do_message_to_addr_free);
+            work->affinity = QDR_GENERAL_WORK_UNORDERED;
             DEQ_MOVE(core->delivery_cleanup_list, work->delivery_cleanup_list);
             qdr_post_general_work_CT(core, work);
         }
@@ -0,0 +1,400 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "router_core_private.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Statistics snapshots: see docs/notes/stats-snapshot.md for the encoding.
+//
+// The core thread only copies the counters into a column-major array of integers. Encoding happens in the handler,
+// on a worker thread.
+//
+// With statsPublishSeconds set the core thread also publishes, on a core timer, the global statistics and a snapshot
+// of the connections and of the links. Requests are then answered from the published copies by the requesting thread,
+// without an action: the core thread does no monitoring work beyond the periodic copy however often it is scraped.
+// A published snapshot is immutable and reference counted, a reader takes a reference under the publish lock and the
+// core thread drops its own when it publishes the next one. The global statistics are double-buffered: the core thread
+// fills the buffer readers do not see, then switches the buffers under the lock, readers copy the published buffer
+// under the lock.
+//
+
+#define QDR_STATS_SNAPSHOT_MAGIC   "QDSS"
+#define QDR_STATS_SNAPSHOT_VERSION 1
+
+// Column names are the attribute names of the management entity
+//
+static const char * const connection_columns[] = {
+    "identity",
+    "role",
+    "uptimeSeconds",
+    "lastDlvSeconds",
+    "cpuMicroseconds",
+    "linkCount",
+};
+#define CONNECTION_COLUMN_COUNT (sizeof(connection_columns) / sizeof(connection_columns[0]))
+
+static const char * const link_columns[] = {
+    "identity",
+    "connectionId",
+    "linkDir",
+    "capacity",
+    "undeliveredCount",
+    "unsettledCount",
+    "deliveryCount",
+    "presettledCount",
+    "droppedPresettledCount",
+    "acceptedCount",
+    "rejectedCount",
+    "releasedCount",
+    "modifiedCount",
+    "deliveriesDelayed1Sec",
+    "deliveriesDelayed10Sec",
+    "deliveriesStuck",
+    "openMovedStreams",
+    "priority",
+    "creditAvailable",
+    "zeroCreditSeconds",
+    "q2BlockedCount",
+};
+#define LINK_COLUMN_COUNT (sizeof(link_columns) / sizeof(link_columns[0]))
+
+struct qdr_stats_snapshot_t {
+    sys_atomic_t              ref_count;
+    qd_router_entity_type_t   entity_type;
+    const char * const       *columns;
+    size_t                    column_count;
+    size_t                    row_count;
+    uint32_t                  uptime;   // core uptime in seconds at the time of the copy
+    uint64_t                 *values;   // column-major: values[column * row_count + row]
+};
+
+struct qdr_stats_publisher_t {
+    qdr_core_timer_t     *timer;
+    uint32_t              interval;      // seconds
+    sys_mutex_t           lock;
+    bool                  published;     // use lock
+    int                   current;       // use lock, the global buffer readers copy
+    qdr_global_stats_t    global[2];
+    qdr_stats_snapshot_t *connections;   // use lock
+    qdr_stats_snapshot_t *links;         // use lock
+};
+
+
+static qdr_stats_snapshot_t *qdr_stats_snapshot(qd_router_entity_type_t entity_type, const char * const *columns,
+                                                size_t column_count, size_t row_count, uint32_t uptime)
+{
+    qdr_stats_snapshot_t *snapshot = NEW(qdr_stats_snapshot_t);
+    ZERO(snapshot);
+    snapshot->entity_type  = entity_type;
+    snapshot->columns      = columns;
+    snapshot->column_count = column_count;
+    snapshot->row_count    = row_count;
+    snapshot->uptime       = uptime;
+    sys_atomic_init(&snapshot->ref_count, 1);
+    if (row_count)
+        snapshot->values = NEW_ARRAY(uint64_t, column_count * row_count);
+    return snapshot;
+}
+
+
+static void copy_connections_CT(qdr_core_t *core, qdr_stats_snapshot_t *snapshot)
+{
+    uint32_t  now    = snapshot->uptime;
+    size_t    rows   = snapshot->row_count;
+    size_t    row    = 0;
+    uint64_t *values = snapshot->values;
+
+    for (qdr_connection_t *conn = DEQ_HEAD(core->open_connections); conn && row < rows; conn = DEQ_NEXT(conn), ++row) {
+        values[0 * rows + row] = conn->identity;
+        values[1 * rows + row] = conn->role;
+        values[2 * rows + row] = now - conn->conn_uptime;
+        values[3 * rows + row] = conn->last_delivery_time ? now - conn->last_delivery_time : 0;
+        values[4 * rows + row] = qdr_connection_cpu_time(conn) / 1000;
+        values[5 * rows + row] = DEQ_SIZE(conn->links);
+    }
+}
+
+
+static void copy_links_CT(qdr_core_t *core, qdr_stats_snapshot_t *snapshot)
+{
+    uint32_t  now    = snapshot->uptime;
+    size_t    rows   = snapshot->row_count;
+    size_t    row    = 0;
+    uint64_t *values = snapshot->values;
+
+    for (qdr_link_t *link = DEQ_HEAD(core->open_links); link && row < rows; link = DEQ_NEXT(link), ++row) {
+        values[0  * rows + row] = link->identity;
+        values[1  * rows + row] = link->conn ? link->conn->identity : 0;
+        values[2  * rows + row] = link->link_direction == QD_INCOMING ? 0 : 1;
+        values[3  * rows + row] = link->conn ? link->conn->link_capacity : link->capacity;
+        values[4  * rows + row] = qdr_delivery_ring_size(&link->undelivered);
+        values[5  * rows + row] = DEQ_SIZE(link->unsettled);
+        values[6  * rows + row] = link->total_deliveries;
+        values[7  * rows + row] = link->presettled_deliveries;
+        values[8  * rows + row] = link->dropped_presettled_deliveries;
+        values[9  * rows + row] = link->accepted_deliveries;
+        values[10 * rows + row] = link->rejected_deliveries;
+        values[11 * rows + row] = link->released_deliveries;
+        values[12 * rows + row] = link->modified_deliveries;
+        values[13 * rows + row] = link->deliveries_delayed_1sec;
+        values[14 * rows + row] = link->deliveries_delayed_10sec;
+        values[15 * rows + row] = link->deliveries_stuck;
+        values[16 * rows + row] = link->open_moved_streams;
+        values[17 * rows + row] = link->priority;
+        values[18 * rows + row] = link->credit_reported;
+        values[19 * rows + row] = link->zero_credit_time ? now - link->zero_credit_time : 0;
+        values[20 * rows + row] = sys_atomic_get(&link->q2_blocked_count);
+    }
+}
+
+
+static qdr_stats_snapshot_t *qdr_stats_snapshot_take_CT(qdr_core_t *core, qd_router_entity_type_t entity_type)
+{
+    qdr_stats_snapshot_t *snapshot = 0;
+    uint32_t              uptime   = qdr_core_uptime_ticks(core);
+
+    switch (entity_type) {
+    case QD_ROUTER_CONNECTION:
+        snapshot = qdr_stats_snapshot(QD_ROUTER_CONNECTION, connection_columns, CONNECTION_COLUMN_COUNT,
+                                      DEQ_SIZE(core->open_connections), uptime);
+        copy_connections_CT(core, snapshot);
+        break;
+    case QD_ROUTER_LINK:
+        snapshot = qdr_stats_snapshot(QD_ROUTER_LINK, link_columns, LINK_COLUMN_COUNT,
+                                      DEQ_SIZE(core->open_links), uptime);
+        copy_links_CT(core, snapshot);
+        break;
+    default:
+        break;  // unsupported entity type: the handler gets a null snapshot
+    }
+    return snapshot;
+}
+
+
+static void qdr_post_stats_snapshot_response(qdr_core_t *core, qdr_general_work_t *work, bool discard)
+{
+    qdr_stats_snapshot_t *snapshot = work->snapshot;
+    if (discard) {
+        qdr_stats_snapshot_free(snapshot);
+        snapshot = 0;
+    }
+    work->snapshot_handler(work->context, snapshot, discard);
+}
+
+
+/**
+ * Hand the snapshot to the handler on a worker thread. Posting general work is lock-free, this is called on the core
+ * thread and, for the published snapshots, on the requesting thread.
+ */
+static void qdr_post_stats_snapshot(qdr_core_t *core, qdr_stats_snapshot_t *snapshot,
+                                    qdr_stats_snapshot_handler_t handler, void *context)
+{
+    qdr_general_work_t *work = qdr_general_work(qdr_post_stats_snapshot_response);
+    work->snapshot_handler = handler;
+    work->context          = context;
+    work->snapshot         = snapshot;
+    qdr_post_general_work_CT(core, work);
+}
+
+
+static void qdr_stats_snapshot_request_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    qdr_stats_snapshot_handler_t  handler  = action->args.stats_snapshot.handler;
+    void                         *context  = action->args.stats_snapshot.context;
+    qdr_stats_snapshot_t         *snapshot = 0;
+
+    if (discard) {
+        handler(context, 0, true);
+        return;
+    }
+
+    snapshot = qdr_stats_snapshot_take_CT(core, action->args.stats_snapshot.entity_type);
+    qdr_post_stats_snapshot(core, snapshot, handler, context);
+}
+
+
+void qdr_request_stats_snapshot(qdr_core_t *core, qd_router_entity_type_t entity_type,
+                                qdr_stats_snapshot_handler_t handler, void *context)
+{
+    qdr_stats_publisher_t *pub = core->stats_publisher;
+    if (pub && (entity_type == QD_ROUTER_CONNECTION || entity_type == QD_ROUTER_LINK)) {
+        qdr_stats_snapshot_t *snapshot = 0;
+        sys_mutex_lock(&pub->lock);
+        if (pub->published) {
+            snapshot = entity_type == QD_ROUTER_CONNECTION ? pub->connections : pub->links;
+            sys_atomic_inc(&snapshot->ref_count);
+        }
+        sys_mutex_unlock(&pub->lock);
+        if (snapshot) {
+            qdr_post_stats_snapshot(core, snapshot, handler, context);
+            return;
+        }
+    }
+
+    qdr_action_t *action = qdr_action(qdr_stats_snapshot_request_CT, "stats_snapshot_request");
+    action->args.stats_snapshot.entity_type = entity_type;
+    action->args.stats_snapshot.handler     = handler;
+    action->args.stats_snapshot.context     = context;
+    qdr_action_enqueue(core, action);
+}
+
+
+size_t qdr_stats_snapshot_rows(const qdr_stats_snapshot_t *snapshot)
+{
+    return snapshot->row_count;
+}
+
+
+void qdr_stats_snapshot_free(qdr_stats_snapshot_t *snapshot)
+{
+    if (snapshot && sys_atomic_dec(&snapshot->ref_count) == 1) {
+        sys_atomic_destroy(&snapshot->ref_count);
+        free(snapshot->values);
+        free(snapshot);
+    }
+}
+
+
+static void qdr_stats_publish_CT(qdr_core_t *core, void *context)
+{
+    qdr_stats_publisher_t *pub = (qdr_stats_publisher_t*) context;
+
+    // only the core thread switches the buffers, reading current without the lock is safe here
+    qdr_global_stats_t   *global      = &pub->global[!pub->current];
+    qdr_stats_snapshot_t *connections = qdr_stats_snapshot_take_CT(core, QD_ROUTER_CONNECTION);
+    qdr_stats_snapshot_t *links       = qdr_stats_snapshot_take_CT(core, QD_ROUTER_LINK);
+    qdr_global_stats_copy_CT(core, global);
+
+    sys_mutex_lock(&pub->lock);
+    pub->current = !pub->current;
+    pub->published = true;
+    qdr_stats_snapshot_t *old_connections = pub->connections;
+    qdr_stats_snapshot_t *old_links       = pub->links;
+    pub->connections = connections;
+    pub->links       = links;
+    sys_mutex_unlock(&pub->lock);
+
+    qdr_stats_snapshot_free(old_connections);
+    qdr_stats_snapshot_free(old_links);
+    qdr_core_timer_schedule_CT(core, pub->timer, pub->interval);
+}
+
+
+void qdr_stats_publish_setup_CT(qdr_core_t *core)
+{
+    if (core->qd->stats_publish_seconds == 0)
+        return;
+
+    qdr_stats_publisher_t *pub = NEW(qdr_stats_publisher_t);
+    ZERO(pub);
+    pub->interval = core->qd->stats_publish_seconds;
+    sys_mutex_init(&pub->lock);
+    pub->timer = qdr_core_timer_CT(core, qdr_stats_publish_CT, pub);
+    core->stats_publisher = pub;
+
+    qd_log(LOG_ROUTER_CORE, QD_LOG_INFO, "Statistics published every %" PRIu32 " seconds", pub->interval);
+    qdr_core_timer_schedule_CT(core, pub->timer, 0);
+}
+
+
+void qdr_stats_publish_final_CT(qdr_core_t *core)
+{
+    qdr_stats_publisher_t *pub = core->stats_publisher;
+    if (pub) {
+        core->stats_publisher = 0;
+        qdr_core_timer_free_CT(core, pub->timer);
+        qdr_stats_snapshot_free(pub->connections);
+        qdr_stats_snapshot_free(pub->links);
+        sys_mutex_free(&pub->lock);
+        free(pub);
+    }
+}
+
+
+bool qdr_global_stats_read_published(qdr_core_t *core, qdr_global_stats_t *stats)
+{
+    qdr_stats_publisher_t *pub       = core->stats_publisher;
+    bool                   published = false;
+
+    if (pub) {
+        sys_mutex_lock(&pub->lock);
+        published = pub->published;
+        if (published)
+            *stats = pub->global[pub->current];
+        sys_mutex_unlock(&pub->lock);
+    }
+    return published;
+}
+
+
+// Unsigned LEB128: seven bits per octet, least significant group first, high bit set on all but the last octet
+//
+static inline uint8_t *put_varint(uint8_t *cursor, uint64_t value)
+{
+    while (value >= 0x80) {
+        *cursor++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *cursor++ = (uint8_t) value;
+    return cursor;
+}
+
+#define VARINT_MAX 10  // octets needed for the largest uint64_t
+
+
+uint8_t *qdr_stats_snapshot_encode(const qdr_stats_snapshot_t *snapshot, size_t *length)
+{
+    size_t value_count = snapshot->column_count * snapshot->row_count;
+    size_t size        = strlen(QDR_STATS_SNAPSHOT_MAGIC) + 2 + 3 * VARINT_MAX + value_count * VARINT_MAX;
+    for (size_t col = 0; col < snapshot->column_count; ++col)
+        size += 1 + strlen(snapshot->columns[col]);
+
+    uint8_t *buffer = NEW_ARRAY(uint8_t, size);
+    uint8_t *cursor = buffer;
+
+    memcpy(cursor, QDR_STATS_SNAPSHOT_MAGIC, strlen(QDR_STATS_SNAPSHOT_MAGIC));
+    cursor += strlen(QDR_STATS_SNAPSHOT_MAGIC);
+    *cursor++ = QDR_STATS_SNAPSHOT_VERSION;
+    *cursor++ = snapshot->entity_type == QD_ROUTER_CONNECTION ? 1 : 2;
+    cursor = put_varint(cursor, snapshot->uptime);
+    cursor = put_varint(cursor, snapshot->column_count);
+    cursor = put_varint(cursor, snapshot->row_count);
+
+    for (size_t col = 0; col < snapshot->column_count; ++col) {
+        size_t name_len = strlen(snapshot->columns[col]);
+        assert(name_len < 256);
+        *cursor++ = (uint8_t) name_len;
+        memcpy(cursor, snapshot->columns[col], name_len);
+        cursor += name_len;
+    }
+
+    for (size_t i = 0; i < value_count; ++i)
+        cursor = put_varint(cursor, snapshot->values[i]);
+
+    *length = cursor - buffer;
+    return buffer;
+}
@@ -19,6 +19,7 @@
 
 #include "delivery.h"
 #include "router_core_private.h"
+#include "trace_probes.h"
 
 #include "qpid/dispatch/amqp.h"
 
@@ -29,20 +30,84 @@
 //==================================================================================
 
 static void qdr_link_flow_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
+static void qdr_link_flow_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
+static void qdr_link_deliver_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
 static void qdr_send_to_CT(qdr_core_t *core, qdr_action_t *action, bool discard);
+static void qdr_link_post_delivery_batch(qdr_link_t *link);
 
 
 //==================================================================================
 // Interface Functions
 //==================================================================================
 
+/**
+ * Hand a newly created delivery to the core.  While the link is batching, receive-complete deliveries are held on the
+ * link and posted together by qdr_link_deliver_batch_flush().  A delivery that is still arriving is posted on its own
+ * after any held deliveries so the core sees the link's deliveries in arrival order, the link keeps batching the
+ * deliveries that follow.  Deliveries on inter-router
+ * control links carry the routing protocol and are always posted on their own as control actions.
+ */
+static void qdr_link_post_delivery(qdr_link_t *link, qdr_delivery_t *dlv, const char *label)
+{
+    const bool more = !qd_message_receive_complete(dlv->msg);
+
+    if (link->link_type == QD_LINK_CONTROL) {
+        qdr_action_t *action = qdr_action(qdr_link_deliver_CT, label);
+        action->args.delivery.delivery = dlv;
+        action->args.delivery.more     = more;
+        qdr_action_control_enqueue(link->core, action);
+        return;
+    }
+
+    if (link->deliver_batching && !more) {
+        DEQ_INSERT_TAIL(link->deliver_batch, dlv);
+        return;
+    }
+
+    qdr_link_post_delivery_batch(link);
+
+    qdr_action_t *action = qdr_action(qdr_link_deliver_CT, label);
+    action->args.delivery.delivery = dlv;
+    action->args.delivery.more     = more;
+    qdr_action_enqueue(link->core, action);
+}
+
+
+void qdr_link_deliver_batch_begin(qdr_link_t *link)
+{
+    assert(DEQ_IS_EMPTY(link->deliver_batch));
+    link->deliver_batching = true;
+}
+
+
+// Post the deliveries held on the link, the link stays in its batching state
+//
+static void qdr_link_post_delivery_batch(qdr_link_t *link)
+{
+    if (!DEQ_IS_EMPTY(link->deliver_batch)) {
+        //
+        // The action takes the chain of deliveries, linked through their DEQ links, from the head of the batch
+        //
+        qdr_action_t *action = qdr_action(qdr_link_deliver_batch_CT, "link_deliver_batch");
+        action->args.delivery.delivery = DEQ_HEAD(link->deliver_batch);
+        DEQ_INIT(link->deliver_batch);
+        qdr_action_enqueue(link->core, action);
+    }
+}
+
+
+void qdr_link_deliver_batch_flush(qdr_link_t *link)
+{
+    qdr_link_post_delivery_batch(link);
+    link->deliver_batching = false;
+}
+
 qdr_delivery_t *qdr_link_deliver(qdr_link_t *link, qd_message_t *msg, qd_iterator_t *ingress,
                                  bool settled, qd_bitmask_t *link_exclusion, int ingress_index,
                                  uint64_t remote_disposition,
                                  qd_delivery_state_t *remote_state)
 {
-    qdr_action_t   *action = qdr_action(qdr_link_deliver_CT, "link_deliver");
-    qdr_delivery_t *dlv    = new_qdr_delivery_t();
+    qdr_delivery_t *dlv = new_qdr_delivery_t();
 
     ZERO(dlv);
     set_safe_ptr_qdr_link_t(link, &dlv->link_sp);
@@ -59,13 +124,12 @@ qdr_delivery_t *qdr_link_deliver(qdr_link_t *link, qd_message_t *msg, qd_iterato
     dlv->conn_id            = link->conn_id;
     sys_mutex_init(&dlv->dispo_lock);
     qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, DLV_FMT " Delivery created qdr_link_deliver", DLV_ARGS(dlv));
+    QD_PROBE_DELIVERY_CREATE(dlv->conn_id, dlv->link_id, dlv->delivery_id);
 
     qdr_delivery_incref(dlv, "qdr_link_deliver - newly created delivery, add to action list");
     qdr_delivery_incref(dlv, "qdr_link_deliver - protect returned value");
 
-    action->args.delivery.delivery = dlv;
-    action->args.delivery.more = !qd_message_receive_complete(msg);
-    qdr_action_enqueue(link->core, action);
+    qdr_link_post_delivery(link, dlv, "link_deliver");
     return dlv;
 }
 
@@ -76,8 +140,7 @@ qdr_delivery_t *qdr_link_deliver_to(qdr_link_t *link, qd_message_t *msg,
                                     uint64_t remote_disposition,
                                     qd_delivery_state_t *remote_state)
 {
-    qdr_action_t   *action = qdr_action(qdr_link_deliver_CT, "link_deliver");
-    qdr_delivery_t *dlv    = new_qdr_delivery_t();
+    qdr_delivery_t *dlv = new_qdr_delivery_t();
 
     ZERO(dlv);
     set_safe_ptr_qdr_link_t(link, &dlv->link_sp);
@@ -99,9 +162,7 @@ qdr_delivery_t *qdr_link_deliver_to(qdr_link_t *link, qd_message_t *msg,
     qdr_delivery_incref(dlv, "qdr_link_deliver_to - newly created delivery, add to action list");
     qdr_delivery_incref(dlv, "qdr_link_deliver_to - protect returned value");
 
-    action->args.delivery.delivery = dlv;
-    action->args.delivery.more = !qd_message_receive_complete(msg);
-    qdr_action_enqueue(link->core, action);
+    qdr_link_post_delivery(link, dlv, "link_deliver");
     return dlv;
 }
 
@@ -110,8 +171,7 @@ qdr_delivery_t *qdr_link_deliver_to_core(qdr_link_t *link, qd_message_t *msg, bo
                                          uint64_t remote_disposition,
                                          qd_delivery_state_t* remote_state)
 {
-    qdr_action_t   *action = qdr_action(qdr_link_deliver_CT, "link_deliver_to_core");
-    qdr_delivery_t *dlv    = new_qdr_delivery_t();
+    qdr_delivery_t *dlv = new_qdr_delivery_t();
 
     ZERO(dlv);
     set_safe_ptr_qdr_link_t(link, &dlv->link_sp);
@@ -133,13 +193,57 @@ qdr_delivery_t *qdr_link_deliver_to_core(qdr_link_t *link, qd_message_t *msg, bo
     qdr_delivery_incref(dlv, "qdr_link_deliver_to_core - newly created delivery, add to action list");
     qdr_delivery_incref(dlv, "qdr_link_deliver_to_core - protect returned value");
 
-    action->args.delivery.delivery = dlv;
-    action->args.delivery.more = !qd_message_receive_complete(msg);
-    qdr_action_enqueue(link->core, action);
+    qdr_link_post_delivery(link, dlv, "link_deliver_to_core");
     return dlv;
 }
 
 
+//
+// Take the delivery at the head of the link's undelivered list off the list instead of sending it
+// if its ttl has run out and none of it has been sent yet.  No credit is used by a dropped delivery.
+// An unsettled one moves to the unsettled list and is to be rejected by the caller once the
+// work_lock is released.  Return true if the delivery was dropped.
+//
+static bool qdr_link_drop_expired_LH(qdr_core_t *core, qdr_link_t *link, qdr_delivery_t *dlv)
+{
+    qd_message_t *msg = qdr_delivery_message(dlv);
+
+    if (!core->enforce_message_ttl || !msg || qd_message_tag_sent(msg) || !qd_message_receive_complete(msg)
+        || !qd_message_expired(msg, qdr_core_now_ns()))
+        return false;
+
+    qdr_delivery_ring_remove(&link->undelivered, dlv);
+    qdr_link_work_release(dlv->link_work);
+    dlv->link_work = 0;
+    link->expired_deliveries++;
+
+    if (dlv->settled) {
+        dlv->where = QDR_DELIVERY_NOWHERE;
+    } else {
+        DEQ_INSERT_TAIL(link->unsettled, dlv);
+        dlv->where = QDR_DELIVERY_IN_UNSETTLED;
+    }
+    return true;
+}
+
+
+// Record the queueing delay of an inter-router delivery in its priority lane, once.  Caller holds the connection's
+// work_lock.
+//
+static void qdr_link_record_lane_delay_LH(qdr_connection_t *conn, qdr_link_t *link, qdr_delivery_t *dlv)
+{
+    if (!dlv->forwarded_ns || dlv->lane_counted)
+        return;
+
+    qdr_priority_lane_stats_t *lane  = &conn->lane_stats[link->priority];
+    uint64_t                   delay = qdr_core_now_ns() - dlv->forwarded_ns;
+    lane->deliveries++;
+    lane->queue_delay_total_ns += delay;
+    lane->queue_delay_max_ns    = MAX(lane->queue_delay_max_ns, delay);
+    dlv->lane_counted           = true;
+}
+
+
 // send up to credit pending outgoing deliveries
 int qdr_link_process_deliveries(qdr_core_t *core, qdr_link_t *link, int credit)
 {
@@ -154,7 +258,24 @@ int qdr_link_process_deliveries(qdr_core_t *core, qdr_link_t *link, int credit)
 
         while (credit > 0) {
             sys_mutex_lock(&conn->work_lock);
-            dlv = DEQ_HEAD(link->undelivered);
+            dlv = qdr_delivery_ring_head(&link->undelivered);
+            if (dlv && qdr_link_drop_expired_LH(core, link, dlv)) {
+                const bool dropped_settled = dlv->where == QDR_DELIVERY_NOWHERE;
+                offer = qdr_delivery_ring_size(&link->undelivered);
+                qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, DLV_FMT " Delivery transfer:  ttl expired, dropped from undelivered",
+                       DLV_ARGS(dlv));
+                sys_mutex_unlock(&conn->work_lock);
+
+                if (dropped_settled) {
+                    qdr_delivery_decref(core, dlv, "qdr_link_process_deliveries - expired, removed from undelivered list");
+                } else {
+                    // as if the remote end had rejected it, so the outcome reaches the sender
+                    qdr_error_t *error = qdr_error(QD_AMQP_COND_PRECONDITION_FAILED, "Message time-to-live expired");
+                    qdr_delivery_remote_state_updated(core, dlv, PN_REJECTED, true, qd_delivery_state_from_error(error),
+                                                      false);
+                }
+                continue;
+            }
             if (dlv) {
                 qdr_delivery_incref(dlv, "qdr_link_process_deliveries - holding the undelivered delivery locally");
                 uint64_t new_disp    = 0;
@@ -195,18 +316,23 @@ int qdr_link_process_deliveries(qdr_core_t *core, qdr_link_t *link, int credit)
 
                         // DISPATCH-1153:
                         // If the undelivered list is cleared the link may have detached.  Stop processing.
-                        offer = DEQ_SIZE(link->undelivered);
+                        offer = qdr_delivery_ring_size(&link->undelivered);
                         if (offer == 0) {
                             qdr_delivery_decref(core, dlv, "qdr_link_process_deliveries - release local reference - closed link");
                             sys_mutex_unlock(&conn->work_lock);
                             return num_deliveries_completed;
                         }
 
-                        assert(dlv == DEQ_HEAD(link->undelivered));
-                        DEQ_REMOVE_HEAD(link->undelivered);
+                        assert(dlv == qdr_delivery_ring_head(&link->undelivered));
+                        qdr_delivery_ring_remove(&link->undelivered, dlv);
                         qdr_link_work_release(dlv->link_work);
                         dlv->link_work = 0;
 
+                        if (dlv->latency)
+                            qd_metric_observe(dlv->latency->egress, (qdr_core_now_ns() - dlv->ingress_ns) / 1000);
+
+                        qdr_link_record_lane_delay_LH(conn, link, dlv);
+
                         if (settled || qdr_delivery_oversize(dlv) || qdr_delivery_is_aborted(dlv)) {
                             dlv->where = QDR_DELIVERY_NOWHERE;
                             qdr_delivery_decref(core, dlv, "qdr_link_process_deliveries - remove from undelivered list");
@@ -229,8 +355,8 @@ int qdr_link_process_deliveries(qdr_core_t *core, qdr_link_t *link, int credit)
                         // core thread (qdr_link_process_initial_delivery) or
                         // here:
                         //
-                        if (dlv == DEQ_HEAD(link->undelivered)) {
-                            DEQ_REMOVE_HEAD(link->undelivered);
+                        if (dlv == qdr_delivery_ring_head(&link->undelivered)) {
+                            qdr_delivery_ring_remove(&link->undelivered, dlv);
                             qdr_link_work_release(dlv->link_work);
                             dlv->link_work = 0;
                             dlv->where = QDR_DELIVERY_NOWHERE;
@@ -251,6 +377,13 @@ int qdr_link_process_deliveries(qdr_core_t *core, qdr_link_t *link, int credit)
                     }
                 }
                 else {
+                    //
+                    // A streaming delivery may never complete: its lane delay is the time until it starts being
+                    // written.
+                    //
+                    if (qd_message_is_streaming(qdr_delivery_message(dlv)))
+                        qdr_link_record_lane_delay_LH(conn, link, dlv);
+
                     qdr_delivery_decref(core, dlv, "qdr_link_process_deliveries - release local reference - not send_complete");
 
                     //
@@ -304,9 +437,9 @@ void qdr_link_complete_sent_message(qdr_core_t *core, qdr_link_t *link)
     bool              activate = false;
 
     sys_mutex_lock(&conn->work_lock);
-    qdr_delivery_t *dlv = DEQ_HEAD(link->undelivered);
+    qdr_delivery_t *dlv = qdr_delivery_ring_head(&link->undelivered);
     if (!!dlv && qdr_delivery_send_complete(dlv)) {
-        DEQ_REMOVE_HEAD(link->undelivered);
+        qdr_delivery_ring_remove(&link->undelivered, dlv);
         if (dlv->link_work) {
             // ensure deliveries are sent in order:
             assert(dlv->link_work == DEQ_HEAD(link->work_list));
@@ -333,7 +466,7 @@ void qdr_link_complete_sent_message(qdr_core_t *core, qdr_link_t *link)
         //
         // If there's another delivery on the undelivered list, get the outbound process moving again.
         //
-        if (DEQ_SIZE(link->undelivered) > 0) {
+        if (qdr_delivery_ring_size(&link->undelivered) > 0) {
             qdr_add_link_ref(&conn->links_with_work[link->priority], link, QDR_LINK_LIST_CLASS_WORK);
             activate = true;
         }
@@ -345,15 +478,13 @@ void qdr_link_complete_sent_message(qdr_core_t *core, qdr_link_t *link)
 }
 
 
-void qdr_link_flow(qdr_core_t *core, qdr_link_t *link, int credit, bool drain_mode)
+//
+// Compute the number of credits now available that we haven't yet given
+// incrementally to the router core.  i.e. convert absolute credit to
+// incremental credit.
+//
+static int qdr_link_flow_credit(qdr_link_t *link, int credit, bool drain_mode)
 {
-    qdr_action_t *action = qdr_action(qdr_link_flow_CT, "link_flow");
-
-    //
-    // Compute the number of credits now available that we haven't yet given
-    // incrementally to the router core.  i.e. convert absolute credit to
-    // incremental credit.
-    //
     if (link->drain_mode && !drain_mode) {
         link->credit_to_core = 0;   // credit calc reset when coming out of drain mode
     } else {
@@ -362,15 +493,51 @@ void qdr_link_flow(qdr_core_t *core, qdr_link_t *link, int credit, bool drain_mo
             credit = 0;
         link->credit_to_core += credit;
     }
+    return credit;
+}
+
+
+void qdr_link_flow(qdr_core_t *core, qdr_link_t *link, int credit, bool drain_mode)
+{
+    qdr_action_t *action = qdr_action(qdr_link_flow_CT, "link_flow");
 
     set_safe_ptr_qdr_link_t(link, &action->args.connection.link);
-    action->args.connection.credit = credit;
+    action->args.connection.credit = qdr_link_flow_credit(link, credit, drain_mode);
     action->args.connection.drain  = drain_mode;
 
     qdr_action_enqueue(core, action);
     qdr_record_link_credit(core, link);
 }
 
+
+typedef struct qdr_link_flow_args_t {
+    qdr_link_t_sp link;
+    int           credit;
+    bool          drain;
+} qdr_link_flow_args_t;
+
+
+void qdr_link_flow_batch(qdr_core_t *core, qdr_link_t **links, const int *credits, const bool *drain_modes, int count)
+{
+    if (count <= 0)
+        return;
+
+    qdr_link_flow_args_t *flows = NEW_ARRAY(qdr_link_flow_args_t, count);
+    for (int i = 0; i < count; i++) {
+        set_safe_ptr_qdr_link_t(links[i], &flows[i].link);
+        flows[i].credit = qdr_link_flow_credit(links[i], credits[i], drain_modes[i]);
+        flows[i].drain  = drain_modes[i];
+    }
+
+    qdr_action_t *action = qdr_action(qdr_link_flow_batch_CT, "link_flow_batch");
+    action->args.general.context_1 = flows;
+    action->args.general.context_2 = (void*) (intptr_t) count;
+    qdr_action_enqueue(core, action);
+
+    for (int i = 0; i < count; i++)
+        qdr_record_link_credit(core, links[i]);
+}
+
 void qdr_link_set_drained(qdr_core_t *core, qdr_link_t *link)
 {
     if (link) {
@@ -388,7 +555,10 @@ void qdr_send_to1(qdr_core_t *core, qd_message_t *msg, qd_iterator_t *addr, bool
     action->args.io.exclude_inprocess = exclude_inprocess;
     action->args.io.control           = control;
 
-    qdr_action_enqueue(core, action);
+    if (control)
+        qdr_action_control_enqueue(core, action);
+    else
+        qdr_action_enqueue(core, action);
 }
 
 
@@ -400,7 +570,10 @@ void qdr_send_to2(qdr_core_t *core, qd_message_t *msg, const char *addr, bool ex
     action->args.io.exclude_inprocess = exclude_inprocess;
     action->args.io.control           = control;
 
-    qdr_action_enqueue(core, action);
+    if (control)
+        qdr_action_control_enqueue(core, action);
+    else
+        qdr_action_enqueue(core, action);
 }
 
 
@@ -409,15 +582,11 @@ void qdr_send_to2(qdr_core_t *core, qd_message_t *msg, const char *addr, bool ex
 //==================================================================================
 
 
-static void qdr_link_flow_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+static void qdr_link_flow_apply_CT(qdr_core_t *core, qdr_link_t *link, int credit, bool drain)
 {
-    qdr_link_t *link = safe_deref_qdr_link_t(action->args.connection.link);
-
-    if (discard || !link)
-        return;
+    if (link->conn)
+        qdr_action_charge_CT(link->conn);
 
-    int  credit           = action->args.connection.credit;
-    bool drain            = action->args.connection.drain;
     bool activate         = false;
     bool drain_was_set    = !link->drain_mode && drain;
     qdr_link_work_t *work = 0;
@@ -452,7 +621,7 @@ static void qdr_link_flow_CT(qdr_core_t *core, qdr_action_t *action, bool discar
             sys_mutex_lock(&link->conn->work_lock);
             if (work)
                 DEQ_INSERT_TAIL(link->work_list, work);
-            if (DEQ_SIZE(link->undelivered) > 0 || drain_was_set) {
+            if (qdr_delivery_ring_size(&link->undelivered) > 0 || drain_was_set) {
                 qdr_add_link_ref(&link->conn->links_with_work[link->priority], link, QDR_LINK_LIST_CLASS_WORK);
                 activate = true;
             }
@@ -472,6 +641,31 @@ static void qdr_link_flow_CT(qdr_core_t *core, qdr_action_t *action, bool discar
 }
 
 
+static void qdr_link_flow_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    qdr_link_t *link = safe_deref_qdr_link_t(action->args.connection.link);
+
+    if (discard || !link)
+        return;
+
+    qdr_link_flow_apply_CT(core, link, action->args.connection.credit, action->args.connection.drain);
+}
+
+
+static void qdr_link_flow_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    qdr_link_flow_args_t *flows = (qdr_link_flow_args_t*) action->args.general.context_1;
+    int                   count = (int) (intptr_t) action->args.general.context_2;
+
+    for (int i = 0; i < count && !discard; i++) {
+        qdr_link_t *link = safe_deref_qdr_link_t(flows[i].link);
+        if (link)
+            qdr_link_flow_apply_CT(core, link, flows[i].credit, flows[i].drain);
+    }
+    free(flows);
+}
+
+
 /**
  * Return the number of outbound paths to destinations that this address has.
  * Note that even if there are more than zero paths, the destination still may
@@ -549,12 +743,17 @@ static void qdr_link_forward_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery
     dlv->multicast = qdr_is_addr_treatment_multicast(addr);
 
     if (addr) {
+        if (addr->config && addr->config->latency_tracking && !dlv->latency)
+            dlv->latency = qdr_address_latency_CT(addr);
         fanout = qdr_forward_message_CT(core, addr, dlv->msg, dlv, false, link->link_type == QD_LINK_CONTROL);
         if (link->link_type != QD_LINK_CONTROL && link->link_type != QD_LINK_ROUTER) {
             addr->deliveries_ingress++;
+            if (core->heavy_hitters)
+                qdr_heavy_hitters_record_CT(core->heavy_hitters, addr, link->conn,
+                                            qd_message_buffered_octets(dlv->msg));
 
             if (qdr_connection_route_container(link->conn)) {
-                addr->deliveries_ingress_route_container++;
+                qdr_address_ext_CT(addr)->deliveries_ingress_route_container++;
                 core->deliveries_ingress_route_container++;
             }
 
@@ -613,7 +812,7 @@ static void qdr_link_forward_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery
     // If the anonymous delivery could not be sent anywhere (fanout = 0) and it is not multicasted, try sending it over
     // the anonymous link.
     //
-    if (fanout == 0 && !dlv->multicast && link->owning_addr == 0 && dlv->to_addr != 0) {
+    if (fanout == 0 && !dlv->expired && !dlv->multicast && link->owning_addr == 0 && dlv->to_addr != 0) {
         if (core->edge_conn_addr && link->conn->role != QDR_ROLE_EDGE_CONNECTION) {
             qdr_address_t *sender_address = core->edge_conn_addr(core->edge_context);
             if (sender_address && sender_address != addr)
@@ -625,9 +824,14 @@ static void qdr_link_forward_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery
         //
         // Message was not delivered, drop the delivery.
         //
-        // If the delivery is not settled, release it.
+        // If the delivery is not settled, release it.  An expired delivery is rejected instead so
+        // the sender does not send it again.
         //
-        if (!dlv->settled) {
+        if (dlv->expired && !dlv->settled) {
+            qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
+                   DLV_FMT " Delivery forward:  qdr_link_forward_CT(fanout == 0): ttl expired, rejected dlv", DLV_ARGS(dlv));
+            qdr_delivery_reject_CT(core, dlv, qdr_error(QD_AMQP_COND_PRECONDITION_FAILED, "Message time-to-live expired"));
+        } else if (!dlv->settled) {
             qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
                    DLV_FMT " Delivery forward:  qdr_link_forward_CT(fanout == 0): released dlv", DLV_ARGS(dlv));
             qdr_delivery_release_CT(core, dlv);
@@ -678,6 +882,7 @@ static void qdr_link_forward_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery
             //
             DEQ_INSERT_TAIL(link->unsettled, dlv);
             dlv->where = QDR_DELIVERY_IN_UNSETTLED;
+            qdr_link_delivery_queued_CT(core, link);
             qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
                    DLV_FMT " Delivery transfer:  qdr_link_forward_CT: action-list -> unsettled-list", DLV_ARGS(dlv));
 
@@ -694,19 +899,16 @@ static void qdr_link_forward_CT(qdr_core_t *core, qdr_link_t *link, qdr_delivery
 }
 
 
-void qdr_link_deliver_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+static void qdr_link_deliver_one_CT(qdr_core_t *core, qdr_delivery_t *dlv, bool more, uint64_t posted_ns)
 {
-    if (discard)
-        return;
-
-    qdr_delivery_t *dlv  = action->args.delivery.delivery;
-    bool            more = action->args.delivery.more;
-    qdr_link_t     *link = qdr_delivery_link(dlv);
+    qdr_link_t *link = qdr_delivery_link(dlv);
 
     if (!link)
         return;
-    if (link->conn)
+    if (link->conn) {
         link->conn->last_delivery_time = qdr_core_uptime_ticks(core);
+        qdr_action_charge_CT(link->conn);
+    }
 
     if (dlv->reforwarded) {
         link->reforwards++;
@@ -720,6 +922,14 @@ void qdr_link_deliver_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
     // Record the ingress time so we can track the age of this delivery.
     //
     dlv->ingress_time = qdr_core_uptime_ticks(core);
+    if (!dlv->ingress_ns)
+        dlv->ingress_ns = posted_ns;  // free: the action was timestamped when the ingress link posted it
+
+    //
+    // Fix the absolute expiry of the message while its age is known.
+    //
+    if (core->enforce_message_ttl)
+        qd_message_set_expiry(qdr_delivery_message(dlv), dlv->ingress_ns);
 
     //
     // If the link is an edge link, mark this delivery as via-edge
@@ -752,12 +962,12 @@ void qdr_link_deliver_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
     }
 
     //
-    // NOTE: The link->undelivered list does not need to be protected by the
+    // NOTE: The link->undelivered ring does not need to be protected by the
     //       connection's work lock for incoming links.  This protection is only
     //       needed for outgoing links.
     //
 
-    if (DEQ_IS_EMPTY(link->undelivered)) {
+    if (qdr_delivery_ring_size(&link->undelivered) == 0) {
         qdr_link_ref_t *temp_rlink = 0;
         qdr_address_t *addr = link->owning_addr;
         if (!addr && dlv->to_addr) {
@@ -824,14 +1034,42 @@ void qdr_link_deliver_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
         //
         // Take the action reference and use it for undelivered.  Don't decref/incref.
         //
-        DEQ_INSERT_TAIL(link->undelivered, dlv);
+        qdr_delivery_ring_push(&link->undelivered, dlv);
         dlv->where = QDR_DELIVERY_IN_UNDELIVERED;
+        qdr_link_delivery_queued_CT(core, link);
         qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG,
                DLV_FMT " Delivery transfer:  qdr_link_deliver_CT: action-list -> undelivered-list", DLV_ARGS(dlv));
     }
 }
 
 
+void qdr_link_deliver_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+
+    qdr_link_deliver_one_CT(core, action->args.delivery.delivery, action->args.delivery.more, action->enqueued_ns);
+}
+
+
+/**
+ * Process a batch of receive-complete deliveries posted by qdr_link_deliver_batch_flush(), oldest first.
+ */
+static void qdr_link_deliver_batch_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    if (discard)
+        return;
+
+    qdr_delivery_t *dlv = action->args.delivery.delivery;
+    while (dlv) {
+        qdr_delivery_t *next = DEQ_NEXT(dlv);
+        DEQ_ITEM_INIT(dlv);
+        qdr_link_deliver_one_CT(core, dlv, false, action->enqueued_ns);
+        dlv = next;
+    }
+}
+
+
 static void qdr_send_to_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
 {
     if (!discard) {
@@ -910,26 +1148,85 @@ void qdr_link_issue_credit_CT(qdr_core_t *core, qdr_link_t *link, int credit, bo
 }
 
 
+static void qdr_memory_timer_CT(qdr_core_t *core, void *context)
+{
+    if (qd_alloc_memory_state() < QD_MEMORY_HOLD_CREDIT) {
+        qd_log(LOG_ROUTER_CORE, QD_LOG_INFO, "Memory pressure relieved, issuing held credit to %d links",
+               core->credit_held_links);
+        qdr_link_t *link = DEQ_HEAD(core->open_links);
+        while (link && core->credit_held_links > 0) {
+            qdr_link_t *next = DEQ_NEXT(link);
+            if (link->credit_held) {
+                qdr_link_release_held_credit_CT(core, link);
+                //
+                // Issue the credit only if the link is anonymous or its address is reachable, otherwise
+                // qdr_addr_start_inlinks_CT issues it once a destination appears.
+                //
+                if (!link->owning_addr || qdr_addr_path_count_CT(link->owning_addr) > 0)
+                    qdr_link_issue_credit_CT(core, link, link->credit_pending, false);
+            }
+            link = next;
+        }
+    }
+
+    if (core->credit_held_links > 0)
+        qdr_core_timer_schedule_CT(core, core->memory_timer, 1);
+}
+
+
+/**
+ * Issue the initial credit to a new endpoint link unless the router is holding credit for memory.  A held link gets
+ * its credit from a core timer once the memory state recovers.
+ */
+void qdr_link_issue_initial_credit_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (qd_alloc_memory_state() < QD_MEMORY_HOLD_CREDIT) {
+        qdr_link_issue_credit_CT(core, link, link->capacity, false);
+        return;
+    }
+
+    if (link->credit_held)
+        return;
+
+    link->credit_held = true;
+    if (core->credit_held_links++ == 0) {
+        if (!core->memory_timer)
+            core->memory_timer = qdr_core_timer_CT(core, qdr_memory_timer_CT, 0);
+        qdr_core_timer_schedule_CT(core, core->memory_timer, 1);
+    }
+    qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] Initial credit held for memory",
+           link->conn->identity, link->identity);
+}
+
+
+/**
+ * Forget the held initial credit of a link, called when the credit is issued or the link goes away.
+ */
+void qdr_link_release_held_credit_CT(qdr_core_t *core, qdr_link_t *link)
+{
+    if (link->credit_held) {
+        link->credit_held = false;
+        assert(core->credit_held_links > 0);
+        core->credit_held_links--;
+    }
+}
+
+
 /**
  * Attempt to push all of the undelivered deliveries on an incoming link downrange.
  */
 void qdr_drain_inbound_undelivered_CT(qdr_core_t *core, qdr_link_t *link, qdr_address_t *addr)
 {
-    if (DEQ_SIZE(link->undelivered) > 0) {
+    if (qdr_delivery_ring_size(&link->undelivered) > 0) {
         //
-        // Move all the undelivered to a local list in case not all can be delivered.
-        // We don't want to loop here forever putting the same messages on the undelivered
-        // list.
+        // Forward only the deliveries undelivered now in case not all can be delivered.
+        // We don't want to loop here forever taking back the same messages the forwarder
+        // puts on the tail of the ring again.
         //
-        qdr_delivery_list_t deliveries;
-        DEQ_MOVE(link->undelivered, deliveries);
-
-        qdr_delivery_t *dlv = DEQ_HEAD(deliveries);
-        while (dlv) {
-            DEQ_REMOVE_HEAD(deliveries);
+        uint32_t        count = qdr_delivery_ring_size(&link->undelivered);
+        qdr_delivery_t *dlv;
+        while (count-- > 0 && (dlv = qdr_delivery_ring_pop(&link->undelivered)))
             qdr_link_forward_CT(core, link, dlv, addr, false);
-            dlv = DEQ_HEAD(deliveries);
-        }
     }
 }
 
@@ -953,7 +1250,7 @@ void qdr_addr_start_inlinks_CT(qdr_core_t *core, qdr_address_t *addr)
             //
             // Issue credit to stalled links
             //
-            if (link->credit_pending > 0)
+            if (link->credit_pending > 0 && !link->credit_held)
                 qdr_link_issue_credit_CT(core, link, link->credit_pending, false);
 
             //
@@ -967,12 +1264,41 @@ void qdr_addr_start_inlinks_CT(qdr_core_t *core, qdr_address_t *addr)
 }
 
 
+/**
+ * This function is called when an address may have lost its last destination.  If the address is
+ * now unreachable, withdraw the credit of its targeted in-links by draining them so that the
+ * producers stop sending instead of having every delivery released.  The credit is remembered as
+ * pending and issued again by qdr_addr_start_inlinks_CT when a destination appears.
+ *
+ * Links on edge connections are left alone, they always have credit available.
+ */
+void qdr_addr_stop_inlinks_CT(qdr_core_t *core, qdr_address_t *addr)
+{
+    if (DEQ_SIZE(addr->inlinks) == 0 || qdr_addr_path_count_CT(addr) > 0)
+        return;
+
+    qdr_link_ref_t *ref = DEQ_HEAD(addr->inlinks);
+    while (ref) {
+        qdr_link_t *link = ref->link;
+
+        if (link->link_type == QD_LINK_ENDPOINT && !link->edge && !link->drain_mode) {
+            qd_log(LOG_ROUTER_CORE, QD_LOG_DEBUG, "[C%" PRIu64 "][L%" PRIu64 "] Address unreachable, draining credit",
+                   link->conn_id, link->identity);
+            qdr_link_issue_credit_CT(core, link, 0, true);
+            link->credit_pending = link->capacity;
+        }
+
+        ref = DEQ_NEXT(ref);
+    }
+}
+
+
 // True if link currently has no outstanding deliveries or work.
 // Used to determine if it is safe for the core to close a link.
 //
 bool qdr_link_is_idle_CT(const qdr_link_t *link)
 {
-    return (DEQ_SIZE(link->undelivered) == 0 &&
+    return (qdr_delivery_ring_size(&link->undelivered) == 0 &&
             DEQ_SIZE(link->unsettled) == 0 &&
             DEQ_SIZE(link->settled) == 0 &&
             DEQ_SIZE(link->updated_deliveries) == 0 &&
@@ -35,13 +35,17 @@
 
 #include "qpid/dispatch/alloc.h"
 #include "qpid/dispatch/amqp.h"
+#include "qpid/dispatch/atomic.h"
 #include "qpid/dispatch/ctools.h"
 #include "qpid/dispatch/failoverlist.h"
+#include "qpid/dispatch/flight_recorder.h"
 #include "qpid/dispatch/log.h"
+#include "qpid/dispatch/metrics.h"
 #include "qpid/dispatch/platform.h"
 #include "qpid/dispatch/proton_utils.h"
 #include "qpid/dispatch/threading.h"
 #include "qpid/dispatch/protocol_adaptor.h"
+#include "qpid/dispatch/vanflow.h"
 
 #include <proton/event.h>
 #include <proton/listener.h>
@@ -54,6 +58,16 @@
 #include <stdio.h>
 #include <string.h>
 
+// Number of connection activation locks, see qd_server_get_activation_lock()
+#define QD_SERVER_ACTIVATION_LOCK_SHARDS 64
+
+// Worker pool sizing, see worker_pool_on_timer()
+#define QD_WORKER_SAMPLE_MS       1000
+#define QD_WORKER_GROW_PERCENT    80   // utilization above which a worker is added
+#define QD_WORKER_GROW_SAMPLES    2
+#define QD_WORKER_SHRINK_PERCENT  40   // utilization the remaining workers would have below which one is parked
+#define QD_WORKER_SHRINK_SAMPLES  30
+
 struct qd_server_t {
     qd_dispatch_t            *qd;
     const int                 thread_count; /* Immutable */
@@ -69,9 +83,28 @@ struct qd_server_t {
     int                       threads_paused;
     int                       pause_next_sequence;
     int                       pause_now_serving;
-    uint64_t                  next_connection_id;
+    atomic_uint_fast64_t      next_connection_id;
     qd_http_server_t         *http;
-    sys_mutex_t               conn_activation_lock;
+    sys_mutex_t               conn_activation_locks[QD_SERVER_ACTIVATION_LOCK_SHARDS];
+    int                       busy_poll_threads;  // worker threads still to start in busy-poll mode, use lock
+
+    // adaptive worker pool, between thread_count and thread_max workers process events
+    int                       thread_max;
+    sys_thread_t            **threads;            // use lock
+    int                       threads_started;    // use lock
+    int                       threads_exited;     // use lock
+    atomic_int                workers_active;     // started and not parked, changed under lock
+    atomic_int                workers_wanted;     // changed under lock
+    bool                      stopping;           // use lock
+    atomic_uint_fast64_t      busy_ns;            // time spent handling event batches, all workers
+    uint64_t                  sample_busy_ns;     // timer only
+    uint64_t                  sample_ns;          // timer only
+    int                       grow_samples;       // timer only
+    int                       shrink_samples;     // timer only
+    atomic_int                utilization;        // percent, last sample
+    qd_timer_t               *worker_timer;
+    qd_metric_t              *workers_metric;
+    qd_metric_t              *utilization_metric;
 };
 
 
@@ -132,6 +165,119 @@ pn_proactor_t *qd_server_proactor(const qd_server_t *qd_server)
     return qd_server->proactor;
 }
 
+//
+// Busy-poll: an idle thread keeps looking for events without blocking for up to busy_poll_ns before it falls back to
+// pn_proactor_wait().  This saves the wakeup latency of a sleeping thread at the cost of CPU.
+//
+static pn_event_batch_t *proactor_wait(qd_server_t *qd_server, uint64_t busy_poll_ns)
+{
+    if (busy_poll_ns) {
+        const uint64_t until = qd_flight_recorder_now_ns() + busy_poll_ns;
+        do {
+            pn_event_batch_t *events = pn_proactor_get(qd_server->proactor);
+            if (events)
+                return events;
+        } while (qd_flight_recorder_now_ns() < until);
+    }
+    return pn_proactor_wait(qd_server->proactor);
+}
+
+//
+// Adaptive worker pool
+//
+// With workerThreadsMax above workerThreads the pool starts with workerThreads workers and a timer samples the share
+// of their time the workers spent handling event batches. While it stays above QD_WORKER_GROW_PERCENT a worker is
+// added, up to workerThreadsMax. While the remaining workers would stay below QD_WORKER_SHRINK_PERCENT without one,
+// for much longer, a worker is parked, down to workerThreads.
+//
+// A worker is parked, rather than exiting, when it finishes a batch while more workers are active than wanted: it
+// blocks on the server condition until it is wanted again or the server stops. It keeps its thread-local alloc pools
+// and added workers reuse the parked threads before new ones are started.
+//
+
+// Returns false if the server stopped while the worker was parked
+static bool worker_park(qd_server_t *qd_server)
+{
+    bool running = true;
+
+    sys_mutex_lock(&qd_server->lock);
+    if (atomic_load(&qd_server->workers_active) > atomic_load(&qd_server->workers_wanted)) {
+        atomic_fetch_sub(&qd_server->workers_active, 1);
+        while (!qd_server->stopping
+               && atomic_load(&qd_server->workers_active) >= atomic_load(&qd_server->workers_wanted)) {
+            sys_cond_wait(&qd_server->cond, &qd_server->lock);
+        }
+        if (qd_server->stopping)
+            running = false;
+        else
+            atomic_fetch_add(&qd_server->workers_active, 1);
+    }
+    sys_mutex_unlock(&qd_server->lock);
+    return running;
+}
+
+static void *proactor_thread(void *arg);
+
+static void worker_start_LH(qd_server_t *qd_server) TA_REQ(qd_server->lock)
+{
+    atomic_fetch_add(&qd_server->workers_active, 1);
+    qd_server->threads[qd_server->threads_started++] = sys_thread(SYS_THREAD_PROACTOR, proactor_thread, qd_server);
+}
+
+static void worker_pool_on_timer(void *context)
+{
+    qd_server_t   *qd_server = (qd_server_t*) context;
+    const uint64_t now       = qd_flight_recorder_now_ns();
+    const uint64_t busy      = atomic_load_explicit(&qd_server->busy_ns, memory_order_relaxed);
+    const uint64_t elapsed   = now - qd_server->sample_ns;
+    const uint64_t busy_ns   = busy - qd_server->sample_busy_ns;
+    qd_server->sample_ns      = now;
+    qd_server->sample_busy_ns = busy;
+
+    sys_mutex_lock(&qd_server->lock);
+    const int active = atomic_load(&qd_server->workers_active);
+    const int wanted = atomic_load(&qd_server->workers_wanted);
+    const int percent = elapsed && active ? (int) MIN(busy_ns * 100 / (elapsed * active), 100) : 0;
+
+    qd_server->grow_samples   = percent > QD_WORKER_GROW_PERCENT ? qd_server->grow_samples + 1 : 0;
+    qd_server->shrink_samples = active > 1 && busy_ns * 100 < (uint64_t) QD_WORKER_SHRINK_PERCENT * elapsed * (active - 1)
+                              ? qd_server->shrink_samples + 1 : 0;
+
+    if (!qd_server->stopping && active == wanted) {
+        if (qd_server->grow_samples >= QD_WORKER_GROW_SAMPLES && wanted < qd_server->thread_max) {
+            atomic_store(&qd_server->workers_wanted, wanted + 1);
+            if (qd_server->threads_started - active > 0)
+                sys_cond_signal_all(&qd_server->cond);  // unpark one
+            else
+                worker_start_LH(qd_server);
+            qd_server->grow_samples = 0;
+            qd_log(LOG_SERVER, QD_LOG_INFO, "Worker threads at %d%% utilization, adding a worker: %d of at most %d",
+                   percent, wanted + 1, qd_server->thread_max);
+        } else if (qd_server->shrink_samples >= QD_WORKER_SHRINK_SAMPLES && wanted > qd_server->thread_count) {
+            atomic_store(&qd_server->workers_wanted, wanted - 1);
+            qd_server->shrink_samples = 0;
+            qd_log(LOG_SERVER, QD_LOG_INFO, "Worker threads at %d%% utilization, parking a worker: %d of at least %d",
+                   percent, wanted - 1, qd_server->thread_count);
+        }
+    }
+    sys_mutex_unlock(&qd_server->lock);
+
+    atomic_store(&qd_server->utilization, percent);
+    qd_metric_set(qd_server->workers_metric, active);
+    qd_metric_set(qd_server->utilization_metric, percent);
+    qd_timer_schedule(qd_server->worker_timer, QD_WORKER_SAMPLE_MS);
+}
+
+int qd_server_worker_threads(const qd_server_t *qd_server)
+{
+    return atomic_load(&qd_server->workers_active);
+}
+
+int qd_server_worker_utilization(const qd_server_t *qd_server)
+{
+    return atomic_load(&qd_server->utilization);
+}
+
 //
 // Proactor  main loop
 //
@@ -142,8 +288,17 @@ static void *proactor_thread(void *arg)
 
     qd_server_t      *qd_server = (qd_server_t*)arg;
     bool running = true;
+
+    uint64_t busy_poll_ns = 0;
+    sys_mutex_lock(&qd_server->lock);
+    if (qd_server->busy_poll_threads > 0) {
+        qd_server->busy_poll_threads--;
+        busy_poll_ns = (uint64_t) qd_server->qd->busy_poll_usec * 1000;
+    }
+    sys_mutex_unlock(&qd_server->lock);
+
     while (running) {
-        pn_event_batch_t            *events            = pn_proactor_wait(qd_server->proactor);
+        pn_event_batch_t            *events            = proactor_wait(qd_server, busy_poll_ns);
         sys_thread_proactor_mode_t   proactor_mode     = SYS_THREAD_PROACTOR_MODE_OTHER;
         void                        *proactor_context  = 0;
         bool                        (*event_handler)(qd_server_t *, pn_event_t *, void *);
@@ -167,16 +322,50 @@ static void *proactor_thread(void *arg)
         // clang-format on
         sys_thread_proactor_set_mode(proactor_mode, proactor_context);
 
+        // Core actions and vanflow updates generated while handling a connection's batch are staged and posted
+        // together. They must be flushed before pn_proactor_done() so they precede any work from the connection's next
+        // batch, which may run on a different thread.
+        const bool batch_actions = !!(proactor_mode & (SYS_THREAD_PROACTOR_MODE_CONNECTION | SYS_THREAD_PROACTOR_MODE_RAW_CONNECTION));
+        if (batch_actions) {
+            qdr_action_batch_begin();
+            vflow_batch_begin();
+        }
+
+        const uint64_t started_ns = qd_flight_recorder_now_ns();
+        uint32_t       handled    = 0;
+
         pn_event_t *e;
         while (running && (e = pn_event_batch_next(events))) {
             running = event_handler(qd_server, e, proactor_context);
+            ++handled;
         }
 
         // indicate batch complete by passing no event to the event_handler
 
         (void) event_handler(qd_server, 0, proactor_context);
+        if (batch_actions) {
+            vflow_batch_flush();
+            qdr_action_batch_flush();
+        }
+
+        const uint64_t now_ns = qd_flight_recorder_now_ns();
+        if (now_ns - started_ns > QD_FLIGHT_LONG_HANDLER_NS)
+            qd_flight_record_at(now_ns, QD_FLIGHT_LONG_HANDLER, proactor_mode, now_ns - started_ns, handled);
+        atomic_fetch_add_explicit(&qd_server->busy_ns, now_ns - started_ns, memory_order_relaxed);
         pn_proactor_done(qd_server->proactor, events);
+
+        if (running && atomic_load_explicit(&qd_server->workers_active, memory_order_relaxed)
+                           > atomic_load_explicit(&qd_server->workers_wanted, memory_order_relaxed)) {
+            running = worker_park(qd_server);
+        }
     }
+
+    // the server is stopping: release the parked workers
+    sys_mutex_lock(&qd_server->lock);
+    qd_server->stopping = true;
+    qd_server->threads_exited++;
+    sys_cond_signal_all(&qd_server->cond);
+    sys_mutex_unlock(&qd_server->lock);
     return NULL;
 }
 
@@ -198,7 +387,8 @@ qd_server_t *qd_server(qd_dispatch_t *qd, int thread_count, const char *containe
     qd_server->start_context    = 0;
 
     sys_mutex_init(&qd_server->lock);
-    sys_mutex_init(&qd_server->conn_activation_lock);
+    for (int i = 0; i < QD_SERVER_ACTIVATION_LOCK_SHARDS; i++)
+        sys_mutex_init(&qd_server->conn_activation_locks[i]);
     sys_cond_init(&qd_server->cond);
 
     qd_timer_initialize();
@@ -207,7 +397,11 @@ qd_server_t *qd_server(qd_dispatch_t *qd, int thread_count, const char *containe
     qd_server->threads_paused         = 0;
     qd_server->pause_next_sequence    = 0;
     qd_server->pause_now_serving      = 0;
-    qd_server->next_connection_id     = 1;
+    atomic_init(&qd_server->next_connection_id, 1);
+    atomic_init(&qd_server->workers_active, 0);
+    atomic_init(&qd_server->workers_wanted, 0);
+    atomic_init(&qd_server->busy_ns, 0);
+    atomic_init(&qd_server->utilization, 0);
 
     if (qd_server->sasl_config_path)
         pn_sasl_config_path(0, qd_server->sasl_config_path);
@@ -233,7 +427,8 @@ void qd_server_free(qd_server_t *qd_server)
     pn_proactor_free(qd_server->proactor);
     qd_timer_finalize();
     sys_mutex_free(&qd_server->lock);
-    sys_mutex_free(&qd_server->conn_activation_lock);
+    for (int i = 0; i < QD_SERVER_ACTIVATION_LOCK_SHARDS; i++)
+        sys_mutex_free(&qd_server->conn_activation_locks[i]);
     sys_cond_free(&qd_server->cond);
     free(qd_server);
 }
@@ -267,16 +462,49 @@ void qd_server_run(qd_dispatch_t *qd)
     qd_alloc_start_monitor(qd);  // enable periodic alloc pool usage loggin
 
     const int n = qd_server->thread_count;
-    sys_thread_t **threads = (sys_thread_t **)qd_calloc(n, sizeof(sys_thread_t*));
-    for (i = 0; i < n; i++) {
-        threads[i] = sys_thread(SYS_THREAD_PROACTOR, proactor_thread, qd_server);
+    if (qd->busy_poll_usec) {
+        qd_server->busy_poll_threads = qd->busy_poll_threads ? MIN(qd->busy_poll_threads, n) : n;
+        qd_log(LOG_ROUTER, QD_LOG_INFO, "Busy-poll mode: %d of %d worker threads poll for %" PRIu32 " usec before blocking",
+               qd_server->busy_poll_threads, n, qd->busy_poll_usec);
     }
 
+    qd_server->stopping        = false;
+    qd_server->threads_started = 0;
+    qd_server->threads_exited  = 0;
+    qd_server->thread_max = MAX(qd->thread_max, n);
+    qd_server->threads    = (sys_thread_t **) qd_calloc(qd_server->thread_max, sizeof(sys_thread_t*));
+    atomic_store(&qd_server->workers_wanted, n);
+    qd_server->workers_metric     = qd_metric(QD_METRIC_GAUGE, "qdr_worker_threads", 0, 0);
+    qd_server->utilization_metric = qd_metric(QD_METRIC_GAUGE, "qdr_worker_utilization_percent", 0, 0);
+    qd_metric_set(qd_server->workers_metric, n);
+    if (qd_server->thread_max > n) {
+        qd_log(LOG_SERVER, QD_LOG_INFO, "Worker threads adapt to load between %d and %d", n, qd_server->thread_max);
+        qd_server->sample_ns    = qd_flight_recorder_now_ns();
+        qd_server->worker_timer = qd_timer(qd, worker_pool_on_timer, qd_server);
+        qd_timer_schedule(qd_server->worker_timer, QD_WORKER_SAMPLE_MS);
+    }
+
+    sys_mutex_lock(&qd_server->lock);
     for (i = 0; i < n; i++) {
-        sys_thread_join(threads[i]);
-        sys_thread_free(threads[i]);
+        worker_start_LH(qd_server);
+    }
+
+    // workers may be added until the first one exits, wait for all of them
+    while (!qd_server->stopping || qd_server->threads_exited < qd_server->threads_started) {
+        sys_cond_wait(&qd_server->cond, &qd_server->lock);
+    }
+    sys_mutex_unlock(&qd_server->lock);
+
+    for (i = 0; i < qd_server->threads_started; i++) {
+        sys_thread_join(qd_server->threads[i]);
+        sys_thread_free(qd_server->threads[i]);
     }
-    free(threads);
+    free(qd_server->threads);
+    qd_server->threads = 0;
+    qd_timer_free(qd_server->worker_timer);
+    qd_server->worker_timer = 0;
+    qd_metric_free(qd_server->workers_metric);
+    qd_metric_free(qd_server->utilization_metric);
 
     qd_alloc_stop_monitor();
 
@@ -298,16 +526,13 @@ qd_dispatch_t* qd_server_dispatch(qd_server_t *server) { return server->qd; }
 
 uint64_t qd_server_allocate_connection_id(qd_server_t *server)
 {
-    uint64_t id;
-    sys_mutex_lock(&server->lock);
-    id = server->next_connection_id++;
-    sys_mutex_unlock(&server->lock);
-    return id;
+    return atomic_fetch_add_explicit(&server->next_connection_id, 1, memory_order_relaxed);
 }
 
-sys_mutex_t *qd_server_get_activation_lock(qd_server_t * server)
+sys_mutex_t *qd_server_get_activation_lock(qd_server_t * server, uint64_t connection_id)
 {
-    return &server->conn_activation_lock;
+    // connection ids are allocated in sequence, consecutive connections get different locks
+    return &server->conn_activation_locks[connection_id % QD_SERVER_ACTIVATION_LOCK_SHARDS];
 }
 
 const char *qd_server_get_container_name(const qd_server_t *server)
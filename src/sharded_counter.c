@@ -0,0 +1,42 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "qpid/dispatch/sharded_counter.h"
+
+__thread int qd_sharded_counter_thread_shard = -1;
+
+// Threads take the shards round-robin in the order they first count
+static atomic_uint next_shard;
+
+
+int qd_sharded_counter_assign_shard(void)
+{
+    qd_sharded_counter_thread_shard =
+        (int) (atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) % QD_SHARDED_COUNTER_SHARDS);
+    return qd_sharded_counter_thread_shard;
+}
+
+
+uint64_t qd_sharded_counter_value(const qd_sharded_counter_t *counter)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < QD_SHARDED_COUNTER_SHARDS; i++)
+        sum += atomic_load_explicit(&((qd_sharded_counter_t*) counter)->shards[i].value, memory_order_relaxed);
+    return sum;
+}
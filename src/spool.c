@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "spool.h"
+
+#include "qpid/dispatch/atomic.h"
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+#include "qpid/dispatch/threading.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SPOOL_SEGMENT_SIZE    (16 * 1024 * 1024)
+#define SPOOL_PREFETCH_WINDOW (256 * 1024)  // paged in ahead of the sender, a multiple of the page size
+#define SPOOL_RETRY_BUFFERS   4096          // buffers kept in memory after a spool file could not be created
+
+/**
+ * A spool file mapped into memory and filled front to back.  Each buffer spooled into it holds a reference, as
+ * does the spool while it is the segment being filled.
+ */
+typedef struct qd_spool_segment_t {
+    sys_atomic_t   refs;
+    unsigned char *base;
+    size_t         used;  // under spool.lock
+} qd_spool_segment_t;
+
+static struct {
+    sys_mutex_t         lock;
+    char               *directory;
+    size_t              threshold;     // content buffers of a message above which it spools
+    qd_spool_segment_t *current;       // the segment being filled
+    size_t              retry_after;   // buffers to skip before creating a segment again
+    bool                creating;      // a thread is creating the next segment, outside the lock
+    bool                enabled;       // set before any message is received, read lock free
+} spool;
+
+
+static void segment_release(void *context)
+{
+    qd_spool_segment_t *segment = (qd_spool_segment_t*) context;
+    if (sys_atomic_dec(&segment->refs) == 1) {
+        munmap(segment->base, SPOOL_SEGMENT_SIZE);
+        sys_atomic_destroy(&segment->refs);
+        free(segment);
+    }
+}
+
+
+// Create, size and map a new spool file.  Called without spool.lock held: the file system calls may block.
+//
+static qd_spool_segment_t *segment_create(void)
+{
+    size_t len  = strlen(spool.directory) + sizeof("/skrouter-spool-XXXXXX");
+    char  *path = (char*) qd_malloc(len);
+    snprintf(path, len, "%s/skrouter-spool-XXXXXX", spool.directory);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        qd_log(LOG_ROUTER, QD_LOG_WARNING, "Cannot create spool file %s: %s", path, strerror(errno));
+        free(path);
+        return 0;
+    }
+    unlink(path);
+
+    // reserve the blocks up front: a write to a mapped page of a sparse file on a full disk raises SIGBUS
+    int rc = posix_fallocate(fd, 0, SPOOL_SEGMENT_SIZE);
+    unsigned char *base = MAP_FAILED;
+    if (rc == 0) {
+        base = (unsigned char*) mmap(0, SPOOL_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+            rc = errno;
+    }
+    close(fd);
+    if (rc != 0) {
+        qd_log(LOG_ROUTER, QD_LOG_WARNING, "Cannot allocate spool file %s: %s", path, strerror(rc));
+        free(path);
+        return 0;
+    }
+    free(path);
+
+    qd_spool_segment_t *segment = NEW(qd_spool_segment_t);
+    sys_atomic_init(&segment->refs, 1);
+    segment->base = base;
+    segment->used = 0;
+    return segment;
+}
+
+
+void qd_spool_configure(const char *directory, size_t threshold_octets)
+{
+    if (!directory || spool.enabled)
+        return;
+
+    sys_mutex_init(&spool.lock);
+    spool.directory = qd_strdup(directory);
+    spool.threshold = MAX(threshold_octets / QD_BUFFER_SIZE, 1);
+    spool.enabled   = true;
+    qd_log(LOG_ROUTER, QD_LOG_INFO, "Spooling message content above %zu octets per message to %s", threshold_octets,
+           directory);
+}
+
+
+void qd_spool_finalize(void)
+{
+    if (!spool.enabled)
+        return;
+
+    spool.enabled = false;
+    if (spool.current)
+        segment_release(spool.current);
+    spool.current = 0;
+    free(spool.directory);
+    spool.directory = 0;
+    sys_mutex_free(&spool.lock);
+}
+
+
+bool qd_spool_wanted(size_t buffer_count, bool under_pressure)
+{
+    return spool.enabled && buffer_count >= (under_pressure ? MAX(spool.threshold / 4, 1) : spool.threshold);
+}
+
+
+qd_buffer_t *qd_spool_buffer(qd_buffer_t *buf)
+{
+    const size_t size = qd_buffer_size(buf);
+    if (!spool.enabled || size == 0 || size > SPOOL_SEGMENT_SIZE || buf->size_class >= QD_BUFFER_CLASS_SHARED)
+        return buf;
+
+    qd_spool_segment_t *retired = 0;
+    qd_spool_segment_t *segment = 0;
+
+    sys_mutex_lock(&spool.lock);
+    if (spool.current && spool.current->used + size > SPOOL_SEGMENT_SIZE) {
+        retired       = spool.current;
+        spool.current = 0;
+    }
+    if (!spool.current && !spool.creating) {
+        if (spool.retry_after > 0) {
+            spool.retry_after--;
+        } else {
+            // buffers spooled by other threads meanwhile stay in memory
+            spool.creating = true;
+            sys_mutex_unlock(&spool.lock);
+            qd_spool_segment_t *created = segment_create();
+            sys_mutex_lock(&spool.lock);
+            spool.creating = false;
+            spool.current  = created;
+            if (!created)
+                spool.retry_after = SPOOL_RETRY_BUFFERS;
+        }
+    }
+    segment = spool.current;
+    unsigned char *data = 0;
+    if (segment) {
+        data           = segment->base + segment->used;
+        segment->used += size;
+        sys_atomic_inc(&segment->refs);
+    }
+    sys_mutex_unlock(&spool.lock);
+
+    if (retired) {
+        // start the write back of the full segment so its pages can be reclaimed
+        msync(retired->base, SPOOL_SEGMENT_SIZE, MS_ASYNC);
+        segment_release(retired);
+    }
+
+    if (!segment)
+        return buf;
+
+    memcpy(data, qd_buffer_base(buf), size);
+    qd_buffer_t *spooled = qd_buffer_external(data, size, segment_release, segment);
+    qd_buffer_free(buf);
+    return spooled;
+}
+
+
+void qd_spool_prefetch(const qd_buffer_t *buf)
+{
+    if (buf->size_class != QD_BUFFER_CLASS_EXTERNAL)
+        return;
+    const qd_buffer_share_t *ext = (const qd_buffer_share_t*) &buf[1];
+    if (ext->release != segment_release)
+        return;
+
+    // once per window: when the buffer starts in a new one
+    const qd_spool_segment_t *segment = (const qd_spool_segment_t*) ext->context;
+    const size_t offset = ext->data - segment->base;
+    if (offset % SPOOL_PREFETCH_WINDOW >= qd_buffer_size(buf))
+        return;
+
+    const size_t start = offset - offset % SPOOL_PREFETCH_WINDOW;
+    const size_t len   = MIN(2 * SPOOL_PREFETCH_WINDOW, SPOOL_SEGMENT_SIZE - start);
+    madvise(segment->base + start, len, MADV_WILLNEED);
+}
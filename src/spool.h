@@ -0,0 +1,72 @@
+#ifndef __spool_h__
+#define __spool_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/** @file
+ * Spooling of buffered message content to disk.
+ *
+ * A message whose content buffers are not released as they are received (Q2 flow control is disabled for it, or
+ * its consumers are slow) holds all of them in memory.  With a spool directory configured, the full buffers a message
+ * receives once it holds more than the spool threshold are copied into memory mapped spool files and the pool
+ * buffers are released.  The spooled data is file backed page cache the kernel can write back and reclaim, it is
+ * paged in again when the buffers are sent.
+ *
+ * Spool files are unlinked as soon as they are created and are allocated with posix_fallocate() so a full disk
+ * fails the spooling, never the access of a mapped page.  A file is unmapped when all buffers spooled into it have
+ * been freed.
+ */
+
+#include "qpid/dispatch/buffer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Configure spooling, before any message is received.
+ *
+ * @param directory Directory the spool files are created in, NULL disables spooling
+ * @param threshold_octets Buffered content of a message above which its buffers are spooled
+ */
+void qd_spool_configure(const char *directory, size_t threshold_octets);
+
+void qd_spool_finalize(void);
+
+/**
+ * True if a message holding buffer_count content buffers should spool the next one.  Lock free.
+ *
+ * @param buffer_count The content buffers of the message that are not protected headers
+ * @param under_pressure The router is short of memory, spool at a lower threshold
+ */
+bool qd_spool_wanted(size_t buffer_count, bool under_pressure);
+
+/**
+ * Copy the data of a complete buffer into the spool and free it.
+ *
+ * @return the spooled buffer (QD_BUFFER_CLASS_EXTERNAL), or buf itself if it could not be spooled
+ */
+qd_buffer_t *qd_spool_buffer(qd_buffer_t *buf);
+
+/**
+ * Ask the kernel to page in the spooled data following buf ahead of sending it.  A no-op for buffers that are not
+ * spooled.
+ */
+void qd_spool_prefetch(const qd_buffer_t *buf);
+
+#endif
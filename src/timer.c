@@ -31,6 +31,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 
 // timer state machine
@@ -38,8 +39,8 @@
 // IDLE: initial state or state immediately after the callback finishes
 // running.
 //
-// SCHEDULED: timer has been scheduled to run.  It is on the scheduled_timer
-// list.  Valid next states are IDLE (if timer canceled), RUNNING, or DELETED.
+// SCHEDULED: timer has been scheduled to run.  It is in its shard's heap.
+// Valid next states are IDLE (if timer canceled), RUNNING, or DELETED.
 //
 // RUNNING: the timer callback is executing.  Valid next states are IDLE,
 // SCHEDULED, BLOCKED or DELETED.  The address of the thread executing the
@@ -60,79 +61,151 @@ typedef enum {
 } qd_timer_state_t;
 
 
+// Timer shards
+//
+// Scheduled timers are kept in a number of shards, each a binary min-heap ordered by deadline and protected by its own
+// lock.  A timer belongs to the shard of the thread that created it, so I/O threads scheduling and cancelling their
+// own connection timers do not contend with each other.  qd_timer_visit() runs the expired timers of every shard.
+//
+// The proactor has a single timeout.  It is armed for the earliest deadline across all shards: a schedule call only
+// needs to re-arm it (under timeout_lock) if the timer became the earliest of its shard and is earlier than the armed
+// deadline.
+//
+#define QD_TIMER_SHARDS 16
+
+typedef struct qd_timer_shard_t {
+    sys_mutex_t   lock;
+    qd_timer_t  **heap;
+    int           count;
+    int           capacity;
+    uint64_t      next_seq;  // insertion order, breaks ties between equal deadlines
+} qd_timer_shard_t;
+
 struct qd_timer_t {
-    DEQ_LINKS(qd_timer_t);
     qd_server_t      *server;
+    qd_timer_shard_t *shard;
+    sys_thread_t     *callback_thread;  // thread running the callback while RUNNING or BLOCKED
     qd_timer_cb_t     handler;
     void             *context;
     sys_cond_t        condition;
-    sys_atomic_t      ref_count; // referenced by user and when on scheduled list
-    qd_timestamp_t    delta_time;
+    sys_atomic_t      ref_count; // referenced by user and when in a shard heap
+    qd_timestamp_t    deadline;
+    uint64_t          seq;
+    int               heap_index;
     qd_timer_state_t  state;
 };
 
-DEQ_DECLARE(qd_timer_t, qd_timer_list_t);
+static qd_timer_shard_t shards[QD_TIMER_SHARDS];
+static sys_atomic_t     next_shard;
+static __thread int     thread_shard = -1;
 
-static sys_mutex_t      lock;
-static qd_timer_list_t  scheduled_timers = {0};
-
-// thread currently running timer callbacks or 0 if callbacks are not running
-static sys_thread_t    *callback_thread = 0;
-
-/* Timers have relative delta_time measured from the previous timer.
- * The delta_time of the first timer on the queue is measured from timer_base.
- */
-static qd_timestamp_t   time_base = 0;
+// the deadline the proactor timeout is armed for, or QD_TIMER_DISARMED
+#define QD_TIMER_DISARMED INT64_MAX
+static sys_mutex_t      timeout_lock;
+static qd_timestamp_t   armed_deadline = QD_TIMER_DISARMED;
 
 ALLOC_DECLARE(qd_timer_t);
 ALLOC_DEFINE(qd_timer_t);
 
-/// For tests only
-sys_mutex_t *qd_timer_lock(void)
-{
-    return &lock;
-}
-
 //=========================================================================
 // Private static functions
 //=========================================================================
 
-// returns true if timer removed from scheduled list
-static bool timer_cancel_LH(qd_timer_t *timer) TA_REQ(lock)
+static qd_timer_shard_t *timer_thread_shard(void)
 {
-    if (timer->state == QD_TIMER_STATE_SCHEDULED) {
-        if (timer->next)
-            timer->next->delta_time += timer->delta_time;
-        DEQ_REMOVE(scheduled_timers, timer);
-        timer->state = QD_TIMER_STATE_IDLE;
-        return true;
+    if (thread_shard < 0)
+        thread_shard = sys_atomic_inc(&next_shard) % QD_TIMER_SHARDS;
+    return &shards[thread_shard];
+}
+
+
+static inline bool timer_before(const qd_timer_t *a, const qd_timer_t *b)
+{
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+}
+
+
+static inline void heap_set(qd_timer_shard_t *shard, int index, qd_timer_t *timer)
+{
+    shard->heap[index] = timer;
+    timer->heap_index  = index;
+}
+
+
+static void heap_sift_up(qd_timer_shard_t *shard, int index)
+{
+    qd_timer_t *timer = shard->heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!timer_before(timer, shard->heap[parent]))
+            break;
+        heap_set(shard, index, shard->heap[parent]);
+        index = parent;
     }
-    return false;
+    heap_set(shard, index, timer);
 }
 
 
-/* Adjust timer's time_base and delays for the current time. */
-static void timer_adjust_now_LH(void) TA_REQ(lock)
+static void heap_sift_down(qd_timer_shard_t *shard, int index)
 {
-    qd_timestamp_t now = qd_timer_now();
-    if (time_base != 0 && now > time_base) {
-        qd_duration_t delta = now - time_base;
-        /* Adjust timer delays by removing duration delta, starting from timer. */
-        for (qd_timer_t *timer = DEQ_HEAD(scheduled_timers); delta > 0 && timer; timer = DEQ_NEXT(timer)) {
-            if (timer->delta_time >= delta) {
-                timer->delta_time -= delta;
-                delta = 0;
-            } else {
-                delta -= timer->delta_time;
-                timer->delta_time = 0; /* Ready to fire */
-            }
-        }
+    qd_timer_t *timer = shard->heap[index];
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= shard->count)
+            break;
+        if (child + 1 < shard->count && timer_before(shard->heap[child + 1], shard->heap[child]))
+            child++;
+        if (!timer_before(shard->heap[child], timer))
+            break;
+        heap_set(shard, index, shard->heap[child]);
+        index = child;
+    }
+    heap_set(shard, index, timer);
+}
+
+
+static void heap_insert_LH(qd_timer_shard_t *shard, qd_timer_t *timer)
+{
+    if (shard->count == shard->capacity) {
+        shard->capacity = shard->capacity ? shard->capacity * 2 : 64;
+        shard->heap     = (qd_timer_t **) realloc(shard->heap, shard->capacity * sizeof(qd_timer_t *));
+        assert(shard->heap);
+    }
+    timer->seq = shard->next_seq++;
+    heap_set(shard, shard->count++, timer);
+    heap_sift_up(shard, timer->heap_index);
+}
+
+
+static void heap_remove_LH(qd_timer_shard_t *shard, qd_timer_t *timer)
+{
+    int         index = timer->heap_index;
+    qd_timer_t *last  = shard->heap[--shard->count];
+
+    timer->heap_index = -1;
+    if (last != timer) {
+        heap_set(shard, index, last);
+        if (index > 0 && timer_before(last, shard->heap[(index - 1) / 2]))
+            heap_sift_up(shard, index);
+        else
+            heap_sift_down(shard, index);
+    }
+}
+
+
+// returns true if timer removed from its shard heap
+static bool timer_cancel_LH(qd_timer_t *timer)
+{
+    if (timer->state == QD_TIMER_STATE_SCHEDULED) {
+        heap_remove_LH(timer->shard, timer);
+        timer->state = QD_TIMER_STATE_IDLE;
+        return true;
     }
-    time_base = now;
+    return false;
 }
 
 
-static void timer_decref_LH(qd_timer_t *timer) TA_REQ(lock)
+static void timer_decref_LH(qd_timer_t *timer)
 {
     assert(sys_atomic_get(&timer->ref_count) > 0);
     if (sys_atomic_dec(&timer->ref_count) == 1) {
@@ -144,6 +217,18 @@ static void timer_decref_LH(qd_timer_t *timer) TA_REQ(lock)
 }
 
 
+// Arm the proactor timeout for deadline unless an earlier one is already armed.
+static void timer_arm(qd_server_t *server, qd_timestamp_t deadline, qd_timestamp_t now)
+{
+    sys_mutex_lock(&timeout_lock);
+    if (deadline < armed_deadline) {
+        armed_deadline = deadline;
+        qd_server_timeout(server, deadline > now ? deadline - now : 0);
+    }
+    sys_mutex_unlock(&timeout_lock);
+}
+
+
 //=========================================================================
 // Public Functions from timer.h
 //=========================================================================
@@ -154,16 +239,15 @@ qd_timer_t *qd_timer(qd_dispatch_t *qd, qd_timer_cb_t cb, void* context)
     qd_timer_t *timer = new_qd_timer_t();
     assert(timer);
 
-    sys_cond_t cond;
-    sys_cond_init(&cond);
-
-    DEQ_ITEM_INIT(timer);
-
-    timer->server     = qd ? qd->server : 0;
-    timer->handler    = cb;
-    timer->context    = context;
-    timer->delta_time = 0;
-    timer->state      = QD_TIMER_STATE_IDLE;
+    timer->server          = qd ? qd->server : 0;
+    timer->shard           = timer_thread_shard();
+    timer->callback_thread = 0;
+    timer->handler         = cb;
+    timer->context         = context;
+    timer->deadline        = 0;
+    timer->seq             = 0;
+    timer->heap_index      = -1;
+    timer->state           = QD_TIMER_STATE_IDLE;
     sys_cond_init(&timer->condition);
     sys_atomic_init(&timer->ref_count, 1);
 
@@ -175,30 +259,31 @@ void qd_timer_free(qd_timer_t *timer)
 {
     if (!timer) return;
 
-    sys_mutex_lock(&lock);
+    qd_timer_shard_t *shard = timer->shard;
+    sys_mutex_lock(&shard->lock);
 
     assert(timer->state != QD_TIMER_STATE_DELETED);  // double free!!!
 
     if (timer->state == QD_TIMER_STATE_RUNNING) {
-        if (sys_thread_self() != callback_thread) {
+        if (sys_thread_self() != timer->callback_thread) {
             // Another thread is running the callback (see qd_timer_visit())
             // Wait until the callback finishes
             timer->state = QD_TIMER_STATE_BLOCKED;
-            sys_cond_wait(&timer->condition, &lock);
+            sys_cond_wait(&timer->condition, &shard->lock);
         }
     }
 
     // we can safely free the timer since the callback is not running
 
     if (timer_cancel_LH(timer)) {
-        // removed from scheduled_timers, so drop ref_count
+        // removed from the shard heap, so drop ref_count
         assert(sys_atomic_get(&timer->ref_count) > 1);  // expect caller holds a ref_count
         timer_decref_LH(timer);
     }
 
     timer->state = QD_TIMER_STATE_DELETED;
     timer_decref_LH(timer);  // now drop caller ref_count
-    sys_mutex_unlock(&lock);
+    sys_mutex_unlock(&shard->lock);
 }
 
 __attribute__((weak))  // permit replacement by dummy implementation in unit_tests
@@ -210,70 +295,50 @@ qd_timer_now(void)
 
 void qd_timer_schedule(qd_timer_t *timer, qd_duration_t duration)
 {
-    sys_mutex_lock(&lock);
+    qd_timer_shard_t *shard = timer->shard;
+    qd_timestamp_t    now   = qd_timer_now();
+
+    sys_mutex_lock(&shard->lock);
 
     assert(timer->state != QD_TIMER_STATE_DELETED);
     const bool was_scheduled = timer_cancel_LH(timer);
 
-    //
-    // Find the insert point in the schedule.
-    //
-    timer_adjust_now_LH();   /* Adjust the timers for current time */
-
-    /* Invariant: time_before == total time up to but not including ptr */
-    qd_timer_t *ptr = DEQ_HEAD(scheduled_timers);
-    qd_duration_t time_before = 0;
-    while (ptr && time_before + ptr->delta_time < duration) {
-        time_before += ptr->delta_time;
-        ptr = ptr->next;
-    }
-    /* ptr is the first timer to exceed duration or NULL if we ran out */
-    if (!ptr) {
-        timer->delta_time = duration - time_before;
-        DEQ_INSERT_TAIL(scheduled_timers, timer);
-    } else {
-        timer->delta_time = duration - time_before;
-        ptr->delta_time -= timer->delta_time;
-        ptr = ptr->prev;
-        if (ptr)
-            DEQ_INSERT_AFTER(scheduled_timers, timer, ptr);
-        else
-            DEQ_INSERT_HEAD(scheduled_timers, timer);
-    }
+    timer->deadline = now + duration;
+    heap_insert_LH(shard, timer);
 
     timer->state = QD_TIMER_STATE_SCHEDULED;
     if (!was_scheduled) {
-        // scheduled_timers list reference:
+        // shard heap reference:
         sys_atomic_inc(&timer->ref_count);
     }
 
-    qd_timer_t *first = DEQ_HEAD(scheduled_timers);
-    // Don't need to set timeout if qd_timer_visit is running on another thread now
-    // Because qd_timer_visit will itself deal with rescheduling the timers
-    if (!callback_thread) {
-        qd_server_timeout(first->server, first->delta_time);
-    }
-    sys_mutex_unlock(&lock);
+    const bool earliest = timer->heap_index == 0;
+    sys_mutex_unlock(&shard->lock);
+
+    // Only the earliest timer of a shard can move the proactor timeout forward
+    if (earliest)
+        timer_arm(timer->server, timer->deadline, now);
 }
 
 
 void qd_timer_cancel(qd_timer_t *timer)
 {
-    sys_mutex_lock(&lock);
+    qd_timer_shard_t *shard = timer->shard;
+    sys_mutex_lock(&shard->lock);
 
     if (timer->state == QD_TIMER_STATE_RUNNING) {
-        assert(sys_thread_self() != callback_thread);  // cancel within callback not allowed
+        assert(sys_thread_self() != timer->callback_thread);  // cancel within callback not allowed
         timer->state = QD_TIMER_STATE_BLOCKED;
-        sys_cond_wait(&timer->condition, &lock);
+        sys_cond_wait(&timer->condition, &shard->lock);
     }
 
     // timer may have been rescheduled before wait returns
     const bool need_decref = timer_cancel_LH(timer);
     timer->state = QD_TIMER_STATE_IDLE;
-    if (need_decref)  // was on scheduled list
+    if (need_decref)  // was in the shard heap
         timer_decref_LH(timer);
 
-    sys_mutex_unlock(&lock);
+    sys_mutex_unlock(&shard->lock);
 }
 
 
@@ -283,55 +348,81 @@ void qd_timer_cancel(qd_timer_t *timer)
 
 void qd_timer_initialize(void)
 {
-    sys_mutex_init(&lock);
-    DEQ_INIT(scheduled_timers);
-    time_base = 0;
+    for (int i = 0; i < QD_TIMER_SHARDS; i++) {
+        ZERO(&shards[i]);
+        sys_mutex_init_named(&shards[i].lock, "timer");
+    }
+    sys_atomic_init(&next_shard, 0);
+    sys_mutex_init(&timeout_lock);
+    armed_deadline = QD_TIMER_DISARMED;
 }
 
 
 void qd_timer_finalize(void)
 {
-    sys_mutex_free(&lock);
+    for (int i = 0; i < QD_TIMER_SHARDS; i++) {
+        sys_mutex_free(&shards[i].lock);
+        free(shards[i].heap);
+        shards[i].heap = 0;
+    }
+    sys_atomic_destroy(&next_shard);
+    sys_mutex_free(&timeout_lock);
 }
 
 
 /* Execute all timers that are ready and set up next timeout. */
 void qd_timer_visit(void)
 {
-    sys_mutex_lock(&lock);
-    callback_thread = sys_thread_self();
-    timer_adjust_now_LH();
-    qd_timer_t *timer = DEQ_HEAD(scheduled_timers);
-    while (timer && timer->delta_time == 0) {
-        // Remove timer from scheduled_timers but keep ref_count
-        assert(timer->state == QD_TIMER_STATE_SCHEDULED);
-        // note: still holding scheduled_timers refcount
-        timer_cancel_LH(timer);
-        timer->state = QD_TIMER_STATE_RUNNING;
-        sys_mutex_unlock(&lock);
-
-        /* The callback may reschedule or delete the timer while the lock is
-         * dropped.  Attempting to delete the timer now will cause the caller to
-         * block until the callback is done.
-         */
-        timer->handler(timer->context);
-
-        sys_mutex_lock(&lock);
-        if (timer->state == QD_TIMER_STATE_BLOCKED) {
-            sys_cond_signal(&timer->condition);
-            // expect blocked caller sets timer->state
-        } else if (timer->state == QD_TIMER_STATE_RUNNING) {
-            timer->state = QD_TIMER_STATE_IDLE;
-        }
+    qd_timestamp_t  now    = qd_timer_now();
+    qd_timestamp_t  next   = QD_TIMER_DISARMED;
+    qd_server_t    *server = 0;
+
+    // The proactor timeout has fired, so nothing is armed.  Timers scheduled while this runs arm it themselves.
+    sys_mutex_lock(&timeout_lock);
+    armed_deadline = QD_TIMER_DISARMED;
+    sys_mutex_unlock(&timeout_lock);
+
+    for (int i = 0; i < QD_TIMER_SHARDS; i++) {
+        qd_timer_shard_t *shard = &shards[i];
+
+        sys_mutex_lock(&shard->lock);
+        while (shard->count > 0 && shard->heap[0]->deadline <= now) {
+            qd_timer_t *timer = shard->heap[0];
+
+            // Remove timer from the heap but keep ref_count
+            assert(timer->state == QD_TIMER_STATE_SCHEDULED);
+            // note: still holding the shard heap refcount
+            timer_cancel_LH(timer);
+            timer->state           = QD_TIMER_STATE_RUNNING;
+            timer->callback_thread = sys_thread_self();
+            sys_mutex_unlock(&shard->lock);
+
+            /* The callback may reschedule or delete the timer while the lock is
+             * dropped.  Attempting to delete the timer now will cause the caller to
+             * block until the callback is done.
+             */
+            timer->handler(timer->context);
+
+            sys_mutex_lock(&shard->lock);
+            timer->callback_thread = 0;
+            if (timer->state == QD_TIMER_STATE_BLOCKED) {
+                sys_cond_signal(&timer->condition);
+                // expect blocked caller sets timer->state
+            } else if (timer->state == QD_TIMER_STATE_RUNNING) {
+                timer->state = QD_TIMER_STATE_IDLE;
+            }
 
-        // now drop scheduled_timers reference:
-        timer_decref_LH(timer);
-        timer = DEQ_HEAD(scheduled_timers);
+            // now drop the shard heap reference:
+            timer_decref_LH(timer);
+        }
+        if (shard->count > 0 && shard->heap[0]->deadline < next) {
+            next   = shard->heap[0]->deadline;
+            server = shard->heap[0]->server;
+        }
+        sys_mutex_unlock(&shard->lock);
     }
-    qd_timer_t *first = DEQ_HEAD(scheduled_timers);
-    if (first) {
-        qd_server_timeout(first->server, first->delta_time);
+
+    if (next != QD_TIMER_DISARMED) {
+        timer_arm(server, next, now);
     }
-    callback_thread = 0;
-    sys_mutex_unlock(&lock);
 }
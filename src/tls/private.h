@@ -29,6 +29,7 @@
 
 typedef struct qd_tls_context_t qd_tls_context_t;
 typedef struct qd_proton_config_t qd_proton_config_t;
+typedef struct qd_tls_session_cache_t qd_tls_session_cache_t;
 typedef struct pn_tls_config_t pn_tls_config_t;
 typedef struct pn_tls_t pn_tls_t;
 typedef struct pn_ssl_domain_t pn_ssl_domain_t;
@@ -52,6 +53,29 @@ struct qd_proton_config_t {
     sys_atomic_t     ref_count;  // for parent qd_tls_config_t and all children qd_tls_session_t
 };
 
+/**
+ * TLS session resumption state for an sslProfile, shared by all TLS configurations and sessions created from it.
+ *
+ * Client sessions are started with a session id made of the profile name, ordinal, generation and peer hostname.
+ * Proton caches the negotiated session under that id and resumes it when a later connection starts with the same id,
+ * skipping the full handshake.  The generation is advanced whenever the sslProfile is updated.  That changes every id
+ * and so invalidates all sessions negotiated with the previous certificates.
+ *
+ * It also accumulates the handshake statistics of the sslProfile.  The handshakes of raw connection sessions run in
+ * pn_tls_process() on the I/O thread, the time spent there before the session became secure is the crypto work that
+ * held the thread.
+ */
+struct qd_tls_session_cache_t {
+    sys_mutex_t   lock;
+    sys_atomic_t  ref_count;   // for parent qd_tls_context_t and all children qd_tls_config_t and qd_tls_session_t
+    uint64_t      generation;  // lock must be held
+    uint64_t      handshakes;  // lock must be held: completed client handshakes
+    uint64_t      resumed;     // lock must be held: completed client handshakes that resumed a cached session
+    uint64_t      raw_handshakes;          // lock must be held: completed handshakes of raw connection sessions
+    uint64_t      raw_handshake_usecs;     // lock must be held: total I/O thread time of raw_handshakes
+    uint64_t      raw_handshake_usecs_max; // lock must be held
+};
+
 /**
  * Context for a single per-connection TLS data stream
  */
@@ -66,6 +90,10 @@ struct qd_tls_session_t {
     void                          *user_context;
     qd_tls_session_on_secure_cb_t *on_secure_cb;
 
+    qd_tls_session_cache_t *session_cache;  // raw sessions and AMQP client sessions started with a resumption id, else 0
+    bool                    handshake_recorded;
+    uint64_t                handshake_nsecs;    // raw sessions: time spent in pn_tls_process() until secure
+
     // copies from parent qd_tls_config_t to avoid locking during I/O:
     char                  *ssl_profile_name;
     char                  *uid_format;
@@ -95,6 +123,7 @@ struct qd_tls_config_t {
     char               *ssl_profile_name;
     char               *uid_format;      // lock must be held
     qd_proton_config_t *proton_tls_cfg;  // lock must be held
+    qd_tls_session_cache_t *session_cache;
     qd_tls_type_t       p_type;
     sys_atomic_t        ref_count;
     uint64_t            ordinal;               // lock must be held
@@ -123,6 +152,7 @@ struct qd_tls_context_t {
     char                 *ssl_profile_name;
     qd_ssl2_profile_t     profile;
     qd_tls_config_list_t  tls_configs;
+    qd_tls_session_cache_t *session_cache;
 };
 
 DEQ_DECLARE(qd_tls_context_t, qd_tls_context_list_t);
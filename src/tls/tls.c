@@ -51,6 +51,9 @@ ALLOC_DEFINE(qd_tls_config_t);
 ALLOC_DECLARE(qd_tls_context_t);
 ALLOC_DEFINE(qd_tls_context_t);
 
+ALLOC_DECLARE(qd_tls_session_cache_t);
+ALLOC_DEFINE(qd_tls_session_cache_t);
+
 
 /**
  * Master list of all active TLS context instances. Only accessed by the management thread so no locking necessary.
@@ -63,6 +66,10 @@ static qd_error_t _read_tls_profile(qd_entity_t *entity, qd_ssl2_profile_t *prof
 static void _cleanup_tls_profile(qd_ssl2_profile_t *profile);
 static qd_tls_context_t *_find_tls_context(const char *profile_name);
 static void _tls_context_free(qd_tls_context_t *ctxt);
+static qd_tls_session_cache_t *_session_cache(void);
+static void _session_cache_decref(qd_tls_session_cache_t *cache);
+static char *_session_cache_id(qd_tls_session_cache_t *cache, const char *ssl_profile_name, uint64_t ordinal,
+                               const char *peer_hostname);
 static qd_error_t _update_tls_config(qd_tls_config_t *tls_config, const qd_ssl2_profile_t *profile);
 static qd_error_t _validate_config(const qd_ssl2_profile_t *profile, const char *profile_name, bool is_listener,
                                    bool authenticate_peer);
@@ -118,6 +125,7 @@ QD_EXPORT void *qd_tls_configure_ssl_profile(qd_dispatch_t *qd, qd_entity_t *ent
     DEQ_ITEM_INIT(tls_context);
     DEQ_INIT(tls_context->tls_configs);
     tls_context->ssl_profile_name = name;
+    tls_context->session_cache    = _session_cache();
 
     if (_read_tls_profile(entity, &tls_context->profile) != QD_ERROR_NONE) {
         qd_log(LOG_AGENT, QD_LOG_ERROR, "Unable to create sslProfile '%s': %s", name, qd_error_message());
@@ -167,6 +175,12 @@ QD_EXPORT void *qd_tls_update_ssl_profile(qd_dispatch_t *qd, qd_entity_t *entity
         return 0;
     }
 
+    // Invalidate the cached sessions before any connection can be started with the new certificates. Resuming a
+    // session negotiated with the old certificates would bypass verification against the new ones.
+    sys_mutex_lock(&tls_context->session_cache->lock);
+    tls_context->session_cache->generation++;
+    sys_mutex_unlock(&tls_context->session_cache->lock);
+
     qd_tls_config_t *config = DEQ_HEAD(tls_context->tls_configs);
     while (config) {
         if (_update_tls_config(config, &new_profile) != QD_ERROR_NONE) {
@@ -192,7 +206,25 @@ QD_EXPORT void *qd_tls_update_ssl_profile(qd_dispatch_t *qd, qd_entity_t *entity
  */
 QD_EXPORT qd_error_t qd_entity_refresh_sslProfile(qd_entity_t* entity, void *impl)
 {
-    return QD_ERROR_NONE;
+    qd_tls_context_t *tls_context = (qd_tls_context_t *) impl;
+    assert(tls_context);
+
+    sys_mutex_lock(&tls_context->session_cache->lock);
+    uint64_t handshakes = tls_context->session_cache->handshakes;
+    uint64_t resumed    = tls_context->session_cache->resumed;
+    uint64_t raw        = tls_context->session_cache->raw_handshakes;
+    uint64_t raw_usecs  = tls_context->session_cache->raw_handshake_usecs;
+    uint64_t raw_max    = tls_context->session_cache->raw_handshake_usecs_max;
+    sys_mutex_unlock(&tls_context->session_cache->lock);
+
+    if (qd_entity_set_long(entity, "clientHandshakes", handshakes) == 0
+        && qd_entity_set_long(entity, "resumedHandshakes", resumed) == 0
+        && qd_entity_set_long(entity, "rawHandshakes", raw) == 0
+        && qd_entity_set_long(entity, "rawHandshakeMicroseconds", raw_usecs) == 0
+        && qd_entity_set_long(entity, "maxRawHandshakeMicroseconds", raw_max) == 0) {
+        return QD_ERROR_NONE;
+    }
+    return qd_error_code();
 }
 
 
@@ -290,6 +322,8 @@ qd_tls_config_t *qd_tls_config(const char *ssl_profile_name,
     tls_config->is_listener          = is_listener;
     tls_config->p_type               = p_type;
     tls_config->proton_tls_cfg       = qd_proton_config(pn_raw_config, pn_amqp_config);
+    tls_config->session_cache        = tls_context->session_cache;
+    sys_atomic_inc(&tls_config->session_cache->ref_count);
 
     DEQ_INSERT_TAIL(tls_context->tls_configs, tls_config);
 
@@ -306,6 +340,7 @@ void qd_tls_config_decref(qd_tls_config_t *tls_config)
             // Last reference: can assume it has already been removed from parent tls_context config list and no
             // other threads are accessing it
             qd_proton_config_decref(tls_config->proton_tls_cfg);
+            _session_cache_decref(tls_config->session_cache);
             free(tls_config->ssl_profile_name);
             free(tls_config->uid_format);
             sys_atomic_destroy(&tls_config->ref_count);
@@ -391,6 +426,10 @@ qd_tls_session_t *qd_tls_session_raw(qd_tls_config_t *tls_config, const char *pe
 
     tls_session->proton_tls_cfg = p_cfg;
 
+    // for the handshake statistics of the sslProfile
+    tls_session->session_cache = tls_config->session_cache;
+    sys_atomic_inc(&tls_session->session_cache->ref_count);
+
     // Must hold the proton config lock during the session initialization. Initialization is not thread safe since the
     // proton config is modified during this process.
 
@@ -486,6 +525,21 @@ qd_tls_session_t *qd_tls_session_amqp(qd_tls_config_t *tls_config, pn_transport_
 
     tls_session->proton_tls_cfg = p_cfg;
 
+    // A client session to a known peer can resume the session negotiated by an earlier connection to the same peer
+    // with the same sslProfile, see qd_tls_session_cache_t.
+
+    char *session_id = 0;
+    if (!tls_config->is_listener) {
+        pn_connection_t *pn_conn   = pn_transport_connection(tport);
+        const char      *peer_host = pn_conn ? pn_connection_get_hostname(pn_conn) : 0;
+        if (peer_host && *peer_host) {
+            session_id = _session_cache_id(tls_config->session_cache, tls_session->ssl_profile_name,
+                                           tls_session->ordinal, peer_host);
+            tls_session->session_cache = tls_config->session_cache;
+            sys_atomic_inc(&tls_session->session_cache->ref_count);
+        }
+    }
+
     // Must hold the proton config lock during the session initialization. Initialization is not thread safe since the
     // proton config is modified during this process.
 
@@ -495,11 +549,13 @@ qd_tls_session_t *qd_tls_session_amqp(qd_tls_config_t *tls_config, pn_transport_
     tls_session->pn_amqp = pn_ssl(tport);
     if (!tls_session->pn_amqp) {
         sys_mutex_unlock(&p_cfg->lock);
+        free(session_id);
         qd_error(QD_ERROR_RUNTIME, "Failed to create an AMQP TLS session");
         goto error;
     }
 
-    int rc = pn_ssl_init(tls_session->pn_amqp, p_cfg->pn_amqp, 0);
+    int rc = pn_ssl_init(tls_session->pn_amqp, p_cfg->pn_amqp, session_id);
+    free(session_id);
     if (rc) {
         sys_mutex_unlock(&p_cfg->lock);
         qd_error(QD_ERROR_RUNTIME, "Failed to initialize AMQP TLS session (%d)", rc);
@@ -556,6 +612,7 @@ void qd_tls_session_free(qd_tls_session_t *tls_session)
         sys_mutex_unlock(&tls_session->proton_tls_cfg->lock);
 
         qd_proton_config_decref(tls_session->proton_tls_cfg);
+        _session_cache_decref(tls_session->session_cache);
         free(tls_session->ssl_profile_name);
         free(tls_session->uid_format);
         free_qd_tls_session_t(tls_session);
@@ -644,6 +701,24 @@ uint64_t qd_tls_session_get_ssl_profile_ordinal(const qd_tls_session_t *session)
 }
 
 
+void qd_tls_session_record_handshake(qd_tls_session_t *session)
+{
+    if (!session || !session->session_cache || !session->pn_amqp || session->handshake_recorded)
+        return;
+
+    pn_ssl_resume_status_t status = pn_ssl_resume_status(session->pn_amqp);
+    if (status == PN_SSL_RESUME_UNKNOWN)
+        return;  // handshake not complete
+
+    session->handshake_recorded = true;
+    sys_mutex_lock(&session->session_cache->lock);
+    session->session_cache->handshakes++;
+    if (status == PN_SSL_RESUME_REUSED)
+        session->session_cache->resumed++;
+    sys_mutex_unlock(&session->session_cache->lock);
+}
+
+
 qd_ssl2_profile_t *qd_tls_read_ssl_profile(const char *ssl_profile_name, qd_ssl2_profile_t *profile)
 {
     ASSERT_MGMT_THREAD;
@@ -886,6 +961,46 @@ static qd_tls_context_t *_find_tls_context(const char *profile_name)
 }
 
 
+static qd_tls_session_cache_t *_session_cache(void)
+{
+    qd_tls_session_cache_t *cache = new_qd_tls_session_cache_t();
+    ZERO(cache);
+    sys_mutex_init(&cache->lock);
+    sys_atomic_init(&cache->ref_count, 1);
+    return cache;
+}
+
+
+static void _session_cache_decref(qd_tls_session_cache_t *cache)
+{
+    if (cache) {
+        uint32_t rc = sys_atomic_dec(&cache->ref_count);
+        assert(rc != 0);  // underflow!
+        if (rc == 1) {
+            sys_mutex_free(&cache->lock);
+            sys_atomic_destroy(&cache->ref_count);
+            free_qd_tls_session_cache_t(cache);
+        }
+    }
+}
+
+
+/** Build the id of the resumable session for a client connection. Caller must free() the returned string.
+ */
+static char *_session_cache_id(qd_tls_session_cache_t *cache, const char *ssl_profile_name, uint64_t ordinal,
+                               const char *peer_hostname)
+{
+    sys_mutex_lock(&cache->lock);
+    uint64_t generation = cache->generation;
+    sys_mutex_unlock(&cache->lock);
+
+    size_t len = strlen(ssl_profile_name) + strlen(peer_hostname) + 48;
+    char  *id  = (char *) qd_malloc(len);
+    snprintf(id, len, "%s:%" PRIu64 ":%" PRIu64 ":%s", ssl_profile_name, ordinal, generation, peer_hostname);
+    return id;
+}
+
+
 /** Free the TLS context. Assumes context is no longer on context_list
  */
 static void _tls_context_free(qd_tls_context_t *ctxt)
@@ -899,6 +1014,7 @@ static void _tls_context_free(qd_tls_context_t *ctxt)
         }
         free(ctxt->ssl_profile_name);
         _cleanup_tls_profile(&ctxt->profile);
+        _session_cache_decref(ctxt->session_cache);
         free_qd_tls_context_t(ctxt);
     }
 }
@@ -25,6 +25,7 @@
 #include <proton/tls.h>
 
 #include <inttypes.h>
+#include <time.h>
 
 
 /*
@@ -142,11 +143,78 @@ static inline qd_buffer_t *_pn_buf_desc_take_buffer(pn_raw_buffer_t *pn_desc)
     qd_buffer_t *buffer = (qd_buffer_t *) pn_desc->context;
     assert(buffer);
     buffer->size = pn_desc->size;
-    assert(buffer->size <= QD_BUFFER_SIZE);
+    assert(buffer->size <= buffer->capacity);
     return buffer;
 }
 
 
+// Buffers are passed between the raw connection, the TLS layer and the adaptor in batches of up to this many
+// descriptors per Proton call
+//
+#define TLS_IO_BATCH 16
+
+
+// give fresh empty buffers to the TLS layer for holding output.  give_fn is either
+// pn_tls_give_encrypt_output_buffers or pn_tls_give_decrypt_output_buffers
+//
+static void _give_output_buffers(pn_tls_t *pn_raw, size_t capacity,
+                                 size_t (*give_fn)(pn_tls_t *, pn_raw_buffer_t const *, size_t))
+{
+    pn_raw_buffer_t descs[TLS_IO_BATCH];
+
+    while (capacity > 0) {
+        const size_t count = MIN(capacity, TLS_IO_BATCH);
+        for (size_t i = 0; i < count; ++i) {
+            _pn_buf_desc_give_buffer(&descs[i], qd_buffer());
+        }
+        size_t given = give_fn(pn_raw, descs, count);
+        (void) given;
+        assert(given == count);
+        capacity -= count;
+    }
+}
+
+
+// free the buffers held by the descriptors
+//
+static inline void _free_desc_buffers(pn_raw_buffer_t *descs, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        qd_buffer_t *buf = (qd_buffer_t *) descs[i].context;
+        assert(buf);
+        qd_buffer_free(buf);
+    }
+}
+
+
+static inline uint64_t _now_nsecs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// count a completed handshake in the statistics of the sslProfile. The time is that spent by the I/O thread in the TLS
+// layer, not the round trips to the peer.
+//
+static void _record_handshake(qd_tls_session_t *session, qd_log_module_t log_module, uint64_t conn_id)
+{
+    const uint64_t usecs = session->handshake_nsecs / 1000;
+
+    qd_log(log_module, QD_LOG_DEBUG, "[C%" PRIu64 "] TLS handshake completed: %" PRIu64 " usecs of crypto work",
+           conn_id, usecs);
+    if (session->session_cache && !session->handshake_recorded) {
+        session->handshake_recorded = true;
+        sys_mutex_lock(&session->session_cache->lock);
+        session->session_cache->raw_handshakes++;
+        session->session_cache->raw_handshake_usecs += usecs;
+        session->session_cache->raw_handshake_usecs_max = MAX(session->session_cache->raw_handshake_usecs_max, usecs);
+        sys_mutex_unlock(&session->session_cache->lock);
+    }
+}
+
+
 int qd_tls_session_do_io(qd_tls_session_t                *session,
                           pn_raw_connection_t              *raw_conn,
                           qd_tls_take_output_buffers_cb_t *take_output_cb,
@@ -163,6 +231,7 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
 
     bool work;
     pn_raw_buffer_t pn_buf_desc;
+    pn_raw_buffer_t descs[TLS_IO_BATCH];
     const bool debug = qd_log_enabled(log_module, QD_LOG_DEBUG);
 
     if (input_data_count)
@@ -193,35 +262,22 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
             if (debug) {
                 qd_log_impl(log_module, QD_LOG_DEBUG, __FILE__, __LINE__, "[C%" PRIu64 "] giving %zu encrypt output buffers", conn_id, capacity);
             }
-            while (capacity > 0) {
-                _pn_buf_desc_give_buffer(&pn_buf_desc, qd_buffer());
-                given = pn_tls_give_encrypt_output_buffers(session->pn_raw, &pn_buf_desc, 1);
-                (void) given;
-                assert(given == 1);
-                capacity -= 1;
-            }
+            _give_output_buffers(session->pn_raw, capacity, pn_tls_give_encrypt_output_buffers);
         }
         capacity = pn_tls_get_decrypt_output_buffer_capacity(session->pn_raw);
         if (capacity > 0) {
             if (debug) {
                 qd_log_impl(log_module, QD_LOG_DEBUG, __FILE__, __LINE__, "[C%" PRIu64 "] giving %zu decrypt output buffers", conn_id, capacity);
             }
-            while (capacity > 0) {
-                _pn_buf_desc_give_buffer(&pn_buf_desc, qd_buffer());
-                given = pn_tls_give_decrypt_output_buffers(session->pn_raw, &pn_buf_desc, 1);
-                (void) given;
-                assert(given == 1);
-                capacity -= 1;
-            }
+            _give_output_buffers(session->pn_raw, capacity, pn_tls_give_decrypt_output_buffers);
         }
 
         //
         // discard written output buffers to make room for new output
         //
 
-        while (pn_raw_connection_take_written_buffers(raw_conn, &pn_buf_desc, 1) == 1) {
-            qd_buffer_t *buf = (qd_buffer_t *) pn_buf_desc.context;
-            qd_buffer_free(buf);
+        while ((taken = pn_raw_connection_take_written_buffers(raw_conn, descs, TLS_IO_BATCH)) > 0) {
+            _free_desc_buffers(descs, taken);
         }
 
         //
@@ -244,11 +300,14 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
                                conn_id, out_octets, DEQ_SIZE(ubufs));
                         qd_buffer_t *abuf = DEQ_HEAD(ubufs);
                         while (abuf) {
-                            DEQ_REMOVE_HEAD(ubufs);
-                            _pn_buf_desc_give_buffer(&pn_buf_desc, abuf);
-                            given = pn_tls_give_encrypt_input_buffers(session->pn_raw, &pn_buf_desc, 1);
-                            assert(given == 1);
-                            abuf = DEQ_HEAD(ubufs);
+                            size_t count = 0;
+                            while (abuf && count < TLS_IO_BATCH) {
+                                DEQ_REMOVE_HEAD(ubufs);
+                                _pn_buf_desc_give_buffer(&descs[count++], abuf);
+                                abuf = DEQ_HEAD(ubufs);
+                            }
+                            given = pn_tls_give_encrypt_input_buffers(session->pn_raw, descs, count);
+                            assert(given == count);
                         }
                     } else if (out_octets == 0) {
                         // currently no output, try again later
@@ -290,18 +349,27 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
                 size_t pushed = 0;
                 total_octets  = 0;
                 while (pushed < capacity) {
-                    size_t took = pn_raw_connection_take_read_buffers(raw_conn, &pn_buf_desc, 1);
-                    if (took != 1) {
+                    size_t took = pn_raw_connection_take_read_buffers(raw_conn, descs, MIN(capacity - pushed, TLS_IO_BATCH));
+                    if (took == 0) {
                         // No more read buffers available. Now it is safe to check if the raw connection has closed
                         session->raw_read_drained = pn_raw_connection_is_read_closed(raw_conn);
                         break;
-                    } else if (pn_buf_desc.size) {
-                        total_octets += pn_buf_desc.size;
-                        given = pn_tls_give_decrypt_input_buffers(session->pn_raw, &pn_buf_desc, 1);
-                        assert(given == 1);
-                        ++pushed;
-                    } else {
-                        qd_buffer_free((qd_buffer_t *) pn_buf_desc.context);
+                    }
+                    // pass on the buffers holding data, compacting them to the front of the batch
+                    size_t count = 0;
+                    for (size_t i = 0; i < took; ++i) {
+                        if (descs[i].size) {
+                            total_octets += descs[i].size;
+                            descs[count++] = descs[i];
+                        } else {
+                            qd_buffer_free((qd_buffer_t *) descs[i].context);
+                        }
+                    }
+                    if (count) {
+                        given = pn_tls_give_decrypt_input_buffers(session->pn_raw, descs, count);
+                        assert(given == count);
+                        (void) given;
+                        pushed += count;
                     }
                 }
                 if (pushed > 0) {
@@ -323,14 +391,20 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
         // for other work once the error has occurred so it is safe to continue running this work loop.
 
         if (!session->tls_error) {
-            const bool check_if_secure = session->on_secure_cb && !pn_tls_is_secure(session->pn_raw);
-            int        err             = pn_tls_process(session->pn_raw);
+            const bool     handshaking = !pn_tls_is_secure(session->pn_raw);
+            const uint64_t start       = handshaking ? _now_nsecs() : 0;
+            int            err         = pn_tls_process(session->pn_raw);
+            if (handshaking)
+                session->handshake_nsecs += _now_nsecs() - start;
             if (err) {
                 session->tls_error = true;
                 qd_log(log_module, QD_LOG_DEBUG, "[C%" PRIu64 "] pn_tls_process failed: error=%d", conn_id, err);
-            } else if (check_if_secure && pn_tls_is_secure(session->pn_raw)) {
-                session->on_secure_cb(session, session->user_context);
-                session->on_secure_cb = 0;  // one shot
+            } else if (handshaking && pn_tls_is_secure(session->pn_raw)) {
+                _record_handshake(session, log_module, conn_id);
+                if (session->on_secure_cb) {
+                    session->on_secure_cb(session, session->user_context);
+                    session->on_secure_cb = 0;  // one shot
+                }
             }
         }
 
@@ -346,11 +420,16 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
             if (debug) {
                 qd_log_impl(log_module, QD_LOG_DEBUG, __FILE__, __LINE__, "[C%" PRIu64 "] raw write capacity=%zu bufs", conn_id, capacity);
             }
-            while (pushed < capacity && pn_tls_take_encrypt_output_buffers(session->pn_raw, &pn_buf_desc, 1) == 1) {
-                total_octets += pn_buf_desc.size;
-                given = pn_raw_connection_write_buffers(raw_conn, &pn_buf_desc, 1);
-                assert(given == 1);
-                ++pushed;
+            while (pushed < capacity) {
+                taken = pn_tls_take_encrypt_output_buffers(session->pn_raw, descs, MIN(capacity - pushed, TLS_IO_BATCH));
+                if (taken == 0)
+                    break;
+                for (size_t i = 0; i < taken; ++i) {
+                    total_octets += descs[i].size;
+                }
+                given = pn_raw_connection_write_buffers(raw_conn, descs, taken);
+                assert(given == taken);
+                pushed += taken;
             }
             if (pushed > 0) {
                 work = true;
@@ -383,14 +462,17 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
             assert(input_data_count);
             total_octets = 0;
             taken        = 0;
-            while (pn_tls_take_decrypt_output_buffers(session->pn_raw, &pn_buf_desc, 1) == 1) {
-                qd_buffer_t *abuf = _pn_buf_desc_take_buffer(&pn_buf_desc);
-                if (qd_buffer_size(abuf)) {
-                    total_octets += qd_buffer_size(abuf);
-                    DEQ_INSERT_TAIL(*input_data, abuf);
-                    ++taken;
-                } else {
-                    qd_buffer_free(abuf);
+            size_t count;
+            while ((count = pn_tls_take_decrypt_output_buffers(session->pn_raw, descs, TLS_IO_BATCH)) > 0) {
+                for (size_t i = 0; i < count; ++i) {
+                    qd_buffer_t *abuf = _pn_buf_desc_take_buffer(&descs[i]);
+                    if (qd_buffer_size(abuf)) {
+                        total_octets += qd_buffer_size(abuf);
+                        DEQ_INSERT_TAIL(*input_data, abuf);
+                        ++taken;
+                    } else {
+                        qd_buffer_free(abuf);
+                    }
                 }
             }
             if (taken) {
@@ -408,20 +490,16 @@ int qd_tls_session_do_io(qd_tls_session_t                *session,
         // Release all used TLS input buffers - they are no longer needed
         //
 
-        taken = 0;
-        while (pn_tls_take_encrypt_input_buffers(session->pn_raw, &pn_buf_desc, 1) == 1) {
-            qd_buffer_t *abuf = (qd_buffer_t *) pn_buf_desc.context;
-            assert(abuf);
-            qd_buffer_free(abuf);
-            ++taken;
+        bool released = false;
+        while ((taken = pn_tls_take_encrypt_input_buffers(session->pn_raw, descs, TLS_IO_BATCH)) > 0) {
+            _free_desc_buffers(descs, taken);
+            released = true;
         }
-        while (pn_tls_take_decrypt_input_buffers(session->pn_raw, &pn_buf_desc, 1) == 1) {
-            qd_buffer_t *abuf = (qd_buffer_t *) pn_buf_desc.context;
-            assert(abuf);
-            qd_buffer_free(abuf);
-            ++taken;
+        while ((taken = pn_tls_take_decrypt_input_buffers(session->pn_raw, descs, TLS_IO_BATCH)) > 0) {
+            _free_desc_buffers(descs, taken);
+            released = true;
         }
-        if (taken)
+        if (released)
             work = true;  // more capacity for encrypt/decrypt input buffers
 
     } while (work);
@@ -24,27 +24,124 @@
 #include "qpid/dispatch/iterator.h"
 #include "qpid/dispatch/threading.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 typedef struct {
     qd_hash_handle_t *hash_handle;
     int               maskbit;
     int               link_maskbit;
+    char             *trace_id;     // "<area>/<router-id>", 0 if the router address has no such part
+    uint64_t          fingerprint;
 } qdtm_router_t;
 
 ALLOC_DECLARE(qdtm_router_t);
 ALLOC_DEFINE(qdtm_router_t);
 
+typedef struct {
+    uint64_t       fingerprint;
+    qdtm_router_t *router;
+} qdtm_fingerprint_t;
+
 struct qd_tracemask_t {
-    sys_rwlock_t    lock;
-    qd_hash_t      *hash;
-    qdtm_router_t **router_by_mask_bit;
+    sys_rwlock_t        lock;
+    qd_hash_t          *hash;
+    qdtm_router_t     **router_by_mask_bit;
+    qdtm_fingerprint_t *by_fingerprint;     // sorted by fingerprint, for compact traces
+    int                 fingerprint_count;
 };
 
 
+// The fingerprint held by an entry of qd_tracemask_unknown_trace_id(), false if trace_id is not such an entry
+//
+static bool unknown_trace_id_fingerprint(const char *trace_id, size_t len, uint64_t *fingerprint)
+{
+    if (len != QD_TRACE_UNKNOWN_ID_LEN || trace_id[0] != '#')
+        return false;
+
+    uint64_t value = 0;
+    for (size_t i = 1; i < len; i++) {
+        const char c = trace_id[i];
+        if (c >= '0' && c <= '9')
+            value = (value << 4) | (uint64_t) (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value = (value << 4) | (uint64_t) (c - 'a' + 10);
+        else
+            return false;
+    }
+    *fingerprint = value;
+    return true;
+}
+
+
+uint64_t qd_tracemask_fingerprint(const char *trace_id, size_t len)
+{
+    uint64_t unknown;
+    if (unknown_trace_id_fingerprint(trace_id, len, &unknown))
+        return unknown;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) trace_id[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+/**
+ * The trace list entry of a router from its address as given by the router module: "amqp:/_topo/<area>/<router-id>"
+ * optionally followed by "/<local>".
+ */
+static char *trace_id_from_address(const char *address)
+{
+    const char *start = strstr(address, "_topo/");
+    if (!start)
+        return 0;
+    start += strlen("_topo/");
+    const char *slash = strchr(start, '/');
+    if (!slash || slash == start || slash[1] == '\0')
+        return 0;
+    const char *end = strchr(slash + 1, '/');
+    size_t      len = end ? (size_t) (end - start) : strlen(start);
+    return strndup(start, len);
+}
+
+
+// index of the first entry not below fingerprint
+static int fingerprint_lower_bound_LH(const qd_tracemask_t *tm, uint64_t fingerprint)
+{
+    int low  = 0;
+    int high = tm->fingerprint_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (tm->by_fingerprint[mid].fingerprint < fingerprint)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+
+static qdtm_router_t *router_by_fingerprint_LH(const qd_tracemask_t *tm, uint64_t fingerprint)
+{
+    int idx = fingerprint_lower_bound_LH(tm, fingerprint);
+    if (idx < tm->fingerprint_count && tm->by_fingerprint[idx].fingerprint == fingerprint)
+        return tm->by_fingerprint[idx].router;
+    return 0;
+}
+
+
 qd_tracemask_t *qd_tracemask(void)
 {
     qd_tracemask_t *tm = NEW(qd_tracemask_t);
     tm->hash               = qd_hash(8, 1, 0);
     tm->router_by_mask_bit = NEW_PTR_ARRAY(qdtm_router_t, qd_bitmask_width());
+    tm->by_fingerprint     = NEW_ARRAY(qdtm_fingerprint_t, qd_bitmask_width());
+    tm->fingerprint_count  = 0;
     sys_rwlock_init(&tm->lock);
 
     for (int i = 0; i < qd_bitmask_width(); i++)
@@ -60,6 +157,7 @@ void qd_tracemask_free(qd_tracemask_t *tm)
             qd_tracemask_del_router(tm, i);
     }
     free(tm->router_by_mask_bit);
+    free(tm->by_fingerprint);
 
     qd_hash_free(tm->hash);
     sys_rwlock_free(&tm->lock);
@@ -69,15 +167,30 @@ void qd_tracemask_free(qd_tracemask_t *tm)
 
 void qd_tracemask_add_router(qd_tracemask_t *tm, const char *address, int maskbit)
 {
-    qd_iterator_t *iter = qd_iterator_string(address, ITER_VIEW_ADDRESS_HASH);
+    qd_iterator_storage_t storage;
+    qd_iterator_t *iter = qd_iterator_init_string(&storage, address, ITER_VIEW_ADDRESS_HASH);
     sys_rwlock_wrlock(&tm->lock);
     assert(maskbit < qd_bitmask_width() && tm->router_by_mask_bit[maskbit] == 0);
     if (maskbit < qd_bitmask_width() && tm->router_by_mask_bit[maskbit] == 0) {
         qdtm_router_t *router = new_qdtm_router_t();
         router->maskbit = maskbit;
         router->link_maskbit = -1;
+        router->trace_id     = trace_id_from_address(address);
+        router->fingerprint  = 0;
         qd_hash_insert(tm->hash, iter, router, &router->hash_handle);
         tm->router_by_mask_bit[maskbit] = router;
+
+        // two routers with the same fingerprint cannot be told apart in a compact trace, the first one added is used
+        if (router->trace_id) {
+            router->fingerprint = qd_tracemask_fingerprint(router->trace_id, strlen(router->trace_id));
+            int idx = fingerprint_lower_bound_LH(tm, router->fingerprint);
+            if (idx == tm->fingerprint_count || tm->by_fingerprint[idx].fingerprint != router->fingerprint) {
+                memmove(&tm->by_fingerprint[idx + 1], &tm->by_fingerprint[idx],
+                        (tm->fingerprint_count - idx) * sizeof(qdtm_fingerprint_t));
+                tm->by_fingerprint[idx] = (qdtm_fingerprint_t) {router->fingerprint, router};
+                tm->fingerprint_count++;
+            }
+        }
     }
     sys_rwlock_unlock(&tm->lock);
     qd_iterator_free(iter);
@@ -93,6 +206,13 @@ void qd_tracemask_del_router(qd_tracemask_t *tm, int maskbit)
         qd_hash_remove_by_handle(tm->hash, router->hash_handle);
         qd_hash_handle_free(router->hash_handle);
         tm->router_by_mask_bit[maskbit] = 0;
+        int idx = fingerprint_lower_bound_LH(tm, router->fingerprint);
+        if (router->trace_id && idx < tm->fingerprint_count && tm->by_fingerprint[idx].router == router) {
+            memmove(&tm->by_fingerprint[idx], &tm->by_fingerprint[idx + 1],
+                    (tm->fingerprint_count - idx - 1) * sizeof(qdtm_fingerprint_t));
+            tm->fingerprint_count--;
+        }
+        free(router->trace_id);
         free_qdtm_router_t(router);
     }
     sys_rwlock_unlock(&tm->lock);
@@ -154,3 +274,52 @@ qd_bitmask_t *qd_tracemask_create(qd_tracemask_t *tm, qd_parsed_field_t *traceli
     return bm;
 }
 
+
+qd_bitmask_t *qd_tracemask_create_compact(qd_tracemask_t *tm, const uint64_t *fingerprints, uint32_t count,
+                                          int *ingress_index)
+{
+    qd_bitmask_t *bm = qd_bitmask(0);
+
+    sys_rwlock_rdlock(&tm->lock);
+    for (uint32_t idx = 0; idx < count; idx++) {
+        qdtm_router_t *router = router_by_fingerprint_LH(tm, fingerprints[idx]);
+        if (router) {
+            if (router->link_maskbit >= 0)
+                qd_bitmask_set_bit(bm, router->link_maskbit);
+            if (idx == 0)
+                *ingress_index = router->maskbit;
+        }
+    }
+    sys_rwlock_unlock(&tm->lock);
+    return bm;
+}
+
+
+size_t qd_tracemask_trace_id(qd_tracemask_t *tm, uint64_t fingerprint, char *buffer, size_t size)
+{
+    size_t len = 0;
+
+    sys_rwlock_rdlock(&tm->lock);
+    qdtm_router_t *router = router_by_fingerprint_LH(tm, fingerprint);
+    if (router) {
+        len = strlen(router->trace_id);
+        if (len <= size)
+            memcpy(buffer, router->trace_id, len);
+        else
+            len = 0;
+    }
+    sys_rwlock_unlock(&tm->lock);
+    return len;
+}
+
+
+size_t qd_tracemask_unknown_trace_id(uint64_t fingerprint, char *buffer, size_t size)
+{
+    char entry[QD_TRACE_UNKNOWN_ID_LEN + 1];
+
+    if (size < QD_TRACE_UNKNOWN_ID_LEN)
+        return 0;
+    snprintf(entry, sizeof(entry), "#%016" PRIx64, fingerprint);
+    memcpy(buffer, entry, QD_TRACE_UNKNOWN_ID_LEN);
+    return QD_TRACE_UNKNOWN_ID_LEN;
+}
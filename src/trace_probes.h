@@ -0,0 +1,86 @@
+#ifndef __trace_probes_h__
+#define __trace_probes_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**@file
+ * Static tracepoints (USDT probes) of the "skrouter" provider.
+ *
+ * A probe compiles to a single nop plus an ELF note describing where its arguments are found, so it costs nothing
+ * measurable until a tracer such as bpftrace or perf attaches to it. Probes are only compiled in when <sys/sdt.h>
+ * (systemtap-sdt-devel) is available at build time, otherwise the macros expand to nothing and their arguments are not
+ * evaluated: never pass an expression with side effects.
+ *
+ * The probe names and arguments are a stable interface, documented in docs/notes/tracepoints.md. Add new probes rather
+ * than changing the arguments of an existing one.
+ */
+
+#include "config.h"
+
+#if QD_HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define QD_PROBE(name, ...) STAP_PROBEV(skrouter, name, __VA_ARGS__)
+
+#else
+
+#define QD_PROBE(name, ...) do {} while (0)
+
+#endif
+
+// An AMQP transfer frame was received: (conn_id, link_id, delivery_id, octets, receive_complete)
+// delivery_id is zero until the core delivery has been created, see delivery__create.
+//
+#define QD_PROBE_MESSAGE_RECEIVE(conn_id, link_id, dlv_id, octets, complete) \
+    QD_PROBE(message__receive, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (int64_t) (octets), (int) (complete))
+
+// A core delivery was created by qdr_link_deliver: (conn_id, link_id, delivery_id)
+//
+#define QD_PROBE_DELIVERY_CREATE(conn_id, link_id, dlv_id) \
+    QD_PROBE(delivery__create, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id))
+
+// The core forwarded an incoming delivery: (conn_id, link_id, delivery_id, fanout)
+//
+#define QD_PROBE_FORWARD_MESSAGE(conn_id, link_id, dlv_id, fanout) \
+    QD_PROBE(forward__message, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (int) (fanout))
+
+// An outgoing delivery was queued on its link: (conn_id, link_id, delivery_id, in_delivery_id)
+//
+#define QD_PROBE_FORWARD_DELIVER(conn_id, link_id, dlv_id, in_dlv_id) \
+    QD_PROBE(forward__deliver, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (uint32_t) (in_dlv_id))
+
+// Message octets were written to an outgoing AMQP link: (conn_id, link_id, delivery_id, octets, send_complete)
+//
+#define QD_PROBE_MESSAGE_SEND(conn_id, link_id, dlv_id, octets, complete) \
+    QD_PROBE(message__send, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (int64_t) (octets), (int) (complete))
+
+// A delivery was removed from its link's unsettled list: (conn_id, link_id, delivery_id, disposition)
+//
+#define QD_PROBE_DELIVERY_SETTLE(conn_id, link_id, dlv_id, disposition) \
+    QD_PROBE(delivery__settle, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (uint64_t) (disposition))
+
+// Octets were read from / written to a TCP adaptor raw connection: (conn_id, link_id, delivery_id, octets)
+//
+#define QD_PROBE_TCP_READ(conn_id, link_id, dlv_id, octets) \
+    QD_PROBE(tcp__read, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (uint64_t) (octets))
+#define QD_PROBE_TCP_WRITE(conn_id, link_id, dlv_id, octets) \
+    QD_PROBE(tcp__write, (uint64_t) (conn_id), (uint64_t) (link_id), (uint32_t) (dlv_id), (uint64_t) (octets))
+
+#endif
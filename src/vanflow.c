@@ -30,12 +30,16 @@
 #include "qpid/dispatch/discriminator.h"
 #include "qpid/dispatch/atomic.h"
 #include "qpid/dispatch/error.h"
+#include "qpid/dispatch/intern.h"
+#include "qpid/dispatch/static_assert.h"
 #include "entity.h"
 #include "dispatch_private.h"
 #include "buffer_field_api.h"
+#include "vflow_export.h"
 #include "stdbool.h"
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #define ROUTER_ID_SIZE 6
@@ -63,7 +67,7 @@ typedef struct vflow_attribute_data_t {
     uint32_t          emit_ordinal;
     union {
         uint64_t  uint_val;
-        char     *string_val;
+        char     *string_val;  // interned while the attribute is in a record, see _vflow_set_string_TH
     } value;
 } vflow_attribute_data_t;
 
@@ -147,10 +151,20 @@ static const int   rate_span                   = 10;    // Ten-second rolling av
 
 static sys_atomic_t site_configured;
 
+//
+// Flow record sampling. The router-wide policies apply to flows opened without a sampler of their own. The backlog
+// tracks the length of the vflow thread's work list; while it is above VFLOW_SHED_BACKLOG new sampled records are
+// shed so that the work list cannot grow without bound at very high flow rates.
+//
+#define VFLOW_SHED_BACKLOG 100000
+
+static vflow_sampler_t tport_sampler;
+static vflow_sampler_t app_sampler;
+static sys_atomic_t    work_backlog;
+
 typedef struct {
     qdr_core_t          *router_core;
     sys_mutex_t          lock;
-    sys_mutex_t          id_lock;
     sys_cond_t           condition;
     sys_thread_t        *thread;
     char                *event_address_my;
@@ -177,7 +191,7 @@ typedef struct {
     char                *site_id;
     char                *hostname;
     char                 router_id[ROUTER_ID_SIZE];
-    uint64_t             next_identity;
+    atomic_uint_fast64_t next_identity;
     const char          *router_area;
     const char          *router_name;
     qdr_watch_handle_t   all_address_watch_handle;
@@ -190,6 +204,8 @@ typedef struct {
     bool                 my_address_usable;
     bool                 my_flow_address_usable;
     bool                 my_log_address_usable;
+    bool                 compact_records;
+    vflow_export_t      *export;  // local export ring (router attribute vflowExportFile), or 0
     qd_timer_t          *heartbeat_timer;
     qd_timer_t          *flush_timer;
     uint64_t             next_message_id;
@@ -224,8 +240,12 @@ static uint8_t valid_attribute_types[] = {
     ATTR_UCOUNT, ATTR_STRING, ATTR_STRING, ATTR_UINT,
     ATTR_UINT,   ATTR_UCOUNT, ATTR_UCOUNT, ATTR_UINT,
     ATTR_REF,    ATTR_UINT,   ATTR_STRING, ATTR_STRING,
-    ATTR_STRING, ATTR_STRING,
+    ATTR_STRING, ATTR_STRING, ATTR_UINT,   ATTR_UINT,
+    ATTR_UCOUNT, ATTR_UINT,   ATTR_UINT,   ATTR_STRING,
+    ATTR_UINT,
 };
+// every attribute must have an entry, lookups by attribute type are not range checked
+STATIC_ASSERT_ARRAY_LEN(valid_attribute_types, VFLOW_ATTRIBUTE_GRPC_STATUS + 1)
 
 /**
  * @brief Return the current timestamp in microseconds
@@ -278,10 +298,8 @@ static vflow_attribute_data_t* _vflow_find_attribute(vflow_record_t *record, vfl
  */
 static void _vflow_next_id(vflow_identity_t *identity)
 {
-    sys_mutex_lock(&state->id_lock);
-    identity->record_id = state->next_identity++;
+    identity->record_id = atomic_fetch_add_explicit(&state->next_identity, 1, memory_order_relaxed);
     memcpy(identity->s.source_id, state->router_id, ROUTER_ID_SIZE);
-    sys_mutex_unlock(&state->id_lock);
 }
 
 
@@ -656,6 +674,13 @@ static void _vflow_set_string_TH(vflow_work_t *work, bool discard)
     vflow_attribute_data_t *insert = _vflow_find_attribute(record, work->attribute);
     vflow_attribute_data_t *data;
 
+    //
+    // The values stored in records are interned: identities, protocol names, hosts and the like are shared by many
+    // records.
+    //
+    char *value = (char *) qd_intern(work->value.string_val);
+    free(work->value.string_val);
+
     if (!insert || insert->attribute_type != work->attribute) {
         //
         // The attribute does not exist, create a new one and insert appropriately
@@ -664,7 +689,7 @@ static void _vflow_set_string_TH(vflow_work_t *work, bool discard)
         ZERO(data);
         data->attribute_type   = work->attribute;
         data->emit_ordinal     = record->emit_ordinal;
-        data->value.string_val = work->value.string_val;
+        data->value.string_val = value;
         if (!!insert) {
             DEQ_INSERT_AFTER(record->attributes, data, insert);
         } else {
@@ -674,8 +699,8 @@ static void _vflow_set_string_TH(vflow_work_t *work, bool discard)
         //
         // The attribute already exists, overwrite the value
         //
-        free(insert->value.string_val);
-        insert->value.string_val = work->value.string_val;
+        qd_intern_release(insert->value.string_val);
+        insert->value.string_val = value;
         insert->emit_ordinal     = record->emit_ordinal;
     }
 
@@ -795,6 +820,54 @@ static vflow_work_t *_vflow_work(vflow_work_handler_t handler)
 }
 
 
+//
+// Thread-local staging of work between vflow_batch_begin() and vflow_batch_flush(). The staged list is appended to
+// the vflow thread's work list under a single lock acquisition. Repeated counter and integer updates to the same
+// record attribute are merged while staged, so a connection that updates its octet counters many times in one
+// proactor batch posts one update per counter.
+//
+#define VFLOW_BATCH_MERGE_DEPTH 16  // Staged items searched for an update to merge with
+
+typedef struct vflow_work_batch_t {
+    vflow_work_list_t work;
+    bool              active;
+} vflow_work_batch_t;
+
+static __thread vflow_work_batch_t work_batch;
+
+
+/**
+ * @brief Merge an integer update into a staged update of the same record attribute if possible.
+ *
+ * Only the most recent staged work for the record attribute is considered, and only if it has the same handler, so
+ * merging never reorders a set with respect to an increment.
+ *
+ * @param work Pointer to the update to be merged
+ * @return true if the update was merged and may be freed
+ */
+static bool _vflow_batch_merge(vflow_work_t *work)
+{
+    int           depth  = VFLOW_BATCH_MERGE_DEPTH;
+    vflow_work_t *staged = DEQ_TAIL(work_batch.work);
+    while (staged && depth-- > 0) {
+        if (staged->record == work->record && staged->attribute == work->attribute
+            && (staged->handler == _vflow_set_int_TH || staged->handler == _vflow_inc_int_TH)) {
+            if (staged->handler != work->handler) {
+                return false;
+            }
+            if (work->handler == _vflow_inc_int_TH) {
+                staged->value.int_val += work->value.int_val;
+            } else {
+                staged->value.int_val = work->value.int_val;
+            }
+            return true;
+        }
+        staged = DEQ_PREV(staged);
+    }
+    return false;
+}
+
+
 /**
  * @brief Post work for processing in the vflow thread
  * 
@@ -802,8 +875,18 @@ static vflow_work_t *_vflow_work(vflow_work_handler_t handler)
  */
 static void _vflow_post_work(vflow_work_t *work)
 {
+    if (work_batch.active) {
+        if ((work->handler == _vflow_set_int_TH || work->handler == _vflow_inc_int_TH) && _vflow_batch_merge(work)) {
+            free_vflow_work_t(work);
+        } else {
+            DEQ_INSERT_TAIL(work_batch.work, work);
+        }
+        return;
+    }
+
     sys_mutex_lock(&state->lock);
     DEQ_INSERT_TAIL(state->work_list, work);
+    sys_atomic_set(&work_backlog, DEQ_SIZE(state->work_list));
     bool need_signal = state->sleeping;
     sys_mutex_unlock(&state->lock);
 
@@ -927,7 +1010,7 @@ static void _vflow_free_record_TH(vflow_record_t *record, bool recursive)
     while (!!data) {
         DEQ_REMOVE_HEAD(record->attributes);
         if (valid_attribute_types[data->attribute_type] & (ATTR_STRING | ATTR_TRACE | ATTR_REF)) {
-            free(data->value.string_val);
+            qd_intern_release(data->value.string_val);
         }
         free_vflow_attribute_data_t(data);
         data = DEQ_HEAD(record->attributes);
@@ -1042,6 +1125,13 @@ static const char *_vflow_attribute_name(const vflow_attribute_data_t *data)
     case VFLOW_ATTRIBUTE_PROXY_PORT           : return "proxyPort";
     case VFLOW_ATTRIBUTE_ERROR_LISTENER_SIDE  : return "errorListenerSide";
     case VFLOW_ATTRIBUTE_ERROR_CONNECTOR_SIDE : return "errorConnectorSide";
+    case VFLOW_ATTRIBUTE_WINDOW_RTT           : return "windowRtt";
+    case VFLOW_ATTRIBUTE_CONNECT_LATENCY      : return "connectLatency";
+    case VFLOW_ATTRIBUTE_FLOWS_UNRECORDED     : return "flowsUnrecorded";
+    case VFLOW_ATTRIBUTE_CPU_TIME             : return "cpuTime";
+    case VFLOW_ATTRIBUTE_OBSERVER_SAMPLING    : return "observerSampleInterval";
+    case VFLOW_ATTRIBUTE_GRPC_METHOD          : return "grpcMethod";
+    case VFLOW_ATTRIBUTE_GRPC_STATUS          : return "grpcStatus";
     }
     return "UNKNOWN";
 }
@@ -1104,21 +1194,98 @@ static void _vflow_emit_record_as_log_TH(vflow_record_t *record)
 }
 
 
+//
+// Compact record encoding (router attribute vflowCompactRecords). Events are sent with the subject "RECORD-COMPACT"
+// instead of "RECORD" so that collectors that do not know the encoding ignore them. The body is the same list of
+// record maps, but string values (identities, references and string attributes) are interned per message: the first
+// occurrence of a string is sent inline and assigned the next index in the message's string table, and every later
+// occurrence is sent as that index, a uint. The table holds at most VFLOW_INTERN_MAX strings; strings sent inline
+// after it fills are not assigned an index. Co-records exchanged between routers always use the full encoding.
+//
+#define VFLOW_COMPACT_BATCH_MAX 200
+#define VFLOW_INTERN_MAX        512
+#define VFLOW_INTERN_BUCKETS    1024  // must be a power of two larger than VFLOW_INTERN_MAX
+
+typedef struct vflow_intern_table_t {
+    char     *strings[VFLOW_INTERN_MAX];
+    uint16_t  buckets[VFLOW_INTERN_BUCKETS];  // string index plus one, zero for an empty bucket
+    uint32_t  count;
+} vflow_intern_table_t;
+
+
+static void _vflow_intern_reset(vflow_intern_table_t *table)
+{
+    for (uint32_t i = 0; i < table->count; i++) {
+        free(table->strings[i]);
+    }
+    table->count = 0;
+    memset(table->buckets, 0, sizeof(table->buckets));
+}
+
+
+/**
+ * @brief Insert a string value into a composed record, as an index into the message's string table if the string
+ * has already been sent in this message.
+ *
+ * @param field The field being composed
+ * @param table The string table for the message, or NULL for the full encoding
+ * @param value The string to be inserted
+ */
+static void _vflow_compose_string(qd_composed_field_t *field, vflow_intern_table_t *table, const char *value)
+{
+    if (!table) {
+        qd_compose_insert_string(field, value);
+        return;
+    }
+
+    uint32_t hash = 5381;
+    for (const char *c = value; *c; c++) {
+        hash = ((hash << 5) + hash) + (uint8_t) *c;
+    }
+
+    uint32_t bucket = hash & (VFLOW_INTERN_BUCKETS - 1);
+    while (table->buckets[bucket]) {
+        uint32_t index = table->buckets[bucket] - 1;
+        if (strcmp(table->strings[index], value) == 0) {
+            qd_compose_insert_uint(field, index);
+            return;
+        }
+        bucket = (bucket + 1) & (VFLOW_INTERN_BUCKETS - 1);
+    }
+
+    if (table->count < VFLOW_INTERN_MAX) {
+        table->strings[table->count] = qd_strdup(value);
+        table->buckets[bucket]       = ++table->count;
+    }
+    qd_compose_insert_string(field, value);
+}
+
+
 /**
  * @brief Emit all of the unflushed records as events, batched into message bodies.
  *
  * @param core Pointer to the core module
+ * @param unflushed_records The records to be emitted
+ * @param to_address The address to send the events to
+ * @param compact Use the compact record encoding
  */
 static void _vflow_emit_unflushed_as_events_TH(qdr_core_t *core, vflow_record_list_t *unflushed_records,
-                                               const char *to_address)
+                                               const char *to_address, bool compact)
 {
     if (DEQ_SIZE(*unflushed_records) == 0) {
         return;
     }
 
-    int                  event_count = 0;
-    qd_composed_field_t *field = 0;
-    vflow_record_t      *record = DEQ_HEAD(*unflushed_records);
+    int                   event_count = 0;
+    const int             batch_max   = compact ? VFLOW_COMPACT_BATCH_MAX : EVENT_BATCH_MAX;
+    qd_composed_field_t  *field       = 0;
+    vflow_record_t       *record      = DEQ_HEAD(*unflushed_records);
+    vflow_intern_table_t *table       = 0;
+
+    if (compact) {
+        table = NEW(vflow_intern_table_t);
+        ZERO(table);
+    }
 
     while (!!record) {
         if (field == 0) {
@@ -1130,7 +1297,7 @@ static void _vflow_emit_unflushed_as_events_TH(qdr_core_t *core, vflow_record_li
             qd_compose_insert_long(field, state->next_message_id++);
             qd_compose_insert_null(field);                             // user-id
             qd_compose_insert_string(field, to_address);               // to
-            qd_compose_insert_string(field, "RECORD");                 // subject
+            qd_compose_insert_string(field, compact ? "RECORD-COMPACT" : "RECORD");  // subject
             qd_compose_end_list(field);
 
             //
@@ -1153,18 +1320,22 @@ static void _vflow_emit_unflushed_as_events_TH(qdr_core_t *core, vflow_record_li
 
         qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_IDENTITY);
         if (record->identity.record_id == VFLOW_ID_CUSTOM) {
-            qd_compose_insert_string(field, record->identity.s.full_id);
+            _vflow_compose_string(field, table, record->identity.s.full_id);
         } else {
             char identity[IDENTITY_MAX + 1];
             snprintf(identity, IDENTITY_MAX, "%s:%"PRIu64, record->identity.s.source_id, record->identity.record_id);
-            qd_compose_insert_string(field, identity);
+            _vflow_compose_string(field, table, identity);
         }
 
         vflow_attribute_data_t *data = DEQ_HEAD(record->attributes);
         while (data) {
             if (data->emit_ordinal >= record->emit_ordinal) {
                 qd_compose_insert_uint(field, data->attribute_type);
-                _vflow_compose_attribute(field, data);
+                if (table && (valid_attribute_types[data->attribute_type] & (ATTR_STRING | ATTR_TRACE | ATTR_REF))) {
+                    _vflow_compose_string(field, table, data->value.string_val);
+                } else {
+                    _vflow_compose_attribute(field, data);
+                }
             }
             data = DEQ_NEXT(data);
         }
@@ -1175,7 +1346,7 @@ static void _vflow_emit_unflushed_as_events_TH(qdr_core_t *core, vflow_record_li
         // we have reached the end of the unflushed list, close out the current message.
         //
         event_count++;
-        if (event_count == EVENT_BATCH_MAX || record == DEQ_TAIL(*unflushed_records)) {
+        if (event_count == batch_max || record == DEQ_TAIL(*unflushed_records)) {
             event_count = 0;
 
             //
@@ -1202,13 +1373,18 @@ static void _vflow_emit_unflushed_as_events_TH(qdr_core_t *core, vflow_record_li
 
             //
             // Nullify the field pointer so that a new message will be started on the next
-            // loop iteration.
+            // loop iteration.  The string table is per message.
             //
             field = 0;
+            if (table) {
+                _vflow_intern_reset(table);
+            }
         }
 
         record = DEQ_NEXT_N(UNFLUSHED, record);
     }
+
+    free(table);
 }
 
 
@@ -1275,13 +1451,50 @@ static void _vflow_emit_co_records_TH(qdr_core_t *core, vflow_record_list_t *unf
             const size_t address_length = ROUTER_ID_SIZE + 7;
             char base_source_address[address_length];
             snprintf(base_source_address, address_length, "%s%s:0", co_record_address_prefix, base_source_id);
-            _vflow_emit_unflushed_as_events_TH(core, &working_list, base_source_address);
+            _vflow_emit_unflushed_as_events_TH(core, &working_list, base_source_address, false);
         }
         _vflow_clean_unflushed_TH(&working_list);
     }
 }
 
 
+/**
+ * @brief Write the unflushed records into the local export ring, see vflow_export.h.  The records carry the same
+ * attributes as the events emitted for them.
+ *
+ * @param unflushed_records The records to be exported
+ */
+static void _vflow_export_unflushed_TH(vflow_record_list_t *unflushed_records)
+{
+    char            identity[IDENTITY_MAX + 1];
+    vflow_record_t *record = DEQ_HEAD(*unflushed_records);
+
+    while (!!record) {
+        if (record->identity.record_id == VFLOW_ID_CUSTOM) {
+            vflow_export_begin(state->export, record->record_type, record->identity.s.full_id);
+        } else {
+            snprintf(identity, IDENTITY_MAX, "%s:%"PRIu64, record->identity.s.source_id, record->identity.record_id);
+            vflow_export_begin(state->export, record->record_type, identity);
+        }
+
+        vflow_attribute_data_t *data = DEQ_HEAD(record->attributes);
+        while (data) {
+            if (data->emit_ordinal >= record->emit_ordinal) {
+                if (valid_attribute_types[data->attribute_type] & ATTR_UINT) {
+                    vflow_export_uint(state->export, data->attribute_type, data->value.uint_val);
+                } else if (!!data->value.string_val) {
+                    vflow_export_string(state->export, data->attribute_type, data->value.string_val);
+                }
+            }
+            data = DEQ_NEXT(data);
+        }
+        vflow_export_end(state->export);
+
+        record = DEQ_NEXT_N(UNFLUSHED, record);
+    }
+}
+
+
 /**
  * @brief Emit all of the unflushed records
  * 
@@ -1289,23 +1502,32 @@ static void _vflow_emit_co_records_TH(qdr_core_t *core, vflow_record_list_t *unf
  */
 static void _vflow_flush_TH(qdr_core_t *core, bool no_defer)
 {
+    //
+    // A co-located collector reading the export ring gets every record without subscribing to the event addresses.
+    //
+    if (!!state->export) {
+        _vflow_export_unflushed_TH(&state->unflushed_records[state->current_flush_slot]);
+        _vflow_export_unflushed_TH(&state->unflushed_flow_records[state->current_flush_slot]);
+        _vflow_export_unflushed_TH(&state->unflushed_log_records[state->current_flush_slot]);
+    }
+
     //
     // If there is at least one collector for this router, batch up the
     // unflushed records and send them as events to the collector.
     //
     if (state->my_address_usable) {
         _vflow_emit_unflushed_as_events_TH(core, &state->unflushed_records[state->current_flush_slot],
-                                           state->event_address_my);
+                                           state->event_address_my, state->compact_records);
     }
 
     if (state->my_flow_address_usable) {
         _vflow_emit_unflushed_as_events_TH(core, &state->unflushed_flow_records[state->current_flush_slot],
-                                           state->event_address_my_flow);
+                                           state->event_address_my_flow, state->compact_records);
     }
 
     if (state->my_log_address_usable) {
         _vflow_emit_unflushed_as_events_TH(core, &state->unflushed_log_records[state->current_flush_slot],
-                                           state->event_address_my_log);
+                                           state->event_address_my_log, state->compact_records);
     }
 
     _vflow_emit_co_records_TH(core, &state->unflushed_co_records[state->current_flush_slot]);
@@ -1332,7 +1554,12 @@ static void _vflow_flush_TH(qdr_core_t *core, bool no_defer)
     // Note that we only use the flow_address for event generation.  Only flow records are delete-deferred.
     //
     if (state->my_flow_address_usable) {
-        _vflow_emit_unflushed_as_events_TH(core, &delete_list, state->event_address_my_flow);
+        _vflow_emit_unflushed_as_events_TH(core, &delete_list, state->event_address_my_flow, state->compact_records);
+    }
+
+    if (!!state->export) {
+        _vflow_export_unflushed_TH(&delete_list);
+        vflow_export_flush(state->export);
     }
 
     _vflow_clean_unflushed_TH(&delete_list);
@@ -1365,6 +1592,10 @@ static void _vflow_send_beacon_TH(vflow_work_t *work, bool discard)
         qd_compose_insert_string(field, state->event_address_my);
         qd_compose_insert_symbol(field, "direct");
         qd_compose_insert_string(field, state->command_address);
+        if (state->compact_records) {
+            qd_compose_insert_symbol(field, "recordEncoding");
+            qd_compose_insert_string(field, "compact");
+        }
         qd_compose_end_map(field);
 
         //
@@ -1515,6 +1746,9 @@ static void _vflow_tick_TH(vflow_work_t *work, bool discard)
     static int tick_ordinal = 0;
     if (!discard) {
         state->current_tick++;
+        if (!!state->export && vflow_export_refresh_requested(state->export)) {
+            _vflow_refresh_record_TH(state->local_root);
+        }
         _vflow_flush_TH(state->router_core, false);
         state->current_flush_slot = (state->current_flush_slot + 1) % FLUSH_SLOT_COUNT;
 
@@ -1669,6 +1903,7 @@ static void *_vflow_thread_TH(void *context)
         for (;;) {
             if (!DEQ_IS_EMPTY(state->work_list)) {
                 DEQ_MOVE(state->work_list, local_work_list);
+                sys_atomic_set(&work_backlog, 0);
                 break;
             }
 
@@ -1827,6 +2062,31 @@ vflow_record_t *vflow_start_record_custom_id(vflow_record_type_t record_type, vf
 //=====================================================================================
 // Public Functions
 //=====================================================================================
+void vflow_batch_begin(void)
+{
+    work_batch.active = true;
+}
+
+
+void vflow_batch_flush(void)
+{
+    work_batch.active = false;
+    if (DEQ_IS_EMPTY(work_batch.work)) {
+        return;
+    }
+
+    sys_mutex_lock(&state->lock);
+    DEQ_APPEND(state->work_list, work_batch.work);
+    sys_atomic_set(&work_backlog, DEQ_SIZE(state->work_list));
+    bool need_signal = state->sleeping;
+    sys_mutex_unlock(&state->lock);
+
+    if (need_signal) {
+        sys_cond_signal(&state->condition);
+    }
+}
+
+
 vflow_record_t *vflow_start_record(vflow_record_type_t record_type, vflow_record_t *parent)
 {
     vflow_record_t *record = new_vflow_record_t();
@@ -1852,6 +2112,81 @@ vflow_record_t *vflow_start_record(vflow_record_type_t record_type, vflow_record
 }
 
 
+void vflow_sampler_init(vflow_sampler_t *sampler, vflow_record_type_t record_type, int interval, int rate_max)
+{
+    assert(record_type == VFLOW_RECORD_BIFLOW_TPORT || record_type == VFLOW_RECORD_BIFLOW_APP);
+    const vflow_sampler_t *router_wide = record_type == VFLOW_RECORD_BIFLOW_APP ? &app_sampler : &tport_sampler;
+
+    sampler->interval = interval < 0 ? router_wide->interval : (uint32_t) interval;
+    sampler->rate_max = rate_max < 0 ? router_wide->rate_max : (uint32_t) rate_max;
+    sys_atomic_init(&sampler->seen, 0);
+    sys_atomic_init(&sampler->window_sec, 0);
+    sys_atomic_init(&sampler->window_count, 0);
+    sys_atomic_init(&sampler->unrecorded, 0);
+}
+
+
+void vflow_set_sampling(vflow_record_type_t record_type, uint32_t interval, uint32_t rate_max)
+{
+    vflow_sampler_init(record_type == VFLOW_RECORD_BIFLOW_APP ? &app_sampler : &tport_sampler, record_type,
+                       (int) MIN(interval, INT32_MAX), (int) MIN(rate_max, INT32_MAX));
+}
+
+
+/**
+ * @brief Decide whether a new flow is to be recorded.
+ *
+ * The rate limit uses one-second windows.  Threads that race on a window change may let a few
+ * extra flows through, which is harmless.
+ *
+ * @param sampler The sampling policy
+ * @return true if the flow is to be recorded
+ */
+static bool _vflow_sample(vflow_sampler_t *sampler)
+{
+    if (sys_atomic_get(&work_backlog) > VFLOW_SHED_BACKLOG) {
+        return false;
+    }
+
+    if (sampler->interval > 1 && sys_atomic_inc(&sampler->seen) % sampler->interval != 0) {
+        return false;
+    }
+
+    if (sampler->rate_max > 0) {
+        const uint32_t now_sec = (uint32_t) (_now_in_usec() / 1000000);
+        if (sys_atomic_get(&sampler->window_sec) != now_sec) {
+            sys_atomic_set(&sampler->window_sec, now_sec);
+            sys_atomic_set(&sampler->window_count, 0);
+        }
+        if (sys_atomic_inc(&sampler->window_count) >= sampler->rate_max) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+vflow_record_t *vflow_start_sampled_record(vflow_record_type_t record_type, vflow_record_t *parent, vflow_sampler_t *sampler)
+{
+    if (!parent) {
+        return 0;
+    }
+
+    if (!sampler) {
+        sampler = record_type == VFLOW_RECORD_BIFLOW_APP ? &app_sampler : &tport_sampler;
+    }
+
+    if (!_vflow_sample(sampler)) {
+        sys_atomic_inc(&sampler->unrecorded);
+        vflow_inc_counter(parent, VFLOW_ATTRIBUTE_FLOWS_UNRECORDED, 1);
+        return 0;
+    }
+
+    return vflow_start_record(record_type, parent);
+}
+
+
 vflow_record_t *vflow_start_co_record_iter(vflow_record_type_t record_type, qd_iterator_t *identity_iterator)
 {
     //
@@ -1901,7 +2236,6 @@ void vflow_end_record(vflow_record_t *record)
 void vflow_serialize_identity(const vflow_record_t *record, qd_composed_field_t *field)
 {
     char buffer[IDENTITY_MAX + 1];
-    assert(!!record);
     if (!!record) {
         if (record->identity.record_id == VFLOW_ID_CUSTOM) {
             qd_compose_insert_string(field, record->identity.s.full_id);
@@ -1909,6 +2243,11 @@ void vflow_serialize_identity(const vflow_record_t *record, qd_composed_field_t
             snprintf(buffer, IDENTITY_MAX, "%s:%"PRIu64, record->identity.s.source_id, record->identity.record_id);
             qd_compose_insert_string(field, buffer);
         }
+    } else {
+        //
+        // The flow was not recorded (sampled out), there is no identity to correlate with
+        //
+        qd_compose_insert_null(field);
     }
 }
 
@@ -2096,6 +2435,22 @@ void vflow_set_trace(vflow_record_t *record, qd_message_t *msg)
             }
             *(cursor++) = '\0';
         }
+    } else if (trace_value && qd_message_trace_is_compact(msg)) {
+        uint64_t fingerprints[32];
+        uint32_t trace_count = qd_message_get_trace_fingerprints(msg, fingerprints, 32);
+        trace_count          = MIN(trace_count, 32);
+        if (trace_count > 0) {
+            trace_text_ptr = trace_buffer;
+            size_t len     = 0;
+            for (uint32_t i = 0; i < trace_count && len < MAX_TRACE_BUFFER; i++) {
+                if (i > 0) {
+                    trace_buffer[len++] = '|';
+                }
+                // a router not known here shows as an empty entry
+                len += qd_message_trace_id(fingerprints[i], trace_buffer + len, MAX_TRACE_BUFFER - len);
+            }
+            trace_buffer[len] = '\0';
+        }
     }
 
     vflow_work_t *work = _vflow_work(_vflow_set_string_TH);
@@ -2361,7 +2716,7 @@ static uint64_t _vflow_on_co_record_message(void                    *context,
                 qd_log(LOG_FLOW_LOG, QD_LOG_DEBUG, "Co-Record update received");
                 qd_iterator_t *body_iter = qd_message_field_iterator(msg, QD_FIELD_BODY);
                 if (!!body_iter) {
-                    qd_parsed_field_t *body = qd_parse(body_iter);
+                    qd_parsed_field_t *body = qd_parse_lazy(body_iter);
                     if (qd_parse_ok(body)) {
                         if (qd_parse_is_list(body)) {
                             qd_parsed_field_t *item = qd_field_first_child(body);
@@ -2469,6 +2824,11 @@ static void _vflow_init(qdr_core_t *core, void **adaptor_context)
 
     state->router_area = qdr_core_dispatch(core)->router_area;
     state->router_name = qdr_core_dispatch(core)->router_id;
+    state->compact_records = qdr_core_dispatch(core)->vflow_compact_records;
+    if (!!qdr_core_dispatch(core)->vflow_export_file) {
+        state->export = vflow_export(qdr_core_dispatch(core)->vflow_export_file,
+                                     qdr_core_dispatch(core)->vflow_export_octets);
+    }
 
     switch (qdr_core_dispatch(core)->router_mode) {
     case QD_ROUTER_MODE_STANDALONE: state->router_mode = "standalone"; break;
@@ -2487,7 +2847,7 @@ static void _vflow_init(qdr_core_t *core, void **adaptor_context)
     DEQ_INIT(state->to_delete_records);
 
     sys_mutex_init(&state->lock);
-    sys_mutex_init(&state->id_lock);
+    atomic_init(&state->next_identity, 0);
     sys_cond_init(&state->condition);
     state->thread    = sys_thread(SYS_THREAD_VFLOW, _vflow_thread_TH, core);
     *adaptor_context = core;
@@ -2557,13 +2917,13 @@ static void _vflow_final(void *adaptor_context)
     free(state->command_address);
     free(state->co_record_address);
     free(state->local_router_id);
+    vflow_export_free(state->export);
 
     //
     // Free the condition and lock variables
     //
     sys_cond_free(&state->condition);
     sys_mutex_free(&state->lock);
-    sys_mutex_free(&state->id_lock);
 
     //
     // Free the module state
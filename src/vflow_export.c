@@ -0,0 +1,193 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "vflow_export.h"
+
+#include "qpid/dispatch/ctools.h"
+#include "qpid/dispatch/log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define VFLOW_EXPORT_HEADER_OCTETS 4096
+#define VFLOW_EXPORT_MIN_RING      (64 * 1024)
+#define VFLOW_EXPORT_STRING_MAX    UINT16_MAX
+
+struct vflow_export_t {
+    vflow_export_header_t *header;
+    unsigned char         *ring;
+    size_t                 map_octets;
+    uint64_t               mask;
+    uint64_t               position;  // ahead of header->write_position until the next flush
+    uint64_t               dropped;
+    unsigned char         *record;    // the record being built
+    size_t                 record_octets;
+    size_t                 record_capacity;
+    uint16_t               attribute_count;
+};
+
+
+static void _append(vflow_export_t *exporter, const void *data, size_t octets)
+{
+    if (exporter->record_octets + octets > exporter->record_capacity) {
+        exporter->record_capacity = MAX(exporter->record_capacity * 2, exporter->record_octets + octets);
+        exporter->record          = (unsigned char*) qd_realloc(exporter->record, exporter->record_capacity);
+    }
+    memcpy(exporter->record + exporter->record_octets, data, octets);
+    exporter->record_octets += octets;
+}
+
+
+static void _append_string(vflow_export_t *exporter, const char *value)
+{
+    const size_t len    = strlen(value);
+    uint16_t     octets = (uint16_t) MIN(len, VFLOW_EXPORT_STRING_MAX);
+    _append(exporter, &octets, sizeof(octets));
+    _append(exporter, value, octets);
+}
+
+
+vflow_export_t *vflow_export(const char *path, size_t ring_octets)
+{
+    uint64_t ring = VFLOW_EXPORT_MIN_RING;
+    while (ring < ring_octets)
+        ring <<= 1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0) {
+        qd_log(LOG_FLOW_LOG, QD_LOG_ERROR, "Cannot create the vanflow export file %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    // reserve the blocks up front: a write to a mapped page of a sparse file on a full disk raises SIGBUS
+    const size_t   map_octets = VFLOW_EXPORT_HEADER_OCTETS + ring;
+    int            rc         = posix_fallocate(fd, 0, map_octets);
+    unsigned char *base       = MAP_FAILED;
+    if (rc == 0) {
+        base = (unsigned char*) mmap(0, map_octets, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+            rc = errno;
+    }
+    close(fd);
+    if (rc != 0) {
+        qd_log(LOG_FLOW_LOG, QD_LOG_ERROR, "Cannot map the vanflow export file %s: %s", path, strerror(rc));
+        return 0;
+    }
+
+    vflow_export_t *exporter = NEW(vflow_export_t);
+    ZERO(exporter);
+    exporter->header          = (vflow_export_header_t*) base;
+    exporter->ring            = base + VFLOW_EXPORT_HEADER_OCTETS;
+    exporter->map_octets      = map_octets;
+    exporter->mask            = ring - 1;
+    exporter->record_capacity = 256;
+    exporter->record          = (unsigned char*) qd_malloc(exporter->record_capacity);
+
+    // the file was truncated, the header is all zeroes: the magic goes in last so a collector that maps the file
+    // early never sees a partial header
+    exporter->header->version       = VFLOW_EXPORT_VERSION;
+    exporter->header->header_octets = VFLOW_EXPORT_HEADER_OCTETS;
+    exporter->header->ring_octets   = ring;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(exporter->header->magic, VFLOW_EXPORT_MAGIC, sizeof(VFLOW_EXPORT_MAGIC));
+
+    qd_log(LOG_FLOW_LOG, QD_LOG_INFO, "Exporting vanflow records to %s (%" PRIu64 " octet ring)", path, ring);
+    return exporter;
+}
+
+
+void vflow_export_free(vflow_export_t *exporter)
+{
+    if (exporter) {
+        munmap(exporter->header, exporter->map_octets);
+        free(exporter->record);
+        free(exporter);
+    }
+}
+
+
+void vflow_export_begin(vflow_export_t *exporter, uint16_t record_type, const char *identity)
+{
+    const uint32_t octets = 0;  // set by vflow_export_end
+    const uint16_t count  = 0;
+
+    exporter->record_octets   = 0;
+    exporter->attribute_count = 0;
+    _append(exporter, &octets, sizeof(octets));
+    _append(exporter, &record_type, sizeof(record_type));
+    _append(exporter, &count, sizeof(count));
+    _append_string(exporter, identity);
+}
+
+
+void vflow_export_uint(vflow_export_t *exporter, uint16_t attribute_type, uint64_t value)
+{
+    const uint8_t kind = VFLOW_EXPORT_UINT;
+    _append(exporter, &attribute_type, sizeof(attribute_type));
+    _append(exporter, &kind, sizeof(kind));
+    _append(exporter, &value, sizeof(value));
+    exporter->attribute_count++;
+}
+
+
+void vflow_export_string(vflow_export_t *exporter, uint16_t attribute_type, const char *value)
+{
+    const uint8_t kind = VFLOW_EXPORT_STRING;
+    _append(exporter, &attribute_type, sizeof(attribute_type));
+    _append(exporter, &kind, sizeof(kind));
+    _append_string(exporter, value);
+    exporter->attribute_count++;
+}
+
+
+void vflow_export_end(vflow_export_t *exporter)
+{
+    const uint32_t octets = (uint32_t) exporter->record_octets;
+    memcpy(exporter->record, &octets, sizeof(octets));
+    memcpy(exporter->record + sizeof(octets) + sizeof(uint16_t), &exporter->attribute_count, sizeof(uint16_t));
+
+    const uint64_t read_position = __atomic_load_n(&exporter->header->read_position, __ATOMIC_ACQUIRE);
+    if (exporter->position + octets - read_position > exporter->mask + 1) {
+        __atomic_store_n(&exporter->header->dropped_records, ++exporter->dropped, __ATOMIC_RELAXED);
+        return;
+    }
+
+    const uint64_t offset = exporter->position & exporter->mask;
+    const size_t   first  = MIN(octets, exporter->mask + 1 - offset);
+    memcpy(exporter->ring + offset, exporter->record, first);
+    if (first < octets)
+        memcpy(exporter->ring, exporter->record + first, octets - first);
+    exporter->position += octets;
+}
+
+
+void vflow_export_flush(vflow_export_t *exporter)
+{
+    __atomic_store_n(&exporter->header->write_position, exporter->position, __ATOMIC_RELEASE);
+}
+
+
+bool vflow_export_refresh_requested(vflow_export_t *exporter)
+{
+    return __atomic_exchange_n(&exporter->header->refresh_requested, 0, __ATOMIC_ACQ_REL) != 0;
+}
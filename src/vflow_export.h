@@ -0,0 +1,106 @@
+#ifndef __vflow_export_h__
+#define __vflow_export_h__ 1
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/** @file
+ * Local export of vanflow records through a memory mapped ring file.
+ *
+ * A collector running on the same host (the sidecar in the router's pod) can map the export file and read the
+ * records the vflow thread flushes without the router composing, routing and sending them as AMQP events.  The
+ * file is a vflow_export_header_t followed, at header_octets, by a byte ring of ring_octets (a power of two).
+ *
+ * write_position and read_position count the octets ever written into and consumed from the ring, the data at
+ * position p is at offset header_octets + (p & (ring_octets - 1)) and records wrap around the end of the ring.  The
+ * router advances write_position with a release store after a flush, the collector reads it with an acquire load,
+ * consumes the records up to it and advances read_position.  A record that does not fit in the space the collector
+ * has not consumed is dropped and counted in dropped_records.  Setting refresh_requested to a non-zero value asks
+ * the router to export every record in full again, a collector does that once it has mapped the file.
+ *
+ * All values are in host byte order. A record is:
+ *
+ *   uint32 record octets, this field included
+ *   uint16 record type (vflow_record_type_t)
+ *   uint16 attribute count
+ *   uint16 identity octets, followed by the identity string
+ *   the attributes, each: uint16 attribute type (vflow_attribute_t), uint8 VFLOW_EXPORT_UINT followed by a
+ *   uint64 value or VFLOW_EXPORT_STRING followed by uint16 octets and the string
+ *
+ * The strings are not terminated.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VFLOW_EXPORT_MAGIC   "SKVFLOW"
+#define VFLOW_EXPORT_VERSION 1
+#define VFLOW_EXPORT_UINT    1
+#define VFLOW_EXPORT_STRING  2
+
+typedef struct vflow_export_header_t {
+    char     magic[8];       // VFLOW_EXPORT_MAGIC
+    uint32_t version;
+    uint32_t header_octets;
+    uint64_t ring_octets;
+    uint64_t write_position __attribute__((aligned(64)));  // router
+    uint64_t dropped_records;                              // router
+    uint64_t read_position __attribute__((aligned(64)));   // collector
+    uint32_t refresh_requested;                            // collector
+} vflow_export_header_t;
+
+typedef struct vflow_export_t vflow_export_t;
+
+/**
+ * Create the export file and map it.
+ *
+ * @param path The file, replaced if it exists
+ * @param ring_octets The size of the ring, rounded up to a power of two
+ * @return the export or NULL if the file could not be created, the reason is logged
+ */
+vflow_export_t *vflow_export(const char *path, size_t ring_octets);
+
+/**
+ * Unmap the export file. The file is left in place for the collector.
+ */
+void vflow_export_free(vflow_export_t *exporter);
+
+/**
+ * Start a record. Not thread safe, all records are exported by the vflow thread.
+ */
+void vflow_export_begin(vflow_export_t *exporter, uint16_t record_type, const char *identity);
+void vflow_export_uint(vflow_export_t *exporter, uint16_t attribute_type, uint64_t value);
+void vflow_export_string(vflow_export_t *exporter, uint16_t attribute_type, const char *value);
+
+/**
+ * Copy the record into the ring, or drop it if the collector has not made room for it.
+ */
+void vflow_export_end(vflow_export_t *exporter);
+
+/**
+ * Make the records ended since the last flush visible to the collector.
+ */
+void vflow_export_flush(vflow_export_t *exporter);
+
+/**
+ * True, once, after the collector has asked for all records to be exported again.
+ */
+bool vflow_export_refresh_requested(vflow_export_t *exporter);
+
+#endif
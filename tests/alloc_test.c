@@ -25,7 +25,9 @@
 #include "qpid/dispatch/threading.h"
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 typedef struct {
     int A;
@@ -42,6 +44,17 @@ const qd_alloc_config_t config = {.transfer_batch_size  = TEST_TRANSFER_BATCH_SI
 ALLOC_DECLARE_SAFE(object_t);
 ALLOC_DEFINE_CONFIG_SAFE(object_t, sizeof(object_t), 0, &config);
 
+typedef object_t slab_object_t;
+
+#define TEST_SLAB_SIZE 4096
+const qd_alloc_config_t slab_config = {.transfer_batch_size  = TEST_TRANSFER_BATCH_SIZE,
+                                       .local_free_list_max  = TEST_LOCAL_FREE_LIST_MAX,
+                                       .global_free_list_max = -1,
+                                       .slab_size            = TEST_SLAB_SIZE};
+
+ALLOC_DECLARE(slab_object_t);
+ALLOC_DEFINE_CONFIG(slab_object_t, sizeof(slab_object_t), 0, &slab_config);
+
 static char *check_stats(qd_alloc_stats_t stats, uint64_t ah, uint64_t fh, uint64_t ht, uint64_t rt, uint64_t rg)
 {
     if (stats.total_alloc_from_heap != ah)
@@ -197,6 +210,233 @@ static char *test_threaded_alloc(void *context)
     return result;
 }
 
+//
+// Producer/consumer test: objects allocated by one thread and freed by another
+// must be handed back to the allocating thread's pool.
+//
+
+#define HANDOFF_COUNT (TEST_TRANSFER_BATCH_SIZE * 2)
+
+static object_t *handoff_objects[HANDOFF_COUNT];
+
+static void *handoff_consumer_thread(void *arg)
+{
+    for (int i = 0; i < HANDOFF_COUNT; ++i) {
+        free_object_t(handoff_objects[i]);
+        handoff_objects[i] = 0;
+    }
+    return (void *) 0;
+}
+
+static void *handoff_producer_thread(void *arg)
+{
+    char **result = (char **) arg;
+
+    // allocating whole batches leaves the producer's local free list empty
+    for (int i = 0; i < HANDOFF_COUNT; ++i)
+        handoff_objects[i] = new_object_t();
+
+    uint64_t reclaimed = alloc_stats_object_t().remote_frees_reclaimed;
+
+    sys_thread_t *consumer = sys_thread(SYS_THREAD_PROACTOR, handoff_consumer_thread, 0);
+    sys_thread_join(consumer);
+    sys_thread_free(consumer);
+
+    object_t *obj = new_object_t();
+    reclaimed     = alloc_stats_object_t().remote_frees_reclaimed - reclaimed;
+    free_object_t(obj);
+
+#if !defined(QD_DISABLE_MEMORY_POOL)
+    if (reclaimed != HANDOFF_COUNT) {
+        fprintf(stderr, "ERROR: expected %d objects reclaimed from the consumer, got %" PRIu64 "\n", HANDOFF_COUNT,
+                reclaimed);
+        *result = "Remotely freed objects were not returned to the allocating thread";
+    }
+#endif
+    return (void *) 0;
+}
+
+static char *test_remote_free_handoff(void *context)
+{
+    char *result = 0;
+
+    sys_thread_t *producer = sys_thread(SYS_THREAD_PROACTOR, handoff_producer_thread, (void *) &result);
+    sys_thread_join(producer);
+    sys_thread_free(producer);
+
+    return result;
+}
+
+//
+// Retire test: when a thread exits its pool is retired.  The items on its free
+// list and inbox go to the global pool, and the ones still in use are freed to
+// the freeing thread's pool rather than the dead inbox.
+//
+
+#define RETIRE_REMOTE_FREES 3
+
+static object_t *retire_objects[HANDOFF_COUNT];
+
+static void *retire_consumer_thread(void *arg)
+{
+    for (int i = 1; i <= RETIRE_REMOTE_FREES; ++i) {
+        free_object_t(retire_objects[i]);
+        retire_objects[i] = 0;
+    }
+    return (void *) 0;
+}
+
+static void *retire_producer_thread(void *arg)
+{
+    for (int i = 0; i < HANDOFF_COUNT; ++i)
+        retire_objects[i] = new_object_t();
+
+    // one item on the local free list, the consumer leaves some on the inbox
+    free_object_t(retire_objects[0]);
+    retire_objects[0] = 0;
+
+    sys_thread_t *consumer = sys_thread(SYS_THREAD_PROACTOR, retire_consumer_thread, 0);
+    sys_thread_join(consumer);
+    sys_thread_free(consumer);
+    return (void *) 0;
+}
+
+static char *test_retire_thread_pool(void *context)
+{
+    char    *result = 0;
+    uint64_t held   = alloc_stats_object_t().held_by_threads;
+
+    sys_thread_t *producer = sys_thread(SYS_THREAD_PROACTOR, retire_producer_thread, 0);
+    sys_thread_join(producer);
+    sys_thread_free(producer);
+
+#if !defined(QD_DISABLE_MEMORY_POOL)
+    // only the objects still in use are held by threads
+    held = alloc_stats_object_t().held_by_threads - held;
+    if (held != HANDOFF_COUNT - 1 - RETIRE_REMOTE_FREES) {
+        fprintf(stderr, "ERROR: expected %d objects held by threads after retiring the producer, got %" PRIu64 "\n",
+                HANDOFF_COUNT - 1 - RETIRE_REMOTE_FREES, held);
+        result = "The pool of an exited thread was not retired";
+    }
+#endif
+
+    for (int i = 0; i < HANDOFF_COUNT; ++i) {
+        free_object_t(retire_objects[i]);
+        retire_objects[i] = 0;
+    }
+    return result;
+}
+
+//
+// Trim test: global free list items that stay unused for a whole trim window
+// are released, except for one transfer batch.
+//
+static char *test_trim_idle(void *context)
+{
+    object_t *objects[TEST_GLOBAL_FREE_LIST_MAX * 3];
+    char     *result = 0;
+
+    for (int i = 0; i < TEST_GLOBAL_FREE_LIST_MAX * 3; ++i)
+        objects[i] = new_object_t();
+    for (int i = 0; i < TEST_GLOBAL_FREE_LIST_MAX * 3; ++i)
+        free_object_t(objects[i]);
+
+    // the first sample still covers the allocations above, which drained the
+    // global pool
+    for (int i = 0; i < QD_ALLOC_TRIM_WINDOW + 1; ++i)
+        qd_alloc_trim();
+
+#if !defined(QD_DISABLE_MEMORY_POOL)
+    qd_alloc_stats_t stats  = alloc_stats_object_t();
+    uint64_t         cached = stats.total_alloc_from_heap - stats.total_free_to_heap - stats.held_by_threads;
+    if (cached != TEST_TRANSFER_BATCH_SIZE) {
+        fprintf(stderr, "ERROR: expected %d objects left in the global pool after trim, got %" PRIu64 "\n",
+                TEST_TRANSFER_BATCH_SIZE, cached);
+        result = "Idle objects were not trimmed from the global pool";
+    }
+#endif
+    return result;
+}
+
+static char *test_slab_refill(void *context)
+{
+    slab_object_t *objects[TEST_TRANSFER_BATCH_SIZE];
+    char          *result = 0;
+
+    for (int i = 0; i < TEST_TRANSFER_BATCH_SIZE; ++i)
+        objects[i] = new_slab_object_t();
+
+#if !defined(QD_DISABLE_MEMORY_POOL)
+    // a single slab refill carves many items and parks the surplus on the global pool
+    qd_alloc_stats_t stats = alloc_stats_slab_object_t();
+    if (stats.total_alloc_from_heap <= TEST_TRANSFER_BATCH_SIZE || stats.held_by_threads != TEST_TRANSFER_BATCH_SIZE)
+        result = "Slab refill did not carve a full slab";
+
+    for (int i = 1; !result && i < TEST_TRANSFER_BATCH_SIZE; ++i) {
+        ptrdiff_t distance = (char *) objects[i] - (char *) objects[0];
+        if (distance < -TEST_SLAB_SIZE || distance > TEST_SLAB_SIZE)
+            result = "Slab items are not contiguous";
+    }
+#endif
+
+    for (int i = 0; i < TEST_TRANSFER_BATCH_SIZE; ++i)
+        free_slab_object_t(objects[i]);
+    return result;
+}
+
+static char *test_profile_samples(void *context)
+{
+    object_t *objects[4];
+    char     *result = 0;
+
+    qd_alloc_set_profile_rate(1);
+    for (int i = 0; i < 4; ++i)
+        objects[i] = new_object_t();
+    qd_alloc_set_profile_rate(0);
+
+    char *report = qd_alloc_profile_report(&__desc_object_t, 10);
+    if (!report || !strstr(report, "4 samples"))
+        result = "Sampled allocations missing from the profile report";
+    free(report);
+
+    for (int i = 0; i < 4; ++i)
+        free_object_t(objects[i]);
+
+    report = qd_alloc_profile_report(&__desc_object_t, 10);
+    if (!result && report)
+        result = "Freed allocations remain in the profile report";
+    free(report);
+
+    return result;
+}
+
+static char *test_memory_state(void *context)
+{
+    // pressure samples and the state each should leave the router in
+    static const struct {
+        int               pressure;
+        qd_memory_state_t state;
+    } steps[] = {
+        {10, QD_MEMORY_NORMAL},
+        {60, QD_MEMORY_SHRINK_Q2},
+        {47, QD_MEMORY_SHRINK_Q2},  // within the hysteresis band
+        {96, QD_MEMORY_REFUSE_CONNECTIONS},
+        {91, QD_MEMORY_REFUSE_CONNECTIONS},
+        {89, QD_MEMORY_HOLD_CREDIT},
+        {20, QD_MEMORY_NORMAL},
+    };
+    char *result = 0;
+
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]) && !result; ++i) {
+        if (qd_alloc_update_memory_state(steps[i].pressure) != steps[i].state
+            || qd_alloc_memory_state() != steps[i].state)
+            result = "Unexpected memory state";
+    }
+
+    qd_alloc_update_memory_state(0);
+    return result;
+}
+
 int alloc_tests(void)
 {
     int result = 0;
@@ -205,6 +445,12 @@ int alloc_tests(void)
     TEST_CASE(test_alloc_basic, 0);  // must be first: expects counters to be zeroed
     TEST_CASE(test_safe_references, 0);
     TEST_CASE(test_threaded_alloc, 0);
+    TEST_CASE(test_remote_free_handoff, 0);
+    TEST_CASE(test_retire_thread_pool, 0);
+    TEST_CASE(test_trim_idle, 0);
+    TEST_CASE(test_slab_refill, 0);
+    TEST_CASE(test_profile_samples, 0);
+    TEST_CASE(test_memory_state, 0);
 
     return result;
 }
@@ -20,10 +20,12 @@
 #define _GNU_SOURCE
 #include "qpid/dispatch/buffer.h"
 #include "buffer_field_api.h"
+#include "spool.h"
 
 #include "test_case.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -126,6 +128,126 @@ static char *test_buffer_list_append(void *context)
 }
 
 
+static char *test_buffer_size_classes(void *context)
+{
+    static const qd_buffer_class_t classes[] = {QD_BUFFER_CLASS_LARGE, QD_BUFFER_CLASS_SMALL, QD_BUFFER_CLASS_DEFAULT};
+    const size_t capacities[] = {QD_BUFFER_LARGE_SIZE, QD_BUFFER_SMALL_SIZE, QD_BUFFER_SIZE};
+    qd_buffer_list_t list = DEQ_EMPTY;
+    const int count = sizeof(classes) / sizeof(classes[0]);
+
+    //
+    // Fill a list of mixed classes one byte short of full so the final append has to spill
+    // into a new buffer.
+    //
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        qd_buffer_t *buf = qd_buffer_sized(classes[i]);
+        if (qd_buffer_capacity(buf) != capacities[i]) return "Wrong capacity for size class";
+        size_t fill = capacities[i] - (i == count - 1 ? 1 : 0);
+        memset(qd_buffer_cursor(buf), 'a' + i, fill);
+        qd_buffer_insert(buf, fill);
+        total += fill;
+        DEQ_INSERT_TAIL(list, buf);
+    }
+    qd_buffer_list_append(&list, (const uint8_t*) pattern, pattern_len);
+    total += pattern_len;
+    if (qd_buffer_list_length(&list) != total) return "Wrong length for mixed list";
+    if (DEQ_TAIL(list)->size_class != QD_BUFFER_CLASS_DEFAULT) return "Append should add default buffers";
+
+    qd_buffer_list_t copy;
+    if (qd_buffer_list_clone(&copy, &list) != total) return "Clone of mixed list failed";
+    qd_buffer_t *src = DEQ_HEAD(list);
+    qd_buffer_t *dst = DEQ_HEAD(copy);
+    while (src && dst) {
+        if (src->size_class != dst->size_class) return "Clone should preserve size class";
+        if (qd_buffer_size(src) != qd_buffer_size(dst)
+            || memcmp(qd_buffer_base(src), qd_buffer_base(dst), qd_buffer_size(src)) != 0)
+            return "Clone content mismatch";
+        src = DEQ_NEXT(src);
+        dst = DEQ_NEXT(dst);
+    }
+    if (src || dst) return "Clone has wrong buffer count";
+
+    qd_buffer_list_free_buffers(&list);
+    qd_buffer_list_free_buffers(&copy);
+    return 0;
+}
+
+
+static char *test_buffer_list_clone_shared(void *context)
+{
+    qd_buffer_list_t list;
+    fill_buffer(&list, (unsigned char *)pattern, pattern_len);
+
+    qd_buffer_list_t copy;
+    unsigned int len = qd_buffer_list_clone_shared(&copy, &list);
+    if (len != pattern_len) return "Shared clone failed";
+    if (DEQ_SIZE(copy) != DEQ_SIZE(list)) return "Shared clone should have one buffer per source buffer";
+    if (qd_buffer_base(DEQ_HEAD(copy)) != qd_buffer_base(DEQ_HEAD(list))) return "Shared clone should not copy";
+
+    // neither side may be appended to in place while shared:
+    if (qd_buffer_capacity(DEQ_TAIL(list)) != 0 || qd_buffer_capacity(DEQ_TAIL(copy)) != 0)
+        return "Shared buffers must report zero capacity";
+    size_t before = DEQ_SIZE(list);
+    qd_buffer_list_append(&list, (const uint8_t*) "!", 1);
+    if (DEQ_SIZE(list) != before + 1) return "Append to shared list should add a buffer";
+
+    // a share of a share, at an offset, refers to the original data:
+    const size_t offset = qd_buffer_size(DEQ_HEAD(copy)) > 1 ? 1 : 0;
+    qd_buffer_t *share2 = qd_buffer_share(DEQ_HEAD(copy), offset);
+    if (qd_buffer_size(share2) != qd_buffer_size(DEQ_HEAD(copy)) - offset) return "Wrong size for offset share";
+    if (*qd_buffer_base(share2) != (unsigned char) pattern[offset]) return "Wrong data for offset share";
+
+    // the data outlives the source list:
+    qd_buffer_list_free_buffers(&list);
+    if (!compare_buffer(&copy, (unsigned char *)pattern, pattern_len)) return "Shared data corrupted";
+    qd_buffer_list_free_buffers(&copy);
+    if (*qd_buffer_base(share2) != (unsigned char) pattern[offset]) return "Data released while still shared";
+    qd_buffer_free(share2);
+    return 0;
+}
+
+
+static char *test_buffer_spool(void *context)
+{
+    const char *tmpdir = getenv("TMPDIR");
+    qd_spool_configure(tmpdir ? tmpdir : "/tmp", 0);
+
+    qd_buffer_list_t list;
+    fill_buffer(&list, (unsigned char *)pattern, pattern_len);
+    qd_buffer_list_t spooled = DEQ_EMPTY;
+    while (!DEQ_IS_EMPTY(list)) {
+        qd_buffer_t *buf = DEQ_HEAD(list);
+        DEQ_REMOVE_HEAD(list);
+        buf = qd_spool_buffer(buf);
+        DEQ_INSERT_TAIL(spooled, buf);
+    }
+
+    char *result = 0;
+    if (!qd_spool_wanted(1, false))
+        result = "Spooling should be wanted above the threshold";
+    else if (DEQ_HEAD(spooled)->size_class != QD_BUFFER_CLASS_EXTERNAL)
+        result = "Buffer was not spooled";
+    else if (qd_buffer_capacity(DEQ_TAIL(spooled)) != 0)
+        result = "Spooled buffers must report zero capacity";
+    else if (!compare_buffer(&spooled, (unsigned char *)pattern, pattern_len))
+        result = "Spooled data corrupted";
+
+    // a share keeps the spooled data mapped:
+    qd_buffer_t *share = qd_buffer_share(DEQ_TAIL(spooled), 0);
+    qd_spool_prefetch(DEQ_TAIL(spooled));
+    qd_buffer_list_free_buffers(&spooled);
+    if (!result && *qd_buffer_base(share) != (unsigned char) pattern[pattern_len - qd_buffer_size(share)])
+        result = "Spooled data released while still shared";
+    qd_buffer_free(share);
+
+    qd_spool_finalize();
+    if (!result && qd_spool_wanted(1, false))
+        result = "Spooling should be disabled";
+    return result;
+}
+
+
 static char *test_buffer_field(void *context)
 {
     char *result = 0;
@@ -431,6 +553,9 @@ int buffer_tests(void)
 
     TEST_CASE(test_buffer_list_clone, 0);
     TEST_CASE(test_buffer_list_append, 0);
+    TEST_CASE(test_buffer_size_classes, 0);
+    TEST_CASE(test_buffer_list_clone_shared, 0);
+    TEST_CASE(test_buffer_spool, 0);
     TEST_CASE(test_buffer_field, 0);
     TEST_CASE(test_buffer_field_iterator, 0);
 
@@ -0,0 +1,278 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "qpid/dispatch/alloc_pool.h"
+}  // extern "C"
+
+// Three pool types sized like a small core object, a delivery and a buffer so that the default configurations
+// (small and big) are both exercised
+struct bm_small_t {
+    char data[48];
+};
+struct bm_medium_t {
+    char data[256];
+};
+struct bm_large_t {
+    char data[2048];
+};
+
+ALLOC_DECLARE(bm_small_t);
+ALLOC_DECLARE(bm_medium_t);
+ALLOC_DECLARE(bm_large_t);
+ALLOC_DEFINE(bm_small_t);
+ALLOC_DEFINE(bm_medium_t);
+ALLOC_DEFINE(bm_large_t);
+
+/// Allocations (and frees) each thread performs per benchmark iteration, a multiple of the sizes below
+static const int OPS_PER_THREAD = 1 << 16;
+
+/// Items a thread holds at once in the same-thread scenario, stays within the local free list
+static const int SMALL_WORKING_SET = 16;
+
+/// Items a thread holds at once in the bursty scenario, many times the local free list so every burst refills from
+/// and returns batches to the global pool
+static const int BURST_SIZE = 4096;
+
+/// Items handed from a producer to its consumer at once
+static const int HANDOFF_CHUNK = 256;
+
+/// Items of each type a thread holds at once in the mixed scenario, and the rounds that make up about OPS_PER_THREAD
+static const int MIXED_PER_TYPE = 128;
+static const int MIXED_ROUNDS   = OPS_PER_THREAD / (3 * MIXED_PER_TYPE);
+
+/// Reports the batches moved between the thread pools and the global pool, each one is a global lock acquisition
+static void report_rebalances(benchmark::State &state, const qd_alloc_stats_t &before, const qd_alloc_stats_t &after,
+                              int64_t ops)
+{
+    const double to_threads = after.batches_rebalanced_to_threads - before.batches_rebalanced_to_threads;
+    const double to_global  = after.batches_rebalanced_to_global - before.batches_rebalanced_to_global;
+    state.counters["to_threads"] = benchmark::Counter(to_threads, benchmark::Counter::kIsRate);
+    state.counters["to_global"]  = benchmark::Counter(to_global, benchmark::Counter::kIsRate);
+    state.counters["locks/kop"]  = ops ? 1000.0 * (to_threads + to_global) / ops : 0;
+}
+
+static qd_alloc_stats_t sum_stats(const qd_alloc_stats_t &a, const qd_alloc_stats_t &b)
+{
+    qd_alloc_stats_t sum = a;
+    sum.batches_rebalanced_to_threads += b.batches_rebalanced_to_threads;
+    sum.batches_rebalanced_to_global  += b.batches_rebalanced_to_global;
+    return sum;
+}
+
+/// Runs body(thread_index) on the given number of threads and waits for all of them
+template <typename F>
+static void run_threads(int threads, F body)
+{
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back(body, t);
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+/// Every thread allocates and frees a small working set, the steady state of a thread that owns its objects
+static void BM_AllocPoolSameThread(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int threads             = state.range(0);
+        const qd_alloc_stats_t before = alloc_stats_bm_small_t();
+
+        for (auto _ : state) {
+            run_threads(threads, [](int) {
+                bm_small_t *items[SMALL_WORKING_SET];
+                for (int i = 0; i < OPS_PER_THREAD; i += SMALL_WORKING_SET) {
+                    for (auto &item : items) {
+                        item = new_bm_small_t();
+                    }
+                    benchmark::DoNotOptimize(items);
+                    for (auto &item : items) {
+                        free_bm_small_t(item);
+                    }
+                }
+            });
+        }
+
+        const int64_t ops = state.iterations() * threads * OPS_PER_THREAD;
+        state.SetItemsProcessed(ops);
+        report_rebalances(state, before, alloc_stats_bm_small_t(), ops);
+    }).join();
+}
+
+BENCHMARK(BM_AllocPoolSameThread)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
+
+/// Each producer thread allocates and hands the items to its own consumer thread which frees them, the pattern of
+/// deliveries created on one I/O thread and settled on another
+static void BM_AllocPoolProducerConsumer(benchmark::State &state)
+{
+    struct Handoff {
+        std::mutex mut;
+        std::condition_variable cv;
+        std::deque<std::vector<bm_medium_t *>> chunks;
+    };
+
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int pairs               = state.range(0);
+        const qd_alloc_stats_t before = alloc_stats_bm_medium_t();
+
+        for (auto _ : state) {
+            std::vector<Handoff> handoffs(pairs);
+            run_threads(pairs * 2, [&handoffs](int t) {
+                Handoff &handoff = handoffs[t / 2];
+                if (t % 2 == 0) {
+                    for (int i = 0; i < OPS_PER_THREAD; i += HANDOFF_CHUNK) {
+                        std::vector<bm_medium_t *> chunk(HANDOFF_CHUNK);
+                        for (auto &item : chunk) {
+                            item = new_bm_medium_t();
+                        }
+                        std::lock_guard<std::mutex> lock(handoff.mut);
+                        handoff.chunks.push_back(std::move(chunk));
+                        handoff.cv.notify_one();
+                    }
+                } else {
+                    for (int i = 0; i < OPS_PER_THREAD; i += HANDOFF_CHUNK) {
+                        std::vector<bm_medium_t *> chunk;
+                        {
+                            std::unique_lock<std::mutex> lock(handoff.mut);
+                            handoff.cv.wait(lock, [&handoff] { return !handoff.chunks.empty(); });
+                            chunk = std::move(handoff.chunks.front());
+                            handoff.chunks.pop_front();
+                        }
+                        for (auto item : chunk) {
+                            free_bm_medium_t(item);
+                        }
+                    }
+                }
+            });
+        }
+
+        const int64_t ops = state.iterations() * pairs * OPS_PER_THREAD;
+        state.SetItemsProcessed(ops);
+        report_rebalances(state, before, alloc_stats_bm_medium_t(), ops);
+    }).join();
+}
+
+BENCHMARK(BM_AllocPoolProducerConsumer)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 8);
+
+/// Every thread repeatedly allocates a burst far larger than its local free list and frees it again, so that each
+/// burst is refilled from and returned to the global pool
+static void BM_AllocPoolBurstyRefill(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int threads             = state.range(0);
+        const qd_alloc_stats_t before = alloc_stats_bm_small_t();
+
+        for (auto _ : state) {
+            run_threads(threads, [](int) {
+                std::vector<bm_small_t *> burst(BURST_SIZE);
+                for (int i = 0; i < OPS_PER_THREAD; i += BURST_SIZE) {
+                    for (auto &item : burst) {
+                        item = new_bm_small_t();
+                    }
+                    for (auto item : burst) {
+                        free_bm_small_t(item);
+                    }
+                }
+            });
+        }
+
+        const int64_t ops = state.iterations() * threads * OPS_PER_THREAD;
+        state.SetItemsProcessed(ops);
+        report_rebalances(state, before, alloc_stats_bm_small_t(), ops);
+    }).join();
+}
+
+BENCHMARK(BM_AllocPoolBurstyRefill)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
+
+/// Every thread interleaves bursts of three pool types of different sizes, the way a message transfer touches the
+/// message, delivery and buffer pools together
+static void BM_AllocPoolMixedTypes(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int threads = state.range(0);
+        const qd_alloc_stats_t before =
+            sum_stats(sum_stats(alloc_stats_bm_small_t(), alloc_stats_bm_medium_t()), alloc_stats_bm_large_t());
+
+        for (auto _ : state) {
+            run_threads(threads, [](int) {
+                std::vector<bm_small_t *> small(MIXED_PER_TYPE);
+                std::vector<bm_medium_t *> medium(MIXED_PER_TYPE);
+                std::vector<bm_large_t *> large(MIXED_PER_TYPE);
+                for (int round = 0; round < MIXED_ROUNDS; ++round) {
+                    for (int j = 0; j < MIXED_PER_TYPE; ++j) {
+                        small[j]  = new_bm_small_t();
+                        medium[j] = new_bm_medium_t();
+                        large[j]  = new_bm_large_t();
+                    }
+                    for (int j = 0; j < MIXED_PER_TYPE; ++j) {
+                        free_bm_large_t(large[j]);
+                        free_bm_small_t(small[j]);
+                        free_bm_medium_t(medium[j]);
+                    }
+                }
+            });
+        }
+
+        const qd_alloc_stats_t after =
+            sum_stats(sum_stats(alloc_stats_bm_small_t(), alloc_stats_bm_medium_t()), alloc_stats_bm_large_t());
+        const int64_t ops = state.iterations() * threads * MIXED_ROUNDS * 3 * MIXED_PER_TYPE;
+        state.SetItemsProcessed(ops);
+        report_rebalances(state, before, after, ops);
+    }).join();
+}
+
+BENCHMARK(BM_AllocPoolMixedTypes)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
@@ -0,0 +1,686 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/// Connection and link storm benchmarks of a single router.
+///
+/// A load generator opens AMQP connections, each attaching a number of receiver links, or TCP flows through a
+/// tcpListener and tcpConnectors to an echo server, at a target rate. An iteration ends once every connection is
+/// open, the connections are then closed outside of the timed region. Reported are the sustained open and attach
+/// rates, the p50/p99/p999 open and attach latencies, the growth of the router's resident memory per connection and
+/// the CPU use of the busiest core thread as a fraction of a core, which nears 1 when the core is saturated.
+///
+/// The loopback allows about 28k connections from one address to one port, so the router listens on a port per
+/// CONNECTIONS_PER_PORT connections, and the open file limit must allow two descriptors per connection.
+
+#include "SocketException.hpp"
+#include "TCPSocket.hpp"
+#include "router_network.hpp"
+#include "socket_utils.hpp"
+
+#include <benchmark/benchmark.h>
+#include <netinet/in.h>
+#include <proton/connection.h>
+#include <proton/event.h>
+#include <proton/link.h>
+#include <proton/proactor.h>
+#include <proton/session.h>
+#include <proton/terminus.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Connections opened through each listening port
+static const int CONNECTIONS_PER_PORT = 20000;
+
+/// Time allowed for a storm to complete
+static const int TIMEOUT_SECONDS = 120;
+
+/// Raises the soft open file limit of this process and of the routers it starts
+static bool raiseFileLimit(rlim_t needed)
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_max < needed) {
+        return false;
+    }
+    if (limit.rlim_cur < needed) {
+        limit.rlim_cur = needed;
+        return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+    }
+    return true;
+}
+
+/// Connections the rate allows to have been started after 'elapsed' seconds, a rate of 0 is unlimited
+static int allowed(int count, int rate, double elapsed)
+{
+    return rate == 0 ? count : std::min(count, (int) (rate * elapsed) + 1);
+}
+
+/// Free ports for the listeners of 'count' connections
+static std::vector<unsigned short> portsFor(int count)
+{
+    std::vector<unsigned short> ports;
+    for (int i = 0; i < (count + CONNECTIONS_PER_PORT - 1) / CONNECTIONS_PER_PORT; ++i) {
+        ports.push_back(findFreePort());
+    }
+    return ports;
+}
+
+/// CPU use of the router and of its busiest core thread between construction and report()
+class StormUsage
+{
+    const RouterProcess &mRouter;
+    double mCpu;
+    std::map<pid_t, double> mCore;
+    size_t mRss;
+    std::chrono::steady_clock::time_point mStart;
+
+   public:
+    explicit StormUsage(const RouterProcess &router)
+        : mRouter(router), mCpu(router.cpuSeconds()), mRss(router.rssBytes()), mStart(std::chrono::steady_clock::now())
+    {
+        for (const auto &thread : router.threadCpuSeconds("core_thread")) {
+            mCore[thread.first] = thread.second;
+        }
+    }
+
+    struct Sample {
+        double cpu;       // fraction of a core used by the router
+        double coreBusy;  // fraction of a core used by the busiest core thread
+        double rssGrowth;
+    };
+
+    Sample sample() const
+    {
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        Sample s{0, 0, (double) mRouter.rssBytes() - (double) mRss};
+        if (wall > 0) {
+            s.cpu = (mRouter.cpuSeconds() - mCpu) / wall;
+            for (const auto &thread : mRouter.threadCpuSeconds("core_thread")) {
+                auto start = mCore.find(thread.first);
+                s.coreBusy = std::max(s.coreBusy, (thread.second - (start != mCore.end() ? start->second : 0)) / wall);
+            }
+        }
+        return s;
+    }
+};
+
+/// Accumulates the samples of the iterations of a storm benchmark
+struct StormReport {
+    std::vector<uint64_t> openSamples;
+    std::vector<uint64_t> attachSamples;
+    double openSeconds   = 0;  // from the first connect to the last open, summed over the iterations
+    double attachSeconds = 0;
+    double cpu           = 0;
+    double coreBusy      = 0;
+    double bytesPerConnection = 0;
+
+    void add(const StormUsage::Sample &sample, int connections)
+    {
+        cpu      = std::max(cpu, sample.cpu);
+        coreBusy = std::max(coreBusy, sample.coreBusy);
+        // freed memory is kept in the pools of the router, so later iterations mostly reuse that of the first
+        bytesPerConnection = std::max(bytesPerConnection, sample.rssGrowth / connections);
+    }
+
+    void report(benchmark::State &state, int connections, long links)
+    {
+        const double iterations = state.iterations();
+        if (openSeconds > 0) {
+            state.counters["opens_per_second"] = iterations * connections / openSeconds;
+        }
+        if (attachSeconds > 0) {
+            state.counters["attaches_per_second"] = iterations * links / attachSeconds;
+        }
+        state.counters["bytes_per_connection"] = bytesPerConnection;
+        state.counters["cpu_router"]            = cpu;
+        state.counters["core_busy"]             = coreBusy;
+        reportLatency(state, openSamples, "open_");
+        reportLatency(state, attachSamples, "attach_");
+    }
+};
+
+/// Opens AMQP connections at a target rate from one proactor, each attaching receiver links once it is open
+class AmqpStorm
+{
+    struct Client {
+        uint64_t connectNs = 0;
+        uint64_t attachNs  = 0;
+        int attached       = 0;
+    };
+
+    pn_proactor_t *mProactor;
+    const std::vector<unsigned short> &mPorts;
+    const int mLinks;
+    std::unordered_map<pn_connection_t *, Client> mClients;
+    std::vector<pn_connection_t *> mConnections;
+    int mOpened    = 0;
+    long mAttached = 0;
+    int mClosed    = 0;
+    bool mClosing  = false;
+    bool mFailed   = false;
+    uint64_t mFirstAttachNs = 0;
+    uint64_t mLastOpenNs    = 0;
+    uint64_t mLastAttachNs  = 0;
+    StormReport &mReport;
+
+    void connect()
+    {
+        pn_connection_t *conn = pn_connection();
+        pn_connection_set_container(conn, "bm_connection_storm");
+        pn_connection_open(conn);
+        const unsigned short port = mPorts[(mConnections.size() / CONNECTIONS_PER_PORT) % mPorts.size()];
+        mClients[conn].connectNs  = nowNs();
+        mConnections.push_back(conn);
+        pn_proactor_connect(mProactor, conn, ("127.0.0.1:" + std::to_string(port)).c_str());
+    }
+
+    void attach(pn_connection_t *conn, Client &client)
+    {
+        pn_session_t *ssn = pn_session(conn);
+        pn_session_open(ssn);
+        client.attachNs = nowNs();
+        if (!mFirstAttachNs) {
+            mFirstAttachNs = client.attachNs;
+        }
+        for (int l = 0; l < mLinks; ++l) {
+            std::string address = "closest/storm/" + std::to_string(mConnections.size()) + "/" + std::to_string(l);
+            pn_link_t *link     = pn_receiver(ssn, address.c_str());
+            pn_terminus_set_address(pn_link_source(link), address.c_str());
+            pn_link_open(link);
+        }
+    }
+
+    void handle(pn_event_t *event)
+    {
+        switch (pn_event_type(event)) {
+            case PN_CONNECTION_REMOTE_OPEN: {
+                pn_connection_t *conn = pn_event_connection(event);
+                Client &client        = mClients[conn];
+                mLastOpenNs           = nowNs();
+                mReport.openSamples.push_back(mLastOpenNs - client.connectNs);
+                ++mOpened;
+                attach(conn, client);
+                break;
+            }
+
+            case PN_LINK_REMOTE_OPEN: {
+                Client &client = mClients[pn_event_connection(event)];
+                mLastAttachNs  = nowNs();
+                mReport.attachSamples.push_back(mLastAttachNs - client.attachNs);
+                ++client.attached;
+                ++mAttached;
+                break;
+            }
+
+            case PN_TRANSPORT_CLOSED:
+                if (mClosing) {
+                    ++mClosed;
+                } else {
+                    mFailed = true;
+                }
+                break;
+
+            case PN_CONNECTION_REMOTE_CLOSE:
+            case PN_LINK_REMOTE_CLOSE:
+                if (!mClosing) {
+                    mFailed = true;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /// Processes events until done() or the timeout, calling tick() every millisecond
+    template <typename Done, typename Tick>
+    bool run(Done done, Tick tick)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+        pn_proactor_set_timeout(mProactor, 1);
+        while (!done() && !mFailed) {
+            pn_event_batch_t *batch = pn_proactor_wait(mProactor);
+            pn_event_t *event;
+            while ((event = pn_event_batch_next(batch))) {
+                if (pn_event_type(event) == PN_PROACTOR_TIMEOUT) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        mFailed = true;
+                    } else {
+                        tick();
+                        pn_proactor_set_timeout(mProactor, 1);
+                    }
+                } else {
+                    handle(event);
+                }
+            }
+            pn_proactor_done(mProactor, batch);
+        }
+        pn_proactor_cancel_timeout(mProactor);
+        return !mFailed;
+    }
+
+   public:
+    AmqpStorm(const std::vector<unsigned short> &ports, int links, StormReport &report)
+        : mProactor(pn_proactor()), mPorts(ports), mLinks(links), mReport(report)
+    {
+    }
+
+    ~AmqpStorm()
+    {
+        pn_proactor_free(mProactor);
+    }
+
+    /// Opens 'count' connections at 'rate' per second and waits until they and their links are open
+    bool storm(int count, int rate)
+    {
+        const uint64_t start = nowNs();
+        mFirstAttachNs       = 0;
+        auto openAllowed     = [&] {
+            const int limit = allowed(count, rate, (nowNs() - start) / 1e9);
+            while ((int) mConnections.size() < limit) {
+                connect();
+            }
+        };
+        openAllowed();
+        bool ok = run([&] { return mOpened == count && mAttached == (long) count * mLinks; }, openAllowed);
+        if (ok) {
+            mReport.openSeconds += (mLastOpenNs - start) / 1e9;
+            if (mLinks > 0) {
+                mReport.attachSeconds += (mLastAttachNs - mFirstAttachNs) / 1e9;
+            }
+        }
+        return ok;
+    }
+
+    /// Closes all connections and waits until their transports have closed
+    bool close()
+    {
+        mClosing = true;
+        for (pn_connection_t *conn : mConnections) {
+            pn_connection_close(conn);
+        }
+        pn_proactor_set_timeout(mProactor, 1);
+        const int count = mConnections.size();
+        bool ok         = run([&] { return mClosed == count; }, [] {});
+        mConnections.clear();
+        mClients.clear();
+        mOpened = mClosed = 0;
+        mAttached         = 0;
+        mClosing          = false;
+        return ok;
+    }
+};
+
+/// Policy enabled for every connection, so its checks of connections and links are part of the cost
+static std::string vhostPolicy()
+{
+    return "policy {\n    maxConnections: 1000000\n    enableVhostPolicy: true\n}\n\n"
+           "vhost {\n    hostname: $default\n    maxConnections: 1000000\n    maxConnectionsPerUser: 1000000\n"
+           "    maxConnectionsPerHost: 1000000\n    allowUnknownUser: true\n    groups: {\n"
+           "        \"$default\": {\"users\": \"*\", \"remoteHosts\": \"*\", \"sources\": \"*\", \"targets\": \"*\"},\n"
+           "    }\n}\n\n";
+}
+
+/// Measures a storm of AMQP connections that each attach a number of receiver links.
+///
+/// Arguments are the number of connections, the links per connection, the target open rate in connections per
+/// second with 0 for as fast as possible, and whether a vhost policy applies to the connections.
+static void BM_AmqpConnectionStorm(benchmark::State &state)
+{
+    const int connections = state.range(0);
+    const int links       = state.range(1);
+    const int rate        = state.range(2);
+    const bool policy     = state.range(3);
+    if (!raiseFileLimit(2 * connections + 1024)) {
+        state.SkipWithError("the open file limit is too low for the number of connections");
+        return;
+    }
+
+    // the ingress router listens on further ports for connections beyond the first CONNECTIONS_PER_PORT
+    std::vector<unsigned short> ports = portsFor(connections);
+    Scenario scenario                 = linear(1);
+    std::stringstream config;
+    for (size_t i = 1; i < ports.size(); ++i) {
+        config << "listener {\n    host: 127.0.0.1\n    port: " << ports[i] << "\n    saslMechanisms: ANONYMOUS\n}\n\n";
+    }
+    // the default policy limits the router to 65535 connections
+    config << (policy ? vhostPolicy() : "policy {\n    maxConnections: 1000000\n}\n\n");
+    scenario.ingressConfig = config.str();
+    Network network("BM_AmqpConnectionStorm", scenario, findFreePort());
+    ports[0] = network.amqpPort(0);
+    try {
+        try_to_connect("127.0.0.1", ports[0]);
+    } catch (std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    StormReport report;
+    AmqpStorm storm(ports, links, report);
+    for (auto _ : state) {
+        StormUsage usage(network.router(0));
+        if (!storm.storm(connections, rate)) {
+            state.SkipWithError("connections failed or timed out");
+            return;
+        }
+        report.add(usage.sample(), connections);
+
+        state.PauseTiming();
+        if (!storm.close()) {
+            state.SkipWithError("connections did not close in time");
+            return;
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * connections);
+    report.report(state, connections, (long) connections * links);
+}
+
+BENCHMARK(BM_AmqpConnectionStorm)
+    ->ArgNames({"connections", "links", "rate", "policy"})
+    ->Args({1000, 0, 0, 0})
+    ->Args({10000, 0, 5000, 0})
+    ->Args({10000, 0, 5000, 1})
+    ->Args({10000, 10, 5000, 0})
+    ->Args({10000, 10, 5000, 1})
+    ->Args({50000, 0, 0, 0})
+    ->Args({50000, 0, 0, 1})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/// Echoes the connections accepted on any number of ports from one epoll thread
+class EpollEchoServer
+{
+    std::vector<int> mListeners;
+    std::vector<unsigned short> mPorts;
+    int mEpoll;
+    int mWake;
+    std::atomic<int> mOpen{0};
+    std::thread mThread;
+
+    void run()
+    {
+        std::vector<epoll_event> events(1024);
+        char buffer[4096];
+        while (true) {
+            int n = epoll_wait(mEpoll, events.data(), events.size(), -1);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == mWake) {
+                    return;
+                }
+                if (std::find(mListeners.begin(), mListeners.end(), fd) != mListeners.end()) {
+                    int conn;
+                    while ((conn = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                        epoll_event ev{};
+                        ev.events  = EPOLLIN;
+                        ev.data.fd = conn;
+                        epoll_ctl(mEpoll, EPOLL_CTL_ADD, conn, &ev);
+                        ++mOpen;
+                    }
+                    continue;
+                }
+                ssize_t received = read(fd, buffer, sizeof(buffer));
+                if (received > 0) {
+                    if (write(fd, buffer, received) != received) {
+                        // the flows only send a byte at a time
+                    }
+                } else if (received == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    close(fd);  // also removes it from the epoll set
+                    --mOpen;
+                }
+            }
+        }
+    }
+
+   public:
+    explicit EpollEchoServer(int portCount) : mEpoll(epoll_create1(0)), mWake(eventfd(0, 0))
+    {
+        for (int i = 0; i < portCount; ++i) {
+            int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            sockaddr_in addr;
+            zero(addr);
+            addr.sin_family      = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len        = sizeof(addr);
+            if (bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 4096) != 0 ||
+                getsockname(fd, (sockaddr *) &addr, &len) != 0) {
+                throw SocketException("Failed to listen for the echo server");
+            }
+            mListeners.push_back(fd);
+            mPorts.push_back(ntohs(addr.sin_port));
+            epoll_event ev{};
+            ev.events  = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &ev);
+        }
+        epoll_event ev{};
+        ev.events  = EPOLLIN;
+        ev.data.fd = mWake;
+        epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWake, &ev);
+        mThread = std::thread([this] { run(); });
+    }
+
+    ~EpollEchoServer()
+    {
+        uint64_t one = 1;
+        if (write(mWake, &one, sizeof(one)) != sizeof(one)) {
+            perror("Waking the echo server");
+        }
+        mThread.join();
+        for (int fd : mListeners) {
+            close(fd);
+        }
+        close(mWake);
+        close(mEpoll);
+    }
+
+    const std::vector<unsigned short> &ports() const
+    {
+        return mPorts;
+    }
+
+    /// Connections accepted and not yet closed by their clients
+    int open() const
+    {
+        return mOpen;
+    }
+};
+
+/// Opens TCP flows at a target rate. A flow is open once a byte sent through it has come back from the echo server;
+/// the flows are then kept open until close().
+class TcpStorm
+{
+    const std::vector<unsigned short> &mPorts;
+    int mEpoll;
+    std::vector<int> mSockets;
+    std::vector<uint64_t> mStartNs;
+    StormReport &mReport;
+
+   public:
+    TcpStorm(const std::vector<unsigned short> &ports, StormReport &report)
+        : mPorts(ports), mEpoll(epoll_create1(0)), mReport(report)
+    {
+    }
+
+    ~TcpStorm()
+    {
+        close();
+        ::close(mEpoll);
+    }
+
+    /// Returns the number of flows that failed to open, or -1 on timeout
+    int storm(int count, int rate)
+    {
+        const uint64_t start = nowNs();
+        auto deadline        = std::chrono::steady_clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+        int done = 0, failed = 0;
+        uint64_t lastOpenNs = start;
+        std::vector<epoll_event> events(1024);
+
+        while (done + failed < count) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return -1;
+            }
+            const int limit = allowed(count, rate, (nowNs() - start) / 1e9);
+            while ((int) mSockets.size() < limit) {
+                const int index = mSockets.size();
+                int fd          = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+                sockaddr_in addr;
+                fillSockAddr("127.0.0.1", mPorts[(index / CONNECTIONS_PER_PORT) % mPorts.size()], addr);
+                mSockets.push_back(fd);
+                mStartNs.push_back(nowNs());
+                if (fd < 0 || (connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0 && errno != EINPROGRESS)) {
+                    ++failed;
+                    continue;
+                }
+                epoll_event ev{};
+                ev.events   = EPOLLOUT;
+                ev.data.u32 = index;
+                epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &ev);
+            }
+
+            int n = epoll_wait(mEpoll, events.data(), events.size(), 1);
+            for (int i = 0; i < n; ++i) {
+                const int index = events[i].data.u32;
+                const int fd    = mSockets[index];
+                if (events[i].events & EPOLLOUT) {
+                    int error       = 0;
+                    socklen_t len   = sizeof(error);
+                    const char byte = 'x';
+                    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error || write(fd, &byte, 1) != 1) {
+                        epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+                        ++failed;
+                        continue;
+                    }
+                    epoll_event ev = events[i];
+                    ev.events      = EPOLLIN;
+                    epoll_ctl(mEpoll, EPOLL_CTL_MOD, fd, &ev);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    char byte;
+                    epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+                    if (read(fd, &byte, 1) == 1) {
+                        lastOpenNs = nowNs();
+                        mReport.openSamples.push_back(lastOpenNs - mStartNs[index]);
+                        ++done;
+                    } else {
+                        ++failed;  // the router closed the flow
+                    }
+                }
+            }
+        }
+        mReport.openSeconds += (lastOpenNs - start) / 1e9;
+        return failed;
+    }
+
+    void close()
+    {
+        for (int fd : mSockets) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        mSockets.clear();
+        mStartNs.clear();
+    }
+};
+
+/// Measures a storm of TCP flows through a tcpListener of the router and its tcpConnectors to an echo server.
+///
+/// Arguments are the number of flows and the target open rate in flows per second, 0 for as fast as possible.
+static void BM_TcpFlowStorm(benchmark::State &state)
+{
+    const int flows = state.range(0);
+    const int rate  = state.range(1);
+    // each flow has a socket to the router and one accepted by the echo server here, the router has both peers
+    if (!raiseFileLimit(2 * flows + 1024)) {
+        state.SkipWithError("the open file limit is too low for the number of flows");
+        return;
+    }
+
+    const int portCount = (flows + CONNECTIONS_PER_PORT - 1) / CONNECTIONS_PER_PORT;
+    EpollEchoServer echo(portCount);
+    std::vector<unsigned short> ports = portsFor(flows);
+    Scenario scenario                 = linear(1);
+    std::stringstream config;
+    for (size_t i = 1; i < ports.size(); ++i) {
+        config << "tcpListener {\n    host: 127.0.0.1\n    port: " << ports[i]
+               << "\n    address: bench-tcp\n    siteId: bench\n}\n\n";
+    }
+    scenario.ingressConfig = config.str();
+    Network network("BM_TcpFlowStorm", scenario, echo.ports());
+    ports[0] = network.tcpListenerPort();
+    try {
+        // a flow is accepted once the tcpConnector's address is reachable
+        TCPSocket sock = try_to_connect("127.0.0.1", ports[0]);
+        char byte      = 'x';
+        sock.send(&byte, 1);
+        sock.recv(&byte, 1);
+    } catch (std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    StormReport report;
+    int failed = 0;
+    TcpStorm storm(ports, report);
+    for (auto _ : state) {
+        StormUsage usage(network.router(0));
+        int result = storm.storm(flows, rate);
+        if (result < 0) {
+            state.SkipWithError("flows timed out");
+            return;
+        }
+        failed += result;
+        report.add(usage.sample(), flows);
+
+        state.PauseTiming();
+        storm.close();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+        while (echo.open() > 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * flows - failed);
+    state.counters["failed"] = failed;
+    report.report(state, flows, 0);
+}
+
+BENCHMARK(BM_TcpFlowStorm)
+    ->ArgNames({"flows", "rate"})
+    ->Args({1000, 0})
+    ->Args({10000, 10000})
+    ->Args({100000, 20000})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,86 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// Number of actions each producer thread posts to the core per benchmark iteration
+static const int ACTIONS_PER_PRODUCER = 10000;
+
+struct ActionCounter {
+    std::atomic<long> remaining;
+    Latch done;
+};
+
+static void count_action_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    auto counter = static_cast<ActionCounter *>(action->args.general.context_1);
+    if (counter->remaining.fetch_sub(1) == 1) {
+        counter->done.notify();
+    }
+}
+
+/// Measures actions/sec through qdr_action_enqueue() with a varying number of producer threads.
+static void BM_CoreActionEnqueue(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDR qdr{};
+        qdr.initialize("minimal_silent.conf");
+        qdr.wait();
+
+        qdr_core_t *core    = qdr.qd->router->router_core;
+        const int producers = state.range(0);
+
+        for (auto _ : state) {
+            ActionCounter counter{};
+            counter.remaining = (long) producers * ACTIONS_PER_PRODUCER;
+
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; ++p) {
+                threads.emplace_back([core, &counter] {
+                    for (int i = 0; i < ACTIONS_PER_PRODUCER; ++i) {
+                        qdr_action_t *action           = qdr_action(count_action_CT, 0);
+                        action->args.general.context_1 = &counter;
+                        qdr_action_enqueue(core, action);
+                    }
+                });
+            }
+            for (auto &t : threads) {
+                t.join();
+            }
+            counter.done.wait();
+        }
+
+        state.SetItemsProcessed(state.iterations() * producers * ACTIONS_PER_PRODUCER);
+        qdr.deinitialize(false);
+    }).join();
+}
+
+BENCHMARK(BM_CoreActionEnqueue)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
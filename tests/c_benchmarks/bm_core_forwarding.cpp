@@ -0,0 +1,280 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+extern "C" {
+#include "router_core/delivery.h"
+
+#include "qpid/dispatch/compose.h"
+#include "qpid/dispatch/iterator.h"
+#include "qpid/dispatch/protocol_adaptor.h"
+}  // extern "C"
+
+/// Deliveries routed per benchmark iteration
+static const int DELIVERIES_PER_ITERATION = 10000;
+
+/// Deliveries the driver lets the core hold before it waits for them to reach the consumers
+static const int DELIVERY_WINDOW = 250;
+
+/// Credit issued to each consumer link, replenished as deliveries are consumed
+static const int CONSUMER_CREDIT = 1000;
+
+/// Address prefixes of core_forwarding.conf, indexed by the treatment argument of the benchmarks
+static const char *const TREATMENT_PREFIXES[] = {"bench.closest", "bench.balanced", "bench.multicast"};
+
+/// Protocol adaptor that stands in for the I/O threads: the benchmark thread processes the connections the core
+/// activates, and consumers complete every delivery as soon as the core pushes it.
+struct BenchAdaptor {
+    qdr_core_t *core;
+    qdr_protocol_adaptor_t *pa;
+    std::vector<qdr_connection_t *> connections;
+    std::vector<qdr_link_t *> links;
+    std::atomic<bool> activated{false};
+    long delivered = 0;  // deliveries completed by the consumers, only touched by the benchmark thread
+
+    static void activate(void *context, qdr_connection_t *conn)
+    {
+        static_cast<BenchAdaptor *>(context)->activated.store(true, std::memory_order_release);
+    }
+
+    static int push(void *context, qdr_link_t *link, int limit)
+    {
+        auto that    = static_cast<BenchAdaptor *>(context);
+        int consumed = qdr_link_process_deliveries(that->core, link, limit);
+        if (consumed > 0) {
+            qdr_link_flow(that->core, link, consumed, false);
+        }
+        return consumed;
+    }
+
+    static uint64_t deliver(void *context, qdr_link_t *link, qdr_delivery_t *delivery, bool settled)
+    {
+        qd_message_set_send_complete(qdr_delivery_message(delivery));
+        static_cast<BenchAdaptor *>(context)->delivered++;
+        return 0;
+    }
+
+    static int get_credit(void *context, qdr_link_t *link)
+    {
+        return CONSUMER_CREDIT;
+    }
+
+    explicit BenchAdaptor(qdr_core_t *core) : core(core)
+    {
+        pa = qdr_protocol_adaptor(core, "bench", this, activate, nullptr,
+                                  [](void *, qdr_link_t *, qdr_terminus_t *source, qdr_terminus_t *target) {
+                                      qdr_terminus_free(source);
+                                      qdr_terminus_free(target);
+                                  },
+                                  [](void *, qdr_link_t *, qdr_error_t *error, bool) { qdr_error_free(error); },
+                                  [](void *, qdr_link_t *, int) {}, [](void *, qdr_link_t *, int) {},
+                                  [](void *, qdr_link_t *) {}, [](void *, qdr_link_t *, bool) {}, push, deliver,
+                                  get_credit, [](void *, qdr_delivery_t *, uint64_t, bool) {},
+                                  [](void *, qdr_connection_t *, qdr_error_t *error) { qdr_error_free(error); },
+                                  [](void *, qdr_connection_t *, bool) {});
+    }
+
+    qdr_connection_t *open_connection()
+    {
+        qdr_connection_info_t *info =
+            qdr_connection_info(false, false, true, (char *) "", QD_INCOMING, "bench", "", "", "", "BenchAdaptor",
+                                nullptr, 0, 0, false, "", true, false);
+        qdr_connection_t *conn = qdr_connection_opened(core, pa, true, QDR_ROLE_NORMAL, 1, connections.size() + 1,
+                                                       nullptr, false, false, CONSUMER_CREDIT, nullptr, info, nullptr,
+                                                       nullptr);
+        connections.push_back(conn);
+        return conn;
+    }
+
+    /// Anonymous sender link: every delivery carries its destination address
+    qdr_link_t *attach_producer(qdr_connection_t *conn)
+    {
+        uint64_t link_id;
+        qdr_link_t *link = qdr_link_first_attach(conn, QD_INCOMING, qdr_terminus(nullptr), qdr_terminus(nullptr),
+                                                 "bench.producer", nullptr, false, nullptr, &link_id);
+        links.push_back(link);
+        return link;
+    }
+
+    qdr_link_t *attach_consumer(qdr_connection_t *conn, const std::string &address)
+    {
+        uint64_t link_id;
+        qdr_terminus_t *source = qdr_terminus(nullptr);
+        qdr_terminus_set_address(source, address.c_str());
+        qdr_link_t *link = qdr_link_first_attach(conn, QD_OUTGOING, source, qdr_terminus(nullptr),
+                                                 address.c_str(), nullptr, false, nullptr, &link_id);
+        qdr_link_flow(core, link, CONSUMER_CREDIT, false);
+        links.push_back(link);
+        return link;
+    }
+
+    /// Act as the I/O thread of every connection if the core has activated any of them
+    void process()
+    {
+        if (activated.exchange(false, std::memory_order_acq_rel)) {
+            for (qdr_connection_t *conn : connections) {
+                qdr_connection_process(conn);
+            }
+        }
+    }
+
+    void close(QDR &qdr)
+    {
+        for (qdr_link_t *link : links) {
+            qdr_link_notify_closed(link, true);
+        }
+        for (qdr_connection_t *conn : connections) {
+            qdr_connection_notify_closed(conn);
+        }
+        qdr.wait();
+        qdr_protocol_adaptor_free(core, pa);
+    }
+};
+
+/// Read the CPU time consumed by the core thread, from an action run on that thread
+static uint64_t core_thread_cpu_ns(qdr_core_t *core)
+{
+    struct Request {
+        Latch done;
+        uint64_t ns = 0;
+    } request;
+
+    qdr_action_t *action = qdr_action(
+        [](qdr_core_t *, qdr_action_t *action, bool) {
+            auto request = static_cast<Request *>(action->args.general.context_1);
+            struct timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            request->ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+            request->done.notify();
+        },
+        "core_thread_cpu_ns");
+    action->args.general.context_1 = &request;
+    qdr_action_enqueue(core, action);
+    request.done.wait();
+    return request.ns;
+}
+
+/// Measures the core's forwarding of presettled deliveries from one anonymous producer link to a table of addresses,
+/// each with a number of consumer links that are always ready to take deliveries.
+///
+/// Arguments are the treatment (0 closest, 1 balanced, 2 multicast), the number of addresses, which the deliveries
+/// are spread over round robin so every delivery looks its address up in the core's address table, and the fan-out,
+/// i.e. the number of consumers of each address. The core_ns_per_delivery counter is the CPU time spent by the core
+/// thread per routed delivery; items are deliveries completed by the consumers, fan-out included.
+static void BM_CoreForwarding(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDR qdr{};
+        qdr.initialize("core_forwarding.conf");
+        qdr.wait();
+
+        const int treatment   = state.range(0);
+        const int addresses   = state.range(1);
+        const int fanout      = state.range(2);
+        const int per_ingress = treatment == 2 ? fanout : 1;  // multicast deliveries reach every consumer
+
+        BenchAdaptor bench{qdr.qd->router->router_core};
+
+        std::vector<std::string> names;
+        for (int a = 0; a < addresses; ++a) {
+            names.push_back(std::string(TREATMENT_PREFIXES[treatment]) + "/" + std::to_string(a));
+        }
+        qdr_link_t *producer = bench.attach_producer(bench.open_connection());
+        for (int f = 0; f < fanout; ++f) {
+            qdr_connection_t *conn = bench.open_connection();
+            for (const std::string &name : names) {
+                bench.attach_consumer(conn, name);
+            }
+        }
+        qdr.wait();
+        bench.process();
+
+        qd_composed_field_t *header = qd_compose(QD_PERFORMATIVE_HEADER, nullptr);
+        qd_compose_start_list(header);
+        qd_compose_insert_bool(header, 0);  // durable
+        qd_compose_end_list(header);
+        qd_composed_field_t *body = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, nullptr);
+        qd_compose_insert_string(body, "core forwarding benchmark");
+        qd_message_t *message = qd_message_compose(header, body, nullptr, true);
+
+        uint64_t core_ns = 0;
+        long next        = 0;
+        for (auto _ : state) {
+            const uint64_t cpu_start = core_thread_cpu_ns(bench.core);
+            const long start         = bench.delivered;
+            const long expected      = (long) DELIVERIES_PER_ITERATION * per_ingress;
+            long sent                = 0;
+            while (bench.delivered - start < expected) {
+                // deliveries sent but not yet completed by all of their consumers
+                while (sent < DELIVERIES_PER_ITERATION
+                       && sent * per_ingress - (bench.delivered - start) < (long) DELIVERY_WINDOW * per_ingress) {
+                    qd_iterator_t *to = qd_iterator_string(names[next++ % addresses].c_str(), ITER_VIEW_ADDRESS_HASH);
+                    qdr_delivery_t *dlv =
+                        qdr_link_deliver_to(producer, qd_message_copy(message), nullptr, to, true, nullptr, 0, 0, nullptr);
+                    if (dlv) {
+                        qdr_delivery_decref(bench.core, dlv, "BM_CoreForwarding - release return from deliver");
+                    }
+                    ++sent;
+                }
+                bench.process();
+            }
+            core_ns += core_thread_cpu_ns(bench.core) - cpu_start;
+        }
+
+        state.SetItemsProcessed(state.iterations() * DELIVERIES_PER_ITERATION * per_ingress);
+        state.counters["core_ns_per_delivery"] =
+            benchmark::Counter((double) core_ns / ((double) state.iterations() * DELIVERIES_PER_ITERATION));
+
+        qd_message_free(message);
+        bench.close(qdr);
+        qdr.deinitialize(false);
+    }).join();
+}
+
+/// Address table sizes from 1 to 10000 with fan-outs from 1 to 16, leaving out the largest tables at the largest
+/// fan-outs to bound the number of links a run attaches
+static void CoreForwardingArguments(benchmark::internal::Benchmark *b)
+{
+    for (int treatment = 0; treatment < 3; ++treatment) {
+        for (int addresses : {1, 100, 10000}) {
+            for (int fanout : {1, 4, 16}) {
+                if (addresses * fanout <= 10000) {
+                    b->Args({treatment, addresses, fanout});
+                }
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_CoreForwarding)
+    ->ArgNames({"treatment", "addresses", "fanout"})
+    ->Apply(CoreForwardingArguments)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
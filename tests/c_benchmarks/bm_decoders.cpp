@@ -0,0 +1,355 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <nghttp2/nghttp2.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "decoders/http1/http1_decoder.h"
+#include "decoders/http2/http2_decoder.h"
+}  // extern "C"
+
+// The decoders are fed in segments of the size of a TCP adaptor read buffer, alternating between the two directions of
+// the connection the way the protocol observer sees them. Each benchmark runs on a single thread so the reported
+// bytes_per_second and items_per_second (requests) are per core.
+//
+static const size_t SEGMENT_SIZE = 16384;
+
+typedef std::vector<uint8_t> octets_t;
+
+static void append(octets_t &out, const std::string &text)
+{
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+/// Feed both streams of a connection to 'decode' one segment at a time, returns false if the decoder fails
+template <typename F>
+static bool feed_segments(const octets_t &client, const octets_t &server, F decode)
+{
+    size_t client_offset = 0;
+    size_t server_offset = 0;
+    while (client_offset < client.size() || server_offset < server.size()) {
+        if (client_offset < client.size()) {
+            size_t length = std::min(SEGMENT_SIZE, client.size() - client_offset);
+            if (decode(true, client.data() + client_offset, length) != 0)
+                return false;
+            client_offset += length;
+        }
+        if (server_offset < server.size()) {
+            size_t length = std::min(SEGMENT_SIZE, server.size() - server_offset);
+            if (decode(false, server.data() + server_offset, length) != 0)
+                return false;
+            server_offset += length;
+        }
+    }
+    return true;
+}
+
+//
+// HTTP/1.x
+//
+
+static int h1_rx_request(qd_http1_decoder_connection_t *, const char *, const char *, uint32_t, uint32_t, uintptr_t *)
+{
+    return 0;
+}
+
+static int h1_rx_response(qd_http1_decoder_connection_t *, uintptr_t, int, const char *, uint32_t, uint32_t)
+{
+    return 0;
+}
+
+static int h1_rx_header(qd_http1_decoder_connection_t *hconn, uintptr_t, bool, const char *key, const char *value)
+{
+    benchmark::DoNotOptimize(key);
+    benchmark::DoNotOptimize(value);
+    return 0;
+}
+
+static int h1_rx_body(qd_http1_decoder_connection_t *, uintptr_t, bool, const unsigned char *body, size_t)
+{
+    benchmark::DoNotOptimize(body);
+    return 0;
+}
+
+static int h1_transaction_complete(qd_http1_decoder_connection_t *hconn, uintptr_t)
+{
+    int *completed = (int *) qd_http1_decoder_connection_get_context(hconn);
+    *completed += 1;
+    return 0;
+}
+
+static void h1_protocol_error(qd_http1_decoder_connection_t *, const char *)
+{
+}
+
+static const qd_http1_decoder_config_t h1_config = {
+    .rx_request           = h1_rx_request,
+    .rx_response          = h1_rx_response,
+    .rx_header            = h1_rx_header,
+    .rx_headers_done      = 0,
+    .rx_body              = h1_rx_body,
+    .message_done         = 0,
+    .transaction_complete = h1_transaction_complete,
+    .protocol_error       = h1_protocol_error,
+};
+
+/// Small REST style GET requests and JSON responses, all requests pipelined ahead of the responses
+static void build_h1_pipelined(int requests, octets_t &client, octets_t &server)
+{
+    const std::string body(128, 'x');
+    for (int i = 0; i < requests; ++i) {
+        append(client, "GET /api/v1/items/" + std::to_string(i) + "?fields=name,price HTTP/1.1\r\n"
+                       "Host: service.example.com:8080\r\n"
+                       "User-Agent: curl/8.5.0\r\n"
+                       "Accept: application/json\r\n"
+                       "Accept-Encoding: gzip, deflate\r\n"
+                       "\r\n");
+        append(server, "HTTP/1.1 200 OK\r\n"
+                       "Date: Mon, 13 Jan 2025 10:00:00 GMT\r\n"
+                       "Content-Type: application/json\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "\r\n" + body);
+    }
+}
+
+/// Uploads with a chunked request body, each answered by a chunked response of the same size
+static void build_h1_chunked(int requests, int chunks, int chunk_size, octets_t &client, octets_t &server)
+{
+    char size_line[32];
+    snprintf(size_line, sizeof(size_line), "%x\r\n", chunk_size);
+    const std::string chunk = size_line + std::string(chunk_size, 'c') + "\r\n";
+
+    for (int i = 0; i < requests; ++i) {
+        append(client, "POST /upload/" + std::to_string(i) + " HTTP/1.1\r\n"
+                       "Host: service.example.com:8080\r\n"
+                       "Content-Type: application/octet-stream\r\n"
+                       "Transfer-Encoding: chunked\r\n"
+                       "\r\n");
+        append(server, "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: application/octet-stream\r\n"
+                       "Transfer-Encoding: chunked\r\n"
+                       "\r\n");
+        for (int j = 0; j < chunks; ++j) {
+            append(client, chunk);
+            append(server, chunk);
+        }
+        append(client, "0\r\n\r\n");
+        append(server, "0\r\n\r\n");
+    }
+}
+
+static void run_h1(benchmark::State &state, const octets_t &client, const octets_t &server, int requests)
+{
+    for (auto _ : state) {
+        int completed                        = 0;
+        qd_http1_decoder_connection_t *hconn = qd_http1_decoder_connection(&h1_config, (uintptr_t) &completed);
+        bool ok = feed_segments(client, server, [hconn](bool from_client, const uint8_t *data, size_t length) {
+            return qd_http1_decoder_connection_rx_data(hconn, from_client, data, length);
+        });
+        qd_http1_decoder_connection_free(hconn);
+        if (!ok || completed != requests) {
+            state.SkipWithError("HTTP/1 decode failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * (client.size() + server.size()));
+    state.SetItemsProcessed(state.iterations() * requests);
+}
+
+static void BM_Http1DecodePipelined(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int requests = state.range(0);
+        octets_t client, server;
+        build_h1_pipelined(requests, client, server);
+        run_h1(state, client, server, requests);
+    }).join();
+}
+
+BENCHMARK(BM_Http1DecodePipelined)->Unit(benchmark::kMicrosecond)->Arg(1)->Arg(100)->Arg(1000);
+
+/// Arguments are the number of chunks per message and the chunk size
+static void BM_Http1DecodeChunked(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int requests = 10;
+        octets_t client, server;
+        build_h1_chunked(requests, state.range(0), state.range(1), client, server);
+        run_h1(state, client, server, requests);
+    }).join();
+}
+
+BENCHMARK(BM_Http1DecodeChunked)->Unit(benchmark::kMicrosecond)->Args({100, 64})->Args({100, 1024})->Args({10, 16384});
+
+//
+// HTTP/2
+//
+
+static const uint8_t H2_FRAME_DATA     = 0x0;
+static const uint8_t H2_FRAME_HEADERS  = 0x1;
+static const uint8_t H2_FRAME_SETTINGS = 0x4;
+static const uint8_t H2_FLAG_END_STREAM  = 0x1;
+static const uint8_t H2_FLAG_END_HEADERS = 0x4;
+
+static void append_frame(octets_t &out, uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t *payload, size_t length)
+{
+    const uint8_t header[9] = {(uint8_t) (length >> 16), (uint8_t) (length >> 8), (uint8_t) length, type, flags,
+                               (uint8_t) ((stream_id >> 24) & 0x7f), (uint8_t) (stream_id >> 16),
+                               (uint8_t) (stream_id >> 8), (uint8_t) stream_id};
+    out.insert(out.end(), header, header + sizeof(header));
+    out.insert(out.end(), payload, payload + length);
+}
+
+/// HPACK encode a header list, the deflater keeps the dynamic table of its direction of the connection
+static void append_headers(octets_t &out, nghttp2_hd_deflater *deflater, uint32_t stream_id, bool end_stream,
+                           const std::vector<std::pair<std::string, std::string>> &headers)
+{
+    std::vector<nghttp2_nv> nva;
+    for (const auto &header : headers) {
+        nva.push_back({(uint8_t *) header.first.data(), (uint8_t *) header.second.data(), header.first.size(),
+                       header.second.size(), NGHTTP2_NV_FLAG_NONE});
+    }
+    octets_t block(nghttp2_hd_deflate_bound(deflater, nva.data(), nva.size()));
+    ssize_t length = nghttp2_hd_deflate_hd(deflater, block.data(), block.size(), nva.data(), nva.size());
+    append_frame(out, H2_FRAME_HEADERS, H2_FLAG_END_HEADERS | (end_stream ? H2_FLAG_END_STREAM : 0), stream_id,
+                 block.data(), length > 0 ? length : 0);
+}
+
+/// Unary gRPC calls, 'concurrency' of them in flight at a time with their frames interleaved on the connection
+static void build_h2_grpc(int calls, int concurrency, int message_size, octets_t &client, octets_t &server)
+{
+    static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    client.insert(client.end(), preface, preface + strlen(preface));
+    append_frame(client, H2_FRAME_SETTINGS, 0, 0, 0, 0);
+    append_frame(server, H2_FRAME_SETTINGS, 0, 0, 0, 0);
+
+    nghttp2_hd_deflater *client_deflater;
+    nghttp2_hd_deflater *server_deflater;
+    nghttp2_hd_deflate_new(&client_deflater, 4096);
+    nghttp2_hd_deflate_new(&server_deflater, 4096);
+
+    // gRPC length prefixed message: compressed flag and a four octet big endian length
+    octets_t message = {0, (uint8_t) (message_size >> 24), (uint8_t) (message_size >> 16),
+                        (uint8_t) (message_size >> 8), (uint8_t) message_size};
+    message.resize(5 + message_size, 'g');
+
+    for (int first = 0; first < calls; first += concurrency) {
+        const int last = std::min(calls, first + concurrency);
+        for (int call = first; call < last; ++call) {
+            append_headers(client, client_deflater, 2 * call + 1, false,
+                           {{":method", "POST"},
+                            {":scheme", "http"},
+                            {":path", "/inventory.v1.Inventory/GetItem"},
+                            {":authority", "inventory.example.com:50051"},
+                            {"content-type", "application/grpc"},
+                            {"te", "trailers"},
+                            {"grpc-timeout", "1S"},
+                            {"user-agent", "grpc-go/1.60.0"}});
+        }
+        for (int call = first; call < last; ++call) {
+            append_frame(client, H2_FRAME_DATA, H2_FLAG_END_STREAM, 2 * call + 1, message.data(), message.size());
+        }
+        for (int call = first; call < last; ++call) {
+            append_headers(server, server_deflater, 2 * call + 1, false,
+                           {{":status", "200"}, {"content-type", "application/grpc"}});
+            append_frame(server, H2_FRAME_DATA, 0, 2 * call + 1, message.data(), message.size());
+        }
+        for (int call = first; call < last; ++call) {
+            append_headers(server, server_deflater, 2 * call + 1, true, {{"grpc-status", "0"}, {"grpc-message", ""}});
+        }
+    }
+
+    nghttp2_hd_deflate_del(client_deflater);
+    nghttp2_hd_deflate_del(server_deflater);
+}
+
+static int h2_on_header(qd_http2_decoder_connection_t *, uintptr_t, bool, uint32_t, const uint8_t *name, size_t,
+                        const uint8_t *value, size_t)
+{
+    benchmark::DoNotOptimize(name);
+    benchmark::DoNotOptimize(value);
+    return 0;
+}
+
+static int h2_on_end_headers(qd_http2_decoder_connection_t *conn_state, uintptr_t, bool from_client, uint32_t,
+                             bool end_stream)
+{
+    if (!from_client && end_stream) {
+        int *completed = (int *) qd_http2_decoder_connection_get_context(conn_state);
+        *completed += 1;
+    }
+    return 0;
+}
+
+static void h2_on_decode_error(qd_http2_decoder_connection_t *, uintptr_t, bool, const char *)
+{
+}
+
+static const qd_http2_decoder_callbacks_t h2_callbacks = {
+    .on_data         = 0,
+    .on_header       = h2_on_header,
+    .on_begin_header = 0,
+    .on_end_headers  = h2_on_end_headers,
+    .on_decode_error = h2_on_decode_error,
+};
+
+/// Arguments are the number of concurrent streams and the size of the gRPC messages
+static void BM_Http2DecodeGrpc(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int calls = 1000;
+        octets_t client, server;
+        build_h2_grpc(calls, state.range(0), state.range(1), client, server);
+
+        for (auto _ : state) {
+            int completed                             = 0;
+            qd_http2_decoder_connection_t *conn_state = qd_http2_decoder_connection(&h2_callbacks, (uintptr_t) &completed, 1);
+            bool ok = feed_segments(client, server, [conn_state](bool from_client, const uint8_t *data, size_t length) {
+                return decode(conn_state, from_client, data, length);
+            });
+            qd_http2_decoder_connection_free(conn_state);
+            if (!ok || completed != calls) {
+                state.SkipWithError("HTTP/2 decode failed");
+                break;
+            }
+        }
+        state.SetBytesProcessed(state.iterations() * (client.size() + server.size()));
+        state.SetItemsProcessed(state.iterations() * calls);
+    }).join();
+}
+
+BENCHMARK(BM_Http2DecodeGrpc)->Unit(benchmark::kMicrosecond)->Args({1, 64})->Args({100, 64})->Args({100, 4096});
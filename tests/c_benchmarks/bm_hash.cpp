@@ -0,0 +1,351 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "qpid/dispatch/buffer.h"
+#include "qpid/dispatch/hash.h"
+}  // extern "C"
+
+/// Counts the hardware cache misses of the calling thread with perf_event_open(2). Counting is unavailable where the
+/// kernel or perf_event_paranoid does not allow it, e.g. in most containers; the benchmarks then report no misses.
+class CacheMissCounter
+{
+    int fd = -1;
+
+   public:
+    CacheMissCounter()
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.size           = sizeof(attr);
+        attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd                  = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        }
+    }
+
+    ~CacheMissCounter()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    void resume()
+    {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void pause()
+    {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    /// Reports the time and, if counted, the cache misses per operation
+    void report(benchmark::State &state, int64_t ops)
+    {
+        state.counters["time_per_op"] =
+            benchmark::Counter(ops, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+        uint64_t misses = 0;
+        if (fd >= 0 && ops > 0 && read(fd, &misses, sizeof(misses)) == sizeof(misses)) {
+            state.counters["cache_misses_per_op"] = (double) misses / ops;
+        }
+    }
+};
+
+static std::vector<std::string> make_keys(int count)
+{
+    std::vector<std::string> keys(count);
+    for (int i = 0; i < count; ++i) {
+        keys[i] = "M0/address/" + std::to_string(i);
+    }
+    return keys;
+}
+
+/// Fills a table created with the same geometry as core->addr_hash and then frees it
+static void BM_HashInsert(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int count                     = state.range(0);
+        const std::vector<std::string> keys = make_keys(count);
+
+        CacheMissCounter misses;
+        for (auto _ : state) {
+            misses.resume();
+            qd_hash_t *hash = qd_hash(12, 32, 0);
+            for (int i = 0; i < count; ++i) {
+                qd_hash_insert_str(hash, (const unsigned char *) keys[i].c_str(), (void *) &keys[i], 0);
+            }
+            misses.pause();
+            state.PauseTiming();
+            qd_hash_free(hash);
+            state.ResumeTiming();
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetComplexityN(count);
+        misses.report(state, state.iterations() * count);
+    }).join();
+}
+
+BENCHMARK(BM_HashInsert)
+    ->Unit(benchmark::kMillisecond)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000)
+    ->Complexity();
+
+/// Looks up every key of a populated table through an iterator, the way the core resolves addresses
+static void BM_HashLookup(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int count                     = state.range(0);
+        const std::vector<std::string> keys = make_keys(count);
+        qd_hash_t *hash                     = qd_hash(12, 32, 0);
+        for (int i = 0; i < count; ++i) {
+            qd_hash_insert_str(hash, (const unsigned char *) keys[i].c_str(), (void *) &keys[i], 0);
+        }
+
+        CacheMissCounter misses;
+        qd_iterator_t *iter = qd_iterator_string("", ITER_VIEW_ALL);
+        misses.resume();
+        for (auto _ : state) {
+            for (int i = 0; i < count; ++i) {
+                void *val = 0;
+                qd_iterator_free(iter);
+                iter = qd_iterator_string(keys[i].c_str(), ITER_VIEW_ALL);
+                qd_hash_retrieve(hash, iter, &val);
+                benchmark::DoNotOptimize(val);
+            }
+        }
+        misses.pause();
+        qd_iterator_free(iter);
+        qd_hash_free(hash);
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetComplexityN(count);
+        misses.report(state, state.iterations() * count);
+    }).join();
+}
+
+BENCHMARK(BM_HashLookup)
+    ->Unit(benchmark::kMillisecond)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000)
+    ->Complexity();
+
+/// Removes every key of a populated table, the table is filled again outside of the timed region
+static void BM_HashRemove(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int count                     = state.range(0);
+        const std::vector<std::string> keys = make_keys(count);
+        qd_hash_t *hash                     = qd_hash(12, 32, 0);
+
+        CacheMissCounter misses;
+        for (auto _ : state) {
+            state.PauseTiming();
+            for (int i = 0; i < count; ++i) {
+                qd_hash_insert_str(hash, (const unsigned char *) keys[i].c_str(), (void *) &keys[i], 0);
+            }
+            state.ResumeTiming();
+            misses.resume();
+            for (int i = 0; i < count; ++i) {
+                qd_hash_remove_str(hash, (const unsigned char *) keys[i].c_str());
+            }
+            misses.pause();
+        }
+        qd_hash_free(hash);
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetComplexityN(count);
+        misses.report(state, state.iterations() * count);
+    }).join();
+}
+
+BENCHMARK(BM_HashRemove)
+    ->Unit(benchmark::kMillisecond)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000)
+    ->Complexity();
+
+/// Resolves addresses three segments longer than the configured prefixes they match, the way qd_hash_retrieve_prefix
+/// matches address prefixes: the longest segments are tried first.
+static void BM_HashRetrievePrefix(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int count = state.range(0);
+        qd_hash_t *hash = qd_hash(12, 32, 0);
+        std::vector<std::string> addresses(count);
+        for (int i = 0; i < count; ++i) {
+            std::string prefix  = "org.prefix" + std::to_string(i);
+            qd_iterator_t *iter = qd_iterator_string(prefix.c_str(), ITER_VIEW_ADDRESS_HASH);
+            qd_iterator_annotate_prefix(iter, 'C');
+            qd_hash_insert(hash, iter, (void *) &addresses[i], 0);
+            qd_iterator_free(iter);
+            addresses[i] = prefix + ".service.instance/queue";
+        }
+
+        CacheMissCounter misses;
+        misses.resume();
+        for (auto _ : state) {
+            for (int i = 0; i < count; ++i) {
+                void *val           = 0;
+                qd_iterator_t *iter = qd_iterator_string(addresses[i].c_str(), ITER_VIEW_ADDRESS_HASH);
+                qd_iterator_annotate_prefix(iter, 'C');
+                qd_hash_retrieve_prefix(hash, iter, &val);
+                benchmark::DoNotOptimize(val);
+                qd_iterator_free(iter);
+            }
+        }
+        misses.pause();
+        qd_hash_free(hash);
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetComplexityN(count);
+        misses.report(state, state.iterations() * count);
+    }).join();
+}
+
+BENCHMARK(BM_HashRetrievePrefix)
+    ->Unit(benchmark::kMillisecond)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Complexity();
+
+/// Builds a dotted address of roughly the given length, e.g. "org.segment0.segment1..."
+static std::string make_dotted_address(int length)
+{
+    std::string addr = "org";
+    for (int i = 0; (int) addr.size() < length; ++i) {
+        addr += ".segment" + std::to_string(i);
+    }
+    addr.resize(length);
+    return addr;
+}
+
+/// Hashes the address view of an iterator, as done for every addr_hash lookup
+static void BM_IteratorHashView(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const std::string addr = make_dotted_address(state.range(0));
+        qd_iterator_t *iter    = qd_iterator_string(addr.c_str(), ITER_VIEW_ADDRESS_HASH);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(qd_iterator_hash_view(iter));
+        }
+        qd_iterator_free(iter);
+
+        state.SetBytesProcessed(state.iterations() * addr.size());
+    }).join();
+}
+
+BENCHMARK(BM_IteratorHashView)->RangeMultiplier(4)->Range(16, 1024);
+
+/// Computes the per-segment hashes used by qd_hash_retrieve_prefix
+static void BM_IteratorHashViewSegments(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const std::string addr = make_dotted_address(state.range(0));
+        qd_iterator_t *iter    = qd_iterator_string(addr.c_str(), ITER_VIEW_ADDRESS_HASH);
+
+        for (auto _ : state) {
+            qd_iterator_hash_view_segments(iter);
+            uint32_t hash;
+            while (qd_iterator_next_segment(iter, &hash)) {
+                benchmark::DoNotOptimize(hash);
+            }
+            qd_iterator_reset_view(iter, ITER_VIEW_ADDRESS_HASH);
+        }
+        qd_iterator_free(iter);
+
+        state.SetBytesProcessed(state.iterations() * addr.size());
+    }).join();
+}
+
+BENCHMARK(BM_IteratorHashViewSegments)->RangeMultiplier(4)->Range(16, 1024);
+
+/// Hashes the address view of a 256 octet address held in a chain of buffers of the given number of octets each, as
+/// the to field of a received message can be split over the buffers it arrived in.
+static void BM_IteratorHashViewBuffers(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const std::string addr   = make_dotted_address(256);
+        const size_t octets      = state.range(0);
+        qd_buffer_list_t buffers = DEQ_EMPTY;
+        for (size_t offset = 0; offset < addr.size(); offset += octets) {
+            qd_buffer_t *buf = qd_buffer();
+            size_t len       = std::min(octets, addr.size() - offset);
+            memcpy(qd_buffer_cursor(buf), addr.data() + offset, len);
+            qd_buffer_insert(buf, len);
+            DEQ_INSERT_TAIL(buffers, buf);
+        }
+        const size_t buffer_count = DEQ_SIZE(buffers);
+        qd_iterator_t *iter = qd_iterator_buffer(DEQ_HEAD(buffers), 0, addr.size(), ITER_VIEW_ADDRESS_HASH);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(qd_iterator_hash_view(iter));
+        }
+        qd_iterator_free(iter);
+        qd_buffer_list_free_buffers(&buffers);
+
+        state.SetBytesProcessed(state.iterations() * addr.size());
+        state.counters["buffers"] = buffer_count;
+    }).join();
+}
+
+BENCHMARK(BM_IteratorHashViewBuffers)->RangeMultiplier(4)->Range(4, 256);
@@ -0,0 +1,382 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "message_private.h"
+
+#include "qpid/dispatch/amqp.h"
+#include "qpid/dispatch/compose.h"
+#include "qpid/dispatch/iterator.h"
+#include "qpid/dispatch/parse.h"
+
+void qd_router_id_initialize(const char *area, const char *id);
+void qd_router_id_finalize(void);
+}  // extern "C"
+
+/// Number of body-data frames the producer appends to the message per benchmark iteration
+static const int EXTENDS_PER_MESSAGE = 1000;
+
+static qd_message_t *make_streaming_message()
+{
+    qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_HEADER, 0);
+    qd_compose_start_list(field);
+    qd_compose_insert_bool(field, 0);  // durable
+    qd_compose_end_list(field);
+    return qd_message_compose(field, 0, 0, false);
+}
+
+/// Measures a producer streaming body data into one message while a varying number of consumer
+/// threads poll the message state the way multicast outbound links do.  The consumer poll rate
+/// reported in the counters shows how much the state accessors contend with buffer-list mutation.
+static void BM_MessageStatePolling(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int consumers = state.range(0);
+        uint8_t data[512]   = {0};
+        long total_polls    = 0;
+
+        for (auto _ : state) {
+            qd_message_t *msg = make_streaming_message();
+            std::atomic<long> polls{0};
+
+            std::vector<std::thread> threads;
+            for (int c = 0; c < consumers; ++c) {
+                threads.emplace_back([msg, &polls] {
+                    long local = 0;
+                    while (!qd_message_receive_complete(msg)) {
+                        benchmark::DoNotOptimize(qd_message_is_Q2_blocked(msg));
+                        benchmark::DoNotOptimize(qd_message_aborted(msg));
+                        benchmark::DoNotOptimize(qd_message_has_data_in_content_or_pending_buffers(msg));
+                        ++local;
+                    }
+                    polls += local;
+                });
+            }
+
+            for (int i = 0; i < EXTENDS_PER_MESSAGE; ++i) {
+                qd_composed_field_t *body = qd_compose(QD_PERFORMATIVE_BODY_DATA, 0);
+                qd_compose_insert_binary(body, data, sizeof(data));
+                qd_message_extend(msg, body, 0);
+                qd_compose_free(body);
+            }
+            qd_message_set_receive_complete(msg);
+
+            for (auto &t : threads) {
+                t.join();
+            }
+            total_polls += polls;
+            qd_message_free(msg);
+        }
+
+        state.SetItemsProcessed(state.iterations() * EXTENDS_PER_MESSAGE);
+        state.counters["polls"] = benchmark::Counter(total_polls, benchmark::Counter::kIsRate);
+    }).join();
+}
+
+BENCHMARK(BM_MessageStatePolling)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
+
+
+/// Compose the sections of a typical application message: header, properties, application properties and a
+/// body-data section holding body
+static qd_composed_field_t *compose_typical_message(const std::vector<uint8_t> &body)
+{
+    qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_HEADER, 0);
+    qd_compose_start_list(field);
+    qd_compose_insert_bool(field, 0);  // durable
+    qd_compose_insert_uint(field, 4);  // priority
+    qd_compose_end_list(field);
+
+    field = qd_compose(QD_PERFORMATIVE_PROPERTIES, field);
+    qd_compose_start_list(field);
+    qd_compose_insert_string(field, "message-id-0123456789");  // message-id
+    qd_compose_insert_null(field);                             // user-id
+    qd_compose_insert_string(field, "examples/orders");        // to
+    qd_compose_insert_string(field, "order.created");          // subject
+    qd_compose_insert_string(field, "amqp:/_edge/edge-router-1/temp.4kX91");  // reply-to
+    qd_compose_end_list(field);
+
+    field = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, field);
+    qd_compose_start_map(field);
+    qd_compose_insert_symbol(field, "region");
+    qd_compose_insert_string(field, "eu-west");
+    qd_compose_insert_symbol(field, "sequence");
+    qd_compose_insert_long(field, 42);
+    qd_compose_end_map(field);
+
+    field = qd_compose(QD_PERFORMATIVE_BODY_DATA, field);
+    qd_compose_insert_binary(field, body.data(), body.size());
+    return field;
+}
+
+/// Encode a typical message, as received from the wire, into a flat array of octets
+static std::vector<uint8_t> encode_typical_message(size_t body_size)
+{
+    std::vector<uint8_t> body(body_size, 'x');
+    qd_composed_field_t *field = compose_typical_message(body);
+    qd_buffer_list_t buffers;
+    DEQ_INIT(buffers);
+    qd_compose_take_buffers(field, &buffers);
+    qd_compose_free(field);
+
+    std::vector<uint8_t> octets;
+    for (qd_buffer_t *buf = DEQ_HEAD(buffers); buf; buf = DEQ_NEXT(buf)) {
+        octets.insert(octets.end(), qd_buffer_base(buf), qd_buffer_base(buf) + qd_buffer_size(buf));
+    }
+    qd_buffer_list_free_buffers(&buffers);
+    return octets;
+}
+
+/// Create a message holding 'octets' the way qd_message_receive() leaves a completely received message
+static qd_message_t *receive_message(const std::vector<uint8_t> &octets)
+{
+    qd_message_t *msg             = qd_message();
+    qd_message_content_t *content = MSG_CONTENT(msg);
+    qd_buffer_list_append(&content->buffers, octets.data(), octets.size());
+    SET_ATOMIC_FLAG(&content->receive_complete);
+    return msg;
+}
+
+/// Measures composing and freeing a locally generated message, body size in octets given by the argument
+static void BM_MessageCompose(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        std::vector<uint8_t> body(state.range(0), 'x');
+
+        for (auto _ : state) {
+            qd_message_t *msg = qd_message_compose(compose_typical_message(body), 0, 0, true);
+            benchmark::DoNotOptimize(msg);
+            qd_message_free(msg);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }).join();
+}
+
+BENCHMARK(BM_MessageCompose)->Unit(benchmark::kMicrosecond)->Arg(16)->Arg(1024)->Arg(65536);
+
+/// Measures composing a control-plane style map of many small fields (a large vanflow record or MAU), the number of
+/// map entries given by the argument
+static void BM_ComposeMapOfScalars(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const int64_t entries = state.range(0);
+
+        for (auto _ : state) {
+            qd_composed_field_t *field = qd_compose_subfield(0);
+            qd_compose_start_map(field);
+            for (int64_t i = 0; i < entries; i++) {
+                qd_compose_insert_uint(field, (uint32_t) i);
+                qd_compose_start_list(field);
+                qd_compose_insert_string(field, "address");
+                qd_compose_insert_ulong(field, (uint64_t) i * 1000003);
+                qd_compose_insert_long(field, -i);
+                qd_compose_end_list(field);
+            }
+            qd_compose_end_map(field);
+            benchmark::DoNotOptimize(field);
+            qd_compose_free(field);
+        }
+        state.SetItemsProcessed(state.iterations() * entries);
+    }).join();
+}
+
+BENCHMARK(BM_ComposeMapOfScalars)->Unit(benchmark::kMicrosecond)->Arg(16)->Arg(1024);
+
+/// Measures validating a received message up to the body, as the router does before forwarding it. The body size in
+/// octets is given by the argument; the time includes copying the octets into message buffers.
+static void BM_MessageCheckDepth(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const std::vector<uint8_t> octets = encode_typical_message(state.range(0));
+
+        for (auto _ : state) {
+            qd_message_t *msg = receive_message(octets);
+            if (qd_message_check_depth(msg, QD_DEPTH_BODY) != QD_MESSAGE_DEPTH_OK) {
+                state.SkipWithError("message did not validate");
+            }
+            qd_message_free(msg);
+        }
+        state.SetBytesProcessed(state.iterations() * octets.size());
+    }).join();
+}
+
+BENCHMARK(BM_MessageCheckDepth)->Unit(benchmark::kMicrosecond)->Arg(16)->Arg(1024)->Arg(16384)->Arg(262144);
+
+/// Measures taking a reference to a received message for every destination of a multicast and releasing them, the
+/// number of destinations given by the argument
+static void BM_MessageCopyFanout(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const int fanout  = state.range(0);
+        qd_message_t *msg = receive_message(encode_typical_message(1024));
+        std::vector<qd_message_t *> copies(fanout);
+
+        for (auto _ : state) {
+            for (int i = 0; i < fanout; ++i) {
+                copies[i] = qd_message_copy(msg);
+                qd_message_add_fanout(copies[i]);
+            }
+            for (int i = 0; i < fanout; ++i) {
+                qd_message_free(copies[i]);
+            }
+        }
+        qd_message_free(msg);
+        state.SetItemsProcessed(state.iterations() * fanout);
+    }).join();
+}
+
+BENCHMARK(BM_MessageCopyFanout)->Unit(benchmark::kMicrosecond)->RangeMultiplier(4)->Range(1, 256);
+
+/// Measures the properties lookups done when a message is routed: the to and reply-to fields and the application
+/// properties section of a message whose sections have already been validated
+static void BM_MessageFieldIterator(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        qd_message_t *msg = receive_message(encode_typical_message(1024));
+        qd_message_check_depth(msg, QD_DEPTH_BODY);
+        const qd_message_field_t fields[] = {QD_FIELD_TO, QD_FIELD_REPLY_TO, QD_FIELD_APPLICATION_PROPERTIES};
+
+        for (auto _ : state) {
+            for (qd_message_field_t field : fields) {
+                qd_iterator_t *iter = qd_message_field_iterator(msg, field);
+                benchmark::DoNotOptimize(qd_iterator_length(iter));
+                qd_iterator_free(iter);
+            }
+        }
+        qd_message_free(msg);
+        state.SetItemsProcessed(state.iterations() * (sizeof(fields) / sizeof(fields[0])));
+    }).join();
+}
+
+BENCHMARK(BM_MessageFieldIterator)->Unit(benchmark::kNanosecond);
+
+/// Measures one inter-router hop of the router annotations: parse the section of a received message, then compose
+/// the section sent to the next router, which appends this router to a trace list of argument length
+static void BM_MessageRouterAnnotations(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        qd_router_id_initialize("0", "BenchmarkRouter");
+
+        qd_composed_field_t *ra = qd_compose(QD_PERFORMATIVE_ROUTER_ANNOTATIONS, 0);
+        qd_compose_start_list(ra);
+        qd_compose_insert_uint(ra, 0);                        // flags
+        qd_compose_insert_string(ra, "examples/override");   // to-override
+        qd_compose_insert_string(ra, "0/IngressRouter");      // ingress router
+        qd_compose_start_list(ra);
+        for (int i = 0; i < state.range(0); ++i) {
+            qd_compose_insert_string(ra, ("0/TransitRouter-" + std::to_string(i)).c_str());
+        }
+        qd_compose_end_list(ra);
+        qd_compose_end_list(ra);
+
+        qd_buffer_list_t buffers;
+        DEQ_INIT(buffers);
+        qd_compose_take_buffers(ra, &buffers);
+        qd_compose_free(ra);
+        std::vector<uint8_t> octets;
+        for (qd_buffer_t *buf = DEQ_HEAD(buffers); buf; buf = DEQ_NEXT(buf)) {
+            octets.insert(octets.end(), qd_buffer_base(buf), qd_buffer_base(buf) + qd_buffer_size(buf));
+        }
+        qd_buffer_list_free_buffers(&buffers);
+        const std::vector<uint8_t> message = encode_typical_message(16);
+        octets.insert(octets.end(), message.begin(), message.end());
+
+        for (auto _ : state) {
+            qd_message_t *msg = receive_message(octets);
+            if (qd_message_parse_router_annotations(msg) != 0) {
+                state.SkipWithError("router annotations did not parse");
+            }
+            qd_buffer_list_t ra_buffers;
+            benchmark::DoNotOptimize(
+                _compose_router_annotations((qd_message_pvt_t *) msg, QD_MESSAGE_RA_STRIP_NONE, &ra_buffers));
+            qd_buffer_list_free_buffers(&ra_buffers);
+            qd_message_free(msg);
+        }
+        state.SetItemsProcessed(state.iterations());
+        qd_router_id_finalize();
+    }).join();
+}
+
+BENCHMARK(BM_MessageRouterAnnotations)->Unit(benchmark::kMicrosecond)->Arg(0)->Arg(4)->Arg(16);
+
+/// Measures the throughput of a unicast cut-through stream, as used by the TCP adaptor: the producer moves batches of
+/// argument buffers into the stream slots and the consumer drains them, on the same thread
+static void BM_MessageCutThrough(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const int batch   = state.range(0);
+        qd_message_t *msg = make_streaming_message();
+        qd_message_start_unicast_cutthrough(msg);
+        long buffers      = 0;
+        long octets       = 0;
+
+        for (auto _ : state) {
+            qd_buffer_list_t produced;
+            DEQ_INIT(produced);
+            for (int i = 0; i < batch; ++i) {
+                qd_buffer_t *buf = qd_buffer();
+                qd_buffer_insert(buf, qd_buffer_capacity(buf));
+                octets += qd_buffer_size(buf);
+                DEQ_INSERT_TAIL(produced, buf);
+            }
+            if (!qd_message_can_produce_buffers(msg)) {
+                state.SkipWithError("no cut-through slot to produce into");
+                qd_buffer_list_free_buffers(&produced);
+                break;
+            }
+            qd_message_produce_buffers(msg, &produced);
+
+            qd_buffer_list_t consumed;
+            DEQ_INIT(consumed);
+            while (qd_message_can_consume_buffers(msg)) {
+                buffers += qd_message_consume_buffers(msg, &consumed, batch);
+            }
+            qd_buffer_list_free_buffers(&consumed);
+        }
+        qd_message_set_receive_complete(msg);
+        qd_message_free(msg);
+        state.SetItemsProcessed(buffers);
+        state.SetBytesProcessed(octets);
+    }).join();
+}
+
+BENCHMARK(BM_MessageCutThrough)->Unit(benchmark::kMicrosecond)->Arg(1)->Arg(8)->Arg(64);
@@ -0,0 +1,465 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/// End-to-end benchmarks of small router networks.
+///
+/// Each scenario is a topology of 2 to 7 routers, generated in the shape of the tests/config-* directories, whose
+/// routers run in child processes. TCP load is echoed through a tcpListener on the ingress router and tcpConnectors
+/// on the egress routers; AMQP load is sent to the ingress router and received on the egress routers. Besides
+/// throughput, every benchmark reports the p50/p99/p999 latency in microseconds and the CPU used by each router while
+/// it ran, as a fraction of a core.
+///
+/// Run with --benchmark_out=results.json --benchmark_out_format=json to keep the results, and compare the results of
+/// two builds with the compare.py tool that comes with Google Benchmark.
+
+#include "SocketException.hpp"
+#include "TCPSocket.hpp"
+#include "router_network.hpp"
+#include "socket_utils.hpp"
+
+#include <benchmark/benchmark.h>
+#include <proton/connection.h>
+#include <proton/delivery.h>
+#include <proton/event.h>
+#include <proton/link.h>
+#include <proton/proactor.h>
+#include <proton/session.h>
+#include <proton/terminus.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Round trips made by each TCP connection per benchmark iteration
+static const int ROUND_TRIPS_PER_ITERATION = 200;
+
+/// Messages sent per benchmark iteration of the AMQP benchmarks
+static const int MESSAGES_PER_ITERATION = 2000;
+
+/// Unsettled messages the AMQP sender keeps in flight
+static const int AMQP_WINDOW = 100;
+
+/// Time allowed for a network to come up, and for an iteration to complete
+static const int TIMEOUT_SECONDS = 60;
+
+/// An edge router on each of two connected interior routers, as in tests/config-2-edge
+static Scenario edgeInteriorChain()
+{
+    Scenario scenario;
+    scenario.routers = {{"EA", true}, {"INTA", false}, {"INTB", false}, {"EB", true}};
+    scenario.links   = {{0, 1}, {2, 1}, {3, 2}};
+    scenario.ingress = 0;
+    scenario.egress  = {3};
+    return scenario;
+}
+
+/// An interior root with two interior children that have two edge routers each
+static Scenario tree()
+{
+    Scenario scenario;
+    scenario.routers = {{"ROOT", false}, {"INT1", false}, {"INT2", false}, {"E11", true},
+                        {"E12", true},   {"E21", true},   {"E22", true}};
+    scenario.links   = {{1, 0}, {2, 0}, {3, 1}, {4, 1}, {5, 2}, {6, 2}};
+    scenario.ingress = 0;
+    scenario.egress  = {3, 4, 5, 6};
+    return scenario;
+}
+
+static bool roundTrip(TCPSocket &sock, const std::vector<char> &payload, std::vector<char> &buffer)
+{
+    sock.send(payload.data(), payload.size());
+    size_t received = 0;
+    while (received < payload.size()) {
+        int n = sock.recv(buffer.data(), buffer.size());
+        if (n <= 0) {
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+/// Measures request/response round trips of a number of concurrent TCP connections through the network.
+///
+/// Arguments are the number of connections and the payload size in bytes.
+static void BM_MultiRouterTcp(benchmark::State &state, const char *name, Scenario scenario)
+{
+    const int connections = state.range(0);
+    const std::vector<char> payload(state.range(1), 'x');
+
+    unsigned short echoPort = findFreePort();
+    Network network(name, scenario, echoPort);
+    EchoService echo(echoPort);
+
+    std::vector<std::unique_ptr<TCPSocket>> sockets;
+    try {
+        std::vector<char> buffer(payload.size());
+        for (int c = 0; c < connections; ++c) {
+            // a connection is accepted once the listener's address is reachable
+            sockets.push_back(std::make_unique<TCPSocket>(try_to_connect("127.0.0.1", network.tcpListenerPort())));
+            if (!roundTrip(*sockets.back(), payload, buffer)) {
+                state.SkipWithError("connection closed while warming up");
+                return;
+            }
+        }
+    } catch (std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    std::vector<uint64_t> samples;
+    bool failed = false;
+    CpuUsage cpu(scenario, network);
+    for (auto _ : state) {
+        std::vector<std::vector<uint64_t>> threadSamples(connections);
+        std::vector<std::thread> threads;
+        std::atomic<bool> threadFailed{false};
+        for (int c = 0; c < connections; ++c) {
+            threads.emplace_back([&, c] {
+                std::vector<char> buffer(payload.size());
+                try {
+                    for (int i = 0; i < ROUND_TRIPS_PER_ITERATION; ++i) {
+                        uint64_t start = nowNs();
+                        if (!roundTrip(*sockets[c], payload, buffer)) {
+                            threadFailed = true;
+                            return;
+                        }
+                        threadSamples[c].push_back(nowNs() - start);
+                    }
+                } catch (SocketException &e) {
+                    threadFailed = true;
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (auto &s : threadSamples) {
+            samples.insert(samples.end(), s.begin(), s.end());
+        }
+        if (threadFailed) {
+            failed = true;
+            break;
+        }
+    }
+    cpu.report(state);
+    sockets.clear();  // lets the echo service finish
+
+    if (failed) {
+        state.SkipWithError("connection closed during the benchmark");
+        return;
+    }
+    const int64_t roundTrips = state.iterations() * connections * ROUND_TRIPS_PER_ITERATION;
+    state.SetItemsProcessed(roundTrips);
+    state.SetBytesProcessed(roundTrips * (int64_t) payload.size());
+    reportLatency(state, samples);
+}
+
+/// A sender attached to the ingress router and a receiver on each egress router, all driven by one proactor.
+///
+/// The body of each message is an AMQP data section whose first eight octets are the time the message was sent, or
+/// zero for the probes that are sent until every receiver is reachable. Latency is measured on receipt.
+class AmqpLoad
+{
+    pn_proactor_t *mProactor;
+    std::vector<pn_connection_t *> mConnections;
+    pn_link_t *mSender = nullptr;
+    std::vector<pn_link_t *> mReceivers;
+    std::vector<long> mProbesReceived;
+    std::vector<char> mMessage;
+    std::vector<char> mReceiveBuffer;
+    uint64_t mTag   = 0;
+    int mInFlight   = 0;
+    int mToSend     = 0;      // messages left to send in this iteration
+    long mReceived  = 0;      // messages of this iteration received, by all receivers
+    bool mProbing   = false;  // sending probes rather than timed messages
+    bool mFailed    = false;
+    std::vector<uint64_t> &mSamples;
+
+    pn_connection_t *connect(unsigned short port)
+    {
+        pn_connection_t *conn = pn_connection();
+        pn_connection_set_container(conn, "bm_multi_router");
+        pn_connection_open(conn);
+        mConnections.push_back(conn);
+        std::string address = "127.0.0.1:" + std::to_string(port);
+        pn_proactor_connect(mProactor, conn, address.c_str());
+        return conn;
+    }
+
+    static pn_session_t *session(pn_connection_t *conn)
+    {
+        pn_session_t *ssn = pn_session(conn);
+        pn_session_open(ssn);
+        return ssn;
+    }
+
+    void send(uint64_t timestamp)
+    {
+        memcpy(mMessage.data() + 8, &timestamp, sizeof(timestamp));
+        ++mTag;
+        pn_delivery(mSender, pn_dtag((const char *) &mTag, sizeof(mTag)));
+        pn_link_send(mSender, mMessage.data(), mMessage.size());
+        pn_link_advance(mSender);
+        ++mInFlight;
+    }
+
+    void sendAvailable()
+    {
+        while (mToSend > 0 && mInFlight < AMQP_WINDOW && pn_link_credit(mSender) > 0) {
+            send(nowNs());
+            --mToSend;
+        }
+    }
+
+    /// Returns the send timestamp of a received message, or zero for a probe
+    uint64_t receive(pn_delivery_t *dlv)
+    {
+        pn_link_t *link = pn_delivery_link(dlv);
+        size_t size     = pn_delivery_pending(dlv);
+        if (mReceiveBuffer.size() < size) {
+            mReceiveBuffer.resize(size);
+        }
+        pn_link_recv(link, mReceiveBuffer.data(), size);
+        pn_link_advance(link);
+
+        // The router may add sections ahead of the body: look for the data section descriptor
+        static const char DATA_SECTION[] = {0x00, 0x53, 0x75, (char) 0xb0};
+        auto *end  = mReceiveBuffer.data() + size;
+        auto *body = std::search(mReceiveBuffer.data(), end, DATA_SECTION, DATA_SECTION + sizeof(DATA_SECTION));
+        uint64_t timestamp = 0;
+        if (end - body >= (long) (sizeof(DATA_SECTION) + 4 + sizeof(timestamp))) {
+            memcpy(&timestamp, body + sizeof(DATA_SECTION) + 4, sizeof(timestamp));
+        }
+        return timestamp;
+    }
+
+    void handle(pn_event_t *event)
+    {
+        switch (pn_event_type(event)) {
+            case PN_LINK_FLOW:
+                if (pn_event_link(event) == mSender) {
+                    sendAvailable();
+                }
+                break;
+
+            case PN_DELIVERY: {
+                pn_delivery_t *dlv = pn_event_delivery(event);
+                pn_link_t *link    = pn_delivery_link(dlv);
+                if (link == mSender) {
+                    if (pn_delivery_remote_state(dlv) || pn_delivery_settled(dlv)) {
+                        pn_delivery_settle(dlv);
+                        --mInFlight;
+                        sendAvailable();
+                    }
+                } else if (pn_delivery_readable(dlv) && !pn_delivery_partial(dlv)) {
+                    uint64_t sent = receive(dlv);
+                    if (sent) {
+                        mSamples.push_back(nowNs() - sent);
+                        ++mReceived;
+                    } else {
+                        size_t r = std::find(mReceivers.begin(), mReceivers.end(), link) - mReceivers.begin();
+                        mProbesReceived[r]++;
+                    }
+                    pn_delivery_update(dlv, PN_ACCEPTED);
+                    pn_delivery_settle(dlv);
+                    pn_link_flow(link, 1);
+                }
+                break;
+            }
+
+            case PN_TRANSPORT_CLOSED:
+            case PN_CONNECTION_REMOTE_CLOSE:
+            case PN_LINK_REMOTE_CLOSE:
+                mFailed = true;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /// Processes events until done() or the timeout, probing the receivers every 10 milliseconds if probing
+    template <typename Done>
+    bool run(Done done)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+        pn_proactor_set_timeout(mProactor, 10);
+        while (!done() && !mFailed) {
+            pn_event_batch_t *batch = pn_proactor_wait(mProactor);
+            pn_event_t *event;
+            while ((event = pn_event_batch_next(batch))) {
+                if (pn_event_type(event) == PN_PROACTOR_TIMEOUT) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        mFailed = true;
+                    } else {
+                        if (mProbing && pn_link_credit(mSender) > 0 && mInFlight < AMQP_WINDOW) {
+                            send(0);
+                        }
+                        pn_proactor_set_timeout(mProactor, 10);
+                    }
+                } else {
+                    handle(event);
+                }
+            }
+            pn_proactor_done(mProactor, batch);
+        }
+        pn_proactor_cancel_timeout(mProactor);
+        return !mFailed;
+    }
+
+   public:
+    AmqpLoad(const Network &network, const Scenario &scenario, const std::string &address, size_t payload,
+             std::vector<uint64_t> &samples)
+        : mProactor(pn_proactor()), mSamples(samples)
+    {
+        // data section descriptor, binary of 'payload' octets with a four-octet length
+        const size_t bodySize = std::max(payload, sizeof(uint64_t));
+        mMessage              = {0x00, 0x53, 0x75, (char) 0xb0, (char) (bodySize >> 24), (char) (bodySize >> 16),
+                                 (char) (bodySize >> 8), (char) bodySize};
+        mMessage.resize(mMessage.size() + bodySize, 'x');
+
+        pn_connection_t *conn = connect(network.amqpPort(scenario.ingress));
+        mSender               = pn_sender(session(conn), "bench-sender");
+        pn_terminus_set_address(pn_link_target(mSender), address.c_str());
+        pn_link_open(mSender);
+
+        for (int router : scenario.egress) {
+            conn            = connect(network.amqpPort(router));
+            pn_link_t *link = pn_receiver(session(conn), "bench-receiver");
+            pn_terminus_set_address(pn_link_source(link), address.c_str());
+            pn_link_open(link);
+            pn_link_flow(link, AMQP_WINDOW);
+            mReceivers.push_back(link);
+            mProbesReceived.push_back(0);
+        }
+    }
+
+    ~AmqpLoad()
+    {
+        for (pn_connection_t *conn : mConnections) {
+            pn_connection_close(conn);
+        }
+        pn_proactor_free(mProactor);
+    }
+
+    /// Sends probes until every receiver has received one
+    bool waitForReceivers()
+    {
+        mProbing = true;
+        bool ready = run([this] {
+            return std::all_of(mProbesReceived.begin(), mProbesReceived.end(), [](long n) { return n > 0; });
+        });
+        mProbing = false;
+        return ready && run([this] { return mInFlight == 0; });
+    }
+
+    /// Sends 'messages' and waits until 'expected' copies have been received
+    bool transfer(int messages, long expected)
+    {
+        mToSend   = messages;
+        mReceived = 0;
+        sendAvailable();
+        return run([this, expected] { return mReceived >= expected && mInFlight == 0; });
+    }
+};
+
+/// Measures AMQP messages sent to the ingress router and received on every egress router.
+///
+/// The argument is the payload size in bytes. With a multicast address each message is received once on each egress
+/// router, otherwise once in all.
+static void BM_MultiRouterAmqp(benchmark::State &state, const char *name, Scenario scenario, const char *address)
+{
+    const size_t payload = state.range(0);
+    const bool multicast = strncmp(address, "multicast", strlen("multicast")) == 0;
+    const long expected  = (long) MESSAGES_PER_ITERATION * (multicast ? scenario.egress.size() : 1);
+
+    Network network(name, scenario, findFreePort());
+    std::vector<uint64_t> samples;
+    AmqpLoad load(network, scenario, address, payload, samples);
+    if (!load.waitForReceivers()) {
+        state.SkipWithError("receivers not reachable in time");
+        return;
+    }
+
+    CpuUsage cpu(scenario, network);
+    for (auto _ : state) {
+        if (!load.transfer(MESSAGES_PER_ITERATION, expected)) {
+            state.SkipWithError("transfer failed or timed out");
+            return;
+        }
+    }
+    cpu.report(state);
+
+    state.SetItemsProcessed(state.iterations() * expected);
+    state.SetBytesProcessed(state.iterations() * expected * (int64_t) payload);
+    reportLatency(state, samples);
+}
+
+BENCHMARK_CAPTURE(BM_MultiRouterTcp, linear2, "BM_MultiRouterTcp_linear2", linear(2))
+    ->ArgNames({"connections", "payload"})
+    ->Args({1, 64})
+    ->Args({8, 16384})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MultiRouterTcp, linear3, "BM_MultiRouterTcp_linear3", linear(3))
+    ->ArgNames({"connections", "payload"})
+    ->Args({1, 64})
+    ->Args({8, 16384})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MultiRouterTcp, linear5, "BM_MultiRouterTcp_linear5", linear(5))
+    ->ArgNames({"connections", "payload"})
+    ->Args({1, 64})
+    ->Args({8, 16384})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MultiRouterTcp, edge_interior, "BM_MultiRouterTcp_edge_interior", edgeInteriorChain())
+    ->ArgNames({"connections", "payload"})
+    ->Args({1, 64})
+    ->Args({8, 16384})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_CAPTURE(BM_MultiRouterAmqp, linear3_closest, "BM_MultiRouterAmqp_linear3", linear(3), "closest/bench")
+    ->ArgName("payload")
+    ->Arg(64)
+    ->Arg(16384)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MultiRouterAmqp, edge_interior_closest, "BM_MultiRouterAmqp_edge_interior",
+                  edgeInteriorChain(), "closest/bench")
+    ->ArgName("payload")
+    ->Arg(64)
+    ->Arg(16384)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_MultiRouterAmqp, tree_multicast, "BM_MultiRouterAmqp_tree", tree(), "multicast/bench")
+    ->ArgName("payload")
+    ->Arg(64)
+    ->Arg(16384)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
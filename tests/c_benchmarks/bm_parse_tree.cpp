@@ -23,7 +23,9 @@
 
 #include <benchmark/benchmark.h>
 
+#include <string>
 #include <thread>
+#include <vector>
 
 extern "C" {
 #include "parse_tree.h"
@@ -93,3 +95,59 @@ BENCHMARK(BM_AddRemoveMultiplePatterns)
     ->Arg(1000)
     ->Arg(100000)
     ->Complexity();
+
+/// Builds a tree of 10k patterns, optionally one in ten ending in a wildcard, and matches a set of
+/// distinct addresses against it.  Arguments: number of distinct addresses, wildcards (0/1),
+/// match cache entries (0 disables the cache).
+static void BM_RetrieveMatch(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+
+        const int patternCount = 10000;
+        const int addressCount = state.range(0);
+        const bool wildcards   = state.range(1);
+        const int cacheSize    = state.range(2);
+
+        qd_parse_tree_t *tree = qd_parse_tree_new(QD_PARSE_TREE_ADDRESS);
+        for (int i = 0; i < patternCount; ++i) {
+            std::string pattern = "org.example.service" + std::to_string(i);
+            if (wildcards && i % 10 == 0) {
+                pattern += ".#";
+            }
+            qd_parse_tree_add_pattern_str(tree, pattern.c_str(), (void *) tree);
+        }
+        qd_parse_tree_enable_match_cache(tree, cacheSize);
+
+        std::vector<std::string> addresses(addressCount);
+        for (int i = 0; i < addressCount; ++i) {
+            addresses[i] = "org.example.service" + std::to_string(i % (patternCount * 2));
+            if (i >= patternCount * 2) {
+                addresses[i] += ".q" + std::to_string(i);
+            }
+        }
+
+        for (auto _ : state) {
+            for (const std::string &address : addresses) {
+                qd_iterator_t *iter = qd_iterator_string(address.c_str(), ITER_VIEW_ALL);
+                void *payload;
+                benchmark::DoNotOptimize(qd_parse_tree_retrieve_match(tree, iter, &payload));
+                qd_iterator_free(iter);
+            }
+        }
+
+        qd_parse_tree_free(tree);
+        state.SetItemsProcessed(state.iterations() * addressCount);
+    }).join();
+}
+
+BENCHMARK(BM_RetrieveMatch)
+    ->Unit(benchmark::kMillisecond)
+    ->ArgNames({"addresses", "wildcards", "cache"})
+    // 1M distinct addresses, each looked up once per iteration
+    ->Args({1000000, 0, 0})
+    ->Args({1000000, 1, 0})
+    ->Args({1000000, 1, 16384})
+    // hot working set that fits in the cache
+    ->Args({1000, 1, 0})
+    ->Args({1000, 1, 16384});
@@ -20,9 +20,14 @@
  */
 
 #include "../cpp/helpers/helpers.hpp"
+#include "SocketException.hpp"
+#include "TCPServerSocket.hpp"
+#include "TCPSocket.hpp"
 
 #include <benchmark/benchmark.h>
 
+#include <chrono>
+#include <fstream>
 #include <thread>
 
 static void BM_RouterInitializeMinimalConfig(benchmark::State &state)
@@ -38,3 +43,77 @@ static void BM_RouterInitializeMinimalConfig(benchmark::State &state)
 }
 
 BENCHMARK(BM_RouterInitializeMinimalConfig)->Unit(benchmark::kMillisecond);
+
+/// Writes a config with an AMQP listener on listenerPort and tcpConnectors tcpConnector entities that only add to the
+/// size of the configuration (no flow is ever started, so they never connect)
+static void writeFirstAcceptConfig(const std::string &configName, unsigned short listenerPort, int tcpConnectors)
+{
+    std::fstream f(configName, std::ios::out);
+    f << R"END(
+router {
+    mode: standalone
+    id : QDR
+}
+
+log {
+    module: DEFAULT
+    enable: warning+
+}
+
+listener {
+    host: 127.0.0.1
+    port: )END" << listenerPort
+      << "\n}\n";
+
+    for (int i = 0; i < tcpConnectors; ++i) {
+        f << "tcpConnector {\n    name: connector" << i << "\n    host: 127.0.0.1\n    port: 1\n    address: address"
+          << i << "\n}\n";
+    }
+    f.close();
+}
+
+/// Measures the time from the start of router initialization until the AMQP listener accepts a TCP connection, with
+/// state.range(0) additional entities in the configuration file
+static void BM_RouterTimeToFirstAccept(benchmark::State &state)
+{
+    const int         tcpConnectors = state.range(0);
+    const std::string configName    = "BM_RouterTimeToFirstAccept.conf";
+
+    for (auto _ : state) {
+        unsigned short listenerPort = TCPServerSocket(0).getLocalPort();
+        writeFirstAcceptConfig(configName, listenerPort, tcpConnectors);
+
+        QDR   qdr{};
+        Latch started;
+        auto  start = std::chrono::steady_clock::now();
+
+        std::thread t([&]() {
+            qdr.initialize(configName);
+            qdr.wait();
+            started.notify();
+            qdr.run();
+            qdr.deinitialize(false);
+        });
+
+        bool accepted = false;
+        while (!accepted && std::chrono::steady_clock::now() - start < std::chrono::seconds(60)) {
+            try {
+                TCPSocket sock("127.0.0.1", listenerPort);
+                accepted = true;
+            } catch (SocketException &e) {
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+        state.SetIterationTime(elapsed.count());
+
+        started.wait();
+        qdr.stop();
+        t.join();
+        if (!accepted) {
+            state.SkipWithError("Listener did not accept a connection in time (60 seconds)");
+            break;
+        }
+    }
+}
+
+BENCHMARK(BM_RouterTimeToFirstAccept)->Arg(0)->Arg(1000)->UseManualTime()->Unit(benchmark::kMillisecond);
@@ -23,6 +23,7 @@
 #include "SocketException.hpp"
 #include "TCPSocket.hpp"
 #include "echo_server.hpp"
+#include "socket_utils.hpp"
 
 #include <benchmark/benchmark.h>
 #include <linux/prctl.h>
@@ -44,13 +45,6 @@ extern "C" {
 void qd_error_initialize();
 }  // extern "C"
 
-static unsigned short findFreePort()
-{
-    TCPServerSocket serverSocket(0);
-    unsigned short port = serverSocket.getLocalPort();
-    return port;
-}
-
 static std::stringstream oneRouterTcpConfig(const unsigned short tcpConnectorPort, unsigned short tcpListenerPort)
 {
     std::stringstream router_config;
@@ -157,19 +151,6 @@ static void writeRouterConfig(const std::string &configName, const std::stringst
     f.close();
 }
 
-static TCPSocket try_to_connect(const std::string &servAddress, int echoServPort)
-{
-    auto then = std::chrono::steady_clock::now();
-    while (std::chrono::steady_clock::now() - then < std::chrono::seconds(60)) {
-        try {
-            TCPSocket sock(servAddress, echoServPort);
-            return sock;
-        } catch (SocketException &e) {
-        }
-    }
-    throw std::runtime_error("Failed to connect in time (60 seconds)");
-}
-
 class LatencyMeasure
 {
     static const int RCVBUFSIZE = 32;
@@ -0,0 +1,81 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <thread>
+#include <vector>
+
+/// Number of timers owned by each thread
+static const int TIMERS_PER_THREAD = 64;
+/// Number of schedule/cancel pairs each thread performs per benchmark iteration
+static const int OPS_PER_THREAD = 10000;
+
+static void never_fires(void *context)
+{
+}
+
+/// Measures qd_timer_schedule()/qd_timer_cancel() throughput with a varying number of threads, each rescheduling its
+/// own (per-connection style) timers. Contention on the timer locks shows up as falling per-thread throughput.
+static void BM_TimerScheduleCancel(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDR qdr{};
+        qdr.initialize();
+
+        const int threads = state.range(0);
+
+        for (auto _ : state) {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&qdr] {
+                    qd_timer_t *timers[TIMERS_PER_THREAD];
+                    for (int i = 0; i < TIMERS_PER_THREAD; ++i) {
+                        timers[i] = qd_timer(qdr.qd, never_fires, nullptr);
+                    }
+                    for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                        qd_timer_t *timer = timers[i % TIMERS_PER_THREAD];
+                        qd_timer_schedule(timer, 60000 + (i % 1000));
+                        if (i % 2)
+                            qd_timer_cancel(timer);
+                    }
+                    for (int i = 0; i < TIMERS_PER_THREAD; ++i) {
+                        qd_timer_free(timers[i]);
+                    }
+                });
+            }
+            for (auto &w : workers) {
+                w.join();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * threads * OPS_PER_THREAD);
+        qdr.deinitialize(false);
+    }).join();
+}
+
+BENCHMARK(BM_TimerScheduleCancel)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
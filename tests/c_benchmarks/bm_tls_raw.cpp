@@ -0,0 +1,351 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+#include "socket_utils.hpp"
+
+#include <benchmark/benchmark.h>
+#include <proton/listener.h>
+#include <proton/proactor.h>
+#include <proton/raw_connection.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <time.h>
+
+extern "C" {
+#include "qpid/dispatch/buffer.h"
+#include "qpid/dispatch/log.h"
+#include "qpid/dispatch/threading.h"
+#include "qpid/dispatch/tls_raw.h"
+}  // extern "C"
+
+/// Cleartext octets the client sends to the server per iteration of the throughput benchmark
+static const uint64_t BULK_OCTETS_PER_ITERATION = 16 * 1024 * 1024;
+
+/// Read buffers each raw connection keeps granted to proton
+static const size_t READ_BUFFERS = 16;
+
+/// Time allowed for a handshake or an iteration to complete
+static const int TIMEOUT_SECONDS = 60;
+
+static double threadCpuSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// One end of a TLS session over a raw connection
+struct TlsEndpoint {
+    qd_tls_session_t *session = nullptr;
+    pn_raw_connection_t *raw  = nullptr;
+    bool secure               = false;
+    bool disconnected         = false;
+    uint64_t toSend           = 0;  // cleartext octets left to hand to the session
+    uint64_t received         = 0;  // cleartext octets decrypted by the session
+    size_t batch              = 1;  // cleartext buffers handed to the session per call at most
+
+    static void onSecure(qd_tls_session_t *session, void *context)
+    {
+        static_cast<TlsEndpoint *>(context)->secure = true;
+    }
+
+    static int64_t takeOutput(void *context, qd_buffer_list_t *blist, size_t limit)
+    {
+        auto that     = static_cast<TlsEndpoint *>(context);
+        int64_t taken = 0;
+        for (size_t i = 0; i < std::min(limit, that->batch) && that->toSend > 0; ++i) {
+            qd_buffer_t *buf = qd_buffer();
+            size_t octets    = std::min((uint64_t) qd_buffer_capacity(buf), that->toSend);
+            memset(qd_buffer_cursor(buf), 'x', octets);
+            qd_buffer_insert(buf, octets);
+            DEQ_INSERT_TAIL(*blist, buf);
+            that->toSend -= octets;
+            taken += octets;
+        }
+        return taken;
+    }
+
+    void grantReadBuffers()
+    {
+        size_t count = std::min(pn_raw_connection_read_buffers_capacity(raw), READ_BUFFERS);
+        pn_raw_buffer_t descs[READ_BUFFERS];
+        for (size_t i = 0; i < count; ++i) {
+            qd_buffer_t *buf  = qd_buffer();
+            descs[i].context  = (uintptr_t) buf;
+            descs[i].bytes    = (char *) qd_buffer_base(buf);
+            descs[i].capacity = qd_buffer_capacity(buf);
+            descs[i].offset   = 0;
+            descs[i].size     = 0;
+        }
+        if (count > 0) {
+            pn_raw_connection_give_read_buffers(raw, descs, count);
+        }
+    }
+
+    /// Runs the TLS work loop as the proactor thread that owns the raw connection would
+    bool doIo()
+    {
+        qd_buffer_list_t input = DEQ_EMPTY;
+        uint64_t inputOctets   = 0;
+        sys_thread_proactor_mode_t mode = sys_thread_proactor_set_mode(SYS_THREAD_PROACTOR_MODE_RAW_CONNECTION, raw);
+        int rc = qd_tls_session_do_io(session, raw, takeOutput, this, &input, &inputOctets, LOG_TCP_ADAPTOR, 0);
+        sys_thread_proactor_set_mode(mode, nullptr);
+        received += inputOctets;
+        qd_buffer_list_free_buffers(&input);
+        return rc >= 0;
+    }
+
+    /// Frees the buffers proton still holds once the raw connection is disconnected
+    void releaseBuffers()
+    {
+        pn_raw_buffer_t desc;
+        while (pn_raw_connection_take_read_buffers(raw, &desc, 1) == 1) {
+            qd_buffer_free((qd_buffer_t *) desc.context);
+        }
+        while (pn_raw_connection_take_written_buffers(raw, &desc, 1) == 1) {
+            qd_buffer_free((qd_buffer_t *) desc.context);
+        }
+    }
+};
+
+/// A TLS client and server connected over loopback and driven by one proactor in the calling thread.
+///
+/// qd_tls_session_do_io() works on proton raw connections, which cannot be used without the I/O of a proactor, so the
+/// sessions exchange their records through the loopback interface rather than in memory.
+class TlsPair
+{
+    pn_proactor_t *mProactor;
+    pn_listener_t *mListener;
+    qd_tls_config_t *mServerConfig;
+    qd_tls_config_t *mClientConfig;
+    bool mFailed = false;
+
+    void handle(pn_event_t *event)
+    {
+        switch (pn_event_type(event)) {
+            case PN_LISTENER_ACCEPT:
+                server.raw = pn_raw_connection();
+                pn_raw_connection_set_context(server.raw, &server);
+                pn_listener_raw_accept(mListener, server.raw);
+                break;
+
+            case PN_LISTENER_CLOSE:
+                break;
+
+            case PN_RAW_CONNECTION_CONNECTED:
+            case PN_RAW_CONNECTION_NEED_READ_BUFFERS:
+            case PN_RAW_CONNECTION_NEED_WRITE_BUFFERS:
+            case PN_RAW_CONNECTION_READ:
+            case PN_RAW_CONNECTION_WRITTEN:
+            case PN_RAW_CONNECTION_CLOSED_READ:
+            case PN_RAW_CONNECTION_CLOSED_WRITE:
+            case PN_RAW_CONNECTION_WAKE: {
+                auto endpoint = static_cast<TlsEndpoint *>(pn_raw_connection_get_context(pn_event_raw_connection(event)));
+                endpoint->grantReadBuffers();
+                if (!endpoint->doIo()) {
+                    mFailed = true;
+                }
+                endpoint->grantReadBuffers();
+                break;
+            }
+
+            case PN_RAW_CONNECTION_DISCONNECTED: {
+                auto endpoint = static_cast<TlsEndpoint *>(pn_raw_connection_get_context(pn_event_raw_connection(event)));
+                endpoint->releaseBuffers();
+                endpoint->disconnected = true;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+   public:
+    TlsEndpoint server;
+    TlsEndpoint client;
+    const std::string address;
+
+    TlsPair(const char *serverProfile, const char *clientProfile)
+        : mProactor(pn_proactor()),
+          mListener(pn_listener()),
+          mServerConfig(qd_tls_config(serverProfile, QD_TLS_TYPE_PROTON_RAW, QD_TLS_CONFIG_SERVER_MODE, false, false)),
+          mClientConfig(qd_tls_config(clientProfile, QD_TLS_TYPE_PROTON_RAW, QD_TLS_CONFIG_CLIENT_MODE, false, false)),
+          address("127.0.0.1:" + std::to_string(findFreePort()))
+    {
+        pn_proactor_listen(mProactor, mListener, address.c_str(), 16);
+    }
+
+    ~TlsPair()
+    {
+        pn_listener_close(mListener);
+        pn_proactor_free(mProactor);
+        qd_tls_config_decref(mServerConfig);
+        qd_tls_config_decref(mClientConfig);
+    }
+
+    bool configured() const
+    {
+        return mServerConfig && mClientConfig;
+    }
+
+    /// Processes events until done() or the timeout
+    template <typename Done>
+    bool run(Done done)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+        while (!done() && !mFailed) {
+            pn_proactor_set_timeout(mProactor, 100);
+            pn_event_batch_t *batch = pn_proactor_wait(mProactor);
+            pn_event_t *event;
+            while ((event = pn_event_batch_next(batch))) {
+                if (pn_event_type(event) == PN_PROACTOR_TIMEOUT) {
+                    mFailed = std::chrono::steady_clock::now() > deadline;
+                } else {
+                    handle(event);
+                }
+            }
+            pn_proactor_done(mProactor, batch);
+        }
+        pn_proactor_cancel_timeout(mProactor);
+        return !mFailed;
+    }
+
+    /// Connects a new client to the server and completes the TLS handshake
+    bool connect()
+    {
+        server = TlsEndpoint{};
+        client = TlsEndpoint{};
+        server.session = qd_tls_session_raw(mServerConfig, nullptr, nullptr, 0, &server, TlsEndpoint::onSecure);
+        client.session = qd_tls_session_raw(mClientConfig, "localhost", nullptr, 0, &client, TlsEndpoint::onSecure);
+        client.raw     = pn_raw_connection();
+        pn_raw_connection_set_context(client.raw, &client);
+        pn_proactor_raw_connect(mProactor, client.raw, address.c_str());
+        return run([this] { return server.secure && client.secure; });
+    }
+
+    /// Closes both raw connections and frees the sessions
+    bool disconnect()
+    {
+        pn_raw_connection_close(client.raw);
+        if (server.raw) {
+            pn_raw_connection_close(server.raw);
+        }
+        bool ok = run([this] { return client.disconnected && (!server.raw || server.disconnected); });
+        qd_tls_session_free(client.session);
+        qd_tls_session_free(server.session);
+        return ok;
+    }
+
+    /// Has the client send 'octets' of cleartext and waits until the server has decrypted them
+    bool transfer(uint64_t octets)
+    {
+        const uint64_t target = server.received + octets;
+        client.toSend += octets;
+        pn_raw_connection_wake(client.raw);
+        return run([this, target] { return server.received >= target; });
+    }
+};
+
+/// Measures bulk cleartext throughput from a TLS client to a TLS server session, both ends encrypting or decrypting on
+/// the benchmark thread.
+///
+/// The argument is the number of cleartext buffers handed to the session per take-output call at most. The
+/// MB_per_cpu_second counter is the cleartext throughput per second of CPU used by the thread doing all of the work.
+static void BM_TlsRawThroughput(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDR qdr{};
+        qdr.initialize("tls_raw.conf");
+        qdr.wait();
+
+        {
+            TlsPair pair{"bench-server", "bench-client"};
+            if (!pair.configured() || !pair.connect()) {
+                state.SkipWithError("TLS handshake failed");
+            } else {
+                pair.client.batch = state.range(0);
+
+                double cpuStart = threadCpuSeconds();
+                for (auto _ : state) {
+                    if (!pair.transfer(BULK_OCTETS_PER_ITERATION)) {
+                        state.SkipWithError("transfer failed or timed out");
+                        break;
+                    }
+                }
+                double cpu = threadCpuSeconds() - cpuStart;
+
+                state.SetBytesProcessed(state.iterations() * BULK_OCTETS_PER_ITERATION);
+                state.counters["MB_per_cpu_second"] =
+                    cpu > 0 ? state.iterations() * BULK_OCTETS_PER_ITERATION / cpu / 1e6 : 0;
+                pair.disconnect();
+            }
+        }
+
+        qdr.deinitialize(false);
+    }).join();
+}
+
+BENCHMARK(BM_TlsRawThroughput)
+    ->ArgName("batch")
+    ->RangeMultiplier(4)
+    ->Range(1, 64)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/// Measures full TLS handshakes per second: each iteration connects a new client, completes the handshake on both ends
+/// and closes the connection.
+///
+/// Only full handshakes are measured. Session resumption is implemented for AMQP connections, through the session ids
+/// of proton's SSL layer, but the proton raw TLS API used by qd_tls_session_raw() does not offer resumption.
+static void BM_TlsRawHandshake(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDR qdr{};
+        qdr.initialize("tls_raw.conf");
+        qdr.wait();
+
+        {
+            TlsPair pair{"bench-server", "bench-client"};
+            if (!pair.configured()) {
+                state.SkipWithError("sslProfiles not configured");
+            } else {
+                for (auto _ : state) {
+                    bool ok = pair.connect();
+                    ok      = pair.disconnect() && ok;
+                    if (!ok) {
+                        state.SkipWithError("TLS handshake failed or timed out");
+                        break;
+                    }
+                }
+                state.SetItemsProcessed(state.iterations());
+            }
+        }
+
+        qdr.deinitialize(false);
+    }).join();
+}
+
+BENCHMARK(BM_TlsRawHandshake)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,253 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../cpp/helpers/helpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "vflow_export.h"
+
+#include "qpid/dispatch/amqp.h"
+#include "qpid/dispatch/compose.h"
+#include "qpid/dispatch/iterator.h"
+#include "qpid/dispatch/message.h"
+#include "qpid/dispatch/parse.h"
+#include "qpid/dispatch/vanflow.h"
+}  // extern "C"
+
+// Both benchmarks move the same batches of transport flow records from the vflow thread to a co-located collector:
+// as the AMQP events _vflow_flush_TH sends (composed, then decoded the way a collector does) and through the export
+// ring of vflow_export.h.  The routing of the events, and the copies made by the connection to the collector, are not
+// included, so the AMQP path is measured at its cheapest.  items_per_second counts records.
+//
+static const int BATCH = 50;  // EVENT_BATCH_MAX
+
+struct flow_record_t {
+    std::string identity;
+    std::string parent;
+    std::string source_host;
+    std::string source_port;
+    uint64_t start_time;
+    uint64_t octets;
+    uint64_t octets_out;
+    uint64_t latency;
+};
+
+static std::vector<flow_record_t> make_records()
+{
+    std::vector<flow_record_t> records;
+    for (int i = 0; i < BATCH; ++i) {
+        records.push_back({"abcde:" + std::to_string(1000000 + i), "abcde:42", "10.128.4." + std::to_string(i),
+                           std::to_string(40000 + i), 1700000000000000ULL + i, 123456789ULL * i, 987654ULL * i,
+                           (uint64_t) 250 + i});
+    }
+    return records;
+}
+
+static void BM_VanflowAmqpEvents(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const std::vector<flow_record_t> records = make_records();
+        char text[64];
+        uint64_t decoded = 0;
+
+        for (auto _ : state) {
+            // router: compose the events
+            qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+            qd_compose_start_list(field);
+            qd_compose_insert_long(field, 1);
+            qd_compose_insert_null(field);
+            qd_compose_insert_string(field, "mc/sfe.abcde.flows");
+            qd_compose_insert_string(field, "RECORD");
+            qd_compose_end_list(field);
+            field = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, field);
+            qd_compose_start_list(field);
+            for (const flow_record_t &record : records) {
+                qd_compose_start_map(field);
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_RECORD_TYPE);
+                qd_compose_insert_uint(field, VFLOW_RECORD_BIFLOW_TPORT);
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_IDENTITY);
+                qd_compose_insert_string(field, record.identity.c_str());
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_PARENT);
+                qd_compose_insert_string(field, record.parent.c_str());
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_START_TIME);
+                qd_compose_insert_ulong(field, record.start_time);
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_SOURCE_HOST);
+                qd_compose_insert_string(field, record.source_host.c_str());
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_SOURCE_PORT);
+                qd_compose_insert_string(field, record.source_port.c_str());
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_OCTETS);
+                qd_compose_insert_ulong(field, record.octets);
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_OCTETS_OUT);
+                qd_compose_insert_ulong(field, record.octets_out);
+                qd_compose_insert_uint(field, VFLOW_ATTRIBUTE_LATENCY);
+                qd_compose_insert_ulong(field, record.latency);
+                qd_compose_end_map(field);
+            }
+            qd_compose_end_list(field);
+            qd_message_t *msg = qd_message();
+            qd_message_compose_2(msg, field, true);
+            qd_compose_free(field);
+
+            // collector: decode the records
+            if (qd_message_check_depth(msg, QD_DEPTH_BODY) != QD_MESSAGE_DEPTH_OK) {
+                state.SkipWithError("event did not validate");
+                qd_message_free(msg);
+                break;
+            }
+            qd_iterator_t *iter     = qd_message_field_iterator(msg, QD_FIELD_BODY);
+            qd_parsed_field_t *body = qd_parse(iter);
+            for (uint32_t r = 0; r < qd_parse_sub_count(body); ++r) {
+                qd_parsed_field_t *map = qd_parse_sub_value(body, r);
+                for (uint32_t a = 0; a < qd_parse_sub_count(map); ++a) {
+                    qd_parsed_field_t *value = qd_parse_sub_value(map, a);
+                    uint8_t tag              = qd_parse_tag(value);
+                    if (tag == QD_AMQP_STR8_UTF8 || tag == QD_AMQP_STR32_UTF8) {
+                        qd_iterator_strncpy(qd_parse_raw(value), text, sizeof(text));
+                    } else {
+                        decoded += qd_parse_as_ulong(value);
+                    }
+                }
+            }
+            qd_parse_free(body);
+            qd_iterator_free(iter);
+            qd_message_free(msg);
+        }
+        benchmark::DoNotOptimize(decoded);
+        state.SetItemsProcessed(state.iterations() * BATCH);
+    }).join();
+}
+
+BENCHMARK(BM_VanflowAmqpEvents)->Unit(benchmark::kMicrosecond);
+
+/// Read a value of the export ring at a position, wrapping around the end of the ring
+static void ring_read(const uint8_t *ring, uint64_t mask, uint64_t position, void *out, size_t octets)
+{
+    const uint64_t offset = position & mask;
+    const size_t first    = std::min<size_t>(octets, mask + 1 - offset);
+    memcpy(out, ring + offset, first);
+    memcpy((uint8_t *) out + first, ring, octets - first);
+}
+
+static void BM_VanflowExportRing(benchmark::State &state)
+{
+    std::thread([&state] {
+        QDRMinimalEnv env{};
+        const std::vector<flow_record_t> records = make_records();
+        char path[] = "/tmp/bm-vflow-export-XXXXXX";
+        int fd      = mkstemp(path);
+        if (fd < 0) {
+            state.SkipWithError("cannot create the export file");
+            return;
+        }
+        close(fd);
+
+        // the collector maps the file the router created
+        vflow_export_t *exp = vflow_export(path, 1024 * 1024);
+        fd                  = open(path, O_RDWR);
+        unlink(path);
+        vflow_export_header_t header;
+        if (!exp || fd < 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            state.SkipWithError("cannot map the export file");
+            if (fd >= 0)
+                close(fd);
+            vflow_export_free(exp);
+            return;
+        }
+        const size_t map_octets = header.header_octets + header.ring_octets;
+        uint8_t *base = (uint8_t *) mmap(0, map_octets, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        vflow_export_header_t *shared = (vflow_export_header_t *) base;
+        const uint8_t *ring           = base + header.header_octets;
+        const uint64_t mask           = header.ring_octets - 1;
+
+        char text[64];
+        uint64_t decoded = 0;
+
+        for (auto _ : state) {
+            // router: export the records
+            for (const flow_record_t &record : records) {
+                vflow_export_begin(exp, VFLOW_RECORD_BIFLOW_TPORT, record.identity.c_str());
+                vflow_export_string(exp, VFLOW_ATTRIBUTE_PARENT, record.parent.c_str());
+                vflow_export_uint(exp, VFLOW_ATTRIBUTE_START_TIME, record.start_time);
+                vflow_export_string(exp, VFLOW_ATTRIBUTE_SOURCE_HOST, record.source_host.c_str());
+                vflow_export_string(exp, VFLOW_ATTRIBUTE_SOURCE_PORT, record.source_port.c_str());
+                vflow_export_uint(exp, VFLOW_ATTRIBUTE_OCTETS, record.octets);
+                vflow_export_uint(exp, VFLOW_ATTRIBUTE_OCTETS_OUT, record.octets_out);
+                vflow_export_uint(exp, VFLOW_ATTRIBUTE_LATENCY, record.latency);
+                vflow_export_end(exp);
+            }
+            vflow_export_flush(exp);
+
+            // collector: decode the records
+            const uint64_t end = __atomic_load_n(&shared->write_position, __ATOMIC_ACQUIRE);
+            uint64_t position  = shared->read_position;
+            while (position < end) {
+                uint32_t octets;
+                uint16_t type, count, length;
+                ring_read(ring, mask, position, &octets, sizeof(octets));
+                ring_read(ring, mask, position + 6, &count, sizeof(count));
+                ring_read(ring, mask, position + 8, &length, sizeof(length));
+                ring_read(ring, mask, position + 10, text, std::min<size_t>(length, sizeof(text)));
+                uint64_t cursor = position + 10 + length;
+                for (uint16_t a = 0; a < count; ++a) {
+                    uint8_t kind;
+                    ring_read(ring, mask, cursor, &type, sizeof(type));
+                    ring_read(ring, mask, cursor + 2, &kind, sizeof(kind));
+                    cursor += 3;
+                    if (kind == VFLOW_EXPORT_UINT) {
+                        uint64_t value;
+                        ring_read(ring, mask, cursor, &value, sizeof(value));
+                        decoded += value;
+                        cursor += sizeof(value);
+                    } else {
+                        ring_read(ring, mask, cursor, &length, sizeof(length));
+                        ring_read(ring, mask, cursor + 2, text, std::min<size_t>(length, sizeof(text)));
+                        cursor += 2 + length;
+                    }
+                }
+                position += octets;
+            }
+            __atomic_store_n(&shared->read_position, position, __ATOMIC_RELEASE);
+        }
+        if (__atomic_load_n(&shared->dropped_records, __ATOMIC_RELAXED) != 0) {
+            state.SkipWithError("records were dropped");
+        }
+        benchmark::DoNotOptimize(decoded);
+        state.SetItemsProcessed(state.iterations() * BATCH);
+        munmap(base, map_octets);
+        vflow_export_free(exp);
+    }).join();
+}
+
+BENCHMARK(BM_VanflowExportRing)->Unit(benchmark::kMicrosecond);
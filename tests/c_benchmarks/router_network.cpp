@@ -0,0 +1,268 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "router_network.hpp"
+
+#include "../cpp/helpers/helpers.hpp"
+#include "SocketException.hpp"
+#include "TCPSocket.hpp"
+#include "socket_utils.hpp"
+
+#include <dirent.h>
+#include <linux/prctl.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <sstream>
+
+Scenario linear(int count)
+{
+    Scenario scenario;
+    for (int i = 0; i < count; ++i) {
+        scenario.routers.push_back({std::string(1, (char) ('A' + i)), false});
+        if (i > 0) {
+            scenario.links.emplace_back(i, i - 1);
+        }
+    }
+    scenario.ingress = 0;
+    scenario.egress  = {count - 1};
+    return scenario;
+}
+
+/// User and system CPU time from a proc(5) stat file
+static double statCpuSeconds(const std::string &path)
+{
+    std::ifstream stat(path);
+    std::string line;
+    std::getline(stat, line);
+    size_t end = line.rfind(')');  // the command name may contain spaces
+    if (end == std::string::npos) {
+        return 0;
+    }
+    std::istringstream fields(line.substr(end + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {  // utime and stime are fields 14 and 15 of proc(5)
+        if (i == 14) {
+            utime = std::stoull(field);
+        } else if (i == 15) {
+            stime = std::stoull(field);
+        }
+    }
+    return (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+RouterProcess::RouterProcess(const std::string &configName)
+{
+    pid = fork();
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGHUP);
+        QDR qdr{};
+        qdr.initialize(configName);
+        qdr.wait();
+
+        qdr.run();  // this never returns until signal is sent, and then process dies
+        _exit(0);
+    }
+}
+
+RouterProcess::~RouterProcess()
+{
+    if (kill(pid, SIGTERM) != 0) {
+        perror("Killing router");
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        perror("Waiting for child");
+    }
+}
+
+double RouterProcess::cpuSeconds() const
+{
+    return statCpuSeconds("/proc/" + std::to_string(pid) + "/stat");
+}
+
+std::vector<std::pair<pid_t, double>> RouterProcess::threadCpuSeconds(const std::string &prefix) const
+{
+    std::vector<std::pair<pid_t, double>> threads;
+    const std::string tasks = "/proc/" + std::to_string(pid) + "/task/";
+    DIR *dir                = opendir(tasks.c_str());
+    if (!dir) {
+        return threads;
+    }
+    while (dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::ifstream comm(tasks + entry->d_name + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            threads.emplace_back(std::stoi(entry->d_name), statCpuSeconds(tasks + entry->d_name + "/stat"));
+        }
+    }
+    closedir(dir);
+    return threads;
+}
+
+size_t RouterProcess::rssBytes() const
+{
+    std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::string Network::config(int router, const std::vector<unsigned short> &tcpConnectorPorts) const
+{
+    const RouterSpec &spec = mScenario.routers[router];
+    const Ports &ports     = mPorts[router];
+    std::stringstream c;
+
+    c << "router {\n    mode: " << (spec.edge ? "edge" : "interior") << "\n    id: " << spec.id << "\n}\n\n";
+    c << "listener {\n    host: 127.0.0.1\n    port: " << ports.amqp << "\n    saslMechanisms: ANONYMOUS\n}\n\n";
+    if (!spec.edge) {
+        c << "listener {\n    role: inter-router\n    host: 127.0.0.1\n    port: " << ports.interRouter
+          << "\n    saslMechanisms: ANONYMOUS\n}\n\n";
+        c << "listener {\n    role: edge\n    host: 127.0.0.1\n    port: " << ports.edge
+          << "\n    saslMechanisms: ANONYMOUS\n}\n\n";
+    }
+    for (const auto &link : mScenario.links) {
+        if (link.first == router) {
+            const Ports &peer = mPorts[link.second];
+            c << "connector {\n    role: " << (spec.edge ? "edge" : "inter-router")
+              << "\n    host: 127.0.0.1\n    port: " << (spec.edge ? peer.edge : peer.interRouter)
+              << "\n    saslMechanisms: ANONYMOUS\n}\n\n";
+        }
+    }
+    if (router == mScenario.ingress) {
+        c << "tcpListener {\n    host: 127.0.0.1\n    port: " << mTcpListenerPort
+          << "\n    address: bench-tcp\n    siteId: bench\n}\n\n";
+        c << mScenario.ingressConfig;
+    }
+    if (std::find(mScenario.egress.begin(), mScenario.egress.end(), router) != mScenario.egress.end()) {
+        for (unsigned short port : tcpConnectorPorts) {
+            c << "tcpConnector {\n    host: 127.0.0.1\n    port: " << port
+              << "\n    address: bench-tcp\n    siteId: bench\n}\n\n";
+        }
+    }
+    c << "address {\n    prefix: multicast\n    distribution: multicast\n}\n\n";
+    c << "address {\n    prefix: closest\n    distribution: closest\n}\n\n";
+    c << "log {\n    module: DEFAULT\n    enable: warn+\n}\n";
+    return c.str();
+}
+
+Network::Network(const std::string &name, const Scenario &scenario,
+                 const std::vector<unsigned short> &tcpConnectorPorts)
+    : mScenario(scenario), mTcpListenerPort(findFreePort())
+{
+    for (size_t i = 0; i < scenario.routers.size(); ++i) {
+        mPorts.push_back({findFreePort(), findFreePort(), findFreePort()});
+    }
+    for (size_t i = 0; i < scenario.routers.size(); ++i) {
+        std::string configName = name + "_" + scenario.routers[i].id + ".conf";
+        std::fstream f(configName, std::ios::out);
+        f << config(i, tcpConnectorPorts);
+        f.close();
+        mRouters.push_back(std::make_unique<RouterProcess>(configName));
+    }
+}
+
+std::vector<double> Network::cpuSeconds() const
+{
+    std::vector<double> seconds;
+    for (const auto &router : mRouters) {
+        seconds.push_back(router->cpuSeconds());
+    }
+    return seconds;
+}
+
+CpuUsage::CpuUsage(const Scenario &scenario, const Network &network)
+    : mScenario(scenario), mNetwork(network), mStart(network.cpuSeconds()), mStartTime(std::chrono::steady_clock::now())
+{
+}
+
+void CpuUsage::report(benchmark::State &state)
+{
+    std::vector<double> end = mNetwork.cpuSeconds();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+    for (size_t i = 0; i < end.size(); ++i) {
+        state.counters["cpu_" + mScenario.routers[i].id] = wall > 0 ? (end[i] - mStart[i]) / wall : 0;
+    }
+}
+
+void reportLatency(benchmark::State &state, std::vector<uint64_t> &samples, const std::string &prefix)
+{
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, (size_t) (p * samples.size()))] / 1000.0;
+    };
+    state.counters[prefix + "p50_us"]  = percentile(0.50);
+    state.counters[prefix + "p99_us"]  = percentile(0.99);
+    state.counters[prefix + "p999_us"] = percentile(0.999);
+}
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+EchoService::EchoService(unsigned short port) : mServer(port, 64)
+{
+    mAcceptor = std::thread([this] {
+        try {
+            while (true) {
+                TCPSocket *sock = mServer.accept();
+                std::lock_guard<std::mutex> lock(mLock);
+                mConnections.emplace_back([sock] {
+                    std::vector<char> buffer(64 * 1024);
+                    try {
+                        int received;
+                        while ((received = sock->recv(buffer.data(), buffer.size())) > 0) {
+                            sock->send(buffer.data(), received);
+                        }
+                    } catch (SocketException &e) {
+                    }
+                    delete sock;
+                });
+            }
+        } catch (SocketException &e) {
+            // shut down
+        }
+    });
+}
+
+EchoService::~EchoService()
+{
+    mServer.shutdown();
+    mAcceptor.join();
+    for (auto &t : mConnections) {
+        t.join();
+    }
+}
@@ -0,0 +1,150 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#ifndef QPID_DISPATCH_ROUTER_NETWORK_HPP
+#define QPID_DISPATCH_ROUTER_NETWORK_HPP
+
+#include "TCPServerSocket.hpp"
+
+#include <benchmark/benchmark.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct RouterSpec {
+    std::string id;
+    bool edge;
+};
+
+/// A router network and where its clients and servers attach
+struct Scenario {
+    std::vector<RouterSpec> routers;
+    std::vector<std::pair<int, int>> links;  // the first router of each pair connects to the second
+    int ingress;                             // clients connect to this router
+    std::vector<int> egress;                 // servers and receivers attach to these routers
+    std::string ingressConfig;               // further configuration entities of the ingress router
+};
+
+/// Interior routers connected in a chain, as in tests/config-3-linear
+Scenario linear(int count);
+
+/// A router running in a child process
+class RouterProcess
+{
+    pid_t pid;
+
+   public:
+    explicit RouterProcess(const std::string &configName);
+    ~RouterProcess();
+
+    /// User and system CPU time consumed by the router
+    double cpuSeconds() const;
+
+    /// User and system CPU time consumed by each of the router's threads whose name starts with the prefix
+    std::vector<std::pair<pid_t, double>> threadCpuSeconds(const std::string &prefix) const;
+
+    /// Resident set size of the router
+    size_t rssBytes() const;
+};
+
+/// The routers of a scenario with the configuration generated for them. The egress routers have a tcpConnector to
+/// each of the given ports, all for the address of the tcpListener on the ingress router.
+class Network
+{
+    struct Ports {
+        unsigned short amqp;
+        unsigned short interRouter;
+        unsigned short edge;
+    };
+
+    const Scenario &mScenario;
+    std::vector<Ports> mPorts;
+    std::vector<std::unique_ptr<RouterProcess>> mRouters;
+    unsigned short mTcpListenerPort;
+
+    std::string config(int router, const std::vector<unsigned short> &tcpConnectorPorts) const;
+
+   public:
+    Network(const std::string &name, const Scenario &scenario, const std::vector<unsigned short> &tcpConnectorPorts);
+    Network(const std::string &name, const Scenario &scenario, unsigned short tcpConnectorPort)
+        : Network(name, scenario, std::vector<unsigned short>{tcpConnectorPort})
+    {
+    }
+
+    unsigned short amqpPort(int router) const
+    {
+        return mPorts[router].amqp;
+    }
+
+    unsigned short tcpListenerPort() const
+    {
+        return mTcpListenerPort;
+    }
+
+    const RouterProcess &router(int router) const
+    {
+        return *mRouters[router];
+    }
+
+    std::vector<double> cpuSeconds() const;
+};
+
+/// Reports the CPU used by each router of a network between construction and report() as a fraction of a core
+class CpuUsage
+{
+    const Scenario &mScenario;
+    const Network &mNetwork;
+    std::vector<double> mStart;
+    std::chrono::steady_clock::time_point mStartTime;
+
+   public:
+    CpuUsage(const Scenario &scenario, const Network &network);
+    void report(benchmark::State &state);
+};
+
+/// Reports the p50/p99/p999 of latency samples in nanoseconds as the <prefix>p50_us... counters in microseconds
+void reportLatency(benchmark::State &state, std::vector<uint64_t> &samples, const std::string &prefix = "");
+
+uint64_t nowNs();
+
+/// Echoes any number of concurrent connections, one thread each
+class EchoService
+{
+    TCPServerSocket mServer;
+    std::thread mAcceptor;
+    std::mutex mLock;
+    std::vector<std::thread> mConnections;
+
+   public:
+    explicit EchoService(unsigned short port);
+
+    /// The clients must have closed their connections
+    ~EchoService();
+};
+
+#endif  // QPID_DISPATCH_ROUTER_NETWORK_HPP
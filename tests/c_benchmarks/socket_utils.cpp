@@ -22,11 +22,14 @@
 #include "socket_utils.hpp"
 
 #include "SocketException.hpp"
+#include "TCPServerSocket.hpp"
+#include "TCPSocket.hpp"
 
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include <chrono>
 #include <stdexcept>
 
 void fillSockAddr(const std::string &address, unsigned short port, sockaddr_in &addr)
@@ -50,3 +53,23 @@ void fillSockAddr(const std::string &address, unsigned short port, sockaddr_in &
         throw SocketException("Name was not resolved to IPv4 (gethostbyname())");
     }
 }
+
+unsigned short findFreePort()
+{
+    TCPServerSocket serverSocket(0);
+    unsigned short port = serverSocket.getLocalPort();
+    return port;
+}
+
+TCPSocket try_to_connect(const std::string &servAddress, int echoServPort)
+{
+    auto then = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - then < std::chrono::seconds(60)) {
+        try {
+            TCPSocket sock(servAddress, echoServPort);
+            return sock;
+        } catch (SocketException &e) {
+        }
+    }
+    throw std::runtime_error("Failed to connect in time (60 seconds)");
+}
@@ -37,4 +37,12 @@ inline void zero(T &value)
 
 void fillSockAddr(const std::string &address, unsigned short port, sockaddr_in &addr);
 
+class TCPSocket;
+
+/// Returns a port that was free when this function was called
+unsigned short findFreePort();
+
+/// Retries the connection for up to 60 seconds, e.g. until a router starts listening
+TCPSocket try_to_connect(const std::string &servAddress, int echoServPort);
+
 #endif  // QPID_DISPATCH_SOCKET_UTILS_HPP
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""
+Record c-benchmarks results as baselines and compare them for regressions.
+
+    track_benchmarks.py run <c-benchmarks binary> [--baseline-dir DIR | --out FILE] [--repetitions N]
+    track_benchmarks.py compare <baseline> <current> [--threshold FRACTION] [--alpha P]
+
+'run' runs every benchmark with repetitions and saves the Google Benchmark JSON output, with the commit it was built
+from, as <baseline-dir>/<commit>.json.  'compare' takes two such files, or a baseline directory and a commit, and
+tests each benchmark's repetitions with the two-sided Mann-Whitney U test.  A benchmark regressed if the test is
+significant at alpha and its median time grew by more than the threshold; the exit status is then 1.
+
+Benchmark times are only comparable between runs on the same machine with the same build type.  For a local check
+record a baseline before a change and compare after it:
+
+    track_benchmarks.py run build/tests/c_benchmarks/c-benchmarks --baseline-dir baselines
+    ...
+    track_benchmarks.py run build/tests/c_benchmarks/c-benchmarks --out after.json
+    track_benchmarks.py compare baselines/<commit>.json after.json
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+TIME_UNITS = {'ns': 1.0, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def git_commit(path):
+    try:
+        return subprocess.check_output(['git', '-C', path, 'rev-parse', 'HEAD'], text=True,
+                                       stderr=subprocess.DEVNULL).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run(args):
+    binary = os.path.abspath(args.binary)
+    commit = args.commit or git_commit(os.path.dirname(os.path.abspath(__file__))) or 'unknown'
+    out = args.out or os.path.join(args.baseline_dir, commit + '.json')
+    os.makedirs(os.path.dirname(os.path.abspath(out)), exist_ok=True)
+
+    with tempfile.NamedTemporaryFile(suffix='.json') as raw:
+        command = [binary,
+                   '--benchmark_repetitions=%d' % args.repetitions,
+                   '--benchmark_out=%s' % raw.name,
+                   '--benchmark_out_format=json']
+        if args.min_time is not None:
+            command.append('--benchmark_min_time=%s' % args.min_time)
+        if args.filter:
+            command.append('--benchmark_filter=%s' % args.filter)
+        command += args.benchmark_args
+        # the benchmarks read their configuration files from the binary's directory
+        subprocess.check_call(command, cwd=os.path.dirname(binary))
+        with open(raw.name) as f:
+            results = json.load(f)
+
+    results['context']['skupper_router_commit'] = commit
+    with open(out, 'w') as f:
+        json.dump(results, f, indent=1)
+    print("Saved %s" % out)
+    return 0
+
+
+def load_samples(path, metric):
+    """
+    Map each benchmark name to the list of its repetition times in nanoseconds
+    """
+    with open(path) as f:
+        results = json.load(f)
+    samples = {}
+    for b in results['benchmarks']:
+        if b.get('run_type', 'iteration') != 'iteration' or b.get('error_occurred'):
+            continue
+        name = b.get('run_name', b['name'])
+        samples.setdefault(name, []).append(b[metric] * TIME_UNITS[b.get('time_unit', 'ns')])
+    return samples
+
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    return values[middle] if len(values) % 2 else (values[middle - 1] + values[middle]) / 2.0
+
+
+def mann_whitney_p(x, y):
+    """
+    Two-sided p-value of the Mann-Whitney U test by the normal approximation with tie correction, which is
+    adequate from about five repetitions per sample
+    """
+    n1, n2 = len(x), len(y)
+    combined = sorted([(v, 0) for v in x] + [(v, 1) for v in y])
+    ranks = [0.0] * len(combined)
+    ties = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1
+        t = j - i + 1
+        ties += t ** 3 - t
+        i = j + 1
+    r1 = sum(rank for rank, (_, sample) in zip(ranks, combined) if sample == 0)
+    u = r1 - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (abs(u - n1 * n2 / 2.0) - 0.5) / math.sqrt(variance)
+    return min(1.0, math.erfc(max(z, 0.0) / math.sqrt(2)))
+
+
+def threshold_for(name, args):
+    for pattern, threshold in args.threshold_for:
+        if re.search(pattern, name):
+            return threshold
+    return args.threshold
+
+
+def resolve(path, commit):
+    return os.path.join(path, commit + '.json') if os.path.isdir(path) and commit else path
+
+
+def compare(args):
+    baseline = load_samples(resolve(args.baseline, args.baseline_commit), args.metric)
+    current  = load_samples(args.current, args.metric)
+
+    regressions = []
+    rows = []
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            rows.append((name, None, None, None, 'removed'))
+            continue
+        if name not in baseline:
+            rows.append((name, None, median(current[name]), None, 'new'))
+            continue
+        before, after = median(baseline[name]), median(current[name])
+        change = after / before - 1.0 if before else 0.0
+        p = mann_whitney_p(baseline[name], current[name])
+        limit = threshold_for(name, args)
+        status = ''
+        if p < args.alpha and change > limit:
+            status = 'REGRESSION'
+            regressions.append(name)
+        elif p < args.alpha and change < -limit:
+            status = 'improved'
+        rows.append((name, before, after, (change, p), status))
+
+    width = max([len(r[0]) for r in rows] + [9])
+    print("%-*s %14s %14s %9s %8s  %s" % (width, 'benchmark', 'baseline ns', 'current ns', 'change', 'p', ''))
+    for name, before, after, stats, status in rows:
+        print("%-*s %14s %14s %9s %8s  %s" % (
+            width, name,
+            '%.1f' % before if before is not None else '-',
+            '%.1f' % after if after is not None else '-',
+            '%+.1f%%' % (stats[0] * 100) if stats else '-',
+            '%.4f' % stats[1] if stats else '-',
+            status))
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump([{'benchmark': name, 'baseline_ns': before, 'current_ns': after,
+                        'change': stats[0] if stats else None, 'p': stats[1] if stats else None,
+                        'status': status} for name, before, after, stats, status in rows], f, indent=1)
+
+    if regressions:
+        print("\n%d benchmark(s) regressed by more than the threshold" % len(regressions))
+        return 1
+    return 0
+
+
+def threshold_override(value):
+    pattern, _, threshold = value.rpartition('=')
+    if not pattern:
+        raise argparse.ArgumentTypeError("expected REGEX=FRACTION")
+    return pattern, float(threshold)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Record and compare c-benchmarks baselines")
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    p = commands.add_parser('run', help="run the benchmarks and save the results")
+    p.add_argument('binary', help="the c-benchmarks executable")
+    p.add_argument('--baseline-dir', default='baselines', help="save as <dir>/<commit>.json (default: %(default)s)")
+    p.add_argument('--out', help="save to this file instead")
+    p.add_argument('--commit', help="commit to record, by default the HEAD of the source tree")
+    p.add_argument('--repetitions', type=int, default=10)
+    p.add_argument('--min-time', help="--benchmark_min_time of every repetition")
+    p.add_argument('--filter', help="--benchmark_filter regular expression")
+    p.add_argument('benchmark_args', nargs='*', help="further arguments for the benchmark binary, after --")
+    p.set_defaults(func=run)
+
+    p = commands.add_parser('compare', help="compare results against a baseline")
+    p.add_argument('baseline', help="baseline file, or baseline directory with --baseline-commit")
+    p.add_argument('current', help="results to check")
+    p.add_argument('--baseline-commit', help="commit of the baseline in the baseline directory")
+    p.add_argument('--metric', choices=['real_time', 'cpu_time'], default='real_time')
+    p.add_argument('--threshold', type=float, default=0.05,
+                   help="median slowdown tolerated as a fraction (default: %(default)s)")
+    p.add_argument('--threshold-for', type=threshold_override, action='append', default=[], metavar='REGEX=FRACTION',
+                   help="threshold of the benchmarks matching a regular expression, may be repeated")
+    p.add_argument('--alpha', type=float, default=0.01, help="significance level (default: %(default)s)")
+    p.add_argument('--json', help="also write the comparison to this file")
+    p.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -500,6 +500,150 @@ exit:
     return error;
 }
 
+// Encodings that straddle buffer boundaries, and the bulk string and symbol inserts
+static char *test_compose_buffer_boundaries(void *context)
+{
+    static const char *const names[] = {"alpha", "", "gamma", 0};
+    char                *error = 0;
+    qd_buffer_list_t     blist = DEQ_EMPTY;
+    qd_composed_field_t *field = qd_compose_subfield(0);
+
+    qd_compose_start_list(field);
+    for (uint64_t i = 0; i < 4000; i++) {
+        qd_compose_insert_ulong(field, 0x0102030405060708 + i);
+        qd_compose_insert_uint(field, 0x10000 + (uint32_t) i);
+        qd_compose_insert_string(field, (i & 1) ? "odd" : "even");
+    }
+    qd_compose_insert_strings(field, names, 4);
+    qd_compose_insert_symbols(field, names, 3);
+    qd_compose_end_list(field);
+    qd_compose_take_buffers(field, &blist);
+    qd_compose_free(field);
+
+    if (DEQ_SIZE(blist) < 2) {
+        error = "Expected the list to span buffers";
+        goto exit;
+    }
+
+    qd_iterator_t     *iter = qd_iterator_buffer(DEQ_HEAD(blist), 0, qd_buffer_list_length(&blist), ITER_VIEW_ALL);
+    qd_parsed_field_t *list = qd_parse(iter);
+    qd_iterator_free(iter);
+    if (!qd_parse_ok(list) || qd_parse_sub_count(list) != 4000 * 3 + 4 + 3) {
+        error = "Failed to parse the list";
+        qd_parse_free(list);
+        goto exit;
+    }
+
+    qd_parsed_field_t *item = qd_field_first_child(list);
+    for (uint64_t i = 0; i < 4000 && !error; i++) {
+        if (qd_parse_as_ulong(item) != 0x0102030405060708 + i)
+            error = "Wrong ulong";
+        item = qd_field_next_child(item);
+        if (qd_parse_as_uint(item) != 0x10000 + (uint32_t) i)
+            error = "Wrong uint";
+        item = qd_field_next_child(item);
+        if (!qd_iterator_equal(qd_parse_raw(item), (const unsigned char *) ((i & 1) ? "odd" : "even")))
+            error = "Wrong string";
+        item = qd_field_next_child(item);
+    }
+    for (int i = 0; i < 7 && !error; i++) {
+        const char *expected = names[i < 4 ? i : i - 4];
+        uint8_t     tag      = i < 4 ? QD_AMQP_STR8_UTF8 : QD_AMQP_SYM8;
+        if (qd_parse_tag(item) != tag || !qd_iterator_equal(qd_parse_raw(item), (const unsigned char *) (expected ? expected : "")))
+            error = "Wrong bulk inserted element";
+        item = qd_field_next_child(item);
+    }
+    qd_parse_free(list);
+
+exit:
+    qd_buffer_list_free_buffers(&blist);
+    return error;
+}
+
+static void compose_template_headers(qd_composed_field_t *field)
+{
+    qd_compose_start_list(field);
+    qd_compose_insert_null(field);
+    qd_compose_insert_null(field);
+    qd_compose_insert_string(field, "_topo/0/all/qdrouter.ma");
+    qd_compose_end_list(field);
+}
+
+
+static void compose_template_body(qd_composed_field_t *field, int i)
+{
+    qd_compose_start_map(field);
+    qd_compose_insert_symbol(field, "seq");
+    qd_compose_insert_long(field, i);
+    qd_compose_insert_symbol(field, "id");
+    qd_compose_insert_string(field, "router-A");
+    qd_compose_end_map(field);
+}
+
+
+static bool compose_buffers_equal(qd_composed_field_t *a, qd_composed_field_t *b)
+{
+    qd_buffer_list_t *la = qd_compose_buffers(a);
+    qd_buffer_list_t *lb = qd_compose_buffers(b);
+    size_t            len = qd_buffer_list_length(la);
+    if (len != qd_buffer_list_length(lb))
+        return false;
+
+    qd_iterator_t *ia    = qd_iterator_buffer(DEQ_HEAD(*la), 0, len, ITER_VIEW_ALL);
+    qd_iterator_t *ib    = qd_iterator_buffer(DEQ_HEAD(*lb), 0, len, ITER_VIEW_ALL);
+    bool           equal = true;
+    while (equal && !qd_iterator_end(ia))
+        equal = qd_iterator_octet(ia) == qd_iterator_octet(ib);
+    qd_iterator_free(ia);
+    qd_iterator_free(ib);
+    return equal;
+}
+
+
+static char *test_compose_template(void *context)
+{
+    char *error = 0;
+
+    qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+    compose_template_headers(field);
+    qd_compose_template_t *tmpl = qd_compose_template(field);
+    qd_compose_free(field);
+
+    for (int i = 0; i < 3 && !error; i++) {
+        // standalone field extended after the template and template appended to a field
+        qd_composed_field_t *expected = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+        compose_template_headers(expected);
+        expected = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, expected);
+        compose_template_body(expected, i);
+
+        qd_composed_field_t *actual = qd_compose_from_template(tmpl, 0);
+        actual = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, actual);
+        compose_template_body(actual, i);
+
+        if (!compose_buffers_equal(expected, actual))
+            error = "Field started from a template differs";
+        qd_compose_free(actual);
+
+        qd_composed_field_t *prefix = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
+        compose_template_body(prefix, i);
+        qd_compose_free(expected);
+        expected = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, 0);
+        compose_template_body(expected, i);
+        expected = qd_compose(QD_PERFORMATIVE_PROPERTIES, expected);
+        compose_template_headers(expected);
+
+        actual = qd_compose_from_template(tmpl, prefix);
+        if (!error && !compose_buffers_equal(expected, actual))
+            error = "Template appended to a field differs";
+        qd_compose_free(actual);
+        qd_compose_free(expected);
+    }
+
+    qd_compose_template_free(tmpl);
+    return error;
+}
+
+
 int compose_tests(void)
 {
     int result = 0;
@@ -513,6 +657,8 @@ int compose_tests(void)
     TEST_CASE(test_compose_scalars, 0);
     TEST_CASE(test_compose_subfields, 0);
     TEST_CASE(test_compose_buffer_field, 0);
+    TEST_CASE(test_compose_buffer_boundaries, 0);
+    TEST_CASE(test_compose_template, 0);
 
     return result;
 }
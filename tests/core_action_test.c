@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "router_core/router_core_private.h"
+#include "test_case.h"
+
+#include "qpid/dispatch/threading.h"
+
+#include <stdio.h>
+#include <string.h>
+
+//
+// The actions run on the core thread of the router started by run_unit_tests.  Each records its id in the order it
+// ran.  The gate action holds the core thread until the test has queued the actions that must overtake the ones
+// already waiting.
+//
+
+#define MAX_RUN 16
+
+static sys_mutex_t lock;
+static sys_cond_t  cond;
+static int         run_order[MAX_RUN];
+static int         run_count;
+static bool        gate_entered;
+static bool        gate_open;
+
+
+static void record_CT(qdr_core_t *core, qdr_action_t *action, bool discard)
+{
+    int  id   = (int) (long) action->args.general.context_1;
+    bool gate = !!action->args.general.context_2;
+
+    sys_mutex_lock(&lock);
+    if (run_count < MAX_RUN)
+        run_order[run_count] = id;
+    run_count++;
+    if (gate) {
+        gate_entered = true;
+        sys_cond_signal_all(&cond);
+        while (!gate_open)
+            sys_cond_wait(&cond, &lock);
+    }
+    sys_cond_signal_all(&cond);
+    sys_mutex_unlock(&lock);
+}
+
+
+static qdr_action_t *test_action(int id, bool gate)
+{
+    qdr_action_t *action           = qdr_action(record_CT, "core_action_test");
+    action->args.general.context_1 = (void *) (long) id;
+    action->args.general.context_2 = gate ? (void *) 1 : 0;
+    return action;
+}
+
+
+static void reset(void)
+{
+    sys_mutex_lock(&lock);
+    run_count    = 0;
+    gate_entered = false;
+    gate_open    = false;
+    sys_mutex_unlock(&lock);
+}
+
+
+static void wait_for_gate(void)
+{
+    sys_mutex_lock(&lock);
+    while (!gate_entered)
+        sys_cond_wait(&cond, &lock);
+    sys_mutex_unlock(&lock);
+}
+
+
+// Open the gate and wait until count actions have run, return 0 if they ran in the expected order
+static char *open_gate_and_check(int count, const int *expected)
+{
+    char *result = 0;
+
+    sys_mutex_lock(&lock);
+    gate_open = true;
+    sys_cond_signal_all(&cond);
+    while (run_count < count)
+        sys_cond_wait(&cond, &lock);
+    if (run_count != count)
+        result = "Unexpected number of actions run";
+    else if (memcmp(run_order, expected, count * sizeof(int)) != 0)
+        result = "Actions ran out of order";
+    sys_mutex_unlock(&lock);
+    return result;
+}
+
+
+// Control actions queued while a foreground batch is running overtake the rest of the batch and waiting background
+// actions, and stay in order with each other
+static char *test_control_overtakes_batch(void *context)
+{
+    qdr_core_t *core = (qdr_core_t *) context;
+    reset();
+
+    // one batch: the core thread takes all three foreground actions at once
+    qdr_action_batch_begin();
+    qdr_action_enqueue(core, test_action(1, true));
+    qdr_action_enqueue(core, test_action(2, false));
+    qdr_action_enqueue(core, test_action(3, false));
+    qdr_action_batch_flush();
+    wait_for_gate();
+
+    qdr_action_background_enqueue(core, test_action(4, false));
+    qdr_action_control_enqueue(core, test_action(5, false));
+    qdr_action_control_enqueue(core, test_action(6, false));
+
+    static const int expected[] = {1, 5, 6, 2, 3, 4};
+    return open_gate_and_check(6, expected);
+}
+
+
+// Control actions queued while a background action is running run before the next background action
+static char *test_control_overtakes_background(void *context)
+{
+    qdr_core_t *core = (qdr_core_t *) context;
+    reset();
+
+    qdr_action_background_enqueue(core, test_action(1, true));
+    wait_for_gate();
+
+    qdr_action_background_enqueue(core, test_action(2, false));
+    qdr_action_control_enqueue(core, test_action(3, false));
+
+    static const int expected[] = {1, 3, 2};
+    return open_gate_and_check(3, expected);
+}
+
+
+int core_action_tests(qdr_core_t *core)
+{
+    int result = 0;
+    char *test_group = "core_action_tests";
+
+    sys_mutex_init(&lock);
+    sys_cond_init(&cond);
+
+    TEST_CASE(test_control_overtakes_batch, core);
+    TEST_CASE(test_control_overtakes_background, core);
+
+    sys_cond_free(&cond);
+    sys_mutex_free(&lock);
+    return result;
+}
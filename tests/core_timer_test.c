@@ -177,12 +177,73 @@ static char* test_core_timer(void *context)
 }
 
 
+static uint64_t fired_at[8];
+static int      fired_count[8];
+static uint64_t ticks;
+
+static void wheel_callback(qdr_core_t *unused, void *context) {
+    fired_at[(long) context] = ticks;
+    fired_count[(long) context]++;
+}
+
+
+static char* test_core_timer_wheel(void *context)
+{
+    static const uint32_t delays[8] = {63, 64, 65, 4095, 4096, 5000, 300000, 70000};
+    qdr_core_t *core = NEW(qdr_core_t);
+    ZERO(core);
+
+    qdr_core_timer_t *timers[8];
+
+    //
+    // Start part way into the level-0 slots so timers straddle level boundaries
+    //
+    ticks = 0;
+    for (int i = 0; i < 10; i++, ticks++)
+        qdr_process_tick_CT(core, 0, false);
+
+    for (long i = 0; i < 8; i++) {
+        timers[i]      = qdr_core_timer_CT(core, wheel_callback, (void*) i);
+        fired_at[i]    = 0;
+        fired_count[i] = 0;
+        qdr_core_timer_schedule_CT(core, timers[i], delays[i]);
+    }
+
+    //
+    // Cancel one of the timers held in a higher level of the wheel
+    //
+    qdr_core_timer_cancel_CT(core, timers[7]);
+
+    uint64_t start = ticks;
+    while (ticks < start + 300001) {
+        ticks++;
+        qdr_process_tick_CT(core, 0, false);
+    }
+
+    for (int i = 0; i < 7; i++) {
+        if (fired_count[i] != 1)
+            return "Expected each timer to fire exactly once";
+        if (fired_at[i] != start + delays[i] + 1)
+            return "Timer fired on the wrong tick";
+    }
+    if (fired_count[7] != 0)
+        return "Cancelled timer fired";
+
+    for (long i = 0; i < 8; i++)
+        qdr_core_timer_free_CT(core, timers[i]);
+    free(core);
+
+    return 0;
+}
+
+
 int core_timer_tests(void)
 {
     int result = 0;
     char *test_group = "core_timer_tests";
 
     TEST_CASE(test_core_timer, 0);
+    TEST_CASE(test_core_timer_wheel, 0);
 
     return result;
 }
@@ -0,0 +1,58 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "qdr_doctest.hpp"
+#include "helpers.hpp"
+
+extern "C" {
+#include <../src/router_core/router_core_private.h>
+
+#include <stdlib.h>
+}
+
+// Routers are expected to hold millions of mobile addresses, guard the per-address footprint.  Raise the budget only
+// for state every address needs, anything else belongs in qdr_address_ext_t.
+static const size_t ADDRESS_BYTES_BUDGET = 288;
+
+TEST_CASE("qdr_address_t bytes per address")
+{
+    CHECK(sizeof(qdr_address_t) <= ADDRESS_BYTES_BUDGET);
+}
+
+TEST_CASE("qdr_address_t rare state is allocated on first use")
+{
+    QDRMinimalEnv env{};
+    qdr_core_t *core = (qdr_core_t *) calloc(1, sizeof(qdr_core_t));
+
+    qdr_address_t *addr = qdr_address_CT(core, QD_TREATMENT_ANYCAST_BALANCED, 0);
+    REQUIRE(addr != nullptr);
+    DEQ_INSERT_TAIL(core->addrs, addr);
+    CHECK(addr->ext == nullptr);
+    CHECK(qdr_address_watch_count(addr) == 0);
+    CHECK(qdr_address_core_endpoint(addr) == nullptr);
+
+    qdr_address_ext_t *ext = qdr_address_ext_CT(addr);
+    CHECK(ext != nullptr);
+    CHECK(addr->ext == ext);
+    CHECK(qdr_address_ext_CT(addr) == ext);
+    CHECK(ext->deliveries_redirected == 0);
+
+    qdr_core_remove_address(core, addr);
+    free(core);
+}
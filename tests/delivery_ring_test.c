@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "router_core/delivery.h"
+#include "test_case.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DELIVERIES 200
+
+static qdr_delivery_t deliveries[DELIVERIES];
+
+
+static char *test_ring_fifo(void *context)
+{
+    qdr_delivery_ring_t ring;
+    ZERO(&ring);
+
+    if (qdr_delivery_ring_head(&ring) || qdr_delivery_ring_pop(&ring))
+        return "Empty ring returned a delivery";
+
+    // push and pop around the ring several times, growing it once
+    int pushed = 0;
+    int popped = 0;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 20; i++)
+            qdr_delivery_ring_push(&ring, &deliveries[pushed++ % DELIVERIES]);
+        for (int i = 0; i < 15; i++) {
+            if (qdr_delivery_ring_pop(&ring) != &deliveries[popped++ % DELIVERIES])
+                return "Deliveries popped out of order";
+        }
+        if (qdr_delivery_ring_size(&ring) != pushed - popped)
+            return "Wrong ring size";
+    }
+    while (popped < pushed) {
+        if (qdr_delivery_ring_pop(&ring) != &deliveries[popped++ % DELIVERIES])
+            return "Deliveries popped out of order";
+    }
+    if (qdr_delivery_ring_size(&ring) != 0 || qdr_delivery_ring_head(&ring))
+        return "Ring not empty";
+
+    qdr_delivery_ring_free(&ring);
+    return 0;
+}
+
+
+static char *test_ring_remove(void *context)
+{
+    qdr_delivery_ring_t ring;
+    ZERO(&ring);
+
+    for (int i = 0; i < 100; i++)
+        qdr_delivery_ring_push(&ring, &deliveries[i]);
+
+    // take every odd delivery out of the middle, then the first and the last
+    for (int i = 1; i < 99; i += 2)
+        qdr_delivery_ring_remove(&ring, &deliveries[i]);
+    qdr_delivery_ring_remove(&ring, &deliveries[0]);
+    qdr_delivery_ring_remove(&ring, &deliveries[99]);
+    if (qdr_delivery_ring_size(&ring) != 49)
+        return "Wrong ring size after removals";
+    if (qdr_delivery_ring_head(&ring) != &deliveries[2])
+        return "Head is not the oldest delivery left";
+
+    // walk, removing as we go
+    int expected = 2;
+    for (uint32_t pos = ring.head; ring.count && qdr_delivery_ring_before(&ring, pos); pos++) {
+        qdr_delivery_t *dlv = qdr_delivery_ring_at(&ring, pos);
+        if (!dlv)
+            continue;
+        if (dlv != &deliveries[expected])
+            return "Walk visited the wrong delivery";
+        if (expected % 4 == 0)
+            qdr_delivery_ring_remove(&ring, dlv);
+        expected += 2;
+    }
+    if (expected != 100)
+        return "Walk stopped early";
+
+    // pushing into a ring full of empty slots compacts it, the order must survive
+    for (int i = 100; i < DELIVERIES; i++)
+        qdr_delivery_ring_push(&ring, &deliveries[i]);
+    for (int i = 2; i < 100; i += 4) {
+        if (qdr_delivery_ring_pop(&ring) != &deliveries[i])
+            return "Compacted ring lost the order";
+    }
+    for (int i = 100; i < DELIVERIES; i++) {
+        if (qdr_delivery_ring_pop(&ring) != &deliveries[i])
+            return "Compacted ring lost the order";
+    }
+    if (qdr_delivery_ring_size(&ring) != 0)
+        return "Ring not empty";
+
+    qdr_delivery_ring_free(&ring);
+    return 0;
+}
+
+
+int delivery_ring_tests(void)
+{
+    int result = 0;
+    char *test_group = "delivery_ring_tests";
+
+    TEST_CASE(test_ring_fifo, 0);
+    TEST_CASE(test_ring_remove, 0);
+
+    return result;
+}
@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "router_core/delivery.h"
+#include "test_case.h"
+
+#include "qpid/dispatch/delivery_state.h"
+#include "qpid/dispatch/protocol_adaptor.h"
+
+#include <proton/disposition.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static qdr_delivery_t inbound;
+static qdr_delivery_t outbound;
+
+
+static void setup(void)
+{
+    ZERO(&inbound);
+    ZERO(&outbound);
+    sys_mutex_init(&inbound.dispo_lock);
+    sys_mutex_init(&outbound.dispo_lock);
+}
+
+
+static void teardown(void)
+{
+    qd_delivery_state_free(inbound.local_state);
+    qd_delivery_state_free(outbound.remote_state);
+    sys_mutex_free(&inbound.dispo_lock);
+    sys_mutex_free(&outbound.dispo_lock);
+}
+
+
+// The PN_RECEIVED counters read from the egress are handed to the ingress delivery by value
+static char *test_received_by_value(void *context)
+{
+    char *result = 0;
+    setup();
+
+    outbound.remote_disposition    = PN_RECEIVED;
+    outbound.remote_section_number = 0;
+    outbound.remote_section_offset = 1000000;
+    if (!qdr_delivery_move_delivery_state_CT(&outbound, &inbound)) {
+        result = "PN_RECEIVED not moved to the peer";
+        goto done;
+    }
+    if (inbound.local_state) {
+        result = "PN_RECEIVED moved as a state object";
+        goto done;
+    }
+
+    uint64_t             dispo;
+    qd_delivery_state_t  received;
+    qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(&inbound, &dispo, &received);
+    if (dstate) {
+        qd_delivery_state_free(dstate);
+        result = "PN_RECEIVED taken as a state object";
+        goto done;
+    }
+    if (dispo != PN_RECEIVED || received.section_number != 0 || received.section_offset != 1000000) {
+        result = "Wrong PN_RECEIVED state taken";
+        goto done;
+    }
+
+    // non-terminal: the next update replaces it, taking again returns nothing
+    outbound.remote_section_offset = 2000000;
+    qdr_delivery_move_delivery_state_CT(&outbound, &inbound);
+    qdr_delivery_take_local_delivery_state(&inbound, &dispo, &received);
+    if (dispo != PN_RECEIVED || received.section_offset != 2000000) {
+        result = "Second PN_RECEIVED update lost";
+        goto done;
+    }
+    qdr_delivery_take_local_delivery_state(&inbound, &dispo, &received);
+    if (dispo != 0 || received.section_offset != 0) {
+        result = "PN_RECEIVED taken twice";
+        goto done;
+    }
+
+done:
+    teardown();
+    return result;
+}
+
+
+// PN_RECEIVED that still arrives as an object (e.g. with a transfer) is copied inline and the object released
+static char *test_received_object_inline(void *context)
+{
+    char *result = 0;
+    setup();
+
+    outbound.remote_disposition           = PN_RECEIVED;
+    outbound.remote_state                 = qd_delivery_state();
+    outbound.remote_state->section_number = 1;
+    outbound.remote_state->section_offset = 4096;
+    qdr_delivery_move_delivery_state_CT(&outbound, &inbound);
+    if (outbound.remote_state || inbound.local_state) {
+        result = "PN_RECEIVED state object kept";
+        goto done;
+    }
+
+    uint64_t            dispo;
+    qd_delivery_state_t received;
+    qdr_delivery_take_local_delivery_state(&inbound, &dispo, &received);
+    if (dispo != PN_RECEIVED || received.section_number != 1 || received.section_offset != 4096) {
+        result = "Wrong PN_RECEIVED state taken";
+        goto done;
+    }
+
+done:
+    teardown();
+    return result;
+}
+
+
+// Terminal outcomes keep passing their state object, the inline counters stay zero
+static char *test_terminal_state_object(void *context)
+{
+    char *result = 0;
+    setup();
+
+    qd_delivery_state_t *modified  = qd_delivery_state();
+    modified->delivery_failed      = true;
+    outbound.remote_disposition    = PN_MODIFIED;
+    outbound.remote_state          = modified;
+    outbound.remote_section_offset = 1000;  // left over from earlier PN_RECEIVED updates
+    qdr_delivery_move_delivery_state_CT(&outbound, &inbound);
+
+    uint64_t             dispo;
+    qd_delivery_state_t  received;
+    qd_delivery_state_t *dstate = qdr_delivery_take_local_delivery_state(&inbound, &dispo, &received);
+    if (dispo != PN_MODIFIED || dstate != modified) {
+        qd_delivery_state_free(dstate);
+        result = "Terminal state object not passed on";
+        goto done;
+    }
+    qd_delivery_state_free(dstate);
+    if (received.section_number != 0 || received.section_offset != 0) {
+        result = "Inline PN_RECEIVED state returned with a terminal outcome";
+        goto done;
+    }
+
+    // terminal dispositions are final, and received may be NULL
+    dstate = qdr_delivery_take_local_delivery_state(&inbound, &dispo, 0);
+    if (dispo != PN_MODIFIED || dstate) {
+        qd_delivery_state_free(dstate);
+        result = "Terminal disposition not kept";
+        goto done;
+    }
+
+done:
+    teardown();
+    return result;
+}
+
+
+int delivery_state_tests(void)
+{
+    int result = 0;
+    char *test_group = "delivery_state_tests";
+
+    TEST_CASE(test_received_by_value, 0);
+    TEST_CASE(test_received_object_inline, 0);
+    TEST_CASE(test_terminal_state_object, 0);
+
+    return result;
+}
@@ -982,6 +982,121 @@ static char *test_iterator_copy_octet(void *context)
 }
 
 
+// The view hash must not depend on how the view is split across buffers, and each segment hash
+// must equal the hash of the corresponding prefix of the view.
+//
+static char *test_view_hash_buffer_chain(void *context)
+{
+    static char error[200];
+    const char *addrs[] = {"a",
+                           "an_entry_with_no_separators_and_longer_than_a_word",
+                           "mixed.set/of/delimiters.one",
+                           "amqp://host/global/sub.address.with.many.dotted.segments",
+                           "_topo/my-area/router-1/$management",
+                           0};
+    const int segment_sizes[] = {1, 3, 7, 8, 9, 512};
+    const qd_iterator_view_t views[] = {ITER_VIEW_ALL, ITER_VIEW_ADDRESS_HASH};
+
+    for (int a = 0; addrs[a]; a++) {
+        for (int v = 0; v < 2; v++) {
+            qd_iterator_t *str_iter = qd_iterator_string(addrs[a], views[v]);
+            unsigned char *view     = qd_iterator_copy(str_iter);
+            const uint32_t expected = qd_hash_bytes(view, strlen((const char *) view));
+
+            if (qd_iterator_hash_view(str_iter) != expected) {
+                snprintf(error, 200, "String hash mismatch: '%s'", (char *) view);
+                qd_iterator_free(str_iter);
+                free(view);
+                return error;
+            }
+            qd_iterator_free(str_iter);
+
+            for (int z = 0; z < sizeof(segment_sizes) / sizeof(segment_sizes[0]); z++) {
+                qd_buffer_list_t chain;
+                DEQ_INIT(chain);
+                build_buffer_chain(&chain, addrs[a], segment_sizes[z]);
+                qd_iterator_t *iter = qd_iterator_buffer(DEQ_HEAD(chain), 0, strlen(addrs[a]), views[v]);
+
+                char *ret = 0;
+                if (qd_iterator_hash_view(iter) != expected) {
+                    snprintf(error, 200, "Buffer hash mismatch: '%s' segment size %d", (char *) view, segment_sizes[z]);
+                    ret = error;
+                }
+
+                qd_iterator_hash_view_segments(iter);
+                uint32_t hash;
+                while (!ret && qd_iterator_next_segment(iter, &hash)) {
+                    unsigned char *prefix = qd_iterator_copy_const(iter);
+                    if (hash != qd_hash_bytes(prefix, strlen((const char *) prefix))) {
+                        snprintf(error, 200, "Segment hash mismatch: '%s' segment size %d", (char *) prefix, segment_sizes[z]);
+                        ret = error;
+                    }
+                    free(prefix);
+                }
+
+                qd_iterator_free(iter);
+                release_buffer_chain(&chain);
+                if (ret) {
+                    free(view);
+                    return ret;
+                }
+            }
+            free(view);
+        }
+    }
+
+    return 0;
+}
+
+
+static char *test_storage_iterator(void *context)
+{
+    char      *result = 0;
+    qd_hash_t *hash   = qd_hash(10, 32, 0);
+
+    qd_iterator_storage_t key_storage;
+    qd_iterator_t *key = qd_iterator_init_string(&key_storage, "policy", ITER_VIEW_ADDRESS_HASH);
+    qd_iterator_annotate_prefix(key, 'C');
+    if ((void*) key != (void*) &key_storage) {
+        result = "Iterator not initialized in its storage";
+        goto exit;
+    }
+    if (qd_hash_insert(hash, key, "TEST", 0) != QD_ERROR_NONE) {
+        result = "qd_hash_insert failed";
+        goto exit;
+    }
+
+    // a short address hashes its segments inline, a deep one moves them to the heap
+    const char *addresses[] = {"policy.org.apache.dev", "policy.a.b.c.d.e.f.g.h.i.j.k.l.m.n.o.p.q", 0};
+    for (int i = 0; addresses[i] && !result; ++i) {
+        qd_iterator_storage_t storage;
+        qd_iterator_t *iter = qd_iterator_init_string(&storage, addresses[i], ITER_VIEW_ADDRESS_HASH);
+        qd_iterator_annotate_prefix(iter, 'C');
+
+        for (int pass = 0; pass < 2 && !result; ++pass) {  // the segments are re-hashed by the second pass
+            void *val = 0;
+            qd_hash_retrieve_prefix(hash, iter, &val);
+            if (!val || strcmp((const char*) val, "TEST") != 0)
+                result = "Prefix not found with an iterator in storage";
+        }
+
+        qd_iterator_storage_t dup_storage;
+        qd_iterator_t *dup = qd_iterator_init_dup(&dup_storage, iter);
+        qd_iterator_reset_view(dup, ITER_VIEW_ALL);
+        if (!result && !qd_iterator_equal(dup, (const unsigned char*) addresses[i]))
+            result = "Iterator duplicated in storage does not match";
+
+        qd_iterator_free(dup);
+        qd_iterator_free(iter);
+    }
+
+exit:
+    qd_iterator_free(key);
+    qd_hash_free(hash);
+    return result;
+}
+
+
 int field_tests(void)
 {
     int result = 0;
@@ -1010,7 +1125,9 @@ int field_tests(void)
     TEST_CASE(test_qd_hash_retrieve_prefix_separator_exact_match_dot_at_end, 0);
     TEST_CASE(test_qd_hash_retrieve_prefix_separator_exact_match_dot_at_end_1, 0);
     TEST_CASE(test_prefix_hash, 0);
+    TEST_CASE(test_view_hash_buffer_chain, 0);
     TEST_CASE(test_iterator_copy_octet, 0);
+    TEST_CASE(test_storage_iterator, 0);
 
     qd_iterator_set_address(true, "my-area", "my-router");
     TEST_CASE(test_view_address_hash_edge, 0);
@@ -0,0 +1,140 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Unit test for the flight recorder
+ */
+
+#include "qpid/dispatch/flight_recorder.h"
+#include "qpid/dispatch/threading.h"
+
+#include "test_case.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WRAPPED   10
+#define MARKER    777777
+#define REUSED    888888
+#define DUMP_MAX  (8 * 1024 * 1024)
+
+static void *record_thread(void *arg)
+{
+    for (uint64_t i = 0; i < QD_FLIGHT_RECORDER_EVENTS + WRAPPED; ++i)
+        qd_flight_record(QD_FLIGHT_Q3_BLOCKED, i, MARKER, 0);
+    return 0;
+}
+
+
+// A thread that records more events than its ring holds keeps the newest QD_FLIGHT_RECORDER_EVENTS, oldest first
+//
+static char *test_ring_wrap(void *context)
+{
+    char         *result = 0;
+    sys_thread_t *thread = sys_thread(SYS_THREAD_PROACTOR, record_thread, 0);
+    sys_thread_join(thread);
+    sys_thread_free(thread);
+
+    FILE *file = tmpfile();
+    if (!file)
+        return "Cannot create a temporary file";
+    qd_flight_recorder_dump(fileno(file));
+
+    char  *dump = malloc(DUMP_MAX);
+    size_t len  = 0;
+    rewind(file);
+    len = fread(dump, 1, DUMP_MAX - 1, file);
+    dump[len] = '\0';
+    fclose(file);
+
+    char suffix[32];
+    char expected[64];
+    int  count = 0;
+    snprintf(suffix, sizeof(suffix), " %d 0\n", MARKER);
+    for (char *line = strstr(dump, suffix); line; line = strstr(line + 1, suffix))
+        ++count;
+
+    // The first event written must be the oldest one kept
+    snprintf(expected, sizeof(expected), " q3-blocked %d%s", WRAPPED, suffix);
+    char *first = strstr(dump, " q3-blocked ");
+
+    if (!strstr(dump, "*** FLIGHT RECORDER") || !strstr(dump, "*** END FLIGHT RECORDER ***\n"))
+        result = "Missing dump header or trailer";
+    else if (count != QD_FLIGHT_RECORDER_EVENTS)
+        result = "Wrong number of events kept";
+    else if (!first || strncmp(first, expected, strlen(expected)) != 0)
+        result = "Oldest events not dropped first";
+    free(dump);
+    return result;
+}
+
+
+static void *record_once_thread(void *arg)
+{
+    qd_flight_record(QD_FLIGHT_Q2_BLOCKED, (uint64_t) (uintptr_t) arg, REUSED, 0);
+    return 0;
+}
+
+
+// The rings of exited threads are reused: more threads than the table holds, one after the other, are all recorded
+//
+static char *test_ring_reuse(void *context)
+{
+    const int threads = QD_FLIGHT_RECORDER_THREADS * 2;
+    char     *result  = 0;
+
+    for (int i = 0; i < threads; ++i) {
+        sys_thread_t *thread = sys_thread(SYS_THREAD_PROACTOR, record_once_thread, (void *) (uintptr_t) i);
+        sys_thread_join(thread);
+        sys_thread_free(thread);
+    }
+
+    FILE *file = tmpfile();
+    if (!file)
+        return "Cannot create a temporary file";
+    qd_flight_recorder_dump(fileno(file));
+
+    char  *dump = malloc(DUMP_MAX);
+    size_t len  = 0;
+    rewind(file);
+    len = fread(dump, 1, DUMP_MAX - 1, file);
+    dump[len] = '\0';
+    fclose(file);
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), " q2-blocked %d %d 0\n", threads - 1, REUSED);
+    if (!strstr(dump, expected))
+        result = "The last thread was not recorded";
+    free(dump);
+    return result;
+}
+
+
+int flight_recorder_tests(void)
+{
+    int result = 0;
+    char *test_group = "flight_recorder_tests";
+
+    TEST_CASE(test_ring_wrap, 0);
+    TEST_CASE(test_ring_reuse, 0);
+
+    return result;
+}
@@ -105,6 +105,9 @@ int ProcessResponseFile(int *argc, char ***argv) {
   return 0;
 }
 
+/* Defined in StandaloneFuzzTargetProfile.c */
+int FuzzProfileInputs(int argc, char **argv);
+
 int main(int argc, char **argv) {
   fprintf(stderr, "StandaloneFuzzTargetMain: running %d inputs\n", argc - 1);
   LLVMFuzzerInitialize(&argc, &argv);
@@ -112,6 +115,13 @@ int main(int argc, char **argv) {
   // Process response file
   ProcessResponseFile(&argc, &argv);
 
+  /* Time the inputs instead of only running them, see StandaloneFuzzTargetProfile.c */
+  if (getenv("FUZZ_PROFILE")) {
+    int rc = FuzzProfileInputs(argc, argv);
+    freeall();
+    return rc;
+  }
+
   for (int i = 1; i < argc; i++) {
     fprintf(stderr, "Running: %s\n", argv[i]);
     FILE *f = fopen(argv[i], "rb");
@@ -0,0 +1,178 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+// Replays the fuzz corpus through the fuzz target under timing, used by StandaloneFuzzTargetMain when FUZZ_PROFILE is
+// set in the environment.
+//
+// Each input is decoded as is and repeated 2, 4, ... FUZZ_PROFILE times (default 64) and the CPU time of every size is
+// measured. The throughput of the input and the exponent of the growth of the decoding time with its size are
+// reported, one line per input. The exponent is about 1 for decoders that are linear in their input and larger for
+// inputs that hit superlinear paths, such as long folded headers or growing header tables. Inputs with an exponent
+// above FUZZ_PROFILE_EXPONENT (default 1.5) are reported as findings and make the run fail.
+//
+// FUZZ_PROFILE_PREFIX octets at the start of an input, for example the HTTP/2 connection preface, are not repeated.
+
+#include "libFuzzingEngine.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MAX_REPEAT     64
+#define DEFAULT_EXPONENT_LIMIT 1.5
+
+// CPU time a sample of repeated runs takes at least, so that timer resolution does not matter
+#define MIN_SAMPLE_NS 2000000
+
+// samples taken of each size, the fastest is used as the least disturbed by the rest of the system
+#define SAMPLES 3
+
+// the exponent is fitted to the sizes of more than FUZZ_PROFILE / FIT_SIZES repeats
+#define FIT_SIZES 8
+
+// too little time at the largest size to tell growth from noise
+#define MIN_MAX_SIZE_NS 20000.0
+
+static uint64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Returns the CPU time of one run of the fuzz target
+static double time_input(const uint8_t *data, size_t size)
+{
+    double best = 0;
+    for (int sample = 0; sample < SAMPLES; ++sample) {
+        uint64_t runs  = 0;
+        uint64_t start = cpu_ns();
+        uint64_t elapsed;
+        do {
+            LLVMFuzzerTestOneInput(data, size);
+            ++runs;
+            elapsed = cpu_ns() - start;
+        } while (elapsed < MIN_SAMPLE_NS);
+        double per_run = (double) elapsed / runs;
+        if (sample == 0 || per_run < best)
+            best = per_run;
+    }
+    return best;
+}
+
+// Builds the input with all but its first prefix octets repeated
+static uint8_t *repeat_input(const uint8_t *data, size_t size, size_t prefix, int repeat, size_t *length)
+{
+    const size_t tail = size - prefix;
+    *length           = prefix + tail * repeat;
+    uint8_t *buffer   = (uint8_t *) malloc(*length);
+    memcpy(buffer, data, prefix);
+    for (int i = 0; i < repeat; ++i)
+        memcpy(buffer + prefix + tail * i, data + prefix, tail);
+    return buffer;
+}
+
+static uint8_t *read_input(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *) malloc(*size ? *size : 1);
+    if (fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = 0;
+    }
+    fclose(f);
+    return data;
+}
+
+int FuzzProfileInputs(int argc, char **argv)
+{
+    const char *value       = getenv("FUZZ_PROFILE");
+    int max_repeat          = value ? atoi(value) : 0;
+    value                   = getenv("FUZZ_PROFILE_EXPONENT");
+    const double max_exp    = value ? atof(value) : DEFAULT_EXPONENT_LIMIT;
+    value                   = getenv("FUZZ_PROFILE_PREFIX");
+    const size_t prefix_len = value ? (size_t) atol(value) : 0;
+    if (max_repeat < 2)
+        max_repeat = DEFAULT_MAX_REPEAT;
+
+    int findings = 0;
+    int failures = 0;
+    printf("%-60s %10s %12s %10s %9s\n", "input", "octets", "ns", "MB/s", "exponent");
+    for (int i = 1; i < argc; i++) {
+        size_t size;
+        uint8_t *data = read_input(argv[i], &size);
+        if (!data) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            ++failures;
+            continue;
+        }
+
+        const double ns = time_input(data, size);
+        const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+        printf("%-60.60s %10zu %12.0f %10.1f", name, size, ns, ns > 0 ? size * 1000.0 / ns : 0.0);
+
+        const size_t prefix = size > prefix_len ? prefix_len : size;
+        if (size == prefix) {
+            printf(" %9s\n", "-");
+            free(data);
+            continue;
+        }
+
+        // least squares slope of log(time) over log(size) of the largest sizes, where the cost of setting up the
+        // decoder no longer hides the growth
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        double largest_ns = ns;
+        int points        = 0;
+        for (int repeat = 1; repeat <= max_repeat; repeat *= 2) {
+            size_t length;
+            uint8_t *input = repeat_input(data, size, prefix, repeat, &length);
+            largest_ns     = repeat == 1 ? ns : time_input(input, length);
+            free(input);
+            if (repeat * FIT_SIZES <= max_repeat && repeat * 2 <= max_repeat)
+                continue;
+            const double x = log((double) length);
+            const double y = log(largest_ns > 1 ? largest_ns : 1);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            ++points;
+        }
+        const double exponent = (points * sxy - sx * sy) / (points * sxx - sx * sx);
+        const bool finding    = exponent > max_exp && largest_ns >= MIN_MAX_SIZE_NS;
+        printf(" %9.2f%s\n", exponent, finding ? "  SUPERLINEAR" : "");
+        if (finding)
+            ++findings;
+        free(data);
+    }
+
+    fprintf(stderr, "Profiled %d inputs: %d with decoding time growing faster than size^%.2f\n", argc - 1 - failures,
+            findings, max_exp);
+    return findings || failures ? 1 : 0;
+}
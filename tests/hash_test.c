@@ -24,6 +24,7 @@
 #include "qpid/dispatch/iterator.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const unsigned char *keys[] = {
@@ -306,6 +307,79 @@ done:
 }
 
 
+// insert enough keys to force several incremental resizes and verify every key and handle
+// remains reachable while the buckets are being migrated
+//
+static char *test_grow(void *context)
+{
+    const int count = 20000;
+    char *result = 0;
+    char key[32];
+    qd_hash_handle_t **handles = calloc(count, sizeof(qd_hash_handle_t *));
+    qd_hash_t *hash = qd_hash(2, 4, false);
+    if (!hash || !handles) {
+        result = "hash table allocation failed";
+        goto done;
+    }
+
+    for (long i = 0; i < count; ++i) {
+        snprintf(key, sizeof(key), "grow/%ld", i);
+        if (qd_hash_insert_str(hash, (const unsigned char *) key, (void *) i, &handles[i]) != QD_ERROR_NONE) {
+            result = "hash table insert failed";
+            goto done;
+        }
+
+        // probe an earlier key, which may live in a bucket that has not migrated yet
+        long j = i / 2;
+        void *val = 0;
+        snprintf(key, sizeof(key), "grow/%ld", j);
+        if (qd_hash_retrieve_str(hash, (const unsigned char *) key, &val) != QD_ERROR_NONE || (long) val != j) {
+            result = "key lost during resize";
+            goto done;
+        }
+    }
+
+    if (qd_hash_size(hash) != count) {
+        result = "hash size is incorrect";
+        goto done;
+    }
+
+    // remove the odd keys by handle and the even ones by key
+
+    for (long i = 0; i < count; ++i) {
+        if (i & 1) {
+            if (qd_hash_remove_by_handle(hash, handles[i]) != QD_ERROR_NONE) {
+                result = "remove by handle failed";
+                goto done;
+            }
+        } else {
+            snprintf(key, sizeof(key), "grow/%ld", i);
+            qd_iterator_t *i_key = qd_iterator_string(key, ITER_VIEW_ALL);
+            qd_error_t     error = qd_hash_remove(hash, i_key);
+            qd_iterator_free(i_key);
+            if (error != QD_ERROR_NONE) {
+                result = "iterator key remove failed";
+                goto done;
+            }
+        }
+    }
+
+    if (qd_hash_size(hash) != 0) {
+        result = "hash not empty after removal";
+        goto done;
+    }
+
+done:
+    if (handles) {
+        for (int i = 0; i < count; ++i)
+            qd_hash_handle_free(handles[i]);
+        free(handles);
+    }
+    qd_hash_free(hash);
+    return result;
+}
+
+
 int hash_tests(void)
 {
     int result = 0;
@@ -315,6 +389,7 @@ int hash_tests(void)
     TEST_CASE(test_str_keys, 0);
     TEST_CASE(test_iter_bad, 0);
     TEST_CASE(test_str_bad, 0);
+    TEST_CASE(test_grow, 0);
 
     return result;
 }
@@ -0,0 +1,209 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Unit test for the Space-Saving sketch of the heavy_hitters core module
+ */
+
+#include "router_core/modules/heavy_hitters/sketch.h"
+
+#include "test_case.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHURN_KEYS (2 * HH_CAPACITY)
+#define CHURN_OPS  20000
+
+static hh_sketch_t sketch;
+static char        error_text[128];
+
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+
+// Every counter is reachable through the index and the index holds nothing else
+//
+static char *check_index(const hh_sketch_t *s)
+{
+    int indexed = 0;
+    for (int slot = 0; slot < HH_INDEX_SLOTS; slot++) {
+        if (s->index[slot] < 0)
+            continue;
+        indexed++;
+        if (s->index[slot] >= s->used)
+            return "Index entry past the last counter";
+    }
+    if (indexed != s->used)
+        return "Index and counters out of step";
+    for (int c = 0; c < s->used; c++) {
+        if (hh_sketch_counter(s, s->counters[c].key) != &s->counters[c])
+            return "Counter not found through the index";
+    }
+    return 0;
+}
+
+
+// Keys are added and removed at random, well below the capacity so nothing is evicted: the sketch must agree with a
+// plain array after each step.  The removals shift index entries back over the freed slots (sketch_unindex), a
+// broken shift leaves a key that cannot be found
+//
+static char *test_sketch_remove(void *context)
+{
+    uint64_t counts[CHURN_KEYS + 1] = {0};
+    uint32_t state = 1;
+
+    hh_sketch_reset(&sketch);
+    for (int op = 0; op < CHURN_OPS; op++) {
+        uint64_t key = 1 + next_random(&state) % CHURN_KEYS;
+        if (counts[key] && next_random(&state) % 2) {
+            hh_sketch_remove(&sketch, key);
+            counts[key] = 0;
+        } else if (counts[key] || sketch.used < HH_CAPACITY) {
+            hh_sketch_add(&sketch, key, key, "churn");
+            counts[key] += key;
+        }
+
+        char *result = check_index(&sketch);
+        if (result)
+            return result;
+    }
+
+    int present = 0;
+    for (uint64_t key = 1; key <= CHURN_KEYS; key++) {
+        const hh_counter_t *counter = hh_sketch_counter(&sketch, key);
+        if (!!counter != !!counts[key]) {
+            snprintf(error_text, sizeof(error_text), "Key %" PRIu64 " %s", key, counter ? "not removed" : "lost");
+            return error_text;
+        }
+        if (counter && (counter->count != counts[key] || counter->error != 0))
+            return "Wrong count after churn";
+        present += !!counter;
+    }
+    if (present != sketch.used)
+        return "Wrong number of counters after churn";
+
+    // removing an unknown key changes nothing
+    hh_sketch_remove(&sketch, CHURN_KEYS + 1);
+    if (sketch.used != present)
+        return "Removing an unknown key dropped a counter";
+    return check_index(&sketch);
+}
+
+
+// A new key takes over the smallest counter of a full sketch and inherits its count as its error
+//
+static char *test_sketch_eviction(void *context)
+{
+    hh_sketch_reset(&sketch);
+    for (uint64_t key = 1; key <= HH_CAPACITY; key++)
+        hh_sketch_add(&sketch, key, 10 + 2 * key, "old");
+    hh_sketch_add(&sketch, 7, 100, "old");  // key 1 remains the smallest
+
+    hh_sketch_add(&sketch, 1000, 1, "new");
+    if (sketch.used != HH_CAPACITY)
+        return "Eviction changed the number of counters";
+    if (hh_sketch_counter(&sketch, 1))
+        return "Smallest counter not evicted";
+
+    const hh_counter_t *counter = hh_sketch_counter(&sketch, 1000);
+    if (!counter)
+        return "New key has no counter";
+    if (counter->count != 13 || counter->error != 12)
+        return "New key did not inherit the evicted count";
+    if (strcmp(counter->name, "new") != 0)
+        return "New key did not take its name";
+
+    // the new key is now the smallest and is the next one to go
+    hh_sketch_add(&sketch, 1001, 1, "newer");
+    if (hh_sketch_counter(&sketch, 1000) || !hh_sketch_counter(&sketch, 1001))
+        return "Second eviction took the wrong counter";
+    if (hh_sketch_counter(&sketch, 1001)->count != 14)
+        return "Second eviction inherited the wrong count";
+    return check_index(&sketch);
+}
+
+
+// A stream of a few heavy keys among many light ones: every counter brackets the true count of its key within its
+// error, every key above 1/HH_CAPACITY of the total holds a counter, and the heavy keys lead the report
+//
+#define LIGHT_KEYS   1000
+#define HEAVY_KEYS   5
+#define STREAM_ITEMS 50000
+
+static char *test_sketch_error_bound(void *context)
+{
+    static uint64_t truth[HEAVY_KEYS + LIGHT_KEYS + 1];
+    uint32_t        state = 7;
+    uint64_t        total = 0;
+
+    memset(truth, 0, sizeof(truth));
+    hh_sketch_reset(&sketch);
+    for (int i = 0; i < STREAM_ITEMS; i++) {
+        uint64_t r   = next_random(&state);
+        uint64_t key = r % 4 == 0 ? 1 + r / 4 % HEAVY_KEYS : 1 + HEAVY_KEYS + r / 4 % LIGHT_KEYS;
+        uint64_t w   = 1 + r % 3;
+        hh_sketch_add(&sketch, key, w, "stream");
+        truth[key] += w;
+        total      += w;
+    }
+
+    for (int c = 0; c < sketch.used; c++) {
+        const hh_counter_t *counter = &sketch.counters[c];
+        if (counter->count < truth[counter->key] || counter->count - counter->error > truth[counter->key]) {
+            snprintf(error_text, sizeof(error_text), "Key %" PRIu64 " count %" PRIu64 " error %" PRIu64 " true %" PRIu64,
+                     counter->key, counter->count, counter->error, truth[counter->key]);
+            return error_text;
+        }
+    }
+    for (uint64_t key = 1; key <= HEAVY_KEYS + LIGHT_KEYS; key++) {
+        if (truth[key] > total / HH_CAPACITY && !hh_sketch_counter(&sketch, key))
+            return "Key above the guaranteed share has no counter";
+    }
+
+    hh_report_t report;
+    hh_sketch_top(&sketch, &report);
+    if (report.count != HH_TOP_K)
+        return "Short report";
+    for (int r = 0; r < report.count; r++) {
+        if (r > 0 && report.top[r].count > report.top[r - 1].count)
+            return "Report not ordered by count";
+        if (r < HEAVY_KEYS && report.top[r].key > HEAVY_KEYS)
+            return "Light key ahead of a heavy key";
+    }
+    return check_index(&sketch);
+}
+
+
+int heavy_hitters_tests(void)
+{
+    int result = 0;
+    char *test_group = "heavy_hitters_tests";
+
+    TEST_CASE(test_sketch_remove, 0);
+    TEST_CASE(test_sketch_eviction, 0);
+    TEST_CASE(test_sketch_error_bound, 0);
+
+    return result;
+}
@@ -399,6 +399,116 @@ char* test_http2_decode_request_header_fragmented(void *context)
     return 0;
 }
 
+/**
+ * Pass a padded HEADERS frame to the decoder one byte at a time. The header block fragment is inflated as it arrives
+ * so the headers must be seen even though no two bytes of the frame are ever in the same buffer.
+ */
+char* test_http2_decode_request_header_byte_by_byte(void *context)
+{
+    method_match5 = false;
+    path_match5   = false;
+    qd_http2_decoder_connection_t *conn_state = qd_http2_decoder_connection(&callbacks5, 0, 1);
+
+    const uint8_t frame[42] = {
+        /* HEADER frame, length 33, END_STREAM END_HEADERS PADDED, stream 1 */ 0x00, 0x00, 0x21, 0x01, 0x0d, 0x00, 0x00, 0x00, 0x01,
+        /* pad length */ 0x02, 0x82, 0x86, 0x41, 0x8a, 0x08, 0x9d, 0x5c, 0x0b, 0x81, 0x70, 0xdc, 0x7c, 0x00, 0x07, 0x85, 0x7a, 0x88,
+        0x25, 0xb6, 0x50, 0xc3, 0xcb, 0x89, 0x70, 0xff, 0x53, 0x03, 0x2a, 0x2f, 0x2a, /* padding */ 0x00, 0x00
+    };
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        if (decode(conn_state, false, &frame[i], 1) != 0) {
+            qd_http2_decoder_connection_free(conn_state);
+            return "Call to decode() failed";
+        }
+    }
+
+    if (!is_decoder_state_decode_frame_header(conn_state, false)) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected server decoder state to be HTTP2_DECODE_FRAME_HEADER but it is not";
+    }
+
+    if(!method_match5 || !path_match5) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected :method to be GET and :path to be /index.html but they are not";
+    }
+
+    qd_http2_decoder_connection_free(conn_state);
+    return 0;
+}
+
+/**
+ * Without an on_data callback the decoder has no use for the rest of the DATA frame header and skips it at once.
+ */
+char* test_http2_decode_data_frame_no_callback(void *context)
+{
+    qd_http2_decoder_connection_t *conn_state = qd_http2_decoder_connection(&callbacks5, 0, 1);
+
+    const uint8_t data1[5] = {
+            0x00, 0x00, 0x1a, 0x00, 0x01
+    };
+    decode(conn_state, false, data1, 5);
+
+    if (!is_decoder_state_skip_frame_payload(conn_state, false)) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected server decoder state to be HTTP2_DECODE_SKIP_FRAME_PAYLOAD but it is not";
+    }
+
+    qd_http2_decoder_connection_free(conn_state);
+    return 0;
+}
+
+/**
+ * Pass the payload of a DATA frame by length only, then a HEADERS frame. The decoder must expect the HEADERS frame
+ * header right after the skipped payload.
+ */
+char* test_http2_decode_skip_data_frame(void *context)
+{
+    method_match5 = false;
+    path_match5   = false;
+    qd_http2_decoder_connection_t *conn_state = qd_http2_decoder_connection(&callbacks5, 0, 1);
+
+    /* DATA frame, length 26, stream 1, and the first two octets of its payload */
+    const uint8_t data1[11] = {
+            0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x61, 0x62
+    };
+    decode(conn_state, false, data1, sizeof(data1));
+
+    if (qd_http2_decoder_connection_skippable(conn_state, false) != 24) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected the 24 remaining octets of the DATA frame to be skippable";
+    }
+    if (qd_http2_decoder_connection_skippable(conn_state, true) != 0) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected nothing to be skippable in the client stream";
+    }
+    if (qd_http2_decoder_connection_rx_skip(conn_state, false, 20) != 0 ||
+        qd_http2_decoder_connection_rx_skip(conn_state, false, 4) != 0) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Call to qd_http2_decoder_connection_rx_skip() failed";
+    }
+    if (!is_decoder_state_decode_frame_header(conn_state, false)) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected server decoder state to be HTTP2_DECODE_FRAME_HEADER but it is not";
+    }
+
+    const uint8_t frame[42] = {
+        /* HEADER frame, length 33, END_STREAM END_HEADERS PADDED, stream 1 */ 0x00, 0x00, 0x21, 0x01, 0x0d, 0x00, 0x00, 0x00, 0x01,
+        /* pad length */ 0x02, 0x82, 0x86, 0x41, 0x8a, 0x08, 0x9d, 0x5c, 0x0b, 0x81, 0x70, 0xdc, 0x7c, 0x00, 0x07, 0x85, 0x7a, 0x88,
+        0x25, 0xb6, 0x50, 0xc3, 0xcb, 0x89, 0x70, 0xff, 0x53, 0x03, 0x2a, 0x2f, 0x2a, /* padding */ 0x00, 0x00
+    };
+    if (decode(conn_state, false, frame, sizeof(frame)) != 0 || !method_match5 || !path_match5) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected :method to be GET and :path to be /index.html after the skipped DATA frame";
+    }
+
+    if (qd_http2_decoder_connection_rx_skip(conn_state, false, 1) == 0) {
+        qd_http2_decoder_connection_free(conn_state);
+        return "Expected skipping the next frame header to fail";
+    }
+
+    qd_http2_decoder_connection_free(conn_state);
+    return 0;
+}
+
 int on_test1_begin_header_callback(qd_http2_decoder_connection_t *conn_state,
                                    uintptr_t request_context,
                                    bool from_client,
@@ -558,7 +668,7 @@ static void protocol_error1(qd_http2_decoder_connection_t *conn_state,
                              uintptr_t request_context,
                              bool from_client, const char *reason)
 {
-    if (!strcmp(reason, "get_request_headers - failure, moving decoder state to HTTP2_DECODE_ERROR nghttp2 error code=-523"))
+    if (!strcmp(reason, "parse_request_response_header_frame - failure, moving decoder state to HTTP2_DECODE_ERROR nghttp2 error code=-523"))
         decoder_error = true;
 }
 
@@ -631,6 +741,9 @@ int http2_decoder_tests(void)
     TEST_CASE(test_http2_decode_compressed_header_error, 0);
     TEST_CASE(test_http2_decode_request_header_fragmented, 0);
     TEST_CASE(test_http2_decode_data_frame, 0);
+    TEST_CASE(test_http2_decode_request_header_byte_by_byte, 0);
+    TEST_CASE(test_http2_decode_data_frame_no_callback, 0);
+    TEST_CASE(test_http2_decode_skip_data_frame, 0);
 
     return result;
 }
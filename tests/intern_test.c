@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Unit test for the string intern table
+ */
+
+#include "qpid/dispatch/intern.h"
+#include "qpid/dispatch/hash.h"
+#include "qpid/dispatch/threading.h"
+
+#include "test_case.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define THREADS 4
+#define STRINGS 1000
+
+
+static char *test_equal_strings(void *context)
+{
+    char        copy[] = "amqp:/_topo/0/router-a/$management";
+    const char *first  = qd_intern("amqp:/_topo/0/router-a/$management");
+    const char *second = qd_intern(copy);
+    const char *prefix = qd_intern_n(copy, 12);
+    char       *result = 0;
+
+    if (first != second)
+        result = "Equal strings interned to different copies";
+    else if (first == copy || strcmp(first, copy) != 0)
+        result = "Interned string is not a copy";
+    else if (strcmp(prefix, "amqp:/_topo/") != 0)
+        result = "qd_intern_n did not terminate the copy";
+    else if (qd_intern_hash(first) != qd_hash_bytes((const uint8_t *) copy, strlen(copy)))
+        result = "Unexpected hash";
+    else if (qd_intern(0) != 0)
+        result = "NULL interned";
+
+    qd_intern_release(first);
+    qd_intern_release(second);
+    qd_intern_release(prefix);
+    qd_intern_release(0);
+    return result;
+}
+
+
+// A string lives as long as its last reference: interning it again afterwards makes a new copy
+//
+static char *test_references(void *context)
+{
+    const char *interned = qd_intern("router-b");
+    if (qd_intern_ref(interned) != interned)
+        return "qd_intern_ref returned another string";
+    qd_intern_release(interned);
+    if (strcmp(interned, "router-b") != 0)
+        return "String freed with references left";
+    if (qd_intern("router-b") != interned)
+        return "Referenced string not found";
+    qd_intern_release(interned);
+    qd_intern_release(interned);
+
+    const char *again = qd_intern("router-b");
+    if (!again || strcmp(again, "router-b") != 0)
+        return "String not interned again";
+    qd_intern_release(again);
+    return 0;
+}
+
+
+static void *intern_thread(void *arg)
+{
+    const char **interned = (const char **) arg;
+    char         name[32];
+
+    for (int i = 0; i < STRINGS; ++i) {
+        snprintf(name, sizeof(name), "address-%d", i);
+        interned[i] = qd_intern(name);
+    }
+    return 0;
+}
+
+
+// Threads interning the same strings concurrently all get the same copies, including while the table grows
+//
+static char *test_threads(void *context)
+{
+    static const char *interned[THREADS][STRINGS];
+    sys_thread_t      *threads[THREADS];
+    char              *result = 0;
+
+    for (int t = 0; t < THREADS; ++t)
+        threads[t] = sys_thread(SYS_THREAD_PROACTOR, intern_thread, interned[t]);
+    for (int t = 0; t < THREADS; ++t) {
+        sys_thread_join(threads[t]);
+        sys_thread_free(threads[t]);
+    }
+
+    for (int i = 0; i < STRINGS && !result; ++i) {
+        for (int t = 1; t < THREADS; ++t) {
+            if (interned[t][i] != interned[0][i]) {
+                result = "Threads interned different copies";
+                break;
+            }
+        }
+    }
+
+    for (int t = 0; t < THREADS; ++t)
+        for (int i = 0; i < STRINGS; ++i)
+            qd_intern_release(interned[t][i]);
+    return result;
+}
+
+
+int intern_tests(void)
+{
+    int result = 0;
+    char *test_group = "intern_tests";
+
+    TEST_CASE(test_equal_strings, 0);
+    TEST_CASE(test_references, 0);
+    TEST_CASE(test_threads, 0);
+
+    return result;
+}
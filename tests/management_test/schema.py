@@ -22,7 +22,8 @@
 
 import unittest
 import json
-from skupper_router_internal.management.schema import Schema, BooleanType, EnumType, AttributeType, ValidationError, EnumValue, EntityType
+from skupper_router_internal.management.schema import Schema, BooleanType, EnumType, AttributeType, ValidationError, EnumValue, EntityType, \
+    EntityIndex
 
 
 SCHEMA_1 = {
@@ -134,6 +135,23 @@ class SchemaTest(unittest.TestCase):
              {'type': 'listener', 'name': 'y'}]
         s.validate_all(m)
 
+    def test_entity_index(self):
+        s = Schema(**SCHEMA_1)
+        index = EntityIndex(s, [{'type': 'org.example.container', 'name': 'x'},
+                                {'type': 'org.example.listener', 'name': 'y'}])
+        # Unique attributes clash across types
+        self.assertRaises(ValidationError, s.validate_add, {'type': 'connector', 'name': 'y'}, index)
+        self.assertRaises(ValidationError, s.validate_add, {'type': 'container', 'name': 'z'}, index)
+        s.validate_add({'type': 'connector', 'name': 'z'}, index)
+        c = {'type': 'org.example.connector', 'name': 'z'}
+        index.add(c)
+        self.assertEqual(index.find('name', 'z'), [c])
+        self.assertEqual(index.last('org.example.listener', 'org.example.connector'), c)
+        index.remove(c)
+        self.assertEqual(index.find('name', 'z'), [])
+        self.assertEqual(len(index), 2)
+        s.validate_add({'type': 'connector', 'name': 'z'}, index)
+
     def test_schema_entity(self):
         s = Schema(**SCHEMA_1)
         self.assertRaises(ValidationError, s.entity, {'type': 'nosuch'})
@@ -21,6 +21,7 @@
 #include "test_case.h"
 
 #include "qpid/dispatch/amqp.h"
+#include "qpid/dispatch/discriminator.h"
 #include "qpid/dispatch/iterator.h"
 
 #include <proton/message.h>
@@ -608,6 +609,142 @@ exit:
 }
 
 
+// Compose the router annotations of msg with the given flags and parse them into a new message, which replaces msg
+//
+static const char *recompose_router_annotations(qd_message_t **msg, unsigned int ra_flags)
+{
+    qd_buffer_list_t blist = DEQ_EMPTY;
+
+    if (_compose_router_annotations((qd_message_pvt_t*) *msg, ra_flags, &blist) == 0)
+        return "failed to compose router annotations";
+    qd_message_free(*msg);
+
+    *msg = qd_message();
+    qd_message_content_t *content = MSG_CONTENT(*msg);
+    DEQ_APPEND(content->buffers, blist);
+    SET_ATOMIC_FLAG(&content->receive_complete);
+    return qd_message_parse_router_annotations(*msg);
+}
+
+
+static bool check_trace_fingerprints(qd_message_t *msg, const uint64_t *expected, uint32_t count)
+{
+    uint64_t fingerprints[8];
+    if (qd_message_get_trace_fingerprints(msg, fingerprints, 8) != count)
+        return false;
+    return memcmp(fingerprints, expected, count * sizeof(uint64_t)) == 0;
+}
+
+
+// Pass a trace through routers using compact traces (router annotations version 3) and routers that do not.  The
+// trace must keep every hop, including routers unknown to the router turning a compact trace into a trace list.
+//
+static char *test_compact_trace(void *context)
+{
+    const char     *error = 0;
+    qd_tracemask_t *tm    = qd_tracemask();
+    qd_tracemask_t *old   = qd_message_set_trace_resolver(tm);
+    char            unknown[2][QD_TRACE_UNKNOWN_ID_LEN + 1] = {{0}};
+
+    // this router knows RouterA only, RouterB and itself are unknown to the resolver
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/RouterA", 0);
+
+    const uint64_t fp_a    = qd_tracemask_fingerprint("0/RouterA", 9);
+    const uint64_t fp_b    = qd_tracemask_fingerprint("0/RouterB", 9);
+    const uint64_t fp_self = qd_tracemask_fingerprint("0/UnitTestRouter", 16);
+    qd_tracemask_unknown_trace_id(fp_b, unknown[0], QD_TRACE_UNKNOWN_ID_LEN);
+    qd_tracemask_unknown_trace_id(fp_self, unknown[1], QD_TRACE_UNKNOWN_ID_LEN);
+
+    const char   *trace[] = {"0/RouterA", "0/RouterB", 0};
+    qd_message_t *msg     = generate_ra_test_message(0, 0, "0/RouterA", trace);
+    error = qd_message_parse_router_annotations(msg);
+    if (error)
+        goto exit;
+    if (qd_message_trace_is_compact(msg)) {
+        error = "Test0: trace list parsed as compact";
+        goto exit;
+    }
+
+    // to a version 3 peer: the trace list is fingerprinted and this router appended
+    error = recompose_router_annotations(&msg, QD_MESSAGE_RA_COMPACT_TRACE);
+    if (error)
+        goto exit;
+    if (!qd_message_trace_is_compact(msg)) {
+        error = "Test1: compact trace expected";
+        goto exit;
+    }
+    const uint64_t expect1[] = {fp_a, fp_b, fp_self};
+    if (!check_trace_fingerprints(msg, expect1, 3)) {
+        error = "Test1: invalid compact trace";
+        goto exit;
+    }
+    qd_parsed_field_t *pf_ingress = qd_message_get_ingress_router(msg);
+    if (!pf_ingress || !qd_iterator_equal(qd_parse_raw(pf_ingress), (const unsigned char*) "0/RouterA")) {
+        error = "Test1: ingress router not kept";
+        goto exit;
+    }
+
+    // compact to compact: the received fingerprints are copied
+    error = recompose_router_annotations(&msg, QD_MESSAGE_RA_COMPACT_TRACE);
+    if (error)
+        goto exit;
+    const uint64_t expect2[] = {fp_a, fp_b, fp_self, fp_self};
+    if (!check_trace_fingerprints(msg, expect2, 4)) {
+        error = "Test2: invalid compact trace";
+        goto exit;
+    }
+
+    // to a version 2 peer: known routers are named, unknown ones keep their fingerprint
+    error = recompose_router_annotations(&msg, QD_MESSAGE_RA_STRIP_NONE);
+    if (error)
+        goto exit;
+    if (qd_message_trace_is_compact(msg)) {
+        error = "Test3: trace list expected";
+        goto exit;
+    }
+    qd_parsed_field_t *pf_trace = qd_message_get_trace(msg);
+    if (!pf_trace || qd_parse_sub_count(pf_trace) != 5) {
+        error = "Test3: unknown routers dropped from the trace list";
+        goto exit;
+    }
+    const char *expect3[] = {"0/RouterA", unknown[0], unknown[1], unknown[1], "0/UnitTestRouter"};
+    for (uint32_t i = 0; i < 5; i++) {
+        if (!qd_iterator_equal(qd_parse_raw(qd_parse_sub_value(pf_trace, i)), (const unsigned char*) expect3[i])) {
+            error = "Test3: invalid trace list entry";
+            goto exit;
+        }
+    }
+
+    // and back to a version 3 peer: the fingerprints of the unknown routers are restored
+    error = recompose_router_annotations(&msg, QD_MESSAGE_RA_COMPACT_TRACE);
+    if (error)
+        goto exit;
+    const uint64_t expect4[] = {fp_a, fp_b, fp_self, fp_self, fp_self, fp_self};
+    if (!check_trace_fingerprints(msg, expect4, 6)) {
+        error = "Test4: fingerprints of unknown routers not restored";
+        goto exit;
+    }
+
+    // a version 2 peer names the router once it is known
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/RouterB", 1);
+    error = recompose_router_annotations(&msg, QD_MESSAGE_RA_STRIP_NONE);
+    if (error)
+        goto exit;
+    pf_trace = qd_message_get_trace(msg);
+    if (!pf_trace || qd_parse_sub_count(pf_trace) != 7
+        || !qd_iterator_equal(qd_parse_raw(qd_parse_sub_value(pf_trace, 1)), (const unsigned char*) "0/RouterB")) {
+        error = "Test5: known router not named";
+        goto exit;
+    }
+
+exit:
+    qd_message_free(msg);
+    qd_message_set_trace_resolver(old);
+    qd_tracemask_free(tm);
+    return (char*) error;
+}
+
+
 static char* test_q2_input_holdoff_sensing(void *context)
 {
     if (QD_QLIMIT_Q2_LOWER >= QD_QLIMIT_Q2_UPPER)
@@ -1019,6 +1156,225 @@ exit:
 }
 
 
+// Message logging must not parse a pass-through message beyond the sections
+// needed for forwarding.
+//
+static char *test_pass_through_repr(void *context)
+{
+    char     *result = 0;
+    char      repr[256];
+    uint32_t  flags  = qd_message_repr_flags("all");
+
+    for (int pass_through = 0; pass_through < 2 && !result; ++pass_through) {
+        qd_message_t *msg = qd_message();
+
+        qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_PROPERTIES, 0);
+        qd_compose_start_list(field);
+        qd_compose_insert_null(field);                // message-id
+        qd_compose_insert_null(field);                // user-id
+        qd_compose_insert_string(field, "test_addr"); // to
+        qd_compose_end_list(field);
+        field = qd_compose(QD_PERFORMATIVE_APPLICATION_PROPERTIES, field);
+        qd_compose_start_map(field);
+        qd_compose_insert_symbol(field, "Key");
+        qd_compose_insert_string(field, "Value");
+        qd_compose_end_map(field);
+        field = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, field);
+        qd_compose_insert_null(field);
+        qd_message_compose_2(msg, field, true);
+        qd_compose_free(field);
+
+        if (pass_through)
+            qd_message_set_pass_through(msg);
+
+        if (qd_message_check_depth(msg, QD_DEPTH_PROPERTIES) != QD_MESSAGE_DEPTH_OK) {
+            result = "Unexpected depth check failure";
+        } else if (pass_through) {
+            if (qd_message_repr(msg, repr, sizeof(repr), flags) != 0)
+                result = "Pass-through message was logged";
+            else if (MSG_CONTENT(msg)->parse_depth != QD_DEPTH_PROPERTIES)
+                result = "Pass-through message was parsed beyond the properties";
+        } else if (qd_message_repr(msg, repr, sizeof(repr), flags) == 0 || !strstr(repr, "Value")) {
+            result = "Message was not logged";
+        }
+
+        qd_message_free(msg);
+    }
+
+    return result;
+}
+
+
+//
+// Copies share the annotation overrides of the message they were copied from
+// until one of them changes its own.
+//
+static char *test_copy_override_annotations(void *context)
+{
+    char         *result = 0;
+    qd_message_t *msg    = qd_message();
+    qd_message_set_to_override_annotation(msg, "to/original");
+
+    qd_message_t *copy = qd_message_copy(msg);
+    if (((qd_message_pvt_t*) copy)->ra_local != ((qd_message_pvt_t*) msg)->ra_local) {
+        result = "Copy does not share the overrides";
+        goto exit;
+    }
+
+    qd_message_set_to_override_annotation(copy, "to/original");
+    if (((qd_message_pvt_t*) copy)->ra_local != ((qd_message_pvt_t*) msg)->ra_local) {
+        result = "Setting an unchanged override unshared the overrides";
+        goto exit;
+    }
+
+    qd_message_set_to_override_annotation(copy, "to/copy");
+    qd_message_set_ingress_mesh(copy, "MeshOfTheCopy01");
+    if (strcmp(((qd_message_pvt_t*) msg)->ra_local->to_override, "to/original") != 0
+        || ((qd_message_pvt_t*) msg)->ra_local->ingress_mesh != 0) {
+        result = "Setting the overrides of a copy changed the original";
+        goto exit;
+    }
+    if (strcmp(((qd_message_pvt_t*) copy)->ra_local->to_override, "to/copy") != 0
+        || memcmp(((qd_message_pvt_t*) copy)->ra_local->ingress_mesh, "MeshOfTheCopy01", QD_DISCRIMINATOR_BYTES) != 0) {
+        result = "Overrides of the copy not set";
+        goto exit;
+    }
+
+exit:
+    qd_message_free(copy);
+    qd_message_free(msg);
+    return result;
+}
+
+
+// A stream as the TCP egress sees it: the headers, the dummy AMQP value body, then raw octets
+//
+#define RAW_BODY_OCTETS (QD_BUFFER_DEFAULT_SIZE * 3 + 100)
+
+static qd_message_t *raw_body_stream(unsigned char *raw)
+{
+    qd_message_t *msg = qd_message();
+
+    qd_composed_field_t *field = qd_compose(QD_PERFORMATIVE_HEADER, 0);
+    qd_compose_start_list(field);
+    qd_compose_insert_bool(field, 0);  // durable
+    qd_compose_end_list(field);
+    field = qd_compose(QD_PERFORMATIVE_PROPERTIES, field);
+    qd_compose_start_list(field);
+    qd_compose_insert_null(field);            // message-id
+    qd_compose_insert_null(field);            // user-id
+    qd_compose_insert_string(field, "tcp/1"); // to
+    qd_compose_end_list(field);
+    field = qd_compose(QD_PERFORMATIVE_BODY_AMQP_VALUE, field);
+    qd_compose_insert_null(field);
+    qd_message_compose_2(msg, field, false);
+    qd_compose_free(field);
+
+    for (int i = 0; i < RAW_BODY_OCTETS; i++)
+        raw[i] = (unsigned char) (i * 7);
+    set_content(MSG_CONTENT(msg), raw, RAW_BODY_OCTETS);
+    return msg;
+}
+
+
+// Take the raw body of out_msg two buffers at a time and check it arrives whole and in order
+//
+static char *check_raw_body(qd_message_t *out_msg, const unsigned char *raw)
+{
+    if (qd_message_check_depth(out_msg, QD_DEPTH_RAW_BODY) != QD_MESSAGE_DEPTH_OK)
+        return "Raw body not found";
+
+    size_t octets   = 0;
+    bool   complete = false;
+    while (!complete) {
+        qd_buffer_list_t taken = DEQ_EMPTY;
+        size_t           count = qd_message_take_raw_body(out_msg, &taken, 2, &complete);
+        if (count > 2 || count != DEQ_SIZE(taken)) {
+            qd_buffer_list_free_buffers(&taken);
+            return "Wrong number of buffers taken";
+        }
+        for (qd_buffer_t *buf = DEQ_HEAD(taken); buf; buf = DEQ_NEXT(buf)) {
+            size_t size = qd_buffer_size(buf);
+            if (octets + size > RAW_BODY_OCTETS || memcmp(qd_buffer_base(buf), raw + octets, size) != 0) {
+                qd_buffer_list_free_buffers(&taken);
+                return "Raw body data corrupted";
+            }
+            octets += size;
+        }
+        qd_buffer_list_free_buffers(&taken);
+        if (count == 0 && !complete)
+            return "No progress taking the raw body";
+    }
+    if (octets != RAW_BODY_OCTETS)
+        return "Raw body truncated";
+
+    qd_buffer_list_t none = DEQ_EMPTY;
+    if (qd_message_take_raw_body(out_msg, &none, 2, &complete) != 0 || !complete)
+        return "Raw body taken twice";
+    return 0;
+}
+
+
+static char *test_take_raw_body(void *context)
+{
+    static unsigned char raw[RAW_BODY_OCTETS];
+    char                *result = 0;
+
+    // a single consumer takes the buffers after the first out of the content
+    qd_message_t *msg = raw_body_stream(raw);
+    qd_message_t *out = qd_message_copy(msg);
+    qd_message_add_fanout(out);
+    qd_message_start_unicast_cutthrough(out);
+    size_t before = DEQ_SIZE(MSG_CONTENT(msg)->buffers);
+    result = check_raw_body(out, raw);
+    if (!result && DEQ_SIZE(MSG_CONTENT(msg)->buffers) >= before)
+        result = "Single consumer did not take the body buffers";
+    qd_message_free(out);
+    qd_message_free(msg);
+    if (result)
+        return result;
+
+    // with two consumers every buffer is shared and each gets all of the body
+    msg = raw_body_stream(raw);
+    qd_message_t *out1 = qd_message_copy(msg);
+    qd_message_t *out2 = qd_message_copy(msg);
+    qd_message_add_fanout(out1);
+    qd_message_add_fanout(out2);
+    qd_message_start_unicast_cutthrough(out1);
+    before = DEQ_SIZE(MSG_CONTENT(msg)->buffers);
+    result = check_raw_body(out1, raw);
+    if (!result)
+        result = check_raw_body(out2, raw);
+    if (!result && DEQ_SIZE(MSG_CONTENT(msg)->buffers) != before)
+        result = "Shared content buffers removed";
+    qd_message_free(out2);
+    qd_message_free(out1);
+    qd_message_free(msg);
+    return result;
+}
+
+
+// The originating message shares its allocation with the content: freeing it while a copy is alive must still
+// invalidate its safe pointers
+//
+static char *test_arena_message_safe_ptr(void *context)
+{
+    char           *result = 0;
+    qd_message_t   *msg    = qd_message();
+    qd_message_t   *copy   = qd_message_copy(msg);
+    qd_message_t_sp sp;
+
+    set_safe_ptr_qd_message_t(msg, &sp);
+    if (safe_deref_qd_message_t(sp) != msg)
+        result = "Safe pointer to a live message does not resolve";
+    qd_message_free(msg);
+    if (!result && safe_deref_qd_message_t(sp) != 0)
+        result = "Safe pointer to a freed message still resolves while a copy is alive";
+    qd_message_free(copy);
+    return result;
+}
+
+
 int message_tests(void)
 {
     int result = 0;
@@ -1029,11 +1385,16 @@ int message_tests(void)
     TEST_CASE(test_message_properties, 0);
     TEST_CASE(test_check_multiple, 0);
     TEST_CASE(test_parse_router_annotations, 0);
+    TEST_CASE(test_compact_trace, 0);
     TEST_CASE(test_q2_input_holdoff_sensing, 0);
     TEST_CASE(test_incomplete_annotations, 0);
     TEST_CASE(test_check_weird_messages, 0);
     TEST_CASE(test_q2_callback_on_disable, 0);
     TEST_CASE(test_q2_ignore_headers, 0);
+    TEST_CASE(test_pass_through_repr, 0);
+    TEST_CASE(test_copy_override_annotations, 0);
+    TEST_CASE(test_take_raw_body, 0);
+    TEST_CASE(test_arena_message_safe_ptr, 0);
 
     return result;
 }
@@ -0,0 +1,169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Unit test for the metrics registry
+ */
+
+#include "qpid/dispatch/metrics.h"
+
+#include "test_case.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_MAX (1024 * 1024)
+
+// Render the whole registry using buffers of 'size' octets, returns a null terminated string to free()
+//
+static char *render_all(size_t size)
+{
+    char               *output = malloc(RENDER_MAX);
+    char               *buffer = malloc(size);
+    size_t              total  = 0;
+    qd_metrics_cursor_t cursor = {0};
+
+    while (!cursor.done) {
+        size_t len = qd_metrics_render(&cursor, buffer, size);
+        if (total + len >= RENDER_MAX)
+            break;
+        memcpy(output + total, buffer, len);
+        total += len;
+    }
+    output[total] = '\0';
+    free(buffer);
+    return output;
+}
+
+
+static char *test_histogram_bounds(void *context)
+{
+    if (qd_metric_histogram_bound(0) != 0 || qd_metric_histogram_bound(3) != 3 || qd_metric_histogram_bound(4) != 4
+        || qd_metric_histogram_bound(7) != 7 || qd_metric_histogram_bound(8) != 9 || qd_metric_histogram_bound(11) != 15)
+        return "Unexpected bound of the first buckets";
+
+    for (int i = 1; i < QD_METRIC_HISTOGRAM_BUCKETS; ++i) {
+        if (qd_metric_histogram_bound(i) <= qd_metric_histogram_bound(i - 1))
+            return "Bucket bounds not increasing";
+    }
+    if (qd_metric_histogram_bound(QD_METRIC_HISTOGRAM_BUCKETS - 2) != ((uint64_t) 1 << QD_METRIC_HISTOGRAM_MAX_EXP) - 1)
+        return "Unexpected bound of the last finite bucket";
+    return 0;
+}
+
+
+static char *test_histogram_observe(void *context)
+{
+    char        *result = 0;
+    qd_metric_t *hist   = qd_metric(QD_METRIC_HISTOGRAM, "test_observe_microseconds", "name", "a\"b");
+    qd_metric_observe(hist, 5);
+    qd_metric_observe(hist, 5);
+    qd_metric_observe(hist, 1000);
+    qd_metric_observe(hist, UINT64_MAX);
+
+    if (qd_metric_value(hist) != 4) {
+        result = "Wrong histogram count";
+    } else {
+        char *output = render_all(QD_METRICS_RENDER_MIN);
+        if (!strstr(output, "# TYPE test_observe_microseconds histogram\n"))
+            result = "Missing TYPE line";
+        else if (!strstr(output, "test_observe_microseconds_bucket{name=\"a\\\"b\",le=\"5\"} 2\n"))
+            result = "Missing bucket of the value 5";
+        else if (!strstr(output, "test_observe_microseconds_bucket{name=\"a\\\"b\",le=\"1023\"} 3\n"))
+            result = "Missing bucket of the value 1000";
+        else if (!strstr(output, "test_observe_microseconds_bucket{name=\"a\\\"b\",le=\"+Inf\"} 4\n"))
+            result = "Missing +Inf bucket";
+        else if (!strstr(output, "test_observe_microseconds_count{name=\"a\\\"b\"} 4\n"))
+            result = "Missing count";
+        free(output);
+    }
+    qd_metric_free(hist);
+    return result;
+}
+
+
+static char *test_multiple_labels(void *context)
+{
+    char              *result   = 0;
+    const char *const  names[]  = {"listener", "method", "code"};
+    const char *const  values[] = {"l1", "/pkg.Svc/\"Get\"", "0"};
+    qd_metric_t       *counter  = qd_metric_labels(QD_METRIC_COUNTER, "test_labels_total", 3, names, values);
+    qd_metric_inc(counter, 2);
+
+    char *output = render_all(QD_METRICS_RENDER_MIN);
+    if (!strstr(output, "test_labels_total{listener=\"l1\",method=\"/pkg.Svc/\\\"Get\\\"\",code=\"0\"} 2\n"))
+        result = "Missing counter with three labels";
+    free(output);
+    qd_metric_free(counter);
+    return result;
+}
+
+
+// A rendering split across many small buffers must match a rendering into a single buffer
+//
+static char *test_render_incremental(void *context)
+{
+    char         *result = 0;
+    qd_metric_t  *counters[50];
+    qd_metric_t  *gauge = qd_metric(QD_METRIC_GAUGE, "test_incremental_gauge", 0, 0);
+    char          label[16];
+
+    for (int i = 0; i < 50; ++i) {
+        snprintf(label, sizeof(label), "c%d", i);
+        counters[i] = qd_metric(QD_METRIC_COUNTER, "test_incremental_total", "index", label);
+        qd_metric_inc(counters[i], i);
+    }
+    qd_metric_set(gauge, 10);
+    qd_metric_dec(gauge, 3);
+
+    {
+        char *whole = render_all(RENDER_MAX);
+        char *parts = render_all(512);
+        if (strcmp(whole, parts) != 0)
+            result = "Incremental rendering differs";
+        else if (!strstr(whole, "test_incremental_gauge 7\n"))
+            result = "Wrong gauge value";
+        else if (!strstr(whole, "test_incremental_total{index=\"c49\"} 49\n"))
+            result = "Missing counter";
+        else if (strstr(strstr(whole, "# TYPE test_incremental_total") + 1, "# TYPE test_incremental_total"))
+            result = "Duplicate TYPE line";
+        free(whole);
+        free(parts);
+    }
+
+    for (int i = 0; i < 50; ++i)
+        qd_metric_free(counters[i]);
+    qd_metric_free(gauge);
+    return result;
+}
+
+
+int metrics_tests(void)
+{
+    int result = 0;
+    char *test_group = "metrics_tests";
+
+    TEST_CASE(test_histogram_bounds, 0);
+    TEST_CASE(test_histogram_observe, 0);
+    TEST_CASE(test_render_incremental, 0);
+    TEST_CASE(test_multiple_labels, 0);
+
+    return result;
+}
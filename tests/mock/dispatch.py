@@ -38,16 +38,16 @@ class LogAdapter:
     def __init__(self, mod_name):
         self.mod_name = mod_name
 
-    def log(self, level, text):
+    def log(self, level, text, *args):
         print("LOG: mod=%s level=%d text=%s" % (self.mod_name, level, text))
 
 
 class IoAdapter:
-    def __init__(self, handler, address, global_address=False):
-        self.handler = handler
-        self.address = address
-        self.global_address = global_address
-
-    def send(self, address, properties, application_properties, body, correlation_id=None):
-        print("IO: send(addr=%s properties=%r application_properties=%r body=%r"
-              % (address, properties, application_properties, body))
+    def __init__(self, handler, address, aclass='L', treatment=TREATMENT_ANYCAST_CLOSEST):
+        self.handler   = handler
+        self.address   = address
+        self.aclass    = aclass
+        self.treatment = treatment
+
+    def send(self, message, no_echo=True, control=False):
+        print("IO: send(%r)" % message)
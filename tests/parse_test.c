@@ -478,6 +478,8 @@ struct err_vector_t {
 {"\xb0\x00\x00\x00", 4, "Insufficient Data to Determine Length"},        // 7
 {"\xc0\x04",         2, "Insufficient Data to Determine Count"},         // 8
 {"\xd0\x00\x00\x00\x00\x00\x00\x00\x01",  9, "Insufficient Length to Determine Count"}, // 9
+{"\xc0\x04\x03\x52\x01\x21", 6, "Invalid Tag - No Length Information"}, // 10 second element of a list
+{"\xc0\x04\x02\x45\xa1\x05", 6, "Truncated field"},                     // 11 string in a list
 {0, 0, 0}
 };
 
@@ -512,6 +514,18 @@ static char *test_parser_errors(void *context)
             return error;
         }
         qd_parse_free(parsed);
+
+        // lazy parsing validates the whole field too
+        parsed = qd_parse_lazy(field);
+        if (qd_parse_ok(parsed) || strcmp(qd_parse_error(parsed), err_vectors[idx].expected_error) != 0) {
+            sprintf(error, "(%d) Lazy Error: Expected %s, Got %s", idx,
+                    err_vectors[idx].expected_error, qd_parse_ok(parsed) ? "success" : qd_parse_error(parsed));
+            qd_parse_free(parsed);
+            qd_iterator_free(field);
+            qd_buffer_list_free_buffers(&buflist);
+            return error;
+        }
+        qd_parse_free(parsed);
         qd_iterator_free(field);
         qd_buffer_list_free_buffers(&buflist);
         idx++;
@@ -625,6 +639,82 @@ cleanup:
 }
 
 
+static char *test_tracemask_compact(void *context)
+{
+    qd_bitmask_t   *bm = NULL;
+    qd_tracemask_t *tm = qd_tracemask();
+    static char     error[1024];
+    char            trace_id[64];
+
+    error[0] = 0;
+
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.A", 0);
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.B", 1);
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.C", 2);
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.D", 3);
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.E", 4);
+    qd_tracemask_add_router(tm, "amqp:/_topo/0/Router.F", 5);
+
+    qd_tracemask_set_link(tm, 0, 4);
+    qd_tracemask_set_link(tm, 3, 10);
+    qd_tracemask_set_link(tm, 4, 3);
+    qd_tracemask_set_link(tm, 5, 2);
+
+    const uint64_t trace[] = {qd_tracemask_fingerprint("0/Router.A", 10), qd_tracemask_fingerprint("0/Router.X", 10),
+                              qd_tracemask_fingerprint("0/Router.D", 10), qd_tracemask_fingerprint("0/Router.E", 10)};
+
+    int ingress = -1;
+    bm = qd_tracemask_create_compact(tm, trace, 4, &ingress);
+    if (qd_bitmask_cardinality(bm) != 3) {
+        sprintf(error, "Expected cardinality of 3, got %d", qd_bitmask_cardinality(bm));
+        goto cleanup;
+    }
+    if (ingress != 0) {
+        sprintf(error, "Expected ingress index of 0, got %d", ingress);
+        goto cleanup;
+    }
+    int total = 0;
+    int bit, c;
+    for (QD_BITMASK_EACH(bm, bit, c)) {
+        total += bit;
+    }
+    if (total != 17) {
+        sprintf(error, "Expected total bit value of 17, got %d", total);
+        goto cleanup;
+    }
+
+    size_t len = qd_tracemask_trace_id(tm, trace[2], trace_id, sizeof(trace_id));
+    if (len != 10 || memcmp(trace_id, "0/Router.D", len) != 0) {
+        sprintf(error, "Expected trace id 0/Router.D, got %.*s", (int) len, trace_id);
+        goto cleanup;
+    }
+    if (qd_tracemask_trace_id(tm, trace[1], trace_id, sizeof(trace_id)) != 0) {
+        sprintf(error, "Expected no trace id for an unknown router");
+        goto cleanup;
+    }
+
+    qd_bitmask_free(bm);
+    bm = 0;
+    qd_tracemask_del_router(tm, 3);
+    if (qd_tracemask_trace_id(tm, trace[2], trace_id, sizeof(trace_id)) != 0) {
+        sprintf(error, "Expected no trace id for a deleted router");
+        goto cleanup;
+    }
+
+    ingress = -1;
+    bm = qd_tracemask_create_compact(tm, trace, 4, &ingress);
+    if (qd_bitmask_cardinality(bm) != 2) {
+        sprintf(error, "Expected cardinality of 2, got %d", qd_bitmask_cardinality(bm));
+        // fallthrough
+    }
+
+cleanup:
+    qd_tracemask_free(tm);
+    qd_bitmask_free(bm);
+    return *error ? error : 0;
+}
+
+
 static char *test_field_api(void *context)
 {
     char *result = 0;
@@ -717,6 +807,128 @@ exit:
     return result;
 }
 
+static char *test_lazy_parse(void *context)
+{
+    char *result = 0;
+    const uint8_t data[] =
+        "\xc1\x13\x04"                             // map8, 4 items
+        "\xa1\x01" "a"                              // "a":
+        "\xc0\x07\x03\x52\x01\x52\x02\x52\x03"      //     [1, 2, 3]
+        "\xa1\x01" "b" "\xa1\x01" "x";              // "b": "x"
+
+    qd_buffer_list_t buflist = DEQ_EMPTY;
+    qd_buffer_list_append(&buflist, data, sizeof(data) - 1);
+    qd_iterator_t     *iter   = qd_iterator_buffer(DEQ_HEAD(buflist), 0, sizeof(data) - 1, ITER_VIEW_ALL);
+    qd_parsed_field_t *parsed = qd_parse_lazy(iter);
+    qd_parsed_field_t *dup    = 0;
+
+    if (!qd_parse_ok(parsed) || !qd_parse_is_map(parsed) || qd_parse_sub_count(parsed) != 2) {
+        result = "failed to parse the map";
+        goto exit;
+    }
+
+    // visiting a later key decodes the entries before it, but not the list's elements
+    qd_parsed_field_t *value = qd_parse_value_by_key(parsed, "b");
+    if (!value || !qd_iterator_equal(qd_parse_raw(value), (const unsigned char *) "x")) {
+        result = "wrong value of \"b\"";
+        goto exit;
+    }
+
+    dup = qd_parse_dup(parsed);
+
+    value = qd_parse_value_by_key(parsed, "a");
+    if (!value || !qd_parse_is_list(value) || qd_parse_is_scalar(value) || qd_parse_sub_count(value) != 3) {
+        result = "wrong value of \"a\"";
+        goto exit;
+    }
+
+    uint32_t expected = 1;
+    for (qd_parsed_field_t *item = qd_field_first_child(value); item; item = qd_field_next_child(item)) {
+        if (qd_parse_as_uint(item) != expected++) {
+            result = "wrong list element";
+            goto exit;
+        }
+    }
+    if (expected != 4) {
+        result = "wrong number of list elements";
+        goto exit;
+    }
+
+    // the list of the duplicate is decoded on its own
+    value = qd_parse_value_by_key(dup, "a");
+    if (!value || qd_parse_as_uint(qd_parse_sub_value(value, 2)) != 3 || qd_parse_sub_value(value, 3) != 0) {
+        result = "wrong list of the duplicate";
+        goto exit;
+    }
+
+exit:
+    qd_parse_free(dup);
+    qd_parse_free(parsed);
+    qd_iterator_free(iter);
+    qd_buffer_list_free_buffers(&buflist);
+    return result;
+}
+
+static char *test_indexed_map(void *context)
+{
+    char                *result = 0;
+    qd_buffer_list_t     blist  = DEQ_EMPTY;
+    qd_composed_field_t *comp   = qd_compose_subfield(0);
+    char                 key[16];
+
+    // large enough to be indexed, with a duplicate key and a key that is a prefix of another
+    qd_compose_start_map(comp);
+    for (uint32_t i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key-%"PRIu32, i);
+        qd_compose_insert_string(comp, key);
+        qd_compose_insert_uint(comp, i);
+    }
+    qd_compose_insert_string(comp, "key-7");
+    qd_compose_insert_uint(comp, 100);
+    qd_compose_insert_symbol(comp, "key-1x");
+    qd_compose_insert_uint(comp, 101);
+    qd_compose_end_map(comp);
+    qd_compose_take_buffers(comp, &blist);
+    qd_compose_free(comp);
+
+    qd_iterator_t     *iter   = qd_iterator_buffer(DEQ_HEAD(blist), 0, qd_buffer_list_length(&blist), ITER_VIEW_ALL);
+    qd_parsed_field_t *parsed = qd_parse_lazy(iter);
+    if (!qd_parse_ok(parsed) || qd_parse_sub_count(parsed) != 22) {
+        result = "failed to parse the map";
+        goto exit;
+    }
+
+    for (uint32_t i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key-%"PRIu32, i);
+        qd_parsed_field_t *value = qd_parse_value_by_key(parsed, key);
+        if (!value || qd_parse_as_uint(value) != i) {
+            result = "wrong value by key";
+            goto exit;
+        }
+        if (qd_parse_as_uint(qd_parse_sub_value(parsed, i)) != i
+            || !qd_iterator_equal(qd_parse_raw(qd_parse_sub_key(parsed, i)), (const unsigned char *) key)) {
+            result = "wrong entry by index";
+            goto exit;
+        }
+    }
+
+    if (qd_parse_as_uint(qd_parse_value_by_key(parsed, "key-1x")) != 101) {
+        result = "wrong value of the symbol key";
+        goto exit;
+    }
+    if (qd_parse_value_by_key(parsed, "key-") || qd_parse_value_by_key(parsed, "key-20")
+        || qd_parse_sub_value(parsed, 22)) {
+        result = "found a missing key";
+        goto exit;
+    }
+
+exit:
+    qd_parse_free(parsed);
+    qd_iterator_free(iter);
+    qd_buffer_list_free_buffers(&blist);
+    return result;
+}
+
 int parse_tests(void)
 {
     int result = 0;
@@ -726,8 +938,11 @@ int parse_tests(void)
     TEST_CASE(test_map, 0);
     TEST_CASE(test_parser_errors, 0);
     TEST_CASE(test_tracemask, 0);
+    TEST_CASE(test_tracemask_compact, 0);
     TEST_CASE(test_integer_conversion, 0);
     TEST_CASE(test_field_api, 0);
+    TEST_CASE(test_lazy_parse, 0);
+    TEST_CASE(test_indexed_map, 0);
 
     return result;
 }
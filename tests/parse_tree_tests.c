@@ -855,6 +855,75 @@ cleanup:
 }
 
 
+// verify memoized matches follow pattern additions and removals
+static char *test_match_cache(void *context)
+{
+    char *error = 0;
+    qd_parse_tree_t *tree = qd_parse_tree_new(QD_PARSE_TREE_ADDRESS);
+    void *payload;
+
+    qd_parse_tree_enable_match_cache(tree, 4);
+
+    if (qd_parse_tree_add_pattern_str(tree, "a.b", (void *) "exact")) {
+        error = "Unexpected error when adding pattern";
+        goto done;
+    }
+
+    // no wildcards in the tree yet: exact lookups, cached hits and misses
+    for (int i = 0; i < 3; i++) {
+        if (!qd_parse_tree_retrieve_match_str(tree, "a/b", &payload) || strcmp((char *) payload, "exact") != 0) {
+            error = "Expected exact match";
+            goto done;
+        }
+        if (qd_parse_tree_retrieve_match_str(tree, "a.c", &payload) || payload) {
+            error = "Unexpected match of a.c";
+            goto done;
+        }
+    }
+
+    // adding a wildcard must invalidate the cached miss
+    if (qd_parse_tree_add_pattern_str(tree, "a.*", (void *) "star")) {
+        error = "Unexpected error when adding wildcard pattern";
+        goto done;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!qd_parse_tree_retrieve_match_str(tree, "a.c", &payload) || strcmp((char *) payload, "star") != 0) {
+            error = "Expected wildcard match of a.c";
+            goto done;
+        }
+        if (!qd_parse_tree_retrieve_match_str(tree, "a.b", &payload) || strcmp((char *) payload, "exact") != 0) {
+            error = "Expected exact match to take precedence";
+            goto done;
+        }
+    }
+
+    // overflow the cache
+    for (int i = 0; i < 20; i++) {
+        char value[32];
+        snprintf(value, sizeof(value), "a.x%d", i);
+        if (!qd_parse_tree_retrieve_match_str(tree, value, &payload) || strcmp((char *) payload, "star") != 0) {
+            error = "Expected wildcard match while cache overflows";
+            goto done;
+        }
+    }
+
+    // removing the wildcard must invalidate the cached hit
+    qd_parse_tree_remove_pattern_str(tree, "a.*");
+    if (qd_parse_tree_retrieve_match_str(tree, "a.c", &payload) || payload) {
+        error = "Stale cached match after pattern removal";
+        goto done;
+    }
+    if (!qd_parse_tree_retrieve_match_str(tree, "a.b", &payload) || strcmp((char *) payload, "exact") != 0) {
+        error = "Lost exact match after wildcard removal";
+        goto done;
+    }
+
+done:
+    qd_parse_tree_free(tree);
+    return error;
+}
+
+
 int parse_tree_tests(void)
 {
     int result = 0;
@@ -867,5 +936,6 @@ int parse_tree_tests(void)
     TEST_CASE(test_matches, 0);
     TEST_CASE(test_multiple_matches, 0);
     TEST_CASE(test_validation, 0);
+    TEST_CASE(test_match_cache, 0);
     return result;
 }
@@ -166,6 +166,80 @@ static char *test_link_name_tree_lookup(void *context)
 }
 
 
+static char *test_compiled_link_name_lookup(void *context)
+{
+    // The compiled names must agree with _qd_policy_approve_link_name for every user
+    static const struct {
+        const char *allowed;
+        const char *proposed;
+    } cases[] = {
+        {"a,joe,", "joe"},
+        {"a,joe,", "joey"},
+        {"a,joe*,", "joey"},
+        {"a,joe*,", "jo"},
+        {"a,joe,,*,,", "anything"},
+        {"a,no1,,a,no2,,a,yes,,a,no4,", "yes"},
+        {"a,no1,,a,no2,,a,yes,,a,no4,", "no3"},
+        {"e,ab,xyz", "abchuckxyz"},
+        {"e,ab,xyz", "abbobxyz"},
+        {"p,,xyz", "chuckxyz"},
+        {"s,ab,", "abchuck"},
+        {"e,ab,*", "abchuckzyxw"},
+        {"p,,*", "chuck"},
+        {"a,*,", "whatever"},
+        {"a,joe,", ""},
+    };
+    static const char *users[] = {"chuck", "bob", ""};
+
+    for (int u = 0; u < sizeof(users) / sizeof(users[0]); ++u) {
+        for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+            qd_policy_link_names_t *names = _qd_policy_compile_link_names(users[u], cases[i].allowed);
+            if (!names)
+                return "allowed links failed to compile";
+            bool expected = _qd_policy_approve_link_name(users[u], cases[i].allowed, cases[i].proposed);
+            bool actual   = _qd_policy_approve_compiled_link_name(names, cases[i].proposed);
+            _qd_policy_link_names_free(names);
+            if (expected != actual) {
+                printf("user '%s' allowed '%s' proposed '%s'\n", users[u], cases[i].allowed, cases[i].proposed);
+                return "compiled link names do not agree with the allowed links";
+            }
+        }
+    }
+
+    if (_qd_policy_compile_link_names("chuck", ""))
+        return "blank allowed list should not compile";
+
+    return 0;
+}
+
+
+static char *test_user_parse_tree_lookup(void *context)
+{
+    void *payload = 0;
+    qd_parse_tree_t *tree = _qd_policy_user_parse_tree("p,,.#,s,abc.,,a,fixed.*,", "chuck");
+    if (!tree)
+        return "user parse tree failed to build";
+
+    if (!qd_parse_tree_retrieve_match_str(tree, "chuck", &payload) ||
+        !qd_parse_tree_retrieve_match_str(tree, "chuck.stubs.wobbler", &payload) ||
+        !qd_parse_tree_retrieve_match_str(tree, "abc.chuck", &payload) ||
+        !qd_parse_tree_retrieve_match_str(tree, "fixed.thing", &payload)) {
+        qd_parse_tree_free(tree);
+        return "proposed link should match the patterns of user 'chuck' but does not";
+    }
+
+    if (qd_parse_tree_retrieve_match_str(tree, "bob.stubs", &payload) ||
+        qd_parse_tree_retrieve_match_str(tree, "abc.achuck", &payload) ||
+        qd_parse_tree_retrieve_match_str(tree, "abc.ynot.chuck", &payload)) {
+        qd_parse_tree_free(tree);
+        return "proposed link should not match the patterns of user 'chuck' but does";
+    }
+
+    qd_parse_tree_free(tree);
+    return 0;
+}
+
+
 static char *test_link_name_csv_parser(void *context)
 {
     char * result;
@@ -216,6 +290,61 @@ static char *test_link_name_csv_parser(void *context)
 }
 
 
+#define NSEC_PER_SEC 1000000000ULL
+
+static char *test_token_bucket(void *context)
+{
+    qd_policy_token_bucket_t bucket;
+    char *result = 0;
+
+    // a new bucket holds one second's worth of tokens
+    _qd_policy_token_bucket_init(&bucket, 100, 0);
+    if (_qd_policy_token_bucket_take(&bucket, 100, 0) != 0) {
+        result = "full bucket should not delay";
+        goto exit;
+    }
+
+    // a deficit of half the rate needs half a second to refill
+    uint64_t delay = _qd_policy_token_bucket_take(&bucket, 50, 0);
+    if (delay < NSEC_PER_SEC / 2 || delay > NSEC_PER_SEC / 2 + 1000) {
+        result = "deficit delay should be half a second";
+        goto exit;
+    }
+    if (_qd_policy_token_bucket_take(&bucket, 0, NSEC_PER_SEC / 2 + 1000) != 0) {
+        result = "bucket should have refilled after the delay";
+        goto exit;
+    }
+
+    // an idle bucket refills up to the burst size only
+    if (_qd_policy_token_bucket_take(&bucket, 100, 10 * NSEC_PER_SEC) != 0) {
+        result = "refilled bucket should not delay";
+        goto exit;
+    }
+    if (_qd_policy_token_bucket_take(&bucket, 1, 10 * NSEC_PER_SEC) == 0) {
+        result = "burst should be limited to one second of tokens";
+        goto exit;
+    }
+
+    // lowering the rate clamps the tokens held to the new burst size
+    _qd_policy_token_bucket_set_rate(&bucket, 10, 20 * NSEC_PER_SEC);
+    if (_qd_policy_token_bucket_take(&bucket, 11, 20 * NSEC_PER_SEC) == 0) {
+        result = "tokens should be clamped to the new rate";
+        goto exit;
+    }
+
+    // rate zero never limits
+    _qd_policy_token_bucket_set_rate(&bucket, 0, 20 * NSEC_PER_SEC);
+    if (_qd_policy_token_bucket_take(&bucket, 1000000, 20 * NSEC_PER_SEC) != 0) {
+        result = "unlimited bucket should not delay";
+        goto exit;
+    }
+
+exit:
+    _qd_policy_token_bucket_final(&bucket);
+    return result;
+}
+
+
 int policy_tests(void)
 {
     int result = 0;
@@ -223,7 +352,10 @@ int policy_tests(void)
 
     TEST_CASE(test_link_name_lookup, 0);
     TEST_CASE(test_link_name_tree_lookup, 0);
+    TEST_CASE(test_compiled_link_name_lookup, 0);
+    TEST_CASE(test_user_parse_tree_lookup, 0);
     TEST_CASE(test_link_name_csv_parser, 0);
+    TEST_CASE(test_token_bucket, 0);
 
     return result;
 }
@@ -17,7 +17,9 @@
 # under the License.
 #
 
+import json
 import os
+import random
 import sys
 
 import mock  # noqa F401: imported for side-effects (installs mock definitions for tests)  # pylint: disable=unused-import
@@ -27,8 +29,10 @@ sys.path.append(os.path.join(os.environ["SOURCE_DIR"], "python"))
 from system_test import unittest
 from system_test import main_module
 from skupper_router.management.entity import EntityBase
-from skupper_router_internal.router.data import LinkState, MessageHELLO
+from skupper_router_internal.router.data import LinkState, LinkStateDeltaHistory, MessageHELLO, \
+    MessageLSR, MessageLSU, ProtocolVersion, TopologySnapshot
 from skupper_router_internal.router.engine import HelloProtocol, PathEngine
+import router_sim
 
 
 class Adapter:
@@ -83,6 +87,52 @@ class DataTest(unittest.TestCase):
         self.assertEqual(new_ls.ls_seq, 2)
         self.assertEqual(new_ls.peers, {'R2': 1, 'R4': 5})
 
+    def test_link_state_delta(self):
+        ls = LinkState(None, 'R1', 0, {})
+        ls.add_peer('R2', 1)
+        ls.add_peer('R3', 1)
+        ls.bump_sequence()
+        ls.del_peer('R2')
+        ls.add_peer('R4', 5)
+        ls.bump_sequence()
+        ls.add_peer('R2', 2)
+        ls.del_peer('R3')
+        ls.bump_sequence()
+        self.assertEqual(ls.ls_seq, 3)
+
+        self.assertEqual(ls.delta_since(3), ({}, []))
+        self.assertEqual(ls.delta_since(2), ({'R2': 2}, ['R3']))
+        self.assertEqual(ls.delta_since(1), ({'R2': 2, 'R4': 5}, ['R3']))
+        self.assertIsNone(ls.delta_since(0))
+        self.assertIsNone(ls.delta_since(4))
+
+        copy = LinkState(None, 'R1', 1, {'R2': 1, 'R3': 1})
+        changed, removed = ls.delta_since(1)
+        copy.apply_delta(ls.ls_seq, changed, removed)
+        self.assertEqual(copy.ls_seq, 3)
+        self.assertEqual(copy.peers, ls.peers)
+
+        for _ in range(LinkStateDeltaHistory):
+            ls.bump_sequence()
+        self.assertIsNone(ls.delta_since(2))
+        self.assertEqual(ls.delta_since(3), ({}, []))
+
+    def test_lsu_lsr_delta_messages(self):
+        lsr = MessageLSR(MessageLSR(None, 'R2', 7).to_dict())
+        self.assertEqual(lsr.have_seq, 7)
+        self.assertNotIn('have_seq', MessageLSR(None, 'R2').to_dict())
+
+        lsu = MessageLSU(MessageLSU(None, 'R1', 9, None, 3, 7, {'R4': 2}, ['R5']).to_dict())
+        self.assertTrue(lsu.is_delta())
+        self.assertIsNone(lsu.ls)
+        self.assertEqual((lsu.ls_seq, lsu.base_seq, lsu.instance), (9, 7, 3))
+        self.assertEqual(lsu.changed, {'R4': 2})
+        self.assertEqual(lsu.removed, ['R5'])
+
+        full = MessageLSU(MessageLSU(None, 'R1', 9, LinkState(None, 'R1', 9, {'R2': 1}), 3).to_dict())
+        self.assertFalse(full.is_delta())
+        self.assertEqual(full.ls.peers, {'R2': 1})
+
     def test_hello_message(self):
         msg1 = MessageHELLO(None, 'R1', ['R2', 'R3', 'R4'])
         self.assertEqual(msg1.get_opcode(), "HELLO")
@@ -95,6 +145,28 @@ class DataTest(unittest.TestCase):
         self.assertEqual(msg2.seen_peers, ['R2', 'R3', 'R4'])
         self.assertTrue(msg2.is_seen('R3'))
         self.assertFalse(msg2.is_seen('R9'))
+        self.assertIsNone(msg2.timestamp)
+        self.assertEqual(msg2.echo, {})
+
+        msg3 = MessageHELLO(MessageHELLO(None, 'R1', ['R2'], 0, 1500000, {'R2': [700000, 2500]}).to_dict())
+        self.assertEqual(msg3.timestamp, 1500000)
+        self.assertEqual(msg3.echo, {'R2': [700000, 2500]})
+
+    def test_topology_snapshot(self):
+        ls2 = LinkState(None, 'R2', 7, {'R1': 1, 'R3': 2})
+        ls3 = LinkState(None, 'R3', 4, {'R2': 2})
+        snap1 = TopologySnapshot(None, 'R1', 1234.5, [(ls2, 100), (ls3, None)])
+        encoded = json.loads(json.dumps(snap1.to_dict()))
+        snap2 = TopologySnapshot(encoded)
+        self.assertEqual(snap2.id, 'R1')
+        self.assertEqual(snap2.version, ProtocolVersion)
+        self.assertEqual(snap2.taken, 1234)
+        self.assertEqual(len(snap2.nodes), 2)
+        ls, instance = snap2.nodes[0]
+        self.assertEqual((ls.id, ls.ls_seq, ls.peers, instance), ('R2', 7, {'R1': 1, 'R3': 2}, 100))
+        ls, instance = snap2.nodes[1]
+        self.assertEqual((ls.id, ls.ls_seq, ls.peers, instance), ('R3', 4, {'R2': 2}, None))
+        self.assertRaises(Exception, TopologySnapshot, {'id': 'R1', 'pv': 1, 'taken': 0})
 
 
 class NodeTrackerTest(unittest.TestCase):
@@ -145,9 +217,13 @@ class NeighborTest(unittest.TestCase):
     def neighbor_refresh(self, node_id, ProtocolVersion, instance, link_id, cost, now):
         self.neighbors[node_id] = (instance, link_id, cost, now)
 
+    def neighbor_rtt(self, node_id, rtt):
+        self.rtts[node_id] = rtt
+
     def setUp(self):
         super().setUp()
         self.sent = []
+        self.rtts = {}
         self.neighbors = {}
         self.id = "R1"
         self.instance = 0
@@ -208,6 +284,81 @@ class NeighborTest(unittest.TestCase):
         keys = sorted(self.neighbors.keys())
         self.assertEqual(keys, ['R2', 'R3', 'R4', 'R6'])
 
+    def test_rtt_measured(self):
+        self.engine = HelloProtocol(self, self)
+        self.engine.tick(1.0)
+        dest, msg = self.sent.pop(0)
+        self.assertEqual(msg.timestamp, 1000000)
+
+        # R2 received the HELLO half a second later and held it for a quarter second before its own
+        self.engine.handle_hello(MessageHELLO(None, 'R2', ['R1'], 0, 1700000, {'R1': [1000000, 250000]}),
+                                 1.8, 0, 1)
+        self.assertAlmostEqual(self.rtts['R2'], 0.55)
+
+        # R1 echoes R2's timestamp in the next HELLO with the time it was held
+        self.engine.tick(2.0)
+        dest, msg = self.sent.pop(0)
+        self.assertEqual(msg.echo, {'R2': [1700000, 200000]})
+
+        # only echoes of R1's own timestamp are measured
+        self.rtts = {}
+        self.engine.handle_hello(MessageHELLO(None, 'R3', ['R1'], 0, 2100000, {'R4': [1000000, 0]}), 2.2, 0, 1)
+        self.assertEqual(self.rtts, {})
+
+
+def full_recompute_routes(my_id, collection):
+    """
+    The routes as the path engine computed them before it repaired its trees incrementally: a full
+    Dijkstra run from every root.  Used as the reference for topologies in which every shortest path
+    is unique, so that the way equal cost paths are resolved does not matter.
+    """
+    link_states = {}
+    for _id, ls in collection.items():
+        link_states[_id] = ls.peers
+        for p in ls.peers:
+            if p not in link_states:
+                link_states[p] = {_id: 1}
+
+    def tree(root):
+        cost = {root: 0}
+        hops = {root: 0}
+        prev = {}
+        unresolved = set(link_states)
+        while unresolved:
+            reachable = [u for u in unresolved if u in cost]
+            if not reachable:
+                break
+            u = min(reachable, key=lambda x: cost[x])
+            unresolved.remove(u)
+            for v, v_cost in link_states[u].items():
+                if v in unresolved and (v not in cost or cost[u] + v_cost < cost[v]):
+                    cost[v] = cost[u] + v_cost
+                    hops[v] = hops[u] + 1
+                    prev[v] = u
+        cost.pop(root)
+        hops.pop(root)
+        return prev, cost, hops
+
+    def path_to(prev, root, node):
+        nodes = []
+        while node != root:
+            nodes.append(node)
+            node = prev[node]
+        return nodes
+
+    prev, costs, hops = tree(my_id)
+    next_hops = {node: path_to(prev, my_id, node)[-1] for node in prev}
+    radius = max(hops.values()) if hops else 0
+
+    # root is a valid origin for dest if the path from root to dest passes through this router
+    valid_origins = {node: [] for node in prev}
+    for root in prev:
+        root_prev = tree(root)[0]
+        for dest in root_prev:
+            if dest != my_id and my_id in path_to(root_prev, root, dest)[1:]:
+                valid_origins[dest].append(root)
+    return next_hops, costs, valid_origins, radius
+
 
 class PathTest(unittest.TestCase):
     def setUp(self):
@@ -667,6 +818,99 @@ class PathTest(unittest.TestCase):
         self.assertEqual(r1_radius, 3)
         self.assertEqual(r3_radius, 2)
 
+    def test_incremental_matches_full_recompute(self):
+        """
+        Apply a sequence of link cost changes and link removals to a mesh and
+        verify that the incrementally repaired trees produce the same results
+        as the full recompute of the original path engine after every step.
+        Every link cost is a distinct power of two, so every path cost is
+        distinct and the shortest paths are unique.
+        """
+        rnd = random.Random(1234)
+        next_cost = iter(1 << i for i in range(1000))
+        ids = ['R%d' % i for i in range(1, 13)]
+        peers = {_id: {} for _id in ids}
+        for i, a in enumerate(ids):
+            for b in ids[i + 1:]:
+                if rnd.random() < 0.3:
+                    peers[a][b] = peers[b][a] = next(next_cost)
+
+        def collection():
+            return {_id: LinkState(None, _id, 1, dict(p)) for _id, p in peers.items()}
+
+        def results(engine):
+            next_hops, costs, valid_origins, radius = engine.calculate_routes(collection())
+            return next_hops, costs, {k: sorted(v) for k, v in valid_origins.items()}, radius
+
+        def expected():
+            next_hops, costs, valid_origins, radius = full_recompute_routes(self.id, collection())
+            return next_hops, costs, {k: sorted(v) for k, v in valid_origins.items()}, radius
+
+        for step in range(200):
+            self.assertEqual(results(self.engine), expected(), "step %d" % step)
+            a, b = rnd.sample(ids, 2)
+            if rnd.random() < 0.3:
+                peers[a].pop(b, None)
+            else:
+                peers[a][b] = next(next_cost)
+
+
+class ConvergenceSimTest(unittest.TestCase):
+    """
+    Run the convergence scenarios of router_sim on small networks
+    """
+    def check(self, **kwds):
+        results = router_sim.run(**kwds)
+        self.assertEqual([r['scenario'] for r in results], ['startup'] + router_sim.SCENARIOS[1:])
+        for r in results:
+            self.assertTrue(r['converged'], r)
+            self.assertEqual(r['stale_routes'], 0, r)
+            self.assertGreater(r['control_octets'], 0, r)
+
+    def test_random_mesh(self):
+        self.check(routers=16, topology='random', degree=4, seed=1)
+
+    def test_ring_with_loss(self):
+        self.check(routers=10, topology='ring', latency=0.01, jitter=0.005, loss=0.01, seed=2)
+
+    def test_link_failure_reroutes(self):
+        sim = router_sim.Simulation(seed=3)
+        try:
+            ids = router_sim.build_network(sim, 6, 'ring')
+            router_sim.scenario_startup(sim, ids, 60)
+            sim.link_down(sim.links[frozenset(('R0', 'R1'))])
+            self.assertTrue(sim.measure('link-failure', sim.routes_converged, 60)['converged'])
+            core = sim.cores['R0']
+            self.assertEqual(core.costs[core.by_id['R1']], 5)
+        finally:
+            sim.close()
+
+    def test_rtt_costs_avoid_high_latency_link(self):
+        """
+        R0 reaches R1 over a direct 120ms round-trip link or over R2 with 5ms round trip per link.  With the
+        configured costs alone the direct link is the least cost path, with RTT costs the path over R2 is.
+        """
+        def next_hop(quantum):
+            sim = router_sim.Simulation(seed=4, config=router_sim.SimConfig(rttCostQuantumMilliseconds=quantum))
+            try:
+                for router_id in ('R0', 'R1', 'R2'):
+                    sim.add_router(router_id)
+                sim.add_link('R0', 'R1', latency=0.06)
+                sim.add_link('R0', 'R2', latency=0.0025)
+                sim.add_link('R2', 'R1', latency=0.0025)
+                for router_id in ('R0', 'R1', 'R2'):
+                    sim.start_router(router_id)
+                sim.run_until(lambda: False, 30)
+                core = sim.cores['R0']
+                r1 = core.by_id['R1']
+                hop = core.next_hops.get(r1)
+                return core.costs[r1], core.by_maskbit[hop] if hop is not None else None
+            finally:
+                sim.close()
+
+        self.assertEqual(next_hop(0), (1, None))
+        self.assertEqual(next_hop(10), (2, 'R2'))
+
 
 if __name__ == '__main__':
     unittest.main(main_module())
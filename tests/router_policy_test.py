@@ -463,6 +463,10 @@ class PolicyAliases(TestCase):
         )
         self.assertTrue(upolicy['maxFrameSize']            == 444444)
         self.assertTrue(upolicy['sources'] == 'a,private,')
+        # rate limits are shared by the vhost the alias resolves to
+        self.assertEqual(upolicy['vhostPolicy'], 'photoserver')
+        self.assertEqual(upolicy['vhostMaxBytesPerSecond'], 0)
+        self.assertEqual(upolicy['vhostMaxMessagesPerSecond'], 0)
 
 
 if __name__ == '__main__':
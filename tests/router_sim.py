@@ -0,0 +1,675 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""
+Discrete event simulation of a network of router engines.
+
+Every simulated router runs the Python router engine (skupper_router_internal.router) on a virtual clock.  The
+parts of the router written in C are stood in for by SimCore: it records the route table the engine programs
+through the router adapter, forwards the control messages the engine sends hop by hop over that table, and plays
+the part of the mobile_sync core module exchanging mobile address updates (MAU) and requests (MAR).  Links have a
+latency, jitter and loss rate, so an arbitrary number of routers can be run in one process to measure:
+
+ - the time until every router has a route of the correct cost to every reachable router, and for address
+   registration until every router has the mobile address sequence of every other router
+ - the control message count and bytes each router transmitted, the bytes being approximated by the JSON
+   encoding of the message body
+ - the CPU time spent in each router's engine
+
+Run as a script for a report of the scenarios on a large network, e.g.
+
+    SOURCE_DIR=<source tree> python3 router_sim.py --routers 120 --topology random --degree 4 --latency 0.005
+
+router_engine_test runs the scenarios on small networks.
+"""
+
+import argparse
+import heapq
+import json
+import os
+import random
+import sys
+import time
+
+sys.path.append(os.path.join(os.environ.get("SOURCE_DIR", os.path.join(os.path.dirname(__file__), "..")), "python"))
+
+import mock  # noqa F401,E402: imported for side-effects (installs mock definitions for tests)  # pylint: disable=unused-import
+from skupper_router_internal.router import engine as engine_module  # noqa: E402
+from skupper_router_internal.router import node as node_module  # noqa: E402
+from skupper_router_internal.router.engine import RouterEngine  # noqa: E402
+
+TICK_INTERVAL  = 1.0  # seconds between timer ticks, as driven by the router's C timer
+MAX_ROUTERS    = 128
+ADDRESS_OCTETS = 40   # approximate encoded size of one address in a mobile address update
+CHECK_INTERVAL = 0.01  # simulated seconds between evaluations of the convergence predicates
+
+
+class SimClock:
+    """
+    Replaces the time module in the router engine modules so the engines run on the simulation's clock.
+    """
+    def __init__(self):
+        self.now = 0.0
+
+    def time(self):
+        return self.now
+
+
+class SimConfig:
+    """
+    The router entity attributes read by the engine, the defaults are those of the router schema.
+    """
+    def __init__(self, **kwds):
+        self.helloIntervalSeconds  = 1
+        self.helloMaxAgeSeconds    = 3
+        self.raIntervalSeconds     = 30
+        self.raIntervalFluxSeconds = 4
+        self.remoteLsMaxAgeSeconds = 60
+        for k, v in kwds.items():
+            setattr(self, k, v)
+
+
+class SimAgent:
+    def __init__(self, config):
+        self.config = config
+
+    def find_entity_by_type(self, entity_type):
+        return [self.config]
+
+    def add_implementation(self, implementation, entity_type_name):
+        pass
+
+    def remove_implementation(self, implementation):
+        pass
+
+
+class SimLink:
+    """
+    An inter-router connection, up until it is failed.  Each end has its own link id as a router numbers its
+    inter-router links independently.
+    """
+    def __init__(self, a, b, cost, latency, jitter, loss):
+        self.ends    = {a: None, b: None}
+        self.cost    = cost
+        self.latency = latency
+        self.jitter  = jitter
+        self.loss    = loss
+        self.up      = False
+
+    def other(self, router_id):
+        for end in self.ends:
+            if end != router_id:
+                return end
+
+
+class SimCore:
+    """
+    The router adapter the engine of one router programs its routes into, standing in for the router core.
+    """
+    def __init__(self, sim, router_id, config):
+        self.sim        = sim
+        self.id         = router_id
+        self.agent      = SimAgent(config)
+        self.by_maskbit = {}   # maskbit -> router id
+        self.by_id      = {}   # router id -> maskbit
+        self.links      = {}   # maskbit -> link id of a neighbor
+        self.next_hops  = {}   # maskbit -> maskbit of the next hop
+        self.costs      = {}   # maskbit -> cost
+        self.radius     = 0
+        self.mobile_seq = 0    # of the local address set
+        self.addresses  = 0    # local address count
+        self.remote_mobile_seqs = {}  # router id -> mobile sequence of the remote addresses in the table
+
+    def get_agent(self):
+        return self.agent
+
+    def __call__(self, addr, reachable, neighbor):
+        pass
+
+    def _changed(self):
+        self.sim.routes_changed()
+
+    def add_router(self, address, maskbit):
+        router_id = address.split('/')[-2]
+        self.by_maskbit[maskbit] = router_id
+        self.by_id[router_id]    = maskbit
+        self._changed()
+
+    def del_router(self, maskbit):
+        router_id = self.by_maskbit.pop(maskbit)
+        self.by_id.pop(router_id, None)
+        self.links.pop(maskbit, None)
+        self.next_hops.pop(maskbit, None)
+        self.costs.pop(maskbit, None)
+        self.remote_mobile_seqs.pop(router_id, None)
+        self._changed()
+
+    def set_link(self, maskbit, link_id):
+        self.links[maskbit] = link_id
+        self._changed()
+
+    def remove_link(self, maskbit):
+        self.links.pop(maskbit, None)
+        self._changed()
+
+    def set_next_hop(self, maskbit, next_hop_maskbit):
+        self.next_hops[maskbit] = next_hop_maskbit
+        self._changed()
+
+    def remove_next_hop(self, maskbit):
+        self.next_hops.pop(maskbit, None)
+        self._changed()
+
+    def set_valid_origins(self, maskbit, valid_origins):
+        pass
+
+    def set_cost(self, maskbit, cost):
+        self.costs[maskbit] = cost
+        self._changed()
+
+    def set_radius(self, radius):
+        self.radius = radius
+
+    def flush_destinations(self, maskbit):
+        self.remote_mobile_seqs.pop(self.by_maskbit.get(maskbit), None)
+        self._changed()
+
+    def mobile_seq_advanced(self, maskbit):
+        # mobile_sync asks the router for its full address set
+        router_id = self.by_maskbit.get(maskbit)
+        if router_id is not None:
+            self.sim.send(self.id, router_id, 'MAR', {'id': self.id})
+
+    # ----------------------------------------------------------------------------------------
+    # Forwarding and mobile_sync
+    # ----------------------------------------------------------------------------------------
+
+    def route(self, router_id):
+        """
+        Return the link id toward a router, None if it is not reachable.  A neighbor is reached over its link,
+        other routers over the link of their next hop.
+        """
+        maskbit = self.by_id.get(router_id)
+        if maskbit is None:
+            return None
+        if maskbit in self.links:
+            return self.links[maskbit]
+        next_hop = self.next_hops.get(maskbit)
+        return self.links.get(next_hop) if next_hop is not None else None
+
+    def reachable(self):
+        return [router_id for router_id in self.by_id if self.route(router_id) is not None]
+
+    def register_addresses(self, count):
+        self.addresses  += count
+        self.mobile_seq += 1
+        for router_id in self.reachable():
+            self.sim.send(self.id, router_id, 'MAU',
+                          {'id': self.id, 'mobile_seq': self.mobile_seq, 'added': count, 'exist': None})
+        self.sim.call(self.id, lambda engine: engine.setMyMobileSeq(self.mobile_seq))
+
+    def handle(self, opcode, body):
+        if opcode == 'MAR':
+            self.sim.send(self.id, body['id'], 'MAU', {'id': self.id, 'mobile_seq': self.mobile_seq,
+                                                       'added': None, 'exist': self.addresses})
+        elif opcode == 'MAU':
+            router_id = body['id']
+            maskbit   = self.by_id.get(router_id)
+            if maskbit is None:
+                return
+            have = self.remote_mobile_seqs.get(router_id, 0)
+            if body['exist'] is None and body['mobile_seq'] != have + 1:
+                # a differential update we are not in sequence for, ask for the full set
+                self.mobile_seq_advanced(maskbit)
+                return
+            self.remote_mobile_seqs[router_id] = body['mobile_seq']
+            self._changed()
+            self.sim.call(self.id, lambda engine: engine.setMobileSeq(maskbit, body['mobile_seq']))
+
+
+class SimEngine(RouterEngine):
+    """
+    Router engine whose control messages go over the simulated network.  Logs are discarded.
+    """
+    def __init__(self, sim, core, router_id, instance):
+        self.sim = sim
+        super(SimEngine, self).__init__(core, router_id, '0', MAX_ROUTERS)
+        self.instance = instance
+
+    def log(self, level, text):
+        pass
+
+    def log_hello(self, level, text):
+        pass
+
+    def log_ls(self, level, text):
+        pass
+
+    def send(self, dest, msg):
+        opcode = msg.get_opcode()
+        body   = msg.to_dict()
+        if dest == 'amqp:/_local/qdhello':
+            for link in self.sim.links_of(self.id):
+                self.sim.transmit(self.id, link, None, opcode, body)
+        elif dest == 'amqp:/_topo/0/all/qdrouter':
+            for router_id in self.sim.cores[self.id].reachable():
+                self.sim.send(self.id, router_id, opcode, body)
+        else:
+            self.sim.send(self.id, dest.split('/')[-2], opcode, body)
+
+
+class Simulation:
+    """
+    A network of simulated routers on a virtual clock.  The router engine modules are bound to the simulation's
+    clock until close() is called.
+    """
+    def __init__(self, seed=0, config=None):
+        self.random   = random.Random(seed)
+        self.clock    = SimClock()
+        self.config   = config or SimConfig()
+        self.events   = []
+        self.sequence = 0
+        self.links    = {}     # frozenset of the two router ids -> SimLink
+        self.up_links = {}     # router id -> {link id -> SimLink that is up}
+        self.routers  = set()  # configured routers, running or not
+        self.cores    = {}     # router id -> SimCore of the running routers
+        self.engines  = {}     # router id -> SimEngine of the running routers
+        self.instance = 1
+        self.changed  = True   # a route table or the topology changed since the last convergence check
+        self.last_change = 0.0
+        self._true_costs = {}  # cache of true_costs() until the topology changes
+        self.reset_stats()
+        self._saved_time = engine_module.time, node_module.time
+        engine_module.time = node_module.time = self.clock
+
+    def close(self):
+        engine_module.time, node_module.time = self._saved_time
+
+    def reset_stats(self):
+        self.messages = {}  # router id -> control messages transmitted, hop by hop
+        self.octets   = {}  # router id -> control octets transmitted
+        self.cpu      = {}  # router id -> CPU seconds in the engine
+        self.dropped  = 0
+
+    # ----------------------------------------------------------------------------------------
+    # Topology
+    # ----------------------------------------------------------------------------------------
+
+    def routes_changed(self):
+        self.changed     = True
+        self.last_change = self.clock.now
+
+    def _topology_changed(self):
+        self._true_costs = {}
+        self.routes_changed()
+
+    def add_router(self, router_id):
+        self.routers.add(router_id)
+        self.up_links[router_id] = {}
+
+    def add_link(self, a, b, cost=1, latency=0.001, jitter=0.0, loss=0.0):
+        link = SimLink(a, b, cost, latency, jitter, loss)
+        self.links[frozenset((a, b))] = link
+        return link
+
+    def links_of(self, router_id):
+        return list(self.up_links[router_id].values())
+
+    def start_router(self, router_id):
+        core = SimCore(self, router_id, self.config)
+        self.cores[router_id] = core
+        self.engines[router_id] = SimEngine(self, core, router_id, self.instance)
+        self.instance += 1
+        phase = self.random.random() * TICK_INTERVAL
+        engine = self.engines[router_id]
+        self.at(self.clock.now + phase, lambda: self._tick(router_id, engine))
+        for link in self.links.values():
+            if router_id in link.ends and link.other(router_id) in self.engines:
+                self.link_up(link)
+        self._topology_changed()
+
+    def stop_router(self, router_id):
+        for link in self.links_of(router_id):
+            self.link_down(link)
+        self.engines.pop(router_id)
+        self.cores.pop(router_id)
+        self._topology_changed()
+
+    def link_up(self, link):
+        link.up = True
+        for end in link.ends:
+            link_id = 0
+            while link_id in self.up_links[end]:
+                link_id += 1
+            link.ends[end] = link_id
+            self.up_links[end][link_id] = link
+        self._topology_changed()
+
+    def link_down(self, link):
+        link.up = False
+        for end, link_id in link.ends.items():
+            self.up_links[end].pop(link_id)
+            if end in self.engines:
+                self.call(end, lambda engine, link_id=link_id: engine.linkLost(link_id))
+        self._topology_changed()
+
+    # ----------------------------------------------------------------------------------------
+    # Events
+    # ----------------------------------------------------------------------------------------
+
+    def at(self, when, action):
+        heapq.heappush(self.events, (when, self.sequence, action))
+        self.sequence += 1
+
+    def call(self, router_id, action):
+        """
+        Run an action on the engine of a router and account the CPU time it takes to the router
+        """
+        engine = self.engines.get(router_id)
+        if engine is None:
+            return
+        start = time.thread_time()
+        action(engine)
+        self.cpu[router_id] = self.cpu.get(router_id, 0.0) + time.thread_time() - start
+
+    def _tick(self, router_id, engine):
+        if self.engines.get(router_id) is not engine:
+            return  # the router has been restarted
+        self.call(router_id, lambda engine: engine.handleTimerTick())
+        self.at(self.clock.now + TICK_INTERVAL, lambda: self._tick(router_id, engine))
+
+    def step(self):
+        when, _, action = heapq.heappop(self.events)
+        self.clock.now = when
+        action()
+
+    # ----------------------------------------------------------------------------------------
+    # Control messages
+    # ----------------------------------------------------------------------------------------
+
+    def send(self, source, dest, opcode, body):
+        """
+        Route a message from its source router toward the destination router
+        """
+        self._forward(source, dest, opcode, body)
+
+    def _forward(self, router_id, dest, opcode, body):
+        if router_id not in self.cores:
+            self.dropped += 1
+            return
+        link_id = self.cores[router_id].route(dest)
+        link    = self.up_links[router_id].get(link_id) if link_id is not None else None
+        if link is None:
+            self.dropped += 1
+            return
+        self.transmit(router_id, link, dest, opcode, body)
+
+    def transmit(self, router_id, link, dest, opcode, body):
+        """
+        Send a message over one link.  A message without a destination is for the router at the other end.
+        """
+        if opcode == 'MAU':
+            octets = len(opcode) + ADDRESS_OCTETS * ((body['added'] or 0) + (body['exist'] or 0))
+        else:
+            octets = len(opcode) + len(json.dumps(body, default=str))
+        self.messages[router_id] = self.messages.get(router_id, 0) + 1
+        self.octets[router_id]   = self.octets.get(router_id, 0) + octets
+        if self.random.random() < link.loss:
+            self.dropped += 1
+            return
+        delay = link.latency + self.random.random() * link.jitter
+        self.at(self.clock.now + delay, lambda: self._arrive(link, link.other(router_id), dest, opcode, body))
+
+    def _arrive(self, link, router_id, dest, opcode, body):
+        if not link.up or router_id not in self.engines:
+            self.dropped += 1
+            return
+        if dest is not None and dest != router_id:
+            self._forward(router_id, dest, opcode, body)
+            return
+        if opcode in ('MAR', 'MAU'):
+            self.cores[router_id].handle(opcode, body)
+            return
+        link_id = link.ends[router_id]
+        self.call(router_id, lambda engine: engine.handleControlMessage(opcode, body, link_id, link.cost))
+
+    # ----------------------------------------------------------------------------------------
+    # Convergence
+    # ----------------------------------------------------------------------------------------
+
+    def true_costs(self, source):
+        """
+        Costs of the least cost paths from a running router over the links that are up
+        """
+        if source in self._true_costs:
+            return self._true_costs[source]
+        costs = {source: 0}
+        heap  = [(0, source)]
+        while heap:
+            cost, u = heapq.heappop(heap)
+            if cost > costs[u]:
+                continue
+            for link in self.links_of(u):
+                v = link.other(u)
+                if v in self.engines and cost + link.cost < costs.get(v, cost + link.cost + 1):
+                    costs[v] = cost + link.cost
+                    heapq.heappush(heap, (costs[v], v))
+        costs.pop(source)
+        self._true_costs[source] = costs
+        return costs
+
+    def routes_converged(self):
+        """
+        True if every running router routes to every router it can reach, at the least cost
+        """
+        for router_id, core in self.cores.items():
+            expected = self.true_costs(router_id)
+            if set(core.reachable()) != set(expected):
+                return False
+            for dest, cost in expected.items():
+                if core.costs.get(core.by_id[dest]) != cost:
+                    return False
+        return True
+
+    def mobile_converged(self):
+        """
+        True if every running router has the current mobile sequence of every router it can reach
+        """
+        for router_id, core in self.cores.items():
+            for dest in self.true_costs(router_id):
+                if core.remote_mobile_seqs.get(dest, 0) != self.cores[dest].mobile_seq:
+                    return False
+        return True
+
+    def stale_routes(self):
+        """
+        The number of routes held to routers that cannot be reached
+        """
+        count = 0
+        for router_id, core in self.cores.items():
+            count += len(set(core.reachable()) - set(self.true_costs(router_id)))
+        return count
+
+    def run_until(self, converged, timeout, settle=5.0):
+        """
+        Run until the converged predicate has held for the settle time.  Return the simulated time from the
+        start of the run until it last became true, or None if that did not happen within the timeout.
+
+        The predicate is evaluated at most every CHECK_INTERVAL of simulated time, as of the last change to a
+        route table or the topology.
+        """
+        start = self.clock.now
+        since = None
+        check = start
+        while self.events and self.clock.now - start < timeout:
+            self.step()
+            if self.changed and self.clock.now >= check:
+                self.changed = False
+                check = self.clock.now + CHECK_INTERVAL
+                if converged():
+                    if since is None:
+                        since = self.last_change
+                else:
+                    since = None
+            if since is not None and self.clock.now - since >= settle:
+                return since - start
+        return None
+
+    def measure(self, name, converged, timeout, settle=5.0):
+        self.reset_stats()
+        self.routes_changed()
+        seconds = self.run_until(converged, timeout, settle)
+        running = list(self.engines)
+        octets  = [self.octets.get(r, 0) for r in running]
+        cpu     = [self.cpu.get(r, 0.0) for r in running]
+        return {
+            'scenario'           : name,
+            'routers'            : len(running),
+            'converged'          : seconds is not None,
+            'convergence_seconds': seconds,
+            'control_messages'   : sum(self.messages.values()),
+            'control_octets'     : sum(octets),
+            'octets_per_router'  : {'mean': sum(octets) / len(running), 'max': max(octets)},
+            'cpu_seconds_per_router': {'mean': sum(cpu) / len(running), 'max': max(cpu)},
+            'dropped'            : self.dropped,
+            'stale_routes'       : self.stale_routes(),
+        }
+
+
+# ========================================================================================
+# Topologies
+# ========================================================================================
+
+def build_network(sim, routers, topology='random', degree=4, **link_args):
+    """
+    Add routers R0..Rn-1 connected in a ring, a full mesh, a square grid, or a ring with random chords up to the
+    given mean degree
+    """
+    ids = ['R%d' % i for i in range(routers)]
+    for router_id in ids:
+        sim.add_router(router_id)
+
+    pairs = set()
+    if topology == 'full':
+        pairs = {(a, b) for i, a in enumerate(ids) for b in ids[i + 1:]}
+    elif topology == 'grid':
+        width = max(1, int(routers ** 0.5))
+        for i in range(routers):
+            if (i + 1) % width and i + 1 < routers:
+                pairs.add((ids[i], ids[i + 1]))
+            if i + width < routers:
+                pairs.add((ids[i], ids[i + width]))
+    else:
+        pairs = {(ids[i], ids[(i + 1) % routers]) for i in range(routers) if routers > 1}
+        if topology == 'random':
+            while len(pairs) < routers * degree // 2 and len(pairs) < routers * (routers - 1) // 2:
+                a, b = sim.random.sample(ids, 2)
+                if (b, a) not in pairs:
+                    pairs.add((a, b))
+    for a, b in sorted(pairs):
+        sim.add_link(a, b, **link_args)
+    return ids
+
+
+# ========================================================================================
+# Scenarios
+# ========================================================================================
+
+def scenario_startup(sim, ids, timeout):
+    for router_id in ids:
+        sim.start_router(router_id)
+    return sim.measure('startup', sim.routes_converged, timeout)
+
+
+def scenario_link_failure(sim, ids, timeout):
+    link = sim.random.choice([link for link in sim.links.values() if link.up])
+    sim.link_down(link)
+    return sim.measure('link-failure', sim.routes_converged, timeout)
+
+
+def scenario_router_restart(sim, ids, timeout, downtime=1.0):
+    router_id = sim.random.choice(ids)
+    addresses = sim.cores[router_id].addresses
+    sim.stop_router(router_id)
+
+    def restart():
+        sim.start_router(router_id)
+        if addresses:
+            sim.cores[router_id].register_addresses(addresses)
+    sim.at(sim.clock.now + downtime, restart)
+    return sim.measure('router-restart',
+                       lambda: router_id in sim.engines and sim.routes_converged() and sim.mobile_converged(),
+                       timeout)
+
+
+def scenario_address_registration(sim, ids, timeout, addresses=1000):
+    for router_id in ids:
+        sim.at(sim.clock.now + sim.random.random(),
+               lambda router_id=router_id: sim.cores[router_id].register_addresses(addresses))
+    return sim.measure('address-registration', sim.mobile_converged, timeout)
+
+
+SCENARIOS = ['startup', 'link-failure', 'router-restart', 'address-registration']
+
+
+def run(routers, topology='random', degree=4, latency=0.001, jitter=0.0, loss=0.0, seed=0, timeout=300.0,
+        scenarios=SCENARIOS, addresses=1000):
+    """
+    Start the network and run the scenarios one after the other, each after the previous has converged.  Return
+    the list of scenario results.
+    """
+    sim = Simulation(seed)
+    try:
+        ids = build_network(sim, routers, topology, degree, latency=latency, jitter=jitter, loss=loss)
+        results = [scenario_startup(sim, ids, timeout)]
+        for name in scenarios:
+            if name == 'link-failure':
+                results.append(scenario_link_failure(sim, ids, timeout))
+            elif name == 'router-restart':
+                results.append(scenario_router_restart(sim, ids, timeout))
+            elif name == 'address-registration':
+                results.append(scenario_address_registration(sim, ids, timeout, addresses))
+        return results
+    finally:
+        sim.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the routing convergence of a network of routers")
+    parser.add_argument('--routers', type=int, default=100)
+    parser.add_argument('--topology', choices=['random', 'ring', 'grid', 'full'], default='random')
+    parser.add_argument('--degree', type=int, default=4, help="mean number of links per router of the random topology")
+    parser.add_argument('--latency', type=float, default=0.001, help="link latency in seconds")
+    parser.add_argument('--jitter', type=float, default=0.0, help="maximum extra random latency in seconds")
+    parser.add_argument('--loss', type=float, default=0.0, help="fraction of the messages a link drops")
+    parser.add_argument('--addresses', type=int, default=1000, help="addresses each router registers")
+    parser.add_argument('--scenario', action='append', choices=SCENARIOS[1:],
+                        help="scenario to run after startup, may be repeated, default all")
+    parser.add_argument('--timeout', type=float, default=300.0, help="simulated seconds to wait for convergence")
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+
+    results = run(args.routers, args.topology, args.degree, args.latency, args.jitter, args.loss, args.seed,
+                  args.timeout, args.scenario or SCENARIOS[1:], args.addresses)
+    print(json.dumps(results, indent=2))
+    return 0 if all(r['converged'] for r in results) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
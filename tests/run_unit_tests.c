@@ -25,6 +25,9 @@
 int tool_tests(void);
 int timer_tests(void);
 int core_timer_tests(void);
+int core_action_tests(qdr_core_t *core);
+int delivery_ring_tests(void);
+int delivery_state_tests(void);
 int alloc_tests(void);
 int compose_tests(void);
 int policy_tests(void);
@@ -33,9 +36,14 @@ int parse_tree_tests(void);
 int proton_utils_tests(void);
 int version_tests(void);
 int hash_tests(void);
+int flight_recorder_tests(void);
+int metrics_tests(void);
+int sharded_counter_tests(void);
+int intern_tests(void);
 int thread_tests(void);
 int platform_tests(void);
 int http2_decoder_tests(void);
+int heavy_hitters_tests(void);
 
 
 int main(int argc, char** argv)
@@ -69,10 +77,18 @@ int main(int argc, char** argv)
     result += parse_tree_tests();
     result += proton_utils_tests();
     result += core_timer_tests();
+    result += core_action_tests(qd_router_core(qd));
+    result += delivery_ring_tests();
+    result += delivery_state_tests();
     result += hash_tests();
+    result += flight_recorder_tests();
+    result += metrics_tests();
+    result += sharded_counter_tests();
+    result += intern_tests();
     result += thread_tests();
     result += platform_tests();
     result += http2_decoder_tests();
+    result += heavy_hitters_tests();
 
     qd_dispatch_free(qd);       // dispatch_free last.
 
@@ -0,0 +1,100 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Unit test for the sharded counters
+ */
+
+#include "qpid/dispatch/sharded_counter.h"
+#include "qpid/dispatch/threading.h"
+
+#include "test_case.h"
+
+#include <string.h>
+
+#define THREADS   (QD_SHARDED_COUNTER_SHARDS + 3)
+#define INCREMENTS 10000
+
+static qd_sharded_counter_t counter;
+
+
+static void *count_thread(void *arg)
+{
+    for (int i = 0; i < INCREMENTS; ++i)
+        qd_sharded_counter_add(&counter, 3);
+    // down by one per increment: a net of two per increment is left
+    for (int i = 0; i < INCREMENTS; ++i)
+        qd_sharded_counter_sub(&counter, 1);
+    return 0;
+}
+
+
+// More threads than shards count concurrently, the sum is exact once they are done
+//
+static char *test_concurrent_counting(void *context)
+{
+    sys_thread_t *threads[THREADS];
+
+    memset(&counter, 0, sizeof(counter));
+    for (int i = 0; i < THREADS; ++i)
+        threads[i] = sys_thread(SYS_THREAD_PROACTOR, count_thread, 0);
+    for (int i = 0; i < THREADS; ++i) {
+        sys_thread_join(threads[i]);
+        sys_thread_free(threads[i]);
+    }
+
+    if (qd_sharded_counter_value(&counter) != (uint64_t) THREADS * INCREMENTS * 2)
+        return "Wrong sum of the shards";
+    return 0;
+}
+
+
+// A counter taken down on another thread than the one that counted up sums to zero
+//
+static void *sub_thread(void *arg)
+{
+    qd_sharded_counter_sub(&counter, 5);
+    return 0;
+}
+
+static char *test_cross_thread_decrement(void *context)
+{
+    memset(&counter, 0, sizeof(counter));
+    qd_sharded_counter_add(&counter, 5);
+
+    sys_thread_t *thread = sys_thread(SYS_THREAD_PROACTOR, sub_thread, 0);
+    sys_thread_join(thread);
+    sys_thread_free(thread);
+
+    if (qd_sharded_counter_value(&counter) != 0)
+        return "Counter not back to zero";
+    return 0;
+}
+
+
+int sharded_counter_tests(void)
+{
+    int result = 0;
+    char *test_group = "sharded_counter_tests";
+
+    TEST_CASE(test_concurrent_counting, 0);
+    TEST_CASE(test_cross_thread_decrement, 0);
+
+    return result;
+}
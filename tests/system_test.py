@@ -1935,6 +1935,12 @@ class SkManager:
             cmd += " limit=%s" % limit
         return json.loads(self(cmd))
 
+    def get_flight_recorder(self, limit=None):
+        cmd = 'GET-FLIGHT-RECORDER'
+        if limit:
+            cmd += " limit=%s" % limit
+        return json.loads(self(cmd))
+
     def delete_all_entities(self, long_entity_type):
         # First, query the router to get all entities of entity type
         results = self.query(long_entity_type)
@@ -17,11 +17,12 @@
 # under the License.
 #
 import json
+import socket
 from subprocess import PIPE, STDOUT
 from threading import Timer
 
 from system_test import TestCase, Process, Qdrouterd, TIMEOUT
-from system_test import AMQP_CONNECTOR_TYPE
+from system_test import AMQP_CONNECTOR_TYPE, retry_assertion
 
 
 class ConnectorStatusTest(TestCase):
@@ -121,6 +122,7 @@ class ConnectorStatusTest(TestCase):
         output = json.loads(self.run_skmanage(query_command))
         connection_msg = output[0]['connectionMsg']
         self.assertEqual('SUCCESS', output[0]['connectionStatus'])
+        self.assertGreaterEqual(output[0]['lastConnectMilliseconds'], 0)
         conn_opened = False
         if "Connection Opened: dir=out" in connection_msg:
             conn_opened = True
@@ -144,3 +146,38 @@ class ConnectorStatusTest(TestCase):
         # SUCCESS. There is no good way to test if the connection status ever
         # reaches the FAILED state because the router immediately tries to
         # re-connect thus setting the status to CONNECTING in the process.
+
+
+class ConnectorHandshakeTimeoutTest(TestCase):
+    """
+    A connector whose peer accepts the TCP connection but never sends an AMQP OPEN gives up on the attempt after
+    initialHandshakeTimeoutSeconds, rather than waiting on the peer forever.
+    """
+
+    @classmethod
+    def setUpClass(cls):
+        super(ConnectorHandshakeTimeoutTest, cls).setUpClass()
+        # The kernel completes the TCP handshake for the backlog, nobody ever reads
+        cls.silent = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        cls.silent.bind(('127.0.0.1', 0))
+        cls.silent.listen(16)
+
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'interior', 'id': 'QDR.Timeout'}),
+            ('listener', {'port': cls.tester.get_port()}),
+            ('connector', {'name': 'silentPeer', 'role': 'inter-router', 'host': '127.0.0.1',
+                           'port': cls.silent.getsockname()[1], 'initialHandshakeTimeoutSeconds': 1}),
+        ])
+        cls.router = cls.tester.qdrouterd('QDR.Timeout', config)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.silent.close()
+        super(ConnectorHandshakeTimeoutTest, cls).tearDownClass()
+
+    def test_handshake_timeout(self):
+        def timed_out():
+            connector = self.router.sk_manager.query(AMQP_CONNECTOR_TYPE)[0]
+            self.assertIn("Timeout waiting for initial handshake", connector['connectionMsg'])
+            self.assertEqual(0, connector['lastConnectMilliseconds'])
+        retry_assertion(timed_out)
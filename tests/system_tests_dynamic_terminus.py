@@ -22,7 +22,7 @@ from proton.handlers import MessagingHandler
 from proton.reactor import Container, LinkOption
 
 from system_test import unittest
-from system_test import TestCase, Qdrouterd, main_module, TIMEOUT, TestTimeout
+from system_test import TestCase, Qdrouterd, main_module, TIMEOUT, TestTimeout, ROUTER_ADDRESS_TYPE
 
 
 class RouterTest(TestCase):
@@ -234,5 +234,147 @@ class DynamicTargetTest(MessagingHandler):
         container.run()
 
 
+class DynamicAddressPoolTest(TestCase):
+    """
+    An edge router that keeps detached dynamic addresses for reuse by their connection
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(DynamicAddressPoolTest, cls).setUpClass()
+        edge_port = cls.tester.get_port()
+        cls.interior = cls.tester.qdrouterd('INT.POOL', Qdrouterd.Config([
+            ('router', {'mode': 'interior', 'id': 'INT.POOL'}),
+            ('listener', {'port': cls.tester.get_port()}),
+            ('listener', {'role': 'edge', 'port': edge_port}),
+        ]), wait=True)
+        cls.edge = cls.tester.qdrouterd('EDGE.POOL', Qdrouterd.Config([
+            ('router', {'mode': 'edge', 'id': 'EDGE.POOL', 'dynamicAddressPoolSize': 4}),
+            ('listener', {'port': cls.tester.get_port()}),
+            ('connector', {'role': 'edge', 'port': edge_port}),
+        ]), wait=True)
+        cls.edge.wait_connectors()
+
+    def test_01_reply_to_reused(self):
+        test = DynamicSourceReuseTest(self.edge.addresses[0], self.interior.addresses[0])
+        test.run()
+        self.assertIsNone(test.error)
+        self.assertEqual(1, len(set(test.addresses)), test.addresses)
+
+    def test_02_sender_outlives_owner(self):
+        test = DynamicAddressOutlivesOwnerTest(self.edge.addresses[0])
+        test.run()
+        self.assertIsNone(test.error)
+        # the router must still be serving after the address left the closed connection
+        self.edge.management.query(type=ROUTER_ADDRESS_TYPE)
+
+
+class DynamicSourceReuseTest(MessagingHandler):
+    """
+    Attach a dynamic receiver once per request on the same connection, the way request/reply clients
+    do, and check that each reply arrives
+    """
+    def __init__(self, receiver_host, sender_host):
+        super(DynamicSourceReuseTest, self).__init__()
+        self.receiver_host = receiver_host
+        self.sender_host   = sender_host
+
+        self.error         = None
+        self.receiver_conn = None
+        self.sender_conn   = None
+        self.sender        = None
+        self.receiver      = None
+        self.timer         = None
+        self.addresses     = []
+        self.count         = 5
+
+    def timeout(self):
+        self.error = "Timeout Expired: replies received to %s" % self.addresses
+        self.sender_conn.close()
+        self.receiver_conn.close()
+
+    def on_start(self, event):
+        self.timer = event.reactor.schedule(TIMEOUT, TestTimeout(self))
+        self.receiver_conn = event.container.connect(self.receiver_host)
+        self.sender_conn   = event.container.connect(self.sender_host)
+        self.sender        = event.container.create_sender(self.sender_conn)
+        self.receiver      = event.container.create_receiver(self.receiver_conn, dynamic=True)
+
+    def on_link_opened(self, event):
+        if event.receiver == self.receiver:
+            self.addresses.append(self.receiver.remote_source.address)
+            self.sender.send(Message(address=self.addresses[-1], body="reply %d" % len(self.addresses)))
+
+    def on_message(self, event):
+        if event.receiver == self.receiver:
+            self.receiver.close()
+
+    def on_link_closed(self, event):
+        if event.receiver == self.receiver:
+            if len(self.addresses) == self.count:
+                self.sender_conn.close()
+                self.receiver_conn.close()
+                self.timer.cancel()
+            else:
+                self.receiver = event.container.create_receiver(self.receiver_conn, dynamic=True)
+
+    def run(self):
+        Container(self).run()
+
+
+class DynamicAddressOutlivesOwnerTest(MessagingHandler):
+    """
+    A sender on a second connection to a dynamic address that stays attached after the
+    connection owning the address has closed, then detaches
+    """
+    def __init__(self, host):
+        super(DynamicAddressOutlivesOwnerTest, self).__init__()
+        self.host       = host
+        self.error      = None
+        self.owner_conn = None
+        self.other_conn = None
+        self.probe_conn = None
+        self.receiver   = None
+        self.sender     = None
+        self.probe      = None
+        self.timer      = None
+
+    def timeout(self):
+        self.error = "Timeout Expired"
+        for conn in [self.owner_conn, self.other_conn, self.probe_conn]:
+            if conn:
+                conn.close()
+
+    def on_start(self, event):
+        self.timer      = event.reactor.schedule(TIMEOUT, TestTimeout(self))
+        self.owner_conn = event.container.connect(self.host)
+        self.receiver   = event.container.create_receiver(self.owner_conn, dynamic=True)
+
+    def on_link_opened(self, event):
+        if event.receiver == self.receiver:
+            self.other_conn = event.container.connect(self.host)
+            self.sender     = event.container.create_sender(self.other_conn, self.receiver.remote_source.address)
+        elif event.sender == self.sender:
+            # the address is still in use, it is not pooled when the receiver detaches
+            self.receiver.close()
+        elif event.receiver == self.probe:
+            self.probe_conn.close()
+            self.timer.cancel()
+
+    def on_link_closed(self, event):
+        if event.receiver == self.receiver:
+            self.owner_conn.close()
+        elif event.sender == self.sender:
+            self.other_conn.close()
+            self.probe_conn = event.container.connect(self.host)
+            self.probe      = event.container.create_receiver(self.probe_conn, dynamic=True)
+
+    def on_connection_closed(self, event):
+        if event.connection == self.owner_conn:
+            self.sender.close()
+
+    def run(self):
+        Container(self).run()
+
+
 if __name__ == '__main__':
     unittest.main(main_module())
@@ -17,7 +17,7 @@
 # under the License.
 #
 
-from system_test import TestCase, Qdrouterd, main_module, unittest
+from system_test import TestCase, Qdrouterd, main_module, unittest, AsyncTestReceiver, AsyncTestSender
 from message_tests import DynamicAddressTest, MobileAddressAnonymousTest, MobileAddressTest
 from message_tests import MobileAddressOneSenderTwoReceiversTest, MobileAddressMulticastTest
 
@@ -194,6 +194,7 @@ class ConnectedMeshTest(TestCase):
             config = [
                 ('router', {'mode': mode, 'id': name}),
                 ('address', {'prefix': 'mc', 'distribution': 'multicast'}),
+                ('address', {'prefix': 'closest', 'distribution': 'closest'}),
                 ('listener', {'port': cls.tester.get_port()})
             ]
 
@@ -485,6 +486,21 @@ class ConnectedMeshTest(TestCase):
         test.run()
         self.assertIsNone(test.error)
 
+    def test_41_closest_prefers_mesh_peer_to_interior(self):
+        # EB reaches the receiver on EA directly over the inter-edge connection and the one on IX over its uplink
+        address = 'closest.test_41'
+        peer_rx = AsyncTestReceiver(self.routers[0].addresses[0], address)
+        interior_rx = AsyncTestReceiver(self.routers[3].addresses[0], address)
+        self.routers[1].wait_address(address, subscribers=2)
+
+        tx = AsyncTestSender(self.routers[1].addresses[0], address, count=20)
+        tx.wait()
+        for _ in range(20):
+            peer_rx.queue.get()
+        self.assertTrue(interior_rx.queue.empty(), "a delivery went up to the interior instead of to the mesh peer")
+        peer_rx.stop()
+        interior_rx.stop()
+
 
 if __name__ == '__main__':
     unittest.main(main_module())
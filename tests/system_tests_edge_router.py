@@ -27,7 +27,7 @@ from skupper_router.management.error import ForbiddenStatus
 
 from system_test import TestCase, Qdrouterd, main_module, TIMEOUT, MgmtMsgProxy, TestTimeout
 from system_test import unittest
-from system_test import CONNECTION_TYPE, ROUTER_ADDRESS_TYPE
+from system_test import CONNECTION_TYPE, ROUTER_ADDRESS_TYPE, ROUTER_LINK_TYPE, retry
 
 from message_tests import DynamicAddressTest, MobileAddressTest
 from message_tests import MobileAddressOneSenderTwoReceiversTest, MobileAddressMulticastTest
@@ -889,5 +889,112 @@ class EdgeListenerSender(TestCase):
         self.assertTrue(blocking_sender is not None)
 
 
+class EdgeUplinksTest(TestCase):
+    """
+    An edge router with edgeUplinks 2 connected to two interior routers uses both edge connections at once
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(EdgeUplinksTest, cls).setUpClass()
+
+        def router(name, mode, extra):
+            config = [
+                ('router', {'mode': mode, 'id': name, 'edgeUplinks': 2}),
+                ('listener', {'port': cls.tester.get_port(), 'stripAnnotations': 'no'}),
+                ('address', {'prefix': 'closest', 'distribution': 'closest'}),
+                ('address', {'prefix': 'spread', 'distribution': 'balanced'}),
+                ('address', {'prefix': 'multicast', 'distribution': 'multicast'})
+            ] + extra
+            return cls.tester.qdrouterd(name, Qdrouterd.Config(config), wait=True)
+
+        inter_router_port = cls.tester.get_port()
+        edge_port_A       = cls.tester.get_port()
+        edge_port_B       = cls.tester.get_port()
+
+        cls.int_a = router('INT.A', 'interior', [('listener', {'role': 'inter-router', 'port': inter_router_port}),
+                                                 ('listener', {'role': 'edge', 'port': edge_port_A})])
+        cls.int_b = router('INT.B', 'interior', [('connector', {'role': 'inter-router', 'port': inter_router_port}),
+                                                 ('listener', {'role': 'edge', 'port': edge_port_B})])
+        cls.edge = router('EA1', 'edge', [('connector', {'name': 'uplinkA', 'role': 'edge', 'port': edge_port_A}),
+                                          ('connector', {'name': 'uplinkB', 'role': 'edge', 'port': edge_port_B})])
+        cls.int_a.wait_router_connected('INT.B')
+        cls.int_b.wait_router_connected('INT.A')
+        cls.edge.wait_connectors()
+
+    def edge_connections(self):
+        return [c for c in self.edge.management.query(type=CONNECTION_TYPE).get_dicts() if c['role'] == 'edge']
+
+    def wait_proxied_on_both(self, address):
+        """
+        Wait until the edge has a proxy sender bound to the address on each uplink
+        """
+        def bound():
+            edge_conns = [c['identity'] for c in self.edge_connections()]
+            links = [l for l in self.edge.management.query(type=ROUTER_LINK_TYPE).get_dicts()
+                     if l['linkDir'] == 'out' and l['owningAddr'] and l['owningAddr'].endswith(address)
+                     and l['connectionId'] in edge_conns]
+            return len(set(l['connectionId'] for l in links)) == 2
+        self.assertTrue(retry(bound), "%s not proxied over both uplinks" % address)
+
+    def test_01_both_uplinks_active(self):
+        self.assertTrue(retry(lambda: len(self.edge_connections()) == 2
+                              and all(c['active'] for c in self.edge_connections())))
+
+    def test_02_anycast_shared_among_uplinks(self):
+        address = 'closest.uplinks'
+        conn_a = BlockingConnection(self.int_a.addresses[0])
+        conn_b = BlockingConnection(self.int_b.addresses[0])
+        rx_a = conn_a.create_receiver(address)
+        rx_b = conn_b.create_receiver(address)
+        self.wait_proxied_on_both(address)
+
+        sender_conn = BlockingConnection(self.edge.addresses[0])
+        sender = sender_conn.create_sender(address)
+        count = 20
+        for i in range(count):
+            sender.send(Message(body="uplinks %d" % i))
+
+        received = {'A': 0, 'B': 0}
+        for name, rx in (('A', rx_a), ('B', rx_b)):
+            while True:
+                try:
+                    rx.receive(timeout=1)
+                    rx.accept()
+                    received[name] += 1
+                except Exception:
+                    break
+        self.assertEqual(count, received['A'] + received['B'])
+        self.assertGreater(received['A'], 0)
+        self.assertGreater(received['B'], 0)
+        sender_conn.close()
+        conn_a.close()
+        conn_b.close()
+
+    def test_03_multicast_not_duplicated(self):
+        address = 'multicast.uplinks'
+        conn_a = BlockingConnection(self.int_a.addresses[0])
+        rx = conn_a.create_receiver(address)
+        self.int_b.wait_address(address, remotes=1)
+
+        sender_conn = BlockingConnection(self.edge.addresses[0])
+        sender = sender_conn.create_sender(address)
+        self.assertTrue(retry(lambda: sender.credit > 0))
+        count = 10
+        for i in range(count):
+            sender.send(Message(body="multicast %d" % i))
+
+        received = 0
+        while True:
+            try:
+                rx.receive(timeout=1)
+                rx.accept()
+                received += 1
+            except Exception:
+                break
+        self.assertEqual(count, received)
+        sender_conn.close()
+        conn_a.close()
+
+
 if __name__ == '__main__':
     unittest.main(main_module())
@@ -25,9 +25,9 @@ import ssl
 from urllib.request import urlopen, build_opener, HTTPSHandler
 from urllib.error import HTTPError, URLError
 from skupper_router._skupper_router_site import SKIP_DELETE_HTTP_LISTENER
-from system_test import Process, SkManager, retry
+from system_test import Process, SkManager, retry, AsyncTestReceiver, AsyncTestSender
 from system_test import TestCase, Qdrouterd, main_module
-from system_test import unittest, AMQP_LISTENER_TYPE, ALLOCATOR_TYPE
+from system_test import unittest, AMQP_LISTENER_TYPE, ALLOCATOR_TYPE, ROUTER_ADDRESS_TYPE, TIMEOUT
 from system_test import CA_CERT, CLIENT_CERTIFICATE, CLIENT_PRIVATE_KEY, CLIENT_PRIVATE_KEY_PASSWORD, \
     SERVER_CERTIFICATE, SERVER_PRIVATE_KEY_PASSWORD, SERVER_PRIVATE_KEY
 #
@@ -36,6 +36,40 @@ from system_test import CA_CERT, CLIENT_CERTIFICATE, CLIENT_PRIVATE_KEY, CLIENT_
 #
 
 
+def _decode_stats_snapshot(data):
+    """Decode a statistics snapshot, see docs/notes/stats-snapshot.md. Return (entity, columns, rows) where each row
+    is a dict keyed by column name"""
+    if data[:4] != b"QDSS" or data[4] != 1:
+        raise ValueError("not a version 1 statistics snapshot")
+    entity = data[5]
+    offset = 6
+
+    def varint():
+        nonlocal offset
+        value, shift = 0, 0
+        while True:
+            octet = data[offset]
+            offset += 1
+            value |= (octet & 0x7f) << shift
+            shift += 7
+            if octet < 0x80:
+                return value
+
+    varint()  # uptime
+    column_count = varint()
+    row_count = varint()
+    columns = []
+    for _ in range(column_count):
+        length = data[offset]
+        columns.append(data[offset + 1:offset + 1 + length].decode())
+        offset += 1 + length
+    values = [[varint() for _ in range(row_count)] for _ in range(column_count)]
+    if offset != len(data):
+        raise ValueError("trailing octets in statistics snapshot")
+    rows = [{columns[col]: values[col][row] for col in range(column_count)} for row in range(row_count)]
+    return entity, columns, rows
+
+
 class RouterTestHttp(TestCase):
 
     @classmethod
@@ -221,6 +255,29 @@ class RouterTestHttp(TestCase):
                       "qdr_deliveries_delayed_10sec_total",
                       "qdr_deliveries_stuck_total",
                       "qdr_links_blocked_total",
+                      "qdr_core_action_batches_total",
+                      "qdr_core_action_depth_max",
+                      "qdr_core_action_duration_microseconds_bucket",
+                      "qdr_core_action_duration_microseconds_count",
+                      "qdr_core_action_duration_max_microseconds",
+                      "qdr_core_action_queue_delay_microseconds_total",
+                      "qdr_core_action_queue_delay_max_microseconds",
+                      "qdr_core_foreground_wait_microseconds_total",
+                      "qdr_core_foreground_wait_max_microseconds",
+                      "qdr_core_background_actions_total",
+                      "qdr_core_background_wait_microseconds_total",
+                      "qdr_core_background_wait_max_microseconds",
+                      "qdr_core_control_actions_total",
+                      "qdr_core_control_wait_microseconds_total",
+                      "qdr_core_control_wait_max_microseconds",
+                      "qdr_core_action_latency_microseconds_bucket",
+                      "qdr_core_action_latency_microseconds_count",
+                      "qdr_tcp_flow_connect_microseconds_count",
+                      "qdr_python_gil_wait_microseconds_count",
+                      "qdr_python_gil_hold_microseconds_count",
+                      "qdr_priority_lane_deliveries_total",
+                      "qdr_priority_lane_delay_microseconds_total",
+                      "qdr_priority_lane_delay_max_microseconds",
                       "qdr_tcp_service_connections",
                       "qdr_amqp_service_connections",
                       "qdr_http1_service_connections",
@@ -245,8 +302,8 @@ class RouterTestHttp(TestCase):
             # Verify that all metric names are valid prometheus names that
             # must match the regex [a-zA-Z_:][a-zA-Z0-9_:]*
             for metric in metrics:
-                # remove trailing counter
-                mname = metric.strip().split()[0]
+                # remove trailing counter and labels (if present)
+                mname = metric.strip().split()[0].split('{')[0]
                 match = re.fullmatch(r'([a-zA-Z_:])([a-zA-Z0-9_:])*', mname)
                 self.assertIsNotNone(match, f"Metric {mname} has invalid name syntax")
 
@@ -254,9 +311,9 @@ class RouterTestHttp(TestCase):
             for name in stat_names:
                 found = False
                 for metric in metrics:
-                    # remove the counter and strip the allocator name suffix
-                    # (if present)
-                    mname = metric.strip().split()[0].split(':')[0]
+                    # remove the counter and strip the labels and allocator
+                    # name suffix (if present)
+                    mname = metric.strip().split()[0].split('{')[0].split(':')[0]
                     if mname == name:
                         found = True
                         break
@@ -286,6 +343,73 @@ class RouterTestHttp(TestCase):
             if t.ex:
                 raise t.ex
 
+    def test_http_stats_snapshot(self):
+        """ Verify the binary statistics snapshot of connections and links """
+        amqp_port = self.get_port()
+        http_port = self.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'id': 'QDR.SNAPSHOT'}),
+            ('listener', {'role': 'normal', 'port': amqp_port}),
+            ('listener', {'port': http_port, 'http': 'yes'}),
+        ])
+        r = self.qdrouterd('snapshot-test-router', config)
+        r.wait_ready()
+
+        def get_snapshot(url):
+            resp = urlopen(url)
+            self.assertEqual(200, resp.getcode())
+            self.assertEqual("application/octet-stream", resp.headers["content-type"])
+            return _decode_stats_snapshot(resp.read())
+
+        # hold a connection with a link open while the snapshots are taken
+        rx = AsyncTestReceiver(r.addresses[0], "snapshot/test")
+        try:
+            entity, columns, rows = get_snapshot(f"http://localhost:{http_port}/stats/connections")
+            self.assertEqual(1, entity)
+            self.assertIn("identity", columns)
+            self.assertIn("cpuMicroseconds", columns)
+            self.assertGreaterEqual(len(rows), 1)
+
+            entity, columns, rows = get_snapshot(f"http://localhost:{http_port}/stats/links")
+            self.assertEqual(2, entity)
+            self.assertIn("deliveryCount", columns)
+            self.assertGreaterEqual(len(rows), 1)
+            conn_ids = [row["connectionId"] for row in rows]
+            self.assertTrue(all(conn_id > 0 for conn_id in conn_ids))
+
+            with self.assertRaises(HTTPError) as error:
+                urlopen(f"http://localhost:{http_port}/stats/nosuch")
+            self.assertEqual(404, error.exception.code)
+        finally:
+            rx.stop()
+
+    def test_http_published_stats(self):
+        """ Verify the metrics and snapshots served from the statistics the core publishes """
+        amqp_port = self.get_port()
+        http_port = self.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'id': 'QDR.PUBLISHED', 'statsPublishSeconds': 1}),
+            ('listener', {'role': 'normal', 'port': amqp_port}),
+            ('listener', {'port': http_port, 'http': 'yes'}),
+        ])
+        r = self.qdrouterd('published-stats-router', config)
+        r.wait_ready()
+
+        # a connection opened after start up shows once the core has published again
+        rx = AsyncTestReceiver(r.addresses[0], "published/test")
+        try:
+            def link_published():
+                _, _, rows = _decode_stats_snapshot(urlopen(f"http://localhost:{http_port}/stats/links").read())
+                return len(rows) >= 1
+            self.assertTrue(retry(link_published))
+
+            metrics = self.get(f"http://localhost:{http_port}/metrics", use_ca=False)
+            connections = re.search(r"^qdr_connections_total (\d+)", metrics, re.MULTILINE)
+            self.assertIsNotNone(connections, metrics)
+            self.assertGreaterEqual(int(connections.group(1)), 1)
+        finally:
+            rx.stop()
+
     def test_http_healthz(self):
         config = Qdrouterd.Config([
             ('router', {'id': 'QDR.HEALTHZ'}),
@@ -323,6 +447,75 @@ class RouterTestHttp(TestCase):
             if t.ex:
                 raise t.ex
 
+    def test_http_address_latency(self):
+        """ Verify the forwarding latency histograms of a latency-tracked address """
+        http_port = self.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'id': 'QDR.LATENCY'}),
+            ('listener', {'role': 'normal', 'port': self.get_port()}),
+            ('listener', {'port': http_port, 'http': 'yes'}),
+            ('address', {'prefix': 'tracked', 'distribution': 'balanced', 'latencyTracking': 'yes'}),
+        ])
+        r = self.qdrouterd('latency-test-router', config)
+        r.wait_ready()
+
+        rx = AsyncTestReceiver(r.addresses[0], 'tracked/latency')
+        tx = AsyncTestSender(r.addresses[0], 'tracked/latency', count=10)
+        tx.wait()
+        for _ in range(10):
+            rx.queue.get(timeout=TIMEOUT)
+        rx.stop()
+
+        def _count(name):
+            for line in self.get(f"http://localhost:{http_port}/metrics", use_ca=False).splitlines():
+                if line.startswith(name + '_count{address="Mtracked/latency"}'):
+                    return int(line.split()[1])
+            return 0
+
+        self.assertTrue(retry(lambda: _count('qdr_address_egress_latency_microseconds') == 10))
+        self.assertTrue(retry(lambda: _count('qdr_address_settle_latency_microseconds') == 10))
+
+        addr = [a for a in r.management.query(type=ROUTER_ADDRESS_TYPE).get_dicts()
+                if a['key'] == 'Mtracked/latency'][0]
+        self.assertGreater(addr['settleLatencyAvg'], 0)
+        self.assertGreaterEqual(addr['settleLatencyAvg'], addr['egressLatencyAvg'])
+
+    def test_http_overload_metrics(self):
+        """ Verify the overload controller reports its samples and admits clients while the router is idle """
+        http_port = self.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'id': 'QDR.OVERLOAD',
+                        'overloadQueueDelayMilliseconds': 10000,
+                        'overloadEventLoopLagMilliseconds': 10000}),
+            ('listener', {'role': 'normal', 'port': self.get_port()}),
+            ('listener', {'port': http_port, 'http': 'yes'}),
+        ])
+        r = self.qdrouterd('overload-test-router', config)
+        r.wait_ready()
+
+        rx = AsyncTestReceiver(r.addresses[0], 'overload/test')
+        tx = AsyncTestSender(r.addresses[0], 'overload/test', count=10)
+        tx.wait()
+        for _ in range(10):
+            rx.queue.get(timeout=TIMEOUT)
+        rx.stop()
+
+        def _metrics():
+            values = {}
+            for line in self.get(f"http://localhost:{http_port}/metrics", use_ca=False).splitlines():
+                if line and not line.startswith('#'):
+                    name, value = line.rsplit(' ', 1)
+                    values[name] = int(float(value))
+            return values
+
+        metrics = _metrics()
+        self.assertEqual(0, metrics['qdr_overloaded'])
+        self.assertEqual(0, metrics['qdr_overload_refused_total{type="connection"}'])
+        self.assertEqual(0, metrics['qdr_overload_refused_total{type="link"}'])
+        self.assertIn('qdr_core_action_queue_delay_milliseconds', metrics)
+        self.assertIn('qdr_core_action_queue_depth', metrics)
+        self.assertIn('qdr_io_event_loop_lag_milliseconds', metrics)
+
     def test_https_get(self):
         def http_listener(**kwargs):
             args = dict(kwargs)
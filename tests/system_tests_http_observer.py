@@ -518,6 +518,70 @@ class Http1ObserverTest(Http1AutoObserverTest):
         cls.address = 'Http1ObserverTest'
 
 
+@unittest.skipUnless(nginx_available() and curl_available(),
+                     "Requires both nginx and curl tools")
+class Http1AsyncObserverTest(Http1AutoObserverTest):
+    """
+    Run the HTTP/1.x observer tests with the observers on a pool of observer
+    threads (observerThreads) rather than on the I/O threads
+    """
+    @classmethod
+    def router(cls, name, listener_port, server_port, extra_config=None, router_config=None):
+        """
+        Create a router with a tcpConnector and a tcpListener and two observer
+        threads.
+        """
+        config = [
+            ('router', {'mode': 'interior',
+                        'id': name,
+                        'observerThreads': 2,
+                        **(router_config or {})}),
+            ('listener', {'role': 'normal',
+                          'port': cls.tester.get_port()}),
+
+            ('tcpListener', {'host': "0.0.0.0",
+                             'port': listener_port,
+                             'address': 'Http1AsyncObserverTest'}),
+            ('tcpConnector', {'host': "localhost",
+                              'port': server_port,
+                              'address': 'Http1AsyncObserverTest'})
+        ]
+
+        if extra_config is not None:
+            config.extend(extra_config)
+        config = Qdrouterd.Config(config)
+        router = cls.tester.qdrouterd(name, config, wait=False, cl_args=["-T"])
+        router.wait_ports()
+        router.wait_address('Http1AsyncObserverTest', subscribers=1)
+        return router
+
+    @classmethod
+    def setUpClass(cls):
+        """
+        Start the HTTP1 servers
+        """
+        super(Http1AsyncObserverTest, cls).setUpClass()
+        cls.address = 'Http1AsyncObserverTest'
+
+    @unittest.skipUnless(sys.version_info >= (3, 11), "Requires HTTP/1.1 support")
+    def test_04_queue_full(self):
+        """
+        A connection whose payload does not fit the observer queue is no
+        longer observed, its data is still forwarded intact.
+        """
+        l_port = self.tester.get_port()
+        router = self.router("test_04", l_port, self.nginx_port,
+                             router_config={'observerQueueOctets': 4096})
+
+        curl_args = ['--http1.1', '-G', f"http://localhost:{l_port}/t100K.html"]
+        (rc, out, err) = run_curl(args=curl_args)
+        self.assertEqual(0, rc, f"curl failed: {rc}, {err}, {out}")
+        self.assertEqual(108803, len(out), "t100K.html not forwarded intact")
+
+        router.wait_log_message("Protocol observer queue full, no longer observing the connection")
+        router.teardown()
+
+
 def image_file(name):
     return os.path.join(system_test.DIR, 'images', name)
 
@@ -18,6 +18,7 @@
 #
 
 import json
+import os
 from subprocess import PIPE, STDOUT
 
 from proton import Message, symbol
@@ -186,6 +187,43 @@ class RouterMessageLogTestSome(RouterMessageLogTestBase):
         self.assertTrue(test_message, message_logs)
 
 
+class RouterMessageLogTestAsync(RouterMessageLogTestBase):
+    """Check that log output written by the asynchronous log writer reaches
+    both the log files and the recent log buffer"""
+    @classmethod
+    def setUpClass(cls):
+        super(RouterMessageLogTestAsync, cls).setUpClass()
+        name = "test-router"
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'QDR', 'asyncLogging': True}),
+            ('listener', {'port': cls.tester.get_port(), 'messageLoggingComponents': 'user-id,subject,reply-to'}),
+            ('log', {'module': 'MESSAGE',
+                     'enable': 'debug+',
+                     'outputFile': 'QDR-message.log'}),
+            ('address', {'prefix': 'closest', 'distribution': 'closest'}),
+        ])
+        cls.router = cls.tester.qdrouterd(name, config)
+        cls.router.wait_ready()
+
+    def address(self):
+        return self.router.addresses[0]
+
+    def test_log_message_async(self):
+        test = LogMessageTest(self.address())
+        test.run()
+        self.assertTrue(test.message_received)
+
+        logs = json.loads(self.run_skmanage("get-log"))
+        message_logs = [log for log in logs if log[0] == 'MESSAGE']
+        self.assertTrue(message_logs)
+
+        logfile = os.path.join(self.router.outdir, 'QDR-message.log')
+        self.router.wait_log_message('Received Message{user-id=b"testuser", subject="test-subject", reply-to="hello_world"}',
+                                     logfile_path=logfile)
+        self.router.wait_log_message('Sent Message{user-id=b"testuser", subject="test-subject", reply-to="hello_world"}',
+                                     logfile_path=logfile)
+
+
 class LogMessageTest(MessagingHandler):
     def __init__(self, address):
         super(LogMessageTest, self).__init__(auto_accept=False)
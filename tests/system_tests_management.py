@@ -41,6 +41,7 @@ from system_test import MANAGEMENT_TYPE, CONFIG_ENTITY_TYPE, OPER_ENTITY_TYPE
 from system_test import AMQP_LISTENER_TYPE, AMQP_CONNECTOR_TYPE, DUMMY_TYPE
 from system_test import ROUTER_TYPE, ROUTER_LINK_TYPE
 from system_test import ROUTER_NODE_TYPE, CONFIG_ADDRESS_TYPE, LOG_TYPE, CONNECTION_TYPE
+from system_test import ALLOCATOR_TYPE, TCP_LISTENER_TYPE
 
 
 def short_name(name):
@@ -199,6 +200,42 @@ class ManagementTest(system_test.TestCase):
         for l in response.get_dicts():
             self.assertNotEqual(l['name'], 'foo')
 
+    def test_apply_config(self):
+        """Apply a desired set of tcpListeners, only the changes are made"""
+
+        def listener(name, port):
+            return {'type': TCP_LISTENER_TYPE, 'name': name, 'port': str(port), 'address': 'apply/%s' % name}
+
+        def identities():
+            return dict((l['name'], l['identity']) for l in
+                        self.node.query(type=TCP_LISTENER_TYPE, attribute_names=['name', 'identity']).get_dicts())
+
+        ports = [self.get_port() for _ in range(4)]
+        result = self.node.apply_config([listener('a', ports[0]), listener('b', ports[1])])
+        self.assertEqual([], result['deleted'])
+        self.assertEqual(['a', 'b'], result['created'])
+        before = identities()
+
+        # 'a' is unchanged, 'b' moves to another port and 'c' is new
+        result = self.node.apply_config([listener('a', ports[0]), listener('b', ports[2]), listener('c', ports[3])])
+        self.assertEqual(['b'], result['deleted'])
+        self.assertEqual(['b', 'c'], result['created'])
+        self.assertEqual(1, result['unchanged'])
+        after = identities()
+        self.assertEqual(before['a'], after['a'])
+        self.assertNotEqual(before['b'], after['b'])
+
+        # Nothing is applied when any entity is invalid
+        self.assertRaises(BadRequestStatus, self.node.apply_config,
+                          [listener('a', ports[0]), {'type': TCP_LISTENER_TYPE, 'name': 'd', 'nosuch': 'x'}])
+        self.assertRaises(BadRequestStatus, self.node.apply_config, [{'type': ROUTER_TYPE, 'name': 'r'}])
+        self.assertEqual(after, identities())
+
+        # An empty set deletes every entity of the managed types
+        result = self.node.apply_config([], entity_types=[TCP_LISTENER_TYPE])
+        self.assertEqual(['a', 'b', 'c'], sorted(result['deleted']))
+        self.assertEqual({}, identities())
+
     def test_log(self):
         """Create, update and query log entities"""
 
@@ -371,6 +408,24 @@ class ManagementTest(system_test.TestCase):
         response = self.node.query(type=CONNECTION_TYPE)
         self.assertTrue(response.results)
 
+    def test_allocator(self):
+        """Verify the allocator entity served by the core agent"""
+        allocators = self.node.query(type=ALLOCATOR_TYPE).get_dicts()
+        self.assertTrue(allocators)
+        for attrs in allocators:
+            self.assertEqual('allocator/%s' % attrs['typeName'], attrs['identity'])
+            self.assertEqual(attrs['identity'], attrs['name'])
+            self.assertGreater(attrs['typeSize'], 0)
+
+        entity = self.node.read(type=ALLOCATOR_TYPE, identity='allocator/qd_message_t')
+        self.assertEqual('qd_message_t', entity.typeName)
+        self.assertGreater(entity.totalAllocFromHeap, 0)
+        self.assertRaises(NotFoundStatus, self.node.read, type=ALLOCATOR_TYPE, identity='allocator/nosuch')
+
+        # attributeNames select the columns of a query
+        response = self.node.query(type=ALLOCATOR_TYPE, attribute_names=['typeName', 'heldByThreads'])
+        self.assertEqual(['typeName', 'heldByThreads'], response.attribute_names)
+
     def test_router(self):
         """Verify router counts match entity counts"""
         entities = self.node.query().get_entities()
@@ -0,0 +1,322 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License
+#
+
+
+"""
+Measure the memory a router uses per idle connection and fail when it grows beyond a threshold.
+
+Each test starts a router, opens a number of idle AMQP connections or TCP flows and reports the growth of the
+router's memory per connection: for every memory pool type the growth of its allocated items times the type size,
+and as 'proton and other' the rest of the growth of the resident set, which is mostly proton's connection and
+transport state, the raw connection and TLS buffers and the heap allocations of the adaptors.  The report is printed
+and saved as memory_footprint.json in the test directory.
+
+The thresholds catch regressions, lower them when memory is saved.  Set SKUPPER_FOOTPRINT_CONNECTIONS to measure
+with more connections.
+"""
+
+import json
+import os
+import resource
+import socket
+import ssl
+import threading
+import time
+
+from proton.handlers import MessagingHandler
+from proton.reactor import Container
+
+from system_test import TestCase, Qdrouterd, main_module, unittest, retry, TIMEOUT
+from system_test import ALLOCATOR_TYPE, CA_CERT, SERVER_CERTIFICATE, SERVER_PRIVATE_KEY_NO_PASS
+
+CONNECTIONS = int(os.environ.get('SKUPPER_FOOTPRINT_CONNECTIONS', 250))
+
+# Links attached by each connection of the AMQP test with links
+LINKS = 10
+
+# Data sent through each TCP flow: the start of an HTTP/1 request, so the observers hold a partly parsed request
+FLOW_DATA = b'GET /footprint HTTP/1.1\r\nHost: localhost\r\n'
+
+# Bytes per connection, or per link, above which a test fails
+AMQP_CONNECTION_THRESHOLD = 128 * 1024
+AMQP_LINK_THRESHOLD = 8 * 1024
+TCP_FLOW_THRESHOLD = 96 * 1024
+TLS_FLOW_THRESHOLD = 192 * 1024
+OBSERVED_FLOW_THRESHOLD = 128 * 1024
+
+
+def rss_bytes(pid):
+    with open('/proc/%d/status' % pid) as f:
+        for line in f:
+            if line.startswith('VmRSS:'):
+                return int(line.split()[1]) * 1024
+    return None
+
+
+class Footprint:
+    """
+    The memory of a router: the allocated items of every pool type and the resident set size
+    """
+
+    def __init__(self, router):
+        self.pools = {}
+        for pool in router.management.query(type=ALLOCATOR_TYPE).get_dicts():
+            allocated = pool['totalAllocFromHeap'] - pool['totalFreeToHeap']
+            self.pools[pool['typeName']] = (allocated, pool['typeSize'])
+        self.rss = rss_bytes(router.pid)
+
+    def growth(self, baseline, count):
+        """
+        Bytes per connection by pool type, grown from baseline, and the total of the pools and the resident set
+        """
+        per_type = {}
+        for name, (allocated, size) in self.pools.items():
+            before = baseline.pools.get(name, (0, size))[0]
+            if allocated > before:
+                per_type[name] = (allocated - before) * size / count
+        pools = sum(per_type.values())
+        rss = (self.rss - baseline.rss) / count
+        return {'pools': per_type,
+                'pool_bytes': pools,
+                'proton_and_other_bytes': max(rss - pools, 0),
+                'bytes': max(rss, pools)}
+
+
+class IdleServer:
+    """
+    Accepts the connections of the tcpConnector and keeps them open without replying, which would end the
+    observation of an incomplete request
+    """
+
+    def __init__(self):
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.bind(('127.0.0.1', 0))
+        self.listener.listen(1024)
+        self.port = self.listener.getsockname()[1]
+        self.accepted = []
+        self.thread = threading.Thread(target=self._run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def _run(self):
+        while True:
+            try:
+                sock, _ = self.listener.accept()
+            except OSError:
+                return
+            self.accepted.append(sock)
+
+    def close_accepted(self):
+        accepted, self.accepted = self.accepted, []
+        for sock in accepted:
+            sock.close()
+
+    def stop(self):
+        self.listener.shutdown(socket.SHUT_RDWR)
+        self.listener.close()
+        self.thread.join(TIMEOUT)
+        self.close_accepted()
+
+
+class IdleAmqpClients(MessagingHandler):
+    """
+    Opens connections that each attach receiver links, then keeps them idle until stop()
+    """
+
+    def __init__(self, url, count, links):
+        super(IdleAmqpClients, self).__init__(prefetch=0)
+        self.url = url
+        self.count = count
+        self.links = links
+        self.opened = 0
+        self.attached = 0
+        self.connections = []
+        self.ready = threading.Event()
+        self.stopping = False
+        self.error = None
+
+    def on_start(self, event):
+        for c in range(self.count):
+            conn = event.container.connect(self.url)
+            self.connections.append(conn)
+            for l in range(self.links):
+                event.container.create_receiver(conn, 'closest/footprint/%d/%d' % (c, l))
+        event.container.schedule(0.1, self)
+
+    def on_timer_task(self, event):
+        if self.stopping:
+            for conn in self.connections:
+                conn.close()
+        else:
+            event.container.schedule(0.1, self)
+
+    def _check_ready(self):
+        if self.opened == self.count and self.attached == self.count * self.links:
+            self.ready.set()
+
+    def on_connection_opened(self, event):
+        self.opened += 1
+        self._check_ready()
+
+    def on_link_opened(self, event):
+        self.attached += 1
+        self._check_ready()
+
+    def on_transport_error(self, event):
+        if not self.stopping:
+            self.error = "transport error: %s" % event.transport.condition
+            self.ready.set()
+
+    def stop(self):
+        self.stopping = True
+
+
+class MemoryFootprintTest(TestCase):
+    """
+    Memory per idle connection of a router
+    """
+
+    @classmethod
+    def setUpClass(cls):
+        super(MemoryFootprintTest, cls).setUpClass()
+        # the TCP tests hold two sockets per flow here and the router two more
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        needed = 2 * CONNECTIONS + 256
+        if soft != resource.RLIM_INFINITY and soft < needed:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (min(needed, hard), hard))
+        cls.results = {}
+
+    @classmethod
+    def tearDownClass(cls):
+        if cls.results:
+            with open(os.path.join(cls.tester.directory, 'memory_footprint.json'), 'w') as f:
+                json.dump(cls.results, f, indent=1)
+        super(MemoryFootprintTest, cls).tearDownClass()
+
+    def setUp(self):
+        super(MemoryFootprintTest, self).setUp()
+        self.server = IdleServer()
+        self.amqp_port = self.get_port()
+        self.tcp_ports = {'plain': self.get_port(), 'tls': self.get_port(), 'observed': self.get_port()}
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'interior', 'id': 'Footprint'}),
+            ('listener', {'port': self.amqp_port}),
+            ('policy', {'maxConnections': 4 * CONNECTIONS + 100}),
+            ('address', {'prefix': 'closest', 'distribution': 'closest'}),
+            ('sslProfile', {'name': 'footprint-ssl-profile',
+                            'caCertFile': CA_CERT,
+                            'certFile': SERVER_CERTIFICATE,
+                            'privateKeyFile': SERVER_PRIVATE_KEY_NO_PASS}),
+            ('tcpListener', {'host': '127.0.0.1', 'port': self.tcp_ports['plain'],
+                             'address': 'footprint', 'observer': 'none'}),
+            ('tcpListener', {'host': '127.0.0.1', 'port': self.tcp_ports['tls'],
+                             'address': 'footprint', 'observer': 'none', 'sslProfile': 'footprint-ssl-profile'}),
+            ('tcpListener', {'host': '127.0.0.1', 'port': self.tcp_ports['observed'],
+                             'address': 'footprint', 'observer': 'http1'}),
+            ('tcpConnector', {'host': '127.0.0.1', 'port': self.server.port, 'address': 'footprint'}),
+        ])
+        self.router = self.qdrouterd('Footprint', config, wait=True)
+        self.router.wait_address('footprint', subscribers=1)
+        if rss_bytes(self.router.pid) is None:
+            self.skipTest("the resident set size of the router is not available")
+
+    def tearDown(self):
+        self.server.stop()
+        super(MemoryFootprintTest, self).tearDown()
+
+    def _report(self, name, growth, count, threshold):
+        """
+        Record and print the growth per connection and check it against the threshold
+        """
+        growth['connections'] = count
+        growth['threshold'] = threshold
+        MemoryFootprintTest.results[name] = growth
+        lines = ["%s: %.0f bytes per connection, %.0f in memory pools, %.0f proton and other (%d connections)"
+                 % (name, growth['bytes'], growth['pool_bytes'], growth['proton_and_other_bytes'], count)]
+        for type_name, size in sorted(growth['pools'].items(), key=lambda p: -p[1]):
+            if size >= 1:
+                lines.append("    %-40s %10.0f" % (type_name, size))
+        print('\n'.join(lines))
+        self.assertLessEqual(growth['bytes'], threshold,
+                             "%s uses more memory per connection than %d bytes:\n%s"
+                             % (name, threshold, '\n'.join(lines)))
+
+    def _measure_amqp(self, links):
+        baseline = Footprint(self.router)
+        clients = IdleAmqpClients('amqp://127.0.0.1:%d' % self.amqp_port, CONNECTIONS, links)
+        container = Container(clients)
+        thread = threading.Thread(target=container.run)
+        thread.daemon = True
+        thread.start()
+        try:
+            self.assertTrue(clients.ready.wait(TIMEOUT), "connections did not open in time")
+            self.assertIsNone(clients.error)
+            # the core completes the attaches after the links have opened
+            time.sleep(1)
+            return Footprint(self.router).growth(baseline, CONNECTIONS)
+        finally:
+            clients.stop()
+            thread.join(TIMEOUT)
+
+    def _open_flows(self, port, tls):
+        context = None
+        if tls:
+            context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+            context.load_verify_locations(cafile=CA_CERT)
+        flows = []
+        for _ in range(CONNECTIONS):
+            sock = socket.create_connection(('127.0.0.1', port), timeout=TIMEOUT)
+            if context:
+                sock = context.wrap_socket(sock, server_hostname='localhost')
+            sock.sendall(FLOW_DATA)
+            flows.append(sock)
+        self.assertTrue(retry(lambda: len(self.server.accepted) >= CONNECTIONS),
+                        "%d of %d flows reached the server" % (len(self.server.accepted), CONNECTIONS))
+        return flows
+
+    def _measure_tcp(self, listener):
+        baseline = Footprint(self.router)
+        flows = self._open_flows(self.tcp_ports[listener], listener == 'tls')
+        try:
+            time.sleep(1)
+            return Footprint(self.router).growth(baseline, CONNECTIONS)
+        finally:
+            for sock in flows:
+                sock.close()
+            self.server.close_accepted()
+
+    def test_01_amqp_connections(self):
+        self._report('amqp', self._measure_amqp(0), CONNECTIONS, AMQP_CONNECTION_THRESHOLD)
+
+    def test_02_amqp_connections_with_links(self):
+        threshold = AMQP_CONNECTION_THRESHOLD + LINKS * AMQP_LINK_THRESHOLD
+        self._report('amqp_%d_links' % LINKS, self._measure_amqp(LINKS), CONNECTIONS, threshold)
+
+    def test_03_tcp_flows(self):
+        self._report('tcp', self._measure_tcp('plain'), CONNECTIONS, TCP_FLOW_THRESHOLD)
+
+    def test_04_tls_tcp_flows(self):
+        self._report('tcp_tls', self._measure_tcp('tls'), CONNECTIONS, TLS_FLOW_THRESHOLD)
+
+    def test_05_observed_tcp_flows(self):
+        self._report('tcp_http1_observer', self._measure_tcp('observed'), CONNECTIONS, OBSERVED_FLOW_THRESHOLD)
+
+
+if __name__ == '__main__':
+    unittest.main(main_module())
@@ -22,6 +22,7 @@ import os
 from subprocess import PIPE, STDOUT
 from time import sleep
 from typing import Sequence
+from urllib.request import urlopen
 
 from proton import Condition, Delivery, Message, Timeout, symbol
 from proton.handlers import MessagingHandler
@@ -31,7 +32,7 @@ from proton.reactor import Container, AtMostOnce, AtLeastOnce
 from skupper_router.management.client import Node
 
 from system_test import TestCase, Qdrouterd, main_module, TIMEOUT, DIR
-from system_test import Process, unittest, SkManager, TestTimeout
+from system_test import Process, unittest, SkManager, TestTimeout, retry
 from system_test import AMQP_CONNECTOR_TYPE, AMQP_LISTENER_TYPE
 from system_test import CONNECTION_TYPE, ROUTER_ADDRESS_TYPE, ROUTER_LINK_TYPE
 from system_test import ROUTER_TYPE, ROUTER_METRICS_TYPE
@@ -714,6 +715,7 @@ class OneRouterTest(TestCase):
 
             ('address', {'prefix': 'closest', 'distribution': 'closest'}),
             ('address', {'prefix': 'balanced', 'distribution': 'balanced'}),
+            ('address', {'prefix': 'affinity', 'distribution': 'affinity'}),
             ('address', {'prefix': 'multicast', 'distribution': 'multicast'}),
             ('address', {'prefix': 'unavailable', 'distribution': 'unavailable'})
         ])
@@ -862,6 +864,11 @@ class OneRouterTest(TestCase):
         test.run()
         self.assertIsNone(test.error)
 
+    def test_22_semantics_affinity(self):
+        test = SemanticsAffinity(self.address)
+        test.run()
+        self.assertIsNone(test.error)
+
     def test_23_send_settle_mode_settled(self):
         """
         The receiver sets a snd-settle-mode of settle thus indicating that it wants to receive settled messages from
@@ -1109,6 +1116,28 @@ class OneRouterTest(TestCase):
         test.run()
         self.assertIsNone(test.error)
 
+    def test_54_credit_withdrawn_without_consumer(self):
+        """
+        Ensure a sending client's credit is drained as soon as the last
+        consumer of its address goes away, and restored when a consumer
+        appears again
+        """
+        addr = 'closest/credit-withdrawn'
+        conn = BlockingConnection(self.address)
+        receiver = conn.create_receiver(addr)
+        sender = conn.create_sender(addr)
+        conn.wait(lambda: sender.link.credit > 0, timeout=TIMEOUT)
+
+        receiver.close()
+        conn.wait(lambda: sender.link.drain_mode, timeout=TIMEOUT, msg="credit not drained")
+
+        receiver = conn.create_receiver(addr)
+        conn.wait(lambda: not sender.link.drain_mode, timeout=TIMEOUT, msg="credit not restored")
+        sender.send(Message(body="restored"))
+        self.assertEqual("restored", receiver.receive(timeout=TIMEOUT).body)
+        receiver.accept()
+        conn.close()
+
 
 class Entity:
     def __init__(self, status_code, status_description, attrs):
@@ -1717,6 +1746,61 @@ class SemanticsBalanced(MessagingHandler):
         Container(self).run()
 
 
+class SemanticsAffinity(MessagingHandler):
+    """
+    Messages of the same group-id on an affinity address must all go to the same one of three receivers
+    """
+    def __init__(self, address):
+        super(SemanticsAffinity, self).__init__()
+        self.address = address
+        self.dest = "affinity.1"
+        self.timer = None
+        self.conn = None
+        self.sender = None
+        self.receivers = []
+        self.num_groups = 10
+        self.num_messages = 200
+        self.n_sent = 0
+        self.n_received = 0
+        self.n_opened = 0
+        self.group_receivers = {}
+        self.error = None
+
+    def on_start(self, event):
+        self.timer = event.reactor.schedule(TIMEOUT, TestTimeout(self))
+        self.conn = event.container.connect(self.address)
+        for name in ("A", "B", "C"):
+            self.receivers.append(event.container.create_receiver(self.conn, self.dest, name=name))
+
+    def timeout(self):
+        self.error = "Timeout Expired: sent=%d rcvd=%d" % (self.n_sent, self.n_received)
+        self.conn.close()
+
+    def on_link_opened(self, event):
+        if event.receiver in self.receivers:
+            self.n_opened += 1
+            if self.n_opened == len(self.receivers):
+                self.sender = event.container.create_sender(self.conn, self.dest)
+
+    def on_sendable(self, event):
+        while self.sender.credit > 0 and self.n_sent < self.num_messages:
+            self.sender.send(Message(body=self.n_sent, group_id="group-%d" % (self.n_sent % self.num_groups)))
+            self.n_sent += 1
+
+    def on_message(self, event):
+        group = event.message.group_id
+        receiver = event.receiver.name
+        if self.group_receivers.setdefault(group, receiver) != receiver:
+            self.error = "%s delivered to both %s and %s" % (group, self.group_receivers[group], receiver)
+        self.n_received += 1
+        if self.error or self.n_received == self.num_messages:
+            self.timer.cancel()
+            self.conn.close()
+
+    def run(self):
+        Container(self).run()
+
+
 class PreSettled (MessagingHandler) :
     def __init__(self,
                  addr,
@@ -2732,6 +2816,7 @@ class UptimeLastDlvChecker:
         container_id_index = result.attribute_names.index('container')
         uptime_seconds_index = result.attribute_names.index('uptimeSeconds')
         last_dlv_seconds_index = result.attribute_names.index('lastDlvSeconds')
+        cpu_microseconds_index = result.attribute_names.index('cpuMicroseconds')
         for res in result.results:
             container_id = res[container_id_index]
 
@@ -2747,6 +2832,8 @@ class UptimeLastDlvChecker:
                 else:
                     if not last_dlv_seconds >= self.lastDlv:
                         self.parent.error = "Connection lastDeliverySeconds must be greater than or equal to %d but is %d" % (self.lastDlv, last_dlv_seconds)
+                    elif not res[cpu_microseconds_index] > 0:
+                        self.parent.error = "Expected the connection to have been charged CPU time, got %r" % res[cpu_microseconds_index]
                     else:
                         self.parent.success = True
                 self.num_connections += 1
@@ -3545,6 +3632,307 @@ class AMQPLinkFlapTest(MessagingHandler):
         Container(self).run()
 
 
+class ManyLinksCloseTest(MessagingHandler):
+    """
+    Attach a large number of links on a single connection, close them all at
+    once and then close the connection. Link teardown must be linear in the
+    number of links otherwise the router stalls and the test times out.
+    """
+    def __init__(self, router_address, link_count):
+        super(ManyLinksCloseTest, self).__init__(prefetch=0)
+        self.router_address = router_address
+        self.link_count = link_count
+        self.target = "many/links/close/test"
+        self.error = None
+        self.conn = None
+        self.receivers = []
+        self.n_opened = 0
+        self.n_closed = 0
+        self.timer = None
+
+    def done(self, error=None):
+        self.error = error
+        self.receivers = []
+        if self.timer:
+            self.timer.cancel()
+        if self.conn:
+            self.conn.close()
+
+    def timeout(self):
+        self.done(error=f"Test timed out: opened={self.n_opened} closed={self.n_closed}")
+
+    def on_start(self, event):
+        self.timer = event.reactor.schedule(TIMEOUT, TestTimeout(self))
+        self.conn = event.container.connect(self.router_address)
+
+    def on_connection_opened(self, event):
+        for index in range(self.link_count):
+            self.receivers.append(event.container.create_receiver(self.conn, self.target,
+                                                                  name=f"ML-{index}"))
+
+    def on_link_opened(self, event):
+        self.n_opened += 1
+        if self.n_opened == self.link_count:
+            for receiver in self.receivers:
+                receiver.close()
+
+    def on_link_closed(self, event):
+        self.n_closed += 1
+        if self.n_closed == self.link_count:
+            self.done()
+
+    def run(self):
+        Container(self).run()
+
+
+class ManyLinksCloseRouterTest(TestCase):
+    """
+    Verify that a connection with a very large number of links can be torn
+    down without stalling the router
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(ManyLinksCloseRouterTest, cls).setUpClass()
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'ManyLinks'}),
+            ('listener', {'port': cls.tester.get_port()}),
+        ])
+        cls.router = cls.tester.qdrouterd("ManyLinksRouter", config)
+        cls.router.wait_ready()
+        cls.address = cls.router.addresses[0]
+
+    def test_01_close_50k_links(self):
+        test = ManyLinksCloseTest(self.address, 50000)
+        test.run()
+        self.assertIsNone(test.error)
+
+        # the router must still be responsive
+        mgmt = self.router.management
+        self.assertEqual(1, len(mgmt.query(type=ROUTER_TYPE).get_dicts()))
+
+
+class MessageTtlTest(TestCase):
+    """
+    Verify that with enforceMessageTtl messages whose time-to-live runs out while queued for a consumer are dropped
+    instead of sent, and that an unsettled one is rejected
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(MessageTtlTest, cls).setUpClass()
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'TTL', 'enforceMessageTtl': 'yes'}),
+            ('listener', {'port': cls.tester.get_port()}),
+        ])
+        cls.router = cls.tester.qdrouterd("MessageTtlRouter", config)
+        cls.router.wait_ready()
+        cls.address = cls.router.addresses[0]
+
+    def test_01_expired_while_queued(self):
+        conn = BlockingConnection(self.address)
+        receiver = conn.create_receiver("ttl/queued", credit=0)
+
+        # the router queues these on the receiver's link, which has no credit yet
+        sender = conn.create_sender("ttl/queued", options=AtMostOnce())
+        for i in range(5):
+            sender.send(Message(body="expiring-%d" % i, ttl=0.2))
+        sender.send(Message(body="lasting"))
+        unsettled = conn.create_sender("ttl/queued")
+        conn.wait(lambda: unsettled.link.credit > 0, timeout=TIMEOUT)
+        dlv = unsettled.link.send(Message(body="expiring-unsettled", ttl=0.2))
+        sleep(0.5)
+
+        msg = receiver.receive(timeout=TIMEOUT)
+        self.assertEqual("lasting", msg.body)
+        receiver.accept()
+        receiver.flow(1)
+        conn.wait(lambda: dlv.remote_state == Delivery.REJECTED, timeout=TIMEOUT)
+
+        mgmt = self.router.management
+        addr = [a for a in mgmt.query(type=ROUTER_ADDRESS_TYPE).get_dicts() if a['key'] == 'Mttl/queued'][0]
+        self.assertEqual(6, addr['deliveriesExpired'])
+        link = [l for l in mgmt.query(type=ROUTER_LINK_TYPE).get_dicts()
+                if l['owningAddr'] == 'Mttl/queued' and l['linkDir'] == 'out'][0]
+        self.assertEqual(6, link['deliveriesExpired'])
+        conn.close()
+
+
+class SlowPresettledConsumerTest(TestCase):
+    """
+    Verify that the adaptive capacity of an outgoing link does not lower the
+    point at which the router drops pre-settled deliveries for a consumer
+    that falls behind: that stays at the connection's linkCapacity
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(SlowPresettledConsumerTest, cls).setUpClass()
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'SlowPresettled'}),
+            ('listener', {'port': cls.tester.get_port(), 'linkCapacity': 10}),
+        ])
+        cls.router = cls.tester.qdrouterd("SlowPresettledRouter", config)
+        cls.router.wait_ready()
+        cls.address = cls.router.addresses[0]
+
+    def test_01_drop_threshold(self):
+        conn = BlockingConnection(self.address)
+        conn.create_receiver("slow/presettled", credit=0)
+
+        # the receiver never grants credit, so every delivery is queued on its link
+        sender = conn.create_sender("slow/presettled", options=AtMostOnce())
+        for i in range(100):
+            sender.send(Message(body="presettled-%d" % i))
+
+        mgmt = self.router.management
+
+        def _out_link():
+            links = [l for l in mgmt.query(type=ROUTER_LINK_TYPE).get_dicts()
+                     if l['owningAddr'] == 'Mslow/presettled' and l['linkDir'] == 'out']
+            return links[0] if links else None
+
+        def _all_forwarded():
+            link = _out_link()
+            return link and link['undeliveredCount'] + link['droppedPresettledCount'] == 100
+        self.assertTrue(retry(_all_forwarded))
+
+        # Each time the link holds linkCapacity deliveries all but the first are dropped, which leaves 10
+        # of the 100 queued.  Dropping at the shrinking effectiveCapacity instead would leave fewer and drop more.
+        link = _out_link()
+        self.assertEqual(90, link['droppedPresettledCount'])
+        self.assertEqual(10, link['undeliveredCount'])
+        self.assertLess(link['effectiveCapacity'], link['capacity'])
+        conn.close()
+
+
+class AdaptiveWorkerPoolTest(TestCase):
+    """
+    Verify that the worker pool of a router with workerThreadsMax above
+    workerThreads adds a worker under load, parks it again once the load is
+    gone and that the router shuts down cleanly with a parked worker
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(AdaptiveWorkerPoolTest, cls).setUpClass()
+        cls.http_port = cls.tester.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'WorkerPool', 'workerThreads': 1, 'workerThreadsMax': 2}),
+            ('listener', {'port': cls.tester.get_port()}),
+            ('listener', {'port': cls.http_port, 'http': 'yes'}),
+        ])
+        cls.router = cls.tester.qdrouterd("WorkerPoolRouter", config, wait=True)
+        cls.address = cls.router.addresses[0]
+
+    def _router_metrics(self):
+        return self.router.management.query(type=ROUTER_METRICS_TYPE).get_dicts()[0]
+
+    def _gauges(self):
+        with urlopen(f"http://localhost:{self.http_port}/metrics") as resp:
+            lines = resp.read().decode('utf-8').splitlines()
+        values = {}
+        for line in lines:
+            name, _, value = line.partition(' ')
+            if name.startswith('qdr_worker_'):
+                values[name] = int(value)
+        return values
+
+    def test_01_grow_and_park(self):
+        self.router.wait_log_message("Worker threads adapt to load between 1 and 2")
+        self.assertEqual(1, self._router_metrics()['workerThreads'])
+
+        # pairs of senders and receivers that keep the single worker busy
+        clients = []
+        for i in range(4):
+            address = "closest/worker_pool/%d" % i
+            clients.append(self.popen(["test-receiver", "-a", self.address, "-c", "0", "-s", address],
+                                      expect=Process.RUNNING))
+            self.router.wait_address(address)
+            clients.append(self.popen(["test-sender", "-a", self.address, "-c", "0", "-t", address, "-sm", "-u"],
+                                      expect=Process.RUNNING))
+
+        self.router.wait_log_message("Worker threads at [0-9]+% utilization, adding a worker: 2 of at most 2")
+        self.assertTrue(retry(lambda: self._router_metrics()['workerThreads'] == 2))
+        self.assertGreater(self._router_metrics()['workerUtilization'], 0)
+        self.assertTrue(retry(lambda: self._gauges().get('qdr_worker_threads') == 2))
+        self.assertGreater(self._gauges().get('qdr_worker_utilization_percent', 0), 0)
+
+        for client in clients:
+            client.teardown()
+
+        # the added worker is parked after thirty idle samples
+        self.router.wait_log_message("Worker threads at [0-9]+% utilization, parking a worker: 1 of at least 1")
+        self.assertTrue(retry(lambda: self._router_metrics()['workerThreads'] == 1))
+        self.assertTrue(retry(lambda: self._gauges().get('qdr_worker_threads') == 1))
+
+        # the parked worker is released on shutdown, the router must exit within TIMEOUT
+        self.router.teardown()
+
+
+class HeavyHittersTest(TestCase):
+    """
+    Verify that the deliveries sent to an address show up in the heavyHitters
+    report of the routerMetrics entity and in the qdr_heavy_hitter_* gauges
+    once the window they were sent in has completed
+    """
+    COUNT = 50
+
+    @classmethod
+    def setUpClass(cls):
+        super(HeavyHittersTest, cls).setUpClass()
+        cls.http_port = cls.tester.get_port()
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'standalone', 'id': 'HeavyHitters'}),
+            ('listener', {'port': cls.tester.get_port()}),
+            ('listener', {'port': cls.http_port, 'http': 'yes'}),
+        ])
+        cls.router = cls.tester.qdrouterd("HeavyHittersRouter", config, wait=True)
+        cls.address = cls.router.addresses[0]
+
+    def _heavy_hitters(self):
+        return self.router.management.query(type=ROUTER_METRICS_TYPE).get_dicts()[0]['heavyHitters']
+
+    def _gauges(self, name):
+        with urlopen(f"http://localhost:{self.http_port}/metrics") as resp:
+            lines = resp.read().decode('utf-8').splitlines()
+        return [line for line in lines if line.startswith(name + '{')]
+
+    def test_01_address_report(self):
+        target = "closest/heavy_hitters"
+        conn = BlockingConnection(self.address)
+        receiver = conn.create_receiver(target)
+        sender = conn.create_sender(target)
+        for i in range(self.COUNT):
+            sender.send(Message(body="heavy hitter %d" % i))
+        for i in range(self.COUNT):
+            receiver.receive(timeout=TIMEOUT)
+            receiver.accept()
+        conn.close()
+
+        # the sends may straddle a window boundary, take the first completed
+        # window that saw any of them. The gauges are replaced with the report
+        # at the end of each window so read both within the same window.
+        def address_entry():
+            report = self._heavy_hitters()
+            gauges = self._gauges('qdr_heavy_hitter_address_deliveries')
+            for entry in report.get('addressDeliveries', []):
+                if target in entry['address'] and any(target in line for line in gauges):
+                    return report, entry
+            return None
+        found = retry(address_entry)
+        self.assertIsNotNone(found, "address never reported")
+        report, entry = found
+
+        self.assertEqual(5, report['windowSeconds'])
+        self.assertGreater(entry['count'], 0)
+        self.assertLessEqual(entry['count'], self.COUNT)
+        # only a handful of keys were seen, the sketch never evicted
+        self.assertEqual(0, entry['error'])
+        self.assertIn(entry['address'], [e['address'] for e in report['addressOctets']])
+        # the one connection that sent to the address carried every one of its deliveries
+        self.assertIn(entry['count'], [e['count'] for e in report['connectionDeliveries']])
+
+        # the management connection itself keeps the connection gauges populated
+        self.assertTrue(retry(lambda: self._gauges('qdr_heavy_hitter_connection_deliveries')))
+
+
 class DataConnectionCountTest(TestCase):
     """
     Start the router with different numbers of worker threads and make sure
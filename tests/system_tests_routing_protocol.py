@@ -17,12 +17,18 @@
 # under the License.
 #
 
+import os
+import signal
+import time
+
 from proton import Message, symbol, int32
 from proton.handlers import MessagingHandler
 from proton.reactor import Container
+from proton.utils import BlockingConnection
 
 from system_test import TestCase, Qdrouterd, main_module, TIMEOUT
-from system_test import unittest, TestTimeout
+from system_test import unittest, TestTimeout, retry
+from system_test import ROUTER_NODE_TYPE
 
 
 class RouterTest(TestCase):
@@ -285,5 +291,81 @@ class HugeRouterIdTest(TestCase):
         self.RD.wait_router_connected(self.RC_name)
 
 
+class NeighborLivenessTest(TestCase):
+    """
+    Verify that a router with neighborLivenessMilliseconds fails over from
+    a silent neighbor within the interval rather than after
+    helloMaxAgeSeconds.
+
+    A is connected to C directly at cost 10 and through B at cost 2.  B is
+    stopped, so its connections stay open but nothing is heard from it.
+    """
+    INTERVAL_MS = 1000
+    HELLO_MAX_AGE = 60
+
+    @classmethod
+    def setUpClass(cls):
+        super(NeighborLivenessTest, cls).setUpClass()
+
+        def router(name, extra_config):
+            config = [
+                ('router', {'mode': 'interior', 'id': name,
+                            'neighborLivenessMilliseconds': cls.INTERVAL_MS,
+                            'helloMaxAgeSeconds': cls.HELLO_MAX_AGE}),
+                ('listener', {'port': cls.tester.get_port()})
+            ] + extra_config
+            return cls.tester.qdrouterd(name, Qdrouterd.Config(config), wait=True)
+
+        ir_port_A = cls.tester.get_port()
+        ir_port_C = cls.tester.get_port()
+
+        cls.RA = router('A', [('listener', {'role': 'inter-router', 'port': ir_port_A}),
+                              ('connector', {'role': 'inter-router', 'port': ir_port_C, 'cost': 10})])
+        cls.RC = router('C', [('listener', {'role': 'inter-router', 'port': ir_port_C})])
+        cls.RB = router('B', [('connector', {'role': 'inter-router', 'port': ir_port_A}),
+                              ('connector', {'role': 'inter-router', 'port': ir_port_C})])
+
+    def _cost(self, router, router_id):
+        try:
+            return router.management.read(type=ROUTER_NODE_TYPE, identity="router.node/%s" % router_id)['cost']
+        except Exception:
+            return None
+
+    def test_01_silent_neighbor(self):
+        self.assertTrue(retry(lambda: self._cost(self.RA, 'C') == 2))
+        self.RA.wait_log_message("Neighbor liveness: lost after %d ms" % self.INTERVAL_MS)
+
+        receiver_conn = BlockingConnection(self.RC.addresses[0], timeout=TIMEOUT)
+        self.addCleanup(receiver_conn.close)
+        receiver = receiver_conn.create_receiver("closest/liveness")
+        self.RA.wait_address("closest/liveness", remotes=1)
+
+        # let the routers hear each other's keepalives before B goes silent
+        time.sleep(2 * self.INTERVAL_MS / 1000)
+        os.kill(self.RB.pid, signal.SIGSTOP)
+        self.addCleanup(os.kill, self.RB.pid, signal.SIGCONT)
+        silenced = time.monotonic()
+
+        self.assertTrue(retry(lambda: self._cost(self.RA, 'C') == 10))
+        elapsed = time.monotonic() - silenced
+        self.assertLess(elapsed, self.HELLO_MAX_AGE / 4,
+                        "failover took %.1f s, neighborLivenessMilliseconds=%d" % (elapsed, self.INTERVAL_MS))
+        self.assertIsNone(self._cost(self.RA, 'B'))
+
+        # the direct path carries the traffic
+        sender_conn = BlockingConnection(self.RA.addresses[0], timeout=TIMEOUT)
+        self.addCleanup(sender_conn.close)
+        sender = sender_conn.create_sender("closest/liveness")
+        sender.send(Message(body="after failover"))
+        self.assertEqual("after failover", receiver.receive(timeout=TIMEOUT).body)
+        receiver.accept()
+
+        with open(self.RA.logfile_path, 'rt') as log_file:
+            log = log_file.read()
+        self.assertIn("Neighbor router silent for", log)
+        # the routing agent is told once, by the liveness check and not again by the control link detach
+        self.assertNotIn("Notify routing agent of loss of control link", log)
+
+
 if __name__ == '__main__':
     unittest.main(main_module())
@@ -285,6 +285,21 @@ class SkmanageTest(TestCase):
                 found = True
         self.assertTrue(found)
 
+    def test_get_flight_recorder(self):
+        self.assertEqual(5, len(json.loads(self.run_skmanage("get-flight-recorder limit=5"))))
+        events = json.loads(self.run_skmanage("get-flight-recorder"))
+        timestamps = [event[0] for event in events]
+        self.assertEqual(sorted(timestamps), timestamps)
+        names = set(event[2] for event in events)
+        # the core thread records every action it runs, and the management
+        # request itself arrived over a newly opened connection
+        self.assertIn('action', names)
+        self.assertIn('connection-opened', names)
+        for event in events:
+            self.assertEqual(6, len(event))
+            if event[2] == 'action':
+                self.assertIsInstance(event[3], str)
+
     def test_get_logstats(self):
         query_command = f'QUERY --type={LOG_STATS_TYPE}'
         logs = json.loads(self.run_skmanage(query_command))
@@ -21,13 +21,16 @@ import io
 import json
 import os
 import re
+import select
 import socket
 import subprocess
 import time
 import traceback
 from subprocess import PIPE
 from subprocess import STDOUT
+from threading import Thread
 from typing import List, Optional, Mapping, Tuple
+from urllib.request import urlopen
 
 from proton import Message
 from proton.handlers import MessagingHandler
@@ -1362,6 +1365,52 @@ class TcpAdaptorManagementTest(TestCase):
                 links.append(link)
         return links
 
+    def _tcp_server(self, backlog=1):
+        """
+        Listen on the test server port.  The socket is closed when the test
+        ends, after the TCP entities are deleted.
+        """
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.addCleanup(server.close)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.settimeout(TIMEOUT)
+        server.bind(("", self.tcp_server_port))
+        server.listen(backlog)
+        return server
+
+    def _create_tcp_entity(self, entity_type, name, address, port, **extra):
+        """
+        Create a tcpConnector or tcpListener on the edge router that is
+        deleted when the test ends, pass or fail
+        """
+        attributes = {'address': address, 'port': port, 'host': '127.0.0.1'}
+        attributes.update(extra)
+        mgmt = self.e_router.management
+        mgmt.create(type=entity_type, name=name, attributes=attributes)
+        self.addCleanup(mgmt.delete, type=entity_type, name=name)
+
+    def _create_tcp_connector(self, name, address, **extra):
+        self._create_tcp_entity(TCP_CONNECTOR_TYPE, name, address, self.tcp_server_port, **extra)
+
+    def _create_tcp_listener(self, name, address, **extra):
+        """
+        Create a tcpListener and wait until it accepts connections
+        """
+        self._create_tcp_entity(TCP_LISTENER_TYPE, name, address, self.tcp_listener_port, **extra)
+        mgmt = self.e_router.management
+        self.assertTrue(retry(lambda: mgmt.read(type=TCP_LISTENER_TYPE,
+                                                name=name)['operStatus'] == 'up'))
+
+    def _tcp_client(self):
+        """
+        Connect a client to the test listener, closed when the test ends
+        """
+        client = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.addCleanup(client.close)
+        client.settimeout(TIMEOUT)
+        client.connect(('127.0.0.1', self.tcp_listener_port))
+        return client
+
     @classmethod
     def setUpClass(cls, test_name='TCPMgmtTest'):
         super(TcpAdaptorManagementTest, cls).setUpClass()
@@ -1378,6 +1427,7 @@ class TcpAdaptorManagementTest(TestCase):
         cls.interior_edge_port = cls.tester.get_port()
         cls.interior_mgmt_port = cls.tester.get_port()
         cls.edge_mgmt_port = cls.tester.get_port()
+        cls.edge_http_port = cls.tester.get_port()
 
         cls.tcp_server_port = cls.tester.get_port()
         cls.tcp_listener_port = cls.tester.get_port()
@@ -1399,6 +1449,7 @@ class TcpAdaptorManagementTest(TestCase):
                         'id': 'TCPMgmtTestEdge'}),
             ('listener', {'role': 'normal',
                           'port': cls.edge_mgmt_port}),
+            ('listener', {'port': cls.edge_http_port, 'http': 'yes'}),
             ('connector', {'name': 'edge', 'role': 'edge',
                            'port': cls.interior_edge_port}),
             ('address', {'prefix': 'closest',   'distribution': 'closest'}),
@@ -1621,6 +1672,458 @@ class TcpAdaptorManagementTest(TestCase):
             with self.assertRaises(ConnectionRefusedError):
                 retry(_retry_until_fail, delay=0.25)
 
+    def _tcp_echo_flow(self, server, data):
+        """
+        Run a flow that sends data to the server and gets it back
+        """
+        client = self._tcp_client()
+        client.sendall(data)
+        ssock, _ = server.accept()
+        with ssock:
+            ssock.settimeout(TIMEOUT)
+            received = b''
+            while received != data:
+                received += ssock.recv(1024)
+            ssock.sendall(data)
+            received = b''
+            while received != data:
+                received += client.recv(1024)
+        client.close()
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_03_connection_pool(self):
+        """
+        Verify that a tcpConnector with poolMinIdle pre-connects to the server
+        and binds a new flow to a pooled connection
+        """
+        mgmt = self.e_router.management
+        van_address = self.test_name + "/test_03_connection_pool"
+        connector_name = "PoolConnector"
+        server = self._tcp_server(backlog=4)
+
+        self._create_tcp_connector(connector_name, van_address, poolMinIdle=2)
+
+        # the pool connects before any client arrives
+        pooled = [server.accept()[0], server.accept()[0]]
+        for ssock in pooled:
+            self.addCleanup(ssock.close)
+        self.assertTrue(retry(lambda: mgmt.read(type=TCP_CONNECTOR_TYPE,
+                                                name=connector_name)['poolIdle'] == 2))
+
+        self._create_tcp_listener("PoolListener", van_address)
+
+        client = self._tcp_client()
+        client.sendall(b'0123456789')
+
+        # the flow arrives on one of the pooled connections
+        ready, _, _ = select.select(pooled, [], [], TIMEOUT)
+        self.assertEqual(1, len(ready))
+        ssock = ready[0]
+        data = b''
+        while data != b'0123456789':
+            data += ssock.recv(1024)
+        ssock.sendall(b'ABCD')
+        data = b''
+        while data != b'ABCD':
+            data += client.recv(1024)
+        client.close()
+
+        c_stats = mgmt.read(type=TCP_CONNECTOR_TYPE, name=connector_name)
+        self.assertEqual(1, c_stats['poolHits'])
+        self.assertEqual(0, c_stats['poolMisses'])
+        self.assertLess(0, c_stats['connectLatency'])
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_04_fast_open(self):
+        """
+        Verify that a tcpListener with fastOpen delivers the data a client
+        sends (and half-closes) right after connecting
+        """
+        van_address = self.test_name + "/test_04_fast_open"
+        server = self._tcp_server()
+        self._create_tcp_connector("FastOpenConnector", van_address)
+        self._create_tcp_listener("FastOpenListener", van_address, fastOpen=True)
+
+        client = self._tcp_client()
+        client.sendall(b'0123456789')
+        client.shutdown(socket.SHUT_WR)
+
+        ssock, _ = server.accept()
+        with ssock:
+            data = b''
+            while data != b'0123456789':
+                chunk = ssock.recv(1024)
+                self.assertNotEqual(b'', chunk)
+                data += chunk
+            self.assertEqual(b'', ssock.recv(1024))
+            ssock.sendall(b'ABCD')
+            ssock.shutdown(socket.SHUT_WR)
+            data = b''
+            while data != b'ABCD':
+                data += client.recv(1024)
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_05_flow_histograms(self):
+        """
+        Verify that a completed flow is counted in the TCP flow histograms
+        reported on /metrics
+        """
+        mgmt = self.e_router.management
+        van_address = self.test_name + "/test_05_flow_histograms"
+        connector_name = "HistogramConnector"
+        listener_name = "HistogramListener"
+        histograms = ['qdr_tcp_flow_connect_microseconds',
+                      'qdr_tcp_flow_first_byte_microseconds',
+                      'qdr_tcp_flow_duration_microseconds',
+                      'qdr_tcp_flow_octets_per_second']
+
+        def _counts():
+            with urlopen(f"http://localhost:{self.edge_http_port}/metrics") as resp:
+                lines = resp.read().decode('utf-8').splitlines()
+            counts = {}
+            for line in lines:
+                name, _, value = line.partition(' ')
+                if name.endswith('_count') and name[:-len('_count')] in histograms:
+                    counts[name[:-len('_count')]] = int(value)
+            return counts
+
+        before = _counts()
+
+        server = self._tcp_server()
+        self._create_tcp_connector(connector_name, van_address)
+        self._create_tcp_listener(listener_name, van_address)
+
+        client = self._tcp_client()
+        client.sendall(b'0123456789')
+        ssock, _ = server.accept()
+        with ssock:
+            data = b''
+            while data != b'0123456789':
+                data += ssock.recv(1024)
+            ssock.sendall(b'ABCD')
+            data = b''
+            while data != b'ABCD':
+                data += client.recv(1024)
+        client.close()
+
+        # both sides of the flow are counted in duration and throughput once closed
+        def _recorded():
+            after = _counts()
+            return (after.get(histograms[0], 0) >= before.get(histograms[0], 0) + 1
+                    and after.get(histograms[1], 0) >= before.get(histograms[1], 0) + 1
+                    and after.get(histograms[2], 0) >= before.get(histograms[2], 0) + 2
+                    and after.get(histograms[3], 0) >= before.get(histograms[3], 0) + 2)
+        self.assertTrue(retry(_recorded))
+
+        # plaintext writes are counted on the listener and connector
+        l_stats = mgmt.read(type=TCP_LISTENER_TYPE, name=listener_name)
+        self.assertEqual(4, l_stats['rawWriteOctets'])
+        self.assertLessEqual(1, l_stats['rawWrites'])
+        c_stats = mgmt.read(type=TCP_CONNECTOR_TYPE, name=connector_name)
+        self.assertEqual(10, c_stats['rawWriteOctets'])
+        self.assertLessEqual(1, c_stats['rawWrites'])
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_06_flow_sampling(self):
+        """
+        Verify that a tcpListener with flowSampleInterval forwards every flow
+        but counts the flows it did not record
+        """
+        mgmt = self.e_router.management
+        van_address = self.test_name + "/test_06_flow_sampling"
+        listener_name = "SamplingListener"
+        flows = 4
+
+        server = self._tcp_server(backlog=flows)
+        self._create_tcp_connector("SamplingConnector", van_address)
+        self._create_tcp_listener(listener_name, van_address, flowSampleInterval=2)
+
+        for _ in range(flows):
+            client = self._tcp_client()
+            client.sendall(b'0123456789')
+            ssock, _ = server.accept()
+            with ssock:
+                data = b''
+                while data != b'0123456789':
+                    data += ssock.recv(1024)
+                ssock.sendall(b'ABCD')
+                data = b''
+                while data != b'ABCD':
+                    data += client.recv(1024)
+            client.close()
+
+        l_stats = mgmt.read(type=TCP_LISTENER_TYPE, name=listener_name)
+        self.assertEqual(flows, l_stats['connectionsOpened'])
+        self.assertEqual(flows // 2, l_stats['flowsUnrecorded'])
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_07_dns_cache(self):
+        """
+        Verify that the host name of a tcpConnector is resolved in the
+        background and that new flows use the cached address
+        """
+        van_address = self.test_name + "/test_07_dns_cache"
+
+        def _metrics():
+            with urlopen(f"http://localhost:{self.edge_http_port}/metrics") as resp:
+                lines = resp.read().decode('utf-8').splitlines()
+            values = {}
+            for line in lines:
+                name, _, value = line.partition(' ')
+                if name.startswith('qdr_dns_'):
+                    values[name] = int(value)
+            return values
+
+        before = _metrics()
+
+        self._tcp_server()
+        self._create_tcp_connector("DnsCacheConnector", van_address, host='localhost')
+        resolved = 'qdr_dns_resolve_latency_microseconds_count'
+        self.assertTrue(retry(lambda: _metrics().get(resolved, 0) > before.get(resolved, 0)))
+
+        self._create_tcp_listener("DnsCacheListener", van_address)
+
+        # localhost may resolve to an address the server is not bound to, only the lookup is checked
+        client = self._tcp_client()
+        client.sendall(b'0123456789')
+        hits = 'qdr_dns_cache_hits_total'
+        self.assertTrue(retry(lambda: _metrics().get(hits, 0) > before.get(hits, 0)))
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_08_shared_connections(self):
+        """
+        Verify that concurrent flows of a tcpListener with sharedConnections
+        each get the replies of their own server connection
+        """
+        van_address = self.test_name + "/test_08_shared_connections"
+        server = self._tcp_server(backlog=3)
+        self._create_tcp_connector("SharedConnConnector", van_address)
+        self._create_tcp_listener("SharedConnListener", van_address, sharedConnections=2)
+
+        # the first flow has a router connection of its own and finds out that the connector side serves
+        # shared connections
+        self._tcp_echo_flow(server, b'probe')
+        self.e_router.wait_log_message("tcpListener SharedConnListener: connector side serves shared connections")
+
+        # three flows on two shared connections, all open at once
+        clients = []
+        for i in range(3):
+            client = self._tcp_client()
+            client.sendall(b'client-%d' % i)
+            clients.append(client)
+
+        servers = []
+        for i in range(3):
+            ssock, _ = server.accept()
+            self.addCleanup(ssock.close)
+            ssock.settimeout(TIMEOUT)
+            servers.append(ssock)
+
+        # echo back what each server connection received, the reply ends up with its client
+        for ssock in servers:
+            data = ssock.recv(1024)
+            self.assertTrue(data.startswith(b'client-'))
+            ssock.sendall(b'echo-' + data)
+
+        for i, client in enumerate(clients):
+            expected = b'echo-client-%d' % i
+            data = b''
+            while data != expected:
+                chunk = client.recv(1024)
+                self.assertNotEqual(b'', chunk)
+                data += chunk
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_09_local_path(self):
+        """
+        Verify that a flow whose listener and connector are on the same router
+        carries many windows worth of data, which it does without window
+        flow control
+        """
+        van_address = self.test_name + "/test_09_local_path"
+        payload = b'0123456789abcdef' * (256 * 1024)  # 4MB
+
+        server = self._tcp_server()
+        self._create_tcp_connector("LocalPathConnector", van_address)
+        self._create_tcp_listener("LocalPathListener", van_address)
+
+        client = self._tcp_client()
+        ssock, _ = server.accept()
+        with ssock:
+            ssock.settimeout(TIMEOUT)
+            sender = Thread(target=lambda: (client.sendall(payload), client.shutdown(socket.SHUT_WR)))
+            sender.start()
+            received = 0
+            while True:
+                chunk = ssock.recv(65536)
+                if chunk == b'':
+                    break
+                received += len(chunk)
+            sender.join(TIMEOUT)
+            self.assertEqual(len(payload), received)
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_10_http1_request_balancing(self):
+        """
+        Verify that a requestBalancing http1 listener routes each request of a
+        pipelining client connection on its own server connection and returns
+        the responses in the order of the requests
+        """
+        van_address = self.test_name + "/test_10_http1_request_balancing"
+        requests = [b'GET /first HTTP/1.1\r\nHost: test\r\n\r\n',
+                    b'POST /second HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nhello']
+
+        def response(body):
+            return b'HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s' % (len(body), body)
+
+        server = self._tcp_server(backlog=2)
+        self._create_tcp_connector("RequestBalancingConnector", van_address)
+        self._create_tcp_listener("RequestBalancingListener", van_address, requestBalancing='http1')
+
+        client = self._tcp_client()
+        client.sendall(requests[0] + requests[1])
+
+        # each request arrives alone on a server connection that is closed after it,
+        # the server connections may be opened in either order
+        for _ in range(2):
+            ssock, _ = server.accept()
+            with ssock:
+                ssock.settimeout(TIMEOUT)
+                data = b''
+                while True:
+                    chunk = ssock.recv(1024)
+                    if chunk == b'':
+                        break
+                    data += chunk
+                self.assertIn(data, requests)
+                ssock.sendall(response(b'response-%d' % requests.index(data)))
+
+        expected = response(b'response-0') + response(b'response-1')
+        data = b''
+        while len(data) < len(expected):
+            chunk = client.recv(1024)
+            self.assertNotEqual(b'', chunk)
+            data += chunk
+        self.assertEqual(expected, data)
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_11_striped_flow(self):
+        """
+        Verify that the server data of a flow striped across several streams
+        arrives at the client whole and in order, including a last chunk that
+        is only partly filled
+        """
+        van_address = self.test_name + "/test_11_striped_flow"
+        payload = bytes(range(251)) * 8000 + b'tail'  # many 64KB chunks, not a multiple of them
+
+        server = self._tcp_server()
+        self._create_tcp_connector("StripedConnector", van_address, stripes=4)
+        self._create_tcp_listener("StripedListener", van_address, stripes=3)
+
+        client = self._tcp_client()
+        ssock, _ = server.accept()
+        with ssock:
+            ssock.settimeout(TIMEOUT)
+            ssock.sendall(payload)
+            ssock.shutdown(socket.SHUT_WR)
+            data = b''
+            while True:
+                chunk = client.recv(65536)
+                if chunk == b'':
+                    break
+                data += chunk
+            self.assertEqual(len(payload), len(data))
+            self.assertEqual(payload, data)
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_12_shared_connection_client_close(self):
+        """
+        Verify that a client of a tcpListener with sharedConnections that
+        closes while its server is still streaming leaves the shared
+        connection usable and its server stream is not taken for one of a
+        flow the lane does not know
+        """
+        van_address = self.test_name + "/test_12_shared_connection_client_close"
+        chunk = b'x' * 65536
+
+        server = self._tcp_server(backlog=2)
+        self._create_tcp_connector("SharedCloseConnector", van_address)
+        self._create_tcp_listener("SharedCloseListener", van_address, sharedConnections=1)
+        self._tcp_echo_flow(server, b'probe')
+        self.e_router.wait_log_message("tcpListener SharedCloseListener: connector side serves shared connections")
+
+        # the client goes away after the first of many chunks of the server stream
+        client = self._tcp_client()
+        client.sendall(b'first')
+        ssock, _ = server.accept()
+        with ssock:
+            ssock.settimeout(TIMEOUT)
+            self.assertEqual(b'first', ssock.recv(1024))
+            ssock.sendall(chunk)
+            self.assertNotEqual(b'', client.recv(1024))
+            client.close()
+            with self.assertRaises(OSError):
+                for _ in range(1000):
+                    ssock.sendall(chunk)
+
+        # the next flow on the same shared connection gets its reply
+        client = self._tcp_client()
+        client.sendall(b'second')
+        ssock, _ = server.accept()
+        with ssock:
+            ssock.settimeout(TIMEOUT)
+            self.assertEqual(b'second', ssock.recv(1024))
+            ssock.sendall(b'reply')
+            data = b''
+            while data != b'reply':
+                data += client.recv(1024)
+
+        with open(self.e_router.logfile_path, 'rt') as log_file:
+            self.assertNotIn('Server stream for no flow of shared connection', log_file.read())
+
+    @unittest.skipIf(DISABLE_SELECTOR_TESTS, DISABLE_SELECTOR_REASON)
+    def test_13_shared_connection_deleted(self):
+        """
+        Verify that deleting the router connection of a tcpListener with
+        sharedConnections closes the flows on it and that the listener opens a
+        new one for the following flows
+        """
+        van_address = self.test_name + "/test_13_shared_connection_deleted"
+        listener_name = "SharedDeleteListener"
+        mgmt = self.e_router.management
+
+        server = self._tcp_server(backlog=2)
+        self._create_tcp_connector("SharedDeleteConnector", van_address)
+        self._create_tcp_listener(listener_name, van_address, sharedConnections=1)
+        self._tcp_echo_flow(server, b'probe')
+        self.e_router.wait_log_message("tcpListener %s: connector side serves shared connections" % listener_name)
+
+        def _lanes():
+            return [d['identity'] for d in mgmt.query(type=CONNECTION_TYPE).get_dicts()
+                    if d['host'] == 'ingress-dispatch']
+
+        # a flow in progress on the shared connection
+        client = self._tcp_client()
+        client.sendall(b'first')
+        ssock, _ = server.accept()
+        self.addCleanup(ssock.close)
+        ssock.settimeout(TIMEOUT)
+        self.assertEqual(b'first', ssock.recv(1024))
+
+        lanes = _lanes()
+        self.assertEqual(1, len(lanes))
+        mgmt.update(attributes={'adminStatus': 'deleted'}, type=CONNECTION_TYPE, identity=lanes[0])
+
+        # the flow is closed rather than left hanging
+        try:
+            self.assertEqual(b'', client.recv(1024))
+        except ConnectionResetError:
+            pass
+        self.assertTrue(retry(lambda: len(_lanes()) == 1 and _lanes()[0] != lanes[0]))
+
+        # the next flow runs on the new shared connection
+        self._tcp_echo_flow(server, b'second')
+
 
 class TcpAdaptorManagementLiteTest(TcpAdaptorManagementTest):
     """
@@ -23,6 +23,7 @@ import logging
 from time import sleep
 from threading import Timer
 from subprocess import PIPE, STDOUT
+from urllib.request import urlopen
 
 from proton import Message, Delivery, symbol, Condition
 from proton.handlers import MessagingHandler
@@ -1666,11 +1667,11 @@ class StreamingLinkScrubberTest(TestCase):
 
     def test_01_streaming_link_scrubber(self):
         """
-        Ensure extra streaming links are closed by the periodic scrubber
+        Ensure extra streaming links are closed by the scrubber once idle
         """
         address = "closest/scrubber"
 
-        # scrubber removes at most 10 links per scan, the test pool size is 2
+        # scrubber removes at most 10 links at once, the test pool size is 2
         sender_count = 12
 
         # fire up a receiver on RouterB to get 1 message from each sender:
@@ -1714,6 +1715,55 @@ class StreamingLinkScrubberTest(TestCase):
         rx.wait(timeout=TIMEOUT)
 
 
+class TransferQuantumTest(TestCase):
+    """
+    Verify that large and small messages all get across when outgoing links
+    yield after sending a transfer quantum of a delivery
+    """
+
+    @classmethod
+    def setUpClass(cls):
+        super(TransferQuantumTest, cls).setUpClass()
+
+        inter_router_port = cls.tester.get_port()
+
+        def router(name, extra):
+            config = Qdrouterd.Config([
+                ('router', {'id': 'Router%s' % name, 'mode': 'interior', 'transferQuantumOctets': 16384}),
+                ('listener', {'port': cls.tester.get_port()}),
+                ('address', {'prefix': 'closest', 'distribution': 'closest'}),
+                extra
+            ])
+            return cls.tester.qdrouterd(name, config, wait=True)
+
+        cls.RouterA = router('A', ('listener', {'role': 'inter-router', 'port': inter_router_port}))
+        cls.RouterB = router('B', ('connector', {'role': 'inter-router', 'port': inter_router_port}))
+        cls.RouterA.wait_router_connected('RouterB')
+        cls.RouterB.wait_router_connected('RouterA')
+
+    def test_01_large_and_small_messages(self):
+        large_count, large_size, small_count = 10, 500000, 100
+        rx_large = AsyncTestReceiver(self.RouterB.addresses[0], 'closest/quantum/large')
+        rx_small = AsyncTestReceiver(self.RouterB.addresses[0], 'closest/quantum/small')
+        self.RouterA.wait_address('closest/quantum/large', remotes=1)
+        self.RouterA.wait_address('closest/quantum/small', remotes=1)
+
+        large = AsyncTestSender(self.RouterA.addresses[0], 'closest/quantum/large', count=large_count,
+                                message=Message(body='X' * large_size))
+        small = AsyncTestSender(self.RouterA.addresses[0], 'closest/quantum/small', count=small_count)
+        large.wait()
+        small.wait()
+        self.assertEqual(large_count, large.accepted)
+        self.assertEqual(small_count, small.accepted)
+
+        for _ in range(large_count):
+            self.assertEqual(large_size, len(rx_large.queue.get(timeout=TIMEOUT).body))
+        for _ in range(small_count):
+            rx_small.queue.get(timeout=TIMEOUT)
+        rx_large.stop()
+        rx_small.stop()
+
+
 class TwoRouterExtensionStateTest(TestCase):
     """
     Verify that routers propagate extended Disposition state correctly.
@@ -2021,5 +2071,141 @@ class TwoRouterSessionWindowTest(TestCase):
         rx_client.stop()
 
 
+class TwoRouterQ3ResumeTest(TestCase):
+    """
+    Verify that streaming links blocked by Q3 on a small inter-router session
+    window are resumed in paced batches until every message is through, and
+    that the qdr_amqp_session_q3_* counters account for it
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(TwoRouterQ3ResumeTest, cls).setUpClass()
+
+        cls.max_frame = 512
+        cls.max_session_window = 10
+        cls.http_port = cls.tester.get_port()
+        inter_router_port = cls.tester.get_port()
+
+        def router(name, extra_config):
+            config = [
+                ('router', {'mode': 'interior',
+                            'id': name,
+                            'dataConnectionCount': 0}),
+                ('listener', {'port': cls.tester.get_port()}),
+            ] + extra_config
+            return cls.tester.qdrouterd(name, Qdrouterd.Config(config), wait=False)
+
+        cls.RouterA = router('RouterA',
+                             [('listener', {'port': cls.http_port, 'http': 'yes'}),
+                              ('listener', {'role': 'inter-router',
+                                            'port': inter_router_port,
+                                            'maxFrameSize': cls.max_frame,
+                                            'maxSessionFrames': cls.max_session_window})])
+        cls.RouterB = router('RouterB',
+                             [('connector', {'name': 'toRouterA',
+                                             'role': 'inter-router',
+                                             'port': inter_router_port,
+                                             'maxFrameSize': cls.max_frame,
+                                             'maxSessionFrames': cls.max_session_window})])
+        cls.RouterA.wait_router_connected('RouterB')
+        cls.RouterB.wait_router_connected('RouterA')
+
+    def _counters(self):
+        with urlopen(f"http://localhost:{self.http_port}/metrics") as resp:
+            lines = resp.read().decode('utf-8').splitlines()
+        values = {}
+        for line in lines:
+            name, _, value = line.partition(' ')
+            if name.startswith('qdr_amqp_session_q3_'):
+                values[name] = int(value)
+        return values
+
+    def test_01_paced_resume(self):
+        """
+        Several large messages stream from A to B at once, each on its own
+        link of the inter-router session, so they block and resume together
+        """
+        senders = 4
+        count = 3
+        payload = "Q" * (20 * self.max_frame * self.max_session_window)
+        before = self._counters()
+
+        rx_client = AsyncTestReceiver(address=self.RouterB.addresses[0], source="test/q3resume")
+        self.RouterA.wait_address("test/q3resume", remotes=1)
+        tx_clients = [AsyncTestSender(address=self.RouterA.addresses[0], target="test/q3resume",
+                                      message=Message(body=payload), count=count)
+                      for _ in range(senders)]
+        for tx_client in tx_clients:
+            tx_client.wait()
+        for _ in range(senders * count):
+            self.assertEqual(payload, rx_client.queue.get(timeout=TIMEOUT).body)
+        rx_client.stop()
+
+        after = self._counters()
+        blocked = (after.get('qdr_amqp_session_q3_blocked_total', 0)
+                   - before.get('qdr_amqp_session_q3_blocked_total', 0))
+        batches = (after.get('qdr_amqp_session_q3_resume_batches_total', 0)
+                   - before.get('qdr_amqp_session_q3_resume_batches_total', 0))
+        self.assertGreater(blocked, 0, f"session never entered Q3: {after}")
+        # a Q3 episode ends only once its blocked links have been resumed by at least one batch
+        self.assertGreaterEqual(batches, blocked, f"{after}")
+        self.assertIn('qdr_amqp_session_q3_oscillations_total', after)
+
+
+class TwoRouterCompressionTest(TestCase):
+    """
+    Transfers between routers whose inter-router listener and connector both enable compression
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(TwoRouterCompressionTest, cls).setUpClass()
+
+        inter_router_port = cls.tester.get_port()
+        cls.routers = []
+        for name, connection in [('A', ('listener', {'role': 'inter-router', 'port': inter_router_port,
+                                                     'compression': 'deflate'})),
+                                 ('B', ('connector', {'role': 'inter-router', 'port': inter_router_port,
+                                                      'compression': 'deflate'}))]:
+            config = Qdrouterd.Config([
+                ('router', {'mode': 'interior', 'id': 'QDR.%s' % name}),
+                ('listener', {'port': cls.tester.get_port()}),
+                connection
+            ])
+            cls.routers.append(cls.tester.qdrouterd(name, config, wait=True))
+
+        cls.routers[0].wait_router_connected('QDR.B')
+        cls.routers[1].wait_router_connected('QDR.A')
+
+    def inter_router_connections(self, router):
+        return [c for c in router.management.query(type=CONNECTION_TYPE).get_dicts()
+                if c['role'] == 'inter-router']
+
+    def test_compressed_transfer(self):
+        connections = self.inter_router_connections(self.routers[0])
+        if not any('qd.compression' in (c['properties'] or {}) for c in connections):
+            self.skipTest("router built without compression support")
+
+        receiver = AsyncTestReceiver(self.routers[0].addresses[0], 'compressed/address')
+        self.routers[1].wait_address('compressed/address', remotes=1)
+
+        conn = BlockingConnection(self.routers[1].addresses[0])
+        sender = conn.create_sender('compressed/address', options=AtLeastOnce())
+        body = 'compressible payload ' * 1000
+        for i in range(10):
+            sender.send(Message(body=body))
+        for i in range(10):
+            self.assertEqual(body, receiver.queue.get(timeout=TIMEOUT).body)
+        conn.close()
+        receiver.stop()
+
+        def compressed(router, wire, plain):
+            totals = [sum(c[wire] for c in self.inter_router_connections(router)),
+                      sum(c[plain] for c in self.inter_router_connections(router))]
+            return 0 < totals[0] < totals[1] / 10 and totals
+        self.assertTrue(retry(lambda: compressed(self.routers[1], 'compressedOctetsSent', 'uncompressedOctetsSent')))
+        self.assertTrue(retry(lambda: compressed(self.routers[0], 'compressedOctetsReceived',
+                                                 'uncompressedOctetsReceived')))
+
+
 if __name__ == '__main__':
     unittest.main(main_module())
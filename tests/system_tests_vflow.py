@@ -17,6 +17,10 @@
 # under the License.
 #
 
+import mmap
+import os
+import struct
+
 from http1_tests import wait_tcp_listeners_up
 from system_test import TestCase, Qdrouterd, main_module, TIMEOUT, unittest
 from system_test import TestTimeout, retry, Logger, wait_port
@@ -215,6 +219,73 @@ class VFlowEventTest(TestCase):
         self.assertIsNone(test.error)
 
 
+class VFlowExportTest(TestCase):
+    """
+    Verify the router writes its vanflow records into the export ring file
+    """
+    @classmethod
+    def setUpClass(cls):
+        super(VFlowExportTest, cls).setUpClass()
+
+        cls.export_file = os.path.join(os.getcwd(), "vflow-export.ring")
+        config = Qdrouterd.Config([
+            ('router', {'mode': 'interior', 'id': "vflowExportRouter",
+                        'vflowExportFile': cls.export_file, 'vflowExportOctets': 65536}),
+            ('listener', {'port': cls.tester.get_port()}),
+        ])
+        cls.router = cls.tester.qdrouterd("vflowExportRouter", config, wait=True)
+
+    def read_records(self, ring, mask, start, end):
+        """Decode the records between two ring positions, see src/vflow_export.h"""
+        records = []
+        data = ring[start & mask:] + ring[:start & mask]
+        offset = 0
+        while offset < end - start:
+            octets, rtype, count, length = struct.unpack_from("=IHHH", data, offset)
+            cursor = offset + 10
+            record = {RECORD_TYPE: rtype, IDENTITY: data[cursor:cursor + length].decode()}
+            cursor += length
+            for _ in range(count):
+                attr, kind = struct.unpack_from("=HB", data, cursor)
+                cursor += 3
+                if kind == 1:
+                    record[attr] = struct.unpack_from("=Q", data, cursor)[0]
+                    cursor += 8
+                else:
+                    length = struct.unpack_from("=H", data, cursor)[0]
+                    record[attr] = data[cursor + 2:cursor + 2 + length].decode()
+                    cursor += 2 + length
+            records.append(record)
+            offset += octets
+        return records
+
+    def test_01_router_record(self):
+        with open(self.export_file, "r+b") as f:
+            ring_file = mmap.mmap(f.fileno(), 0)
+        self.assertEqual(b"SKVFLOW\0", ring_file[0:8])
+        version, header_octets, ring_octets = struct.unpack_from("=IIQ", ring_file, 8)
+        self.assertEqual(1, version)
+        self.assertEqual(65536, ring_octets)
+
+        records = []
+
+        def router_record_exported():
+            write_position = struct.unpack_from("=Q", ring_file, 64)[0]
+            read_position = struct.unpack_from("=Q", ring_file, 128)[0]
+            ring = ring_file[header_octets:header_octets + ring_octets]
+            records.extend(self.read_records(ring, ring_octets - 1, read_position, write_position))
+            struct.pack_into("=Q", ring_file, 128, write_position)
+            return any(r[RECORD_TYPE] == RT_ROUTER for r in records)
+
+        self.assertTrue(retry(router_record_exported), "no router record in %s" % records)
+
+        # a refresh exports the router record again
+        records.clear()
+        struct.pack_into("=I", ring_file, 136, 1)
+        self.assertTrue(retry(router_record_exported), "no router record after a refresh in %s" % records)
+        ring_file.close()
+
+
 class VFlowEventsGrabber(MessagingHandler):
     '''
     Open a receiver for BEACON messages on the indicated router
@@ -261,6 +261,50 @@ char *test_threading_mode(void *context)
     return 0;
 }
 
+static sys_mutex_t _contended_mutex;
+
+static void *_contending_thread(void *arg)
+{
+    sys_mutex_lock(&_contended_mutex);  // blocks until the main thread releases it
+    sys_mutex_unlock(&_contended_mutex);
+    return 0;
+}
+
+// A thread that waits for a named mutex must be accounted against the mutex's lock class
+//
+char *test_lock_profiling(void *context)
+{
+    sys_lock_profiling_enable();
+    sys_mutex_init_named(&_contended_mutex, "test_contended");
+
+    sys_mutex_lock(&_contended_mutex);
+    sys_thread_t *t = sys_thread(SYS_THREAD_PROACTOR, _contending_thread, 0);
+    usleep(20000);
+    sys_mutex_unlock(&_contended_mutex);
+    sys_thread_join(t);
+    sys_thread_free(t);
+    sys_mutex_free(&_contended_mutex);
+    sys_lock_profiling_disable();  // the tests that follow run unprofiled
+
+    sys_lock_stats_t stats[SYS_LOCK_CLASS_MAX];
+    int count = sys_lock_stats(stats, SYS_LOCK_CLASS_MAX);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(stats[i].name, "test_contended") == 0) {
+            uint64_t waits = 0;
+            for (int b = 0; b < SYS_LOCK_HISTOGRAM_BUCKETS; b++)
+                waits += stats[i].histogram[b];
+            if (stats[i].acquisitions != 2)
+                return "Expected two profiled acquisitions";
+            if (stats[i].contended != 1 || waits != 1)
+                return "Expected one contended acquisition";
+            if (stats[i].wait_max_ns == 0 || stats[i].wait_total_ns != stats[i].wait_max_ns)
+                return "Wait time not recorded";
+            return 0;
+        }
+    }
+    return "Lock class not found";
+}
+
 int thread_tests(void)
 {
     int result = 0;
@@ -269,7 +313,9 @@ int thread_tests(void)
     TEST_CASE(test_thread_id, 0);
     TEST_CASE(test_condition, 0);
     TEST_CASE(test_threading_roles_names, 0);
+    TEST_CASE(test_threading_role_cpus, 0);
     TEST_CASE(test_threading_mode, 0);
+    TEST_CASE(test_lock_profiling, 0);
 
     return result;
 }
@@ -355,6 +355,77 @@ static char* test_bitmask(void *context)
 }
 
 
+// exercise the full configured width and the bulk operations
+static char* test_bitmask_wide(void *context)
+{
+    char         *result = 0;
+    const int     width  = qd_bitmask_width();
+    qd_bitmask_t *a      = qd_bitmask(0);
+    qd_bitmask_t *b      = qd_bitmask(0);
+    int           num;
+    int           c;
+    int           count;
+    int           last;
+
+    // every 63rd bit hits each word at a different offset, plus the highest bit
+    for (int i = 0; i < width; i += 63)
+        qd_bitmask_set_bit(a, i);
+    qd_bitmask_set_bit(a, width - 1);
+
+    count = 0;
+    last  = -1;
+    for (QD_BITMASK_EACH(a, num, c)) {
+        if (num <= last || !qd_bitmask_value(a, num)) {
+            result = "Iteration out of order";
+            goto done;
+        }
+        last = num;
+        count++;
+    }
+    if (count != qd_bitmask_cardinality(a) || last != width - 1) {
+        result = "Iteration did not visit every set bit";
+        goto done;
+    }
+
+    qd_bitmask_set_bit(b, 63);
+    qd_bitmask_set_bit(b, 64);
+    qd_bitmask_set_bit(b, width - 1);
+    qd_bitmask_and(b, a);
+    if (qd_bitmask_cardinality(b) != 2 || !qd_bitmask_value(b, 63) || qd_bitmask_value(b, 64)) {
+        result = "Unexpected result of bitmask and";
+        goto done;
+    }
+    if (!qd_bitmask_first_set(b, &num) || num != 63) {
+        result = "Expected first set bit to be 63 after and";
+        goto done;
+    }
+
+    qd_bitmask_clear_all(b);
+    qd_bitmask_set_bit(b, 1);
+    qd_bitmask_or(b, a);
+    if (qd_bitmask_cardinality(b) != qd_bitmask_cardinality(a) + 1) {
+        result = "Unexpected cardinality after bitmask or";
+        goto done;
+    }
+
+    qd_bitmask_copy(b, a);
+    if (qd_bitmask_cardinality(b) != qd_bitmask_cardinality(a) || qd_bitmask_value(b, 1)) {
+        result = "Bitmask copy mismatch";
+        goto done;
+    }
+
+    if (qd_bitmask_valid_bit_value(width) || !qd_bitmask_valid_bit_value(width - 1)) {
+        result = "Bit range check does not match the bitmask width";
+        goto done;
+    }
+
+done:
+    qd_bitmask_free(a);
+    qd_bitmask_free(b);
+    return result;
+}
+
+
 int tool_tests(void)
 {
     int result = 0;
@@ -364,6 +435,7 @@ int tool_tests(void)
     TEST_CASE(test_deq_basic2, 0);
     TEST_CASE(test_deq_multi, 0);
     TEST_CASE(test_bitmask, 0);
+    TEST_CASE(test_bitmask_wide, 0);
 
     return result;
 }
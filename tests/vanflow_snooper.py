@@ -127,7 +127,14 @@ attribute_types = {
     62: "PROXY_HOST",
     63: "PROXY_PORT",
     64: "ERROR_LISTENER_SIDE",
-    65: "ERROR_CONNECTOR_SIDE"
+    65: "ERROR_CONNECTOR_SIDE",
+    66: "WINDOW_RTT",
+    67: "CONNECT_LATENCY",
+    68: "FLOWS_UNRECORDED",
+    69: "CPU_TIME",
+    70: "OBSERVER_SAMPLING",
+    71: "GRPC_METHOD",
+    72: "GRPC_STATUS"
 }
 
 